@@ -45,11 +45,14 @@ typedef struct
 	 gchar			*arch, *cleanmethod, *dbpath, *gpgdir, *logfile,
 				*root, *xfercmd;
 
+	 guint			 paralleldownloads;
+
 	 alpm_list_t		*cachedirs, *holdpkgs, *ignoregroups,
 				*ignorepkgs, *localfilesiglevels, *noextracts,
 				*noupgrades, *remotefilesiglevels;
 
 	 alpm_list_t		*sections;
+	 GHashTable		*files;
 	 GRegex			*xrepo, *xarch;
 	 PkBackend		*backend;
 } PkAlpmConfig;
@@ -68,6 +71,8 @@ pk_alpm_config_new (PkBackend *backend)
 
 	config->xrepo = g_regex_new ("\\$repo", 0, 0, NULL);
 	config->xarch = g_regex_new ("\\$arch", 0, 0, NULL);
+	config->files = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, g_free);
 
 	return config;
 }
@@ -110,6 +115,8 @@ pk_alpm_config_free (PkAlpmConfig *config)
 	alpm_list_free_inner (config->sections, pk_alpm_config_section_free);
 	alpm_list_free (config->sections);
 
+	if (config->files != NULL)
+		g_hash_table_unref (config->files);
 	g_regex_unref (config->xrepo);
 	g_regex_unref (config->xarch);
 }
@@ -281,6 +288,18 @@ pk_alpm_config_set_logfile (PkAlpmConfig *config, const gchar *filename)
 	config->logfile = g_strdup (filename);
 }
 
+static void
+pk_alpm_config_set_paralleldownloads (PkAlpmConfig *config, const gchar *number)
+{
+	guint64 value;
+
+	g_return_if_fail (config != NULL);
+	g_return_if_fail (number != NULL);
+
+	value = g_ascii_strtoull (number, NULL, 10);
+	config->paralleldownloads = (guint) CLAMP (value, 1, G_MAXUINT);
+}
+
 static void
 pk_alpm_config_set_root (PkAlpmConfig *config, const gchar *path)
 {
@@ -315,6 +334,7 @@ static const PkAlpmConfigString pk_alpm_config_string_options[] = {
 	{ "DBPath", pk_alpm_config_set_dbpath },
 	{ "GPGDir", pk_alpm_config_set_gpgdir },
 	{ "LogFile", pk_alpm_config_set_logfile },
+	{ "ParallelDownloads", pk_alpm_config_set_paralleldownloads },
 	{ "RootDir", pk_alpm_config_set_root },
 	{ "XferCommand", pk_alpm_config_set_xfercmd },
 	{ NULL, NULL }
@@ -478,6 +498,28 @@ pk_alpm_config_add_siglevel (PkAlpmConfig *config,
 	section->siglevels = pk_alpm_list_add_words (section->siglevels, words);
 }
 
+static gint64
+pk_alpm_config_get_mtime (const gchar *filename)
+{
+	GStatBuf buf;
+
+	if (g_stat (filename, &buf) < 0)
+		return 0;
+	return (gint64) buf.st_mtime;
+}
+
+static void
+pk_alpm_config_add_file (PkAlpmConfig *config, const gchar *filename)
+{
+	gint64 *mtime;
+
+	if (g_hash_table_contains (config->files, filename))
+		return;
+	mtime = g_new (gint64, 1);
+	*mtime = pk_alpm_config_get_mtime (filename);
+	g_hash_table_insert (config->files, g_strdup (filename), mtime);
+}
+
 static gboolean
 pk_alpm_config_parse (PkAlpmConfig *config, const gchar *filename,
 			 PkAlpmConfigSection *section, GError **error)
@@ -500,6 +542,7 @@ pk_alpm_config_parse (PkAlpmConfig *config, const gchar *filename,
 	}
 
 	input = g_data_input_stream_new (G_INPUT_STREAM (is));
+	pk_alpm_config_add_file (config, filename);
 
 	for (;; g_free (line), ++num) {
 		line = g_data_input_stream_read_line (input, NULL, NULL, &e);
@@ -562,6 +605,12 @@ pk_alpm_config_parse (PkAlpmConfig *config, const gchar *filename,
 
 			/* parse the files that matched */
 			for (i = 0; i < match.gl_pathc; ++i) {
+				g_autofree gchar *dirname = NULL;
+
+				/* notice files being added next to it */
+				dirname = g_path_get_dirname (match.gl_pathv[i]);
+				pk_alpm_config_add_file (config, dirname);
+
 				if (!pk_alpm_config_parse (config,
 							      match.gl_pathv[i],
 							      section, &e)) {
@@ -952,6 +1001,14 @@ pk_alpm_config_configure_alpm (PkBackend *backend, PkAlpmConfig *config, GError
 	alpm_option_set_checkspace (handle, config->checkspace);
 	alpm_option_set_usesyslog (handle, config->usesyslog);
 	alpm_option_set_arch (handle, config->arch);
+#ifdef HAVE_ALPM_OPTION_SET_PARALLEL_DOWNLOADS
+	if (config->paralleldownloads > 0)
+		alpm_option_set_parallel_downloads (handle, config->paralleldownloads);
+#else
+	if (config->paralleldownloads > 1)
+		g_debug ("libalpm %s downloads one file at a time, ignoring ParallelDownloads",
+			 alpm_version ());
+#endif
 
 	/* backend takes ownership */
 	g_free (xfercmd);
@@ -1009,6 +1066,15 @@ pk_alpm_configure (PkBackend *backend, const gchar *filename, gboolean is_check,
 		handle = pk_alpm_config_configure_alpm (backend, config, &e);
 	}
 
+	/* backend takes ownership */
+	if (e == NULL && !is_check) {
+		PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+		if (priv->config_files != NULL)
+			g_hash_table_unref (priv->config_files);
+		priv->config_files = config->files;
+		config->files = NULL;
+	}
+
 	pk_alpm_config_free (config);
 	if (e != NULL) {
 		g_propagate_error (error, e);
@@ -1018,3 +1084,24 @@ pk_alpm_configure (PkBackend *backend, const gchar *filename, gboolean is_check,
 	}
 	return handle;
 }
+
+/* whether any file read by pk_alpm_configure was touched since */
+gboolean
+pk_alpm_config_changed (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	GHashTableIter iter;
+	gpointer filename, mtime;
+
+	if (priv->config_files == NULL)
+		return FALSE;
+
+	g_hash_table_iter_init (&iter, priv->config_files);
+	while (g_hash_table_iter_next (&iter, &filename, &mtime)) {
+		if (pk_alpm_config_get_mtime (filename) != *(gint64 *) mtime) {
+			g_debug ("%s has changed", (const gchar *) filename);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
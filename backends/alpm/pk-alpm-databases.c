@@ -21,6 +21,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <glib/gstdio.h>
+
 #include "pk-backend-alpm.h"
 #include "pk-alpm-config.h"
 #include "pk-alpm-databases.h"
@@ -31,8 +33,50 @@ typedef struct
 	gchar *name;
 	alpm_list_t *servers;
 	alpm_siglevel_t level;
+	gint64 mtime; /* of the sync file when registered */
 } PkBackendRepo;
 
+static gint64
+pk_alpm_repo_get_mtime (PkBackend *backend, PkBackendRepo *repo)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	GStatBuf buf;
+	g_autofree gchar *filename = NULL;
+
+	filename = g_strconcat (alpm_option_get_dbpath (priv->alpm), "/sync/",
+				repo->name, ".db", NULL);
+	if (g_stat (filename, &buf) < 0)
+		return 0;
+	return (gint64) buf.st_mtime;
+}
+
+static gboolean
+pk_alpm_repo_register (PkBackend *backend, PkBackendRepo *repo,
+		       gboolean only_trusted, GError **error)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	alpm_siglevel_t level = repo->level;
+	alpm_db_t *db;
+
+	if (!only_trusted) {
+		level &= ~ALPM_SIG_PACKAGE;
+		level &= ~ALPM_SIG_DATABASE;
+		level &= ~ALPM_SIG_USE_DEFAULT;
+	}
+
+	db = alpm_register_syncdb (priv->alpm, repo->name, level);
+	if (db == NULL) {
+		alpm_errno_t alpm_err = alpm_errno (priv->alpm);
+		g_set_error (error, PK_ALPM_ERROR, alpm_err, "[%s]: %s",
+			     repo->name, alpm_strerror (alpm_err));
+		return FALSE;
+	}
+
+	alpm_db_set_servers (db, alpm_list_strdup (repo->servers));
+	repo->mtime = pk_alpm_repo_get_mtime (backend, repo);
+	return TRUE;
+}
+
 static gboolean
 pk_alpm_disabled_repos_configure (PkBackend *backend, gboolean only_trusted, GError **error)
 {
@@ -47,25 +91,8 @@ pk_alpm_disabled_repos_configure (PkBackend *backend, gboolean only_trusted, GEr
 	}
 
 	for (i = priv->configured_repos; i != NULL; i = i->next) {
-		PkBackendRepo *repo = (PkBackendRepo *) i->data;
-		alpm_siglevel_t level = repo->level;
-		alpm_db_t *db;
-
-		if (!only_trusted) {
-			level &= ~ALPM_SIG_PACKAGE;
-			level &= ~ALPM_SIG_DATABASE;
-			level &= ~ALPM_SIG_USE_DEFAULT;
-		}
-
-		db = alpm_register_syncdb (priv->alpm, repo->name, level);
-		if (db == NULL) {
-			alpm_errno_t alpm_err = alpm_errno (priv->alpm);
-			g_set_error (error, PK_ALPM_ERROR, alpm_err, "[%s]: %s",
-				     repo->name, alpm_strerror (alpm_err));
+		if (!pk_alpm_repo_register (backend, i->data, only_trusted, error))
 			return FALSE;
-		}
-
-		alpm_db_set_servers (db, alpm_list_strdup (repo->servers));
 	}
 
 	return TRUE;
@@ -83,6 +110,7 @@ pk_alpm_add_database (PkBackend *backend, const gchar *name, alpm_list_t *server
 	repo->name = g_strdup (name);
 	repo->servers = alpm_list_strdup (servers);
 	repo->level = level;
+	repo->mtime = 0;
 
 	priv->configured_repos = alpm_list_add (priv->configured_repos, repo);
 }
@@ -108,6 +136,44 @@ pk_alpm_initialize_databases (PkBackend *backend, GError **error)
 	return TRUE;
 }
 
+/* re-registers the sync databases whose files were replaced behind our
+ * back, e.g. by pacman -Sy, keeping the parsed cache of the others */
+gboolean
+pk_alpm_reload_databases (PkBackend *backend, GError **error)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *i, *j;
+	alpm_list_t *stale = NULL;
+
+	for (i = priv->configured_repos; i != NULL; i = i->next) {
+		PkBackendRepo *repo = (PkBackendRepo *) i->data;
+		if (pk_alpm_repo_get_mtime (backend, repo) != repo->mtime)
+			break;
+	}
+	if (i == NULL)
+		return TRUE;
+
+	/* the database order is significant, so everything from the first
+	 * changed repo onwards has to be registered again */
+	for (j = alpm_get_syncdbs (priv->alpm); j != NULL; j = j->next) {
+		const gchar *name = alpm_db_get_name (j->data);
+		if (stale != NULL ||
+		    g_strcmp0 (name, ((PkBackendRepo *) i->data)->name) == 0)
+			stale = alpm_list_add (stale, j->data);
+	}
+	for (j = stale; j != NULL; j = j->next) {
+		g_debug ("reloading sync database %s", alpm_db_get_name (j->data));
+		alpm_db_unregister (j->data);
+	}
+	alpm_list_free (stale);
+
+	for (; i != NULL; i = i->next) {
+		if (!pk_alpm_repo_register (backend, i->data, TRUE, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 void
 pk_alpm_destroy_databases (PkBackend *backend)
 {
@@ -21,203 +21,340 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <glib/gstdio.h>
 #include <alpm.h>
 #include <pk-backend.h>
 
 #include "pk-backend-alpm.h"
+#include "pk-alpm-depends.h"
 #include "pk-alpm-error.h"
 #include "pk-alpm-packages.h"
 
-static alpm_pkg_t *
-pk_alpm_list_find_pkgname (const alpm_list_t *pkgs, const gchar *name)
+/* what one depend of a package resolved to */
+typedef struct {
+	gchar		*depend;
+	alpm_pkg_t	*provider;	/* NULL if nothing satisfies it */
+	gboolean	 local;
+} PkAlpmDepEdge;
+
+/* the packages of one generation of the databases, with the edges between
+ * them filled in as the walks need them */
+typedef struct {
+	gchar		*stamp;
+	GHashTable	*local_provides;	/* name : alpm_list_t of pkgs */
+	GHashTable	*sync_provides;		/* name : alpm_list_t of pkgs */
+	GHashTable	*depends;		/* pkg : GArray of PkAlpmDepEdge */
+	GHashTable	*required_by;		/* local pkg : alpm_list_t of pkgs */
+} PkAlpmDepGraph;
+
+static PkAlpmDepGraph *dep_graph = NULL;
+static GMutex dep_graph_mutex;
+
+static void
+pk_alpm_dep_edges_free (GArray *edges)
 {
-	g_return_val_if_fail (name != NULL, NULL);
+	for (guint i = 0; i < edges->len; i++)
+		g_free (g_array_index (edges, PkAlpmDepEdge, i).depend);
+	g_array_unref (edges);
+}
 
-	for (; pkgs != NULL; pkgs = pkgs->next) {
-		if (g_strcmp0 (name, alpm_pkg_get_name (pkgs->data)) == 0)
-			return pkgs->data;
-	}
+static void
+pk_alpm_dep_graph_free (PkAlpmDepGraph *graph)
+{
+	g_hash_table_unref (graph->local_provides);
+	g_hash_table_unref (graph->sync_provides);
+	g_hash_table_unref (graph->depends);
+	g_clear_pointer (&graph->required_by, g_hash_table_unref);
+	g_free (graph->stamp);
+	g_free (graph);
+}
 
-	return NULL;
+void
+pk_alpm_depends_destroy (void)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&dep_graph_mutex);
+	g_clear_pointer (&dep_graph, pk_alpm_dep_graph_free);
 }
 
-static alpm_list_t *
-pk_alpm_find_provider (PkBackendJob *job, alpm_list_t *pkgs,
-		       const gchar *depend, gboolean recursive,
-		       PkBitfield filters, GError **error)
+/* changes whenever pk_alpm_run reloads a database */
+static gchar *
+pk_alpm_dep_graph_stamp (PkBackend *backend)
 {
-	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
-	gboolean skip_local, skip_remote;
+	const gchar *dbpath = alpm_option_get_dbpath (priv->alpm);
+	const alpm_list_t *i;
+	GString *stamp = g_string_new (NULL);
+	g_autofree gchar *local = g_build_filename (dbpath, "local", NULL);
+	GStatBuf buf;
+
+	if (g_stat (local, &buf) == 0)
+		g_string_append_printf (stamp, "local:%" G_GINT64_FORMAT, (gint64) buf.st_mtime);
+	for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next) {
+		const gchar *name = alpm_db_get_name (i->data);
+		g_autofree gchar *basename = g_strconcat (name, ".db", NULL);
+		g_autofree gchar *filename = g_build_filename (dbpath, "sync", basename, NULL);
+		gint64 mtime = g_stat (filename, &buf) == 0 ? (gint64) buf.st_mtime : 0;
+		g_string_append_printf (stamp, ";%s:%" G_GINT64_FORMAT, name, mtime);
+	}
+	return g_string_free (stamp, FALSE);
+}
 
-	alpm_pkg_t *provider;
-	alpm_list_t *pkgcache, *syncdbs;
+static void
+pk_alpm_dep_graph_add_provides (GHashTable *provides, alpm_list_t *pkgcache)
+{
+	for (; pkgcache != NULL; pkgcache = pkgcache->next) {
+		alpm_pkg_t *pkg = pkgcache->data;
+		const gchar *name = alpm_pkg_get_name (pkg);
+		alpm_list_t *list;
+		const alpm_list_t *j;
+
+		list = g_hash_table_lookup (provides, name);
+		g_hash_table_insert (provides, (gpointer) name, alpm_list_add (list, pkg));
+		for (j = alpm_pkg_get_provides (pkg); j != NULL; j = j->next) {
+			alpm_depend_t *provide = j->data;
+			list = g_hash_table_lookup (provides, provide->name);
+			g_hash_table_insert (provides, provide->name, alpm_list_add (list, pkg));
+		}
+	}
+}
 
-	g_return_val_if_fail (depend != NULL, pkgs);
+/* must be called with dep_graph_mutex held */
+static PkAlpmDepGraph *
+pk_alpm_dep_graph_get (PkBackend *backend)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *i;
+	g_autofree gchar *stamp = pk_alpm_dep_graph_stamp (backend);
+
+	if (dep_graph != NULL && g_strcmp0 (dep_graph->stamp, stamp) == 0)
+		return dep_graph;
+
+	g_clear_pointer (&dep_graph, pk_alpm_dep_graph_free);
+	dep_graph = g_new0 (PkAlpmDepGraph, 1);
+	dep_graph->stamp = g_steal_pointer (&stamp);
+	dep_graph->local_provides = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+							   (GDestroyNotify) alpm_list_free);
+	dep_graph->sync_provides = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+							  (GDestroyNotify) alpm_list_free);
+	dep_graph->depends = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+						    (GDestroyNotify) pk_alpm_dep_edges_free);
+
+	/* in the order alpm_find_dbs_satisfier looks at them */
+	pk_alpm_dep_graph_add_provides (dep_graph->local_provides,
+					alpm_db_get_pkgcache (priv->localdb));
+	for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next)
+		pk_alpm_dep_graph_add_provides (dep_graph->sync_provides,
+						alpm_db_get_pkgcache (i->data));
+	return dep_graph;
+}
 
-	skip_local = pk_bitfield_contain (filters,
-					  PK_FILTER_ENUM_NOT_INSTALLED);
-	skip_remote = pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED);
+static gboolean
+pk_alpm_pkg_satisfies (alpm_pkg_t *pkg, const gchar *depend)
+{
+	alpm_list_t one = { pkg, &one, NULL };
+	return alpm_find_satisfier (&one, depend) != NULL;
+}
 
-	if (alpm_find_satisfier (pkgs, depend) != NULL) {
-		return pkgs;
+/* must be called with dep_graph_mutex held */
+static GArray *
+pk_alpm_dep_graph_get_depends (PkAlpmDepGraph *graph, alpm_pkg_t *pkg)
+{
+	GArray *edges = g_hash_table_lookup (graph->depends, pkg);
+	const alpm_list_t *i;
+
+	if (edges != NULL)
+		return edges;
+
+	/* installed providers win, as with the package transactions */
+	edges = g_array_new (FALSE, FALSE, sizeof (PkAlpmDepEdge));
+	for (i = alpm_pkg_get_depends (pkg); i != NULL; i = i->next) {
+		alpm_depend_t *dep = i->data;
+		PkAlpmDepEdge edge = { alpm_dep_compute_string (dep), NULL, TRUE };
+
+		edge.provider = alpm_find_satisfier (g_hash_table_lookup (graph->local_provides, dep->name),
+						     edge.depend);
+		if (edge.provider == NULL) {
+			edge.local = FALSE;
+			edge.provider = alpm_find_satisfier (g_hash_table_lookup (graph->sync_provides, dep->name),
+							     edge.depend);
+		}
+		g_array_append_val (edges, edge);
 	}
+	g_hash_table_insert (graph->depends, pkg, edges);
+	return edges;
+}
+
+/* must be called with dep_graph_mutex held */
+static const alpm_list_t *
+pk_alpm_dep_graph_get_required_by (PkBackend *backend, PkAlpmDepGraph *graph, alpm_pkg_t *pkg)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *i, *j;
+
+	if (graph->required_by != NULL)
+		goto out;
 
-	/* look for local dependencies */
-	pkgcache = alpm_db_get_pkgcache (priv->localdb);
-	provider = alpm_find_satisfier (pkgcache, depend);
+	/* one pass over what is installed gives every reverse edge */
+	graph->required_by = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+						    (GDestroyNotify) alpm_list_free);
+	for (i = alpm_db_get_pkgcache (priv->localdb); i != NULL; i = i->next) {
+		alpm_pkg_t *requirer = i->data;
 
-	if (provider != NULL) {
-		if (!skip_local) {
-			pk_alpm_pkg_emit (job, provider, PK_INFO_ENUM_INSTALLED);
-			/* assume later dependencies will also be local */
-			if (recursive) {
-				pkgs = alpm_list_add (pkgs, provider);
+		for (j = alpm_pkg_get_depends (requirer); j != NULL; j = j->next) {
+			alpm_depend_t *dep = j->data;
+			const alpm_list_t *k = g_hash_table_lookup (graph->local_provides, dep->name);
+			g_autofree gchar *depend = NULL;
+
+			if (k == NULL)
+				continue;
+			depend = alpm_dep_compute_string (dep);
+			for (; k != NULL; k = k->next) {
+				alpm_list_t *list;
+				if (k->data == requirer || !pk_alpm_pkg_satisfies (k->data, depend))
+					continue;
+				list = g_hash_table_lookup (graph->required_by, k->data);
+				if (alpm_list_find_ptr (list, requirer) != NULL)
+					continue;
+				g_hash_table_insert (graph->required_by, k->data,
+						     alpm_list_add (list, requirer));
 			}
 		}
-
-		return pkgs;
 	}
-
-	/* look for remote dependencies */
-	syncdbs = alpm_get_syncdbs (priv->alpm);
-	provider = alpm_find_dbs_satisfier (priv->alpm, syncdbs, depend);
-
-	if (provider != NULL) {
-		if (!skip_remote)
-			pk_alpm_pkg_emit (job, provider, PK_INFO_ENUM_AVAILABLE);
-		/* keep looking for local dependencies */
-		if (recursive)
-			pkgs = alpm_list_add (pkgs, provider);
-	} else {
-		int code = ALPM_ERR_UNSATISFIED_DEPS;
-		g_set_error (error, PK_ALPM_ERROR, code, "%s: %s", depend,
-			     alpm_strerror (code));
+out:
+	/* an available package is required by whatever needs the installed
+	 * one it would replace */
+	if (alpm_pkg_get_db (pkg) != priv->localdb) {
+		alpm_pkg_t *local = alpm_db_get_pkg (priv->localdb, alpm_pkg_get_name (pkg));
+		if (local != NULL)
+			pkg = local;
 	}
-
-	return pkgs;
+	return g_hash_table_lookup (graph->required_by, pkg);
 }
 
 static alpm_list_t *
-pk_backend_find_requirer (PkBackendJob *job, alpm_list_t *pkgs, const gchar *name, gboolean recursive,
-			  GError **error)
+pk_alpm_depends_find_pkgs (PkBackendJob *job, gchar **packages, GError **error)
 {
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
-	alpm_pkg_t *requirer;
+	alpm_list_t *pkgs = NULL;
 
-	g_return_val_if_fail (name != NULL, pkgs);
+	for (; *packages != NULL; ++packages) {
+		alpm_pkg_t *pkg;
 
-	if (pk_alpm_list_find_pkgname (pkgs, name) != NULL)
-		return pkgs;
+		if (pk_backend_job_is_cancelled (job))
+			break;
 
-	/* look for local requirers */
-	requirer = alpm_db_get_pkg (priv->localdb, name);
+		pkg = pk_alpm_find_pkg (job, *packages, error);
+		if (pkg == NULL)
+			break;
 
-	if (requirer != NULL) {
-		pk_alpm_pkg_emit (job, requirer, PK_INFO_ENUM_INSTALLED);
-		if (recursive)
-			pkgs = alpm_list_add (pkgs, requirer);
-	} else {
-		int code = ALPM_ERR_PKG_NOT_FOUND;
-		g_set_error (error, PK_ALPM_ERROR, code, "%s: %s", name,
-			     alpm_strerror (code));
+		pkgs = alpm_list_add (pkgs, pkg);
 	}
-
 	return pkgs;
 }
 
 static void
 pk_backend_depends_on_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
+	PkBackend *backend = pk_backend_job_get_backend (job);
 	gchar **packages;
-	alpm_list_t *i, *pkgs = NULL;
+	alpm_list_t *i, *pkgs;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+	PkAlpmDepGraph *graph;
 	PkBitfield filters;
-	gboolean recursive;
+	gboolean recursive, skip_local, skip_remote;
+	g_autoptr(GMutexLocker) locker = NULL;
 
 	g_variant_get (params, "(t^a&sb)",
 		       &filters, &packages, &recursive);
 
-	/* construct an initial package list */
-	for (; *packages != NULL; ++packages) {
-		alpm_pkg_t *pkg;
-
-		if (pk_backend_job_is_cancelled (job))
-			break;
+	skip_local = pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED);
+	skip_remote = pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED);
 
-		pkg = pk_alpm_find_pkg (job, *packages, &error);
-		if (pkg == NULL)
-			break;
+	/* construct an initial package list */
+	pkgs = pk_alpm_depends_find_pkgs (job, packages, &error);
 
-		pkgs = alpm_list_add (pkgs, pkg);
-	}
+	locker = g_mutex_locker_new (&dep_graph_mutex);
+	graph = pk_alpm_dep_graph_get (backend);
 
-	/* package list might be modified along the way but that is ok */
-	for (i = pkgs; i != NULL; i = i->next) {
-		const alpm_list_t *depends;
+	/* one walk for all the packages, so a shared dependency is only
+	 * looked at once; the list grows at the end as it is walked */
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = pkgs; i != NULL; i = i->next)
+		g_hash_table_add (seen, i->data);
+	for (i = pkgs; i != NULL && error == NULL; i = i->next) {
+		GArray *edges;
 
-		if (pk_backend_job_is_cancelled (job) || error != NULL)
+		if (pk_backend_job_is_cancelled (job))
 			break;
 
-		depends = alpm_pkg_get_depends (i->data);
-		for (; depends != NULL; depends = depends->next) {
-			g_autofree gchar *depend = NULL;
+		edges = pk_alpm_dep_graph_get_depends (graph, i->data);
+		for (guint j = 0; j < edges->len; j++) {
+			PkAlpmDepEdge *edge = &g_array_index (edges, PkAlpmDepEdge, j);
 
-			if (pk_backend_job_is_cancelled (job) || error != NULL)
+			if (edge->provider == NULL) {
+				int code = ALPM_ERR_UNSATISFIED_DEPS;
+				g_set_error (&error, PK_ALPM_ERROR, code, "%s: %s",
+					     edge->depend, alpm_strerror (code));
 				break;
-
-			depend = alpm_dep_compute_string (depends->data);
-			pkgs = pk_alpm_find_provider (job, pkgs, depend, recursive, filters, &error);
+			}
+			if (!g_hash_table_add (seen, edge->provider))
+				continue;
+
+			if (edge->local) {
+				if (skip_local)
+					continue;
+				pk_alpm_pkg_emit (job, edge->provider, PK_INFO_ENUM_INSTALLED);
+			} else if (!skip_remote) {
+				pk_alpm_pkg_emit (job, edge->provider, PK_INFO_ENUM_AVAILABLE);
+			}
+			if (recursive)
+				pkgs = alpm_list_add (pkgs, edge->provider);
 		}
 	}
 
 	alpm_list_free (pkgs);
+	pk_alpm_finish (job, error);
 }
 
 static void
 pk_backend_required_by_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
+	PkBackend *backend = pk_backend_job_get_backend (job);
 	gchar **packages;
-	alpm_list_t *i, *pkgs = NULL;
+	alpm_list_t *i, *pkgs;
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+	PkAlpmDepGraph *graph;
 	gboolean recursive;
 	PkBitfield filters;
+	g_autoptr(GMutexLocker) locker = NULL;
 
 	g_variant_get (params, "(t^a&sb)",
 		       &filters, &packages, &recursive);
 
 	/* construct an initial package list */
-	for (; *packages != NULL; ++packages) {
-		alpm_pkg_t *pkg;
-
-		if (pk_backend_job_is_cancelled (job))
-			break;
+	pkgs = pk_alpm_depends_find_pkgs (job, packages, &error);
 
-		pkg = pk_alpm_find_pkg (job, *packages, &error);
-		if (pkg == NULL)
-			break;
-
-		pkgs = alpm_list_add (pkgs, pkg);
-	}
+	locker = g_mutex_locker_new (&dep_graph_mutex);
+	graph = pk_alpm_dep_graph_get (backend);
 
-	/* package list might be modified along the way but that is ok */
-	for (i = pkgs; i != NULL; i = i->next) {
-		alpm_list_t *requiredby;
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = pkgs; i != NULL; i = i->next)
+		g_hash_table_add (seen, i->data);
+	for (i = pkgs; i != NULL && error == NULL; i = i->next) {
+		const alpm_list_t *j;
 
-		if (pk_backend_job_is_cancelled (job) || error != NULL)
+		if (pk_backend_job_is_cancelled (job))
 			break;
 
-		requiredby = alpm_pkg_compute_requiredby (i->data);
-		for (; requiredby != NULL; requiredby = requiredby->next) {
-			if (pk_backend_job_is_cancelled (job) || error != NULL)
-				break;
-
-			pkgs = pk_backend_find_requirer (job, pkgs,
-							 requiredby->data, recursive, &error);
+		j = pk_alpm_dep_graph_get_required_by (backend, graph, i->data);
+		for (; j != NULL; j = j->next) {
+			if (!g_hash_table_add (seen, j->data))
+				continue;
+			pk_alpm_pkg_emit (job, j->data, PK_INFO_ENUM_INSTALLED);
+			if (recursive)
+				pkgs = alpm_list_add (pkgs, j->data);
 		}
-
-		FREELIST (requiredby);
 	}
 
 	alpm_list_free (pkgs);
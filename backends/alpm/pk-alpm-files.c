@@ -0,0 +1,279 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "pk-backend-alpm.h"
+#include "pk-alpm-files.h"
+
+typedef struct {
+	const gchar	*path;
+	const gchar	*pkgname;
+} PkAlpmFile;
+
+typedef struct {
+	gint64		 mtime;
+	GStringChunk	*strings;
+	GArray		*files;		/* of PkAlpmFile, sorted by path */
+	GHashTable	*basenames;	/* basename : GArray of file indexes */
+	GHashTable	*applications;	/* names of packages with desktop files */
+} PkAlpmFileDb;
+
+/* unlike the groups this is kept when pk_alpm_run reloads the handle, so
+ * only the databases that changed are indexed again */
+static GHashTable *file_dbs = NULL;
+static GMutex file_dbs_mutex;
+
+static void
+pk_alpm_file_db_free (PkAlpmFileDb *fdb)
+{
+	g_hash_table_unref (fdb->applications);
+	g_hash_table_unref (fdb->basenames);
+	g_array_unref (fdb->files);
+	g_string_chunk_free (fdb->strings);
+	g_free (fdb);
+}
+
+static gint
+pk_alpm_file_cmp (gconstpointer a, gconstpointer b)
+{
+	return strcmp (((const PkAlpmFile *) a)->path,
+		       ((const PkAlpmFile *) b)->path);
+}
+
+static void
+pk_alpm_file_db_add_pkgs (PkAlpmFileDb *fdb, const alpm_list_t *pkgs)
+{
+	const alpm_list_t *i;
+
+	for (i = pkgs; i != NULL; i = i->next) {
+		alpm_filelist_t *files = alpm_pkg_get_files (i->data);
+		PkAlpmFile file;
+		gsize j;
+
+		file.pkgname = g_string_chunk_insert_const (fdb->strings,
+							    alpm_pkg_get_name (i->data));
+		for (j = 0; j < files->count; ++j) {
+			const gchar *name = files->files[j].name;
+
+			file.path = g_string_chunk_insert (fdb->strings, name);
+			g_array_append_val (fdb->files, file);
+
+			if (g_str_has_prefix (name, "usr/share/applications/") &&
+			    g_str_has_suffix (name, ".desktop")) {
+				g_hash_table_add (fdb->applications,
+						  g_strdup (file.pkgname));
+			}
+		}
+	}
+}
+
+static void
+pk_alpm_file_db_index (PkAlpmFileDb *fdb)
+{
+	guint i;
+
+	g_array_sort (fdb->files, pk_alpm_file_cmp);
+	for (i = 0; i < fdb->files->len; ++i) {
+		const PkAlpmFile *file = &g_array_index (fdb->files, PkAlpmFile, i);
+		const gchar *name = strrchr (file->path, G_DIR_SEPARATOR);
+		GArray *idxs;
+
+		name = name == NULL ? file->path : name + 1;
+
+		/* directories end with a separator and never match */
+		if (*name == '\0')
+			continue;
+
+		idxs = g_hash_table_lookup (fdb->basenames, name);
+		if (idxs == NULL) {
+			idxs = g_array_new (FALSE, FALSE, sizeof (guint));
+			g_hash_table_insert (fdb->basenames, (gpointer) name, idxs);
+		}
+		g_array_append_val (idxs, i);
+	}
+}
+
+static gint64
+pk_alpm_file_db_get_mtime (PkBackend *backend, alpm_db_t *db)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const gchar *dbpath = alpm_option_get_dbpath (priv->alpm);
+	g_autofree gchar *filename = NULL;
+	GStatBuf buf;
+
+	if (db == priv->localdb) {
+		filename = g_build_filename (dbpath, "local", NULL);
+	} else {
+		g_autofree gchar *basename = NULL;
+		basename = g_strconcat (alpm_db_get_name (db), ".files", NULL);
+		filename = g_build_filename (dbpath, "sync", basename, NULL);
+	}
+	if (g_stat (filename, &buf) != 0)
+		return 0;
+	return (gint64) buf.st_mtime;
+}
+
+static PkAlpmFileDb *
+pk_alpm_file_db_new (PkBackend *backend, alpm_db_t *db, gint64 mtime)
+{
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	PkAlpmFileDb *fdb;
+
+	fdb = g_new0 (PkAlpmFileDb, 1);
+	fdb->mtime = mtime;
+	fdb->strings = g_string_chunk_new (64 * 1024);
+	fdb->files = g_array_new (FALSE, FALSE, sizeof (PkAlpmFile));
+	fdb->basenames = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						(GDestroyNotify) g_array_unref);
+	fdb->applications = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, NULL);
+
+	if (db == priv->localdb) {
+		pk_alpm_file_db_add_pkgs (fdb, alpm_db_get_pkgcache (db));
+	} else if (mtime != 0) {
+		alpm_errno_t alpm_err;
+		alpm_handle_t *handle;
+		alpm_db_t *files_db;
+
+		/* the .db files have no file lists, so use a private handle
+		 * that reads the matching .files databases instead */
+		handle = alpm_initialize (alpm_option_get_root (priv->alpm),
+					  alpm_option_get_dbpath (priv->alpm),
+					  &alpm_err);
+		if (handle == NULL) {
+			g_warning ("failed to read %s.files: %s",
+				   alpm_db_get_name (db), alpm_strerror (alpm_err));
+			return fdb;
+		}
+		alpm_option_set_dbext (handle, ".files");
+		files_db = alpm_register_syncdb (handle, alpm_db_get_name (db), 0);
+		if (files_db != NULL)
+			pk_alpm_file_db_add_pkgs (fdb, alpm_db_get_pkgcache (files_db));
+		alpm_release (handle);
+	}
+
+	pk_alpm_file_db_index (fdb);
+	g_debug ("indexed %u files in %s", fdb->files->len, alpm_db_get_name (db));
+	return fdb;
+}
+
+static void
+pk_alpm_file_db_find (PkAlpmFileDb *fdb, const gchar *needle, GHashTable *found)
+{
+	guint i;
+
+	if (G_IS_DIR_SEPARATOR (*needle)) {
+		PkAlpmFile key = { needle + 1, NULL };
+		guint lo = 0, hi = fdb->files->len;
+
+		/* the paths are sorted, so find the first match */
+		while (lo < hi) {
+			guint mid = lo + (hi - lo) / 2;
+			if (pk_alpm_file_cmp (&g_array_index (fdb->files, PkAlpmFile, mid), &key) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		for (i = lo; i < fdb->files->len; ++i) {
+			const PkAlpmFile *file = &g_array_index (fdb->files, PkAlpmFile, i);
+			if (strcmp (file->path, key.path) != 0)
+				break;
+			g_hash_table_add (found, (gpointer) file->pkgname);
+		}
+	} else {
+		GArray *idxs = g_hash_table_lookup (fdb->basenames, needle);
+		for (i = 0; idxs != NULL && i < idxs->len; ++i) {
+			guint idx = g_array_index (idxs, guint, i);
+			const PkAlpmFile *file = &g_array_index (fdb->files, PkAlpmFile, idx);
+			g_hash_table_add (found, (gpointer) file->pkgname);
+		}
+	}
+}
+
+/* must be called with file_dbs_mutex held */
+static PkAlpmFileDb *
+pk_alpm_files_get_db (PkBackend *backend, alpm_db_t *db)
+{
+	PkAlpmFileDb *fdb;
+	gint64 mtime;
+
+	if (file_dbs == NULL) {
+		file_dbs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						  (GDestroyNotify) pk_alpm_file_db_free);
+	}
+
+	/* only reindex the databases that changed since the last search */
+	mtime = pk_alpm_file_db_get_mtime (backend, db);
+	fdb = g_hash_table_lookup (file_dbs, alpm_db_get_name (db));
+	if (fdb == NULL || fdb->mtime != mtime) {
+		fdb = pk_alpm_file_db_new (backend, db, mtime);
+		g_hash_table_replace (file_dbs, g_strdup (alpm_db_get_name (db)), fdb);
+	}
+	return fdb;
+}
+
+/* returns the names of the packages in db that contain all the needles */
+GHashTable *
+pk_alpm_files_find (PkBackend *backend, alpm_db_t *db, const alpm_list_t *needles)
+{
+	PkAlpmFileDb *fdb;
+	GHashTable *result = NULL;
+	const alpm_list_t *i;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&file_dbs_mutex);
+
+	g_return_val_if_fail (db != NULL, NULL);
+
+	fdb = pk_alpm_files_get_db (backend, db);
+
+	for (i = needles; i != NULL; i = i->next) {
+		GHashTable *found = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   g_free, NULL);
+		g_autoptr(GHashTable) matched = g_hash_table_new (g_str_hash, g_str_equal);
+		GHashTableIter iter;
+		gpointer key;
+
+		pk_alpm_file_db_find (fdb, i->data, matched);
+		g_hash_table_iter_init (&iter, matched);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			if (result == NULL || g_hash_table_contains (result, key))
+				g_hash_table_add (found, g_strdup (key));
+		}
+		if (result != NULL)
+			g_hash_table_unref (result);
+		result = found;
+	}
+	if (result == NULL)
+		result = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	return result;
+}
+
+/* returns the names of the packages in db that ship a desktop file */
+GHashTable *
+pk_alpm_files_get_applications (PkBackend *backend, alpm_db_t *db)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&file_dbs_mutex);
+
+	g_return_val_if_fail (db != NULL, NULL);
+
+	return g_hash_table_ref (pk_alpm_files_get_db (backend, db)->applications);
+}
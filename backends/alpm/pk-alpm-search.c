@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "pk-backend-alpm.h"
+#include "pk-alpm-files.h"
 #include "pk-alpm-groups.h"
 #include "pk-alpm-packages.h"
 
@@ -264,38 +265,72 @@ pk_alpm_pkg_is_local (PkBackendJob *job, alpm_pkg_t *pkg)
 	return TRUE;
 }
 
+/* NULL unless the filters need to know which packages are applications */
+static GHashTable *
+pk_backend_search_get_applications (PkBackendJob *job, alpm_db_t *db,
+				    PkBitfield filters)
+{
+	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) &&
+	    !pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION))
+		return NULL;
+	return pk_alpm_files_get_applications (pk_backend_job_get_backend (job), db);
+}
+
 static gboolean
-pk_alpm_search_is_application (alpm_pkg_t *pkg) {
-	guint i;
-	alpm_filelist_t *filelist;
-	g_autoptr(GRegex) regex = NULL;
+pk_backend_search_filter (GHashTable *applications, alpm_pkg_t *pkg,
+			  PkBitfield filters)
+{
+	gboolean is_application;
 
-	filelist = alpm_pkg_get_files (pkg);
-	regex = g_regex_new ("^usr/share/applications/.*\\.desktop$", 0, 0, NULL);
+	if (applications == NULL)
+		return TRUE;
+	is_application = g_hash_table_contains (applications, alpm_pkg_get_name (pkg));
 
-	for (i = 0; i < filelist->count; i++) {
-		const alpm_file_t *file = filelist->files + i;
-		if (g_regex_match (regex, file->name, 0, NULL)) {
-			return TRUE;
+	/* want applications */
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) && !is_application)
+		return FALSE;
+
+	/* don't want applications */
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION) && is_application)
+		return FALSE;
+
+	return TRUE;
+}
+
+static void
+pk_backend_search_emit (PkBackendJob *job, alpm_db_t *db, const alpm_list_t *pkgs)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const alpm_list_t *i;
+
+	for (i = pkgs; i != NULL; i = i->next) {
+		/* the rest would not be sent */
+		if (pk_backend_job_get_limit_reached (job))
+			break;
+		if (db == priv->localdb) {
+			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_INSTALLED);
+		} else if (!pk_alpm_pkg_is_local (job, i->data)) {
+			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_AVAILABLE);
 		}
 	}
-	return FALSE;
 }
 
-static void
+/* returns the packages that match all search terms, in pkgcache order */
+static alpm_list_t *
 pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
 		      const alpm_list_t *patterns, PkBitfield filters)
 {
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
 	const alpm_list_t *i, *j;
+	alpm_list_t *found = NULL;
+	g_autoptr(GHashTable) applications = NULL;
 
-	g_return_if_fail (db != NULL);
-	g_return_if_fail (match != NULL);
+	g_return_val_if_fail (db != NULL, NULL);
+	g_return_val_if_fail (match != NULL, NULL);
 
-	/* emit packages that match all search terms */
+	applications = pk_backend_search_get_applications (job, db, filters);
 	for (i = alpm_db_get_pkgcache (db); i != NULL; i = i->next) {
-		if (pk_backend_job_is_cancelled (job))
+		if (pk_backend_job_checkpoint (job, "alpm:search"))
 			break;
 
 		for (j = patterns; j != NULL; j = j->next) {
@@ -307,20 +342,70 @@ pk_backend_search_db (PkBackendJob *job, alpm_db_t *db, MatchFunc match,
 		if (j != NULL)
 			continue;
 
-		/* want applications */
-		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION) && !pk_alpm_search_is_application (i->data))
-			continue;
+		if (pk_backend_search_filter (applications, i->data, filters))
+			found = alpm_list_add (found, i->data);
+	}
+	return found;
+}
 
-		/* don't want applications */
-		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION) && pk_alpm_search_is_application (i->data))
-			continue;
+static alpm_list_t *
+pk_backend_search_db_files (PkBackendJob *job, alpm_db_t *db,
+			    const alpm_list_t *patterns, PkBitfield filters)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	GHashTableIter iter;
+	gpointer name;
+	alpm_list_t *found = NULL;
+	g_autoptr(GHashTable) applications = NULL;
+	g_autoptr(GHashTable) names = NULL;
+
+	g_return_val_if_fail (db != NULL, NULL);
+
+	/* look the files up in the index rather than every package */
+	names = pk_alpm_files_find (backend, db, patterns);
+	applications = pk_backend_search_get_applications (job, db, filters);
+	g_hash_table_iter_init (&iter, names);
+	while (g_hash_table_iter_next (&iter, &name, NULL)) {
+		alpm_pkg_t *pkg = alpm_db_get_pkg (db, name);
+		if (pkg != NULL && pk_backend_search_filter (applications, pkg, filters))
+			found = alpm_list_add (found, pkg);
+	}
+	return found;
+}
 
-		if (db == priv->localdb) {
-			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_INSTALLED);
-		} else if (!pk_alpm_pkg_is_local (job, i->data)) {
-			pk_alpm_pkg_emit (job, i->data, PK_INFO_ENUM_AVAILABLE);
-		}
+typedef struct {
+	PkBackendJob	*job;
+	alpm_db_t	*db;
+	SearchType	 type;
+	gchar		**needles;
+	PkBitfield	 filters;
+	alpm_list_t	*found;
+} PkBackendSearchWorker;
+
+static void
+pk_backend_search_worker (gpointer data, gpointer user_data)
+{
+	PkBackendSearchWorker *worker = data;
+	PkBackend *backend = pk_backend_job_get_backend (worker->job);
+	GDestroyNotify pattern_free = pattern_frees[worker->type];
+	alpm_list_t *patterns = NULL;
+	gchar **needle;
+
+	/* each worker compiles its own copy of the patterns */
+	for (needle = worker->needles; needle != NULL && *needle != NULL; ++needle) {
+		gpointer pattern = pattern_funcs[worker->type] (backend, *needle, NULL);
+		if (pattern == NULL)
+			goto out;
+		patterns = alpm_list_add (patterns, pattern);
 	}
+
+	worker->found = pk_backend_search_db (worker->job, worker->db,
+					      match_funcs[worker->type],
+					      patterns, worker->filters);
+out:
+	if (pattern_free != NULL)
+		alpm_list_free_inner (patterns, pattern_free);
+	alpm_list_free (patterns);
 }
 
 static void
@@ -338,9 +423,12 @@ pk_backend_search_thread (PkBackendJob *job, GVariant* params, gpointer p)
 	PkRoleEnum role;
 	PkBitfield filters = 0;
 	gboolean skip_local, skip_remote;
+	guint n;
 
 	const alpm_list_t *i;
 	alpm_list_t *patterns = NULL;
+	GThreadPool *pool = NULL;
+	PkBackendSearchWorker *workers = NULL;
 	g_autoptr(GError) error = NULL;
 
 	g_return_if_fail (p == NULL);
@@ -396,29 +484,73 @@ pk_backend_search_thread (PkBackendJob *job, GVariant* params, gpointer p)
 	skip_remote = pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED);
 
 	/* convert search terms to the pattern requested */
-	if (needles) {
-		for (; *needles != NULL; ++needles) {
-			gpointer pattern = pattern_func (backend, *needles, &error);
+	for (n = 0; needles != NULL && needles[n] != NULL; ++n) {
+		gpointer pattern = pattern_func (backend, needles[n], &error);
+
+		if (pattern == NULL)
+			goto out;
 
-			if (pattern == NULL)
-				goto out;
+		patterns = alpm_list_add (patterns, pattern);
+	}
 
-			patterns = alpm_list_add (patterns, pattern);
+	/* search the sync databases on worker threads; they are fully
+	 * read when their pkgcache is loaded, unlike the local database
+	 * which loads package data lazily and so stays on this thread */
+	if (!skip_remote && type != SEARCH_TYPE_FILES) {
+		workers = g_new0 (PkBackendSearchWorker,
+				  alpm_list_count (alpm_get_syncdbs (priv->alpm)));
+		pool = g_thread_pool_new (pk_backend_search_worker, NULL,
+					  (gint) g_get_num_processors (), FALSE, NULL);
+		n = 0;
+		for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next, ++n) {
+			alpm_db_get_pkgcache (i->data);
+			workers[n].job = job;
+			workers[n].db = i->data;
+			workers[n].type = type;
+			workers[n].needles = needles;
+			workers[n].filters = filters;
+			g_thread_pool_push (pool, &workers[n], NULL);
 		}
 	}
 
 	/* find installed packages first */
-	if (!skip_local)
-		pk_backend_search_db (job, priv->localdb, match_func, patterns, filters);
+	if (!skip_local) {
+		alpm_list_t *found;
+		if (type == SEARCH_TYPE_FILES)
+			found = pk_backend_search_db_files (job, priv->localdb, patterns, filters);
+		else
+			found = pk_backend_search_db (job, priv->localdb, match_func, patterns, filters);
+		pk_backend_search_emit (job, priv->localdb, found);
+		alpm_list_free (found);
+	}
+
+	if (pool != NULL) {
+		/* emit in database order */
+		g_thread_pool_free (pool, FALSE, TRUE);
+		n = 0;
+		for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next, ++n) {
+			if (!pk_backend_job_is_cancelled (job) &&
+			    !pk_backend_job_get_limit_reached (job))
+				pk_backend_search_emit (job, i->data, workers[n].found);
+			alpm_list_free (workers[n].found);
+		}
+		g_free (workers);
+		goto out;
+	}
 
 	if (skip_remote)
 		goto out;
 
 	for (i = alpm_get_syncdbs (priv->alpm); i != NULL; i = i->next) {
-		if (pk_backend_job_is_cancelled (job))
+		alpm_list_t *found;
+
+		if (pk_backend_job_is_cancelled (job) ||
+		    pk_backend_job_get_limit_reached (job))
 			break;
 
-		pk_backend_search_db (job, i->data, match_func, patterns, filters);
+		found = pk_backend_search_db_files (job, i->data, patterns, filters);
+		pk_backend_search_emit (job, i->data, found);
+		alpm_list_free (found);
 	}
 out:
 	if (pattern_free != NULL)
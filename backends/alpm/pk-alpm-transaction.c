@@ -31,6 +31,11 @@
 static off_t transaction_dcomplete = 0;
 static off_t transaction_dtotal = 0;
 
+/* files being downloaded, as with ParallelDownloads there can be more than
+ * one; each maps the basename to the bytes received so far */
+static GHashTable *dstreams = NULL;
+static GTimer *dtimer = NULL;
+
 static alpm_pkg_t *dpkg = NULL;
 static GString *dfiles = NULL;
 
@@ -129,6 +134,48 @@ pk_alpm_transaction_download_start (PkBackendJob *job, const gchar *basename)
 	}
 }
 
+static off_t
+pk_alpm_transaction_dstreams_sum (void)
+{
+	GHashTableIter iter;
+	gpointer value;
+	off_t sum = 0;
+
+	g_hash_table_iter_init (&iter, dstreams);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		sum += *(off_t *) value;
+	return sum;
+}
+
+static void
+pk_alpm_transaction_dstreams_update (PkBackendJob *job, const gchar *basename,
+				     off_t complete)
+{
+	off_t *received;
+	gdouble elapsed;
+
+	if (dstreams == NULL) {
+		dstreams = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, g_free);
+	}
+	if (dtimer == NULL)
+		dtimer = g_timer_new ();
+
+	received = g_hash_table_lookup (dstreams, basename);
+	if (received == NULL) {
+		received = g_new0 (off_t, 1);
+		g_hash_table_insert (dstreams, g_strdup (basename), received);
+	}
+	*received = complete;
+
+	/* average over every stream since the downloads started */
+	elapsed = g_timer_elapsed (dtimer, NULL);
+	if (elapsed > 0) {
+		off_t bytes = transaction_dcomplete + pk_alpm_transaction_dstreams_sum ();
+		pk_backend_job_set_speed (job, (guint) MIN ((bytes * 8) / elapsed, G_MAXUINT));
+	}
+}
+
 static void
 pk_alpm_transaction_totaldlcb (off_t total)
 {
@@ -141,6 +188,10 @@ pk_alpm_transaction_totaldlcb (off_t total)
 
 	transaction_dcomplete = 0;
 	transaction_dtotal = total;
+	if (dstreams != NULL)
+		g_hash_table_remove_all (dstreams);
+	if (dtimer != NULL)
+		g_timer_start (dtimer);
 }
 
 static void
@@ -164,16 +215,34 @@ pk_alpm_transaction_dlcb (const gchar *basename, off_t complete, off_t total)
 		return;
 
 	} else if (complete > 0 && complete == total) { // download is complete
-		pk_backend_job_set_percentage(job, 100);
+		if (dstreams != NULL)
+			g_hash_table_remove (dstreams, basename);
 		transaction_dcomplete += complete;
+		if (transaction_dtotal > 0) {
+			percentage = ((transaction_dcomplete + pk_alpm_transaction_dstreams_sum ()) * 100) / transaction_dtotal;
+			pk_backend_job_set_percentage (job, MIN (percentage, 100));
+		} else {
+			pk_backend_job_set_percentage (job, 100);
+		}
+		if (dpkg != NULL && pk_alpm_pkg_has_basename (pk_backend_job_get_backend (job), dpkg, basename)) {
+			g_autofree gchar *package_id = pk_alpm_pkg_build_id (dpkg);
+			pk_backend_job_set_item_progress (job, package_id, PK_STATUS_ENUM_DOWNLOAD, 100);
+		}
 
 	} else if (complete > 0 && complete < total && total > 0) { // download in progress
 		sub_percentage = (complete * 100) / (total);
 		if (transaction_dtotal > 0) {
 			// positive totals indicate packages
-			percentage = ((transaction_dcomplete + complete) * 100) / transaction_dtotal;
-
-			pk_backend_job_set_percentage (job, percentage);
+			pk_alpm_transaction_dstreams_update (job, basename, complete);
+			percentage = ((transaction_dcomplete + pk_alpm_transaction_dstreams_sum ()) * 100) / transaction_dtotal;
+
+			pk_backend_job_set_percentage (job, MIN (percentage, 100));
+			if (dpkg != NULL && pk_alpm_pkg_has_basename (pk_backend_job_get_backend (job), dpkg, basename)) {
+				g_autofree gchar *package_id = pk_alpm_pkg_build_id (dpkg);
+				pk_backend_job_set_item_progress (job, package_id,
+								  PK_STATUS_ENUM_DOWNLOAD,
+								  sub_percentage);
+			}
 		} else if (transaction_dtotal < 0) {
 			// negative totals indicate databases
 			guint total_databases = -transaction_dtotal;
@@ -1134,6 +1203,8 @@ pk_alpm_transaction_end (PkBackendJob *job, GError **error)
 		pk_alpm_transaction_download_end (job);
 	if (tpkg != NULL)
 		pk_alpm_transaction_output_end ();
+	g_clear_pointer (&dstreams, g_hash_table_unref);
+	g_clear_pointer (&dtimer, g_timer_destroy);
 
 	g_assert (pkalpm_current_job);
 	pkalpm_current_job = NULL;
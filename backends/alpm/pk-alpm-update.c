@@ -217,21 +217,14 @@ pk_alpm_update_get_db_timestamp_filename (alpm_db_t *db)
 static gboolean
 pk_alpm_update_is_db_fresh (PkBackendJob *job, alpm_db_t *db)
 {
-	guint cache_age;
 	GStatBuf stat_buffer;
 	g_autofree gchar *timestamp_filename = NULL;
 
-	cache_age = pk_backend_job_get_cache_age (job);
-
 	timestamp_filename = pk_alpm_update_get_db_timestamp_filename (db);
-
-	if (cache_age < 0 || cache_age >= G_MAXUINT)
-		return FALSE;
-
 	if (g_stat (timestamp_filename, &stat_buffer) < 0)
 		return FALSE;
 
-	return stat_buffer.st_mtime >= (time (NULL) - cache_age);
+	return pk_backend_job_is_cache_fresh (job, stat_buffer.st_mtime);
 }
 
 static gboolean
@@ -265,24 +258,24 @@ pk_alpm_update_set_db_timestamp (alpm_db_t *db, GError **error)
 gboolean
 pk_alpm_update_database (PkBackendJob *job, gint force, alpm_db_t *db, GError **error)
 {
-	PkBackend *backend = pk_backend_job_get_backend (job);
-	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	alpm_handle_t *handle = alpm_db_get_handle (db);
 	alpm_cb_download dlcb;
 	gint result;
 
-	dlcb = alpm_option_get_dlcb (priv->alpm);
+	dlcb = alpm_option_get_dlcb (handle);
 
-	if (pk_alpm_update_is_db_fresh (job, db))
-		return TRUE;
-
-	if (!force)
+	if (!force && pk_alpm_update_is_db_fresh (job, db))
 		return TRUE;
 
+	/* unless forced, libalpm sends If-Modified-Since with the mtime of
+	 * the local copy and returns 1 without a transfer if it is current */
 	result = alpm_db_update (force, db);
 	if (result > 0) {
-		dlcb ("", 1, 1);
+		g_debug ("%s is up to date", alpm_db_get_name (db));
+		if (dlcb != NULL)
+			dlcb ("", 1, 1);
 	} else if (result < 0) {
-		g_set_error (error, PK_ALPM_ERROR, alpm_errno (priv->alpm), "[%s]: %s",
+		g_set_error (error, PK_ALPM_ERROR, alpm_errno (handle), "[%s]: %s",
 				alpm_db_get_name (db),
 				alpm_strerror (errno));
 		return FALSE;
@@ -291,6 +284,65 @@ pk_alpm_update_database (PkBackendJob *job, gint force, alpm_db_t *db, GError **
 	return pk_alpm_update_set_db_timestamp (db, error);
 }
 
+/**
+ * pk_alpm_update_files_databases:
+ *
+ * Refreshes the .files databases that pacman -Fy fetched before, so the
+ * file index is not left behind the package lists. A missing or failed
+ * one only means SearchFile finds less, so this never fails the job.
+ **/
+static void
+pk_alpm_update_files_databases (PkBackendJob *job, gint force, alpm_list_t *dbs)
+{
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	const gchar *dbpath = alpm_option_get_dbpath (priv->alpm);
+	alpm_errno_t alpm_err;
+	alpm_handle_t *handle = NULL;
+	alpm_list_t *i;
+
+	for (i = dbs; i != NULL; i = i->next) {
+		alpm_db_t *db = i->data;
+		alpm_db_t *files_db;
+		const alpm_list_t *j;
+		g_autofree gchar *basename = NULL;
+		g_autofree gchar *filename = NULL;
+
+		basename = g_strconcat (alpm_db_get_name (db), ".files", NULL);
+		filename = g_build_filename (dbpath, "sync", basename, NULL);
+		if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+			continue;
+		if (pk_backend_job_is_cancelled (job))
+			break;
+
+		if (handle == NULL) {
+			handle = alpm_initialize (alpm_option_get_root (priv->alpm),
+						  dbpath, &alpm_err);
+			if (handle == NULL) {
+				g_warning ("failed to refresh the .files databases: %s",
+					   alpm_strerror (alpm_err));
+				return;
+			}
+			alpm_option_set_dbext (handle, ".files");
+			alpm_option_set_gpgdir (handle, alpm_option_get_gpgdir (priv->alpm));
+		}
+
+		files_db = alpm_register_syncdb (handle, alpm_db_get_name (db),
+						 alpm_db_get_siglevel (db));
+		if (files_db == NULL)
+			continue;
+		for (j = alpm_db_get_servers (db); j != NULL; j = j->next)
+			alpm_db_add_server (files_db, j->data);
+		if (alpm_db_update (force, files_db) < 0) {
+			g_warning ("failed to refresh %s: %s", basename,
+				   alpm_strerror (alpm_errno (handle)));
+		}
+	}
+
+	if (handle != NULL)
+		alpm_release (handle);
+}
+
 static gboolean
 pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 {
@@ -299,6 +351,17 @@ pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 	alpm_cb_totaldl totaldlcb;
 	gboolean ret;
 	const alpm_list_t *i;
+	alpm_list_t *updated = NULL;
+
+	/* nothing to do, so do not even take the lock */
+	for (i = alpm_get_syncdbs (priv->alpm); !force && i != NULL; i = i->next) {
+		if (!pk_alpm_update_is_db_fresh (job, i->data))
+			break;
+	}
+	if (!force && i == NULL) {
+		g_debug ("all databases are younger than the cache age");
+		return TRUE;
+	}
 
 	if (!pk_alpm_transaction_initialize (job, 0, NULL, error))
 		return FALSE;
@@ -319,6 +382,8 @@ pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 			break;
 		}
 
+		if (force || !pk_alpm_update_is_db_fresh (job, i->data))
+			updated = alpm_list_add (updated, i->data);
 		ret = pk_alpm_update_database (job, force, i->data, error);
 		if (!ret) {
 			break;
@@ -327,10 +392,18 @@ pk_alpm_update_databases (PkBackendJob *job, gint force, GError **error)
 
 	totaldlcb (0);
 
-	if (i == NULL)
-		return pk_alpm_transaction_end (job, error);
-	pk_alpm_transaction_end (job, NULL);
-	return FALSE;
+	if (i != NULL) {
+		pk_alpm_transaction_end (job, NULL);
+		alpm_list_free (updated);
+		return FALSE;
+	}
+	ret = pk_alpm_transaction_end (job, error);
+
+	/* a second handle can only lock the databases once this one is done */
+	if (ret)
+		pk_alpm_update_files_databases (job, force, updated);
+	alpm_list_free (updated);
+	return ret;
 }
 
 static gboolean
@@ -419,6 +492,22 @@ pk_alpm_update_is_pkg_downloaded (alpm_pkg_t *pkg)
 	return g_file_test (filename, G_FILE_TEST_IS_REGULAR);
 }
 
+/* the handle GetUpdates syncs the check databases with, kept between jobs
+ * so pacman.conf is not parsed and the databases registered every time */
+static alpm_handle_t *check_handle = NULL;
+static GMutex check_mutex;
+
+void
+pk_alpm_update_destroy (void)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&check_mutex);
+
+	if (check_handle != NULL) {
+		alpm_release (check_handle);
+		check_handle = NULL;
+	}
+}
+
 static void
 pk_backend_get_updates_thread (PkBackendJob *job, GVariant* params, gpointer p)
 {
@@ -432,7 +521,17 @@ pk_backend_get_updates_thread (PkBackendJob *job, GVariant* params, gpointer p)
 	int stored_count;
 	alpm_cb_totaldl totaldlcb;
 	gboolean ret;
-	alpm_handle_t* handle = pk_alpm_configure (backend, PK_BACKEND_CONFIG_FILE, TRUE, error);
+	alpm_handle_t *handle;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&check_mutex);
+
+	if (check_handle == NULL) {
+		check_handle = pk_alpm_configure (backend, PK_BACKEND_CONFIG_FILE, TRUE, &error);
+		if (check_handle == NULL) {
+			pk_alpm_error_emit (job, error);
+			return;
+		}
+	}
+	handle = check_handle;
 
 	alpm_logaction (handle, PK_LOG_PREFIX, "synchronizing package lists\n");
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD_PACKAGELIST);
@@ -447,7 +546,7 @@ pk_backend_get_updates_thread (PkBackendJob *job, GVariant* params, gpointer p)
 			break;
 		}
 
-		ret = pk_alpm_update_database (job, TRUE, i->data, error);
+		ret = pk_alpm_update_database (job, FALSE, i->data, &error);
 		if (!ret)
 			break;
 	}
@@ -24,3 +24,5 @@
 #include <pk-backend.h>
 
 gboolean pk_alpm_update_database(PkBackendJob *job, gint force, alpm_db_t *db, GError **error);
+
+void pk_alpm_update_destroy (void);
@@ -31,10 +31,12 @@
 #include "pk-backend-alpm.h"
 #include "pk-alpm-config.h"
 #include "pk-alpm-databases.h"
+#include "pk-alpm-depends.h"
 #include "pk-alpm-error.h"
 #include "pk-alpm-groups.h"
 #include "pk-alpm-transaction.h"
 #include "pk-alpm-environment.h"
+#include "pk-alpm-update.h"
 
 const gchar *
 pk_backend_get_description (PkBackend *backend)
@@ -164,6 +166,8 @@ pk_backend_destroy (PkBackend *backend)
 	pk_alpm_groups_destroy (backend);
 	pk_alpm_destroy_databases (backend);
 	pk_alpm_destroy_monitor (backend);
+	pk_alpm_update_destroy ();
+	pk_alpm_depends_destroy ();
 
 	if (priv->alpm != NULL) {
 		if (alpm_trans_get_flags (priv->alpm) < 0)
@@ -173,6 +177,8 @@ pk_backend_destroy (PkBackend *backend)
 
 	FREELIST (priv->syncfirsts);
 	FREELIST (priv->holdpkgs);
+	if (priv->config_files != NULL)
+		g_hash_table_unref (priv->config_files);
 	g_free (priv);
 }
 
@@ -198,12 +204,18 @@ pk_alpm_run (PkBackendJob *job, PkStatusEnum status, PkBackendJobThreadFunc func
 {
 	PkBackend *backend = pk_backend_job_get_backend (job);
 	PkBackendAlpmPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
 	g_return_if_fail (func != NULL);
 
-	if (priv->localdb_changed) {
+	/* keep the handle unless libalpm cannot pick the change up itself;
+	 * the local database and the options can only be reloaded by
+	 * starting over */
+	if (priv->localdb_changed || pk_alpm_config_changed (backend)) {
 		pk_backend_destroy (backend);
 		pk_backend_initialize (NULL, backend);
 		pk_backend_installed_db_changed (backend);
+	} else if (!pk_alpm_reload_databases (backend, &error)) {
+		g_warning ("failed to reload databases: %s", error->message);
 	}
 
 	pk_backend_job_set_allow_cancel (job, TRUE);
@@ -32,6 +32,7 @@ typedef struct {
 	alpm_handle_t	*alpm;
 	GFileMonitor    *monitor;
 	alpm_list_t     *configured_repos; /* list of configured repos */
+	GHashTable	*config_files; /* path : mtime of the parsed config */
 	gboolean	localdb_changed;
 } PkBackendAlpmPrivate;
 
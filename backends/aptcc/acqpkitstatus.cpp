@@ -88,6 +88,9 @@ void AcqPackageKitStatus::Done(pkgAcquire::ItemDesc &Itm)
                                    true);
     }
     // Download completed
+    if (Itm.Owner->FileSize > 0) {
+        updateBytes(Itm, Itm.Owner->FileSize, Itm.Owner->FileSize);
+    }
     updateStatus(Itm, 100);
 }
 
@@ -155,16 +158,21 @@ bool AcqPackageKitStatus::Pulse(pkgAcquire *Owner)
         }
 
 #if APT_PKG_ABI >= 590
-        if (I->CurrentItem->TotalSize > 0) {
-            updateStatus(*I->CurrentItem,
-                         long(double(I->CurrentItem->CurrentSize * 100.0) / double(I->CurrentItem->TotalSize)));
+        unsigned long long current = I->CurrentItem->CurrentSize;
+        unsigned long long total = I->CurrentItem->TotalSize;
 #else
-        if (I->TotalSize > 0) {
-            updateStatus(*I->CurrentItem,
-                         long(double(I->CurrentSize * 100.0) / double(I->TotalSize)));
+        unsigned long long current = I->CurrentSize;
+        unsigned long long total = I->TotalSize;
 #endif
-        } else {
-            updateStatus(*I->CurrentItem, 100);
+        // until the server told the size go by the one from the index,
+        // Done() reports the item as finished
+        if (total == 0) {
+            total = I->CurrentItem->Owner->FileSize;
+        }
+        if (total > 0) {
+            updateBytes(*I->CurrentItem, current, total);
+            updateStatus(*I->CurrentItem,
+                         MIN(long(double(current * 100.0) / double(total)), 99));
         }
     }
 
@@ -177,7 +185,7 @@ bool AcqPackageKitStatus::Pulse(pkgAcquire *Owner)
 
     Update = false;
 
-    return !m_apt->cancelled();
+    return !m_apt->checkpoint("aptcc:acquire");
 }
 
 // AcqPackageKitStatus::MediaChange - Media need to be swapped
@@ -220,13 +228,45 @@ void AcqPackageKitStatus::updateStatus(pkgAcquire::ItemDesc & Itm, int status)
         return;
     }
 
+    // only emit what changed, every pulse goes over all the items
+    // that are being downloaded
+    auto it = m_itemPercent.find(Itm.Owner);
+    if (it != m_itemPercent.end() && it->second == status) {
+        return;
+    }
+    bool started = it != m_itemPercent.end() && it->second != 100;
+    m_itemPercent[Itm.Owner] = status;
+
     if (status == 100) {
         m_apt->emitPackage(ver, PK_INFO_ENUM_FINISHED);
     } else {
         // emit the package
-        m_apt->emitPackage(ver, PK_INFO_ENUM_DOWNLOADING);
-        
+        if (!started) {
+            m_apt->emitPackage(ver, PK_INFO_ENUM_DOWNLOADING);
+        }
+
         // Emit the individual progress
         m_apt->emitPackageProgress(ver, PK_STATUS_ENUM_DOWNLOAD, status);
     }
 }
+
+void AcqPackageKitStatus::updateBytes(pkgAcquire::ItemDesc & Itm, unsigned long long current,
+                                      unsigned long long total)
+{
+    PkRoleEnum role = pk_backend_job_get_role(m_job);
+    if ((role == PK_ROLE_ENUM_REFRESH_CACHE) || (role == PK_ROLE_ENUM_GET_UPDATE_DETAIL)) {
+        return;
+    }
+
+    pkgAcqArchiveSane *archive = static_cast<pkgAcqArchiveSane*>(dynamic_cast<pkgAcqArchive*>(Itm.Owner));
+    if (archive == nullptr) {
+        return;
+    }
+    const pkgCache::VerIterator ver = archive->version();
+    if (ver.end() == true) {
+        return;
+    }
+
+    // the job adds these up over all the items downloading at once
+    m_apt->emitPackageBytes(ver, current, total);
+}
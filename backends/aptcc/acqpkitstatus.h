@@ -21,6 +21,7 @@
 #ifndef ACQ_PKIT_STATUS_H
 #define ACQ_PKIT_STATUS_H
 
+#include <map>
 #include <set>
 #include <string>
 #include <apt-pkg/acquire-item.h>
@@ -49,12 +50,17 @@ public:
 
 private:
     void updateStatus(pkgAcquire::ItemDesc & Itm, int status);
+    void updateBytes(pkgAcquire::ItemDesc & Itm, unsigned long long current,
+                     unsigned long long total);
 
     PkBackendJob *m_job;
 
     unsigned long m_lastPercent;
     double        m_lastCPS;
     AptIntf       *m_apt;
+
+    // the last percentage emitted for each item, several download at once
+    std::map<pkgAcquire::Item*, int> m_itemPercent;
 };
 
 class pkgAcqArchiveSane : public pkgAcqArchive
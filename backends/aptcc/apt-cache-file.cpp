@@ -21,21 +21,138 @@
  */
 #include "apt-cache-file.h"
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unordered_map>
 #include <apt-pkg/algorithms.h>
+#include <apt-pkg/aptconfiguration.h>
+#include <apt-pkg/fileutl.h>
 #include <apt-pkg/progress.h>
 #include <apt-pkg/upgrade.h>
 
 #include "apt-utils.h"
 #include "apt-messages.h"
+#include "details-index.h"
+#include "dpkg-file-index.h"
+#include "gst-matcher.h"
+#include "summary-cache.h"
+
+// which of the cached properties have been worked out
+#define VERSION_PROPERTIES_COMPUTED     (1u << 30)
+#define VERSION_APPLICATION_COMPUTED    (1u << 31)
 
 using namespace APT;
 
+/* the cache kept open between read-only jobs */
+static GMutex sharedMutex;
+static AptCacheFile *sharedCache = nullptr;
+static bool sharedInUse = false;
+static std::atomic<guint> sharedGeneration(0);
+
+/* the version properties of the last closed cache, by "name:arch version",
+ * so the next cache only works out the ones of the packages that changed */
+static GMutex carriedMutex;
+static std::unordered_map<string, guint32> carriedProperties;
+static DpkgStatusSnapshot carriedStatus;
+static time_t carriedListsMtime = 0;
+
+static time_t listsMtime()
+{
+    struct stat st;
+    string lists = _config->FindDir("Dir::State::lists");
+
+    // the lists are renamed into place, which changes the directory
+    if (stat(lists.c_str(), &st) != 0) {
+        return 0;
+    }
+    return st.st_mtime;
+}
+
 AptCacheFile::AptCacheFile(PkBackendJob *job) :
     m_packageRecords(0),
-    m_job(job)
+    m_job(job),
+    m_generation(G_MAXUINT),
+    m_listsMtime(0),
+    m_detailsIndex(nullptr),
+    m_summaryCache(nullptr),
+    m_summaryMtime(0),
+    m_desktopOwners(nullptr),
+    m_gstIndex(nullptr),
+    m_appStreamPool(nullptr)
+{
+}
+
+AptCacheFile *AptCacheFile::acquireShared(PkBackendJob *job)
+{
+    AptCacheFile *cache = nullptr;
+
+    g_mutex_lock(&sharedMutex);
+    if (sharedCache != nullptr && !sharedInUse && sharedCache->isCurrent()) {
+        cache = sharedCache;
+        sharedInUse = true;
+    }
+    g_mutex_unlock(&sharedMutex);
+    if (cache == nullptr) {
+        return nullptr;
+    }
+
+    // drop whatever the previous job marked on the depcache
+    cache->m_job = job;
+    OpPackageKitProgress progress(job);
+    if (!cache->GetDepCache()->Init(&progress)) {
+        _error->Discard();
+        invalidateShared();
+        releaseShared(cache);
+        return nullptr;
+    }
+    g_debug("reusing the open package cache");
+    return cache;
+}
+
+void AptCacheFile::releaseShared(AptCacheFile *cache)
+{
+    g_mutex_lock(&sharedMutex);
+    bool current = cache->isCurrent();
+    cache->m_job = nullptr;
+    if (cache == sharedCache) {
+        sharedInUse = false;
+        if (current) {
+            cache = nullptr;
+        } else {
+            sharedCache = nullptr;
+        }
+    } else if (current && !sharedInUse) {
+        std::swap(sharedCache, cache);
+    }
+    g_mutex_unlock(&sharedMutex);
+
+    delete cache;
+}
+
+void AptCacheFile::invalidateShared()
 {
+    AptCacheFile *cache = nullptr;
+
+    sharedGeneration++;
+
+    // a job using it deletes it once it is done
+    g_mutex_lock(&sharedMutex);
+    if (!sharedInUse) {
+        std::swap(sharedCache, cache);
+    }
+    g_mutex_unlock(&sharedMutex);
+
+    delete cache;
+}
+
+bool AptCacheFile::isCurrent() const
+{
+    return m_generation == sharedGeneration && m_listsMtime == listsMtime();
 }
 
 AptCacheFile::~AptCacheFile()
@@ -46,7 +163,18 @@ AptCacheFile::~AptCacheFile()
 bool AptCacheFile::Open(bool withLock)
 {
     OpPackageKitProgress progress(m_job);
-    return pkgCacheFile::Open(&progress, withLock);
+    guint generation = sharedGeneration;
+    time_t mtime = listsMtime();
+
+    // taken first, anything changing afterwards is found by the next cache
+    m_status.load(_config->FindFile("Dir::State::status"));
+
+    if (!pkgCacheFile::Open(&progress, withLock)) {
+        return false;
+    }
+    m_generation = generation;
+    m_listsMtime = mtime;
+    return true;
 }
 
 void AptCacheFile::Close()
@@ -55,6 +183,24 @@ void AptCacheFile::Close()
 
     m_packageRecords = 0;
 
+    // the iterators point into the cache
+    m_names.clear();
+    m_nameOffsets.clear();
+    m_namePkgs.clear();
+    m_groupPkgs.clear();
+    delete m_detailsIndex;
+    m_detailsIndex = nullptr;
+    saveSummaryCache();
+    m_details.clear();
+    exportVersionProperties();
+    m_versionProperties.clear();
+    delete m_desktopOwners;
+    m_desktopOwners = nullptr;
+    delete m_gstIndex;
+    m_gstIndex = nullptr;
+    m_gstVersions.clear();
+    g_clear_object(&m_appStreamPool);
+
     pkgCacheFile::Close();
 
     // Discard all errors to avoid a future failure when opening
@@ -261,6 +407,480 @@ void AptCacheFile::buildPkgRecords()
     m_packageRecords = new pkgRecords(*this);
 }
 
+void AptCacheFile::buildNameIndex()
+{
+    if (!m_namePkgs.empty()) {
+        return;
+    }
+
+    pkgCache *cache = GetPkgCache();
+    m_names.reserve(cache->HeaderP->PackageCount * 16);
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        m_nameOffsets.push_back(m_names.size());
+        m_namePkgs.push_back(pkg);
+        for (const char *c = pkg.Name(); *c != '\0'; c++) {
+            m_names.push_back(g_ascii_tolower(*c));
+        }
+        m_names.push_back('\n');
+    }
+}
+
+std::vector<pkgCache::PkgIterator> AptCacheFile::searchNames(const std::vector<std::string> &queries)
+{
+    std::vector<pkgCache::PkgIterator> output;
+
+    buildNameIndex();
+
+    // scan the whole arena once per query instead of every name, a match
+    // can't span two names as no query contains the separator
+    std::vector<bool> matched(m_namePkgs.size(), false);
+    for (const std::string &query : queries) {
+        if (query.empty()) {
+            std::fill(matched.begin(), matched.end(), true);
+            break;
+        }
+
+        g_autofree gchar *needle = g_ascii_strdown(query.c_str(), query.size());
+        const char *start = m_names.data();
+        const char *end = start + m_names.size();
+        const char *pos = start;
+        while (pos < end) {
+            const char *hit = static_cast<const char *>(memmem(pos, end - pos, needle, query.size()));
+            if (hit == nullptr) {
+                break;
+            }
+
+            // find the name the match is in and continue after it
+            size_t offset = hit - start;
+            auto it = std::upper_bound(m_nameOffsets.begin(), m_nameOffsets.end(), offset);
+            size_t index = (it - m_nameOffsets.begin()) - 1;
+            matched[index] = true;
+            pos = index + 1 < m_nameOffsets.size() ? start + m_nameOffsets[index + 1] : end;
+        }
+    }
+
+    for (size_t i = 0; i < matched.size(); i++) {
+        if (matched[i]) {
+            output.push_back(m_namePkgs[i]);
+        }
+    }
+    return output;
+}
+
+/**
+ * Returns where to keep a file built from the package cache, next to the
+ * cache itself, or an empty string if there is nowhere. The translated
+ * descriptions depend on the languages of the job, so they are part of
+ * the name.
+ */
+std::string AptCacheFile::getCacheFilename(const std::string &prefix, std::string &languages,
+                                           gint64 &cacheMtime)
+{
+    std::vector<std::string> langs = APT::Configuration::getLanguages();
+    std::string filename;
+    struct stat st;
+
+    languages.clear();
+    for (const std::string &lang : langs) {
+        if (!languages.empty()) {
+            languages.append(",");
+        }
+        languages.append(lang);
+    }
+
+    cacheMtime = 0;
+    std::string pkgcache = _config->FindFile("Dir::Cache::pkgcache");
+    if (!pkgcache.empty() && stat(pkgcache.c_str(), &st) == 0) {
+        filename = flNotFile(pkgcache) + prefix +
+                (langs.empty() ? "none" : langs[0]) + ".bin";
+        cacheMtime = (gint64) st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
+    }
+    return filename;
+}
+
+void AptCacheFile::buildDetailsIndex()
+{
+    if (m_detailsIndex != nullptr) {
+        return;
+    }
+
+    pkgCache *cache = GetPkgCache();
+    guint32 nPackages = cache->HeaderP->PackageCount;
+    std::string languages;
+    gint64 cacheMtime = 0;
+    std::string filename = getCacheFilename("packagekit-details-", languages, cacheMtime);
+
+    m_detailsIndex = new DetailsIndex();
+    if (!filename.empty() &&
+            m_detailsIndex->load(filename, cacheMtime, languages, nPackages)) {
+        return;
+    }
+
+    g_debug("building the details index for %s", languages.c_str());
+    for (pkgCache::PkgIterator pkg = cache->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        m_detailsIndex->add(pkg->ID, pkg.Name());
+        const pkgCache::VerIterator &ver = findVer(pkg);
+        if (ver.end() == false) {
+            m_detailsIndex->add(pkg->ID, getLongDescription(ver).c_str());
+        }
+    }
+    m_detailsIndex->save(filename, cacheMtime, languages, nPackages);
+}
+
+std::vector<pkgCache::PkgIterator> AptCacheFile::searchDetails(const std::vector<std::string> &queries)
+{
+    std::vector<pkgCache::PkgIterator> output;
+
+    buildDetailsIndex();
+    std::vector<bool> matched = m_detailsIndex->search(queries);
+    if (matched.empty()) {
+        return output;
+    }
+
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        if (pkg->ID < matched.size() && matched[pkg->ID]) {
+            output.push_back(pkg);
+        }
+    }
+    return output;
+}
+
+void AptCacheFile::buildGroupIndex()
+{
+    if (!m_groupPkgs.empty()) {
+        return;
+    }
+
+    // the sections are pooled strings, so each is only mapped once
+    std::unordered_map<const char *, PkGroupEnum> sectionGroups;
+    m_groupPkgs.resize(PK_GROUP_ENUM_LAST);
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        // Ignore virtual packages
+        if (findVer(pkg).end()) {
+            continue;
+        }
+
+        const char *section = pkg.VersionList().Section();
+        auto it = sectionGroups.find(section);
+        if (it == sectionGroups.end()) {
+            string str = section == NULL ? "" : section;
+            str = str.substr(str.find_last_of("/") + 1);
+            it = sectionGroups.emplace(section, get_enum_group(str)).first;
+        }
+        m_groupPkgs[it->second].push_back(pkg->ID);
+    }
+}
+
+std::vector<pkgCache::PkgIterator> AptCacheFile::packagesInGroups(const std::vector<PkGroupEnum> &groups)
+{
+    std::vector<guint32> ids;
+    std::vector<pkgCache::PkgIterator> output;
+
+    buildGroupIndex();
+    std::vector<bool> wanted(PK_GROUP_ENUM_LAST, false);
+    for (PkGroupEnum group : groups) {
+        if (group >= PK_GROUP_ENUM_LAST || wanted[group]) {
+            continue;
+        }
+        wanted[group] = true;
+        ids.insert(ids.end(), m_groupPkgs[group].begin(), m_groupPkgs[group].end());
+    }
+
+    // each package is in one group, only the order has to be restored
+    if (groups.size() > 1) {
+        std::sort(ids.begin(), ids.end());
+    }
+
+    pkgCache *cache = GetPkgCache();
+    output.reserve(ids.size());
+    for (guint32 id : ids) {
+        output.push_back(pkgCache::PkgIterator(*cache, cache->PkgP + id));
+    }
+    return output;
+}
+
+guint32 AptCacheFile::getVersionProperties(const pkgCache::VerIterator &ver, bool application)
+{
+    if (m_versionProperties.empty()) {
+        m_versionProperties.resize(GetPkgCache()->HeaderP->VersionCount, 0);
+        importVersionProperties();
+    }
+
+    guint32 &props = m_versionProperties[ver->ID];
+    if (!(props & VERSION_PROPERTIES_COMPUTED)) {
+        props |= computeVersionProperties(ver) | VERSION_PROPERTIES_COMPUTED;
+    }
+    if (application && !(props & VERSION_APPLICATION_COMPUTED)) {
+        if (ownsDesktopFile(ver)) {
+            props |= VersionApplication;
+        }
+        props |= VERSION_APPLICATION_COMPUTED;
+    }
+
+    guint32 ret = props & ~(VERSION_PROPERTIES_COMPUTED | VERSION_APPLICATION_COMPUTED);
+    const pkgCache::PkgIterator &pkg = ver.ParentPkg();
+    if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
+        ret |= VersionInstalled;
+    }
+    return ret;
+}
+
+static string versionKey(const pkgCache::PkgIterator &pkg, const char *verStr)
+{
+    string key = pkg.Name();
+    key.append(":");
+    key.append(pkg.Arch());
+    key.append(" ");
+    key.append(verStr);
+    return key;
+}
+
+void AptCacheFile::exportVersionProperties()
+{
+    if (m_versionProperties.empty() || m_status.empty()) {
+        return;
+    }
+
+    std::unordered_map<string, guint32> properties;
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            guint32 props = m_versionProperties[ver->ID];
+            if (props & VERSION_PROPERTIES_COMPUTED) {
+                properties[versionKey(pkg, ver.VerStr())] = props;
+            }
+        }
+    }
+
+    g_mutex_lock(&carriedMutex);
+    carriedProperties.swap(properties);
+    carriedStatus = std::move(m_status);
+    carriedListsMtime = m_listsMtime;
+    g_mutex_unlock(&carriedMutex);
+}
+
+void AptCacheFile::importVersionProperties()
+{
+    std::unordered_map<string, guint32> properties;
+    std::set<string> changed;
+
+    g_mutex_lock(&carriedMutex);
+    // the lists describe the versions, if they changed nothing is kept
+    if (carriedListsMtime == m_listsMtime && !m_status.empty()) {
+        properties.swap(carriedProperties);
+        m_status.changedSince(carriedStatus, changed);
+    }
+    carriedProperties.clear();
+    g_mutex_unlock(&carriedMutex);
+
+    if (properties.empty()) {
+        return;
+    }
+
+    // only what a package installs can change with its state, the
+    // rest comes from the version itself
+    guint kept = 0;
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            string key = versionKey(pkg, ver.VerStr());
+            auto it = properties.find(key);
+            if (it == properties.end()) {
+                continue;
+            }
+
+            // dpkg knows architecture independent packages as "all"
+            guint32 props = it->second;
+            string name = pkg.Name();
+            if (changed.count(name + ":" + pkg.Arch()) > 0 || changed.count(name + ":all") > 0) {
+                props &= ~(VersionApplication | VERSION_APPLICATION_COMPUTED);
+            }
+            m_versionProperties[ver->ID] = props;
+            kept++;
+        }
+    }
+    g_debug("kept the properties of %u versions, %u packages changed",
+            kept, (guint) changed.size());
+}
+
+guint32 AptCacheFile::computeVersionProperties(const pkgCache::VerIterator &ver)
+{
+    guint32 props = 0;
+    const pkgCache::PkgIterator &pkg = ver.ParentPkg();
+
+    if (strcmp(ver.Arch(), "all") == 0 ||
+            strcmp(ver.Arch(), _config->Find("APT::Architecture").c_str()) == 0) {
+        props |= VersionNativeArch;
+    }
+
+    std::string str = ver.Section() == NULL ? "" : ver.Section();
+    std::string section, component;
+    size_t found = str.find_last_of("/");
+    section = str.substr(found + 1);
+    if (found == str.npos) {
+        component = "main";
+    } else {
+        component = str.substr(0, found);
+    }
+
+    std::string pkgName = pkg.Name();
+    if (ends_with(pkgName, "-dev") ||
+            ends_with(pkgName, "-dbg") ||
+            section == "devel" ||
+            section == "libdevel") {
+        props |= VersionDevelopment;
+    }
+
+    if (section == "x11" || section == "gnome" ||
+            section == "kde" || section == "graphics") {
+        props |= VersionGui;
+    }
+
+    // Must be in main and universe to be free
+    if (component == "main" || component == "universe") {
+        props |= VersionFree;
+    }
+
+    std::string origin;
+    pkgCache::VerFileIterator vf = ver.FileList();
+    if (!vf.end() && vf.File().Origin() != NULL) {
+        origin = vf.File().Origin();
+    }
+    if (component.empty()) {
+        component = "main";
+    }
+    if ((origin == "Debian" || origin == "Ubuntu") &&
+            (component == "main" ||
+             component == "restricted" ||
+             component == "unstable" ||
+             component == "testing")) {
+        props |= VersionSupported;
+    }
+
+    return props;
+}
+
+bool AptCacheFile::ownsDesktopFile(const pkgCache::VerIterator &ver)
+{
+    std::string name = ver.ParentPkg().Name();
+
+    // one pass over the file index finds every application at once
+    if (m_desktopOwners == nullptr) {
+        m_desktopOwners = new std::set<std::string>();
+        DpkgFileIndex index(DPKG_INFO_DIR, DPKG_FILE_INDEX_FILENAME);
+        if (index.open()) {
+            index.findSuffix(".desktop", *m_desktopOwners);
+        } else {
+            delete m_desktopOwners;
+            m_desktopOwners = nullptr;
+        }
+    }
+    if (m_desktopOwners != nullptr) {
+        return m_desktopOwners->count(name + ":" + ver.Arch()) > 0 ||
+                m_desktopOwners->count(name) > 0;
+    }
+
+    // no index, read the list of the package
+    std::string fileName = std::string(DPKG_INFO_DIR "/") + name + ":" + ver.Arch() + ".list";
+    if (!FileExists(fileName)) {
+        // if the file was not found try without the arch field
+        fileName = std::string(DPKG_INFO_DIR "/") + name + ".list";
+    }
+
+    std::ifstream in(fileName.c_str());
+    std::string line;
+    while (std::getline(in, line)) {
+        if (ends_with(line, ".desktop")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AptCacheFile::buildGstIndex()
+{
+    if (m_gstIndex != nullptr) {
+        return;
+    }
+
+    m_gstIndex = new GstProvidesIndex();
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        // Ignore packages that exist only due to dependencies.
+        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
+            continue;
+        }
+
+        // Ignore debug packages - these aren't interesting as codec providers,
+        // but they do have apt GStreamer-* metadata.
+        if (ends_with (pkg.Name(), "-dbg") || ends_with (pkg.Name(), "-dbgsym")) {
+            continue;
+        }
+
+        // TODO search in updates packages
+        // Ignore virtual packages
+        pkgCache::VerIterator ver = findVer(pkg);
+        if (ver.end() == true) {
+            ver = findCandidateVer(pkg);
+        }
+        if (ver.end() == true) {
+            continue;
+        }
+
+        pkgRecords::Parser &rec = GetPkgRecords()->Lookup(ver.FileList());
+        const char *start, *stop;
+        rec.GetRec(start, stop);
+        std::string record(start, stop - start);
+        if (record.find("\nGstreamer-Version: ") == std::string::npos) {
+            continue;
+        }
+
+        m_gstIndex->add(m_gstVersions.size(), record, ver.Arch());
+        m_gstVersions.push_back(ver);
+    }
+    g_debug("%u packages have GStreamer capabilities", (guint) m_gstVersions.size());
+}
+
+std::vector<pkgCache::VerIterator> AptCacheFile::findGstProviders(const GstMatcher &matcher)
+{
+    std::vector<pkgCache::VerIterator> output;
+
+    buildGstIndex();
+    for (size_t id : m_gstIndex->find(matcher)) {
+        output.push_back(m_gstVersions[id]);
+    }
+    return output;
+}
+
+AsPool *AptCacheFile::getAppStreamPool()
+{
+    g_autoptr(GError) error = NULL;
+
+    if (m_appStreamPool != nullptr) {
+        return m_appStreamPool;
+    }
+
+    m_appStreamPool = as_pool_new();
+    as_pool_load(m_appStreamPool, NULL, &error);
+    if (error != NULL) {
+        /* we do not fail here because even with error we might still find metadata */
+        g_warning("Issue while loading the AppStream metadata pool: %s", error->message);
+    }
+    return m_appStreamPool;
+}
+
 bool AptCacheFile::isGarbage(const pkgCache::PkgIterator &pkg)
 {
     return (*this)[pkg].Garbage;
@@ -413,12 +1033,54 @@ pkgCache::VerIterator AptCacheFile::findCandidateVer(const pkgCache::PkgIterator
     return (*this)[pkg].CandidateVerIter(*this);
 }
 
+void AptCacheFile::loadSummaryCache(bool checkLanguages)
+{
+    std::string languages;
+    gint64 cacheMtime;
+
+    if (m_summaryCache != nullptr && !checkLanguages) {
+        return;
+    }
+
+    // the cache may be shared with a job in another language
+    std::string filename = getCacheFilename("packagekit-summaries-", languages, cacheMtime);
+    if (m_summaryCache != nullptr && languages == m_summaryLanguages) {
+        return;
+    }
+    saveSummaryCache();
+
+    m_summaryCache = new SummaryCache();
+    m_summaryFilename = filename;
+    m_summaryLanguages = languages;
+    m_summaryMtime = cacheMtime;
+    if (!filename.empty()) {
+        m_summaryCache->load(filename, cacheMtime, languages, GetPkgCache()->HeaderP->VersionCount);
+    }
+}
+
+void AptCacheFile::saveSummaryCache()
+{
+    if (m_summaryCache == nullptr) {
+        return;
+    }
+    m_summaryCache->save(m_summaryFilename, m_summaryMtime, m_summaryLanguages,
+                         GetPkgCache()->HeaderP->VersionCount);
+    delete m_summaryCache;
+    m_summaryCache = nullptr;
+}
+
 std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
 {
     if (ver.end() || ver.FileList().end() || GetPkgRecords() == 0) {
         return string();
     }
 
+    loadSummaryCache(false);
+    const char *summary = m_summaryCache->lookup(ver->ID);
+    if (summary != nullptr) {
+        return summary;
+    }
+
     pkgCache::DescIterator d = ver.TranslatedDescription();
     if (d.end()) {
         return string();
@@ -428,8 +1090,103 @@ std::string AptCacheFile::getShortDescription(const pkgCache::VerIterator &ver)
     if (df.end()) {
         return string();
     } else {
-        return m_packageRecords->Lookup(df).ShortDesc();
+        std::string shortDesc = m_packageRecords->Lookup(df).ShortDesc();
+        m_summaryCache->add(ver->ID, shortDesc);
+        return shortDesc;
+    }
+}
+
+void AptCacheFile::buildDescriptionCaches()
+{
+    std::vector<pkgCache::VerIterator> vers;
+
+    for (pkgCache::PkgIterator pkg = GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+        for (pkgCache::VerIterator ver = pkg.VersionList(); !ver.end(); ++ver) {
+            vers.push_back(ver);
+        }
     }
+    hydrateRecords(vers, false);
+    saveSummaryCache();
+
+    buildDetailsIndex();
+}
+
+void AptCacheFile::hydrateRecords(const std::vector<pkgCache::VerIterator> &vers, bool withDetails)
+{
+    struct Pending {
+        guint32 file;
+        guint64 offset;
+        pkgCache::VerIterator ver;
+        pkgCache::DescFileIterator df;
+        pkgCache::VerFileIterator vf;
+    };
+    std::vector<Pending> descs;
+    std::vector<Pending> files;
+
+    if (GetPkgRecords() == 0) {
+        return;
+    }
+    loadSummaryCache(true);
+
+    for (const pkgCache::VerIterator &ver : vers) {
+        if (ver.end() || ver.FileList().end()) {
+            continue;
+        }
+
+        if (withDetails && m_details.find(ver->ID) != m_details.end()) {
+            continue;
+        }
+        if (withDetails) {
+            pkgCache::VerFileIterator vf = ver.FileList();
+            files.push_back({vf.File()->ID, (guint64) vf->Offset, ver, pkgCache::DescFileIterator(), vf});
+            m_details[ver->ID] = DetailRecord();
+        } else if (m_summaryCache->lookup(ver->ID) != nullptr) {
+            continue;
+        }
+
+        pkgCache::DescIterator d = ver.TranslatedDescription();
+        if (d.end() || d.FileList().end()) {
+            continue;
+        }
+        pkgCache::DescFileIterator df = d.FileList();
+        descs.push_back({df.File()->ID, (guint64) df->Offset, ver, df, pkgCache::VerFileIterator()});
+    }
+
+    // a seek forward through each file rather than all over all of them
+    auto byLocation = [](const Pending &a, const Pending &b) {
+        return a.file != b.file ? a.file < b.file : a.offset < b.offset;
+    };
+    std::sort(descs.begin(), descs.end(), byLocation);
+    std::sort(files.begin(), files.end(), byLocation);
+
+    for (const Pending &pending : descs) {
+        pkgRecords::Parser &rec = m_packageRecords->Lookup(pending.df);
+        m_summaryCache->add(pending.ver->ID, rec.ShortDesc());
+        if (withDetails) {
+            m_details[pending.ver->ID].longDesc = rec.LongDesc();
+        }
+    }
+    for (const Pending &pending : files) {
+        m_details[pending.ver->ID].homepage = m_packageRecords->Lookup(pending.vf).Homepage();
+    }
+}
+
+void AptCacheFile::clearDetails()
+{
+    m_details.clear();
+}
+
+std::string AptCacheFile::getHomepage(const pkgCache::VerIterator &ver)
+{
+    if (ver.end() || ver.FileList().end() || GetPkgRecords() == 0) {
+        return string();
+    }
+
+    auto it = m_details.find(ver->ID);
+    if (it != m_details.end()) {
+        return it->second.homepage;
+    }
+    return m_packageRecords->Lookup(ver.FileList()).Homepage();
 }
 
 std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
@@ -438,6 +1195,11 @@ std::string AptCacheFile::getLongDescription(const pkgCache::VerIterator &ver)
         return string();
     }
 
+    auto it = m_details.find(ver->ID);
+    if (it != m_details.end()) {
+        return it->second.longDesc;
+    }
+
     pkgCache::DescIterator d = ver.TranslatedDescription();
     if (d.end()) {
         return string();
@@ -25,15 +25,58 @@
 #include <apt-pkg/cachefile.h>
 #include <apt-pkg/pkgrecords.h>
 #include <apt-pkg/progress.h>
+#include <appstream.h>
 #include <pk-backend.h>
 
+#include "dpkg-status.h"
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 class pkgProblemResolver;
+class DetailsIndex;
+class SummaryCache;
+class GstMatcher;
+class GstProvidesIndex;
 class AptCacheFile : public pkgCacheFile
 {
 public:
+    /**
+      * What the package filters look at
+      */
+    enum VersionProperty {
+        VersionNativeArch  = 1 << 0,
+        VersionDevelopment = 1 << 1,
+        VersionGui         = 1 << 2,
+        VersionFree        = 1 << 3,
+        VersionSupported   = 1 << 4,
+        VersionApplication = 1 << 5,
+        VersionInstalled   = 1 << 6
+    };
+
     AptCacheFile(PkBackendJob *job);
     ~AptCacheFile();
 
+    /**
+      * Returns the cache kept open for the read-only jobs with its marks
+      * reset, or nullptr if there is none or the package lists changed
+      */
+    static AptCacheFile *acquireShared(PkBackendJob *job);
+
+    /**
+      * Hands a cache to be kept open for the next read-only job, deleting
+      * it instead if it is out of date
+      */
+    static void releaseShared(AptCacheFile *cache);
+
+    /**
+      * Makes sure the next read-only job opens the cache again, call when
+      * the package database changes or the backend goes away
+      */
+    static void invalidateShared();
+
     /**
       * Inits the package cache returning false if it can't open
       */
@@ -83,6 +126,42 @@ public:
       */
     inline pkgDepCache* GetDepCache() { BuildCaches(); BuildPolicy(); BuildDepCache(); return DCache; }
 
+    /**
+     * Returns the real or provided packages whose name contains any of
+     * the queries ignoring case, in cache order
+     */
+    std::vector<pkgCache::PkgIterator> searchNames(const std::vector<std::string> &queries);
+
+    /**
+     * Returns the packages whose name or description contains all of the
+     * words of the queries ignoring case, in cache order
+     */
+    std::vector<pkgCache::PkgIterator> searchDetails(const std::vector<std::string> &queries);
+
+    /**
+     * Returns the packages whose section maps to any of @groups, in
+     * cache order
+     */
+    std::vector<pkgCache::PkgIterator> packagesInGroups(const std::vector<PkGroupEnum> &groups);
+
+    /**
+     * Returns the VersionProperty flags of the version, computed once per
+     * cache. @application says if VersionApplication is needed, as only
+     * that one needs the file lists
+     */
+    guint32 getVersionProperties(const pkgCache::VerIterator &ver, bool application);
+
+    /**
+     * Returns the versions that provide any of the GStreamer capabilities
+     * of @matcher, in cache order
+     */
+    std::vector<pkgCache::VerIterator> findGstProviders(const GstMatcher &matcher);
+
+    /**
+     * Returns the AppStream metadata, loaded once for the cache
+     */
+    AsPool *getAppStreamPool();
+
     /**
      * Checks if the package is garbage (not depended on)
      */
@@ -135,6 +214,26 @@ public:
      */
     std::string getLongDescriptionParsed(const pkgCache::VerIterator &ver);
 
+    /** \return the homepage of the given version, or an empty string
+     */
+    std::string getHomepage(const pkgCache::VerIterator &ver);
+
+    /**
+     * Reads the records of @vers ordered by where they are in the Packages
+     * and Translation files, rather than in the order they are emitted.
+     * The summaries are kept, and with @withDetails the long descriptions
+     * and homepages are too, until clearDetails().
+     */
+    void hydrateRecords(const std::vector<pkgCache::VerIterator> &vers, bool withDetails);
+    void clearDetails();
+
+    /**
+     * Reads the summaries of every version and the long descriptions for
+     * SearchDetails in the current languages, and saves them, so the first
+     * jobs after a refresh do not have to.
+     */
+    void buildDescriptionCaches();
+
     bool tryToInstall(pkgProblemResolver &Fix,
                       const pkgCache::VerIterator &ver,
                       bool BrokenFix, bool autoInst, bool preserveAuto);
@@ -144,10 +243,59 @@ public:
 
 private:
     void buildPkgRecords();
+    void buildNameIndex();
+    void buildDetailsIndex();
+    void buildGroupIndex();
+    void loadSummaryCache(bool checkLanguages);
+    void saveSummaryCache();
+    std::string getCacheFilename(const std::string &prefix, std::string &languages,
+                                 gint64 &cacheMtime);
+    void buildGstIndex();
+    guint32 computeVersionProperties(const pkgCache::VerIterator &ver);
+    bool ownsDesktopFile(const pkgCache::VerIterator &ver);
+    void exportVersionProperties();
+    void importVersionProperties();
+    bool isCurrent() const;
     static std::string debParser(std::string descr);
 
     pkgRecords *m_packageRecords;
     PkBackendJob *m_job;
+    guint m_generation;
+    time_t m_listsMtime;
+
+    // the dpkg status the cache was opened from
+    DpkgStatusSnapshot m_status;
+
+    // lowercased names each followed by a newline, and where they start
+    std::string m_names;
+    std::vector<size_t> m_nameOffsets;
+    std::vector<pkgCache::PkgIterator> m_namePkgs;
+
+    DetailsIndex *m_detailsIndex;
+
+    // the package IDs of each PkGroupEnum, in cache order
+    std::vector<std::vector<guint32>> m_groupPkgs;
+
+    // the summaries, and what hydrateRecords() read for the details
+    SummaryCache *m_summaryCache;
+    std::string m_summaryFilename;
+    std::string m_summaryLanguages;
+    gint64 m_summaryMtime;
+    struct DetailRecord {
+        std::string longDesc;
+        std::string homepage;
+    };
+    std::unordered_map<guint32, DetailRecord> m_details;
+
+    // the properties by version ID, and who has a .desktop file
+    std::vector<guint32> m_versionProperties;
+    std::set<std::string> *m_desktopOwners;
+
+    // the versions with GStreamer capabilities, by their ID in the index
+    GstProvidesIndex *m_gstIndex;
+    std::vector<pkgCache::VerIterator> m_gstVersions;
+
+    AsPool *m_appStreamPool;
 };
 
 /**
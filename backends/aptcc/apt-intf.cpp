@@ -29,7 +29,9 @@
 #include <apt-pkg/error.h>
 #include <apt-pkg/fileutl.h>
 #include <apt-pkg/install-progress.h>
+#include <apt-pkg/netrc.h>
 #include <apt-pkg/sourcelist.h>
+#include <apt-pkg/strutl.h>
 #include <apt-pkg/update.h>
 #include <apt-pkg/algorithms.h>
 #include <apt-pkg/pkgsystem.h>
@@ -43,8 +45,11 @@
 #include <sys/fcntl.h>
 #include <pty.h>
 
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <fstream>
 #include <dirent.h>
 
@@ -54,17 +59,28 @@
 #include "apt-messages.h"
 #include "acqpkitstatus.h"
 #include "deb-file.h"
+#include "dpkg-file-index.h"
 
 using namespace APT;
 
 #define RAMFS_MAGIC     0x858458f6
 
+// changelogs are not downloaded with less time than this left before the
+// deadline of the client
+#define CHANGELOG_FETCH_BUDGET_MS 2000
+
 AptIntf::AptIntf(PkBackendJob *job) :
     m_cache(0),
+    m_sharedCache(false),
     m_job(job),
     m_cancel(false),
     m_lastSubProgress(0),
-    m_terminalTimeout(120)
+    m_lastProgressEmit(0),
+    m_pendingPercentage(-1),
+    m_pendingItemStatus(PK_STATUS_ENUM_UNKNOWN),
+    m_pendingItemPercentage(0),
+    m_terminalTimeout(120),
+    m_dlLimitSet(false)
 {
     m_cancel = false;
 }
@@ -93,6 +109,18 @@ bool AptIntf::init(gchar **localDebs)
         g_setenv("ftp_proxy", uri, TRUE);
     }
 
+    // cap the download speed of background transactions; the methods
+    // take this in KiB/s and get it from the config when they are started
+    guint64 rate = pk_backend_job_get_download_rate(m_job);
+    if (rate > 0) {
+        string limit = std::to_string(MAX(rate / 1024, 1));
+        m_dlLimitHttp = _config->Find("Acquire::http::Dl-Limit");
+        m_dlLimitHttps = _config->Find("Acquire::https::Dl-Limit");
+        m_dlLimitSet = true;
+        _config->Set("Acquire::http::Dl-Limit", limit);
+        _config->Set("Acquire::https::Dl-Limit", limit);
+    }
+
     // Check if we should open the Cache with lock
     bool withLock;
     bool AllowBroken = false;
@@ -121,38 +149,58 @@ bool AptIntf::init(gchar **localDebs)
         withLock = !simulate;
     }
 
-    // Create the AptCacheFile class to search for packages
-    m_cache = new AptCacheFile(m_job);
-    if (localDebs) {
-        PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
-        if (pk_bitfield_contain(flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED)) {
-            // We are NOT simulating and have untrusted packages
-            // fail the transaction.
-            pk_backend_job_error_code(m_job,
-                                  PK_ERROR_ENUM_CANNOT_INSTALL_REPO_UNSIGNED,
-                                  "Local packages cannot be authenticated");
-            return false;
-        }
-
-        for (guint i = 0; i < g_strv_length(localDebs); ++i)
-            markFileForInstall(localDebs[i]);
+    // Jobs that only read can keep the cache open for the next one, the
+    // marks they leave on the depcache are reset when it is reused
+    m_sharedCache = !withLock && !AllowBroken && localDebs == nullptr &&
+            !simulate && role != PK_ROLE_ENUM_REFRESH_CACHE;
+    if (m_sharedCache) {
+        m_cache = AptCacheFile::acquireShared(m_job);
     }
 
-    int timeout = 10;
-    // TODO test this
-    while (m_cache->Open(withLock) == false) {
-        if (withLock == false || (timeout <= 0)) {
-            show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
-            return false;
-        } else {
-            _error->Discard();
-            pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
-            sleep(1);
-            timeout--;
+    if (m_cache == nullptr) {
+        // Create the AptCacheFile class to search for packages
+        m_cache = new AptCacheFile(m_job);
+        if (localDebs) {
+            PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
+            if (pk_bitfield_contain(flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED)) {
+                // We are NOT simulating and have untrusted packages
+                // fail the transaction.
+                pk_backend_job_error_code(m_job,
+                                      PK_ERROR_ENUM_CANNOT_INSTALL_REPO_UNSIGNED,
+                                      "Local packages cannot be authenticated");
+                return false;
+            }
+
+            if (!checkLocalFiles(localDebs)) {
+                return false;
+            }
+            for (guint i = 0; i < g_strv_length(localDebs); ++i) {
+                if (!markFileForInstall(localDebs[i])) {
+                    pk_backend_job_error_code(m_job,
+                                              PK_ERROR_ENUM_INVALID_PACKAGE_FILE,
+                                              "Failed to add %s to the package list",
+                                              localDebs[i]);
+                    return false;
+                }
+            }
         }
 
-        // Close the cache if we are going to try again
-        m_cache->Close();
+        int timeout = 10;
+        // TODO test this
+        while (m_cache->Open(withLock) == false) {
+            if (withLock == false || (timeout <= 0)) {
+                show_errors(m_job, PK_ERROR_ENUM_CANNOT_GET_LOCK);
+                return false;
+            } else {
+                _error->Discard();
+                pk_backend_job_set_status(m_job, PK_STATUS_ENUM_WAITING_FOR_LOCK);
+                sleep(1);
+                timeout--;
+            }
+
+            // Close the cache if we are going to try again
+            m_cache->Close();
+        }
     }
 
     // default settings
@@ -174,7 +222,20 @@ bool AptIntf::init(gchar **localDebs)
 
 AptIntf::~AptIntf()
 {
-    delete m_cache;
+    if (m_sharedCache && m_cache != nullptr) {
+        AptCacheFile::releaseShared(m_cache);
+    } else if (m_cache != nullptr) {
+        delete m_cache;
+
+        // we might have changed the package database
+        AptCacheFile::invalidateShared();
+    }
+
+    // the config outlives us, don't cap the next transaction
+    if (m_dlLimitSet) {
+        _config->Set("Acquire::http::Dl-Limit", m_dlLimitHttp);
+        _config->Set("Acquire::https::Dl-Limit", m_dlLimitHttps);
+    }
 }
 
 void AptIntf::setEnvLocaleFromJob()
@@ -208,136 +269,74 @@ bool AptIntf::cancelled() const
     return m_cancel;
 }
 
-bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
+bool AptIntf::checkpoint(const char *where)
 {
-    if (filters != 0) {
-        const pkgCache::PkgIterator &pkg = ver.ParentPkg();
-        bool installed = false;
-
-        // Check if the package is installed
-        if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
-            installed = true;
-        }
-
-        // if we are on multiarch check also the arch filter
-        if (m_isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)/* && !installed*/) {
-            // don't emit the package if it does not match
-            // the native architecture
-            if (strcmp(ver.Arch(), "all") != 0 &&
-                    strcmp(ver.Arch(), _config->Find("APT::Architecture").c_str()) != 0) {
-                return false;
-            }
-        }
-
-        std::string str = ver.Section() == NULL ? "" : ver.Section();
-        std::string section, component;
-
-        size_t found;
-        found = str.find_last_of("/");
-        section = str.substr(found + 1);
-        if(found == str.npos) {
-            component = "main";
-        } else {
-            component = str.substr(0, found);
-        }
-
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_INSTALLED) && installed) {
-            return false;
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_INSTALLED) && !installed) {
-            return false;
-        }
-
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_DEVELOPMENT)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than devel
-            std::string pkgName = pkg.Name();
-            if (!ends_with(pkgName, "-dev") &&
-                    !ends_with(pkgName, "-dbg") &&
-                    section.compare("devel") &&
-                    section.compare("libdevel")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_DEVELOPMENT)) {
-            std::string pkgName = pkg.Name();
-            if (ends_with(pkgName, "-dev") ||
-                    ends_with(pkgName, "-dbg") ||
-                    !section.compare("devel") ||
-                    !section.compare("libdevel")) {
-                return false;
-            }
-        }
-
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_GUI)) {
-            // if ver.end() means unknow
-            // strcmp will be true when it's different than x11
-            if (section.compare("x11") && section.compare("gnome") &&
-                    section.compare("kde") && section.compare("graphics")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_GUI)) {
-            if (!section.compare("x11") || !section.compare("gnome") ||
-                    !section.compare("kde") || !section.compare("graphics")) {
-                return false;
-            }
-        }
+    return pk_backend_job_checkpoint(m_job, where) || m_cancel;
+}
 
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_FREE)) {
-            if (component.compare("main") != 0 &&
-                    component.compare("universe") != 0) {
-                // Must be in main and universe to be free
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_FREE)) {
-            if (component.compare("main") == 0 ||
-                    component.compare("universe") == 0) {
-                // Must not be in main or universe to be free
-                return false;
-            }
-        }
+// Adds a filter and its negation to the mask of properties to compare and
+// the value they have to have, returns false if they can't both be met
+static bool addFilterProperty(PkBitfield filters, PkFilterEnum filter, PkFilterEnum notFilter,
+                              guint32 property, guint32 &mask, guint32 &want)
+{
+    bool value;
+    if (pk_bitfield_contain(filters, filter)) {
+        value = true;
+    } else if (pk_bitfield_contain(filters, notFilter)) {
+        value = false;
+    } else {
+        return true;
+    }
 
-        // Check for supported packages
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_SUPPORTED)) {
-            if (!packageIsSupported(ver, component)) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_SUPPORTED)) {
-            if (packageIsSupported(ver, component)) {
-                return false;
-            }
-        }
+    if ((mask & property) && ((want & property) != 0) != value) {
+        return false;
+    }
+    mask |= property;
+    if (value) {
+        want |= property;
+    }
+    return true;
+}
 
-        // Check for applications, if they have files with .desktop
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || !isApplication(ver)) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION)) {
-            // We do not support checking if it is an Application
-            // if NOT installed
-            if (!installed || isApplication(ver)) {
-                return false;
-            }
-        }
+bool AptIntf::matchPackage(const pkgCache::VerIterator &ver, PkBitfield filters)
+{
+    if (filters == 0) {
+        return true;
+    }
 
-        // TODO test this one..
-#if 0
-        // I couldn'tfind any packages with the metapackages component, and I
-        // think the check is the wrong way around; PK_FILTER_ENUM_COLLECTIONS
-        // is for virtual group packages -- hughsie
-        if (pk_bitfield_contain(filters, PK_FILTER_ENUM_COLLECTIONS)) {
-            if (!component.compare("metapackages")) {
-                return false;
-            }
-        } else if (pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_COLLECTIONS)) {
-            if (component.compare("metapackages")) {
-                return false;
-            }
-        }
-#endif
+    // turn the filters into the properties to compare
+    guint32 mask = 0;
+    guint32 want = 0;
+    if (m_isMultiArch && pk_bitfield_contain(filters, PK_FILTER_ENUM_ARCH)) {
+        // don't emit the package if it does not match
+        // the native architecture
+        mask |= AptCacheFile::VersionNativeArch;
+        want |= AptCacheFile::VersionNativeArch;
+    }
+    bool application = pk_bitfield_contain(filters, PK_FILTER_ENUM_APPLICATION) ||
+            pk_bitfield_contain(filters, PK_FILTER_ENUM_NOT_APPLICATION);
+    if (application) {
+        // We do not support checking if it is an Application
+        // if NOT installed
+        mask |= AptCacheFile::VersionInstalled;
+        want |= AptCacheFile::VersionInstalled;
+    }
+    if (!addFilterProperty(filters, PK_FILTER_ENUM_INSTALLED, PK_FILTER_ENUM_NOT_INSTALLED,
+                           AptCacheFile::VersionInstalled, mask, want) ||
+            !addFilterProperty(filters, PK_FILTER_ENUM_DEVELOPMENT, PK_FILTER_ENUM_NOT_DEVELOPMENT,
+                               AptCacheFile::VersionDevelopment, mask, want) ||
+            !addFilterProperty(filters, PK_FILTER_ENUM_GUI, PK_FILTER_ENUM_NOT_GUI,
+                               AptCacheFile::VersionGui, mask, want) ||
+            !addFilterProperty(filters, PK_FILTER_ENUM_FREE, PK_FILTER_ENUM_NOT_FREE,
+                               AptCacheFile::VersionFree, mask, want) ||
+            !addFilterProperty(filters, PK_FILTER_ENUM_SUPPORTED, PK_FILTER_ENUM_NOT_SUPPORTED,
+                               AptCacheFile::VersionSupported, mask, want) ||
+            !addFilterProperty(filters, PK_FILTER_ENUM_APPLICATION, PK_FILTER_ENUM_NOT_APPLICATION,
+                               AptCacheFile::VersionApplication, mask, want)) {
+        return false;
     }
-    return true;
+
+    return (m_cache->getVersionProperties(ver, application) & mask) == want;
 }
 
 PkgList AptIntf::filterPackages(const PkgList &packages, PkBitfield filters)
@@ -413,6 +412,15 @@ PkgList AptIntf::filterPackages(const PkgList &packages, PkBitfield filters)
     }
 }
 
+string AptIntf::getSummary(const pkgCache::VerIterator &ver)
+{
+    // the summary needs a pkgRecords lookup, skip it if it is not sent
+    if (!pk_backend_job_wants_field(m_job, "summary")) {
+        return string();
+    }
+    return m_cache->getShortDescription(ver);
+}
+
 // used to emit packages it collects all the needed info
 void AptIntf::emitPackage(const pkgCache::VerIterator &ver, PkInfoEnum state)
 {
@@ -433,10 +441,39 @@ void AptIntf::emitPackage(const pkgCache::VerIterator &ver, PkInfoEnum state)
     pk_backend_job_package(m_job,
                            state,
                            package_id,
-                           m_cache->getShortDescription(ver).c_str());
+                           getSummary(ver).c_str());
     g_free(package_id);
 }
 
+PkPackage *AptIntf::buildPackage(const pkgCache::VerIterator &ver, PkInfoEnum state)
+{
+    if (state == PK_INFO_ENUM_UNKNOWN) {
+        const pkgCache::PkgIterator &pkg = ver.ParentPkg();
+
+        if (pkg->CurrentState == pkgCache::State::Installed &&
+                pkg.CurrentVer() == ver) {
+            state = PK_INFO_ENUM_INSTALLED;
+        } else {
+            state = PK_INFO_ENUM_AVAILABLE;
+        }
+    }
+
+    g_autofree gchar *package_id = utilBuildPackageId(ver);
+    g_autoptr(GError) error = NULL;
+    PkPackage *item = pk_package_new_full(state,
+                                          package_id,
+                                          getSummary(ver).c_str(),
+                                          PK_INFO_ENUM_UNKNOWN,
+                                          PK_ROLE_ENUM_UNKNOWN,
+                                          NULL,
+                                          &error);
+    if (item == NULL) {
+        g_warning("package_id %s invalid and cannot be processed: %s",
+                  package_id, error->message);
+    }
+    return item;
+}
+
 void AptIntf::emitPackageProgress(const pkgCache::VerIterator &ver, PkStatusEnum status, uint percentage)
 {
     gchar *package_id;
@@ -445,22 +482,93 @@ void AptIntf::emitPackageProgress(const pkgCache::VerIterator &ver, PkStatusEnum
     g_free(package_id);
 }
 
+void AptIntf::emitPackageBytes(const pkgCache::VerIterator &ver, guint64 done, guint64 total)
+{
+    g_autofree gchar *package_id = utilBuildPackageId(ver);
+    pk_backend_job_set_item_bytes(m_job, package_id, done, total);
+}
+
 void AptIntf::emitPackages(PkgList &output, PkBitfield filters, PkInfoEnum state)
 {
-    // Sort so we can remove the duplicated entries
-    output.sort();
+    PkgEmitter emitter(this, filters, state);
+    for (const pkgCache::VerIterator &verIt : output) {
+        emitter.push_back(verIt);
+    }
+    emitter.finish();
+}
 
-    // Remove the duplicated entries
-    output.removeDuplicates();
+PkgEmitter::PkgEmitter(AptIntf *apt, PkBitfield filters, PkInfoEnum state) :
+    m_apt(apt),
+    m_filters(filters),
+    m_state(state),
+    m_seen((*apt->aptCacheFile())->Head().VersionCount, false),
+    m_downloaded(pk_bitfield_contain(filters, PK_FILTER_ENUM_DOWNLOADED))
+{
+    m_batch.reserve(BatchSize);
+}
 
-    output = filterPackages(output, filters);
-    for (const pkgCache::VerIterator &verIt : output) {
-        if (m_cancel) {
+PkgEmitter::~PkgEmitter()
+{
+    finish();
+}
+
+void PkgEmitter::push_back(const pkgCache::VerIterator &ver)
+{
+    if (ver.end() || m_seen[ver->ID] || full()) {
+        return;
+    }
+    m_seen[ver->ID] = true;
+
+    if (!m_apt->matchPackage(ver, m_filters)) {
+        return;
+    }
+
+    m_batch.push_back(ver);
+    if (!m_downloaded && m_batch.size() >= BatchSize) {
+        flush();
+    }
+}
+
+void PkgEmitter::flush()
+{
+    if (m_batch.empty()) {
+        return;
+    }
+
+    if (pk_backend_job_wants_field(m_apt->m_job, "summary")) {
+        m_apt->aptCacheFile()->hydrateRecords(m_batch, false);
+    }
+
+    // the batch crosses to the daemon thread as a single event
+    g_autoptr(GPtrArray) items = g_ptr_array_new_full(m_batch.size(), g_object_unref);
+    for (const pkgCache::VerIterator &verIt : m_batch) {
+        if (m_apt->cancelled()) {
             break;
         }
 
-        emitPackage(verIt, state);
+        PkPackage *item = m_apt->buildPackage(verIt, m_state);
+        if (item != NULL) {
+            g_ptr_array_add(items, item);
+        }
     }
+    pk_backend_job_packages(m_apt->m_job, items);
+    m_batch.clear();
+}
+
+bool PkgEmitter::full() const
+{
+    // the job drops what is past the requested page
+    return pk_backend_job_get_limit_reached(m_apt->m_job);
+}
+
+void PkgEmitter::finish()
+{
+    if (m_downloaded && !m_batch.empty()) {
+        // the other filters were already applied
+        m_batch = m_apt->filterPackages(m_batch,
+                                        pk_bitfield_value(PK_FILTER_ENUM_DOWNLOADED));
+    }
+    flush();
 }
 
 void AptIntf::emitRequireRestart(PkgList &output)
@@ -524,52 +632,16 @@ void AptIntf::emitUpdates(PkgList &output, PkBitfield filters)
 // search packages which provide a codec (specified in "values")
 void AptIntf::providesCodec(PkgList &output, gchar **values)
 {
-    string arch;
     GstMatcher matcher(values);
     if (!matcher.hasMatches()) {
         return;
     }
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
-        }
-
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // Ignore debug packages - these aren't interesting as codec providers,
-        // but they do have apt GStreamer-* metadata.
-        if (ends_with (pkg.Name(), "-dbg") || ends_with (pkg.Name(), "-dbgsym")) {
-            continue;
-        }
-
-        // TODO search in updates packages
-        // Ignore virtual packages
-        pkgCache::VerIterator ver = m_cache->findVer(pkg);
-        if (ver.end() == true) {
-            ver = m_cache->findCandidateVer(pkg);
-        }
-        if (ver.end() == true) {
-            continue;
-        }
-
-        arch = string(ver.Arch());
-
-        pkgCache::VerFileIterator vf = ver.FileList();
-        pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(vf);
-        const char *start, *stop;
-        rec.GetRec(start, stop);
-        string record(start, stop - start);
-        if (matcher.matches(record, arch)) {
-            output.push_back(ver);
-        }
+    for (const pkgCache::VerIterator &ver : m_cache->findGstProviders(matcher)) {
+        output.push_back(ver);
     }
 }
 
-// search packages which provide the libraries specified in "values"
 void AptIntf::providesLibrary(PkgList &output, gchar **values)
 {
     bool ret = false;
@@ -611,9 +683,17 @@ void AptIntf::providesLibrary(PkgList &output, gchar **values)
                 libPkgName.append (strvalue.substr (pos + 4));
             }
 
+            // Make everything lower-case
+            std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
+
             g_debug ("pkg-name: %s", libPkgName.c_str ());
 
-            for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
+            // the package is named after the library, look it up directly
+            pkgCache::GrpIterator grp = (*m_cache)->FindGrp(libPkgName);
+            if (grp.end()) {
+                continue;
+            }
+            for (pkgCache::PkgIterator pkg = grp.PackageList(); !pkg.end(); pkg = grp.NextPkg(pkg)) {
                 // Ignore packages that exist only due to dependencies.
                 if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
                     continue;
@@ -628,12 +708,7 @@ void AptIntf::providesLibrary(PkgList &output, gchar **values)
                     }
                 }
 
-                // Make everything lower-case
-                std::transform(libPkgName.begin(), libPkgName.end(), libPkgName.begin(), ::tolower);
-
-                if (g_strcmp0 (pkg.Name (), libPkgName.c_str ()) == 0) {
-                    output.push_back(ver);
-                }
+                output.push_back(ver);
             }
         } else {
             g_debug("libmatcher: Did not match: %s", value);
@@ -744,9 +819,6 @@ void AptIntf::emitPackageDetail(const pkgCache::VerIterator &ver)
     found = section.find_last_of("/");
     section = section.substr(found + 1);
 
-    pkgCache::VerFileIterator vf = ver.FileList();
-    pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(vf);
-
     long size;
     if (pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver) {
         // if the package is installed emit the installed size
@@ -757,13 +829,21 @@ void AptIntf::emitPackageDetail(const pkgCache::VerIterator &ver)
 
     gchar *package_id;
     package_id = utilBuildPackageId(ver);
+    string description;
+    if (pk_backend_job_wants_field(m_job, "description")) {
+        description = m_cache->getLongDescriptionParsed(ver);
+    }
+    string homepage;
+    if (pk_backend_job_wants_field(m_job, "url")) {
+        homepage = m_cache->getHomepage(ver);
+    }
     pk_backend_job_details(m_job,
                            package_id,
-                           m_cache->getShortDescription(ver).c_str(),
+                           getSummary(ver).c_str(),
                            "unknown",
                            get_enum_group(section),
-                           m_cache->getLongDescriptionParsed(ver).c_str(),
-                           rec.Homepage().c_str(),
+                           description.c_str(),
+                           homepage.c_str(),
                            size);
 
     g_free(package_id);
@@ -777,6 +857,12 @@ void AptIntf::emitDetails(PkgList &pkgs)
     // Remove the duplicated entries
     pkgs.removeDuplicates();
 
+    // the records are only read for the text fields
+    if (pk_backend_job_wants_field(m_job, "summary") ||
+            pk_backend_job_wants_field(m_job, "description") ||
+            pk_backend_job_wants_field(m_job, "url")) {
+        m_cache->hydrateRecords(pkgs, true);
+    }
     for (const pkgCache::VerIterator &verIt : pkgs) {
         if (m_cancel) {
             break;
@@ -784,10 +870,11 @@ void AptIntf::emitDetails(PkgList &pkgs)
 
         emitPackageDetail(verIt);
     }
+    m_cache->clearDetails();
 }
 
 // used to emit packages it collects all the needed info
-void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
+void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver, const ChangelogInfo &info)
 {
     // Verify if our update version is valid
     if (candver.end()) {
@@ -804,39 +891,11 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
     gchar *current_package_id = utilBuildPackageId(currver);
 
     pkgCache::VerFileIterator vf = candver.FileList();
-    string origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
-    pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(candver.FileList());
-
-    string changelog;
-    string update_text;
-    string updated;
-    string issued;
-    string srcpkg;
-    if (rec.SourcePkg().empty()) {
-        srcpkg = pkg.Name();
-    } else {
-        srcpkg = rec.SourcePkg();
-    }
 
-    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
-    if (pk_backend_is_online(backend)) {
-        // Create the download object
-        AcqPackageKitStatus Stat(this, m_job);
-
-        // get a fetcher
-        pkgAcquire fetcher;
-        fetcher.SetLog(&Stat);
-
-        // fetch the changelog
-        pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
-        changelog = fetchChangelogData(*m_cache,
-                                       fetcher,
-                                       candver,
-                                       currver,
-                                       &update_text,
-                                       &updated,
-                                       &issued);
-    }
+    const string &changelog = info.changelog;
+    const string &update_text = info.updateText;
+    string updated = info.updated;
+    const string &issued = info.issued;
 
     // Check if the update was updates since it was issued
     if (issued.compare(updated) == 0) {
@@ -908,14 +967,99 @@ void AptIntf::emitUpdateDetail(const pkgCache::VerIterator &candver)
     g_ptr_array_unref(cve_urls);
 }
 
+vector<ChangelogInfo> AptIntf::fetchChangelogs(const PkgList &pkgs)
+{
+    vector<ChangelogInfo> infos(pkgs.size());
+    vector<pkgAcqChangelog *> items(pkgs.size(), nullptr);
+    vector<string> srcpkgs(pkgs.size());
+    vector<string> cacheFiles(pkgs.size());
+    string cacheDir = _config->FindDir("Dir::Cache") + "packagekit-changelogs/";
+    PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(m_job));
+    bool online = pk_backend_is_online(backend);
+    bool queued = false;
+    gint64 budget = pk_backend_job_get_budget(m_job);
+    bool hurry = budget >= 0 && budget < CHANGELOG_FETCH_BUDGET_MS;
+
+    // Create the download object
+    AcqPackageKitStatus Stat(this, m_job);
+    pkgAcquire fetcher;
+    fetcher.SetLog(&Stat);
+
+    for (size_t i = 0; i < pkgs.size(); i++) {
+        const pkgCache::VerIterator &candver = pkgs[i];
+        if (candver.end()) {
+            continue;
+        }
+
+        const pkgCache::PkgIterator &pkg = candver.ParentPkg();
+        const pkgCache::VerIterator &currver = m_cache->findVer(pkg);
+        pkgRecords::Parser &rec = m_cache->GetPkgRecords()->Lookup(candver.FileList());
+        srcpkgs[i] = rec.SourcePkg().empty() ? pkg.Name() : rec.SourcePkg();
+
+        // a changelog only changes with the update and what it is parsed up to
+        cacheFiles[i] = cacheDir + srcpkgs[i] + "_" + candver.VerStr() + ".changelog";
+        if (loadChangelog(cacheFiles[i], currver.VerStr(), infos[i])) {
+            continue;
+        }
+
+        // only the cached ones are sent, the rest can be asked for again
+        if (online && hurry) {
+            pk_backend_job_set_partial(m_job);
+        } else if (online) {
+            items[i] = new pkgAcqChangelog(&fetcher, candver);
+            queued = true;
+        }
+    }
+
+    // fetch the changelogs, the fetcher pipelines them
+    if (queued) {
+        pk_backend_job_set_status(m_job, PK_STATUS_ENUM_DOWNLOAD_CHANGELOG);
+        fetcher.Run();
+    }
+
+    for (size_t i = 0; i < pkgs.size(); i++) {
+        if (checkpoint("aptcc:changelog-parse")) {
+            break;
+        }
+        if (items[i] == nullptr) {
+            continue;
+        }
+
+        if (items[i]->Status != pkgAcquire::Item::StatDone || !FileExists(items[i]->DestFile)) {
+            infos[i].changelog = "Changelog for this version is not yet available";
+            continue;
+        }
+
+        const pkgCache::VerIterator &currver = m_cache->findVer(pkgs[i].ParentPkg());
+        parseChangelog(items[i]->DestFile, srcpkgs[i], currver, infos[i]);
+        saveChangelog(cacheFiles[i], currver.VerStr(), infos[i]);
+    }
+
+    // one failed changelog must not fail the others
+    _error->Discard();
+    return infos;
+}
+
 void AptIntf::emitUpdateDetails(const PkgList &pkgs)
 {
-    for (const pkgCache::VerIterator &verIt : pkgs) {
+    vector<ChangelogInfo> infos(pkgs.size());
+
+    // everything but the obsoletes, restart and state comes from the changelog
+    if (pk_backend_job_wants_field(m_job, "changelog") ||
+            pk_backend_job_wants_field(m_job, "update-text") ||
+            pk_backend_job_wants_field(m_job, "bugzilla-urls") ||
+            pk_backend_job_wants_field(m_job, "cve-urls") ||
+            pk_backend_job_wants_field(m_job, "issued") ||
+            pk_backend_job_wants_field(m_job, "updated")) {
+        infos = fetchChangelogs(pkgs);
+    }
+
+    for (size_t i = 0; i < pkgs.size(); i++) {
         if (m_cancel) {
             break;
         }
 
-        emitUpdateDetail(verIt);
+        emitUpdateDetail(pkgs[i], infos[i]);
     }
 }
 
@@ -952,76 +1096,158 @@ void AptIntf::getRequires(PkgList &output,
                           const pkgCache::VerIterator &ver,
                           bool recursive)
 {
-    for (pkgCache::PkgIterator parentPkg = m_cache->GetPkgCache()->PkgBegin(); !parentPkg.end(); ++parentPkg) {
-        if (m_cancel) {
-            break;
+    // The cache already lists the dependencies pointing at each package, so
+    // follow those rather than the depends of every package in the cache.
+    // seen is by package, so each level of a recursive walk is only done once.
+    std::vector<bool> seen(m_cache->GetPkgCache()->HeaderP->PackageCount, false);
+    std::deque<pkgCache::VerIterator> pending;
+
+    if (recursive) {
+        for (const pkgCache::VerIterator &outputVer : output) {
+            seen[outputVer.ParentPkg()->ID] = true;
         }
+    }
 
-        // Ignore packages that exist only due to dependencies.
-        if (parentPkg.VersionList().end() && parentPkg.ProvidesList().end()) {
+    pending.push_back(ver);
+    while (!pending.empty() && !m_cancel) {
+        const pkgCache::VerIterator cur = pending.front();
+        pending.pop_front();
+
+        // depends only resolve to the version findVer() picks
+        if (m_cache->findVer(cur.ParentPkg()) != cur) {
             continue;
         }
 
-        // Don't insert virtual packages instead add what it provides
-        const pkgCache::VerIterator &parentVer = m_cache->findVer(parentPkg);
-        if (parentVer.end() == false) {
-            PkgList deps;
-            getDepends(deps, parentVer, false);
-            for (const pkgCache::VerIterator &depVer : deps) {
-                if (depVer == ver) {
-                    if (recursive) {
-                        if (!output.contains(parentPkg)) {
-                            output.push_back(parentVer);
-                            getRequires(output, parentVer, recursive);
-                        }
-                    } else {
-                        output.push_back(parentVer);
-                    }
-                    break;
+        // the package itself, and the virtual packages it provides
+        std::vector<pkgCache::PkgIterator> targets;
+        targets.push_back(cur.ParentPkg());
+        for (pkgCache::PrvIterator prv = cur.ProvidesList(); !prv.end(); ++prv) {
+            targets.push_back(prv.ParentPkg());
+        }
+
+        for (const pkgCache::PkgIterator &target : targets) {
+            for (pkgCache::DepIterator dep = target.RevDependsList(); !dep.end(); ++dep) {
+                if (dep->Type != pkgCache::Dep::Depends) {
+                    continue;
+                }
+
+                const pkgCache::VerIterator parentVer = dep.ParentVer();
+                const pkgCache::PkgIterator parentPkg = dep.ParentPkg();
+                if (seen[parentPkg->ID] || m_cache->findVer(parentPkg) != parentVer) {
+                    continue;
+                }
+                seen[parentPkg->ID] = true;
+                output.push_back(parentVer);
+                if (recursive) {
+                    pending.push_back(parentVer);
                 }
             }
         }
     }
 }
 
-PkgList AptIntf::getPackages()
+std::vector<pkgCache::PkgIterator> AptIntf::scanPackagesPrepare()
 {
-    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
+    std::vector<pkgCache::PkgIterator> packages;
 
-    PkgList output;
-    output.reserve(m_cache->GetPkgCache()->HeaderP->PackageCount);
+    // build everything the workers read from now, that is not thread safe
+    m_cache->GetDepCache();
+
+    packages.reserve(m_cache->GetPkgCache()->HeaderP->PackageCount);
     for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
-            break;
+        packages.push_back(pkg);
+    }
+    return packages;
+}
+
+void AptIntf::scanPackagesRun(size_t nChunks, const std::function<void(size_t chunk)> &func)
+{
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    auto worker = [&]() {
+        for (size_t chunk = next++; chunk < nChunks && !m_cancel; chunk = next++) {
+            func(chunk);
         }
+    };
 
+    // the calling thread works too, so small caches don't start threads
+    size_t nWorkers = std::min<size_t>(MIN(g_get_num_processors(), 8), nChunks);
+    for (size_t i = 1; i < nWorkers; i++) {
+        workers.push_back(std::thread(worker));
+    }
+    worker();
+    for (std::thread &thread : workers) {
+        thread.join();
+    }
+}
+
+void AptIntf::getPackages(PkgEmitter &output)
+{
+    pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
+
+    std::vector<PkgList> chunks = scanPackages<PkgList>([this](const pkgCache::PkgIterator &pkg, PkgList &chunk) {
         // Ignore packages that exist only due to dependencies.
         if(pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
+            return;
         }
 
         // Don't insert virtual packages as they don't have all kinds of info
         const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
         if (ver.end() == false) {
+            chunk.push_back(ver);
+        }
+    });
+
+    for (const PkgList &chunk : chunks) {
+        for (const pkgCache::VerIterator &ver : chunk) {
+            if (output.full()) {
+                return;
+            }
             output.push_back(ver);
         }
     }
-    return output;
 }
 
 PkgList AptIntf::getPackagesFromRepo(SourcesList::SourceRecord *&rec)
 {
     pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
 
+    // match the repo against each package file once rather than
+    // against the file of each package
+    std::vector<bool> fromRepo(m_cache->GetPkgCache()->HeaderP->PackageFileCount, false);
+    bool any = false;
+    for (pkgCache::PkgFileIterator file = m_cache->GetPkgCache()->FileBegin(); !file.end(); ++file) {
+        // Distro name
+        if (file.Archive() == NULL || rec->Dist.compare(file.Archive()) != 0) {
+            continue;
+        }
+
+        // Section part
+        if (file.Component() == NULL || !rec->hasSection(file.Component())) {
+            continue;
+        }
+
+        // Check if the site the package comes from is include in the Repo uri
+        if (file.Site() == NULL || rec->URI.find(file.Site()) == std::string::npos) {
+            continue;
+        }
+
+        fromRepo[file->ID] = true;
+        any = true;
+    }
+
     PkgList output;
-    output.reserve(m_cache->GetPkgCache()->HeaderP->PackageCount);
+    if (!any) {
+        return output;
+    }
+
     for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
         if (m_cancel) {
             break;
         }
 
-        // Ignore packages that exist only due to dependencies.
-        if(pkg.VersionList().end() && pkg.ProvidesList().end()) {
+        // only installed packages matters
+        if (pkg->CurrentState != pkgCache::State::Installed || pkg.CurrentVer().end()) {
             continue;
         }
 
@@ -1031,24 +1257,12 @@ PkgList AptIntf::getPackagesFromRepo(SourcesList::SourceRecord *&rec)
             continue;
         }
 
-        // only installed packages matters
-        if (!(pkg->CurrentState == pkgCache::State::Installed && pkg.CurrentVer() == ver)) {
+        if (pkg.CurrentVer() != ver) {
             continue;
         }
 
-        // Distro name
         pkgCache::VerFileIterator vf = ver.FileList();
-        if (vf.File().Archive() == NULL || rec->Dist.compare(vf.File().Archive()) != 0){
-            continue;
-        }
-
-        // Section part
-        if (vf.File().Component() == NULL || !rec->hasSection(vf.File().Component())) {
-            continue;
-        }
-
-        // Check if the site the package comes from is include in the Repo uri
-        if (vf.File().Site() == NULL || rec->URI.find(vf.File().Site()) == std::string::npos) {
+        if (vf.end() || !fromRepo[vf.File()->ID]) {
             continue;
         }
 
@@ -1057,11 +1271,10 @@ PkgList AptIntf::getPackagesFromRepo(SourcesList::SourceRecord *&rec)
     return output;
 }
 
-PkgList AptIntf::getPackagesFromGroup(gchar **values)
+void AptIntf::getPackagesFromGroup(PkgEmitter &output, gchar **values)
 {
     pk_backend_job_set_status(m_job, PK_STATUS_ENUM_QUERY);
 
-    PkgList output;
     vector<PkGroupEnum> groups;
 
     uint len = g_strv_length(values);
@@ -1070,7 +1283,7 @@ PkgList AptIntf::getPackagesFromGroup(gchar **values)
             pk_backend_job_error_code(m_job,
                                       PK_ERROR_ENUM_GROUP_NOT_FOUND,
                                       "An empty group was received");
-            return output;
+            return;
         } else {
             groups.push_back(pk_group_enum_from_string(values[i]));
         }
@@ -1078,111 +1291,53 @@ PkgList AptIntf::getPackagesFromGroup(gchar **values)
 
     pk_backend_job_set_allow_cancel(m_job, true);
 
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
+    for (const pkgCache::PkgIterator &pkg : m_cache->packagesInGroups(groups)) {
+        if (m_cancel || output.full()) {
             break;
         }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
-
-        // Ignore virtual packages
-        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-        if (ver.end() == false) {
-            string section = pkg.VersionList().Section() == NULL ? "" : pkg.VersionList().Section();
-
-            size_t found;
-            found = section.find_last_of("/");
-            section = section.substr(found + 1);
-
-            // Don't insert virtual packages instead add what it provides
-            for (PkGroupEnum group : groups) {
-                if (group == get_enum_group(section)) {
-                    output.push_back(ver);
-                    break;
-                }
-            }
-        }
-    }
-    return output;
-}
-
-bool AptIntf::matchesQueries(const vector<string> &queries, string s) {
-    for (string query : queries) {
-        // Case insensitive "string.contains"
-        auto it = std::search(
-            s.begin(), s.end(),
-            query.begin(), query.end(),
-            [](unsigned char ch1, unsigned char ch2) {
-                return std::tolower(ch1) == std::tolower(ch2);
-            }
-        );
 
-        if (it != s.end()) {
-            return true;
-        }
+        output.push_back(m_cache->findVer(pkg));
     }
-    return false;
 }
 
-PkgList AptIntf::searchPackageName(const vector<string> &queries)
+void AptIntf::searchPackageName(PkgEmitter &output, const vector<string> &queries)
 {
-    PkgList output;
-
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
+    for (const pkgCache::PkgIterator &pkg : m_cache->searchNames(queries)) {
+        if (m_cancel || output.full()) {
             break;
         }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
 
-        if (matchesQueries(queries, pkg.Name())) {
-            // Don't insert virtual packages instead add what it provides
-            const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-            if (ver.end() == false) {
-                output.push_back(ver);
-            } else {
-                // iterate over the provides list
-                for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
-                    const pkgCache::VerIterator &ownerVer = m_cache->findVer(Prv.OwnerPkg());
+        // Don't insert virtual packages instead add what it provides
+        const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
+        if (ver.end() == false) {
+            output.push_back(ver);
+        } else {
+            // iterate over the provides list
+            for (pkgCache::PrvIterator Prv = pkg.ProvidesList(); Prv.end() == false; ++Prv) {
+                const pkgCache::VerIterator &ownerVer = m_cache->findVer(Prv.OwnerPkg());
 
-                    // check to see if the provided package isn't virtual too
-                    if (ownerVer.end() == false) {
-                        // we add the package now because we will need to
-                        // remove duplicates later anyway
-                        output.push_back(ownerVer);
-                    }
+                // check to see if the provided package isn't virtual too
+                if (ownerVer.end() == false) {
+                    // the emitter drops the duplicates
+                    output.push_back(ownerVer);
                 }
             }
         }
     }
-    return output;
 }
 
-PkgList AptIntf::searchPackageDetails(const vector<string> &queries)
+void AptIntf::searchPackageDetails(PkgEmitter &output, const vector<string> &queries)
 {
-    PkgList output;
-
-    for (pkgCache::PkgIterator pkg = m_cache->GetPkgCache()->PkgBegin(); !pkg.end(); ++pkg) {
-        if (m_cancel) {
+    for (const pkgCache::PkgIterator &pkg : m_cache->searchDetails(queries)) {
+        if (m_cancel || output.full()) {
             break;
         }
-        // Ignore packages that exist only due to dependencies.
-        if (pkg.VersionList().end() && pkg.ProvidesList().end()) {
-            continue;
-        }
 
         const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
         if (ver.end() == false) {
-            if (matchesQueries(queries, pkg.Name()) ||
-                    matchesQueries(queries, (*m_cache).getLongDescription(ver))) {
-                // The package matched
-                output.push_back(ver);
-            }
-        } else if (matchesQueries(queries, pkg.Name())) {
+            // The package matched
+            output.push_back(ver);
+        } else {
             // The package is virtual and MATCHED the name
             // Don't insert virtual packages instead add what it provides
 
@@ -1192,86 +1347,100 @@ PkgList AptIntf::searchPackageDetails(const vector<string> &queries)
 
                 // check to see if the provided package isn't virtual too
                 if (ownerVer.end() == false) {
-                    // we add the package now because we will need to
-                    // remove duplicates later anyway
+                    // the emitter drops the duplicates
                     output.push_back(ownerVer);
                 }
             }
         }
     }
-    return output;
 }
 
 // used to return files it reads, using the info from the files in /var/lib/dpkg/info/
-PkgList AptIntf::searchPackageFiles(gchar **values)
+void AptIntf::searchPackageFiles(PkgEmitter &output, gchar **values)
 {
-    PkgList output;
     vector<string> packages;
-    string search;
-    regex_t re;
 
-    for (uint i = 0; i < g_strv_length(values); ++i) {
-        gchar *value = values[i];
-        if (strlen(value) < 1) {
-            continue;
+    // the index knows the files of every installed package, paths are
+    // matched exactly and anything else against the end of the path
+    DpkgFileIndex index(DPKG_INFO_DIR, DPKG_FILE_INDEX_FILENAME);
+    if (index.open()) {
+        std::set<string> owners;
+        for (uint i = 0; i < g_strv_length(values); ++i) {
+            const gchar *value = values[i];
+            if (value[0] == '/') {
+                index.findPath(value, owners);
+            } else if (value[0] != '\0') {
+                index.findName(value, owners);
+            }
         }
+        packages.assign(owners.begin(), owners.end());
+    } else {
+        string search;
+        regex_t re;
 
-        if (!search.empty()) {
-            search.append("|");
-        }
+        for (uint i = 0; i < g_strv_length(values); ++i) {
+            gchar *value = values[i];
+            if (strlen(value) < 1) {
+                continue;
+            }
 
-        if (value[0] == '/') {
-            search.append("^");
-            search.append(value);
-            search.append("$");
-        } else {
-            search.append(value);
-            search.append("$");
-        }
-    }
+            if (!search.empty()) {
+                search.append("|");
+            }
 
-    if(regcomp(&re, search.c_str(), REG_NOSUB) != 0) {
-        g_debug("Regex compilation error");
-        return output;
-    }
+            if (value[0] == '/') {
+                search.append("^");
+                search.append(value);
+                search.append("$");
+            } else {
+                search.append(value);
+                search.append("$");
+            }
+        }
 
-    DIR *dp;
-    struct dirent *dirp;
-    if (!(dp = opendir("/var/lib/dpkg/info/"))) {
-        g_debug ("Error opening /var/lib/dpkg/info/\n");
-        regfree(&re);
-        return output;
-    }
+        if(regcomp(&re, search.c_str(), REG_NOSUB) != 0) {
+            g_debug("Regex compilation error");
+            return;
+        }
 
-    string line;
-    while ((dirp = readdir(dp)) != NULL) {
-        if (m_cancel) {
-            break;
+        DIR *dp;
+        struct dirent *dirp;
+        if (!(dp = opendir("/var/lib/dpkg/info/"))) {
+            g_debug ("Error opening /var/lib/dpkg/info/\n");
+            regfree(&re);
+            return;
         }
 
-        if (ends_with(dirp->d_name, ".list")) {
-            string file(dirp->d_name);
-            string f = "/var/lib/dpkg/info/" + file;
-            ifstream in(f.c_str());
-            if (!in != 0) {
-                continue;
+        string line;
+        while ((dirp = readdir(dp)) != NULL) {
+            if (checkpoint("aptcc:dpkg-list-scan")) {
+                break;
             }
 
-            while (!in.eof()) {
-                getline(in, line);
-                if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
-                    packages.push_back(file.erase(file.size() - 5, file.size()));
-                    break;
+            if (ends_with(dirp->d_name, ".list")) {
+                string file(dirp->d_name);
+                string f = "/var/lib/dpkg/info/" + file;
+                ifstream in(f.c_str());
+                if (!in != 0) {
+                    continue;
+                }
+
+                while (!in.eof()) {
+                    getline(in, line);
+                    if (regexec(&re, line.c_str(), (size_t)0, NULL, 0) == 0) {
+                        packages.push_back(file.erase(file.size() - 5, file.size()));
+                        break;
+                    }
                 }
             }
         }
+        closedir(dp);
+        regfree(&re);
     }
-    closedir(dp);
-    regfree(&re);
 
     // Resolve the package names now
     for (const string &name : packages) {
-        if (m_cancel) {
+        if (m_cancel || output.full()) {
             break;
         }
 
@@ -1300,8 +1469,6 @@ PkgList AptIntf::searchPackageFiles(gchar **values)
         }
         output.push_back(ver);
     }
-
-    return output;
 }
 
 PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades, PkgList &installs, PkgList &removals, PkgList &obsoleted)
@@ -1315,34 +1482,43 @@ PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades, PkgList &inst
         return updates;
     }
 
-    for (pkgCache::PkgIterator pkg = (*m_cache)->PkgBegin(); !pkg.end(); ++pkg) {
+    // what each chunk of the cache adds to the lists
+    struct UpdateLists {
+        PkgList updates;
+        PkgList downgrades;
+        PkgList blocked;
+        PkgList installs;
+        PkgList removals;
+        PkgList obsoleted;
+    };
+    std::vector<UpdateLists> chunks = scanPackages<UpdateLists>([this](const pkgCache::PkgIterator &pkg, UpdateLists &lists) {
         const auto &state = (*m_cache)[pkg];
         if (pkg->SelectedState == pkgCache::State::Hold) {
             // We pretend held packages are not upgradable at all since we can't represent
             // the concept of holds in PackageKit.
             // https://github.com/PackageKit/PackageKit/issues/120
-            continue;
+            return;
         } else if (state.Upgrade() == true && state.NewInstall() == false) {
             const pkgCache::VerIterator &ver = m_cache->findCandidateVer(pkg);
             if (!ver.end()) {
-                updates.push_back(ver);
+                lists.updates.push_back(ver);
             }
         } else if (state.Downgrade() == true) {
             const pkgCache::VerIterator &ver = m_cache->findCandidateVer(pkg);
             if (!ver.end()) {
-                downgrades.push_back(ver);
+                lists.downgrades.push_back(ver);
             }
         } else if (state.Upgradable() == true &&
                    pkg->CurrentVer != 0 &&
                    state.Delete() == false) {
             const pkgCache::VerIterator &ver = m_cache->findCandidateVer(pkg);
             if (!ver.end()) {
-                blocked.push_back(ver);
+                lists.blocked.push_back(ver);
             }
         } else if (state.NewInstall()) {
             const pkgCache::VerIterator &ver = m_cache->findCandidateVer(pkg);
             if (!ver.end()) {
-                installs.push_back(ver);
+                lists.installs.push_back(ver);
             }
         } else if (state.Delete()) {
             const pkgCache::VerIterator &ver = m_cache->findCandidateVer(pkg);
@@ -1366,15 +1542,24 @@ PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades, PkgList &inst
                 if( is_obsoleted )
                 {
                     /* Obsoleted packages */
-                    obsoleted.push_back(ver);
+                    lists.obsoleted.push_back(ver);
                 }
                 else
                 {
                     /* Removed packages */
-                    removals.push_back(ver);
+                    lists.removals.push_back(ver);
                 }
             }
         }
+    });
+
+    for (const UpdateLists &lists : chunks) {
+        updates.insert(updates.end(), lists.updates.begin(), lists.updates.end());
+        downgrades.insert(downgrades.end(), lists.downgrades.begin(), lists.downgrades.end());
+        blocked.insert(blocked.end(), lists.blocked.begin(), lists.blocked.end());
+        installs.insert(installs.end(), lists.installs.begin(), lists.installs.end());
+        removals.insert(removals.end(), lists.removals.begin(), lists.removals.end());
+        obsoleted.insert(obsoleted.end(), lists.obsoleted.begin(), lists.obsoleted.end());
     }
 
     return updates;
@@ -1383,19 +1568,11 @@ PkgList AptIntf::getUpdates(PkgList &blocked, PkgList &downgrades, PkgList &inst
 // used to return files it reads, using the info from the files in /var/lib/dpkg/info/
 void AptIntf::providesMimeType(PkgList &output, gchar **values)
 {
-    g_autoptr(AsPool) pool = NULL;
-    g_autoptr(GError) error = NULL;
     guint i;
     vector<string> packages;
 
-    pool = as_pool_new ();
-    as_pool_load (pool, NULL, &error);
-    if (error != NULL) {
-        /* we do not fail here because even with error we might still find metadata */
-        g_warning ("Issue while loading the AppStream metadata pool: %s", error->message);
-        g_error_free (error);
-        error = NULL;
-    }
+    /* loaded once for as long as the cache is open */
+    AsPool *pool = m_cache->getAppStreamPool();
 
     for (i = 0; values[i] != NULL; i++) {
         g_autoptr(GPtrArray) result = NULL;
@@ -1437,42 +1614,6 @@ void AptIntf::providesMimeType(PkgList &output, gchar **values)
     }
 }
 
-bool AptIntf::isApplication(const pkgCache::VerIterator &ver)
-{
-    bool ret = false;
-    gchar *fileName;
-    string line;
-
-    fileName = g_strdup_printf("/var/lib/dpkg/info/%s:%s.list",
-                               ver.ParentPkg().Name(),
-                               ver.Arch());
-    if (!FileExists(fileName)) {
-        g_free(fileName);
-        // if the file was not found try without the arch field
-        fileName = g_strdup_printf("/var/lib/dpkg/info/%s.list",
-                                   ver.ParentPkg().Name());
-    }
-
-    if (FileExists(fileName)) {
-        ifstream in(fileName);
-        if (!in != 0) {
-            g_free(fileName);
-            return false;
-        }
-
-        while (in.eof() == false) {
-            getline(in, line);
-            if (ends_with(line, ".desktop")) {
-                ret = true;
-                break;
-            }
-        }
-    }
-
-    g_free(fileName);
-    return ret;
-}
-
 // used to emit files it reads the info directly from the files
 void AptIntf::emitPackageFiles(const gchar *pi)
 {
@@ -1544,38 +1685,6 @@ void AptIntf::emitPackageFilesLocal(const gchar *file)
 /**
   * Check if package is officially supported by the current distribution
   */
-bool AptIntf::packageIsSupported(const pkgCache::VerIterator &verIter, string component)
-{
-    string origin;
-    if (!verIter.end()) {
-        pkgCache::VerFileIterator vf = verIter.FileList();
-        origin = vf.File().Origin() == NULL ? "" : vf.File().Origin();
-    }
-
-    if (component.empty()) {
-        component = "main";
-    }
-
-    // Get a fetcher
-    AcqPackageKitStatus Stat(this, m_job);
-    pkgAcquire fetcher;
-    fetcher.SetLog(&Stat);
-
-    PkBitfield flags = pk_backend_job_get_transaction_flags(m_job);
-    bool trusted = checkTrusted(fetcher, flags);
-
-    if ((origin.compare("Debian") == 0) || (origin.compare("Ubuntu") == 0))  {
-        if ((component.compare("main") == 0 ||
-             component.compare("restricted") == 0 ||
-             component.compare("unstable") == 0 ||
-             component.compare("testing") == 0) && trusted) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
 bool AptIntf::checkTrusted(pkgAcquire &fetcher, PkBitfield flags)
 {
     string UntrustedList;
@@ -1620,6 +1729,88 @@ bool AptIntf::checkTrusted(pkgAcquire &fetcher, PkBitfield flags)
     }
 }
 
+/**
+ * fetchFromPeers - Put what the peers have in the partial directory
+ *
+ * The fetcher then resumes those files from the mirror, which finds them
+ * complete, and checks their hashes as for any other download.
+ */
+void AptIntf::fetchFromPeers(pkgAcquire &fetcher)
+{
+    for (pkgAcquire::ItemIterator I = fetcher.ItemsBegin(); I < fetcher.ItemsEnd() && !m_cancel; ++I) {
+        pkgAcqArchiveSane *archive = static_cast<pkgAcqArchiveSane*>(dynamic_cast<pkgAcqArchive*>(*I));
+        if (archive == nullptr || (*I)->Local || (*I)->Status != pkgAcquire::Item::StatIdle) {
+            continue;
+        }
+
+        // a partial download is resumed from the mirror
+        if (FileExists((*I)->DestFile)) {
+            continue;
+        }
+
+        g_autofree gchar *package_id = utilBuildPackageId(archive->version());
+        pk_backend_job_fetch_from_peers(m_job, package_id, (*I)->DestFile.c_str(),
+                                        archive->version()->Size);
+    }
+}
+
+/**
+ * needsCredentials - Whether the mirror wants a login or a client certificate
+ */
+static bool needsCredentials(const string &descUri)
+{
+    URI uri(descUri);
+    if (!uri.User.empty() || !uri.Password.empty()) {
+        return true;
+    }
+    if (_config->Exists("Acquire::https::SslCert") ||
+            _config->Exists("Acquire::https::" + uri.Host + "::SslCert")) {
+        return true;
+    }
+
+    vector<string> authConfs;
+    const string netrc = _config->FindFile("Dir::Etc::netrc");
+    if (!netrc.empty() && FileExists(netrc)) {
+        authConfs.push_back(netrc);
+    }
+    const string netrcParts = _config->FindDir("Dir::Etc::netrcparts");
+    if (!netrcParts.empty() && DirectoryExists(netrcParts)) {
+        for (const string &part : GetListOfFilesInDir(netrcParts, "conf", true, true)) {
+            authConfs.push_back(part);
+        }
+    }
+    for (const string &authConf : authConfs) {
+        FileFd fd(authConf, FileFd::ReadOnly);
+        URI probe(descUri);
+        if (fd.IsOpen() && MaybeAddAuthTo(probe, &fd) && !probe.User.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * shareWithPeers - Offer the verified downloads to the other hosts
+ */
+void AptIntf::shareWithPeers(pkgAcquire &fetcher)
+{
+    for (pkgAcquire::ItemIterator I = fetcher.ItemsBegin(); I < fetcher.ItemsEnd(); ++I) {
+        pkgAcqArchiveSane *archive = static_cast<pkgAcqArchiveSane*>(dynamic_cast<pkgAcqArchive*>(*I));
+        if (archive == nullptr || (*I)->Status != pkgAcquire::Item::StatDone ||
+                !FileExists((*I)->DestFile)) {
+            continue;
+        }
+
+        // the peers would get it without logging in
+        if (needsCredentials((*I)->DescURI())) {
+            continue;
+        }
+
+        g_autofree gchar *package_id = utilBuildPackageId(archive->version());
+        pk_backend_job_share_with_peers(m_job, package_id, (*I)->DestFile.c_str());
+    }
+}
+
 /**
  * checkChangedPackages - Check whas is goind to happen to the packages
  */
@@ -1719,69 +1910,255 @@ PkgList AptIntf::checkChangedPackages(bool emitChanged)
 
 pkgCache::VerIterator AptIntf::findTransactionPackage(const std::string &name)
 {
-    for (const pkgCache::VerIterator &verIt : m_pkgs) {
-        if (verIt.ParentPkg().Name() == name) {
-            return verIt;
-        }
+    auto it = m_transactionPkgs.find(name);
+    if (it != m_transactionPkgs.end()) {
+        return it->second;
     }
 
+    pkgCache::VerIterator ver;
     const pkgCache::PkgIterator &pkg = (*m_cache)->FindPkg(name);
     // Ignore packages that could not be found or that exist only due to dependencies.
-    if (pkg.end() == true ||
-            (pkg.VersionList().end() && pkg.ProvidesList().end())) {
-        return pkgCache::VerIterator();
+    if (pkg.end() == false &&
+            !(pkg.VersionList().end() && pkg.ProvidesList().end())) {
+        ver = m_cache->findVer(pkg);
+        // check to see if the provided package isn't virtual too,
+        // return the last try anyway
+        if (ver.end()) {
+            ver = m_cache->findCandidateVer(pkg);
+        }
     }
 
-    const pkgCache::VerIterator &ver = m_cache->findVer(pkg);
-    // check to see if the provided package isn't virtual too
-    if (ver.end() == false) {
-        return ver;
-    }
+    // dpkg names the same package on many lines
+    m_transactionPkgs.emplace(name, ver);
+    return ver;
+}
 
-    const pkgCache::VerIterator &candidateVer = m_cache->findCandidateVer(pkg);
+void AptIntf::queueItemProgress(const pkgCache::VerIterator &ver, PkStatusEnum status, uint percentage)
+{
+    // the progress of another package can't wait for the next interval
+    if (!m_pendingItem.end() && m_pendingItem != ver) {
+        flushProgress(true);
+    }
+    m_pendingItem = ver;
+    m_pendingItemStatus = status;
+    m_pendingItemPercentage = percentage;
+    flushProgress(false);
+}
+
+void AptIntf::flushProgress(bool force)
+{
+    gint64 now = g_get_monotonic_time();
+    if (!force && now - m_lastProgressEmit < ProgressInterval) {
+        return;
+    }
+    m_lastProgressEmit = now;
 
-    // Return the last try anyway
-    return candidateVer;
+    if (!m_pendingItem.end()) {
+        emitPackageProgress(m_pendingItem, m_pendingItemStatus, m_pendingItemPercentage);
+        m_pendingItem = pkgCache::VerIterator();
+    }
+    if (m_pendingPercentage >= 0) {
+        pk_backend_job_set_percentage(m_job, m_pendingPercentage);
+        m_pendingPercentage = -1;
+    }
 }
 
-void AptIntf::updateInterface(int fd, int writeFd)
+void AptIntf::handleStatusLine(char *line, int writeFd)
 {
-    char buf[2];
-    static char line[1024] = "";
+    gchar **split  = g_strsplit(line, ":",5);
 
-    while (1) {
-        // This algorithm should be improved (it's the same as the rpm one ;)
-        int len = read(fd, buf, 1);
+    // major problem here, we got unexpected input. should _never_ happen
+    if (g_strv_length(split) < 4) {
+        g_strfreev(split);
+        return;
+    }
 
-        // nothing was read
-        if(len < 1) {
-            break;
+    gchar *status  = g_strstrip(split[0]);
+    gchar *pkg     = g_strstrip(split[1]);
+    gchar *percent = g_strstrip(split[2]);
+    gchar *str     = g_strdup(g_strstrip(split[3]));
+
+    // Since PackageKit doesn't emulate finished anymore
+    // we need to manually do it here, as at this point
+    // dpkg doesn't process two packages at the same time
+    if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+        if (!ver.end()) {
+            emitPackage(ver, PK_INFO_ENUM_FINISHED);
         }
+        m_lastSubProgress = 0;
+    }
 
-        // update the time we last saw some action
-        m_lastTermAction = time(NULL);
+    // first check for errors and conf-file prompts
+    if (strstr(status, "pmerror") != NULL) {
+        // error from dpkg
+        pk_backend_job_error_code(m_job,
+                                  PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
+                                  "Error while installing package: %s",
+                                  str);
+    } else if (strstr(status, "pmconffile") != NULL) {
+        // conffile-request from dpkg, needs to be parsed different
+        int i = 0;
+        string orig_file, new_file;
+
+        // go to first ' and read until the end
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            /*nothing*/
+            ;
+        i++;
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            orig_file.append(1, str[i]);
+        i++;
+
+        // same for second ' and read until the end
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            /*nothing*/
+            ;
+        i++;
+        for(;str[i] != '\'' || str[i] == 0; i++)
+            new_file.append(1, str[i]);
+        i++;
+
+        gchar *filename;
+        filename = g_build_filename(DATADIR, "PackageKit", "helpers", "aptcc", "pkconffile", NULL);
+        gchar **argv;
+        gchar **envp;
+        GError *error = NULL;
+        argv = (gchar **) g_malloc(5 * sizeof(gchar *));
+        argv[0] = filename;
+        argv[1] = g_strdup(m_lastPackage.c_str());
+        argv[2] = g_strdup(orig_file.c_str());
+        argv[3] = g_strdup(new_file.c_str());
+        argv[4] = NULL;
 
-        if( buf[0] == '\n') {
-            if (m_cancel) {
-                kill(m_child_pid, SIGTERM);
+        const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
+        if ((m_interactive) && (socket != NULL)) {
+            envp = (gchar **) g_malloc(3 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
+            envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
+            envp[2] = NULL;
+        } else {
+            // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
+            envp = (gchar **) g_malloc(2 * sizeof(gchar *));
+            envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
+            envp[1] = NULL;
+        }
+
+        gboolean ret;
+        gint exitStatus;
+        ret = g_spawn_sync(NULL, // working dir
+                           argv, // argv
+                           envp, // envp
+                           G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
+                           NULL, // child_setup
+                           NULL, // user_data
+                           NULL, // standard_output
+                           NULL, // standard_error
+                           &exitStatus,
+                           &error);
+
+        int exit_code = WEXITSTATUS(exitStatus);
+        cout << filename << " " << exit_code << " ret: "<< ret << endl;
+
+        g_strfreev(argv);
+        g_strfreev(envp);
+
+        if (exit_code == 10) {
+            // 1 means the user wants the package config
+            if (write(writeFd, "Y\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
             }
-            //cout << "got line: " << line << endl;
-
-            gchar **split  = g_strsplit(line, ":",5);
-            gchar *status  = g_strstrip(split[0]);
-            gchar *pkg     = g_strstrip(split[1]);
-            gchar *percent = g_strstrip(split[2]);
-            gchar *str     = g_strdup(g_strstrip(split[3]));
-
-            // major problem here, we got unexpected input. should _never_ happen
-            if(!(pkg && status)) {
-                continue;
+        } else if (exit_code == 20) {
+            // 2 means the user wants to keep the current config
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
             }
-
-            // Since PackageKit doesn't emulate finished anymore
-            // we need to manually do it here, as at this point
-            // dpkg doesn't process two packages at the same time
-            if (!m_lastPackage.empty() && m_lastPackage.compare(pkg) != 0) {
+        } else {
+            // either the user didn't choose an option or the front end failed'
+            //                     pk_backend_job_message(m_job,
+            //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
+            //                                            "The configuration file '%s' "
+            //                                            "(modified by you or a script) "
+            //                                            "has a newer version '%s'.\n"
+            //                                            "Please verify your changes and update it manually.",
+            //                                            orig_file.c_str(),
+            //                                            new_file.c_str());
+            // fall back to keep the current config file
+            if (write(writeFd, "N\n", 2) != 2) {
+                // TODO we need a DPKG patch to use debconf
+                g_debug("Failed to write");
+            }
+        }
+    } else if (strstr(status, "pmstatus") != NULL) {
+        // INSTALL & UPDATE
+        // - Running dpkg
+        // loops ALL
+        // -  0 Installing pkg (sometimes this is skiped)
+        // - 25 Preparing pkg
+        // - 50 Unpacking pkg
+        // - 75 Preparing to configure pkg
+        //   ** Some pkgs have
+        //   - Running post-installation
+        //   - Running dpkg
+        // reloops all
+        // -   0 Configuring pkg
+        // - +25 Configuring pkg (SOMETIMES)
+        // - 100 Installed pkg
+        // after all
+        // - Running post-installation
+
+        // REMOVE
+        // - Running dpkg
+        // loops
+        // - 25  Removing pkg
+        // - 50  Preparing for removal of pkg
+        // - 75  Removing pkg
+        // - 100 Removed pkg
+        // after all
+        // - Running post-installation
+
+        // Let's start parsing the status:
+        if (starts_with(str, "Preparing to configure")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing to configure! " << line << endl;
+            // The next item might be Configuring so better it be 100
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                queueItemProgress(ver, PK_STATUS_ENUM_SETUP, 75);
+            }
+        } else if (starts_with(str, "Preparing for removal")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing for removal! " << line << endl;
+            m_lastSubProgress = 50;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                queueItemProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Preparing")) {
+            // Preparing to Install/configure
+            // cout << "Found Preparing! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_PREPARING);
+                queueItemProgress(ver, PK_STATUS_ENUM_SETUP, 25);
+            }
+        } else if (starts_with(str, "Unpacking")) {
+            // cout << "Found Unpacking! " << line << endl;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
+                queueItemProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
+            }
+        } else if (starts_with(str, "Configuring")) {
+            // Installing Package
+            // cout << "Found Configuring! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
                 const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
                 if (!ver.end()) {
                     emitPackage(ver, PK_INFO_ENUM_FINISHED);
@@ -1789,259 +2166,107 @@ void AptIntf::updateInterface(int fd, int writeFd)
                 m_lastSubProgress = 0;
             }
 
-            // first check for errors and conf-file prompts
-            if (strstr(status, "pmerror") != NULL) {
-                // error from dpkg
-                pk_backend_job_error_code(m_job,
-                                          PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
-                                          "Error while installing package: %s",
-                                          str);
-            } else if (strstr(status, "pmconffile") != NULL) {
-                // conffile-request from dpkg, needs to be parsed different
-                int i = 0;
-                string orig_file, new_file;
-
-                // go to first ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    orig_file.append(1, str[i]);
-                i++;
-
-                // same for second ' and read until the end
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    /*nothing*/
-                    ;
-                i++;
-                for(;str[i] != '\'' || str[i] == 0; i++)
-                    new_file.append(1, str[i]);
-                i++;
-
-                gchar *filename;
-                filename = g_build_filename(DATADIR, "PackageKit", "helpers", "aptcc", "pkconffile", NULL);
-                gchar **argv;
-                gchar **envp;
-                GError *error = NULL;
-                argv = (gchar **) g_malloc(5 * sizeof(gchar *));
-                argv[0] = filename;
-                argv[1] = g_strdup(m_lastPackage.c_str());
-                argv[2] = g_strdup(orig_file.c_str());
-                argv[3] = g_strdup(new_file.c_str());
-                argv[4] = NULL;
-
-                const gchar *socket = pk_backend_job_get_frontend_socket(m_job);
-                if ((m_interactive) && (socket != NULL)) {
-                    envp = (gchar **) g_malloc(3 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=passthrough");
-                    envp[1] = g_strdup_printf("DEBCONF_PIPE=%s", socket);
-                    envp[2] = NULL;
-                } else {
-                    // we don't have a socket set or are non-interactive. Use the noninteractive frontend.
-                    envp = (gchar **) g_malloc(2 * sizeof(gchar *));
-                    envp[0] = g_strdup("DEBIAN_FRONTEND=noninteractive");
-                    envp[1] = NULL;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                queueItemProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+            m_lastSubProgress += 25;
+        } else if (starts_with(str, "Running dpkg")) {
+            // cout << "Found Running dpkg! " << line << endl;
+        } else if (starts_with(str, "Running")) {
+            // cout << "Found Running! " << line << endl;
+            pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
+        } else if (starts_with(str, "Installing")) {
+            // cout << "Found Installing! " << line << endl;
+            // FINISH the last package
+            if (!m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-
-                gboolean ret;
-                gint exitStatus;
-                ret = g_spawn_sync(NULL, // working dir
-                                   argv, // argv
-                                   envp, // envp
-                                   G_SPAWN_LEAVE_DESCRIPTORS_OPEN,
-                                   NULL, // child_setup
-                                   NULL, // user_data
-                                   NULL, // standard_output
-                                   NULL, // standard_error
-                                   &exitStatus,
-                                   &error);
-
-                int exit_code = WEXITSTATUS(exitStatus);
-                cout << filename << " " << exit_code << " ret: "<< ret << endl;
-
-                g_strfreev(argv);
-                g_strfreev(envp);
-
-                if (exit_code == 10) {
-                    // 1 means the user wants the package config
-                    if (write(writeFd, "Y\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else if (exit_code == 20) {
-                    // 2 means the user wants to keep the current config
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
-                } else {
-                    // either the user didn't choose an option or the front end failed'
-                    //                     pk_backend_job_message(m_job,
-                    //                                            PK_MESSAGE_ENUM_CONFIG_FILES_CHANGED,
-                    //                                            "The configuration file '%s' "
-                    //                                            "(modified by you or a script) "
-                    //                                            "has a newer version '%s'.\n"
-                    //                                            "Please verify your changes and update it manually.",
-                    //                                            orig_file.c_str(),
-                    //                                            new_file.c_str());
-                    // fall back to keep the current config file
-                    if (write(writeFd, "N\n", 2) != 2) {
-                        // TODO we need a DPKG patch to use debconf
-                        g_debug("Failed to write");
-                    }
+            }
+            m_lastSubProgress = 0;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_INSTALLING);
+                queueItemProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Removing")) {
+            // cout << "Found Removing! " << line << endl;
+            if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
+                // cout << "FINISH the last package: " << m_lastPackage << endl;
+                const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
+                if (!ver.end()) {
+                    emitPackage(ver, PK_INFO_ENUM_FINISHED);
                 }
-            } else if (strstr(status, "pmstatus") != NULL) {
-                // INSTALL & UPDATE
-                // - Running dpkg
-                // loops ALL
-                // -  0 Installing pkg (sometimes this is skiped)
-                // - 25 Preparing pkg
-                // - 50 Unpacking pkg
-                // - 75 Preparing to configure pkg
-                //   ** Some pkgs have
-                //   - Running post-installation
-                //   - Running dpkg
-                // reloops all
-                // -   0 Configuring pkg
-                // - +25 Configuring pkg (SOMETIMES)
-                // - 100 Installed pkg
-                // after all
-                // - Running post-installation
-
-                // REMOVE
-                // - Running dpkg
-                // loops
-                // - 25  Removing pkg
-                // - 50  Preparing for removal of pkg
-                // - 75  Removing pkg
-                // - 100 Removed pkg
-                // after all
-                // - Running post-installation
-
-                // Let's start parsing the status:
-                if (starts_with(str, "Preparing to configure")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing to configure! " << line << endl;
-                    // The next item might be Configuring so better it be 100
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 75);
-                    }
-                } else if (starts_with(str, "Preparing for removal")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing for removal! " << line << endl;
-                    m_lastSubProgress = 50;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Preparing")) {
-                    // Preparing to Install/configure
-                    // cout << "Found Preparing! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_PREPARING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_SETUP, 25);
-                    }
-                } else if (starts_with(str, "Unpacking")) {
-                    // cout << "Found Unpacking! " << line << endl;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_DECOMPRESSING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, 50);
-                    }
-                } else if (starts_with(str, "Configuring")) {
-                    // Installing Package
-                    // cout << "Found Configuring! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                        m_lastSubProgress = 0;
-                    }
+            }
+            m_lastSubProgress += 25;
 
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                    m_lastSubProgress += 25;
-                } else if (starts_with(str, "Running dpkg")) {
-                    // cout << "Found Running dpkg! " << line << endl;
-                } else if (starts_with(str, "Running")) {
-                    // cout << "Found Running! " << line << endl;
-                    pk_backend_job_set_status (m_job, PK_STATUS_ENUM_COMMIT);
-                } else if (starts_with(str, "Installing")) {
-                    // cout << "Found Installing! " << line << endl;
-                    // FINISH the last package
-                    if (!m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress = 0;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_INSTALLING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_INSTALL, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Removing")) {
-                    // cout << "Found Removing! " << line << endl;
-                    if (m_lastSubProgress >= 100 && !m_lastPackage.empty()) {
-                        // cout << "FINISH the last package: " << m_lastPackage << endl;
-                        const pkgCache::VerIterator &ver = findTransactionPackage(m_lastPackage);
-                        if (!ver.end()) {
-                            emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        }
-                    }
-                    m_lastSubProgress += 25;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_REMOVING);
+                queueItemProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
+            }
+        } else if (starts_with(str, "Installed") ||
+                   starts_with(str, "Removed")) {
+            // cout << "Found FINISHED! " << line << endl;
+            m_lastSubProgress = 100;
+            const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
+            if (!ver.end()) {
+                emitPackage(ver, PK_INFO_ENUM_FINISHED);
+                //                         emitPackageProgress(ver, m_lastSubProgress);
+            }
+        } else {
+            cout << ">>>Unmaped value<<< :" << line << endl;
+        }
 
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_REMOVING);
-                        emitPackageProgress(ver, PK_STATUS_ENUM_REMOVE, m_lastSubProgress);
-                    }
-                } else if (starts_with(str, "Installed") ||
-                           starts_with(str, "Removed")) {
-                    // cout << "Found FINISHED! " << line << endl;
-                    m_lastSubProgress = 100;
-                    const pkgCache::VerIterator &ver = findTransactionPackage(pkg);
-                    if (!ver.end()) {
-                        emitPackage(ver, PK_INFO_ENUM_FINISHED);
-                        //                         emitPackageProgress(ver, m_lastSubProgress);
-                    }
-                } else {
-                    cout << ">>>Unmaped value<<< :" << line << endl;
-                }
+        if (!starts_with(str, "Running")) {
+            m_lastPackage = pkg;
+        }
+        m_startCounting = true;
+    } else {
+        m_startCounting = true;
+    }
 
-                if (!starts_with(str, "Running")) {
-                    m_lastPackage = pkg;
-                }
-                m_startCounting = true;
-            } else {
-                m_startCounting = true;
-            }
+    m_pendingPercentage = atoi(percent);
+    flushProgress(false);
+
+    // clean-up
+    g_strfreev(split);
+    g_free(str);
+}
 
-            int val = atoi(percent);
-            //cout << "progress: " << val << endl;
-            pk_backend_job_set_percentage(m_job, val);
+void AptIntf::updateInterface(int fd, int writeFd)
+{
+    char buf[4096];
 
-            // clean-up
-            g_strfreev(split);
-            g_free(str);
-            line[0] = 0;
-        } else {
-            buf[1] = 0;
-            strcat(line, buf);
+    while (1) {
+        int len = read(fd, buf, sizeof(buf));
+
+        // nothing was read
+        if(len < 1) {
+            break;
+        }
+
+        // update the time we last saw some action
+        m_lastTermAction = time(NULL);
+
+        // dpkg writes whole lines, but a read can still split one
+        m_statusLine.append(buf, len);
+        size_t begin = 0;
+        size_t end;
+        while ((end = m_statusLine.find('\n', begin)) != string::npos) {
+            if (m_cancel) {
+                kill(m_child_pid, SIGTERM);
+            }
+
+            m_statusLine[end] = '\0';
+            handleStatusLine(&m_statusLine[begin], writeFd);
+            begin = end + 1;
         }
+        m_statusLine.erase(0, begin);
     }
 
     time_t now = time(NULL);
@@ -2187,6 +2412,42 @@ bool AptIntf::markFileForInstall(std::string const &file)
     return m_cache->GetSourceList()->AddVolatileFile(file);
 }
 
+bool AptIntf::checkLocalFiles(gchar **localDebs)
+{
+    guint len = g_strv_length(localDebs);
+    std::vector<PkErrorEnum> codes(len, PK_ERROR_ENUM_UNKNOWN);
+    std::vector<string> errors(len);
+
+    // fills apt's architecture cache before the workers read it
+    APT::Configuration::getArchitectures();
+
+    // opening each archive and inflating its control member is the slow
+    // part, the files are independent so they are read in parallel
+    scanPackagesRun(len, [&](size_t i) {
+        _error->PushToStack();
+        DebFile deb(localDebs[i], false);
+        if (!deb.isValid()) {
+            codes[i] = PK_ERROR_ENUM_INVALID_PACKAGE_FILE;
+            errors[i] = "Not a valid package file";
+        } else if (!deb.check()) {
+            codes[i] = PK_ERROR_ENUM_INCOMPATIBLE_ARCHITECTURE;
+            errors[i] = deb.errorMsg();
+        }
+        _error->RevertToStack();
+    });
+    if (m_cancel) {
+        return false;
+    }
+
+    for (guint i = 0; i < len; i++) {
+        if (!errors[i].empty()) {
+            pk_backend_job_error_code(m_job, codes[i], "%s: %s", localDebs[i], errors[i].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
 PkgList AptIntf::resolveLocalFiles(gchar **localDebs)
 {
     PkgList ret;
@@ -2441,6 +2702,7 @@ bool AptIntf::installPackages(PkBitfield flags)
     }
 
     // Download and check if we can continue
+    fetchFromPeers(fetcher);
     if (fetcher.Run() != pkgAcquire::Continue
             && m_cancel == false) {
         // We failed and we did not cancel
@@ -2452,6 +2714,7 @@ bool AptIntf::installPackages(PkBitfield flags)
         cout << "PendingError download" << endl;
         return false;
     }
+    shareWithPeers(fetcher);
 
     // Download finished, check if we should proceed the install
     if (pk_bitfield_contain(flags, PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD)) {
@@ -2554,6 +2817,16 @@ bool AptIntf::installPackages(PkBitfield flags)
     m_lastTermAction = time(NULL);
     m_startCounting = false;
 
+    // dpkg only names packages, look them up once for the whole run
+    m_statusLine.clear();
+    m_transactionPkgs.clear();
+    for (const pkgCache::VerIterator &verIt : m_pkgs) {
+        m_transactionPkgs.emplace(verIt.ParentPkg().Name(), verIt);
+    }
+    m_lastProgressEmit = 0;
+    m_pendingPercentage = -1;
+    m_pendingItem = pkgCache::VerIterator();
+
     // Check if the child died
     int ret;
     char masterbuf[1024];
@@ -2562,6 +2835,7 @@ bool AptIntf::installPackages(PkBitfield flags)
         while(read(pty_master, masterbuf, sizeof(masterbuf)) > 0);
         updateInterface(readFromChildFD[0], pty_master);
     }
+    flushProgress(true);
 
     close(readFromChildFD[0]);
     close(readFromChildFD[1]);
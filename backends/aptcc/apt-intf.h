@@ -32,7 +32,12 @@
 
 #include <pk-backend.h>
 
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
 #include "pkg-list.h"
+#include "apt-utils.h"
 #include "apt-sourceslist.h"
 
 #define REBOOT_REQUIRED      "/var/run/reboot-required"
@@ -40,6 +45,7 @@
 class pkgProblemResolver;
 class Matcher;
 class AptCacheFile;
+class PkgEmitter;
 class AptIntf
 {
 public:
@@ -50,6 +56,12 @@ public:
     void cancel();
     bool cancelled() const;
 
+    /**
+     * Like cancelled(), for the loops that can run for long, and times how
+     * late the cancel request was noticed at @where
+     */
+    bool checkpoint(const char *where);
+
     /**
      * Tries to find a package with the given packageId
      * @returns pkgCache::VerIterator, if .end() is true the package could not be found
@@ -77,6 +89,13 @@ public:
       */
     bool markFileForInstall(std::string const &file);
 
+    /**
+      * Reads the control data of all the \sa localDebs at once and checks
+      * they can be installed here
+      * @returns false if one can't, the job error is set
+      */
+    bool checkLocalFiles(gchar **localDebs);
+
     /**
       * Marks the given packages as auto installed
       */
@@ -113,9 +132,9 @@ public:
                      bool recursive);
 
     /**
-      * Returns a list of all packages in the cache
+      * Adds all packages in the cache to @output
       */
-    PkgList getPackages();
+    void getPackages(PkgEmitter &output);
 
     /**
       * Returns a list of all packages in the cache
@@ -123,24 +142,24 @@ public:
     PkgList getPackagesFromRepo(SourcesList::SourceRecord *&);
 
     /**
-      * Returns a list of all packages in the given groups
+      * Adds all packages in the given groups to @output
       */
-    PkgList getPackagesFromGroup(gchar **values);
+    void getPackagesFromGroup(PkgEmitter &output, gchar **values);
 
     /**
-      * Returns a list of all packages that matched their names with matcher
+      * Adds all packages that matched their names with matcher to @output
       */
-    PkgList searchPackageName(const vector<string> &queries);
+    void searchPackageName(PkgEmitter &output, const vector<string> &queries);
 
     /**
-      * Returns a list of all packages that matched their description with matcher
+      * Adds all packages that matched their description with matcher to @output
       */
-    PkgList searchPackageDetails(const vector<string> &queries);
+    void searchPackageDetails(PkgEmitter &output, const vector<string> &queries);
 
     /**
-      * Returns a list of all packages that matched contains the given files
+      * Adds all packages that contain the given files to @output
       */
-    PkgList searchPackageFiles(gchar **values);
+    void searchPackageFiles(PkgEmitter &output, gchar **values);
 
     /**
       * Returns a list of all packages that can be updated
@@ -153,11 +172,21 @@ public:
      */
     void emitPackage(const pkgCache::VerIterator &ver, PkInfoEnum state = PK_INFO_ENUM_UNKNOWN);
 
+    /**
+     *  Builds the PkPackage emitPackage() would send, or NULL if the id is invalid
+     */
+    PkPackage *buildPackage(const pkgCache::VerIterator &ver, PkInfoEnum state = PK_INFO_ENUM_UNKNOWN);
+
     /**
      *  Emits a package with the given percentage
      */
     void emitPackageProgress(const pkgCache::VerIterator &ver, PkStatusEnum status, uint percentage);
 
+    /**
+     *  Emits how much of a package has been downloaded
+     */
+    void emitPackageBytes(const pkgCache::VerIterator &ver, guint64 done, guint64 total);
+
     /**
       * Emits a list of packages that matches the given filters
       */
@@ -188,6 +217,11 @@ public:
       */
     void emitPackageDetail(const pkgCache::VerIterator &ver);
 
+    /**
+      * Returns the summary, or an empty string if the client did not ask for it
+      */
+    std::string getSummary(const pkgCache::VerIterator &ver);
+
     /**
       * Emits details of the given package list
       */
@@ -196,7 +230,7 @@ public:
     /**
       * Emits update detail
       */
-    void emitUpdateDetail(const pkgCache::VerIterator &candver);
+    void emitUpdateDetail(const pkgCache::VerIterator &candver, const ChangelogInfo &info);
 
     /**
       * Emits update datails for the given list
@@ -242,20 +276,61 @@ public:
     AptCacheFile* aptCacheFile() const;
 
 private:
+    // sends its batches straight to m_job
+    friend class PkgEmitter;
+
+    /**
+     * Returns the changelogs of the updates, from the cache or downloaded
+     * all together in one run
+     */
+    vector<ChangelogInfo> fetchChangelogs(const PkgList &pkgs);
+
+    /**
+     * Runs @func over every package from a pool of threads. The packages
+     * are split in consecutive chunks which each have their own result,
+     * so the results are returned in cache order. @func must only read
+     * from the cache.
+     */
+    template<typename Result>
+    std::vector<Result> scanPackages(const std::function<void(const pkgCache::PkgIterator &pkg, Result &result)> &func)
+    {
+        const std::vector<pkgCache::PkgIterator> packages = scanPackagesPrepare();
+        std::vector<Result> results((packages.size() + ScanChunkSize - 1) / ScanChunkSize);
+        scanPackagesRun(results.size(), [&](size_t chunk) {
+            size_t end = std::min(packages.size(), (chunk + 1) * ScanChunkSize);
+            for (size_t i = chunk * ScanChunkSize; i < end && !m_cancel; i++) {
+                func(packages[i], results[chunk]);
+            }
+        });
+        return results;
+    }
+    std::vector<pkgCache::PkgIterator> scanPackagesPrepare();
+    void scanPackagesRun(size_t nChunks, const std::function<void(size_t chunk)> &func);
+    static const size_t ScanChunkSize = 4096;
+
     void setEnvLocaleFromJob();
     bool checkTrusted(pkgAcquire &fetcher, PkBitfield flags);
-    bool packageIsSupported(const pkgCache::VerIterator &verIter, string component);
-    bool isApplication(const pkgCache::VerIterator &verIter);
-    bool matchesQueries(const vector<string> &queries, string s);
+    void fetchFromPeers(pkgAcquire &fetcher);
+    void shareWithPeers(pkgAcquire &fetcher);
 
     /**
      *  interprets dpkg status fd
      */
     void updateInterface(int readFd, int writeFd);
+    void handleStatusLine(char *line, int writeFd);
     PkgList checkChangedPackages(bool emitChanged);
     pkgCache::VerIterator findTransactionPackage(const std::string &name);
 
+    /**
+     *  dpkg reports several steps per package, the percentage and the
+     *  item progress are only emitted every ProgressInterval
+     */
+    void queueItemProgress(const pkgCache::VerIterator &ver, PkStatusEnum status, uint percentage);
+    void flushProgress(bool force);
+    static const gint64 ProgressInterval = 100 * G_TIME_SPAN_MILLISECOND;
+
     AptCacheFile *m_cache;
+    bool       m_sharedCache;
     PkBackendJob  *m_job;
     bool       m_cancel;
     struct stat m_restartStat;
@@ -270,9 +345,67 @@ private:
     bool       m_startCounting;
     bool       m_interactive;
 
+    // the status-fd line being read and the packages it names
+    string     m_statusLine;
+    std::unordered_map<string, pkgCache::VerIterator> m_transactionPkgs;
+    gint64     m_lastProgressEmit;
+    int        m_pendingPercentage;
+    pkgCache::VerIterator m_pendingItem;
+    PkStatusEnum m_pendingItemStatus;
+    uint       m_pendingItemPercentage;
+
     // when the internal terminal timesout after no activity
     int m_terminalTimeout;
+
+    // the download limits to restore after a background transaction
+    bool m_dlLimitSet;
+    string m_dlLimitHttp;
+    string m_dlLimitHttps;
     pid_t m_child_pid;
 };
 
+/**
+ * Emits packages to the job as they are found. Duplicates are dropped
+ * with a bitset over the version IDs and the filters are applied to
+ * each version as it is added, so the results never have to be
+ * collected, sorted and copied before they are emitted.
+ */
+class PkgEmitter
+{
+public:
+    PkgEmitter(AptIntf *apt,
+               PkBitfield filters = PK_FILTER_ENUM_NONE,
+               PkInfoEnum state = PK_INFO_ENUM_UNKNOWN);
+    ~PkgEmitter();
+
+    /**
+      * Adds @ver to the results, it is emitted with the next batch
+      */
+    void push_back(const pkgCache::VerIterator &ver);
+
+    /**
+      * Returns true once the job got more packages than the limit
+      * hint asked for, so the search can stop
+      */
+    bool full() const;
+
+    /**
+      * Emits everything that is still pending
+      */
+    void finish();
+
+private:
+    void flush();
+    static const size_t BatchSize = 64;
+
+    AptIntf *m_apt;
+    PkBitfield m_filters;
+    PkInfoEnum m_state;
+    vector<bool> m_seen;
+    // versions that passed the filters but were not emitted yet
+    PkgList m_batch;
+    // the downloaded filter needs all the results at once
+    bool m_downloaded;
+};
+
 #endif
@@ -156,39 +156,17 @@ PkGroupEnum get_enum_group(string group)
     }
 }
 
-string fetchChangelogData(AptCacheFile &CacheFile,
-                          pkgAcquire &Fetcher,
-                          pkgCache::VerIterator Ver,
-                          pkgCache::VerIterator currver,
-                          string *update_text,
-                          string *updated,
-                          string *issued)
+void parseChangelog(const string &file,
+                    const string &srcpkg,
+                    pkgCache::VerIterator currver,
+                    ChangelogInfo &info)
 {
-    string changelog;
+    string &changelog = info.changelog;
+    string *update_text = &info.updateText;
+    string *updated = &info.updated;
+    string *issued = &info.issued;
 
-    pkgAcqChangelog *c = new pkgAcqChangelog(&Fetcher, Ver);
-
-    // try downloading it, if that fails, try third-party-changelogs location
-    // FIXME: Fetcher.Run() is "Continue" even if I get a 404?!?
-    Fetcher.Run();
-
-    // error
-    pkgRecords Recs(CacheFile);
-    pkgCache::PkgIterator Pkg = Ver.ParentPkg();
-    pkgRecords::Parser &rec=Recs.Lookup(Ver.FileList());
-    string srcpkg = rec.SourcePkg().empty() ? Pkg.Name() : rec.SourcePkg();
-    changelog = "Changelog for this version is not yet available";
-
-    // return empty string if we don't have a file to read
-    if (!FileExists(c->DestFile)) {
-        return changelog;
-    }
-
-    if (_error->PendingError()) {
-        return changelog;
-    }
-
-    ifstream in(c->DestFile.c_str());
+    ifstream in(file.c_str());
     string line;
     g_autoptr(GRegex) regexVer = NULL;
     regexVer = g_regex_new("(?'source'.+) \\((?'version'.*)\\) "
@@ -268,8 +246,48 @@ string fetchChangelogData(AptCacheFile &CacheFile,
             g_match_info_free(match_info);
         }
     }
+}
 
-    return changelog;
+bool loadChangelog(const string &cacheFile, const char *currver, ChangelogInfo &info)
+{
+    g_autoptr(GKeyFile) keyfile = g_key_file_new();
+
+    if (!g_key_file_load_from_file(keyfile, cacheFile.c_str(), G_KEY_FILE_NONE, NULL) ||
+            !g_key_file_has_group(keyfile, currver)) {
+        return false;
+    }
+
+    g_autofree gchar *changelog = g_key_file_get_string(keyfile, currver, "Changelog", NULL);
+    g_autofree gchar *updateText = g_key_file_get_string(keyfile, currver, "UpdateText", NULL);
+    g_autofree gchar *updated = g_key_file_get_string(keyfile, currver, "Updated", NULL);
+    g_autofree gchar *issued = g_key_file_get_string(keyfile, currver, "Issued", NULL);
+    if (changelog == NULL) {
+        return false;
+    }
+    info.changelog = changelog;
+    info.updateText = updateText == NULL ? "" : updateText;
+    info.updated = updated == NULL ? "" : updated;
+    info.issued = issued == NULL ? "" : issued;
+    return true;
+}
+
+void saveChangelog(const string &cacheFile, const char *currver, const ChangelogInfo &info)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GKeyFile) keyfile = g_key_file_new();
+    g_autofree gchar *dirname = g_path_get_dirname(cacheFile.c_str());
+
+    // the same update can be parsed again for another installed version
+    g_key_file_load_from_file(keyfile, cacheFile.c_str(), G_KEY_FILE_NONE, NULL);
+    g_key_file_set_string(keyfile, currver, "Changelog", info.changelog.c_str());
+    g_key_file_set_string(keyfile, currver, "UpdateText", info.updateText.c_str());
+    g_key_file_set_string(keyfile, currver, "Updated", info.updated.c_str());
+    g_key_file_set_string(keyfile, currver, "Issued", info.issued.c_str());
+
+    g_mkdir_with_parents(dirname, 0755);
+    if (!g_key_file_save_to_file(keyfile, cacheFile.c_str(), &error)) {
+        g_debug("Failed to save changelog to %s: %s", cacheFile.c_str(), error->message);
+    }
 }
 
 GPtrArray* getCVEUrls(const string &changelog)
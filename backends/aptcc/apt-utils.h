@@ -36,15 +36,34 @@ using namespace std;
 PkGroupEnum get_enum_group(string group);
 
 /**
-  * Return the changelog and extract details about the changes.
+  * The changelog of an update and the details extracted from it
   */
-string fetchChangelogData(AptCacheFile &CacheFile,
-                          pkgAcquire &Fetcher,
-                          pkgCache::VerIterator Ver,
-                          pkgCache::VerIterator currver,
-                          string *update_text,
-                          string *updated,
-                          string *issued);
+struct ChangelogInfo {
+    string changelog;
+    string updateText;
+    string updated;
+    string issued;
+};
+
+/**
+  * Reads the changelog saved in @file up to the version currently
+  * installed and extracts the details about the changes
+  */
+void parseChangelog(const string &file,
+                    const string &srcpkg,
+                    pkgCache::VerIterator currver,
+                    ChangelogInfo &info);
+
+/**
+  * Loads a changelog parsed earlier for the installed version @currver,
+  * returning false if there is none
+  */
+bool loadChangelog(const string &cacheFile, const char *currver, ChangelogInfo &info);
+
+/**
+  * Saves a parsed changelog for the installed version @currver
+  */
+void saveChangelog(const string &cacheFile, const char *currver, const ChangelogInfo &info);
 
 /**
   * Returns a list of links pairs url;description for CVEs
@@ -24,8 +24,11 @@
 
 #include <glib.h>
 #include <apt-pkg/init.h>
+#include <apt-pkg/aptconfiguration.h>
 #include <apt-pkg/configuration.h>
+#include <apt-pkg/error.h>
 #include <apt-pkg/fileutl.h>
+#include <algorithm>
 #include <iostream>
 
 class GetFilesStream : public pkgDirStream
@@ -40,7 +43,8 @@ public:
     }
 };
 
-DebFile::DebFile(const string &filename)
+DebFile::DebFile(const string &filename, bool withFiles) :
+    m_extractor(nullptr)
 {
     FileFd in(filename, FileFd::ReadOnly);
     debDebFile deb(in);
@@ -56,11 +60,14 @@ DebFile::DebFile(const string &filename)
         return;
     }
 
-    GetFilesStream stream;
-    if (deb.ExtractArchive(stream) == false) {
-        return;
+    // the data member is much larger than the control one
+    if (withFiles) {
+        GetFilesStream stream;
+        if (deb.ExtractArchive(stream) == false) {
+            return;
+        }
+        m_files = stream.files;
     }
-    m_files = stream.files;
 
     m_isValid = true;
 }
@@ -126,9 +133,10 @@ bool DebFile::check()
         return false;
     }
 
-    std::cout << architecture() << std::endl;
+    // foreign architectures can be installed once dpkg knows them
+    std::vector<std::string> archs = APT::Configuration::getArchitectures();
     if (architecture().compare("all") != 0 &&
-            architecture().compare(_config->Find("APT::Architecture")) != 0) {
+            std::find(archs.begin(), archs.end(), architecture()) == archs.end()) {
         m_errorMsg = "Wrong architecture ";
         m_errorMsg.append(architecture());
         return false;
@@ -31,7 +31,11 @@ class DebFile
 {
     //     typedef int user_tag_reference;
 public:
-    DebFile(const string &filename);
+    /**
+      * Reads the control data of @filename, and the list of the files the
+      * package installs when @withFiles is set
+      */
+    DebFile(const string &filename, bool withFiles = true);
     virtual ~DebFile();
     bool isValid() const;
 
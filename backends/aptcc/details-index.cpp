@@ -0,0 +1,288 @@
+/* details-index.cpp
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "details-index.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define DETAILS_INDEX_MAGIC "PKAPTDX1"
+
+namespace {
+
+/* the file is the header, the words, the postings and then the words
+ * themselves in the same sorted order */
+struct Header {
+    char magic[8];
+    guint32 nWords;
+    guint32 nPostings;
+    guint32 nPackages;
+    guint32 stringsSize;
+    gint64 cacheMtime;
+    char languages[64];
+};
+
+struct Word {
+    guint32 word;
+    guint32 first;
+    guint32 count;
+    guint32 reserved;
+};
+
+struct View {
+    const Header *header;
+    const Word *words;
+    const guint32 *postings;
+    const char *strings;
+};
+
+bool getView(const char *contents, gsize length, View &view)
+{
+    if (contents == nullptr || length < sizeof(Header)) {
+        return false;
+    }
+
+    view.header = reinterpret_cast<const Header *>(contents);
+    if (memcmp(view.header->magic, DETAILS_INDEX_MAGIC, sizeof(view.header->magic)) != 0) {
+        return false;
+    }
+    guint64 expected = sizeof(Header) +
+            (guint64) view.header->nWords * sizeof(Word) +
+            (guint64) view.header->nPostings * sizeof(guint32) +
+            view.header->stringsSize;
+    if (expected != length) {
+        return false;
+    }
+
+    view.words = reinterpret_cast<const Word *>(contents + sizeof(Header));
+    view.postings = reinterpret_cast<const guint32 *>(view.words + view.header->nWords);
+    view.strings = reinterpret_cast<const char *>(view.postings + view.header->nPostings);
+    return true;
+}
+
+}
+
+DetailsIndex::DetailsIndex() :
+    m_mapped(nullptr),
+    m_contents(nullptr),
+    m_length(0)
+{
+}
+
+DetailsIndex::~DetailsIndex()
+{
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+    }
+}
+
+bool DetailsIndex::load(const std::string &filename, gint64 cacheMtime,
+                        const std::string &languages, guint32 nPackages)
+{
+    g_autoptr(GError) error = nullptr;
+
+    GMappedFile *mapped = g_mapped_file_new(filename.c_str(), FALSE, &error);
+    if (mapped == nullptr) {
+        g_debug("Failed to map %s: %s", filename.c_str(), error->message);
+        return false;
+    }
+
+    if (!setContents(g_mapped_file_get_contents(mapped),
+                     g_mapped_file_get_length(mapped),
+                     cacheMtime, languages, nPackages)) {
+        g_debug("Ignoring out of date details index %s", filename.c_str());
+        g_mapped_file_unref(mapped);
+        return false;
+    }
+
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+    }
+    m_mapped = mapped;
+    return true;
+}
+
+bool DetailsIndex::setContents(const char *contents, gsize length, gint64 cacheMtime,
+                               const std::string &languages, guint32 nPackages)
+{
+    View view;
+
+    if (!getView(contents, length, view) ||
+            view.header->cacheMtime != cacheMtime ||
+            view.header->nPackages != nPackages ||
+            languages.compare(0, sizeof(view.header->languages) - 1, view.header->languages) != 0) {
+        return false;
+    }
+
+    // never trust an offset from the file, and the words have to be in
+    // order for the search to map a match back to its word
+    bool valid = view.header->nWords == 0 ||
+            (view.header->stringsSize > 0 &&
+             view.strings[view.header->stringsSize - 1] == '\0' &&
+             view.words[0].word == 0);
+    for (guint32 i = 0; valid && i < view.header->nWords; i++) {
+        const Word &word = view.words[i];
+        valid = word.word < view.header->stringsSize &&
+                (i == 0 || word.word > view.words[i - 1].word) &&
+                word.first <= view.header->nPostings &&
+                word.count <= view.header->nPostings - word.first;
+    }
+    for (guint32 i = 0; valid && i < view.header->nPostings; i++) {
+        valid = view.postings[i] < nPackages;
+    }
+    if (!valid) {
+        return false;
+    }
+
+    m_contents = contents;
+    m_length = length;
+    return true;
+}
+
+void DetailsIndex::add(guint32 id, const char *text)
+{
+    std::string word;
+
+    for (const char *c = text; ; c++) {
+        if (*c != '\0' && !g_ascii_isspace(*c)) {
+            word.push_back(g_ascii_tolower(*c));
+            continue;
+        }
+
+        if (!word.empty()) {
+            std::vector<guint32> &ids = m_building[word];
+            if (ids.empty() || ids.back() != id) {
+                ids.push_back(id);
+            }
+            word.clear();
+        }
+        if (*c == '\0') {
+            break;
+        }
+    }
+}
+
+bool DetailsIndex::save(const std::string &filename, gint64 cacheMtime,
+                        const std::string &languages, guint32 nPackages)
+{
+    g_autoptr(GError) error = nullptr;
+    std::vector<const std::string *> sorted;
+    std::vector<Word> words;
+    std::vector<guint32> postings;
+    std::string strings;
+
+    for (const auto &it : m_building) {
+        sorted.push_back(&it.first);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const std::string *a, const std::string *b) {
+        return *a < *b;
+    });
+    for (const std::string *key : sorted) {
+        const std::vector<guint32> &ids = m_building[*key];
+        Word word;
+        word.word = strings.size();
+        word.first = postings.size();
+        word.count = ids.size();
+        word.reserved = 0;
+        words.push_back(word);
+        postings.insert(postings.end(), ids.begin(), ids.end());
+        strings.append(*key).push_back('\0');
+    }
+    m_building.clear();
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DETAILS_INDEX_MAGIC, sizeof(header.magic));
+    header.nWords = words.size();
+    header.nPostings = postings.size();
+    header.nPackages = nPackages;
+    header.stringsSize = strings.size();
+    header.cacheMtime = cacheMtime;
+    g_strlcpy(header.languages, languages.c_str(), sizeof(header.languages));
+
+    m_data.clear();
+    m_data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    m_data.append(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(Word));
+    m_data.append(reinterpret_cast<const char *>(postings.data()), postings.size() * sizeof(guint32));
+    m_data.append(strings);
+
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+        m_mapped = nullptr;
+    }
+    if (!filename.empty() &&
+            !g_file_set_contents(filename.c_str(), m_data.data(), m_data.size(), &error)) {
+        g_warning("Failed to write %s: %s", filename.c_str(), error->message);
+    }
+
+    return setContents(m_data.data(), m_data.size(), cacheMtime, languages, nPackages);
+}
+
+std::vector<bool> DetailsIndex::search(const std::vector<std::string> &terms) const
+{
+    std::vector<bool> result;
+    View view;
+
+    if (!getView(m_contents, m_length, view)) {
+        return result;
+    }
+
+    // every word of every term has to be found, anywhere in the details
+    result.assign(view.header->nPackages, true);
+    for (const std::string &term : terms) {
+        g_auto(GStrv) parts = g_strsplit_set(term.c_str(), " \t\n", -1);
+        for (guint i = 0; parts[i] != nullptr; i++) {
+            if (parts[i][0] == '\0') {
+                continue;
+            }
+
+            g_autofree gchar *needle = g_ascii_strdown(parts[i], -1);
+            gsize needleLen = strlen(needle);
+            std::vector<bool> found(view.header->nPackages, false);
+            const char *start = view.strings;
+            const char *end = start + view.header->stringsSize;
+            const char *pos = start;
+            while (pos < end) {
+                const char *hit = static_cast<const char *>(memmem(pos, end - pos, needle, needleLen));
+                if (hit == nullptr) {
+                    break;
+                }
+
+                // find the word the match is in and continue after it
+                guint32 offset = hit - start;
+                const Word *wordsEnd = view.words + view.header->nWords;
+                const Word *word = std::upper_bound(view.words, wordsEnd, offset,
+                                                    [](guint32 value, const Word &w) {
+                    return value < w.word;
+                }) - 1;
+                for (guint32 j = 0; j < word->count; j++) {
+                    found[view.postings[word->first + j]] = true;
+                }
+                pos = word + 1 < wordsEnd ? start + word[1].word : end;
+            }
+
+            for (gsize j = 0; j < result.size(); j++) {
+                result[j] = result[j] && found[j];
+            }
+        }
+    }
+    return result;
+}
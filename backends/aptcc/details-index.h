@@ -0,0 +1,79 @@
+/* details-index.h
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DETAILS_INDEX_H
+#define DETAILS_INDEX_H
+
+#include <glib.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * An inverted index from the lowercased words of the package names and
+ * descriptions to the IDs of the packages in the apt cache.
+ *
+ * It is only valid for the package cache and the languages it was built
+ * for, which are stored in the file so a stale index is never used.
+ */
+class DetailsIndex
+{
+public:
+    DetailsIndex();
+    ~DetailsIndex();
+
+    /**
+      * Maps a previously saved index, returning false if it is missing
+      * or was built for another cache
+      */
+    bool load(const std::string &filename, gint64 cacheMtime,
+              const std::string &languages, guint32 nPackages);
+
+    /**
+      * Adds the words of @text to the package, IDs must be added in order
+      */
+    void add(guint32 id, const char *text);
+
+    /**
+      * Turns what was added into the index, writing it to @filename
+      * unless that is empty
+      */
+    bool save(const std::string &filename, gint64 cacheMtime,
+              const std::string &languages, guint32 nPackages);
+
+    /**
+      * Returns which package IDs have a word containing every term
+      */
+    std::vector<bool> search(const std::vector<std::string> &terms) const;
+
+private:
+    bool setContents(const char *contents, gsize length, gint64 cacheMtime,
+                     const std::string &languages, guint32 nPackages);
+
+    GMappedFile *m_mapped;
+    std::string m_data;
+    const char *m_contents;
+    gsize m_length;
+    std::unordered_map<std::string, std::vector<guint32>> m_building;
+};
+
+#endif // DETAILS_INDEX_H
@@ -0,0 +1,369 @@
+/* dpkg-file-index.cpp
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "dpkg-file-index.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <sys/stat.h>
+#include <vector>
+
+#define DPKG_FILE_INDEX_MAGIC "PKDPKGF1"
+
+namespace {
+
+/* the file is the header, the tables and then the string pool, all of
+ * the offsets in the tables point into the string pool */
+struct Header {
+    char magic[8];
+    guint32 nLists;
+    guint32 nPaths;
+    guint32 stringsSize;
+    guint32 reserved;
+    gint64 infoMtime;
+};
+
+/* one per .list file, in no particular order */
+struct ListEntry {
+    guint32 name;
+    guint32 reserved;
+    gint64 mtime;
+};
+
+/* sorted by path */
+struct PathEntry {
+    guint32 path;
+    guint32 list;
+};
+
+/* sorted by basename, pointing at the path it is the last part of */
+struct BaseEntry {
+    guint32 base;
+    guint32 path;
+};
+
+struct View {
+    const Header *header;
+    const ListEntry *lists;
+    const PathEntry *paths;
+    const BaseEntry *bases;
+    const char *strings;
+};
+
+bool getView(GMappedFile *mapped, View &view)
+{
+    if (mapped == nullptr) {
+        return false;
+    }
+
+    const char *data = g_mapped_file_get_contents(mapped);
+    gsize size = g_mapped_file_get_length(mapped);
+    if (size < sizeof(Header)) {
+        return false;
+    }
+
+    view.header = reinterpret_cast<const Header *>(data);
+    if (memcmp(view.header->magic, DPKG_FILE_INDEX_MAGIC, sizeof(view.header->magic)) != 0) {
+        return false;
+    }
+    guint64 expected = sizeof(Header) +
+            (guint64) view.header->nLists * sizeof(ListEntry) +
+            (guint64) view.header->nPaths * (sizeof(PathEntry) + sizeof(BaseEntry)) +
+            view.header->stringsSize;
+    if (expected != size) {
+        return false;
+    }
+
+    view.lists = reinterpret_cast<const ListEntry *>(data + sizeof(Header));
+    view.paths = reinterpret_cast<const PathEntry *>(view.lists + view.header->nLists);
+    view.bases = reinterpret_cast<const BaseEntry *>(view.paths + view.header->nPaths);
+    view.strings = reinterpret_cast<const char *>(view.bases + view.header->nPaths);
+    return true;
+}
+
+gint64 getMtime(const struct stat &st)
+{
+    return (gint64) st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
+}
+
+void appendData(std::string &blob, const void *data, gsize size)
+{
+    blob.append(static_cast<const char *>(data), size);
+}
+
+}
+
+DpkgFileIndex::DpkgFileIndex(const std::string &infoDir, const std::string &indexFile) :
+    m_infoDir(infoDir),
+    m_indexFile(indexFile),
+    m_mapped(nullptr)
+{
+}
+
+DpkgFileIndex::~DpkgFileIndex()
+{
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+    }
+}
+
+bool DpkgFileIndex::open()
+{
+    struct stat st;
+    View view;
+
+    if (stat(m_infoDir.c_str(), &st) != 0) {
+        g_debug("Failed to stat %s: %s", m_infoDir.c_str(), g_strerror(errno));
+        return false;
+    }
+
+    // dpkg renames the .list files into place, so the directory changes
+    // whenever a package is installed, upgraded or removed
+    gint64 infoMtime = getMtime(st);
+    if (load() && getView(m_mapped, view) && view.header->infoMtime == infoMtime) {
+        return true;
+    }
+    return update(infoMtime);
+}
+
+bool DpkgFileIndex::load()
+{
+    g_autoptr(GError) error = nullptr;
+    View view;
+
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+        m_mapped = nullptr;
+    }
+
+    m_mapped = g_mapped_file_new(m_indexFile.c_str(), FALSE, &error);
+    if (m_mapped == nullptr) {
+        g_debug("Failed to map %s: %s", m_indexFile.c_str(), error->message);
+        return false;
+    }
+
+    // never trust an offset that points outside the string pool
+    bool valid = getView(m_mapped, view) &&
+            view.header->stringsSize > 0 &&
+            view.strings[view.header->stringsSize - 1] == '\0';
+    for (guint32 i = 0; valid && i < view.header->nLists; i++) {
+        valid = view.lists[i].name < view.header->stringsSize;
+    }
+    for (guint32 i = 0; valid && i < view.header->nPaths; i++) {
+        valid = view.paths[i].path < view.header->stringsSize &&
+                view.paths[i].list < view.header->nLists &&
+                view.bases[i].base < view.header->stringsSize &&
+                view.bases[i].path < view.header->nPaths;
+    }
+    if (!valid) {
+        g_debug("Ignoring invalid file index %s", m_indexFile.c_str());
+        g_mapped_file_unref(m_mapped);
+        m_mapped = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool DpkgFileIndex::update(gint64 infoMtime)
+{
+    g_autoptr(GError) error = nullptr;
+    g_autofree gchar *dirname = nullptr;
+    std::map<std::string, guint32> oldLists;
+    std::vector<std::vector<guint32>> oldPaths;
+    std::vector<std::string> names;
+    std::vector<gint64> mtimes;
+    std::vector<std::pair<std::string, guint32>> files;
+    guint reread = 0;
+    View old;
+
+    // what we already know, by list
+    bool haveOld = getView(m_mapped, old);
+    if (haveOld) {
+        oldPaths.resize(old.header->nLists);
+        for (guint32 i = 0; i < old.header->nLists; i++) {
+            oldLists[old.strings + old.lists[i].name] = i;
+        }
+        for (guint32 i = 0; i < old.header->nPaths; i++) {
+            oldPaths[old.paths[i].list].push_back(old.paths[i].path);
+        }
+    }
+
+    DIR *dp = opendir(m_infoDir.c_str());
+    if (dp == nullptr) {
+        g_debug("Error opening %s", m_infoDir.c_str());
+        return false;
+    }
+
+    struct dirent *dirp;
+    while ((dirp = readdir(dp)) != nullptr) {
+        if (!g_str_has_suffix(dirp->d_name, ".list")) {
+            continue;
+        }
+
+        std::string filename = m_infoDir + "/" + dirp->d_name;
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0) {
+            continue;
+        }
+
+        guint32 list = names.size();
+        names.push_back(std::string(dirp->d_name, strlen(dirp->d_name) - 5));
+        mtimes.push_back(getMtime(st));
+
+        // only read the lists that changed since the index was written
+        auto it = haveOld ? oldLists.find(names.back()) : oldLists.end();
+        if (it != oldLists.end() && old.lists[it->second].mtime == mtimes.back()) {
+            for (guint32 path : oldPaths[it->second]) {
+                files.push_back(std::make_pair(std::string(old.strings + path), list));
+            }
+            continue;
+        }
+
+        std::ifstream in(filename.c_str());
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) {
+                files.push_back(std::make_pair(line, list));
+            }
+        }
+        reread++;
+    }
+    closedir(dp);
+    g_debug("updating file index from %u lists, %u read again", (guint) names.size(), reread);
+
+    // lay out the string pool, with the paths sorted
+    std::sort(files.begin(), files.end());
+    std::string strings;
+    std::vector<ListEntry> lists(names.size());
+    for (guint32 i = 0; i < names.size(); i++) {
+        lists[i].name = strings.size();
+        lists[i].reserved = 0;
+        lists[i].mtime = mtimes[i];
+        strings.append(names[i]).push_back('\0');
+    }
+    std::vector<PathEntry> paths(files.size());
+    std::vector<BaseEntry> bases(files.size());
+    for (guint32 i = 0; i < files.size(); i++) {
+        const std::string &path = files[i].first;
+        size_t slash = path.rfind('/');
+        paths[i].path = strings.size();
+        paths[i].list = files[i].second;
+        bases[i].base = paths[i].path + (slash == std::string::npos ? 0 : slash + 1);
+        bases[i].path = i;
+        strings.append(path).push_back('\0');
+    }
+    const char *pool = strings.c_str();
+    std::sort(bases.begin(), bases.end(), [pool](const BaseEntry &a, const BaseEntry &b) {
+        return strcmp(pool + a.base, pool + b.base) < 0;
+    });
+
+    Header header;
+    memcpy(header.magic, DPKG_FILE_INDEX_MAGIC, sizeof(header.magic));
+    header.nLists = lists.size();
+    header.nPaths = paths.size();
+    header.stringsSize = strings.size();
+    header.reserved = 0;
+    header.infoMtime = infoMtime;
+
+    std::string blob;
+    blob.reserve(sizeof(header) + lists.size() * sizeof(ListEntry) +
+                 paths.size() * (sizeof(PathEntry) + sizeof(BaseEntry)) + strings.size());
+    appendData(blob, &header, sizeof(header));
+    appendData(blob, lists.data(), lists.size() * sizeof(ListEntry));
+    appendData(blob, paths.data(), paths.size() * sizeof(PathEntry));
+    appendData(blob, bases.data(), bases.size() * sizeof(BaseEntry));
+    blob.append(strings);
+
+    // replace the old index atomically, it may still be mapped
+    dirname = g_path_get_dirname(m_indexFile.c_str());
+    g_mkdir_with_parents(dirname, 0755);
+    if (!g_file_set_contents(m_indexFile.c_str(), blob.data(), blob.size(), &error)) {
+        g_warning("Failed to write %s: %s", m_indexFile.c_str(), error->message);
+        return false;
+    }
+    return load();
+}
+
+void DpkgFileIndex::findPath(const std::string &path, std::set<std::string> &packages) const
+{
+    View view;
+
+    if (!getView(m_mapped, view)) {
+        return;
+    }
+
+    const char *key = path.c_str();
+    const PathEntry *end = view.paths + view.header->nPaths;
+    const PathEntry *it = std::lower_bound(view.paths, end, key,
+                                           [&view](const PathEntry &entry, const char *value) {
+        return strcmp(view.strings + entry.path, value) < 0;
+    });
+    for (; it != end && strcmp(view.strings + it->path, key) == 0; it++) {
+        packages.insert(view.strings + view.lists[it->list].name);
+    }
+}
+
+void DpkgFileIndex::findName(const std::string &name, std::set<std::string> &packages) const
+{
+    View view;
+
+    if (!getView(m_mapped, view)) {
+        return;
+    }
+
+    // look up the last part, then check the leading directories if any
+    size_t slash = name.rfind('/');
+    std::string base = slash == std::string::npos ? name : name.substr(slash + 1);
+    std::string suffix = "/" + name;
+    const char *key = base.c_str();
+    const BaseEntry *end = view.bases + view.header->nPaths;
+    const BaseEntry *it = std::lower_bound(view.bases, end, key,
+                                           [&view](const BaseEntry &entry, const char *value) {
+        return strcmp(view.strings + entry.base, value) < 0;
+    });
+    for (; it != end && strcmp(view.strings + it->base, key) == 0; it++) {
+        const PathEntry &path = view.paths[it->path];
+        if (slash != std::string::npos &&
+                !g_str_has_suffix(view.strings + path.path, suffix.c_str())) {
+            continue;
+        }
+        packages.insert(view.strings + view.lists[path.list].name);
+    }
+}
+
+void DpkgFileIndex::findSuffix(const char *suffix, std::set<std::string> &packages) const
+{
+    View view;
+
+    if (!getView(m_mapped, view)) {
+        return;
+    }
+
+    for (guint32 i = 0; i < view.header->nPaths; i++) {
+        if (g_str_has_suffix(view.strings + view.paths[i].path, suffix)) {
+            packages.insert(view.strings + view.lists[view.paths[i].list].name);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/* dpkg-file-index.h
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DPKG_FILE_INDEX_H
+#define DPKG_FILE_INDEX_H
+
+#include <glib.h>
+
+#include <set>
+#include <string>
+
+#define DPKG_INFO_DIR               "/var/lib/dpkg/info"
+#define DPKG_FILE_INDEX_FILENAME    PK_DB_DIR "/aptcc-file-index"
+
+/**
+ * Maps the files listed in the dpkg info directory back to the packages
+ * that own them, so that searching files does not read every .list file.
+ *
+ * The index is kept on disk as a sorted path table and a sorted basename
+ * table pointing into it, and the .list files that changed since it was
+ * written are read again when it is opened.
+ */
+class DpkgFileIndex
+{
+public:
+    DpkgFileIndex(const std::string &infoDir, const std::string &indexFile);
+    ~DpkgFileIndex();
+
+    /**
+      * Opens the index, updating it first if the info directory changed
+      */
+    bool open();
+
+    /**
+      * Adds the names of the packages owning exactly @path to @packages
+      */
+    void findPath(const std::string &path, std::set<std::string> &packages) const;
+
+    /**
+      * Adds the names of the packages owning a file whose path ends with
+      * /@name to @packages, where @name is a basename or a relative path
+      */
+    void findName(const std::string &name, std::set<std::string> &packages) const;
+
+    /**
+      * Adds the names of the packages owning a file whose path ends with
+      * @suffix, e.g. ".desktop", to @packages
+      */
+    void findSuffix(const char *suffix, std::set<std::string> &packages) const;
+
+private:
+    bool load();
+    bool update(gint64 infoMtime);
+
+    std::string m_infoDir;
+    std::string m_indexFile;
+    GMappedFile *m_mapped;
+};
+
+#endif // DPKG_FILE_INDEX_H
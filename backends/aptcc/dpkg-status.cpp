@@ -0,0 +1,118 @@
+/* dpkg-status.cpp
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "dpkg-status.h"
+
+#include <cstring>
+
+// FNV-1a, we only need to notice when a stanza changes
+static guint64 hashStanza(const gchar *data, gsize len)
+{
+    guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+    for (gsize i = 0; i < len; i++) {
+        hash ^= (guchar) data[i];
+        hash *= G_GUINT64_CONSTANT(1099511628211);
+    }
+    return hash;
+}
+
+// returns the value of the @field line in the stanza, or an empty string
+static std::string stanzaField(const gchar *start, const gchar *end, const gchar *field)
+{
+    size_t len = strlen(field);
+    const gchar *line = start;
+    while (line < end) {
+        const gchar *eol = (const gchar *) memchr(line, '\n', end - line);
+        if (eol == NULL) {
+            eol = end;
+        }
+        if ((size_t) (eol - line) > len && strncmp(line, field, len) == 0 && line[len] == ':') {
+            const gchar *value = line + len + 1;
+            while (value < eol && *value == ' ') {
+                value++;
+            }
+            return std::string(value, eol - value);
+        }
+        line = eol + 1;
+    }
+    return std::string();
+}
+
+bool DpkgStatusSnapshot::load(const std::string &path)
+{
+    gchar *contents = NULL;
+    gsize length = 0;
+
+    m_stanzas.clear();
+    if (!g_file_get_contents(path.c_str(), &contents, &length, NULL)) {
+        return false;
+    }
+
+    const gchar *end = contents + length;
+    const gchar *start = contents;
+    while (start < end) {
+        // stanzas are separated by an empty line
+        const gchar *stop = start;
+        while (stop < end) {
+            const gchar *eol = (const gchar *) memchr(stop, '\n', end - stop);
+            if (eol == NULL) {
+                stop = end;
+                break;
+            }
+            if (eol == stop) {
+                break;
+            }
+            stop = eol + 1;
+        }
+
+        if (stop > start) {
+            std::string name = stanzaField(start, stop, "Package");
+            if (!name.empty()) {
+                std::string arch = stanzaField(start, stop, "Architecture");
+                m_stanzas[name + ":" + arch] = hashStanza(start, stop - start);
+            }
+        }
+        start = stop + 1;
+    }
+
+    g_free(contents);
+    return true;
+}
+
+void DpkgStatusSnapshot::changedSince(const DpkgStatusSnapshot &old, std::set<std::string> &changed) const
+{
+    for (const auto &stanza : m_stanzas) {
+        auto it = old.m_stanzas.find(stanza.first);
+        if (it == old.m_stanzas.end() || it->second != stanza.second) {
+            changed.insert(stanza.first);
+        }
+    }
+    for (const auto &stanza : old.m_stanzas) {
+        if (m_stanzas.find(stanza.first) == m_stanzas.end()) {
+            changed.insert(stanza.first);
+        }
+    }
+}
+
+bool DpkgStatusSnapshot::empty() const
+{
+    return m_stanzas.empty();
+}
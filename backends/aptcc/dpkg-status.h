@@ -0,0 +1,56 @@
+/* dpkg-status.h
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef DPKG_STATUS_H
+#define DPKG_STATUS_H
+
+#include <glib.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+
+/**
+ * A checksum of every stanza of the dpkg status file, so that after it
+ * changed the packages whose state actually changed can be told apart
+ * from the ones that were only written out again.
+ */
+class DpkgStatusSnapshot
+{
+public:
+    /**
+      * Reads the status file at @path, returns false if it can't be read
+      */
+    bool load(const std::string &path);
+
+    /**
+      * Adds the "name:arch" of the packages that were added, removed or
+      * changed since @old to @changed
+      */
+    void changedSince(const DpkgStatusSnapshot &old, std::set<std::string> &changed) const;
+
+    bool empty() const;
+
+private:
+    std::unordered_map<std::string, guint64> m_stanzas;
+};
+
+#endif // DPKG_STATUS_H
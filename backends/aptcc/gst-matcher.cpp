@@ -21,6 +21,8 @@
 #include "gst-matcher.h"
 #include "apt-utils.h"
 
+#include <algorithm>
+#include <cstring>
 #include <regex.h>
 #include <gst/gst.h>
 
@@ -173,3 +175,101 @@ bool GstMatcher::hasMatches() const
 {
     return !m_matches.empty();
 }
+
+static const char *gstTypes[] = {
+    "Gstreamer-Encoders: ",
+    "Gstreamer-Decoders: ",
+    "Gstreamer-Uri-Sources: ",
+    "Gstreamer-Uri-Sinks: ",
+    "Gstreamer-Elements: ",
+    NULL
+};
+
+GstProvidesIndex::GstProvidesIndex()
+{
+    if (!inited) {
+        gst_init(NULL, NULL);
+        inited = true;
+    }
+}
+
+GstProvidesIndex::~GstProvidesIndex()
+{
+    for (const Entry &entry : m_entries) {
+        gst_caps_unref(static_cast<GstCaps*>(entry.caps));
+    }
+}
+
+void GstProvidesIndex::add(size_t id, const string &record, const string &arch)
+{
+    const string versionField = "\nGstreamer-Version: ";
+    size_t found = record.find(versionField);
+    if (found == string::npos) {
+        return;
+    }
+    found += versionField.size();
+    string version = record.substr(found, record.find('\n', found) - found);
+
+    for (guint i = 0; gstTypes[i] != NULL; i++) {
+        found = record.find(gstTypes[i]);
+        if (found == string::npos) {
+            continue;
+        }
+        found += strlen(gstTypes[i]);
+
+        GstCaps *caps = gst_caps_from_string(record.substr(found, record.find('\n', found) - found).c_str());
+        if (caps == NULL) {
+            continue;
+        }
+
+        // file the caps under each media type they have
+        Entry entry;
+        entry.id = id;
+        entry.version = version;
+        entry.arch = arch;
+        entry.caps = caps;
+        m_entries.push_back(entry);
+        if (gst_caps_is_any(caps)) {
+            m_byKey[string(gstTypes[i]) + "*"].push_back(m_entries.size() - 1);
+            continue;
+        }
+        for (guint j = 0; j < gst_caps_get_size(caps); j++) {
+            const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, j));
+            m_byKey[string(gstTypes[i]) + name].push_back(m_entries.size() - 1);
+        }
+    }
+}
+
+vector<size_t> GstProvidesIndex::find(const GstMatcher &matcher) const
+{
+    vector<size_t> ids;
+
+    for (const Match &match : matcher.m_matches) {
+        // the query has "\nGstreamer-Version: " in front of the version
+        string version = match.version.substr(match.version.find(": ") + 2);
+        for (const string &key : { match.type + match.data, match.type + "*" }) {
+            auto it = m_byKey.find(key);
+            if (it == m_byKey.end()) {
+                continue;
+            }
+
+            for (size_t index : it->second) {
+                const Entry &entry = m_entries[index];
+                if (!g_str_has_prefix(entry.version.c_str(), version.c_str()) ||
+                        (!match.arch.empty() && entry.arch != match.arch)) {
+                    continue;
+                }
+
+                // if the record is capable of intersect them we found the package
+                if (gst_caps_can_intersect(static_cast<GstCaps*>(match.caps),
+                                           static_cast<GstCaps*>(entry.caps))) {
+                    ids.push_back(entry.id);
+                }
+            }
+        }
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
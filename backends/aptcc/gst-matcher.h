@@ -25,6 +25,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 using namespace std;
 
@@ -47,7 +48,40 @@ public:
     bool hasMatches() const;
 
 private:
+    friend class GstProvidesIndex;
     vector<Match> m_matches;
 };
 
+/**
+ * The GStreamer capabilities in the records of the packages, keyed by the
+ * kind of provide and the media types, so that a query only intersects
+ * the caps of the few packages that can match
+ */
+class GstProvidesIndex
+{
+public:
+    GstProvidesIndex();
+    ~GstProvidesIndex();
+
+    /**
+      * Adds the capabilities from the package record, if it has any
+      */
+    void add(size_t id, const string &record, const string &arch);
+
+    /**
+      * Returns the sorted ids of the packages matching any of the queries
+      */
+    vector<size_t> find(const GstMatcher &matcher) const;
+
+private:
+    struct Entry {
+        size_t id;
+        string version;
+        string arch;
+        void *caps;
+    };
+    vector<Entry> m_entries;
+    unordered_map<string, vector<size_t>> m_byKey;
+};
+
 #endif
@@ -24,11 +24,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <atomic>
+#include <vector>
+
 #include <config.h>
+#include <glib/gstdio.h>
 #include <pk-backend.h>
 #include <pk-backend-spawn.h>
 
 #include <apt-pkg/aptconfiguration.h>
+#include <apt-pkg/configuration.h>
 #include <apt-pkg/error.h>
 #include <apt-pkg/fileutl.h>
 #include <apt-pkg/init.h>
@@ -43,6 +48,65 @@
 /* static bodges */
 static PkBackendSpawn *spawn;
 
+/* the parsed sources, kept until a monitor sees one of the files change */
+static GMutex sourcesMutex;
+static SourcesList *sharedSources = nullptr;
+static std::atomic<bool> sourcesStale(true);
+static std::vector<GFileMonitor *> sourcesMonitors;
+
+/**
+ * Holds the shared SourcesList for a repo job, reading it first if it
+ * was never read or changed since
+ */
+class SourcesListLocker
+{
+public:
+    SourcesListLocker() : m_modified(false)
+    {
+        g_mutex_lock(&sourcesMutex);
+        if (sourcesStale.exchange(false) || sharedSources == nullptr) {
+            delete sharedSources;
+            sharedSources = new SourcesList;
+            if (sharedSources->ReadSources() == false) {
+                _error->
+                        Warning("Ignoring invalid record(s) in sources.list file!");
+            }
+
+            // try again with the next job
+            if (sharedSources->ReadVendors() == false) {
+                delete sharedSources;
+                sharedSources = nullptr;
+            }
+        }
+    }
+
+    ~SourcesListLocker()
+    {
+        if (m_modified) {
+            delete sharedSources;
+            sharedSources = nullptr;
+        }
+        g_mutex_unlock(&sourcesMutex);
+    }
+
+    SourcesList *get() const
+    {
+        return sharedSources;
+    }
+
+    /**
+      * The records were changed in memory, they are read again rather
+      * than trusting they match the files written
+      */
+    void setModified()
+    {
+        m_modified = true;
+    }
+
+private:
+    bool m_modified;
+};
+
 const gchar* pk_backend_get_description(PkBackend *backend)
 {
     return "APTcc";
@@ -60,6 +124,55 @@ pk_backend_supports_parallelization (PkBackend *backend)
     return FALSE;
 }
 
+gboolean
+pk_backend_watches_repos (PkBackend *backend)
+{
+    // the sources.list files are watched for changes
+    return TRUE;
+}
+
+static void pk_backend_status_changed_cb(PkBackend *backend, gpointer data)
+{
+    g_debug("dpkg status changed, dropping the open package cache");
+    AptCacheFile::invalidateShared();
+}
+
+static void pk_backend_sources_changed_cb(GFileMonitor *monitor,
+                                          GFile *file,
+                                          GFile *other_file,
+                                          GFileMonitorEvent event_type,
+                                          gpointer user_data)
+{
+    if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+        return;
+    }
+
+    // a repo job may hold the lock for a whole transaction
+    sourcesStale = true;
+
+    // add-apt-repository and friends, the cached GetRepoList is dropped
+    pk_backend_repo_list_changed(PK_BACKEND(user_data));
+}
+
+static void pk_backend_watch_sources(PkBackend *backend, const string &path, bool directory)
+{
+    g_autoptr(GFile) file = g_file_new_for_path(path.c_str());
+    g_autoptr(GError) error = NULL;
+    GFileMonitor *monitor;
+
+    if (directory) {
+        monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, &error);
+    } else {
+        monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, &error);
+    }
+    if (monitor == NULL) {
+        g_warning("Failed to set watch on %s: %s", path.c_str(), error->message);
+        return;
+    }
+    g_signal_connect(monitor, "changed", G_CALLBACK(pk_backend_sources_changed_cb), backend);
+    sourcesMonitors.push_back(monitor);
+}
+
 void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 {
     g_debug("APTcc Initializing");
@@ -83,6 +196,28 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
         g_debug("ERROR initializing backend system");
     }
 
+    // how many archives are fetched at once, apt keeps a queue with one
+    // connection per host and pipelines the requests sent on it
+    gint queues = g_key_file_get_integer(conf, "Aptcc", "DownloadQueues", NULL);
+    if (queues > 0) {
+        _config->Set("Acquire::Queue-Mode", "host");
+        _config->Set("Acquire::QueueHost::Limit", queues);
+    }
+    gint depth = g_key_file_get_integer(conf, "Aptcc", "PipelineDepth", NULL);
+    if (depth > 0) {
+        _config->Set("Acquire::http::Pipeline-Depth", depth);
+    }
+
+    // reopen the cache kept for read-only jobs when something else
+    // installs or removes packages, the lists are checked on reuse
+    string status = _config->FindFile("Dir::State::status");
+    pk_backend_watch_file(backend, status.c_str(), pk_backend_status_changed_cb, NULL);
+
+    // the repo jobs keep the parsed sources until they change
+    pk_backend_watch_sources(backend, _config->FindFile("Dir::Etc::sourcelist"), false);
+    pk_backend_watch_sources(backend, _config->FindDir("Dir::Etc::sourceparts"), true);
+    pk_backend_watch_sources(backend, _config->FindFile("Dir::Etc::vendorlist"), false);
+
     spawn = pk_backend_spawn_new(conf);
     //     pk_backend_spawn_set_job(spawn, backend);
     pk_backend_spawn_set_name(spawn, "aptcc");
@@ -91,6 +226,14 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 void pk_backend_destroy(PkBackend *backend)
 {
     g_debug("APTcc being destroyed");
+    AptCacheFile::invalidateShared();
+
+    for (GFileMonitor *monitor : sourcesMonitors) {
+        g_object_unref(monitor);
+    }
+    sourcesMonitors.clear();
+    delete sharedSources;
+    sharedSources = nullptr;
 }
 
 PkBitfield pk_backend_get_groups(PkBackend *backend)
@@ -560,10 +703,28 @@ void pk_backend_download_packages(PkBackend *backend,
     pk_backend_job_thread_create(job, pk_backend_download_packages_thread, NULL, NULL);
 }
 
+/* apt only touches the lists that changed, so keep our own stamp */
+static std::string pk_backend_refresh_stamp_filename()
+{
+    return _config->FindDir("Dir::Cache") + "packagekit-refresh.stamp";
+}
+
 static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
 {
+    gboolean force;
+    GStatBuf st;
+
+    g_variant_get(params, "(b)", &force);
     pk_backend_job_set_allow_cancel(job, true);
 
+    // skip opening the cache if the lists are recent enough
+    const std::string stamp = pk_backend_refresh_stamp_filename();
+    if (!force && g_stat(stamp.c_str(), &st) == 0 &&
+        pk_backend_job_is_cache_fresh(job, st.st_mtime)) {
+        g_debug("package lists are younger than the cache age");
+        return;
+    }
+
     AptIntf *apt = static_cast<AptIntf*>(pk_backend_job_get_user_data(job));
     if (!apt->init()) {
         g_debug("Failed to create apt cache");
@@ -576,6 +737,18 @@ static void pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params,
         
         if (_error->PendingError() == true) {
             show_errors(job, PK_ERROR_ENUM_CANNOT_FETCH_SOURCES, true);
+        } else {
+            if (!g_file_set_contents(stamp.c_str(), "", 0, NULL)) {
+                g_debug("failed to write %s", stamp.c_str());
+            }
+
+            // the cache opened for the refresh is from before the new lists
+            AptCacheFile cache(job);
+            if (cache.Open(false)) {
+                cache.buildDescriptionCaches();
+            } else {
+                _error->Discard();
+            }
         }
     } else {
         pk_backend_job_error_code(job,
@@ -636,11 +809,9 @@ static void pk_backend_search_files_thread(PkBackendJob *job, GVariant *params,
         }
 
         pk_backend_job_set_status(job, PK_STATUS_ENUM_QUERY);
-        PkgList output;
-        output = apt->searchPackageFiles(search);
-
-        // It's faster to emit the packages here rather than in the matching part
-        apt->emitPackages(output, filters);
+        PkgEmitter output(apt, filters);
+        apt->searchPackageFiles(output, search);
+        output.finish();
     }
 }
 
@@ -664,10 +835,9 @@ static void backend_search_groups_thread(PkBackendJob *job, GVariant *params, gp
         return;
     }
 
-    // It's faster to emit the packages here rather than in the matching part
-    PkgList output;
-    output = apt->getPackagesFromGroup(search);
-    apt->emitPackages(output, filters);
+    PkgEmitter output(apt, filters);
+    apt->getPackagesFromGroup(output, search);
+    output.finish();
 
     pk_backend_job_set_percentage(job, 100);
 }
@@ -708,16 +878,15 @@ static void backend_search_package_thread(PkBackendJob *job, GVariant *params, g
     pk_backend_job_set_percentage(job, PK_BACKEND_PERCENTAGE_INVALID);
     pk_backend_job_set_allow_cancel(job, true);
 
-    PkgList output;
+    // the packages are emitted as they are found
+    PkgEmitter output(apt, filters);
     role = pk_backend_job_get_role(job);
     if (role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-        output = apt->searchPackageDetails(queries);
+        apt->searchPackageDetails(output, queries);
     } else {
-        output = apt->searchPackageName(queries);
+        apt->searchPackageName(output, queries);
     }
-
-    // It's faster to emit the packages here than in the matching part
-    apt->emitPackages(output, filters);
+    output.finish();
 
     pk_backend_job_set_percentage(job, 100);
 }
@@ -889,18 +1058,13 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
                        &enabled);
     }
 
-    SourcesList sourcesList;
-    if (sourcesList.ReadSources() == false) {
-        _error->
-                Warning("Ignoring invalid record(s) in sources.list file!");
-        //return false;
-    }
-
-    if (sourcesList.ReadVendors() == false) {
+    SourcesListLocker locker;
+    if (locker.get() == nullptr) {
         _error->Error("Cannot read vendors.list file");
         show_errors(job, PK_ERROR_ENUM_FAILED_CONFIG_PARSING);
         return;
     }
+    SourcesList &sourcesList = *locker.get();
 
     for (SourcesList::SourceRecord *souceRecord : sourcesList.SourceRecords) {
 
@@ -935,6 +1099,7 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
                 } else {
                     souceRecord->Type |= SourcesList::Disabled;
                 }
+                locker.setModified();
 
                 // Commit changes
                 if (!sourcesList.UpdateSources()) {
@@ -970,6 +1135,7 @@ static void backend_repo_manager_thread(PkBackendJob *job, GVariant *params, gpo
                 // Now if we are not simulating remove the repository
                 if (!pk_bitfield_contain(transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE)) {
                     sourcesList.RemoveSource(souceRecord);
+                    locker.setModified();
 
                     // Commit changes
                     if (!sourcesList.UpdateSources()) {
@@ -1024,11 +1190,9 @@ static void backend_get_packages_thread(PkBackendJob *job, GVariant *params, gpo
         return;
     }
 
-    PkgList output;
-    output = apt->getPackages();
-
-    // It's faster to emit the packages rather here than in the matching part
-    apt->emitPackages(output, filters);
+    PkgEmitter output(apt, filters);
+    apt->getPackages(output);
+    output.finish();
 }
 
 void pk_backend_get_packages(PkBackend *backend, PkBackendJob *job, PkBitfield filters)
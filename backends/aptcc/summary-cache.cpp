@@ -0,0 +1,157 @@
+/* summary-cache.cpp
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "summary-cache.h"
+
+#include <cstring>
+#include <vector>
+
+#define SUMMARY_CACHE_MAGIC "PKAPTSC1"
+
+/* the summary has not been read yet */
+#define SUMMARY_CACHE_UNKNOWN G_MAXUINT32
+
+namespace {
+
+/* the file is the header, one offset into the strings for each version
+ * ID and then the strings */
+struct Header {
+    char magic[8];
+    guint32 nVersions;
+    guint32 stringsSize;
+    gint64 cacheMtime;
+    char languages[64];
+};
+
+}
+
+SummaryCache::SummaryCache() :
+    m_mapped(nullptr),
+    m_offsets(nullptr),
+    m_strings(nullptr),
+    m_nVersions(0),
+    m_stringsSize(0)
+{
+}
+
+SummaryCache::~SummaryCache()
+{
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+    }
+}
+
+bool SummaryCache::load(const std::string &filename, gint64 cacheMtime,
+                        const std::string &languages, guint32 nVersions)
+{
+    g_autoptr(GError) error = nullptr;
+
+    GMappedFile *mapped = g_mapped_file_new(filename.c_str(), FALSE, &error);
+    if (mapped == nullptr) {
+        g_debug("Failed to map %s: %s", filename.c_str(), error->message);
+        return false;
+    }
+
+    const char *contents = g_mapped_file_get_contents(mapped);
+    gsize length = g_mapped_file_get_length(mapped);
+    const Header *header = reinterpret_cast<const Header *>(contents);
+    bool valid = contents != nullptr && length >= sizeof(Header) &&
+            memcmp(header->magic, SUMMARY_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+            header->cacheMtime == cacheMtime &&
+            header->nVersions == nVersions &&
+            languages.compare(0, sizeof(header->languages) - 1, header->languages) == 0 &&
+            length == sizeof(Header) + (guint64) nVersions * sizeof(guint32) + header->stringsSize &&
+            (header->stringsSize == 0 || contents[length - 1] == '\0');
+    if (!valid) {
+        g_debug("Ignoring out of date summary cache %s", filename.c_str());
+        g_mapped_file_unref(mapped);
+        return false;
+    }
+
+    if (m_mapped != nullptr) {
+        g_mapped_file_unref(m_mapped);
+    }
+    m_mapped = mapped;
+    m_offsets = reinterpret_cast<const guint32 *>(contents + sizeof(Header));
+    m_strings = reinterpret_cast<const char *>(m_offsets + nVersions);
+    m_nVersions = nVersions;
+    m_stringsSize = header->stringsSize;
+    return true;
+}
+
+const char *SummaryCache::lookup(guint32 id) const
+{
+    auto it = m_added.find(id);
+    if (it != m_added.end()) {
+        return it->second.c_str();
+    }
+
+    // never trust an offset from the file
+    if (id >= m_nVersions || m_offsets[id] >= m_stringsSize) {
+        return nullptr;
+    }
+    return m_strings + m_offsets[id];
+}
+
+void SummaryCache::add(guint32 id, const std::string &summary)
+{
+    m_added[id] = summary;
+}
+
+bool SummaryCache::save(const std::string &filename, gint64 cacheMtime,
+                        const std::string &languages, guint32 nVersions)
+{
+    g_autoptr(GError) error = nullptr;
+    std::vector<guint32> offsets(nVersions, SUMMARY_CACHE_UNKNOWN);
+    std::string strings;
+
+    if (m_added.empty() || filename.empty()) {
+        return true;
+    }
+
+    for (guint32 id = 0; id < nVersions; id++) {
+        const char *summary = lookup(id);
+        if (summary == nullptr) {
+            continue;
+        }
+        offsets[id] = strings.size();
+        strings.append(summary).push_back('\0');
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SUMMARY_CACHE_MAGIC, sizeof(header.magic));
+    header.nVersions = nVersions;
+    header.stringsSize = strings.size();
+    header.cacheMtime = cacheMtime;
+    g_strlcpy(header.languages, languages.c_str(), sizeof(header.languages));
+
+    std::string data;
+    data.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(guint32));
+    data.append(strings);
+    if (!g_file_set_contents(filename.c_str(), data.data(), data.size(), &error)) {
+        g_warning("Failed to write %s: %s", filename.c_str(), error->message);
+        return false;
+    }
+    m_added.clear();
+    return load(filename, cacheMtime, languages, nVersions);
+}
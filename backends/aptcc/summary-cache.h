@@ -0,0 +1,74 @@
+/* summary-cache.h
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SUMMARY_CACHE_H
+#define SUMMARY_CACHE_H
+
+#include <glib.h>
+
+#include <string>
+#include <unordered_map>
+
+/**
+ * The short descriptions of the versions in the apt cache, by version ID,
+ * so listing packages does not have to read a record for each of them.
+ *
+ * Like the details index it is only valid for the package cache and the
+ * languages it was written for. It is filled in as summaries are read, so
+ * a version missing from it is not an error.
+ */
+class SummaryCache
+{
+public:
+    SummaryCache();
+    ~SummaryCache();
+
+    /**
+      * Maps a previously saved cache, returning false if it is missing
+      * or was written for another cache
+      */
+    bool load(const std::string &filename, gint64 cacheMtime,
+              const std::string &languages, guint32 nVersions);
+
+    /**
+      * Returns the summary of the version, or nullptr if it is not known
+      */
+    const char *lookup(guint32 id) const;
+
+    void add(guint32 id, const std::string &summary);
+
+    /**
+      * Writes the loaded and the added summaries to @filename, if
+      * anything was added
+      */
+    bool save(const std::string &filename, gint64 cacheMtime,
+              const std::string &languages, guint32 nVersions);
+
+private:
+    GMappedFile *m_mapped;
+    const guint32 *m_offsets;
+    const char *m_strings;
+    guint32 m_nVersions;
+    guint32 m_stringsSize;
+    std::unordered_map<guint32, std::string> m_added;
+};
+
+#endif // SUMMARY_CACHE_H
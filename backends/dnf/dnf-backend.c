@@ -29,23 +29,31 @@
 
 #include "dnf-backend.h"
 
-void
-dnf_emit_package (PkBackendJob *job, PkInfoEnum info, DnfPackage *pkg)
+static PkInfoEnum
+dnf_emit_package_get_info (PkInfoEnum info, DnfPackage *pkg)
 {
-	PkInfoEnum update_severity;
-
-	update_severity = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (pkg), PK_DNF_UPDATE_SEVERITY_KEY));
-
 	/* detect */
 	if (info == PK_INFO_ENUM_UNKNOWN)
 		info = dnf_package_get_info (pkg);
 	if (info == PK_INFO_ENUM_UNKNOWN)
 		info = dnf_package_installed (pkg) ? PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_AVAILABLE;
+	return info;
+}
+
+static PkInfoEnum
+dnf_emit_package_get_update_severity (DnfPackage *pkg)
+{
+	return GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (pkg), PK_DNF_UPDATE_SEVERITY_KEY));
+}
+
+void
+dnf_emit_package (PkBackendJob *job, PkInfoEnum info, DnfPackage *pkg)
+{
 	pk_backend_job_package_full (job,
-				     info,
+				     dnf_emit_package_get_info (info, pkg),
 				     dnf_package_get_package_id (pkg),
 				     dnf_package_get_summary (pkg),
-				     update_severity);
+				     dnf_emit_package_get_update_severity (pkg));
 }
 
 void
@@ -55,11 +63,28 @@ dnf_emit_package_list (PkBackendJob *job,
 {
 	guint i;
 	DnfPackage *pkg;
+	g_autoptr(GPtrArray) items = NULL;
 
+	/* hand the whole list to the daemon in one go */
+	items = g_ptr_array_new_full (pkglist->len, g_object_unref);
 	for (i = 0; i < pkglist->len; i++) {
+		PkPackage *item;
+		g_autoptr(GError) error = NULL;
+
 		pkg = g_ptr_array_index (pkglist, i);
-		dnf_emit_package (job, info, pkg);
+		item = pk_package_new_full (dnf_emit_package_get_info (info, pkg),
+					    dnf_package_get_package_id (pkg),
+					    dnf_package_get_summary (pkg),
+					    dnf_emit_package_get_update_severity (pkg),
+					    PK_ROLE_ENUM_UNKNOWN, NULL, &error);
+		if (item == NULL) {
+			g_warning ("package_id %s invalid and cannot be processed: %s",
+				   dnf_package_get_package_id (pkg), error->message);
+			continue;
+		}
+		g_ptr_array_add (items, item);
 	}
+	pk_backend_job_packages (job, items);
 }
 
 void
@@ -67,13 +92,7 @@ dnf_emit_package_array (PkBackendJob *job,
 			 PkInfoEnum info,
 			 GPtrArray *array)
 {
-	guint i;
-	DnfPackage *pkg;
-
-	for (i = 0; i < array->len; i++) {
-		pkg = g_ptr_array_index (array, i);
-		dnf_emit_package (job, info, pkg);
-	}
+	dnf_emit_package_list (job, info, array);
 }
 
 void
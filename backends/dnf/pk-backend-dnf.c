@@ -24,7 +24,9 @@
 #include <gmodule.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 #include <appstream-glib.h>
 
 #include <pk-backend.h>
@@ -42,6 +44,8 @@
 #include <libdnf/hy-util.h>
 #include <librepo/librepo.h>
 #include <rpm/rpmlib.h>
+#include <rpm/rpmmacro.h>
+#include <rpm/rpmts.h>
 
 #include "dnf-backend-vendor.h"
 #include "dnf-backend.h"
@@ -50,15 +54,33 @@ typedef struct {
 	DnfSack		*sack;
 	gboolean	 valid;
 	gchar		*key;
+	DnfSackAddFlags	 flags;
+	DnfContext	*context;
+	gint64		 invalidated;
+	gchar		*rpmdb_cookie;	/* installed-only sacks */
 } DnfSackCacheItem;
 
 typedef struct {
 	GKeyFile	*conf;
 	DnfContext	*context;
+	GHashTable	*root_contexts;	/* root:DnfContext */
 	GHashTable	*sack_cache;	/* of DnfSackCacheItem */
 	GMutex		 sack_mutex;
+	GCond		 sack_cond;
+	GMutex		 context_mutex;	/* held by any thread using the cached sacks or the context */
+	guint		 sack_generation;
+	gboolean	 sack_rebuilding;
+	guint		 sack_rebuild_id;
+	gint		 jobs_running;
 	GTimer		*repos_timer;
 	gchar		*release_ver;
+	GThreadPool	*appstream_pool;	/* of DnfRepo */
+	GMutex		 appstream_mutex;
+	GCond		 appstream_cond;
+	guint		 appstream_pending;	/* repos queued or being copied */
+#if GLIB_CHECK_VERSION(2, 64, 0)
+	GMemoryMonitor	*memory_monitor;
+#endif
 } PkBackendDnfPrivate;
 
 typedef struct {
@@ -88,6 +110,36 @@ pk_backend_supports_parallelization (PkBackend *backend)
 	return FALSE;
 }
 
+gboolean
+pk_backend_supports_roots (PkBackend *backend)
+{
+	return TRUE;
+}
+
+gboolean
+pk_backend_watches_repos (PkBackend *backend)
+{
+	/* the repo loader signals changes to yum.repos.d */
+	return TRUE;
+}
+
+static gboolean pk_backend_sack_cache_rebuild_cb (gpointer user_data);
+
+/*
+ * pk_backend_context_lock:
+ *
+ * libdnf does not make a DnfSack or DnfContext safe to use from more
+ * than one thread: even a query loads repodata into the pool on demand.
+ * The jobs run one at a time, so this is only taken against the threads
+ * the backend runs in the background.
+ */
+static GMutexLocker *
+pk_backend_context_lock (PkBackend *backend)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	return g_mutex_locker_new (&priv->context_mutex);
+}
+
 static void
 pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
 {
@@ -97,16 +149,70 @@ pk_backend_sack_cache_invalidate (PkBackend *backend, const gchar *why)
 	g_autoptr(GList) values = NULL;
 	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
 
-	/* set all the cached sacks as invalid */
+	/* set all the cached sacks as invalid, but keep them around so that
+	 * callers happy with slightly stale data can use them until the
+	 * background rebuild has finished */
+	priv->sack_generation++;
 	values = g_hash_table_get_values (priv->sack_cache);
 	for (l = values; l != NULL; l = l->next) {
 		cache_item = l->data;
 		if (cache_item->valid) {
 			g_debug ("invalidating %s as %s", cache_item->key, why);
 			cache_item->valid = FALSE;
+			cache_item->invalidated = g_get_monotonic_time ();
+		}
+	}
+
+	/* rebuild once things have settled down */
+	if (values != NULL && priv->sack_rebuild_id == 0) {
+		priv->sack_rebuild_id =
+			g_timeout_add_seconds_full (G_PRIORITY_LOW, 2,
+						    pk_backend_sack_cache_rebuild_cb,
+						    backend, NULL);
+	}
+}
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+static void
+pk_backend_low_memory_warning_cb (GMemoryMonitor *monitor,
+				  GMemoryMonitorWarningLevel level,
+				  PkBackend *backend)
+{
+	GList *l;
+	DnfSackCacheItem *cache_item;
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	gboolean dropped = FALSE;
+	g_autoptr(GList) values = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+
+	/* libdnf can't unload repodata, so rebuild the cached sacks without
+	 * the filelists; the jobs using them keep their own reference */
+	values = g_hash_table_get_values (priv->sack_cache);
+	for (l = values; l != NULL; l = l->next) {
+		cache_item = l->data;
+		if ((cache_item->flags & DNF_SACK_ADD_FLAG_FILELISTS) == 0)
+			continue;
+		g_debug ("dropping the filelists of %s as memory is low", cache_item->key);
+		cache_item->flags &= ~DNF_SACK_ADD_FLAG_FILELISTS;
+		if (cache_item->valid) {
+			cache_item->valid = FALSE;
+			cache_item->invalidated = g_get_monotonic_time ();
 		}
+		dropped = TRUE;
+	}
+	if (!dropped)
+		return;
+
+	/* a rebuild under way would put the filelists back */
+	priv->sack_generation++;
+	if (priv->sack_rebuild_id == 0) {
+		priv->sack_rebuild_id =
+			g_timeout_add_seconds_full (G_PRIORITY_LOW, 2,
+						    pk_backend_sack_cache_rebuild_cb,
+						    backend, NULL);
 	}
 }
+#endif
 
 static void
 pk_backend_yum_repos_changed_cb (DnfRepoLoader *repo_loader, PkBackend *backend)
@@ -119,6 +225,8 @@ static void
 dnf_sack_cache_item_free (DnfSackCacheItem *cache_item)
 {
 	g_object_unref (cache_item->sack);
+	g_object_unref (cache_item->context);
+	g_free (cache_item->rpmdb_cookie);
 	g_free (cache_item->key);
 	g_slice_free (DnfSackCacheItem, cache_item);
 }
@@ -132,8 +240,12 @@ pk_backend_context_invalidate_cb (DnfContext *context,
 	pk_backend_installed_db_changed (backend);
 }
 
+/*
+ * A context for another root only installs into it and reads its rpmdb,
+ * the repos, metadata, solv files and downloads are the ones of DestDir.
+ */
 static gboolean
-pk_backend_setup_dnf_context (DnfContext *context, GKeyFile *conf, const gchar *release_ver, GError **error)
+pk_backend_setup_dnf_context (DnfContext *context, GKeyFile *conf, const gchar *root, const gchar *release_ver, GError **error)
 {
 	const gchar * const *repo_dirs;
 	const gchar * const *var_dirs;
@@ -146,12 +258,12 @@ pk_backend_setup_dnf_context (DnfContext *context, GKeyFile *conf, const gchar *
 	destdir = g_key_file_get_string (conf, "Daemon", "DestDir", NULL);
 	if (destdir == NULL)
 		destdir = g_strdup ("/");
-	dnf_context_set_install_root (context, destdir);
+	dnf_context_set_install_root (context, root != NULL ? root : destdir);
 	cache_dir = g_build_filename (destdir, "/var/cache/PackageKit", release_ver, "metadata", NULL);
 	dnf_context_set_cache_dir (context, cache_dir);
 	solv_dir = g_build_filename (destdir, "/var/cache/PackageKit", release_ver, "hawkey", NULL);
 	dnf_context_set_solv_dir (context, solv_dir);
-	lock_dir = g_build_filename (destdir, "/var/run", NULL);
+	lock_dir = g_build_filename (root != NULL ? root : destdir, "/var/run", NULL);
 	dnf_context_set_lock_dir (context, lock_dir);
 	dnf_context_set_rpm_verbosity (context, "info");
 
@@ -185,6 +297,14 @@ pk_backend_setup_dnf_context (DnfContext *context, GKeyFile *conf, const gchar *
 	keep_cache = g_key_file_get_boolean (conf, "Daemon", "KeepCache", NULL);
 	dnf_context_set_keep_cache (context, keep_cache);
 
+	/* only fetch the chunks of the metadata that changed, for the repos
+	 * that publish zchunk files */
+	if (!g_key_file_has_key (conf, "Dnf", "ZchunkMetadata", NULL) ||
+	    g_key_file_get_boolean (conf, "Dnf", "ZchunkMetadata", NULL))
+		dnf_context_set_zchunk (context, TRUE);
+	else
+		dnf_context_set_zchunk (context, FALSE);
+
 	/* set up context */
 	return dnf_context_setup (context, NULL, error);
 }
@@ -254,7 +374,7 @@ pk_backend_ensure_default_dnf_context (PkBackend *backend, GError **error)
 
 	/* set defaults */
 	context = dnf_context_new ();
-	if (!pk_backend_setup_dnf_context (context, priv->conf, priv->release_ver, error))
+	if (!pk_backend_setup_dnf_context (context, priv->conf, NULL, priv->release_ver, error))
 		return FALSE;
 
 	/* setup succeeded: store in priv and connect signals */
@@ -267,6 +387,29 @@ pk_backend_ensure_default_dnf_context (PkBackend *backend, GError **error)
 	return TRUE;
 }
 
+/* the default context, and the one for the root of the job if it has one */
+static gboolean
+pk_backend_ensure_dnf_context (PkBackend *backend, PkBackendJob *job, GError **error)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	const gchar *root = pk_backend_job_get_root (job);
+	g_autoptr(DnfContext) context = NULL;
+
+	if (!pk_backend_ensure_default_dnf_context (backend, error))
+		return FALSE;
+	if (root == NULL || g_hash_table_contains (priv->root_contexts, root))
+		return TRUE;
+
+	g_debug ("setting up a context for %s", root);
+	context = dnf_context_new ();
+	if (!pk_backend_setup_dnf_context (context, priv->conf, root, priv->release_ver, error))
+		return FALSE;
+	g_signal_connect (context, "invalidate",
+			  G_CALLBACK (pk_backend_context_invalidate_cb), backend);
+	g_hash_table_insert (priv->root_contexts, g_strdup (root), g_steal_pointer (&context));
+	return TRUE;
+}
+
 void
 pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 {
@@ -303,30 +446,69 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	 *
 	 * notes:
 	 * - this deals with deallocating the sack when the backend is unloaded
-	 * - all the cached sacks are dropped on any transaction that can
-	 *   modify state or if the repos or rpmdb are changed
+	 * - all the cached sacks are invalidated on any transaction that can
+	 *   modify state or if the repos or rpmdb are changed, and rebuilt in
+	 *   the background once no jobs are running
 	 */
 	g_mutex_init (&priv->sack_mutex);
+	g_mutex_init (&priv->context_mutex);
+	g_cond_init (&priv->sack_cond);
+
+	/* the AppStream data is copied out after a refresh, without making
+	 * the RefreshCache job wait for it */
+	g_mutex_init (&priv->appstream_mutex);
+	g_cond_init (&priv->appstream_cond);
+	priv->appstream_pool = g_thread_pool_new (pk_backend_refresh_appstream_worker,
+						  priv, 2, FALSE, NULL);
 	priv->sack_cache = g_hash_table_new_full (g_str_hash,
 						  g_str_equal,
 						  g_free,
 						  (GDestroyNotify) dnf_sack_cache_item_free);
+	priv->root_contexts = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, g_object_unref);
 
 	if (!pk_backend_ensure_default_dnf_context (backend, &error))
 		g_warning ("failed to setup context: %s", error->message);
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+	priv->memory_monitor = g_memory_monitor_dup_default ();
+	g_signal_connect (priv->memory_monitor, "low-memory-warning",
+			  G_CALLBACK (pk_backend_low_memory_warning_cb), backend);
+#endif
 }
 
 void
 pk_backend_destroy (PkBackend *backend)
 {
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+
+#if GLIB_CHECK_VERSION(2, 64, 0)
+	g_signal_handlers_disconnect_by_data (priv->memory_monitor, backend);
+	g_object_unref (priv->memory_monitor);
+#endif
+
+	/* the rebuild thread uses the context and the cache */
+	g_mutex_lock (&priv->sack_mutex);
+	if (priv->sack_rebuild_id != 0)
+		g_source_remove (priv->sack_rebuild_id);
+	while (priv->sack_rebuilding)
+		g_cond_wait (&priv->sack_cond, &priv->sack_mutex);
+	g_mutex_unlock (&priv->sack_mutex);
+
+	g_thread_pool_free (priv->appstream_pool, FALSE, TRUE);
+	g_mutex_clear (&priv->appstream_mutex);
+	g_cond_clear (&priv->appstream_cond);
+
 	if (priv->conf != NULL)
 		g_key_file_unref (priv->conf);
 	if (priv->context != NULL)
 		g_object_unref (priv->context);
 	g_timer_destroy (priv->repos_timer);
-	g_mutex_clear (&priv->sack_mutex);
 	g_hash_table_unref (priv->sack_cache);
+	g_hash_table_unref (priv->root_contexts);
+	g_cond_clear (&priv->sack_cond);
+	g_mutex_clear (&priv->sack_mutex);
+	g_mutex_clear (&priv->context_mutex);
 	g_free (priv->release_ver);
 	g_free (priv);
 }
@@ -449,6 +631,13 @@ pk_backend_job_set_context (PkBackendJob *job, DnfContext *context)
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	const gchar *value;
 
+	/* set up by pk_backend_ensure_dnf_context() */
+	if (pk_backend_job_get_root (job) != NULL) {
+		PkBackendDnfPrivate *priv = pk_backend_get_user_data (job_data->backend);
+		context = g_hash_table_lookup (priv->root_contexts, pk_backend_job_get_root (job));
+		g_assert (context != NULL);
+	}
+
 	/* DnfContext */
 	g_set_object (&job_data->context, context);
 
@@ -472,9 +661,11 @@ void
 pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 {
 	PkBackendDnfJobData *job_data;
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	job_data = g_new0 (PkBackendDnfJobData, 1);
 	job_data->backend = backend;
 	pk_backend_job_set_user_data (job, job_data);
+	g_atomic_int_inc (&priv->jobs_running);
 
 	/* DnfState */
 	job_data->state = dnf_state_new ();
@@ -506,7 +697,9 @@ void
 pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 {
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 
+	g_atomic_int_add (&priv->jobs_running, -1);
 	if (job_data->state != NULL) {
 		dnf_state_release_locks (job_data->state);
 		g_object_unref (job_data->state);
@@ -521,10 +714,60 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 	pk_backend_job_set_user_data (job, NULL);
 }
 
+static const gchar *as_basenames[] = { "appstream", "appstream-icons", NULL };
+
+/* what repomd.xml says about the AppStream data, or NULL if it has none */
+static gchar *
+dnf_utils_get_appstream_checksum (DnfRepo *repo)
+{
+	LrYumRepoMd *repomd;
+	gint fd;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) checksum = g_string_new (NULL);
+
+	filename = g_build_filename (dnf_repo_get_location (repo),
+				     "repodata", "repomd.xml", NULL);
+	fd = g_open (filename, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	repomd = lr_yum_repomd_init ();
+	if (lr_yum_repomd_parse_file (repomd, fd, NULL, NULL, &error)) {
+		for (guint i = 0; as_basenames[i] != NULL; i++) {
+			LrYumRepoMdRecord *rec = lr_yum_repomd_get_record (repomd, as_basenames[i]);
+			if (rec != NULL && rec->checksum != NULL)
+				g_string_append_printf (checksum, "%s %s\n", as_basenames[i], rec->checksum);
+		}
+	} else {
+		g_debug ("failed to parse %s: %s", filename, error->message);
+	}
+	lr_yum_repomd_free (repomd);
+	close (fd);
+
+	if (checksum->len == 0)
+		return NULL;
+	return g_string_free (g_steal_pointer (&checksum), FALSE);
+}
+
 static gboolean
 dnf_utils_refresh_repo_appstream (DnfRepo *repo, GError **error)
 {
-	const gchar *as_basenames[] = { "appstream", "appstream-icons", NULL };
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *checksum_old = NULL;
+	g_autofree gchar *stamp = NULL;
+
+	/* extracting the icons is slow, so skip it when the data is the same
+	 * as last time; cleaning the repo removes the stamp too */
+	stamp = g_build_filename (dnf_repo_get_location (repo),
+				  "packagekit-appstream.checksum", NULL);
+	checksum = dnf_utils_get_appstream_checksum (repo);
+	if (checksum != NULL &&
+	    g_file_get_contents (stamp, &checksum_old, NULL, NULL) &&
+	    g_strcmp0 (checksum, checksum_old) == 0) {
+		g_debug ("AppStream data of %s is unchanged", dnf_repo_get_id (repo));
+		return TRUE;
+	}
+
 	for (guint i = 0; as_basenames[i] != NULL; i++) {
 		const gchar *tmp = dnf_repo_get_filename_md (repo, as_basenames[i]);
 		if (tmp != NULL) {
@@ -541,17 +784,58 @@ dnf_utils_refresh_repo_appstream (DnfRepo *repo, GError **error)
 #endif
 		}
 	}
+
+	if (checksum != NULL)
+		return g_file_set_contents (stamp, checksum, -1, error);
 	return TRUE;
 }
 
+static void
+pk_backend_refresh_appstream_worker (gpointer data, gpointer user_data)
+{
+	DnfRepo *repo = data;
+	PkBackendDnfPrivate *priv = user_data;
+	g_autoptr(GError) error = NULL;
+
+	if (!dnf_utils_refresh_repo_appstream (repo, &error)) {
+		g_warning ("failed to install the AppStream metadata of %s: %s",
+			   dnf_repo_get_id (repo), error->message);
+	}
+	g_object_unref (repo);
+
+	g_mutex_lock (&priv->appstream_mutex);
+	if (--priv->appstream_pending == 0)
+		g_cond_broadcast (&priv->appstream_cond);
+	g_mutex_unlock (&priv->appstream_mutex);
+}
+
+static void
+pk_backend_refresh_appstream_queue (PkBackendDnfPrivate *priv, DnfRepo *repo)
+{
+	g_mutex_lock (&priv->appstream_mutex);
+	priv->appstream_pending++;
+	g_mutex_unlock (&priv->appstream_mutex);
+	g_thread_pool_push (priv->appstream_pool, g_object_ref (repo), NULL);
+}
+
+/* the copies read the repo directories that a refresh cleans and updates */
+static void
+pk_backend_refresh_appstream_wait (PkBackendDnfPrivate *priv)
+{
+	g_mutex_lock (&priv->appstream_mutex);
+	while (priv->appstream_pending > 0)
+		g_cond_wait (&priv->appstream_cond, &priv->appstream_mutex);
+	g_mutex_unlock (&priv->appstream_mutex);
+}
+
 static gboolean
-dnf_utils_add_remote (PkBackendJob *job,
+dnf_utils_add_remote (DnfContext *context,
+		      guint cache_age,
 		      DnfSack *sack,
 		      DnfSackAddFlags flags,
 		      DnfState *state,
 		      GError **error)
 {
-	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	gboolean ret;
 	DnfState *state_local;
 	g_autoptr(GPtrArray) repos = NULL;
@@ -565,7 +849,7 @@ dnf_utils_add_remote (PkBackendJob *job,
 		return FALSE;
 
 	/* ask the context's repo loader for new repos, forcing it to reload them */
-	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (job_data->context), error);
+	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (context), error);
 	if (repos == NULL)
 		return FALSE;
 
@@ -577,7 +861,7 @@ dnf_utils_add_remote (PkBackendJob *job,
 	state_local = dnf_state_get_child (state);
 	ret = dnf_sack_add_repos (sack,
 	                          repos,
-	                          pk_backend_job_get_cache_age (job),
+	                          cache_age,
 	                          flags,
 	                          state_local,
 	                          error);
@@ -591,16 +875,49 @@ dnf_utils_add_remote (PkBackendJob *job,
 }
 
 typedef enum {
-	DNF_CREATE_SACK_FLAG_NONE,
-	DNF_CREATE_SACK_FLAG_USE_CACHE,
+	DNF_CREATE_SACK_FLAG_NONE	= 0,
+	DNF_CREATE_SACK_FLAG_USE_CACHE	= 1 << 0,
+	DNF_CREATE_SACK_FLAG_FILELISTS	= 1 << 1,
 	DNF_CREATE_SACK_FLAG_LAST
 } DnfCreateSackFlags;
 
+/* createrepo puts these in primary.xml as well, as most file requires
+ * are on them, so they can be found without the filelists */
+static gboolean
+dnf_utils_path_is_in_primary (const gchar *path)
+{
+	return g_str_has_prefix (path, "/etc/") ||
+		g_strcmp0 (path, "/usr/lib/sendmail") == 0 ||
+		strstr (path, "bin/") != NULL;
+}
+
+static gboolean
+dnf_utils_paths_need_filelists (gchar **values)
+{
+	for (guint i = 0; values[i] != NULL; i++) {
+		if (values[i][0] == '/' && !dnf_utils_path_is_in_primary (values[i]))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* filelists and updateinfo only add metadata to the packages already in the
+ * sack, so a sack carrying them can serve queries that did not ask for them */
+#define DNF_SACK_ADD_FLAGS_LAYERED	(DNF_SACK_ADD_FLAG_FILELISTS | \
+					 DNF_SACK_ADD_FLAG_UPDATEINFO)
+
+/* the severity of updates is left out with less time than this left
+ * before the deadline of the client, as loading updateinfo is slow */
+#define DNF_UPDATEINFO_BUDGET_MS	2000
+
 static gchar *
 dnf_utils_create_cache_key (const gchar *release_ver, DnfSackAddFlags flags)
 {
 	GString *key;
 
+	/* one canonical sack per package set, whatever metadata it carries */
+	flags &= ~DNF_SACK_ADD_FLAGS_LAYERED;
+
 	key = g_string_new ("DnfSack::");
 	g_string_append_printf (key, "release_ver[%s]::", release_ver);
 
@@ -639,6 +956,235 @@ dnf_utils_real_path (const gchar *path)
 	return real;
 }
 
+/* cheaper than libdnf's cookie, which reads every header in the rpmdb */
+static gchar *
+dnf_utils_get_rpmdb_cookie (DnfContext *context)
+{
+	const gchar *fn;
+	char *dbpath;
+	GString *cookie;
+	g_autofree gchar *path = NULL;
+	g_autoptr(GDir) dir = NULL;
+
+	dbpath = rpmExpand ("%{_dbpath}", NULL);
+	path = g_build_filename (dnf_context_get_install_root (context), dbpath, NULL);
+	free (dbpath);
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return NULL;
+
+	cookie = g_string_new (NULL);
+	while ((fn = g_dir_read_name (dir)) != NULL) {
+		GStatBuf buf;
+		g_autofree gchar *full = g_build_filename (path, fn, NULL);
+
+		if (g_stat (full, &buf) != 0 || !S_ISREG (buf.st_mode))
+			continue;
+		g_string_append_printf (cookie, "%s:%" G_GINT64_FORMAT ".%ld:%" G_GINT64_FORMAT ";",
+					fn,
+					(gint64) buf.st_mtim.tv_sec,
+					(glong) buf.st_mtim.tv_nsec,
+					(gint64) buf.st_size);
+	}
+	return g_string_free (cookie, FALSE);
+}
+
+static DnfSack *
+dnf_utils_build_sack (DnfContext *context,
+		      DnfSackAddFlags flags,
+		      guint cache_age,
+		      DnfState *state,
+		      GError **error)
+{
+	gboolean ret;
+	DnfState *state_local;
+	g_autofree gchar *install_root = NULL;
+	g_autofree gchar *solv_dir = NULL;
+	g_autoptr(DnfSack) sack = NULL;
+
+	/* set state */
+	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
+		ret = dnf_state_set_steps (state, error,
+					   8, /* add installed */
+					   92, /* add remote */
+					   -1);
+		if (!ret)
+			return NULL;
+	} else {
+		dnf_state_set_number_steps (state, 1);
+	}
+
+	/* create empty sack */
+	solv_dir = dnf_utils_real_path (dnf_context_get_solv_dir (context));
+	install_root = dnf_utils_real_path (dnf_context_get_install_root (context));
+	sack = dnf_sack_new ();
+	dnf_sack_set_cachedir (sack, solv_dir);
+	dnf_sack_set_rootdir (sack, install_root);
+	ret = dnf_sack_setup (sack, DNF_SACK_SETUP_FLAG_MAKE_CACHE_DIR, error);
+	if (!ret) {
+		g_prefix_error (error, "failed to create sack in %s for %s: ",
+				dnf_context_get_solv_dir (context),
+				dnf_context_get_install_root (context));
+		return NULL;
+	}
+
+	/* add installed packages */
+	ret = dnf_sack_load_system_repo (sack, NULL, DNF_SACK_LOAD_FLAG_BUILD_CACHE, error);
+	if (!ret) {
+		g_prefix_error (error, "Failed to load system repo: ");
+		return NULL;
+	}
+
+	/* done */
+	ret = dnf_state_done (state, error);
+	if (!ret)
+		return NULL;
+
+	/* add remote packages */
+	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
+		state_local = dnf_state_get_child (state);
+		ret = dnf_utils_add_remote (context, cache_age, sack, flags,
+					    state_local, error);
+		if (!ret)
+			return NULL;
+
+		/* done */
+		ret = dnf_state_done (state, error);
+		if (!ret)
+			return NULL;
+	}
+
+	dnf_sack_filter_modules (sack, dnf_context_get_repos (context), install_root, NULL);
+	return g_steal_pointer (&sack);
+}
+
+static void
+pk_backend_sack_cache_rebuild_thread (GTask *task,
+				      gpointer source_object,
+				      gpointer task_data,
+				      GCancellable *cancellable)
+{
+	GList *l;
+	PkBackend *backend = PK_BACKEND (source_object);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	DnfSackCacheItem *cache_item;
+	guint generation;
+	g_autoptr(GList) keys = NULL;
+
+	/* the keys are owned by the hash table, so take copies */
+	g_mutex_lock (&priv->sack_mutex);
+	generation = priv->sack_generation;
+	keys = g_hash_table_get_keys (priv->sack_cache);
+	for (l = keys; l != NULL; l = l->next)
+		l->data = g_strdup (l->data);
+	g_mutex_unlock (&priv->sack_mutex);
+
+	for (l = keys; l != NULL; l = l->next) {
+		const gchar *key = l->data;
+		DnfSackAddFlags flags;
+		g_autofree gchar *rpmdb_cookie = NULL;
+		g_autoptr(DnfContext) context = NULL;
+		DnfState *state;
+		g_autoptr(DnfSack) sack = NULL;
+		g_autoptr(GError) error = NULL;
+
+		g_mutex_lock (&priv->sack_mutex);
+		cache_item = g_hash_table_lookup (priv->sack_cache, key);
+		if (cache_item == NULL || cache_item->valid ||
+		    priv->sack_generation != generation) {
+			g_mutex_unlock (&priv->sack_mutex);
+			continue;
+		}
+		flags = cache_item->flags;
+		context = g_object_ref (cache_item->context);
+		rpmdb_cookie = g_strdup (cache_item->rpmdb_cookie);
+		g_mutex_unlock (&priv->sack_mutex);
+
+		/* installed-only sacks only need rebuilding for rpmdb changes */
+		if (rpmdb_cookie != NULL) {
+			g_autofree gchar *current = dnf_utils_get_rpmdb_cookie (context);
+			if (g_strcmp0 (current, rpmdb_cookie) == 0) {
+				g_mutex_lock (&priv->sack_mutex);
+				cache_item = g_hash_table_lookup (priv->sack_cache, key);
+				if (cache_item != NULL && priv->sack_generation == generation)
+					cache_item->valid = TRUE;
+				g_mutex_unlock (&priv->sack_mutex);
+				continue;
+			}
+			g_free (rpmdb_cookie);
+			rpmdb_cookie = g_steal_pointer (&current);
+		}
+
+		/* the context is shared with the jobs */
+		state = dnf_state_new ();
+		g_mutex_lock (&priv->context_mutex);
+		sack = dnf_utils_build_sack (context, flags, G_MAXUINT, state, &error);
+		g_mutex_unlock (&priv->context_mutex);
+		g_object_unref (state);
+		if (sack == NULL) {
+			g_debug ("failed to rebuild sack %s: %s", key, error->message);
+			continue;
+		}
+
+		/* swap it in unless something changed whilst we were busy */
+		g_mutex_lock (&priv->sack_mutex);
+		cache_item = g_hash_table_lookup (priv->sack_cache, key);
+		if (cache_item != NULL && !cache_item->valid &&
+		    priv->sack_generation == generation) {
+			g_debug ("rebuilt cached sack %s", key);
+			g_object_unref (cache_item->sack);
+			cache_item->sack = g_steal_pointer (&sack);
+			cache_item->valid = TRUE;
+			g_free (cache_item->rpmdb_cookie);
+			cache_item->rpmdb_cookie = g_steal_pointer (&rpmdb_cookie);
+		}
+		g_mutex_unlock (&priv->sack_mutex);
+	}
+	g_list_free_full (g_steal_pointer (&keys), g_free);
+
+	g_mutex_lock (&priv->sack_mutex);
+	priv->sack_rebuilding = FALSE;
+	g_cond_broadcast (&priv->sack_cond);
+	g_mutex_unlock (&priv->sack_mutex);
+}
+
+static gboolean
+pk_backend_sack_cache_rebuild_cb (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
+	g_autoptr(GTask) task = NULL;
+
+	/* jobs share the repo loader, so wait until we're idle */
+	if (priv->sack_rebuilding || g_atomic_int_get (&priv->jobs_running) > 0)
+		return G_SOURCE_CONTINUE;
+
+	priv->sack_rebuild_id = 0;
+	priv->sack_rebuilding = TRUE;
+	task = g_task_new (backend, NULL, NULL, NULL);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+	g_task_run_in_thread (task, pk_backend_sack_cache_rebuild_thread);
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+dnf_sack_cache_item_is_usable (DnfSackCacheItem *cache_item,
+			       DnfSackAddFlags flags,
+			       guint cache_age)
+{
+	if ((cache_item->flags & flags) != flags)
+		return FALSE;
+	if (cache_item->valid)
+		return TRUE;
+
+	/* the caller can accept a sack that went stale a short time ago */
+	if (cache_age == G_MAXUINT)
+		return FALSE;
+	return g_get_monotonic_time () - cache_item->invalidated <=
+		(gint64) cache_age * G_USEC_PER_SEC;
+}
+
 static DnfSack *
 dnf_utils_create_sack_for_filters (PkBackendJob *job,
 				   PkBitfield filters,
@@ -646,26 +1192,53 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 				   DnfState *state,
 				   GError **error)
 {
-	gboolean ret;
-	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_FILELISTS;
+	DnfSackAddFlags flags = DNF_SACK_ADD_FLAG_NONE;
 	DnfSackCacheItem *cache_item = NULL;
-	DnfState *state_local;
 	PkBackend *backend = pk_backend_job_get_backend (job);
+	gboolean skip_updateinfo = FALSE;
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autofree gchar *cache_key = NULL;
-	g_autofree gchar *install_root = NULL;
-	g_autofree gchar *solv_dir = NULL;
+	g_autofree gchar *rpmdb_cookie = NULL;
 	g_autoptr(DnfSack) sack = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
 
 	/* don't add if we're going to filter out anyway */
 	if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED))
 		flags |= DNF_SACK_ADD_FLAG_REMOTE;
 
-	/* only load updateinfo when required */
-	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL ||
-	    pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATES)
+	/* the filelists are by far the largest metadata, so only load them
+	 * for file queries outside primary.xml and to depsolve file requires;
+	 * refreshing writes their solv cache for later */
+	if ((create_flags & DNF_CREATE_SACK_FLAG_FILELISTS) > 0)
+		flags |= DNF_SACK_ADD_FLAG_FILELISTS;
+	switch (pk_backend_job_get_role (job)) {
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_REFRESH_CACHE:
+	case PK_ROLE_ENUM_DOWNLOAD_PACKAGES:
+	case PK_ROLE_ENUM_INSTALL_FILES:
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+	case PK_ROLE_ENUM_REPO_REMOVE:
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+	case PK_ROLE_ENUM_UPGRADE_SYSTEM:
+		flags |= DNF_SACK_ADD_FLAG_FILELISTS;
+		break;
+	default:
+		break;
+	}
+
+	/* only load updateinfo when required, and for the severity of the
+	 * updates only when the client is not in a hurry */
+	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATE_DETAIL)
 		flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
+	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATES) {
+		gint64 budget = pk_backend_job_get_budget (job);
+		if (budget >= 0 && budget < DNF_UPDATEINFO_BUDGET_MS)
+			skip_updateinfo = TRUE;
+		else
+			flags |= DNF_SACK_ADD_FLAG_UPDATEINFO;
+	}
 
 	/* only use unavailble packages for queries */
 	switch (pk_backend_job_get_role (job)) {
@@ -681,8 +1254,17 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 		break;
 	}
 
+	/* the other flags only apply to remote repos, so share one sack
+	 * between every installed-only query and never load the repos */
+	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) == 0) {
+		flags = DNF_SACK_ADD_FLAG_NONE;
+		rpmdb_cookie = dnf_utils_get_rpmdb_cookie (job_data->context);
+		skip_updateinfo = FALSE;
+	}
+
 	/* media repos could disappear at any time */
 	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0 &&
+	    (flags & DNF_SACK_ADD_FLAG_REMOTE) > 0 &&
 	    dnf_repo_loader_has_removable_repos (dnf_context_get_repo_loader (job_data->context)) &&
 	    g_timer_elapsed (priv->repos_timer, NULL) > 1.0f) {
 		g_debug ("not reusing sack as media may have disappeared");
@@ -699,84 +1281,73 @@ dnf_utils_create_sack_for_filters (PkBackendJob *job,
 
 	/* do we have anything in the cache */
 	cache_key = dnf_utils_create_cache_key (dnf_context_get_release_ver (job_data->context), flags);
+	if (pk_backend_job_get_root (job) != NULL) {
+		gchar *tmp = g_strdup_printf ("%s::root[%s]", cache_key, pk_backend_job_get_root (job));
+		g_free (cache_key);
+		cache_key = tmp;
+	}
+	locker = g_mutex_locker_new (&priv->sack_mutex);
 	if ((create_flags & DNF_CREATE_SACK_FLAG_USE_CACHE) > 0) {
-		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->sack_mutex);
-		cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
-		if (cache_item != NULL && cache_item->sack != NULL) {
-			if (cache_item->valid) {
-				g_debug ("using cached sack %s", cache_key);
+		guint cache_age = pk_backend_job_get_cache_age (job);
+		for (;;) {
+			cache_item = g_hash_table_lookup (priv->sack_cache, cache_key);
+
+			/* only the rpmdb matters for an installed-only sack */
+			if (cache_item != NULL && !cache_item->valid &&
+			    rpmdb_cookie != NULL &&
+			    g_strcmp0 (cache_item->rpmdb_cookie, rpmdb_cookie) == 0) {
+				g_debug ("rpmdb unchanged, revalidating %s", cache_key);
+				cache_item->valid = TRUE;
+			}
+			if (cache_item != NULL &&
+			    dnf_sack_cache_item_is_usable (cache_item, flags, cache_age)) {
+				g_debug ("using %s sack %s",
+					 cache_item->valid ? "cached" : "stale", cache_key);
+				if (skip_updateinfo &&
+				    (cache_item->flags & DNF_SACK_ADD_FLAG_UPDATEINFO) == 0)
+					pk_backend_job_set_partial (job);
 				return g_object_ref (cache_item->sack);
-			} else {
-				/* we have to do this now rather than rely on the
-				 * callback of the hash table */
-				g_hash_table_remove (priv->sack_cache, cache_key);
 			}
+			if (!priv->sack_rebuilding)
+				break;
+
+			/* the new sack may be just what we need */
+			g_cond_wait (&priv->sack_cond, &priv->sack_mutex);
+		}
+		if (cache_item != NULL && cache_item->valid) {
+			/* libdnf cannot add repodata to a loaded
+			 * sack, so rebuild once with every layer
+			 * either user has asked for and replace it */
+			g_debug ("extending cached sack %s", cache_key);
+			flags |= cache_item->flags;
 		}
+	} else {
+		/* the rebuild thread is using the repo loader */
+		while (priv->sack_rebuilding)
+			g_cond_wait (&priv->sack_cond, &priv->sack_mutex);
 	}
+	g_clear_pointer (&locker, g_mutex_locker_free);
 
 	/* update status */
 	dnf_state_action_start (state, DNF_STATE_ACTION_QUERY, NULL);
 
-	/* set state */
-	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
-		ret = dnf_state_set_steps (state, error,
-					   8, /* add installed */
-					   92, /* add remote */
-					   -1);
-		if (!ret)
-			return NULL;
-	} else {
-		dnf_state_set_number_steps (state, 1);
-	}
-
-	/* create empty sack */
-	solv_dir = dnf_utils_real_path (dnf_context_get_solv_dir (job_data->context));
-	install_root = dnf_utils_real_path (dnf_context_get_install_root (job_data->context));
-	sack = dnf_sack_new ();
-	dnf_sack_set_cachedir (sack, solv_dir);
-	dnf_sack_set_rootdir (sack, install_root);
-	ret = dnf_sack_setup (sack, DNF_SACK_SETUP_FLAG_MAKE_CACHE_DIR, error);
-	if (!ret) {
-		g_prefix_error (error, "failed to create sack in %s for %s: ",
-				dnf_context_get_solv_dir (job_data->context),
-				dnf_context_get_install_root (job_data->context));
-		return NULL;
-	}
-
-	/* add installed packages */
-	ret = dnf_sack_load_system_repo (sack, NULL, DNF_SACK_LOAD_FLAG_BUILD_CACHE, error);
-	if (!ret) {
-		g_prefix_error (error, "Failed to load system repo: ");
-		return NULL;
-	}
-
-	/* done */
-	ret = dnf_state_done (state, error);
-	if (!ret)
+	sack = dnf_utils_build_sack (job_data->context, flags,
+				     pk_backend_job_get_cache_age (job),
+				     state, error);
+	if (sack == NULL)
 		return NULL;
-
-	/* add remote packages */
-	if ((flags & DNF_SACK_ADD_FLAG_REMOTE) > 0) {
-		state_local = dnf_state_get_child (state);
-		ret = dnf_utils_add_remote (job, sack, flags,
-					    state_local, error);
-		if (!ret)
-			return NULL;
-
-		/* done */
-		ret = dnf_state_done (state, error);
-		if (!ret)
-			return NULL;
-	}
-
-	dnf_sack_filter_modules (sack, dnf_context_get_repos (job_data->context), install_root, NULL);
+	if (skip_updateinfo && (flags & DNF_SACK_ADD_FLAG_UPDATEINFO) == 0)
+		pk_backend_job_set_partial (job);
 
 	/* save in cache */
 	g_mutex_lock (&priv->sack_mutex);
-	cache_item = g_slice_new (DnfSackCacheItem);
+	cache_item = g_slice_new0 (DnfSackCacheItem);
 	cache_item->key = g_strdup (cache_key);
 	cache_item->sack = g_object_ref (sack);
+	cache_item->context = g_object_ref (job_data->context);
 	cache_item->valid = TRUE;
+	cache_item->flags = flags;
+	cache_item->rpmdb_cookie = g_steal_pointer (&rpmdb_cookie);
 	g_debug ("created cached sack %s", cache_item->key);
 	g_hash_table_insert (priv->sack_cache, g_strdup (cache_key), cache_item);
 	g_mutex_unlock (&priv->sack_mutex);
@@ -912,54 +1483,138 @@ pk_backend_what_provides_decompose (gchar **values, GError **error)
 	return (gchar **) g_ptr_array_free (array, FALSE);
 }
 
-static GHashTable *
-pk_backend_dnf_cache_advisories (DnfSack *sack)
-{
+typedef struct {
+	DnfAdvisory	*advisory;
+	PkInfoEnum	 info;
+	PkInfoEnum	 severity;
+} PkDnfAdvisoryEntry;
+
+typedef struct {
+	GPtrArray	*advisories;	/* of DnfAdvisory */
+	GPtrArray	*items;		/* of PkDnfAdvisoryEntry */
+	GHashTable	*entries;	/* solvable id : PkDnfAdvisoryEntry */
+} PkDnfAdvisoryIndex;
+
+#define PK_DNF_ADVISORY_INDEX_KEY	"PkDnfAdvisoryIndex"
+
 #ifdef HAVE_HY_QUERY_GET_ADVISORY_PKGS
-	g_autoptr(GPtrArray) array = NULL;
-	GHashTable *hash;
+static void
+pk_dnf_advisory_index_free (PkDnfAdvisoryIndex *adv_index)
+{
+	g_hash_table_unref (adv_index->entries);
+	g_ptr_array_unref (adv_index->items);
+	g_ptr_array_unref (adv_index->advisories);
+	g_free (adv_index);
+}
+
+static PkDnfAdvisoryIndex *
+pk_dnf_advisory_index_new (DnfSack *sack)
+{
+	PkDnfAdvisoryIndex *adv_index;
 	HyQuery query;
 	guint ii;
+	g_autoptr(GHashTable) by_nevra = NULL;
+	g_autoptr(GHashTable) names = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GPtrArray) pkgs = NULL;
+	g_autofree const gchar **names_strv = NULL;
+
+	adv_index = g_new0 (PkDnfAdvisoryIndex, 1);
+	adv_index->advisories = g_ptr_array_new_with_free_func ((GDestroyNotify) dnf_advisory_free);
+	adv_index->items = g_ptr_array_new_with_free_func (g_free);
+	adv_index->entries = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-	hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) dnf_advisory_free);
+	/* the advisories only know the name, evr and arch */
+	by_nevra = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	names = g_hash_table_new (g_str_hash, g_str_equal);
 	query = hy_query_create (sack);
 	array = hy_query_get_advisory_pkgs (query, HY_EQ);
-
+	hy_query_free (query);
 	for (ii = 0; ii < array->len; ii++) {
 		DnfAdvisoryPkg *advpkg = g_ptr_array_index (array, ii);
-		gchar *id;
+		DnfAdvisory *advisory = dnf_advisorypkg_get_advisory (advpkg);
+		PkDnfAdvisoryEntry *entry;
+
+		entry = g_new0 (PkDnfAdvisoryEntry, 1);
+		entry->advisory = advisory;
+		entry->info = dnf_advisory_kind_to_info_enum (dnf_advisory_get_kind (advisory));
+		entry->severity = dnf_update_severity_to_enum (dnf_advisory_get_severity (advisory));
+		g_ptr_array_add (adv_index->advisories, advisory);
+		g_ptr_array_add (adv_index->items, entry);
+		g_hash_table_replace (by_nevra,
+				      g_strdup_printf ("%s;%s;%s",
+						       dnf_advisorypkg_get_name (advpkg),
+						       dnf_advisorypkg_get_evr (advpkg),
+						       dnf_advisorypkg_get_arch (advpkg)),
+				      entry);
+		g_hash_table_add (names, (gpointer) dnf_advisorypkg_get_name (advpkg));
+	}
+	if (g_hash_table_size (names) == 0)
+		return adv_index;
+
+	/* resolve them once to solvables so lookups are just an integer */
+	names_strv = (const gchar **) g_hash_table_get_keys_as_array (names, NULL);
+	query = hy_query_create (sack);
+	hy_query_filter_in (query, HY_PKG_NAME, HY_EQ, names_strv);
+	pkgs = hy_query_run (query);
+	hy_query_free (query);
+	for (ii = 0; ii < pkgs->len; ii++) {
+		DnfPackage *pkg = g_ptr_array_index (pkgs, ii);
+		PkDnfAdvisoryEntry *entry;
+		g_autofree gchar *id = NULL;
 
 		id = g_strdup_printf ("%s;%s;%s",
-			dnf_advisorypkg_get_name (advpkg),
-			dnf_advisorypkg_get_evr (advpkg),
-			dnf_advisorypkg_get_arch (advpkg));
-
-		g_hash_table_insert (hash, id, dnf_advisorypkg_get_advisory (advpkg));
+				      dnf_package_get_name (pkg),
+				      dnf_package_get_evr (pkg),
+				      dnf_package_get_arch (pkg));
+		entry = g_hash_table_lookup (by_nevra, id);
+		if (entry == NULL)
+			continue;
+		g_hash_table_insert (adv_index->entries,
+				     GUINT_TO_POINTER (dnf_package_get_id (pkg)),
+				     entry);
 	}
+	return adv_index;
+}
+#endif
 
-	hy_query_free (query);
-	return hash;
+/* the index lives as long as the sack, so cached sacks share it */
+static PkDnfAdvisoryIndex *
+pk_backend_dnf_cache_advisories (DnfSack *sack)
+{
+#ifdef HAVE_HY_QUERY_GET_ADVISORY_PKGS
+	static GMutex mutex;
+	PkDnfAdvisoryIndex *adv_index;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&mutex);
+
+	adv_index = g_object_get_data (G_OBJECT (sack), PK_DNF_ADVISORY_INDEX_KEY);
+	if (adv_index != NULL)
+		return adv_index;
+	adv_index = pk_dnf_advisory_index_new (sack);
+	g_debug ("indexed %u advisories for %u packages",
+		 adv_index->advisories->len,
+		 g_hash_table_size (adv_index->entries));
+	g_object_set_data_full (G_OBJECT (sack), PK_DNF_ADVISORY_INDEX_KEY, adv_index,
+				(GDestroyNotify) pk_dnf_advisory_index_free);
+	return adv_index;
 #else
 	return NULL;
 #endif
 }
 
 static DnfAdvisory *
-pk_backend_dnf_get_advisory (GHashTable *advisories_hash,
+pk_backend_dnf_get_advisory (PkDnfAdvisoryIndex *adv_index,
 			     DnfPackage *pkg)
 {
 #ifdef HAVE_HY_QUERY_GET_ADVISORY_PKGS
-	g_autofree gchar *id = NULL;
+	PkDnfAdvisoryEntry *entry;
 
 	if (pkg == NULL)
 		return NULL;
 
-	id = g_strdup_printf ("%s;%s;%s",
-		dnf_package_get_name (pkg),
-		dnf_package_get_evr (pkg),
-		dnf_package_get_arch (pkg));
-
-	return g_hash_table_lookup (advisories_hash, id);
+	entry = g_hash_table_lookup (adv_index->entries,
+				     GUINT_TO_POINTER (dnf_package_get_id (pkg)));
+	return entry != NULL ? entry->advisory : NULL;
 #else
 	GPtrArray *advisorylist;
 	DnfAdvisory *advisory = NULL;
@@ -974,10 +1629,41 @@ pk_backend_dnf_get_advisory (GHashTable *advisories_hash,
 #endif
 }
 
+static gboolean
+pk_backend_dnf_get_update_info (PkDnfAdvisoryIndex *adv_index,
+				DnfPackage *pkg,
+				PkInfoEnum *info,
+				PkInfoEnum *severity)
+{
+#ifdef HAVE_HY_QUERY_GET_ADVISORY_PKGS
+	PkDnfAdvisoryEntry *entry;
+
+	entry = g_hash_table_lookup (adv_index->entries,
+				     GUINT_TO_POINTER (dnf_package_get_id (pkg)));
+	if (entry == NULL)
+		return FALSE;
+	*info = entry->info;
+	*severity = entry->severity;
+	return TRUE;
+#else
+	DnfAdvisory *advisory;
+
+	advisory = pk_backend_dnf_get_advisory (adv_index, pkg);
+	if (advisory == NULL)
+		return FALSE;
+	*info = dnf_advisory_kind_to_info_enum (dnf_advisory_get_kind (advisory));
+	*severity = dnf_update_severity_to_enum (dnf_advisory_get_severity (advisory));
+	dnf_advisory_free (advisory);
+	return TRUE;
+#endif
+}
+
 static void
 pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
+	g_autoptr(GMutexLocker) context_locker = pk_backend_context_lock (pk_backend_job_get_backend (job));
 	gboolean ret;
+	DnfCreateSackFlags create_flags = DNF_CREATE_SACK_FLAG_USE_CACHE;
 	DnfDb *db;
 	DnfState *state_local;
 	DnfGoalActions flags;
@@ -1023,10 +1709,14 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 	}
 
 	/* get sack */
+	if ((pk_backend_job_get_role (job) == PK_ROLE_ENUM_SEARCH_FILE ||
+	     pk_backend_job_get_role (job) == PK_ROLE_ENUM_WHAT_PROVIDES) &&
+	    dnf_utils_paths_need_filelists (search))
+		create_flags |= DNF_CREATE_SACK_FLAG_FILELISTS;
 	state_local = dnf_state_get_child (job_data->state);
 	sack = dnf_utils_create_sack_for_filters (job,
 						  filters,
-						  DNF_CREATE_SACK_FLAG_USE_CACHE,
+						  create_flags,
 						  state_local,
 						  &error);
 	if (sack == NULL) {
@@ -1136,21 +1826,14 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 	if (pk_backend_job_get_role (job) == PK_ROLE_ENUM_GET_UPDATES) {
 		guint i;
 		DnfPackage *pkg;
-		DnfAdvisory *advisory;
-		DnfAdvisoryKind kind;
 		PkInfoEnum info_enum;
-		g_autoptr(GHashTable) advisories_hash = pk_backend_dnf_cache_advisories (sack);
+		PkInfoEnum severity;
+		PkDnfAdvisoryIndex *advisories = pk_backend_dnf_cache_advisories (sack);
 		for (i = 0; i < pkglist->len; i++) {
 			pkg = g_ptr_array_index (pkglist, i);
-			advisory = pk_backend_dnf_get_advisory (advisories_hash, pkg);
-			if (advisory != NULL) {
-				kind = dnf_advisory_get_kind (advisory);
+			if (pk_backend_dnf_get_update_info (advisories, pkg, &info_enum, &severity)) {
 				g_object_set_data (G_OBJECT (pkg), PK_DNF_UPDATE_SEVERITY_KEY,
-					GUINT_TO_POINTER (dnf_update_severity_to_enum (dnf_advisory_get_severity (advisory))));
-#ifndef HAVE_HY_QUERY_GET_ADVISORY_PKGS
-				dnf_advisory_free (advisory);
-#endif
-				info_enum = dnf_advisory_kind_to_info_enum (kind);
+						   GUINT_TO_POINTER (severity));
 				dnf_package_set_info (pkg, info_enum);
 			}
 		}
@@ -1180,7 +1863,7 @@ pk_backend_get_packages (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1198,7 +1881,7 @@ pk_backend_resolve (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1216,7 +1899,7 @@ pk_backend_search_names (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1234,7 +1917,7 @@ pk_backend_search_details (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1252,7 +1935,7 @@ pk_backend_search_files (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1270,7 +1953,7 @@ pk_backend_what_provides (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1287,7 +1970,7 @@ pk_backend_get_updates (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1296,6 +1979,87 @@ pk_backend_get_updates (PkBackend *backend,
 	pk_backend_job_thread_create (job, pk_backend_search_thread, NULL, NULL);
 }
 
+static void
+pk_backend_prewarm_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(DnfSack) sack = NULL;
+
+	/* this leaves the sack GetUpdates uses in the cache */
+	sack = dnf_utils_create_sack_for_filters (job,
+						  pk_bitfield_value (PK_FILTER_ENUM_NONE),
+						  DNF_CREATE_SACK_FLAG_USE_CACHE,
+						  job_data->state,
+						  &error);
+	if (sack == NULL)
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+}
+
+void
+pk_backend_prewarm (PkBackend *backend, PkBackendJob *job)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		pk_backend_job_finished (job);
+		return;
+	}
+	pk_backend_job_set_context (job, priv->context);
+	pk_backend_job_thread_create (job, pk_backend_prewarm_thread, NULL, NULL);
+}
+
+static void
+pk_backend_get_commands_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBitfield filters;
+	HyQuery query = NULL;
+	const gchar *globs[] = { "/usr/bin/*", "/usr/sbin/*", "/bin/*", "/sbin/*", NULL };
+	g_autoptr(GError) error = NULL;
+	g_autoptr(DnfSack) sack = NULL;
+	g_autoptr(GPtrArray) pkglist = NULL;
+
+	g_variant_get (params, "(t)", &filters);
+	sack = dnf_utils_create_sack_for_filters (job,
+						  filters,
+						  DNF_CREATE_SACK_FLAG_USE_CACHE,
+						  job_data->state,
+						  &error);
+	if (sack == NULL) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
+	/* the daemon ignores anything outside the bin directories */
+	query = hy_query_create (sack);
+	hy_query_filter_in (query, HY_PKG_FILE, HY_GLOB, globs);
+	pkglist = dnf_utils_run_query_with_filters (job, sack, query, filters);
+	for (guint i = 0; i < pkglist->len; i++) {
+		DnfPackage *pkg = g_ptr_array_index (pkglist, i);
+		g_auto(GStrv) files = dnf_package_get_files (pkg);
+		pk_backend_job_files (job, dnf_package_get_package_id (pkg), files);
+	}
+	hy_query_free (query);
+}
+
+void
+pk_backend_get_commands (PkBackend *backend, PkBackendJob *job)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		pk_backend_job_finished (job);
+		return;
+	}
+	pk_backend_job_set_context (job, priv->context);
+	pk_backend_job_thread_create (job, pk_backend_get_commands_thread, NULL, NULL);
+}
+
 /* Obviously hardcoded based on the repository ID labels.
  * Colin Walters thinks this concept should be based on
  * user's trust of a GPG key or something more flexible.
@@ -1394,7 +2158,7 @@ pk_backend_get_repo_list (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1513,7 +2277,7 @@ pk_backend_repo_set_data (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1531,7 +2295,7 @@ pk_backend_repo_enable (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -1564,13 +2328,17 @@ pk_backend_get_mime_types (PkBackend *backend)
 static gboolean
 pk_backend_refresh_repo (PkBackendJob *job,
                          DnfRepo *repo,
+                         GMutex *mutex,
                          DnfState *state,
                          GError **error)
 {
 	gboolean ret;
 	gboolean repo_okay;
+	g_autoptr(GMutexLocker) locker = NULL;
 	DnfState *state_local;
 	GError *error_local = NULL;
+	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 
 	/* set state */
 	ret = dnf_state_set_steps (state, error,
@@ -1580,12 +2348,15 @@ pk_backend_refresh_repo (PkBackendJob *job,
 	if (!ret)
 		return FALSE;
 
-	/* is the repo up to date? */
+	/* is the repo up to date? this only reads local files, so the
+	 * workers take turns rather than share whatever libdnf caches */
 	state_local = dnf_state_get_child (state);
+	locker = g_mutex_locker_new (mutex);
 	repo_okay = dnf_repo_check (repo,
 	                            pk_backend_job_get_cache_age (job),
 	                            state_local,
 	                            &error_local);
+	g_clear_pointer (&locker, g_mutex_locker_free);
 	if (!repo_okay) {
 		g_debug ("repo %s not okay [%s], refreshing",
 			 dnf_repo_get_id (repo), error_local->message);
@@ -1600,6 +2371,10 @@ pk_backend_refresh_repo (PkBackendJob *job,
 
 	/* update repo, TODO: if we have network access */
 	if (!repo_okay) {
+		/* the download of the other repos goes on, but importing a
+		 * key to check the metadata with is done by one at a time */
+		if (dnf_repo_get_gpgcheck_md (repo))
+			locker = g_mutex_locker_new (mutex);
 		state_local = dnf_state_get_child (state);
 		ret = dnf_repo_update (repo,
 		                       DNF_REPO_UPDATE_FLAG_IMPORT_PUBKEY,
@@ -1620,16 +2395,39 @@ pk_backend_refresh_repo (PkBackendJob *job,
 				return FALSE;
 			}
 		}
+		g_clear_pointer (&locker, g_mutex_locker_free);
 	}
 
 	/* copy the appstream files somewhere that the GUI will pick them up */
-	if (!dnf_utils_refresh_repo_appstream (repo, error))
-		return FALSE;
+	g_debug ("queueing the AppStream data of %s", dnf_repo_get_id (repo));
+	pk_backend_refresh_appstream_queue (priv, repo);
 
 	/* done */
 	return dnf_state_done (state, error);
 }
 
+typedef struct {
+	PkBackendJob	*job;
+	DnfRepo		*repo;
+	GMutex		*mutex;
+	GAsyncQueue	*done;
+	GError		*error;
+} PkDnfRefreshItem;
+
+static void
+pk_backend_refresh_repo_worker (gpointer data, gpointer user_data)
+{
+	PkDnfRefreshItem *item = data;
+	DnfState *state;
+
+	/* DnfState is not threadsafe, so each repo reports to its own */
+	state = dnf_state_new ();
+	dnf_state_set_cancellable (state, pk_backend_job_get_cancellable (item->job));
+	pk_backend_refresh_repo (item->job, item->repo, item->mutex, state, &item->error);
+	g_object_unref (state);
+	g_async_queue_push (item->done, item);
+}
+
 static void
 pk_backend_refresh_subman (PkBackendJob *job)
 {
@@ -1662,14 +2460,20 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 {
 	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackend *backend = pk_backend_job_get_backend (job);
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	DnfRepo *repo;
 	DnfState *state_local;
 	DnfState *state_loop;
+	GMutex mutex;
+	GThreadPool *pool;
+	PkDnfRefreshItem *items;
 	gboolean force;
 	gboolean ret;
+	gint max_threads;
 	guint cnt = 0;
 	guint i;
 	g_autoptr(DnfSack) sack = NULL;
+	g_autoptr(GAsyncQueue) done = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) refresh_repos = NULL;
 	g_autoptr(GPtrArray) repos = NULL;
@@ -1686,6 +2490,9 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 	/* kick subscription-manager if it exists */
 	pk_backend_refresh_subman (job);
 
+	/* not whilst the last refresh is still copying out of the repos */
+	pk_backend_refresh_appstream_wait (priv);
+
 	/* ask the context's repo loader for new repos, forcing it to reload them */
 	repos = dnf_repo_loader_get_repos (dnf_context_get_repo_loader (job_data->context), &error);
 	if (repos == NULL) {
@@ -1754,36 +2561,61 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 		return;
 	}
 
-	/* refresh each repo */
-	state_local = dnf_state_get_child (job_data->state);
-	dnf_state_set_number_steps (state_local, refresh_repos->len);
-	for (i = 0; i < refresh_repos->len; i++) {
+	/* delete content even if up to date */
+	for (i = 0; force && i < refresh_repos->len; i++) {
 		repo = g_ptr_array_index (refresh_repos, i);
-
-		/* delete content even if up to date */
-		if (force) {
-			g_debug ("Deleting contents of %s as forced", dnf_repo_get_id (repo));
-			ret = dnf_repo_clean (repo, &error);
-			if (!ret) {
-				pk_backend_job_error_code (job, error->code, "%s", error->message);
-				return;
-			}
-		}
-
-		/* check and download */
-		state_loop = dnf_state_get_child (state_local);
-		ret = pk_backend_refresh_repo (job, repo, state_loop, &error);
+		g_debug ("Deleting contents of %s as forced", dnf_repo_get_id (repo));
+		ret = dnf_repo_clean (repo, &error);
 		if (!ret) {
 			pk_backend_job_error_code (job, error->code, "%s", error->message);
 			return;
 		}
+	}
 
-		/* done */
-		ret = dnf_state_done (state_local, &error);
-		if (!ret) {
-			pk_backend_job_error_code (job, error->code, "%s", error->message);
-			return;
+	/* check and download several repos at once, as most of the time is
+	 * spent waiting for the mirrors */
+	max_threads = g_key_file_get_integer (priv->conf, "Dnf", "ParallelDownloads", NULL);
+	if (max_threads <= 0)
+		max_threads = 3;
+	pool = g_thread_pool_new (pk_backend_refresh_repo_worker, NULL,
+				  max_threads, FALSE, &error);
+	if (pool == NULL) {
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_INTERNAL_ERROR,
+					   "%s", error->message);
+		return;
+	}
+	done = g_async_queue_new ();
+	g_mutex_init (&mutex);
+	items = g_new0 (PkDnfRefreshItem, refresh_repos->len);
+	for (i = 0; i < refresh_repos->len; i++) {
+		items[i].job = job;
+		items[i].repo = g_ptr_array_index (refresh_repos, i);
+		items[i].mutex = &mutex;
+		items[i].done = done;
+		g_thread_pool_push (pool, &items[i], NULL);
+	}
+
+	/* wait for every repo even on failure, as the workers use the job */
+	state_local = dnf_state_get_child (job_data->state);
+	dnf_state_set_number_steps (state_local, refresh_repos->len);
+	for (i = 0; i < refresh_repos->len; i++) {
+		PkDnfRefreshItem *item = g_async_queue_pop (done);
+		if (item->error != NULL && error == NULL) {
+			g_propagate_prefixed_error (&error, item->error, "%s: ",
+						    dnf_repo_get_id (item->repo));
+			item->error = NULL;
 		}
+		if (error == NULL)
+			dnf_state_done (state_local, &error);
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+	g_mutex_clear (&mutex);
+	for (i = 0; i < refresh_repos->len; i++)
+		g_clear_error (&items[i].error);
+	g_free (items);
+	if (error != NULL) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
 	}
 
 	/* done */
@@ -1795,6 +2627,7 @@ pk_backend_refresh_cache_thread (PkBackendJob *job,
 
 	/* invalidate the sack cache after downloading new metadata */
 	pk_backend_sack_cache_invalidate (backend, "downloaded new metadata");
+	pk_backend_bump_epoch (backend, PK_BACKEND_EPOCH_AVAILABLE);
 
 	/* regenerate the libsolv metadata */
 	state_local = dnf_state_get_child (job_data->state);
@@ -1822,12 +2655,13 @@ pk_backend_refresh_cache (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
 	}
 	pk_backend_job_set_context (job, priv->context);
+	pk_backend_job_set_resumable (job, TRUE);
 	pk_backend_job_thread_create (job, pk_backend_refresh_cache_thread, NULL, NULL);
 }
 
@@ -1845,74 +2679,95 @@ static GHashTable *
 dnf_utils_find_package_ids (DnfSack *sack, gchar **package_ids, GError **error)
 {
 	const gchar *reponame;
-	gboolean ret = TRUE;
 	GHashTable *hash;
 	guint i;
-	GPtrArray *pkglist = NULL;
 	DnfPackage *pkg;
-	HyQuery query = NULL;
+	HyQuery query;
+	g_autoptr(GHashTable) wanted = NULL;
+	g_autoptr(GHashTable) names = NULL;
+	g_autoptr(GPtrArray) pkglist = NULL;
+	g_autoptr(GPtrArray) splits = NULL;
+	g_autofree const gchar **names_strv = NULL;
 
-	/* run query */
+	/* one query for all the names, then match the rest in a hash */
 	hash = g_hash_table_new_full (g_str_hash, g_str_equal,
 				      g_free, (GDestroyNotify) g_object_unref);
-	query = hy_query_create (sack);
+	wanted = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	names = g_hash_table_new (g_str_hash, g_str_equal);
+	splits = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
 	for (i = 0; package_ids[i] != NULL; i++) {
-		g_auto(GStrv) split = NULL;
-		hy_query_clear (query);
-		split = pk_package_id_split (package_ids[i]);
+		gchar **split = pk_package_id_split (package_ids[i]);
+		if (split == NULL)
+			continue;
+		g_ptr_array_add (splits, split);
 		reponame = split[PK_PACKAGE_ID_DATA];
 		if (g_strcmp0 (reponame, "installed") == 0 ||
 		    g_str_has_prefix (reponame, "installed:"))
 			reponame = HY_SYSTEM_REPO_NAME;
 		else if (g_strcmp0 (reponame, "local") == 0)
 			reponame = HY_CMDLINE_REPO_NAME;
-		hy_query_filter (query, HY_PKG_NAME, HY_EQ, split[PK_PACKAGE_ID_NAME]);
-		hy_query_filter (query, HY_PKG_EVR, HY_EQ, split[PK_PACKAGE_ID_VERSION]);
-		hy_query_filter (query, HY_PKG_ARCH, HY_EQ, split[PK_PACKAGE_ID_ARCH]);
-		hy_query_filter (query, HY_PKG_REPONAME, HY_EQ, reponame);
-		pkglist = hy_query_run (query);
+		g_hash_table_insert (wanted,
+				     g_strjoin (";",
+						split[PK_PACKAGE_ID_NAME],
+						split[PK_PACKAGE_ID_VERSION],
+						split[PK_PACKAGE_ID_ARCH],
+						reponame,
+						NULL),
+				     package_ids[i]);
+		g_hash_table_add (names, split[PK_PACKAGE_ID_NAME]);
+	}
+	if (g_hash_table_size (names) == 0)
+		return hash;
+
+	names_strv = (const gchar **) g_hash_table_get_keys_as_array (names, NULL);
+	query = hy_query_create (sack);
+	hy_query_filter_in (query, HY_PKG_NAME, HY_EQ, names_strv);
+	pkglist = hy_query_run (query);
+	hy_query_free (query);
+
+	for (i = 0; i < pkglist->len; i++) {
+		const gchar *package_id;
+		DnfPackage *found;
+		g_autofree gchar *key = NULL;
 
-		/* no matches */
-		if (pkglist->len == 0) {
-			g_ptr_array_unref (pkglist);
+		pkg = g_ptr_array_index (pkglist, i);
+		key = g_strjoin (";",
+				 dnf_package_get_name (pkg),
+				 dnf_package_get_evr (pkg),
+				 dnf_package_get_arch (pkg),
+				 dnf_package_get_reponame (pkg),
+				 NULL);
+		package_id = g_hash_table_lookup (wanted, key);
+		if (package_id == NULL)
 			continue;
-		}
 
 		/* multiple matches */
-		if (pkglist->len > 1) {
-			ret = FALSE;
+		found = g_hash_table_lookup (hash, package_id);
+		if (found != NULL) {
 			g_set_error (error,
 				     DNF_ERROR,
 				     PK_ERROR_ENUM_PACKAGE_CONFLICTS,
-				     "Multiple matches of %s", package_ids[i]);
-			for (i = 0; i < pkglist->len; i++) {
-				pkg = g_ptr_array_index (pkglist, i);
-				g_debug ("possible matches: %s",
-					 dnf_package_get_package_id (pkg));
-			}
-			goto out;
+				     "Multiple matches of %s", package_id);
+			g_debug ("possible matches: %s",
+				 dnf_package_get_package_id (found));
+			g_debug ("possible matches: %s",
+				 dnf_package_get_package_id (pkg));
+			g_hash_table_unref (hash);
+			return NULL;
 		}
 
 		/* add to results */
-		pkg = g_ptr_array_index (pkglist, 0);
 		g_hash_table_insert (hash,
-				     g_strdup (package_ids[i]),
+				     g_strdup (package_id),
 				     g_object_ref (pkg));
-		g_ptr_array_unref (pkglist);
-	}
-out:
-	if (!ret && hash != NULL) {
-		g_hash_table_unref (hash);
-		hash = NULL;
 	}
-	if (query != NULL)
-		hy_query_free (query);
 	return hash;
 }
 
 static void
 backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 {
+	g_autoptr(GMutexLocker) context_locker = pk_backend_context_lock (pk_backend_job_get_backend (job));
 	gboolean ret;
 	guint i;
 	DnfState *state_local;
@@ -1995,7 +2850,7 @@ pk_backend_get_details (PkBackend *backend, PkBackendJob *job, gchar **package_i
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -2079,13 +2934,274 @@ backend_get_details_local_thread (PkBackendJob *job, GVariant *params, gpointer
 	}
 }
 
+typedef enum {
+	PK_DNF_DEPS_DIRECTION_DEPENDS_ON,
+	PK_DNF_DEPS_DIRECTION_REQUIRED_BY,
+	PK_DNF_DEPS_DIRECTION_LAST
+} PkDnfDepsDirection;
+
+/* the direct edges of each solvable, kept on the sack as they can only
+ * change with it */
+typedef struct {
+	GHashTable	*edges[PK_DNF_DEPS_DIRECTION_LAST];	/* of Id:GPtrArray */
+} PkDnfDepsCache;
+
+static GMutex deps_cache_mutex;
+
+static void
+pk_dnf_deps_cache_free (PkDnfDepsCache *cache)
+{
+	for (guint i = 0; i < PK_DNF_DEPS_DIRECTION_LAST; i++)
+		g_hash_table_unref (cache->edges[i]);
+	g_free (cache);
+}
+
+static PkDnfDepsCache *
+pk_dnf_deps_cache_for_sack (DnfSack *sack)
+{
+	PkDnfDepsCache *cache;
+
+	cache = g_object_get_data (G_OBJECT (sack), "pk-dnf-deps-cache");
+	if (cache != NULL)
+		return cache;
+	cache = g_new0 (PkDnfDepsCache, 1);
+	for (guint i = 0; i < PK_DNF_DEPS_DIRECTION_LAST; i++) {
+		cache->edges[i] = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							 NULL, (GDestroyNotify) g_ptr_array_unref);
+	}
+	g_object_set_data_full (G_OBJECT (sack), "pk-dnf-deps-cache",
+				cache, (GDestroyNotify) pk_dnf_deps_cache_free);
+	return cache;
+}
+
+/* returns the packages pkg points at, which are owned by the sack */
+static GPtrArray *
+pk_dnf_deps_get_edges (DnfSack *sack, DnfPackage *pkg, PkDnfDepsDirection direction)
+{
+	GPtrArray *edges;
+	HyQuery query;
+	DnfReldepList *reldeps;
+	gpointer key = GINT_TO_POINTER (dnf_package_get_id (pkg));
+
+	g_mutex_lock (&deps_cache_mutex);
+	edges = g_hash_table_lookup (pk_dnf_deps_cache_for_sack (sack)->edges[direction], key);
+	g_mutex_unlock (&deps_cache_mutex);
+	if (edges != NULL)
+		return edges;
+
+	query = hy_query_create (sack);
+	if (direction == PK_DNF_DEPS_DIRECTION_DEPENDS_ON) {
+		reldeps = dnf_package_get_requires (pkg);
+		hy_query_filter_reldep_in (query, HY_PKG_PROVIDES, reldeps);
+	} else {
+		reldeps = dnf_package_get_provides (pkg);
+		hy_query_filter_reldep_in (query, HY_PKG_REQUIRES, reldeps);
+	}
+	edges = hy_query_run (query);
+	hy_query_free (query);
+	dnf_reldep_list_free (reldeps);
+
+	/* another job may have got there first, keep the one in the cache */
+	g_mutex_lock (&deps_cache_mutex);
+	if (g_hash_table_contains (pk_dnf_deps_cache_for_sack (sack)->edges[direction], key)) {
+		g_ptr_array_unref (edges);
+		edges = g_hash_table_lookup (pk_dnf_deps_cache_for_sack (sack)->edges[direction], key);
+	} else {
+		g_hash_table_insert (pk_dnf_deps_cache_for_sack (sack)->edges[direction], key, edges);
+	}
+	g_mutex_unlock (&deps_cache_mutex);
+	return edges;
+}
+
+static gboolean
+pk_backend_deps_emit_level (PkBackendJob *job,
+			    DnfSack *sack,
+			    GPtrArray *level,
+			    PkBitfield filters,
+			    GError **error)
+{
+	DnfDb *db;
+	DnfPackageSet *pkgset;
+	HyQuery query;
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	g_autoptr(GPtrArray) pkglist = NULL;
+
+	pkgset = dnf_packageset_new (sack);
+	for (guint i = 0; i < level->len; i++)
+		dnf_packageset_add (pkgset, g_ptr_array_index (level, i));
+	query = hy_query_create (sack);
+	hy_query_filter_package_in (query, HY_PKG, HY_EQ, pkgset);
+	pkglist = dnf_utils_run_query_with_filters (job, sack, query, filters);
+	hy_query_free (query);
+	dnf_packageset_free (pkgset);
+
+	if (!dnf_transaction_ensure_repo_list (job_data->transaction, pkglist, error))
+		return FALSE;
+	db = dnf_transaction_get_db (job_data->transaction);
+	dnf_db_ensure_origin_pkglist (db, pkglist);
+	dnf_emit_package_list_filter (job, filters, pkglist);
+	return TRUE;
+}
+
+/**
+ * pk_backend_deps_thread:
+ *
+ * Walks the closure of all the requested packages together, one level at a
+ * time, so a package reached from several of them is only expanded once.
+ **/
+static void
+pk_backend_deps_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	g_autoptr(GMutexLocker) context_locker = pk_backend_context_lock (pk_backend_job_get_backend (job));
+	gboolean recursive;
+	gboolean ret;
+	DnfPackage *pkg;
+	DnfState *state_local;
+	GHashTableIter iter;
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkBitfield filters;
+	PkDnfDepsDirection direction;
+	g_autofree gchar **package_ids = NULL;
+	g_autoptr(DnfSack) sack = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) hash = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+	g_autoptr(GPtrArray) level = NULL;
+
+	g_variant_get (params, "(t^a&sb)", &filters, &package_ids, &recursive);
+	direction = pk_backend_job_get_role (job) == PK_ROLE_ENUM_DEPENDS_ON ?
+			PK_DNF_DEPS_DIRECTION_DEPENDS_ON :
+			PK_DNF_DEPS_DIRECTION_REQUIRED_BY;
+
+	/* set state */
+	ret = dnf_state_set_steps (job_data->state, NULL,
+				   50, /* add repos */
+				   10, /* find packages */
+				   40, /* walk */
+				   -1);
+	g_assert (ret);
+
+	/* get sack */
+	state_local = dnf_state_get_child (job_data->state);
+	sack = dnf_utils_create_sack_for_filters (job,
+						  filters,
+						  DNF_CREATE_SACK_FLAG_USE_CACHE,
+						  state_local,
+						  &error);
+	if (sack == NULL) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
+	/* done */
+	if (!dnf_state_done (job_data->state, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
+	/* find packages */
+	hash = dnf_utils_find_package_ids (sack, package_ids, &error);
+	if (hash == NULL) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
+	/* done */
+	if (!dnf_state_done (job_data->state, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+
+	/* the requested packages are never part of the result */
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	level = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, hash);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &pkg)) {
+		if (g_hash_table_add (seen, GINT_TO_POINTER (dnf_package_get_id (pkg))))
+			g_ptr_array_add (level, pkg);
+	}
+
+	while (level->len > 0) {
+		g_autoptr(GPtrArray) next = g_ptr_array_new ();
+
+		for (guint i = 0; i < level->len; i++) {
+			GPtrArray *edges = pk_dnf_deps_get_edges (sack, g_ptr_array_index (level, i), direction);
+			for (guint j = 0; j < edges->len; j++) {
+				DnfPackage *dep = g_ptr_array_index (edges, j);
+				if (g_hash_table_add (seen, GINT_TO_POINTER (dnf_package_get_id (dep))))
+					g_ptr_array_add (next, dep);
+			}
+		}
+		if (g_cancellable_is_cancelled (pk_backend_job_get_cancellable (job))) {
+			pk_backend_job_error_code (job, PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+						   "The walk was cancelled");
+			return;
+		}
+
+		/* each level is complete here, so there is no need to wait */
+		if (next->len > 0 &&
+		    !pk_backend_deps_emit_level (job, sack, next, filters, &error)) {
+			pk_backend_job_error_code (job, error->code, "%s", error->message);
+			return;
+		}
+		g_ptr_array_unref (level);
+		level = g_steal_pointer (&next);
+		if (!recursive)
+			break;
+	}
+
+	/* done */
+	if (!dnf_state_done (job_data->state, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		return;
+	}
+}
+
+void
+pk_backend_depends_on (PkBackend *backend,
+		       PkBackendJob *job,
+		       PkBitfield filters,
+		       gchar **package_ids,
+		       gboolean recursive)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		pk_backend_job_finished (job);
+		return;
+	}
+	pk_backend_job_set_context (job, priv->context);
+	pk_backend_job_thread_create (job, pk_backend_deps_thread, NULL, NULL);
+}
+
+void
+pk_backend_required_by (PkBackend *backend,
+			PkBackendJob *job,
+			PkBitfield filters,
+			gchar **package_ids,
+			gboolean recursive)
+{
+	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
+	g_autoptr(GError) error = NULL;
+
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
+		pk_backend_job_error_code (job, error->code, "%s", error->message);
+		pk_backend_job_finished (job);
+		return;
+	}
+	pk_backend_job_set_context (job, priv->context);
+	pk_backend_job_thread_create (job, pk_backend_deps_thread, NULL, NULL);
+}
+
 void
 pk_backend_get_details_local (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
 {
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -2170,7 +3286,7 @@ pk_backend_get_files_local (PkBackend *backend, PkBackendJob *job, gchar **files
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -2326,12 +3442,13 @@ pk_backend_download_packages (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
 	}
 	pk_backend_job_set_context (job, priv->context);
+	pk_backend_job_set_resumable (job, TRUE);
 	pk_backend_job_thread_create (job, pk_backend_download_packages_thread, NULL, NULL);
 }
 
@@ -2465,6 +3582,244 @@ pk_backend_transaction_simulate (PkBackendJob *job,
 	return dnf_state_done (state, error);
 }
 
+typedef struct {
+	gchar		*install_root;
+	GMutex		 mutex;
+	GError		*error;
+} PkDnfVerifier;
+
+/* rpmts is not threadsafe, so each verification thread has its own */
+static GPrivate pk_dnf_verifier_ts = G_PRIVATE_INIT ((GDestroyNotify) rpmtsFree);
+
+static void
+pk_backend_verify_rpm_worker (gpointer data, gpointer user_data)
+{
+	DnfPackage *pkg = DNF_PACKAGE (data);
+	PkDnfVerifier *verifier = user_data;
+	const gchar *filename = dnf_package_get_filename (pkg);
+	FD_t fd;
+	Header hdr = NULL;
+	rpmRC rc = RPMRC_NOTFOUND;
+	rpmts ts;
+
+	ts = g_private_get (&pk_dnf_verifier_ts);
+	if (ts == NULL) {
+		ts = rpmtsCreate ();
+		rpmtsSetRootDir (ts, verifier->install_root);
+		g_private_set (&pk_dnf_verifier_ts, ts);
+	}
+
+	/* this checks the header digests and signature, which in turn
+	 * covers the payload digest rpm checks when installing */
+	fd = Fopen (filename, "r.ufdio");
+	if (fd != NULL && !Ferror (fd))
+		rc = rpmReadPackageFile (ts, fd, filename, &hdr);
+	if (fd != NULL)
+		Fclose (fd);
+	if (hdr != NULL)
+		headerFree (hdr);
+
+	/* whether to trust the key is decided by the transaction, which
+	 * also knows about the keys of the enabled repos */
+	if (rc != RPMRC_OK && rc != RPMRC_NOKEY && rc != RPMRC_NOTTRUSTED) {
+		g_mutex_lock (&verifier->mutex);
+		if (verifier->error == NULL) {
+			g_set_error (&verifier->error,
+				     DNF_ERROR,
+				     PK_ERROR_ENUM_PACKAGE_CORRUPT,
+				     "Downloaded package %s failed verification",
+				     filename);
+		}
+		g_mutex_unlock (&verifier->mutex);
+	}
+	g_object_unref (pkg);
+}
+
+static gboolean
+pk_backend_transaction_check_free_space (PkBackendJob *job,
+					 GPtrArray *remote_pkgs,
+					 GError **error)
+{
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	guint64 download_size;
+	guint64 free_space;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GFileInfo) info = NULL;
+
+	file = g_file_new_for_path (dnf_context_get_cache_dir (job_data->context));
+	info = g_file_query_filesystem_info (file, G_FILE_ATTRIBUTE_FILESYSTEM_FREE,
+					     NULL, error);
+	if (info == NULL)
+		return FALSE;
+	download_size = dnf_package_array_get_download_size (remote_pkgs);
+	free_space = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_FILESYSTEM_FREE);
+	if (free_space < download_size) {
+		g_autofree gchar *formatted_free = g_format_size (free_space);
+		g_autofree gchar *formatted_size = g_format_size (download_size);
+		g_set_error (error,
+			     DNF_ERROR,
+			     PK_ERROR_ENUM_NO_SPACE_ON_DEVICE,
+			     "Not enough free space in %s: needed %s, available %s",
+			     dnf_context_get_cache_dir (job_data->context),
+			     formatted_size, formatted_free);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* whatever a repo like this sends would reach the peers without a login */
+static gboolean
+pk_backend_repo_needs_credentials (DnfRepo *repo)
+{
+	const gchar *keys[] = { "username", "password", "sslclientcert", "sslclientkey", NULL };
+	const gchar *url_keys[] = { "baseurl", "mirrorlist", "metalink", NULL };
+	const gchar *id = dnf_repo_get_id (repo);
+	g_autoptr(GKeyFile) keyfile = g_key_file_new ();
+
+	/* cannot tell, so assume the worst */
+	if (dnf_repo_get_filename (repo) == NULL ||
+	    !g_key_file_load_from_file (keyfile, dnf_repo_get_filename (repo), G_KEY_FILE_NONE, NULL))
+		return TRUE;
+	for (guint i = 0; keys[i] != NULL; i++) {
+		g_autofree gchar *value = g_key_file_get_string (keyfile, id, keys[i], NULL);
+		if (value != NULL && value[0] != '\0')
+			return TRUE;
+	}
+
+	/* user:password@host */
+	for (guint i = 0; url_keys[i] != NULL; i++) {
+		g_autofree gchar *value = g_key_file_get_string (keyfile, id, url_keys[i], NULL);
+		const gchar *authority;
+		if (value == NULL || (authority = strstr (value, "://")) == NULL)
+			continue;
+		authority += 3;
+		if (memchr (authority, '@', strcspn (authority, "/ \t,")) != NULL)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* what a peer sends is checked against the repo metadata here, and
+ * verified with the mirror downloads afterwards */
+static GPtrArray *
+pk_backend_transaction_fetch_from_peers (PkBackendJob *job, GPtrArray *pkgs)
+{
+	GPtrArray *missing = g_ptr_array_new ();
+
+	for (guint i = 0; i < pkgs->len; i++) {
+		DnfPackage *pkg = g_ptr_array_index (pkgs, i);
+		const gchar *filename = dnf_package_get_filename (pkg);
+		gboolean valid = FALSE;
+
+		if (filename != NULL &&
+		    pk_backend_job_fetch_from_peers (job, dnf_package_get_package_id (pkg), filename,
+						     (goffset) dnf_package_get_downloadsize (pkg))) {
+			if (dnf_package_check_filename (pkg, &valid, NULL) && valid)
+				continue;
+			g_debug ("%s from a peer does not match, downloading it", filename);
+			g_unlink (filename);
+		}
+		g_ptr_array_add (missing, pkg);
+	}
+	return missing;
+}
+
+/* download one repo at a time and verify what has arrived on worker
+ * threads whilst the next repo is downloading */
+static gboolean
+pk_backend_transaction_download (PkBackendJob *job,
+				 DnfState *state,
+				 GError **error)
+{
+	GPtrArray *remote_pkgs;
+	GThreadPool *pool;
+	PkBackendDnfJobData *job_data = pk_backend_job_get_user_data (job);
+	PkDnfVerifier verifier = { NULL };
+	gboolean ret = TRUE;
+	guint i;
+	g_autoptr(GHashTable) by_repo = NULL;
+	g_autoptr(GPtrArray) repos = NULL;
+
+	remote_pkgs = dnf_transaction_get_remote_pkgs (job_data->transaction);
+	if (!pk_backend_transaction_check_free_space (job, remote_pkgs, error))
+		return FALSE;
+
+	repos = g_ptr_array_new ();
+	by_repo = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					 NULL, (GDestroyNotify) g_ptr_array_unref);
+	for (i = 0; i < remote_pkgs->len; i++) {
+		DnfPackage *pkg = g_ptr_array_index (remote_pkgs, i);
+		DnfRepo *repo = dnf_package_get_repo (pkg);
+		GPtrArray *pkgs = g_hash_table_lookup (by_repo, repo);
+		if (pkgs == NULL) {
+			pkgs = g_ptr_array_new ();
+			g_hash_table_insert (by_repo, repo, pkgs);
+			g_ptr_array_add (repos, repo);
+		}
+		g_ptr_array_add (pkgs, pkg);
+	}
+
+	/* exclusive, so the threads and their rpmts go away with the pool */
+	pool = g_thread_pool_new (pk_backend_verify_rpm_worker, &verifier,
+				  (gint) g_get_num_processors (), TRUE, error);
+	if (pool == NULL)
+		return FALSE;
+	verifier.install_root = dnf_utils_real_path (dnf_context_get_install_root (job_data->context));
+	g_mutex_init (&verifier.mutex);
+
+	dnf_state_set_number_steps (state, repos->len);
+	for (i = 0; i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		GPtrArray *pkgs = g_hash_table_lookup (by_repo, repo);
+		DnfState *state_local = dnf_state_get_child (state);
+		g_autoptr(GPtrArray) missing = NULL;
+
+		missing = pk_backend_transaction_fetch_from_peers (job, pkgs);
+		if (missing->len > 0) {
+			ret = dnf_repo_download_packages (repo, missing, NULL, state_local, error);
+			if (!ret)
+				break;
+		}
+		for (guint j = 0; j < pkgs->len; j++)
+			g_thread_pool_push (pool, g_object_ref (g_ptr_array_index (pkgs, j)), NULL);
+
+		/* fail before downloading anything else */
+		g_mutex_lock (&verifier.mutex);
+		ret = verifier.error == NULL;
+		g_mutex_unlock (&verifier.mutex);
+		if (!ret)
+			break;
+
+		ret = dnf_state_done (state, error);
+		if (!ret)
+			break;
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	if (verifier.error != NULL) {
+		g_clear_error (error);
+		g_propagate_error (error, verifier.error);
+		ret = FALSE;
+	}
+
+	/* only once every package has been verified */
+	for (i = 0; ret && i < repos->len; i++) {
+		DnfRepo *repo = g_ptr_array_index (repos, i);
+		GPtrArray *pkgs = g_hash_table_lookup (by_repo, repo);
+		if (pk_backend_repo_needs_credentials (repo))
+			continue;
+		for (guint j = 0; j < pkgs->len; j++) {
+			DnfPackage *pkg = g_ptr_array_index (pkgs, j);
+			pk_backend_job_share_with_peers (job,
+							 dnf_package_get_package_id (pkg),
+							 dnf_package_get_filename (pkg));
+		}
+	}
+	g_mutex_clear (&verifier.mutex);
+	g_free (verifier.install_root);
+	return ret;
+}
+
 static gboolean
 pk_backend_transaction_download_commit (PkBackendJob *job,
 					DnfState *state,
@@ -2499,9 +3854,7 @@ pk_backend_transaction_download_commit (PkBackendJob *job,
 	                  G_CALLBACK (pk_backend_download_percentage_changed_cb),
 	                  job);
 	pk_backend_download_percentage_changed_cb (state, 0, job);
-	ret = dnf_transaction_download (job_data->transaction,
-					state_local,
-					error);
+	ret = pk_backend_transaction_download (job, state_local, error);
 	if (!ret)
 		return FALSE;
 	pk_backend_download_percentage_changed_cb (state, 100, job);
@@ -2876,7 +4229,7 @@ pk_backend_repo_remove (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3056,7 +4409,7 @@ pk_backend_remove_packages (PkBackend *backend, PkBackendJob *job,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3245,7 +4598,7 @@ pk_backend_install_packages (PkBackend *backend, PkBackendJob *job,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3357,7 +4710,7 @@ pk_backend_install_files (PkBackend *backend, PkBackendJob *job,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3471,7 +4824,7 @@ pk_backend_update_packages (PkBackend *backend, PkBackendJob *job,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3576,7 +4929,7 @@ pk_backend_upgrade_system (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3723,7 +5076,7 @@ pk_backend_get_files (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3748,7 +5101,7 @@ pk_backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpoint
 	g_autoptr(DnfSack) sack = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GHashTable) hash = NULL;
-	g_autoptr(GHashTable) advisories_hash = NULL;
+	PkDnfAdvisoryIndex *advisories;
 
 	/* set state */
 	ret = dnf_state_set_steps (job_data->state, NULL,
@@ -3791,7 +5144,7 @@ pk_backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpoint
 		return;
 	}
 
-	advisories_hash = pk_backend_dnf_cache_advisories (sack);
+	advisories = pk_backend_dnf_cache_advisories (sack);
 
 	/* emit details for each */
 	for (i = 0; package_ids[i] != NULL; i++) {
@@ -3802,7 +5155,7 @@ pk_backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpoint
 		pkg = g_hash_table_lookup (hash, package_ids[i]);
 		if (pkg == NULL)
 			continue;
-		advisory = pk_backend_dnf_get_advisory (advisories_hash, pkg);
+		advisory = pk_backend_dnf_get_advisory (advisories, pkg);
 		if (advisory == NULL)
 			continue;
 
@@ -3874,7 +5227,7 @@ pk_backend_get_update_detail (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -3944,7 +5297,7 @@ pk_backend_repair_system (PkBackend *backend,
 	PkBackendDnfPrivate *priv = pk_backend_get_user_data (backend);
 	g_autoptr(GError) error = NULL;
 
-	if (!pk_backend_ensure_default_dnf_context (backend, &error)) {
+	if (!pk_backend_ensure_dnf_context (backend, job, &error)) {
 		pk_backend_job_error_code (job, error->code, "%s", error->message);
 		pk_backend_job_finished (job);
 		return;
@@ -48,6 +48,10 @@ typedef struct {
 	gchar		**values;
 	PkBitfield	 filters;
 	gboolean	 fake_db_locked;
+	guint		 synthetic_packages;
+	guint		 synthetic_rate;
+	gchar		*synthetic_broken;
+	gboolean	 serial;
 } PkBackendDummyPrivate;
 
 typedef struct {
@@ -69,11 +73,95 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv->repo_enabled_devel = TRUE;
 	priv->repo_enabled_livna = TRUE;
 	priv->use_trusted = TRUE;
+
+	/* for pk-bench: Resolve, GetPackages and GetUpdates return this
+	 * many generated packages, at most SyntheticRate per second */
+	priv->synthetic_packages = MAX (g_key_file_get_integer (conf, "Dummy", "SyntheticPackages", NULL), 0);
+	priv->synthetic_rate = MAX (g_key_file_get_integer (conf, "Dummy", "SyntheticRate", NULL), 0);
+
+	/* for the self tests: installing this generated package fails, and
+	 * the backend behaves as if it was not thread safe */
+	priv->synthetic_broken = g_key_file_get_string (conf, "Dummy", "SyntheticBroken", NULL);
+	priv->serial = g_key_file_get_boolean (conf, "Dummy", "Serial", NULL);
+}
+
+static gboolean
+pk_backend_dummy_is_synthetic (const gchar *search)
+{
+	guint64 idx;
+	g_autofree gchar *name = NULL;
+
+	if (priv->synthetic_packages == 0 || !g_str_has_prefix (search, "synthetic-"))
+		return FALSE;
+	name = g_strndup (search, strcspn (search, ";"));
+	if (!g_ascii_string_to_unsigned (name + strlen ("synthetic-"), 10,
+					 0, priv->synthetic_packages - 1, &idx, NULL))
+		return FALSE;
+	return TRUE;
+}
+
+static void
+pk_backend_dummy_emit_synthetic (PkBackendJob *job, const gchar *name,
+				 PkInfoEnum info)
+{
+	g_autofree gchar *package_id = NULL;
+	package_id = g_strdup_printf ("%s;1.0-1;x86_64;bench", name);
+	pk_backend_job_package (job, info, package_id, "Synthetic benchmark package");
+}
+
+static void
+pk_backend_dummy_synthetic_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkInfoEnum info = GPOINTER_TO_UINT (user_data);
+	gint64 start = g_get_monotonic_time ();
+
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	for (guint i = 0; i < priv->synthetic_packages; i++) {
+		g_autofree gchar *name = NULL;
+
+		/* pace the output rather than sending it in bursts */
+		if (priv->synthetic_rate > 0) {
+			gint64 due = start + (gint64) i * G_USEC_PER_SEC / priv->synthetic_rate;
+			gint64 now = g_get_monotonic_time ();
+			if (due > now)
+				g_usleep (due - now);
+		}
+		name = g_strdup_printf ("synthetic-%u", i);
+		pk_backend_dummy_emit_synthetic (job, name, info);
+	}
+}
+
+static void
+pk_backend_dummy_synthetic_install_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBitfield transaction_flags;
+	g_autofree gchar **package_ids = NULL;
+
+	g_variant_get (params, "(t^a&s)",
+		       &transaction_flags,
+		       &package_ids);
+
+	/* all or nothing, like a real transaction */
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_INSTALL);
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		g_auto(GStrv) split = pk_package_id_split (package_ids[i]);
+		if (g_strcmp0 (split[PK_PACKAGE_ID_NAME], priv->synthetic_broken) == 0) {
+			pk_backend_job_error_code (job, PK_ERROR_ENUM_PACKAGE_FAILED_TO_INSTALL,
+						   "%s failed to install", package_ids[i]);
+			return;
+		}
+	}
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		g_auto(GStrv) split = pk_package_id_split (package_ids[i]);
+		pk_backend_dummy_emit_synthetic (job, split[PK_PACKAGE_ID_NAME],
+						 PK_INFO_ENUM_INSTALLING);
+	}
 }
 
 void
 pk_backend_destroy (PkBackend *backend)
 {
+	g_free (priv->synthetic_broken);
 	g_free (priv);
 }
 
@@ -472,6 +560,12 @@ void
 pk_backend_get_updates (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
 	PkBackendDummyJobData *job_data = pk_backend_job_get_user_data (job);
+
+	if (priv->synthetic_packages > 0) {
+		pk_backend_job_thread_create (job, pk_backend_dummy_synthetic_thread,
+					      GUINT_TO_POINTER (PK_INFO_ENUM_NORMAL), NULL);
+		return;
+	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
 	/* check network state */
@@ -507,6 +601,27 @@ pk_backend_install_thread (PkBackendJob *job, GVariant *params, gpointer user_da
 		if (job_data->progress_percentage == 100)
 			break;
 
+		/* pipelined, so the second download overlaps the first install */
+		if (pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_PIPELINE)) {
+			if (job_data->progress_percentage < 30) {
+				pk_backend_job_set_item_progress (job,
+								  "gtkhtml2;2.19.1-4.fc8;i386;fedora",
+								  PK_STATUS_ENUM_DOWNLOAD,
+								  job_data->progress_percentage * 100 / 30);
+			} else if (job_data->progress_percentage < 50) {
+				pk_backend_job_set_item_progress (job,
+								  "gtkhtml2;2.19.1-4.fc8;i386;fedora",
+								  PK_STATUS_ENUM_INSTALL,
+								  (job_data->progress_percentage - 30) * 100 / 20);
+			}
+			if (job_data->progress_percentage >= 30 && job_data->progress_percentage < 50) {
+				pk_backend_job_set_item_progress (job,
+								  "gtkhtml2-devel;2.19.1-0.fc8;i386;fedora",
+								  PK_STATUS_ENUM_DOWNLOAD,
+								  (job_data->progress_percentage - 30) * 100 / 20);
+			}
+		}
+
 		if (job_data->progress_percentage == 30) {
 			pk_backend_job_set_allow_cancel (job, FALSE);
 			pk_backend_job_package (job, PK_INFO_ENUM_INSTALLING,
@@ -567,10 +682,22 @@ pk_backend_install_packages (PkBackend *backend, PkBackendJob *job, PkBitfield t
 		pk_backend_job_package (job, PK_INFO_ENUM_UPDATING,
 					"gtkhtml2;2.19.1-4.fc8;i386;fedora", "An HTML widget for GTK+ 2.0");
 
+		/* the daemon keeps this for the commit */
+		pk_backend_job_set_plan (job, g_strjoinv (",", package_ids), g_free);
 		pk_backend_job_finished (job);
 		return;
 	}
 
+	/* nothing to solve again when the simulation was confirmed */
+	if (pk_backend_job_get_plan (job) != NULL)
+		g_debug ("committing the simulated plan for %s",
+			 (const gchar *) pk_backend_job_get_plan (job));
+
+	if (pk_backend_dummy_is_synthetic (package_ids[0])) {
+		pk_backend_job_thread_create (job, pk_backend_dummy_synthetic_install_thread, NULL, NULL);
+		return;
+	}
+
 	if (g_strcmp0 (package_ids[0], "vips-doc;7.12.4-2.fc8;noarch;linva") == 0) {
 		if (priv->use_gpg && !priv->has_signature) {
 			pk_backend_job_repo_signature_required (job, package_ids[0], "updates",
@@ -770,7 +897,10 @@ pk_backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_da
 	/* each one has a different detail for testing */
 	len = g_strv_length (search);
 	for (i = 0; i < len; i++) {
-		if (g_strcmp0 (search[i], "vips-doc") == 0 || g_strcmp0 (search[i], "vips-doc;7.12.4-2.fc8;noarch;linva") == 0) {
+		if (pk_backend_dummy_is_synthetic (search[i])) {
+			g_autofree gchar *name = g_strndup (search[i], strcspn (search[i], ";"));
+			pk_backend_dummy_emit_synthetic (job, name, PK_INFO_ENUM_INSTALLED);
+		} else if (g_strcmp0 (search[i], "vips-doc") == 0 || g_strcmp0 (search[i], "vips-doc;7.12.4-2.fc8;noarch;linva") == 0) {
 			if (!pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED)) {
 				pk_backend_job_package (job, PK_INFO_ENUM_AVAILABLE,
 							"vips-doc;7.12.4-2.fc8;noarch;linva",
@@ -1443,6 +1573,11 @@ pk_backend_what_provides (PkBackend *backend, PkBackendJob *job, PkBitfield filt
 void
 pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
 {
+	if (priv->synthetic_packages > 0) {
+		pk_backend_job_thread_create (job, pk_backend_dummy_synthetic_thread,
+					      GUINT_TO_POINTER (PK_INFO_ENUM_INSTALLED), NULL);
+		return;
+	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REQUEST);
 	pk_backend_job_package (job, PK_INFO_ENUM_INSTALLED,
 				"update1;2.19.1-4.fc8;i386;fedora",
@@ -1590,7 +1725,17 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 gboolean
 pk_backend_supports_parallelization (PkBackend *backend)
 {
-	return TRUE;
+	return !priv->serial;
+}
+
+PkBitfield
+pk_backend_get_reader_roles (PkBackend *backend)
+{
+	/* only asked when not parallel */
+	return pk_bitfield_from_enums (PK_ROLE_ENUM_RESOLVE,
+		PK_ROLE_ENUM_SEARCH_DETAILS,
+		PK_ROLE_ENUM_SEARCH_NAME,
+		-1);
 }
 
 const gchar *
@@ -57,6 +57,8 @@ from entropy.locks import EntropyResourcesLock
 import entropy.tools
 import entropy.dep
 
+import entropySnapshot
+
 PK_DEBUG = False
 
 
@@ -303,6 +305,48 @@ class PackageKitEntropyMixin(object):
                 size += extra_download['size']
         return size
 
+    def _etp_save_snapshot(self):
+        """
+        Write the package metadata snapshot read by entropySnapshot.py, so
+        that the next queries don't need to load the Entropy client.
+        """
+        paths = [etpConst['etpdatabaseclientfilepath']]
+        repo_data = self._settings['repositories']['available']
+        for repo in self._entropy.repositories():
+            db_dir = repo_data.get(repo, {}).get('dbpath')
+            if db_dir is None:
+                continue
+            paths.append(os.path.join(db_dir, etpConst['etpdatabasefile']))
+            paths.append(os.path.join(db_dir,
+                                      etpConst['etpdatabaserevisionfile']))
+
+        # stamp first, a change while reading invalidates the snapshot
+        sources = entropySnapshot.stamp_sources(paths)
+
+        inst_pkgs_repo_id = PackageKitEntropyMixin.INST_PKGS_REPO_ID
+        packages = []
+        for repo_db, repo in self._get_all_repos():
+            try:
+                pkg_ids = repo_db.listAllIdpackages()
+            except AttributeError:
+                pkg_ids = repo_db.listAllPackageIds()
+            installed = repo == inst_pkgs_repo_id
+            for pkg_id in pkg_ids:
+                visible = installed or repo_db.maskFilter(pkg_id)[0] != -1
+                packages.append([
+                    self._etp_to_id((pkg_id, repo_db)),
+                    repo_db.retrieveAtom(pkg_id),
+                    repo_db.retrieveKeySlot(pkg_id)[0],
+                    repo_db.retrieveDescription(pkg_id),
+                    installed,
+                    visible,
+                ])
+
+        try:
+            entropySnapshot.save(sources, packages)
+        except (IOError, OSError) as err:
+            self._log_message(__name__, "cannot save snapshot: %s" % (err,))
+
     def _pk_feed_sorted_pkgs(self, pkgs):
         """
         Given an unsorted list of tuples composed by repository identifier and
@@ -1635,6 +1679,7 @@ class PackageKitEntropyBackend(PackageKitBaseBackend, PackageKitEntropyMixin):
         ex_rc = repo_intf.sync()
         if not ex_rc:
             self._etp_update_repository_stats(repo_identifiers)
+            self._etp_save_snapshot()
         else:
             self._log_message(__name__, "Cannot update repositories!")
 
@@ -0,0 +1,181 @@
+#!/usr/bin/python2
+# -*- coding: utf-8 -*-
+#
+# Copyright (C) 2026 The PackageKit Authors
+#
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+
+"""
+Package metadata snapshot for the read-only queries.
+
+entropyBackend.py writes the snapshot, recording the size and mtime of
+the repository databases, their revision files and the installed
+packages database it was built from. This helper serves GetPackages,
+Resolve and SearchName straight from it while none of those files have
+changed; otherwise it loads the full Entropy client stack through
+entropyBackend.py, answers from there and writes a fresh snapshot.
+"""
+
+import json
+import os
+import re
+import sys
+
+from packagekit.enums import *
+from packagekit.backend import PackageKitBaseBackend
+
+SNAPSHOT_FILE = "/var/lib/entropy/client/packagekit-snapshot.json"
+SNAPSHOT_VERSION = 1
+
+# indexes in the package rows
+ROW_ID, ROW_ATOM, ROW_KEY, ROW_SUMMARY, ROW_INSTALLED, ROW_VISIBLE = range(6)
+
+# what Resolve can match without entropy.dep
+_PLAIN_NAME = re.compile(r"^[A-Za-z0-9_+.-]+(/[A-Za-z0-9_+.-]+)?$")
+
+
+def _stamp(path):
+    try:
+        st = os.stat(path)
+    except OSError:
+        return None
+    return [st.st_mtime, st.st_size]
+
+
+def save(sources, packages):
+    """
+    Write the snapshot atomically. sources must be stamped by the caller
+    before the packages were read, with stamp_sources().
+    """
+    data = {
+        "version": SNAPSHOT_VERSION,
+        "sources": sources,
+        "packages": sorted(packages, key=lambda row: row[ROW_ATOM]),
+    }
+    tmp_path = SNAPSHOT_FILE + ".tmp"
+    with open(tmp_path, "w") as tmp_f:
+        json.dump(data, tmp_f)
+    os.rename(tmp_path, SNAPSHOT_FILE)
+
+
+def stamp_sources(paths):
+    return dict((path, _stamp(path)) for path in paths)
+
+
+def load():
+    """
+    Return the package rows, or None if the snapshot is missing or stale.
+    """
+    try:
+        with open(SNAPSHOT_FILE, "r") as snap_f:
+            data = json.load(snap_f)
+    except (IOError, OSError, ValueError):
+        return None
+
+    if data.get("version") != SNAPSHOT_VERSION:
+        return None
+    for path, stamp in data.get("sources", {}).items():
+        if _stamp(path) != stamp:
+            return None
+    return data.get("packages")
+
+
+class PackageKitEntropySnapshotBackend(PackageKitBaseBackend):
+
+    def __init__(self, args):
+        PackageKitBaseBackend.__init__(self, args)
+        self._rows = None
+        self._full = None
+
+    def _full_backend(self):
+        if self._full is None:
+            sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+            import entropyBackend
+            self._full = entropyBackend.PackageKitEntropyBackend("")
+        return self._full
+
+    def _get_rows(self, filters):
+        # the license check needs the entropy client
+        if FILTER_FREE in filters or FILTER_NOT_FREE in filters:
+            return None
+        if self._rows is None:
+            self._rows = load()
+        return self._rows
+
+    def _fallback(self, method, *args):
+        full = self._full_backend()
+        getattr(full, method)(*args)
+        self._rows = None
+        full._etp_save_snapshot()
+
+    def _feed(self, rows, filters):
+        self.status(STATUS_QUERY)
+        self.allow_cancel(True)
+        self.percentage(0)
+        for row in rows:
+            if FILTER_INSTALLED in filters and not row[ROW_INSTALLED]:
+                continue
+            if FILTER_NOT_INSTALLED in filters and row[ROW_INSTALLED]:
+                continue
+            if row[ROW_INSTALLED]:
+                info = INFO_INSTALLED
+            else:
+                info = INFO_AVAILABLE
+            self.package(row[ROW_ID], info, row[ROW_SUMMARY])
+        self.percentage(100)
+
+    def get_packages(self, filters):
+        rows = self._get_rows(filters)
+        if rows is None:
+            return self._fallback("get_packages", filters)
+        self._feed(rows, filters)
+
+    def resolve(self, filters, values):
+        rows = self._get_rows(filters)
+        if rows is None or \
+                not all(_PLAIN_NAME.match(value) for value in values):
+            return self._fallback("resolve", filters, values)
+
+        # atomMatch drops masked packages, so do the same
+        matches = []
+        for row in rows:
+            if not row[ROW_VISIBLE]:
+                continue
+            key = row[ROW_KEY]
+            name = key.split("/")[-1]
+            if key in values or name in values:
+                matches.append(row)
+        self._feed(matches, filters)
+
+    def search_name(self, filters, values):
+        rows = self._get_rows(filters)
+        if rows is None:
+            return self._fallback("search_name", filters, values)
+
+        # searchPackages is a case-insensitive LIKE on the atom
+        keys = [value.lower() for value in values]
+        matches = [row for row in rows
+                   if any(key in row[ROW_ATOM].lower() for key in keys)]
+        self._feed(matches, filters)
+
+
+def main():
+    backend = PackageKitEntropySnapshotBackend("")
+    backend.dispatcher(sys.argv[1:])
+
+if __name__ == "__main__":
+    main()
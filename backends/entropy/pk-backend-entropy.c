@@ -25,6 +25,8 @@
 
 static PkBackendSpawn *spawn = 0;
 static const gchar* BACKEND_FILE = "entropyBackend.py";
+/* answers the read-only queries from a metadata snapshot */
+static const gchar* QUERY_FILE = "entropySnapshot.py";
 
 void
 pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
@@ -391,7 +393,7 @@ pk_backend_resolve(PkBackend *backend,
 
 	filters_text = pk_filter_bitfield_to_string(filters);
 	package_ids_temp = pk_package_ids_to_string(package_ids);
-	pk_backend_spawn_helper(spawn, job, BACKEND_FILE,
+	pk_backend_spawn_helper(spawn, job, QUERY_FILE,
 				"resolve", filters_text,
 				package_ids_temp, NULL);
 	g_free(package_ids_temp);
@@ -459,7 +461,7 @@ pk_backend_search_names(PkBackend *backend,
 	gchar *search;
 	filters_text = pk_filter_bitfield_to_string(filters);
 	search = g_strjoinv("&", values);
-	pk_backend_spawn_helper(spawn, job, BACKEND_FILE,
+	pk_backend_spawn_helper(spawn, job, QUERY_FILE,
 				"search-name", filters_text,
 				search, NULL);
 	g_free(filters_text);
@@ -494,7 +496,7 @@ pk_backend_get_packages(PkBackend *backend,
 	gchar *filters_text;
 
 	filters_text = pk_filter_bitfield_to_string(filters);
-	pk_backend_spawn_helper(spawn, job, BACKEND_FILE,
+	pk_backend_spawn_helper(spawn, job, QUERY_FILE,
 				"get-packages", filters_text,
 				NULL);
 	g_free (filters_text);
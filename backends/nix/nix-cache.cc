@@ -0,0 +1,317 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed i3n the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <algorithm>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <sqlite3.h>
+
+#include "nix-cache.hh"
+#include "nix-helpers.hh"
+
+// the packages of the channels identified by cache_key
+static std::shared_ptr<const NixPackages> cache_packages;
+static string cache_key;
+static GMutex cache_mutex;
+
+static gchar*
+nix_cache_get_filename ()
+{
+	return g_build_filename (LOCALSTATEDIR, "cache", "PackageKit", "nix", "derivations.db", NULL);
+}
+
+// the store paths ~/.nix-defexpr resolves to, which change with every
+// channel update
+static string
+nix_cache_get_key (const Path & homedir)
+{
+	string key;
+	Path defexpr = homedir + "/.nix-defexpr";
+	const gchar* entry;
+	std::vector<string> entries;
+
+	GDir* dir = g_dir_open (defexpr.c_str (), 0, NULL);
+	if (dir == NULL)
+		return key;
+	while ((entry = g_dir_read_name (dir)) != NULL)
+		entries.push_back (entry);
+	g_dir_close (dir);
+
+	std::sort (entries.begin (), entries.end ());
+	for (auto & name : entries)
+	{
+		gchar* target = realpath ((defexpr + "/" + name).c_str (), NULL);
+		key += name + "=" + (target != NULL ? target : "") + ";";
+		free (target);
+	}
+
+	return key;
+}
+
+static sqlite3*
+nix_cache_open ()
+{
+	sqlite3* db = NULL;
+	gchar* filename = nix_cache_get_filename ();
+	gchar* dirname = g_path_get_dirname (filename);
+
+	g_mkdir_with_parents (dirname, 0755);
+	if (sqlite3_open (filename, &db) != SQLITE_OK ||
+	    sqlite3_exec (db,
+			  "CREATE TABLE IF NOT EXISTS cache_info (key TEXT PRIMARY KEY, value TEXT);"
+			  "CREATE TABLE IF NOT EXISTS packages (attr_path TEXT, name TEXT, version TEXT, "
+			  "system TEXT, description TEXT, license TEXT, failed INTEGER);",
+			  NULL, NULL, NULL) != SQLITE_OK)
+	{
+		g_warning ("failed to open %s: %s", filename, sqlite3_errmsg (db));
+		sqlite3_close (db);
+		db = NULL;
+	}
+
+	g_free (dirname);
+	g_free (filename);
+	return db;
+}
+
+static const char*
+nix_cache_column (sqlite3_stmt* stmt, int column)
+{
+	const unsigned char* text = sqlite3_column_text (stmt, column);
+	return text != NULL ? (const char*) text : "";
+}
+
+// load the packages saved for key, if any
+static std::shared_ptr<NixPackages>
+nix_cache_load (sqlite3* db, const string & key)
+{
+	sqlite3_stmt* stmt = NULL;
+	std::shared_ptr<NixPackages> packages;
+
+	if (sqlite3_prepare_v2 (db, "SELECT value FROM cache_info WHERE key = 'channels'", -1, &stmt, NULL) != SQLITE_OK)
+		return packages;
+	bool valid = sqlite3_step (stmt) == SQLITE_ROW && key == nix_cache_column (stmt, 0);
+	sqlite3_finalize (stmt);
+	if (!valid)
+		return packages;
+
+	if (sqlite3_prepare_v2 (db,
+				"SELECT attr_path, name, version, system, description, license, failed FROM packages",
+				-1, &stmt, NULL) != SQLITE_OK)
+		return packages;
+
+	packages = std::make_shared<NixPackages> ();
+	while (sqlite3_step (stmt) == SQLITE_ROW)
+	{
+		NixPackage package;
+		package.attrPath = nix_cache_column (stmt, 0);
+		package.name = nix_cache_column (stmt, 1);
+		package.version = nix_cache_column (stmt, 2);
+		package.system = nix_cache_column (stmt, 3);
+		package.description = nix_cache_column (stmt, 4);
+		package.license = nix_cache_column (stmt, 5);
+		package.failed = sqlite3_column_int (stmt, 6) != 0;
+		packages->push_back (package);
+	}
+	sqlite3_finalize (stmt);
+
+	return packages;
+}
+
+static void
+nix_cache_save (sqlite3* db, const string & key, const NixPackages & packages)
+{
+	sqlite3_stmt* stmt = NULL;
+
+	sqlite3_exec (db, "BEGIN TRANSACTION; DELETE FROM packages; DELETE FROM cache_info;", NULL, NULL, NULL);
+
+	if (sqlite3_prepare_v2 (db,
+				"INSERT INTO packages (attr_path, name, version, system, description, license, failed) "
+				"VALUES (?, ?, ?, ?, ?, ?, ?)",
+				-1, &stmt, NULL) == SQLITE_OK)
+	{
+		for (auto & package : packages)
+		{
+			sqlite3_bind_text (stmt, 1, package.attrPath.c_str (), -1, SQLITE_STATIC);
+			sqlite3_bind_text (stmt, 2, package.name.c_str (), -1, SQLITE_STATIC);
+			sqlite3_bind_text (stmt, 3, package.version.c_str (), -1, SQLITE_STATIC);
+			sqlite3_bind_text (stmt, 4, package.system.c_str (), -1, SQLITE_STATIC);
+			sqlite3_bind_text (stmt, 5, package.description.c_str (), -1, SQLITE_STATIC);
+			sqlite3_bind_text (stmt, 6, package.license.c_str (), -1, SQLITE_STATIC);
+			sqlite3_bind_int (stmt, 7, package.failed);
+			sqlite3_step (stmt);
+			sqlite3_reset (stmt);
+		}
+		sqlite3_finalize (stmt);
+	}
+
+	if (sqlite3_prepare_v2 (db, "INSERT INTO cache_info (key, value) VALUES ('channels', ?)", -1, &stmt, NULL) == SQLITE_OK)
+	{
+		sqlite3_bind_text (stmt, 1, key.c_str (), -1, SQLITE_STATIC);
+		sqlite3_step (stmt);
+		sqlite3_finalize (stmt);
+	}
+
+	if (sqlite3_exec (db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK)
+	{
+		g_warning ("failed to save the derivation cache: %s", sqlite3_errmsg (db));
+		sqlite3_exec (db, "ROLLBACK", NULL, NULL, NULL);
+	}
+}
+
+// evaluate drvs, passing each package to func as soon as it is known; the
+// evaluation stops early, returning nothing, when func returns false
+static std::shared_ptr<NixPackages>
+nix_cache_evaluate (EvalState & state, DrvInfos & drvs, const NixPackageFunc & func)
+{
+	auto packages = std::make_shared<NixPackages> ();
+	auto fullNameSymbol = state.symbols.create ("fullName");
+
+	for (auto & drv : drvs)
+	{
+		NixPackage package;
+		DrvName name (drv.queryName ());
+
+		package.license = "unknown";
+		auto licenseMeta = drv.queryMeta ("license");
+		if (licenseMeta != NULL && licenseMeta->type == tAttrs)
+		{
+			Bindings::iterator fullName = licenseMeta->attrs->find (fullNameSymbol);
+			if (fullName != licenseMeta->attrs->end () && fullName->value->type == tString)
+				package.license = fullName->value->string.s;
+		}
+
+		package.attrPath = drv.attrPath;
+		package.name = name.name;
+		package.version = name.version;
+		package.system = drv.querySystem ();
+		package.description = drv.queryMetaString ("description");
+		package.failed = drv.hasFailed ();
+		packages->push_back (package);
+
+		if (func && !func (packages->back ()))
+			return nullptr;
+	}
+
+	return packages;
+}
+
+// get the packages of the current channels, evaluating ~/.nix-defexpr into
+// drvs only when the channels changed since the cache was written; func, if
+// set, sees the packages while they are evaluated
+static std::shared_ptr<const NixPackages>
+nix_cache_lookup (EvalState & state, const Path & homedir, DrvInfos & drvs, bool refresh,
+		  const NixPackageFunc & func, bool & streamed)
+{
+	string key = nix_cache_get_key (homedir);
+	std::shared_ptr<NixPackages> packages;
+	sqlite3* db;
+
+	streamed = false;
+	g_mutex_lock (&cache_mutex);
+
+	if (!refresh && cache_packages && key == cache_key)
+	{
+		auto ret = cache_packages;
+		g_mutex_unlock (&cache_mutex);
+		return ret;
+	}
+
+	db = nix_cache_open ();
+	if (!refresh && db != NULL)
+		packages = nix_cache_load (db, key);
+
+	if (!packages)
+	{
+		try
+		{
+			// possibly slow call
+			if (refresh || drvs.empty () || key != cache_key)
+				drvs = nix_get_all_derivations (state, homedir);
+			packages = nix_cache_evaluate (state, drvs, func);
+			streamed = bool (func);
+		}
+		catch (...)
+		{
+			if (db != NULL)
+				sqlite3_close (db);
+			g_mutex_unlock (&cache_mutex);
+			throw;
+		}
+
+		// stopped by the caller, keep what was cached before
+		if (!packages)
+		{
+			if (db != NULL)
+				sqlite3_close (db);
+			g_mutex_unlock (&cache_mutex);
+			return nullptr;
+		}
+
+		if (db != NULL)
+			nix_cache_save (db, key, *packages);
+	}
+	if (db != NULL)
+		sqlite3_close (db);
+
+	cache_packages = packages;
+	cache_key = key;
+	g_mutex_unlock (&cache_mutex);
+
+	return packages;
+}
+
+std::shared_ptr<const NixPackages>
+nix_cache_get_packages (EvalState & state, const Path & homedir, DrvInfos & drvs, bool refresh)
+{
+	bool streamed;
+
+	return nix_cache_lookup (state, homedir, drvs, refresh, nullptr, streamed);
+}
+
+// call func for every package of the current channels; on a cold cache it
+// runs while the derivations are evaluated, so callers can emit results
+// before the whole set is known
+void
+nix_cache_foreach_package (EvalState & state, const Path & homedir, DrvInfos & drvs,
+			   const NixPackageFunc & func)
+{
+	bool streamed;
+	auto packages = nix_cache_lookup (state, homedir, drvs, false, func, streamed);
+
+	if (!packages || streamed)
+		return;
+
+	for (auto & package : *packages)
+		if (!func (package))
+			break;
+}
+
+// generate package id from cached derivation
+gchar*
+nix_package_id (const NixPackage & package)
+{
+	return pk_package_id_build (
+		package.name.c_str (),
+		package.version.c_str (),
+		package.system.c_str (),
+		package.attrPath.c_str ()
+	);
+}
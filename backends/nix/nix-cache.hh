@@ -0,0 +1,58 @@
+/* -*- Mode: C; tab-width: 8; indent-tab-modes: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed i3n the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NIX_CACHE_HH
+#define NIX_CACHE_HH
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "nix-lib-plus.hh"
+
+// a derivation as far as the queries need it
+struct NixPackage
+{
+	string attrPath;
+	string name;
+	string version;
+	string system;
+	string description;
+	string license;
+	bool failed;
+};
+
+typedef std::vector<NixPackage> NixPackages;
+
+// return false to stop the iteration
+typedef std::function<bool (const NixPackage &)> NixPackageFunc;
+
+std::shared_ptr<const NixPackages>
+nix_cache_get_packages (EvalState & state, const Path & homedir, DrvInfos & drvs, bool refresh);
+
+void
+nix_cache_foreach_package (EvalState & state, const Path & homedir, DrvInfos & drvs,
+			   const NixPackageFunc & func);
+
+gchar*
+nix_package_id (const NixPackage & package);
+
+#endif
@@ -72,12 +72,12 @@ nix_get_drvs_from_ids (EvalState & state, DrvInfos drvs, gchar** package_ids)
 	return _drvs;
 }
 
-// return false if drvinfo doesn't conflicts with a filter
-bool
-nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkBitfield filters)
+// return false if a derivation conflicts with a filter
+static bool
+nix_filter (bool failed, const string & system, const Settings & settings, PkBitfield filters)
 {
 	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_VISIBLE) || pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_VISIBLE))
-		if (!drv.hasFailed ())
+		if (!failed)
 		{
 			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_VISIBLE))
 				return FALSE;
@@ -89,7 +89,7 @@ nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkB
 		}
 
 	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_ARCH) || pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_ARCH))
-		if (drv.querySystem() == settings.thisSystem)
+		if (system == settings.thisSystem)
 		{
 			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_ARCH))
 				return FALSE;
@@ -103,6 +103,20 @@ nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkB
 	return TRUE;
 }
 
+// return false if drvinfo doesn't conflicts with a filter
+bool
+nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkBitfield filters)
+{
+	return nix_filter (drv.hasFailed (), drv.querySystem (), settings, filters);
+}
+
+// return false if a cached derivation conflicts with a filter
+bool
+nix_filter_package (const NixPackage & package, const Settings & settings, PkBitfield filters)
+{
+	return nix_filter (package.failed, package.system, settings, filters);
+}
+
 // get current state
 EvalState*
 nix_get_state ()
@@ -29,6 +29,7 @@
 #include <pk-backend-job.h>
 
 #include "nix-lib-plus.hh"
+#include "nix-cache.hh"
 
 void
 pk_nix_run (PkBackendJob *job, PkStatusEnum status, PkBackendJobThreadFunc func, gpointer data);
@@ -57,6 +58,9 @@ nix_find_drv (EvalState & state, DrvInfos drvs, gchar* package_id);
 bool
 nix_filter_drv (EvalState & state, DrvInfo & drv, const Settings & settings, PkBitfield filters);
 
+bool
+nix_filter_package (const NixPackage & package, const Settings & settings, PkBitfield filters);
+
 Path
 nix_get_profile (PkBackendJob* job);
 
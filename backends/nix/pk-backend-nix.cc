@@ -31,15 +31,82 @@ typedef struct {
 } PkBackendNixPrivate;
 
 static PkBackendNixPrivate* priv;
+
+// the evaluator, its store connection and the derivations it evaluated are
+// shared by all jobs; EvalState is not thread-safe, so the jobs take turns
 static EvalState* state;
 static DrvInfos drvs;
+static GMutex state_mutex;
+static gint64 state_last_used;
+static guint state_evict_id;
+
+// seconds an unused evaluator is kept before its memory is given back
+#define PK_NIX_STATE_IDLE_TIMEOUT	300
+
+static void
+pk_backend_nix_state_free (void)
+{
+	drvs.clear ();
+	delete state;
+	state = NULL;
+}
+
+// held for the duration of a job; creates the evaluator on first use
+class PkNixStateLocker
+{
+public:
+	PkNixStateLocker ()
+	{
+		g_mutex_lock (&state_mutex);
+		try
+		{
+			if (state == NULL)
+				state = nix_get_state ();
+		}
+		catch (...)
+		{
+			g_mutex_unlock (&state_mutex);
+			throw;
+		}
+	}
+
+	~PkNixStateLocker ()
+	{
+		state_last_used = g_get_monotonic_time ();
+		g_mutex_unlock (&state_mutex);
+	}
+
+	// start over with a fresh evaluator, e.g. after the channels changed
+	void reset ()
+	{
+		pk_backend_nix_state_free ();
+		state = nix_get_state ();
+	}
+};
+
+static gboolean
+pk_backend_nix_state_evict_cb (gpointer user_data)
+{
+	// a job is using the evaluator, so it is not idle
+	if (!g_mutex_trylock (&state_mutex))
+		return G_SOURCE_CONTINUE;
+
+	if (state != NULL &&
+	    g_get_monotonic_time () - state_last_used > PK_NIX_STATE_IDLE_TIMEOUT * G_USEC_PER_SEC) {
+		g_debug ("freeing the idle evaluator");
+		pk_backend_nix_state_free ();
+	}
+
+	g_mutex_unlock (&state_mutex);
+	return G_SOURCE_CONTINUE;
+}
 
 void
 pk_backend_initialize (GKeyFile* conf, PkBackend* backend)
 {
 	g_debug ("backend initalize start");
 
-	priv = g_new0 (PkBackendNixPrivate, 1);
+	priv = new PkBackendNixPrivate;
 
 	struct passwd* uid_ent = NULL;
 	if ((uid_ent = getpwuid (getuid ())) == NULL)
@@ -54,18 +121,29 @@ pk_backend_initialize (GKeyFile* conf, PkBackend* backend)
 		initGC();
 
 		state = nix_get_state();
+		state_last_used = g_get_monotonic_time ();
 	}
 	catch (std::exception & e)
 	{
 	}
+
+	state_evict_id = g_timeout_add_seconds (PK_NIX_STATE_IDLE_TIMEOUT / 5,
+						pk_backend_nix_state_evict_cb,
+						NULL);
 }
 
 void
 pk_backend_destroy (PkBackend* backend)
 {
-	drvs.empty ();
-	g_free (state);
-	g_free (priv);
+	if (state_evict_id != 0)
+		g_source_remove (state_evict_id);
+	state_evict_id = 0;
+
+	g_mutex_lock (&state_mutex);
+	pk_backend_nix_state_free ();
+	g_mutex_unlock (&state_mutex);
+
+	delete priv;
 }
 
 gboolean
@@ -201,6 +279,8 @@ pk_backend_get_details_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 	try
 	{
+		PkNixStateLocker locker;
+
 		// possibly slow call
 		if (drvs.empty ())
 			drvs = nix_get_all_derivations (*state, priv->roothome);
@@ -209,7 +289,7 @@ pk_backend_get_details_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 		for (auto drv : _drvs)
 		{
-			if (pk_backend_job_is_cancelled (job))
+			if (pk_backend_job_checkpoint (job, "nix:get-details"))
 				break;
 
 			string license = "unknown";
@@ -251,6 +331,33 @@ pk_backend_get_details (PkBackend* backend, PkBackendJob* job, gchar** packages)
 	pk_nix_run (job, PK_STATUS_ENUM_INFO, pk_backend_get_details_thread, packages);
 }
 
+// emit a cached derivation unless the filters exclude it
+static void
+pk_backend_nix_emit_package (PkBackendJob* job, const NixPackage & package, DrvInfos & installedDrvs, PkBitfield filters)
+{
+	if (!nix_filter_package (package, settings, filters))
+		return;
+
+	string fullName = package.version.empty () ? package.name : package.name + "-" + package.version;
+	auto info = PK_INFO_ENUM_AVAILABLE;
+
+	for (auto & _drv : installedDrvs)
+		if (_drv.queryName() == fullName)
+		{
+			info = PK_INFO_ENUM_INSTALLED;
+			break;
+		}
+
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
+		return;
+
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && info == PK_INFO_ENUM_INSTALLED)
+		return;
+
+	g_autofree gchar* package_id = nix_package_id (package);
+	pk_backend_job_package (job, info, package_id, package.description.c_str ());
+}
+
 static void
 pk_backend_get_packages_thread (PkBackendJob* job, GVariant* params, gpointer p)
 {
@@ -261,47 +368,24 @@ pk_backend_get_packages_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		PkNixStateLocker locker;
+
+		auto packages = nix_cache_get_packages (*state, priv->roothome, drvs, false);
 
 		auto profile = nix_get_profile (job);
 		DrvInfos installedDrvs = queryInstalled (*state, profile);
 
 		int n = 0;
-		double percentFactor = 100 / drvs.size ();
+		double percentFactor = 100.0 / MAX (packages->size (), 1);
 
-		for (auto drv : drvs)
+		for (auto & package : *packages)
 		{
-			if (pk_backend_job_is_cancelled (job))
+			if (pk_backend_job_checkpoint (job, "nix:get-packages"))
 				break;
 
 			pk_backend_job_set_percentage (job, (n++) * percentFactor);
 
-			if (!nix_filter_drv (*state, drv, settings, filters))
-				continue;
-
-			auto info = PK_INFO_ENUM_AVAILABLE;
-
-			for (auto _drv : installedDrvs)
-				if (_drv.queryName() == drv.queryName())
-				{
-					info = PK_INFO_ENUM_INSTALLED;
-					break;
-				}
-
-			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
-				continue;
-
-			if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && info == PK_INFO_ENUM_INSTALLED)
-				continue;
-
-			pk_backend_job_package (
-				job,
-				info,
-				nix_drv_package_id (drv),
-				drv.queryMetaString ("description").c_str ()
-			);
+			pk_backend_nix_emit_package (job, package, installedDrvs, filters);
 		}
 	}
 	catch (std::exception & e)
@@ -328,50 +412,25 @@ pk_backend_resolve_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		PkNixStateLocker locker;
+
+		auto packages = nix_cache_get_packages (*state, priv->roothome, drvs, false);
 
 		auto profile = nix_get_profile (job);
 		DrvInfos installedDrvs = queryInstalled (*state, profile);
 
 		for (; *search != NULL; ++search)
 		{
-			if (pk_backend_job_is_cancelled (job))
+			if (pk_backend_job_checkpoint (job, "nix:resolve"))
 				break;
 
 			DrvName searchName (*search);
 
-			for (auto drv : drvs)
+			for (auto & package : *packages)
 			{
-				DrvName drvName (drv.queryName());
+				DrvName drvName (package.version.empty () ? package.name : package.name + "-" + package.version);
 				if (searchName.matches (drvName))
-				{
-					if (!nix_filter_drv (*state, drv, settings, filters))
-						continue;
-
-					auto info = PK_INFO_ENUM_AVAILABLE;
-
-					for (auto _drv : installedDrvs)
-						if (_drv.queryName() == drv.queryName())
-						{
-							info = PK_INFO_ENUM_INSTALLED;
-							break;
-						}
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
-						continue;
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && info == PK_INFO_ENUM_INSTALLED)
-						continue;
-
-					pk_backend_job_package (
-						job,
-						info,
-						nix_drv_package_id (drv),
-						drv.queryMetaString ("description").c_str ()
-					);
-				}
+					pk_backend_nix_emit_package (job, package, installedDrvs, filters);
 			}
 		}
 	}
@@ -399,47 +458,25 @@ pk_backend_search_names_thread (PkBackendJob* job, GVariant* params, gpointer p)
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		PkNixStateLocker locker;
 
 		auto profile = nix_get_profile (job);
 		DrvInfos installedDrvs = queryInstalled (*state, profile);
 
-		for (; *search != NULL; ++search)
-		{
-			if (pk_backend_job_is_cancelled (job))
-				break;
+		// matches are emitted as soon as they are evaluated
+		nix_cache_foreach_package (*state, priv->roothome, drvs, [&] (const NixPackage & package) {
+			if (pk_backend_job_checkpoint (job, "nix:search-names"))
+				return false;
 
-			for (auto drv : drvs)
-				if (drv.queryName().find(*search) != -1)
+			string fullName = package.version.empty () ? package.name : package.name + "-" + package.version;
+			for (gchar** value = search; *value != NULL; ++value)
+				if (fullName.find (*value) != string::npos)
 				{
-					if (!nix_filter_drv (*state, drv, settings, filters))
-						continue;
-
-					auto info = PK_INFO_ENUM_AVAILABLE;
-
-					for (auto _drv : installedDrvs)
-						if (_drv.queryName() == drv.queryName())
-						{
-							info = PK_INFO_ENUM_INSTALLED;
-							break;
-						}
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
-						continue;
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && info == PK_INFO_ENUM_INSTALLED)
-						continue;
-
-					pk_backend_job_package (
-						job,
-						info,
-						nix_drv_package_id (drv),
-						drv.queryMetaString ("description").c_str ()
-					);
+					pk_backend_nix_emit_package (job, package, installedDrvs, filters);
+					break;
 				}
-		}
+			return true;
+		});
 	}
 	catch (std::exception & e)
 	{
@@ -465,47 +502,24 @@ pk_backend_search_details_thread (PkBackendJob* job, GVariant* params, gpointer
 
 	try
 	{
-		// possibly slow call
-		if (drvs.empty ())
-			drvs = nix_get_all_derivations (*state, priv->roothome);
+		PkNixStateLocker locker;
 
 		auto profile = nix_get_profile (job);
 		DrvInfos installedDrvs = queryInstalled (*state, profile);
 
-		for (; *value != NULL; ++value)
-		{
-			if (pk_backend_job_is_cancelled (job))
-				break;
+		// matches are emitted as soon as they are evaluated
+		nix_cache_foreach_package (*state, priv->roothome, drvs, [&] (const NixPackage & package) {
+			if (pk_backend_job_checkpoint (job, "nix:search-details"))
+				return false;
 
-			for (auto drv : drvs)
-				if (drv.queryMetaString ("description").find (*value) != -1)
+			for (gchar** v = value; *v != NULL; ++v)
+				if (package.description.find (*v) != string::npos)
 				{
-					if (!nix_filter_drv (*state, drv, settings, filters))
-						continue;
-
-					auto info = PK_INFO_ENUM_AVAILABLE;
-
-					for (auto _drv : installedDrvs)
-						if (_drv.queryName() == drv.queryName())
-						{
-							info = PK_INFO_ENUM_INSTALLED;
-							break;
-						}
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && info != PK_INFO_ENUM_INSTALLED)
-						continue;
-
-					if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && info == PK_INFO_ENUM_INSTALLED)
-						continue;
-
-					pk_backend_job_package (
-						job,
-						info,
-						nix_drv_package_id (drv),
-						drv.queryMetaString ("description").c_str ()
-					);
+					pk_backend_nix_emit_package (job, package, installedDrvs, filters);
+					break;
 				}
-		}
+			return true;
+		});
 	}
 	catch (std::exception & e)
 	{
@@ -527,8 +541,10 @@ pk_backend_refresh_cache_thread (PkBackendJob* job, GVariant* params, gpointer p
 
 	try
 	{
-		state = nix_get_state ();
-		drvs = nix_get_all_derivations (*state, priv->roothome);
+		PkNixStateLocker locker;
+
+		locker.reset ();
+		nix_cache_get_packages (*state, priv->roothome, drvs, true);
 	}
 	catch (std::exception & e)
 	{
@@ -555,6 +571,8 @@ pk_backend_install_packages_thread (PkBackendJob* job, GVariant* params, gpointe
 
 	try
 	{
+		PkNixStateLocker locker;
+
 		// possibly slow call
 		if (drvs.empty ())
 			drvs = nix_get_all_derivations (*state, priv->roothome);
@@ -575,7 +593,7 @@ pk_backend_install_packages_thread (PkBackendJob* job, GVariant* params, gpointe
 
 		while (true)
 		{
-			if (pk_backend_job_is_cancelled (job))
+			if (pk_backend_job_checkpoint (job, "nix:install-packages"))
 				break;
 
 			string lockToken = optimisticLockProfile (profile);
@@ -628,6 +646,8 @@ pk_backend_remove_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 	try
 	{
+		PkNixStateLocker locker;
+
 		// possibly slow call
 		if (drvs.empty ())
 			drvs = nix_get_all_derivations(*state, priv->roothome);
@@ -648,7 +668,7 @@ pk_backend_remove_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 		while (true)
 		{
-			if (pk_backend_job_is_cancelled (job))
+			if (pk_backend_job_checkpoint (job, "nix:remove-packages"))
 				break;
 
 			string lockToken = optimisticLockProfile (profile);
@@ -705,6 +725,8 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 	try
 	{
+		PkNixStateLocker locker;
+
 		// possibly slow call
 		if (drvs.empty ())
 			drvs = nix_get_all_derivations (*state, priv->roothome);
@@ -713,7 +735,7 @@ pk_backend_update_packages_thread (PkBackendJob* job, GVariant* params, gpointer
 
 		while (true)
 		{
-			if (pk_backend_job_is_cancelled (job))
+			if (pk_backend_job_checkpoint (job, "nix:update-packages"))
 				break;
 
 			string lockToken = optimisticLockProfile (profile);
@@ -848,6 +870,8 @@ pk_backend_download_packages_thread (PkBackendJob* job, GVariant* params, gpoint
 
 	try
 	{
+		PkNixStateLocker locker;
+
 		// possibly slow call
 		if (drvs.empty ())
 			drvs = nix_get_all_derivations (*state, priv->roothome);
@@ -20,7 +20,9 @@
  */
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <pwd.h>
+#include <glib/gstdio.h>
 
 #include <pk-backend.h>
 
@@ -83,6 +85,12 @@ typedef struct {
 	struct poldek_ctx	*ctx;
 	struct poclidek_ctx	*cctx;
 	struct pkgdb		*db;
+
+	/* kept across jobs until the rpmdb or the indexes change */
+	GHashTable		*pkg_index;	/* "dir/name-ver-rel.arch" -> pkg */
+	GHashTable		*installed;	/* pkg -> GINT_TO_POINTER (is installed) */
+	GHashTable		*summaries;	/* locale -> ("name-ver-rel.arch" -> summary) */
+	time_t			 rpmdb_mtime;
 } PkBackendPoldekPriv;
 
 typedef struct {
@@ -326,6 +334,52 @@ pkg_uinf_i18n (PkBackendJob *job, struct pkg *pkg)
 	return pkgu;
 }
 
+/**
+ * pb_summary_get:
+ *
+ * Returns the summary of @pkg in the locale of @job. Reading the package
+ * info is the slow part of listing packages, so the summaries are kept
+ * per locale until the indexes are reloaded.
+ **/
+static const gchar *
+pb_summary_get (PkBackendJob *job, struct pkg *pkg)
+{
+	const gchar *lang = pk_backend_job_get_locale (job);
+	struct pkguinf *pkgu;
+	GHashTable *summaries;
+	const gchar *summary;
+	gchar *key;
+
+	if (lang == NULL)
+		lang = "";
+
+	if (priv->summaries == NULL)
+		priv->summaries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+							 (GDestroyNotify) g_hash_table_unref);
+
+	if ((summaries = g_hash_table_lookup (priv->summaries, lang)) == NULL) {
+		summaries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		g_hash_table_insert (priv->summaries, g_strdup (lang), summaries);
+	}
+
+	key = g_strdup_printf ("%s-%s-%s.%s", pkg->name, pkg->ver, pkg->rel, pkg_arch (pkg));
+
+	if ((summary = g_hash_table_lookup (summaries, key)) != NULL) {
+		g_free (key);
+		return summary;
+	}
+
+	if ((pkgu = pkg_uinf_i18n (job, pkg)) != NULL) {
+		summary = pkguinf_get (pkgu, PKGUINF_SUMMARY);
+		g_hash_table_insert (summaries, key, g_strdup (summary ? summary : ""));
+		pkguinf_free (pkgu);
+	} else {
+		g_hash_table_insert (summaries, key, g_strdup (""));
+	}
+
+	return g_hash_table_lookup (summaries, key);
+}
+
 static gint
 poldek_get_files_to_download (const struct poldek_ts *ts)
 {
@@ -791,19 +845,61 @@ pk_backend_poldek_open_pkgdb (void)
 	}
 }
 
+static time_t
+pb_get_rpmdb_mtime (void)
+{
+	GStatBuf st;
+
+	if (g_stat ("/var/lib/rpm/Packages", &st) == 0 ||
+	    g_stat ("/var/lib/rpm", &st) == 0)
+		return st.st_mtime;
+
+	return 0;
+}
+
+/**
+ * pb_cache_invalidate:
+ *
+ * Drops the resident pkgdb handle and the package lookups, they are
+ * rebuilt when needed.
+ **/
+static void
+pb_cache_invalidate (void)
+{
+	if (priv->db != NULL) {
+		pkgdb_close (priv->db);
+		priv->db = NULL;
+	}
+
+	g_clear_pointer (&priv->pkg_index, g_hash_table_unref);
+	g_clear_pointer (&priv->installed, g_hash_table_unref);
+	g_clear_pointer (&priv->summaries, g_hash_table_unref);
+}
+
 static gboolean
 pkg_is_installed (struct pkg *pkg)
 {
 	gint cmprc, is_installed = 0;
+	gpointer value;
 
 	g_return_val_if_fail (pkg != NULL, FALSE);
 
+	if (priv->installed == NULL)
+		priv->installed = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							 (GDestroyNotify) pkg_free, NULL);
+	else if (g_hash_table_lookup_extended (priv->installed, pkg, NULL, &value))
+		return GPOINTER_TO_INT (value);
+
 	pk_backend_poldek_open_pkgdb ();
 
 	if (priv->db) {
 		is_installed = pkgdb_is_pkg_installed (priv->db, pkg, &cmprc);
 	}
 
+	/* the key holds a reference, so the pointer can't be reused */
+	g_hash_table_insert (priv->installed, pkg_link (pkg),
+			     GINT_TO_POINTER (is_installed ? TRUE : FALSE));
+
 	return is_installed ? TRUE : FALSE;
 }
 
@@ -1403,7 +1499,6 @@ package_id_from_pkg (struct pkg *pkg, const gchar *repo, PkBitfield filters)
 static void
 poldek_backend_package (PkBackendJob *job, struct pkg *pkg, PkInfoEnum infoenum, PkBitfield filters)
 {
-	struct pkguinf *pkgu = NULL;
 	gchar *package_id;
 
 	if (infoenum == PK_INFO_ENUM_UNKNOWN) {
@@ -1422,15 +1517,60 @@ poldek_backend_package (PkBackendJob *job, struct pkg *pkg, PkInfoEnum infoenum,
 
 	package_id = package_id_from_pkg (pkg, NULL, filters);
 
-	if ((pkgu = pkg_uinf_i18n (job, pkg))) {
-		pk_backend_job_package (job, infoenum, package_id, pkguinf_get (pkgu, PKGUINF_SUMMARY));
+	pk_backend_job_package (job, infoenum, package_id, pb_summary_get (job, pkg));
 
-		pkguinf_free (pkgu);
-	} else {
-		pk_backend_job_package (job, infoenum, package_id, "");
+	g_free (package_id);
+}
+
+static void
+pb_pkg_index_add (const gchar *dir, struct pkg *pkg)
+{
+	gchar *key;
+
+	key = g_strdup_printf ("%s/%s-%s-%s.%s", dir, pkg->name, pkg->ver,
+			       pkg->rel, pkg_arch (pkg));
+
+	/* keep the first one, as 'ls -q' would */
+	if (g_hash_table_contains (priv->pkg_index, key))
+		g_free (key);
+	else
+		g_hash_table_insert (priv->pkg_index, key, pkg_link (pkg));
+}
+
+/**
+ * pb_pkg_index_build:
+ *
+ * Indexes the installed and available packages by the directory and
+ * name-version-release.arch used in package ids.
+ **/
+static void
+pb_pkg_index_build (void)
+{
+	tn_array *packages;
+	guint i;
+
+	priv->pkg_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+						 g_free, (GDestroyNotify) pkg_free);
+
+	if ((packages = poldek_get_installed_packages ()) != NULL) {
+		for (i = 0; i < n_array_size (packages); i++)
+			pb_pkg_index_add ("installed", n_array_nth (packages, i));
+
+		n_array_free (packages);
 	}
 
-	g_free (package_id);
+	if ((packages = execute_packages_command ("cd /all-avail; ls -q")) != NULL) {
+		for (i = 0; i < n_array_size (packages); i++) {
+			struct pkg *pkg = n_array_nth (packages, i);
+
+			pb_pkg_index_add ("all-avail", pkg);
+
+			if (pkg->pkgdir && pkg->pkgdir->name)
+				pb_pkg_index_add (pkg->pkgdir->name, pkg);
+		}
+
+		n_array_free (packages);
+	}
 }
 
 static struct pkg*
@@ -1444,10 +1584,21 @@ poldek_get_pkg_from_package_id (const gchar *package_id)
 	if ((parts = pk_package_id_split (package_id))) {
 		tn_array *packages = NULL;
 		gchar    *vr = NULL;
+		gchar    *key = NULL;
 
 		vr = poldek_get_vr_from_package_id_evr (parts[PK_PACKAGE_ID_VERSION]);
 
-		if ((packages = execute_packages_command ("cd /%s; ls -q %s-%s.%s", parts[PK_PACKAGE_ID_DATA],
+		if (priv->pkg_index == NULL)
+			pb_pkg_index_build ();
+
+		key = g_strdup_printf ("%s/%s-%s.%s", parts[PK_PACKAGE_ID_DATA],
+						      parts[PK_PACKAGE_ID_NAME],
+						      vr,
+						      parts[PK_PACKAGE_ID_ARCH]);
+
+		if ((pkg = g_hash_table_lookup (priv->pkg_index, key)) != NULL) {
+			pkg = pkg_link (pkg);
+		} else if ((packages = execute_packages_command ("cd /%s; ls -q %s-%s.%s", parts[PK_PACKAGE_ID_DATA],
 										    parts[PK_PACKAGE_ID_NAME],
 										    vr,
 										    parts[PK_PACKAGE_ID_ARCH]))) {
@@ -1455,8 +1606,11 @@ poldek_get_pkg_from_package_id (const gchar *package_id)
 				/* only one package is needed */
 				pkg = pkg_link (n_array_nth (packages, 0));
 			}
+
+			n_array_free (packages);
 		}
 
+		g_free (key);
 		g_free (vr);
 		g_strfreev (parts);
 	}
@@ -2195,10 +2349,7 @@ do_poldek_destroy (PkBackend *backend)
 {
 	sigint_destroy ();
 
-	if (priv->db != NULL) {
-		pkgdb_close (priv->db);
-		priv->db = NULL;
-	}
+	pb_cache_invalidate ();
 
 	poclidek_free (priv->cctx);
 	poldek_free (priv->ctx);
@@ -2281,6 +2432,12 @@ pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 	poldek_log_set_appender ("PackageKit", (void *) job, NULL, 0, (poldek_vlog_fn) poldek_backend_log);
 
 	poldek_configure (priv->ctx, POLDEK_CONF_TSCONFIRM_CB, ts_confirm, job);
+
+	/* something else changed the installed packages */
+	if (priv->rpmdb_mtime != pb_get_rpmdb_mtime ()) {
+		pb_cache_invalidate ();
+		priv->rpmdb_mtime = pb_get_rpmdb_mtime ();
+	}
 }
 
 void
@@ -2297,10 +2454,17 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 
 	g_free (job_data);
 
-	// close pkgdb as well
-	if (priv->db != NULL) {
-		pkgdb_close (priv->db);
-		priv->db = NULL;
+	/* the pkgdb and the lookups stay resident for the next job,
+	 * unless this one changed the installed packages */
+	switch (pk_backend_job_get_role (job)) {
+	case PK_ROLE_ENUM_INSTALL_FILES:
+	case PK_ROLE_ENUM_INSTALL_PACKAGES:
+	case PK_ROLE_ENUM_REMOVE_PACKAGES:
+	case PK_ROLE_ENUM_UPDATE_PACKAGES:
+		pb_cache_invalidate ();
+		break;
+	default:
+		break;
 	}
 
 	pk_backend_job_set_user_data (job, NULL);
@@ -2967,6 +3131,7 @@ backend_refresh_cache_thread (PkBackendJob *job, GVariant *params, gpointer user
 	PkBackendPoldekJobData *job_data = pk_backend_job_get_user_data (job);
 	PkBackendPoldekProgressData *pd = job_data->progress_data;
 	tn_array		*sources = NULL;
+	tn_array		*packages = NULL;
 	struct vf_progress	vfpro;
 
 	setup_vf_progress (&vfpro, job);
@@ -3007,6 +3172,16 @@ backend_refresh_cache_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	poldek_reload (job, TRUE);
 
+	/* so the first listing in this locale does not read every package info */
+	if ((packages = execute_packages_command ("cd /all-avail; ls -q")) != NULL) {
+		size_t	i;
+
+		for (i = 0; i < n_array_size (packages); i++)
+			pb_summary_get (job, n_array_nth (packages, i));
+
+		n_array_free (packages);
+	}
+
 	pk_backend_job_set_percentage (job, 100);
 }
 
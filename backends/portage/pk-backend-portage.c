@@ -20,12 +20,138 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <string.h>
 #include <pk-backend.h>
 #include <pk-backend-spawn.h>
 
+#include "pk-portage-vdb.h"
+
 static PkBackendSpawn *spawn = 0;
 static const gchar* BACKEND_FILE = "portageBackend.py";
 
+/*
+ * Queries limited to installed packages are answered from /var/db/pkg in
+ * process; everything else still needs portage itself to apply masks,
+ * keywords and licenses, so it goes to the helper.
+ */
+typedef enum {
+	PK_PORTAGE_QUERY_GET_PACKAGES,
+	PK_PORTAGE_QUERY_RESOLVE,
+	PK_PORTAGE_QUERY_SEARCH_NAME
+} PkPortageQuery;
+
+typedef struct {
+	PkBackendJob	*job;
+	PkPortageQuery	 query;
+	gchar		**values;
+	gchar		*category;
+} PkPortageQueryData;
+
+static gboolean
+pk_backend_portage_can_query_vdb (PkBitfield filters)
+{
+	return pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) &&
+	       !pk_bitfield_contain (filters, PK_FILTER_ENUM_FREE) &&
+	       !pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_FREE);
+}
+
+static gboolean
+pk_backend_portage_vdb_match (const PkPortageVdbEntry *entry, gpointer user_data)
+{
+	PkPortageQueryData *data = user_data;
+	g_autofree gchar *name = NULL;
+	gboolean found = TRUE;
+
+	if (pk_backend_job_is_cancelled (data->job))
+		return FALSE;
+
+	switch (data->query) {
+	case PK_PORTAGE_QUERY_RESOLVE:
+		name = g_strdup_printf ("%s/%s", entry->category, entry->name);
+		found = g_strv_contains ((const gchar * const *) data->values, name);
+		break;
+	case PK_PORTAGE_QUERY_SEARCH_NAME:
+		if (data->category != NULL && g_strcmp0 (data->category, entry->category) != 0)
+			return TRUE;
+		/* the name has to contain every key */
+		name = g_utf8_casefold (entry->name, -1);
+		for (guint i = 0; data->values[i] != NULL && found; i++)
+			found = strstr (name, data->values[i]) != NULL;
+		break;
+	default:
+		break;
+	}
+
+	if (found)
+		pk_backend_job_package (data->job, PK_INFO_ENUM_INSTALLED,
+					entry->package_id, entry->description);
+	return TRUE;
+}
+
+static void
+pk_backend_portage_vdb_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkPortageQueryData *data = user_data;
+	g_autoptr(GError) error = NULL;
+
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	pk_backend_job_set_allow_cancel (job, TRUE);
+
+	if (!pk_portage_vdb_foreach (pk_backend_portage_vdb_match, data, &error))
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_INTERNAL_ERROR,
+					   "failed to read the installed packages: %s",
+					   error->message);
+
+	pk_backend_job_finished (job);
+}
+
+static void
+pk_backend_portage_query_data_free (gpointer user_data)
+{
+	PkPortageQueryData *data = user_data;
+
+	g_strfreev (data->values);
+	g_free (data->category);
+	g_free (data);
+}
+
+static void
+pk_backend_portage_query_vdb (PkBackendJob *job, PkPortageQuery query, gchar **values)
+{
+	PkPortageQueryData *data = g_new0 (PkPortageQueryData, 1);
+
+	data->job = job;
+	data->query = query;
+	data->values = g_strdupv (values);
+
+	/* a "cat/name" key limits the search to cat, the names are compared
+	 * case-insensitively */
+	if (query == PK_PORTAGE_QUERY_SEARCH_NAME) {
+		for (guint i = 0; data->values[i] != NULL; i++) {
+			gchar *slash = strchr (data->values[i], '/');
+			gchar *key;
+
+			if (slash != NULL) {
+				/* two cat/name keys can never match together */
+				if (data->category != NULL) {
+					pk_backend_portage_query_data_free (data);
+					pk_backend_job_finished (job);
+					return;
+				}
+				data->category = g_strndup (data->values[i], slash - data->values[i]);
+				key = g_utf8_casefold (slash + 1, -1);
+			} else {
+				key = g_utf8_casefold (data->values[i], -1);
+			}
+			g_free (data->values[i]);
+			data->values[i] = key;
+		}
+	}
+
+	pk_backend_job_thread_create (job, pk_backend_portage_vdb_thread, data,
+				      pk_backend_portage_query_data_free);
+}
+
 void
 pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 {
@@ -275,6 +401,11 @@ pk_backend_resolve (PkBackend *backend, PkBackendJob *job, PkBitfield filters, g
 	gchar *filters_text;
 	gchar *package_ids_temp;
 
+	if (pk_backend_portage_can_query_vdb (filters)) {
+		pk_backend_portage_query_vdb (job, PK_PORTAGE_QUERY_RESOLVE, package_ids);
+		return;
+	}
+
 	filters_text = pk_filter_bitfield_to_string (filters);
 	package_ids_temp = pk_package_ids_to_string (package_ids);
 	pk_backend_spawn_helper (spawn, job, BACKEND_FILE, "resolve", filters_text, package_ids_temp, NULL);
@@ -323,6 +454,12 @@ pk_backend_search_names (PkBackend *backend, PkBackendJob *job, PkBitfield filte
 {
 	gchar *filters_text;
 	gchar *search;
+
+	if (pk_backend_portage_can_query_vdb (filters)) {
+		pk_backend_portage_query_vdb (job, PK_PORTAGE_QUERY_SEARCH_NAME, values);
+		return;
+	}
+
 	filters_text = pk_filter_bitfield_to_string (filters);
 	search = g_strjoinv ("&", values);
 	pk_backend_spawn_helper (spawn, job, BACKEND_FILE, "search-name", filters_text, search, NULL);
@@ -349,6 +486,11 @@ pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filte
 {
 	gchar *filters_text;
 
+	if (pk_backend_portage_can_query_vdb (filters)) {
+		pk_backend_portage_query_vdb (job, PK_PORTAGE_QUERY_GET_PACKAGES, NULL);
+		return;
+	}
+
 	filters_text = pk_filter_bitfield_to_string (filters);
 	pk_backend_spawn_helper (spawn, job, BACKEND_FILE, "get-packages", filters_text, NULL);
 	g_free (filters_text);
@@ -0,0 +1,232 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <pk-backend.h>
+
+#include "pk-portage-vdb.h"
+
+#define PK_PORTAGE_VDB_DIR		"/var/db/pkg"
+#define PK_PORTAGE_MAKE_CONF		"/etc/portage/make.conf"
+
+static GMutex	 accept_keywords_mutex;
+static gchar	**accept_keywords = NULL;
+static time_t	 accept_keywords_mtime = 0;
+
+/**
+ * pk_portage_vdb_get_accept_keywords:
+ *
+ * ACCEPT_KEYWORDS is the result of the whole profile stack, so ask portage
+ * once and keep the answer until make.conf changes.
+ **/
+static gchar **
+pk_portage_vdb_get_accept_keywords (GError **error)
+{
+	const gchar *argv[] = { "portageq", "envvar", "ACCEPT_KEYWORDS", NULL };
+	g_autofree gchar *output = NULL;
+	gchar **keywords = NULL;
+	GStatBuf st;
+	gint status;
+
+	if (g_stat (PK_PORTAGE_MAKE_CONF, &st) != 0)
+		st.st_mtime = 0;
+
+	g_mutex_lock (&accept_keywords_mutex);
+	if (accept_keywords != NULL && accept_keywords_mtime == st.st_mtime) {
+		keywords = g_strdupv (accept_keywords);
+		goto out;
+	}
+
+	if (!g_spawn_sync (NULL, (gchar **) argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+			   NULL, NULL, &output, NULL, &status, error))
+		goto out;
+	if (!g_spawn_check_exit_status (status, error))
+		goto out;
+
+	g_strfreev (accept_keywords);
+	accept_keywords = g_strsplit_set (g_strstrip (output), " \t\n", -1);
+	accept_keywords_mtime = st.st_mtime;
+	keywords = g_strdupv (accept_keywords);
+out:
+	g_mutex_unlock (&accept_keywords_mutex);
+	return keywords;
+}
+
+static gchar *
+pk_portage_vdb_read (const gchar *dir, const gchar *key)
+{
+	g_autofree gchar *filename = g_build_filename (dir, key, NULL);
+	gchar *contents = NULL;
+
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return g_strdup ("");
+
+	return g_strstrip (contents);
+}
+
+/**
+ * pk_portage_vdb_split_pf:
+ *
+ * Splits "name-1.2.3-r1" into "name", "1.2.3" and "r1", or returns FALSE if
+ * pf does not end in a version.
+ **/
+static gboolean
+pk_portage_vdb_split_pf (const gchar *pf, gchar **name, gchar **version, gchar **revision)
+{
+	const gchar *end = pf + strlen (pf);
+	const gchar *sep;
+	g_autofree gchar *rest = NULL;
+
+	*revision = NULL;
+
+	sep = g_strrstr (pf, "-");
+	if (sep != NULL && sep[1] == 'r' && g_ascii_isdigit (sep[2])) {
+		*revision = g_strdup (sep + 1);
+		end = sep;
+	}
+
+	rest = g_strndup (pf, end - pf);
+	sep = g_strrstr (rest, "-");
+	if (sep == NULL || sep == rest || !g_ascii_isdigit (sep[1])) {
+		g_clear_pointer (revision, g_free);
+		return FALSE;
+	}
+
+	*name = g_strndup (rest, sep - rest);
+	*version = g_strdup (sep + 1);
+	return TRUE;
+}
+
+static guint
+pk_portage_vdb_strv_index (gchar **strv, const gchar *str)
+{
+	guint i;
+
+	for (i = 0; strv[i] != NULL; i++) {
+		if (g_strcmp0 (strv[i], str) == 0)
+			break;
+	}
+	return i;
+}
+
+/* the same id portageBackend.py builds in _cpv_to_id */
+static gchar *
+pk_portage_vdb_build_package_id (const gchar *dir,
+				 const gchar *category,
+				 const gchar *name,
+				 const gchar *version,
+				 const gchar *revision,
+				 gchar **accepted)
+{
+	g_autofree gchar *slot = pk_portage_vdb_read (dir, "SLOT");
+	g_autofree gchar *pkg_keywords = pk_portage_vdb_read (dir, "KEYWORDS");
+	g_auto(GStrv) split = g_strsplit_set (pkg_keywords, " \t\n", -1);
+	g_autoptr(GString) pk_version = g_string_new (version);
+	g_autoptr(GString) keywords = g_string_new (NULL);
+	g_autofree gchar *cp = g_strdup_printf ("%s/%s", category, name);
+
+	for (guint i = 0; split[i] != NULL; i++) {
+		if (split[i][0] == '\0' || !g_strv_contains ((const gchar * const *) accepted, split[i]))
+			continue;
+		if (pk_portage_vdb_strv_index (split, split[i]) != i)
+			continue;
+		if (keywords->len > 0)
+			g_string_append_c (keywords, ' ');
+		g_string_append (keywords, split[i]);
+	}
+	if (keywords->len == 0)
+		g_string_assign (keywords, "no keywords");
+
+	if (revision != NULL && g_strcmp0 (revision, "r0") != 0)
+		g_string_append_printf (pk_version, "-%s", revision);
+	if (slot[0] != '\0' && g_strcmp0 (slot, "0") != 0)
+		g_string_append_printf (pk_version, ":%s", slot);
+
+	return pk_package_id_build (cp, pk_version->str, keywords->str, "installed");
+}
+
+/**
+ * pk_portage_vdb_foreach:
+ *
+ * Walks the installed packages straight from the on-disk vdb, without
+ * starting the python helper.
+ *
+ * Returns: %FALSE if the vdb or ACCEPT_KEYWORDS can't be read
+ **/
+gboolean
+pk_portage_vdb_foreach (PkPortageVdbFunc func, gpointer user_data, GError **error)
+{
+	g_auto(GStrv) accepted = NULL;
+	g_autoptr(GDir) root = NULL;
+	const gchar *category;
+
+	accepted = pk_portage_vdb_get_accept_keywords (error);
+	if (accepted == NULL)
+		return FALSE;
+
+	root = g_dir_open (PK_PORTAGE_VDB_DIR, 0, error);
+	if (root == NULL)
+		return FALSE;
+
+	while ((category = g_dir_read_name (root)) != NULL) {
+		g_autofree gchar *category_dir = g_build_filename (PK_PORTAGE_VDB_DIR, category, NULL);
+		g_autoptr(GDir) packages = NULL;
+		const gchar *pf;
+
+		if (category[0] == '.' || !g_file_test (category_dir, G_FILE_TEST_IS_DIR))
+			continue;
+
+		packages = g_dir_open (category_dir, 0, NULL);
+		if (packages == NULL)
+			continue;
+
+		while ((pf = g_dir_read_name (packages)) != NULL) {
+			g_autofree gchar *dir = NULL;
+			g_autofree gchar *name = NULL;
+			g_autofree gchar *version = NULL;
+			g_autofree gchar *revision = NULL;
+			g_autofree gchar *package_id = NULL;
+			g_autofree gchar *description = NULL;
+			PkPortageVdbEntry entry;
+
+			/* -MERGING-foo and friends are still being written */
+			if (pf[0] == '-' || pf[0] == '.')
+				continue;
+			if (!pk_portage_vdb_split_pf (pf, &name, &version, &revision))
+				continue;
+
+			dir = g_build_filename (category_dir, pf, NULL);
+			package_id = pk_portage_vdb_build_package_id (dir, category, name, version,
+								      revision, accepted);
+			description = pk_portage_vdb_read (dir, "DESCRIPTION");
+
+			entry.category = category;
+			entry.name = name;
+			entry.package_id = package_id;
+			entry.description = description;
+			if (!func (&entry, user_data))
+				return TRUE;
+		}
+	}
+
+	return TRUE;
+}
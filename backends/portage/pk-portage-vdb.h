@@ -0,0 +1,46 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_PORTAGE_VDB_H
+#define __PK_PORTAGE_VDB_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* one package installed in /var/db/pkg */
+typedef struct {
+	const gchar	*category;
+	const gchar	*name;
+	const gchar	*package_id;
+	const gchar	*description;
+} PkPortageVdbEntry;
+
+/* return FALSE to stop the walk */
+typedef gboolean (*PkPortageVdbFunc) (const PkPortageVdbEntry *entry, gpointer user_data);
+
+gboolean	 pk_portage_vdb_foreach		(PkPortageVdbFunc	 func,
+						 gpointer		 user_data,
+						 GError			**error);
+
+G_END_DECLS
+
+#endif /* __PK_PORTAGE_VDB_H */
@@ -124,7 +124,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	{
 		goto out;
 	}
-	sqlite3_exec(job_data->db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(job_data->db, "SAVEPOINT generate_cache", NULL, NULL, NULL);
 
 	while ((line = g_data_input_stream_read_line(data_in, NULL, NULL, NULL)))
 	{
@@ -221,7 +221,7 @@ Dl::generate_cache(PkBackendJob *job, const gchar *tmpl) noexcept
 	}
 	g_free(collection_name);
 
-	sqlite3_exec(job_data->db, "END TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(job_data->db, "RELEASE generate_cache", NULL, NULL, NULL);
 
 out:
 	if (data_in)
@@ -20,34 +20,135 @@ filter_package (PkBitfield filters, bool is_installed)
 	return false;
 }
 
+static bool
+has_table (sqlite3 *db, const gchar *name)
+{
+	sqlite3_stmt *stmt;
+	bool ret = false;
+
+	if (sqlite3_prepare_v2 (db,
+				"SELECT 1 FROM sqlite_master WHERE type IN ('table', 'view') AND name = ?",
+				-1, &stmt, NULL) == SQLITE_OK)
+	{
+		sqlite3_bind_text (stmt, 1, name, -1, SQLITE_STATIC);
+		ret = sqlite3_step (stmt) == SQLITE_ROW;
+		sqlite3_finalize (stmt);
+	}
+	return ret;
+}
+
 static std::string
-generate_query(PkBitfield filters)
+generate_query(PkBitfield filters, sqlite3 *db)
 {
+	/* A cache generated before the search index existed */
+	if (!has_table (db, "best_pkg"))
+	{
+		std::string query(
+				"SELECT (p1.name || ';' || p1.ver || ';' || p1.arch || ';' || r.repo), p1.summary, "
+				"p1.full_name FROM pkglist AS p1 NATURAL JOIN repos AS r "
+				"WHERE p1.%s LIKE '%%%q%%' AND p1.ext NOT LIKE 'obsolete' AND p1.repo_order = "
+				"(SELECT MIN(p2.repo_order) FROM pkglist AS p2 WHERE p2.name = p1.name GROUP BY p2.name)");
+
+		if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION))
+		{
+			query.append(
+					" AND EXISTS (SELECT filelist.full_name "
+					"FROM filelist "
+					"WHERE filelist.full_name = p1.full_name "
+					"AND filelist.filename LIKE 'usr/share/applications/%%.desktop')");
+		}
+		else if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION))
+		{
+			query.append(
+					" AND NOT EXISTS (SELECT filelist.full_name "
+					"FROM filelist "
+					"WHERE filelist.full_name = p1.full_name "
+					"AND filelist.filename LIKE 'usr/share/applications/%%.desktop')");
+		}
+		return query;
+	}
+
 	std::string query(
 			"SELECT (p1.name || ';' || p1.ver || ';' || p1.arch || ';' || r.repo), p1.summary, "
-			"p1.full_name FROM pkglist AS p1 NATURAL JOIN repos AS r "
-			"WHERE p1.%s LIKE '%%%q%%' AND p1.ext NOT LIKE 'obsolete' AND p1.repo_order = "
-			"(SELECT MIN(p2.repo_order) FROM pkglist AS p2 WHERE p2.name = p1.name GROUP BY p2.name)");
+			"p1.full_name FROM best_pkg AS b JOIN pkglist AS p1 ON p1.full_name = b.full_name "
+			"NATURAL JOIN repos AS r WHERE ");
+
+	if (has_table (db, "pkgsearch"))
+	{
+		/* The trigram tokenizer answers LIKE from the index */
+		query.append("b.rowid IN (SELECT rowid FROM pkgsearch WHERE pkgsearch.%s LIKE '%%%q%%')");
+	}
+	else
+	{
+		query.append("p1.%s LIKE '%%%q%%'");
+	}
+	query.append(" AND p1.ext NOT LIKE 'obsolete'");
 
 	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_APPLICATION))
 	{
-		query.append(
-				" AND EXISTS (SELECT filelist.full_name "
-				"FROM filelist "
-				"WHERE filelist.full_name = p1.full_name "
-				"AND filelist.filename LIKE 'usr/share/applications/%%.desktop')");
+		query.append(" AND b.is_application");
 	}
 	else if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_APPLICATION))
 	{
-		query.append(
-				" AND NOT EXISTS (SELECT filelist.full_name "
-				"FROM filelist "
-				"WHERE filelist.full_name = p1.full_name "
-				"AND filelist.filename LIKE 'usr/share/applications/%%.desktop')");
+		query.append(" AND NOT b.is_application");
 	}
 	return query;
 }
 
+/**
+ * slack::generate_search_index:
+ * @db: metadata database.
+ *
+ * Materializes the package each name resolves to, i.e. the one from the
+ * repository with the lowest order, whether it is an application, and a
+ * full text index over the searchable columns. Has to be called after the
+ * repositories generated their cache.
+ *
+ * Returns: true on success, false otherwise.
+ **/
+bool
+generate_search_index (sqlite3 *db)
+{
+	gchar *db_err = NULL;
+
+	if (sqlite3_exec (db,
+				"BEGIN TRANSACTION;"
+				"CREATE INDEX IF NOT EXISTS filelist_filename ON filelist (filename);"
+				"DROP TABLE IF EXISTS best_pkg;"
+				"CREATE TABLE best_pkg (name VARCHAR NOT NULL PRIMARY KEY, "
+				"full_name VARCHAR NOT NULL UNIQUE, repo_order INTEGER NOT NULL, "
+				"is_application INTEGER NOT NULL DEFAULT 0);"
+				"INSERT INTO best_pkg (name, full_name, repo_order) "
+				"SELECT name, full_name, MIN(repo_order) FROM pkglist GROUP BY name;"
+				"UPDATE best_pkg SET is_application = 1 WHERE full_name IN "
+				"(SELECT full_name FROM filelist WHERE filename GLOB 'usr/share/applications/*.desktop');"
+				"END TRANSACTION",
+				NULL, NULL, &db_err) != SQLITE_OK)
+	{
+		g_warning ("Failed to index the package list: %s", db_err);
+		sqlite3_free (db_err);
+		sqlite3_exec (db, "ROLLBACK", NULL, NULL, NULL);
+		return false;
+	}
+
+	/* Searching goes without the full text index if SQLite lacks FTS5 */
+	if (sqlite3_exec (db,
+				"BEGIN TRANSACTION;"
+				"DROP TABLE IF EXISTS pkgsearch;"
+				"CREATE VIRTUAL TABLE pkgsearch USING fts5 (name, desc, cat, tokenize = 'trigram');"
+				"INSERT INTO pkgsearch (rowid, name, desc, cat) "
+				"SELECT b.rowid, p.name, p.desc, p.cat FROM best_pkg AS b "
+				"JOIN pkglist AS p ON p.full_name = b.full_name;"
+				"END TRANSACTION",
+				NULL, NULL, &db_err) != SQLITE_OK)
+	{
+		g_debug ("Not creating the search index: %s", db_err);
+		sqlite3_free (db_err);
+		sqlite3_exec (db, "ROLLBACK", NULL, NULL, NULL);
+	}
+	return true;
+}
+
 }
 
 void
@@ -63,14 +164,15 @@ pk_backend_search_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 	g_variant_get (params, "(t^a&s)", &filters, &vals);
 	gchar *search = g_strjoinv ("%", vals);
 
-	gchar *query = sqlite3_mprintf (slack::generate_query(filters).c_str(),
+	gchar *query = sqlite3_mprintf (slack::generate_query(filters, job_data->db).c_str(),
 			user_data, search);
 
 	sqlite3_stmt *stmt;
 	if ((sqlite3_prepare_v2 (job_data->db, query, -1, &stmt, NULL) == SQLITE_OK))
 	{
-		/* Now we're ready to output all packages */
-		while (sqlite3_step (stmt) == SQLITE_ROW)
+		/* Now we're ready to output all packages, up to the page asked for */
+		while (!pk_backend_job_get_limit_reached (job)
+				&& sqlite3_step (stmt) == SQLITE_ROW)
 		{
 			PkInfoEnum info = slack::is_installed (
 					reinterpret_cast<const gchar *> (sqlite3_column_text (stmt, 2)));
@@ -8,6 +8,8 @@ namespace slack {
 
 bool filter_package (PkBitfield filters, bool is_installed);
 
+bool generate_search_index (sqlite3 *db);
+
 }
 
 extern "C" {
@@ -121,6 +121,8 @@ void pk_backend_initialize(GKeyFile *conf, PkBackend *backend)
 	g_free(groups);
 
 	g_key_file_free(key_conf);
+
+	installed_watch();
 }
 
 void
@@ -134,6 +136,7 @@ pk_backend_destroy(PkBackend *backend)
 	}
 
 	g_slist_free (repos);
+	installed_unwatch ();
 	curl_global_cleanup ();
 }
 
@@ -273,8 +276,8 @@ pk_backend_search_files_thread(PkBackendJob *job, GVariant *params, gpointer use
 
 	if ((sqlite3_prepare_v2(job_data->db, query, -1, &stmt, NULL) == SQLITE_OK))
 	{
-		/* Now we're ready to output all packages */
-		while (sqlite3_step(stmt) == SQLITE_ROW)
+		/* Now we're ready to output all packages, up to the page asked for */
+		while (!pk_backend_job_get_limit_reached(job) && sqlite3_step(stmt) == SQLITE_ROW)
 		{
 			ret = is_installed((gchar*) sqlite3_column_text(stmt, 2));
 			if ((ret == PK_INFO_ENUM_INSTALLED) || (ret == PK_INFO_ENUM_UPDATING))
@@ -457,11 +460,33 @@ pk_backend_resolve(PkBackend *backend, PkBackendJob *job, PkBitfield filters, gc
 	pk_backend_job_thread_create(job, pk_backend_resolve_thread, NULL, NULL);
 }
 
+/* Appends the source url and the destination of the package to file_list
+ * unless it is downloaded already */
+static GSList *
+collect_package_download(PkBackendJob *job, GSList *file_list, const gchar *dest_dir_name, const gchar *pkg_id)
+{
+	gchar **source_dest, **tokens = pk_package_id_split(pkg_id);
+	GSList *repo = g_slist_find_custom(repos, tokens[PK_PACKAGE_ID_DATA], cmp_repo);
+
+	if (repo
+	 && static_cast<Pkgtools *> (repo->data)->collect_download (job,
+			dest_dir_name, tokens[PK_PACKAGE_ID_NAME], &source_dest)
+	 && source_dest)
+	{
+		file_list = g_slist_append(file_list, source_dest);
+	}
+	g_strfreev(tokens);
+
+	return file_list;
+}
+
 static void
 pk_backend_download_packages_thread(PkBackendJob *job, GVariant *params, gpointer user_data)
 {
-	gchar *dir_path, *path, **pkg_ids, *to_strv[] = {NULL, NULL};
+	gchar *dir_path, **pkg_ids;
 	guint i;
+	GSList *file_list = NULL;
+	GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
 	sqlite3_stmt *stmt;
 	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
@@ -495,12 +520,8 @@ pk_backend_download_packages_thread(PkBackendJob *job, GVariant *params, gpointe
 				pk_backend_job_package(job, PK_INFO_ENUM_DOWNLOADING,
 									   pkg_ids[i],
 									   (gchar *) sqlite3_column_text(stmt, 0));
-				static_cast<Pkgtools *> (repo->data)->download (job,
-						dir_path, tokens[PK_PACKAGE_ID_NAME]);
-				path = g_build_filename(dir_path, (gchar *) sqlite3_column_text(stmt, 1), NULL);
-				to_strv[0] = path;
-				pk_backend_job_files(job, NULL, to_strv);
-				g_free(path);
+				file_list = collect_package_download(job, file_list, dir_path, pkg_ids[i]);
+				g_ptr_array_add(paths, g_build_filename(dir_path, (gchar *) sqlite3_column_text(stmt, 1), NULL));
 			}
 		}
 		sqlite3_clear_bindings(stmt);
@@ -508,7 +529,15 @@ pk_backend_download_packages_thread(PkBackendJob *job, GVariant *params, gpointe
 		g_strfreev(tokens);
 	}
 
+	/* Fetch all packages at once */
+	get_files(job, file_list, 100);
+	g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
+
+	g_ptr_array_add(paths, NULL);
+	pk_backend_job_files(job, NULL, (gchar **) paths->pdata);
+
 out:
+	g_ptr_array_unref(paths);
 	sqlite3_finalize(stmt);
 }
 
@@ -525,7 +554,7 @@ pk_backend_install_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 	gchar **pkg_ids;
 	guint i;
 	gdouble percent_step;
-	GSList *install_list = NULL, *l;
+	GSList *install_list = NULL, *file_list = NULL, *l;
 	sqlite3_stmt *pkglist_stmt = NULL, *collection_stmt = NULL;
     PkBitfield transaction_flags = 0;
 	PkInfoEnum ret;
@@ -626,20 +655,10 @@ pk_backend_install_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 		dest_dir_name = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit", "downloads", NULL);
 		for (l = install_list, i = 0; l; l = g_slist_next(l), i++)
 		{
-			gchar **tokens;
-			GSList *repo;
-
-			pk_backend_job_set_percentage(job, percent_step * i);
-			tokens = pk_package_id_split((gchar *)(l->data));
-			repo = g_slist_find_custom(repos, tokens[PK_PACKAGE_ID_DATA], cmp_repo);
-
-			if (repo)
-			{
-				static_cast<Pkgtools *> (repo->data)->download (job,
-						dest_dir_name, tokens[PK_PACKAGE_ID_NAME]);
-			}
-			g_strfreev(tokens);
+			file_list = collect_package_download(job, file_list, dest_dir_name, (gchar *)(l->data));
 		}
+		get_files(job, file_list, 50);
+		g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
 		g_free(dest_dir_name);
 
 		/* Install the packages */
@@ -851,6 +870,7 @@ pk_backend_update_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 {
 	gchar *dest_dir_name, *cmd_line, **pkg_ids;
 	guint i;
+	GSList *file_list = NULL;
     PkBitfield transaction_flags = 0;
 
 	g_variant_get(params, "(t^a&s)", &transaction_flags, &pkg_ids);
@@ -862,21 +882,10 @@ pk_backend_update_packages_thread(PkBackendJob *job, GVariant *params, gpointer
 		dest_dir_name = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit", "downloads", NULL);
 		for (i = 0; pkg_ids[i]; i++)
 		{
-			gchar **tokens = pk_package_id_split(pkg_ids[i]);
-
-			if (g_strcmp0(tokens[PK_PACKAGE_ID_DATA], "obsolete"))
-			{
-				GSList *repo = g_slist_find_custom(repos, tokens[PK_PACKAGE_ID_DATA], cmp_repo);
-
-				if (repo)
-				{
-					static_cast<Pkgtools *> (repo->data)->download (job,
-							dest_dir_name, tokens[PK_PACKAGE_ID_NAME]);
-				}
-			}
-
-			g_strfreev(tokens);
+			file_list = collect_package_download(job, file_list, dest_dir_name, pkg_ids[i]);
 		}
+		get_files(job, file_list, 100);
+		g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
 		g_free(dest_dir_name);
 
 		/* Install the packages */
@@ -927,6 +936,8 @@ pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer us
 	GFile *db_file = NULL;
 	GFileInfo *file_info = NULL;
 	GError *err = NULL;
+	gchar *stamp_path = NULL;
+	GStatBuf stamp_stat;
 	sqlite3_stmt *stmt = NULL;
 	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
@@ -943,6 +954,15 @@ pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer us
 
 	g_variant_get(params, "(b)", &force);
 
+	/* Nothing to download if the last refresh is recent enough */
+	stamp_path = g_build_filename(LOCALSTATEDIR, "cache", "PackageKit", "metadata", "refresh.stamp", NULL);
+	if (!force && g_stat(stamp_path, &stamp_stat) == 0 &&
+	    pk_backend_job_is_cache_fresh(job, stamp_stat.st_mtime))
+	{
+		g_debug("metadata is younger than the cache age");
+		goto out;
+	}
+
 	/* Force the complete cache refresh if the read configuration file is newer than the metadata cache */
 	if (!force)
 	{
@@ -994,20 +1014,29 @@ pk_backend_refresh_cache_thread(PkBackendJob *job, GVariant *params, gpointer us
 	/* Download repository */
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_DOWNLOAD_REPOSITORY);
 
-	for (GSList *l = file_list; l; l = g_slist_next(l))
-	{
-		get_file(&job_data->curl, static_cast<gchar **> (l->data)[0],
-				static_cast<gchar **> (l->data)[1]);
-	}
+	get_files(job, file_list, 100);
 	g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
 
 	/* Refresh cache */
 	pk_backend_job_set_status(job, PK_STATUS_ENUM_REFRESH_CACHE);
 
+	/* Import all repositories in one transaction without waiting for the disk
+	 * after every write. The indexes are created after the bulk load. A cache
+	 * broken by a power loss is rebuilt by the next forced refresh. */
+	sqlite3_exec(job_data->db,
+	             "PRAGMA journal_mode = WAL;"
+	             "PRAGMA synchronous = OFF;"
+	             "DROP INDEX IF EXISTS filelist_filename;"
+	             "BEGIN TRANSACTION",
+	             NULL, NULL, NULL);
 	for (GSList *l = repos; l; l = g_slist_next(l))
 	{
 		static_cast<Pkgtools *> (l->data)->generate_cache (job, tmp_dir_name);
 	}
+	sqlite3_exec(job_data->db, "END TRANSACTION; PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+	generate_search_index(job_data->db);
+	if (!pk_backend_job_get_is_error_set(job))
+		g_file_set_contents(stamp_path, "", 0, NULL);
 
 out:
 	sqlite3_finalize(stmt);
@@ -1020,6 +1049,7 @@ out:
 		g_object_unref(db_file);
 	}
 	g_free(path);
+	g_free(stamp_path);
 
 	pk_directory_remove_contents(tmp_dir_name);
 	g_rmdir(tmp_dir_name);
@@ -6,25 +6,28 @@
 namespace slack {
 
 /**
- * slack::Pkgtools::download:
+ * slack::Pkgtools::collect_download:
  * @job: A #PkBackendJob.
  * @dest_dir_name: Destination directory.
  * @pkg_name: Package name.
+ * @source_dest: Return location for the source url and the destination,
+ *               %NULL if the package is already downloaded.
  *
- * Download a package.
+ * Looks up where a package is downloaded from, so that several packages
+ * can be fetched at once with slack::get_files().
  *
- * Returns: %TRUE on success, %FALSE otherwise.
+ * Returns: %TRUE if the package is known, %FALSE otherwise.
  **/
 gboolean
-Pkgtools::download (PkBackendJob *job,
-		gchar *dest_dir_name, gchar *pkg_name) noexcept
+Pkgtools::collect_download (PkBackendJob *job, const gchar *dest_dir_name,
+		const gchar *pkg_name, gchar ***source_dest) noexcept
 {
-	gchar *dest_filename, *source_url;
+	gchar *dest_filename;
 	gboolean ret = FALSE;
 	sqlite3_stmt *statement = NULL;
-	CURL *curl = NULL;
 	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
 
+	*source_dest = NULL;
 	if ((sqlite3_prepare_v2(job_data->db,
 							"SELECT location, (full_name || '.' || ext) FROM pkglist "
 							"WHERE name LIKE @name AND repo_order = @repo_order",
@@ -39,36 +42,63 @@ Pkgtools::download (PkBackendJob *job,
 	if (sqlite3_step(statement) == SQLITE_ROW)
 	{
 		dest_filename = g_build_filename(dest_dir_name, sqlite3_column_text(statement, 1), NULL);
-		source_url = g_strconcat(this->get_mirror (),
-								 sqlite3_column_text(statement, 0),
-								 "/",
-								 sqlite3_column_text(statement, 1),
-								 NULL);
 
 		if (!g_file_test(dest_filename, G_FILE_TEST_EXISTS))
 		{
-			if (get_file(&curl, source_url, dest_filename) == CURLE_OK)
-			{
-				ret = TRUE;
-			}
+			*source_dest = static_cast<gchar **> (g_malloc_n(3, sizeof(gchar *)));
+			(*source_dest)[0] = g_strconcat(this->get_mirror (),
+									 sqlite3_column_text(statement, 0),
+									 "/",
+									 sqlite3_column_text(statement, 1),
+									 NULL);
+			(*source_dest)[1] = dest_filename;
+			(*source_dest)[2] = NULL;
 		}
 		else
 		{
-			ret = TRUE;
+			g_free(dest_filename);
 		}
-
-		if (curl)
-		{
-			curl_easy_cleanup(curl);
-		}
-		g_free(source_url);
-		g_free(dest_filename);
+		ret = TRUE;
 	}
 	sqlite3_finalize(statement);
 
 	return ret;
 }
 
+/**
+ * slack::Pkgtools::download:
+ * @job: A #PkBackendJob.
+ * @dest_dir_name: Destination directory.
+ * @pkg_name: Package name.
+ *
+ * Download a package.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise.
+ **/
+gboolean
+Pkgtools::download (PkBackendJob *job,
+		gchar *dest_dir_name, gchar *pkg_name) noexcept
+{
+	gchar **source_dest;
+	GSList *file_list;
+	gboolean ret;
+
+	if (!this->collect_download (job, dest_dir_name, pkg_name, &source_dest))
+	{
+		return FALSE;
+	}
+	if (!source_dest)
+	{
+		return TRUE;
+	}
+
+	file_list = g_slist_append(NULL, source_dest);
+	ret = get_files(NULL, file_list, 100);
+	g_slist_free_full(file_list, (GDestroyNotify)g_strfreev);
+
+	return ret;
+}
+
 /**
  * slack::Pkgtools::install:
  * @job: A #PkBackendJob.
@@ -16,6 +16,8 @@ public:
 
 	virtual ~Pkgtools () noexcept;
 
+	gboolean collect_download (PkBackendJob *job, const gchar *dest_dir_name,
+			const gchar *pkg_name, gchar ***source_dest) noexcept;
 	gboolean download (PkBackendJob *job,
 			gchar *dest_dir_name, gchar *pkg_name) noexcept;
 	void install (PkBackendJob *job, gchar *pkg_name) noexcept;
@@ -9,74 +9,50 @@ namespace slack {
 
 GHashTable *Slackpkg::cat_map = NULL;
 
+struct ManifestExprs
+{
+	GRegex *pkg_expr, *file_expr;
+};
+
+struct ManifestFiles
+{
+	gchar *path;
+	GStringChunk *strings;
+	GPtrArray *rows; /* Pairs of the package full name and a file name */
+};
+
 /*
- * slack::Slackpkg::manifest:
- * @job:      a #PkBackendJob.
- * @tmpl:     temporary directory.
- * @filename: manifest filename
+ * slack::Slackpkg::read_manifest:
+ * @data:      a #ManifestFiles.
+ * @user_data: the #ManifestExprs.
  *
- * Parse the manifest file and save the file list in the database.
+ * Decompress and parse a manifest file. Runs on a worker thread, so the
+ * file list is only collected here and saved in the database afterwards.
  */
 void
-Slackpkg::manifest (PkBackendJob *job,
-		const gchar *tmpl, gchar *filename) noexcept
+Slackpkg::read_manifest (gpointer data, gpointer user_data) noexcept
 {
 	FILE *manifest;
 	gint err, read_len;
 	guint pos;
-	gchar buf[max_buf_size], *path, *pkg_filename, *rest = NULL, *start;
-	gchar *full_name = NULL;
+	gchar buf[max_buf_size], *rest = NULL, *start;
+	const gchar *full_name = NULL;
 	gchar **line, **lines;
 	BZFILE *manifest_bz2;
-	GRegex *pkg_expr = NULL, *file_expr = NULL;
 	GMatchInfo *match_info;
-	sqlite3_stmt *statement = NULL;
-	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
-
-	path = g_build_filename(tmpl,
-	                        this->get_name (),
-	                        filename,
-	                        NULL);
-	manifest = fopen(path, "rb");
-	g_free(path);
+	auto files = static_cast<ManifestFiles *> (data);
+	auto exprs = static_cast<ManifestExprs *> (user_data);
 
-	if (!manifest)
+	if (!(manifest = fopen(files->path, "rb")))
 	{
 		return;
 	}
 	if (!(manifest_bz2 = BZ2_bzReadOpen(&err, manifest, 0, 0, NULL, 0)))
 	{
-		goto out;
-	}
-
-	/* Prepare regular expressions */
-	pkg_expr = g_regex_new("^\\|\\|[[:blank:]]+Package:[[:blank:]]+.+\\/(.+)\\.(t[blxg]z$)?",
-	                       static_cast<GRegexCompileFlags> (G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES),
-	                       static_cast<GRegexMatchFlags> (0),
-	                       NULL);
-	file_expr = g_regex_new("^[-bcdlps][-r][-w][-xsS][-r][-w][-xsS][-r][-w]"
-	                        "[-xtT][[:space:]][^[:space:]]+[[:space:]]+"
-	                        "[[:digit:]]+[[:space:]][[:digit:]-]+[[:space:]]"
-	                        "[[:digit:]:]+[[:space:]](?!install\\/|\\.)(.*)",
-	                        static_cast<GRegexCompileFlags> (G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES),
-	                        static_cast<GRegexMatchFlags> (0),
-	                        NULL);
-	if (!(file_expr) || !(pkg_expr))
-	{
-		goto out;
-	}
-
-	/* Prepare SQL statements */
-	if (sqlite3_prepare_v2(job_data->db,
-						   "INSERT INTO filelist (full_name, filename) VALUES (@full_name, @filename)",
-						   -1,
-						   &statement,
-						   NULL) != SQLITE_OK)
-	{
-		goto out;
+		fclose(manifest);
+		return;
 	}
 
-	sqlite3_exec(job_data->db, "BEGIN TRANSACTION", NULL, NULL, NULL);
 	while ((read_len = BZ2_bzRead(&err, manifest_bz2, buf, max_buf_size - 1)))
 	{
 		if ((err != BZ_OK) && (err != BZ_STREAM_END))
@@ -93,6 +69,7 @@ Slackpkg::manifest (PkBackendJob *job,
 			lines[0] = g_strconcat(rest, lines[0], NULL);
 			g_free(start);
 			g_free(rest);
+			rest = NULL;
 		}
 		if (err != BZ_STREAM_END) /* The last line can be incomplete */
 		{
@@ -102,12 +79,13 @@ Slackpkg::manifest (PkBackendJob *job,
 		}
 		for (line = lines; *line; line++)
 		{
-			if (g_regex_match(pkg_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
+			if (g_regex_match(exprs->pkg_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
 			{
 				if (g_match_info_get_match_count(match_info) > 2)
 				{ /* If the extension matches */
-					g_free(full_name);
-					full_name = g_match_info_fetch(match_info, 1);
+					gchar *name = g_match_info_fetch(match_info, 1);
+					full_name = g_string_chunk_insert_const(files->strings, name);
+					g_free(name);
 				}
 				else
 				{
@@ -117,36 +95,125 @@ Slackpkg::manifest (PkBackendJob *job,
 			g_match_info_free(match_info);
 
 			match_info = NULL;
-			if (full_name && g_regex_match(file_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
+			if (full_name && g_regex_match(exprs->file_expr, *line, static_cast<GRegexMatchFlags> (0), &match_info))
 			{
-				pkg_filename = g_match_info_fetch(match_info, 1);
-				sqlite3_bind_text(statement, 1, full_name, -1, SQLITE_TRANSIENT);
-				sqlite3_bind_text(statement, 2, pkg_filename, -1, SQLITE_TRANSIENT);
-				sqlite3_step(statement);
-				sqlite3_clear_bindings(statement);
-				sqlite3_reset(statement);
+				gchar *pkg_filename = g_match_info_fetch(match_info, 1);
+				g_ptr_array_add(files->rows, (gpointer) full_name);
+				g_ptr_array_add(files->rows, g_string_chunk_insert(files->strings, pkg_filename));
 				g_free(pkg_filename);
 			}
 			g_match_info_free(match_info);
 		}
 		g_strfreev(lines);
 	}
+	g_free(rest);
 
-	sqlite3_exec(job_data->db, "END TRANSACTION", NULL, NULL, NULL);
-	g_free(full_name);
 	BZ2_bzReadClose(&err, manifest_bz2);
+	fclose(manifest);
+}
 
-out:
+/*
+ * slack::Slackpkg::manifest:
+ * @job:      a #PkBackendJob.
+ * @tmpl:     temporary directory.
+ *
+ * Parse the manifest files of all priorities in parallel and save the file
+ * lists in the database.
+ */
+void
+Slackpkg::manifest (PkBackendJob *job, const gchar *tmpl) noexcept
+{
+	guint i, n_manifests = g_strv_length(this->priority);
+	GThreadPool *pool = NULL;
+	ManifestExprs exprs;
+	ManifestFiles *files;
+	sqlite3_stmt *statement = NULL;
+	auto job_data = static_cast<JobData *> (pk_backend_job_get_user_data(job));
+
+	/* Prepare regular expressions */
+	exprs.pkg_expr = g_regex_new("^\\|\\|[[:blank:]]+Package:[[:blank:]]+.+\\/(.+)\\.(t[blxg]z$)?",
+	                       static_cast<GRegexCompileFlags> (G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES),
+	                       static_cast<GRegexMatchFlags> (0),
+	                       NULL);
+	exprs.file_expr = g_regex_new("^[-bcdlps][-r][-w][-xsS][-r][-w][-xsS][-r][-w]"
+	                        "[-xtT][[:space:]][^[:space:]]+[[:space:]]+"
+	                        "[[:digit:]]+[[:space:]][[:digit:]-]+[[:space:]]"
+	                        "[[:digit:]:]+[[:space:]](?!install\\/|\\.)(.*)",
+	                        static_cast<GRegexCompileFlags> (G_REGEX_OPTIMIZE | G_REGEX_DUPNAMES),
+	                        static_cast<GRegexMatchFlags> (0),
+	                        NULL);
+	if (!(exprs.file_expr) || !(exprs.pkg_expr) || !n_manifests)
+	{
+		goto out;
+	}
+
+	/* Decompressing and matching dominate, so do it for all manifests at once */
+	files = g_new0(ManifestFiles, n_manifests);
+	pool = g_thread_pool_new(read_manifest, &exprs,
+	                         MIN(n_manifests, g_get_num_processors()), TRUE, NULL);
+	for (i = 0; i < n_manifests; i++)
+	{
+		gchar *filename = g_strconcat(this->priority[i], "-MANIFEST.bz2", NULL);
+
+		files[i].path = g_build_filename(tmpl, this->get_name (), filename, NULL);
+		files[i].strings = g_string_chunk_new(max_buf_size);
+		files[i].rows = g_ptr_array_new();
+		g_free(filename);
+
+		if (!pool || !g_thread_pool_push(pool, &files[i], NULL))
+		{
+			read_manifest(&files[i], &exprs);
+		}
+	}
+	if (pool)
+	{
+		g_thread_pool_free(pool, FALSE, TRUE);
+	}
+
+	/* Save the file lists in the order of the priorities */
+	if (sqlite3_prepare_v2(job_data->db,
+						   "INSERT INTO filelist (full_name, filename) VALUES (@full_name, @filename)",
+						   -1,
+						   &statement,
+						   NULL) == SQLITE_OK)
+	{
+		sqlite3_exec(job_data->db, "SAVEPOINT manifest", NULL, NULL, NULL);
+		for (i = 0; i < n_manifests; i++)
+		{
+			for (guint j = 0; j + 1 < files[i].rows->len; j += 2)
+			{
+				sqlite3_bind_text(statement, 1,
+				                  static_cast<gchar *> (g_ptr_array_index(files[i].rows, j)),
+				                  -1, SQLITE_STATIC);
+				sqlite3_bind_text(statement, 2,
+				                  static_cast<gchar *> (g_ptr_array_index(files[i].rows, j + 1)),
+				                  -1, SQLITE_STATIC);
+				sqlite3_step(statement);
+				sqlite3_clear_bindings(statement);
+				sqlite3_reset(statement);
+			}
+		}
+		sqlite3_exec(job_data->db, "RELEASE manifest", NULL, NULL, NULL);
+	}
 	sqlite3_finalize(statement);
-	if (file_expr)
+
+	for (i = 0; i < n_manifests; i++)
+	{
+		g_ptr_array_unref(files[i].rows);
+		g_string_chunk_free(files[i].strings);
+		g_free(files[i].path);
+	}
+	g_free(files);
+
+out:
+	if (exprs.file_expr)
 	{
-		g_regex_unref(file_expr);
+		g_regex_unref(exprs.file_expr);
 	}
-	if (pkg_expr)
+	if (exprs.pkg_expr)
 	{
-		g_regex_unref(pkg_expr);
+		g_regex_unref(exprs.pkg_expr);
 	}
-	fclose(manifest);
 }
 
 /**
@@ -329,7 +396,7 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 	data_in = g_data_input_stream_new(G_INPUT_STREAM(fin));
 	desc = g_string_new("");
 
-	sqlite3_exec(job_data->db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(job_data->db, "SAVEPOINT generate_cache", NULL, NULL, NULL);
 
 	while ((line = g_data_input_stream_read_line(data_in, NULL, NULL, NULL)))
 	{
@@ -424,18 +491,13 @@ Slackpkg::generate_cache (PkBackendJob *job, const gchar *tmpl) noexcept
 		}
 		g_free(line);
 	}
-	sqlite3_exec(job_data->db, "END TRANSACTION", NULL, NULL, NULL);
+	sqlite3_exec(job_data->db, "RELEASE generate_cache", NULL, NULL, NULL);
 
 	g_string_free(desc, TRUE);
 	g_object_unref(data_in);
 
 	/* Parse MANIFEST.bz2 */
-	for (gchar **p = this->priority; *p; p++)
-	{
-		filename = g_strconcat(*p, "-MANIFEST.bz2", NULL);
-		manifest (job, tmpl, filename);
-		g_free(filename);
-	}
+	manifest (job, tmpl);
 out:
 	sqlite3_finalize(update_statement);
 	sqlite3_free(query);
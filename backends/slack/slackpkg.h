@@ -21,8 +21,8 @@ private:
 	static const std::size_t max_buf_size = 8192;
 	gchar **priority = NULL;
 
-	void manifest (PkBackendJob *job,
-			const gchar *tmpl, gchar *filename) noexcept;
+	static void read_manifest (gpointer data, gpointer user_data) noexcept;
+	void manifest (PkBackendJob *job, const gchar *tmpl) noexcept;
 };
 
 }
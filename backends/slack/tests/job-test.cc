@@ -26,6 +26,45 @@ test_filter_package_none ()
 	g_assert_true (filter_package (filters, true));
 }
 
+static void
+test_generate_search_index ()
+{
+	sqlite3 *db;
+	sqlite3_stmt *stmt;
+
+	g_assert_cmpint (sqlite3_open (":memory:", &db), ==, SQLITE_OK);
+	g_assert_cmpint (sqlite3_exec (db,
+				"CREATE TABLE repos (repo_order INTEGER PRIMARY KEY, repo VARCHAR);"
+				"CREATE TABLE pkglist (full_name VARCHAR NOT NULL UNIQUE, name VARCHAR NOT NULL,"
+				"desc TEXT DEFAULT '', cat VARCHAR DEFAULT 'unknown', repo_order INTEGER,"
+				"PRIMARY KEY (name, repo_order));"
+				"CREATE TABLE filelist (full_name VARCHAR NOT NULL, filename VARCHAR NOT NULL,"
+				"PRIMARY KEY (full_name, filename));"
+				"INSERT INTO pkglist (full_name, name, repo_order) VALUES"
+				"('xterm-1-x86_64-2', 'xterm', 2), ('xterm-2-x86_64-1', 'xterm', 1),"
+				"('zlib-1-x86_64-1', 'zlib', 2);"
+				"INSERT INTO filelist VALUES"
+				"('xterm-2-x86_64-1', 'usr/share/applications/xterm.desktop'),"
+				"('zlib-1-x86_64-1', 'usr/lib64/libz.so');",
+				NULL, NULL, NULL), ==, SQLITE_OK);
+
+	g_assert_true (generate_search_index (db));
+
+	g_assert_cmpint (sqlite3_prepare_v2 (db,
+				"SELECT full_name, is_application FROM best_pkg ORDER BY name",
+				-1, &stmt, NULL), ==, SQLITE_OK);
+	g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_ROW);
+	g_assert_cmpstr ((const gchar *) sqlite3_column_text (stmt, 0), ==, "xterm-2-x86_64-1");
+	g_assert_cmpint (sqlite3_column_int (stmt, 1), ==, 1);
+	g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_ROW);
+	g_assert_cmpstr ((const gchar *) sqlite3_column_text (stmt, 0), ==, "zlib-1-x86_64-1");
+	g_assert_cmpint (sqlite3_column_int (stmt, 1), ==, 0);
+	g_assert_cmpint (sqlite3_step (stmt), ==, SQLITE_DONE);
+	sqlite3_finalize (stmt);
+
+	sqlite3_close (db);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -34,6 +73,7 @@ main (int argc, char *argv[])
 	g_test_add_func ("/slack/filter_package_installed", test_filter_package_installed);
 	g_test_add_func ("/slack/filter_package_not_installed", test_filter_package_not_installed);
 	g_test_add_func ("/slack/filter_package_none", test_filter_package_none);
+	g_test_add_func ("/slack/generate_search_index", test_generate_search_index);
 
 	return g_test_run ();
 }
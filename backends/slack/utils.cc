@@ -1,3 +1,4 @@
+#include <glib/gstdio.h>
 #include <sqlite3.h>
 #include <string.h>
 #include "utils.h"
@@ -66,6 +67,193 @@ get_file (CURL **curl, gchar *source_url, gchar *dest)
 	return ret;
 }
 
+/* Maximal number of files slack::get_files() fetches at the same time */
+static const gint max_parallel_downloads = 4;
+
+struct Transfer
+{
+	CURL *curl;
+	FILE *fout;
+	const gchar *dest;
+	curl_off_t dlnow, dltotal;
+	gboolean done;
+};
+
+static int
+transfer_progress_cb (void *clientp, curl_off_t dltotal, curl_off_t dlnow,
+                      curl_off_t ultotal, curl_off_t ulnow)
+{
+	auto transfer = static_cast<Transfer *> (clientp);
+
+	transfer->dltotal = dltotal;
+	transfer->dlnow = dlnow;
+
+	return 0;
+}
+
+static void
+transfers_report (PkBackendJob *job, Transfer *transfers, guint n_transfers,
+                  guint max_percentage, gint64 start_time)
+{
+	curl_off_t dlnow = 0;
+	gdouble progress = 0;
+	gint64 elapsed;
+
+	for (guint i = 0; i < n_transfers; i++)
+	{
+		if (transfers[i].done)
+		{
+			progress += 1;
+		}
+		else if (transfers[i].dltotal > 0)
+		{
+			progress += (gdouble) transfers[i].dlnow / transfers[i].dltotal;
+		}
+		dlnow += transfers[i].dlnow;
+	}
+	pk_backend_job_set_percentage(job, max_percentage * progress / n_transfers);
+
+	elapsed = g_get_monotonic_time() - start_time;
+	if (elapsed > 0)
+	{
+		pk_backend_job_set_speed(job, (guint) (dlnow * 8 * G_USEC_PER_SEC / elapsed));
+	}
+}
+
+/**
+ * slack::get_files:
+ * @job: a #PkBackendJob to report the progress to, or %NULL.
+ * @file_list: list of string vectors with the source url and the destination.
+ * @max_percentage: percentage reported when all files are downloaded.
+ *
+ * Downloads the files concurrently, reusing the connections to the mirrors
+ * and multiplexing the requests over HTTP/2 where the server supports it.
+ *
+ * Returns: %TRUE if all files were downloaded, %FALSE otherwise.
+ **/
+gboolean
+get_files (PkBackendJob *job, GSList *file_list, guint max_percentage)
+{
+	CURLM *multi;
+	CURLMsg *msg;
+	GSList *l = file_list;
+	gboolean ret = TRUE;
+	gint running = 0, msgs_left;
+	guint i, n_transfers = g_slist_length(file_list), n_next = 0;
+	gint64 start_time = g_get_monotonic_time();
+
+	if (!n_transfers)
+	{
+		return TRUE;
+	}
+	if (!(multi = curl_multi_init()))
+	{
+		return FALSE;
+	}
+	curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) max_parallel_downloads);
+
+	auto transfers = g_new0(Transfer, n_transfers);
+
+	do
+	{
+		/* Keep up to max_parallel_downloads transfers running */
+		for (; l && running < max_parallel_downloads; l = g_slist_next(l), n_next++)
+		{
+			auto source_dest = static_cast<gchar **> (l->data);
+			Transfer *transfer = &transfers[n_next];
+
+			transfer->dest = source_dest[1];
+			if (!(transfer->fout = fopen(source_dest[1], "wb"))
+			 || !(transfer->curl = curl_easy_init()))
+			{
+				if (transfer->fout)
+				{
+					fclose(transfer->fout);
+					transfer->fout = NULL;
+				}
+				transfer->done = TRUE;
+				ret = FALSE;
+				continue;
+			}
+			curl_easy_setopt(transfer->curl, CURLOPT_URL, source_dest[0]);
+			curl_easy_setopt(transfer->curl, CURLOPT_FOLLOWLOCATION, 1L);
+			curl_easy_setopt(transfer->curl, CURLOPT_WRITEDATA, transfer->fout);
+			curl_easy_setopt(transfer->curl, CURLOPT_HTTP_VERSION, (long) CURL_HTTP_VERSION_2TLS);
+			curl_easy_setopt(transfer->curl, CURLOPT_PIPEWAIT, 1L);
+			curl_easy_setopt(transfer->curl, CURLOPT_PRIVATE, transfer);
+			curl_easy_setopt(transfer->curl, CURLOPT_NOPROGRESS, 0L);
+			curl_easy_setopt(transfer->curl, CURLOPT_XFERINFOFUNCTION, transfer_progress_cb);
+			curl_easy_setopt(transfer->curl, CURLOPT_XFERINFODATA, transfer);
+			curl_multi_add_handle(multi, transfer->curl);
+			running++;
+		}
+
+		curl_multi_perform(multi, &running);
+
+		while ((msg = curl_multi_info_read(multi, &msgs_left)))
+		{
+			Transfer *transfer;
+			CURLcode result = msg->data.result;
+			glong response_code = 0;
+
+			if (msg->msg != CURLMSG_DONE)
+			{
+				continue;
+			}
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &transfer);
+			curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
+			transfer->done = TRUE;
+
+			/* Frees msg as well */
+			curl_multi_remove_handle(multi, transfer->curl);
+			curl_easy_cleanup(transfer->curl);
+			transfer->curl = NULL;
+			fclose(transfer->fout);
+			transfer->fout = NULL;
+
+			/* Don't leave a partial file to be taken for a downloaded one */
+			if (result != CURLE_OK || response_code >= 400)
+			{
+				g_remove(transfer->dest);
+				ret = FALSE;
+			}
+		}
+
+		if (job)
+		{
+			transfers_report(job, transfers, n_transfers, max_percentage, start_time);
+		}
+
+		if (running)
+		{
+			curl_multi_wait(multi, NULL, 0, 1000, NULL);
+		}
+	}
+	while (running || l);
+
+	for (i = 0; i < n_transfers; i++)
+	{
+		if (transfers[i].curl)
+		{
+			curl_multi_remove_handle(multi, transfers[i].curl);
+			curl_easy_cleanup(transfers[i].curl);
+		}
+		if (transfers[i].fout)
+		{
+			fclose(transfers[i].fout);
+		}
+	}
+	g_free(transfers);
+	curl_multi_cleanup(multi);
+
+	if (job)
+	{
+		pk_backend_job_set_percentage(job, max_percentage);
+	}
+	return ret;
+}
+
 /**
  * slack::split_package_name:
  * Got the name of a package, without version-arch-release data.
@@ -118,53 +306,76 @@ split_package_name (const gchar *pkg_filename)
 	return pkg_tokens;
 }
 
-/**
- * slack::is_installed:
- * Checks if a package is already installed in the system.
- *
- * Params:
- * 	pkg_fullname = Package name should be looked for.
- *
- * Returns: PK_INFO_ENUM_INSTALLING if pkg_fullname is already installed,
- *          PK_INFO_ENUM_UPDATING if an elder version of pkg_fullname is
- *          installed, PK_INFO_ENUM_UNKNOWN if pkg_fullname is malformed.
- **/
-PkInfoEnum
-is_installed (const gchar *pkg_fullname)
+/* Package name : full name of the installed packages, kept current by a
+ * monitor on the package metadata directory. */
+static GHashTable *installed_pkgs = NULL;
+static GFileMonitor *installed_monitor = NULL;
+static GMutex installed_mutex;
+
+/* Strips version, architecture and build from a full package name. */
+static gchar *
+installed_get_name (const gchar *pkg_fullname)
+{
+	const gchar *it;
+	guint8 dashes = 0;
+
+	for (it = pkg_fullname + strlen(pkg_fullname); it != pkg_fullname; --it)
+	{
+		if (*it == '-')
+		{
+			if (dashes == 2)
+			{
+				break;
+			}
+			++dashes;
+		}
+	}
+	if (dashes < 2)
+	{
+		return NULL;
+	}
+	return g_strndup(pkg_fullname, it - pkg_fullname);
+}
+
+static void
+installed_add (const gchar *pkg_fullname)
+{
+	gchar *name = installed_get_name(pkg_fullname);
+
+	if (name != NULL)
+	{
+		g_hash_table_replace(installed_pkgs, name, g_strdup(pkg_fullname));
+	}
+}
+
+static void
+installed_remove (const gchar *pkg_fullname)
+{
+	gchar *name = installed_get_name(pkg_fullname);
+
+	/* An upgrade may have added the new version before removing the old one */
+	if (name != NULL
+	 && g_strcmp0(static_cast<const gchar *> (g_hash_table_lookup(installed_pkgs, name)),
+	              pkg_fullname) == 0)
+	{
+		g_hash_table_remove(installed_pkgs, name);
+	}
+	g_free(name);
+}
+
+/* Must be called with installed_mutex held. */
+static gboolean
+installed_load (void)
 {
 	GFileEnumerator *pkg_metadata_enumerator;
 	GFileInfo *pkg_metadata_file_info;
 	GFile *pkg_metadata_dir;
-	PkInfoEnum ret = PK_INFO_ENUM_INSTALLING;
-    const gchar *it;
-    guint8 dashes = 0;
-	ptrdiff_t pkg_name;
-
-	g_return_val_if_fail(pkg_fullname != NULL, PK_INFO_ENUM_UNKNOWN);
 
-    // We want to find the package name without version for the package we're
-    // looking for.
-    g_debug("Looking if %s is installed", pkg_fullname);
-
-    for (it = pkg_fullname + strlen(pkg_fullname); it != pkg_fullname; --it)
-    {
-        if (*it == '-')
-        {
-            if (dashes == 2)
-            {
-                break;
-            }
-            ++dashes;
-        }
-    }
-	if (dashes < 2)
+	if (installed_pkgs != NULL)
 	{
-		return PK_INFO_ENUM_UNKNOWN;
+		return TRUE;
 	}
-    pkg_name = it - pkg_fullname;
 
-	// Read the package metadata directory and comprare all installed packages
-    // with ones in the cache.
 	pkg_metadata_dir = g_file_new_for_path("/var/log/packages");
 	if (!(pkg_metadata_enumerator = g_file_enumerate_children(pkg_metadata_dir,
 	                                                          "standard::name",
@@ -173,46 +384,149 @@ is_installed (const gchar *pkg_fullname)
 	                                                          NULL)))
 	{
 		g_object_unref(pkg_metadata_dir);
-		return PK_INFO_ENUM_UNKNOWN;
+		return FALSE;
 	}
 
+	installed_pkgs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 	while ((pkg_metadata_file_info = g_file_enumerator_next_file(pkg_metadata_enumerator, NULL, NULL)))
 	{
-		const gchar *dir = g_file_info_get_name(pkg_metadata_file_info);
-        dashes = 0;
+		installed_add(g_file_info_get_name(pkg_metadata_file_info));
+		g_object_unref(pkg_metadata_file_info);
+	}
+	g_object_unref(pkg_metadata_enumerator);
+	g_object_unref(pkg_metadata_dir);
 
-        if (strcmp(dir, pkg_fullname) == 0)
-        {
-            ret = PK_INFO_ENUM_INSTALLED;
-        }
-		else
-		{
-			for (it = dir + strlen(dir); it != dir; --it)
-			{
-				if (*it == '-')
-				{
-					if (dashes == 2)
-					{
-						break;
-					}
-					++dashes;
-				}
-			}
-			if (pkg_name == (it - dir) && strncmp(pkg_fullname, dir, pkg_name) == 0)
-			{
-				ret = PK_INFO_ENUM_UPDATING;
-			}
+	return TRUE;
+}
+
+static void
+installed_changed_cb (GFileMonitor *monitor, GFile *file, GFile *other_file,
+                      GFileMonitorEvent event_type, gpointer user_data)
+{
+	gchar *pkg_fullname = g_file_get_basename(file);
+	gchar *other_fullname = NULL;
 
+	g_mutex_lock(&installed_mutex);
+	if (installed_pkgs != NULL)
+	{
+		switch (event_type)
+		{
+			case G_FILE_MONITOR_EVENT_CREATED:
+			case G_FILE_MONITOR_EVENT_MOVED_IN:
+				installed_add(pkg_fullname);
+				break;
+			case G_FILE_MONITOR_EVENT_DELETED:
+			case G_FILE_MONITOR_EVENT_MOVED_OUT:
+				installed_remove(pkg_fullname);
+				break;
+			case G_FILE_MONITOR_EVENT_RENAMED:
+				other_fullname = g_file_get_basename(other_file);
+				installed_remove(pkg_fullname);
+				installed_add(other_fullname);
+				break;
+			default:
+				break;
 		}
-		g_object_unref(pkg_metadata_file_info);
+	}
+	g_mutex_unlock(&installed_mutex);
+
+	g_free(other_fullname);
+	g_free(pkg_fullname);
+}
+
+/**
+ * slack::installed_watch:
+ * Starts keeping the set of installed packages in memory. Without it the
+ * package metadata directory is read on every slack::is_installed() call.
+ **/
+void
+installed_watch (void)
+{
+	GFile *pkg_metadata_dir;
+	GError *err = NULL;
 
-		if (ret != PK_INFO_ENUM_INSTALLING) /* If installed */
+	g_mutex_lock(&installed_mutex);
+	if (installed_monitor == NULL)
+	{
+		pkg_metadata_dir = g_file_new_for_path("/var/log/packages");
+		installed_monitor = g_file_monitor_directory(pkg_metadata_dir,
+		                                             G_FILE_MONITOR_WATCH_MOVES,
+		                                             NULL,
+		                                             &err);
+		if (installed_monitor != NULL)
+		{
+			g_signal_connect(installed_monitor, "changed",
+			                 G_CALLBACK(installed_changed_cb), NULL);
+		}
+		else
 		{
-			break;
+			g_warning("/var/log/packages: %s", err->message);
+			g_error_free(err);
 		}
+		g_object_unref(pkg_metadata_dir);
 	}
-	g_object_unref(pkg_metadata_enumerator);
-	g_object_unref(pkg_metadata_dir);
+	g_mutex_unlock(&installed_mutex);
+}
+
+/**
+ * slack::installed_unwatch:
+ * Stops the monitor and frees the set of installed packages.
+ **/
+void
+installed_unwatch (void)
+{
+	g_mutex_lock(&installed_mutex);
+	g_clear_object(&installed_monitor);
+	g_clear_pointer(&installed_pkgs, g_hash_table_unref);
+	g_mutex_unlock(&installed_mutex);
+}
+
+/**
+ * slack::is_installed:
+ * Checks if a package is already installed in the system.
+ *
+ * Params:
+ * 	pkg_fullname = Package name should be looked for.
+ *
+ * Returns: PK_INFO_ENUM_INSTALLING if pkg_fullname is already installed,
+ *          PK_INFO_ENUM_UPDATING if an elder version of pkg_fullname is
+ *          installed, PK_INFO_ENUM_UNKNOWN if pkg_fullname is malformed.
+ **/
+PkInfoEnum
+is_installed (const gchar *pkg_fullname)
+{
+	PkInfoEnum ret = PK_INFO_ENUM_INSTALLING;
+	const gchar *installed_fullname;
+	gchar *pkg_name;
+
+	g_return_val_if_fail(pkg_fullname != NULL, PK_INFO_ENUM_UNKNOWN);
+
+	g_debug("Looking if %s is installed", pkg_fullname);
+
+	// We want to find the package name without version for the package we're
+	// looking for.
+	if (!(pkg_name = installed_get_name(pkg_fullname)))
+	{
+		return PK_INFO_ENUM_UNKNOWN;
+	}
+
+	g_mutex_lock(&installed_mutex);
+	if (!installed_load())
+	{
+		ret = PK_INFO_ENUM_UNKNOWN;
+	}
+	else if ((installed_fullname = static_cast<const gchar *> (g_hash_table_lookup(installed_pkgs, pkg_name))))
+	{
+		ret = strcmp(installed_fullname, pkg_fullname) == 0 ? PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_UPDATING;
+	}
+
+	/* Nothing keeps the set current without the monitor */
+	if (installed_monitor == NULL)
+	{
+		g_clear_pointer(&installed_pkgs, g_hash_table_unref);
+	}
+	g_mutex_unlock(&installed_mutex);
+	g_free(pkg_name);
 
 	return ret;
 }
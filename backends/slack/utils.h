@@ -17,8 +17,14 @@ struct JobData
 
 CURLcode get_file (CURL **curl, gchar *source_url, gchar *dest);
 
+gboolean get_files (PkBackendJob *job, GSList *file_list, guint max_percentage);
+
 gchar **split_package_name (const gchar *pkg_filename);
 
+void installed_watch (void);
+
+void installed_unwatch (void);
+
 PkInfoEnum is_installed (const gchar *pkg_fullname);
 
 extern "C" {
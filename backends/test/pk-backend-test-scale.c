@@ -0,0 +1,688 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A backend with a generated, distro-sized package universe for scale
+ * testing. Everything is derived from the seed, so two daemons with the
+ * same config return exactly the same results:
+ *
+ *   [TestScale]
+ *   Packages=100000
+ *   Seed=1
+ *
+ * Packages are named scale-0000000 and up, and each may only depend on
+ * packages with a lower index so the graph has no cycles. Only the query
+ * roles are implemented; the data is read-only after initialization, so
+ * every query runs on its own thread without locking.
+ */
+
+#include <gmodule.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pk-backend.h>
+
+#define PK_SCALE_PACKAGES_DEFAULT	100000
+#define PK_SCALE_PACKAGES_MAX		1000000
+#define PK_SCALE_MAX_DEPENDS		4
+#define PK_SCALE_MAX_FILES		16
+#define PK_SCALE_URL			"https://example.com/scale"
+
+enum {
+	PK_SCALE_FLAG_INSTALLED		= 1 << 0,
+	PK_SCALE_FLAG_UPDATE		= 1 << 1,
+	PK_SCALE_FLAG_SECURITY		= 1 << 2,
+	PK_SCALE_FLAG_DEVEL		= 1 << 3,
+};
+
+typedef struct {
+	guint16		 major;
+	guint16		 minor;
+	guint8		 flags;
+	guint8		 group_idx;
+	guint8		 n_files;
+	guint8		 n_depends;
+	guint32		 depends;	/* offset into priv->depends */
+	guint32		 required_by;	/* offset into priv->required_by */
+	guint32		 n_required_by;
+	guint32		 size;
+} PkScalePackage;
+
+typedef struct {
+	guint		 n_packages;
+	PkScalePackage	*packages;
+	guint32		*depends;
+	guint32		*required_by;
+} PkBackendScalePrivate;
+
+static PkBackendScalePrivate *priv;
+
+/* the groups packages are spread over, also used as the categories */
+static const PkGroupEnum pk_scale_groups[] = {
+	PK_GROUP_ENUM_ACCESSORIES,
+	PK_GROUP_ENUM_ADMIN_TOOLS,
+	PK_GROUP_ENUM_COMMUNICATION,
+	PK_GROUP_ENUM_DESKTOP_GNOME,
+	PK_GROUP_ENUM_DOCUMENTATION,
+	PK_GROUP_ENUM_FONTS,
+	PK_GROUP_ENUM_GAMES,
+	PK_GROUP_ENUM_GRAPHICS,
+	PK_GROUP_ENUM_INTERNET,
+	PK_GROUP_ENUM_MULTIMEDIA,
+	PK_GROUP_ENUM_NETWORK,
+	PK_GROUP_ENUM_OFFICE,
+	PK_GROUP_ENUM_PROGRAMMING,
+	PK_GROUP_ENUM_SYSTEM,
+};
+
+const gchar *
+pk_backend_get_description (PkBackend *backend)
+{
+	return "Test-Scale";
+}
+
+const gchar *
+pk_backend_get_author (PkBackend *backend)
+{
+	return "The PackageKit Authors";
+}
+
+gboolean
+pk_backend_supports_parallelization (PkBackend *backend)
+{
+	return TRUE;
+}
+
+void
+pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
+{
+	guint32 seed = 1;
+	guint n_depends = 0;
+	guint32 *fill;
+	g_autoptr(GRand) rand = NULL;
+	g_autoptr(GArray) depends = NULL;
+
+	priv = g_new0 (PkBackendScalePrivate, 1);
+	priv->n_packages = PK_SCALE_PACKAGES_DEFAULT;
+	if (g_key_file_has_key (conf, "TestScale", "Packages", NULL)) {
+		gint tmp = g_key_file_get_integer (conf, "TestScale", "Packages", NULL);
+		priv->n_packages = CLAMP (tmp, 1, PK_SCALE_PACKAGES_MAX);
+	}
+	if (g_key_file_has_key (conf, "TestScale", "Seed", NULL))
+		seed = g_key_file_get_integer (conf, "TestScale", "Seed", NULL);
+
+	/* generate the universe */
+	rand = g_rand_new_with_seed (seed);
+	priv->packages = g_new0 (PkScalePackage, priv->n_packages);
+	depends = g_array_new (FALSE, FALSE, sizeof (guint32));
+	for (guint i = 0; i < priv->n_packages; i++) {
+		PkScalePackage *pkg = &priv->packages[i];
+		pkg->major = g_rand_int_range (rand, 0, 20);
+		pkg->minor = g_rand_int_range (rand, 0, 100);
+		pkg->group_idx = g_rand_int_range (rand, 0, G_N_ELEMENTS (pk_scale_groups));
+		pkg->n_files = g_rand_int_range (rand, 1, PK_SCALE_MAX_FILES + 1);
+		pkg->size = g_rand_int_range (rand, 1024, 64 * 1024 * 1024);
+		if (g_rand_int_range (rand, 0, 3) == 0)
+			pkg->flags |= PK_SCALE_FLAG_INSTALLED;
+		if ((pkg->flags & PK_SCALE_FLAG_INSTALLED) > 0 &&
+		    g_rand_int_range (rand, 0, 10) == 0) {
+			pkg->flags |= PK_SCALE_FLAG_UPDATE;
+			if (g_rand_int_range (rand, 0, 5) == 0)
+				pkg->flags |= PK_SCALE_FLAG_SECURITY;
+		}
+		if (pk_scale_groups[pkg->group_idx] == PK_GROUP_ENUM_PROGRAMMING)
+			pkg->flags |= PK_SCALE_FLAG_DEVEL;
+
+		/* only depend on earlier packages */
+		pkg->depends = depends->len;
+		if (i > 0)
+			pkg->n_depends = g_rand_int_range (rand, 0, PK_SCALE_MAX_DEPENDS + 1);
+		for (guint j = 0; j < pkg->n_depends; j++) {
+			guint32 dep = g_rand_int_range (rand, 0, i);
+			g_array_append_val (depends, dep);
+			priv->packages[dep].n_required_by++;
+		}
+	}
+	n_depends = depends->len;
+	priv->depends = (guint32 *) g_array_free (g_steal_pointer (&depends), FALSE);
+
+	/* the reverse edges, laid out the same way */
+	priv->required_by = g_new (guint32, MAX (n_depends, 1));
+	fill = g_new0 (guint32, priv->n_packages);
+	for (guint i = 0, offset = 0; i < priv->n_packages; i++) {
+		priv->packages[i].required_by = offset;
+		offset += priv->packages[i].n_required_by;
+	}
+	for (guint i = 0; i < priv->n_packages; i++) {
+		PkScalePackage *pkg = &priv->packages[i];
+		for (guint j = 0; j < pkg->n_depends; j++) {
+			guint32 dep = priv->depends[pkg->depends + j];
+			priv->required_by[priv->packages[dep].required_by + fill[dep]++] = i;
+		}
+	}
+	g_free (fill);
+
+	g_debug ("generated %u packages and %u dependencies from seed %u",
+		 priv->n_packages, n_depends, seed);
+}
+
+void
+pk_backend_destroy (PkBackend *backend)
+{
+	g_free (priv->packages);
+	g_free (priv->depends);
+	g_free (priv->required_by);
+	g_free (priv);
+}
+
+PkBitfield
+pk_backend_get_groups (PkBackend *backend)
+{
+	PkBitfield groups = 0;
+	for (guint i = 0; i < G_N_ELEMENTS (pk_scale_groups); i++)
+		pk_bitfield_add (groups, pk_scale_groups[i]);
+	return groups;
+}
+
+PkBitfield
+pk_backend_get_filters (PkBackend *backend)
+{
+	return pk_bitfield_from_enums (PK_FILTER_ENUM_INSTALLED,
+				       PK_FILTER_ENUM_DEVELOPMENT,
+				       -1);
+}
+
+static void
+pk_scale_get_name (guint idx, gchar *buf, gsize len)
+{
+	g_snprintf (buf, len, "scale-%07u", idx);
+}
+
+static gchar *
+pk_scale_get_package_id (guint idx, gboolean update)
+{
+	const PkScalePackage *pkg = &priv->packages[idx];
+	gboolean installed = (pkg->flags & PK_SCALE_FLAG_INSTALLED) > 0 && !update;
+	return g_strdup_printf ("scale-%07u;%u.%u-1;x86_64;%s", idx,
+				pkg->major, pkg->minor + (update ? 1 : 0),
+				installed ? "installed" : "scale");
+}
+
+/* accepts a name, a package-id, or the name as part of a path */
+static gboolean
+pk_scale_parse (const gchar *str, guint *idx)
+{
+	guint tmp;
+	gchar end = '\0';
+
+	if (sscanf (str, "scale-%7u%c", &tmp, &end) < 1)
+		return FALSE;
+	if (end != '\0' && end != ';' && end != '/')
+		return FALSE;
+	if (tmp >= priv->n_packages)
+		return FALSE;
+	*idx = tmp;
+	return TRUE;
+}
+
+static gboolean
+pk_scale_filter_match (guint idx, PkBitfield filters)
+{
+	const PkScalePackage *pkg = &priv->packages[idx];
+	gboolean installed = (pkg->flags & PK_SCALE_FLAG_INSTALLED) > 0;
+	gboolean devel = (pkg->flags & PK_SCALE_FLAG_DEVEL) > 0;
+
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_INSTALLED) && !installed)
+		return FALSE;
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_INSTALLED) && installed)
+		return FALSE;
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_DEVELOPMENT) && !devel)
+		return FALSE;
+	if (pk_bitfield_contain (filters, PK_FILTER_ENUM_NOT_DEVELOPMENT) && devel)
+		return FALSE;
+	return TRUE;
+}
+
+static void
+pk_scale_emit_package (PkBackendJob *job, guint idx)
+{
+	const PkScalePackage *pkg = &priv->packages[idx];
+	g_autofree gchar *package_id = pk_scale_get_package_id (idx, FALSE);
+	g_autofree gchar *summary = g_strdup_printf ("Synthetic package %u", idx);
+	pk_backend_job_package (job,
+				(pkg->flags & PK_SCALE_FLAG_INSTALLED) > 0 ?
+					PK_INFO_ENUM_INSTALLED : PK_INFO_ENUM_AVAILABLE,
+				package_id, summary);
+}
+
+static gchar *
+pk_scale_get_file (guint idx, guint file_idx)
+{
+	if (file_idx == 0)
+		return g_strdup_printf ("/usr/bin/scale-%07u", idx);
+	return g_strdup_printf ("/usr/share/scale-%07u/file-%02u", idx, file_idx);
+}
+
+static void
+pk_scale_job_start (PkBackendJob *job)
+{
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	pk_backend_job_set_allow_cancel (job, TRUE);
+	pk_backend_job_set_percentage (job, 0);
+}
+
+/* updates the percentage at most a hundred times per query */
+static gboolean
+pk_scale_job_progress (PkBackendJob *job, guint i, guint len)
+{
+	if (len >= 100 && i % (len / 100) != 0)
+		return TRUE;
+	if (pk_backend_job_is_cancelled (job))
+		return FALSE;
+	pk_backend_job_set_percentage (job, (guint) ((guint64) i * 100 / len));
+	return TRUE;
+}
+
+static void
+pk_scale_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBitfield filters;
+
+	g_variant_get (params, "(t)", &filters);
+	pk_scale_job_start (job);
+	for (guint i = 0; i < priv->n_packages; i++) {
+		if (!pk_scale_job_progress (job, i, priv->n_packages))
+			return;
+		if (pk_scale_filter_match (i, filters))
+			pk_scale_emit_package (job, i);
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
+{
+	pk_backend_job_thread_create (job, pk_scale_get_packages_thread, NULL, NULL);
+}
+
+static void
+pk_scale_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	guint idx;
+	PkBitfield filters;
+	g_autofree gchar **search = NULL;
+
+	g_variant_get (params, "(t^a&s)", &filters, &search);
+	pk_scale_job_start (job);
+	for (guint i = 0; search[i] != NULL; i++) {
+		if (pk_scale_parse (search[i], &idx) && pk_scale_filter_match (idx, filters))
+			pk_scale_emit_package (job, idx);
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_resolve (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **packages)
+{
+	pk_backend_job_thread_create (job, pk_scale_resolve_thread, NULL, NULL);
+}
+
+typedef enum {
+	PK_SCALE_SEARCH_NAME,
+	PK_SCALE_SEARCH_DETAILS,
+	PK_SCALE_SEARCH_FILE,
+	PK_SCALE_SEARCH_GROUP,
+} PkScaleSearch;
+
+static gboolean
+pk_scale_search_match (guint idx, PkScaleSearch kind, const gchar *value)
+{
+	const PkScalePackage *pkg = &priv->packages[idx];
+	gchar name[32];
+
+	switch (kind) {
+	case PK_SCALE_SEARCH_NAME:
+		pk_scale_get_name (idx, name, sizeof (name));
+		return strstr (name, value) != NULL;
+	case PK_SCALE_SEARCH_DETAILS:
+		pk_scale_get_name (idx, name, sizeof (name));
+		if (strstr (name, value) != NULL)
+			return TRUE;
+		return g_strcmp0 (value, pk_group_enum_to_string (pk_scale_groups[pkg->group_idx])) == 0;
+	case PK_SCALE_SEARCH_FILE:
+		for (guint i = 0; i < pkg->n_files; i++) {
+			g_autofree gchar *file = pk_scale_get_file (idx, i);
+			if (g_strcmp0 (file, value) == 0 ||
+			    (value[0] != '/' && g_str_has_suffix (file, value)))
+				return TRUE;
+		}
+		return FALSE;
+	case PK_SCALE_SEARCH_GROUP:
+		if (g_str_has_prefix (value, "@"))
+			value++;
+		return g_strcmp0 (value, pk_group_enum_to_string (pk_scale_groups[pkg->group_idx])) == 0;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+static void
+pk_scale_search_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkScaleSearch kind = GPOINTER_TO_UINT (user_data);
+	PkBitfield filters;
+	guint idx;
+	g_autofree gchar **values = NULL;
+
+	g_variant_get (params, "(t^a&s)", &filters, &values);
+	pk_scale_job_start (job);
+
+	/* a full path is owned by the package named in it, no need to scan */
+	if (kind == PK_SCALE_SEARCH_FILE) {
+		gboolean need_scan = FALSE;
+		for (guint j = 0; values[j] != NULL; j++) {
+			const gchar *tmp = strstr (values[j], "scale-");
+			if (values[j][0] != '/') {
+				need_scan = TRUE;
+				continue;
+			}
+			if (tmp != NULL &&
+			    pk_scale_parse (tmp, &idx) &&
+			    pk_scale_search_match (idx, kind, values[j]) &&
+			    pk_scale_filter_match (idx, filters))
+				pk_scale_emit_package (job, idx);
+		}
+		if (!need_scan) {
+			pk_backend_job_set_percentage (job, 100);
+			return;
+		}
+	}
+
+	for (guint i = 0; i < priv->n_packages; i++) {
+		if (!pk_scale_job_progress (job, i, priv->n_packages))
+			return;
+		if (!pk_scale_filter_match (i, filters))
+			continue;
+		for (guint j = 0; values[j] != NULL; j++) {
+			if (kind == PK_SCALE_SEARCH_FILE && values[j][0] == '/')
+				continue;
+			if (pk_scale_search_match (i, kind, values[j])) {
+				pk_scale_emit_package (job, i);
+				break;
+			}
+		}
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_search_names (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
+{
+	pk_backend_job_thread_create (job, pk_scale_search_thread,
+				      GUINT_TO_POINTER (PK_SCALE_SEARCH_NAME), NULL);
+}
+
+void
+pk_backend_search_details (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
+{
+	pk_backend_job_thread_create (job, pk_scale_search_thread,
+				      GUINT_TO_POINTER (PK_SCALE_SEARCH_DETAILS), NULL);
+}
+
+void
+pk_backend_search_files (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
+{
+	pk_backend_job_thread_create (job, pk_scale_search_thread,
+				      GUINT_TO_POINTER (PK_SCALE_SEARCH_FILE), NULL);
+}
+
+void
+pk_backend_search_groups (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **values)
+{
+	pk_backend_job_thread_create (job, pk_scale_search_thread,
+				      GUINT_TO_POINTER (PK_SCALE_SEARCH_GROUP), NULL);
+}
+
+static void
+pk_scale_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	guint idx;
+	g_autofree gchar **package_ids = NULL;
+
+	g_variant_get (params, "(^a&s)", &package_ids);
+	pk_scale_job_start (job);
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		const PkScalePackage *pkg;
+		g_autofree gchar *package_id = NULL;
+		g_autofree gchar *summary = NULL;
+		g_autofree gchar *description = NULL;
+
+		if (!pk_scale_parse (package_ids[i], &idx))
+			continue;
+		pkg = &priv->packages[idx];
+		package_id = pk_scale_get_package_id (idx, FALSE);
+		summary = g_strdup_printf ("Synthetic package %u", idx);
+		description = g_strdup_printf ("Package %u of %u in the generated universe, "
+					       "with %u dependencies and %u packages "
+					       "requiring it.",
+					       idx, priv->n_packages,
+					       pkg->n_depends, pkg->n_required_by);
+		pk_backend_job_details (job, package_id, summary, "GPL-2.0+",
+					pk_scale_groups[pkg->group_idx],
+					description, PK_SCALE_URL, pkg->size);
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_get_details (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
+{
+	pk_backend_job_thread_create (job, pk_scale_get_details_thread, NULL, NULL);
+}
+
+static void
+pk_scale_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	guint idx;
+	g_autofree gchar **package_ids = NULL;
+
+	g_variant_get (params, "(^a&s)", &package_ids);
+	pk_scale_job_start (job);
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		const PkScalePackage *pkg;
+		g_autofree gchar *package_id = NULL;
+		g_auto(GStrv) files = NULL;
+
+		if (!pk_scale_parse (package_ids[i], &idx))
+			continue;
+		pkg = &priv->packages[idx];
+		files = g_new0 (gchar *, pkg->n_files + 1);
+		for (guint j = 0; j < pkg->n_files; j++)
+			files[j] = pk_scale_get_file (idx, j);
+		package_id = pk_scale_get_package_id (idx, FALSE);
+		pk_backend_job_files (job, package_id, files);
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_get_files (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
+{
+	pk_backend_job_thread_create (job, pk_scale_get_files_thread, NULL, NULL);
+}
+
+/* walks the graph breadth first, emitting each package once */
+static void
+pk_scale_depends_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	gboolean required_by = GPOINTER_TO_UINT (user_data);
+	gboolean recursive;
+	guint idx;
+	PkBitfield filters;
+	g_autofree gchar **package_ids = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+	g_autoptr(GQueue) queue = NULL;
+
+	g_variant_get (params, "(t^a&sb)", &filters, &package_ids, &recursive);
+	pk_scale_job_start (job);
+
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	queue = g_queue_new ();
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		if (!pk_scale_parse (package_ids[i], &idx))
+			continue;
+		g_hash_table_add (seen, GUINT_TO_POINTER (idx));
+		g_queue_push_tail (queue, GUINT_TO_POINTER (idx));
+	}
+	while (!g_queue_is_empty (queue)) {
+		const PkScalePackage *pkg;
+		const guint32 *edges;
+		guint n_edges;
+
+		if (pk_backend_job_is_cancelled (job))
+			return;
+		pkg = &priv->packages[GPOINTER_TO_UINT (g_queue_pop_head (queue))];
+		if (required_by) {
+			edges = priv->required_by + pkg->required_by;
+			n_edges = pkg->n_required_by;
+		} else {
+			edges = priv->depends + pkg->depends;
+			n_edges = pkg->n_depends;
+		}
+		for (guint i = 0; i < n_edges; i++) {
+			if (!g_hash_table_add (seen, GUINT_TO_POINTER (edges[i])))
+				continue;
+			if (pk_scale_filter_match (edges[i], filters))
+				pk_scale_emit_package (job, edges[i]);
+			if (recursive)
+				g_queue_push_tail (queue, GUINT_TO_POINTER (edges[i]));
+		}
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_depends_on (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **package_ids, gboolean recursive)
+{
+	pk_backend_job_thread_create (job, pk_scale_depends_thread, GUINT_TO_POINTER (FALSE), NULL);
+}
+
+void
+pk_backend_required_by (PkBackend *backend, PkBackendJob *job, PkBitfield filters, gchar **package_ids, gboolean recursive)
+{
+	pk_backend_job_thread_create (job, pk_scale_depends_thread, GUINT_TO_POINTER (TRUE), NULL);
+}
+
+static void
+pk_scale_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	PkBitfield filters;
+
+	g_variant_get (params, "(t)", &filters);
+	pk_scale_job_start (job);
+	for (guint i = 0; i < priv->n_packages; i++) {
+		const PkScalePackage *pkg = &priv->packages[i];
+		g_autofree gchar *package_id = NULL;
+		g_autofree gchar *summary = NULL;
+
+		if (!pk_scale_job_progress (job, i, priv->n_packages))
+			return;
+		if ((pkg->flags & PK_SCALE_FLAG_UPDATE) == 0)
+			continue;
+		package_id = pk_scale_get_package_id (i, TRUE);
+		summary = g_strdup_printf ("Synthetic package %u", i);
+		pk_backend_job_package (job,
+					(pkg->flags & PK_SCALE_FLAG_SECURITY) > 0 ?
+						PK_INFO_ENUM_SECURITY : PK_INFO_ENUM_NORMAL,
+					package_id, summary);
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_get_updates (PkBackend *backend, PkBackendJob *job, PkBitfield filters)
+{
+	pk_backend_job_thread_create (job, pk_scale_get_updates_thread, NULL, NULL);
+}
+
+static void
+pk_scale_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
+{
+	guint idx;
+	g_autofree gchar **package_ids = NULL;
+
+	g_variant_get (params, "(^a&s)", &package_ids);
+	pk_scale_job_start (job);
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		const PkScalePackage *pkg;
+		gboolean security;
+		g_autofree gchar *package_id = NULL;
+		g_autofree gchar *update_text = NULL;
+		g_auto(GStrv) updates = NULL;
+		g_auto(GStrv) bugzilla_urls = NULL;
+		g_auto(GStrv) cve_urls = NULL;
+
+		if (!pk_scale_parse (package_ids[i], &idx))
+			continue;
+		pkg = &priv->packages[idx];
+		if ((pkg->flags & PK_SCALE_FLAG_UPDATE) == 0)
+			continue;
+		security = (pkg->flags & PK_SCALE_FLAG_SECURITY) > 0;
+		package_id = pk_scale_get_package_id (idx, TRUE);
+		updates = g_new0 (gchar *, 2);
+		updates[0] = pk_scale_get_package_id (idx, FALSE);
+		bugzilla_urls = g_new0 (gchar *, 2);
+		bugzilla_urls[0] = g_strdup_printf (PK_SCALE_URL "/bug/%u", idx);
+		if (security) {
+			cve_urls = g_new0 (gchar *, 2);
+			cve_urls[0] = g_strdup_printf (PK_SCALE_URL "/cve/%u", idx);
+		}
+		update_text = g_strdup_printf ("Update %u.%u-1 of synthetic package %u.",
+					       pkg->major, pkg->minor + 1, idx);
+		pk_backend_job_update_detail (job, package_id, updates, NULL, NULL,
+					      bugzilla_urls, cve_urls,
+					      security ? PK_RESTART_ENUM_SESSION : PK_RESTART_ENUM_NONE,
+					      update_text, NULL,
+					      PK_UPDATE_STATE_ENUM_STABLE,
+					      "2026-01-01T00:00:00Z", NULL);
+	}
+	pk_backend_job_set_percentage (job, 100);
+}
+
+void
+pk_backend_get_update_detail (PkBackend *backend, PkBackendJob *job, gchar **package_ids)
+{
+	pk_backend_job_thread_create (job, pk_scale_get_update_detail_thread, NULL, NULL);
+}
+
+void
+pk_backend_get_categories (PkBackend *backend, PkBackendJob *job)
+{
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
+	for (guint i = 0; i < G_N_ELEMENTS (pk_scale_groups); i++) {
+		const gchar *group = pk_group_enum_to_string (pk_scale_groups[i]);
+		g_autofree gchar *cat_id = g_strdup_printf ("@%s", group);
+		pk_backend_job_category (job, NULL, cat_id, group,
+					 "Synthetic packages in this group",
+					 "applications-other");
+	}
+	pk_backend_job_finished (job);
+}
@@ -24,6 +24,7 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <iterator>
 #include <list>
 #include <map>
@@ -35,6 +36,7 @@
 #include <string>
 #include <sys/vfs.h>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
 #include <glib.h>
@@ -74,6 +76,7 @@
 #include <zypp/base/Functional.h>
 #include <zypp/base/LogControl.h>
 #include <zypp/base/Logger.h>
+#include <zypp/base/SerialNumber.h>
 #include <zypp/base/String.h>
 #include <zypp/parser/IniDict.h>
 #include <zypp/parser/ParseException.h>
@@ -159,6 +162,9 @@ guint _dl_count = 0;
 guint _dl_progress = 0;
 guint _dl_status = 0;
 
+/* bumped whenever the shared resolver runs, see ZyppPlan */
+guint _solver_runs = 0;
+
 /**
  * Build a package_id from the specified resolvable.  The returned
  * gchar * should be freed with g_free ().
@@ -371,42 +377,121 @@ struct RepoReportReceiver : public zypp::callback::ReceiveReport<zypp::repo::Rep
 
 struct DownloadProgressReportReceiver : public zypp::callback::ReceiveReport<zypp::repo::DownloadResolvableReport>, ZyppBackendReceiver
 {
+	// the packages being downloaded, several at once when libzypp
+	// fetches them in parallel
+	struct Download {
+		gchar *package_id;
+		guint percentage;
+	};
+	std::map<zypp::sat::detail::SolvableIdType, Download> _downloads;
+
+	void forget_downloads ()
+	{
+		for (auto &it : _downloads)
+			g_free (it.second.package_id);
+		_downloads.clear ();
+	}
+
+	// the finished packages and the parts of the others
+	void update_percentage ()
+	{
+		guint partial = 0;
+
+		if (_dl_count == 0)
+			return;
+		for (auto &it : _downloads)
+			partial += it.second.percentage;
+		pk_backend_job_set_percentage (_job, MIN ((100 * _dl_progress + partial) / _dl_count, 100));
+	}
+
 	virtual void start (zypp::Resolvable::constPtr resolvable, const zypp::Url &file)
 	{
 		MIL << resolvable << " " << file << std::endl;
-		clear_package_id ();
 		/* This is the first package we see coming as INSTALLING - resetting counter and modus */
 		if (_dl_status != PK_INFO_ENUM_DOWNLOADING) {
 			_dl_progress = 0;
 			_dl_status = PK_INFO_ENUM_DOWNLOADING;
+			forget_downloads ();
 		}
-		_package_id = zypp_build_package_id_from_resolvable (resolvable->satSolvable ());
-		gchar* summary = g_strdup(zypp::asKind<zypp::ResObject>(resolvable)->summary().c_str ());
 
-		fprintf (stderr, "DownloadProgressReportReceiver::start():%s --%s\n",
-			 g_strdup (file.asString().c_str()),	_package_id);
-		if (_package_id != NULL) {
-			pk_backend_job_set_status (_job, PK_STATUS_ENUM_DOWNLOAD); 
-			pk_backend_job_package (_job, PK_INFO_ENUM_DOWNLOADING, _package_id, summary);
-			reset_sub_percentage ();
-		}
-		g_free(summary);
+		gchar *package_id = zypp_build_package_id_from_resolvable (resolvable->satSolvable ());
+		if (package_id == NULL)
+			return;
+
+		const string &summary = zypp::asKind<zypp::ResObject>(resolvable)->summary ();
+		pk_backend_job_set_status (_job, PK_STATUS_ENUM_DOWNLOAD);
+		pk_backend_job_package (_job, PK_INFO_ENUM_DOWNLOADING, package_id, summary.c_str ());
+
+		Download &download = _downloads[resolvable->satSolvable ().id ()];
+		g_free (download.package_id);
+		download.package_id = package_id;
+		download.percentage = 0;
 	}
 
 	virtual bool progress (int value, zypp::Resolvable::constPtr resolvable)
 	{
-		//MIL << resolvable << " " << value << " " << _package_id << std::endl;
-		update_sub_percentage (value, PK_STATUS_ENUM_DOWNLOAD);
-		//pk_backend_job_set_speed (_job, static_cast<guint>(dbps_current));
+		auto it = _downloads.find (resolvable->satSolvable ().id ());
+		if (it == _downloads.end () || value < 0 || value > 100 ||
+		    (guint) value == it->second.percentage)
+			return true;
+
+		it->second.percentage = value;
+		pk_backend_job_set_item_progress (_job, it->second.package_id, PK_STATUS_ENUM_DOWNLOAD, value);
+		update_percentage ();
 		return true;
 	}
 
 	virtual void finish (zypp::Resolvable::constPtr resolvable, Error error, const std::string &konreason)
 	{
-		MIL << resolvable << " " << error << " " << _package_id << std::endl;
-		update_sub_percentage (100, PK_STATUS_ENUM_DOWNLOAD);
-		pk_backend_job_set_percentage(_job, (double)++_dl_progress / _dl_count * 100);
-		clear_package_id ();
+		MIL << resolvable << " " << error << std::endl;
+		auto it = _downloads.find (resolvable->satSolvable ().id ());
+		if (it != _downloads.end ()) {
+			pk_backend_job_set_item_progress (_job, it->second.package_id, PK_STATUS_ENUM_DOWNLOAD, 100);
+			g_free (it->second.package_id);
+			_downloads.erase (it);
+		}
+		_dl_progress++;
+		update_percentage ();
+	}
+};
+
+struct MediaDownloadReportReceiver : public zypp::callback::ReceiveReport<zypp::media::DownloadProgressReport>, ZyppBackendReceiver
+{
+	// the current rate of each file being fetched, the job speed is the
+	// sum of them while downloads run in parallel
+	std::map<std::string, double> _rates;
+	guint _speed = 0;
+
+	void update_speed ()
+	{
+		double total = 0;
+
+		for (auto &it : _rates)
+			total += it.second;
+		if (_job == NULL || (guint) total == _speed)
+			return;
+		_speed = (guint) total;
+		pk_backend_job_set_speed (_job, _speed);
+	}
+
+	virtual void start (const zypp::Url &file, zypp::Pathname localfile)
+	{
+		_rates[file.asString ()] = 0;
+	}
+
+	virtual bool progress (int value, const zypp::Url &file, double dbps_avg, double dbps_current)
+	{
+		if (dbps_current >= 0) {
+			_rates[file.asString ()] = dbps_current;
+			update_speed ();
+		}
+		return true;
+	}
+
+	virtual void finish (const zypp::Url &file, Error error, const std::string &reason)
+	{
+		_rates.erase (file.asString ());
+		update_speed ();
 	}
 };
 
@@ -500,6 +585,7 @@ class EventDirector
 		ZyppBackend::InstallResolvableReportReceiver _installResolvableReport;
 		ZyppBackend::RemoveResolvableReportReceiver _removeResolvableReport;
 		ZyppBackend::DownloadProgressReportReceiver _downloadProgressReport;
+		ZyppBackend::MediaDownloadReportReceiver _mediaDownloadReport;
                 ZyppBackend::KeyRingReportReceiver _keyRingReport;
 		ZyppBackend::DigestReportReceiver _digestReport;
                 ZyppBackend::MediaChangeReportReceiver _mediaChangeReport;
@@ -513,6 +599,7 @@ class EventDirector
 			_installResolvableReport.connect ();
 			_removeResolvableReport.connect ();
 			_downloadProgressReport.connect ();
+			_mediaDownloadReport.connect ();
                         _keyRingReport.connect ();
 			_digestReport.connect ();
                         _mediaChangeReport.connect ();
@@ -526,6 +613,7 @@ class EventDirector
 			_installResolvableReport._job = job;
 			_removeResolvableReport._job = job;
 			_downloadProgressReport._job = job;
+			_mediaDownloadReport._job = job;
                         _keyRingReport._job = job;
 			_digestReport._job = job;
                         _mediaChangeReport._job = job;
@@ -539,6 +627,7 @@ class EventDirector
 			_installResolvableReport.disconnect ();
 			_removeResolvableReport.disconnect ();
 			_downloadProgressReport.disconnect ();
+			_mediaDownloadReport.disconnect ();
                         _keyRingReport.disconnect ();
 			_digestReport.disconnect ();
                         _mediaChangeReport.disconnect ();
@@ -553,17 +642,88 @@ class PkBackendZYppPrivate {
 	PkBackendJob *currentJob;
 	
 	pthread_mutex_t zypp_mutex;
+
+	// the root the target is initialized for, empty if there is none
+	std::string target_root;
+	// the root from the DestDir setting, used unless ZYpp.conf has one
+	std::string default_root;
+	// the target is let go after being idle for this many seconds
+	guint target_idle_timeout;
+	guint target_idle_id;
+	// zypper ar and the like change the repos behind our back
+	GFileMonitor *repos_monitor;
 };
 
 }; // namespace ZyppBackend
 
 using namespace ZyppBackend;
 
+static void zypp_forget_pool (ZYpp::Ptr zypp);
+
+/**
+ * Returns the root the jobs should work on, the one of the current job if
+ * it has one, else the one that can be changed in ZYpp.conf without
+ * restarting the daemon
+ */
+static string
+zypp_get_target_root ()
+{
+	if (priv->currentJob != NULL && pk_backend_job_get_root (priv->currentJob) != NULL)
+		return pk_backend_job_get_root (priv->currentJob);
+
+	string root = priv->default_root;
+	if (PathInfo("/etc/PackageKit/ZYpp.conf").isExist()) {
+		parser::IniDict vendorConf(InputStream("/etc/PackageKit/ZYpp.conf"));
+		if (vendorConf.hasSection("Target")) {
+			for (parser::IniDict::entry_const_iterator eit = vendorConf.entriesBegin("Target");
+			     eit != vendorConf.entriesEnd("Target");
+			     ++eit) {
+				if ((*eit).first == "Root" && !(*eit).second.empty())
+					root = (*eit).second;
+			}
+		}
+	}
+	return root;
+}
+
+/**
+ * Lets go of the target and everything loaded from it once no job used
+ * it for a while, the next job initializes it again
+ */
+static gboolean
+zypp_target_idle_cb (gpointer user_data)
+{
+	priv->target_idle_id = 0;
+
+	// a job just started and keeps it
+	if (pthread_mutex_trylock(&priv->zypp_mutex) != 0)
+		return G_SOURCE_REMOVE;
+
+	if (!priv->target_root.empty ()) {
+		try {
+			ZYpp::Ptr zypp = ZYppFactory::instance ().getZYpp ();
+			MIL << "target " << priv->target_root << " idle, releasing it" << endl;
+			zypp_forget_pool (zypp);
+			zypp->finishTarget ();
+		} catch (const Exception &ex) {
+			MIL << "failed to release the target: " << ex.asUserString () << endl;
+		}
+		priv->target_root.clear ();
+	}
+	pthread_mutex_unlock(&priv->zypp_mutex);
+	return G_SOURCE_REMOVE;
+}
+
 ZyppJob::ZyppJob(PkBackendJob *job)
 {
 	MIL << "locking zypp" << std::endl;
 	pthread_mutex_lock(&priv->zypp_mutex);
 
+	if (priv->target_idle_id != 0) {
+		g_source_remove (priv->target_idle_id);
+		priv->target_idle_id = 0;
+	}
+
 	if (priv->currentJob) {
 		MIL << "currentjob is already defined - highly impossible" << endl;
 	}
@@ -579,6 +739,11 @@ ZyppJob::~ZyppJob()
 		pk_backend_job_set_locked(priv->currentJob, false);
 	priv->currentJob = 0;
 	priv->eventDirector.setJob(0);
+
+	if (priv->target_idle_timeout > 0 && !priv->target_root.empty ())
+		priv->target_idle_id = g_timeout_add_seconds (priv->target_idle_timeout,
+							      zypp_target_idle_cb, NULL);
+
 	MIL << "unlocking zypp" << std::endl;
 	pthread_mutex_unlock(&priv->zypp_mutex);
 }
@@ -589,19 +754,24 @@ ZyppJob::~ZyppJob()
 ZYpp::Ptr
 ZyppJob::get_zypp()
 {
-	static gboolean initialized = FALSE;
 	ZYpp::Ptr zypp = NULL;
 
 	try {
 		zypp = ZYppFactory::instance ().getZYpp ();
 
-		/* TODO: we need to lifecycle manage this, detect changes
-		   in the requested 'root' etc. */
-		if (!initialized) {
-			filesystem::Pathname pathname("/");
+		/* libzypp has one ZYpp and one pool per process, so a job
+		   for another root replaces the target of the previous one */
+		string root = zypp_get_target_root ();
+		if (root != priv->target_root) {
+			if (!priv->target_root.empty ()) {
+				MIL << "switching the target from " << priv->target_root << " to " << root << endl;
+				zypp_forget_pool (zypp);
+				zypp->finishTarget ();
+			}
+			priv->target_root.clear ();
+			filesystem::Pathname pathname(root);
 			zypp->initializeTarget (pathname);
-
-			initialized = TRUE;
+			priv->target_root = root;
 		}
 	} catch (const ZYppFactoryException &ex) {
 		pk_backend_job_error_code (priv->currentJob, PK_ERROR_ENUM_FAILED_INITIALIZATION, "%s", ex.asUserString().c_str() );
@@ -692,32 +862,39 @@ zypp_is_valid_repo (PkBackendJob *job, RepoInfo repo)
 	return TRUE;
 }
 
+/**
+ * Loads the installed packages into the pool, unless they are there
+ * already and the rpmdb did not change since.
+ */
+static void
+zypp_load_target (Target_Ptr target)
+{
+	static Date system_stamp;
+
+	Date stamp = target->rpmDb ().timestamp ();
+	if (stamp != system_stamp ||
+	    sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ()) {
+		// Add local resolvables
+		MIL << "rpmdb changed, loading the installed packages" << endl;
+		target->load ();
+		system_stamp = stamp;
+	}
+}
+
 /**
  * Build and return a ResPool that contains all local resolvables
  * and ones found in the enabled repositories.
+ *
+ * The installed packages stay in the pool, the queries filter them out
+ * when needed, and they are only read again when the rpmdb changed.
  */
+/* whether the enabled repositories were loaded into the pool */
+static gboolean repos_loaded = FALSE;
+
 ResPool
-zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
+zypp_build_pool (ZYpp::Ptr zypp)
 {
-	static gboolean repos_loaded = FALSE;
-
-	// the target is loaded or unloaded on request
-	if (include_local) {
-		// FIXME have to wait for fix in zypp (repeated loading of target)
-		if (sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Add local resolvables
-			Target_Ptr target = zypp->target ();
-			target->load ();
-		}
-	} else {
-		if (!sat::Pool::instance().reposFind( sat::Pool::systemRepoAlias() ).solvablesEmpty ())
-		{
-			// Remove local resolvables
-			Repository repository = sat::Pool::instance ().reposFind (sat::Pool::systemRepoAlias());
-			repository.eraseFromPool ();
-		}
-	}
+	zypp_load_target (zypp->target ());
 
 	// we only load repositories once.
 	if (repos_loaded)
@@ -754,20 +931,33 @@ zypp_build_pool (ZYpp::Ptr zypp, gboolean include_local)
 	return zypp->pool ();
 }
 
+static string
+zypp_rpmHeader_key (const string &name, const Edition &edition)
+{
+	return name + ";" + edition.asString ();
+}
+
 /**
-  * Return the rpmHeader of a package
+  * Return the rpmHeaders of the @wanted packages, keyed by name and
+  * edition, read in a single pass over the rpmdb
   */
-target::rpm::RpmHeader::constPtr
-zypp_get_rpmHeader (const string &name, Edition edition)
+static void
+zypp_get_rpmHeaders (const set<string> &wanted,
+		     map<string, target::rpm::RpmHeader::constPtr> &headers)
 {
 	target::rpm::librpmDb::db_const_iterator it;
-	target::rpm::RpmHeader::constPtr result = new target::rpm::RpmHeader ();
 
-	for (it.findPackage (name, edition); *it; ++it) {
-		result = *it;
-	}
+	if (wanted.empty ())
+		return;
 
-	return result;
+	for (it.findAll (); *it; ++it) {
+		string key = zypp_rpmHeader_key ((*it)->tag_name (), (*it)->tag_edition ());
+		if (wanted.count (key) == 0)
+			continue;
+
+		// the last one wins, as with findPackage
+		headers[key] = *it;
+	}
 }
 
 /**
@@ -847,38 +1037,6 @@ zypp_get_packages_by_name (const gchar *package_name,
 	}
 }
 
-/**
- * Returns a list of packages that owns the specified file.
- */
-void
-zypp_get_packages_by_file (ZYpp::Ptr zypp,
-			   const gchar *search_file,
-			   vector<sat::Solvable> &ret)
-{
-	ResPool pool = zypp_build_pool (zypp, TRUE);
-
-	string file (search_file);
-
-	target::rpm::librpmDb::db_const_iterator it;
-	target::rpm::RpmHeader::constPtr result = new target::rpm::RpmHeader ();
-
-	for (it.findByFile (search_file); *it; ++it) {
-		for (ResPool::byName_iterator it2 = pool.byNameBegin (it->tag_name ()); it2 != pool.byNameEnd (it->tag_name ()); it2++) {
-			if ((*it2)->isSystem ())
-				ret.push_back ((*it2)->satSolvable ());
-		}
-	}
-
-	if (ret.empty ()) {
-		Capability cap (search_file);
-		sat::WhatProvides prov (cap);
-
-		for(sat::WhatProvides::const_iterator it = prov.begin (); it != prov.end (); ++it) {
-			ret.push_back (*it);
-		}
-	}
-}
-
 /**
  * Return the package is from a local file or not.
  */
@@ -899,73 +1057,334 @@ zypp_package_is_local (const gchar *package_id)
 	return ret;
 }
 
+/**
+ * Builds the key of a solvable in the package id index, which is the
+ * package id with "installed" as the data of every installed package.
+ */
+static string
+zypp_package_id_key (const string &name, const string &version, const string &arch, const string &data)
+{
+	string key;
+	key.reserve (name.size () + version.size () + arch.size () + data.size () + 3);
+	key.append (name);
+	key.append (";");
+	key.append (version);
+	key.append (";");
+	key.append (arch);
+	key.append (";");
+	key.append (data);
+	return key;
+}
+
 /**
  * Returns the Resolvable for the specified package_id.
  * e.g. gnome-packagekit;3.6.1-132.1;x86_64;G:F
+ *
+ * The solvables are looked up in an index of the whole pool that is
+ * built again whenever repositories are added to or removed from it.
 */
 sat::Solvable
 zypp_get_package_by_id (const gchar *package_id)
 {
+	static unordered_map<string, sat::Solvable> index;
+	static SerialNumberWatcher index_serial;
+
 	MIL << package_id << endl;
 	if (!pk_package_id_check(package_id)) {
 		// TODO: Do we need to do something more for this error?
 		return sat::Solvable::noSolvable;
 	}
 
+	ResPool pool = ResPool::instance();
+	if (index_serial.remember (pool.serial ())) {
+		index.clear ();
+		for (ResPool::const_iterator it = pool.begin (); it != pool.end (); ++it) {
+			sat::Solvable pkg = it->satSolvable();
+			string key = zypp_package_id_key (pkg.name (),
+							  pkg.edition ().asString (),
+							  isKind<SrcPackage>(pkg) ? "source" : pkg.arch ().asString (),
+							  pkg.isSystem () ? "installed" : pkg.repository ().alias ());
+			// the first one wins, as when searching by name
+			index.emplace (key, pkg);
+		}
+		MIL << "indexed " << index.size () << " package ids" << endl;
+	}
+
 	gchar **id_parts = pk_package_id_split(package_id);
 	const gchar *arch = id_parts[PK_PACKAGE_ID_ARCH];
 	if (!arch)
 		arch = "noarch";
-	bool want_source = !g_strcmp0 (arch, "source");
-	
+	const gchar *data = id_parts[PK_PACKAGE_ID_DATA];
+	if (!strncmp(data, "installed", 9))
+		data = "installed";
+
 	sat::Solvable package;
+	auto it = index.find (zypp_package_id_key (id_parts[PK_PACKAGE_ID_NAME],
+						   id_parts[PK_PACKAGE_ID_VERSION],
+						   arch, data));
+	if (it != index.end ()) {
+		MIL << "found " << it->second << endl;
+		package = it->second;
+	}
 
-	ResPool pool = ResPool::instance();
+	g_strfreev (id_parts);
+	return package;
+}
 
-	// Iterate over the resolvables and mark the one we want to check its dependencies
-	for (ResPool::byName_iterator it = pool.byNameBegin (id_parts[PK_PACKAGE_ID_NAME]);
-	     it != pool.byNameEnd (id_parts[PK_PACKAGE_ID_NAME]); ++it) {
-		
-		sat::Solvable pkg = it->satSolvable();
-		//MIL << "match " << package_id << " " << pkg << endl;
+/**
+ * The files of the installed packages as read from the rpmdb, split in
+ * a dictionary of directories and basenames so they can be looked up by
+ * path or by basename without querying the rpmdb for each one.
+ */
+class ZyppFileIndex
+{
+public:
+	/**
+	 * Reads the headers that were added since the last update, and
+	 * forgets the removed ones, if the rpmdb changed
+	 */
+	void update (const Date &stamp)
+	{
+		if (!_packages.empty () && stamp == _stamp)
+			return;
 
-		if (want_source && !isKind<SrcPackage>(pkg)) {
-			//MIL << "not a src package\n";
-			continue;
+		set<unsigned> seen;
+		target::rpm::librpmDb::db_const_iterator it;
+		for (it.findAll (); *it; ++it) {
+			unsigned hdr = it.dbHdrNum ();
+			string key = (*it)->tag_name () + ";" + (*it)->tag_edition ().asString () + ";" +
+				(*it)->tag_arch ().asString ();
+			seen.insert (hdr);
+
+			auto pkg = _packages.find (hdr);
+			if (pkg != _packages.end ()) {
+				if (pkg->second.key == key)
+					continue;
+				remove (hdr);
+			}
+
+			Package &added = _packages[hdr];
+			added.key = key;
+			list<string> files = (*it)->tag_filenames ();
+			for (const string &file : files) {
+				string::size_type slash = file.rfind ('/');
+				string dir = slash == string::npos ? string () : file.substr (0, slash + 1);
+				auto d = _dir_ids.emplace (dir, _dirs.size ());
+				if (d.second)
+					_dirs.push_back (dir);
+
+				string base = file.substr (slash == string::npos ? 0 : slash + 1);
+				added.files.push_back (make_pair (d.first->second, base));
+				_by_base[base].push_back (make_pair (hdr, d.first->second));
+			}
+			_by_key[key] = hdr;
 		}
 
-		if (!want_source && (isKind<SrcPackage>(pkg) || g_strcmp0 (pkg.arch().c_str(), arch))) {
-			//MIL << "not a matching arch\n";
-			continue;
+		vector<unsigned> removed;
+		for (const auto &pkg : _packages) {
+			if (seen.count (pkg.first) == 0)
+				removed.push_back (pkg.first);
 		}
+		for (unsigned hdr : removed)
+			remove (hdr);
 
-		const string &ver = pkg.edition ().asString();
-		if (g_strcmp0 (ver.c_str (), id_parts[PK_PACKAGE_ID_VERSION])) {
-			//MIL << "not a matching version\n";
-			continue;
+		MIL << "indexed the files of " << _packages.size () << " installed packages" << endl;
+		_stamp = stamp;
+	}
+
+	/**
+	 * Returns the files of the installed package, false if it's unknown
+	 */
+	bool files (const string &name, const string &edition, const string &arch, vector<string> &files) const
+	{
+		auto hdr = _by_key.find (name + ";" + edition + ";" + arch);
+		if (hdr == _by_key.end ())
+			return false;
+
+		for (const auto &file : _packages.at (hdr->second).files)
+			files.push_back (_dirs[file.first] + file.second);
+		return true;
+	}
+
+	/**
+	 * Adds the "name;edition;arch" of the installed packages owning
+	 * @search to @owners, which is a path or else a basename
+	 */
+	void owners (const string &search, set<string> &owners) const
+	{
+		string::size_type slash = search.rfind ('/');
+		auto base = _by_base.find (search.substr (slash == string::npos ? 0 : slash + 1));
+		if (base == _by_base.end ())
+			return;
+
+		guint dir = G_MAXUINT;
+		if (slash != string::npos) {
+			auto d = _dir_ids.find (search.substr (0, slash + 1));
+			if (d == _dir_ids.end ())
+				return;
+			dir = d->second;
 		}
 
-		if (!pkg.isSystem()) {
-			if (!strncmp(id_parts[PK_PACKAGE_ID_DATA], "installed", 9)) {
-				//MIL << "pkg is not installed\n";
-				continue;
+		for (const auto &owner : base->second) {
+			if (dir == G_MAXUINT || owner.second == dir)
+				owners.insert (_packages.at (owner.first).key);
+		}
+	}
+
+private:
+	struct Package {
+		string key;
+		vector<pair<guint, string> > files;
+	};
+
+	void remove (unsigned hdr)
+	{
+		auto pkg = _packages.find (hdr);
+		for (const auto &file : pkg->second.files) {
+			vector<pair<unsigned, guint> > &owners = _by_base[file.second];
+			owners.erase (std::remove (owners.begin (), owners.end (), make_pair (hdr, file.first)),
+				      owners.end ());
+			if (owners.empty ())
+				_by_base.erase (file.second);
+		}
+		auto key = _by_key.find (pkg->second.key);
+		if (key != _by_key.end () && key->second == hdr)
+			_by_key.erase (key);
+		_packages.erase (pkg);
+	}
+
+	Date _stamp;
+	vector<string> _dirs;
+	unordered_map<string, guint> _dir_ids;
+	unordered_map<unsigned, Package> _packages;
+	unordered_map<string, unsigned> _by_key;
+	unordered_map<string, vector<pair<unsigned, guint> > > _by_base;
+};
+
+static ZyppFileIndex file_index;
+
+/**
+ * Which installed packages need each installed package, worked out from
+ * the requires of the whole system repository once per pool serial
+ * rather than with a solver run for each package asked about.
+ */
+class ZyppRequiredByIndex
+{
+public:
+	void update (const ResPool &pool)
+	{
+		if (!_serial.remember (pool.serial ()))
+			return;
+
+		_requirements.clear ();
+		_edges.clear ();
+		Repository system = sat::Pool::instance ().findSystemRepo ();
+		for (const sat::Solvable &solvable : system.solvables ()) {
+			Capabilities req = solvable[Dep::REQUIRES];
+			for (Capabilities::const_iterator cap = req.begin (); cap != req.end (); ++cap) {
+				Requirement requirement;
+				requirement.requirer = solvable.id ();
+
+				sat::WhatProvides prov (*cap);
+				for (sat::WhatProvides::const_iterator it = prov.begin (); it != prov.end (); ++it) {
+					if (it->isSystem () && *it != solvable)
+						requirement.providers.push_back (it->id ());
+				}
+				if (requirement.providers.empty ())
+					continue;
+
+				for (sat::detail::SolvableIdType provider : requirement.providers)
+					_edges[provider].push_back (_requirements.size ());
+				_requirements.push_back (std::move (requirement));
 			}
-			if (g_strcmp0(pkg.repository().alias().c_str(), id_parts[PK_PACKAGE_ID_DATA])) {
-				//MIL << "repo does not match\n";
+		}
+		MIL << "indexed " << _requirements.size () << " installed requirements" << endl;
+	}
+
+	/**
+	 * Returns the installed packages that can't stay without all of
+	 * @removed, and the ones that can't stay without those in turn if
+	 * @recursive, in the order they were found
+	 */
+	vector<sat::Solvable> required_by (const vector<sat::Solvable> &removed, bool recursive) const
+	{
+		vector<sat::Solvable> output;
+		set<sat::detail::SolvableIdType> gone;
+		vector<sat::detail::SolvableIdType> queue;
+
+		// all of them go at once, so one of them is not kept by another
+		for (const sat::Solvable &solvable : removed) {
+			if (gone.insert (solvable.id ()).second)
+				queue.push_back (solvable.id ());
+		}
+
+		for (size_t i = 0; i < queue.size (); i++) {
+			auto edges = _edges.find (queue[i]);
+			if (edges == _edges.end ())
 				continue;
+
+			for (size_t index : edges->second) {
+				const Requirement &requirement = _requirements[index];
+				if (gone.count (requirement.requirer) > 0)
+					continue;
+
+				// another package still provides it
+				bool provided = false;
+				for (sat::detail::SolvableIdType provider : requirement.providers) {
+					if (gone.count (provider) == 0) {
+						provided = true;
+						break;
+					}
+				}
+				if (provided)
+					continue;
+
+				gone.insert (requirement.requirer);
+				output.push_back (sat::Solvable (requirement.requirer));
+				if (recursive)
+					queue.push_back (requirement.requirer);
 			}
-		} else if (strncmp(id_parts[PK_PACKAGE_ID_DATA], "installed", 9)) {
-			//MIL << "pkg installed\n";
-			continue;
 		}
-
-		MIL << "found " << pkg << endl;
-		package = pkg;
-		break;
+		return output;
 	}
 
-	g_strfreev (id_parts);
-	return package;
+private:
+	struct Requirement {
+		sat::detail::SolvableIdType requirer;
+		vector<sat::detail::SolvableIdType> providers;
+	};
+
+	SerialNumberWatcher _serial;
+	vector<Requirement> _requirements;
+	// the requirements each package is one of the providers of
+	unordered_map<sat::detail::SolvableIdType, vector<size_t> > _edges;
+};
+
+static ZyppRequiredByIndex required_by_index;
+
+/**
+ * Returns the installed packages that own any of the specified files,
+ * either given as a full path or as a basename.
+ */
+void
+zypp_get_packages_by_file (ZYpp::Ptr zypp,
+			   gchar **search_files,
+			   vector<sat::Solvable> &ret)
+{
+	set<string> owners;
+
+	zypp_build_pool (zypp);
+	file_index.update (zypp->target ()->rpmDb ().timestamp ());
+	for (guint i = 0; search_files[i] != NULL; i++)
+		file_index.owners (search_files[i], owners);
+
+	for (const string &owner : owners) {
+		// the index has the installed solvables by package id
+		string package_id = owner + ";installed";
+		sat::Solvable solvable = zypp_get_package_by_id (package_id.c_str ());
+		if (solvable != sat::Solvable::noSolvable)
+			ret.push_back (solvable);
+	}
 }
 
 RepoInfo
@@ -1011,12 +1430,19 @@ static gboolean
 zypp_refresh_meta_and_cache (RepoManager &manager, RepoInfo &repo, bool force = false)
 {
 	try {
+		RepoStatus cached = manager.cacheStatus (repo);
 		manager.refreshMetadata (repo, force ?
 					 RepoManager::RefreshForced :
 					 RepoManager::RefreshIfNeededIgnoreDelay);
 		manager.buildCache (repo, force ?
 				    RepoManager::BuildForced :
 				    RepoManager::BuildIfNeeded);
+
+		// loading it again would change the pool serial for nothing
+		if (!force && cached == manager.cacheStatus (repo) &&
+		    sat::Pool::instance ().reposFind (repo.alias ()) != Repository::noRepository)
+			return TRUE;
+
 		try
 		{
 			manager.loadFromCache (repo);
@@ -1153,6 +1579,26 @@ zypp_backend_package (PkBackendJob *job, PkInfoEnum info,
 	g_free (id);
 }
 
+/* queue a package for pk_backend_job_packages() */
+static void
+zypp_backend_package_add (GPtrArray *items, PkInfoEnum info,
+			  const sat::Solvable &pkg,
+			  const char *opt_summary)
+{
+	g_autofree gchar *id = zypp_build_package_id_from_resolvable (pkg);
+	g_autoptr(GError) error = NULL;
+	PkPackage *item;
+
+	item = pk_package_new_full (info, id, opt_summary, PK_INFO_ENUM_UNKNOWN,
+				    PK_ROLE_ENUM_UNKNOWN, NULL, &error);
+	if (item == NULL) {
+		g_warning ("package_id %s invalid and cannot be processed: %s",
+			   id, error->message);
+		return;
+	}
+	g_ptr_array_add (items, item);
+}
+
 /*
  * Emit signals for the packages, -but- if we have an installed package
  * we don't notify the client that the package is also available, since
@@ -1164,6 +1610,7 @@ zypp_emit_filtered_packages_in_list (PkBackendJob *job, PkBitfield filters, cons
 	typedef vector<sat::Solvable>::const_iterator sat_it_t;
 
 	vector<sat::Solvable> installed;
+	g_autoptr(GPtrArray) items = g_ptr_array_new_full (v.size (), g_object_unref);
 
 	// always emit system installed packages first
 	for (sat_it_t it = v.begin (); it != v.end (); ++it) {
@@ -1171,8 +1618,8 @@ zypp_emit_filtered_packages_in_list (PkBackendJob *job, PkBitfield filters, cons
 		    zypp_filter_solvable (filters, *it))
 			continue;
 
-		zypp_backend_package (job, PK_INFO_ENUM_INSTALLED, *it,
-				      make<ResObject>(*it)->summary().c_str());
+		zypp_backend_package_add (items, PK_INFO_ENUM_INSTALLED, *it,
+					  make<ResObject>(*it)->summary().c_str());
 		installed.push_back (*it);
 	}
 
@@ -1191,10 +1638,13 @@ zypp_emit_filtered_packages_in_list (PkBackendJob *job, PkBitfield filters, cons
 				  !isKind<SrcPackage>(*i));
 		}
 		if (!match) {
-			zypp_backend_package (job, PK_INFO_ENUM_AVAILABLE, *it,
-					      make<ResObject>(*it)->summary().c_str());
+			zypp_backend_package_add (items, PK_INFO_ENUM_AVAILABLE, *it,
+						  make<ResObject>(*it)->summary().c_str());
 		}
 	}
+
+	// the whole list reaches the daemon as one event
+	pk_backend_job_packages (job, items);
 }
 
 static gboolean
@@ -1232,6 +1682,7 @@ zypp_get_package_updates (string repo, set<PoolItem> &pks)
 	ResPool::byKind_iterator it = pool.byKindBegin (kind);
 	ResPool::byKind_iterator e = pool.byKindEnd (kind);
 
+	_solver_runs++;
 	if (is_tumbleweed ()) {
 		resolver->dupSetAllowVendorChange (ZConfig::instance ().solver_dupAllowVendorChange ());
 		resolver->doUpgrade ();
@@ -1266,6 +1717,7 @@ zypp_get_patches (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &patches)
 	bool sawSecurityPatch = false;
 	
 	zypp->resolver ()->setIgnoreAlreadyRecommended (TRUE);
+	_solver_runs++;
 	zypp->resolver ()->resolvePool ();
 
 	for (ResPoolProxy::const_iterator it = zypp->poolProxy ().byKindBegin<Patch>();
@@ -1300,6 +1752,37 @@ zypp_get_patches (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &patches)
 	return detail;
 }
 
+/* the result of the last zypp_get_updates (), valid for the pool serial */
+static SerialNumberWatcher updates_serial;
+static set<PoolItem> updates_candidates;
+static SelfUpdate updates_detail = SelfUpdate::kNo;
+static bool updates_valid = false;
+
+/**
+  * Makes the next zypp_get_updates () run the resolver again, the pool
+  * serial already changes when repositories are loaded or removed
+  */
+static void
+zypp_invalidate_updates ()
+{
+	updates_valid = false;
+	updates_candidates.clear ();
+}
+
+/**
+  * Empties the pool and drops everything that was worked out from it,
+  * before the target is switched to another root or released
+  */
+static void
+zypp_forget_pool (ZYpp::Ptr zypp)
+{
+	zypp_invalidate_updates ();
+	file_index = ZyppFileIndex ();
+	required_by_index = ZyppRequiredByIndex ();
+	sat::Pool::instance ().reposEraseAll ();
+	repos_loaded = FALSE;
+}
+
 /**
   * Return the best, most friendly selection of update patches and packages that
   * we can find. Also manages SelfUpdate to prioritise critical infrastructure
@@ -1309,6 +1792,15 @@ static SelfUpdate
 zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
 {
 	typedef set<PoolItem>::iterator pi_it_t;
+
+	if (updates_serial.remember (zypp->pool ().serial ()))
+		zypp_invalidate_updates ();
+	if (updates_valid) {
+		MIL << "reusing " << updates_candidates.size () << " update candidates" << endl;
+		candidates.insert (updates_candidates.begin (), updates_candidates.end ());
+		return updates_detail;
+	}
+
 	SelfUpdate detail = zypp_get_patches (job, zypp, candidates);
 
 	if (detail == SelfUpdate::kNo) {
@@ -1367,6 +1859,10 @@ zypp_get_updates (PkBackendJob *job, ZYpp::Ptr zypp, set<PoolItem> &candidates)
 			candidates.insert (packages.begin (), packages.end ());
 		}
 	}
+
+	updates_candidates = candidates;
+	updates_detail = detail;
+	updates_valid = true;
 	return detail;
 }
 
@@ -1433,6 +1929,116 @@ zypp_backend_pool_item_notify (PkBackendJob  *job,
 	return true;
 }
 
+/**
+  * whether the repo wants a login or a client certificate, whatever it
+  * sends would reach the peers without them
+  */
+static gboolean
+zypp_repo_needs_credentials (const RepoInfo &info)
+{
+	for (RepoInfo::urls_const_iterator it = info.baseUrlsBegin (); it != info.baseUrlsEnd (); ++it) {
+		if (it->hasCredentialsInAuthority () ||
+		    !it->getQueryParam ("credentials").empty () ||
+		    !it->getQueryParam ("ssl_clientcert").empty ())
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+  * put what the peers have where zypp caches the packages, zypp only
+  * uses a cached package if its checksum matches the repo metadata
+  * and rpm checks the signature when installing it
+  */
+static std::vector<std::pair<std::string, std::string> >
+zypp_fetch_from_peers (PkBackendJob *job, const ResPool &pool)
+{
+	std::vector<std::pair<std::string, std::string> > fetched;
+
+	for (ResPool::const_iterator it = pool.begin (); it != pool.end (); ++it) {
+		if (!it->status ().isToBeInstalled () || !isKind<Package> (it->resolvable ()))
+			continue;
+		if (pk_backend_job_is_cancelled (job))
+			break;
+
+		Package::constPtr package = asKind<Package> (it->resolvable ());
+		RepoInfo info = package->repoInfo ();
+		filesystem::Pathname path = info.packagesPath () / info.path () / package->location ().filename ();
+		g_autofree gchar *package_id = zypp_build_package_id_from_resolvable (it->satSolvable ());
+
+		if (!PathInfo (path).isExist ())
+			pk_backend_job_fetch_from_peers (job, package_id, path.c_str (),
+							 (goffset) package->downloadSize ());
+		if (zypp_repo_needs_credentials (info))
+			continue;
+		fetched.push_back (std::make_pair (std::string (package_id), path.asString ()));
+	}
+	return fetched;
+}
+
+/// \class ZyppPlan
+/// \brief The pool statuses the resolver left after a simulation.
+///
+/// The daemon keeps this between a simulation and its commit, so the
+/// commit can put the solved statuses back instead of resolving again.
+/// The commit still takes the auto-installed packages from the last run
+/// of the resolver, so a plan is only used while the pool was not
+/// reloaded and the resolver did not run since.
+struct ZyppPlan
+{
+	unsigned pool_serial;
+	guint solver_run;
+	vector<pair<PoolItem, ResStatus> > items;
+};
+
+static void
+zypp_plan_free (gpointer plan)
+{
+	delete static_cast<ZyppPlan *> (plan);
+}
+
+static ZyppPlan *
+zypp_plan_new (ResPool pool)
+{
+	ZyppPlan *plan = new ZyppPlan;
+
+	plan->pool_serial = pool.serial ().serial ();
+	plan->solver_run = _solver_runs;
+	for (ResPool::const_iterator it = pool.begin (); it != pool.end (); ++it) {
+		if (it->status ().transacts ())
+			plan->items.push_back (make_pair (*it, it->status ()));
+	}
+	return plan;
+}
+
+/**
+  * put back what the simulation of this request solved, if still valid
+  */
+static gboolean
+zypp_plan_restore (PkBackendJob *job, ResPool pool)
+{
+	ZyppPlan *plan = static_cast<ZyppPlan *> (pk_backend_job_get_plan (job));
+
+	if (plan == NULL)
+		return FALSE;
+	if (plan->pool_serial != pool.serial ().serial () ||
+	    plan->solver_run != _solver_runs) {
+		MIL << "pool or resolver changed since the simulation, solving again" << endl;
+		return FALSE;
+	}
+
+	for (ResPool::const_iterator it = pool.begin (); it != pool.end (); ++it) {
+		if (it->status ().transacts ())
+			it->statusReset ();
+	}
+	for (vector<pair<PoolItem, ResStatus> >::iterator it = plan->items.begin ();
+	     it != plan->items.end (); ++it)
+		it->first.status () = it->second;
+
+	MIL << "committing the simulated plan of " << plan->items.size () << " items" << endl;
+	return TRUE;
+}
+
 /**
   * simulate, or perform changes in pool to the system
   */
@@ -1441,6 +2047,9 @@ zypp_perform_execution (PkBackendJob *job, ZYpp::Ptr zypp, PerformType type, gbo
 {
 	MIL << force << " " << pk_filter_bitfield_to_string(transaction_flags) << endl;
 	gboolean ret = FALSE;
+
+	// whatever is committed changes what can be updated
+	zypp_invalidate_updates ();
 	
 	PkBackend *backend = PK_BACKEND(pk_backend_job_get_backend(job));
 	
@@ -1452,8 +2061,13 @@ zypp_perform_execution (PkBackendJob *job, ZYpp::Ptr zypp, PerformType type, gbo
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DEP_RESOLVE);
 		pk_backend_job_set_percentage(job, 0);
 		zypp->resolver ()->setIgnoreAlreadyRecommended (TRUE);
+		gboolean solved = zypp_plan_restore (job, ResPool::instance ());
+		if (!solved) {
+			_solver_runs++;
+			solved = zypp->resolver ()->resolvePool ();
+		}
 		pk_backend_job_set_percentage(job, 100);
-		if (!zypp->resolver ()->resolvePool ()) {
+		if (!solved) {
 			// Manual intervention required to resolve dependencies
 			// TODO: Figure out what we need to do with PackageKit
 			// to pull off interactive problem solving.
@@ -1510,6 +2124,9 @@ zypp_perform_execution (PkBackendJob *job, ZYpp::Ptr zypp, PerformType type, gbo
 
 			MIL << "simulating" << endl;
 
+			// keep what was solved for when the simulation is confirmed
+			pk_backend_job_set_plan (job, zypp_plan_new (pool), zypp_plan_free);
+
 			for (ResPool::const_iterator it = pool.begin (); it != pool.end (); ++it) {
 				switch (type) {
 				case REMOVE:
@@ -1576,6 +2193,7 @@ zypp_perform_execution (PkBackendJob *job, ZYpp::Ptr zypp, PerformType type, gbo
 		if (!pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED))
 			policy.rpmNoSignature(true);
 
+		std::vector<std::pair<std::string, std::string> > peer_packages = zypp_fetch_from_peers (job, pool);
 		ZYppCommitResult result = zypp->commit (policy);
 
 		bool worked = result.allDone();
@@ -1607,6 +2225,14 @@ zypp_perform_execution (PkBackendJob *job, ZYpp::Ptr zypp, PerformType type, gbo
 			goto exit;
 		}
 
+		// only kept after the commit with keeppackages or when only downloading
+		for (guint i = 0; i < peer_packages.size (); i++) {
+			if (PathInfo (peer_packages[i].second).isExist ())
+				pk_backend_job_share_with_peers (job,
+								 peer_packages[i].first.c_str (),
+								 peer_packages[i].second.c_str ());
+		}
+
 		pk_backend_job_set_percentage(job, 100);
 		ret = TRUE;
 	} catch (const repo::RepoNotFoundException &ex) {
@@ -1656,7 +2282,7 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 
 	if (zypp == NULL)
 		return  FALSE;
-	filesystem::Pathname pathname("/");
+	filesystem::Pathname pathname(zypp_get_target_root ());
 
 	bool poolIsClean = sat::Pool::instance ().reposEmpty ();
 	// Erase and reload all if pool is too holey (densyity [100: good | 0 bad])
@@ -1680,7 +2306,7 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 		target->rpmDb ().exportTrustedKeysInZyppKeyRing ();
 	}
 	// load installed packages to pool
-	target->load ();
+	zypp_load_target (target);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_REFRESH_CACHE);
 	pk_backend_job_set_percentage (job, 0);
@@ -1714,17 +2340,19 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 		}
 	}
 
-	int i = 1;
-	int num_of_repos = repos.size ();
-	gchar *repo_messages = NULL;
-
-	for (list <RepoInfo>::iterator it = repos.begin(); it != repos.end(); ++it, i++) {
+	// pick the repositories to refresh first, so the progress can be
+	// spread over all of them
+	list <RepoInfo> refresh;
+	GString *repo_messages = g_string_new (NULL);
+	for (list <RepoInfo>::iterator it = repos.begin(); it != repos.end(); ++it) {
 		RepoInfo repo (*it);
 
-		if (!zypp_is_valid_repo (job, repo))
-			return FALSE;
-		if (pk_backend_job_get_is_error_set (job))
-			break;
+		// a broken repository must not keep the others from refreshing
+		if (repo.alias ().empty () || !repo.url ().isValid ()) {
+			g_string_append_printf (repo_messages, "%s: %s\n", repo.alias ().c_str (),
+						"Repository has no or invalid name or url defined.");
+			continue;
+		}
 
 		// skip disabled repos
 		if (repo.enabled () == false)
@@ -1738,6 +2366,12 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 		if (!force && !repo.autorefresh())
 			continue;
 
+		// checked against the server recently enough for the client
+		if (!force &&
+		    pk_backend_job_is_cache_fresh (job, manager.metadataStatus (repo).timestamp ()) &&
+		    sat::Pool::instance ().reposFind (repo.alias ()) != Repository::noRepository)
+			continue;
+
 		// skip changeable media (DVDs and CDs).  Without doing this,
 		// the disc would be required to be physically present.
 		if (repo.baseUrlsBegin ()->schemeIsVolatile())
@@ -1747,31 +2381,40 @@ zypp_refresh_cache (PkBackendJob *job, ZYpp::Ptr zypp, gboolean force)
 			continue;
 		}
 
+		refresh.push_back (repo);
+	}
+
+	// libzypp must only be used from one thread, so the repositories are
+	// refreshed one after another, a failing one is reported and skipped
+	int i = 1;
+	int num_of_repos = refresh.size ();
+	for (list <RepoInfo>::iterator it = refresh.begin(); it != refresh.end(); ++it, i++) {
+		RepoInfo &repo = *it;
+
+		if (pk_backend_job_get_is_error_set (job))
+			break;
+
 		try {
 			// Refreshing metadata
 			g_free (_repoName);
 			_repoName = g_strdup (repo.alias ().c_str ());
 			zypp_refresh_meta_and_cache (manager, repo, force);
 		} catch (const Exception &ex) {
-			if (repo_messages == NULL) {
-				repo_messages = g_strdup_printf ("%s: %s%s", repo.alias ().c_str (), ex.asUserString ().c_str (), "\n");
-			} else {
-				repo_messages = g_strdup_printf ("%s%s: %s%s", repo_messages, repo.alias ().c_str (), ex.asUserString ().c_str (), "\n");
-			}
-			if (repo_messages == NULL || !g_utf8_validate (repo_messages, -1, NULL))
-				repo_messages = g_strdup ("A repository could not be refreshed");
-			g_strdelimit (repo_messages, "\\\f\r\t", ' ');
-			continue;
+			g_string_append_printf (repo_messages, "%s: %s\n", repo.alias ().c_str (), ex.asUserString ().c_str ());
 		}
 
 		// Update the percentage completed
 		pk_backend_job_set_percentage (job, i >= num_of_repos ? 100 : (100 * i) / num_of_repos);
 	}
-	if (repo_messages != NULL)
-		g_printf("%s", repo_messages);
+	if (repo_messages->len > 0) {
+		if (!g_utf8_validate (repo_messages->str, -1, NULL))
+			g_string_assign (repo_messages, "A repository could not be refreshed\n");
+		g_strdelimit (repo_messages->str, "\\\f\r\t", ' ');
+		g_printf("%s", repo_messages->str);
+	}
 
 	pk_backend_job_set_percentage (job, 100);
-	g_free (repo_messages);
+	g_string_free (repo_messages, TRUE);
 	return TRUE;
 }
 
@@ -1806,6 +2449,25 @@ pk_backend_supports_parallelization (PkBackend *backend)
         return FALSE;
 }
 
+/**
+ * The repositories, their metadata and the downloads are those of the
+ * default root, a job for another root only switches the target
+ */
+gboolean
+pk_backend_supports_roots (PkBackend *backend)
+{
+	return TRUE;
+}
+
+/**
+ * The repo files in knownReposPath are watched, whoever changes them
+ */
+gboolean
+pk_backend_watches_repos (PkBackend *backend)
+{
+	return TRUE;
+}
+
 
 const gchar *
 pk_backend_get_description (PkBackend *backend)
@@ -1822,6 +2484,19 @@ pk_backend_get_author (PkBackend *backend)
 			 "ZYpp developers <zypp-devel@opensuse.org>");
 }
 
+static void
+zypp_repos_changed_cb (GFileMonitor *monitor,
+		       GFile *file,
+		       GFile *other_file,
+		       GFileMonitorEvent event_type,
+		       gpointer user_data)
+{
+	if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED)
+		return;
+	g_debug ("repos changed outside of PackageKit");
+	pk_backend_repo_list_changed (PK_BACKEND (user_data));
+}
+
 void
 pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 {
@@ -1829,11 +2504,40 @@ pk_backend_initialize (GKeyFile *conf, PkBackend *backend)
 	priv = new PkBackendZYppPrivate;
 	priv->currentJob = 0;
 	priv->zypp_mutex = PTHREAD_MUTEX_INITIALIZER;
+	priv->target_idle_id = 0;
+	priv->repos_monitor = NULL;
 	zypp_logging ();
 
+	g_autofree gchar *destdir = g_key_file_get_string (conf, "Daemon", "DestDir", NULL);
+	priv->default_root = destdir != NULL ? destdir : "/";
+	priv->target_idle_timeout = MAX (g_key_file_get_integer (conf, "Zypp", "TargetIdleTimeout", NULL), 0);
+
+	/* let libzypp fetch the packages of a commit in parallel, with the
+	 * curl backend that reuses connections and spreads over mirrors */
+	if (!g_key_file_has_key (conf, "Zypp", "ParallelDownloads", NULL) ||
+	    g_key_file_get_boolean (conf, "Zypp", "ParallelDownloads", NULL)) {
+		g_setenv ("ZYPP_PCK_PRELOAD", "1", FALSE);
+		g_setenv ("ZYPP_CURL2", "1", FALSE);
+	}
+
+	/* a packagekit-reader process must not take the zypp lock the
+	 * daemon holds, it only ever reads the pool */
+	if (g_key_file_get_boolean (conf, "Daemon", "ReadOnly", NULL))
+		g_setenv ("ZYPP_READONLY_HACK", "1", TRUE);
+
 	/* Set PATH variable to avoid problems when installing packges(bsc#1175315). */
 	g_setenv("PATH", "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin", TRUE);
 
+	/* the answers to GetRepoList are cached until the repos change */
+	g_autoptr(GFile) repos_dir = g_file_new_for_path (ZConfig::instance ().knownReposPath ().c_str ());
+	g_autoptr(GError) error = NULL;
+	priv->repos_monitor = g_file_monitor_directory (repos_dir, G_FILE_MONITOR_NONE, NULL, &error);
+	if (priv->repos_monitor == NULL)
+		g_warning ("failed to watch the repos: %s", error->message);
+	else
+		g_signal_connect (priv->repos_monitor, "changed",
+				  G_CALLBACK (zypp_repos_changed_cb), backend);
+
 	g_debug ("zypp_backend_initialize");
 }
 
@@ -1842,6 +2546,11 @@ pk_backend_destroy (PkBackend *backend)
 {
 	g_debug ("zypp_backend_destroy");
 
+	if (priv->target_idle_id != 0)
+		g_source_remove (priv->target_idle_id);
+	if (priv->repos_monitor != NULL)
+		g_object_unref (priv->repos_monitor);
+
 	filesystem::recursive_rmdir (zypp::myTmpDir ());
 
 	g_free (_repoName);
@@ -1882,8 +2591,8 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 
 	pk_backend_job_set_percentage (job, 10);
 
-	ResPool pool = zypp_build_pool (zypp, true);
-	PoolStatusSaver saver;
+	ResPool pool = zypp_build_pool (zypp);
+	vector<sat::Solvable> removed;
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
 
@@ -1893,45 +2602,24 @@ backend_required_by_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 			return;
 		}
 
-		PoolItem package = PoolItem(solvable);
-
 		// required-by only works for installed packages. It's meaningless for stuff in the repo
 		// same with yum backend
 		if (!solvable.isSystem ())
 			continue;
-		// set Package as to be uninstalled
-		package.status ().setToBeUninstalled (ResStatus::USER);
-
-		// solver run
-		ResPool pool = ResPool::instance ();
-		Resolver solver(pool);
-
-		solver.setForceResolve (true);
-		solver.setIgnoreAlreadyRecommended (TRUE);
-
-		if (!solver.resolvePool ()) {
-			string problem = "Resolution failed: ";
-			list<ResolverProblem_Ptr> problems = solver.problems ();
-			for (list<ResolverProblem_Ptr>::iterator it = problems.begin (); it != problems.end (); ++it){
-				problem += (*it)->description ();
-			}
-			zypp_backend_finished_error (
-				job, PK_ERROR_ENUM_DEP_RESOLUTION_FAILED,
-				problem.c_str());
-			return;
-		}
-
-		// look for packages which would be uninstalled
-		bool error = false;
-		for (ResPool::byKind_iterator it = pool.byKindBegin (ResKind::package);
-				it != pool.byKindEnd (ResKind::package); ++it) {
-
-			if (!error && !zypp_filter_solvable (_filters, it->resolvable()->satSolvable()))
-				error = !zypp_backend_pool_item_notify (job, *it);
-		}
+		removed.push_back (solvable);
+	}
 
-		solver.setForceResolve (false);
+	// one walk for all the ids, as if they were removed together
+	pk_backend_job_set_percentage (job, 40);
+	required_by_index.update (pool);
+	for (const sat::Solvable &solvable : required_by_index.required_by (removed, recursive)) {
+		if (zypp_filter_solvable (_filters, solvable))
+			continue;
+		PoolItem item (solvable);
+		zypp_backend_package (job, PK_INFO_ENUM_INSTALLED, solvable,
+				      item.resolvable ()->summary ().c_str ());
 	}
+	pk_backend_job_set_percentage (job, 100);
 }
 
 /**
@@ -2145,7 +2833,7 @@ backend_get_details_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	zypp_build_pool (zypp, true);
+	zypp_build_pool (zypp);
 
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
@@ -2456,7 +3144,7 @@ backend_get_updates_thread (PkBackendJob *job, GVariant *params, gpointer user_d
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	pk_backend_job_set_percentage (job, 40);
 
 	set<PoolItem> candidates;
@@ -2576,7 +3264,7 @@ backend_install_files_thread (PkBackendJob *job, GVariant *params, gpointer user
 			  job, PK_ERROR_ENUM_INTERNAL_ERROR, "Can't refresh repositories");
 			return;
 		}
-		zypp_build_pool (zypp, true);
+		zypp_build_pool (zypp);
 
 	} catch (const Exception &ex) {
 		zypp_backend_finished_error (
@@ -2635,7 +3323,7 @@ backend_get_update_detail_thread (PkBackendJob *job, GVariant *params, gpointer
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; package_ids[i]; i++) {
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
@@ -2742,7 +3430,7 @@ backend_install_packages_thread (PkBackendJob *job, GVariant *params, gpointer u
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, TRUE);
+		ResPool pool = zypp_build_pool (zypp);
 		PoolStatusSaver saver;
 		pk_backend_job_set_percentage (job, 10);
 		vector<PoolItem> items;
@@ -2995,7 +3683,7 @@ backend_resolve_thread (PkBackendJob *job, GVariant *params, gpointer user_data)
 	
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 
 	for (uint i = 0; search[i]; i++) {
 		MIL << search[i] << " " << pk_filter_bitfield_to_string(_filters) << endl;
@@ -3115,7 +3803,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 
 	switch (role) {
 	case PK_ROLE_ENUM_SEARCH_NAME:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
 		q.addKind( ResKind::package );
 		q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -3124,7 +3812,7 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 		// two separate queries.
 		break;
 	case PK_ROLE_ENUM_SEARCH_DETAILS:
-		zypp_build_pool (zypp, TRUE); // seems to be necessary?
+		zypp_build_pool (zypp); // seems to be necessary?
 		q.addKind( ResKind::package );
 		//q.addKind( ResKind::srcpackage );
 		q.addAttribute( sat::SolvAttr::name );
@@ -3135,7 +3823,20 @@ backend_find_packages_thread (PkBackendJob *job, GVariant *params, gpointer user
 	case PK_ROLE_ENUM_SEARCH_FILE: {
 		q.setCaseSensitive( true ); // [<>] But we probably want case sensitive search for the file searches.
 
-		zypp_build_pool (zypp, TRUE);
+		// the installed files all come from the index in one go
+		zypp_get_packages_by_file (zypp, values, v);
+		if (pk_bitfield_contain (_filters, PK_FILTER_ENUM_INSTALLED)) {
+			zypp_emit_filtered_packages_in_list (job, _filters, v);
+			return;
+		}
+
+		// the repositories only know the files of their primary filelist
+		for (guint i = 1; values[i] != NULL; i++)
+			q.addString( values[i] );
+		for (const Repository &repo : zypp->pool ().knownRepositories ()) {
+			if (!repo.isSystemRepo ())
+				q.addRepo( repo.alias () );
+		}
 		q.addKind( ResKind::package );
 		q.addAttribute( sat::SolvAttr::name );
 		q.addAttribute( sat::SolvAttr::description );
@@ -3196,7 +3897,7 @@ backend_search_group_thread (PkBackendJob *job, GVariant *params, gpointer user_
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 	pk_backend_job_set_percentage (job, 0);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	pk_backend_job_set_percentage (job, 30);
 
@@ -3334,37 +4035,59 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 		return;
 	}
 
-	zypp_build_pool (zypp, true);
+	zypp_build_pool (zypp);
+	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
+	// the files of the ids before one that can't be found are still sent
+	vector<sat::Solvable> solvables;
+	bool not_found = false;
 	for (uint i = 0; package_ids[i]; i++) {
-		pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 		sat::Solvable solvable = zypp_get_package_by_id (package_ids[i]);
-
 		if (zypp_is_no_solvable(solvable)) {
-			zypp_backend_finished_error (
-				job, PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
-				"couldn't find package");
-			return;
+			not_found = true;
+			break;
+		}
+		solvables.push_back (solvable);
+	}
+
+	vector<vector<string> > files (solvables.size ());
+	try {
+		set<string> wanted;
+		map<string, target::rpm::RpmHeader::constPtr> headers;
+
+		// the index has most of them, the rest are read in one rpmdb pass
+		file_index.update (zypp->target ()->rpmDb ().timestamp ());
+		for (size_t i = 0; i < solvables.size (); i++) {
+			const sat::Solvable &solvable = solvables[i];
+			if (solvable.isSystem () &&
+			    !file_index.files (solvable.name (), solvable.edition ().asString (),
+					       solvable.arch ().asString (), files[i]))
+				wanted.insert (zypp_rpmHeader_key (solvable.name (), solvable.edition ()));
+		}
+		zypp_get_rpmHeaders (wanted, headers);
+
+		for (size_t i = 0; i < solvables.size (); i++) {
+			auto it = headers.find (zypp_rpmHeader_key (solvables[i].name (), solvables[i].edition ()));
+			if (!solvables[i].isSystem () || !files[i].empty () || it == headers.end ())
+				continue;
+			list<string> header_files = it->second->tag_filenames ();
+			files[i].assign (header_files.begin (), header_files.end ());
 		}
+	} catch (const target::rpm::RpmException &ex) {
+		zypp_backend_finished_error (job, PK_ERROR_ENUM_REPO_NOT_FOUND,
+					     "Couldn't open rpm-database");
+		return;
+	}
 
+	for (size_t i = 0; i < solvables.size (); i++) {
 		g_auto(GStrv) strv = NULL;
 		g_autoptr(GPtrArray) pkg_files = NULL;
 
 		pkg_files = g_ptr_array_new ();
 
-		if (solvable.isSystem ()){
-			try {
-				target::rpm::RpmHeader::constPtr rpmHeader = zypp_get_rpmHeader (solvable.name (), solvable.edition ());
-				list<string> files = rpmHeader->tag_filenames ();
-
-				for (list<string>::iterator it = files.begin (); it != files.end (); ++it) {
-					g_ptr_array_add (pkg_files, g_strdup (it->c_str ()));
-				}
-
-			} catch (const target::rpm::RpmException &ex) {
-				zypp_backend_finished_error (job, PK_ERROR_ENUM_REPO_NOT_FOUND,
-							     "Couldn't open rpm-database");
-				return;
+		if (solvables[i].isSystem ()){
+			for (vector<string>::iterator it = files[i].begin (); it != files[i].end (); ++it) {
+				g_ptr_array_add (pkg_files, g_strdup (it->c_str ()));
 			}
 		} else {
 			g_ptr_array_add (pkg_files,
@@ -3376,6 +4099,12 @@ backend_get_files_thread (PkBackendJob *job, GVariant *params, gpointer user_dat
 		strv = g_strdupv ((gchar **) pkg_files->pdata);
 		pk_backend_job_files (job, package_ids[i], strv);
 	}
+
+	if (not_found) {
+		zypp_backend_finished_error (
+			job, PK_ERROR_ENUM_PACKAGE_NOT_FOUND,
+			"couldn't find package");
+	}
 }
 
 /**
@@ -3406,7 +4135,7 @@ backend_get_packages_thread (PkBackendJob *job, GVariant *params, gpointer user_
 
 	vector<sat::Solvable> v;
 
-	zypp_build_pool (zypp, TRUE);
+	zypp_build_pool (zypp);
 	ResPool pool = ResPool::instance ();
 	for (ResPool::byKind_iterator it = pool.byKindBegin (ResKind::package); it != pool.byKindEnd (ResKind::package); ++it) {
 		v.push_back (it->satSolvable ());
@@ -3447,6 +4176,7 @@ upgrade_system (PkBackendJob *job,
 	}
 
 	zypp->resolver ()->dupSetAllowVendorChange (ZConfig::instance ().solver_dupAllowVendorChange ());
+	_solver_runs++;
 	zypp->resolver ()->doUpgrade ();
 
 	zypp_perform_execution (job, zypp, UPGRADE_SYSTEM, FALSE, transaction_flags);
@@ -3471,7 +4201,7 @@ backend_update_packages_thread (PkBackendJob *job, GVariant *params, gpointer us
 		return;
 	}
 
-	ResPool pool = zypp_build_pool (zypp, TRUE);
+	ResPool pool = zypp_build_pool (zypp);
 	PkRestartEnum restart = PK_RESTART_ENUM_NONE;
 	PoolStatusSaver saver;
 
@@ -3707,7 +4437,7 @@ backend_what_provides_thread (PkBackendJob *job, GVariant *params, gpointer user
 	}
 	pk_backend_job_set_status (job, PK_STATUS_ENUM_QUERY);
 
-	ResPool pool = zypp_build_pool (zypp, true);
+	ResPool pool = zypp_build_pool (zypp);
 
 	if(g_ascii_strcasecmp("drivers_for_attached_hardware", values[0]) == 0) {
 		// solver run
@@ -3824,7 +4554,7 @@ backend_download_packages_thread (PkBackendJob *job, GVariant *params, gpointer
 
 	try
 	{
-		ResPool pool = zypp_build_pool (zypp, FALSE);
+		ResPool pool = zypp_build_pool (zypp);
 
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
 		for (guint i = 0; package_ids[i]; i++) {
@@ -0,0 +1,359 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Drives a running daemon with a number of concurrent clients and prints
+ * the throughput and latency as JSON. It is meant to be used with the
+ * dummy backend, which can return a synthetic package set when the daemon
+ * config has:
+ *
+ *   [Dummy]
+ *   SyntheticPackages=10000
+ *   SyntheticRate=0
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <packagekit-glib2/packagekit.h>
+
+typedef struct {
+	GMainLoop		*loop;
+	PkRoleEnum		 role;
+	gchar			**names;
+	guint			 outstanding;
+	GArray			*latencies;	/* gdouble, in ms */
+	guint64			 packages;
+	guint64			 progress;
+	guint			 failures;
+} PkBenchRun;
+
+typedef struct {
+	PkBenchRun		*run;
+	PkClient		*client;
+	guint			 remaining;
+	gint64			 start;
+} PkBenchClient;
+
+static void pk_bench_client_next (PkBenchClient *bench_client);
+
+static void
+pk_bench_progress_cb (PkProgress *progress, PkProgressType type, gpointer user_data)
+{
+	PkBenchRun *run = (PkBenchRun *) user_data;
+	run->progress++;
+}
+
+static void
+pk_bench_finished_cb (GObject *object, GAsyncResult *res, gpointer user_data)
+{
+	PkBenchClient *bench_client = (PkBenchClient *) user_data;
+	PkBenchRun *run = bench_client->run;
+	gdouble latency;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	latency = (gdouble) (g_get_monotonic_time () - bench_client->start) / 1000.f;
+	results = pk_client_generic_finish (bench_client->client, res, &error);
+	if (results == NULL ||
+	    pk_results_get_exit_code (results) != PK_EXIT_ENUM_SUCCESS) {
+		if (error != NULL)
+			g_warning ("failed: %s", error->message);
+		run->failures++;
+	} else {
+		packages = pk_results_get_package_array (results);
+		run->packages += packages->len;
+		g_array_append_val (run->latencies, latency);
+	}
+
+	if (--bench_client->remaining > 0) {
+		pk_bench_client_next (bench_client);
+		return;
+	}
+	if (--run->outstanding == 0)
+		g_main_loop_quit (run->loop);
+}
+
+static void
+pk_bench_client_next (PkBenchClient *bench_client)
+{
+	PkBenchRun *run = bench_client->run;
+	PkBitfield filters = pk_bitfield_value (PK_FILTER_ENUM_NONE);
+
+	bench_client->start = g_get_monotonic_time ();
+	switch (run->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+		pk_client_resolve_async (bench_client->client, filters, run->names, NULL,
+					 pk_bench_progress_cb, run,
+					 pk_bench_finished_cb, bench_client);
+		break;
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		pk_client_get_packages_async (bench_client->client, filters, NULL,
+					      pk_bench_progress_cb, run,
+					      pk_bench_finished_cb, bench_client);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATES:
+		pk_client_get_updates_async (bench_client->client, filters, NULL,
+					     pk_bench_progress_cb, run,
+					     pk_bench_finished_cb, bench_client);
+		break;
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		pk_client_search_names_async (bench_client->client, filters, run->names, NULL,
+					      pk_bench_progress_cb, run,
+					      pk_bench_finished_cb, bench_client);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+static gint
+pk_bench_sort_double_cb (gconstpointer a, gconstpointer b)
+{
+	gdouble da = *((const gdouble *) a);
+	gdouble db = *((const gdouble *) b);
+	if (da < db)
+		return -1;
+	if (da > db)
+		return 1;
+	return 0;
+}
+
+static gdouble
+pk_bench_percentile (GArray *sorted, gdouble percentile)
+{
+	guint idx;
+	if (sorted->len == 0)
+		return 0.f;
+	idx = (guint) (percentile / 100.f * sorted->len + 0.5f);
+	idx = CLAMP (idx, 1, sorted->len) - 1;
+	return g_array_index (sorted, gdouble, idx);
+}
+
+static void
+pk_bench_json_add_double (GString *str, const gchar *key, gdouble value, gboolean comma)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	g_string_append_printf (str, "\"%s\": %s%s", key,
+				g_ascii_formatd (buf, sizeof (buf), "%.3f", value),
+				comma ? ", " : "");
+}
+
+/* rss of the daemon, so that leaks under load show up */
+static gint64
+pk_bench_get_daemon_peak_rss (void)
+{
+	guint32 pid = 0;
+	gint64 rss = -1;
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *filename = NULL;
+	g_auto(GStrv) lines = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+	if (connection == NULL)
+		return -1;
+	value = g_dbus_connection_call_sync (connection,
+					     "org.freedesktop.DBus",
+					     "/org/freedesktop/DBus",
+					     "org.freedesktop.DBus",
+					     "GetConnectionUnixProcessID",
+					     g_variant_new ("(s)", PK_DBUS_SERVICE),
+					     G_VARIANT_TYPE ("(u)"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, NULL);
+	if (value == NULL)
+		return -1;
+	g_variant_get (value, "(u)", &pid);
+
+	filename = g_strdup_printf ("/proc/%u/status", pid);
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return -1;
+	lines = g_strsplit (contents, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], "VmHWM:"))
+			rss = g_ascii_strtoll (lines[i] + strlen ("VmHWM:"), NULL, 10);
+	}
+	return rss;
+}
+
+static void
+pk_bench_run (GString *json, PkRoleEnum role, guint clients,
+	      guint iterations, gchar **names, gboolean comma)
+{
+	gdouble elapsed;
+	gdouble sum = 0.f;
+	gint64 start;
+	PkBenchRun run = { 0 };
+	g_autofree PkBenchClient *bench_clients = NULL;
+
+	run.loop = g_main_loop_new (NULL, FALSE);
+	run.role = role;
+	run.names = names;
+	run.latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	run.outstanding = clients;
+
+	/* every client waits for its answer before asking again */
+	bench_clients = g_new0 (PkBenchClient, clients);
+	start = g_get_monotonic_time ();
+	for (guint i = 0; i < clients; i++) {
+		bench_clients[i].run = &run;
+		bench_clients[i].client = pk_client_new ();
+		bench_clients[i].remaining = iterations;
+		pk_client_set_background (bench_clients[i].client, FALSE);
+		pk_client_set_interactive (bench_clients[i].client, FALSE);
+		pk_bench_client_next (&bench_clients[i]);
+	}
+	g_main_loop_run (run.loop);
+	elapsed = (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+
+	for (guint i = 0; i < run.latencies->len; i++)
+		sum += g_array_index (run.latencies, gdouble, i);
+	g_array_sort (run.latencies, pk_bench_sort_double_cb);
+
+	g_string_append_printf (json, "    { \"role\": \"%s\", \"clients\": %u, "
+				"\"transactions\": %u, \"failures\": %u, ",
+				pk_role_enum_to_string (role), clients,
+				run.latencies->len, run.failures);
+	pk_bench_json_add_double (json, "elapsed-s", elapsed, TRUE);
+	pk_bench_json_add_double (json, "transactions-per-second",
+				  run.latencies->len / elapsed, TRUE);
+	g_string_append_printf (json, "\"packages\": %" G_GUINT64_FORMAT ", ", run.packages);
+	pk_bench_json_add_double (json, "packages-per-second",
+				  run.packages / elapsed, TRUE);
+	pk_bench_json_add_double (json, "progress-per-second",
+				  run.progress / elapsed, TRUE);
+	g_string_append (json, "\"latency-ms\": { ");
+	pk_bench_json_add_double (json, "min", pk_bench_percentile (run.latencies, 0.f), TRUE);
+	pk_bench_json_add_double (json, "mean",
+				  run.latencies->len > 0 ? sum / run.latencies->len : 0.f, TRUE);
+	pk_bench_json_add_double (json, "p50", pk_bench_percentile (run.latencies, 50.f), TRUE);
+	pk_bench_json_add_double (json, "p95", pk_bench_percentile (run.latencies, 95.f), TRUE);
+	pk_bench_json_add_double (json, "p99", pk_bench_percentile (run.latencies, 99.f), TRUE);
+	pk_bench_json_add_double (json, "max", pk_bench_percentile (run.latencies, 100.f), FALSE);
+	g_string_append_printf (json, " } }%s\n", comma ? "," : "");
+
+	for (guint i = 0; i < clients; i++)
+		g_object_unref (bench_clients[i].client);
+	g_array_unref (run.latencies);
+	g_main_loop_unref (run.loop);
+}
+
+int
+main (int argc, char *argv[])
+{
+	gboolean no_ramp = FALSE;
+	gint clients = 4;
+	gint iterations = 50;
+	gint64 rss;
+	GOptionContext *context;
+	g_autofree gchar *output = NULL;
+	g_autofree gchar *names = NULL;
+	g_autofree gchar *roles = NULL;
+	g_auto(GStrv) names_split = NULL;
+	g_auto(GStrv) roles_split = NULL;
+	g_autoptr(GArray) role_enums = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) json = NULL;
+
+	const GOptionEntry options[] = {
+		{ "clients", 'c', 0, G_OPTION_ARG_INT, &clients,
+			"Run with 1 up to this many concurrent clients", "N" },
+		{ "no-ramp", '\0', 0, G_OPTION_ARG_NONE, &no_ramp,
+			"Only run with the --clients number of clients", NULL },
+		{ "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+			"Transactions each client runs in turn", "N" },
+		{ "roles", 'r', 0, G_OPTION_ARG_STRING, &roles,
+			"Comma separated roles out of resolve,get-packages,get-updates,search-name, "
+			"default resolve,get-packages,get-updates", "ROLES" },
+		{ "names", 'n', 0, G_OPTION_ARG_STRING, &names,
+			"Comma separated package names to resolve or search, default synthetic-0", "NAMES" },
+		{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+			"Write the JSON to a file rather than stdout", "FILE" },
+		{ NULL}
+	};
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "PackageKit Benchmark");
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_add_group (context, pk_debug_get_option_group ());
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse options: %s\n", error->message);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (clients < 1 || iterations < 1) {
+		g_printerr ("--clients and --iterations must be at least 1\n");
+		return EXIT_FAILURE;
+	}
+
+	role_enums = g_array_new (FALSE, FALSE, sizeof (PkRoleEnum));
+	roles_split = g_strsplit (roles != NULL ? roles : "resolve,get-packages,get-updates", ",", -1);
+	for (guint i = 0; roles_split[i] != NULL; i++) {
+		PkRoleEnum role = pk_role_enum_from_string (roles_split[i]);
+		if (role != PK_ROLE_ENUM_RESOLVE &&
+		    role != PK_ROLE_ENUM_GET_PACKAGES &&
+		    role != PK_ROLE_ENUM_GET_UPDATES &&
+		    role != PK_ROLE_ENUM_SEARCH_NAME) {
+			g_printerr ("Role %s is not supported\n", roles_split[i]);
+			return EXIT_FAILURE;
+		}
+		g_array_append_val (role_enums, role);
+	}
+	names_split = g_strsplit (names != NULL ? names : "synthetic-0", ",", -1);
+
+	json = g_string_new ("{\n");
+	g_string_append_printf (json, "  \"version\": \"%s\",\n", VERSION);
+	g_string_append_printf (json, "  \"iterations\": %i,\n", iterations);
+	g_string_append (json, "  \"results\": [\n");
+	for (guint i = 0; i < role_enums->len; i++) {
+		for (gint j = no_ramp ? clients : 1; j <= clients; j++) {
+			pk_bench_run (json, g_array_index (role_enums, PkRoleEnum, i),
+				      j, iterations, names_split,
+				      i + 1 < role_enums->len || j < clients);
+		}
+	}
+	g_string_append (json, "  ],\n");
+
+	/* -1 when the daemon is not ours to look at */
+	rss = pk_bench_get_daemon_peak_rss ();
+	if (rss >= 0)
+		g_string_append_printf (json, "  \"daemon-peak-rss-kb\": %" G_GINT64_FORMAT "\n", rss);
+	else
+		g_string_append (json, "  \"daemon-peak-rss-kb\": null\n");
+	g_string_append (json, "}\n");
+
+	if (output == NULL) {
+		g_print ("%s", json->str);
+		return EXIT_SUCCESS;
+	}
+	if (!g_file_set_contents (output, json->str, json->len, &error)) {
+		g_printerr ("Failed to write %s: %s\n", output, error->message);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -21,14 +21,20 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <glib-unix.h>
+#include <gio/gunixfdlist.h>
 #include <packagekit-glib2/packagekit.h>
 #include <packagekit-glib2/packagekit-private.h>
+#include <packagekit-glib2/pk-name-list-private.h>
 #include <sys/types.h>
 #include <pwd.h>
 #include <locale.h>
@@ -176,6 +182,22 @@ pk_console_transaction_cb (PkTransactionPast *item, PkConsoleCtx *ctx)
 		g_print (" %s: %i %s\n", _("Duration"), duration, _("(seconds)"));
 	}
 
+	/* only recorded by newer daemons */
+	if (pk_transaction_past_get_cpu_time (item) > 0) {
+		g_autofree gchar *memory = NULL;
+		g_autofree gchar *emitted = NULL;
+		/* TRANSLATORS: this is the CPU time the backend used */
+		g_print (" %s: %.2f %s\n", _("CPU time"),
+			 (gdouble) pk_transaction_past_get_cpu_time (item) / G_USEC_PER_SEC,
+			 _("(seconds)"));
+		memory = g_format_size (pk_transaction_past_get_memory_growth (item));
+		/* TRANSLATORS: this is how much the peak memory of the daemon grew */
+		g_print (" %s: %s\n", _("Memory growth"), memory);
+		emitted = g_format_size (pk_transaction_past_get_bytes_emitted (item));
+		/* TRANSLATORS: this is the size of the results sent to clients */
+		g_print (" %s: %s\n", _("Results sent"), emitted);
+	}
+
 	/* TRANSLATORS: this is The command line used to do the action */
 	g_print (" %s: %s\n", _("Command line"), cmdline);
 	/* TRANSLATORS: this is the user ID of the user that started the action */
@@ -834,34 +856,17 @@ out:
 }
 
 static gchar *
-pk_console_resolve_package (PkConsoleCtx *ctx, const gchar *package_name, GError **error)
+pk_console_resolve_package (PkConsoleCtx *ctx,
+			    const gchar *package_name,
+			    PkResults *results,
+			    GError **error)
 {
 	const gchar *package_id_tmp;
 	gchar *package_id = NULL;
-	gboolean valid;
 	guint i;
 	PkPackage *package;
 	g_autoptr(GPtrArray) array = NULL;
 	g_autoptr(PkError) error_code = NULL;
-	g_autoptr(PkResults) results = NULL;
-	g_auto(GStrv) tmp = NULL;
-
-	/* have we passed a complete package_id? */
-	valid = pk_package_id_check (package_name);
-	if (valid)
-		return g_strdup (package_name);
-
-	/* split */
-	tmp = g_strsplit (package_name, ",", -1);
-
-	/* get the list of possibles */
-	results = pk_client_resolve (PK_CLIENT (ctx->task),
-				     ctx->filters, tmp,
-				     ctx->cancellable,
-				     pk_console_progress_cb, ctx,
-				     error);
-	if (results == NULL)
-		return NULL;
 
 	/* check error code */
 	error_code = pk_results_get_error_code (results);
@@ -918,24 +923,120 @@ pk_console_resolve_package (PkConsoleCtx *ctx, const gchar *package_name, GError
 	return g_strdup (pk_package_get_id (package));
 }
 
+/*
+ * pk_console_expand_wildcards:
+ *
+ * Replaces each "name*" with the package names starting with "name" from
+ * the list the daemon keeps. Everything else is left alone, and so is the
+ * wildcard if there is no list or nothing matches.
+ **/
 static gchar **
-pk_console_resolve_packages (PkConsoleCtx *ctx, gchar **packages, GError **error)
+pk_console_expand_wildcards (gchar **packages)
+{
+	g_autoptr(PkNameList) list = NULL;
+	g_autoptr(GPtrArray) array = g_ptr_array_new ();
+	gboolean tried = FALSE;
+
+	for (guint i = 0; packages[i] != NULL; i++) {
+		gsize len = strlen (packages[i]);
+		g_autofree gchar *prefix = NULL;
+		g_auto(GStrv) names = NULL;
+
+		if (len < 2 || packages[i][len - 1] != '*' ||
+		    strchr (packages[i], '*') != packages[i] + len - 1 ||
+		    pk_package_id_check (packages[i])) {
+			g_ptr_array_add (array, g_strdup (packages[i]));
+			continue;
+		}
+		if (!tried) {
+			list = pk_name_list_new_from_file (PK_NAME_LIST_FILENAME, NULL);
+			tried = TRUE;
+		}
+		if (list != NULL) {
+			prefix = g_strndup (packages[i], len - 1);
+			names = pk_name_list_complete (list, prefix);
+		}
+		if (names == NULL || names[0] == NULL) {
+			g_ptr_array_add (array, g_strdup (packages[i]));
+			continue;
+		}
+		for (guint j = 0; names[j] != NULL; j++)
+			g_ptr_array_add (array, g_strdup (names[j]));
+	}
+	g_ptr_array_add (array, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&array), FALSE);
+}
+
+/*
+ * pk_console_complete_names:
+ *
+ * Prints the package names starting with @prefix for the shell completion,
+ * without contacting, or starting, the daemon.
+ **/
+static gint
+pk_console_complete_names (const gchar *prefix)
+{
+	g_autoptr(PkNameList) list = NULL;
+	g_auto(GStrv) names = NULL;
+
+	list = pk_name_list_new_from_file (PK_NAME_LIST_FILENAME, NULL);
+	if (list == NULL)
+		return PK_EXIT_CODE_NOTHING_USEFUL;
+	names = pk_name_list_complete (list, prefix);
+	for (guint i = 0; names[i] != NULL; i++)
+		g_print ("%s\n", names[i]);
+	return EXIT_SUCCESS;
+}
+
+static gchar **
+pk_console_resolve_packages (PkConsoleCtx *ctx, gchar **packages_in, GError **error)
 {
 	guint i;
 	guint len;
+	guint idx;
 	gchar *package_id;
 	GError *error_local = NULL;
 	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GPtrArray) results = NULL;
+	g_autoptr(PkClientBatch) batch = NULL;
+	g_autofree guint *indexes = NULL;
+	g_auto(GStrv) packages = pk_console_expand_wildcards (packages_in);
 
 	/* get length */
 	len = g_strv_length (packages);
 	g_debug ("resolving %i packages", len);
 
-	/* resolve each package */
+	/* queue every name that is not already a package_id, so that they
+	 * are all looked up by the same transaction */
+	batch = pk_client_batch_new (PK_CLIENT (ctx->task));
+	indexes = g_new0 (guint, len);
+	for (i = 0; i < len; i++) {
+		g_auto(GStrv) tmp = NULL;
+		if (pk_package_id_check (packages[i]))
+			continue;
+		tmp = g_strsplit (packages[i], ",", -1);
+		indexes[i] = pk_client_batch_add_resolve (batch, ctx->filters, tmp) + 1;
+	}
+	if (pk_client_batch_get_size (batch) > 0) {
+		results = pk_client_batch_run (batch,
+					       ctx->cancellable,
+					       pk_console_progress_cb, ctx,
+					       error);
+		if (results == NULL)
+			return NULL;
+	}
+
+	/* pick a package for each name */
 	array = g_ptr_array_new ();
 	for (i = 0; i < len; i++) {
+		idx = indexes[i];
+		if (idx == 0) {
+			g_ptr_array_add (array, g_strdup (packages[i]));
+			continue;
+		}
 		package_id = pk_console_resolve_package (ctx,
 							 packages[i],
+							 g_ptr_array_index (results, idx - 1),
 							 &error_local);
 		if (package_id == NULL) {
 			if (g_error_matches (error_local,
@@ -1460,6 +1561,8 @@ pk_console_get_summary (PkConsoleCtx *ctx)
 	g_string_append_printf (string, "  %s\n", "offline-trigger");
 	g_string_append_printf (string, "  %s\n", "offline-cancel");
 	g_string_append_printf (string, "  %s\n", "offline-status");
+	g_string_append_printf (string, "  %s\n", "cache-export [file]");
+	g_string_append_printf (string, "  %s\n", "cache-import [file] [signature]");
 	g_string_append_printf (string, "  %s\n", "quit");
 	return g_string_free (string, FALSE);
 }
@@ -1539,6 +1642,82 @@ pk_console_offline_status (GError **error)
 	return TRUE;
 }
 
+/* the daemon streams the bundle through the descriptor, as root cannot
+ * be asked to write to a path of the caller */
+static gboolean
+pk_console_cache_bundle (const gchar *method,
+			 const gchar *filename,
+			 const gchar *signature,
+			 GError **error)
+{
+	gint fd;
+	g_autofree gchar *signature_default = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GUnixFDList) fd_list = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	if (filename == NULL) {
+		g_set_error (error, PK_CONSOLE_ERROR, PK_EXIT_CODE_SYNTAX_INVALID,
+			     /* TRANSLATORS: the user did not say which file */
+			     "%s", _("A filename is required"));
+		return FALSE;
+	}
+	if (g_strcmp0 (method, "ExportCache") == 0)
+		fd = g_open (filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	else
+		fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+	if (fd < 0) {
+		g_set_error (error, PK_CONSOLE_ERROR, PK_EXIT_CODE_FILE_NOT_FOUND,
+			     "%s: %s", filename, g_strerror (errno));
+		return FALSE;
+	}
+	fd_list = g_unix_fd_list_new_from_array (&fd, 1);
+
+	/* gpg --detach-sign writes it next to the bundle */
+	if (g_strcmp0 (method, "ImportCache") == 0) {
+		gint signature_fd;
+		gint ret;
+		if (signature == NULL) {
+			signature_default = g_strdup_printf ("%s.sig", filename);
+			signature = signature_default;
+		}
+		signature_fd = g_open (signature, O_RDONLY | O_CLOEXEC, 0);
+		if (signature_fd < 0) {
+			g_set_error (error, PK_CONSOLE_ERROR, PK_EXIT_CODE_FILE_NOT_FOUND,
+				     "%s: %s", signature, g_strerror (errno));
+			return FALSE;
+		}
+		ret = g_unix_fd_list_append (fd_list, signature_fd, error);
+		close (signature_fd);
+		if (ret < 0)
+			return FALSE;
+	}
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, error);
+	if (connection == NULL)
+		return FALSE;
+	value = g_dbus_connection_call_with_unix_fd_list_sync (connection,
+							       PK_DBUS_SERVICE,
+							       PK_DBUS_PATH,
+							       PK_DBUS_INTERFACE,
+							       method,
+							       g_strcmp0 (method, "ImportCache") == 0 ?
+								       g_variant_new ("(hh)", 0, 1) :
+								       g_variant_new ("(h)", 0),
+							       NULL,
+							       G_DBUS_CALL_FLAGS_ALLOW_INTERACTIVE_AUTHORIZATION,
+							       G_MAXINT,
+							       fd_list,
+							       NULL,
+							       NULL,
+							       error);
+	if (value == NULL) {
+		(*error)->code = PK_EXIT_CODE_TRANSACTION_FAILED;
+		return FALSE;
+	}
+	return TRUE;
+}
+
 static gboolean
 pk_console_set_proxy (PkConsoleCtx *ctx, GError **error)
 {
@@ -1682,6 +1861,12 @@ main (int argc, char *argv[])
 		goto out_last;
 	}
 
+	/* answered from the file the daemon keeps, so never start it */
+	if (argc >= 2 && g_strcmp0 (argv[1], "complete-names") == 0) {
+		retval_copy = pk_console_complete_names (argc > 2 ? argv[2] : "");
+		goto out_last;
+	}
+
 	/* we need the ctx->roles early, as we only show the user only what they can do */
 	ctx->control = pk_control_new ();
 	ret = pk_control_get_properties (ctx->control, ctx->cancellable, &error);
@@ -1732,6 +1917,7 @@ main (int argc, char *argv[])
 		      "allow-reinstall", allow_reinstall,
 		      "cache-age", cache_age,
 		      "only-trusted", !allow_untrusted,
+		      "progress-interval", 100,
 		      NULL);
 
 	/* set the proxy */
@@ -2301,6 +2487,20 @@ main (int argc, char *argv[])
 		if (!ret)
 			ctx->retval = error->code;
 
+	} else if (strcmp (mode, "cache-export") == 0) {
+
+		run_mainloop = FALSE;
+		ret = pk_console_cache_bundle ("ExportCache", value, NULL, &error);
+		if (!ret)
+			ctx->retval = error->code;
+
+	} else if (strcmp (mode, "cache-import") == 0) {
+
+		run_mainloop = FALSE;
+		ret = pk_console_cache_bundle ("ImportCache", value, details, &error);
+		if (!ret)
+			ctx->retval = error->code;
+
 	} else if (strcmp (mode, "get-transactions") == 0) {
 		pk_client_get_old_transactions_async (PK_CLIENT (ctx->task),
 						      10,
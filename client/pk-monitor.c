@@ -28,6 +28,7 @@
 #include <packagekit-glib2/packagekit.h>
 
 static PkClient *client = NULL;
+static PkBitfield roles = 0;
 
 static void
 pk_monitor_repo_list_changed_cb (PkControl *control, gpointer data)
@@ -235,13 +236,50 @@ pk_monitor_transaction_list_changed_cb (PkControl *control, gchar **transaction_
 		pk_monitor_get_daemon_state (control);
 }
 
+static void
+pk_monitor_adopt (const gchar *transaction_id)
+{
+	pk_client_adopt_async (client, transaction_id, NULL,
+			       (PkProgressCallback) pk_monitor_progress_cb, NULL,
+			       (GAsyncReadyCallback) pk_monitor_adopt_cb, NULL);
+}
+
+static void
+pk_monitor_get_progress_cb (PkClient *client_, GAsyncResult *res, gpointer user_data)
+{
+	PkRoleEnum role;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkProgress) progress = NULL;
+	g_autofree gchar *transaction_id = user_data;
+
+	progress = pk_client_get_progress_finish (client_, res, &error);
+	if (progress == NULL) {
+		g_debug ("failed to get progress of %s: %s",
+			 transaction_id, error->message);
+		return;
+	}
+
+	/* only adopt the transactions we were asked to watch */
+	role = pk_progress_get_role (progress);
+	if (!pk_bitfield_contain (roles, role)) {
+		g_debug ("ignoring %s as role %s",
+			 transaction_id, pk_role_enum_to_string (role));
+		return;
+	}
+	pk_monitor_adopt (transaction_id);
+}
+
 static void
 pk_monitor_transaction_list_added_cb (PkTransactionList *tlist, const gchar *transaction_id, gpointer user_data)
 {
 	g_debug ("added: %s", transaction_id);
-	pk_client_adopt_async (client, transaction_id, NULL,
-			       (PkProgressCallback) pk_monitor_progress_cb, user_data,
-			       (GAsyncReadyCallback) pk_monitor_adopt_cb, user_data);
+	if (roles != 0) {
+		pk_client_get_progress_async (client, transaction_id, NULL,
+					      (GAsyncReadyCallback) pk_monitor_get_progress_cb,
+					      g_strdup (transaction_id));
+	} else {
+		pk_monitor_adopt (transaction_id);
+	}
 	pk_monitor_list_print (tlist);
 }
 
@@ -265,6 +303,8 @@ main (int argc, char *argv[])
 {
 	GMainLoop *loop;
 	gboolean program_version = FALSE;
+	g_autofree gchar *signals = NULL;
+	g_autofree gchar *roles_str = NULL;
 	GOptionContext *context;
 	gint retval = EXIT_SUCCESS;
 	gchar **transaction_ids;
@@ -275,6 +315,12 @@ main (int argc, char *argv[])
 	const GOptionEntry options[] = {
 		{ "version", '\0', 0, G_OPTION_ARG_NONE, &program_version,
 			_("Show the program version and exit"), NULL},
+		{ "signals", '\0', 0, G_OPTION_ARG_STRING, &signals,
+			/* TRANSLATORS: command line argument, e.g. Package,ItemProgress */
+			_("Only receive these transaction signals"), "Package,ItemProgress" },
+		{ "roles", '\0', 0, G_OPTION_ARG_STRING, &roles_str,
+			/* TRANSLATORS: command line argument, e.g. install-packages */
+			_("Only monitor transactions with these roles"), "install-packages,update-packages" },
 		{ NULL}
 	};
 
@@ -321,6 +367,23 @@ main (int argc, char *argv[])
 			  G_CALLBACK (pk_monitor_transaction_list_removed_cb), NULL);
 
 	client = pk_client_new ();
+	if (signals != NULL) {
+		g_auto(GStrv) split = g_strsplit (signals, ",", -1);
+		pk_client_set_signal_filter (client, split);
+	}
+	if (roles_str != NULL) {
+		g_auto(GStrv) split = g_strsplit (roles_str, ",", -1);
+		for (i = 0; split[i] != NULL; i++) {
+			PkRoleEnum role = pk_role_enum_from_string (split[i]);
+			if (role == PK_ROLE_ENUM_UNKNOWN) {
+				/* TRANSLATORS: the user passed a role we don't know */
+				g_printerr ("%s: %s\n", _("Unknown role"), split[i]);
+				retval = EXIT_FAILURE;
+				goto out;
+			}
+			pk_bitfield_add (roles, role);
+		}
+	}
 
 	/* coldplug, but shouldn't be needed yet */
 	transaction_ids = pk_transaction_list_get_ids (tlist);
@@ -496,6 +496,9 @@ main (int argc, char *argv[])
 	task = pk_task_new ();
 	pk_client_set_interactive (PK_CLIENT (task), FALSE);
 
+	/* plymouth does not need more than a few updates a second */
+	pk_client_set_progress_interval (PK_CLIENT (task), 250);
+
 	if (g_strcmp0 (link, PK_OFFLINE_PREPARED_UPGRADE_FILENAME) == 0 &&
 	    g_file_test (PK_OFFLINE_PREPARED_UPGRADE_FILENAME, G_FILE_TEST_EXISTS)) {
 		/* do system upgrade */
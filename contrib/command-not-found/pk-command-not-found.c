@@ -30,8 +30,7 @@
 #include <glib/gi18n.h>
 #include <packagekit-glib2/packagekit.h>
 #include <packagekit-glib2/packagekit-private.h>
-
-#define PK_MAX_PATH_LEN 1023
+#include <packagekit-glib2/pk-command-index-private.h>
 
 typedef enum {
 	PK_CNF_POLICY_RUN,
@@ -58,154 +57,6 @@ static GCancellable *cancellable = NULL;
 /* bash reserved code */
 #define EXIT_COMMAND_NOT_FOUND	127
 
-/**
- *
- * Swizzle ordering, e.g. amke -> make
- **/
-static void
-pk_cnf_find_alternatives_swizzle (const gchar *cmd, guint len, GPtrArray *array)
-{
-	guint i;
-	gchar *possible;
-	gchar swap;
-
-	/*  */
-	for (i = 0; i < len-1; i++) {
-		possible = g_strdup (cmd);
-		swap = possible[i];
-		possible[i] = possible[i+1];
-		possible[i+1] = swap;
-		g_ptr_array_add (array, possible);
-	}
-}
-
-/**
- *
- * Replace some easily confused chars, e.g. gnome-power-managir to gnome-power-manager
- **/
-static void
-pk_cnf_find_alternatives_replace (const gchar *cmd, guint len, GPtrArray *array)
-{
-	guint i;
-	gchar *possible;
-	gchar temp;
-
-	/* replace some easily confused chars */
-	for (i = 0; i < len; i++) {
-		temp = cmd[i];
-		if (temp == 'i') {
-			possible = g_strdup (cmd);
-			possible[i] = 'e';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 'e') {
-			possible = g_strdup (cmd);
-			possible[i] = 'i';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 'i') {
-			possible = g_strdup (cmd);
-			possible[i] = 'o';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 'c') {
-			possible = g_strdup (cmd);
-			possible[i] = 's';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 's') {
-			possible = g_strdup (cmd);
-			possible[i] = 'c';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 's') {
-			possible = g_strdup (cmd);
-			possible[i] = 'z';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 'z') {
-			possible = g_strdup (cmd);
-			possible[i] = 's';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 'k') {
-			possible = g_strdup (cmd);
-			possible[i] = 'c';
-			g_ptr_array_add (array, possible);
-		}
-		if (temp == 'c') {
-			possible = g_strdup (cmd);
-			possible[i] = 'k';
-			g_ptr_array_add (array, possible);
-		}
-	}
-}
-
-/**
- *
- * Truncate first and last char, so lshall -> lshal
- **/
-static void
-pk_cnf_find_alternatives_truncate (const gchar *cmd, guint len, GPtrArray *array)
-{
-	guint i;
-	gchar *possible;
-
-	/* truncate last char */
-	possible = g_strdup (cmd);
-	possible[len-1] = '\0';
-	g_ptr_array_add (array, possible);
-
-	/* truncate first char */
-	possible = g_strdup (cmd);
-	for (i = 0; i < len-1; i++)
-		possible[i] = possible[i+1];
-	possible[len-1] = '\0';
-	g_ptr_array_add (array, possible);
-}
-
-/**
- *
- * Remove double chars, e.g. gnome-power-manaager -> gnome-power-manager
- **/
-static void
-pk_cnf_find_alternatives_remove_double (const gchar *cmd, guint len, GPtrArray *array)
-{
-	guint i, j;
-	gchar *possible;
-
-	for (i = 1; i < len; i++) {
-		if (cmd[i-1] == cmd[i]) {
-			possible = g_strdup (cmd);
-			for (j = i; j < len; j++)
-				possible[j] = possible[j+1];
-			possible[len-1] = '\0';
-			g_ptr_array_add (array, possible);
-		}
-	}
-}
-
-/**
- *
- * Fix British spellings, e.g. colourdiff -> colordiff
- **/
-static void
-pk_cnf_find_alternatives_locale (const gchar *cmd, guint len, GPtrArray *array)
-{
-	guint i, j;
-	gchar *possible;
-
-	for (i = 1; i < len; i++) {
-		if (cmd[i-1] == 'o' && cmd[i] == 'u') {
-			possible = g_strdup (cmd);
-			for (j = i; j < len; j++)
-				possible[j] = possible[j+1];
-			possible[len-1] = '\0';
-			g_ptr_array_add (array, possible);
-		}
-	}
-}
-
 /**
  *
  * Suggest Linux commands for Solaris commands
@@ -282,51 +133,6 @@ pk_cnf_find_alternatives_solaris (const gchar *cmd, guint len, GPtrArray *array)
 		g_ptr_array_add (array, g_strdup (tmp));
 }
 
-/**
- *
- * Remove double chars, e.g. Lshal -> lshal
- **/
-static void
-pk_cnf_find_alternatives_case (const gchar *cmd, guint len, GPtrArray *array)
-{
-	guint i;
-	gchar *possible;
-	gchar temp;
-
-	for (i = 0; i < len; i++) {
-		temp = g_ascii_tolower (cmd[i]);
-		if (temp != cmd[i]) {
-			possible = g_strdup (cmd);
-			possible[i] = temp;
-			g_ptr_array_add (array, possible);
-		}
-		temp = g_ascii_toupper (cmd[i]);
-		if (temp != cmd[i]) {
-			possible = g_strdup (cmd);
-			possible[i] = temp;
-			g_ptr_array_add (array, possible);
-		}
-	}
-
-	/* all lower */
-	possible = g_strdup (cmd);
-	for (i = 0; i < len; i++)
-		possible[i] = g_ascii_tolower (cmd[i]);
-	if (strcmp (possible, cmd) != 0)
-		g_ptr_array_add (array, possible);
-	else
-		g_free (possible);
-
-	/* all upper */
-	possible = g_strdup (cmd);
-	for (i = 0; i < len; i++)
-		possible[i] = g_ascii_toupper (cmd[i]);
-	if (strcmp (possible, cmd) != 0)
-		g_ptr_array_add (array, possible);
-	else
-		g_free (possible);
-}
-
 /**
  *
  * Generate a list of commands it might be
@@ -335,70 +141,44 @@ static GPtrArray *
 pk_cnf_find_alternatives (const gchar *cmd, guint len)
 {
 	GPtrArray *array;
-	const gchar *cmdt;
-	const gchar *cmdt2;
-	guint i, j;
-	gchar buffer_bin[PK_MAX_PATH_LEN+1];
-	gchar buffer_sbin[PK_MAX_PATH_LEN+1];
-	gboolean ret;
+	const gchar *dirs[] = { "/usr/bin", "/usr/sbin", NULL };
 	g_autoptr(GPtrArray) possible = NULL;
-	g_autoptr(GPtrArray) unique = NULL;
+	g_autoptr(GHashTable) unique = NULL;
 
 	array = g_ptr_array_new_with_free_func (g_free);
 	possible = g_ptr_array_new_with_free_func (g_free);
-	unique = g_ptr_array_new ();
-	pk_cnf_find_alternatives_swizzle (cmd, len, possible);
-	pk_cnf_find_alternatives_replace (cmd, len, possible);
-	if (len > 3)
-		pk_cnf_find_alternatives_truncate (cmd, len, possible);
-	pk_cnf_find_alternatives_remove_double (cmd, len, possible);
-	pk_cnf_find_alternatives_case (cmd, len, possible);
-	pk_cnf_find_alternatives_locale (cmd, len, possible);
+	unique = g_hash_table_new (g_str_hash, g_str_equal);
 	pk_cnf_find_alternatives_solaris (cmd, len, possible);
 
-	/* remove duplicates using a helper array */
-	for (i = 0; i < possible->len; i++) {
-		cmdt = g_ptr_array_index (possible, i);
-		ret = TRUE;
-		for (j=0; j<unique->len; j++) {
-			cmdt2 = g_ptr_array_index (unique, j);
-			if (strcmp (cmdt, cmdt2) == 0) {
-				ret = FALSE;
-				break;
-			}
+	/* everything within one edit, which is a single pass over the
+	 * directory listing rather than a stat for every spelling */
+	for (guint i = 0; dirs[i] != NULL; i++) {
+		const gchar *name;
+		g_autoptr(GDir) dir = g_dir_open (dirs[i], 0, NULL);
+		if (dir == NULL)
+			continue;
+		while ((name = g_dir_read_name (dir)) != NULL) {
+			if (pk_command_index_is_similar (cmd, name))
+				g_ptr_array_add (possible, g_build_filename (dirs[i], name, NULL));
 		}
-		/* only add if not duplicate */
-		if (ret)
-			g_ptr_array_add (unique, (gpointer) cmdt);
 	}
 
-	/* ITS4: ignore, source is constant size */
-	strncpy (buffer_bin, "/usr/bin/", PK_MAX_PATH_LEN);
-
-	/* ITS4: ignore, source is constant size */
-	strncpy (buffer_sbin, "/usr/sbin/", PK_MAX_PATH_LEN);
-
-	/* remove any that exist (fast path) */
-	for (i = 0; i < unique->len; i++) {
-		cmdt = g_ptr_array_index (unique, i);
-
-		/* ITS4: ignore, size is checked */
-		strncpy (&buffer_bin[9], cmdt, PK_MAX_PATH_LEN-9);
-
-		/* ITS4: ignore, size is checked */
-		strncpy (&buffer_sbin[10], cmdt, PK_MAX_PATH_LEN-10);
-
-		/* does file exist in bindir (common case) */
-		ret = g_file_test (buffer_bin, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_EXECUTABLE);
-		if (ret) {
-			g_ptr_array_add (array, g_strdup (cmdt));
+	/* only keep the ones that can be run, without duplicates */
+	for (guint i = 0; i < possible->len; i++) {
+		const gchar *cmdt = g_ptr_array_index (possible, i);
+		g_autofree gchar *basename = g_path_get_basename (cmdt);
+		if (g_hash_table_contains (unique, basename))
 			continue;
+		if (g_path_is_absolute (cmdt)) {
+			if (!g_file_test (cmdt, G_FILE_TEST_IS_EXECUTABLE))
+				continue;
+		} else {
+			g_autofree gchar *path = g_find_program_in_path (cmdt);
+			if (path == NULL)
+				continue;
 		}
-
-		/* does file exist in sbindir */
-		ret = g_file_test (buffer_sbin, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_EXECUTABLE);
-		if (ret)
-			g_ptr_array_add (array, g_strdup (cmdt));
+		g_hash_table_add (unique, (gpointer) basename);
+		g_ptr_array_add (array, g_steal_pointer (&basename));
 	}
 	return array;
 }
@@ -474,6 +254,14 @@ pk_cnf_find_available (const gchar *cmd, guint max_search_time)
 	PkResults *results = NULL;
 	PkError *error_code = NULL;
 	guint cancel_id;
+	g_autoptr(GError) error_index = NULL;
+	g_autoptr(PkCommandIndex) index = NULL;
+
+	/* the daemon keeps an index of the available commands */
+	index = pk_command_index_new_from_file (PK_COMMAND_INDEX_FILENAME, &error_index);
+	if (index != NULL)
+		return pk_command_index_lookup (index, cmd);
+	g_debug ("not using the command index: %s", error_index->message);
 
 	/* create new array of full paths */
 	len = g_strv_length ((gchar **)prefixes);
@@ -535,6 +323,35 @@ out:
 	return package_ids;
 }
 
+/**
+ *
+ * Show the commands with a similar name that could be installed
+ **/
+static void
+pk_cnf_find_similar_available (const gchar *cmd)
+{
+	g_auto(GStrv) names = NULL;
+	g_autoptr(PkCommandIndex) index = NULL;
+
+	index = pk_command_index_new_from_file (PK_COMMAND_INDEX_FILENAME, NULL);
+	if (index == NULL)
+		return;
+	names = pk_command_index_find_similar (index, cmd);
+	if (names == NULL)
+		return;
+
+	/* TRANSLATORS: show the user a list of commands they could install */
+	g_printerr ("%s:\n", _("Similar commands can be installed"));
+	for (guint i = 0; names[i] != NULL; i++) {
+		g_auto(GStrv) package_ids = pk_command_index_lookup (index, names[i]);
+		g_auto(GStrv) parts = NULL;
+		if (package_ids == NULL)
+			continue;
+		parts = pk_package_id_split (package_ids[0]);
+		g_printerr ("'%s'\t(%s)\n", names[i], parts[PK_PACKAGE_ID_NAME]);
+	}
+}
+
 static PkCnfPolicy
 pk_cnf_get_policy_from_string (const gchar *policy_text)
 {
@@ -851,10 +668,14 @@ main (int argc, char *argv[])
 
 	/* only search using PackageKit if configured to do so */
 	} else if (config->software_source_search &&
-		   pk_cnf_is_backend_fast_enough_to_do_search ()) {
+		   (g_file_test (PK_COMMAND_INDEX_FILENAME, G_FILE_TEST_EXISTS) ||
+		    pk_cnf_is_backend_fast_enough_to_do_search ())) {
 		package_ids = pk_cnf_find_available (argv[1], config->max_search_time);
-		if (package_ids == NULL)
+		if (package_ids == NULL) {
+			if (config->similar_name_search)
+				pk_cnf_find_similar_available (argv[1]);
 			goto out;
+		}
 		len = g_strv_length (package_ids);
 		if (len == 1) {
 			parts = pk_package_id_split (package_ids[0]);
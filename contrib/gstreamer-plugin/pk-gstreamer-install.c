@@ -22,9 +22,24 @@
 
 #include <gst/gst.h>
 #include <gst/pbutils/install-plugins.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include <sys/utsname.h>
 #include <packagekit-glib2/packagekit.h>
+#include <packagekit-glib2/pk-offline-private.h>
+
+/* how long a codec nothing provides is remembered, even if the package
+ * metadata does not look changed */
+#define PK_GST_NOT_FOUND_MAX_AGE	(24 * 60 * 60) /* s */
+
+/* the directories the backends replace the package metadata in */
+static const gchar *pk_gst_metadata_paths[] = {
+	"/var/cache/PackageKit",
+	"/var/cache/dnf",
+	"/var/lib/apt/lists",
+	"/var/cache/zypp/solv",
+	"/var/lib/pacman/sync",
+	NULL };
 
 typedef struct {
 	GstStructure	*structure;
@@ -330,6 +345,114 @@ pk_gst_dbus_install_resources_compat (gchar **resources, gint xid, GError **erro
 	return FALSE;
 }
 
+static gchar *
+pk_gst_get_metadata_fingerprint (void)
+{
+	GString *str = g_string_new (NULL);
+	g_autofree gchar *package_db = pk_offline_get_package_db_fingerprint ();
+
+	g_string_append (str, package_db);
+	for (guint i = 0; pk_gst_metadata_paths[i] != NULL; i++) {
+		GStatBuf buf;
+		if (g_stat (pk_gst_metadata_paths[i], &buf) != 0)
+			continue;
+		g_string_append_printf (str, "%s:%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ";",
+					pk_gst_metadata_paths[i],
+					(guint64) buf.st_ino,
+					(gint64) buf.st_mtime);
+	}
+	return g_string_free (str, FALSE);
+}
+
+/**
+ * pk_gst_find_providers:
+ *
+ * Media players ask again every time they hit the codec, so remember the
+ * provides no package has and do not show the installer for them until
+ * the package metadata changes.
+ *
+ * Return value: %FALSE if nothing provides any of the codecs
+ **/
+static gboolean
+pk_gst_find_providers (GPtrArray *provides)
+{
+	gboolean found = FALSE;
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *fingerprint = NULL;
+	g_autofree gchar *fingerprint_old = NULL;
+	g_autoptr(GKeyFile) keyfile = g_key_file_new ();
+	g_autoptr(PkClient) client = NULL;
+
+	filename = g_build_filename (g_get_user_cache_dir (),
+				     "PackageKit",
+				     "gstreamer-provides",
+				     NULL);
+	fingerprint = pk_gst_get_metadata_fingerprint ();
+	if (g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL)) {
+		fingerprint_old = g_key_file_get_string (keyfile, "cache", "Fingerprint", NULL);
+		if (g_strcmp0 (fingerprint, fingerprint_old) != 0)
+			g_key_file_remove_group (keyfile, "not-found", NULL);
+	}
+	g_key_file_set_string (keyfile, "cache", "Fingerprint", fingerprint);
+
+	for (guint i = 0; i < provides->len; i++) {
+		const gchar *provide = g_ptr_array_index (provides, i);
+		gchar *values[] = { (gchar *) provide, NULL };
+		gint64 stamp;
+		PkError *error_code;
+		g_autofree gchar *checksum = NULL;
+		g_autoptr(GError) error = NULL;
+		g_autoptr(GPtrArray) packages = NULL;
+		g_autoptr(PkResults) results = NULL;
+
+		checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, provide, -1);
+		stamp = g_key_file_get_int64 (keyfile, "not-found", checksum, NULL);
+		if (stamp > 0 && now - stamp < PK_GST_NOT_FOUND_MAX_AGE) {
+			g_message ("PackageKit: nothing provided %s before", provide);
+			continue;
+		}
+
+		/* the daemon answers repeated lookups from its query cache */
+		if (client == NULL) {
+			client = pk_client_new ();
+			g_object_set (client,
+				      "cache-age", G_MAXUINT,
+				      "interactive", FALSE,
+				      "background", FALSE,
+				      NULL);
+		}
+		results = pk_client_what_provides (client,
+						   pk_bitfield_value (PK_FILTER_ENUM_NOT_INSTALLED),
+						   values, NULL, NULL, NULL, &error);
+		if (results == NULL) {
+			/* let the installer deal with it */
+			g_message ("PackageKit: failed to look up %s: %s", provide, error->message);
+			found = TRUE;
+			continue;
+		}
+		error_code = pk_results_get_error_code (results);
+		if (error_code != NULL) {
+			g_object_unref (error_code);
+			found = TRUE;
+			continue;
+		}
+		packages = pk_results_get_package_array (results);
+		if (packages->len > 0) {
+			found = TRUE;
+			continue;
+		}
+		g_key_file_set_int64 (keyfile, "not-found", checksum, now);
+	}
+
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0700);
+	if (!g_key_file_save_to_file (keyfile, filename, NULL))
+		g_message ("PackageKit: failed to save %s", filename);
+	return found;
+}
+
 int
 main (int argc, gchar **argv)
 {
@@ -346,6 +469,7 @@ main (int argc, gchar **argv)
 	g_autofree gchar *interaction = NULL;
 	g_autofree gchar *startup_id = NULL;
 	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GPtrArray) provides = NULL;
 	g_auto(GStrv) resources = NULL;
 
 	const GOptionEntry options[] = {
@@ -381,6 +505,7 @@ main (int argc, gchar **argv)
 	suffix = pk_gst_get_arch_suffix ();
 
 	array = g_ptr_array_new_with_free_func (g_free);
+	provides = g_ptr_array_new_with_free_func (g_free);
 	len = g_strv_length (codecs);
 
 	/* process argv */
@@ -423,6 +548,7 @@ main (int argc, gchar **argv)
 		/* "encode" */
 		resource = g_strdup_printf ("%s|%s", info->codec_name, type);
 		g_ptr_array_add (array, resource);
+		g_ptr_array_add (provides, type);
 
 		/* free codec structure */
 		pk_gst_codec_free (info);
@@ -434,6 +560,12 @@ main (int argc, gchar **argv)
 		return GST_INSTALL_PLUGINS_ERROR;
 	}
 
+	/* nothing to install, so do not bother the session installer */
+	if (!pk_gst_find_providers (provides)) {
+		g_message ("PackageKit: no package provides the codecs");
+		return GST_INSTALL_PLUGINS_NOT_FOUND;
+	}
+
 	/* convert to a GStrv */
 	resources = pk_ptr_array_to_strv (array);
 
@@ -29,6 +29,11 @@
 #include <pango/pangocairo.h>
 #include <gtk/gtk.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
 
 static gchar *
 pk_guess_application_id (void)
@@ -51,6 +56,8 @@ pk_guess_application_id (void)
  * Invoke the PackageKit InstallFonts method over D-BUS
  **/
 
+static void pk_requested_tags_save (GPtrArray *font_tags);
+
 static void
 pk_install_fonts_method_finished_cb (GObject *source_object,
 				     GAsyncResult *res,
@@ -58,6 +65,7 @@ pk_install_fonts_method_finished_cb (GObject *source_object,
 {
 	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) font_tags = user_data;
 	g_autoptr(GVariant) value = NULL;
 
 	value = g_dbus_proxy_call_finish (proxy, res, &error);
@@ -65,6 +73,9 @@ pk_install_fonts_method_finished_cb (GObject *source_object,
 		g_warning ("Error occurred during install: %s", error->message);
 		return;
 	}
+
+	/* only once the request was handled, so a failed one is retried */
+	pk_requested_tags_save (font_tags);
 	/* XXX Make gtk/pango reload fonts? */
 }
 
@@ -78,12 +89,71 @@ pk_make_platform_data (void)
 
 static GPtrArray *tags;
 
+/* every tag this process has asked for */
+static GHashTable *requested_tags;
+
+/**
+ * The tags any application asked for in this session, so that each
+ * missing font is only offered once however many applications need it
+ **/
+static gchar *
+pk_requested_tags_get_filename (void)
+{
+	return g_build_filename (g_get_user_runtime_dir (),
+				 "PackageKit",
+				 "requested-font-tags",
+				 NULL);
+}
+
+static GPtrArray *
+pk_requested_tags_filter (gchar **font_tags)
+{
+	GPtrArray *array = g_ptr_array_new_with_free_func (g_free);
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *filename = pk_requested_tags_get_filename ();
+	g_auto(GStrv) lines = NULL;
+
+	if (g_file_get_contents (filename, &data, NULL, NULL))
+		lines = g_strsplit (data, "\n", -1);
+	for (guint i = 0; font_tags[i] != NULL; i++) {
+		if (lines != NULL && g_strv_contains ((const gchar * const *) lines, font_tags[i])) {
+			g_debug ("%s was already requested in this session", font_tags[i]);
+			continue;
+		}
+		g_ptr_array_add (array, g_strdup (font_tags[i]));
+	}
+	return array;
+}
+
+static void
+pk_requested_tags_save (GPtrArray *font_tags)
+{
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *filename = pk_requested_tags_get_filename ();
+	g_autoptr(GString) str = g_string_new (NULL);
+	int fd;
+
+	for (guint i = 0; i < font_tags->len && g_ptr_array_index (font_tags, i) != NULL; i++)
+		g_string_append_printf (str, "%s\n", (const gchar *) g_ptr_array_index (font_tags, i));
+
+	/* a single appending write, so concurrent writers do not interleave */
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0700);
+	fd = g_open (filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0)
+		return;
+	if (write (fd, str->str, str->len) != (gssize) str->len)
+		g_debug ("failed to save requested font tags: %s", g_strerror (errno));
+	close (fd);
+}
+
 static gboolean
 pk_install_fonts_idle_cb (gpointer data G_GNUC_UNUSED)
 {
 	g_autofree gchar *application_id = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GDBusProxy) proxy = NULL;
+	g_autoptr(GPtrArray) wanted = NULL;
 	g_auto(GStrv) font_tags = NULL;
 
 	g_return_val_if_fail (tags->len > 0, FALSE);
@@ -93,6 +163,12 @@ pk_install_fonts_idle_cb (gpointer data G_GNUC_UNUSED)
 	font_tags = (gchar **) g_ptr_array_free (tags, FALSE);
 	tags = NULL;
 
+	/* another application may have asked already */
+	wanted = pk_requested_tags_filter (font_tags);
+	if (wanted->len == 0)
+		return FALSE;
+	g_ptr_array_add (wanted, NULL);
+
 	application_id = pk_guess_application_id ();
 
 	/* get proxy */
@@ -110,11 +186,11 @@ pk_install_fonts_idle_cb (gpointer data G_GNUC_UNUSED)
 		return FALSE;
 	}
 
-	/* invoke the method */
+	/* invoke the method, the callback saves the tags */
 	g_dbus_proxy_call (proxy,
 			   "InstallFontconfigResources",
 			   g_variant_new ("(^a&sss@a{sv})",
-					  font_tags,
+					  (gchar **) wanted->pdata,
 					  "hide-finished",
 					   application_id ? application_id : "",
 					   pk_make_platform_data ()),
@@ -122,7 +198,7 @@ pk_install_fonts_idle_cb (gpointer data G_GNUC_UNUSED)
 			   60 * 60 * 1000, /* 1 hour */
 			   NULL,
 			   pk_install_fonts_method_finished_cb,
-			   NULL);
+			   g_ptr_array_ref (wanted));
 
 	g_debug ("InstallFontconfigResources method invoked");
 	return FALSE;
@@ -132,6 +208,14 @@ static void
 queue_install_fonts_tag (const char *tag)
 {
 	guint idle_id;
+
+	/* the D-Bus round trip is far more expensive than the lookup */
+	if (requested_tags == NULL)
+		requested_tags = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	if (g_hash_table_contains (requested_tags, tag))
+		return;
+	g_hash_table_add (requested_tags, g_strdup (tag));
+
 	if (tags == NULL) {
 		tags = g_ptr_array_new ();
 		idle_id = g_idle_add (pk_install_fonts_idle_cb, NULL);
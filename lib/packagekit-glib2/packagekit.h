@@ -26,6 +26,7 @@
 
 #include <packagekit-glib2/pk-category.h>
 #include <packagekit-glib2/pk-client.h>
+#include <packagekit-glib2/pk-client-batch.h>
 #include <packagekit-glib2/pk-client-sync.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-control.h>
@@ -41,6 +42,7 @@
 #include <packagekit-glib2/pk-media-change-required.h>
 #include <packagekit-glib2/pk-item-progress.h>
 #include <packagekit-glib2/pk-offline.h>
+#include <packagekit-glib2/pk-package-array.h>
 #include <packagekit-glib2/pk-package-id.h>
 #include <packagekit-glib2/pk-package-ids.h>
 #include <packagekit-glib2/pk-package-sack.h>
@@ -0,0 +1,259 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Times the primitives that every result set goes through, at 10k, 100k
+ * and 1M items, and prints the operations per second as JSON. Nothing
+ * here needs a daemon, so two builds can be compared directly.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <glib.h>
+
+#include "pk-bitfield.h"
+#include "pk-enum.h"
+#include "pk-package.h"
+#include "pk-package-id.h"
+#include "pk-package-sack.h"
+#include "pk-results.h"
+
+/* lookups against the sack are capped, a linear find at 1M is the point */
+#define PK_BENCH_FIND_MAX	10000
+
+typedef struct {
+	GString			*json;
+	gboolean		 first;
+	gint64			 start;
+} PkBench;
+
+/* stops the compiler dropping work whose result is not used */
+static volatile guint pk_bench_sink = 0;
+
+static void
+pk_bench_start (PkBench *bench)
+{
+	bench->start = g_get_monotonic_time ();
+}
+
+static void
+pk_bench_stop (PkBench *bench, const gchar *name, guint scale, guint ops)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	gdouble elapsed = (gdouble) MAX (g_get_monotonic_time () - bench->start, 1) /
+			  G_USEC_PER_SEC;
+
+	g_string_append_printf (bench->json,
+				"%s    { \"name\": \"%s\", \"scale\": %u, \"ops\": %u, ",
+				bench->first ? "" : ",\n", name, scale, ops);
+	g_string_append_printf (bench->json, "\"ops-per-second\": %s, ",
+				g_ascii_formatd (buf, sizeof (buf), "%.0f", ops / elapsed));
+	g_string_append_printf (bench->json, "\"ns-per-op\": %s }",
+				g_ascii_formatd (buf, sizeof (buf), "%.1f",
+						 elapsed * 1e9 / MAX (ops, 1)));
+	bench->first = FALSE;
+}
+
+static gchar **
+pk_bench_make_package_ids (guint scale)
+{
+	gchar **package_ids = g_new0 (gchar *, scale + 1);
+	for (guint i = 0; i < scale; i++) {
+		g_autofree gchar *name = g_strdup_printf ("package%u", i);
+		package_ids[i] = pk_package_id_build (name, "1.2.3-4.fc40", "x86_64", "fedora");
+	}
+	return package_ids;
+}
+
+static void
+pk_bench_package_id (PkBench *bench, gchar **package_ids, guint scale)
+{
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		g_auto(GStrv) split = pk_package_id_split (package_ids[i]);
+		pk_bench_sink += split != NULL;
+	}
+	pk_bench_stop (bench, "pk_package_id_split", scale, scale);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++)
+		pk_bench_sink += pk_package_id_check (package_ids[i]);
+	pk_bench_stop (bench, "pk_package_id_check", scale, scale);
+}
+
+static void
+pk_bench_enum (PkBench *bench, guint scale)
+{
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		const gchar *tmp = pk_role_enum_to_string (i % PK_ROLE_ENUM_LAST);
+		pk_bench_sink += pk_role_enum_from_string (tmp);
+	}
+	pk_bench_stop (bench, "pk_role_enum_to_string+from_string", scale, scale);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		const gchar *tmp = pk_info_enum_to_string (i % PK_INFO_ENUM_LAST);
+		pk_bench_sink += pk_info_enum_from_string (tmp);
+	}
+	pk_bench_stop (bench, "pk_info_enum_to_string+from_string", scale, scale);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		const gchar *tmp = pk_status_enum_to_string (i % PK_STATUS_ENUM_LAST);
+		pk_bench_sink += pk_status_enum_from_string (tmp);
+	}
+	pk_bench_stop (bench, "pk_status_enum_to_string+from_string", scale, scale);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		const gchar *tmp = pk_filter_enum_to_string (i % PK_FILTER_ENUM_LAST);
+		pk_bench_sink += pk_filter_enum_from_string (tmp);
+	}
+	pk_bench_stop (bench, "pk_filter_enum_to_string+from_string", scale, scale);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		const gchar *tmp = pk_error_enum_to_string (i % PK_ERROR_ENUM_LAST);
+		pk_bench_sink += pk_error_enum_from_string (tmp);
+	}
+	pk_bench_stop (bench, "pk_error_enum_to_string+from_string", scale, scale);
+}
+
+static void
+pk_bench_bitfield (PkBench *bench, guint scale)
+{
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		pk_bench_sink += pk_bitfield_from_enums (PK_FILTER_ENUM_INSTALLED,
+							 PK_FILTER_ENUM_ARCH,
+							 PK_FILTER_ENUM_NEWEST,
+							 -1) != 0;
+	}
+	pk_bench_stop (bench, "pk_bitfield_from_enums", scale, scale);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++)
+		pk_bench_sink += pk_filter_bitfield_from_string ("installed;arch;newest") != 0;
+	pk_bench_stop (bench, "pk_filter_bitfield_from_string", scale, scale);
+}
+
+static GPtrArray *
+pk_bench_package (PkBench *bench, gchar **package_ids, guint scale)
+{
+	GPtrArray *packages = g_ptr_array_new_full (scale, g_object_unref);
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++) {
+		PkPackage *package = pk_package_new ();
+		pk_package_set_id (package, package_ids[i], NULL);
+		g_ptr_array_add (packages, package);
+	}
+	pk_bench_stop (bench, "pk_package_new+set_id", scale, scale);
+	return packages;
+}
+
+static void
+pk_bench_results (PkBench *bench, GPtrArray *packages, guint scale)
+{
+	g_autoptr(PkResults) results = pk_results_new ();
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++)
+		pk_results_add_package (results, g_ptr_array_index (packages, i));
+	pk_bench_stop (bench, "pk_results_add_package", scale, scale);
+}
+
+static void
+pk_bench_sack (PkBench *bench, GPtrArray *packages, gchar **package_ids, guint scale)
+{
+	guint find = MIN (scale, PK_BENCH_FIND_MAX);
+	g_autoptr(PkPackageSack) sack = pk_package_sack_new ();
+
+	pk_bench_start (bench);
+	for (guint i = 0; i < scale; i++)
+		pk_package_sack_add_package (sack, g_ptr_array_index (packages, i));
+	pk_bench_stop (bench, "pk_package_sack_add_package", scale, scale);
+
+	/* from the far end, which a linear search sees last */
+	pk_bench_start (bench);
+	for (guint i = 0; i < find; i++) {
+		PkPackage *package = pk_package_sack_find_by_id (sack, package_ids[scale - 1 - i]);
+		pk_bench_sink += package != NULL;
+		g_clear_object (&package);
+	}
+	pk_bench_stop (bench, "pk_package_sack_find_by_id", scale, find);
+
+	pk_bench_start (bench);
+	pk_package_sack_sort (sack, PK_PACKAGE_SACK_SORT_TYPE_PACKAGE_ID);
+	pk_bench_stop (bench, "pk_package_sack_sort:package-id", scale, scale);
+
+	pk_bench_start (bench);
+	pk_package_sack_sort (sack, PK_PACKAGE_SACK_SORT_TYPE_NAME);
+	pk_bench_stop (bench, "pk_package_sack_sort:name", scale, scale);
+}
+
+int
+main (int argc, char *argv[])
+{
+	gint max_scale = 1000000;
+	GOptionContext *context;
+	PkBench bench = { 0 };
+	g_autoptr(GError) error = NULL;
+
+	const GOptionEntry options[] = {
+		{ "max-scale", 'm', 0, G_OPTION_ARG_INT, &max_scale,
+			"Largest number of items, default 1000000", "N" },
+		{ NULL}
+	};
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "PackageKit Library Benchmark");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse options: %s\n", error->message);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	bench.json = g_string_new ("{\n");
+	bench.first = TRUE;
+	g_string_append_printf (bench.json, "  \"version\": \"%s\",\n", PROJECT_VERSION);
+	g_string_append (bench.json, "  \"results\": [\n");
+	for (guint scale = 10000; scale <= (guint) max_scale; scale *= 10) {
+		g_auto(GStrv) package_ids = pk_bench_make_package_ids (scale);
+		g_autoptr(GPtrArray) packages = NULL;
+
+		pk_bench_package_id (&bench, package_ids, scale);
+		pk_bench_enum (&bench, scale);
+		pk_bench_bitfield (&bench, scale);
+		packages = pk_bench_package (&bench, package_ids, scale);
+		pk_bench_results (&bench, packages, scale);
+		pk_bench_sack (&bench, packages, package_ids, scale);
+	}
+	g_string_append (bench.json, "\n  ]\n}\n");
+
+	g_print ("%s", bench.json->str);
+	g_string_free (bench.json, TRUE);
+	return pk_bench_sink > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
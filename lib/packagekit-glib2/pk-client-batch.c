@@ -0,0 +1,653 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:pk-client-batch
+ * @short_description: Run many small queries as few transactions
+ *
+ * A #PkClientBatch collects queries such as resolving package names and
+ * sends all the queries of the same kind as a single transaction, so
+ * resolving thousands of names costs one transaction rather than one each.
+ * The results are split up again so that every query gets its own
+ * #PkResults, in the order the queries were added. Anything the backend
+ * returned that matches none of the queries, e.g. a package found by
+ * what it provides, goes to the first query of the transaction only.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <gio/gio.h>
+
+#include <packagekit-glib2/pk-client-batch.h>
+#include <packagekit-glib2/pk-common-private.h>
+#include <packagekit-glib2/pk-package-id.h>
+#include <packagekit-glib2/pk-results.h>
+
+static void     pk_client_batch_finalize	(GObject     *object);
+
+#define PK_CLIENT_BATCH_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_CLIENT_BATCH, PkClientBatchPrivate))
+
+typedef struct {
+	PkRoleEnum		 role;
+	PkBitfield		 filters;
+	gchar			**values;
+	PkResults		*results;
+} PkClientBatchRequest;
+
+typedef struct _PkClientBatchState PkClientBatchState;
+
+/* all the requests sent as one transaction */
+typedef struct {
+	PkClientBatchState	*state;
+	PkRoleEnum		 role;
+	PkBitfield		 filters;
+	GPtrArray		*values;	/* borrowed from the requests */
+	GHashTable		*targets;	/* value:GPtrArray of PkClientBatchRequest */
+	GPtrArray		*requests;	/* PkClientBatchRequest */
+	GPtrArray		*unmatched;	/* the first of @requests */
+} PkClientBatchGroup;
+
+struct _PkClientBatchState {
+	PkClientBatch		*batch;
+	GSimpleAsyncResult	*res;
+	GPtrArray		*groups;	/* PkClientBatchGroup */
+	guint			 pending;
+	GError			*error;
+};
+
+/**
+ * PkClientBatchPrivate:
+ *
+ * Private #PkClientBatch data
+ **/
+struct _PkClientBatchPrivate
+{
+	PkClient		*client;
+	GPtrArray		*requests;	/* PkClientBatchRequest */
+	gboolean		 running;
+};
+
+G_DEFINE_TYPE (PkClientBatch, pk_client_batch, G_TYPE_OBJECT)
+
+static void
+pk_client_batch_request_free (PkClientBatchRequest *request)
+{
+	g_strfreev (request->values);
+	g_clear_object (&request->results);
+	g_slice_free (PkClientBatchRequest, request);
+}
+
+static void
+pk_client_batch_group_free (PkClientBatchGroup *group)
+{
+	g_ptr_array_unref (group->values);
+	g_hash_table_unref (group->targets);
+	g_ptr_array_unref (group->requests);
+	g_ptr_array_unref (group->unmatched);
+	g_slice_free (PkClientBatchGroup, group);
+}
+
+static guint
+pk_client_batch_add (PkClientBatch *batch,
+		     PkRoleEnum role,
+		     PkBitfield filters,
+		     gchar **values)
+{
+	PkClientBatchRequest *request;
+
+	request = g_slice_new0 (PkClientBatchRequest);
+	request->role = role;
+	request->filters = filters;
+	request->values = g_strdupv (values);
+	g_ptr_array_add (batch->priv->requests, request);
+	return batch->priv->requests->len - 1;
+}
+
+/**
+ * pk_client_batch_add_resolve:
+ * @batch: a valid #PkClientBatch instance
+ * @filters: a #PkBitfield such as %PK_FILTER_ENUM_GUI | %PK_FILTER_ENUM_FREE or %PK_FILTER_ENUM_NONE
+ * @packages: (array zero-terminated=1): an array of package names to resolve
+ *
+ * Adds a query resolving package names, like pk_client_resolve_async().
+ * All the resolve queries using the same filters are sent together.
+ *
+ * Return value: the index of the query in the results
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_client_batch_add_resolve (PkClientBatch *batch,
+			     PkBitfield filters,
+			     gchar **packages)
+{
+	g_return_val_if_fail (PK_IS_CLIENT_BATCH (batch), G_MAXUINT);
+	g_return_val_if_fail (packages != NULL, G_MAXUINT);
+	g_return_val_if_fail (!batch->priv->running, G_MAXUINT);
+	return pk_client_batch_add (batch, PK_ROLE_ENUM_RESOLVE, filters, packages);
+}
+
+/**
+ * pk_client_batch_add_get_details:
+ * @batch: a valid #PkClientBatch instance
+ * @package_ids: (array zero-terminated=1): a null terminated array of package_id structures
+ *
+ * Adds a query getting the details of packages, like
+ * pk_client_get_details_async(). All the details queries are sent together.
+ *
+ * Return value: the index of the query in the results
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_client_batch_add_get_details (PkClientBatch *batch, gchar **package_ids)
+{
+	g_return_val_if_fail (PK_IS_CLIENT_BATCH (batch), G_MAXUINT);
+	g_return_val_if_fail (package_ids != NULL, G_MAXUINT);
+	g_return_val_if_fail (!batch->priv->running, G_MAXUINT);
+	return pk_client_batch_add (batch, PK_ROLE_ENUM_GET_DETAILS, 0, package_ids);
+}
+
+/**
+ * pk_client_batch_get_size:
+ * @batch: a valid #PkClientBatch instance
+ *
+ * Gets the number of queries added to the batch.
+ *
+ * Return value: the number of queries
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_client_batch_get_size (PkClientBatch *batch)
+{
+	g_return_val_if_fail (PK_IS_CLIENT_BATCH (batch), 0);
+	return batch->priv->requests->len;
+}
+
+/*
+ * pk_client_batch_add_target:
+ **/
+static void
+pk_client_batch_add_target (PkClientBatchGroup *group,
+			    const gchar *value,
+			    PkClientBatchRequest *request)
+{
+	GPtrArray *targets;
+
+	targets = g_hash_table_lookup (group->targets, value);
+	if (targets == NULL) {
+		targets = g_ptr_array_new ();
+		g_hash_table_insert (group->targets, (gpointer) value, targets);
+		g_ptr_array_add (group->values, (gpointer) value);
+	}
+
+	/* the same value twice in one request */
+	if (targets->len > 0 &&
+	    g_ptr_array_index (targets, targets->len - 1) == request)
+		return;
+	g_ptr_array_add (targets, request);
+}
+
+/*
+ * pk_client_batch_build_groups:
+ **/
+static GPtrArray *
+pk_client_batch_build_groups (PkClientBatch *batch)
+{
+	GPtrArray *groups;
+	guint i;
+	guint j;
+
+	groups = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_client_batch_group_free);
+	for (i = 0; i < batch->priv->requests->len; i++) {
+		PkClientBatchRequest *request = g_ptr_array_index (batch->priv->requests, i);
+		PkClientBatchGroup *group = NULL;
+
+		g_clear_object (&request->results);
+		request->results = pk_results_new ();
+		g_object_set (request->results,
+			      "role", request->role,
+			      NULL);
+
+		/* nothing to ask the daemon */
+		if (request->values[0] == NULL) {
+			pk_results_set_exit_code (request->results, PK_EXIT_ENUM_SUCCESS);
+			continue;
+		}
+
+		for (j = 0; j < groups->len; j++) {
+			PkClientBatchGroup *tmp = g_ptr_array_index (groups, j);
+			if (tmp->role == request->role &&
+			    tmp->filters == request->filters) {
+				group = tmp;
+				break;
+			}
+		}
+		if (group == NULL) {
+			group = g_slice_new0 (PkClientBatchGroup);
+			group->role = request->role;
+			group->filters = request->filters;
+			group->values = g_ptr_array_new ();
+			group->targets = g_hash_table_new_full (g_str_hash, g_str_equal,
+								NULL, (GDestroyNotify) g_ptr_array_unref);
+			group->requests = g_ptr_array_new ();
+			group->unmatched = g_ptr_array_new ();
+			g_ptr_array_add (group->unmatched, request);
+			g_ptr_array_add (groups, group);
+		}
+		g_ptr_array_add (group->requests, request);
+		for (j = 0; request->values[j] != NULL; j++)
+			pk_client_batch_add_target (group, request->values[j], request);
+	}
+	for (i = 0; i < groups->len; i++) {
+		PkClientBatchGroup *group = g_ptr_array_index (groups, i);
+		g_ptr_array_add (group->values, NULL);
+	}
+	return groups;
+}
+
+/*
+ * pk_client_batch_split_packages:
+ **/
+static void
+pk_client_batch_split_packages (PkClientBatchGroup *group, PkResults *results)
+{
+	guint i;
+	guint j;
+	g_autoptr(PkPackageArray) packages = NULL;
+
+	packages = pk_results_get_packages_compact (results);
+	for (i = 0; i < pk_package_array_get_size (packages); i++) {
+		const gchar *package_id = pk_package_array_get_id (packages, i);
+		GPtrArray *targets;
+		PkPackageIdParts parts;
+
+		/* match the package ID, then the name */
+		targets = g_hash_table_lookup (group->targets, package_id);
+		if (targets == NULL && pk_package_id_split_parts (package_id, &parts)) {
+			g_autofree gchar *name = NULL;
+			name = g_strndup (package_id + parts.offsets[PK_PACKAGE_ID_NAME],
+					  parts.lengths[PK_PACKAGE_ID_NAME]);
+			targets = g_hash_table_lookup (group->targets, name);
+		}
+
+		/* the backend matched something else, e.g. a provide, keep
+		 * it once rather than in every query */
+		if (targets == NULL)
+			targets = group->unmatched;
+		for (j = 0; j < targets->len; j++) {
+			PkClientBatchRequest *request = g_ptr_array_index (targets, j);
+			pk_results_add_package_data (request->results,
+						     pk_package_array_get_info (packages, i),
+						     package_id,
+						     pk_package_array_get_summary (packages, i),
+						     pk_package_array_get_update_severity (packages, i));
+		}
+	}
+}
+
+/*
+ * pk_client_batch_split_details:
+ **/
+static void
+pk_client_batch_split_details (PkClientBatchGroup *group, PkResults *results)
+{
+	guint i;
+	guint j;
+	g_autoptr(GPtrArray) details = NULL;
+
+	details = pk_results_get_details_array (results);
+	for (i = 0; i < details->len; i++) {
+		PkDetails *item = g_ptr_array_index (details, i);
+		GPtrArray *targets;
+
+		targets = g_hash_table_lookup (group->targets,
+					       pk_details_get_package_id (item));
+		if (targets == NULL)
+			targets = group->unmatched;
+		for (j = 0; j < targets->len; j++) {
+			PkClientBatchRequest *request = g_ptr_array_index (targets, j);
+			pk_results_add_details (request->results, item);
+		}
+	}
+}
+
+/*
+ * pk_client_batch_split:
+ **/
+static void
+pk_client_batch_split (PkClientBatchGroup *group, PkResults *results)
+{
+	PkExitEnum exit_enum;
+	guint i;
+	g_autoptr(PkError) error_code = NULL;
+
+	if (group->role == PK_ROLE_ENUM_RESOLVE)
+		pk_client_batch_split_packages (group, results);
+	else if (group->role == PK_ROLE_ENUM_GET_DETAILS)
+		pk_client_batch_split_details (group, results);
+
+	/* every query shares the outcome of the transaction */
+	exit_enum = pk_results_get_exit_code (results);
+	error_code = pk_results_get_error_code (results);
+	for (i = 0; i < group->requests->len; i++) {
+		PkClientBatchRequest *request = g_ptr_array_index (group->requests, i);
+		pk_results_set_exit_code (request->results, exit_enum);
+		if (error_code != NULL)
+			pk_results_set_error_code (request->results, error_code);
+	}
+}
+
+/*
+ * pk_client_batch_state_finish:
+ **/
+static void
+pk_client_batch_state_finish (PkClientBatchState *state)
+{
+	PkClientBatchPrivate *priv = state->batch->priv;
+	GPtrArray *array;
+	guint i;
+
+	if (state->error != NULL) {
+		g_simple_async_result_take_error (state->res, state->error);
+	} else {
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		for (i = 0; i < priv->requests->len; i++) {
+			PkClientBatchRequest *request = g_ptr_array_index (priv->requests, i);
+			g_ptr_array_add (array, g_object_ref (request->results));
+		}
+		g_simple_async_result_set_op_res_gpointer (state->res, array,
+							   (GDestroyNotify) g_ptr_array_unref);
+	}
+	priv->running = FALSE;
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	g_ptr_array_unref (state->groups);
+	g_object_unref (state->res);
+	g_object_unref (state->batch);
+	g_slice_free (PkClientBatchState, state);
+}
+
+/*
+ * pk_client_batch_group_cb:
+ **/
+static void
+pk_client_batch_group_cb (GObject *source_object,
+			  GAsyncResult *res,
+			  gpointer user_data)
+{
+	PkClientBatchGroup *group = (PkClientBatchGroup *) user_data;
+	PkClientBatchState *state = group->state;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_generic_finish (PK_CLIENT (source_object), res, &error);
+	if (results == NULL) {
+		if (state->error == NULL)
+			state->error = g_steal_pointer (&error);
+	} else {
+		pk_client_batch_split (group, results);
+	}
+	if (--state->pending == 0)
+		pk_client_batch_state_finish (state);
+}
+
+/**
+ * pk_client_batch_run_async:
+ * @batch: a valid #PkClientBatch instance
+ * @cancellable: a #GCancellable or %NULL
+ * @progress_callback: (scope notified): the function to run when the progress changes
+ * @progress_user_data: data to pass to @progress_callback
+ * @callback_ready: the function to run on completion
+ * @user_data: the data to pass to @callback_ready
+ *
+ * Runs all the queries added to the batch, using one transaction for each
+ * kind of query. If any of the transactions fails the whole batch fails.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_batch_run_async (PkClientBatch *batch,
+			   GCancellable *cancellable,
+			   PkProgressCallback progress_callback,
+			   gpointer progress_user_data,
+			   GAsyncReadyCallback callback_ready,
+			   gpointer user_data)
+{
+	PkClientBatchPrivate *priv;
+	PkClientBatchState *state;
+	guint i;
+
+	g_return_if_fail (PK_IS_CLIENT_BATCH (batch));
+	g_return_if_fail (callback_ready != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+	g_return_if_fail (!batch->priv->running);
+
+	priv = batch->priv;
+	state = g_slice_new0 (PkClientBatchState);
+	state->batch = g_object_ref (batch);
+	state->res = g_simple_async_result_new (G_OBJECT (batch),
+						callback_ready,
+						user_data,
+						pk_client_batch_run_async);
+	state->groups = pk_client_batch_build_groups (batch);
+	priv->running = TRUE;
+
+	/* only empty queries */
+	if (state->groups->len == 0) {
+		pk_client_batch_state_finish (state);
+		return;
+	}
+
+	state->pending = state->groups->len;
+	for (i = 0; i < state->groups->len; i++) {
+		PkClientBatchGroup *group = g_ptr_array_index (state->groups, i);
+		group->state = state;
+		g_debug ("running %u %s queries as one transaction",
+			 group->requests->len, pk_role_enum_to_string (group->role));
+		if (group->role == PK_ROLE_ENUM_RESOLVE) {
+			pk_client_resolve_async (priv->client,
+						 group->filters,
+						 (gchar **) group->values->pdata,
+						 cancellable,
+						 progress_callback,
+						 progress_user_data,
+						 pk_client_batch_group_cb,
+						 group);
+		} else if (group->role == PK_ROLE_ENUM_GET_DETAILS) {
+			pk_client_get_details_async (priv->client,
+						     (gchar **) group->values->pdata,
+						     cancellable,
+						     progress_callback,
+						     progress_user_data,
+						     pk_client_batch_group_cb,
+						     group);
+		} else {
+			g_assert_not_reached ();
+		}
+	}
+}
+
+/**
+ * pk_client_batch_run_finish:
+ * @batch: a valid #PkClientBatch instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: (element-type PkResults) (transfer container): the results
+ * of each query, in the order they were added, or %NULL for error
+ *
+ * Since: 1.2.5
+ **/
+GPtrArray *
+pk_client_batch_run_finish (PkClientBatch *batch,
+			    GAsyncResult *res,
+			    GError **error)
+{
+	GSimpleAsyncResult *simple;
+
+	g_return_val_if_fail (PK_IS_CLIENT_BATCH (batch), NULL);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_ptr_array_ref (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/* tiny helper to help us do the async operation */
+typedef struct {
+	GError		**error;
+	GMainLoop	*loop;
+	GPtrArray	*results;
+} PkClientBatchHelper;
+
+/*
+ * pk_client_batch_run_finish_sync:
+ **/
+static void
+pk_client_batch_run_finish_sync (PkClientBatch *batch,
+				 GAsyncResult *res,
+				 PkClientBatchHelper *helper)
+{
+	helper->results = pk_client_batch_run_finish (batch, res, helper->error);
+	g_main_loop_quit (helper->loop);
+}
+
+/**
+ * pk_client_batch_run:
+ * @batch: a valid #PkClientBatch instance
+ * @cancellable: a #GCancellable or %NULL
+ * @progress_callback: (scope call): the function to run when the progress changes
+ * @progress_user_data: data to pass to @progress_callback
+ * @error: the #GError to store any failure, or %NULL
+ *
+ * Runs all the queries added to the batch, see pk_client_batch_run_async().
+ *
+ * Warning: this function is synchronous, and may block. Do not use it in GUI
+ * applications.
+ *
+ * Return value: (element-type PkResults) (transfer container): the results
+ * of each query, in the order they were added, or %NULL for error
+ *
+ * Since: 1.2.5
+ **/
+GPtrArray *
+pk_client_batch_run (PkClientBatch *batch,
+		     GCancellable *cancellable,
+		     PkProgressCallback progress_callback,
+		     gpointer progress_user_data,
+		     GError **error)
+{
+	GMainContext *context;
+	PkClientBatchHelper helper;
+
+	g_return_val_if_fail (PK_IS_CLIENT_BATCH (batch), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* create temp object */
+	memset (&helper, 0, sizeof (PkClientBatchHelper));
+	context = pk_sync_context_get ();
+	helper.loop = g_main_loop_new (context, FALSE);
+	helper.error = error;
+
+	g_main_context_push_thread_default (context);
+
+	/* run async method */
+	pk_client_batch_run_async (batch, cancellable,
+				   progress_callback, progress_user_data,
+				   (GAsyncReadyCallback) pk_client_batch_run_finish_sync,
+				   &helper);
+	g_main_loop_run (helper.loop);
+
+	g_main_context_pop_thread_default (context);
+
+	/* free temp object */
+	g_main_loop_unref (helper.loop);
+	g_main_context_unref (context);
+
+	return helper.results;
+}
+
+/*
+ * pk_client_batch_class_init:
+ **/
+static void
+pk_client_batch_class_init (PkClientBatchClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_client_batch_finalize;
+	g_type_class_add_private (klass, sizeof (PkClientBatchPrivate));
+}
+
+/*
+ * pk_client_batch_init:
+ **/
+static void
+pk_client_batch_init (PkClientBatch *batch)
+{
+	batch->priv = PK_CLIENT_BATCH_GET_PRIVATE (batch);
+	batch->priv->requests = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_client_batch_request_free);
+}
+
+/*
+ * pk_client_batch_finalize:
+ **/
+static void
+pk_client_batch_finalize (GObject *object)
+{
+	PkClientBatch *batch = PK_CLIENT_BATCH (object);
+	PkClientBatchPrivate *priv = batch->priv;
+
+	g_ptr_array_unref (priv->requests);
+	g_object_unref (priv->client);
+
+	G_OBJECT_CLASS (pk_client_batch_parent_class)->finalize (object);
+}
+
+/**
+ * pk_client_batch_new:
+ * @client: a valid #PkClient instance used to run the queries
+ *
+ * Return value: a new #PkClientBatch object.
+ *
+ * Since: 1.2.5
+ **/
+PkClientBatch *
+pk_client_batch_new (PkClient *client)
+{
+	PkClientBatch *batch;
+
+	g_return_val_if_fail (PK_IS_CLIENT (client), NULL);
+
+	batch = g_object_new (PK_TYPE_CLIENT_BATCH, NULL);
+	batch->priv->client = g_object_ref (client);
+	return PK_CLIENT_BATCH (batch);
+}
@@ -0,0 +1,95 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_CLIENT_BATCH_H
+#define __PK_CLIENT_BATCH_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include <packagekit-glib2/pk-bitfield.h>
+#include <packagekit-glib2/pk-client.h>
+#include <packagekit-glib2/pk-progress.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_CLIENT_BATCH		(pk_client_batch_get_type ())
+#define PK_CLIENT_BATCH(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_CLIENT_BATCH, PkClientBatch))
+#define PK_CLIENT_BATCH_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_CLIENT_BATCH, PkClientBatchClass))
+#define PK_IS_CLIENT_BATCH(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_CLIENT_BATCH))
+#define PK_IS_CLIENT_BATCH_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_CLIENT_BATCH))
+#define PK_CLIENT_BATCH_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_CLIENT_BATCH, PkClientBatchClass))
+
+typedef struct _PkClientBatchPrivate	PkClientBatchPrivate;
+typedef struct _PkClientBatch		PkClientBatch;
+typedef struct _PkClientBatchClass	PkClientBatchClass;
+
+struct _PkClientBatch
+{
+	 GObject		 parent;
+	 PkClientBatchPrivate	*priv;
+};
+
+struct _PkClientBatchClass
+{
+	GObjectClass	parent_class;
+	/* padding for future expansion */
+	void (*_pk_reserved1) (void);
+	void (*_pk_reserved2) (void);
+	void (*_pk_reserved3) (void);
+	void (*_pk_reserved4) (void);
+	void (*_pk_reserved5) (void);
+};
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkClientBatch, g_object_unref)
+#endif
+
+GType		 pk_client_batch_get_type		(void);
+PkClientBatch	*pk_client_batch_new			(PkClient		*client);
+guint		 pk_client_batch_add_resolve		(PkClientBatch		*batch,
+							 PkBitfield		 filters,
+							 gchar			**packages);
+guint		 pk_client_batch_add_get_details	(PkClientBatch		*batch,
+							 gchar			**package_ids);
+guint		 pk_client_batch_get_size		(PkClientBatch		*batch);
+void		 pk_client_batch_run_async		(PkClientBatch		*batch,
+							 GCancellable		*cancellable,
+							 PkProgressCallback	 progress_callback,
+							 gpointer		 progress_user_data,
+							 GAsyncReadyCallback	 callback_ready,
+							 gpointer		 user_data);
+GPtrArray	*pk_client_batch_run_finish		(PkClientBatch		*batch,
+							 GAsyncResult		*res,
+							 GError			**error);
+GPtrArray	*pk_client_batch_run			(PkClientBatch		*batch,
+							 GCancellable		*cancellable,
+							 PkProgressCallback	 progress_callback,
+							 gpointer		 progress_user_data,
+							 GError			**error);
+
+G_END_DECLS
+
+#endif /* __PK_CLIENT_BATCH_H */
@@ -27,6 +27,7 @@
 #include <glib.h>
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-progress.h>
+#include <packagekit-glib2/pk-common-private.h>
 
 #include "pk-client-sync.h"
 
@@ -87,7 +88,7 @@ pk_client_resolve (PkClient *client, PkBitfield filters, gchar **packages, GCanc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -142,7 +143,7 @@ pk_client_search_names (PkClient *client, PkBitfield filters, gchar **values, GC
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -198,7 +199,7 @@ pk_client_search_details (PkClient *client, PkBitfield filters, gchar **values,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -252,7 +253,7 @@ pk_client_search_groups (PkClient *client, PkBitfield filters, gchar **values, G
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -306,7 +307,7 @@ pk_client_search_files (PkClient *client, PkBitfield filters, gchar **values, GC
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -360,7 +361,7 @@ pk_client_get_details (PkClient *client, gchar **package_ids, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -415,7 +416,7 @@ pk_client_get_details_local (PkClient *client, gchar **files, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -471,7 +472,7 @@ pk_client_get_files_local (PkClient *client, gchar **files, GCancellable *cancel
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -526,7 +527,7 @@ pk_client_get_update_detail (PkClient *client, gchar **package_ids, GCancellable
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -580,7 +581,7 @@ pk_client_download_packages (PkClient *client, gchar **package_ids, const gchar
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -633,7 +634,7 @@ pk_client_get_updates (PkClient *client, PkBitfield filters, GCancellable *cance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -686,7 +687,7 @@ pk_client_get_old_transactions (PkClient *client, guint number, GCancellable *ca
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -741,7 +742,7 @@ pk_client_depends_on (PkClient *client, PkBitfield filters, gchar **package_ids,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -794,7 +795,7 @@ pk_client_get_packages (PkClient *client, PkBitfield filters, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -849,7 +850,7 @@ pk_client_required_by (PkClient *client, PkBitfield filters, gchar **package_ids
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -908,7 +909,7 @@ pk_client_what_provides (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -961,7 +962,7 @@ pk_client_get_distro_upgrades (PkClient *client, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1014,7 +1015,7 @@ pk_client_get_files (PkClient *client, gchar **package_ids, GCancellable *cancel
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1066,7 +1067,7 @@ pk_client_get_categories (PkClient *client, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1131,7 +1132,7 @@ pk_client_remove_packages (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1195,7 +1196,7 @@ pk_client_refresh_cache (PkClient *client, gboolean force, GCancellable *cancell
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1254,7 +1255,7 @@ pk_client_install_packages (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1309,7 +1310,7 @@ pk_client_install_signature (PkClient *client, PkSigTypeEnum type, const gchar *
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1368,7 +1369,7 @@ pk_client_update_packages (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1428,7 +1429,7 @@ pk_client_install_files (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1481,7 +1482,7 @@ pk_client_accept_eula (PkClient *client, const gchar *eula_id, GCancellable *can
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1534,7 +1535,7 @@ pk_client_get_repo_list (PkClient *client, PkBitfield filters, GCancellable *can
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1588,7 +1589,7 @@ pk_client_repo_enable (PkClient *client, const gchar *repo_id, gboolean enabled,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1644,7 +1645,7 @@ pk_client_repo_set_data (PkClient *client, const gchar *repo_id, const gchar *pa
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1705,7 +1706,7 @@ pk_client_repo_remove (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1773,7 +1774,7 @@ pk_client_upgrade_system (PkClient *client, PkBitfield transaction_flags,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1836,7 +1837,7 @@ pk_client_repair_system (PkClient *client,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1894,7 +1895,7 @@ pk_client_adopt (PkClient *client, const gchar *transaction_id, GCancellable *ca
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1959,7 +1960,7 @@ pk_client_get_progress (PkClient *client, const gchar *transaction_id, GCancella
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkClientHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -31,26 +31,43 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <packagekit-glib2/pk-client.h>
 #include <packagekit-glib2/pk-client-helper.h>
 #include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-common-private.h>
 #include <packagekit-glib2/pk-control.h>
 #include <packagekit-glib2/pk-debug.h>
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-package-id.h>
 #include <packagekit-glib2/pk-package-ids.h>
 
+#include "pk-client-private.h"
+#include "pk-details-cache-private.h"
+
 static void     pk_client_finalize	(GObject     *object);
 
 #define PK_CLIENT_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_CLIENT, PkClientPrivate))
 
 #define PK_CLIENT_DBUS_METHOD_TIMEOUT	G_MAXINT /* ms */
 
+/* the number of packages the daemon can group into one ::Packages signal */
+#define PK_CLIENT_PACKAGES_BATCH_SIZE	512
+
+/* the only layout of GetResultsFd we understand */
+#define PK_CLIENT_RESULTS_FD_FORMAT	"(a(uss)a(sas))"
+
 /**
  * PkClientPrivate:
  *
@@ -59,6 +76,8 @@ static void     pk_client_finalize	(GObject     *object);
 struct _PkClientPrivate
 {
 	GDBusConnection		*connection;
+	GDBusConnection		*peer_connection;
+	guint			 name_owner_id;
 	GPtrArray		*calls;
 	PkControl		*control;
 	gchar			*locale;
@@ -66,6 +85,20 @@ struct _PkClientPrivate
 	gboolean		 interactive;
 	gboolean		 idle;
 	guint			 cache_age;
+	PkClientResultsMode	 results_mode;
+	gboolean		 details_cache;
+	guint			 progress_interval;
+	PkClientItemCallback	 item_callback;
+	gpointer		 item_user_data;
+	GDestroyNotify		 item_destroy;
+	gchar			*plan;
+	guint			 limit;
+	gchar			*cursor;
+	guint			 deadline_ms;
+	gchar			**fields;
+	gchar			*search_session;
+	gboolean		 coalesce;
+	gchar			**signal_filter;
 };
 
 enum {
@@ -75,6 +108,9 @@ enum {
 	PROP_INTERACTIVE,
 	PROP_IDLE,
 	PROP_CACHE_AGE,
+	PROP_RESULTS_MODE,
+	PROP_DETAILS_CACHE,
+	PROP_PROGRESS_INTERVAL,
 	PROP_LAST
 };
 
@@ -107,27 +143,21 @@ pk_client_weak_ref_free (gpointer ptr)
 }
 
 static void
-pk_client_weak_ref_free_gclosure (gpointer ptr,
-				  GClosure *closure)
-{
-	pk_client_weak_ref_free (ptr);
-}
-
-static void
-pk_client_properties_changed_cb (GDBusProxy *proxy,
-				 GVariant *changed_properties,
-				 const gchar* const  *invalidated_properties,
+pk_client_properties_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
 				 gpointer user_data);
 static void
-pk_client_signal_cb (GDBusProxy *proxy,
+pk_client_signal_cb (GDBusConnection *connection,
 		     const gchar *sender_name,
+		     const gchar *object_path,
+		     const gchar *interface_name,
 		     const gchar *signal_name,
 		     GVariant *parameters,
 		     gpointer user_data);
-static void
-pk_client_notify_name_owner_cb (GObject    *obj,
-                                GParamSpec *pspec,
-                                gpointer    user_data);
 
 struct _PkClientState
 {
@@ -143,6 +173,7 @@ struct _PkClientState
 	gchar				*directory;
 	gchar				*eula_id;
 	gchar				**files;
+	GUnixFDList			*files_fd_list;
 	gchar				*key_id;
 	gchar				*package_id;
 	gchar				**package_ids;
@@ -153,12 +184,14 @@ struct _PkClientState
 	gchar				*distro_id;
 	gchar				*transaction_id;
 	gchar				*value;
+	PkTransactionPast		*last_transaction; /* for ::TransactionResources */
 	gpointer			 progress_user_data;
 	gpointer			 user_data;
 	guint				 number;
 	gulong				 cancellable_id;
-	GDBusProxy			*proxy;
-	GDBusProxy			*proxy_props;
+	GDBusConnection			*connection;
+	GArray				*signal_ids;
+	guint				 properties_id;
 	GCancellable			*cancellable;
 	GCancellable			*cancellable_client;
 	GSimpleAsyncResult		*res;
@@ -166,6 +199,8 @@ struct _PkClientState
 	PkClient			*client;
 	PkProgress			*progress;
 	PkProgressCallback		 progress_callback;
+	guint				 progress_pending;	/* bitfield of PkProgressType */
+	guint				 progress_id;
 	PkResults			*results;
 	PkRoleEnum			 role;
 	PkSigTypeEnum			 type;
@@ -173,27 +208,93 @@ struct _PkClientState
 	guint				 refcount;
 	PkClientHelper			*client_helper;
 	gboolean			 waiting_for_finished;
+	gboolean			 results_fd;
+	gboolean			 stream;
+	gchar				*plan;
+	gchar				*cursor;
+	GPtrArray			*cached_items;
+	gboolean			 cache_results;
+	guint64				 installed_epoch;
+	guint64				 available_epoch;
 };
 
 G_DEFINE_TYPE (PkClientState, pk_client_state, G_TYPE_OBJECT)
 
 static void
-pk_client_state_unset_proxy (PkClientState *state)
+pk_client_state_unsubscribe (PkClientState *state)
 {
-	if (state->proxy != NULL) {
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_properties_changed_cb),
-						      state);
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_signal_cb),
-						      state);
-		g_signal_handlers_disconnect_by_func (state->proxy,
-						      G_CALLBACK (pk_client_notify_name_owner_cb),
-						      state);
-		g_clear_object (&state->proxy);
+	for (guint i = 0; i < state->signal_ids->len; i++) {
+		g_dbus_connection_signal_unsubscribe (state->connection,
+						      g_array_index (state->signal_ids, guint, i));
+	}
+	g_array_set_size (state->signal_ids, 0);
+	if (state->properties_id > 0) {
+		g_dbus_connection_signal_unsubscribe (state->connection,
+						      state->properties_id);
+		state->properties_id = 0;
 	}
 }
 
+/*
+ * pk_client_state_get_bus_name:
+ *
+ * Messages on the private connection to the daemon have no destination.
+ **/
+static const gchar *
+pk_client_state_get_bus_name (PkClientState *state)
+{
+	if (g_dbus_connection_get_unique_name (state->connection) == NULL)
+		return NULL;
+	return PK_DBUS_SERVICE;
+}
+
+/*
+ * pk_client_state_call:
+ *
+ * Calls a method on the transaction object using the shared connection,
+ * so no proxy has to be set up for each transaction.
+ **/
+static void
+pk_client_state_call (PkClientState *state,
+		      const gchar *method_name,
+		      GVariant *parameters,
+		      GDBusCallFlags flags,
+		      gint timeout_msec,
+		      GCancellable *cancellable,
+		      GAsyncReadyCallback callback,
+		      gpointer user_data)
+{
+	g_dbus_connection_call (state->connection,
+				pk_client_state_get_bus_name (state),
+				state->tid,
+				PK_DBUS_INTERFACE_TRANSACTION,
+				method_name,
+				parameters,
+				NULL,
+				flags,
+				timeout_msec,
+				cancellable,
+				callback,
+				user_data);
+}
+
+/* shared by every client in the process, and never freed */
+static PkDetailsCache *
+pk_client_get_shared_details_cache (void)
+{
+	static gsize cache_once = 0;
+	static PkDetailsCache *cache = NULL;
+
+	if (g_once_init_enter (&cache_once)) {
+		g_autofree gchar *filename = NULL;
+		filename = g_build_filename (g_get_user_cache_dir (),
+					     "PackageKit", "details-cache", NULL);
+		cache = pk_details_cache_new (filename);
+		g_once_init_leave (&cache_once, 1);
+	}
+	return cache;
+}
+
 static void
 pk_client_state_remove (PkClient *client, PkClientState *state)
 {
@@ -208,6 +309,77 @@ pk_client_state_remove (PkClient *client, PkClientState *state)
 	}
 }
 
+/*
+ * pk_client_state_progress_flush:
+ *
+ * Delivers the coalesced progress changes, one callback for each type.
+ **/
+static void
+pk_client_state_progress_flush (PkClientState *state)
+{
+	guint pending = state->progress_pending;
+
+	if (state->progress_id > 0) {
+		g_source_remove (state->progress_id);
+		state->progress_id = 0;
+	}
+	state->progress_pending = 0;
+	if (state->progress_callback == NULL)
+		return;
+	for (guint i = 0; i < PK_PROGRESS_TYPE_INVALID; i++) {
+		if (pending & (1u << i))
+			state->progress_callback (state->progress, i, state->progress_user_data);
+	}
+}
+
+static gboolean
+pk_client_state_progress_timeout_cb (gpointer user_data)
+{
+	PkClientState *state = PK_CLIENT_STATE (user_data);
+	state->progress_id = 0;
+	pk_client_state_progress_flush (state);
+	return G_SOURCE_REMOVE;
+}
+
+/*
+ * pk_client_state_progress_changed:
+ *
+ * Runs the progress callback, or with a progress interval set, folds the
+ * values that change many times a second into at most one callback per
+ * interval. Any other change first delivers what is pending so that the
+ * callbacks keep their order.
+ **/
+static void
+pk_client_state_progress_changed (PkClientState *state, PkProgressType type)
+{
+	guint interval = state->client->priv->progress_interval;
+
+	if (state->progress_callback == NULL)
+		return;
+
+	switch (type) {
+	case PK_PROGRESS_TYPE_PERCENTAGE:
+	case PK_PROGRESS_TYPE_ELAPSED_TIME:
+	case PK_PROGRESS_TYPE_REMAINING_TIME:
+	case PK_PROGRESS_TYPE_SPEED:
+	case PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING:
+		if (interval == 0)
+			break;
+		state->progress_pending |= 1u << type;
+		if (state->progress_id == 0) {
+			state->progress_id = g_timeout_add_full (G_PRIORITY_DEFAULT, interval,
+								 pk_client_state_progress_timeout_cb,
+								 g_object_ref (state),
+								 g_object_unref);
+		}
+		return;
+	default:
+		pk_client_state_progress_flush (state);
+		break;
+	}
+	state->progress_callback (state->progress, type, state->progress_user_data);
+}
+
 static void
 pk_client_state_finish (PkClientState *state, const GError *error)
 {
@@ -219,12 +391,10 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 
 	/* force finished (if not already set) so clients can update the UI's */
 	ret = pk_progress_set_status (state->progress, PK_STATUS_ENUM_FINISHED);
-	if (ret && state->progress_callback != NULL) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_STATUS,
-					  state->progress_user_data);
-		state->progress_callback = NULL;
-	}
+	if (ret)
+		pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_STATUS);
+	pk_client_state_progress_flush (state);
+	state->progress_callback = NULL;
 
 	if (state->cancellable_id > 0) {
 		g_cancellable_disconnect (state->cancellable_client,
@@ -234,10 +404,7 @@ pk_client_state_finish (PkClientState *state, const GError *error)
 	g_clear_object (&state->cancellable);
 	g_clear_object (&state->cancellable_client);
 
-	pk_client_state_unset_proxy (state);
-
-	if (state->proxy_props != NULL)
-		g_object_unref (G_OBJECT (state->proxy_props));
+	pk_client_state_unsubscribe (state);
 
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
@@ -282,8 +449,16 @@ pk_client_state_finalize (GObject *object)
 	g_free (state->tid);
 	g_free (state->distro_id);
 	g_free (state->transaction_id);
+	g_free (state->plan);
+	g_free (state->cursor);
 	g_strfreev (state->files);
+	g_clear_object (&state->files_fd_list);
+	g_clear_object (&state->last_transaction);
 	g_strfreev (state->package_ids);
+	if (state->cached_items != NULL)
+		g_ptr_array_unref (state->cached_items);
+	g_array_unref (state->signal_ids);
+	g_clear_object (&state->connection);
 	/* results will not exist if the CreateTransaction fails */
 	g_clear_object (&state->results);
 	g_object_unref (state->progress);
@@ -304,6 +479,7 @@ pk_client_state_class_init (PkClientStateClass *klass)
 static void
 pk_client_state_init (PkClientState *state)
 {
+	state->signal_ids = g_array_new (FALSE, FALSE, sizeof (guint));
 }
 
 static void
@@ -311,7 +487,7 @@ pk_client_cancel_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
 	GWeakRef *weak_ref = user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
@@ -322,7 +498,7 @@ pk_client_cancel_cb (GObject *source_object,
 	pk_client_weak_ref_free (weak_ref);
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* Instructing the daemon to cancel failed, so just return an
 		 * error to the client so they don’t wait forever. */
@@ -348,19 +524,19 @@ pk_client_cancellable_cancel_cb (GCancellable *cancellable,
 	}
 
 	/* dbus method has not yet fired */
-	if (state->proxy == NULL) {
-		g_debug ("Cancelled, but no proxy, not sure what to do here");
+	if (state->signal_ids->len == 0) {
+		g_debug ("Cancelled, but no transaction, not sure what to do here");
 		return;
 	}
 
 	/* takeover the call with the cancel method */
 	g_debug ("cancelling %s", state->tid);
-	g_dbus_proxy_call (state->proxy, "Cancel",
-			   NULL,
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   NULL,
-			   pk_client_cancel_cb, pk_client_weak_ref_new (state));
+	pk_client_state_call (state, "Cancel",
+			      NULL,
+			      G_DBUS_CALL_FLAGS_NONE,
+			      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+			      NULL,
+			      pk_client_cancel_cb, pk_client_weak_ref_new (state));
 }
 
 static PkClientState *
@@ -378,6 +554,8 @@ pk_client_state_new (PkClient *client,
 	state->res = g_simple_async_result_new (G_OBJECT (client), callback_ready, user_data, source_tag);
 	state->client = g_object_ref (client);
 	state->cancellable = g_cancellable_new ();
+	state->plan = g_steal_pointer (&client->priv->plan);
+	state->cursor = g_steal_pointer (&client->priv->cursor);
 
 	if (cancellable != NULL) {
 		state->cancellable_client = g_object_ref (cancellable);
@@ -426,6 +604,15 @@ pk_client_get_property (GObject *object, guint prop_id, GValue *value, GParamSpe
 	case PROP_CACHE_AGE:
 		g_value_set_uint (value, priv->cache_age);
 		break;
+	case PROP_RESULTS_MODE:
+		g_value_set_uint (value, priv->results_mode);
+		break;
+	case PROP_DETAILS_CACHE:
+		g_value_set_boolean (value, priv->details_cache);
+		break;
+	case PROP_PROGRESS_INTERVAL:
+		g_value_set_uint (value, priv->progress_interval);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -455,6 +642,15 @@ pk_client_set_property (GObject *object, guint prop_id, const GValue *value, GPa
 	case PROP_CACHE_AGE:
 		priv->cache_age = g_value_get_uint (value);
 		break;
+	case PROP_RESULTS_MODE:
+		priv->results_mode = g_value_get_uint (value);
+		break;
+	case PROP_DETAILS_CACHE:
+		priv->details_cache = g_value_get_boolean (value);
+		break;
+	case PROP_PROGRESS_INTERVAL:
+		priv->progress_interval = g_value_get_uint (value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -656,16 +852,15 @@ pk_client_set_property_value (PkClientState *state,
 {
 	gboolean ret;
 	const gchar *package_id;
+	const gchar *plan;
+	const gchar *cursor;
 
 	/* role */
 	if (g_strcmp0 (key, "Role") == 0) {
 		ret = pk_progress_set_role (state->progress,
 					    g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ROLE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_ROLE);
 		return;
 	}
 
@@ -673,11 +868,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Status") == 0) {
 		ret = pk_progress_set_status (state->progress,
 					      g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_STATUS,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_STATUS);
 		return;
 	}
 
@@ -690,11 +882,8 @@ pk_client_set_property_value (PkClientState *state,
 			return;
 		ret = pk_progress_set_package_id (state->progress,
 						  package_id);
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PACKAGE_ID,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PACKAGE_ID);
 		return;
 	}
 
@@ -702,11 +891,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Percentage") == 0) {
 		ret = pk_progress_set_percentage (state->progress,
 						  pk_client_percentage_to_signed (g_variant_get_uint32 (value)));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PERCENTAGE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PERCENTAGE);
 		return;
 	}
 
@@ -714,11 +900,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "AllowCancel") == 0) {
 		ret = pk_progress_set_allow_cancel (state->progress,
 						  g_variant_get_boolean (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ALLOW_CANCEL,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_ALLOW_CANCEL);
 		return;
 	}
 
@@ -726,11 +909,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "CallerActive") == 0) {
 		ret = pk_progress_set_caller_active (state->progress,
 						  g_variant_get_boolean (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_CALLER_ACTIVE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_CALLER_ACTIVE);
 		return;
 	}
 
@@ -738,11 +918,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "ElapsedTime") == 0) {
 		ret = pk_progress_set_elapsed_time (state->progress,
 						  g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ELAPSED_TIME,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_ELAPSED_TIME);
 		return;
 	}
 
@@ -750,11 +927,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "RemainingTime") == 0) {
 		ret = pk_progress_set_elapsed_time (state->progress,
 						    g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_REMAINING_TIME,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_REMAINING_TIME);
 		return;
 	}
 
@@ -762,11 +936,31 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Speed") == 0) {
 		ret = pk_progress_set_speed (state->progress,
 					     g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_SPEED,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_SPEED);
+		return;
+	}
+
+	/* plan */
+	if (g_strcmp0 (key, "Plan") == 0) {
+		plan = g_variant_get_string (value, NULL);
+		if (state->results != NULL && plan[0] != '\0')
+			pk_results_set_plan (state->results, plan);
+		return;
+	}
+
+	/* cursor */
+	if (g_strcmp0 (key, "Cursor") == 0) {
+		cursor = g_variant_get_string (value, NULL);
+		if (state->results != NULL && cursor[0] != '\0')
+			pk_results_set_cursor (state->results, cursor);
+		return;
+	}
+
+	/* partial */
+	if (g_strcmp0 (key, "Partial") == 0) {
+		if (state->results != NULL)
+			pk_results_set_partial (state->results, g_variant_get_boolean (value));
 		return;
 	}
 
@@ -774,11 +968,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "DownloadSizeRemaining") == 0) {
 		ret = pk_progress_set_download_size_remaining (state->progress,
 							       g_variant_get_uint64 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING);
 		return;
 	}
 
@@ -786,11 +977,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "TransactionFlags") == 0) {
 		ret = pk_progress_set_transaction_flags (state->progress,
 							 g_variant_get_uint64 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_TRANSACTION_FLAGS,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_TRANSACTION_FLAGS);
 		return;
 	}
 
@@ -798,11 +986,8 @@ pk_client_set_property_value (PkClientState *state,
 	if (g_strcmp0 (key, "Uid") == 0) {
 		ret = pk_progress_set_uid (state->progress,
 						  g_variant_get_uint32 (value));
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_UID,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_UID);
 		return;
 	}
 
@@ -831,20 +1016,32 @@ pk_client_state_add (PkClient *client, PkClientState *state)
  * pk_client_properties_changed_cb:
  **/
 static void
-pk_client_properties_changed_cb (GDBusProxy *proxy,
-				 GVariant *changed_properties,
-				 const gchar* const  *invalidated_properties,
+pk_client_properties_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
 				 gpointer user_data)
 {
+	const gchar *interface;
 	const gchar *key;
 	GVariantIter *iter;
 	GVariant *value;
 	GWeakRef *weak_ref = user_data;
+	g_autoptr(GVariant) changed_properties = NULL;
 	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
 
 	if (!state)
 		return;
 
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sa{sv}as)")))
+		return;
+	g_variant_get (parameters, "(&s@a{sv}as)",
+		       &interface, &changed_properties, NULL);
+	if (g_strcmp0 (interface, PK_DBUS_INTERFACE_TRANSACTION) != 0)
+		return;
+
 	if (g_variant_n_children (changed_properties) > 0) {
 		g_variant_get (changed_properties,
 				"a{sv}",
@@ -855,6 +1052,37 @@ pk_client_properties_changed_cb (GDBusProxy *proxy,
 	}
 }
 
+/*
+ * pk_client_state_is_streaming:
+ *
+ * The callback may be unset while the transaction is running, in which
+ * case the rest of the items go into the results.
+ */
+static gboolean
+pk_client_state_is_streaming (PkClientState *state)
+{
+	if (state->stream && state->client->priv->item_callback == NULL)
+		state->stream = FALSE;
+	return state->stream;
+}
+
+/*
+ * pk_client_state_stream_item:
+ *
+ * Hands the item to the streaming callback rather than keeping it in
+ * the results. Returns %FALSE if the item should be added as normal.
+ */
+static gboolean
+pk_client_state_stream_item (PkClientState *state, gpointer item)
+{
+	PkClientPrivate *priv = state->client->priv;
+
+	if (!pk_client_state_is_streaming (state))
+		return FALSE;
+	priv->item_callback (state->client, PK_SOURCE (item), priv->item_user_data);
+	return TRUE;
+}
+
 /*
  * pk_client_signal_package:
  */
@@ -869,23 +1097,27 @@ pk_client_signal_package (PkClientState *state,
 	g_autoptr(GError) error = NULL;
 	g_autoptr(PkPackage) package = NULL;
 
-	/* create virtual package */
-	package = pk_package_new ();
-	if (!pk_package_set_id (package, package_id, &error)) {
-		g_warning ("failed to set package id for %s", package_id);
-		return;
+	/* stream out */
+	if (pk_client_state_is_streaming (state) && info_enum != PK_INFO_ENUM_FINISHED) {
+		g_autoptr(PkPackage) item = NULL;
+		item = pk_package_new_full (info_enum, package_id, summary,
+					    update_severity, state->role,
+					    state->transaction_id, &error);
+		if (item == NULL) {
+			g_warning ("failed to set package id for %s", package_id);
+			return;
+		}
+		pk_client_state_stream_item (state, item);
+
+	/* add to results without creating an object for every package */
+	} else if (state->results != NULL && info_enum != PK_INFO_ENUM_FINISHED) {
+		if (!pk_results_add_package_data (state->results, info_enum,
+						  package_id, summary,
+						  update_severity)) {
+			g_warning ("failed to set package id for %s", package_id);
+			return;
+		}
 	}
-	g_object_set (package,
-		      "info", info_enum,
-		      "summary", summary,
-		      "update-severity", update_severity,
-		      "role", state->role,
-		      "transaction-id", state->transaction_id,
-		      NULL);
-
-	/* add to results */
-	if (state->results != NULL && info_enum != PK_INFO_ENUM_FINISHED)
-		pk_results_add_package (state->results, package);
 
 	/* only emit progress for verb packages */
 	switch (info_enum) {
@@ -901,17 +1133,18 @@ pk_client_signal_package (PkClientState *state,
 	case PK_INFO_ENUM_DECOMPRESSING:
 	case PK_INFO_ENUM_FINISHED:
 		ret = pk_progress_set_package_id (state->progress, package_id);
-		if (state->progress_callback != NULL && ret) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PACKAGE_ID,
-						  state->progress_user_data);
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PACKAGE_ID);
+		package = pk_package_new_full (info_enum, package_id, summary,
+					       update_severity, state->role,
+					       state->transaction_id, &error);
+		if (package == NULL) {
+			g_warning ("failed to set package id for %s", package_id);
+			return;
 		}
 		ret = pk_progress_set_package (state->progress, package);
-		if (state->progress_callback != NULL && ret) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_PACKAGE,
-						  state->progress_user_data);
-		}
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PACKAGE);
 		break;
 	default:
 		break;
@@ -952,6 +1185,20 @@ pk_client_copy_finished_remove_old_files (PkClientState *state)
 	}
 }
 
+/*
+ * pk_client_copy_downloaded_done:
+ */
+static void
+pk_client_copy_downloaded_done (PkClientState *state)
+{
+	/* no more copies pending? */
+	if (--state->refcount == 0) {
+		pk_client_copy_finished_remove_old_files (state);
+		state->ret = TRUE;
+		pk_client_state_finish (state, NULL);
+	}
+}
+
 /*
  * pk_client_copy_downloaded_finished_cb:
  */
@@ -971,12 +1218,7 @@ pk_client_copy_downloaded_finished_cb (GFile *file, GAsyncResult *res, PkClientS
 		return;
 	}
 
-	/* no more copies pending? */
-	if (--state->refcount == 0) {
-		pk_client_copy_finished_remove_old_files (state);
-		state->ret = TRUE;
-		pk_client_state_finish (state, NULL);
-	}
+	pk_client_copy_downloaded_done (state);
 }
 
 /*
@@ -990,11 +1232,8 @@ pk_client_copy_progress_cb (goffset current_num_bytes, goffset total_num_bytes,
 
 	/* save status */
 	ret = pk_progress_set_status (state->progress, PK_STATUS_ENUM_COPY_FILES);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_STATUS,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_STATUS);
 
 	/* calculate percentage */
 	if (total_num_bytes > 0)
@@ -1002,11 +1241,8 @@ pk_client_copy_progress_cb (goffset current_num_bytes, goffset total_num_bytes,
 
 	/* save percentage */
 	ret = pk_progress_set_percentage (state->progress, percentage);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_PERCENTAGE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PERCENTAGE);
 }
 
 /*
@@ -1039,10 +1275,19 @@ pk_client_copy_downloaded_file (PkClientState *state, const gchar *package_id, c
 		pk_client_state_finish (state, error);
 		return;
 	}
-	g_file_copy_async (source, destination, G_FILE_COPY_OVERWRITE,
-			   G_PRIORITY_DEFAULT, state->cancellable,
-			   (GFileProgressCallback) pk_client_copy_progress_cb, state,
-			   (GAsyncReadyCallback) pk_client_copy_downloaded_finished_cb, state);
+
+	/* a link costs nothing, but only works on the same filesystem and
+	 * for a caller allowed to link the daemon's files, usually root;
+	 * otherwise GIO still reflinks where the filesystem can */
+	if (link (source_file, path) == 0) {
+		g_debug ("linked %s to %s", source_file, path);
+		pk_client_copy_downloaded_done (state);
+	} else {
+		g_file_copy_async (source, destination, G_FILE_COPY_OVERWRITE,
+				   G_PRIORITY_DEFAULT, state->cancellable,
+				   (GFileProgressCallback) pk_client_copy_progress_cb, state,
+				   (GAsyncReadyCallback) pk_client_copy_downloaded_finished_cb, state);
+	}
 
 	/* Add the result (as a GStrv) to the results set */
 	files = g_strsplit (path, ",", -1);
@@ -1080,22 +1325,21 @@ pk_client_copy_downloaded (PkClientState *state)
 		return;
 	}
 
-	/* get the number of files to copy */
+	/* get the number of files to copy, and hold one more so that files
+	 * linked straight away can't finish the state under the loop */
 	for (i = 0; i < array->len; i++) {
 		item = g_ptr_array_index (array, i);
 		state->refcount += g_strv_length (pk_files_get_files (item));
 	}
+	state->refcount++;
 
 	/* get a cached value, as pk_client_copy_downloaded_file() adds items */
 	len = array->len;
 
 	/* save percentage */
 	ret = pk_progress_set_percentage (state->progress, -1);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_PERCENTAGE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PERCENTAGE);
 
 	/* do the copies pipelined */
 	for (i = 0; i < len; i++) {
@@ -1108,6 +1352,185 @@ pk_client_copy_downloaded (PkClientState *state)
 							files[j]);
 		}
 	}
+	pk_client_copy_downloaded_done (state);
+}
+
+/*
+ * pk_client_signal_files:
+ */
+static void
+pk_client_signal_files (PkClientState *state,
+			const gchar *package_id,
+			gchar **files)
+{
+	g_autoptr(PkFiles) item = NULL;
+
+	item = pk_files_new ();
+	g_object_set (item,
+		      "package-id", package_id,
+		      "files", files,
+		      "role", state->role,
+		      "transaction-id", state->transaction_id,
+		      NULL);
+	if (!pk_client_state_stream_item (state, item))
+		pk_results_add_files (state->results, item);
+}
+
+typedef struct {
+	gpointer	 addr;
+	gsize		 size;
+} PkClientMapping;
+
+static void
+pk_client_mapping_free (PkClientMapping *mapping)
+{
+	munmap (mapping->addr, mapping->size);
+	g_free (mapping);
+}
+
+/*
+ * pk_client_read_results_fd:
+ *
+ * The data is used straight from the shared mapping and is only copied
+ * when packages and files are added to the results.
+ */
+static gboolean
+pk_client_read_results_fd (PkClientState *state,
+			   gint fd,
+			   const gchar *format,
+			   GError **error)
+{
+	GVariantIter iter;
+	PkClientMapping *mapping;
+	const gchar *package_id;
+	const gchar *summary;
+	gpointer addr;
+	guint32 encoded_value;
+	struct stat st;
+	g_autoptr(GVariant) child = NULL;
+	g_autoptr(GVariant) variant = NULL;
+
+	if (g_strcmp0 (format, PK_CLIENT_RESULTS_FD_FORMAT) != 0) {
+		g_set_error (error, PK_CLIENT_ERROR, PK_CLIENT_ERROR_NOT_SUPPORTED,
+			     "results format %s not supported", format);
+		return FALSE;
+	}
+	if (fstat (fd, &st) < 0) {
+		g_set_error (error, PK_CLIENT_ERROR, PK_CLIENT_ERROR_FAILED,
+			     "failed to stat results: %s", g_strerror (errno));
+		return FALSE;
+	}
+	if (st.st_size == 0)
+		return TRUE;
+	addr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED) {
+		g_set_error (error, PK_CLIENT_ERROR, PK_CLIENT_ERROR_FAILED,
+			     "failed to map results: %s", g_strerror (errno));
+		return FALSE;
+	}
+	mapping = g_new0 (PkClientMapping, 1);
+	mapping->addr = addr;
+	mapping->size = st.st_size;
+	variant = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (format),
+							       addr, st.st_size, FALSE,
+							       (GDestroyNotify) pk_client_mapping_free,
+							       mapping));
+
+	/* same as ::Package */
+	child = g_variant_get_child_value (variant, 0);
+	g_variant_iter_init (&iter, child);
+	while (g_variant_iter_next (&iter, "(u&s&s)", &encoded_value, &package_id, &summary)) {
+		pk_client_signal_package (state,
+					  encoded_value & 0xFFFF,
+					  (encoded_value >> 16) & 0xFFFF,
+					  package_id,
+					  summary);
+	}
+	g_clear_pointer (&child, g_variant_unref);
+
+	/* same as ::Files */
+	child = g_variant_get_child_value (variant, 1);
+	g_variant_iter_init (&iter, child);
+	while (TRUE) {
+		g_autofree gchar **files = NULL;
+		if (!g_variant_iter_next (&iter, "(&s^a&s)", &package_id, &files))
+			break;
+		pk_client_signal_files (state, package_id, files);
+	}
+	return TRUE;
+}
+
+/*
+ * pk_client_signal_finished_results:
+ */
+static void
+pk_client_signal_finished_results (PkClientState *state)
+{
+	/* do we have to copy results? */
+	if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES &&
+	    state->directory != NULL &&
+	    pk_results_get_exit_code (state->results) != PK_EXIT_ENUM_CANCELLED) {
+		pk_client_copy_downloaded (state);
+		return;
+	}
+
+	/* keep what we were sent for next time */
+	if (state->cache_results) {
+		g_autoptr(GError) error = NULL;
+		if (!pk_details_cache_save (pk_client_get_shared_details_cache (), &error))
+			g_debug ("failed to save the details cache: %s", error->message);
+	}
+
+	/* we're done */
+	state->ret = TRUE;
+	pk_client_state_finish (state, NULL);
+}
+
+/*
+ * pk_client_get_results_fd_cb:
+ */
+static void
+pk_client_get_results_fd_cb (GObject *source_object,
+			     GAsyncResult *res,
+			     gpointer user_data)
+{
+	g_autoptr(PkClientState) state = user_data;
+	const gchar *format;
+	gint fd;
+	gint idx;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GUnixFDList) fd_list = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = g_dbus_connection_call_with_unix_fd_list_finish (G_DBUS_CONNECTION (source_object),
+								 &fd_list, res, &error);
+	if (value == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			pk_client_state_finish (state, error);
+			return;
+		}
+
+		/* older daemons sent everything as signals */
+		g_debug ("no results fd: %s", error->message);
+		pk_client_signal_finished_results (state);
+		return;
+	}
+
+	/* keep what did arrive, and say that it is not everything */
+	g_variant_get (value, "(h&s)", &idx, &format);
+	fd = fd_list != NULL ? g_unix_fd_list_get (fd_list, idx, &error) : -1;
+	if (fd < 0) {
+		g_warning ("no results fd: %s",
+			   error != NULL ? error->message : "no file descriptor in reply");
+		pk_results_set_partial (state->results, TRUE);
+	} else {
+		if (!pk_client_read_results_fd (state, fd, format, &error)) {
+			g_warning ("failed to read results fd: %s", error->message);
+			pk_results_set_partial (state->results, TRUE);
+		}
+		close (fd);
+	}
+	pk_client_signal_finished_results (state);
 }
 
 /*
@@ -1146,25 +1569,36 @@ pk_client_signal_finished (PkClientState *state,
 		return;
 	}
 
-	/* do we have to copy results? */
-	if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES &&
-	    state->directory != NULL &&
-	    exit_enum != PK_EXIT_ENUM_CANCELLED) {
-		pk_client_copy_downloaded (state);
+	/* large result sets were not sent as signals, a cancelled
+	 * transaction still returns what it found */
+	if (state->results_fd) {
+		g_dbus_connection_call_with_unix_fd_list (state->connection,
+							  pk_client_state_get_bus_name (state),
+							  state->tid,
+							  PK_DBUS_INTERFACE_TRANSACTION,
+							  "GetResultsFd",
+							  NULL,
+							  G_VARIANT_TYPE ("(hs)"),
+							  G_DBUS_CALL_FLAGS_NONE,
+							  PK_CLIENT_DBUS_METHOD_TIMEOUT,
+							  NULL,
+							  state->cancellable,
+							  pk_client_get_results_fd_cb,
+							  g_object_ref (state));
 		return;
 	}
 
-	/* we're done */
-	state->ret = TRUE;
-	pk_client_state_finish (state, NULL);
+	pk_client_signal_finished_results (state);
 }
 
 /*
  * pk_client_signal_cb:
  **/
 static void
-pk_client_signal_cb (GDBusProxy *proxy,
+pk_client_signal_cb (GDBusConnection *connection,
 		     const gchar *sender_name,
+		     const gchar *object_path,
+		     const gchar *interface_name,
 		     const gchar *signal_name,
 		     GVariant *parameters,
 		     gpointer user_data)
@@ -1208,6 +1642,24 @@ pk_client_signal_cb (GDBusProxy *proxy,
 					  tmp_str[2]);
 		return;
 	}
+	if (g_strcmp0 (signal_name, "Packages") == 0) {
+		g_autoptr(GVariantIter) iter = NULL;
+		g_variant_get (parameters, "(a(uss))", &iter);
+		while (g_variant_iter_next (iter,
+					    "(u&s&s)",
+					    &tmp_uint,
+					    &tmp_str[1],
+					    &tmp_str[2])) {
+			tmp_uint2 = tmp_uint & 0xFFFF;
+			tmp_uint3 = (tmp_uint >> 16) & 0xFFFF;
+			pk_client_signal_package (state,
+						  tmp_uint2,
+						  tmp_uint3,
+						  tmp_str[1],
+						  tmp_str[2]);
+		}
+		return;
+	}
 	if (g_strcmp0 (signal_name, "Details") == 0) {
 		gchar *key;
 		GVariantIter *dictionary;
@@ -1249,7 +1701,14 @@ pk_client_signal_cb (GDBusProxy *proxy,
 				      "transaction-id", state->transaction_id,
 				      NULL);
 		}
-		pk_results_add_details (state->results, item);
+		if (state->cache_results) {
+			pk_details_cache_add_details (pk_client_get_shared_details_cache (),
+						      state->installed_epoch,
+						      state->available_epoch,
+						      item);
+		}
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_details (state->results, item);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "UpdateDetail") == 0) {
@@ -1285,7 +1744,14 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_update_detail (state->results, item);
+		if (state->cache_results) {
+			pk_details_cache_add_update_detail (pk_client_get_shared_details_cache (),
+							    state->installed_epoch,
+							    state->available_epoch,
+							    item);
+		}
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_update_detail (state->results, item);
 		g_free (tmp_strv[0]);
 		g_free (tmp_strv[1]);
 		g_free (tmp_strv[2]);
@@ -1318,7 +1784,30 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "PkSource::role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_transaction (state->results, item);
+		g_set_object (&state->last_transaction, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_transaction (state->results, item);
+		return;
+	}
+	if (g_strcmp0 (signal_name, "TransactionResources") == 0) {
+		guint64 cpu_time, memory_growth, bytes_emitted;
+		g_variant_get (parameters,
+			       "(&ottt)",
+			       &tmp_str[0],
+			       &cpu_time,
+			       &memory_growth,
+			       &bytes_emitted);
+
+		/* always sent straight after ::Transaction */
+		if (state->last_transaction == NULL ||
+		    g_strcmp0 (pk_transaction_past_get_id (state->last_transaction),
+			       tmp_str[0]) != 0)
+			return;
+		g_object_set (state->last_transaction,
+			      "cpu-time", cpu_time,
+			      "memory-growth", memory_growth,
+			      "bytes-emitted", bytes_emitted,
+			      NULL);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "DistroUpgrade") == 0) {
@@ -1336,7 +1825,8 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_distro_upgrade (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_distro_upgrade (state->results, item);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "RequireRestart") == 0) {
@@ -1352,7 +1842,8 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_require_restart (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_require_restart (state->results, item);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "Category") == 0) {
@@ -1374,24 +1865,17 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_category (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_category (state->results, item);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "Files") == 0) {
 		g_autofree gchar **files = NULL;
-		g_autoptr(PkFiles) item = NULL;
 		g_variant_get (parameters,
 			       "(&s^a&s)",
 			       &tmp_str[0],
 			       &files);
-		item = pk_files_new ();
-		g_object_set (item,
-			      "package-id", tmp_str[0],
-			      "files", files,
-			      "role", state->role,
-			      "transaction-id", state->transaction_id,
-			      NULL);
-		pk_results_add_files (state->results, item);
+		pk_client_signal_files (state, tmp_str[0], files);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "RepoSignatureRequired") == 0) {
@@ -1457,7 +1941,8 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      "role", state->role,
 			      "transaction-id", state->transaction_id,
 			      NULL);
-		pk_results_add_repo_detail (state->results, item);
+		if (!pk_client_state_stream_item (state, item))
+			pk_results_add_repo_detail (state->results, item);
 		return;
 	}
 	if (g_strcmp0 (signal_name, "ErrorCode") == 0) {
@@ -1510,10 +1995,28 @@ pk_client_signal_cb (GDBusProxy *proxy,
 			      NULL);
 		ret = pk_progress_set_item_progress (state->progress,
 						     item);
-		if (ret && state->progress_callback != NULL) {
-			state->progress_callback (state->progress,
-						  PK_PROGRESS_TYPE_ITEM_PROGRESS,
-						  state->progress_user_data);
+		if (ret)
+			pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_ITEM_PROGRESS);
+		return;
+	}
+	if (g_strcmp0 (signal_name, "ItemsProgress") == 0) {
+		GVariantIter iter;
+		g_autoptr(GVariant) items = NULL;
+		g_variant_get (parameters, "(@a(suu))", &items);
+		g_variant_iter_init (&iter, items);
+		while (g_variant_iter_next (&iter, "(&suu)",
+					    &tmp_str[0], &tmp_uint, &tmp_uint2)) {
+			g_autoptr(PkItemProgress) item = pk_item_progress_new ();
+			g_object_set (item,
+				      "package-id", tmp_str[0],
+				      "status", tmp_uint,
+				      "percentage", tmp_uint2,
+				      "transaction-id", state->transaction_id,
+				      NULL);
+			ret = pk_progress_set_item_progress (state->progress,
+							     item);
+			if (ret)
+				pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_ITEM_PROGRESS);
 		}
 		return;
 	}
@@ -1521,17 +2024,12 @@ pk_client_signal_cb (GDBusProxy *proxy,
 		return;
 }
 
+/*
+ * pk_client_state_daemon_vanished:
+ **/
 static void
-pk_client_notify_name_owner_cb (GObject *obj,
-				GParamSpec *pspec,
-				gpointer user_data)
+pk_client_state_daemon_vanished (PkClientState *state)
 {
-	GWeakRef *weak_ref = user_data;
-	g_autoptr(PkClientState) state = g_weak_ref_get (weak_ref);
-
-	if (!state)
-		return;
-
 	if (state->waiting_for_finished) {
 		g_autoptr(GError) local_error = NULL;
 
@@ -1539,41 +2037,216 @@ pk_client_notify_name_owner_cb (GObject *obj,
 						   "PackageKit daemon disappeared");
 		pk_client_state_finish (state, local_error);
 	} else {
-		pk_client_state_unset_proxy (state);
+		pk_client_state_unsubscribe (state);
 		g_cancellable_cancel (state->cancellable);
 	}
 }
 
 /*
- * pk_client_proxy_connect:
+ * pk_client_name_owner_changed_cb:
  **/
 static void
-pk_client_proxy_connect (PkClientState *state)
+pk_client_name_owner_changed_cb (GDBusConnection *connection,
+				 const gchar *sender_name,
+				 const gchar *object_path,
+				 const gchar *interface_name,
+				 const gchar *signal_name,
+				 GVariant *parameters,
+				 gpointer user_data)
 {
+	const gchar *new_owner;
 	guint i;
-	g_auto(GStrv) props = NULL;
-
-	/* coldplug properties */
-	props = g_dbus_proxy_get_cached_property_names (state->proxy);
-	for (i = 0; props != NULL && props[i] != NULL; i++) {
-		g_autoptr(GVariant) value_tmp = NULL;
-		value_tmp = g_dbus_proxy_get_cached_property (state->proxy,
-							      props[i]);
-		pk_client_set_property_value (state,
-					      props[i],
-					      value_tmp);
-	}
-
-	/* connect up signals */
-	g_signal_connect_data (state->proxy, "g-properties-changed",
-			       G_CALLBACK (pk_client_properties_changed_cb),
-			       pk_client_weak_ref_new (state), pk_client_weak_ref_free_gclosure, 0);
-	g_signal_connect_data (state->proxy, "g-signal",
-			       G_CALLBACK (pk_client_signal_cb),
-			       pk_client_weak_ref_new (state), pk_client_weak_ref_free_gclosure, 0);
-	g_signal_connect_data (state->proxy, "notify::g-name-owner",
-			       G_CALLBACK (pk_client_notify_name_owner_cb),
-			       pk_client_weak_ref_new (state), pk_client_weak_ref_free_gclosure, 0);
+	GWeakRef *weak_ref = user_data;
+	g_autoptr(GPtrArray) calls = NULL;
+	g_autoptr(PkClient) client = g_weak_ref_get (weak_ref);
+
+	if (client == NULL)
+		return;
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sss)")))
+		return;
+	g_variant_get (parameters, "(&s&s&s)", NULL, NULL, &new_owner);
+	if (new_owner[0] != '\0')
+		return;
+
+	/* finishing a call removes it from the list */
+	calls = g_ptr_array_new_with_free_func (g_object_unref);
+	for (i = 0; i < client->priv->calls->len; i++) {
+		PkClientState *state = g_ptr_array_index (client->priv->calls, i);
+		if (state->connection != NULL)
+			g_ptr_array_add (calls, g_object_ref (state));
+	}
+	for (i = 0; i < calls->len; i++)
+		pk_client_state_daemon_vanished (g_ptr_array_index (calls, i));
+}
+
+/*
+ * pk_client_get_connection:
+ *
+ * Returns the system bus connection shared by all the transactions of
+ * the client, watching for the daemon going away on first use.
+ **/
+static GDBusConnection *
+pk_client_get_connection (PkClient *client, GError **error)
+{
+	PkClientPrivate *priv = client->priv;
+
+	if (priv->connection != NULL)
+		return priv->connection;
+
+	priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, error);
+	if (priv->connection == NULL)
+		return NULL;
+	priv->name_owner_id =
+		g_dbus_connection_signal_subscribe (priv->connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    PK_DBUS_SERVICE,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_name_owner_changed_cb,
+						    pk_client_weak_ref_new (client),
+						    pk_client_weak_ref_free);
+	return priv->connection;
+}
+
+/*
+ * pk_client_get_peer_connection:
+ *
+ * Returns the private connection to the daemon, connecting if there is
+ * none yet, or %NULL when the daemon does not accept them.
+ **/
+static GDBusConnection *
+pk_client_get_peer_connection (PkClient *client)
+{
+	PkClientPrivate *priv = client->priv;
+	g_autoptr(GError) error = NULL;
+
+	if (priv->peer_connection != NULL &&
+	    !g_dbus_connection_is_closed (priv->peer_connection))
+		return priv->peer_connection;
+	g_clear_object (&priv->peer_connection);
+
+	/* not configured, or the daemon is not running */
+	if (!g_file_test (PK_DBUS_PEER_SOCKET, G_FILE_TEST_EXISTS))
+		return NULL;
+	priv->peer_connection =
+		g_dbus_connection_new_for_address_sync ("unix:path=" PK_DBUS_PEER_SOCKET,
+							G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+							NULL, NULL, &error);
+	if (priv->peer_connection == NULL) {
+		g_debug ("no private connection: %s", error->message);
+		return NULL;
+	}
+	return priv->peer_connection;
+}
+
+/*
+ * pk_client_state_subscribe:
+ *
+ * Subscribes to the signals of the transaction on the shared connection.
+ * This has to happen before the transaction is started so nothing is lost.
+ **/
+static void
+pk_client_state_subscribe_member (PkClientState *state, const gchar *member)
+{
+	guint signal_id;
+
+	signal_id = g_dbus_connection_signal_subscribe (state->connection,
+							pk_client_state_get_bus_name (state),
+							PK_DBUS_INTERFACE_TRANSACTION,
+							member,
+							state->tid,
+							NULL,
+							G_DBUS_SIGNAL_FLAGS_NONE,
+							pk_client_signal_cb,
+							pk_client_weak_ref_new (state),
+							pk_client_weak_ref_free);
+	g_array_append_val (state->signal_ids, signal_id);
+}
+
+static void
+pk_client_state_subscribe (PkClientState *state)
+{
+	gchar **signal_filter = state->client->priv->signal_filter;
+
+	/* one match rule per member, so the bus only sends what we asked for */
+	if (signal_filter != NULL) {
+		const gchar *required[] = { "Finished",
+					    "ErrorCode",
+					    "Destroy",
+					    "EulaRequired",
+					    "MediaChangeRequired",
+					    "RepoSignatureRequired",
+					    NULL };
+		for (guint i = 0; required[i] != NULL; i++)
+			pk_client_state_subscribe_member (state, required[i]);
+		for (guint i = 0; signal_filter[i] != NULL; i++) {
+			if (g_strv_contains (required, signal_filter[i]))
+				continue;
+			pk_client_state_subscribe_member (state, signal_filter[i]);
+		}
+	} else {
+		pk_client_state_subscribe_member (state, NULL);
+	}
+	state->properties_id =
+		g_dbus_connection_signal_subscribe (state->connection,
+						    pk_client_state_get_bus_name (state),
+						    "org.freedesktop.DBus.Properties",
+						    "PropertiesChanged",
+						    state->tid,
+						    PK_DBUS_INTERFACE_TRANSACTION,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_client_properties_changed_cb,
+						    pk_client_weak_ref_new (state),
+						    pk_client_weak_ref_free);
+}
+
+/*
+ * pk_client_state_get_properties:
+ *
+ * Only needed for transactions that already exist, as new transactions
+ * report any change from the initial values.
+ **/
+static void
+pk_client_state_get_properties (PkClientState *state,
+				GAsyncReadyCallback callback)
+{
+	g_dbus_connection_call (state->connection,
+				pk_client_state_get_bus_name (state),
+				state->tid,
+				"org.freedesktop.DBus.Properties",
+				"GetAll",
+				g_variant_new ("(s)", PK_DBUS_INTERFACE_TRANSACTION),
+				G_VARIANT_TYPE ("(a{sv})"),
+				G_DBUS_CALL_FLAGS_NONE,
+				PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				state->cancellable,
+				callback,
+				state);
+}
+
+/*
+ * pk_client_state_get_properties_finish:
+ **/
+static gboolean
+pk_client_state_get_properties_finish (PkClientState *state,
+				       GAsyncResult *res,
+				       GError **error)
+{
+	const gchar *key;
+	GVariant *value;
+	GVariantIter *iter;
+	g_autoptr(GVariant) reply = NULL;
+
+	reply = g_dbus_connection_call_finish (state->connection, res, error);
+	if (reply == NULL)
+		return FALSE;
+	g_variant_get (reply, "(a{sv})", &iter);
+	while (g_variant_iter_loop (iter, "{&sv}", &key, &value))
+		pk_client_set_property_value (state, key, value);
+	g_variant_iter_free (iter);
+	return TRUE;
 }
 
 /*
@@ -1584,13 +2257,13 @@ pk_client_method_cb (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
-	PkClientState *state = (PkClientState *) user_data;
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
 	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
@@ -1602,6 +2275,73 @@ pk_client_method_cb (GObject *source_object,
 	state->waiting_for_finished = TRUE;
 }
 
+static void pk_client_copy_non_native_then_get_tid (PkClientState *state);
+
+/*
+ * pk_client_install_files_fd_cb:
+ *
+ * An older daemon that has no InstallFilesFd gets the copies instead.
+ */
+static void
+pk_client_install_files_fd_cb (GObject *source_object,
+			       GAsyncResult *res,
+			       gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = g_dbus_connection_call_with_unix_fd_list_finish (connection, NULL, res, &error);
+	if (value == NULL &&
+	    g_error_matches (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD)) {
+		g_debug ("daemon has no InstallFilesFd, copying the files instead");
+		g_clear_object (&state->files_fd_list);
+		pk_client_state_unsubscribe (state);
+		g_clear_pointer (&state->tid, g_free);
+		for (guint i = 0; state->files[i] != NULL; i++) {
+			if (!pk_client_is_file_native (state->files[i]))
+				state->refcount++;
+		}
+		pk_client_copy_non_native_then_get_tid (state);
+		return;
+	}
+	if (value == NULL) {
+		pk_client_fixup_dbus_error (error);
+		pk_client_state_finish (state, error);
+		return;
+	}
+
+	/* wait for ::Finished() or notify::g-name-owner (if the daemon disappears) */
+	state->waiting_for_finished = TRUE;
+}
+
+/*
+ * pk_client_open_files:
+ *
+ * Return value: the opened files, or %NULL if any of them can't be read
+ **/
+static GUnixFDList *
+pk_client_open_files (gchar **files)
+{
+	g_autoptr(GUnixFDList) fd_list = g_unix_fd_list_new ();
+
+	for (guint i = 0; files[i] != NULL; i++) {
+		gint fd = g_open (files[i], O_RDONLY | O_CLOEXEC, 0);
+		if (fd < 0) {
+			g_debug ("cannot open %s: %s", files[i], g_strerror (errno));
+			return NULL;
+		}
+		if (g_unix_fd_list_append (fd_list, fd, NULL) < 0) {
+			close (fd);
+			return NULL;
+		}
+		/* the list holds a dup */
+		close (fd);
+	}
+	return g_steal_pointer (&fd_list);
+}
+
 /*
  * pk_client_set_role:
  **/
@@ -1612,11 +2352,8 @@ pk_client_set_role (PkClientState *state, PkRoleEnum role)
 	pk_progress_set_transaction_flags (state->progress,
 					   state->transaction_flags);
 	ret = pk_progress_set_role (state->progress, role);
-	if (ret && state->progress_callback != NULL) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_ROLE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_ROLE);
 	return;
 }
 
@@ -1628,381 +2365,404 @@ pk_client_set_hints_cb (GObject *source_object,
 			GAsyncResult *res,
 			gpointer user_data)
 {
-	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
-	PkClientState *state = (PkClientState *) user_data;
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = user_data;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GVariant) value = NULL;
 
-	/* get the result */
-	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	/* get the result, the method call has already been sent */
+	value = g_dbus_connection_call_finish (connection, res, &error);
 	if (value == NULL) {
 		/* fix up the D-Bus error */
 		pk_client_fixup_dbus_error (error);
 		pk_client_state_finish (state, error);
 		return;
 	}
+}
 
-	/* we'll have results from now on */
-	state->results = pk_results_new ();
-	g_object_set (state->results,
-		      "role", state->role,
-		      "progress", state->progress,
-		      "transaction-flags", state->transaction_flags,
-		      NULL);
-
+/*
+ * pk_client_call_method:
+ **/
+static void
+pk_client_call_method (PkClientState *state)
+{
 	/* do this async, although this should be pretty fast anyway */
 	if (state->role == PK_ROLE_ENUM_RESOLVE) {
-		g_dbus_proxy_call (state->proxy, "Resolve",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "Resolve",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_NAME) {
-		g_dbus_proxy_call (state->proxy, "SearchNames",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchNames",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "SearchDetails",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchDetails",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_GROUP) {
-		g_dbus_proxy_call (state->proxy, "SearchGroups",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchGroups",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_SEARCH_FILE) {
-		g_dbus_proxy_call (state->proxy, "SearchFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "SearchFiles",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
-		g_dbus_proxy_call (state->proxy, "GetDetails",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetDetails",
+				      g_variant_new ("(^a&s)",
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_DETAILS_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetDetailsLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetDetailsLocal",
+				      g_variant_new ("(^a&s)",
+						     state->files),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES_LOCAL) {
-		g_dbus_proxy_call (state->proxy, "GetFilesLocal",
-				   g_variant_new ("(^a&s)",
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetFilesLocal",
+				      g_variant_new ("(^a&s)",
+						     state->files),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL) {
-		g_dbus_proxy_call (state->proxy, "GetUpdateDetail",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetUpdateDetail",
+				      g_variant_new ("(^a&s)",
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS) {
-		g_dbus_proxy_call (state->proxy, "GetOldTransactions",
-				   g_variant_new ("(u)",
-						  state->number),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetOldTransactions",
+				      g_variant_new ("(u)",
+						     state->number),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_DOWNLOAD_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "DownloadPackages",
-				   g_variant_new ("(b^a&s)",
-						  (state->directory == NULL),
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "DownloadPackages",
+				      g_variant_new ("(b^a&s)",
+						     (state->directory == NULL),
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_UPDATES) {
-		g_dbus_proxy_call (state->proxy, "GetUpdates",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetUpdates",
+				      g_variant_new ("(t)",
+						     state->filters),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_DEPENDS_ON) {
-		g_dbus_proxy_call (state->proxy, "DependsOn",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "DependsOn",
+				      g_variant_new ("(t^a&sb)",
+						     state->filters,
+						     state->package_ids,
+						     state->recursive),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 
 	} else if (state->role == PK_ROLE_ENUM_REQUIRED_BY) {
-		g_dbus_proxy_call (state->proxy, "RequiredBy",
-				   g_variant_new ("(t^a&sb)",
-						  state->filters,
-						  state->package_ids,
-						  state->recursive),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RequiredBy",
+				      g_variant_new ("(t^a&sb)",
+						     state->filters,
+						     state->package_ids,
+						     state->recursive),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "GetPackages",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetPackages",
+				      g_variant_new ("(t)",
+						     state->filters),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_WHAT_PROVIDES) {
-		g_dbus_proxy_call (state->proxy, "WhatProvides",
-				   g_variant_new ("(t^a&s)",
-						  state->filters,
-						  state->search),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "WhatProvides",
+				      g_variant_new ("(t^a&s)",
+						     state->filters,
+						     state->search),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_GET_DISTRO_UPGRADES) {
-		g_dbus_proxy_call (state->proxy, "GetDistroUpgrades",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetDistroUpgrades",
+				      NULL,
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_GET_FILES) {
-		g_dbus_proxy_call (state->proxy, "GetFiles",
-				   g_variant_new ("(^a&s)",
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetFiles",
+				      g_variant_new ("(^a&s)",
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_GET_CATEGORIES) {
-		g_dbus_proxy_call (state->proxy, "GetCategories",
-				   NULL,
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetCategories",
+				      NULL,
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_REMOVE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "RemovePackages",
-				   g_variant_new ("(t^a&sbb)",
-						  state->transaction_flags,
-						  state->package_ids,
-						  state->allow_deps,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RemovePackages",
+				      g_variant_new ("(t^a&sbb)",
+						     state->transaction_flags,
+						     state->package_ids,
+						     state->allow_deps,
+						     state->autoremove),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_REFRESH_CACHE) {
-		g_dbus_proxy_call (state->proxy, "RefreshCache",
-				   g_variant_new ("(b)",
-						  state->force),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RefreshCache",
+				      g_variant_new ("(b)",
+						     state->force),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "InstallPackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "InstallPackages",
+				      g_variant_new ("(t^a&s)",
+						     state->transaction_flags,
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_SIGNATURE) {
-		g_dbus_proxy_call (state->proxy, "InstallSignature",
-				   g_variant_new ("(uss)",
-						  state->type,
-						  state->key_id,
-						  state->package_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "InstallSignature",
+				      g_variant_new ("(uss)",
+						     state->type,
+						     state->key_id,
+						     state->package_id),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_UPDATE_PACKAGES) {
-		g_dbus_proxy_call (state->proxy, "UpdatePackages",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->package_ids),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "UpdatePackages",
+				      g_variant_new ("(t^a&s)",
+						     state->transaction_flags,
+						     state->package_ids),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->package_ids),
 			      NULL);
+	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES &&
+		   state->files_fd_list != NULL) {
+		GVariantBuilder handles;
+		g_variant_builder_init (&handles, G_VARIANT_TYPE ("ah"));
+		for (gint i = 0; i < g_unix_fd_list_get_length (state->files_fd_list); i++)
+			g_variant_builder_add (&handles, "h", i);
+		g_dbus_connection_call_with_unix_fd_list (state->connection,
+							  pk_client_state_get_bus_name (state),
+							  state->tid,
+							  PK_DBUS_INTERFACE_TRANSACTION,
+							  "InstallFilesFd",
+							  g_variant_new ("(tah)",
+									 state->transaction_flags,
+									 &handles),
+							  NULL,
+							  G_DBUS_CALL_FLAGS_NONE,
+							  PK_CLIENT_DBUS_METHOD_TIMEOUT,
+							  state->files_fd_list,
+							  state->cancellable,
+							  pk_client_install_files_fd_cb,
+							  g_object_ref (state));
+		g_object_set (state->results,
+			      "inputs", g_strv_length (state->files),
+			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_INSTALL_FILES) {
-		g_dbus_proxy_call (state->proxy, "InstallFiles",
-				   g_variant_new ("(t^a&s)",
-						  state->transaction_flags,
-						  state->files),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "InstallFiles",
+				      g_variant_new ("(t^a&s)",
+						     state->transaction_flags,
+						     state->files),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 		g_object_set (state->results,
 			      "inputs", g_strv_length (state->files),
 			      NULL);
 	} else if (state->role == PK_ROLE_ENUM_ACCEPT_EULA) {
-		g_dbus_proxy_call (state->proxy, "AcceptEula",
-				   g_variant_new ("(s)",
-						  state->eula_id),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "AcceptEula",
+				      g_variant_new ("(s)",
+						     state->eula_id),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_GET_REPO_LIST) {
-		g_dbus_proxy_call (state->proxy, "GetRepoList",
-				   g_variant_new ("(t)",
-						  state->filters),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "GetRepoList",
+				      g_variant_new ("(t)",
+						     state->filters),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_REPO_ENABLE) {
-		g_dbus_proxy_call (state->proxy, "RepoEnable",
-				   g_variant_new ("(sb)",
-						  state->repo_id,
-						  state->enabled),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepoEnable",
+				      g_variant_new ("(sb)",
+						     state->repo_id,
+						     state->enabled),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_REPO_SET_DATA) {
-		g_dbus_proxy_call (state->proxy, "RepoSetData",
-				   g_variant_new ("(sss)",
-						  state->repo_id,
-						  state->parameter ? state->parameter : "",
-						  state->value ? state->value : ""),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepoSetData",
+				      g_variant_new ("(sss)",
+						     state->repo_id,
+						     state->parameter ? state->parameter : "",
+						     state->value ? state->value : ""),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_REPO_REMOVE) {
-		g_dbus_proxy_call (state->proxy, "RepoRemove",
-				   g_variant_new ("(tsb)",
-						  state->transaction_flags,
-						  state->repo_id,
-						  state->autoremove),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepoRemove",
+				      g_variant_new ("(tsb)",
+						     state->transaction_flags,
+						     state->repo_id,
+						     state->autoremove),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "UpgradeSystem",
-				   g_variant_new ("(tsu)",
-						  state->transaction_flags,
-						  state->distro_id,
-						  state->upgrade_kind),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "UpgradeSystem",
+				      g_variant_new ("(tsu)",
+						     state->transaction_flags,
+						     state->distro_id,
+						     state->upgrade_kind),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else if (state->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
-		g_dbus_proxy_call (state->proxy, "RepairSystem",
-				   g_variant_new ("(t)",
-						  state->transaction_flags),
-				   G_DBUS_CALL_FLAGS_NONE,
-				   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-				   state->cancellable,
-				   pk_client_method_cb,
-				   state);
+		pk_client_state_call (state, "RepairSystem",
+				      g_variant_new ("(t)",
+						     state->transaction_flags),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+				      state->cancellable,
+				      pk_client_method_cb,
+				      g_object_ref (state));
 	} else {
 		g_assert_not_reached ();
 	}
@@ -2111,6 +2871,7 @@ pk_client_create_helper_socket (PkClientState *state)
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *socket_filename = NULL;
 	g_autofree gchar *socket_id = NULL;
+	g_autofree gchar *tid_name = NULL;
 	g_auto(GStrv) argv = NULL;
 	g_auto(GStrv) envp = NULL;
 
@@ -2146,7 +2907,8 @@ pk_client_create_helper_socket (PkClientState *state)
 	state->client_helper = pk_client_helper_new ();
 
 	/* create socket to read from /tmp */
-	socket_id = g_strdup_printf ("gpk-%s.socket", &state->tid[1]);
+	tid_name = g_path_get_basename (state->tid);
+	socket_id = g_strdup_printf ("gpk-%s.socket", tid_name);
 	socket_filename = g_build_filename (g_get_tmp_dir (), socket_id, NULL);
 
 	/* start the helper process */
@@ -2161,24 +2923,131 @@ pk_client_create_helper_socket (PkClientState *state)
 }
 
 /*
- * pk_client_get_proxy_cb:
+ * pk_client_state_create_results:
  **/
 static void
-pk_client_get_proxy_cb (GObject *object,
-			GAsyncResult *res,
-			gpointer user_data)
+pk_client_state_create_results (PkClientState *state)
+{
+	guint i;
+
+	/* stream items to the callback, unless we need them ourselves to
+	 * copy the downloads or to show what a simulation would do */
+	state->stream = state->client->priv->results_mode == PK_CLIENT_RESULTS_MODE_STREAM &&
+			state->client->priv->item_callback != NULL &&
+			state->role != PK_ROLE_ENUM_DOWNLOAD_PACKAGES &&
+			!pk_bitfield_contain (state->transaction_flags,
+					      PK_TRANSACTION_FLAG_ENUM_SIMULATE);
+
+	state->results = pk_results_new ();
+	g_object_set (state->results,
+		      "role", state->role,
+		      "progress", state->progress,
+		      "transaction-flags", state->transaction_flags,
+		      NULL);
+
+	/* what the details cache already answered */
+	for (i = 0; state->cached_items != NULL && i < state->cached_items->len; i++) {
+		gpointer item = g_ptr_array_index (state->cached_items, i);
+		if (pk_client_state_stream_item (state, item))
+			continue;
+		if (PK_IS_DETAILS (item))
+			pk_results_add_details (state->results, item);
+		else
+			pk_results_add_update_detail (state->results, item);
+	}
+
+	/* the epochs are known once we are talking to the daemon, and any
+	 * change from now on moves them past what we store */
+	if (state->client->priv->details_cache &&
+	    (state->role == PK_ROLE_ENUM_GET_DETAILS ||
+	     state->role == PK_ROLE_ENUM_GET_UPDATE_DETAIL)) {
+		g_object_get (state->client->priv->control,
+			      "installed-epoch", &state->installed_epoch,
+			      "available-epoch", &state->available_epoch,
+			      NULL);
+		state->cache_results = state->installed_epoch != 0 &&
+				       state->available_epoch != 0;
+	}
+}
+
+/*
+ * pk_client_state_use_details_cache:
+ *
+ * Takes the ids the details cache can answer out of the request.
+ *
+ * Return value: %TRUE if the request has been answered completely
+ **/
+static gboolean
+pk_client_state_use_details_cache (PkClientState *state)
+{
+	guint i;
+	guint64 installed_epoch = 0;
+	guint64 available_epoch = 0;
+	g_autoptr(GPtrArray) missing = NULL;
+
+	if (!state->client->priv->details_cache)
+		return FALSE;
+
+	/* not connected, so we can't tell if anything is still valid */
+	g_object_get (state->client->priv->control,
+		      "installed-epoch", &installed_epoch,
+		      "available-epoch", &available_epoch,
+		      NULL);
+	if (installed_epoch == 0 || available_epoch == 0)
+		return FALSE;
+
+	state->cached_items = g_ptr_array_new_with_free_func (g_object_unref);
+	missing = g_ptr_array_new ();
+	for (i = 0; state->package_ids[i] != NULL; i++) {
+		gpointer item;
+
+		if (state->role == PK_ROLE_ENUM_GET_DETAILS) {
+			item = pk_details_cache_lookup_details (pk_client_get_shared_details_cache (),
+								installed_epoch,
+								available_epoch,
+								state->package_ids[i]);
+		} else {
+			item = pk_details_cache_lookup_update_detail (pk_client_get_shared_details_cache (),
+								      installed_epoch,
+								      available_epoch,
+								      state->package_ids[i]);
+		}
+		if (item == NULL) {
+			g_ptr_array_add (missing, g_strdup (state->package_ids[i]));
+			continue;
+		}
+		g_object_set (item, "role", state->role, NULL);
+		g_ptr_array_add (state->cached_items, item);
+	}
+	g_debug ("%u of %u found in the details cache",
+		 state->cached_items->len, g_strv_length (state->package_ids));
+
+	/* only ask the daemon for the rest */
+	if (missing->len > 0) {
+		g_ptr_array_add (missing, NULL);
+		g_strfreev (state->package_ids);
+		state->package_ids = (gchar **) g_ptr_array_free (g_steal_pointer (&missing), FALSE);
+		return FALSE;
+	}
+
+	pk_client_state_create_results (state);
+	pk_results_set_exit_code (state->results, PK_EXIT_ENUM_SUCCESS);
+	state->ret = TRUE;
+	pk_client_state_finish (state, NULL);
+	return TRUE;
+}
+
+/*
+ * pk_client_state_start:
+ **/
+static void
+pk_client_state_start (PkClientState *state)
 {
 	gchar *hint;
-	PkClientState *state = (PkClientState *) user_data;
-	g_autoptr(GError) error = NULL;
 	g_autoptr(GPtrArray) array = NULL;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL)
-		g_error ("Cannot connect to PackageKit on %s", state->tid);
-
-	/* connect */
-	pk_client_proxy_connect (state);
+	/* subscribe before anything can be emitted */
+	pk_client_state_subscribe (state);
 
 	/* get hints */
 	array = g_ptr_array_new_with_free_func (g_free);
@@ -2206,6 +3075,68 @@ pk_client_get_proxy_cb (GObject *object,
 		g_ptr_array_add (array, hint);
 	}
 
+	/* items-progress, older daemons just ignore this */
+	hint = g_strdup ("items-progress=true");
+	g_ptr_array_add (array, hint);
+
+	/* batch-size, older daemons just ignore this */
+	hint = g_strdup_printf ("batch-size=%u", PK_CLIENT_PACKAGES_BATCH_SIZE);
+	g_ptr_array_add (array, hint);
+
+	/* results-fd for the roles that can return huge result sets */
+	if (state->role == PK_ROLE_ENUM_GET_PACKAGES ||
+	    state->role == PK_ROLE_ENUM_GET_FILES ||
+	    state->role == PK_ROLE_ENUM_SEARCH_FILE) {
+		g_ptr_array_add (array, g_strdup ("results-fd=true"));
+		state->results_fd = TRUE;
+	}
+
+	/* plan, to commit what an earlier simulation solved */
+	if (state->plan != NULL) {
+		hint = g_strdup_printf ("plan=%s", state->plan);
+		g_ptr_array_add (array, hint);
+	}
+
+	/* one page of a query */
+	if (state->client->priv->limit > 0) {
+		hint = g_strdup_printf ("limit=%u", state->client->priv->limit);
+		g_ptr_array_add (array, hint);
+	}
+	if (state->cursor != NULL) {
+		hint = g_strdup_printf ("cursor=%s", state->cursor);
+		g_ptr_array_add (array, hint);
+	}
+
+	/* when the results are wanted by */
+	if (state->client->priv->deadline_ms > 0) {
+		hint = g_strdup_printf ("deadline-ms=%u", state->client->priv->deadline_ms);
+		g_ptr_array_add (array, hint);
+	}
+
+	/* only some fields of the results */
+	if (state->client->priv->fields != NULL) {
+		g_autofree gchar *fields = g_strjoinv (";", state->client->priv->fields);
+		hint = g_strdup_printf ("fields=%s", fields);
+		g_ptr_array_add (array, hint);
+	}
+
+	/* search-as-you-type */
+	if (state->client->priv->search_session != NULL &&
+	    (state->role == PK_ROLE_ENUM_SEARCH_NAME ||
+	     state->role == PK_ROLE_ENUM_SEARCH_DETAILS ||
+	     state->role == PK_ROLE_ENUM_SEARCH_GROUP ||
+	     state->role == PK_ROLE_ENUM_SEARCH_FILE)) {
+		hint = g_strdup_printf ("search-session=%s",
+					state->client->priv->search_session);
+		g_ptr_array_add (array, hint);
+	}
+
+	/* let the daemon merge queued installs and updates */
+	if (state->client->priv->coalesce &&
+	    (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	     state->role == PK_ROLE_ENUM_UPDATE_PACKAGES))
+		g_ptr_array_add (array, g_strdup ("coalesce=true"));
+
 	/* create socket for roles that need interaction */
 	if (state->role == PK_ROLE_ENUM_INSTALL_FILES ||
 	    state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
@@ -2216,21 +3147,90 @@ pk_client_get_proxy_cb (GObject *object,
 			g_ptr_array_add (array, hint);
 	}
 
-	/* set hints */
+	/* we'll have results from now on */
+	pk_client_state_create_results (state);
+
+	/* set hints, and send the method straight after it as the daemon
+	 * handles both in order without us waiting for the reply */
 	g_ptr_array_add (array, NULL);
-	g_dbus_proxy_call (state->proxy, "SetHints",
-			   g_variant_new ("(^a&s)",
-					  array->pdata),
-			   G_DBUS_CALL_FLAGS_NONE,
-			   PK_CLIENT_DBUS_METHOD_TIMEOUT,
-			   state->cancellable,
-			   pk_client_set_hints_cb,
-			   state);
+	pk_client_state_call (state, "SetHints",
+			      g_variant_new ("(^a&s)",
+					     array->pdata),
+			      G_DBUS_CALL_FLAGS_NONE,
+			      PK_CLIENT_DBUS_METHOD_TIMEOUT,
+			      state->cancellable,
+			      pk_client_set_hints_cb,
+			      g_object_ref (state));
+	pk_client_call_method (state);
 
 	/* track state */
 	g_ptr_array_add (state->client->priv->calls, state);
 }
 
+/*
+ * pk_client_role_prefers_peer:
+ *
+ * The roles that can return thousands of results, and are worth a
+ * round trip to attach them to the private connection.
+ **/
+static gboolean
+pk_client_role_prefers_peer (PkRoleEnum role)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_DETAILS_LOCAL:
+	case PK_ROLE_ENUM_GET_FILES:
+	case PK_ROLE_ENUM_GET_FILES_LOCAL:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * pk_client_attach_cb:
+ **/
+static void
+pk_client_attach_cb (GObject *source_object,
+		     GAsyncResult *res,
+		     gpointer user_data)
+{
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	g_autoptr(PkClientState) state = user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* an older daemon, or the transaction was refused, so use the bus */
+	value = g_dbus_connection_call_finish (connection, res, &error);
+	if (value == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			pk_client_state_finish (state, error);
+			return;
+		}
+		g_debug ("failed to attach %s: %s", state->tid, error->message);
+		g_clear_error (&error);
+		state->connection = pk_client_get_connection (state->client, &error);
+		if (state->connection == NULL) {
+			pk_client_state_finish (state, error);
+			return;
+		}
+	} else {
+		state->connection = connection;
+	}
+	g_object_ref (state->connection);
+	pk_client_state_start (state);
+}
+
 /*
  * pk_client_get_tid_cb:
  **/
@@ -2238,6 +3238,7 @@ static void
 pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 {
 	PkControl *control = PK_CONTROL (object);
+	GDBusConnection *peer_connection;
 	g_autoptr(GError) error = NULL;
 
 	state->tid = pk_control_get_tid_finish (control, res, &error);
@@ -2248,16 +3249,34 @@ pk_client_get_tid_cb (GObject *object, GAsyncResult *res, PkClientState *state)
 
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_get_proxy_cb,
-				  state);
+	/* skip the bus daemon for the large result sets when we can */
+	if (pk_client_role_prefers_peer (state->role)) {
+		peer_connection = pk_client_get_peer_connection (state->client);
+		if (peer_connection != NULL) {
+			g_dbus_connection_call (peer_connection,
+						NULL,
+						PK_DBUS_PATH,
+						PK_DBUS_INTERFACE_PEER,
+						"Attach",
+						g_variant_new ("(o)", state->tid),
+						NULL,
+						G_DBUS_CALL_FLAGS_NONE,
+						PK_CLIENT_DBUS_METHOD_TIMEOUT,
+						state->cancellable,
+						pk_client_attach_cb,
+						g_object_ref (state));
+			return;
+		}
+	}
+
+	/* use the shared connection rather than a proxy per transaction */
+	state->connection = pk_client_get_connection (state->client, &error);
+	if (state->connection == NULL) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+	g_object_ref (state->connection);
+	pk_client_state_start (state);
 }
 
 /**
@@ -2595,6 +3614,10 @@ pk_client_get_details_async (PkClient *client, gchar **package_ids, GCancellable
 		return;
 	}
 
+	/* answered without a transaction */
+	if (pk_client_state_use_details_cache (state))
+		return;
+
 	/* identify */
 	pk_client_set_role (state, state->role);
 
@@ -2759,6 +3782,10 @@ pk_client_get_update_detail_async (PkClient *client, gchar **package_ids, GCance
 		return;
 	}
 
+	/* answered without a transaction */
+	if (pk_client_state_use_details_cache (state))
+		return;
+
 	/* identify */
 	pk_client_set_role (state, state->role);
 
@@ -3613,11 +4640,8 @@ pk_client_copy_non_native_then_get_tid (PkClientState *state)
 
 	/* save percentage */
 	ret = pk_progress_set_percentage (state->progress, -1);
-	if (state->progress_callback != NULL && ret) {
-		state->progress_callback (state->progress,
-					  PK_PROGRESS_TYPE_PERCENTAGE,
-					  state->progress_user_data);
-	}
+	if (ret)
+		pk_client_state_progress_changed (state, PK_PROGRESS_TYPE_PERCENTAGE);
 
 	/* copy each file that is non-native */
 	for (i = 0; state->files[i] != NULL; i++) {
@@ -3714,6 +4738,13 @@ pk_client_install_files_async (PkClient *client,
 			state->refcount++;
 	}
 
+	/* the daemon can read what we can open, without a copy */
+	if (state->refcount > 0) {
+		state->files_fd_list = pk_client_open_files (state->files);
+		if (state->files_fd_list != NULL)
+			state->refcount = 0;
+	}
+
 	/* nothing to copy, common case */
 	if (state->refcount == 0) {
 		/* just get tid */
@@ -4114,24 +5145,21 @@ pk_client_repair_system_async (PkClient *client,
 /**********************************************************************/
 
 /*
- * pk_client_adopt_get_proxy_cb:
+ * pk_client_adopt_get_properties_cb:
  **/
 static void
-pk_client_adopt_get_proxy_cb (GObject *object,
-			      GAsyncResult *res,
-			      gpointer user_data)
+pk_client_adopt_get_properties_cb (GObject *object,
+				   GAsyncResult *res,
+				   gpointer user_data)
 {
 	g_autoptr(GError) error = NULL;
 	PkClientState *state = (PkClientState *) user_data;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
+	if (!pk_client_state_get_properties_finish (state, res, &error)) {
+		pk_client_fixup_dbus_error (error);
 		pk_client_state_finish (state, error);
 		return;
 	}
-
-	/* connect */
-	pk_client_proxy_connect (state);
 }
 
 /**
@@ -4187,19 +5215,18 @@ pk_client_adopt_async (PkClient *client,
 	pk_client_set_role (state, state->role);
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_adopt_get_proxy_cb,
-				  state);
-
 	/* track state */
 	pk_client_state_add (client, state);
+
+	/* watch the transaction, then get the current values */
+	state->connection = pk_client_get_connection (client, &error);
+	if (state->connection == NULL) {
+		pk_client_state_finish (state, error);
+		return;
+	}
+	g_object_ref (state->connection);
+	pk_client_state_subscribe (state);
+	pk_client_state_get_properties (state, pk_client_adopt_get_properties_cb);
 }
 
 /**********************************************************************/
@@ -4245,10 +5272,7 @@ pk_client_get_progress_state_finish (PkClientState *state, const GError *error)
 	g_clear_object (&state->cancellable);
 	g_clear_object (&state->cancellable_client);
 
-	pk_client_state_unset_proxy (state);
-
-	if (state->proxy_props != NULL)
-		g_object_unref (G_OBJECT (state->proxy_props));
+	pk_client_state_unsubscribe (state);
 
 	if (state->ret) {
 		g_simple_async_result_set_op_res_gpointer (state->res,
@@ -4279,15 +5303,12 @@ pk_client_get_progress_cb (GObject *source_object,
 	g_autoptr(GError) error = NULL;
 	PkClientState *state = (PkClientState *) user_data;
 
-	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
-	if (state->proxy == NULL) {
+	if (!pk_client_state_get_properties_finish (state, res, &error)) {
+		pk_client_fixup_dbus_error (error);
 		pk_client_get_progress_state_finish (state, error);
 		return;
 	}
 
-	/* connect */
-	pk_client_proxy_connect (state);
-
 	state->ret = TRUE;
 	pk_client_get_progress_state_finish (state, NULL);
 }
@@ -4333,19 +5354,17 @@ pk_client_get_progress_async (PkClient *client,
 	/* identify */
 	pk_progress_set_transaction_id (state->progress, state->tid);
 
-	/* get a connection to the transaction interface */
-	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
-				  G_DBUS_PROXY_FLAGS_NONE,
-				  NULL,
-				  PK_DBUS_SERVICE,
-				  state->tid,
-				  PK_DBUS_INTERFACE_TRANSACTION,
-				  state->cancellable,
-				  pk_client_get_progress_cb,
-				  state);
-
 	/* track state */
 	pk_client_state_add (client, state);
+
+	/* get the current values */
+	state->connection = pk_client_get_connection (client, &error);
+	if (state->connection == NULL) {
+		pk_client_get_progress_state_finish (state, error);
+		return;
+	}
+	g_object_ref (state->connection);
+	pk_client_state_get_properties (state, pk_client_get_progress_cb);
 }
 
 /**********************************************************************/
@@ -4364,7 +5383,7 @@ pk_client_cancel_all_dbus_methods (PkClient *client)
 	array = client->priv->calls;
 	for (i = 0; i < array->len; i++) {
 		state = g_ptr_array_index (array, i);
-		if (state->proxy == NULL)
+		if (state->connection == NULL)
 			continue;
 		g_debug ("cancel in flight call");
 		g_cancellable_cancel (state->cancellable);
@@ -4547,6 +5566,399 @@ pk_client_get_cache_age (PkClient *client)
 	return client->priv->cache_age;
 }
 
+/*
+ * pk_client_set_plan:
+ *
+ * Sets the plan token given by a simulation, which is used by the next
+ * transaction the client starts and then forgotten.
+ **/
+void
+pk_client_set_plan (PkClient *client, const gchar *plan)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	g_free (client->priv->plan);
+	client->priv->plan = g_strdup (plan);
+}
+
+/**
+ * pk_client_set_limit:
+ * @client: a valid #PkClient instance
+ * @limit: the most packages to return, or 0 for all of them
+ *
+ * Sets how many packages pk_client_get_packages_async(),
+ * pk_client_what_provides_async() and the searches return. If the daemon
+ * has more, pk_results_get_cursor() is set and the next page can be asked
+ * for with pk_client_set_cursor(). Older daemons ignore the limit.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_limit (PkClient *client, guint limit)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	client->priv->limit = limit;
+}
+
+/**
+ * pk_client_get_limit:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: the most packages a query returns, or 0 for all of them
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_client_get_limit (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), 0);
+	return client->priv->limit;
+}
+
+/**
+ * pk_client_set_cursor:
+ * @client: a valid #PkClient instance
+ * @cursor: (nullable): the value of pk_results_get_cursor()
+ *
+ * Sets where the next page of a query starts. The cursor is used by the
+ * next transaction the client starts and then forgotten.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_cursor (PkClient *client, const gchar *cursor)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	g_free (client->priv->cursor);
+	client->priv->cursor = g_strdup (cursor);
+}
+
+/**
+ * pk_client_set_deadline:
+ * @client: a valid #PkClient instance
+ * @deadline_ms: how many milliseconds after it starts the results of a
+ * transaction are wanted by, or 0 for no deadline
+ *
+ * Queued transactions with earlier deadlines are run first, and the
+ * backend may leave optional detail out to meet the deadline, in which
+ * case pk_results_get_partial() is set. Older daemons ignore it.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_deadline (PkClient *client, guint deadline_ms)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	client->priv->deadline_ms = deadline_ms;
+}
+
+/**
+ * pk_client_get_deadline:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: the deadline of the transactions in milliseconds, or 0
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_client_get_deadline (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), 0);
+	return client->priv->deadline_ms;
+}
+
+/**
+ * pk_client_set_fields:
+ * @client: a valid #PkClient instance
+ * @fields: (nullable) (array zero-terminated=1): the optional fields to
+ * get, e.g. "summary", or %NULL for all of them
+ *
+ * Sets which optional fields of packages, details and update details the
+ * daemon sends, so a client that only needs the package IDs can pass an
+ * empty list and the backend can skip looking the others up. The fields
+ * left out are empty or unset in the results. Older daemons ignore it.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_fields (PkClient *client, gchar **fields)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	g_strfreev (client->priv->fields);
+	client->priv->fields = g_strdupv (fields);
+}
+
+/**
+ * pk_client_get_fields:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: (transfer none) (array zero-terminated=1): the optional
+ * fields the daemon sends, or %NULL for all of them
+ *
+ * Since: 1.2.5
+ **/
+gchar **
+pk_client_get_fields (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), NULL);
+	return client->priv->fields;
+}
+
+/**
+ * pk_client_set_search_session:
+ * @client: a valid #PkClient instance
+ * @search_session: (nullable): from pk_control_create_search_session_async()
+ *
+ * Sets the search session used by all the searches the client starts,
+ * or %NULL to stop using one.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_search_session (PkClient *client, const gchar *search_session)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	g_free (client->priv->search_session);
+	client->priv->search_session = g_strdup (search_session);
+}
+
+/**
+ * pk_client_get_search_session:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: the search session, or %NULL if unset
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+pk_client_get_search_session (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), NULL);
+	return client->priv->search_session;
+}
+
+/**
+ * pk_client_set_coalesce:
+ * @client: a valid #PkClient instance
+ * @coalesce: if queued transactions may be merged
+ *
+ * Lets the daemon merge the package installs and updates the client
+ * starts with the others the same user queued in the same session, so
+ * that the dependencies are solved and the package triggers run once.
+ * Each transaction still gets the packages it asked for, and if the
+ * merged transaction fails they are run one by one.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_coalesce (PkClient *client, gboolean coalesce)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	client->priv->coalesce = coalesce;
+}
+
+/**
+ * pk_client_get_coalesce:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: %TRUE if queued transactions may be merged
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_client_get_coalesce (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), FALSE);
+	return client->priv->coalesce;
+}
+
+/**
+ * pk_client_set_results_mode:
+ * @client: a valid #PkClient instance
+ * @results_mode: a #PkClientResultsMode
+ *
+ * Sets how the items emitted by the transactions started after this call
+ * are handled. With %PK_CLIENT_RESULTS_MODE_STREAM each package, file list,
+ * details or other item is handed to the callback set with
+ * pk_client_set_item_callback() as it arrives, and is not kept in the
+ * #PkResults, so that memory use stays flat for huge result sets.
+ *
+ * The exit code, the error code and the items needed to continue a
+ * transaction such as #PkEulaRequired are always kept in the results.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_results_mode (PkClient *client, PkClientResultsMode results_mode)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+	g_return_if_fail (results_mode < PK_CLIENT_RESULTS_MODE_LAST);
+
+	if (client->priv->results_mode == results_mode)
+		return;
+
+	client->priv->results_mode = results_mode;
+	g_object_notify (G_OBJECT (client), "results-mode");
+}
+
+/**
+ * pk_client_get_results_mode:
+ * @client: a valid #PkClient instance
+ *
+ * Gets how the items emitted by transactions are handled.
+ *
+ * Return value: a #PkClientResultsMode
+ *
+ * Since: 1.2.5
+ **/
+PkClientResultsMode
+pk_client_get_results_mode (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), PK_CLIENT_RESULTS_MODE_COLLECT);
+	return client->priv->results_mode;
+}
+
+/**
+ * pk_client_set_details_cache:
+ * @client: a valid #PkClient instance
+ * @details_cache: if the cache should be used
+ *
+ * Keeps the results of pk_client_get_details_async() and
+ * pk_client_get_update_detail_async() in a cache shared by the user's
+ * processes. Later requests are answered from it without a transaction
+ * for as long as the daemon reports the same package epochs, and only
+ * the package-ids missing from it are sent to the daemon.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_details_cache (PkClient *client, gboolean details_cache)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	if (client->priv->details_cache == details_cache)
+		return;
+
+	client->priv->details_cache = details_cache;
+	g_object_notify (G_OBJECT (client), "details-cache");
+}
+
+/**
+ * pk_client_get_details_cache:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: %TRUE if details are cached
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_client_get_details_cache (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), FALSE);
+	return client->priv->details_cache;
+}
+
+/**
+ * pk_client_set_progress_interval:
+ * @client: a valid #PkClient instance
+ * @progress_interval: the shortest time between callbacks in ms, or 0
+ *
+ * Coalesces the percentage, speed, elapsed, remaining and download size
+ * changes so the progress callback runs at most once per interval for
+ * them, with the latest values. Status changes and the end of the
+ * transaction deliver anything pending straight away.
+ *
+ * The default of 0 runs the callback for every change.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_progress_interval (PkClient *client, guint progress_interval)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	if (client->priv->progress_interval == progress_interval)
+		return;
+
+	client->priv->progress_interval = progress_interval;
+	g_object_notify (G_OBJECT (client), "progress-interval");
+}
+
+/**
+ * pk_client_get_progress_interval:
+ * @client: a valid #PkClient instance
+ *
+ * Return value: the progress interval in ms, or 0 if not coalescing
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_client_get_progress_interval (PkClient *client)
+{
+	g_return_val_if_fail (PK_IS_CLIENT (client), 0);
+	return client->priv->progress_interval;
+}
+
+/**
+ * pk_client_set_item_callback:
+ * @client: a valid #PkClient instance
+ * @item_callback: (scope notified) (nullable): the function to run for each item
+ * @user_data: data to pass to @item_callback
+ * @destroy: (nullable): function to free @user_data, or %NULL
+ *
+ * Sets the function that receives the items of the transactions when the
+ * results mode is %PK_CLIENT_RESULTS_MODE_STREAM. The item is only valid
+ * for the duration of the call unless a reference is taken.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_item_callback (PkClient *client,
+			     PkClientItemCallback item_callback,
+			     gpointer user_data,
+			     GDestroyNotify destroy)
+{
+	PkClientPrivate *priv;
+
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	priv = client->priv;
+	if (priv->item_destroy != NULL)
+		priv->item_destroy (priv->item_user_data);
+	priv->item_callback = item_callback;
+	priv->item_user_data = user_data;
+	priv->item_destroy = destroy;
+}
+
+/**
+ * pk_client_set_signal_filter:
+ * @client: a valid #PkClient instance
+ * @signals: (array zero-terminated=1) (nullable): D-Bus signal names, e.g. "Package"
+ *
+ * Limits the transaction signals received by the transactions started or
+ * adopted after this call to @signals, which is useful for monitoring
+ * clients that are not interested in every package of every transaction.
+ * The filtering is done by the message bus, so the unwanted signals are
+ * never delivered to this process.
+ *
+ * The signals needed to finish a transaction, such as "Finished" and
+ * "ErrorCode", and the property changes used for progress are always
+ * received. Use %NULL to receive all signals again.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_client_set_signal_filter (PkClient *client, gchar **signals)
+{
+	g_return_if_fail (PK_IS_CLIENT (client));
+
+	g_strfreev (client->priv->signal_filter);
+	client->priv->signal_filter = g_strdupv (signals);
+}
+
 /*
  * pk_client_class_init:
  **/
@@ -4610,6 +6022,38 @@ pk_client_class_init (PkClientClass *klass)
 				   0, G_MAXUINT, 0,
 				   G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_CACHE_AGE, pspec);
+
+	/**
+	 * PkClient:results-mode:
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint ("results-mode", NULL, NULL,
+				   PK_CLIENT_RESULTS_MODE_COLLECT,
+				   PK_CLIENT_RESULTS_MODE_LAST - 1,
+				   PK_CLIENT_RESULTS_MODE_COLLECT,
+				   G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_RESULTS_MODE, pspec);
+
+	/**
+	 * PkClient:details-cache:
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_boolean ("details-cache", NULL, NULL,
+				      FALSE,
+				      G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_DETAILS_CACHE, pspec);
+
+	/**
+	 * PkClient:progress-interval:
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint ("progress-interval", NULL, NULL,
+				   0, G_MAXUINT, 0,
+				   G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_PROGRESS_INTERVAL, pspec);
 }
 
 /*
@@ -4644,7 +6088,19 @@ pk_client_finalize (GObject *object)
 	/* ensure we cancel any in-flight DBus calls */
 	pk_client_cancel_all_dbus_methods (client);
 
+	if (priv->name_owner_id > 0)
+		g_dbus_connection_signal_unsubscribe (priv->connection,
+						      priv->name_owner_id);
+	g_clear_object (&priv->connection);
+	g_clear_object (&priv->peer_connection);
+	if (priv->item_destroy != NULL)
+		priv->item_destroy (priv->item_user_data);
 	g_free (client->priv->locale);
+	g_free (priv->plan);
+	g_free (priv->cursor);
+	g_free (priv->search_session);
+	g_strfreev (priv->fields);
+	g_strfreev (priv->signal_filter);
 	g_object_unref (priv->control);
 	g_ptr_array_unref (priv->calls);
 
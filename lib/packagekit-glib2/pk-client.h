@@ -77,10 +77,41 @@ typedef enum
 	PK_CLIENT_ERROR_LAST
 } PkClientError;
 
+/**
+ * PkClientResultsMode:
+ * @PK_CLIENT_RESULTS_MODE_COLLECT: items are added to the #PkResults
+ * @PK_CLIENT_RESULTS_MODE_STREAM: items are passed to the item callback and not kept
+ * @PK_CLIENT_RESULTS_MODE_LAST:
+ *
+ * How the items emitted by a transaction are handled.
+ *
+ * Since: 1.2.5
+ */
+typedef enum
+{
+	PK_CLIENT_RESULTS_MODE_COLLECT,
+	PK_CLIENT_RESULTS_MODE_STREAM,
+	PK_CLIENT_RESULTS_MODE_LAST
+} PkClientResultsMode;
+
 typedef struct _PkClientPrivate		PkClientPrivate;
 typedef struct _PkClient		PkClient;
 typedef struct _PkClientClass		PkClientClass;
 
+/**
+ * PkClientItemCallback:
+ * @client: the #PkClient
+ * @item: the #PkPackage, #PkFiles, #PkDetails or other item
+ * @user_data: user data passed to pk_client_set_item_callback()
+ *
+ * Receives the items of a transaction in %PK_CLIENT_RESULTS_MODE_STREAM.
+ *
+ * Since: 1.2.5
+ */
+typedef void (*PkClientItemCallback)	(PkClient		*client,
+					 PkSource		*item,
+					 gpointer		 user_data);
+
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkClient, g_object_unref)
 #endif
@@ -429,6 +460,38 @@ gboolean	 pk_client_get_idle			(PkClient		*client);
 void		 pk_client_set_cache_age		(PkClient		*client,
 							 guint			 cache_age);
 guint		 pk_client_get_cache_age		(PkClient		*client);
+void		 pk_client_set_limit			(PkClient		*client,
+							 guint			 limit);
+guint		 pk_client_get_limit			(PkClient		*client);
+void		 pk_client_set_cursor			(PkClient		*client,
+							 const gchar		*cursor);
+void		 pk_client_set_deadline			(PkClient		*client,
+							 guint			 deadline_ms);
+guint		 pk_client_get_deadline			(PkClient		*client);
+void		 pk_client_set_fields			(PkClient		*client,
+							 gchar			**fields);
+gchar		**pk_client_get_fields			(PkClient		*client);
+void		 pk_client_set_search_session		(PkClient		*client,
+							 const gchar		*search_session);
+const gchar	*pk_client_get_search_session		(PkClient		*client);
+void		 pk_client_set_coalesce			(PkClient		*client,
+							 gboolean		 coalesce);
+gboolean	 pk_client_get_coalesce			(PkClient		*client);
+void		 pk_client_set_results_mode		(PkClient		*client,
+							 PkClientResultsMode	 results_mode);
+PkClientResultsMode pk_client_get_results_mode		(PkClient		*client);
+void		 pk_client_set_details_cache		(PkClient		*client,
+							 gboolean		 details_cache);
+gboolean	 pk_client_get_details_cache		(PkClient		*client);
+void		 pk_client_set_progress_interval	(PkClient		*client,
+							 guint			 progress_interval);
+guint		 pk_client_get_progress_interval	(PkClient		*client);
+void		 pk_client_set_item_callback		(PkClient		*client,
+							 PkClientItemCallback	 item_callback,
+							 gpointer		 user_data,
+							 GDestroyNotify		 destroy);
+void		 pk_client_set_signal_filter		(PkClient		*client,
+							 gchar			**signals);
 
 G_END_DECLS
 
@@ -0,0 +1,442 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * The daemon writes the index after the package lists change, and the
+ * command-not-found handler maps it to look up commands without starting
+ * a transaction. The file has a header, an array of entries sorted by
+ * command and then by package-id, an array of deletes, and the strings
+ * the entries point to. It is read on the machine that wrote it, so
+ * native byte order is used.
+ *
+ * The deletes make finding similar commands a handful of binary searches:
+ * every command is stored under itself and under each string made by
+ * removing one character, so two names within one edit of each other
+ * always share a key.
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <string.h>
+
+#include "pk-command-index-private.h"
+
+#define PK_COMMAND_INDEX_MAGIC		"PKCMDIX2"
+
+typedef struct {
+	gchar			 magic[8];
+	guint32			 n_entries;
+	guint32			 n_deletes;
+	guint32			 strings_size;
+	guint32			 reserved;
+} PkCommandIndexHeader;
+
+typedef struct {
+	guint32			 command;	/* offsets into the strings */
+	guint32			 package_id;
+} PkCommandIndexEntry;
+
+struct _PkCommandIndex
+{
+	GMappedFile			*mapped;
+	const PkCommandIndexEntry	*entries;
+	const PkCommandIndexEntry	*deletes;	/* key, command */
+	const gchar			*strings;
+	guint32				 n_entries;
+	guint32				 n_deletes;
+	guint32				 strings_size;
+};
+
+/* the directories command-not-found looks in */
+static const gchar *pk_command_index_prefixes[] = {
+	"/usr/bin",
+	"/usr/sbin",
+	"/bin",
+	"/sbin",
+	NULL };
+
+/*
+ * pk_command_index_get_command:
+ * @filename: a file from a package
+ *
+ * Return value: the command name, or %NULL if the file is not in one of
+ * the directories commands are searched in
+ **/
+const gchar *
+pk_command_index_get_command (const gchar *filename)
+{
+	const gchar *basename;
+	gsize len;
+
+	basename = strrchr (filename, '/');
+	if (basename == NULL || basename[1] == '\0')
+		return NULL;
+	len = basename - filename;
+	for (guint i = 0; pk_command_index_prefixes[i] != NULL; i++) {
+		if (strlen (pk_command_index_prefixes[i]) == len &&
+		    strncmp (filename, pk_command_index_prefixes[i], len) == 0)
+			return basename + 1;
+	}
+	return NULL;
+}
+
+static guint32
+pk_command_index_add_string (GString *strings, GHashTable *offsets, const gchar *str)
+{
+	gpointer offset;
+
+	if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+		return GPOINTER_TO_UINT (offset);
+	offset = GUINT_TO_POINTER (strings->len);
+	g_string_append_len (strings, str, strlen (str) + 1);
+	g_hash_table_insert (offsets, g_strdup (str), offset);
+	return GPOINTER_TO_UINT (offset);
+}
+
+/* the key with each character removed in turn */
+static GPtrArray *
+pk_command_index_get_deletes (const gchar *command)
+{
+	GPtrArray *deletes = g_ptr_array_new_with_free_func (g_free);
+	gchar *key = g_ascii_strdown (command, -1);
+	gsize len = strlen (key);
+
+	for (gsize i = 0; i < len; i++) {
+		gchar *tmp;
+		if (i > 0 && key[i] == key[i - 1])
+			continue;
+		tmp = g_new (gchar, len);
+		memcpy (tmp, key, i);
+		memcpy (tmp + i, key + i + 1, len - i);
+		g_ptr_array_add (deletes, tmp);
+	}
+	g_ptr_array_add (deletes, key);
+	return deletes;
+}
+
+static gint
+pk_command_index_sort_deletes_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const PkCommandIndexEntry *entry_a = a;
+	const PkCommandIndexEntry *entry_b = b;
+	const gchar *strings = user_data;
+	gint rc;
+
+	rc = strcmp (strings + entry_a->command, strings + entry_b->command);
+	if (rc != 0)
+		return rc;
+	return strcmp (strings + entry_a->package_id, strings + entry_b->package_id);
+}
+
+static gint
+pk_command_index_sort_cb (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*((const gchar **) a), *((const gchar **) b));
+}
+
+/*
+ * pk_command_index_save:
+ * @commands: (element-type utf8 GPtrArray): command names to arrays of package-ids
+ * @filename: the file to write
+ * @error: A #GError or %NULL
+ *
+ * Writes a new index, replacing the file atomically so that readers that
+ * still have the old one mapped are not affected.
+ *
+ * Return value: %TRUE for success, else %FALSE and @error set
+ **/
+gboolean
+pk_command_index_save (GHashTable *commands, const gchar *filename, GError **error)
+{
+	GHashTableIter iter;
+	gpointer key;
+	PkCommandIndexHeader header;
+	g_autoptr(GArray) deletes = NULL;
+	g_autoptr(GArray) entries = NULL;
+	g_autoptr(GHashTable) offsets = NULL;
+	g_autoptr(GPtrArray) names = NULL;
+	g_autoptr(GString) data = NULL;
+	g_autoptr(GString) strings = NULL;
+
+	entries = g_array_new (FALSE, FALSE, sizeof (PkCommandIndexEntry));
+	deletes = g_array_new (FALSE, FALSE, sizeof (PkCommandIndexEntry));
+	offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	strings = g_string_new (NULL);
+
+	/* sorted by command, then by package-id */
+	names = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, commands);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_ptr_array_add (names, key);
+	g_ptr_array_sort (names, pk_command_index_sort_cb);
+	for (guint i = 0; i < names->len; i++) {
+		const gchar *command = g_ptr_array_index (names, i);
+		GPtrArray *package_ids = g_hash_table_lookup (commands, command);
+		g_autoptr(GPtrArray) keys = pk_command_index_get_deletes (command);
+		g_autoptr(GPtrArray) sorted = g_ptr_array_new ();
+
+		for (guint j = 0; j < keys->len; j++) {
+			PkCommandIndexEntry entry;
+			entry.command = pk_command_index_add_string (strings, offsets,
+								     g_ptr_array_index (keys, j));
+			entry.package_id = pk_command_index_add_string (strings, offsets, command);
+			g_array_append_val (deletes, entry);
+		}
+
+		for (guint j = 0; j < package_ids->len; j++)
+			g_ptr_array_add (sorted, g_ptr_array_index (package_ids, j));
+		g_ptr_array_sort (sorted, pk_command_index_sort_cb);
+		for (guint j = 0; j < sorted->len; j++) {
+			PkCommandIndexEntry entry;
+			const gchar *package_id = g_ptr_array_index (sorted, j);
+			if (j > 0 && strcmp (package_id, g_ptr_array_index (sorted, j - 1)) == 0)
+				continue;
+			entry.command = pk_command_index_add_string (strings, offsets, command);
+			entry.package_id = pk_command_index_add_string (strings, offsets, package_id);
+			g_array_append_val (entries, entry);
+		}
+	}
+
+	g_array_sort_with_data (deletes, pk_command_index_sort_deletes_cb, strings->str);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, PK_COMMAND_INDEX_MAGIC, sizeof (header.magic));
+	header.n_entries = entries->len;
+	header.n_deletes = deletes->len;
+	header.strings_size = strings->len;
+	data = g_string_sized_new (sizeof (header) +
+				   (entries->len + deletes->len) * sizeof (PkCommandIndexEntry) +
+				   strings->len);
+	g_string_append_len (data, (const gchar *) &header, sizeof (header));
+	g_string_append_len (data, entries->data,
+			     entries->len * sizeof (PkCommandIndexEntry));
+	g_string_append_len (data, deletes->data,
+			     deletes->len * sizeof (PkCommandIndexEntry));
+	g_string_append_len (data, strings->str, strings->len);
+	return g_file_set_contents (filename, data->str, data->len, error);
+}
+
+/*
+ * pk_command_index_new_from_file:
+ * @filename: the index to map
+ * @error: A #GError or %NULL
+ *
+ * Return value: the index, or %NULL if it does not exist or is invalid
+ **/
+PkCommandIndex *
+pk_command_index_new_from_file (const gchar *filename, GError **error)
+{
+	const PkCommandIndexHeader *header;
+	const gchar *contents;
+	gsize len;
+	guint64 expected;
+	g_autoptr(GMappedFile) mapped = NULL;
+	PkCommandIndex *index;
+
+	mapped = g_mapped_file_new (filename, FALSE, error);
+	if (mapped == NULL)
+		return NULL;
+	contents = g_mapped_file_get_contents (mapped);
+	len = g_mapped_file_get_length (mapped);
+	if (len < sizeof (PkCommandIndexHeader)) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+			     "%s is too small", filename);
+		return NULL;
+	}
+	header = (const PkCommandIndexHeader *) contents;
+	if (memcmp (header->magic, PK_COMMAND_INDEX_MAGIC, sizeof (header->magic)) != 0) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+			     "%s is not a command index", filename);
+		return NULL;
+	}
+	expected = sizeof (PkCommandIndexHeader) +
+		   ((guint64) header->n_entries + header->n_deletes) * sizeof (PkCommandIndexEntry) +
+		   header->strings_size;
+	if (expected != len ||
+	    (header->strings_size > 0 && contents[len - 1] != '\0')) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+			     "%s is truncated", filename);
+		return NULL;
+	}
+
+	index = g_new0 (PkCommandIndex, 1);
+	index->mapped = g_steal_pointer (&mapped);
+	index->n_entries = header->n_entries;
+	index->n_deletes = header->n_deletes;
+	index->strings_size = header->strings_size;
+	index->entries = (const PkCommandIndexEntry *) (contents + sizeof (PkCommandIndexHeader));
+	index->deletes = index->entries + header->n_entries;
+	index->strings = (const gchar *) (index->deletes + header->n_deletes);
+	return index;
+}
+
+static const gchar *
+pk_command_index_get_string (PkCommandIndex *index, guint32 offset)
+{
+	if (offset >= index->strings_size)
+		return "";
+	return index->strings + offset;
+}
+
+static guint32
+pk_command_index_find_first (PkCommandIndex *index,
+			     const PkCommandIndexEntry *entries,
+			     guint32 n_entries,
+			     const gchar *command)
+{
+	guint32 lo = 0;
+	guint32 hi = n_entries;
+
+	while (lo < hi) {
+		guint32 mid = lo + (hi - lo) / 2;
+		const gchar *tmp = pk_command_index_get_string (index, entries[mid].command);
+		if (strcmp (tmp, command) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * pk_command_index_lookup:
+ * @index: a #PkCommandIndex
+ * @command: the command name, e.g. "powertop"
+ *
+ * Return value: (transfer full): the package-ids providing the command,
+ * or %NULL if there are none
+ **/
+gchar **
+pk_command_index_lookup (PkCommandIndex *index, const gchar *command)
+{
+	g_autoptr(GPtrArray) package_ids = g_ptr_array_new ();
+
+	for (guint32 i = pk_command_index_find_first (index, index->entries,
+						      index->n_entries, command);
+	     i < index->n_entries; i++) {
+		const PkCommandIndexEntry *entry = &index->entries[i];
+		if (strcmp (pk_command_index_get_string (index, entry->command), command) != 0)
+			break;
+		g_ptr_array_add (package_ids,
+				 g_strdup (pk_command_index_get_string (index, entry->package_id)));
+	}
+	if (package_ids->len == 0)
+		return NULL;
+	g_ptr_array_add (package_ids, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&package_ids), FALSE);
+}
+
+/*
+ * pk_command_index_is_similar:
+ * @command: what the user typed
+ * @name: a known command name
+ *
+ * Checks if the two differ by exactly one insertion, deletion, substitution
+ * or swap of neighbouring characters, ignoring ASCII case.
+ *
+ * Return value: %TRUE if @name is a likely correction of @command
+ **/
+gboolean
+pk_command_index_is_similar (const gchar *command, const gchar *name)
+{
+	gsize len_a = strlen (command);
+	gsize len_b = strlen (name);
+	gsize i = 0;
+
+	if (strcmp (command, name) == 0)
+		return FALSE;
+	if (len_a > len_b + 1 || len_b > len_a + 1)
+		return FALSE;
+
+	/* skip the common prefix */
+	while (i < len_a && i < len_b &&
+	       g_ascii_tolower (command[i]) == g_ascii_tolower (name[i]))
+		i++;
+	if (i == len_a && i == len_b)
+		return TRUE;
+
+	/* the rest has to match after one edit */
+	if (len_a == len_b) {
+		if (g_ascii_strcasecmp (command + i + 1, name + i + 1) == 0)
+			return TRUE;
+		return i + 1 < len_a &&
+		       g_ascii_tolower (command[i]) == g_ascii_tolower (name[i + 1]) &&
+		       g_ascii_tolower (command[i + 1]) == g_ascii_tolower (name[i]) &&
+		       g_ascii_strcasecmp (command + i + 2, name + i + 2) == 0;
+	}
+	if (len_a > len_b)
+		return g_ascii_strcasecmp (command + i + 1, name + i) == 0;
+	return g_ascii_strcasecmp (command + i, name + i + 1) == 0;
+}
+
+/*
+ * pk_command_index_find_similar:
+ * @index: a #PkCommandIndex
+ * @command: the command name that was not found
+ *
+ * Return value: (transfer full): the sorted command names within one edit
+ * of @command, or %NULL if there are none
+ **/
+gchar **
+pk_command_index_find_similar (PkCommandIndex *index, const gchar *command)
+{
+	g_autoptr(GPtrArray) keys = pk_command_index_get_deletes (command);
+	g_autoptr(GPtrArray) names = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GHashTable) seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (guint i = 0; i < keys->len; i++) {
+		const gchar *key = g_ptr_array_index (keys, i);
+		for (guint32 j = pk_command_index_find_first (index, index->deletes,
+							      index->n_deletes, key);
+		     j < index->n_deletes; j++) {
+			const PkCommandIndexEntry *entry = &index->deletes[j];
+			const gchar *name;
+			if (strcmp (pk_command_index_get_string (index, entry->command), key) != 0)
+				break;
+			name = pk_command_index_get_string (index, entry->package_id);
+			if (g_hash_table_contains (seen, name))
+				continue;
+			g_hash_table_add (seen, (gpointer) name);
+			if (pk_command_index_is_similar (command, name))
+				g_ptr_array_add (names, g_strdup (name));
+		}
+	}
+	if (names->len == 0)
+		return NULL;
+	g_ptr_array_sort (names, pk_command_index_sort_cb);
+	g_ptr_array_add (names, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&names), FALSE);
+}
+
+guint
+pk_command_index_get_size (PkCommandIndex *index)
+{
+	return index->n_entries;
+}
+
+void
+pk_command_index_free (PkCommandIndex *index)
+{
+	g_mapped_file_unref (index->mapped);
+	g_free (index);
+}
@@ -0,0 +1,63 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_COMMAND_INDEX_PRIVATE_H
+#define __PK_COMMAND_INDEX_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* this allows us to override for the self tests */
+#ifndef PK_COMMAND_INDEX_DESTDIR
+#define PK_COMMAND_INDEX_DESTDIR	""
+#endif
+
+/* the index of the commands provided by available packages */
+#define PK_COMMAND_INDEX_FILENAME	PK_COMMAND_INDEX_DESTDIR "/var/lib/PackageKit/command-index"
+
+typedef struct _PkCommandIndex		PkCommandIndex;
+
+const gchar	*pk_command_index_get_command		(const gchar		*filename);
+gboolean	 pk_command_index_save			(GHashTable		*commands,
+							 const gchar		*filename,
+							 GError			**error);
+PkCommandIndex	*pk_command_index_new_from_file		(const gchar		*filename,
+							 GError			**error);
+gchar		**pk_command_index_lookup		(PkCommandIndex		*index,
+							 const gchar		*command);
+gchar		**pk_command_index_find_similar		(PkCommandIndex		*index,
+							 const gchar		*command);
+gboolean	 pk_command_index_is_similar		(const gchar		*command,
+							 const gchar		*name);
+guint		 pk_command_index_get_size		(PkCommandIndex		*index);
+void		 pk_command_index_free			(PkCommandIndex		*index);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkCommandIndex, pk_command_index_free)
+
+G_END_DECLS
+
+#endif /* __PK_COMMAND_INDEX_PRIVATE_H */
@@ -30,8 +30,16 @@
 
 G_BEGIN_DECLS
 
+/* the private peer-to-peer connections, see org.freedesktop.PackageKit.Peer */
+#define PK_DBUS_PEER_SOCKET		LOCALSTATEDIR "/run/PackageKit/bus"
+#define PK_DBUS_INTERFACE_PEER		"org.freedesktop.PackageKit.Peer"
+
+/* every transaction ID is an object below this, see PkScheduler */
+#define PK_DBUS_PATH_TRANSACTION	"/org/freedesktop/PackageKit/Transaction"
+
 gchar		*pk_get_distro_name			(GError		**error);
 gchar		*pk_get_distro_version_id		(GError		**error);
+GMainContext	*pk_sync_context_get			(void);
 
 G_END_DECLS
 
@@ -362,3 +362,27 @@ pk_get_distro_version_id (GError **error)
 
 	return version_id;
 }
+
+/* one per thread, freed when the thread exits */
+static GPrivate pk_sync_context_private = G_PRIVATE_INIT ((GDestroyNotify) g_main_context_unref);
+
+/**
+ * pk_sync_context_get:
+ *
+ * Gets the context the synchronous API runs its loop in. It is created
+ * the first time a thread needs one and is then reused, so each blocking
+ * call does not have to make a new context and wakeup fd. Every thread
+ * has its own, which keeps threaded callers from sharing one.
+ *
+ * Return value: (transfer full): a #GMainContext
+ **/
+GMainContext *
+pk_sync_context_get (void)
+{
+	GMainContext *context = g_private_get (&pk_sync_context_private);
+	if (context == NULL) {
+		context = g_main_context_new ();
+		g_private_set (&pk_sync_context_private, context);
+	}
+	return g_main_context_ref (context);
+}
@@ -67,6 +67,13 @@ G_BEGIN_DECLS
  */
 #define	PK_DBUS_INTERFACE_OFFLINE	"org.freedesktop.PackageKit.Offline"
 
+/**
+ * PK_DBUS_INTERFACE_METRICS:
+ *
+ * The DBUS interface for PackageKit daemon metrics
+ */
+#define	PK_DBUS_INTERFACE_METRICS	"org.freedesktop.PackageKit.Metrics"
+
 /**
  * PK_PACKAGE_LIST_FILENAME:
  *
@@ -27,6 +27,7 @@
 #include <glib.h>
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-control.h>
+#include <packagekit-glib2/pk-common-private.h>
 
 #include "pk-control-sync.h"
 
@@ -76,7 +77,7 @@ pk_control_get_properties (PkControl *control, GCancellable *cancellable, GError
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -133,7 +134,7 @@ pk_control_get_transaction_list (PkControl *control, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -190,7 +191,7 @@ pk_control_suggest_daemon_quit (PkControl *control, GCancellable *cancellable, G
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -261,7 +262,7 @@ pk_control_set_proxy2 (PkControl *control,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkControlHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
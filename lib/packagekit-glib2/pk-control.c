@@ -44,6 +44,9 @@ static void     pk_control_finalize	(GObject     *object);
 
 #define PK_CONTROL_DBUS_METHOD_TIMEOUT		1500 /* ms */
 
+/* stop using leased IDs this long before the daemon destroys them */
+#define PK_CONTROL_LEASE_MARGIN			5 /* s */
+
 /**
  * PkControlPrivate:
  *
@@ -69,7 +72,11 @@ struct _PkControlPrivate
 	gboolean		 locked;
 	PkNetworkEnum		 network_state;
 	gchar			*distro_id;
+	guint64			 installed_epoch;
+	guint64			 available_epoch;
 	guint			 watch_id;
+	GPtrArray		*tid_pool;
+	gint64			 tid_pool_expires;	/* monotonic, in us */
 };
 
 enum {
@@ -77,6 +84,10 @@ enum {
 	SIGNAL_RESTART_SCHEDULE,
 	SIGNAL_UPDATES_CHANGED,
 	SIGNAL_REPO_LIST_CHANGED,
+	SIGNAL_TRANSACTION_ADDED,
+	SIGNAL_TRANSACTION_REMOVED,
+	SIGNAL_UPDATES_DELTA,
+	SIGNAL_REPO_LIST_DELTA,
 	SIGNAL_LAST
 };
 
@@ -97,6 +108,8 @@ enum {
 	PROP_NETWORK_STATE,
 	PROP_CONNECTED,
 	PROP_DISTRO_ID,
+	PROP_INSTALLED_EPOCH,
+	PROP_AVAILABLE_EPOCH,
 	PROP_LAST
 };
 
@@ -110,7 +123,9 @@ typedef struct {
 	gchar			*tid;
 	gchar			**transaction_list;
 	gchar			*daemon_state;
+	gchar			*search_session;
 	guint			 time;
+	guint			 number;
 	gulong			 cancellable_id;
 	GCancellable		*call;
 	GCancellable		*cancellable;
@@ -181,6 +196,7 @@ pk_control_set_property_value (PkControl *control,
 	const gchar *tmp_str;
 	gboolean tmp_bool;
 	guint tmp_uint;
+	guint64 tmp_uint64;
 	PkBitfield tmp_bitfield;
 
 	if (g_strcmp0 (key, "VersionMajor") == 0) {
@@ -304,7 +320,25 @@ pk_control_set_property_value (PkControl *control,
 		g_object_notify (G_OBJECT(control), "distro-id");
 		return;
 	}
-	g_warning ("unhandled property '%s'", key);
+	if (g_strcmp0 (key, "InstalledEpoch") == 0) {
+		tmp_uint64 = g_variant_get_uint64 (value);
+		if (control->priv->installed_epoch == tmp_uint64)
+			return;
+		control->priv->installed_epoch = tmp_uint64;
+		g_object_notify (G_OBJECT(control), "installed-epoch");
+		return;
+	}
+	if (g_strcmp0 (key, "AvailableEpoch") == 0) {
+		tmp_uint64 = g_variant_get_uint64 (value);
+		if (control->priv->available_epoch == tmp_uint64)
+			return;
+		control->priv->available_epoch = tmp_uint64;
+		g_object_notify (G_OBJECT(control), "available-epoch");
+		return;
+	}
+
+	/* newer daemons have properties we don't know about */
+	g_debug ("unhandled property '%s'", key);
 }
 
 /*
@@ -357,6 +391,20 @@ pk_control_signal_cb (GDBusProxy *proxy,
 			       signals[SIGNAL_TRANSACTION_LIST_CHANGED], 0,
 			       ids);
 	}
+	if (g_strcmp0 (signal_name, "TransactionAdded") == 0) {
+		const gchar *tid = NULL;
+		g_variant_get (parameters, "(&o)", &tid);
+		g_debug ("emit transaction-added: %s", tid);
+		g_signal_emit (control, signals[SIGNAL_TRANSACTION_ADDED], 0, tid);
+		return;
+	}
+	if (g_strcmp0 (signal_name, "TransactionRemoved") == 0) {
+		const gchar *tid = NULL;
+		g_variant_get (parameters, "(&o)", &tid);
+		g_debug ("emit transaction-removed: %s", tid);
+		g_signal_emit (control, signals[SIGNAL_TRANSACTION_REMOVED], 0, tid);
+		return;
+	}
 	if (g_strcmp0 (signal_name, "UpdatesChanged") == 0) {
 		g_debug ("emit updates-changed");
 		g_signal_emit (control, signals[SIGNAL_UPDATES_CHANGED], 0);
@@ -367,6 +415,21 @@ pk_control_signal_cb (GDBusProxy *proxy,
 		g_signal_emit (control, signals[SIGNAL_REPO_LIST_CHANGED], 0);
 		return;
 	}
+	if (g_strcmp0 (signal_name, "UpdatesDelta") == 0 ||
+	    g_strcmp0 (signal_name, "RepoListDelta") == 0) {
+		guint64 epoch;
+		g_autofree const gchar **added = NULL;
+		g_autofree const gchar **removed = NULL;
+		g_autofree const gchar **changed = NULL;
+		g_variant_get (parameters, "(t^a&s^a&s^a&s)",
+			       &epoch, &added, &removed, &changed);
+		g_debug ("emit %s %" G_GUINT64_FORMAT, signal_name, epoch);
+		g_signal_emit (control,
+			       signals[g_strcmp0 (signal_name, "UpdatesDelta") == 0 ?
+				       SIGNAL_UPDATES_DELTA : SIGNAL_REPO_LIST_DELTA], 0,
+			       epoch, added, removed, changed);
+		return;
+	}
 	if (g_strcmp0 (signal_name, "RestartSchedule") == 0) {
 		g_debug ("emit restart-schedule");
 		g_signal_emit (control, signals[SIGNAL_RESTART_SCHEDULE], 0);
@@ -472,6 +535,24 @@ pk_control_get_tid_cb (GObject *source_object,
 	pk_control_get_tid_state_finish (state, NULL);
 }
 
+/*
+ * pk_control_take_leased_tid:
+ **/
+static gchar *
+pk_control_take_leased_tid (PkControl *control)
+{
+	PkControlPrivate *priv = control->priv;
+
+	if (priv->tid_pool->len == 0)
+		return NULL;
+	if (g_get_monotonic_time () >= priv->tid_pool_expires) {
+		g_debug ("dropping %u expired leased IDs", priv->tid_pool->len);
+		g_ptr_array_set_size (priv->tid_pool, 0);
+		return NULL;
+	}
+	return g_ptr_array_steal_index (priv->tid_pool, priv->tid_pool->len - 1);
+}
+
 /*
  * pk_control_get_tid_internal:
  **/
@@ -552,6 +633,13 @@ pk_control_get_tid_async (PkControl *control,
 		return;
 	}
 
+	/* use an ID leased in advance if there is one */
+	state->tid = pk_control_take_leased_tid (control);
+	if (state->tid != NULL) {
+		pk_control_get_tid_state_finish (state, NULL);
+		return;
+	}
+
 	/* skip straight to the D-Bus method if already connection */
 	if (control->priv->proxy != NULL) {
 		pk_control_get_tid_internal (state);
@@ -608,6 +696,248 @@ pk_control_get_tid_finish (PkControl *control,
 
 /**********************************************************************/
 
+/*
+ * pk_control_lease_tids_state_finish:
+ **/
+static void
+pk_control_lease_tids_state_finish (PkControlState *state, const GError *error)
+{
+	/* get result */
+	if (state->ret) {
+		g_simple_async_result_set_op_res_gboolean (state->res,
+							   state->ret);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* remove from list */
+	g_ptr_array_remove (state->control->priv->calls, state);
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL) {
+		g_cancellable_disconnect (state->cancellable,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable);
+	}
+	g_object_unref (state->res);
+	g_object_unref (state->control);
+	if (state->proxy != NULL)
+		g_object_unref (state->proxy);
+	g_slice_free (PkControlState, state);
+}
+
+/*
+ * pk_control_lease_tids_cb:
+ **/
+static void
+pk_control_lease_tids_cb (GObject *source_object,
+			  GAsyncResult *res,
+			  gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	PkControlPrivate *priv = state->control->priv;
+	const gchar *tid;
+	gint64 expires;
+	guint lease;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+	g_autoptr(GVariantIter) iter = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_lease_tids_state_finish (state, error);
+		return;
+	}
+
+	/* the whole pool has to be used before the first lease expires */
+	g_variant_get (value, "(aou)", &iter, &lease);
+	if (lease > 2 * PK_CONTROL_LEASE_MARGIN)
+		lease -= PK_CONTROL_LEASE_MARGIN;
+	else
+		lease /= 2;
+	expires = g_get_monotonic_time () + (gint64) lease * G_USEC_PER_SEC;
+	if (priv->tid_pool->len == 0 || expires < priv->tid_pool_expires)
+		priv->tid_pool_expires = expires;
+	while (g_variant_iter_next (iter, "&o", &tid))
+		g_ptr_array_add (priv->tid_pool, g_strdup (tid));
+
+	/* we're done */
+	state->ret = TRUE;
+	pk_control_lease_tids_state_finish (state, NULL);
+}
+
+/*
+ * pk_control_lease_tids_internal:
+ **/
+static void
+pk_control_lease_tids_internal (PkControlState *state)
+{
+	g_dbus_proxy_call (state->control->priv->proxy,
+			   "LeaseTransactions",
+			   g_variant_new ("(u)", state->number),
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CONTROL_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_control_lease_tids_cb,
+			   state);
+}
+
+/*
+ * pk_control_lease_tids_proxy_cb:
+ **/
+static void
+pk_control_lease_tids_proxy_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	g_autoptr(GError) error = NULL;
+	PkControlState *state = (PkControlState *) user_data;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		pk_control_lease_tids_state_finish (state, error);
+		return;
+	}
+	pk_control_proxy_connect (state);
+	pk_control_lease_tids_internal (state);
+}
+
+/**
+ * pk_control_lease_tids_async:
+ * @control: a valid #PkControl instance
+ * @count: the number of transaction IDs wanted
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Gets several transaction IDs from the daemon in one call. They are kept
+ * in a pool and handed out by pk_control_get_tid_async() without asking
+ * the daemon again, until the pool is empty or the lease expires.
+ *
+ * This is useful for clients running many short queries, as otherwise
+ * every #PkClient method has to wait for a new transaction first.
+ * The daemon may return fewer IDs than asked for.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_control_lease_tids_async (PkControl *control,
+			     guint count,
+			     GCancellable *cancellable,
+			     GAsyncReadyCallback callback,
+			     gpointer user_data)
+{
+	PkControlState *state;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GSimpleAsyncResult) res = NULL;
+
+	g_return_if_fail (PK_IS_CONTROL (control));
+	g_return_if_fail (count > 0);
+	g_return_if_fail (callback != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	res = g_simple_async_result_new (G_OBJECT (control),
+					 callback,
+					 user_data,
+					 pk_control_lease_tids_async);
+
+	/* save state */
+	state = g_slice_new0 (PkControlState);
+	state->res = g_object_ref (res);
+	state->control = g_object_ref (control);
+	state->number = count;
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+
+	/* check not already cancelled */
+	if (cancellable != NULL &&
+	    g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		pk_control_lease_tids_state_finish (state, error);
+		return;
+	}
+
+	/* skip straight to the D-Bus method if already connection */
+	if (control->priv->proxy != NULL) {
+		pk_control_lease_tids_internal (state);
+	} else {
+		g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+					  G_DBUS_PROXY_FLAGS_NONE,
+					  NULL,
+					  PK_DBUS_SERVICE,
+					  PK_DBUS_PATH,
+					  PK_DBUS_INTERFACE,
+					  control->priv->cancellable,
+					  pk_control_lease_tids_proxy_cb,
+					  state);
+	}
+
+	/* track state */
+	g_ptr_array_add (control->priv->calls, state);
+}
+
+/**
+ * pk_control_lease_tids_finish:
+ * @control: a valid #PkControl instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: %TRUE if any IDs were added to the pool
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_control_lease_tids_finish (PkControl *control,
+			      GAsyncResult *res,
+			      GError **error)
+{
+	GSimpleAsyncResult *simple;
+	gpointer source_tag;
+
+	g_return_val_if_fail (PK_IS_CONTROL (control), FALSE);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	source_tag = g_simple_async_result_get_source_tag (simple);
+
+	g_return_val_if_fail (source_tag == pk_control_lease_tids_async, FALSE);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return FALSE;
+
+	return g_simple_async_result_get_op_res_gboolean (simple);
+}
+
+/**
+ * pk_control_get_leased_tids:
+ * @control: a valid #PkControl instance
+ *
+ * Gets how many leased transaction IDs are left in the pool.
+ *
+ * Return value: the number of IDs, 0 if none or the lease expired
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_control_get_leased_tids (PkControl *control)
+{
+	g_return_val_if_fail (PK_IS_CONTROL (control), 0);
+	if (g_get_monotonic_time () >= control->priv->tid_pool_expires)
+		return 0;
+	return control->priv->tid_pool->len;
+}
+
+/**********************************************************************/
+
 
 /*
  * pk_control_suggest_daemon_quit_state_finish:
@@ -1005,6 +1335,209 @@ pk_control_get_daemon_state_finish (PkControl *control,
 /**********************************************************************/
 
 
+/*
+ * pk_control_create_search_session_state_finish:
+ **/
+static void
+pk_control_create_search_session_state_finish (PkControlState *state, const GError *error)
+{
+	/* get result */
+	if (state->search_session != NULL) {
+		g_simple_async_result_set_op_res_gpointer (state->res,
+							   g_strdup (state->search_session), g_free);
+	} else {
+		g_simple_async_result_set_from_error (state->res, error);
+	}
+
+	/* remove from list */
+	g_ptr_array_remove (state->control->priv->calls, state);
+
+	/* complete */
+	g_simple_async_result_complete_in_idle (state->res);
+
+	/* deallocate */
+	if (state->cancellable != NULL) {
+		g_cancellable_disconnect (state->cancellable,
+					  state->cancellable_id);
+		g_object_unref (state->cancellable);
+	}
+	g_free (state->search_session);
+	g_object_unref (state->res);
+	g_object_unref (state->control);
+	if (state->proxy != NULL)
+		g_object_unref (state->proxy);
+	g_slice_free (PkControlState, state);
+}
+
+/*
+ * pk_control_create_search_session_cb:
+ **/
+static void
+pk_control_create_search_session_cb (GObject *source_object,
+				     GAsyncResult *res,
+				     gpointer user_data)
+{
+	GDBusProxy *proxy = G_DBUS_PROXY (source_object);
+	PkControlState *state = (PkControlState *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* get the result */
+	value = g_dbus_proxy_call_finish (proxy, res, &error);
+	if (value == NULL) {
+		/* fix up the D-Bus error */
+		pk_control_fixup_dbus_error (error);
+		pk_control_create_search_session_state_finish (state, error);
+		return;
+	}
+
+	/* save results */
+	g_variant_get (value, "(s)", &state->search_session);
+
+	/* we're done */
+	pk_control_create_search_session_state_finish (state, NULL);
+}
+
+/*
+ * pk_control_create_search_session_internal:
+ **/
+static void
+pk_control_create_search_session_internal (PkControlState *state)
+{
+	g_dbus_proxy_call (state->control->priv->proxy,
+			   "CreateSearchSession",
+			   NULL,
+			   G_DBUS_CALL_FLAGS_NONE,
+			   PK_CONTROL_DBUS_METHOD_TIMEOUT,
+			   state->cancellable,
+			   pk_control_create_search_session_cb,
+			   state);
+}
+
+/*
+ * pk_control_create_search_session_proxy_cb:
+ **/
+static void
+pk_control_create_search_session_proxy_cb (GObject *source_object,
+					   GAsyncResult *res,
+					   gpointer user_data)
+{
+	g_autoptr(GError) error = NULL;
+	PkControlState *state = (PkControlState *) user_data;
+
+	state->proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (state->proxy == NULL) {
+		pk_control_create_search_session_state_finish (state, error);
+		return;
+	}
+	pk_control_proxy_connect (state);
+	pk_control_create_search_session_internal (state);
+}
+
+/**
+ * pk_control_create_search_session_async:
+ * @control: a valid #PkControl instance
+ * @cancellable: a #GCancellable or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Creates a search session for search-as-you-type. Pass it to
+ * pk_client_set_search_session() so that each search that only extends
+ * the previous term is answered from the results the daemon already has.
+ * The session ends when the client disconnects from the bus.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_control_create_search_session_async (PkControl *control,
+					GCancellable *cancellable,
+					GAsyncReadyCallback callback,
+					gpointer user_data)
+{
+	PkControlState *state;
+	g_autoptr(GSimpleAsyncResult) res = NULL;
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (PK_IS_CONTROL (control));
+	g_return_if_fail (callback != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	res = g_simple_async_result_new (G_OBJECT (control),
+					 callback,
+					 user_data,
+					 pk_control_create_search_session_async);
+
+	/* save state */
+	state = g_slice_new0 (PkControlState);
+	state->res = g_object_ref (res);
+	state->control = g_object_ref (control);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+
+	/* check not already cancelled */
+	if (cancellable != NULL &&
+	    g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		pk_control_create_search_session_state_finish (state, error);
+		return;
+	}
+
+	/* skip straight to the D-Bus method if already connection */
+	if (control->priv->proxy != NULL) {
+		pk_control_create_search_session_internal (state);
+	} else {
+		g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+					  G_DBUS_PROXY_FLAGS_NONE,
+					  NULL,
+					  PK_DBUS_SERVICE,
+					  PK_DBUS_PATH,
+					  PK_DBUS_INTERFACE,
+					  control->priv->cancellable,
+					  pk_control_create_search_session_proxy_cb,
+					  state);
+	}
+
+	/* track state */
+	g_ptr_array_add (control->priv->calls, state);
+}
+
+/**
+ * pk_control_create_search_session_finish:
+ * @control: a valid #PkControl instance
+ * @res: the #GAsyncResult
+ * @error: A #GError or %NULL
+ *
+ * Gets the result from the asynchronous function.
+ *
+ * Return value: the session, or %NULL for an error, free with g_free()
+ *
+ * Since: 1.2.5
+ **/
+gchar *
+pk_control_create_search_session_finish (PkControl *control,
+					 GAsyncResult *res,
+					 GError **error)
+{
+	GSimpleAsyncResult *simple;
+	gpointer source_tag;
+
+	g_return_val_if_fail (PK_IS_CONTROL (control), NULL);
+	g_return_val_if_fail (G_IS_SIMPLE_ASYNC_RESULT (res), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	simple = G_SIMPLE_ASYNC_RESULT (res);
+	source_tag = g_simple_async_result_get_source_tag (simple);
+
+	g_return_val_if_fail (source_tag == pk_control_create_search_session_async, NULL);
+
+	if (g_simple_async_result_propagate_error (simple, error))
+		return NULL;
+
+	return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/**********************************************************************/
+
+
 /*
  * pk_control_set_proxy_state_finish:
  **/
@@ -2099,6 +2632,12 @@ pk_control_get_property (GObject *object, guint prop_id, GValue *value, GParamSp
 	case PROP_DISTRO_ID:
 		g_value_set_string (value, priv->distro_id);
 		break;
+	case PROP_INSTALLED_EPOCH:
+		g_value_set_uint64 (value, priv->installed_epoch);
+		break;
+	case PROP_AVAILABLE_EPOCH:
+		g_value_set_uint64 (value, priv->available_epoch);
+		break;
 	case PROP_CONNECTED:
 		g_value_set_boolean (value, priv->connected);
 		break;
@@ -2273,6 +2812,32 @@ pk_control_class_init (PkControlClass *klass)
 				     G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_DISTRO_ID, pspec);
 
+	/**
+	 * PkControl:installed-epoch:
+	 *
+	 * Goes up whenever the installed packages change, or 0 if not known
+	 * yet, such as while the daemon is not running.
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint64 ("installed-epoch", NULL, NULL,
+				     0, G_MAXUINT64, 0,
+				     G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_INSTALLED_EPOCH, pspec);
+
+	/**
+	 * PkControl:available-epoch:
+	 *
+	 * Goes up whenever the repositories or their metadata change, or 0
+	 * if not known yet.
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint64 ("available-epoch", NULL, NULL,
+				     0, G_MAXUINT64, 0,
+				     G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_AVAILABLE_EPOCH, pspec);
+
 	/**
 	 * PkControl:connected:
 	 *
@@ -2339,6 +2904,80 @@ pk_control_class_init (PkControlClass *klass)
 			      NULL, NULL, g_cclosure_marshal_VOID__BOXED,
 			      G_TYPE_NONE, 1, G_TYPE_STRV);
 
+	/**
+	 * PkControl::transaction-added:
+	 * @control: the #PkControl instance that emitted the signal
+	 * @tid: the transaction ID
+	 *
+	 * The ::transaction-added signal is emitted when a transaction is
+	 * committed, before the matching ::transaction-list-changed.
+	 * Older daemons only emit ::transaction-list-changed.
+	 *
+	 * Since: 1.2.5
+	 **/
+	signals[SIGNAL_TRANSACTION_ADDED] =
+		g_signal_new ("transaction-added",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
+
+	/**
+	 * PkControl::transaction-removed:
+	 * @control: the #PkControl instance that emitted the signal
+	 * @tid: the transaction ID
+	 *
+	 * The ::transaction-removed signal is emitted when a transaction
+	 * leaves the daemon's transaction list.
+	 *
+	 * Since: 1.2.5
+	 **/
+	signals[SIGNAL_TRANSACTION_REMOVED] =
+		g_signal_new ("transaction-removed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
+
+	/**
+	 * PkControl::updates-delta:
+	 * @control: the #PkControl instance that emitted the signal
+	 * @epoch: increased by one for each delta
+	 * @added: the package IDs of the new updates
+	 * @removed: the package IDs of the updates that went away
+	 * @changed: the package IDs of the updates with a different #PkInfoEnum
+	 *
+	 * The ::updates-delta signal is emitted when the daemon listed the
+	 * updates again after ::updates-changed. A client that saw the
+	 * previous epoch can apply the delta rather than getting the updates
+	 * again, others have to call pk_client_get_updates_async().
+	 * Only daemons with ChangeDeltas enabled list the updates themselves.
+	 *
+	 * Since: 1.2.5
+	 **/
+	signals[SIGNAL_UPDATES_DELTA] =
+		g_signal_new ("updates-delta",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, NULL,
+			      G_TYPE_NONE, 4, G_TYPE_UINT64, G_TYPE_STRV, G_TYPE_STRV, G_TYPE_STRV);
+
+	/**
+	 * PkControl::repo-list-delta:
+	 * @control: the #PkControl instance that emitted the signal
+	 * @epoch: increased by one for each delta
+	 * @added: the IDs of the new repositories
+	 * @removed: the IDs of the repositories that went away
+	 * @changed: the IDs of the repositories that were enabled, disabled
+	 * or got a new description
+	 *
+	 * Like #PkControl::updates-delta, but for the repository list.
+	 *
+	 * Since: 1.2.5
+	 **/
+	signals[SIGNAL_REPO_LIST_DELTA] =
+		g_signal_new ("repo-list-delta",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, NULL,
+			      G_TYPE_NONE, 4, G_TYPE_UINT64, G_TYPE_STRV, G_TYPE_STRV, G_TYPE_STRV);
+
 	g_type_class_add_private (klass, sizeof (PkControlPrivate));
 }
 
@@ -2392,6 +3031,13 @@ pk_control_name_vanished_cb (GDBusConnection *connection,
 	 * GDBus.Error:org.freedesktop.DBus.Error.ServiceUnknown if we try to
 	 * use this after the server has restarted */
 	pk_control_proxy_destroy (control);
+
+	/* the next daemon starts new epochs */
+	control->priv->installed_epoch = 0;
+	control->priv->available_epoch = 0;
+
+	/* the transactions went away with the daemon */
+	g_ptr_array_set_size (control->priv->tid_pool, 0);
 }
 
 /*
@@ -2408,6 +3054,7 @@ pk_control_init (PkControl *control)
 	control->priv->version_micro = G_MAXUINT;
 	control->priv->cancellable = g_cancellable_new ();
 	control->priv->calls = g_ptr_array_new ();
+	control->priv->tid_pool = g_ptr_array_new_with_free_func (g_free);
 	control->priv->watch_id = g_bus_watch_name (G_BUS_TYPE_SYSTEM,
 						    PK_DBUS_SERVICE,
 						    G_BUS_NAME_WATCHER_FLAGS_NONE,
@@ -2440,6 +3087,7 @@ pk_control_finalize (GObject *object)
 	g_strfreev (priv->mime_types);
 	g_free (priv->distro_id);
 	g_ptr_array_unref (priv->calls);
+	g_ptr_array_unref (priv->tid_pool);
 	g_object_unref (priv->cancellable);
 
 	G_OBJECT_CLASS (pk_control_parent_class)->finalize (object);
@@ -103,6 +103,15 @@ void		 pk_control_get_tid_async		(PkControl		*control,
 gchar		*pk_control_get_tid_finish		(PkControl		*control,
 							 GAsyncResult		*res,
 							 GError			**error);
+void		 pk_control_lease_tids_async		(PkControl		*control,
+							 guint			 count,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gboolean	 pk_control_lease_tids_finish		(PkControl		*control,
+							 GAsyncResult		*res,
+							 GError			**error);
+guint		 pk_control_get_leased_tids		(PkControl		*control);
 void		 pk_control_suggest_daemon_quit_async	(PkControl		*control,
 							 GCancellable		*cancellable,
 							 GAsyncReadyCallback	 callback,
@@ -117,6 +126,13 @@ void		 pk_control_get_daemon_state_async	(PkControl		*control,
 gchar		*pk_control_get_daemon_state_finish	(PkControl		*control,
 							 GAsyncResult		*res,
 							 GError			**error);
+void		 pk_control_create_search_session_async	(PkControl		*control,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gchar		*pk_control_create_search_session_finish (PkControl		*control,
+							 GAsyncResult		*res,
+							 GError			**error);
 void		 pk_control_set_proxy_async		(PkControl		*control,
 							 const gchar		*proxy_http,
 							 const gchar		*proxy_ftp,
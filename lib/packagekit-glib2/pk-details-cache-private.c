@@ -0,0 +1,405 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Clients browsing packages ask for the same details again and again, so
+ * PkClient can keep them in a per-user file. Everything in it was read at
+ * one pair of daemon epochs, and is dropped as soon as either moves on.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "pk-details-cache-private.h"
+
+#define PK_DETAILS_CACHE_VERSION	1
+#define PK_DETAILS_CACHE_TYPE		"(utta{s(ssusstt)}a{s(asasasasasussuss)})"
+#define PK_DETAILS_CACHE_DETAILS_TYPE	"(ssusstt)"
+#define PK_DETAILS_CACHE_UPDATE_TYPE	"(asasasasasussuss)"
+
+/* start again rather than grow without bounds */
+#define PK_DETAILS_CACHE_MAX_ITEMS	50000
+
+struct _PkDetailsCache
+{
+	GMutex			 mutex;
+	gchar			*filename;
+	gboolean		 loaded;
+	gboolean		 dirty;
+	guint64			 installed_epoch;
+	guint64			 available_epoch;
+	GHashTable		*details;		/* package-id : GVariant */
+	GHashTable		*update_details;	/* package-id : GVariant */
+};
+
+/*
+ * pk_details_cache_new:
+ * @filename: where the cache is kept, created when it is first saved
+ **/
+PkDetailsCache *
+pk_details_cache_new (const gchar *filename)
+{
+	PkDetailsCache *cache = g_new0 (PkDetailsCache, 1);
+	g_mutex_init (&cache->mutex);
+	cache->filename = g_strdup (filename);
+	cache->details = g_hash_table_new_full (g_str_hash, g_str_equal,
+						g_free, (GDestroyNotify) g_variant_unref);
+	cache->update_details = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, (GDestroyNotify) g_variant_unref);
+	return cache;
+}
+
+/*
+ * pk_details_cache_free:
+ **/
+void
+pk_details_cache_free (PkDetailsCache *cache)
+{
+	if (cache == NULL)
+		return;
+	g_mutex_clear (&cache->mutex);
+	g_free (cache->filename);
+	g_hash_table_unref (cache->details);
+	g_hash_table_unref (cache->update_details);
+	g_free (cache);
+}
+
+static void
+pk_details_cache_load (PkDetailsCache *cache)
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	guint version = 0;
+	const gchar *package_id;
+	GVariant *item;
+	GVariantIter iter;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) data = NULL;
+	g_autoptr(GVariant) details = NULL;
+	g_autoptr(GVariant) update_details = NULL;
+
+	if (cache->loaded)
+		return;
+	cache->loaded = TRUE;
+
+	if (!g_file_get_contents (cache->filename, &contents, &length, &error)) {
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_debug ("failed to load details cache: %s", error->message);
+		return;
+	}
+	bytes = g_bytes_new_take (contents, length);
+	data = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (PK_DETAILS_CACHE_TYPE),
+							     bytes, FALSE));
+
+	/* truncated, or written by another version */
+	if (!g_variant_is_normal_form (data)) {
+		g_debug ("ignoring invalid details cache %s", cache->filename);
+		return;
+	}
+	g_variant_get (data, "(utt@a{s" PK_DETAILS_CACHE_DETAILS_TYPE "}@a{s" PK_DETAILS_CACHE_UPDATE_TYPE "})",
+		       &version, &cache->installed_epoch, &cache->available_epoch,
+		       &details, &update_details);
+	if (version == PK_DETAILS_CACHE_VERSION) {
+		g_variant_iter_init (&iter, details);
+		while (g_variant_iter_next (&iter, "{&s@" PK_DETAILS_CACHE_DETAILS_TYPE "}", &package_id, &item))
+			g_hash_table_insert (cache->details, g_strdup (package_id), item);
+		g_variant_iter_init (&iter, update_details);
+		while (g_variant_iter_next (&iter, "{&s@" PK_DETAILS_CACHE_UPDATE_TYPE "}", &package_id, &item))
+			g_hash_table_insert (cache->update_details, g_strdup (package_id), item);
+	} else {
+		cache->installed_epoch = 0;
+		cache->available_epoch = 0;
+	}
+}
+
+/* must be called with the lock held; FALSE if the epochs are older than
+ * what is cached, so the data must not be used or stored */
+static gboolean
+pk_details_cache_check_epochs (PkDetailsCache *cache,
+			       guint64 installed_epoch,
+			       guint64 available_epoch)
+{
+	pk_details_cache_load (cache);
+
+	if (installed_epoch == cache->installed_epoch &&
+	    available_epoch == cache->available_epoch)
+		return TRUE;
+
+	/* a lookup racing with a newer result */
+	if (installed_epoch < cache->installed_epoch ||
+	    available_epoch < cache->available_epoch)
+		return FALSE;
+
+	g_debug ("details cache is out of date");
+	g_hash_table_remove_all (cache->details);
+	g_hash_table_remove_all (cache->update_details);
+	cache->installed_epoch = installed_epoch;
+	cache->available_epoch = available_epoch;
+	cache->dirty = TRUE;
+	return TRUE;
+}
+
+static const gchar *
+pk_details_cache_nonnull (const gchar *str)
+{
+	return str != NULL ? str : "";
+}
+
+static const gchar *
+pk_details_cache_nullable (const gchar *str)
+{
+	return str[0] != '\0' ? str : NULL;
+}
+
+static gchar **
+pk_details_cache_strv_nullable (gchar **strv)
+{
+	return strv[0] != NULL ? strv : NULL;
+}
+
+static GVariant *
+pk_details_cache_strv_to_variant (gchar **strv)
+{
+	if (strv == NULL)
+		return g_variant_new_strv (NULL, 0);
+	return g_variant_new_strv ((const gchar * const *) strv, -1);
+}
+
+/*
+ * pk_details_cache_lookup_details:
+ *
+ * Return value: (transfer full): the cached details, or %NULL
+ **/
+PkDetails *
+pk_details_cache_lookup_details (PkDetailsCache *cache,
+				 guint64 installed_epoch,
+				 guint64 available_epoch,
+				 const gchar *package_id)
+{
+	const gchar *tmp_str[6];
+	guint tmp_uint;
+	guint64 size;
+	guint64 download_size;
+	GVariant *variant;
+	PkDetails *item;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (!pk_details_cache_check_epochs (cache, installed_epoch, available_epoch))
+		return NULL;
+	variant = g_hash_table_lookup (cache->details, package_id);
+	if (variant == NULL)
+		return NULL;
+
+	g_variant_get (variant, "(&s&su&s&stt)",
+		       &tmp_str[0], &tmp_str[1], &tmp_uint,
+		       &tmp_str[3], &tmp_str[4], &size, &download_size);
+	item = pk_details_new ();
+	g_object_set (item,
+		      "package-id", package_id,
+		      "summary", pk_details_cache_nullable (tmp_str[0]),
+		      "license", pk_details_cache_nullable (tmp_str[1]),
+		      "group", tmp_uint,
+		      "description", pk_details_cache_nullable (tmp_str[3]),
+		      "url", pk_details_cache_nullable (tmp_str[4]),
+		      "size", size,
+		      "download-size", download_size,
+		      NULL);
+	return item;
+}
+
+/*
+ * pk_details_cache_lookup_update_detail:
+ *
+ * Return value: (transfer full): the cached update details, or %NULL
+ **/
+PkUpdateDetail *
+pk_details_cache_lookup_update_detail (PkDetailsCache *cache,
+				       guint64 installed_epoch,
+				       guint64 available_epoch,
+				       const gchar *package_id)
+{
+	const gchar *tmp_str[4];
+	guint restart;
+	guint state;
+	GVariant *variant;
+	PkUpdateDetail *item;
+	g_autofree const gchar **updates = NULL;
+	g_autofree const gchar **obsoletes = NULL;
+	g_autofree const gchar **vendor_urls = NULL;
+	g_autofree const gchar **bugzilla_urls = NULL;
+	g_autofree const gchar **cve_urls = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (!pk_details_cache_check_epochs (cache, installed_epoch, available_epoch))
+		return NULL;
+	variant = g_hash_table_lookup (cache->update_details, package_id);
+	if (variant == NULL)
+		return NULL;
+
+	g_variant_get (variant, "(^a&s^a&s^a&s^a&s^a&su&s&su&s&s)",
+		       &updates, &obsoletes, &vendor_urls, &bugzilla_urls, &cve_urls,
+		       &restart, &tmp_str[0], &tmp_str[1], &state, &tmp_str[2], &tmp_str[3]);
+	item = pk_update_detail_new ();
+	g_object_set (item,
+		      "package-id", package_id,
+		      "updates", pk_details_cache_strv_nullable ((gchar **) updates),
+		      "obsoletes", pk_details_cache_strv_nullable ((gchar **) obsoletes),
+		      "vendor-urls", pk_details_cache_strv_nullable ((gchar **) vendor_urls),
+		      "bugzilla-urls", pk_details_cache_strv_nullable ((gchar **) bugzilla_urls),
+		      "cve-urls", pk_details_cache_strv_nullable ((gchar **) cve_urls),
+		      "restart", restart,
+		      "update-text", pk_details_cache_nullable (tmp_str[0]),
+		      "changelog", pk_details_cache_nullable (tmp_str[1]),
+		      "state", state,
+		      "issued", pk_details_cache_nullable (tmp_str[2]),
+		      "updated", pk_details_cache_nullable (tmp_str[3]),
+		      NULL);
+	return item;
+}
+
+static void
+pk_details_cache_insert (PkDetailsCache *cache, GHashTable *hash,
+			 const gchar *package_id, GVariant *variant)
+{
+	if (g_hash_table_size (hash) >= PK_DETAILS_CACHE_MAX_ITEMS)
+		g_hash_table_remove_all (hash);
+	g_hash_table_insert (hash, g_strdup (package_id), g_variant_ref_sink (variant));
+	cache->dirty = TRUE;
+}
+
+/*
+ * pk_details_cache_add_details:
+ * @installed_epoch: the daemon epochs from before @item was asked for
+ **/
+void
+pk_details_cache_add_details (PkDetailsCache *cache,
+			      guint64 installed_epoch,
+			      guint64 available_epoch,
+			      PkDetails *item)
+{
+	const gchar *package_id = pk_details_get_package_id (item);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (package_id == NULL)
+		return;
+	if (!pk_details_cache_check_epochs (cache, installed_epoch, available_epoch))
+		return;
+	pk_details_cache_insert (cache, cache->details, package_id,
+				 g_variant_new (PK_DETAILS_CACHE_DETAILS_TYPE,
+						pk_details_cache_nonnull (pk_details_get_summary (item)),
+						pk_details_cache_nonnull (pk_details_get_license (item)),
+						(guint) pk_details_get_group (item),
+						pk_details_cache_nonnull (pk_details_get_description (item)),
+						pk_details_cache_nonnull (pk_details_get_url (item)),
+						pk_details_get_size (item),
+						pk_details_get_download_size (item)));
+}
+
+/*
+ * pk_details_cache_add_update_detail:
+ * @installed_epoch: the daemon epochs from before @item was asked for
+ **/
+void
+pk_details_cache_add_update_detail (PkDetailsCache *cache,
+				    guint64 installed_epoch,
+				    guint64 available_epoch,
+				    PkUpdateDetail *item)
+{
+	const gchar *package_id = pk_update_detail_get_package_id (item);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (package_id == NULL)
+		return;
+	if (!pk_details_cache_check_epochs (cache, installed_epoch, available_epoch))
+		return;
+	pk_details_cache_insert (cache, cache->update_details, package_id,
+				 g_variant_new ("(@as@as@as@as@asussuss)",
+						pk_details_cache_strv_to_variant (pk_update_detail_get_updates (item)),
+						pk_details_cache_strv_to_variant (pk_update_detail_get_obsoletes (item)),
+						pk_details_cache_strv_to_variant (pk_update_detail_get_vendor_urls (item)),
+						pk_details_cache_strv_to_variant (pk_update_detail_get_bugzilla_urls (item)),
+						pk_details_cache_strv_to_variant (pk_update_detail_get_cve_urls (item)),
+						(guint) pk_update_detail_get_restart (item),
+						pk_details_cache_nonnull (pk_update_detail_get_update_text (item)),
+						pk_details_cache_nonnull (pk_update_detail_get_changelog (item)),
+						(guint) pk_update_detail_get_state (item),
+						pk_details_cache_nonnull (pk_update_detail_get_issued (item)),
+						pk_details_cache_nonnull (pk_update_detail_get_updated (item))));
+}
+
+static GVariant *
+pk_details_cache_hash_to_variant (GHashTable *hash, const gchar *type)
+{
+	GHashTableIter iter;
+	GVariantBuilder builder;
+	gpointer key;
+	gpointer value;
+	g_autofree gchar *array_type = g_strdup_printf ("a{s%s}", type);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE (array_type));
+	g_hash_table_iter_init (&iter, hash);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_variant_builder_add (&builder, "{s@*}", (const gchar *) key, (GVariant *) value);
+	return g_variant_builder_end (&builder);
+}
+
+/*
+ * pk_details_cache_save:
+ *
+ * Writes the cache if anything was added since it was loaded. The file is
+ * replaced atomically, so other processes see either version.
+ **/
+gboolean
+pk_details_cache_save (PkDetailsCache *cache, GError **error)
+{
+	g_autofree gchar *dirname = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+	g_autoptr(GVariant) data = NULL;
+
+	if (!cache->dirty)
+		return TRUE;
+
+	data = g_variant_ref_sink (g_variant_new ("(utt@a{s" PK_DETAILS_CACHE_DETAILS_TYPE "}@a{s" PK_DETAILS_CACHE_UPDATE_TYPE "})",
+						  PK_DETAILS_CACHE_VERSION,
+						  cache->installed_epoch,
+						  cache->available_epoch,
+						  pk_details_cache_hash_to_variant (cache->details,
+										    PK_DETAILS_CACHE_DETAILS_TYPE),
+						  pk_details_cache_hash_to_variant (cache->update_details,
+										    PK_DETAILS_CACHE_UPDATE_TYPE)));
+	dirname = g_path_get_dirname (cache->filename);
+	if (g_mkdir_with_parents (dirname, 0700) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", dirname, g_strerror (errno));
+		return FALSE;
+	}
+	if (!g_file_set_contents (cache->filename,
+				  g_variant_get_data (data),
+				  (gssize) g_variant_get_size (data),
+				  error))
+		return FALSE;
+	cache->dirty = FALSE;
+	return TRUE;
+}
@@ -0,0 +1,63 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_DETAILS_CACHE_PRIVATE_H
+#define __PK_DETAILS_CACHE_PRIVATE_H
+
+#include <glib.h>
+
+#include <packagekit-glib2/pk-details.h>
+#include <packagekit-glib2/pk-update-detail.h>
+
+G_BEGIN_DECLS
+
+typedef struct _PkDetailsCache		PkDetailsCache;
+
+PkDetailsCache	*pk_details_cache_new			(const gchar		*filename);
+void		 pk_details_cache_free			(PkDetailsCache		*cache);
+PkDetails	*pk_details_cache_lookup_details	(PkDetailsCache		*cache,
+							 guint64		 installed_epoch,
+							 guint64		 available_epoch,
+							 const gchar		*package_id);
+PkUpdateDetail	*pk_details_cache_lookup_update_detail	(PkDetailsCache		*cache,
+							 guint64		 installed_epoch,
+							 guint64		 available_epoch,
+							 const gchar		*package_id);
+void		 pk_details_cache_add_details		(PkDetailsCache		*cache,
+							 guint64		 installed_epoch,
+							 guint64		 available_epoch,
+							 PkDetails		*item);
+void		 pk_details_cache_add_update_detail	(PkDetailsCache		*cache,
+							 guint64		 installed_epoch,
+							 guint64		 available_epoch,
+							 PkUpdateDetail		*item);
+gboolean	 pk_details_cache_save			(PkDetailsCache		*cache,
+							 GError			**error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkDetailsCache, pk_details_cache_free)
+
+G_END_DECLS
+
+#endif /* __PK_DETAILS_CACHE_PRIVATE_H */
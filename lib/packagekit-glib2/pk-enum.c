@@ -380,6 +380,7 @@ static const PkEnumMatch enum_transaction_flag[] = {
 	{PK_TRANSACTION_FLAG_ENUM_ALLOW_REINSTALL,	"allow-reinstall"},
 	{PK_TRANSACTION_FLAG_ENUM_JUST_REINSTALL,	"just-reinstall"},
 	{PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE,	"allow-downgrade"},
+	{PK_TRANSACTION_FLAG_ENUM_PIPELINE,		"pipeline"},
 	{0, NULL}
 };
 
@@ -440,6 +441,86 @@ pk_enum_find_string (const PkEnumMatch *table, guint value)
 	return table[0].string;
 }
 
+/* the largest value to convert using a direct index rather than a search */
+#define PK_ENUM_INDEX_MAX_VALUE		1024
+
+typedef struct {
+	guint			 len;
+	const gchar		*strings[];
+} PkEnumStrings;
+
+/*
+ * pk_enum_find_value_indexed:
+ * @index: a static location to keep the lookup table, initialised to 0
+ *
+ * Like pk_enum_find_value(), but builds a hash table for @table on first
+ * use so that the conversions used when parsing are not a linear search.
+ */
+static guint
+pk_enum_find_value_indexed (gsize *index, const PkEnumMatch *table, const gchar *string)
+{
+	gpointer value;
+
+	if (g_once_init_enter (index)) {
+		GHashTable *hash = g_hash_table_new (g_str_hash, g_str_equal);
+		guint i;
+
+		/* the first of any duplicate wins, as with the search */
+		for (i = 0; table[i].string != NULL; i++) {
+			if (!g_hash_table_contains (hash, table[i].string)) {
+				g_hash_table_insert (hash, (gpointer) table[i].string,
+						     GUINT_TO_POINTER (table[i].value));
+			}
+		}
+		g_once_init_leave (index, (gsize) hash);
+	}
+
+	/* return the first entry on non-found or error */
+	if (string == NULL)
+		return table[0].value;
+	if (!g_hash_table_lookup_extended ((GHashTable *) *index, string, NULL, &value))
+		return table[0].value;
+	return GPOINTER_TO_UINT (value);
+}
+
+/*
+ * pk_enum_find_string_indexed:
+ * @index: a static location to keep the lookup table, initialised to 0
+ *
+ * Like pk_enum_find_string(), but uses an array indexed by value.
+ */
+static const gchar *
+pk_enum_find_string_indexed (gsize *index, const PkEnumMatch *table, guint value)
+{
+	PkEnumStrings *strings;
+
+	if (g_once_init_enter (index)) {
+		guint i;
+		guint len = 0;
+
+		for (i = 0; table[i].string != NULL; i++)
+			len = MAX (len, table[i].value + 1);
+
+		/* sparse tables keep using the search */
+		if (len > PK_ENUM_INDEX_MAX_VALUE)
+			len = 0;
+		strings = g_malloc0 (sizeof (PkEnumStrings) + len * sizeof (gchar *));
+		strings->len = len;
+		for (i = 0; len > 0 && table[i].string != NULL; i++) {
+			if (strings->strings[table[i].value] == NULL)
+				strings->strings[table[i].value] = table[i].string;
+		}
+		g_once_init_leave (index, (gsize) strings);
+	}
+
+	strings = (PkEnumStrings *) *index;
+	if (strings->len == 0)
+		return pk_enum_find_string (table, value);
+	if (value >= strings->len || strings->strings[value] == NULL)
+		return table[0].string;
+	return strings->strings[value];
+}
+
 /**
  * pk_sig_type_enum_from_string:
  * @sig_type: Text describing the enumerated type
@@ -451,7 +532,8 @@ pk_enum_find_string (const PkEnumMatch *table, guint value)
 PkSigTypeEnum
 pk_sig_type_enum_from_string (const gchar *sig_type)
 {
-	return pk_enum_find_value (enum_sig_type, sig_type);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_sig_type, sig_type);
 }
 
 /**
@@ -467,7 +549,8 @@ pk_sig_type_enum_from_string (const gchar *sig_type)
 const gchar *
 pk_sig_type_enum_to_string (PkSigTypeEnum sig_type)
 {
-	return pk_enum_find_string (enum_sig_type, sig_type);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_sig_type, sig_type);
 }
 
 /**
@@ -483,7 +566,8 @@ pk_sig_type_enum_to_string (PkSigTypeEnum sig_type)
 PkDistroUpgradeEnum
 pk_distro_upgrade_enum_from_string (const gchar *upgrade)
 {
-	return pk_enum_find_value (enum_upgrade, upgrade);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_upgrade, upgrade);
 }
 
 /**
@@ -499,7 +583,8 @@ pk_distro_upgrade_enum_from_string (const gchar *upgrade)
 const gchar *
 pk_distro_upgrade_enum_to_string (PkDistroUpgradeEnum upgrade)
 {
-	return pk_enum_find_string (enum_upgrade, upgrade);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_upgrade, upgrade);
 }
 
 /**
@@ -515,7 +600,8 @@ pk_distro_upgrade_enum_to_string (PkDistroUpgradeEnum upgrade)
 PkInfoEnum
 pk_info_enum_from_string (const gchar *info)
 {
-	return pk_enum_find_value (enum_info, info);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_info, info);
 }
 
 /**
@@ -531,7 +617,8 @@ pk_info_enum_from_string (const gchar *info)
 const gchar *
 pk_info_enum_to_string (PkInfoEnum info)
 {
-	return pk_enum_find_string (enum_info, info);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_info, info);
 }
 
 /**
@@ -547,7 +634,8 @@ pk_info_enum_to_string (PkInfoEnum info)
 PkExitEnum
 pk_exit_enum_from_string (const gchar *exit_text)
 {
-	return pk_enum_find_value (enum_exit, exit_text);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_exit, exit_text);
 }
 
 /**
@@ -563,7 +651,8 @@ pk_exit_enum_from_string (const gchar *exit_text)
 const gchar *
 pk_exit_enum_to_string (PkExitEnum exit_enum)
 {
-	return pk_enum_find_string (enum_exit, exit_enum);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_exit, exit_enum);
 }
 
 /**
@@ -579,7 +668,8 @@ pk_exit_enum_to_string (PkExitEnum exit_enum)
 PkNetworkEnum
 pk_network_enum_from_string (const gchar *network)
 {
-	return pk_enum_find_value (enum_network, network);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_network, network);
 }
 
 /**
@@ -595,7 +685,8 @@ pk_network_enum_from_string (const gchar *network)
 const gchar *
 pk_network_enum_to_string (PkNetworkEnum network)
 {
-	return pk_enum_find_string (enum_network, network);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_network, network);
 }
 
 /**
@@ -611,7 +702,8 @@ pk_network_enum_to_string (PkNetworkEnum network)
 PkStatusEnum
 pk_status_enum_from_string (const gchar *status)
 {
-	return pk_enum_find_value (enum_status, status);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_status, status);
 }
 
 /**
@@ -627,7 +719,8 @@ pk_status_enum_from_string (const gchar *status)
 const gchar *
 pk_status_enum_to_string (PkStatusEnum status)
 {
-	return pk_enum_find_string (enum_status, status);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_status, status);
 }
 
 /**
@@ -643,7 +736,8 @@ pk_status_enum_to_string (PkStatusEnum status)
 PkRoleEnum
 pk_role_enum_from_string (const gchar *role)
 {
-	return pk_enum_find_value (enum_role, role);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_role, role);
 }
 
 /**
@@ -659,7 +753,8 @@ pk_role_enum_from_string (const gchar *role)
 const gchar *
 pk_role_enum_to_string (PkRoleEnum role)
 {
-	return pk_enum_find_string (enum_role, role);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_role, role);
 }
 
 /**
@@ -675,7 +770,8 @@ pk_role_enum_to_string (PkRoleEnum role)
 PkErrorEnum
 pk_error_enum_from_string (const gchar *code)
 {
-	return pk_enum_find_value (enum_error, code);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_error, code);
 }
 
 /**
@@ -691,7 +787,8 @@ pk_error_enum_from_string (const gchar *code)
 const gchar *
 pk_error_enum_to_string (PkErrorEnum code)
 {
-	return pk_enum_find_string (enum_error, code);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_error, code);
 }
 
 /**
@@ -707,7 +804,8 @@ pk_error_enum_to_string (PkErrorEnum code)
 PkRestartEnum
 pk_restart_enum_from_string (const gchar *restart)
 {
-	return pk_enum_find_value (enum_restart, restart);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_restart, restart);
 }
 
 /**
@@ -723,7 +821,8 @@ pk_restart_enum_from_string (const gchar *restart)
 const gchar *
 pk_restart_enum_to_string (PkRestartEnum restart)
 {
-	return pk_enum_find_string (enum_restart, restart);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_restart, restart);
 }
 
 /**
@@ -739,7 +838,8 @@ pk_restart_enum_to_string (PkRestartEnum restart)
 PkGroupEnum
 pk_group_enum_from_string (const gchar *group)
 {
-	return pk_enum_find_value (enum_group, group);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_group, group);
 }
 
 /**
@@ -755,7 +855,8 @@ pk_group_enum_from_string (const gchar *group)
 const gchar *
 pk_group_enum_to_string (PkGroupEnum group)
 {
-	return pk_enum_find_string (enum_group, group);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_group, group);
 }
 
 /**
@@ -771,7 +872,8 @@ pk_group_enum_to_string (PkGroupEnum group)
 PkUpdateStateEnum
 pk_update_state_enum_from_string (const gchar *update_state)
 {
-	return pk_enum_find_value (enum_update_state, update_state);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_update_state, update_state);
 }
 
 /**
@@ -787,7 +889,8 @@ pk_update_state_enum_from_string (const gchar *update_state)
 const gchar *
 pk_update_state_enum_to_string (PkUpdateStateEnum update_state)
 {
-	return pk_enum_find_string (enum_update_state, update_state);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_update_state, update_state);
 }
 
 /**
@@ -803,7 +906,8 @@ pk_update_state_enum_to_string (PkUpdateStateEnum update_state)
 PkFilterEnum
 pk_filter_enum_from_string (const gchar *filter)
 {
-	return pk_enum_find_value (enum_filter, filter);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_filter, filter);
 }
 
 /**
@@ -819,7 +923,8 @@ pk_filter_enum_from_string (const gchar *filter)
 const gchar *
 pk_filter_enum_to_string (PkFilterEnum filter)
 {
-	return pk_enum_find_string (enum_filter, filter);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_filter, filter);
 }
 
 /**
@@ -835,7 +940,8 @@ pk_filter_enum_to_string (PkFilterEnum filter)
 PkMediaTypeEnum
 pk_media_type_enum_from_string (const gchar *media_type)
 {
-	return pk_enum_find_value (enum_media_type, media_type);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_media_type, media_type);
 }
 
 /**
@@ -851,7 +957,8 @@ pk_media_type_enum_from_string (const gchar *media_type)
 const gchar *
 pk_media_type_enum_to_string (PkMediaTypeEnum media_type)
 {
-	return pk_enum_find_string (enum_media_type, media_type);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_media_type, media_type);
 }
 
 /**
@@ -867,7 +974,8 @@ pk_media_type_enum_to_string (PkMediaTypeEnum media_type)
 PkAuthorizeEnum
 pk_authorize_type_enum_from_string (const gchar *authorize_type)
 {
-	return pk_enum_find_value (enum_authorize_type, authorize_type);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_authorize_type, authorize_type);
 }
 
 /**
@@ -883,7 +991,8 @@ pk_authorize_type_enum_from_string (const gchar *authorize_type)
 const gchar *
 pk_authorize_type_enum_to_string (PkAuthorizeEnum authorize_type)
 {
-	return pk_enum_find_string (enum_authorize_type, authorize_type);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_authorize_type, authorize_type);
 }
 
 /**
@@ -899,7 +1008,8 @@ pk_authorize_type_enum_to_string (PkAuthorizeEnum authorize_type)
 PkUpgradeKindEnum
 pk_upgrade_kind_enum_from_string (const gchar *upgrade_kind)
 {
-	return pk_enum_find_value (enum_upgrade_kind, upgrade_kind);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_upgrade_kind, upgrade_kind);
 }
 
 /**
@@ -915,7 +1025,8 @@ pk_upgrade_kind_enum_from_string (const gchar *upgrade_kind)
 const gchar *
 pk_upgrade_kind_enum_to_string (PkUpgradeKindEnum upgrade_kind)
 {
-	return pk_enum_find_string (enum_upgrade_kind, upgrade_kind);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_upgrade_kind, upgrade_kind);
 }
 
 /**
@@ -931,7 +1042,8 @@ pk_upgrade_kind_enum_to_string (PkUpgradeKindEnum upgrade_kind)
 PkTransactionFlagEnum
 pk_transaction_flag_enum_from_string (const gchar *transaction_flag)
 {
-	return pk_enum_find_value (enum_transaction_flag, transaction_flag);
+	static gsize index = 0;
+	return pk_enum_find_value_indexed (&index, enum_transaction_flag, transaction_flag);
 }
 
 /**
@@ -947,7 +1059,8 @@ pk_transaction_flag_enum_from_string (const gchar *transaction_flag)
 const gchar *
 pk_transaction_flag_enum_to_string (PkTransactionFlagEnum transaction_flag)
 {
-	return pk_enum_find_string (enum_transaction_flag, transaction_flag);
+	static gsize index = 0;
+	return pk_enum_find_string_indexed (&index, enum_transaction_flag, transaction_flag);
 }
 
 /**
@@ -772,6 +772,7 @@ typedef enum {
  * @PK_TRANSACTION_FLAG_ENUM_ALLOW_REINSTALL: Allow package reinstallation
  * @PK_TRANSACTION_FLAG_ENUM_JUST_REINSTALL: Only allow package reinstallation
  * @PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE: Allow packages to be downgraded
+ * @PK_TRANSACTION_FLAG_ENUM_PIPELINE: Install packages in batches while later ones are still downloading, if the backend supports it
  * @PK_TRANSACTION_FLAG_ENUM_LAST:
  *
  * The transaction flags that alter how the transaction is handled
@@ -784,6 +785,7 @@ typedef enum {
 	PK_TRANSACTION_FLAG_ENUM_ALLOW_REINSTALL,	/* Since: 1.0.2 */
 	PK_TRANSACTION_FLAG_ENUM_JUST_REINSTALL,	/* Since: 1.0.2 */
 	PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE,	/* Since: 1.0.2 */
+	PK_TRANSACTION_FLAG_ENUM_PIPELINE,		/* Since: 1.2.5 */
 	PK_TRANSACTION_FLAG_ENUM_LAST			/* Since: 0.8.1 */
 } PkTransactionFlagEnum;
 
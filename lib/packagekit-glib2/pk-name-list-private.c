@@ -0,0 +1,187 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+/*
+ * The daemon writes the list after the package lists change, and pkcon
+ * reads it to complete package names without starting a transaction. It
+ * is just the sorted, unique names, one per line, so that it is also
+ * usable from a shell script.
+ */
+
+#include <config.h>
+
+#include <glib.h>
+#include <string.h>
+
+#include "pk-name-list-private.h"
+
+struct _PkNameList
+{
+	GMappedFile		*mapped;
+	const gchar		*contents;
+	GArray			*lines;		/* guint32 offset of each name */
+};
+
+static gint
+pk_name_list_sort_cb (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*((const gchar **) a), *((const gchar **) b));
+}
+
+/*
+ * pk_name_list_save:
+ * @names: (element-type utf8 utf8): a set of package names
+ * @filename: the file to write
+ * @error: A #GError or %NULL
+ *
+ * Writes a new list, replacing the file atomically so that readers that
+ * still have the old one mapped are not affected.
+ *
+ * Return value: %TRUE for success, else %FALSE and @error set
+ **/
+gboolean
+pk_name_list_save (GHashTable *names, const gchar *filename, GError **error)
+{
+	GHashTableIter iter;
+	gpointer key;
+	g_autoptr(GPtrArray) sorted = g_ptr_array_new ();
+	g_autoptr(GString) data = g_string_new (NULL);
+
+	g_hash_table_iter_init (&iter, names);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		/* a name with a newline would split into two */
+		if (strchr (key, '\n') != NULL || ((const gchar *) key)[0] == '\0')
+			continue;
+		g_ptr_array_add (sorted, key);
+	}
+	g_ptr_array_sort (sorted, pk_name_list_sort_cb);
+	for (guint i = 0; i < sorted->len; i++) {
+		g_string_append (data, g_ptr_array_index (sorted, i));
+		g_string_append_c (data, '\n');
+	}
+	return g_file_set_contents (filename, data->str, data->len, error);
+}
+
+/*
+ * pk_name_list_new_from_file:
+ * @filename: the list to map
+ * @error: A #GError or %NULL
+ *
+ * Return value: the list, or %NULL if it does not exist or is invalid
+ **/
+PkNameList *
+pk_name_list_new_from_file (const gchar *filename, GError **error)
+{
+	const gchar *contents;
+	gsize len;
+	g_autoptr(GMappedFile) mapped = NULL;
+	g_autoptr(GArray) lines = NULL;
+	PkNameList *list;
+
+	mapped = g_mapped_file_new (filename, FALSE, error);
+	if (mapped == NULL)
+		return NULL;
+	contents = g_mapped_file_get_contents (mapped);
+	len = g_mapped_file_get_length (mapped);
+	if (len > G_MAXUINT32 || (len > 0 && contents[len - 1] != '\n')) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+			     "%s is truncated", filename);
+		return NULL;
+	}
+
+	/* one offset per name, so the lookups can binary search */
+	lines = g_array_new (FALSE, FALSE, sizeof (guint32));
+	for (const gchar *p = contents; p < contents + len; ) {
+		const gchar *end = memchr (p, '\n', contents + len - p);
+		guint32 offset = p - contents;
+		g_array_append_val (lines, offset);
+		p = end + 1;
+	}
+
+	list = g_new0 (PkNameList, 1);
+	list->contents = contents;
+	list->mapped = g_steal_pointer (&mapped);
+	list->lines = g_steal_pointer (&lines);
+	return list;
+}
+
+/* compares the name on @line with the first @len bytes of @prefix */
+static gint
+pk_name_list_compare (PkNameList *list, guint line, const gchar *prefix, gsize len)
+{
+	const gchar *name = list->contents + g_array_index (list->lines, guint32, line);
+
+	for (gsize i = 0; i < len; i++) {
+		if (name[i] == '\n')
+			return -1;
+		if (name[i] != prefix[i])
+			return (guchar) name[i] < (guchar) prefix[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+ * pk_name_list_complete:
+ * @list: a #PkNameList
+ * @prefix: the start of a package name, or "" for all of them
+ *
+ * Return value: (transfer full): the sorted names starting with @prefix,
+ * which may be empty
+ **/
+gchar **
+pk_name_list_complete (PkNameList *list, const gchar *prefix)
+{
+	gsize len = strlen (prefix);
+	guint lo = 0;
+	guint hi = list->lines->len;
+	g_autoptr(GPtrArray) names = g_ptr_array_new ();
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		if (pk_name_list_compare (list, mid, prefix, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (guint i = lo; i < list->lines->len; i++) {
+		const gchar *name = list->contents + g_array_index (list->lines, guint32, i);
+		if (pk_name_list_compare (list, i, prefix, len) != 0)
+			break;
+		g_ptr_array_add (names, g_strndup (name, strchr (name, '\n') - name));
+	}
+	g_ptr_array_add (names, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&names), FALSE);
+}
+
+guint
+pk_name_list_get_size (PkNameList *list)
+{
+	return list->lines->len;
+}
+
+void
+pk_name_list_free (PkNameList *list)
+{
+	g_array_unref (list->lines);
+	g_mapped_file_unref (list->mapped);
+	g_free (list);
+}
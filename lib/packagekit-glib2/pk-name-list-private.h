@@ -0,0 +1,58 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_NAME_LIST_PRIVATE_H
+#define __PK_NAME_LIST_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* this allows us to override for the self tests */
+#ifndef PK_NAME_LIST_DESTDIR
+#define PK_NAME_LIST_DESTDIR		""
+#endif
+
+/* the names of all the installed and available packages */
+#define PK_NAME_LIST_FILENAME		PK_NAME_LIST_DESTDIR "/var/lib/PackageKit/package-names"
+
+typedef struct _PkNameList		PkNameList;
+
+gboolean	 pk_name_list_save			(GHashTable		*names,
+							 const gchar		*filename,
+							 GError			**error);
+PkNameList	*pk_name_list_new_from_file		(const gchar		*filename,
+							 GError			**error);
+gchar		**pk_name_list_complete			(PkNameList		*list,
+							 const gchar		*prefix);
+guint		 pk_name_list_get_size			(PkNameList		*list);
+void		 pk_name_list_free			(PkNameList		*list);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkNameList, pk_name_list_free)
+
+G_END_DECLS
+
+#endif /* __PK_NAME_LIST_PRIVATE_H */
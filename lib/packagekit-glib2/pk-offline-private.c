@@ -29,6 +29,17 @@
 #include "pk-offline.h"
 #include "pk-offline-private.h"
 
+/* the package databases the backends commit to */
+static const gchar *pk_offline_package_dbs[] = {
+	"/usr/lib/sysimage/rpm/rpmdb.sqlite",
+	"/usr/lib/sysimage/rpm/rpmdb.sqlite-wal",
+	"/var/lib/rpm/rpmdb.sqlite",
+	"/var/lib/rpm/rpmdb.sqlite-wal",
+	"/var/lib/rpm/Packages",
+	"/var/lib/dpkg/status",
+	"/var/lib/pacman/local",
+	NULL };
+
 /*
  * pk_offline_auth_set_action:
  * @action: a #PkOfflineAction, e.g. %PK_OFFLINE_ACTION_REBOOT
@@ -316,6 +327,41 @@ pk_offline_auth_set_prepared_ids (gchar **package_ids, GError **error)
 	return g_key_file_save_to_file (keyfile, PK_OFFLINE_PREPARED_FILENAME, error);
 }
 
+/*
+ * pk_offline_get_package_db_fingerprint:
+ *
+ * Gets a string that changes whenever a package database is written to,
+ * which is much cheaper than asking the backend what is installed.
+ *
+ * Return value: the fingerprint, or %NULL if no package database was found
+ *
+ * Since: 1.2.5
+ **/
+gchar *
+pk_offline_get_package_db_fingerprint (void)
+{
+	GString *str = g_string_new (NULL);
+
+	for (guint i = 0; pk_offline_package_dbs[i] != NULL; i++) {
+		GStatBuf buf;
+		g_autofree gchar *filename = NULL;
+
+		filename = g_strconcat (PK_OFFLINE_DESTDIR, pk_offline_package_dbs[i], NULL);
+		if (g_stat (filename, &buf) != 0)
+			continue;
+		g_string_append_printf (str, "%s:%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT ";",
+					pk_offline_package_dbs[i],
+					(guint64) buf.st_ino,
+					(guint64) buf.st_size,
+					(gint64) buf.st_mtime);
+	}
+	if (str->len == 0) {
+		g_string_free (str, TRUE);
+		return NULL;
+	}
+	return g_string_free (str, FALSE);
+}
+
 /*
  * pk_offline_auth_set_prepared_upgrade:
  * @name: Distro name to upgrade to
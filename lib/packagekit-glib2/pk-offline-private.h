@@ -70,6 +70,8 @@ gboolean		 pk_offline_auth_trigger_upgrade
 							 GError			**error);
 gboolean		 pk_offline_auth_set_prepared_ids(gchar			**package_ids,
 							 GError			**error);
+gchar			*pk_offline_get_package_db_fingerprint
+							(void);
 gboolean		 pk_offline_auth_set_prepared_upgrade
 							(const gchar		 *name,
 							 const gchar		 *release_ver,
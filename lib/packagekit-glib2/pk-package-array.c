@@ -0,0 +1,339 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:pk-package-array
+ * @short_description: A compact list of packages
+ *
+ * Stores the info, update severity, PackageID and summary of each package
+ * in parallel arrays, which is much smaller than a #PkPackage for each one
+ * when there are tens of thousands of them. A #PkPackage is only created
+ * when asked for, and is then kept for later calls.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include <packagekit-glib2/pk-package-array.h>
+#include <packagekit-glib2/pk-package-id.h>
+
+struct _PkPackageArray
+{
+	gint			 refcount;
+	GArray			*infos;		/* guint8 */
+	GArray			*update_severities;	/* guint8 */
+	GPtrArray		*package_ids;	/* interned */
+	GPtrArray		*summaries;	/* owned by summary_chunk */
+	GStringChunk		*summary_chunk;
+	GPtrArray		*packages;	/* PkPackage or %NULL, created on demand */
+	PkRoleEnum		 role;
+	gchar			*transaction_id;
+};
+
+G_STATIC_ASSERT (PK_INFO_ENUM_LAST <= G_MAXUINT8);
+
+G_DEFINE_BOXED_TYPE (PkPackageArray, pk_package_array,
+		     pk_package_array_ref, pk_package_array_unref)
+
+/**
+ * pk_package_array_new:
+ *
+ * Return value: (transfer full): a new #PkPackageArray, free with pk_package_array_unref()
+ *
+ * Since: 1.2.5
+ **/
+PkPackageArray *
+pk_package_array_new (void)
+{
+	PkPackageArray *array = g_new0 (PkPackageArray, 1);
+	array->refcount = 1;
+	array->infos = g_array_new (FALSE, FALSE, sizeof (guint8));
+	array->update_severities = g_array_new (FALSE, FALSE, sizeof (guint8));
+	array->package_ids = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_package_id_unintern);
+	array->summaries = g_ptr_array_new ();
+
+	/* summaries are often the same for each arch or version */
+	array->summary_chunk = g_string_chunk_new (4096);
+	return array;
+}
+
+/**
+ * pk_package_array_ref:
+ * @array: a #PkPackageArray
+ *
+ * Return value: (transfer full): @array
+ *
+ * Since: 1.2.5
+ **/
+PkPackageArray *
+pk_package_array_ref (PkPackageArray *array)
+{
+	g_return_val_if_fail (array != NULL, NULL);
+	g_atomic_int_inc (&array->refcount);
+	return array;
+}
+
+/**
+ * pk_package_array_unref:
+ * @array: a #PkPackageArray
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_package_array_unref (PkPackageArray *array)
+{
+	g_return_if_fail (array != NULL);
+	if (!g_atomic_int_dec_and_test (&array->refcount))
+		return;
+	g_array_unref (array->infos);
+	g_array_unref (array->update_severities);
+	g_ptr_array_unref (array->package_ids);
+	g_ptr_array_unref (array->summaries);
+	g_string_chunk_free (array->summary_chunk);
+	if (array->packages != NULL)
+		g_ptr_array_unref (array->packages);
+	g_free (array->transaction_id);
+	g_free (array);
+}
+
+/**
+ * pk_package_array_set_source:
+ * @array: a #PkPackageArray
+ * @role: the #PkRoleEnum of the transaction
+ * @transaction_id: the transaction ID, or %NULL
+ *
+ * Sets the #PkSource properties of the packages that are created later.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_package_array_set_source (PkPackageArray *array,
+			     PkRoleEnum role,
+			     const gchar *transaction_id)
+{
+	g_return_if_fail (array != NULL);
+	array->role = role;
+	g_free (array->transaction_id);
+	array->transaction_id = g_strdup (transaction_id);
+}
+
+static void
+pk_package_array_append (PkPackageArray *array,
+			 PkInfoEnum info,
+			 const gchar *package_id,
+			 const gchar *summary,
+			 PkInfoEnum update_severity,
+			 PkPackage *package)
+{
+	guint8 tmp;
+
+	tmp = info;
+	g_array_append_val (array->infos, tmp);
+	tmp = update_severity;
+	g_array_append_val (array->update_severities, tmp);
+	g_ptr_array_add (array->package_ids, (gpointer) pk_package_id_intern (package_id));
+	g_ptr_array_add (array->summaries,
+			 summary != NULL ? g_string_chunk_insert_const (array->summary_chunk, summary) : NULL);
+	if (package != NULL && array->packages == NULL) {
+		array->packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		g_ptr_array_set_size (array->packages, array->infos->len - 1);
+	}
+	if (array->packages != NULL)
+		g_ptr_array_add (array->packages, package != NULL ? g_object_ref (package) : NULL);
+}
+
+/**
+ * pk_package_array_add:
+ * @array: a #PkPackageArray
+ * @info: the #PkInfoEnum
+ * @package_id: the PackageID
+ * @summary: the package summary, or %NULL
+ * @update_severity: the #PkInfoEnum of the update, or %PK_INFO_ENUM_UNKNOWN
+ *
+ * Adds a package without creating a #PkPackage for it.
+ *
+ * Return value: %TRUE if @package_id was valid and the package was added
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_package_array_add (PkPackageArray *array,
+		      PkInfoEnum info,
+		      const gchar *package_id,
+		      const gchar *summary,
+		      PkInfoEnum update_severity)
+{
+	PkPackageIdParts parts;
+
+	g_return_val_if_fail (array != NULL, FALSE);
+
+	if (!pk_package_id_split_parts (package_id, &parts))
+		return FALSE;
+	pk_package_array_append (array, info, package_id, summary, update_severity, NULL);
+	return TRUE;
+}
+
+/**
+ * pk_package_array_add_package:
+ * @array: a #PkPackageArray
+ * @package: a #PkPackage
+ *
+ * Adds a package that already exists, which is returned as-is by
+ * pk_package_array_get_package().
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_package_array_add_package (PkPackageArray *array, PkPackage *package)
+{
+	g_return_if_fail (array != NULL);
+	g_return_if_fail (PK_IS_PACKAGE (package));
+
+	pk_package_array_append (array,
+				 pk_package_get_info (package),
+				 pk_package_get_id (package),
+				 pk_package_get_summary (package),
+				 pk_package_get_update_severity (package),
+				 package);
+}
+
+/**
+ * pk_package_array_get_size:
+ * @array: a #PkPackageArray
+ *
+ * Return value: the number of packages
+ *
+ * Since: 1.2.5
+ **/
+guint
+pk_package_array_get_size (PkPackageArray *array)
+{
+	g_return_val_if_fail (array != NULL, 0);
+	return array->infos->len;
+}
+
+/**
+ * pk_package_array_get_info:
+ * @array: a #PkPackageArray
+ * @idx: the index of the package
+ *
+ * Return value: the #PkInfoEnum of the package
+ *
+ * Since: 1.2.5
+ **/
+PkInfoEnum
+pk_package_array_get_info (PkPackageArray *array, guint idx)
+{
+	g_return_val_if_fail (array != NULL, PK_INFO_ENUM_UNKNOWN);
+	g_return_val_if_fail (idx < array->infos->len, PK_INFO_ENUM_UNKNOWN);
+	return g_array_index (array->infos, guint8, idx);
+}
+
+/**
+ * pk_package_array_get_id:
+ * @array: a #PkPackageArray
+ * @idx: the index of the package
+ *
+ * Return value: the PackageID, valid for as long as @array is
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+pk_package_array_get_id (PkPackageArray *array, guint idx)
+{
+	g_return_val_if_fail (array != NULL, NULL);
+	g_return_val_if_fail (idx < array->package_ids->len, NULL);
+	return g_ptr_array_index (array->package_ids, idx);
+}
+
+/**
+ * pk_package_array_get_summary:
+ * @array: a #PkPackageArray
+ * @idx: the index of the package
+ *
+ * Return value: the summary, or %NULL if unset
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+pk_package_array_get_summary (PkPackageArray *array, guint idx)
+{
+	g_return_val_if_fail (array != NULL, NULL);
+	g_return_val_if_fail (idx < array->summaries->len, NULL);
+	return g_ptr_array_index (array->summaries, idx);
+}
+
+/**
+ * pk_package_array_get_update_severity:
+ * @array: a #PkPackageArray
+ * @idx: the index of the package
+ *
+ * Return value: the update severity as a #PkInfoEnum
+ *
+ * Since: 1.2.5
+ **/
+PkInfoEnum
+pk_package_array_get_update_severity (PkPackageArray *array, guint idx)
+{
+	g_return_val_if_fail (array != NULL, PK_INFO_ENUM_UNKNOWN);
+	g_return_val_if_fail (idx < array->update_severities->len, PK_INFO_ENUM_UNKNOWN);
+	return g_array_index (array->update_severities, guint8, idx);
+}
+
+/**
+ * pk_package_array_get_package:
+ * @array: a #PkPackageArray
+ * @idx: the index of the package
+ *
+ * Gets the package as a #PkPackage, creating it the first time.
+ *
+ * Return value: (transfer none): the #PkPackage, valid for as long as @array is
+ *
+ * Since: 1.2.5
+ **/
+PkPackage *
+pk_package_array_get_package (PkPackageArray *array, guint idx)
+{
+	PkPackage *package;
+
+	g_return_val_if_fail (array != NULL, NULL);
+	g_return_val_if_fail (idx < array->infos->len, NULL);
+
+	if (array->packages == NULL) {
+		array->packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		g_ptr_array_set_size (array->packages, array->infos->len);
+	}
+	package = g_ptr_array_index (array->packages, idx);
+	if (package != NULL)
+		return package;
+
+	/* the ID was checked when it was added */
+	package = pk_package_new_full (pk_package_array_get_info (array, idx),
+				       g_ptr_array_index (array->package_ids, idx),
+				       pk_package_array_get_summary (array, idx),
+				       pk_package_array_get_update_severity (array, idx),
+				       array->role,
+				       array->transaction_id,
+				       NULL);
+	g_ptr_array_index (array->packages, idx) = package;
+	return package;
+}
@@ -0,0 +1,69 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU Lesser General Public License Version 2.1
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#if !defined (__PACKAGEKIT_H_INSIDE__) && !defined (PK_COMPILATION)
+#error "Only <packagekit.h> can be included directly."
+#endif
+
+#ifndef __PK_PACKAGE_ARRAY_H
+#define __PK_PACKAGE_ARRAY_H
+
+#include <glib-object.h>
+#include <packagekit-glib2/pk-enum.h>
+#include <packagekit-glib2/pk-package.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_PACKAGE_ARRAY		(pk_package_array_get_type ())
+
+typedef struct _PkPackageArray PkPackageArray;
+
+GType		 pk_package_array_get_type		(void);
+PkPackageArray	*pk_package_array_new			(void);
+PkPackageArray	*pk_package_array_ref			(PkPackageArray	*array);
+void		 pk_package_array_unref			(PkPackageArray	*array);
+void		 pk_package_array_set_source		(PkPackageArray	*array,
+							 PkRoleEnum	 role,
+							 const gchar	*transaction_id);
+gboolean	 pk_package_array_add			(PkPackageArray	*array,
+							 PkInfoEnum	 info,
+							 const gchar	*package_id,
+							 const gchar	*summary,
+							 PkInfoEnum	 update_severity);
+void		 pk_package_array_add_package		(PkPackageArray	*array,
+							 PkPackage	*package);
+guint		 pk_package_array_get_size		(PkPackageArray	*array);
+PkInfoEnum	 pk_package_array_get_info		(PkPackageArray	*array,
+							 guint		 idx);
+const gchar	*pk_package_array_get_id		(PkPackageArray	*array,
+							 guint		 idx);
+const gchar	*pk_package_array_get_summary		(PkPackageArray	*array,
+							 guint		 idx);
+PkInfoEnum	 pk_package_array_get_update_severity	(PkPackageArray	*array,
+							 guint		 idx);
+PkPackage	*pk_package_array_get_package		(PkPackageArray	*array,
+							 guint		 idx);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkPackageArray, pk_package_array_unref)
+
+G_END_DECLS
+
+#endif /* __PK_PACKAGE_ARRAY_H */
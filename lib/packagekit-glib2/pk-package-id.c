@@ -28,9 +28,160 @@
 #include "config.h"
 
 #include <glib.h>
+#include <string.h>
 
 #include <packagekit-glib2/pk-package-id.h>
 
+#include "pk-package-id-private.h"
+
+/*
+ * An interned PackageID is stored once per process however many objects
+ * refer to it, followed by a copy with the ';' changed into '\0' so the
+ * sections can be returned without allocating.
+ */
+typedef struct {
+	guint			 refcount;
+	const gchar		*sections[4];
+	gchar			 id[];
+} PkPackageIdEntry;
+
+#define PK_PACKAGE_ID_ENTRY(id)	((PkPackageIdEntry *) (gpointer) ((id) - G_STRUCT_OFFSET (PkPackageIdEntry, id)))
+
+static GMutex		 pk_package_id_intern_mutex;
+static GHashTable	*pk_package_id_intern_hash = NULL;	/* id:PkPackageIdEntry */
+
+/**
+ * pk_package_id_split_parts:
+ * @package_id: the ; delimited PackageID to split
+ * @parts: (out caller-allocates): the sections of @package_id
+ *
+ * Finds the sections of a PackageID, checking the correct number of
+ * delimiters are present, without allocating any memory.
+ *
+ * Return value: %TRUE if @package_id is valid
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_package_id_split_parts (const gchar *package_id, PkPackageIdParts *parts)
+{
+	guint cnt = 0;
+	guint i;
+
+	g_return_val_if_fail (parts != NULL, FALSE);
+
+	if (package_id == NULL)
+		return FALSE;
+	parts->offsets[0] = 0;
+	for (i = 0; package_id[i] != '\0'; i++) {
+		if (package_id[i] != ';')
+			continue;
+		if (++cnt > 3)
+			return FALSE;
+		parts->lengths[cnt - 1] = i - parts->offsets[cnt - 1];
+		parts->offsets[cnt] = i + 1;
+	}
+	if (cnt != 3)
+		return FALSE;
+	parts->lengths[3] = i - parts->offsets[3];
+
+	/* name has to be valid */
+	return parts->lengths[PK_PACKAGE_ID_NAME] > 0;
+}
+
+/**
+ * pk_package_id_intern:
+ * @package_id: a PackageID
+ *
+ * Gets the shared copy of @package_id, creating it if required. This is
+ * useful when a large number of objects refer to the same packages.
+ *
+ * Return value: the interned PackageID, which must be released with
+ * pk_package_id_unintern() rather than freed
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+pk_package_id_intern (const gchar *package_id)
+{
+	PkPackageIdEntry *entry;
+	gsize len;
+	guint cnt = 0;
+	guint i;
+	gchar *data;
+
+	g_return_val_if_fail (package_id != NULL, NULL);
+
+	g_mutex_lock (&pk_package_id_intern_mutex);
+	if (pk_package_id_intern_hash == NULL)
+		pk_package_id_intern_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	entry = g_hash_table_lookup (pk_package_id_intern_hash, package_id);
+	if (entry != NULL) {
+		entry->refcount++;
+		g_mutex_unlock (&pk_package_id_intern_mutex);
+		return entry->id;
+	}
+
+	/* sections past the data stay part of it, as pk_package_set_id()
+	 * always did; missing sections are %NULL */
+	len = strlen (package_id);
+	entry = g_malloc0 (sizeof (PkPackageIdEntry) + (len + 1) * 2);
+	entry->refcount = 1;
+	memcpy (entry->id, package_id, len + 1);
+	data = entry->id + len + 1;
+	memcpy (data, package_id, len + 1);
+	entry->sections[0] = data;
+	for (i = 0; data[i] != '\0'; i++) {
+		if (data[i] == ';' && cnt < 3) {
+			data[i] = '\0';
+			entry->sections[++cnt] = &data[i + 1];
+		}
+	}
+	g_hash_table_insert (pk_package_id_intern_hash, entry->id, entry);
+	g_mutex_unlock (&pk_package_id_intern_mutex);
+	return entry->id;
+}
+
+/**
+ * pk_package_id_unintern:
+ * @package_id: a PackageID returned by pk_package_id_intern()
+ *
+ * Releases a reference to an interned PackageID, freeing it when it is
+ * no longer used.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_package_id_unintern (const gchar *package_id)
+{
+	PkPackageIdEntry *entry;
+
+	if (package_id == NULL)
+		return;
+
+	entry = PK_PACKAGE_ID_ENTRY (package_id);
+	g_mutex_lock (&pk_package_id_intern_mutex);
+	g_assert (entry->refcount > 0);
+	if (--entry->refcount == 0) {
+		g_hash_table_remove (pk_package_id_intern_hash, entry->id);
+		g_free (entry);
+	}
+	g_mutex_unlock (&pk_package_id_intern_mutex);
+}
+
+/*
+ * pk_package_id_intern_get_sections:
+ * @package_id: a PackageID returned by pk_package_id_intern()
+ *
+ * Return value: the name, version, arch and data of the interned
+ * PackageID, which are valid as long as it is
+ **/
+const gchar * const *
+pk_package_id_intern_get_sections (const gchar *package_id)
+{
+	return PK_PACKAGE_ID_ENTRY (package_id)->sections;
+}
+
 /**
  * pk_package_id_split:
  * @package_id: the ; delimited PackageID to split
@@ -76,23 +227,54 @@ out:
 gboolean
 pk_package_id_check (const gchar *package_id)
 {
-	g_auto(GStrv) sections = NULL;
-	gboolean ret;
+	PkPackageIdParts parts;
+	return pk_package_id_check_parts (package_id, &parts);
+}
+
+/**
+ * pk_package_id_check_parts:
+ * @package_id: the ; delimited PackageID to check
+ * @parts: (out caller-allocates): the sections of @package_id
+ *
+ * Does what pk_package_id_check() and pk_package_id_split_parts() do in
+ * one pass over the string. Only PackageIDs that are not plain ASCII are
+ * read again to validate the UTF-8.
+ *
+ * Return value: %TRUE if @package_id is valid
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_package_id_check_parts (const gchar *package_id, PkPackageIdParts *parts)
+{
+	guchar seen = 0;
+	guint cnt = 0;
+	guint i;
+
+	g_return_val_if_fail (parts != NULL, FALSE);
 
-	/* NULL check */
 	if (package_id == NULL)
 		return FALSE;
-
-	/* UTF8 */
-	ret = g_utf8_validate (package_id, -1, NULL);
-	if (!ret)
+	parts->offsets[0] = 0;
+	for (i = 0; package_id[i] != '\0'; i++) {
+		seen |= (guchar) package_id[i];
+		if (package_id[i] != ';')
+			continue;
+		if (++cnt > 3)
+			return FALSE;
+		parts->lengths[cnt - 1] = i - parts->offsets[cnt - 1];
+		parts->offsets[cnt] = i + 1;
+	}
+	if (cnt != 3)
 		return FALSE;
-
-	/* correct number of sections */
-	sections = pk_package_id_split (package_id);
-	if (sections == NULL)
+	parts->lengths[3] = i - parts->offsets[3];
+	if (parts->lengths[PK_PACKAGE_ID_NAME] == 0)
 		return FALSE;
-	return TRUE;
+
+	/* every byte was below 0x80 */
+	if ((seen & 0x80) == 0)
+		return TRUE;
+	return g_utf8_validate (package_id, i, NULL);
 }
 
 /**
@@ -163,16 +345,31 @@ pk_package_id_equal_fuzzy_arch_section (const gchar *arch1, const gchar *arch2)
 gboolean
 pk_package_id_equal_fuzzy_arch (const gchar *package_id1, const gchar *package_id2)
 {
-	g_auto(GStrv) sections1 = NULL;
-	g_auto(GStrv) sections2 = NULL;
-
-	sections1 = pk_package_id_split (package_id1);
-	sections2 = pk_package_id_split (package_id2);
-	if (g_strcmp0 (sections1[0], sections2[0]) == 0 &&
-	    g_strcmp0 (sections1[1], sections2[1]) == 0 &&
-	    pk_package_id_equal_fuzzy_arch_section (sections1[2], sections2[2]))
+	PkPackageIdParts parts1;
+	PkPackageIdParts parts2;
+	g_autofree gchar *arch1 = NULL;
+	g_autofree gchar *arch2 = NULL;
+
+	if (!pk_package_id_split_parts (package_id1, &parts1) ||
+	    !pk_package_id_split_parts (package_id2, &parts2))
+		return FALSE;
+
+	/* the name and version are one range, including the ';' */
+	if (parts1.offsets[PK_PACKAGE_ID_ARCH] != parts2.offsets[PK_PACKAGE_ID_ARCH] ||
+	    strncmp (package_id1, package_id2, parts1.offsets[PK_PACKAGE_ID_ARCH]) != 0)
+		return FALSE;
+	if (parts1.lengths[PK_PACKAGE_ID_ARCH] == parts2.lengths[PK_PACKAGE_ID_ARCH] &&
+	    strncmp (package_id1 + parts1.offsets[PK_PACKAGE_ID_ARCH],
+		     package_id2 + parts2.offsets[PK_PACKAGE_ID_ARCH],
+		     parts1.lengths[PK_PACKAGE_ID_ARCH]) == 0)
 		return TRUE;
-	return FALSE;
+
+	/* only copy when it has to be a fuzzy match */
+	arch1 = g_strndup (package_id1 + parts1.offsets[PK_PACKAGE_ID_ARCH],
+			   parts1.lengths[PK_PACKAGE_ID_ARCH]);
+	arch2 = g_strndup (package_id2 + parts2.offsets[PK_PACKAGE_ID_ARCH],
+			   parts2.lengths[PK_PACKAGE_ID_ARCH]);
+	return pk_package_id_equal_fuzzy_arch_section (arch1, arch2);
 }
 
 /**
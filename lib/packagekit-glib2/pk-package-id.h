@@ -58,12 +58,33 @@ G_BEGIN_DECLS
  */
 #define PK_PACKAGE_ID_DATA	3
 
+/**
+ * PkPackageIdParts:
+ * @offsets: where each section starts in the PackageID
+ * @lengths: the length of each section, not including the ';'
+ *
+ * The sections of a PackageID without copying them, indexed using
+ * %PK_PACKAGE_ID_NAME and friends.
+ *
+ * Since: 1.2.5
+ */
+typedef struct {
+	guint		 offsets[4];
+	guint		 lengths[4];
+} PkPackageIdParts;
+
 gchar		*pk_package_id_build			(const gchar		*name,
 							 const gchar		*version,
 							 const gchar		*arch,
 							 const gchar		*data);
 gboolean	 pk_package_id_check			(const gchar		*package_id);
 gchar		**pk_package_id_split			(const gchar		*package_id);
+gboolean	 pk_package_id_check_parts		(const gchar		*package_id,
+							 PkPackageIdParts	*parts);
+gboolean	 pk_package_id_split_parts		(const gchar		*package_id,
+							 PkPackageIdParts	*parts);
+const gchar	*pk_package_id_intern			(const gchar		*package_id);
+void		 pk_package_id_unintern			(const gchar		*package_id);
 gchar		*pk_package_id_to_printable		(const gchar		*package_id);
 gboolean	 pk_package_id_equal_fuzzy_arch		(const gchar		*package_id1,
 							 const gchar		*package_id2);
@@ -74,23 +74,46 @@ pk_package_ids_from_string (const gchar *package_id)
 gboolean
 pk_package_ids_check (gchar **package_ids)
 {
+	g_return_val_if_fail (package_ids != NULL, FALSE);
+	return pk_package_ids_check_parts (package_ids, NULL);
+}
+
+/**
+ * pk_package_ids_check_parts:
+ * @package_ids: a string array of package_id's
+ * @parts: (out) (optional) (array) (transfer full): the sections of each
+ *   PackageID, in the same order, or %NULL
+ *
+ * Checks the string array of package_id's for validity, reading each one
+ * only once, and keeps where the sections of every PackageID are so that
+ * they can be used without splitting them again.
+ *
+ * Return value: %TRUE if the package_ids are all valid; @parts is only
+ * set in that case and must be freed with g_free()
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_package_ids_check_parts (gchar **package_ids, PkPackageIdParts **parts)
+{
+	g_autofree PkPackageIdParts *array = NULL;
+	PkPackageIdParts tmp;
 	guint i;
-	guint size;
-	gboolean ret = FALSE;
-	const gchar *package_id;
 
 	g_return_val_if_fail (package_ids != NULL, FALSE);
 
-	/* check all */
-	size = g_strv_length (package_ids);
-	for (i = 0; i < size; i++) {
-		package_id = package_ids[i];
-		ret = pk_package_id_check (package_id);
-		if (!ret)
-			goto out;
+	if (package_ids[0] == NULL)
+		return FALSE;
+	if (parts != NULL)
+		array = g_new (PkPackageIdParts, g_strv_length (package_ids));
+	for (i = 0; package_ids[i] != NULL; i++) {
+		if (!pk_package_id_check_parts (package_ids[i],
+						array != NULL ? &array[i] : &tmp))
+			return FALSE;
 	}
-out:
-	return ret;
+	if (parts != NULL)
+		*parts = g_steal_pointer (&array);
+	return TRUE;
 }
 
 /**
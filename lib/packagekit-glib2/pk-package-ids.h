@@ -27,6 +27,7 @@
 #define __PK_PACKAGE_IDS_H
 
 #include <glib.h>
+#include <packagekit-glib2/pk-package-id.h>
 
 G_BEGIN_DECLS
 
@@ -46,6 +47,8 @@ G_BEGIN_DECLS
 gchar		**pk_package_ids_from_id		(const gchar	*package_id);
 gchar		**pk_package_ids_from_string		(const gchar	*package_id);
 gboolean	 pk_package_ids_check			(gchar		**package_ids);
+gboolean	 pk_package_ids_check_parts		(gchar		**package_ids,
+							 PkPackageIdParts **parts);
 gchar		*pk_package_ids_to_string			(gchar		**package_ids);
 gboolean	 pk_package_ids_present_id		(gchar		**package_ids,
 							 const gchar	*package_id);
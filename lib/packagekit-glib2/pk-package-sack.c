@@ -32,6 +32,7 @@
 
 #include <glib-object.h>
 #include <gio/gio.h>
+#include <string.h>
 
 #include <packagekit-glib2/pk-package-sack.h>
 #include <packagekit-glib2/pk-client.h>
@@ -51,11 +52,18 @@ static void     pk_package_sack_finalize	(GObject     *object);
  **/
 struct _PkPackageSackPrivate
 {
-	GHashTable		*table;
+	GHashTable		*table;		/* package_id:GPtrArray of PkPackage */
+	GHashTable		*table_name_arch; /* "name;arch":GPtrArray of PkPackage */
 	GPtrArray		*array;
 	PkClient		*client;
+	guint			 chunk_size;
+	guint			 max_parallel;
 };
 
+/* defaults for pk_package_sack_set_merge_chunking() */
+#define PK_PACKAGE_SACK_CHUNK_SIZE	1000
+#define PK_PACKAGE_SACK_MAX_PARALLEL	4
+
 enum {
 	SIGNAL_CHANGED,
 	SIGNAL_LAST
@@ -63,6 +71,67 @@ enum {
 
 G_DEFINE_TYPE (PkPackageSack, pk_package_sack, G_TYPE_OBJECT)
 
+/*
+ * Both indexes map to every package with that key in the order they were
+ * added, so that duplicates do not go missing when one of them is removed.
+ * The package_id keys are borrowed from the interned IDs of the packages.
+ */
+static void
+pk_package_sack_index_add (GHashTable *table,
+			   gpointer key,
+			   GDestroyNotify key_free,
+			   PkPackage *package)
+{
+	GPtrArray *bucket = g_hash_table_lookup (table, key);
+	if (bucket == NULL) {
+		bucket = g_ptr_array_sized_new (1);
+		g_hash_table_insert (table, key, bucket);
+	} else if (key_free != NULL) {
+		key_free (key);
+	}
+	g_ptr_array_add (bucket, package);
+}
+
+static void
+pk_package_sack_index_remove (GHashTable *table, gconstpointer key, PkPackage *package)
+{
+	GPtrArray *bucket = g_hash_table_lookup (table, key);
+	if (bucket == NULL)
+		return;
+	g_ptr_array_remove (bucket, package);
+	if (bucket->len == 0)
+		g_hash_table_remove (table, key);
+}
+
+static gchar *
+pk_package_sack_name_arch_key (PkPackage *package)
+{
+	return g_strdup_printf ("%s;%s",
+				pk_package_get_name (package),
+				pk_package_get_arch (package));
+}
+
+static void
+pk_package_sack_add_to_indexes (PkPackageSack *sack, PkPackage *package)
+{
+	pk_package_sack_index_add (sack->priv->table,
+				   (gpointer) pk_package_get_id (package),
+				   NULL, package);
+	pk_package_sack_index_add (sack->priv->table_name_arch,
+				   pk_package_sack_name_arch_key (package),
+				   g_free, package);
+}
+
+static void
+pk_package_sack_remove_from_indexes (PkPackageSack *sack, PkPackage *package)
+{
+	g_autofree gchar *key = pk_package_sack_name_arch_key (package);
+	pk_package_sack_index_remove (sack->priv->table_name_arch, key, package);
+	pk_package_sack_index_remove (sack->priv->table,
+				      pk_package_get_id (package),
+				      package);
+}
+
 /**
  * pk_package_sack_clear:
  * @sack: a valid #PkPackageSack instance
@@ -76,8 +145,9 @@ pk_package_sack_clear (PkPackageSack *sack)
 {
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 
-	g_ptr_array_set_size (sack->priv->array, 0);
 	g_hash_table_remove_all (sack->priv->table);
+	g_hash_table_remove_all (sack->priv->table_name_arch);
+	g_ptr_array_set_size (sack->priv->array, 0);
 }
 
 /**
@@ -234,12 +304,14 @@ pk_package_sack_add_package (PkPackageSack *sack, PkPackage *package)
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 
+	/* packages without an ID cannot be found again */
+	if (pk_package_get_id (package) == NULL)
+		return FALSE;
+
 	/* add to array */
 	g_ptr_array_add (sack->priv->array,
 			 g_object_ref (package));
-	g_hash_table_insert (sack->priv->table,
-			     (gpointer) pk_package_get_id (package),
-			     (gpointer) package);
+	pk_package_sack_add_to_indexes (sack, package);
 
 	return TRUE;
 }
@@ -279,24 +351,35 @@ pk_package_sack_add_package_by_id (PkPackageSack *sack,
 
 /*
  * pk_package_sack_add_packages_from_line:
+ * @package_str: a stripped line, which is split in place
  **/
 static gboolean
 pk_package_sack_add_packages_from_line (PkPackageSack *sack,
-					const gchar *package_str,
+					gchar *package_str,
 					GError **error)
 {
 	PkInfoEnum info;
+	gchar *pdata[3];
+	gchar *tmp;
+	guint i;
 	g_autoptr(GError) error_local = NULL;
 	g_autoptr(PkPackage) package = NULL;
-	g_auto(GStrv) pdata = NULL;
 
-	package = pk_package_new ();
-	pdata = g_strsplit (package_str, "\t", -1);
-	if (g_strv_length (pdata) != 3) {
+	/* exactly three sections, without allocating each */
+	pdata[0] = package_str;
+	for (i = 1; i < 3; i++) {
+		tmp = strchr (pdata[i - 1], '\t');
+		if (tmp == NULL)
+			break;
+		*tmp = '\0';
+		pdata[i] = tmp + 1;
+	}
+	if (i != 3 || strchr (pdata[2], '\t') != NULL) {
 		g_set_error (error, 1, 0, "invalid package-info line: %s", package_str);
 		return FALSE;
 	}
 
+	package = pk_package_new ();
 	info = pk_info_enum_from_string (pdata[0]);
 	g_object_set (package,
 		      "info", info,
@@ -311,6 +394,39 @@ pk_package_sack_add_packages_from_line (PkPackageSack *sack,
 	return TRUE;
 }
 
+/*
+ * pk_package_sack_add_packages_from_data:
+ *
+ * Walks the file contents once, only copying each line into a buffer
+ * that is reused so that it can be split in place.
+ **/
+static gboolean
+pk_package_sack_add_packages_from_data (PkPackageSack *sack,
+					const gchar *data,
+					gsize len,
+					GError **error)
+{
+	const gchar *end = data + len;
+	const gchar *line = data;
+	g_autoptr(GString) buf = g_string_new (NULL);
+
+	while (line < end) {
+		const gchar *eol = memchr (line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+		g_string_truncate (buf, 0);
+		g_string_append_len (buf, line, eol - line);
+		line = eol + 1;
+
+		g_strstrip (buf->str);
+		if (buf->str[0] == '\0')
+			continue;
+		if (!pk_package_sack_add_packages_from_line (sack, buf->str, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 /**
  * pk_package_sack_add_packages_from_file:
  * @sack: a valid #PkPackageSack instance
@@ -327,31 +443,26 @@ pk_package_sack_add_packages_from_file (PkPackageSack *sack,
 					GFile *file,
 					GError **error)
 {
-	GError *error_local = NULL;
-	g_autoptr(GFileInputStream) is = NULL;
-	g_autoptr(GDataInputStream) input = NULL;
+	gsize len = 0;
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *path = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 
-	is = g_file_read (file, NULL, &error_local);
-	if (is == NULL) {
-		g_propagate_error (error, error_local);
-		return FALSE;
-	}
-
-	input = g_data_input_stream_new (G_INPUT_STREAM (is));
-
-	/* read package info file line by line */
-	while (TRUE) {
-		gchar *line;
-		line = g_data_input_stream_read_line (input, NULL, NULL, NULL);
-		if (line == NULL)
-			break;
-		g_strstrip (line);
-		if (!pk_package_sack_add_packages_from_line (sack, line, error))
+	/* map local files rather than reading them */
+	path = g_file_get_path (file);
+	if (path != NULL) {
+		g_autoptr(GMappedFile) mapped = g_mapped_file_new (path, FALSE, error);
+		if (mapped == NULL)
 			return FALSE;
+		return pk_package_sack_add_packages_from_data (sack,
+							       g_mapped_file_get_contents (mapped),
+							       g_mapped_file_get_length (mapped),
+							       error);
 	}
-	return TRUE;
+	if (!g_file_load_contents (file, NULL, &contents, &len, NULL, error))
+		return FALSE;
+	return pk_package_sack_add_packages_from_data (sack, contents, len, error);
 }
 
 /**
@@ -369,32 +480,38 @@ pk_package_sack_add_packages_from_file (PkPackageSack *sack,
 gboolean
 pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
 {
-	gboolean ret;
 	guint i;
 	PkPackage *pkg;
-	g_autoptr(GString) string = NULL;
+	g_autoptr(GFileOutputStream) os = NULL;
+	g_autoptr(GOutputStream) out = NULL;
+
+	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 
-	string = g_string_new ("");
+	/* the file is only replaced when the stream is closed, and the
+	 * buffer keeps the memory used the same for any size of sack */
+	os = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+	if (os == NULL)
+		return FALSE;
+	out = g_buffered_output_stream_new_sized (G_OUTPUT_STREAM (os), 64 * 1024);
 	for (i = 0; i < sack->priv->array->len; i++) {
+		const gchar *summary;
+
 		pkg = g_ptr_array_index (sack->priv->array, i);
-		g_string_append_printf (string,
-					"%s\t%s\t%s\n",
-					pk_info_enum_to_string (pk_package_get_info (pkg)),
-					pk_package_get_id (pkg),
-					pk_package_get_summary (pkg));
+		summary = pk_package_get_summary (pkg);
+		if (!g_output_stream_printf (out, NULL, NULL, error,
+					     "%s\t%s\t%s\n",
+					     pk_info_enum_to_string (pk_package_get_info (pkg)),
+					     pk_package_get_id (pkg),
+					     summary != NULL ? summary : "")) {
+			/* closing cancelled keeps the old file, rather
+			 * than replacing it with a partial one */
+			g_autoptr(GCancellable) cancellable = g_cancellable_new ();
+			g_cancellable_cancel (cancellable);
+			g_output_stream_close (out, cancellable, NULL);
+			return FALSE;
+		}
 	}
-	ret = g_file_replace_contents (file,
-				       string->str,
-				       string->len,
-				       NULL,
-				       FALSE,
-				       G_FILE_CREATE_NONE,
-				       NULL,
-				       NULL,
-				       error);
-	if (!ret)
-		return FALSE;
-	return TRUE;
+	return g_output_stream_close (out, NULL, error);
 }
 
 /**
@@ -411,12 +528,17 @@ pk_package_sack_to_file (PkPackageSack *sack, GFile *file, GError **error)
 gboolean
 pk_package_sack_remove_package (PkPackageSack *sack, PkPackage *package)
 {
+	guint idx;
+
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
 
 	/* remove from array */
-	g_hash_table_remove (sack->priv->table, pk_package_get_id (package));
-	return g_ptr_array_remove (sack->priv->array, package);
+	if (!g_ptr_array_find (sack->priv->array, package, &idx))
+		return FALSE;
+	pk_package_sack_remove_from_indexes (sack, package);
+	g_ptr_array_remove_index (sack->priv->array, idx);
+	return TRUE;
 }
 
 /**
@@ -435,22 +557,15 @@ gboolean
 pk_package_sack_remove_package_by_id (PkPackageSack *sack,
 				      const gchar *package_id)
 {
-	PkPackage *package;
-	guint i;
-	GPtrArray *array;
+	GPtrArray *bucket;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (package_id != NULL, FALSE);
 
-	array = sack->priv->array;
-	for (i = 0; i < array->len; i++) {
-		package = g_ptr_array_index (array, i);
-		if (g_strcmp0 (package_id, pk_package_get_id (package)) == 0) {
-			pk_package_sack_remove_package (sack, package);
-			return TRUE;
-		}
-	}
-	return FALSE;
+	bucket = g_hash_table_lookup (sack->priv->table, package_id);
+	if (bucket == NULL)
+		return FALSE;
+	return pk_package_sack_remove_package (sack, g_ptr_array_index (bucket, 0));
 }
 
 /**
@@ -471,26 +586,32 @@ pk_package_sack_remove_by_filter (PkPackageSack *sack,
 				  PkPackageSackFilterFunc filter_cb,
 				  gpointer user_data)
 {
-	gboolean ret = FALSE;
 	PkPackage *package;
-	gint i;
+	guint i;
+	guint j = 0;
 	PkPackageSackPrivate *priv = sack->priv;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), FALSE);
 	g_return_val_if_fail (filter_cb != NULL, FALSE);
 
-	/* add each that matches the info enum */
-	for (i = 0; i < (gint) priv->array->len; i++) {
+	/* compact the array in place rather than removing one at a time */
+	for (i = 0; i < priv->array->len; i++) {
 		package = g_ptr_array_index (priv->array, i);
-		if (!filter_cb (package, user_data)) {
-			ret = TRUE;
-			pk_package_sack_remove_package (sack, package);
-
-			/* ensure we pick up subsequent matches */
-			i--;
+		if (filter_cb (package, user_data)) {
+			g_ptr_array_index (priv->array, j++) = package;
+			continue;
 		}
+		pk_package_sack_remove_from_indexes (sack, package);
+		g_object_unref (package);
 	}
-	return ret;
+	if (j == priv->array->len)
+		return FALSE;
+
+	/* the removed packages have already been unreffed */
+	g_ptr_array_set_free_func (priv->array, NULL);
+	g_ptr_array_set_size (priv->array, j);
+	g_ptr_array_set_free_func (priv->array, g_object_unref);
+	return TRUE;
 }
 
 /**
@@ -498,8 +619,8 @@ pk_package_sack_remove_by_filter (PkPackageSack *sack,
  * @sack: a valid #PkPackageSack instance
  * @package_id: a package_id descriptor
  *
- * Finds a package in a sack from reference. As soon as one package is found
- * the search is stopped.
+ * Finds a package in a sack from reference. If the same ID was added more
+ * than once the latest package is returned.
  *
  * Return value: (transfer full): the #PkPackage object, or %NULL if unfound. Free with g_object_unref()
  *
@@ -513,9 +634,12 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
-	package = g_hash_table_lookup (sack->priv->table, package_id);
-	if (package != NULL)
-		g_object_ref (package);
+	GPtrArray *bucket;
+
+	/* the bucket is in the order the packages were added */
+	bucket = g_hash_table_lookup (sack->priv->table, package_id);
+	if (bucket != NULL)
+		package = g_object_ref (g_ptr_array_index (bucket, bucket->len - 1));
 
 	return package;
 }
@@ -535,27 +659,25 @@ pk_package_sack_find_by_id (PkPackageSack *sack, const gchar *package_id)
 PkPackage *
 pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_id)
 {
-	PkPackage *pkg_tmp;
-	guint i;
-	g_auto(GStrv) split = NULL;
+	GPtrArray *bucket;
+	PkPackageIdParts parts;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (PK_IS_PACKAGE_SACK (sack), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
 
 	/* does the package name feature in the array */
-	split = pk_package_id_split (package_id);
-	if (split == NULL)
+	if (!pk_package_id_split_parts (package_id, &parts))
 		return NULL;
-	for (i = 0; i < sack->priv->array->len; i++) {
-		pkg_tmp = g_ptr_array_index (sack->priv->array, i);
-		if (g_strcmp0 (pk_package_get_name (pkg_tmp),
-			       split[PK_PACKAGE_ID_NAME]) == 0 &&
-		    g_strcmp0 (pk_package_get_arch (pkg_tmp),
-			       split[PK_PACKAGE_ID_ARCH]) == 0) {
-			return g_object_ref (pkg_tmp);
-		}
-	}
-	return NULL;
+	key = g_strdup_printf ("%.*s;%.*s",
+			       (gint) parts.lengths[PK_PACKAGE_ID_NAME],
+			       package_id + parts.offsets[PK_PACKAGE_ID_NAME],
+			       (gint) parts.lengths[PK_PACKAGE_ID_ARCH],
+			       package_id + parts.offsets[PK_PACKAGE_ID_ARCH]);
+	bucket = g_hash_table_lookup (sack->priv->table_name_arch, key);
+	if (bucket == NULL)
+		return NULL;
+	return g_object_ref (g_ptr_array_index (bucket, 0));
 }
 
 /*
@@ -564,16 +686,7 @@ pk_package_sack_find_by_id_name_arch (PkPackageSack *sack, const gchar *package_
 static gint
 pk_package_sack_sort_compare_name_func (PkPackage **a, PkPackage **b)
 {
-	const gchar *package_id1;
-	const gchar *package_id2;
-	g_auto(GStrv) split1 = NULL;
-	g_auto(GStrv) split2 = NULL;
-
-	package_id1 = pk_package_get_id (*a);
-	package_id2 = pk_package_get_id (*b);
-	split1 = pk_package_id_split (package_id1);
-	split2 = pk_package_id_split (package_id2);
-	return g_strcmp0 (split1[PK_PACKAGE_ID_NAME], split2[PK_PACKAGE_ID_NAME]);
+	return g_strcmp0 (pk_package_get_name (*a), pk_package_get_name (*b));
 }
 
 /*
@@ -699,12 +812,27 @@ pk_package_sack_get_package_ids (PkPackageSack *sack)
 	return package_ids;
 }
 
-typedef struct {
+typedef struct _PkPackageSackState PkPackageSackState;
+
+/* starts one transaction for a chunk of the package IDs */
+typedef void (*PkPackageSackChunkFunc) (PkPackageSackState *state, gchar **package_ids);
+
+struct _PkPackageSackState {
 	PkPackageSack		*sack;
 	GCancellable		*cancellable;
 	gboolean		 ret;
 	GSimpleAsyncResult	*res;
-} PkPackageSackState;
+	PkProgressCallback	 progress_callback;
+	gpointer		 progress_user_data;
+	PkPackageSackChunkFunc	 chunk_func;
+	const gchar		*empty_message;
+	gchar			**package_ids;
+	guint			 n_package_ids;
+	guint			 next;		/* index of the first ID not yet sent */
+	guint			 pending;	/* chunks in flight */
+	guint			 found;		/* items merged over all chunks */
+	GError			*error;		/* first chunk failure */
+};
 
 /***************************************************************************************************/
 
@@ -727,11 +855,127 @@ pk_package_sack_merge_bool_state_finish (PkPackageSackState *state, const GError
 	/* deallocate */
 	if (state->cancellable != NULL)
 		g_object_unref (state->cancellable);
+	g_strfreev (state->package_ids);
+	g_clear_error (&state->error);
 	g_object_unref (state->res);
 	g_object_unref (state->sack);
 	g_slice_free (PkPackageSackState, state);
 }
 
+/*
+ * pk_package_sack_merge_start_chunks:
+ *
+ * Keeps up to max-parallel transactions in flight, each for the next
+ * chunk-size package IDs. Nothing new is started once a chunk has failed.
+ **/
+static void
+pk_package_sack_merge_start_chunks (PkPackageSackState *state)
+{
+	PkPackageSackPrivate *priv = state->sack->priv;
+	guint chunk_size = priv->chunk_size > 0 ? priv->chunk_size : state->n_package_ids;
+
+	while (state->error == NULL &&
+	       state->pending < priv->max_parallel &&
+	       state->next < state->n_package_ids) {
+		guint len = MIN (chunk_size, state->n_package_ids - state->next);
+		g_auto(GStrv) chunk = g_new0 (gchar *, len + 1);
+
+		for (guint i = 0; i < len; i++)
+			chunk[i] = g_strdup (state->package_ids[state->next + i]);
+		state->next += len;
+		state->pending++;
+		state->chunk_func (state, chunk);
+	}
+}
+
+/*
+ * pk_package_sack_merge_chunk_done:
+ * @found: the number of items merged from this chunk
+ * @error: why the chunk failed, or %NULL
+ *
+ * Completes the operation once the last chunk is back. It only fails with
+ * the empty message if none of the chunks returned anything at all.
+ **/
+static void
+pk_package_sack_merge_chunk_done (PkPackageSackState *state, guint found, const GError *error)
+{
+	state->pending--;
+	state->found += found;
+	if (error != NULL && state->error == NULL)
+		state->error = g_error_copy (error);
+
+	pk_package_sack_merge_start_chunks (state);
+	if (state->pending > 0)
+		return;
+
+	if (state->error == NULL && state->found == 0)
+		state->error = g_error_new (1, 0, "%s", state->empty_message);
+	state->ret = state->error == NULL;
+	pk_package_sack_merge_bool_state_finish (state, state->error);
+}
+
+/*
+ * pk_package_sack_merge_start:
+ **/
+static void
+pk_package_sack_merge_start (PkPackageSack *sack,
+			     gpointer source_tag,
+			     PkPackageSackChunkFunc chunk_func,
+			     const gchar *empty_message,
+			     GCancellable *cancellable,
+			     PkProgressCallback progress_callback,
+			     gpointer progress_user_data,
+			     GAsyncReadyCallback callback,
+			     gpointer user_data)
+{
+	PkPackageSackState *state;
+
+	/* save state */
+	state = g_slice_new0 (PkPackageSackState);
+	state->res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, source_tag);
+	state->sack = g_object_ref (sack);
+	if (cancellable != NULL)
+		state->cancellable = g_object_ref (cancellable);
+	state->ret = FALSE;
+	state->progress_callback = progress_callback;
+	state->progress_user_data = progress_user_data;
+	state->chunk_func = chunk_func;
+	state->empty_message = empty_message;
+	state->package_ids = pk_package_sack_get_package_ids (sack);
+	state->n_package_ids = g_strv_length (state->package_ids);
+
+	/* an empty sack still makes the one request it always did */
+	if (state->n_package_ids == 0) {
+		state->pending = 1;
+		chunk_func (state, state->package_ids);
+		return;
+	}
+	pk_package_sack_merge_start_chunks (state);
+}
+
+/**
+ * pk_package_sack_set_merge_chunking:
+ * @sack: a valid #PkPackageSack instance
+ * @chunk_size: the most package IDs to send in one transaction, or 0 for all
+ * @max_parallel: the most transactions to have running at once
+ *
+ * Sets how pk_package_sack_resolve_async(), pk_package_sack_get_details_async()
+ * and pk_package_sack_get_update_detail_async() split up a large sack.
+ * Each chunk is merged as soon as its transaction finishes, rather than
+ * holding every result of one huge transaction in memory at the same time.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_package_sack_set_merge_chunking (PkPackageSack *sack, guint chunk_size, guint max_parallel)
+{
+	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
+	g_return_if_fail (max_parallel > 0);
+
+	sack->priv->chunk_size = chunk_size;
+	sack->priv->max_parallel = max_parallel;
+}
+
 /*
  * pk_package_sack_resolve_cb:
  **/
@@ -751,18 +995,12 @@ pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackage
 	results = pk_client_generic_finish (client, res, &error);
 	if (results == NULL) {
 		g_warning ("failed to resolve: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
+		pk_package_sack_merge_chunk_done (state, 0, error);
 		return;
 	}
 
 	/* get the packages */
 	packages = pk_results_get_package_array (results);
-	if (packages->len == 0) {
-		g_warning ("%i", state->ret);
-		error = g_error_new (1, 0, "no packages found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
 
 	/* set data on each item */
 	for (i = 0; i < packages->len; i++) {
@@ -782,11 +1020,20 @@ pk_package_sack_resolve_cb (GObject *source_object, GAsyncResult *res, PkPackage
 		g_object_unref (package);
 	}
 
-	/* all okay */
-	state->ret = TRUE;
+	/* this chunk is done */
+	pk_package_sack_merge_chunk_done (state, packages->len, NULL);
+}
 
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+/*
+ * pk_package_sack_resolve_chunk:
+ **/
+static void
+pk_package_sack_resolve_chunk (PkPackageSackState *state, gchar **package_ids)
+{
+	pk_client_resolve_async (state->sack->priv->client,
+				 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids,
+				 state->cancellable, state->progress_callback, state->progress_user_data,
+				 (GAsyncReadyCallback) pk_package_sack_resolve_cb, state);
 }
 
 /**
@@ -807,29 +1054,13 @@ pk_package_sack_resolve_async (PkPackageSack *sack, GCancellable *cancellable,
 				     PkProgressCallback progress_callback, gpointer progress_user_data,
 				     GAsyncReadyCallback callback, gpointer user_data)
 {
-	PkPackageSackState *state;
-	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
-
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
 
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_resolve_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start resolve async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_resolve_async (sack->priv->client,
-				 pk_bitfield_value (PK_FILTER_ENUM_INSTALLED), package_ids,
-				 cancellable, progress_callback, progress_user_data,
-				 (GAsyncReadyCallback) pk_package_sack_resolve_cb, state);
+	pk_package_sack_merge_start (sack, pk_package_sack_resolve_async,
+				     pk_package_sack_resolve_chunk, "no packages found!",
+				     cancellable, progress_callback, progress_user_data,
+				     callback, user_data);
 }
 
 /**
@@ -881,17 +1112,12 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 	results = pk_client_generic_finish (client, res, &error);
 	if (results == NULL) {
 		g_warning ("failed to details: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
+		pk_package_sack_merge_chunk_done (state, 0, error);
 		return;
 	}
 
 	/* get the details */
 	details = pk_results_get_details_array (results);
-	if (details->len == 0) {
-		error = g_error_new (1, 0, "no details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
 
 	/* set data on each item */
 	for (i = 0; i < details->len; i++) {
@@ -919,11 +1145,19 @@ pk_package_sack_get_details_cb (GObject *source_object, GAsyncResult *res, PkPac
 		g_object_unref (package);
 	}
 
-	/* all okay */
-	state->ret = TRUE;
+	/* this chunk is done */
+	pk_package_sack_merge_chunk_done (state, details->len, NULL);
+}
 
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+/*
+ * pk_package_sack_get_details_chunk:
+ **/
+static void
+pk_package_sack_get_details_chunk (PkPackageSackState *state, gchar **package_ids)
+{
+	pk_client_get_details_async (state->sack->priv->client, package_ids,
+				     state->cancellable, state->progress_callback, state->progress_user_data,
+				     (GAsyncReadyCallback) pk_package_sack_get_details_cb, state);
 }
 
 /**
@@ -942,28 +1176,13 @@ pk_package_sack_get_details_async (PkPackageSack *sack, GCancellable *cancellabl
 				   PkProgressCallback progress_callback, gpointer progress_user_data,
 				   GAsyncReadyCallback callback, gpointer user_data)
 {
-	PkPackageSackState *state;
-	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
-
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
 
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_details_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start details async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_details_async (sack->priv->client, package_ids,
+	pk_package_sack_merge_start (sack, pk_package_sack_get_details_async,
+				     pk_package_sack_get_details_chunk, "no details found!",
 				     cancellable, progress_callback, progress_user_data,
-				     (GAsyncReadyCallback) pk_package_sack_get_details_cb, state);
+				     callback, user_data);
 }
 
 /***************************************************************************************************/
@@ -986,17 +1205,12 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 	results = pk_client_generic_finish (client, res, &error);
 	if (results == NULL) {
 		g_warning ("failed to update_detail: %s", error->message);
-		pk_package_sack_merge_bool_state_finish (state, error);
+		pk_package_sack_merge_chunk_done (state, 0, error);
 		return;
 	}
 
 	/* get the update_details */
 	update_details = pk_results_get_update_detail_array (results);
-	if (update_details->len == 0) {
-		error = g_error_new (1, 0, "no update details found!");
-		pk_package_sack_merge_bool_state_finish (state, error);
-		return;
-	}
 
 	/* set data on each item */
 	for (i = 0; i < update_details->len; i++) {
@@ -1053,11 +1267,19 @@ pk_package_sack_get_update_detail_cb (GObject *source_object, GAsyncResult *res,
 		g_object_unref (package);
 	}
 
-	/* all okay */
-	state->ret = TRUE;
+	/* this chunk is done */
+	pk_package_sack_merge_chunk_done (state, update_details->len, NULL);
+}
 
-	/* we're done */
-	pk_package_sack_merge_bool_state_finish (state, error);
+/*
+ * pk_package_sack_get_update_detail_chunk:
+ **/
+static void
+pk_package_sack_get_update_detail_chunk (PkPackageSackState *state, gchar **package_ids)
+{
+	pk_client_get_update_detail_async (state->sack->priv->client, package_ids,
+					   state->cancellable, state->progress_callback, state->progress_user_data,
+					   (GAsyncReadyCallback) pk_package_sack_get_update_detail_cb, state);
 }
 
 /**
@@ -1078,28 +1300,13 @@ pk_package_sack_get_update_detail_async (PkPackageSack *sack, GCancellable *canc
 					 PkProgressCallback progress_callback, gpointer progress_user_data,
 					 GAsyncReadyCallback callback, gpointer user_data)
 {
-	PkPackageSackState *state;
-	g_autoptr(GSimpleAsyncResult) res = NULL;
-	g_auto(GStrv) package_ids = NULL;
-
 	g_return_if_fail (PK_IS_PACKAGE_SACK (sack));
 	g_return_if_fail (callback != NULL);
 
-	res = g_simple_async_result_new (G_OBJECT (sack), callback, user_data, pk_package_sack_get_update_detail_async);
-
-	/* save state */
-	state = g_slice_new0 (PkPackageSackState);
-	state->res = g_object_ref (res);
-	state->sack = g_object_ref (sack);
-	if (cancellable != NULL)
-		state->cancellable = g_object_ref (cancellable);
-	state->ret = FALSE;
-
-	/* start update_detail async */
-	package_ids = pk_package_sack_get_package_ids (sack);
-	pk_client_get_update_detail_async (sack->priv->client, package_ids,
-					   cancellable, progress_callback, progress_user_data,
-					   (GAsyncReadyCallback) pk_package_sack_get_update_detail_cb, state);
+	pk_package_sack_merge_start (sack, pk_package_sack_get_update_detail_async,
+				     pk_package_sack_get_update_detail_chunk, "no update details found!",
+				     cancellable, progress_callback, progress_user_data,
+				     callback, user_data);
 }
 
 /***************************************************************************************************/
@@ -1141,9 +1348,14 @@ pk_package_sack_init (PkPackageSack *sack)
 	sack->priv = PK_PACKAGE_SACK_GET_PRIVATE (sack);
 	priv = sack->priv;
 
-	priv->table = g_hash_table_new (g_str_hash, g_str_equal);
+	priv->table = g_hash_table_new_full (g_str_hash, g_str_equal,
+					     NULL, (GDestroyNotify) g_ptr_array_unref);
+	priv->table_name_arch = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, (GDestroyNotify) g_ptr_array_unref);
 	priv->array = g_ptr_array_new_with_free_func (g_object_unref);
 	priv->client = pk_client_new ();
+	priv->chunk_size = PK_PACKAGE_SACK_CHUNK_SIZE;
+	priv->max_parallel = PK_PACKAGE_SACK_MAX_PARALLEL;
 }
 
 /*
@@ -1155,8 +1367,9 @@ pk_package_sack_finalize (GObject *object)
 	PkPackageSack *sack = PK_PACKAGE_SACK (object);
 	PkPackageSackPrivate *priv = sack->priv;
 
-	g_ptr_array_unref (priv->array);
 	g_hash_table_unref (priv->table);
+	g_hash_table_unref (priv->table_name_arch);
+	g_ptr_array_unref (priv->array);
 	g_object_unref (priv->client);
 
 	G_OBJECT_CLASS (pk_package_sack_parent_class)->finalize (object);
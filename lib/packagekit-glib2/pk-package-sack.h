@@ -139,6 +139,9 @@ PkPackageSack	*pk_package_sack_filter			(PkPackageSack		*sack,
 							 gpointer		 user_data);
 guint64		 pk_package_sack_get_total_bytes	(PkPackageSack		*sack);
 
+void		 pk_package_sack_set_merge_chunking	(PkPackageSack		*sack,
+							 guint			 chunk_size,
+							 guint			 max_parallel);
 gboolean	 pk_package_sack_merge_generic_finish	(PkPackageSack		*sack,
 							 GAsyncResult		*res,
 							 GError			**error);
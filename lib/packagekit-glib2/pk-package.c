@@ -38,6 +38,9 @@
 #include <packagekit-glib2/pk-enum-types.h>
 #include <packagekit-glib2/pk-package-id.h>
 
+#include "pk-package-id-private.h"
+#include "pk-source-private.h"
+
 static void     pk_package_finalize	(GObject     *object);
 
 #define PK_PACKAGE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PACKAGE, PkPackagePrivate))
@@ -50,9 +53,8 @@ static void     pk_package_finalize	(GObject     *object);
 struct _PkPackagePrivate
 {
 	PkInfoEnum		 info;
-	gchar			*package_id;
-	gchar			*package_id_data;
-	const gchar		*package_id_split[4];
+	const gchar		*package_id;		/* interned */
+	const gchar * const	*package_id_split;
 	gchar			*summary;
 	gchar			*license;
 	PkGroupEnum		 group;
@@ -124,7 +126,7 @@ pk_package_equal (PkPackage *package1, PkPackage *package2)
 	g_return_val_if_fail (PK_IS_PACKAGE (package1), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package2), FALSE);
 	return (g_strcmp0 (package1->priv->summary, package2->priv->summary) == 0 &&
-	        g_strcmp0 (package1->priv->package_id, package2->priv->package_id) == 0 &&
+	        package1->priv->package_id == package2->priv->package_id &&
 	        package1->priv->info == package2->priv->info);
 }
 
@@ -144,7 +146,8 @@ pk_package_equal_id (PkPackage *package1, PkPackage *package2)
 {
 	g_return_val_if_fail (PK_IS_PACKAGE (package1), FALSE);
 	g_return_val_if_fail (PK_IS_PACKAGE (package2), FALSE);
-	return (g_strcmp0 (package1->priv->package_id, package2->priv->package_id) == 0);
+	/* interned, so the same ID is the same pointer */
+	return package1->priv->package_id == package2->priv->package_id;
 }
 
 /**
@@ -163,44 +166,35 @@ gboolean
 pk_package_set_id (PkPackage *package, const gchar *package_id, GError **error)
 {
 	PkPackagePrivate *priv = package->priv;
-	gboolean ret;
+	const gchar *package_id_old = priv->package_id;
 	guint cnt = 0;
 	guint i;
 
 	g_return_val_if_fail (PK_IS_PACKAGE (package), FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	/* free old data */
-	g_free (priv->package_id);
-	g_free (priv->package_id_data);
-
-	/* copy the package-id into package_id_data, change the ';' into '\0'
-	 * and reference the pointers in the const gchar * array */
-	priv->package_id = g_strdup (package_id);
-	priv->package_id_data = g_strdup (package_id);
-	priv->package_id_split[0] = priv->package_id_data;
-	for (i = 0; priv->package_id_data[i] != '\0'; i++) {
-		if (package_id[i] == ';') {
-			if (++cnt > 3)
-				continue;
-			priv->package_id_split[cnt] = &priv->package_id_data[i+1];
-			priv->package_id_data[i] = '\0';
-		}
+	/* share the copy, and its sections, with every other package object
+	 * that has the same ID */
+	priv->package_id = pk_package_id_intern (package_id);
+	priv->package_id_split = pk_package_id_intern_get_sections (priv->package_id);
+	pk_package_id_unintern (package_id_old);
+
+	for (i = 0; package_id[i] != '\0'; i++) {
+		if (package_id[i] == ';')
+			cnt++;
 	}
 	if (cnt != 3) {
-		ret = FALSE;
 		g_set_error (error, 1, 0, "invalid number of sections %i", cnt);
-		goto out;
+		return FALSE;
 	}
 
 	/* name has to be valid */
-	ret = (priv->package_id_split[0][0] != '\0');
-	if (!ret) {
+	if (priv->package_id_split[0][0] == '\0') {
 		g_set_error_literal (error, 1, 0, "name invalid");
-		goto out;
+		return FALSE;
 	}
-out:
-	return ret;
+	return TRUE;
 }
 
 /**
@@ -833,11 +827,10 @@ pk_package_class_init (PkPackageClass *klass)
 static void
 pk_package_init (PkPackage *package)
 {
+	static const gchar * const package_id_split_unset[4] = { NULL, NULL, NULL, NULL };
+
 	package->priv = PK_PACKAGE_GET_PRIVATE (package);
-	package->priv->package_id_split[PK_PACKAGE_ID_NAME] = NULL;
-	package->priv->package_id_split[PK_PACKAGE_ID_VERSION] = NULL;
-	package->priv->package_id_split[PK_PACKAGE_ID_ARCH] = NULL;
-	package->priv->package_id_split[PK_PACKAGE_ID_DATA] = NULL;
+	package->priv->package_id_split = package_id_split_unset;
 }
 
 /*
@@ -850,7 +843,7 @@ pk_package_finalize (GObject *object)
 	PkPackage *package = PK_PACKAGE (object);
 	PkPackagePrivate *priv = package->priv;
 
-	g_free (priv->package_id);
+	pk_package_id_unintern (priv->package_id);
 	g_free (priv->summary);
 	g_free (priv->license);
 	g_free (priv->description);
@@ -864,7 +857,6 @@ pk_package_finalize (GObject *object)
 	g_free (priv->update_changelog);
 	g_free (priv->update_issued);
 	g_free (priv->update_updated);
-	g_free (priv->package_id_data);
 
 	G_OBJECT_CLASS (pk_package_parent_class)->finalize (object);
 }
@@ -884,6 +876,50 @@ pk_package_new (void)
 	return PK_PACKAGE (package);
 }
 
+/**
+ * pk_package_new_full:
+ * @info: the #PkInfoEnum
+ * @package_id: the valid package_id
+ * @summary: (nullable): the package summary
+ * @update_severity: a #PkInfoEnum, usually %PK_INFO_ENUM_UNKNOWN
+ * @role: the #PkRoleEnum of the transaction the package came from
+ * @transaction_id: (nullable): the transaction ID the package came from
+ * @error: a #GError to put the error code and message in, or %NULL
+ *
+ * Creates a package with all the commonly used fields set at once. This is
+ * much cheaper than setting each property with g_object_set() as no
+ * property notifications are emitted.
+ *
+ * Return value: (transfer full): a new #PkPackage object, or %NULL if the
+ * package_id was invalid
+ *
+ * Since: 1.2.5
+ **/
+PkPackage *
+pk_package_new_full (PkInfoEnum info,
+		     const gchar *package_id,
+		     const gchar *summary,
+		     PkInfoEnum update_severity,
+		     PkRoleEnum role,
+		     const gchar *transaction_id,
+		     GError **error)
+{
+	PkPackagePrivate *priv;
+	g_autoptr(PkPackage) package = NULL;
+
+	g_return_val_if_fail (package_id != NULL, NULL);
+
+	package = g_object_new (PK_TYPE_PACKAGE, NULL);
+	if (!pk_package_set_id (package, package_id, error))
+		return NULL;
+	priv = package->priv;
+	priv->info = info;
+	priv->summary = g_strdup (summary);
+	priv->update_severity = update_severity;
+	pk_source_set_origin (PK_SOURCE (package), role, transaction_id);
+	return g_steal_pointer (&package);
+}
+
 /**
  * pk_package_get_update_severity:
  * @package: a #PkPackage
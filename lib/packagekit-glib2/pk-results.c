@@ -65,7 +65,12 @@ struct _PkResultsPrivate
 	GPtrArray		*eula_required_array;
 	GPtrArray		*media_change_required_array;
 	GPtrArray		*repo_detail_array;
-	PkPackageSack		*package_sack;
+	PkPackageArray		*packages;
+	PkPackageSack		*package_sack;		/* created on demand */
+	gchar			*plan;
+	gchar			*cursor;
+	gboolean		 partial;
+	gboolean		 source_has_tid;
 };
 
 enum {
@@ -79,6 +84,25 @@ enum {
 
 G_DEFINE_TYPE (PkResults, pk_results, G_TYPE_OBJECT)
 
+/*
+ * pk_results_update_source:
+ *
+ * Gives the packages that are created from data the role and the
+ * transaction ID of the results, the ID may only be known once the
+ * first package arrives.
+ **/
+static void
+pk_results_update_source (PkResults *results)
+{
+	PkResultsPrivate *priv = results->priv;
+	const gchar *tid = NULL;
+
+	if (priv->progress != NULL)
+		tid = pk_progress_get_transaction_id (priv->progress);
+	pk_package_array_set_source (priv->packages, priv->role, tid);
+	priv->source_has_tid = tid != NULL;
+}
+
 /*
  * pk_results_get_property:
  **/
@@ -119,6 +143,7 @@ pk_results_set_property (GObject *object, guint prop_id, const GValue *value, GP
 	switch (prop_id) {
 	case PROP_ROLE:
 		priv->role = g_value_get_enum (value);
+		pk_results_update_source (results);
 		break;
 	case PROP_TRANSACTION_FLAGS:
 		priv->transaction_flags = g_value_get_uint64 (value);
@@ -130,6 +155,7 @@ pk_results_set_property (GObject *object, guint prop_id, const GValue *value, GP
 		if (priv->progress != NULL)
 			g_object_unref (priv->progress);
 		priv->progress = g_object_ref (g_value_get_object (value));
+		pk_results_update_source (results);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -155,6 +181,7 @@ pk_results_set_role (PkResults *results, PkRoleEnum role)
 	g_return_val_if_fail (role != PK_ROLE_ENUM_UNKNOWN, FALSE);
 
 	results->priv->role = role;
+	pk_results_update_source (results);
 
 	return TRUE;
 }
@@ -181,6 +208,58 @@ pk_results_set_exit_code (PkResults *results, PkExitEnum exit_enum)
 	return TRUE;
 }
 
+/**
+ * pk_results_set_plan:
+ * @results: a valid #PkResults instance
+ * @plan: (nullable): the plan token
+ *
+ * Sets the token of the plan the daemon kept for this simulation.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_results_set_plan (PkResults *results, const gchar *plan)
+{
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	g_free (results->priv->plan);
+	results->priv->plan = g_strdup (plan);
+}
+
+/**
+ * pk_results_set_cursor:
+ * @results: a valid #PkResults instance
+ * @cursor: (nullable): the cursor token
+ *
+ * Sets the token of the next page of a query sent with a limit.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_results_set_cursor (PkResults *results, const gchar *cursor)
+{
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	g_free (results->priv->cursor);
+	results->priv->cursor = g_strdup (cursor);
+}
+
+/**
+ * pk_results_set_partial:
+ * @results: a valid #PkResults instance
+ * @partial: if the backend left optional detail out
+ *
+ * Sets if the results were cut short to meet the deadline of the client.
+ *
+ * Since: 1.2.5
+ **/
+void
+pk_results_set_partial (PkResults *results, gboolean partial)
+{
+	g_return_if_fail (PK_IS_RESULTS (results));
+	results->priv->partial = partial;
+}
+
 /**
  * pk_results_add_package:
  * @results: a valid #PkResults instance
@@ -203,7 +282,55 @@ pk_results_add_package (PkResults *results, PkPackage *item)
 		g_warning ("Finished packages cannot be added to PkResults");
 		return FALSE;
 	}
-	pk_package_sack_add_package (results->priv->package_sack, item);
+	pk_package_array_add_package (results->priv->packages, item);
+	if (results->priv->package_sack != NULL)
+		pk_package_sack_add_package (results->priv->package_sack, item);
+	return TRUE;
+}
+
+/**
+ * pk_results_add_package_data:
+ * @results: a valid #PkResults instance
+ * @info: the #PkInfoEnum
+ * @package_id: the PackageID
+ * @summary: the package summary, or %NULL
+ * @update_severity: the #PkInfoEnum of the update
+ *
+ * Adds a package to the results set without creating a #PkPackage, which
+ * is much cheaper when only pk_results_get_packages_compact() is used.
+ *
+ * Return value: %TRUE if the value was set
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_results_add_package_data (PkResults *results,
+			     PkInfoEnum info,
+			     const gchar *package_id,
+			     const gchar *summary,
+			     PkInfoEnum update_severity)
+{
+	PkPackageArray *packages;
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
+
+	/* do not allow finished types */
+	if (info == PK_INFO_ENUM_FINISHED) {
+		g_warning ("Finished packages cannot be added to PkResults");
+		return FALSE;
+	}
+	if (!results->priv->source_has_tid && results->priv->progress != NULL &&
+	    pk_progress_get_transaction_id (results->priv->progress) != NULL)
+		pk_results_update_source (results);
+	packages = results->priv->packages;
+	if (!pk_package_array_add (packages, info, package_id, summary, update_severity))
+		return FALSE;
+	if (results->priv->package_sack != NULL) {
+		guint idx = pk_package_array_get_size (packages) - 1;
+		pk_package_sack_add_package (results->priv->package_sack,
+					     pk_package_array_get_package (packages, idx));
+	}
 	return TRUE;
 }
 
@@ -537,6 +664,63 @@ pk_results_get_transaction_flags (PkResults *results)
 	return results->priv->transaction_flags;
 }
 
+/**
+ * pk_results_get_plan:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the token of the plan the daemon kept when simulating. Passing it
+ * back with the "plan" hint when committing the same request lets the
+ * daemon skip solving it again.
+ *
+ * Return value: the plan token, or %NULL if no plan was kept
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+pk_results_get_plan (PkResults *results)
+{
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+	return results->priv->plan;
+}
+
+/**
+ * pk_results_get_cursor:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the token of the next page when the query was sent with
+ * pk_client_set_limit() and the daemon had more results than that.
+ * Pass it to pk_client_set_cursor() before asking for the same query again.
+ *
+ * Return value: the cursor token, or %NULL if this was the last page
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+pk_results_get_cursor (PkResults *results)
+{
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+	return results->priv->cursor;
+}
+
+/**
+ * pk_results_get_partial:
+ * @results: a valid #PkResults instance
+ *
+ * Gets if the backend left optional detail out of the results, such as
+ * the severity of updates, to meet the deadline set with
+ * pk_client_set_deadline(). Asking again without a deadline gets all of it.
+ *
+ * Return value: %TRUE if the results are partial
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+pk_results_get_partial (PkResults *results)
+{
+	g_return_val_if_fail (PK_IS_RESULTS (results), FALSE);
+	return results->priv->partial;
+}
+
 /**
  * pk_results_get_error_code:
  * @results: a valid #PkResults instance
@@ -577,8 +761,112 @@ pk_results_get_error_code (PkResults *results)
 GPtrArray *
 pk_results_get_package_array (PkResults *results)
 {
+	PkPackageArray *packages;
+	GPtrArray *array;
+	guint i;
+	guint len;
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+
+	/* the sack may have been changed by the caller */
+	if (results->priv->package_sack != NULL)
+		return pk_package_sack_get_array (results->priv->package_sack);
+
+	packages = results->priv->packages;
+	len = pk_package_array_get_size (packages);
+	array = g_ptr_array_new_full (len, (GDestroyNotify) g_object_unref);
+	for (i = 0; i < len; i++)
+		g_ptr_array_add (array, g_object_ref (pk_package_array_get_package (packages, i)));
+	return array;
+}
+
+/**
+ * pk_results_get_packages_compact:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the packages from the transaction without creating a #PkPackage
+ * for each one. Packages added to the sack returned by
+ * pk_results_get_package_sack() are not included.
+ *
+ * Return value: (transfer full): a #PkPackageArray, free with pk_package_array_unref()
+ *
+ * Since: 1.2.5
+ **/
+PkPackageArray *
+pk_results_get_packages_compact (PkResults *results)
+{
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+	return pk_package_array_ref (results->priv->packages);
+}
+
+/**
+ * pk_results_get_packages_variant:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the packages from the transaction as one #GVariant of type
+ * `a(uss)`, holding the #PkInfoEnum, the PackageID and the summary of
+ * each package. Language bindings can walk this without wrapping a
+ * #PkPackage for every item.
+ *
+ * Return value: (transfer full): a #GVariant, free with g_variant_unref()
+ *
+ * Since: 1.2.5
+ **/
+GVariant *
+pk_results_get_packages_variant (PkResults *results)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uss)"));
+
+	/* the sack may have been changed by the caller */
+	if (results->priv->package_sack != NULL) {
+		g_autoptr(GPtrArray) array = pk_package_sack_get_array (results->priv->package_sack);
+		for (i = 0; i < array->len; i++) {
+			PkPackage *item = g_ptr_array_index (array, i);
+			const gchar *summary = pk_package_get_summary (item);
+			g_variant_builder_add (&builder, "(uss)",
+					       pk_package_get_info (item),
+					       pk_package_get_id (item),
+					       summary != NULL ? summary : "");
+		}
+	} else {
+		PkPackageArray *packages = results->priv->packages;
+		for (i = 0; i < pk_package_array_get_size (packages); i++) {
+			const gchar *summary = pk_package_array_get_summary (packages, i);
+			g_variant_builder_add (&builder, "(uss)",
+					       pk_package_array_get_info (packages, i),
+					       pk_package_array_get_id (packages, i),
+					       summary != NULL ? summary : "");
+		}
+	}
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+/**
+ * pk_results_get_packages_bytes:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the packages like pk_results_get_packages_variant(), as the
+ * serialized `a(uss)` data, for callers that hand the results on
+ * without reading them, e.g. to another process.
+ *
+ * Return value: (transfer full): a #GBytes, free with g_bytes_unref()
+ *
+ * Since: 1.2.5
+ **/
+GBytes *
+pk_results_get_packages_bytes (PkResults *results)
+{
+	g_autoptr(GVariant) value = NULL;
+
 	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
-	return pk_package_sack_get_array (results->priv->package_sack);
+
+	value = pk_results_get_packages_variant (results);
+	return g_variant_get_data_as_bytes (value);
 }
 
 /**
@@ -594,8 +882,21 @@ pk_results_get_package_array (PkResults *results)
 PkPackageSack *
 pk_results_get_package_sack (PkResults *results)
 {
+	PkResultsPrivate *priv;
+	guint i;
+
 	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
-	return g_object_ref (results->priv->package_sack);
+
+	/* kept in sync from now on */
+	priv = results->priv;
+	if (priv->package_sack == NULL) {
+		priv->package_sack = pk_package_sack_new ();
+		for (i = 0; i < pk_package_array_get_size (priv->packages); i++) {
+			pk_package_sack_add_package (priv->package_sack,
+						     pk_package_array_get_package (priv->packages, i));
+		}
+	}
+	return g_object_ref (priv->package_sack);
 }
 
 /**
@@ -615,6 +916,69 @@ pk_results_get_details_array (PkResults *results)
 	return g_ptr_array_ref (results->priv->details_array);
 }
 
+/**
+ * pk_results_get_details_variant:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the package details from the transaction as one #GVariant of type
+ * `aa{sv}`, using the same keys as the Details D-Bus signal.
+ *
+ * Return value: (transfer full): a #GVariant, free with g_variant_unref()
+ *
+ * Since: 1.2.5
+ **/
+GVariant *
+pk_results_get_details_variant (PkResults *results)
+{
+	GVariantBuilder builder;
+	GPtrArray *array;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+
+	array = results->priv->details_array;
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+	for (i = 0; i < array->len; i++) {
+		PkDetails *item = g_ptr_array_index (array, i);
+		PkGroupEnum group = pk_details_get_group (item);
+		const gchar *tmp;
+		guint64 size;
+
+		g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+		g_variant_builder_add (&builder, "{sv}", "package-id",
+				       g_variant_new_string (pk_details_get_package_id (item)));
+		if (group != PK_GROUP_ENUM_UNKNOWN)
+			g_variant_builder_add (&builder, "{sv}", "group",
+					       g_variant_new_uint32 (group));
+		tmp = pk_details_get_summary (item);
+		if (tmp != NULL)
+			g_variant_builder_add (&builder, "{sv}", "summary",
+					       g_variant_new_string (tmp));
+		tmp = pk_details_get_description (item);
+		if (tmp != NULL)
+			g_variant_builder_add (&builder, "{sv}", "description",
+					       g_variant_new_string (tmp));
+		tmp = pk_details_get_url (item);
+		if (tmp != NULL)
+			g_variant_builder_add (&builder, "{sv}", "url",
+					       g_variant_new_string (tmp));
+		tmp = pk_details_get_license (item);
+		if (tmp != NULL)
+			g_variant_builder_add (&builder, "{sv}", "license",
+					       g_variant_new_string (tmp));
+		size = pk_details_get_size (item);
+		if (size != 0)
+			g_variant_builder_add (&builder, "{sv}", "size",
+					       g_variant_new_uint64 (size));
+		size = pk_details_get_download_size (item);
+		if (size != G_MAXUINT64)
+			g_variant_builder_add (&builder, "{sv}", "download-size",
+					       g_variant_new_uint64 (size));
+		g_variant_builder_close (&builder);
+	}
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
 /**
  * pk_results_get_update_detail_array:
  * @results: a valid #PkResults instance
@@ -757,6 +1121,41 @@ pk_results_get_files_array (PkResults *results)
 	return g_ptr_array_ref (results->priv->files_array);
 }
 
+/**
+ * pk_results_get_files_variant:
+ * @results: a valid #PkResults instance
+ *
+ * Gets the files from the transaction as one #GVariant of type `a(sas)`,
+ * holding the PackageID and the file list of each package.
+ *
+ * Return value: (transfer full): a #GVariant, free with g_variant_unref()
+ *
+ * Since: 1.2.5
+ **/
+GVariant *
+pk_results_get_files_variant (PkResults *results)
+{
+	GVariantBuilder builder;
+	GPtrArray *array;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_RESULTS (results), NULL);
+
+	array = results->priv->files_array;
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sas)"));
+	for (i = 0; i < array->len; i++) {
+		PkFiles *item = g_ptr_array_index (array, i);
+		const gchar *package_id = pk_files_get_package_id (item);
+		gchar **files = pk_files_get_files (item);
+		const gchar *empty[] = { NULL };
+
+		g_variant_builder_add (&builder, "(s^as)",
+				       package_id != NULL ? package_id : "",
+				       files != NULL ? files : (gchar **) empty);
+	}
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
 /**
  * pk_results_get_repo_signature_required_array:
  * @results: a valid #PkResults instance
@@ -897,7 +1296,7 @@ pk_results_init (PkResults *results)
 	results->priv->inputs = 0;
 	results->priv->progress = NULL;
 	results->priv->error_code = NULL;
-	results->priv->package_sack = pk_package_sack_new ();
+	results->priv->packages = pk_package_array_new ();
 	results->priv->details_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	results->priv->update_detail_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	results->priv->category_array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
@@ -931,7 +1330,11 @@ pk_results_finalize (GObject *object)
 	g_ptr_array_unref (priv->eula_required_array);
 	g_ptr_array_unref (priv->media_change_required_array);
 	g_ptr_array_unref (priv->repo_detail_array);
-	g_object_unref (priv->package_sack);
+	pk_package_array_unref (priv->packages);
+	g_free (priv->plan);
+	g_free (priv->cursor);
+	if (priv->package_sack != NULL)
+		g_object_unref (priv->package_sack);
 	if (results->priv->progress != NULL)
 		g_object_unref (results->priv->progress);
 	if (results->priv->error_code != NULL)
@@ -36,6 +36,7 @@
 #include <packagekit-glib2/pk-eula-required.h>
 #include <packagekit-glib2/pk-files.h>
 #include <packagekit-glib2/pk-media-change-required.h>
+#include <packagekit-glib2/pk-package-array.h>
 #include <packagekit-glib2/pk-package-sack.h>
 #include <packagekit-glib2/pk-repo-detail.h>
 #include <packagekit-glib2/pk-repo-signature-required.h>
@@ -88,10 +89,21 @@ gboolean	 pk_results_set_role	 		(PkResults		*results,
 							 PkRoleEnum		 role);
 gboolean	 pk_results_set_error_code 		(PkResults		*results,
 							 PkError		*item);
+void		 pk_results_set_plan			(PkResults		*results,
+							 const gchar		*plan);
+void		 pk_results_set_cursor			(PkResults		*results,
+							 const gchar		*cursor);
+void		 pk_results_set_partial			(PkResults		*results,
+							 gboolean		 partial);
 
 /* add */
 gboolean	 pk_results_add_package			(PkResults		*results,
 							 PkPackage		*item);
+gboolean	 pk_results_add_package_data		(PkResults		*results,
+							 PkInfoEnum		 info,
+							 const gchar		*package_id,
+							 const gchar		*summary,
+							 PkInfoEnum		 update_severity);
 gboolean	 pk_results_add_details			(PkResults		*results,
 							 PkDetails		*item);
 gboolean	 pk_results_add_update_detail		(PkResults		*results,
@@ -122,9 +134,17 @@ PkError		*pk_results_get_error_code		(PkResults		*results);
 PkRoleEnum	 pk_results_get_role			(PkResults		*results);
 PkBitfield	 pk_results_get_transaction_flags	(PkResults		*results);
 PkRestartEnum	 pk_results_get_require_restart_worst	(PkResults		*results);
+const gchar	*pk_results_get_plan			(PkResults		*results);
+const gchar	*pk_results_get_cursor			(PkResults		*results);
+gboolean	 pk_results_get_partial			(PkResults		*results);
 
 /* get array objects */
 GPtrArray	*pk_results_get_package_array		(PkResults		*results);
+PkPackageArray	*pk_results_get_packages_compact	(PkResults		*results);
+GVariant	*pk_results_get_packages_variant	(PkResults		*results);
+GBytes		*pk_results_get_packages_bytes		(PkResults		*results);
+GVariant	*pk_results_get_details_variant		(PkResults		*results);
+GVariant	*pk_results_get_files_variant		(PkResults		*results);
 GPtrArray	*pk_results_get_details_array		(PkResults		*results);
 GPtrArray	*pk_results_get_update_detail_array	(PkResults		*results);
 GPtrArray	*pk_results_get_category_array		(PkResults		*results);
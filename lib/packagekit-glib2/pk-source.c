@@ -35,6 +35,8 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-enum-types.h>
 
+#include "pk-source-private.h"
+
 static void     pk_source_finalize	(GObject     *object);
 
 #define PK_SOURCE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SOURCE, PkSourcePrivate))
@@ -104,6 +106,24 @@ pk_source_set_property (GObject *object, guint prop_id, const GValue *value, GPa
 	}
 }
 
+/*
+ * pk_source_set_origin:
+ *
+ * Sets the role and transaction ID without any property notification,
+ * for objects that are being constructed.
+ **/
+void
+pk_source_set_origin (PkSource *source, PkRoleEnum role, const gchar *transaction_id)
+{
+	PkSourcePrivate *priv = source->priv;
+
+	priv->role = role;
+	if (g_strcmp0 (priv->transaction_id, transaction_id) != 0) {
+		g_free (priv->transaction_id);
+		priv->transaction_id = g_strdup (transaction_id);
+	}
+}
+
 /*
  * pk_source_class_init:
  **/
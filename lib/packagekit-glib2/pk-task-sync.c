@@ -28,6 +28,7 @@
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-task.h>
 #include <packagekit-glib2/pk-progress.h>
+#include <packagekit-glib2/pk-common-private.h>
 
 #include "pk-task-sync.h"
 
@@ -89,7 +90,7 @@ pk_task_remove_packages_sync (PkTask *task, gchar **package_ids, gboolean allow_
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -142,7 +143,7 @@ pk_task_install_packages_sync (PkTask *task, gchar **package_ids, GCancellable *
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -195,7 +196,7 @@ pk_task_update_packages_sync (PkTask *task, gchar **package_ids, GCancellable *c
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -249,7 +250,7 @@ pk_task_install_files_sync (PkTask *task, gchar **files, GCancellable *cancellab
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -301,7 +302,7 @@ pk_task_resolve_sync (PkTask *task, PkBitfield filters, gchar **packages, GCance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -353,7 +354,7 @@ pk_task_search_names_sync (PkTask *task, PkBitfield filters, gchar **values, GCa
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -405,7 +406,7 @@ pk_task_search_details_sync (PkTask *task, PkBitfield filters, gchar **values, G
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -457,7 +458,7 @@ pk_task_search_groups_sync (PkTask *task, PkBitfield filters, gchar **values, GC
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -509,7 +510,7 @@ pk_task_search_files_sync (PkTask *task, PkBitfield filters, gchar **values, GCa
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -560,7 +561,7 @@ pk_task_get_details_sync (PkTask *task, gchar **package_ids, GCancellable *cance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -611,7 +612,7 @@ pk_task_get_update_detail_sync (PkTask *task, gchar **package_ids, GCancellable
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -663,7 +664,7 @@ pk_task_download_packages_sync (PkTask *task, gchar **package_ids, const gchar *
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -714,7 +715,7 @@ pk_task_get_updates_sync (PkTask *task, PkBitfield filters, GCancellable *cancel
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -767,7 +768,7 @@ pk_task_depends_on_sync (PkTask *task, PkBitfield filters, gchar **package_ids,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -818,7 +819,7 @@ pk_task_get_packages_sync (PkTask *task, PkBitfield filters, GCancellable *cance
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -871,7 +872,7 @@ pk_task_required_by_sync (PkTask *task, PkBitfield filters, gchar **package_ids,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -924,7 +925,7 @@ pk_task_what_provides_sync (PkTask *task, PkBitfield filters,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -975,7 +976,7 @@ pk_task_get_files_sync (PkTask *task, gchar **package_ids, GCancellable *cancell
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1025,7 +1026,7 @@ pk_task_get_categories_sync (PkTask *task, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1076,7 +1077,7 @@ pk_task_refresh_cache_sync (PkTask *task, gboolean force, GCancellable *cancella
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1127,7 +1128,7 @@ pk_task_get_repo_list_sync (PkTask *task, PkBitfield filters, GCancellable *canc
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1179,7 +1180,7 @@ pk_task_repo_enable_sync (PkTask *task, const gchar *repo_id, gboolean enabled,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1237,7 +1238,7 @@ pk_task_upgrade_system_sync (PkTask *task,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
@@ -1291,7 +1292,7 @@ pk_task_repair_system_sync (PkTask *task, GCancellable *cancellable,
 
 	/* create temp object */
 	memset (&helper, 0, sizeof (PkTaskHelper));
-	helper.context = g_main_context_new ();
+	helper.context = pk_sync_context_get ();
 	helper.loop = g_main_loop_new (helper.context, FALSE);
 	helper.error = error;
 
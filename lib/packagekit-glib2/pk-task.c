@@ -34,6 +34,8 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
 
+#include "pk-client-private.h"
+
 static void     pk_task_finalize	(GObject     *object);
 
 #define PK_TASK_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_TASK, PkTaskPrivate))
@@ -102,6 +104,7 @@ typedef struct {
 	PkBitfield			 filters;
 	PkUpgradeKindEnum		 upgrade_kind;
 	guint				 retry_id;
+	gchar				*plan;
 } PkTaskState;
 
 G_DEFINE_TYPE (PkTask, pk_task, PK_TYPE_CLIENT)
@@ -175,6 +178,7 @@ pk_task_generic_state_finish (PkTaskState *state, const GError *error)
 	g_free (state->distro_id);
 	g_free (state->repo_id);
 	g_free (state->transaction_id);
+	g_free (state->plan);
 	g_strfreev (state->files);
 	g_strfreev (state->package_ids);
 	g_strfreev (state->packages);
@@ -210,6 +214,13 @@ pk_task_do_async_action (PkTaskState *state)
 				PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE);
 	}
 
+	/* commit what the simulation solved, the daemon checks it still fits */
+	if (state->plan != NULL &&
+	    (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	     state->role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
+	     state->role == PK_ROLE_ENUM_REMOVE_PACKAGES))
+		pk_client_set_plan (PK_CLIENT (state->task), state->plan);
+
 	/* do the correct action */
 	if (state->role == PK_ROLE_ENUM_INSTALL_PACKAGES) {
 		pk_client_install_packages_async (PK_CLIENT(state->task), transaction_flags, state->package_ids,
@@ -372,6 +383,8 @@ pk_task_simulate_ready_cb (GObject *source_object, GAsyncResult *res, PkTaskStat
 
 	/* we own a copy now */
 	state->results = g_object_ref (results);
+	g_free (state->plan);
+	state->plan = g_strdup (pk_results_get_plan (results));
 
 	/* get exit code */
 	state->exit_enum = pk_results_get_exit_code (state->results);
@@ -1011,6 +1011,100 @@ pk_test_package_sack_filter_cb (PkPackage *package, gpointer user_data)
 	return TRUE;
 }
 
+static void
+pk_test_client_batch_func (void)
+{
+	GPtrArray *packages;
+	GPtrArray *results;
+	PkResults *tmp;
+	guint idx_glib;
+	guint idx_both;
+	guint idx_missing;
+	guint idx_details;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkClient) client = NULL;
+	g_autoptr(PkClientBatch) batch = NULL;
+	g_auto(GStrv) details_ids = NULL;
+	g_auto(GStrv) names_both = NULL;
+	g_auto(GStrv) names_glib = NULL;
+	g_auto(GStrv) names_missing = NULL;
+
+	client = pk_client_new ();
+	batch = pk_client_batch_new (client);
+
+	/* the three resolves share one transaction */
+	names_glib = g_strsplit ("glib2", ",", -1);
+	names_both = g_strsplit ("glib2,powertop", ",", -1);
+	names_missing = g_strsplit ("dave", ",", -1);
+	details_ids = pk_package_ids_from_id ("powertop;1.8-1.fc8;i386;fedora");
+	idx_glib = pk_client_batch_add_resolve (batch, pk_bitfield_value (PK_FILTER_ENUM_NONE), names_glib);
+	idx_both = pk_client_batch_add_resolve (batch, pk_bitfield_value (PK_FILTER_ENUM_NONE), names_both);
+	idx_missing = pk_client_batch_add_resolve (batch, pk_bitfield_value (PK_FILTER_ENUM_NONE), names_missing);
+	idx_details = pk_client_batch_add_get_details (batch, details_ids);
+	g_assert_cmpint (pk_client_batch_get_size (batch), ==, 4);
+
+	results = pk_client_batch_run (batch, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (results != NULL);
+	g_assert_cmpint (results->len, ==, 4);
+
+	/* each query only gets what it asked for */
+	tmp = g_ptr_array_index (results, idx_glib);
+	g_assert_cmpint (pk_results_get_exit_code (tmp), ==, PK_EXIT_ENUM_SUCCESS);
+	packages = pk_results_get_package_array (tmp);
+	g_assert_cmpint (packages->len, ==, 1);
+	g_assert_cmpstr (pk_package_get_name (g_ptr_array_index (packages, 0)), ==, "glib2");
+	g_ptr_array_unref (packages);
+	tmp = g_ptr_array_index (results, idx_both);
+	packages = pk_results_get_package_array (tmp);
+	g_assert_cmpint (packages->len, ==, 2);
+	g_ptr_array_unref (packages);
+	tmp = g_ptr_array_index (results, idx_missing);
+	packages = pk_results_get_package_array (tmp);
+	g_assert_cmpint (packages->len, ==, 0);
+	g_ptr_array_unref (packages);
+	tmp = g_ptr_array_index (results, idx_details);
+	packages = pk_results_get_details_array (tmp);
+	g_assert_cmpint (packages->len, ==, 1);
+	g_ptr_array_unref (packages);
+	g_ptr_array_unref (results);
+}
+
+static void
+pk_test_client_stream_item_cb (PkClient *client, PkSource *item, gpointer user_data)
+{
+	guint *count = (guint *) user_data;
+	g_assert (PK_IS_PACKAGE (item));
+	(*count)++;
+}
+
+static void
+pk_test_client_stream_func (void)
+{
+	guint count = 0;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(PkClient) client = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_auto(GStrv) names = NULL;
+
+	client = pk_client_new ();
+	pk_client_set_results_mode (client, PK_CLIENT_RESULTS_MODE_STREAM);
+	pk_client_set_item_callback (client, pk_test_client_stream_item_cb, &count, NULL);
+	g_assert_cmpint (pk_client_get_results_mode (client), ==, PK_CLIENT_RESULTS_MODE_STREAM);
+
+	/* the packages go to the callback and are not kept */
+	names = g_strsplit ("glib2,powertop", ",", -1);
+	results = pk_client_resolve (client, pk_bitfield_value (PK_FILTER_ENUM_NONE),
+				     names, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (results != NULL);
+	g_assert_cmpint (pk_results_get_exit_code (results), ==, PK_EXIT_ENUM_SUCCESS);
+	g_assert_cmpint (count, ==, 2);
+	packages = pk_results_get_package_array (results);
+	g_assert_cmpint (packages->len, ==, 0);
+}
+
 static void
 pk_test_package_sack_func (void)
 {
@@ -1130,6 +1224,36 @@ pk_test_package_sack_func (void)
 	size = pk_package_sack_get_size (sack);
 	g_assert_cmpint (size, ==, 0);
 
+	/* the indexes follow duplicates being removed */
+	pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", NULL);
+	pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", NULL);
+	ret = pk_package_sack_remove_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (ret);
+	package = pk_package_sack_find_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package != NULL);
+	g_object_unref (package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "powertop;1.9-1.fc9;i386;updates");
+	g_assert (package != NULL);
+	g_object_unref (package);
+	package = pk_package_sack_find_by_id_name_arch (sack, "powertop;1.8-1.fc8;x86_64;fedora");
+	g_assert (package == NULL);
+	pk_package_sack_clear (sack);
+	package = pk_package_sack_find_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package == NULL);
+
+	/* the latest of the duplicates is found */
+	for (guint i = 0; i < 2; i++) {
+		g_autoptr(PkPackage) item = pk_package_new ();
+		ret = pk_package_set_id (item, "powertop;1.8-1.fc8;i386;fedora", NULL);
+		g_assert (ret);
+		pk_package_set_summary (item, i == 0 ? "first" : "latest");
+		pk_package_sack_add_package (sack, item);
+	}
+	package = pk_package_sack_find_by_id (sack, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (package != NULL);
+	g_assert_cmpstr (pk_package_get_summary (package), ==, "latest");
+	g_object_unref (package);
+
 	g_object_unref (sack);
 }
 
@@ -1438,6 +1562,8 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/transaction-list", pk_test_transaction_list_func);
 	g_test_add_func ("/packagekit-glib2/client-helper", pk_test_client_helper_func);
 	g_test_add_func ("/packagekit-glib2/client", pk_test_client_func);
+	g_test_add_func ("/packagekit-glib2/client-batch", pk_test_client_batch_func);
+	g_test_add_func ("/packagekit-glib2/client-stream", pk_test_client_stream_func);
 	g_test_add_func ("/packagekit-glib2/package-sack", pk_test_package_sack_func);
 	g_test_add_func ("/packagekit-glib2/task", pk_test_task_func);
 	g_test_add_func ("/packagekit-glib2/task-wrapper", pk_test_task_wrapper_func);
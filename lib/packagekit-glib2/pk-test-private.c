@@ -22,9 +22,14 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
 
+#include "pk-command-index-private.h"
+#include "pk-name-list-private.h"
 #include "pk-common.h"
+#include "pk-common-private.h"
 #include "pk-debug.h"
+#include "pk-details-cache-private.h"
 #include "pk-enum.h"
 #include "pk-offline.h"
 #include "pk-offline-private.h"
@@ -199,6 +204,33 @@ pk_test_common_func (void)
 	g_date_free (date);
 }
 
+static gpointer
+pk_test_sync_context_thread_cb (gpointer user_data)
+{
+	return pk_sync_context_get ();
+}
+
+static void
+pk_test_sync_context_func (void)
+{
+	GThread *thread;
+	g_autoptr(GMainContext) context1 = NULL;
+	g_autoptr(GMainContext) context2 = NULL;
+	g_autoptr(GMainContext) context_thread = NULL;
+
+	/* reused within a thread */
+	context1 = pk_sync_context_get ();
+	context2 = pk_sync_context_get ();
+	g_assert (context1 == context2);
+	g_assert (context1 != g_main_context_default ());
+
+	/* but not shared between threads */
+	thread = g_thread_new ("pk-test-sync-context", pk_test_sync_context_thread_cb, NULL);
+	context_thread = g_thread_join (thread);
+	g_assert (context_thread != NULL);
+	g_assert (context_thread != context1);
+}
+
 static void
 pk_test_enum_func (void)
 {
@@ -214,6 +246,17 @@ pk_test_enum_func (void)
 	string = pk_role_enum_to_string (PK_ROLE_ENUM_SEARCH_FILE);
 	g_assert_cmpstr (string, ==, "search-file");
 
+	/* unknown and out of range fall back to the first entry */
+	g_assert_cmpint (pk_role_enum_from_string ("dave"), ==, PK_ROLE_ENUM_UNKNOWN);
+	g_assert_cmpint (pk_role_enum_from_string (NULL), ==, PK_ROLE_ENUM_UNKNOWN);
+	g_assert_cmpstr (pk_role_enum_to_string (PK_ROLE_ENUM_LAST + 100), ==, "unknown");
+
+	/* check the conversions round trip */
+	for (i = 0; i < PK_INFO_ENUM_LAST; i++) {
+		string = pk_info_enum_to_string (i);
+		g_assert_cmpint (pk_info_enum_from_string (string), ==, i);
+	}
+
 	/* check we convert all the role bitfield */
 	for (i = 1; i < PK_ROLE_ENUM_LAST; i++) {
 		string = pk_role_enum_to_string (i);
@@ -331,6 +374,8 @@ pk_test_package_id_func (void)
 	gboolean ret;
 	gchar *text;
 	gchar **sections;
+	const gchar *interned;
+	PkPackageIdParts parts;
 
 	/* check not valid - NULL */
 	ret = pk_package_id_check (NULL);
@@ -402,6 +447,33 @@ pk_test_package_id_func (void)
 	/* test fail missing first */
 	sections = pk_package_id_split (";0.1.2;i386;data");
 	g_assert (sections == NULL);
+
+	/* split without allocating */
+	ret = pk_package_id_split_parts ("kde-i18n-csb;4:3.5.8~pre20071001-0ubuntu1;all;", &parts);
+	g_assert (ret);
+	g_assert_cmpint (parts.offsets[PK_PACKAGE_ID_VERSION], ==, 13);
+	g_assert_cmpint (parts.lengths[PK_PACKAGE_ID_VERSION], ==, 28);
+	g_assert_cmpint (parts.offsets[PK_PACKAGE_ID_ARCH], ==, 42);
+	g_assert_cmpint (parts.lengths[PK_PACKAGE_ID_ARCH], ==, 3);
+	g_assert_cmpint (parts.lengths[PK_PACKAGE_ID_DATA], ==, 0);
+	g_assert (!pk_package_id_split_parts ("foo;moo", &parts));
+	g_assert (!pk_package_id_split_parts ("foo;moo;dave;clive;dan", &parts));
+	g_assert (!pk_package_id_split_parts (";0.1.2;i386;data", &parts));
+
+	/* fuzzy arch */
+	g_assert (pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.1;i686;updates"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.1;x86_64;fedora"));
+	g_assert (!pk_package_id_equal_fuzzy_arch ("moo;0.1;i386;fedora", "moo;0.2;i386;fedora"));
+
+	/* interned IDs are shared */
+	text = g_strdup ("moo;0.0.1;i386;fedora");
+	interned = pk_package_id_intern (text);
+	g_assert (interned != text);
+	g_assert_cmpstr (interned, ==, text);
+	g_assert (pk_package_id_intern ("moo;0.0.1;i386;fedora") == interned);
+	pk_package_id_unintern (interned);
+	pk_package_id_unintern (interned);
+	g_free (text);
 }
 
 static void
@@ -410,6 +482,7 @@ pk_test_package_ids_func (void)
 	gboolean ret;
 	gchar *package_ids_blank[] = {NULL};
 	gchar **package_ids;
+	PkPackageIdParts *parts = NULL;
 
 	/* parse va_list */
 	package_ids = pk_package_ids_from_string ("foo;0.0.1;i386;fedora&bar;0.1.1;noarch;livna");
@@ -426,6 +499,18 @@ pk_test_package_ids_func (void)
 	ret = pk_package_ids_check (package_ids);
 	g_assert (ret);
 
+	/* verify and keep the sections */
+	ret = pk_package_ids_check_parts (package_ids, &parts);
+	g_assert (ret);
+	g_assert_cmpint (parts[1].offsets[PK_PACKAGE_ID_ARCH], ==, 10);
+	g_assert_cmpint (parts[1].lengths[PK_PACKAGE_ID_ARCH], ==, 6);
+	g_free (parts);
+
+	/* invalid UTF-8 in a later section */
+	g_free (package_ids[1]);
+	package_ids[1] = g_strdup ("bar;0.1.1;noarch;\xff");
+	g_assert (!pk_package_ids_check_parts (package_ids, NULL));
+
 	g_strfreev (package_ids);
 }
 
@@ -457,6 +542,7 @@ pk_test_results_func (void)
 	gboolean ret;
 	PkResults *results;
 	PkExitEnum exit_enum;
+	PkPackageArray *compact;
 	GPtrArray *packages;
 	PkPackage *item;
 	PkInfoEnum info;
@@ -532,9 +618,97 @@ pk_test_results_func (void)
 	g_free (package_id);
 	g_free (summary);
 
+	/* add without an object */
+	ret = pk_results_add_package_data (results, PK_INFO_ENUM_INSTALLED,
+					   "gnome-power-manager;0.1.1;i386;installed",
+					   "Power manager for GNOME",
+					   PK_INFO_ENUM_UNKNOWN);
+	g_assert (ret);
+	ret = pk_results_add_package_data (results, PK_INFO_ENUM_INSTALLED,
+					   "gnome-power-manager;0.1.1", NULL,
+					   PK_INFO_ENUM_UNKNOWN);
+	g_assert (!ret);
+
+	/* the compact form */
+	compact = pk_results_get_packages_compact (results);
+	g_assert_cmpint (pk_package_array_get_size (compact), ==, 2);
+	g_assert_cmpint (pk_package_array_get_info (compact, 1), ==, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpstr (pk_package_array_get_id (compact, 1), ==, "gnome-power-manager;0.1.1;i386;installed");
+	g_assert (pk_package_array_get_summary (compact, 0) == pk_package_array_get_summary (compact, 1));
+
+	/* only created when asked for, then kept */
+	item = pk_package_array_get_package (compact, 1);
+	g_assert_cmpstr (pk_package_get_version (item), ==, "0.1.1");
+	g_assert (pk_package_array_get_package (compact, 1) == item);
+	packages = pk_results_get_package_array (results);
+	g_assert_cmpint (packages->len, ==, 2);
+	g_assert (g_ptr_array_index (packages, 1) == item);
+	g_ptr_array_unref (packages);
+	pk_package_array_unref (compact);
+
+	/* in bulk, for bindings */
+	{
+		g_autoptr(GVariant) value = NULL;
+		g_autoptr(GBytes) bytes = NULL;
+		const gchar *tmp;
+		guint32 info_tmp;
+
+		value = pk_results_get_packages_variant (results);
+		g_assert_cmpint (g_variant_n_children (value), ==, 2);
+		g_variant_get_child (value, 1, "(u&s&s)", &info_tmp, &tmp, NULL);
+		g_assert_cmpint (info_tmp, ==, PK_INFO_ENUM_INSTALLED);
+		g_assert_cmpstr (tmp, ==, "gnome-power-manager;0.1.1;i386;installed");
+		bytes = pk_results_get_packages_bytes (results);
+		g_assert_cmpint (g_bytes_get_size (bytes), ==, g_variant_get_size (value));
+	}
+
 	g_object_unref (results);
 }
 
+static void
+pk_test_package_sack_file_func (void)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(PkPackage) package = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkPackageSack) sack_new = NULL;
+	g_autofree gchar *filename = NULL;
+
+	sack = pk_package_sack_new ();
+	ret = pk_package_sack_add_package_by_id (sack, "powertop;1.8-1.fc8;i386;fedora", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = pk_package_sack_add_package_by_id (sack, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* round trip */
+	filename = g_build_filename (g_get_tmp_dir (), "pk-self-test-sack.txt", NULL);
+	file = g_file_new_for_path (filename);
+	ret = pk_package_sack_to_file (sack, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	sack_new = pk_package_sack_new ();
+	ret = pk_package_sack_add_packages_from_file (sack_new, file, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (pk_package_sack_get_size (sack_new), ==, 2);
+	package = pk_package_sack_find_by_id (sack_new, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed");
+	g_assert (package != NULL);
+
+	/* invalid lines are rejected */
+	ret = g_file_set_contents (filename, "available\tpowertop;1.8-1.fc8;i386;fedora\n"
+				   "available\tpowertop\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = pk_package_sack_add_packages_from_file (sack_new, file, &error);
+	g_assert_error (error, 1, 0);
+	g_assert (!ret);
+	g_unlink (filename);
+}
+
 static void
 pk_test_package_func (void)
 {
@@ -596,6 +770,30 @@ pk_test_package_func (void)
 	g_free (text);
 
 	g_object_unref (package);
+
+	/* create with everything set at once */
+	package = pk_package_new_full (PK_INFO_ENUM_INSTALLED,
+				       "gnome-power-manager;0.1.2;i386;fedora",
+				       "Power manager", PK_INFO_ENUM_LOW,
+				       PK_ROLE_ENUM_RESOLVE, "/1_abc", &error);
+	g_assert_no_error (error);
+	g_assert (package != NULL);
+	g_assert_cmpint (pk_package_get_info (package), ==, PK_INFO_ENUM_INSTALLED);
+	g_assert_cmpstr (pk_package_get_name (package), ==, "gnome-power-manager");
+	g_assert_cmpstr (pk_package_get_summary (package), ==, "Power manager");
+	g_assert_cmpint (pk_package_get_update_severity (package), ==, PK_INFO_ENUM_LOW);
+	g_object_get (package, "transaction-id", &text, NULL);
+	g_assert_cmpstr (text, ==, "/1_abc");
+	g_free (text);
+	g_object_unref (package);
+
+	/* invalid id */
+	package = pk_package_new_full (PK_INFO_ENUM_INSTALLED, "gnome-power-manager",
+				       NULL, PK_INFO_ENUM_UNKNOWN,
+				       PK_ROLE_ENUM_UNKNOWN, NULL, &error);
+	g_assert_error (error, 1, 0);
+	g_assert (package == NULL);
+	g_clear_error (&error);
 }
 
 static void
@@ -608,6 +806,8 @@ pk_test_offline_func (void)
 	guint64 mtime;
 	PkOfflineAction action;
 	PkPackage *pkg;
+	g_autofree gchar *fingerprint = NULL;
+	g_autofree gchar *fingerprint_now = NULL;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GFileMonitor) monitor = NULL;
 	g_autoptr(PkError) pk_error = NULL;
@@ -688,6 +888,19 @@ pk_test_offline_func (void)
 	g_assert (sack != NULL);
 	g_assert_cmpint (pk_package_sack_get_size (sack), ==, 1);
 
+	/* the fingerprint changes when the package database is written to */
+	g_assert_cmpint (g_mkdir_with_parents ("/tmp/PackageKit-self-test/var/lib/dpkg", 0755), ==, 0);
+	ret = g_file_set_contents ("/tmp/PackageKit-self-test/var/lib/dpkg/status", "Package: powertop\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	fingerprint = pk_offline_get_package_db_fingerprint ();
+	g_assert (fingerprint != NULL);
+	ret = g_file_set_contents ("/tmp/PackageKit-self-test/var/lib/dpkg/status", "Package: powertop\nPackage: zif\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	fingerprint_now = pk_offline_get_package_db_fingerprint ();
+	g_assert_cmpstr (fingerprint_now, !=, fingerprint);
+
 	/* check monitor */
 	monitor = pk_offline_get_prepared_monitor (NULL, &error);
 	g_assert_no_error (error);
@@ -909,6 +1122,227 @@ pk_test_offline_upgrade_func (void)
 	g_assert (!g_file_test (PK_OFFLINE_RESULTS_FILENAME, G_FILE_TEST_EXISTS));
 }
 
+static void
+pk_test_details_cache_func (void)
+{
+	const gchar *filename = "/tmp/PackageKit-self-test/details-cache";
+	gchar *cve_urls[] = { "CVE-2026-0001", NULL };
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkDetails) details = NULL;
+	g_autoptr(PkDetails) details_cached = NULL;
+	g_autoptr(PkDetailsCache) cache = NULL;
+	g_autoptr(PkDetailsCache) cache_loaded = NULL;
+	g_autoptr(PkUpdateDetail) update_detail = NULL;
+	g_autoptr(PkUpdateDetail) update_detail_cached = NULL;
+
+	g_unlink (filename);
+	cache = pk_details_cache_new (filename);
+	details = pk_details_new ();
+	g_object_set (details,
+		      "package-id", "powertop;1.8-1.fc8;i386;fedora",
+		      "summary", "Power consumption monitor",
+		      "group", PK_GROUP_ENUM_SYSTEM,
+		      "size", (guint64) 12345,
+		      NULL);
+	pk_details_cache_add_details (cache, 10, 20, details);
+	update_detail = pk_update_detail_new ();
+	g_object_set (update_detail,
+		      "package-id", "powertop;1.8-1.fc8;i386;fedora",
+		      "cve-urls", cve_urls,
+		      "restart", PK_RESTART_ENUM_SYSTEM,
+		      NULL);
+	pk_details_cache_add_update_detail (cache, 10, 20, update_detail);
+	ret = pk_details_cache_save (cache, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* another process at the same epochs */
+	cache_loaded = pk_details_cache_new (filename);
+	details_cached = pk_details_cache_lookup_details (cache_loaded, 10, 20,
+							 "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (details_cached != NULL);
+	g_assert_cmpstr (pk_details_get_summary (details_cached), ==, "Power consumption monitor");
+	g_assert_cmpstr (pk_details_get_license (details_cached), ==, NULL);
+	g_assert_cmpint (pk_details_get_group (details_cached), ==, PK_GROUP_ENUM_SYSTEM);
+	g_assert_cmpuint (pk_details_get_size (details_cached), ==, 12345);
+	update_detail_cached = pk_details_cache_lookup_update_detail (cache_loaded, 10, 20,
+								      "powertop;1.8-1.fc8;i386;fedora");
+	g_assert (update_detail_cached != NULL);
+	g_assert_cmpstr (pk_update_detail_get_cve_urls (update_detail_cached)[0], ==, "CVE-2026-0001");
+	g_assert (pk_update_detail_get_updates (update_detail_cached) == NULL);
+	g_assert_cmpint (pk_update_detail_get_restart (update_detail_cached), ==, PK_RESTART_ENUM_SYSTEM);
+	g_assert (pk_details_cache_lookup_details (cache_loaded, 10, 20, "kernel;1;i386;fedora") == NULL);
+
+	/* an older lookup racing with the newer results */
+	g_assert (pk_details_cache_lookup_details (cache_loaded, 9, 20,
+						   "powertop;1.8-1.fc8;i386;fedora") == NULL);
+
+	/* the repositories changed */
+	g_assert (pk_details_cache_lookup_details (cache_loaded, 10, 21,
+						   "powertop;1.8-1.fc8;i386;fedora") == NULL);
+	g_assert (pk_details_cache_lookup_details (cache_loaded, 10, 20,
+						   "powertop;1.8-1.fc8;i386;fedora") == NULL);
+}
+
+static void
+pk_test_command_index_func (void)
+{
+	const gchar *filename = "/tmp/PackageKit-self-test/command-index";
+	gboolean ret;
+	GPtrArray *package_ids;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) commands = NULL;
+	g_autoptr(PkCommandIndex) index = NULL;
+	g_auto(GStrv) found = NULL;
+
+	/* only commands in the bin directories */
+	g_assert_cmpstr (pk_command_index_get_command ("/usr/bin/powertop"), ==, "powertop");
+	g_assert_cmpstr (pk_command_index_get_command ("/sbin/ip"), ==, "ip");
+	g_assert_cmpstr (pk_command_index_get_command ("/usr/bin/"), ==, NULL);
+	g_assert_cmpstr (pk_command_index_get_command ("/usr/bin/sub/dir"), ==, NULL);
+	g_assert_cmpstr (pk_command_index_get_command ("/usr/share/powertop"), ==, NULL);
+
+	/* save */
+	commands = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					  (GDestroyNotify) g_ptr_array_unref);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (package_ids, g_strdup ("powertop;2.15;x86_64;fedora"));
+	g_hash_table_insert (commands, g_strdup ("powertop"), package_ids);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (package_ids, g_strdup ("vim-enhanced;9.1;x86_64;fedora"));
+	g_ptr_array_add (package_ids, g_strdup ("neovim;0.10;x86_64;fedora"));
+	g_ptr_array_add (package_ids, g_strdup ("neovim;0.10;x86_64;fedora"));
+	g_hash_table_insert (commands, g_strdup ("vi"), package_ids);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_add (package_ids, g_strdup ("make;4.4;x86_64;fedora"));
+	g_hash_table_insert (commands, g_strdup ("make"), package_ids);
+	g_mkdir_with_parents ("/tmp/PackageKit-self-test", 0755);
+	ret = pk_command_index_save (commands, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* load, with the duplicate dropped */
+	index = pk_command_index_new_from_file (filename, &error);
+	g_assert_no_error (error);
+	g_assert (index != NULL);
+	g_assert_cmpint (pk_command_index_get_size (index), ==, 4);
+
+	/* look up */
+	found = pk_command_index_lookup (index, "powertop");
+	g_assert (found != NULL);
+	g_assert_cmpint (g_strv_length (found), ==, 1);
+	g_assert_cmpstr (found[0], ==, "powertop;2.15;x86_64;fedora");
+	g_strfreev (found);
+	found = pk_command_index_lookup (index, "vi");
+	g_assert (found != NULL);
+	g_assert_cmpint (g_strv_length (found), ==, 2);
+	g_assert_cmpstr (found[0], ==, "neovim;0.10;x86_64;fedora");
+	g_assert_cmpstr (found[1], ==, "vim-enhanced;9.1;x86_64;fedora");
+	g_strfreev (found);
+	found = pk_command_index_lookup (index, "vim");
+	g_assert (found == NULL);
+	found = pk_command_index_lookup (index, "a");
+	g_assert (found == NULL);
+
+	/* one edit away */
+	g_assert (pk_command_index_is_similar ("amke", "make"));
+	g_assert (pk_command_index_is_similar ("mkae", "make"));
+	g_assert (pk_command_index_is_similar ("maek", "make"));
+	g_assert (pk_command_index_is_similar ("mak", "make"));
+	g_assert (pk_command_index_is_similar ("maake", "make"));
+	g_assert (pk_command_index_is_similar ("mike", "make"));
+	g_assert (pk_command_index_is_similar ("Make", "make"));
+	g_assert (!pk_command_index_is_similar ("make", "make"));
+	g_assert (!pk_command_index_is_similar ("kame", "make"));
+	g_assert (!pk_command_index_is_similar ("ma", "make"));
+	found = pk_command_index_find_similar (index, "amke");
+	g_assert (found != NULL);
+	g_assert_cmpint (g_strv_length (found), ==, 1);
+	g_assert_cmpstr (found[0], ==, "make");
+	g_strfreev (found);
+	found = pk_command_index_find_similar (index, "vim");
+	g_assert (found != NULL);
+	g_assert_cmpint (g_strv_length (found), ==, 1);
+	g_assert_cmpstr (found[0], ==, "vi");
+	g_strfreev (found);
+	found = pk_command_index_find_similar (index, "POWERTOP");
+	g_assert (found != NULL);
+	g_assert_cmpstr (found[0], ==, "powertop");
+	g_strfreev (found);
+	found = pk_command_index_find_similar (index, "powertopp");
+	g_assert (found != NULL);
+	g_assert_cmpstr (found[0], ==, "powertop");
+	g_strfreev (found);
+	found = pk_command_index_find_similar (index, "xyz");
+	g_assert (found == NULL);
+
+	/* not an index */
+	g_clear_pointer (&index, pk_command_index_free);
+	ret = g_file_set_contents (filename, "PKCMDIX1", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	index = pk_command_index_new_from_file (filename, &error);
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+	g_assert (index == NULL);
+}
+
+static void
+pk_test_name_list_func (void)
+{
+	const gchar *filename = "/tmp/PackageKit-self-test/package-names";
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) names = NULL;
+	g_autoptr(PkNameList) list = NULL;
+	g_auto(GStrv) found = NULL;
+
+	/* save, out of order */
+	names = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_add (names, (gpointer) "vim-enhanced");
+	g_hash_table_add (names, (gpointer) "powertop");
+	g_hash_table_add (names, (gpointer) "vim");
+	g_hash_table_add (names, (gpointer) "vim-minimal");
+	g_hash_table_add (names, (gpointer) "make");
+	g_mkdir_with_parents ("/tmp/PackageKit-self-test", 0755);
+	ret = pk_name_list_save (names, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* load */
+	list = pk_name_list_new_from_file (filename, &error);
+	g_assert_no_error (error);
+	g_assert (list != NULL);
+	g_assert_cmpint (pk_name_list_get_size (list), ==, 5);
+
+	/* complete */
+	found = pk_name_list_complete (list, "vim");
+	g_assert_cmpint (g_strv_length (found), ==, 3);
+	g_assert_cmpstr (found[0], ==, "vim");
+	g_assert_cmpstr (found[1], ==, "vim-enhanced");
+	g_assert_cmpstr (found[2], ==, "vim-minimal");
+	g_strfreev (found);
+	found = pk_name_list_complete (list, "vim-m");
+	g_assert_cmpint (g_strv_length (found), ==, 1);
+	g_assert_cmpstr (found[0], ==, "vim-minimal");
+	g_strfreev (found);
+	found = pk_name_list_complete (list, "");
+	g_assert_cmpint (g_strv_length (found), ==, 5);
+	g_assert_cmpstr (found[0], ==, "make");
+	g_strfreev (found);
+	found = pk_name_list_complete (list, "zsh");
+	g_assert_cmpint (g_strv_length (found), ==, 0);
+
+	/* truncated */
+	g_clear_pointer (&list, pk_name_list_free);
+	ret = g_file_set_contents (filename, "make\npower", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	list = pk_name_list_new_from_file (filename, &error);
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL);
+	g_assert (list == NULL);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -922,6 +1356,7 @@ main (int argc, char **argv)
 
 	/* tests go here */
 	g_test_add_func ("/packagekit-glib2/common", pk_test_common_func);
+	g_test_add_func ("/packagekit-glib2/sync-context", pk_test_sync_context_func);
 	g_test_add_func ("/packagekit-glib2/enum", pk_test_enum_func);
 	g_test_add_func ("/packagekit-glib2/bitfield", pk_test_bitfield_func);
 	g_test_add_func ("/packagekit-glib2/package-id", pk_test_package_id_func);
@@ -929,9 +1364,13 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit-glib2/progress", pk_test_progress_func);
 	g_test_add_func ("/packagekit-glib2/results", pk_test_results_func);
 	g_test_add_func ("/packagekit-glib2/package", pk_test_package_func);
+	g_test_add_func ("/packagekit-glib2/package-sack-file", pk_test_package_sack_file_func);
 	g_test_add_func ("/packagekit-glib2/progress-bar", pk_test_progress_bar);
 	g_test_add_func ("/packagekit-glib2/offline", pk_test_offline_func);
 	g_test_add_func ("/packagekit-glib2/offline-upgrade", pk_test_offline_upgrade_func);
+	g_test_add_func ("/packagekit-glib2/command-index", pk_test_command_index_func);
+	g_test_add_func ("/packagekit-glib2/details-cache", pk_test_details_cache_func);
+	g_test_add_func ("/packagekit-glib2/name-list", pk_test_name_list_func);
 
 	return g_test_run ();
 }
@@ -47,9 +47,11 @@ static void     pk_transaction_list_finalize		(GObject         *object);
  **/
 struct _PkTransactionListPrivate
 {
-	GPtrArray		*transaction_ids;
+	GPtrArray		*transaction_ids;	/* in the order they were added */
+	GHashTable		*transaction_set;	/* borrowed from @transaction_ids */
 	PkControl		*control;
 	GCancellable		*cancellable;
+	gboolean		 incremental;
 };
 
 typedef enum {
@@ -63,66 +65,69 @@ static guint signals [SIGNAL_LAST] = { 0 };
 G_DEFINE_TYPE (PkTransactionList, pk_transaction_list, G_TYPE_OBJECT)
 
 /*
- * pk_transaction_list_process_transaction_list:
+ * pk_transaction_list_add:
  **/
 static void
-pk_transaction_list_process_transaction_list (PkTransactionList *tlist, gchar **transaction_ids)
+pk_transaction_list_add (PkTransactionList *tlist, const gchar *tid)
 {
-	guint i, j;
-	gboolean ret;
-	const gchar *tid;
 	gchar *tid_tmp;
-	GPtrArray *array = tlist->priv->transaction_ids;
 
-	/* debug */
-	for (i = 0; i < array->len; i++) {
-		tid = g_ptr_array_index (array, i);
-		g_debug ("last:\t%s", tid);
-	}
-	for (i = 0; transaction_ids[i] != NULL; i++)
-		g_debug ("current:\t%s", transaction_ids[i]);
+	if (g_hash_table_contains (tlist->priv->transaction_set, tid))
+		return;
+	tid_tmp = g_strdup (tid);
+	g_ptr_array_add (tlist->priv->transaction_ids, tid_tmp);
+	g_hash_table_add (tlist->priv->transaction_set, tid_tmp);
+	g_debug ("emit added: %s", tid);
+	g_signal_emit (tlist, signals[SIGNAL_ADDED], 0, tid);
+}
+
+/*
+ * pk_transaction_list_remove:
+ **/
+static void
+pk_transaction_list_remove (PkTransactionList *tlist, const gchar *tid)
+{
+	g_autofree gchar *tid_tmp = NULL;
+	guint idx;
+
+	if (!g_hash_table_contains (tlist->priv->transaction_set, tid))
+		return;
+	tid_tmp = g_strdup (tid);
+	g_hash_table_remove (tlist->priv->transaction_set, tid_tmp);
+	if (g_ptr_array_find_with_equal_func (tlist->priv->transaction_ids, tid_tmp,
+					      g_str_equal, &idx))
+		g_ptr_array_remove_index (tlist->priv->transaction_ids, idx);
+	g_debug ("emit removed: %s", tid_tmp);
+	g_signal_emit (tlist, signals[SIGNAL_REMOVED], 0, tid_tmp);
+}
+
+/*
+ * pk_transaction_list_process_transaction_list:
+ **/
+static void
+pk_transaction_list_process_transaction_list (PkTransactionList *tlist, gchar **transaction_ids)
+{
+	g_autoptr(GHashTable) current = NULL;
+	g_autoptr(GPtrArray) removed = NULL;
 
 	/* remove old entries */
-	for (i = 0; i < array->len; i++) {
-		tid = g_ptr_array_index (array, i);
-
-		/* is in new list */
-		ret = FALSE;
-		for (j = 0; transaction_ids[j] != NULL; j++) {
-			ret = (g_strcmp0 (tid, transaction_ids[j]) == 0);
-			if (ret)
-				break;
-		}
-
-		/* no, so remove from array */
-		if (!ret) {
-			tid_tmp = g_strdup (tid);
-			g_ptr_array_remove_index (array, i);
-			g_debug ("emit removed: %s", tid_tmp);
-			g_signal_emit (tlist, signals[SIGNAL_REMOVED], 0, tid_tmp);
-			g_free (tid_tmp);
-		}
+	current = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; transaction_ids[i] != NULL; i++) {
+		g_debug ("current:\t%s", transaction_ids[i]);
+		g_hash_table_add (current, transaction_ids[i]);
+	}
+	removed = g_ptr_array_new_with_free_func (g_free);
+	for (guint i = 0; i < tlist->priv->transaction_ids->len; i++) {
+		const gchar *tid = g_ptr_array_index (tlist->priv->transaction_ids, i);
+		if (!g_hash_table_contains (current, tid))
+			g_ptr_array_add (removed, g_strdup (tid));
 	}
+	for (guint i = 0; i < removed->len; i++)
+		pk_transaction_list_remove (tlist, g_ptr_array_index (removed, i));
 
 	/* add new entries */
-	for (i = 0; transaction_ids[i] != NULL; i++) {
-
-		/* check to see if tid is in array */
-		ret = FALSE;
-		for (j = 0; j<array->len; j++) {
-			tid = g_ptr_array_index (array, j);
-			ret = (g_strcmp0 (tid, transaction_ids[i]) == 0);
-			if (ret)
-				break;
-		}
-
-		/* no, so add to array */
-		if (!ret) {
-			g_ptr_array_add (array, g_strdup (transaction_ids[i]));
-			g_debug ("emit added: %s", transaction_ids[i]);
-			g_signal_emit (tlist, signals[SIGNAL_ADDED], 0, transaction_ids[i]);
-		}
-	}
+	for (guint i = 0; transaction_ids[i] != NULL; i++)
+		pk_transaction_list_add (tlist, transaction_ids[i]);
 }
 
 /*
@@ -162,10 +167,34 @@ pk_transaction_list_get_transaction_list (PkTransactionList *tlist)
 static void
 pk_transaction_list_task_list_changed_cb (PkControl *control, gchar **transaction_ids, PkTransactionList *tlist)
 {
+	/* the daemon already told us what changed */
+	if (tlist->priv->incremental)
+		return;
+
 	/* process */
 	pk_transaction_list_process_transaction_list (tlist, transaction_ids);
 }
 
+/*
+ * pk_transaction_list_transaction_added_cb:
+ **/
+static void
+pk_transaction_list_transaction_added_cb (PkControl *control, const gchar *tid, PkTransactionList *tlist)
+{
+	tlist->priv->incremental = TRUE;
+	pk_transaction_list_add (tlist, tid);
+}
+
+/*
+ * pk_transaction_list_transaction_removed_cb:
+ **/
+static void
+pk_transaction_list_transaction_removed_cb (PkControl *control, const gchar *tid, PkTransactionList *tlist)
+{
+	tlist->priv->incremental = TRUE;
+	pk_transaction_list_remove (tlist, tid);
+}
+
 /*
  * pk_transaction_list_notify_connected_cb:
  **/
@@ -174,6 +203,9 @@ pk_transaction_list_notify_connected_cb (PkControl *control, GParamSpec *pspec,
 {
 	gboolean connected;
 	g_object_get (control, "connected", &connected, NULL);
+
+	/* the new daemon may be an older version */
+	tlist->priv->incremental = FALSE;
 	if (connected)
 		pk_transaction_list_get_transaction_list (tlist);
 }
@@ -251,9 +283,14 @@ pk_transaction_list_init (PkTransactionList *tlist)
 			  G_CALLBACK (pk_transaction_list_task_list_changed_cb), tlist);
 	g_signal_connect (tlist->priv->control, "notify::connected",
 			  G_CALLBACK (pk_transaction_list_notify_connected_cb), tlist);
+	g_signal_connect (tlist->priv->control, "transaction-added",
+			  G_CALLBACK (pk_transaction_list_transaction_added_cb), tlist);
+	g_signal_connect (tlist->priv->control, "transaction-removed",
+			  G_CALLBACK (pk_transaction_list_transaction_removed_cb), tlist);
 
 	/* we maintain a local copy */
 	tlist->priv->transaction_ids = g_ptr_array_new_with_free_func (g_free);
+	tlist->priv->transaction_set = g_hash_table_new (g_str_hash, g_str_equal);
 
 	/* force a refresh so we have valid data*/
 	pk_transaction_list_get_transaction_list (tlist);
@@ -278,8 +315,11 @@ pk_transaction_list_finalize (GObject *object)
 	/* unhook all signals */
 	g_signal_handlers_disconnect_by_func (tlist->priv->control, G_CALLBACK (pk_transaction_list_task_list_changed_cb), tlist);
 	g_signal_handlers_disconnect_by_func (tlist->priv->control, G_CALLBACK (pk_transaction_list_notify_connected_cb), tlist);
+	g_signal_handlers_disconnect_by_func (tlist->priv->control, G_CALLBACK (pk_transaction_list_transaction_added_cb), tlist);
+	g_signal_handlers_disconnect_by_func (tlist->priv->control, G_CALLBACK (pk_transaction_list_transaction_removed_cb), tlist);
 
 	/* remove all watches */
+	g_hash_table_unref (tlist->priv->transaction_set);
 	g_ptr_array_unref (tlist->priv->transaction_ids);
 	g_object_unref (tlist->priv->control);
 	g_object_unref (tlist->priv->cancellable);
@@ -56,6 +56,9 @@ struct _PkTransactionPastPrivate
 	gchar				*data;
 	guint				 uid;
 	gchar				*cmdline;
+	guint64				 cpu_time; /* us */
+	guint64				 memory_growth; /* bytes */
+	guint64				 bytes_emitted;
 };
 
 enum {
@@ -68,6 +71,9 @@ enum {
 	PROP_DATA,
 	PROP_UID,
 	PROP_CMDLINE,
+	PROP_CPU_TIME,
+	PROP_MEMORY_GROWTH,
+	PROP_BYTES_EMITTED,
 	PROP_LAST
 };
 
@@ -254,6 +260,59 @@ pk_transaction_past_get_cmdline (PkTransactionPast *past)
 	return past->priv->cmdline;
 }
 
+/**
+ * pk_transaction_past_get_cpu_time:
+ * @past: a valid #PkTransactionPast instance
+ *
+ * Gets the CPU time the backend spent on the transaction, including any
+ * helper process it spawned.
+ *
+ * Return value: The CPU time in microseconds, or 0 if not recorded
+ *
+ * Since: 1.2.5
+ **/
+guint64
+pk_transaction_past_get_cpu_time (PkTransactionPast *past)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION_PAST (past), 0);
+	return past->priv->cpu_time;
+}
+
+/**
+ * pk_transaction_past_get_memory_growth:
+ * @past: a valid #PkTransactionPast instance
+ *
+ * Gets how much the peak resident size of the daemon grew while the
+ * transaction was running.
+ *
+ * Return value: The growth in bytes, or 0 if not recorded
+ *
+ * Since: 1.2.5
+ **/
+guint64
+pk_transaction_past_get_memory_growth (PkTransactionPast *past)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION_PAST (past), 0);
+	return past->priv->memory_growth;
+}
+
+/**
+ * pk_transaction_past_get_bytes_emitted:
+ * @past: a valid #PkTransactionPast instance
+ *
+ * Gets the size of the results the transaction sent to its clients.
+ *
+ * Return value: The number of bytes, or 0 if not recorded
+ *
+ * Since: 1.2.5
+ **/
+guint64
+pk_transaction_past_get_bytes_emitted (PkTransactionPast *past)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION_PAST (past), 0);
+	return past->priv->bytes_emitted;
+}
+
 /*
  * pk_transaction_past_get_property:
  **/
@@ -288,6 +347,15 @@ pk_transaction_past_get_property (GObject *object, guint prop_id, GValue *value,
 	case PROP_CMDLINE:
 		g_value_set_string (value, priv->cmdline);
 		break;
+	case PROP_CPU_TIME:
+		g_value_set_uint64 (value, priv->cpu_time);
+		break;
+	case PROP_MEMORY_GROWTH:
+		g_value_set_uint64 (value, priv->memory_growth);
+		break;
+	case PROP_BYTES_EMITTED:
+		g_value_set_uint64 (value, priv->bytes_emitted);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -332,6 +400,15 @@ pk_transaction_past_set_property (GObject *object, guint prop_id, const GValue *
 		g_free (priv->cmdline);
 		priv->cmdline = g_strdup (g_value_get_string (value));
 		break;
+	case PROP_CPU_TIME:
+		priv->cpu_time = g_value_get_uint64 (value);
+		break;
+	case PROP_MEMORY_GROWTH:
+		priv->memory_growth = g_value_get_uint64 (value);
+		break;
+	case PROP_BYTES_EMITTED:
+		priv->bytes_emitted = g_value_get_uint64 (value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -430,6 +507,36 @@ pk_transaction_past_class_init (PkTransactionPastClass *klass)
 				     G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_CMDLINE, pspec);
 
+	/**
+	 * PkTransactionPast:cpu-time:
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint64 ("cpu-time", NULL, NULL,
+				     0, G_MAXUINT64, 0,
+				     G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_CPU_TIME, pspec);
+
+	/**
+	 * PkTransactionPast:memory-growth:
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint64 ("memory-growth", NULL, NULL,
+				     0, G_MAXUINT64, 0,
+				     G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_MEMORY_GROWTH, pspec);
+
+	/**
+	 * PkTransactionPast:bytes-emitted:
+	 *
+	 * Since: 1.2.5
+	 */
+	pspec = g_param_spec_uint64 ("bytes-emitted", NULL, NULL,
+				     0, G_MAXUINT64, 0,
+				     G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_BYTES_EMITTED, pspec);
+
 	g_type_class_add_private (klass, sizeof (PkTransactionPastPrivate));
 }
 
@@ -77,6 +77,9 @@ gboolean		 pk_transaction_past_get_succeeded	(PkTransactionPast	*past);
 guint			 pk_transaction_past_get_duration	(PkTransactionPast	*past);
 guint			 pk_transaction_past_get_uid		(PkTransactionPast	*past);
 PkRoleEnum		 pk_transaction_past_get_role		(PkTransactionPast	*past);
+guint64			 pk_transaction_past_get_cpu_time	(PkTransactionPast	*past);
+guint64			 pk_transaction_past_get_memory_growth	(PkTransactionPast	*past);
+guint64			 pk_transaction_past_get_bytes_emitted	(PkTransactionPast	*past);
 
 G_END_DECLS
 
@@ -29,6 +29,7 @@ import traceback
 import os.path
 
 from .enums import *
+from . import protocol
 
 PACKAGE_IDS_DELIM = '&'
 FILENAME_DELIM = '|'
@@ -67,6 +68,7 @@ class PackageKitBaseBackend:
         self.interactive = False
         self.cache_age = 0
         self.percentage_old = 0
+        self._writer = protocol.get_writer()
 
         # try to get LANG
         try:
@@ -124,19 +126,17 @@ class PackageKitBaseBackend:
         @param percent: Progress percentage (int preferred)
         '''
         if percent == None:
-            sys.stdout.write(_to_utf8("no-percentage-updates\n"))
+            self._writer.write(["no-percentage-updates"])
         elif percent == 0 or percent > self.percentage_old:
-            sys.stdout.write(_to_utf8("percentage\t%i\n" % percent))
+            self._writer.write(["percentage", "%i" % percent])
             self.percentage_old = percent
-        sys.stdout.flush()
 
     def speed(self, bps=0):
         '''
         Write progress speed
         @param bps: Progress speed (int, bytes per second)
         '''
-        sys.stdout.write(_to_utf8("speed\t%i\n" % bps))
-        sys.stdout.flush()
+        self._writer.write(["speed", "%i" % bps])
 
     def item_progress(self, package_id, status, percent=None):
         '''
@@ -144,8 +144,7 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param percent: percentage of the current item (int preferred)
         '''
-        sys.stdout.write(_to_utf8("item-progress\t%s\t%s\t%i\n" % (package_id, status, percent)))
-        sys.stdout.flush()
+        self._writer.write(["item-progress", package_id, status, "%i" % percent])
 
     def error(self, err, description, exit=True):
         '''
@@ -159,8 +158,7 @@ class PackageKitBaseBackend:
             self.unLock()
 
         # this should be fast now
-        sys.stdout.write(_to_utf8("error\t%s\t%s\n" % (err, description)))
-        sys.stdout.flush()
+        self._writer.write(["error", err, description])
         if exit:
             # Paradoxically, we don't want to print "finished" to stdout here.
             # Python takes an _enormous_ amount of time to exit, and leaves a
@@ -174,8 +172,7 @@ class PackageKitBaseBackend:
         send 'message' signal
         @param typ: MESSAGE_BROKEN_MIRROR
         '''
-        sys.stdout.write(_to_utf8("message\t%s\t%s\n" % (typ, msg)))
-        sys.stdout.flush()
+        self._writer.write(["message", typ, msg])
 
     def package(self, package_id, status, summary):
         '''
@@ -184,8 +181,7 @@ class PackageKitBaseBackend:
         @param package_id: The package ID name, e.g. openoffice-clipart;2.6.22;ppc64;fedora
         @param summary: The package Summary
         '''
-        sys.stdout.write(_to_utf8("package\t%s\t%s\t%s\n" % (status, package_id, summary)))
-        sys.stdout.flush()
+        self._writer.write(["package", status, package_id, summary])
 
     def media_change_required(self, mtype, id, text):
         '''
@@ -194,8 +190,7 @@ class PackageKitBaseBackend:
         @param id: the localised label of the media
         @param text: the localised text describing the media
         '''
-        sys.stdout.write(_to_utf8("media-change-required\t%s\t%s\t%s\n" % (mtype, id, text)))
-        sys.stdout.flush()
+        self._writer.write(["media-change-required", mtype, id, text])
 
     def distro_upgrade(self, dtype, name, summary):
         '''
@@ -204,16 +199,14 @@ class PackageKitBaseBackend:
         @param name: The distro name, e.g. "fedora-9"
         @param summary: The localised distribution name and description
         '''
-        sys.stdout.write(_to_utf8("distro-upgrade\t%s\t%s\t%s\n" % (dtype, name, summary)))
-        sys.stdout.flush()
+        self._writer.write(["distro-upgrade", dtype, name, summary])
 
     def status(self, state):
         '''
         send 'status' signal
         @param state: STATUS_DOWNLOAD, STATUS_INSTALL, STATUS_UPDATE, STATUS_REMOVE, STATUS_WAIT
         '''
-        sys.stdout.write(_to_utf8("status\t%s\n" % state))
-        sys.stdout.flush()
+        self._writer.write(["status", state])
 
     def repo_detail(self, repoid, name, state):
         '''
@@ -221,16 +214,14 @@ class PackageKitBaseBackend:
         @param repoid: The repo id tag
         @param state: false is repo is disabled else true.
         '''
-        sys.stdout.write(_to_utf8("repo-detail\t%s\t%s\t%s\n" % (repoid, name, _bool_to_string(state))))
-        sys.stdout.flush()
+        self._writer.write(["repo-detail", repoid, name, _bool_to_string(state)])
 
     def data(self, data):
         '''
         send 'data' signal:
         @param data:  The current worked on package
         '''
-        sys.stdout.write(_to_utf8("data\t%s\n" % data))
-        sys.stdout.flush()
+        self._writer.write(["data", data])
 
     def details(self, package_id, summary, package_license, group, desc, url, bytes):
         '''
@@ -243,16 +234,14 @@ class PackageKitBaseBackend:
         @param url: The upstream project homepage
         @param bytes: The size of the package, in bytes
         '''
-        sys.stdout.write(_to_utf8("details\t%s\t%s\t%s\t%s\t%s\t%s\t%ld\n" % (package_id, summary, package_license, group, desc, url, bytes)))
-        sys.stdout.flush()
+        self._writer.write(["details", package_id, summary, package_license, group, desc, url, "%ld" % bytes])
 
     def files(self, package_id, file_list):
         '''
         Send 'files' signal
         @param file_list: List of the files in the package, separated by ';'
         '''
-        sys.stdout.write(_to_utf8("files\t%s\t%s\n" % (package_id, file_list)))
-        sys.stdout.flush()
+        self._writer.write(["files", package_id, file_list])
 
     def category(self, parent_id, cat_id, name, summary, icon):
         '''
@@ -263,15 +252,13 @@ class PackageKitBaseBackend:
         summery   : a summary of the category in current locale.
         icon      : an icon name to represent the category
         '''
-        sys.stdout.write(_to_utf8("category\t%s\t%s\t%s\t%s\t%s\n" % (parent_id, cat_id, name, summary, icon)))
-        sys.stdout.flush()
+        self._writer.write(["category", parent_id, cat_id, name, summary, icon])
 
     def finished(self):
         '''
         Send 'finished' signal
         '''
-        sys.stdout.write(_to_utf8("finished\n"))
-        sys.stdout.flush()
+        self._writer.write(["finished"])
 
     def update_detail(self, package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated):
         '''
@@ -289,8 +276,7 @@ class PackageKitBaseBackend:
         @param issued:
         @param updated:
         '''
-        sys.stdout.write(_to_utf8("updatedetail\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated)))
-        sys.stdout.flush()
+        self._writer.write(["updatedetail", package_id, updates, obsoletes, vendor_url, bugzilla_url, cve_url, restart, update_text, changelog, state, issued, updated])
 
     def require_restart(self, restart_type, details):
         '''
@@ -298,8 +284,7 @@ class PackageKitBaseBackend:
         @param restart_type: RESTART_SYSTEM, RESTART_APPLICATION, RESTART_SESSION
         @param details: Optional details about the restart
         '''
-        sys.stdout.write(_to_utf8("requirerestart\t%s\t%s\n" % (restart_type, details)))
-        sys.stdout.flush()
+        self._writer.write(["requirerestart", restart_type, details])
 
     def allow_cancel(self, allow):
         '''
@@ -310,8 +295,7 @@ class PackageKitBaseBackend:
             data = 'true'
         else:
             data = 'false'
-        sys.stdout.write(_to_utf8("allow-cancel\t%s\n" % data))
-        sys.stdout.flush()
+        self._writer.write(["allow-cancel", data])
 
     def repo_signature_required(self, package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type):
         '''
@@ -325,10 +309,9 @@ class PackageKitBaseBackend:
         @param key_timestamp:   Key timestamp
         @param sig_type:        Key type (GPG)
         '''
-        sys.stdout.write(_to_utf8("repo-signature-required\t%s\t%s\t%s\t%s\t%s\t%s\t%s\t%s\n" % (
+        self._writer.write(["repo-signature-required",
             package_id, repo_name, key_url, key_userid, key_id, key_fingerprint, key_timestamp, sig_type
-            )))
-        sys.stdout.flush()
+            ])
 
     def eula_required(self, eula_id, package_id, vendor_name, license_agreement):
         '''
@@ -338,10 +321,9 @@ class PackageKitBaseBackend:
         @param vendor_name:     Name of the vendor that wrote the EULA
         @param license_agreement: The license text
         '''
-        sys.stdout.write(_to_utf8("eula-required\t%s\t%s\t%s\t%s\n" % (
+        self._writer.write(["eula-required",
             eula_id, package_id, vendor_name, license_agreement
-            )))
-        sys.stdout.flush()
+            ])
 
 #
 # Backend Action Methods
@@ -0,0 +1,69 @@
+#!/usr/bin/python
+#
+# Licensed under the GNU General Public License Version 2
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+# Copyright (C) 2026 The PackageKit Authors
+#
+# Writers for the two protocols a helper can use to talk to PkBackendSpawn.
+#
+# The text protocol is one tab separated line per command. The record
+# protocol is a NUL marker byte, a big-endian 32 bit payload length, then the
+# payload: the command and its fields separated by NUL bytes. Fields are sent
+# verbatim, so they may contain tabs, newlines and semicolons.
+
+import os
+import struct
+import sys
+
+RECORD_MARKER = b'\0'
+FIELD_DELIM = b'\0'
+
+def _to_bytes(field):
+    if isinstance(field, bytes):
+        return field
+    if not isinstance(field, str):
+        field = str(field)
+    return field.encode('utf-8', errors='replace')
+
+def records_supported():
+    ''' True if the daemon that spawned us understands records '''
+    protocols = os.environ.get('HELPER_PROTOCOL', '')
+    return 'records' in protocols.split(',')
+
+def encode_record(fields):
+    payload = FIELD_DELIM.join(_to_bytes(field) for field in fields)
+    return RECORD_MARKER + struct.pack('>I', len(payload)) + payload
+
+class TextWriter:
+
+    def write(self, fields):
+        sys.stdout.write('\t'.join(str(field) for field in fields) + '\n')
+        sys.stdout.flush()
+
+class RecordWriter:
+
+    def write(self, fields):
+        # anything printed as text has to go out first
+        sys.stdout.flush()
+        out = getattr(sys.stdout, 'buffer', sys.stdout)
+        out.write(encode_record(fields))
+        out.flush()
+
+def get_writer():
+    if records_supported():
+        return RecordWriter()
+    return TextWriter()
@@ -0,0 +1,188 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include "pk-auth-cache.h"
+
+static void     pk_auth_cache_finalize	(GObject        *object);
+
+#define PK_AUTH_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_AUTH_CACHE, PkAuthCachePrivate))
+
+typedef struct {
+	gchar			*sender;
+	gint64			 expires;	/* monotonic, in us */
+} PkAuthCacheItem;
+
+struct PkAuthCachePrivate
+{
+	GHashTable		*hash;		/* key:PkAuthCacheItem */
+	gint64			 timeout;	/* us */
+};
+
+G_DEFINE_TYPE (PkAuthCache, pk_auth_cache, G_TYPE_OBJECT)
+
+static void
+pk_auth_cache_item_free (PkAuthCacheItem *item)
+{
+	g_free (item->sender);
+	g_free (item);
+}
+
+static gchar *
+pk_auth_cache_build_key (const gchar *sender,
+			 const gchar *action_id,
+			 gboolean interactive)
+{
+	return g_strdup_printf ("%s\t%s\t%i", sender, action_id, interactive);
+}
+
+/**
+ * pk_auth_cache_lookup:
+ * @sender: the D-Bus unique name of the caller
+ * @action_id: the polkit action, e.g. "org.freedesktop.packagekit.package-install"
+ * @interactive: if the caller allowed user interaction
+ *
+ * Return value: %TRUE if @sender was authorized for @action_id recently
+ **/
+gboolean
+pk_auth_cache_lookup (PkAuthCache *cache,
+		      const gchar *sender,
+		      const gchar *action_id,
+		      gboolean interactive)
+{
+	PkAuthCacheItem *item;
+	g_autofree gchar *key = NULL;
+
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), FALSE);
+	g_return_val_if_fail (action_id != NULL, FALSE);
+
+	if (sender == NULL || cache->priv->timeout == 0)
+		return FALSE;
+	key = pk_auth_cache_build_key (sender, action_id, interactive);
+	item = g_hash_table_lookup (cache->priv->hash, key);
+	if (item == NULL)
+		return FALSE;
+	if (item->expires < g_get_monotonic_time ()) {
+		g_hash_table_remove (cache->priv->hash, key);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void
+pk_auth_cache_insert (PkAuthCache *cache,
+		      const gchar *sender,
+		      const gchar *action_id,
+		      gboolean interactive)
+{
+	PkAuthCacheItem *item;
+
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+	g_return_if_fail (action_id != NULL);
+
+	if (sender == NULL || cache->priv->timeout == 0)
+		return;
+	item = g_new0 (PkAuthCacheItem, 1);
+	item->sender = g_strdup (sender);
+	item->expires = g_get_monotonic_time () + cache->priv->timeout;
+	g_hash_table_replace (cache->priv->hash,
+			      pk_auth_cache_build_key (sender, action_id, interactive),
+			      item);
+}
+
+static gboolean
+pk_auth_cache_item_is_sender (gpointer key, gpointer value, gpointer user_data)
+{
+	PkAuthCacheItem *item = (PkAuthCacheItem *) value;
+	return g_strcmp0 (item->sender, user_data) == 0;
+}
+
+/* unique names are not reused, but do not keep the entries around */
+void
+pk_auth_cache_invalidate_sender (PkAuthCache *cache, const gchar *sender)
+{
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+	g_return_if_fail (sender != NULL);
+	g_hash_table_foreach_remove (cache->priv->hash,
+				     pk_auth_cache_item_is_sender,
+				     (gpointer) sender);
+}
+
+void
+pk_auth_cache_invalidate (PkAuthCache *cache)
+{
+	g_return_if_fail (PK_IS_AUTH_CACHE (cache));
+
+	if (g_hash_table_size (cache->priv->hash) == 0)
+		return;
+	g_debug ("invalidating %u cached authorizations",
+		 g_hash_table_size (cache->priv->hash));
+	g_hash_table_remove_all (cache->priv->hash);
+}
+
+guint
+pk_auth_cache_get_size (PkAuthCache *cache)
+{
+	g_return_val_if_fail (PK_IS_AUTH_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->hash);
+}
+
+static void
+pk_auth_cache_class_init (PkAuthCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_auth_cache_finalize;
+	g_type_class_add_private (klass, sizeof (PkAuthCachePrivate));
+}
+
+static void
+pk_auth_cache_init (PkAuthCache *cache)
+{
+	cache->priv = PK_AUTH_CACHE_GET_PRIVATE (cache);
+	cache->priv->hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, (GDestroyNotify) pk_auth_cache_item_free);
+}
+
+static void
+pk_auth_cache_finalize (GObject *object)
+{
+	PkAuthCache *cache;
+	g_return_if_fail (PK_IS_AUTH_CACHE (object));
+	cache = PK_AUTH_CACHE (object);
+
+	g_hash_table_unref (cache->priv->hash);
+
+	G_OBJECT_CLASS (pk_auth_cache_parent_class)->finalize (object);
+}
+
+/**
+ * pk_auth_cache_new:
+ * @timeout: the number of seconds to remember an authorization, or 0
+ **/
+PkAuthCache *
+pk_auth_cache_new (guint timeout)
+{
+	PkAuthCache *cache;
+	cache = g_object_new (PK_TYPE_AUTH_CACHE, NULL);
+	cache->priv->timeout = (gint64) timeout * G_USEC_PER_SEC;
+	return PK_AUTH_CACHE (cache);
+}
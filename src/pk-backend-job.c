@@ -21,6 +21,7 @@
 
 #include <config.h>
 
+#include <sys/resource.h>
 #include <glib.h>
 #include <glib/gprintf.h>
 
@@ -29,6 +30,11 @@
 #include "pk-backend.h"
 #include "pk-backend-job.h"
 #include "pk-shared.h"
+#include "pk-trace.h"
+
+#ifdef PK_BUILD_DAEMON
+#include "pk-peer-cache.h"
+#endif
 
 #define PK_BACKEND_JOB_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_BACKEND_JOB, PkBackendJobPrivate))
 
@@ -60,6 +66,15 @@
  */
 #define PK_BACKEND_CANCEL_ACTION_TIMEOUT	2000 /* ms */
 
+/**
+ * PK_BACKEND_JOB_CHECKPOINT_SLOW:
+ *
+ * The time in ms after a cancel request that a checkpoint noticing it is
+ * logged as too late, so the loops that do not check often enough can
+ * be found.
+ */
+#define PK_BACKEND_JOB_CHECKPOINT_SLOW		250 /* ms */
+
 typedef struct {
 	gboolean		 enabled;
 	PkBackendJobVFunc	 vfunc;
@@ -82,9 +97,26 @@ struct PkBackendJobPrivate
 	gchar			*proxy_http;
 	gchar			*proxy_https;
 	gchar			*proxy_socks;
+	gchar			*root;
 	gpointer		 user_data;
+	gpointer		 plan;
+	GDestroyNotify		 plan_destroy;
 	guint64			 download_size_remaining;
+	GMutex			 cancel_mutex;
+	gint64			 cancel_requested;	/* us, 0 if not */
+	gint64			 cancel_noticed;	/* us, 0 if not */
+	const gchar		*cancel_checkpoint;	/* static */
+	GMutex			 item_bytes_mutex;
+	GHashTable		*item_bytes;	/* package_id:guint64[2] */
+	guint64			 download_rate;
 	guint			 cache_age;
+	guint			 limit;			/* 0 for all */
+	guint			 offset;
+	guint			 packages_counted;	/* for the page */
+	gboolean		 limit_reached;
+	gint64			 deadline;		/* 0 for none */
+	gboolean		 partial;
+	gchar			**fields;		/* NULL for all */
 	guint			 download_files;
 	guint			 percentage;
 	guint			 remaining;
@@ -99,6 +131,7 @@ struct PkBackendJobPrivate
 	PkExitEnum		 exit;
 	gboolean		 allow_cancel;
 	gboolean		 background;
+	gboolean		 resumable;
 	gboolean		 interactive;
 	gboolean		 locked;
 	GHashTable		*emitted;
@@ -107,6 +140,15 @@ struct PkBackendJobPrivate
 	PkStatusEnum		 status;
 	GTimer			*timer;
 	gboolean		 started;
+	gint64			 finished_time;
+	gint64			 cpu_time;		/* us, including helpers */
+	gint64			 memory_growth;		/* bytes of peak RSS */
+	GThread			*usage_thread;		/* sampling, or NULL */
+	gint64			 usage_cpu_start;
+	glong			 usage_maxrss_start;	/* KiB */
+	gpointer		 pending_events;	/* (atomic) PkBackendJobVFuncHelper */
+	gpointer		 async_helper;		/* PkBackendJobAsyncHelper */
+	gint			 dispatch_scheduled;	/* (atomic) */
 };
 
 G_DEFINE_TYPE (PkBackendJob, pk_backend_job, G_TYPE_OBJECT)
@@ -161,6 +203,111 @@ pk_backend_job_is_cancelled (PkBackendJob *job)
 	return g_cancellable_is_cancelled (job->priv->cancellable);
 }
 
+/**
+ * pk_backend_job_checkpoint:
+ * @job: a #PkBackendJob
+ * @where: a static string naming the loop, e.g. "aptcc:changelog"
+ *
+ * Checks for cancellation like pk_backend_job_is_cancelled(), and is
+ * meant to be called at least every 100ms from any loop that can run
+ * for longer. The first checkpoint to see a cancel request remembers
+ * how long it took and where it was, and warns when that was slow.
+ *
+ * May be called from any thread.
+ *
+ * Return value: %TRUE if the job has been cancelled
+ **/
+gboolean
+pk_backend_job_checkpoint (PkBackendJob *job, const gchar *where)
+{
+	gint64 latency;
+
+	if (!g_cancellable_is_cancelled (job->priv->cancellable))
+		return FALSE;
+
+	g_mutex_lock (&job->priv->cancel_mutex);
+	if (job->priv->cancel_requested == 0 || job->priv->cancel_noticed != 0) {
+		g_mutex_unlock (&job->priv->cancel_mutex);
+		return TRUE;
+	}
+	job->priv->cancel_noticed = g_get_monotonic_time ();
+	job->priv->cancel_checkpoint = where;
+	latency = job->priv->cancel_noticed - job->priv->cancel_requested;
+	g_mutex_unlock (&job->priv->cancel_mutex);
+
+	if (latency > PK_BACKEND_JOB_CHECKPOINT_SLOW * 1000) {
+		g_warning ("%s only noticed the cancel after %" G_GINT64_FORMAT "ms at %s",
+			   pk_role_enum_to_string (job->priv->role), latency / 1000, where);
+	} else {
+		g_debug ("cancel noticed after %" G_GINT64_FORMAT "us at %s", latency, where);
+	}
+	return TRUE;
+}
+
+/**
+ * pk_backend_job_set_cancel_requested:
+ *
+ * Remembers when the job was asked to cancel, for the checkpoints to
+ * time against.
+ **/
+void
+pk_backend_job_set_cancel_requested (PkBackendJob *job)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	g_mutex_lock (&job->priv->cancel_mutex);
+	if (job->priv->cancel_requested == 0)
+		job->priv->cancel_requested = g_get_monotonic_time ();
+	g_mutex_unlock (&job->priv->cancel_mutex);
+}
+
+/**
+ * pk_backend_job_get_cancel_requested:
+ *
+ * Return value: the monotonic time the job was asked to cancel, or 0
+ **/
+gint64
+pk_backend_job_get_cancel_requested (PkBackendJob *job)
+{
+	gint64 requested;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+
+	g_mutex_lock (&job->priv->cancel_mutex);
+	requested = job->priv->cancel_requested;
+	g_mutex_unlock (&job->priv->cancel_mutex);
+	return requested;
+}
+
+/**
+ * pk_backend_job_get_cancel_checkpoint:
+ *
+ * Return value: the checkpoint that first saw the cancel request, or
+ * %NULL if none has
+ **/
+const gchar *
+pk_backend_job_get_cancel_checkpoint (PkBackendJob *job)
+{
+	const gchar *where;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+
+	g_mutex_lock (&job->priv->cancel_mutex);
+	where = job->priv->cancel_checkpoint;
+	g_mutex_unlock (&job->priv->cancel_mutex);
+	return where;
+}
+
+static void
+pk_backend_job_reset_cancel (PkBackendJob *job)
+{
+	g_mutex_lock (&job->priv->cancel_mutex);
+	job->priv->cancel_requested = 0;
+	job->priv->cancel_noticed = 0;
+	job->priv->cancel_checkpoint = NULL;
+	g_mutex_unlock (&job->priv->cancel_mutex);
+}
+
 /**
  * pk_backend_job_get_backend:
  *
@@ -232,6 +379,26 @@ pk_backend_job_set_proxy (PkBackendJob	*job,
 	job->priv->pac = g_strdup (pac);
 }
 
+void
+pk_backend_job_set_download_rate (PkBackendJob *job, guint64 download_rate)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	job->priv->download_rate = download_rate;
+}
+
+/**
+ * pk_backend_job_get_download_rate:
+ *
+ * Return value: the most bytes per second the backend should download at,
+ * or 0 for no limit
+ **/
+guint64
+pk_backend_job_get_download_rate (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->download_rate;
+}
+
 /**
  * pk_backend_job_get_proxy_http:
  *
@@ -367,6 +534,29 @@ pk_backend_job_set_locale (PkBackendJob *job, const gchar *code)
 	job->priv->locale = g_strdup (code);
 }
 
+/**
+ * pk_backend_job_get_root:
+ *
+ * Return value: the root the job installs into and reads the installed
+ * packages from, or %NULL for the root the backend was set up with
+ **/
+const gchar *
+pk_backend_job_get_root (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	return job->priv->root;
+}
+
+void
+pk_backend_job_set_root (PkBackendJob *job, const gchar *root)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	g_debug ("root changed to %s", root);
+	g_free (job->priv->root);
+	job->priv->root = g_strdup (root);
+}
+
 GVariant *
 pk_backend_job_get_parameters (PkBackendJob *job)
 {
@@ -447,6 +637,271 @@ pk_backend_job_set_cache_age (PkBackendJob *job, guint cache_age)
 	job->priv->cache_age = cache_age;
 }
 
+/**
+ * pk_backend_job_is_cache_fresh:
+ * @last_refresh: when the metadata was last refreshed, in seconds since
+ * the epoch, or 0 if it never was
+ *
+ * The one test every backend uses to skip a RefreshCache that is not
+ * forced, before it loads anything. With no cache age set, the backend
+ * has to ask the servers.
+ *
+ * Return value: %TRUE if the metadata is younger than the cache age
+ **/
+gboolean
+pk_backend_job_is_cache_fresh (PkBackendJob *job, gint64 last_refresh)
+{
+	guint cache_age;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+
+	cache_age = job->priv->cache_age;
+	if (cache_age == 0 || cache_age == G_MAXUINT || last_refresh <= 0)
+		return FALSE;
+	return last_refresh >= g_get_real_time () / G_USEC_PER_SEC - cache_age;
+}
+
+/**
+ * pk_backend_job_fetch_from_peers:
+ * @package_id: the package being downloaded
+ * @filename: where the backend downloads the file to
+ * @size: the download size of the package in the repo metadata
+ *
+ * Tries the hosts in PeerCacheHosts before the mirror. The backend still
+ * has to check the checksum and the signature of the file as if it had
+ * downloaded it, and download it again if they do not match.
+ *
+ * Return value: %TRUE if a peer had the file and it is now at @filename
+ **/
+gboolean
+pk_backend_job_fetch_from_peers (PkBackendJob *job,
+				 const gchar *package_id,
+				 const gchar *filename,
+				 goffset size)
+{
+#ifdef PK_BUILD_DAEMON
+	g_autoptr(GError) error = NULL;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+	g_return_val_if_fail (package_id != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!pk_peer_cache_fetch (job->priv->conf, package_id, filename, size,
+				  job->priv->cancellable, &error)) {
+		g_debug ("not fetching %s from peers: %s", package_id, error->message);
+		return FALSE;
+	}
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/**
+ * pk_backend_job_share_with_peers:
+ * @package_id: the package that was downloaded
+ * @filename: the verified file
+ *
+ * Offers a downloaded file to the other hosts, if PeerCachePort is set.
+ * Backends must not offer packages from a repo that needs credentials,
+ * the peers would get them without any.
+ **/
+void
+pk_backend_job_share_with_peers (PkBackendJob *job,
+				 const gchar *package_id,
+				 const gchar *filename)
+{
+#ifdef PK_BUILD_DAEMON
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (package_id != NULL);
+	g_return_if_fail (filename != NULL);
+
+	if (!pk_peer_cache_share (job->priv->conf, package_id, filename, &error))
+		g_warning ("failed to share %s: %s", filename, error->message);
+#endif
+}
+
+/**
+ * pk_backend_job_set_page:
+ * @limit: the most packages to send, or 0 for all of them
+ * @offset: how many packages to skip first
+ *
+ * Asks for one page of the results of a query role. The job drops the
+ * packages outside the page itself, so backends do not have to.
+ **/
+void
+pk_backend_job_set_page (PkBackendJob *job, guint limit, guint offset)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	g_debug ("page changed to %u packages from %u", limit, offset);
+	job->priv->limit = limit;
+	job->priv->offset = offset;
+}
+
+guint
+pk_backend_job_get_limit (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->limit;
+}
+
+guint
+pk_backend_job_get_offset (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->offset;
+}
+
+/**
+ * pk_backend_job_set_deadline:
+ * @deadline: the monotonic time the client wants the results by, or 0
+ **/
+void
+pk_backend_job_set_deadline (PkBackendJob *job, gint64 deadline)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	job->priv->deadline = deadline;
+}
+
+gint64
+pk_backend_job_get_deadline (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->deadline;
+}
+
+/**
+ * pk_backend_job_get_budget:
+ *
+ * Backends can check this before work that only adds detail to the
+ * results, and skip it when the client is in a hurry. If they do, they
+ * should call pk_backend_job_set_partial().
+ *
+ * Return value: the milliseconds left until the deadline of the client,
+ * 0 if it has passed, or -1 if there is no deadline
+ **/
+gint64
+pk_backend_job_get_budget (PkBackendJob *job)
+{
+	gint64 now;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), -1);
+
+	if (job->priv->deadline == 0)
+		return -1;
+	now = g_get_monotonic_time ();
+	if (now >= job->priv->deadline)
+		return 0;
+	return (job->priv->deadline - now) / 1000;
+}
+
+/**
+ * pk_backend_job_set_partial:
+ *
+ * Says that some optional detail was left out of the results to meet
+ * the deadline, so they are not kept for other clients.
+ **/
+void
+pk_backend_job_set_partial (PkBackendJob *job)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_debug ("results are partial, %" G_GINT64_FORMAT " ms were left",
+		 pk_backend_job_get_budget (job));
+	job->priv->partial = TRUE;
+}
+
+gboolean
+pk_backend_job_get_partial (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+	return job->priv->partial;
+}
+
+/**
+ * pk_backend_job_set_fields:
+ * @fields: (nullable): the fields the client wants, or %NULL for all of them
+ *
+ * Asks for only some of the optional fields of packages, details and update
+ * details, e.g. "summary" or "changelog". The package ID, info and the
+ * other required values are always sent.
+ **/
+void
+pk_backend_job_set_fields (PkBackendJob *job, gchar **fields)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	g_strfreev (job->priv->fields);
+	job->priv->fields = g_strdupv (fields);
+}
+
+/**
+ * pk_backend_job_wants_field:
+ * @field: a field name, e.g. "summary"
+ *
+ * Backends can check this to skip looking up values that would not be
+ * sent anyway.
+ *
+ * Return value: %TRUE if @field should be filled in
+ **/
+gboolean
+pk_backend_job_wants_field (PkBackendJob *job, const gchar *field)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), TRUE);
+
+	if (job->priv->fields == NULL)
+		return TRUE;
+	return g_strv_contains ((const gchar * const *) job->priv->fields, field);
+}
+
+/**
+ * pk_backend_job_get_limit_reached:
+ *
+ * Backends can check this in their scans to stop early, as nothing more
+ * they find would be sent.
+ *
+ * Return value: %TRUE if a package after the requested page was emitted
+ **/
+gboolean
+pk_backend_job_get_limit_reached (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+	return job->priv->limit_reached;
+}
+
+static gboolean
+pk_backend_job_role_is_pageable (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_GET_PACKAGES ||
+		role == PK_ROLE_ENUM_SEARCH_DETAILS ||
+		role == PK_ROLE_ENUM_SEARCH_FILE ||
+		role == PK_ROLE_ENUM_SEARCH_GROUP ||
+		role == PK_ROLE_ENUM_SEARCH_NAME ||
+		role == PK_ROLE_ENUM_WHAT_PROVIDES;
+}
+
+/* returns %FALSE if the next package is outside the requested page */
+static gboolean
+pk_backend_job_package_in_page (PkBackendJob *job)
+{
+	PkBackendJobPrivate *priv = job->priv;
+
+	if (priv->limit == 0 && priv->offset == 0)
+		return TRUE;
+	if (!pk_backend_job_role_is_pageable (priv->role))
+		return TRUE;
+	priv->packages_counted++;
+	if (priv->packages_counted <= priv->offset)
+		return FALSE;
+	if (priv->limit > 0 && priv->packages_counted > priv->offset + priv->limit) {
+		priv->limit_reached = TRUE;
+		return FALSE;
+	}
+	return TRUE;
+}
+
 void
 pk_backend_job_set_user_data (PkBackendJob *job, gpointer user_data)
 {
@@ -454,6 +909,58 @@ pk_backend_job_set_user_data (PkBackendJob *job, gpointer user_data)
 	job->priv->user_data = user_data;
 }
 
+/**
+ * pk_backend_job_set_plan:
+ * @plan: the solver state, or %NULL
+ * @destroy: the function to free @plan
+ *
+ * A backend calls this from a simulation with the solved state it would
+ * need to commit the same request. If the client then commits the
+ * simulation, the daemon gives the plan back to the committing job, where
+ * pk_backend_job_get_plan() returns it, so it does not have to be solved
+ * again.
+ **/
+void
+pk_backend_job_set_plan (PkBackendJob *job, gpointer plan, GDestroyNotify destroy)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	if (job->priv->plan_destroy != NULL)
+		job->priv->plan_destroy (job->priv->plan);
+	job->priv->plan = plan;
+	job->priv->plan_destroy = destroy;
+}
+
+/**
+ * pk_backend_job_get_plan:
+ *
+ * Return value: (transfer none): the plan of the simulation this job
+ * commits, or %NULL if the request has to be solved
+ **/
+gpointer
+pk_backend_job_get_plan (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	return job->priv->plan;
+}
+
+/**
+ * pk_backend_job_steal_plan:
+ * @destroy: (out): the function to free the plan
+ *
+ * Return value: (transfer full): the plan, which the job no longer owns
+ **/
+gpointer
+pk_backend_job_steal_plan (PkBackendJob *job, GDestroyNotify *destroy)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), NULL);
+	g_return_val_if_fail (destroy != NULL, NULL);
+
+	*destroy = job->priv->plan_destroy;
+	job->priv->plan_destroy = NULL;
+	return g_steal_pointer (&job->priv->plan);
+}
+
 gboolean
 pk_backend_job_get_background (PkBackendJob *job)
 {
@@ -468,6 +975,29 @@ pk_backend_job_set_background (PkBackendJob *job, gboolean background)
 	job->priv->background = background;
 }
 
+gboolean
+pk_backend_job_get_resumable (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+	return job->priv->resumable;
+}
+
+/**
+ * pk_backend_job_set_resumable:
+ *
+ * Backends set this when cancelling the role leaves whatever it already
+ * fetched in the cache, so running it again later picks up where it was
+ * stopped rather than starting over. A resumable background job is then
+ * requeued rather than failed when an interactive transaction needs the
+ * backend.
+ **/
+void
+pk_backend_job_set_resumable (PkBackendJob *job, gboolean resumable)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	job->priv->resumable = resumable;
+}
+
 gboolean
 pk_backend_job_get_interactive (PkBackendJob *job)
 {
@@ -514,12 +1044,14 @@ pk_backend_job_get_is_error_set (PkBackendJob *job)
 }
 
 /* used to call vfuncs in the main daemon thread */
-typedef struct {
-	PkBackendJob		*job;
+typedef struct PkBackendJobVFuncHelper PkBackendJobVFuncHelper;
+struct PkBackendJobVFuncHelper {
+	PkBackendJobVFuncHelper	*next;
 	PkBackendJobSignal	 signal_kind;
 	GObject			*object;
 	GDestroyNotify		 destroy_func;
-} PkBackendJobVFuncHelper;
+	GPtrArray		*objects;	/* a whole chunk, or %NULL */
+};
 
 static const gchar *
 pk_backend_job_signal_to_string (PkBackendJobSignal id)
@@ -564,6 +1096,8 @@ pk_backend_job_signal_to_string (PkBackendJobSignal id)
 		return "UpdateDetail";
 	if (id == PK_BACKEND_SIGNAL_CATEGORY)
 		return "Category";
+	if (id == PK_BACKEND_SIGNAL_DOWNLOAD_BYTES)
+		return "DownloadBytes";
 	return NULL;
 }
 
@@ -572,25 +1106,73 @@ pk_backend_job_vfunc_event_free (PkBackendJobVFuncHelper *helper)
 {
 	if (helper->destroy_func != NULL)
 		helper->destroy_func (helper->object);
-	g_object_unref (helper->job);
-	g_free (helper);
+	if (helper->objects != NULL)
+		g_ptr_array_unref (helper->objects);
+	g_slice_free (PkBackendJobVFuncHelper, helper);
 }
 
+/* only the last of these in each batch is interesting to the transaction */
 static gboolean
-pk_backend_job_call_vfunc_idle_cb (gpointer user_data)
+pk_backend_job_signal_can_coalesce (PkBackendJobSignal signal_kind)
 {
-	PkBackendJobVFuncHelper *helper = (PkBackendJobVFuncHelper *) user_data;
+	return signal_kind == PK_BACKEND_SIGNAL_PERCENTAGE ||
+	       signal_kind == PK_BACKEND_SIGNAL_SPEED ||
+	       signal_kind == PK_BACKEND_SIGNAL_DOWNLOAD_SIZE_REMAINING ||
+	       signal_kind == PK_BACKEND_SIGNAL_DOWNLOAD_BYTES;
+}
+
+static gboolean
+pk_backend_job_dispatch_events_cb (gpointer user_data)
+{
+	PkBackendJob *job = PK_BACKEND_JOB (user_data);
+	PkBackendJobVFuncHelper *events;
+	PkBackendJobVFuncHelper *helper;
+	PkBackendJobVFuncHelper *last[PK_BACKEND_SIGNAL_LAST] = { NULL };
+	PkBackendJobVFuncHelper *next;
+	PkBackendJobVFuncHelper *ordered = NULL;
 	PkBackendJobVFuncItem *item;
+	guint i;
 
-	/* call transaction vfunc on main thread */
-	item = &helper->job->priv->vfunc_items[helper->signal_kind];
-	if (item != NULL && item->vfunc != NULL) {
-		item->vfunc (helper->job, helper->object, item->user_data);
-	} else {
-		g_warning ("tried to do signal %s when no longer connected",
-			   pk_backend_job_signal_to_string (helper->signal_kind));
+	/* allow new events to schedule another dispatch before we take
+	 * the list, so nothing pushed after this point can be lost */
+	g_atomic_int_set (&job->priv->dispatch_scheduled, 0);
+	do {
+		events = g_atomic_pointer_get (&job->priv->pending_events);
+	} while (!g_atomic_pointer_compare_and_exchange (&job->priv->pending_events,
+							 events, NULL));
+
+	/* the list was pushed as a stack, so reverse into emission order */
+	for (helper = events; helper != NULL; helper = next) {
+		next = helper->next;
+		helper->next = ordered;
+		ordered = helper;
+		if (last[helper->signal_kind] == NULL)
+			last[helper->signal_kind] = helper;
 	}
-	return FALSE;
+
+	/* call transaction vfuncs on main thread */
+	for (helper = ordered; helper != NULL; helper = next) {
+		next = helper->next;
+		if (pk_backend_job_signal_can_coalesce (helper->signal_kind) &&
+		    last[helper->signal_kind] != helper) {
+			pk_backend_job_vfunc_event_free (helper);
+			continue;
+		}
+		item = &job->priv->vfunc_items[helper->signal_kind];
+		PK_TRACE2 (job__vfunc__dispatch, job, helper->signal_kind);
+		if (item->vfunc != NULL && helper->objects != NULL) {
+			/* a chunk from one of the bulk helpers */
+			for (i = 0; i < helper->objects->len; i++)
+				item->vfunc (job, g_ptr_array_index (helper->objects, i), item->user_data);
+		} else if (item->vfunc != NULL) {
+			item->vfunc (job, helper->object, item->user_data);
+		} else {
+			g_warning ("tried to do signal %s when no longer connected",
+				   pk_backend_job_signal_to_string (helper->signal_kind));
+		}
+		pk_backend_job_vfunc_event_free (helper);
+	}
+	return G_SOURCE_REMOVE;
 }
 
 /**
@@ -598,7 +1180,40 @@ pk_backend_job_call_vfunc_idle_cb (gpointer user_data)
  *
  * This method can be called in any thread, and the vfunc is guaranteed
  * to be called idle in the main thread.
+ *
+ * Events are pushed onto a per-job list without taking a lock, and only
+ * the first event since the last dispatch attaches an idle source, so a
+ * backend emitting thousands of packages causes a single wakeup of the
+ * main loop. Events are always dispatched in the order they were pushed,
+ * so ::Finished is never handled before any earlier event of this job.
  **/
+static void
+pk_backend_job_queue_event (PkBackendJob *job, PkBackendJobVFuncHelper *helper)
+{
+	PkBackendJobSignal signal_kind = helper->signal_kind;
+	g_autoptr(GSource) source = NULL;
+
+	do {
+		helper->next = g_atomic_pointer_get (&job->priv->pending_events);
+	} while (!g_atomic_pointer_compare_and_exchange (&job->priv->pending_events,
+							 helper->next, helper));
+	PK_TRACE2 (job__vfunc__enqueue, job, signal_kind);
+
+	/* already going to be dispatched */
+	if (!g_atomic_int_compare_and_exchange (&job->priv->dispatch_scheduled, 0, 1))
+		return;
+
+	/* emit idle */
+	source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_DEFAULT_IDLE);
+	g_source_set_callback (source,
+			       pk_backend_job_dispatch_events_cb,
+			       g_object_ref (job),
+			       (GDestroyNotify) g_object_unref);
+	g_source_set_name (source, "[PkBackendJob] idle_event_cb");
+	g_source_attach (source, NULL);
+}
+
 static void
 pk_backend_job_call_vfunc (PkBackendJob *job,
 			   PkBackendJobSignal signal_kind,
@@ -606,33 +1221,46 @@ pk_backend_job_call_vfunc (PkBackendJob *job,
 			   GDestroyNotify destroy_func)
 {
 	PkBackendJobVFuncHelper *helper;
-	PkBackendJobVFuncItem *item;
-	guint priority = G_PRIORITY_DEFAULT_IDLE;
-	g_autoptr(GSource) source = NULL;
 
 	/* call transaction vfunc if not disabled and set */
-	item = &job->priv->vfunc_items[signal_kind];
-	if (!item->enabled || item->vfunc == NULL)
+	if (!pk_backend_job_get_vfunc_enabled (job, signal_kind)) {
+		if (destroy_func != NULL)
+			destroy_func (object);
 		return;
+	}
 
-	/* order this last if others are still pending */
-	if (signal_kind == PK_BACKEND_SIGNAL_FINISHED)
-		priority = G_PRIORITY_LOW;
-
-	/* emit idle */
-	helper = g_new0 (PkBackendJobVFuncHelper, 1);
-	helper->job = g_object_ref (job);
+	/* queue */
+	helper = g_slice_new0 (PkBackendJobVFuncHelper);
 	helper->signal_kind = signal_kind;
 	helper->object = object;
 	helper->destroy_func = destroy_func;
-	source = g_idle_source_new ();
-	g_source_set_priority (source, priority);
-	g_source_set_callback (source,
-			       pk_backend_job_call_vfunc_idle_cb,
-			       helper,
-			       (GDestroyNotify) pk_backend_job_vfunc_event_free);
-	g_source_set_name (source, "[PkBackendJob] idle_event_cb");
-	g_source_attach (source, NULL);
+	pk_backend_job_queue_event (job, helper);
+}
+
+/**
+ * pk_backend_job_call_vfunc_array:
+ * @objects: (transfer full): the objects to pass to the vfunc, in order
+ *
+ * Like pk_backend_job_call_vfunc() but the whole array crosses to the main
+ * thread as a single event, and the vfunc is called once per object.
+ **/
+static void
+pk_backend_job_call_vfunc_array (PkBackendJob *job,
+				 PkBackendJobSignal signal_kind,
+				 GPtrArray *objects)
+{
+	PkBackendJobVFuncHelper *helper;
+
+	if (objects->len == 0 ||
+	    !pk_backend_job_get_vfunc_enabled (job, signal_kind)) {
+		g_ptr_array_unref (objects);
+		return;
+	}
+
+	helper = g_slice_new0 (PkBackendJobVFuncHelper);
+	helper->signal_kind = signal_kind;
+	helper->objects = objects;
+	pk_backend_job_queue_event (job, helper);
 }
 
 /**
@@ -714,22 +1342,80 @@ typedef struct {
 	GDestroyNotify		 destroy_func;
 } PkBackendJobThreadHelper;
 
+/* the thread-specific counter is what keeps jobs on other workers out */
+static gint64
+pk_backend_job_get_thread_cpu_time (void)
+{
+	struct rusage usage;
+#ifdef RUSAGE_THREAD
+	if (getrusage (RUSAGE_THREAD, &usage) != 0)
+		return 0;
+#else
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return 0;
+#endif
+	return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+	       usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static glong
+pk_backend_job_get_maxrss (void)
+{
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return usage.ru_maxrss;
+}
+
+static void
+pk_backend_job_usage_start (PkBackendJob *job)
+{
+	job->priv->usage_thread = g_thread_self ();
+	job->priv->usage_cpu_start = pk_backend_job_get_thread_cpu_time ();
+	job->priv->usage_maxrss_start = pk_backend_job_get_maxrss ();
+}
+
+/* only the thread that started sampling can read its own counters */
+static void
+pk_backend_job_usage_stop (PkBackendJob *job)
+{
+	glong maxrss;
+
+	if (job->priv->usage_thread != g_thread_self ())
+		return;
+	job->priv->usage_thread = NULL;
+	job->priv->cpu_time += pk_backend_job_get_thread_cpu_time () -
+			       job->priv->usage_cpu_start;
+	maxrss = pk_backend_job_get_maxrss ();
+	if (maxrss > job->priv->usage_maxrss_start)
+		job->priv->memory_growth += (gint64) (maxrss - job->priv->usage_maxrss_start) * 1024;
+}
+
 static gpointer
 pk_backend_job_thread_setup (gpointer thread_data)
 {
 	PkBackendJobThreadHelper *helper = (PkBackendJobThreadHelper *) thread_data;
 
+	/* set idle IO priority for this job only, as the worker is reused */
+#ifdef PK_BUILD_DAEMON
+	if (helper->job->priv->background == TRUE) {
+		g_debug ("setting ioprio class to idle");
+		pk_ioprio_set_idle (0);
+		pk_background_thread_enter ();
+	}
+#endif
+
 	/* run original function with automatic locking */
 	pk_backend_thread_start (helper->backend, helper->job, helper->func);
+	pk_backend_job_usage_start (helper->job);
 	helper->func (helper->job, helper->job->priv->params, helper->user_data);
 	pk_backend_job_finished (helper->job);
 	pk_backend_thread_stop (helper->backend, helper->job, helper->func);
 
-	/* set idle IO priority */
 #ifdef PK_BUILD_DAEMON
 	if (helper->job->priv->background == TRUE) {
-		g_debug ("setting ioprio class to idle");
-		pk_ioprio_set_idle (0);
+		pk_ioprio_set_default (0);
+		pk_background_thread_leave ();
 	}
 #endif
 
@@ -744,14 +1430,19 @@ pk_backend_job_thread_setup (gpointer thread_data)
 }
 
 /**
- * pk_backend_job_thread_create:
- * @func: (scope call):
+ * pk_backend_job_thread_create_for_role:
+ * @role: the role to run on a dedicated worker, or %PK_ROLE_ENUM_UNKNOWN
+ * @func: (scope async):
+ *
+ * Like pk_backend_job_thread_create(), but runs @func on a worker thread
+ * kept for @role alone, so heavy roles do not hold up the shared workers.
  **/
 gboolean
-pk_backend_job_thread_create (PkBackendJob *job,
-			      PkBackendJobThreadFunc func,
-			      gpointer user_data,
-			      GDestroyNotify destroy_func)
+pk_backend_job_thread_create_for_role (PkBackendJob *job,
+				       PkRoleEnum role,
+				       PkBackendJobThreadFunc func,
+				       gpointer user_data,
+				       GDestroyNotify destroy_func)
 {
 	PkBackendJobThreadHelper *helper = NULL;
 
@@ -765,15 +1456,111 @@ pk_backend_job_thread_create (PkBackendJob *job,
 	helper->backend = job->priv->backend;
 	helper->func = func;
 	helper->user_data = user_data;
+	helper->destroy_func = destroy_func;
+
+	/* run on a pooled worker; we do not need to join() this at any stage */
+	pk_backend_thread_push (helper->backend, role,
+				pk_backend_job_thread_setup, helper);
+	return TRUE;
+}
+
+typedef struct {
+	PkBackendJob		*job;
+	PkBackendJobAsyncFunc	 func;
+	gpointer		 user_data;
+	GDestroyNotify		 destroy_func;
+} PkBackendJobAsyncHelper;
+
+static gboolean
+pk_backend_job_async_start_cb (gpointer user_data)
+{
+	PkBackendJobAsyncHelper *helper = (PkBackendJobAsyncHelper *) user_data;
+
+	helper->func (helper->job,
+		      helper->job->priv->params,
+		      g_main_context_get_thread_default (),
+		      helper->user_data);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_backend_job_async_create:
+ * @func: (scope async): starts the role and returns straight away
+ *
+ * An alternative to pk_backend_job_thread_create() for roles that spend
+ * most of their time waiting on the network or on a child process. @func
+ * is called on the backend I/O thread with its #GMainContext as the
+ * thread-default, so any async operation it starts completes there too.
+ * Many such jobs share the one thread.
+ *
+ * Whatever finishes last has to call pk_backend_job_async_finished() in
+ * the I/O thread, instead of pk_backend_job_finished().
+ **/
+gboolean
+pk_backend_job_async_create (PkBackendJob *job,
+			     PkBackendJobAsyncFunc func,
+			     gpointer user_data,
+			     GDestroyNotify destroy_func)
+{
+	PkBackendJobAsyncHelper *helper = NULL;
+
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+	g_return_val_if_fail (job->priv->async_helper == NULL, FALSE);
+	g_return_val_if_fail (pk_is_thread_default (), FALSE);
+
+	helper = g_new0 (PkBackendJobAsyncHelper, 1);
+	helper->job = g_object_ref (job);
+	helper->func = func;
+	helper->user_data = user_data;
+	helper->destroy_func = destroy_func;
+	job->priv->async_helper = helper;
 
-	/* create a thread and unref it immediately as we do not need to join()
-	 * this at any stage */
-	g_thread_unref (g_thread_new ("PK-Backend",
-	                              pk_backend_job_thread_setup,
-	                              helper));
+	g_main_context_invoke (pk_backend_get_io_context (job->priv->backend),
+			       pk_backend_job_async_start_cb, helper);
 	return TRUE;
 }
 
+/**
+ * pk_backend_job_async_finished:
+ *
+ * Finishes a job started with pk_backend_job_async_create().
+ **/
+void
+pk_backend_job_async_finished (PkBackendJob *job)
+{
+	PkBackendJobAsyncHelper *helper;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (job->priv->async_helper != NULL);
+
+	helper = job->priv->async_helper;
+	job->priv->async_helper = NULL;
+	pk_backend_job_finished (job);
+
+	if (helper->destroy_func != NULL)
+		helper->destroy_func (helper->user_data);
+	g_object_unref (helper->job);
+	g_free (helper);
+}
+
+/**
+ * pk_backend_job_thread_create:
+ * @func: (scope async):
+ **/
+gboolean
+pk_backend_job_thread_create (PkBackendJob *job,
+			      PkBackendJobThreadFunc func,
+			      gpointer user_data,
+			      GDestroyNotify destroy_func)
+{
+	return pk_backend_job_thread_create_for_role (job,
+						      PK_ROLE_ENUM_UNKNOWN,
+						      func,
+						      user_data,
+						      destroy_func);
+}
+
 void
 pk_backend_job_set_percentage (PkBackendJob *job, guint percentage)
 {
@@ -863,6 +1650,61 @@ pk_backend_job_set_download_size_remaining (PkBackendJob *job, guint64 download_
 				   g_free);
 }
 
+/**
+ * pk_backend_job_set_item_bytes:
+ * @package_id: the package being downloaded
+ * @bytes_done: how much of it has been fetched
+ * @bytes_total: its size, or 0 if not known yet
+ *
+ * Backends downloading several packages at once call this for each of
+ * them, from any thread. The job keeps the sum over all the packages, so
+ * the transaction shows one done and total byte count.
+ **/
+void
+pk_backend_job_set_item_bytes (PkBackendJob *job,
+			       const gchar *package_id,
+			       guint64 bytes_done,
+			       guint64 bytes_total)
+{
+	GHashTableIter iter;
+	gpointer value;
+	guint64 *item;
+	guint64 *totals;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (package_id != NULL);
+
+	if (job->priv->set_error) {
+		g_warning ("already set error: item-bytes %s", package_id);
+		return;
+	}
+
+	totals = g_new0 (guint64, 2);
+	g_mutex_lock (&job->priv->item_bytes_mutex);
+	if (job->priv->item_bytes == NULL) {
+		job->priv->item_bytes = g_hash_table_new_full (g_str_hash, g_str_equal,
+							       g_free, g_free);
+	}
+	item = g_hash_table_lookup (job->priv->item_bytes, package_id);
+	if (item == NULL) {
+		item = g_new0 (guint64, 2);
+		g_hash_table_insert (job->priv->item_bytes, g_strdup (package_id), item);
+	}
+	item[0] = bytes_done;
+	item[1] = MAX (bytes_total, bytes_done);
+	g_hash_table_iter_init (&iter, job->priv->item_bytes);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		totals[0] += ((guint64 *) value)[0];
+		totals[1] += ((guint64 *) value)[1];
+	}
+	g_mutex_unlock (&job->priv->item_bytes_mutex);
+
+	pk_backend_job_call_vfunc (job,
+				   PK_BACKEND_SIGNAL_DOWNLOAD_BYTES,
+				   totals,
+				   g_free);
+}
+
 void
 pk_backend_job_set_item_progress (PkBackendJob *job,
 				  const gchar *package_id,
@@ -964,49 +1806,33 @@ pk_backend_job_package (PkBackendJob *job,
 	pk_backend_job_package_full (job, info, package_id, summary, PK_INFO_ENUM_UNKNOWN);
 }
 
-void
-pk_backend_job_package_full (PkBackendJob *job,
-			     PkInfoEnum info,
-			     const gchar *package_id,
-			     const gchar *summary,
-			     PkInfoEnum update_severity)
+/* returns %FALSE if @item must not be sent */
+static gboolean
+pk_backend_job_package_accept (PkBackendJob *job, PkPackage *item)
 {
 	PkPackage *emitted_item;
-	gboolean ret;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(PkPackage) item = NULL;
-
-	g_return_if_fail (PK_IS_BACKEND_JOB (job));
-	g_return_if_fail (package_id != NULL);
-
-	/* check we are valid */
-	item = pk_package_new ();
-	ret = pk_package_set_id (item, package_id, &error);
-	if (!ret) {
-		g_warning ("package_id %s invalid and cannot be processed: %s",
-			   package_id, error->message);
-		return;
-	}
-	pk_package_set_info (item, info);
-	pk_package_set_update_severity (item, update_severity);
-	pk_package_set_summary (item, summary);
+	PkInfoEnum info = pk_package_get_info (item);
 
 	/* already emitted? */
 	emitted_item = g_hash_table_lookup (job->priv->emitted, pk_package_get_id (item));
 	if (emitted_item != NULL && pk_package_equal (emitted_item, item))
-		return;
+		return FALSE;
 
-	/* update the emitted package table */
-	g_hash_table_insert (job->priv->emitted,
-	                     g_strdup (pk_package_get_id (item)),
-	                     g_object_ref (item));
+	/* update the emitted package table, the key is owned by the value */
+	g_hash_table_replace (job->priv->emitted,
+	                      (gpointer) pk_package_get_id (item),
+	                      g_object_ref (item));
 
 	/* have we already set an error? */
 	if (job->priv->set_error) {
-		g_warning ("already set error: package %s", package_id);
-		return;
+		g_warning ("already set error: package %s", pk_package_get_id (item));
+		return FALSE;
 	}
 
+	/* only the requested page of a search is sent */
+	if (!pk_backend_job_package_in_page (job))
+		return FALSE;
+
 	/* we automatically set the transaction status  */
 	if (info == PK_INFO_ENUM_DOWNLOADING)
 		pk_backend_job_set_status (job, PK_STATUS_ENUM_DOWNLOAD);
@@ -1023,6 +1849,32 @@ pk_backend_job_package_full (PkBackendJob *job,
 
 	/* we've sent a package for this transaction */
 	job->priv->has_sent_package = TRUE;
+	return TRUE;
+}
+
+void
+pk_backend_job_package_full (PkBackendJob *job,
+			     PkInfoEnum info,
+			     const gchar *package_id,
+			     const gchar *summary,
+			     PkInfoEnum update_severity)
+{
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkPackage) item = NULL;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (package_id != NULL);
+
+	/* check we are valid */
+	item = pk_package_new_full (info, package_id, summary, update_severity,
+				    PK_ROLE_ENUM_UNKNOWN, NULL, &error);
+	if (item == NULL) {
+		g_warning ("package_id %s invalid and cannot be processed: %s",
+			   package_id, error->message);
+		return;
+	}
+	if (!pk_backend_job_package_accept (job, item))
+		return;
 
 	/* emit */
 	pk_backend_job_call_vfunc (job,
@@ -1031,6 +1883,36 @@ pk_backend_job_package_full (PkBackendJob *job,
 				   g_object_unref);
 }
 
+/**
+ * pk_backend_job_packages:
+ * @job: A valid #PkBackendJob
+ * @packages: (element-type PkPackage): packages with their info set
+ *
+ * Emits many packages at once, handing them to the transaction in a single
+ * main loop event rather than one event per package.
+ *
+ * The packages are checked and deduplicated the same way as
+ * pk_backend_job_package_full(); the ones that are sent are referenced, so
+ * @packages can be freed as soon as this returns.
+ **/
+void
+pk_backend_job_packages (PkBackendJob *job, GPtrArray *packages)
+{
+	GPtrArray *accepted;
+	guint i;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (packages != NULL);
+
+	accepted = g_ptr_array_new_full (packages->len, g_object_unref);
+	for (i = 0; i < packages->len; i++) {
+		PkPackage *item = g_ptr_array_index (packages, i);
+		if (pk_backend_job_package_accept (job, item))
+			g_ptr_array_add (accepted, g_object_ref (item));
+	}
+	pk_backend_job_call_vfunc_array (job, PK_BACKEND_SIGNAL_PACKAGE, accepted);
+}
+
 void
 pk_backend_job_update_detail (PkBackendJob *job,
 			      const gchar *package_id,
@@ -1189,6 +2071,29 @@ pk_backend_job_details_full (PkBackendJob *job,
 				   g_object_unref);
 }
 
+/**
+ * pk_backend_job_details_array:
+ * @job: A valid #PkBackendJob
+ * @details: (element-type PkDetails): the details of each package
+ *
+ * Emits the details of many packages in a single main loop event.
+ **/
+void
+pk_backend_job_details_array (PkBackendJob *job, GPtrArray *details)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (details != NULL);
+
+	/* have we already set an error? */
+	if (job->priv->set_error) {
+		g_warning ("already set error: %u details", details->len);
+		return;
+	}
+
+	pk_backend_job_call_vfunc_array (job, PK_BACKEND_SIGNAL_DETAILS,
+					 g_ptr_array_ref (details));
+}
+
 /**
  * pk_backend_job_files:
  *
@@ -1235,6 +2140,44 @@ pk_backend_job_files (PkBackendJob *job,
 	job->priv->download_files++;
 }
 
+/**
+ * pk_backend_job_files_array:
+ * @job: A valid #PkBackendJob
+ * @files: (element-type PkFiles): the file lists of each package
+ *
+ * Emits the file lists of many packages in a single main loop event.
+ **/
+void
+pk_backend_job_files_array (PkBackendJob *job, GPtrArray *files)
+{
+	GPtrArray *checked;
+	guint i;
+
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (files != NULL);
+
+	/* have we already set an error? */
+	if (job->priv->set_error) {
+		g_warning ("already set error: %u files", files->len);
+		return;
+	}
+
+	checked = g_ptr_array_new_full (files->len, g_object_unref);
+	for (i = 0; i < files->len; i++) {
+		PkFiles *item = g_ptr_array_index (files, i);
+		const gchar *package_id = pk_files_get_package_id (item);
+
+		if (package_id != NULL && !pk_package_id_check (package_id)) {
+			g_warning ("package_id invalid and cannot be processed: %s", package_id);
+			continue;
+		}
+		g_ptr_array_add (checked, g_object_ref (item));
+	}
+
+	job->priv->download_files += checked->len;
+	pk_backend_job_call_vfunc_array (job, PK_BACKEND_SIGNAL_FILES, checked);
+}
+
 void
 pk_backend_job_distro_upgrade (PkBackendJob *job,
 			       PkDistroUpgradeEnum state,
@@ -1565,6 +2508,62 @@ pk_backend_job_get_started (PkBackendJob *job)
 	return job->priv->started;
 }
 
+/**
+ * pk_backend_job_get_finished_time:
+ *
+ * Return value: the monotonic time pk_backend_job_finished() was called
+ * at, which can be well before the ::finished vfunc runs in the daemon
+ **/
+gint64
+pk_backend_job_get_finished_time (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->finished_time;
+}
+
+/**
+ * pk_backend_job_add_cpu_time:
+ * @cpu_time: microseconds
+ *
+ * Accounts CPU time spent for the job outside of its thread, for instance
+ * by a helper process.
+ **/
+void
+pk_backend_job_add_cpu_time (PkBackendJob *job, gint64 cpu_time)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	job->priv->cpu_time += cpu_time;
+}
+
+/**
+ * pk_backend_job_get_cpu_time:
+ *
+ * Return value: the CPU time of the job thread and any helper in
+ * microseconds, complete once the job has finished
+ **/
+gint64
+pk_backend_job_get_cpu_time (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->cpu_time;
+}
+
+/**
+ * pk_backend_job_get_memory_growth:
+ *
+ * The daemon shares one heap between all jobs, so this is how far the
+ * peak resident size of the process grew while the job thread ran; a
+ * job that stays below an earlier peak reports 0.
+ *
+ * Return value: bytes
+ **/
+gint64
+pk_backend_job_get_memory_growth (PkBackendJob *job)
+{
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), 0);
+	return job->priv->memory_growth;
+}
+
 void
 pk_backend_job_set_allow_cancel (PkBackendJob *job, gboolean allow_cancel)
 {
@@ -1624,6 +2623,9 @@ pk_backend_job_finished (PkBackendJob *job)
 
 	g_return_if_fail (PK_IS_BACKEND_JOB (job));
 
+	/* before ::finished can read it on the main thread */
+	pk_backend_job_usage_stop (job);
+
 	/* check we have not already finished */
 	if (job->priv->finished) {
 		g_warning ("already finished");
@@ -1654,6 +2656,7 @@ pk_backend_job_finished (PkBackendJob *job)
 
 	/* we can't ever be re-used */
 	job->priv->finished = TRUE;
+	job->priv->finished_time = g_get_monotonic_time ();
 
 	/* this wasn't set otherwise, assume success */
 	if (job->priv->exit == PK_EXIT_ENUM_UNKNOWN)
@@ -1666,16 +2669,82 @@ pk_backend_job_finished (PkBackendJob *job)
 				   NULL);
 }
 
+/**
+ * pk_backend_job_reset_finished:
+ *
+ * Lets a job that finished successfully run its role again, so input that
+ * is too large for one go can be fed to the backend in chunks; the vfuncs
+ * stay connected and the job is not stopped in between.
+ **/
+void
+pk_backend_job_reset_finished (PkBackendJob *job)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (job->priv->finished);
+	g_return_if_fail (!job->priv->set_error);
+
+	job->priv->finished = FALSE;
+	job->priv->exit = PK_EXIT_ENUM_UNKNOWN;
+	job->priv->percentage = PK_BACKEND_PERCENTAGE_INVALID;
+	job->priv->status = PK_STATUS_ENUM_UNKNOWN;
+}
+
+/**
+ * pk_backend_job_reset_preempted:
+ *
+ * Gets a resumable job that was cancelled to make way for another
+ * transaction ready to run its role again. The backend sees a stop and a
+ * fresh start so it can drop its per-job state, and the cancellable is
+ * replaced as the old one stays cancelled. The emitted packages are kept
+ * so the client does not get the same ones twice.
+ **/
+void
+pk_backend_job_reset_preempted (PkBackendJob *job)
+{
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+	g_return_if_fail (job->priv->finished);
+
+	if (job->priv->started && job->priv->backend != NULL)
+		pk_backend_stop_job (job->priv->backend, job);
+
+	g_object_unref (job->priv->cancellable);
+	job->priv->cancellable = g_cancellable_new ();
+	pk_backend_job_reset_cancel (job);
+
+	job->priv->finished = FALSE;
+	job->priv->set_error = FALSE;
+	job->priv->last_error_code = PK_ERROR_ENUM_UNKNOWN;
+	job->priv->exit = PK_EXIT_ENUM_UNKNOWN;
+	job->priv->allow_cancel = TRUE;
+	job->priv->percentage = PK_BACKEND_PERCENTAGE_INVALID;
+	job->priv->status = PK_STATUS_ENUM_UNKNOWN;
+
+	/* the downloads start again */
+	g_mutex_lock (&job->priv->item_bytes_mutex);
+	if (job->priv->item_bytes != NULL)
+		g_hash_table_remove_all (job->priv->item_bytes);
+	g_mutex_unlock (&job->priv->item_bytes_mutex);
+}
+
 static void
 pk_backend_job_finalize (GObject *object)
 {
 	PkBackendJob *job;
+	PkBackendJobVFuncHelper *helper;
 
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (PK_IS_BACKEND_JOB (object));
 	g_return_if_fail (pk_is_thread_default ());
 	job = PK_BACKEND_JOB (object);
 
+	/* any events still queued have nobody to go to */
+	helper = g_atomic_pointer_get (&job->priv->pending_events);
+	while (helper != NULL) {
+		PkBackendJobVFuncHelper *next = helper->next;
+		pk_backend_job_vfunc_event_free (helper);
+		helper = next;
+	}
+
 	if (pk_backend_job_get_started (job)) {
 		g_warning ("finalized job without stopping it before");
 		pk_backend_stop_job (job->priv->backend, job);
@@ -1689,8 +2758,16 @@ pk_backend_job_finalize (GObject *object)
 	g_free (job->priv->pac);
 	g_free (job->priv->cmdline);
 	g_free (job->priv->locale);
+	g_free (job->priv->root);
 	g_free (job->priv->frontend_socket);
+	g_strfreev (job->priv->fields);
 	g_hash_table_unref (job->priv->emitted);
+	if (job->priv->item_bytes != NULL)
+		g_hash_table_unref (job->priv->item_bytes);
+	g_mutex_clear (&job->priv->item_bytes_mutex);
+	g_mutex_clear (&job->priv->cancel_mutex);
+	if (job->priv->plan_destroy != NULL)
+		job->priv->plan_destroy (job->priv->plan);
 	if (job->priv->params != NULL)
 		g_variant_unref (job->priv->params);
 	g_timer_destroy (job->priv->timer);
@@ -1722,7 +2799,9 @@ pk_backend_job_init (PkBackendJob *job)
 	job->priv->role = PK_ROLE_ENUM_UNKNOWN;
 	job->priv->status = PK_STATUS_ENUM_UNKNOWN;
 	job->priv->emitted = g_hash_table_new_full (g_str_hash, g_str_equal,
-	                                            g_free, (GDestroyNotify) g_object_unref);
+	                                            NULL, (GDestroyNotify) g_object_unref);
+	g_mutex_init (&job->priv->item_bytes_mutex);
+	g_mutex_init (&job->priv->cancel_mutex);
 }
 
 /**
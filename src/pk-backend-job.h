@@ -60,6 +60,7 @@ typedef enum {
 	PK_BACKEND_SIGNAL_LOCKED_CHANGED,
 	PK_BACKEND_SIGNAL_UPDATE_DETAIL,
 	PK_BACKEND_SIGNAL_CATEGORY,
+	PK_BACKEND_SIGNAL_DOWNLOAD_BYTES,
 	PK_BACKEND_SIGNAL_LAST
 } PkBackendJobSignal;
 
@@ -87,9 +88,20 @@ void		 pk_backend_job_set_backend		(PkBackendJob	*job,
 							 gpointer	 backend);
 GCancellable	*pk_backend_job_get_cancellable		(PkBackendJob	*job);
 gboolean	 pk_backend_job_is_cancelled		(PkBackendJob	*job);
+gboolean	 pk_backend_job_checkpoint		(PkBackendJob	*job,
+							 const gchar	*where);
+void		 pk_backend_job_set_cancel_requested	(PkBackendJob	*job);
+gint64		 pk_backend_job_get_cancel_requested	(PkBackendJob	*job);
+const gchar	*pk_backend_job_get_cancel_checkpoint	(PkBackendJob	*job);
 gpointer	 pk_backend_job_get_user_data		(PkBackendJob	*job);
 void		 pk_backend_job_set_user_data		(PkBackendJob	*job,
 							 gpointer	 user_data);
+void		 pk_backend_job_set_plan		(PkBackendJob	*job,
+							 gpointer	 plan,
+							 GDestroyNotify	 destroy);
+gpointer	 pk_backend_job_get_plan		(PkBackendJob	*job);
+gpointer	 pk_backend_job_steal_plan		(PkBackendJob	*job,
+							 GDestroyNotify	*destroy);
 PkBitfield	 pk_backend_job_get_transaction_flags	(PkBackendJob	*job);
 void		 pk_backend_job_set_transaction_flags	(PkBackendJob	*job,
 							 PkBitfield	 transaction_flags);
@@ -99,6 +111,9 @@ void		 pk_backend_job_set_parameters		(PkBackendJob	*job,
 gboolean	 pk_backend_job_get_background		(PkBackendJob	*job);
 void		 pk_backend_job_set_background		(PkBackendJob	*job,
 							 gboolean	 background);
+gboolean	 pk_backend_job_get_resumable		(PkBackendJob	*job);
+void		 pk_backend_job_set_resumable		(PkBackendJob	*job,
+							 gboolean	 resumable);
 gboolean	 pk_backend_job_get_interactive		(PkBackendJob	*job);
 void		 pk_backend_job_set_interactive		(PkBackendJob	*job,
 							 gboolean	 interactive);
@@ -123,6 +138,9 @@ void		 pk_backend_job_set_proxy		(PkBackendJob	*job,
 							 const gchar	*proxy_socks,
 							 const gchar	*no_proxy,
 							 const gchar	*pac);
+void		 pk_backend_job_set_download_rate	(PkBackendJob	*job,
+							 guint64	 download_rate);
+guint64		 pk_backend_job_get_download_rate	(PkBackendJob	*job);
 void		 pk_backend_job_set_uid			(PkBackendJob	*job,
 							 guint		 uid);
 guint		 pk_backend_job_get_uid			(PkBackendJob	*job);
@@ -131,10 +149,15 @@ void		 pk_backend_job_set_cmdline		(PkBackendJob	*job,
 const gchar	*pk_backend_job_get_cmdline		(PkBackendJob	*job);
 void		 pk_backend_job_set_locale		(PkBackendJob	*job,
 							 const gchar	*code);
+void		 pk_backend_job_set_root		(PkBackendJob	*job,
+							 const gchar	*root);
 void		 pk_backend_job_set_frontend_socket	(PkBackendJob	*job,
 							 const gchar	*frontend_socket);
 void		 pk_backend_job_set_cache_age		(PkBackendJob	*job,
 							 guint		 cache_age);
+void		 pk_backend_job_set_page		(PkBackendJob	*job,
+							 guint		 limit,
+							 guint		 offset);
 const gchar	*pk_backend_job_get_proxy_ftp		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_proxy_http		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_proxy_https		(PkBackendJob	*job);
@@ -142,8 +165,31 @@ const gchar	*pk_backend_job_get_proxy_socks		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_no_proxy		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_pac			(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_locale		(PkBackendJob	*job);
+const gchar	*pk_backend_job_get_root		(PkBackendJob	*job);
 const gchar	*pk_backend_job_get_frontend_socket	(PkBackendJob	*job);
 guint		 pk_backend_job_get_cache_age		(PkBackendJob	*job);
+gboolean	 pk_backend_job_is_cache_fresh		(PkBackendJob	*job,
+							 gint64		 last_refresh);
+gboolean	 pk_backend_job_fetch_from_peers	(PkBackendJob	*job,
+							 const gchar	*package_id,
+							 const gchar	*filename,
+							 goffset	 size);
+void		 pk_backend_job_share_with_peers	(PkBackendJob	*job,
+							 const gchar	*package_id,
+							 const gchar	*filename);
+guint		 pk_backend_job_get_limit		(PkBackendJob	*job);
+guint		 pk_backend_job_get_offset		(PkBackendJob	*job);
+gboolean	 pk_backend_job_get_limit_reached	(PkBackendJob	*job);
+void		 pk_backend_job_set_deadline		(PkBackendJob	*job,
+							 gint64		 deadline);
+gint64		 pk_backend_job_get_deadline		(PkBackendJob	*job);
+gint64		 pk_backend_job_get_budget		(PkBackendJob	*job);
+void		 pk_backend_job_set_partial		(PkBackendJob	*job);
+gboolean	 pk_backend_job_get_partial		(PkBackendJob	*job);
+void		 pk_backend_job_set_fields		(PkBackendJob	*job,
+							 gchar		**fields);
+gboolean	 pk_backend_job_wants_field		(PkBackendJob	*job,
+							 const gchar	*field);
 
 /* transaction vfuncs */
 typedef void	 (*PkBackendJobVFunc)			(PkBackendJob	*job,
@@ -166,9 +212,27 @@ gboolean	 pk_backend_job_thread_create		(PkBackendJob	*job,
 							 PkBackendJobThreadFunc func,
 							 gpointer	 user_data,
 							 GDestroyNotify destroy_func);
+gboolean	 pk_backend_job_thread_create_for_role	(PkBackendJob	*job,
+							 PkRoleEnum	 role,
+							 PkBackendJobThreadFunc func,
+							 gpointer	 user_data,
+							 GDestroyNotify destroy_func);
+
+/* async helpers */
+typedef void	(*PkBackendJobAsyncFunc)		(PkBackendJob	*job,
+							 GVariant	*params,
+							 GMainContext	*context,
+							 gpointer	 user_data);
+gboolean	 pk_backend_job_async_create		(PkBackendJob	*job,
+							 PkBackendJobAsyncFunc func,
+							 gpointer	 user_data,
+							 GDestroyNotify destroy_func);
+void		 pk_backend_job_async_finished		(PkBackendJob	*job);
 
 /* signal helpers */
 void		 pk_backend_job_finished		(PkBackendJob	*job);
+void		 pk_backend_job_reset_finished		(PkBackendJob	*job);
+void		 pk_backend_job_reset_preempted		(PkBackendJob	*job);
 void		 pk_backend_job_package			(PkBackendJob	*job,
 							 PkInfoEnum	 info,
 							 const gchar	*package_id,
@@ -178,6 +242,8 @@ void		 pk_backend_job_package_full		(PkBackendJob	*job,
 							 const gchar	*package_id,
 							 const gchar	*summary,
 							 PkInfoEnum	 update_severity);
+void		 pk_backend_job_packages		(PkBackendJob	*job,
+							 GPtrArray	*packages);
 void		 pk_backend_job_repo_detail		(PkBackendJob	*job,
 							 const gchar	*repo_id,
 							 const gchar	*description,
@@ -215,9 +281,13 @@ void		 pk_backend_job_details_full		(PkBackendJob	*job,
 							 const gchar	*url,
 							 gulong		 size,
 							 guint64	 download_size);
+void		 pk_backend_job_details_array		(PkBackendJob	*job,
+							 GPtrArray	*details);
 void	 	 pk_backend_job_files 			(PkBackendJob	*job,
 							 const gchar	*package_id,
 							 gchar	 	**files);
+void		 pk_backend_job_files_array		(PkBackendJob	*job,
+							 GPtrArray	*files);
 void	 	 pk_backend_job_distro_upgrade		(PkBackendJob	*job,
 							 PkDistroUpgradeEnum type,
 							 const gchar 	*name,
@@ -264,9 +334,18 @@ void		 pk_backend_job_set_speed		(PkBackendJob	*job,
 							 guint		 speed);
 void		 pk_backend_job_set_download_size_remaining (PkBackendJob	*job,
 							 guint64	 download_size_remaining);
+void		 pk_backend_job_set_item_bytes		(PkBackendJob	*job,
+							 const gchar	*package_id,
+							 guint64	 bytes_done,
+							 guint64	 bytes_total);
 void		 pk_backend_job_set_started		(PkBackendJob *job,
 							 gboolean started);
 gboolean	 pk_backend_job_get_started		(PkBackendJob *job);
+gint64		 pk_backend_job_get_finished_time	(PkBackendJob *job);
+void		 pk_backend_job_add_cpu_time		(PkBackendJob *job,
+							 gint64 cpu_time);
+gint64		 pk_backend_job_get_cpu_time		(PkBackendJob *job);
+gint64		 pk_backend_job_get_memory_growth	(PkBackendJob *job);
 
 G_END_DECLS
 
@@ -52,17 +52,32 @@
 
 #define	PK_UNSAFE_DELIMITERS	"\\\f\r\t"
 
+/* one helper process, idle or running a job */
+typedef struct {
+	PkBackendSpawn		*backend_spawn;	/* not a ref */
+	PkSpawn			*spawn;
+	PkBackendJob		*job;		/* NULL when idle */
+	guint			 kill_id;
+	gboolean		 finished;
+	gboolean		 used;		/* has run at least one job */
+	gboolean		 stale;		/* exit once the job is done */
+	gint64			 cpu_time_start; /* of the helper, for the job */
+} PkBackendSpawnWorker;
+
 struct PkBackendSpawnPrivate
 {
-	PkSpawn			*spawn;
-	PkBackend		*backend;
-	PkBackendJob		*job;
+	GPtrArray		*workers;
 	gchar			*name;
-	guint			 kill_id;
 	GKeyFile		*conf;
-	gboolean		 finished;
 	gboolean		 allow_sigkill;
-	gboolean		 is_busy;
+	gboolean		 raw_fields;
+	guint			 pool_size;	/* idle helpers to keep warm */
+	guint			 max_workers;	/* helpers running jobs at once */
+	guint			 refill_id;
+	gchar			*pool_argv0;
+	gchar			**pool_envp;
+	gboolean		 pool_background;
+	gboolean		 pool_unsupported;
 	PkBackendSpawnFilterFunc stdout_func;
 	PkBackendSpawnFilterFunc stderr_func;
 };
@@ -85,32 +100,94 @@ pk_backend_spawn_set_filter_stderr (PkBackendSpawn *backend_spawn, PkBackendSpaw
 	return TRUE;
 }
 
+static guint
+pk_backend_spawn_get_idle_count (PkBackendSpawn *backend_spawn)
+{
+	guint cnt = 0;
+	PkBackendSpawnWorker *worker;
+
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		if (worker->job == NULL && pk_spawn_is_running (worker->spawn))
+			cnt++;
+	}
+	return cnt;
+}
+
+static guint
+pk_backend_spawn_get_busy_count (PkBackendSpawn *backend_spawn)
+{
+	guint cnt = 0;
+	PkBackendSpawnWorker *worker;
+
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		if (worker->job != NULL)
+			cnt++;
+	}
+	return cnt;
+}
+
+static PkBackendSpawnWorker *
+pk_backend_spawn_get_worker_for_job (PkBackendSpawn *backend_spawn, PkBackendJob *job)
+{
+	PkBackendSpawnWorker *worker;
+
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		if (worker->job == job)
+			return worker;
+	}
+	return NULL;
+}
+
+static void pk_backend_spawn_refill_pool (PkBackendSpawn *backend_spawn);
+
 static gboolean
-pk_backend_spawn_exit_timeout_cb (PkBackendSpawn *backend_spawn)
+pk_backend_spawn_exit_timeout_cb (PkBackendSpawnWorker *worker)
 {
-	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+	PkBackendSpawn *backend_spawn = worker->backend_spawn;
+
+	worker->kill_id = 0;
+
+	/* keep it running if it is part of the warm pool */
+	if (pk_backend_spawn_get_idle_count (backend_spawn) <= backend_spawn->priv->pool_size) {
+		g_debug ("keeping idle dispatcher as part of the pool");
+		return FALSE;
+	}
 
 	/* only try to close if running */
-	if (pk_spawn_is_running (backend_spawn->priv->spawn)) {
+	if (worker->job == NULL && pk_spawn_is_running (worker->spawn)) {
 		g_debug ("closing dispatcher as running and is idle");
-		pk_spawn_exit (backend_spawn->priv->spawn);
+		pk_spawn_exit (worker->spawn);
+	}
+	return FALSE;
+}
+
+static gboolean
+pk_backend_spawn_stale_cb (PkBackendSpawnWorker *worker)
+{
+	worker->kill_id = 0;
+	worker->stale = FALSE;
+	if (worker->job == NULL && pk_spawn_is_running (worker->spawn)) {
+		g_debug ("closing dispatcher as it has out of date data");
+		pk_spawn_exit (worker->spawn);
 	}
-	backend_spawn->priv->kill_id = 0;
 	return FALSE;
 }
 
 static void
-pk_backend_spawn_start_kill_timer (PkBackendSpawn *backend_spawn)
+pk_backend_spawn_start_kill_timer (PkBackendSpawnWorker *worker)
 {
 	gint timeout;
-	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+	PkBackendSpawnPrivate *priv = worker->backend_spawn->priv;
 
 	/* we finished okay, so we don't need to emulate Finished() for a crashing script */
-	priv->finished = TRUE;
+	worker->finished = TRUE;
 	g_debug ("backend marked as finished, so starting kill timer");
 
-	if (priv->kill_id > 0)
-		g_source_remove (priv->kill_id);
+	if (worker->kill_id > 0)
+		g_source_remove (worker->kill_id);
 
 	/* get policy timeout */
 	timeout = g_key_file_get_integer (priv->conf, "Daemon", "BackendShutdownTimeout", NULL);
@@ -119,471 +196,631 @@ pk_backend_spawn_start_kill_timer (PkBackendSpawn *backend_spawn)
 		timeout = 5;
 	}
 
-	/* close down the dispatcher if it is still open after this much time */
-	priv->kill_id = g_timeout_add_seconds (timeout, (GSourceFunc) pk_backend_spawn_exit_timeout_cb, backend_spawn);
-	g_source_set_name_by_id (priv->kill_id, "[PkBackendSpawn] exit");
+	/* close down the dispatcher if it is still open after this much time,
+	 * or straight away if what it loaded is out of date */
+	if (worker->stale) {
+		worker->kill_id = g_idle_add ((GSourceFunc) pk_backend_spawn_stale_cb, worker);
+		g_source_set_name_by_id (worker->kill_id, "[PkBackendSpawn] stale");
+		return;
+	}
+	worker->kill_id = g_timeout_add_seconds (timeout, (GSourceFunc) pk_backend_spawn_exit_timeout_cb, worker);
+	g_source_set_name_by_id (worker->kill_id, "[PkBackendSpawn] exit");
 }
 
+/* the most fields any command has, plus one so we can spot extra fields */
+#define PK_BACKEND_SPAWN_MAX_SECTIONS	14
+
+typedef gboolean (*PkBackendSpawnCommandFunc)	(PkBackendSpawn	*backend_spawn,
+						 PkBackendJob	*job,
+						 gchar		**sections,
+						 GError		**error);
+
+typedef struct {
+	const gchar			*name;
+	guint				 size;	/* including the command */
+	PkBackendSpawnCommandFunc	 func;
+} PkBackendSpawnCommand;
+
 static gboolean
-pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
-			       PkBackendJob *job,
-			       const gchar *line,
-			       GError **error)
+pk_backend_spawn_check_utf8 (PkBackendSpawn *backend_spawn, gchar *text, GError **error)
+{
+	/* records carry fields verbatim, lines cannot contain delimiters */
+	if (!backend_spawn->priv->raw_fields)
+		g_strdelimit (text, PK_UNSAFE_DELIMITERS, ' ');
+	if (!g_utf8_validate (text, -1, NULL)) {
+		g_set_error (error, 1, 0,
+			     "text '%s' was not valid UTF8!",
+			     text);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+pk_backend_spawn_unescape_newlines (PkBackendSpawn *backend_spawn, gchar *text)
+{
+	/* convert ; to \n as we can't emit them on stdout */
+	if (!backend_spawn->priv->raw_fields)
+		g_strdelimit (text, ";", '\n');
+}
+
+static gboolean
+pk_backend_spawn_parse_package (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				gchar **sections, GError **error)
 {
-	guint size;
-	gchar *command;
-	gchar *text;
-	guint64 speed;
-	guint64 download_size_remaining;
 	PkInfoEnum info;
-	PkRestartEnum restart;
+
+	if (pk_package_id_check (sections[2]) == FALSE) {
+		g_set_error_literal (error, 1, 0, "invalid package_id");
+		return FALSE;
+	}
+	info = pk_info_enum_from_string (sections[1]);
+	if (info == PK_INFO_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Info enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	if (!pk_backend_spawn_check_utf8 (backend_spawn, sections[3], error))
+		return FALSE;
+	pk_backend_job_package (job, info, sections[2], sections[3]);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_details (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				gchar **sections, GError **error)
+{
 	PkGroupEnum group;
 	gulong package_size;
-	gint percentage;
-	PkErrorEnum error_enum;
-	PkStatusEnum status_enum;
-	PkRestartEnum restart_enum;
-	PkSigTypeEnum sig_type;
-	PkUpdateStateEnum update_state_enum;
-	PkMediaTypeEnum media_type_enum;
-	PkDistroUpgradeEnum distro_upgrade_enum;
-	PkBackendSpawnPrivate *priv = backend_spawn->priv;
-	g_auto(GStrv) sections = NULL;
 
-	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+	group = pk_group_enum_from_string (sections[4]);
 
-	/* check if output line */
-	if (line == NULL)
+	/* ITS4: ignore, checked for overflow */
+	package_size = atol (sections[7]);
+	if (package_size > 1073741824) {
+		g_set_error_literal (error, 1, 0,
+				     "package size cannot be that large");
+		return FALSE;
+	}
+	if (!pk_backend_spawn_check_utf8 (backend_spawn, sections[5], error))
 		return FALSE;
 
-	/* split by tab */
-	sections = g_strsplit (line, "\t", 0);
-	command = sections[0];
+	pk_backend_spawn_unescape_newlines (backend_spawn, sections[5]);
+	pk_backend_job_details (job, sections[1], sections[2], sections[3],
+				group, sections[5], sections[6], package_size);
+	return TRUE;
+}
 
-	/* get size */
-	size = g_strv_length (sections);
+static gboolean
+pk_backend_spawn_parse_finished (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				 gchar **sections, GError **error)
+{
+	PkBackendSpawnWorker *worker;
 
-	if (g_strcmp0 (command, "package") == 0) {
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (pk_package_id_check (sections[2]) == FALSE) {
-			g_set_error_literal (error, 1, 0, "invalid package_id");
-			return FALSE;
-		}
-		info = pk_info_enum_from_string (sections[1]);
-		if (info == PK_INFO_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Info enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		g_strdelimit (sections[3], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[3], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[3]);
-			return FALSE;
-		}
-		pk_backend_job_package (job, info, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "details") == 0) {
-		if (size != 8) {
-			g_set_error (error, 1, 0,
-				     "invalid command'%s', size %i",
-				     command, size);
-			return FALSE;
-		}
-		group = pk_group_enum_from_string (sections[4]);
-
-		/* ITS4: ignore, checked for overflow */
-		package_size = atol (sections[7]);
-		if (package_size > 1073741824) {
-			g_set_error_literal (error, 1, 0,
-					     "package size cannot be that large");
-			return FALSE;
-		}
-		g_strdelimit (sections[5], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[4], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[5]);
-			return FALSE;
-		}
-		text = g_strdup (sections[5]);
-		/* convert ; to \n as we can't emit them on stdout */
-		g_strdelimit (text, ";", '\n');
-		pk_backend_job_details (job, sections[1], sections[2], sections[3],
-					group, text, sections[6], package_size);
-		g_free (text);
-	} else if (g_strcmp0 (command, "finished") == 0) {
-		if (size != 1) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		pk_backend_job_finished (job);
-		priv->is_busy = FALSE;
+	/* the helper is kept running, so charge what it used for this job */
+	worker = pk_backend_spawn_get_worker_for_job (backend_spawn, job);
+	if (worker != NULL) {
+		pk_backend_job_add_cpu_time (job, pk_spawn_get_cpu_time (worker->spawn) -
+						  worker->cpu_time_start);
+	}
 
-		/* from this point on, we can start the kill timer */
-		pk_backend_spawn_start_kill_timer (backend_spawn);
+	pk_backend_job_finished (job);
 
-	} else if (g_strcmp0 (command, "files") == 0) {
-		g_auto(GStrv) tmp = NULL;
-		if (size != 3) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		tmp = g_strsplit (sections[2], ";", -1);
-		pk_backend_job_files (job, sections[1], tmp);
-	} else if (g_strcmp0 (command, "repo-detail") == 0) {
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		g_strdelimit (sections[2], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[2], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[2]);
-			return FALSE;
-		}
-		if (g_strcmp0 (sections[3], "true") == 0) {
-			pk_backend_job_repo_detail (job, sections[1], sections[2], TRUE);
-		} else if (g_strcmp0 (sections[3], "false") == 0) {
-			pk_backend_job_repo_detail (job, sections[1], sections[2], FALSE);
-		} else {
-			g_set_error (error, 1, 0, "invalid qualifier '%s'", sections[3]);
-			return FALSE;
-		}
-	} else if (g_strcmp0 (command, "updatedetail") == 0) {
-		g_auto(GStrv) updates = NULL;
-		g_auto(GStrv) obsoletes = NULL;
-		g_auto(GStrv) vendor_urls = NULL;
-		g_auto(GStrv) bugzilla_urls = NULL;
-		g_auto(GStrv) cve_urls = NULL;
-		if (size != 13) {
-			g_set_error (error, 1, 0, "invalid command '%s', size %i", command, size);
-			return FALSE;
-		}
-		restart = pk_restart_enum_from_string (sections[7]);
-		if (restart == PK_RESTART_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[7]);
-			return FALSE;
-		}
-		g_strdelimit (sections[12], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[12], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[12]);
-			return FALSE;
-		}
-		update_state_enum = pk_update_state_enum_from_string (sections[10]);
-		/* convert ; to \n as we can't emit them on stdout */
-		g_strdelimit (sections[8], ";", '\n');
-		g_strdelimit (sections[9], ";", '\n');
-		updates = g_strsplit (sections[2], "&", -1);
-		obsoletes = g_strsplit (sections[3], "&", -1);
-		vendor_urls = g_strsplit (sections[4], ";", -1);
-		bugzilla_urls = g_strsplit (sections[5], ";", -1);
-		cve_urls = g_strsplit (sections[6], ";", -1);
-		pk_backend_job_update_detail (job,
-					  sections[1],
-					  updates,
-					  obsoletes,
-					  vendor_urls,
-					  bugzilla_urls,
-					  cve_urls,
-					  restart,
-					  sections[8],
-					  sections[9],
-					  update_state_enum,
-					  sections[11],
-					  sections[12]);
-	} else if (g_strcmp0 (command, "percentage") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_strtoint (sections[1], &percentage)) {
-			g_set_error (error, 1, 0, "invalid percentage value %s", sections[1]);
-			return FALSE;
-		} else if (percentage < 0 || percentage > 100) {
-			g_set_error (error, 1, 0, "invalid percentage value %i", percentage);
-			return FALSE;
-		} else {
-			pk_backend_job_set_percentage (job, percentage);
-		}
-	} else if (g_strcmp0 (command, "item-progress") == 0) {
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_package_id_check (sections[1])) {
-			g_set_error (error, 1, 0, "invalid package_id");
-			return FALSE;
-		}
-		status_enum = pk_status_enum_from_string (sections[2]);
-		if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[2]);
-			return FALSE;
-		}
-		if (!pk_strtoint (sections[3], &percentage)) {
-			g_set_error (error, 1, 0, "invalid item-progress value %s", sections[3]);
-			return FALSE;
-		}
-		if (percentage < 0 || percentage > 100) {
-			g_set_error (error, 1, 0, "invalid item-progress value %i", percentage);
-			return FALSE;
-		}
-		pk_backend_job_set_item_progress (job,
-						  sections[1],
-						  status_enum,
-						  percentage);
-	} else if (g_strcmp0 (command, "error") == 0) {
-		if (size != 3) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		error_enum = pk_error_enum_from_string (sections[1]);
-		if (error_enum == PK_ERROR_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Error enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		/* convert back all the ;'s to newlines */
-		text = g_strdup (sections[2]);
+	/* from this point on, we can start the kill timer */
+	if (worker != NULL) {
+		worker->job = NULL;
+		pk_backend_spawn_start_kill_timer (worker);
+		pk_backend_spawn_refill_pool (backend_spawn);
+	}
+	return TRUE;
+}
 
-		/* convert ; to \n as we can't emit them on stdout */
-		g_strdelimit (text, ";", '\n');
+static gboolean
+pk_backend_spawn_parse_files (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+			      gchar **sections, GError **error)
+{
+	g_auto(GStrv) tmp = NULL;
 
-		/* convert % else we try to format them */
-		g_strdelimit (text, "%", '$');
+	tmp = g_strsplit (sections[2], ";", -1);
+	pk_backend_job_files (job, sections[1], tmp);
+	return TRUE;
+}
 
-		pk_backend_job_error_code (job, error_enum, "%s", text);
-		g_free (text);
-	} else if (g_strcmp0 (command, "requirerestart") == 0) {
-		if (size != 3) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		restart_enum = pk_restart_enum_from_string (sections[1]);
-		if (restart_enum == PK_RESTART_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		if (!pk_package_id_check (sections[2])) {
-			g_set_error (error, 1, 0, "invalid package_id");
-			return FALSE;
-		}
-		pk_backend_job_require_restart (job, restart_enum, sections[2]);
-	} else if (g_strcmp0 (command, "status") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		status_enum = pk_status_enum_from_string (sections[1]);
-		if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		pk_backend_job_set_status (job, status_enum);
-	} else if (g_strcmp0 (command, "speed") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_strtouint64 (sections[1], &speed)) {
-			g_set_error (error, 1, 0,
-				     "failed to parse speed: '%s'",
-				     sections[1]);
-			return FALSE;
-		}
-		pk_backend_job_set_speed (job, speed);
-	} else if (g_strcmp0 (command, "download-size-remaining") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (!pk_strtouint64 (sections[1], &download_size_remaining)) {
-			g_set_error (error, 1, 0,
-				     "failed to parse download_size_remaining: '%s'",
-				     sections[1]);
-			return FALSE;
-		}
-		pk_backend_job_set_download_size_remaining (job, download_size_remaining);
-	} else if (g_strcmp0 (command, "allow-cancel") == 0) {
-		if (size != 2) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (g_strcmp0 (sections[1], "true") == 0) {
-			pk_backend_job_set_allow_cancel (job, TRUE);
-		} else if (g_strcmp0 (sections[1], "false") == 0) {
-			pk_backend_job_set_allow_cancel (job, FALSE);
-		} else {
-			g_set_error (error, 1, 0, "invalid section '%s'", sections[1]);
-			return FALSE;
-		}
-	} else if (g_strcmp0 (command, "no-percentage-updates") == 0) {
-		if (size != 1) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
-	} else if (g_strcmp0 (command, "repo-signature-required") == 0) {
+static gboolean
+pk_backend_spawn_parse_repo_detail (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				    gchar **sections, GError **error)
+{
+	if (!pk_backend_spawn_check_utf8 (backend_spawn, sections[2], error))
+		return FALSE;
+	if (g_strcmp0 (sections[3], "true") == 0) {
+		pk_backend_job_repo_detail (job, sections[1], sections[2], TRUE);
+	} else if (g_strcmp0 (sections[3], "false") == 0) {
+		pk_backend_job_repo_detail (job, sections[1], sections[2], FALSE);
+	} else {
+		g_set_error (error, 1, 0, "invalid qualifier '%s'", sections[3]);
+		return FALSE;
+	}
+	return TRUE;
+}
 
-		if (size != 9) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+static gboolean
+pk_backend_spawn_parse_update_detail (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				      gchar **sections, GError **error)
+{
+	PkRestartEnum restart;
+	PkUpdateStateEnum update_state_enum;
+	g_auto(GStrv) updates = NULL;
+	g_auto(GStrv) obsoletes = NULL;
+	g_auto(GStrv) vendor_urls = NULL;
+	g_auto(GStrv) bugzilla_urls = NULL;
+	g_auto(GStrv) cve_urls = NULL;
+
+	restart = pk_restart_enum_from_string (sections[7]);
+	if (restart == PK_RESTART_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[7]);
+		return FALSE;
+	}
+	if (!pk_backend_spawn_check_utf8 (backend_spawn, sections[12], error))
+		return FALSE;
+	update_state_enum = pk_update_state_enum_from_string (sections[10]);
+	pk_backend_spawn_unescape_newlines (backend_spawn, sections[8]);
+	pk_backend_spawn_unescape_newlines (backend_spawn, sections[9]);
+	updates = g_strsplit (sections[2], "&", -1);
+	obsoletes = g_strsplit (sections[3], "&", -1);
+	vendor_urls = g_strsplit (sections[4], ";", -1);
+	bugzilla_urls = g_strsplit (sections[5], ";", -1);
+	cve_urls = g_strsplit (sections[6], ";", -1);
+	pk_backend_job_update_detail (job,
+				      sections[1],
+				      updates,
+				      obsoletes,
+				      vendor_urls,
+				      bugzilla_urls,
+				      cve_urls,
+				      restart,
+				      sections[8],
+				      sections[9],
+				      update_state_enum,
+				      sections[11],
+				      sections[12]);
+	return TRUE;
+}
 
-		sig_type = pk_sig_type_enum_from_string (sections[8]);
-		if (sig_type == PK_SIGTYPE_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "Sig enum not recognised, and hence ignored: '%s'", sections[8]);
-			return FALSE;
-		}
-		if (pk_strzero (sections[1])) {
-			g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		if (pk_strzero (sections[2])) {
-			g_set_error (error, 1, 0, "repository name blank, and hence ignored: '%s'", sections[2]);
-			return FALSE;
-		}
+static gboolean
+pk_backend_spawn_parse_percentage (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				   gchar **sections, GError **error)
+{
+	gint percentage;
 
-		/* pass _all_ of the data */
-		pk_backend_job_repo_signature_required (job, sections[1],
-							  sections[2], sections[3], sections[4],
-							  sections[5], sections[6], sections[7], sig_type);
-	} else if (g_strcmp0 (command, "eula-required") == 0) {
+	if (!pk_strtoint (sections[1], &percentage)) {
+		g_set_error (error, 1, 0, "invalid percentage value %s", sections[1]);
+		return FALSE;
+	}
+	if (percentage < 0 || percentage > 100) {
+		g_set_error (error, 1, 0, "invalid percentage value %i", percentage);
+		return FALSE;
+	}
+	pk_backend_job_set_percentage (job, percentage);
+	return TRUE;
+}
 
-		if (size != 5) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+static gboolean
+pk_backend_spawn_parse_item_progress (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				      gchar **sections, GError **error)
+{
+	gint percentage;
+	PkStatusEnum status_enum;
 
-		if (pk_strzero (sections[1])) {
-			g_set_error (error, 1, 0, "eula_id blank, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
+	if (!pk_package_id_check (sections[1])) {
+		g_set_error (error, 1, 0, "invalid package_id");
+		return FALSE;
+	}
+	status_enum = pk_status_enum_from_string (sections[2]);
+	if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[2]);
+		return FALSE;
+	}
+	if (!pk_strtoint (sections[3], &percentage)) {
+		g_set_error (error, 1, 0, "invalid item-progress value %s", sections[3]);
+		return FALSE;
+	}
+	if (percentage < 0 || percentage > 100) {
+		g_set_error (error, 1, 0, "invalid item-progress value %i", percentage);
+		return FALSE;
+	}
+	pk_backend_job_set_item_progress (job,
+					  sections[1],
+					  status_enum,
+					  percentage);
+	return TRUE;
+}
 
-		if (pk_strzero (sections[2])) {
-			g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[2]);
-			return FALSE;
-		}
+static gboolean
+pk_backend_spawn_parse_error (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+			      gchar **sections, GError **error)
+{
+	PkErrorEnum error_enum;
 
-		if (pk_strzero (sections[4])) {
-			g_set_error (error, 1, 0, "agreement name blank, and hence ignored: '%s'", sections[4]);
-			return FALSE;
-		}
+	error_enum = pk_error_enum_from_string (sections[1]);
+	if (error_enum == PK_ERROR_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Error enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
 
-		pk_backend_job_eula_required (job, sections[1], sections[2], sections[3], sections[4]);
-	} else if (g_strcmp0 (command, "media-change-required") == 0) {
+	pk_backend_spawn_unescape_newlines (backend_spawn, sections[2]);
 
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+	/* convert % else we try to format them */
+	g_strdelimit (sections[2], "%", '$');
 
-		media_type_enum = pk_media_type_enum_from_string (sections[1]);
-		if (media_type_enum == PK_MEDIA_TYPE_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "media type enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
+	pk_backend_job_error_code (job, error_enum, "%s", sections[2]);
+	return TRUE;
+}
 
-		pk_backend_job_media_change_required (job, media_type_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "distro-upgrade") == 0) {
+static gboolean
+pk_backend_spawn_parse_require_restart (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+					gchar **sections, GError **error)
+{
+	PkRestartEnum restart_enum;
 
-		if (size != 4) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
+	restart_enum = pk_restart_enum_from_string (sections[1]);
+	if (restart_enum == PK_RESTART_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Restart enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	if (!pk_package_id_check (sections[2])) {
+		g_set_error (error, 1, 0, "invalid package_id");
+		return FALSE;
+	}
+	pk_backend_job_require_restart (job, restart_enum, sections[2]);
+	return TRUE;
+}
 
-		distro_upgrade_enum = pk_distro_upgrade_enum_from_string (sections[1]);
-		if (distro_upgrade_enum == PK_DISTRO_UPGRADE_ENUM_UNKNOWN) {
-			g_set_error (error, 1, 0, "distro upgrade enum not recognised, and hence ignored: '%s'", sections[1]);
-			return FALSE;
-		}
-		g_strdelimit (sections[3], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[3], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[3]);
-			return FALSE;
-		}
+static gboolean
+pk_backend_spawn_parse_status (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+			       gchar **sections, GError **error)
+{
+	PkStatusEnum status_enum;
 
-		pk_backend_job_distro_upgrade (job, distro_upgrade_enum, sections[2], sections[3]);
-	} else if (g_strcmp0 (command, "category") == 0) {
+	status_enum = pk_status_enum_from_string (sections[1]);
+	if (status_enum == PK_STATUS_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Status enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	pk_backend_job_set_status (job, status_enum);
+	return TRUE;
+}
 
-		if (size != 6) {
-			g_set_error (error, 1, 0, "invalid command'%s', size %i", command, size);
-			return FALSE;
-		}
-		if (g_strcmp0 (sections[1], sections[2]) == 0) {
-			g_set_error_literal (error, 1, 0, "cat_id cannot be the same as parent_id");
-			return FALSE;
-		}
-		if (pk_strzero (sections[2])) {
-			g_set_error_literal (error, 1, 0, "cat_id cannot not blank");
-			return FALSE;
-		}
-		if (pk_strzero (sections[3])) {
-			g_set_error_literal (error, 1, 0, "name cannot not blank");
-			return FALSE;
-		}
-		g_strdelimit (sections[4], PK_UNSAFE_DELIMITERS, ' ');
-		if (!g_utf8_validate (sections[4], -1, NULL)) {
-			g_set_error (error, 1, 0,
-				     "text '%s' was not valid UTF8!",
-				     sections[4]);
-			return FALSE;
-		}
-		if (pk_strzero (sections[5])) {
-			g_set_error_literal (error, 1, 0, "icon cannot not blank");
-			return FALSE;
-		}
-		if (g_str_has_prefix (sections[5], "/")) {
-			g_set_error (error, 1, 0, "icon '%s' should be a named icon, not a path", sections[5]);
-			return FALSE;
-		}
-		pk_backend_job_category (job, sections[1], sections[2], sections[3], sections[4], sections[5]);
+static gboolean
+pk_backend_spawn_parse_speed (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+			      gchar **sections, GError **error)
+{
+	guint64 speed;
+
+	if (!pk_strtouint64 (sections[1], &speed)) {
+		g_set_error (error, 1, 0,
+			     "failed to parse speed: '%s'",
+			     sections[1]);
+		return FALSE;
+	}
+	pk_backend_job_set_speed (job, speed);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_download_size_remaining (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+						gchar **sections, GError **error)
+{
+	guint64 download_size_remaining;
+
+	if (!pk_strtouint64 (sections[1], &download_size_remaining)) {
+		g_set_error (error, 1, 0,
+			     "failed to parse download_size_remaining: '%s'",
+			     sections[1]);
+		return FALSE;
+	}
+	pk_backend_job_set_download_size_remaining (job, download_size_remaining);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_allow_cancel (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				     gchar **sections, GError **error)
+{
+	if (g_strcmp0 (sections[1], "true") == 0) {
+		pk_backend_job_set_allow_cancel (job, TRUE);
+	} else if (g_strcmp0 (sections[1], "false") == 0) {
+		pk_backend_job_set_allow_cancel (job, FALSE);
 	} else {
-		g_set_error (error, 1, 0, "invalid command '%s'", command);
+		g_set_error (error, 1, 0, "invalid section '%s'", sections[1]);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_no_percentage_updates (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+					      gchar **sections, GError **error)
+{
+	pk_backend_job_set_percentage (job, PK_BACKEND_PERCENTAGE_INVALID);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_repo_signature_required (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+						gchar **sections, GError **error)
+{
+	PkSigTypeEnum sig_type;
+
+	sig_type = pk_sig_type_enum_from_string (sections[8]);
+	if (sig_type == PK_SIGTYPE_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "Sig enum not recognised, and hence ignored: '%s'", sections[8]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[1])) {
+		g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[2])) {
+		g_set_error (error, 1, 0, "repository name blank, and hence ignored: '%s'", sections[2]);
+		return FALSE;
+	}
+
+	/* pass _all_ of the data */
+	pk_backend_job_repo_signature_required (job, sections[1],
+						sections[2], sections[3], sections[4],
+						sections[5], sections[6], sections[7], sig_type);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_eula_required (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				      gchar **sections, GError **error)
+{
+	if (pk_strzero (sections[1])) {
+		g_set_error (error, 1, 0, "eula_id blank, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[2])) {
+		g_set_error (error, 1, 0, "package_id blank, and hence ignored: '%s'", sections[2]);
+		return FALSE;
+	}
+	if (pk_strzero (sections[4])) {
+		g_set_error (error, 1, 0, "agreement name blank, and hence ignored: '%s'", sections[4]);
+		return FALSE;
+	}
+	pk_backend_job_eula_required (job, sections[1], sections[2], sections[3], sections[4]);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_media_change_required (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+					      gchar **sections, GError **error)
+{
+	PkMediaTypeEnum media_type_enum;
+
+	media_type_enum = pk_media_type_enum_from_string (sections[1]);
+	if (media_type_enum == PK_MEDIA_TYPE_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "media type enum not recognised, and hence ignored: '%s'", sections[1]);
+		return FALSE;
+	}
+	pk_backend_job_media_change_required (job, media_type_enum, sections[2], sections[3]);
+	return TRUE;
+}
+
+static gboolean
+pk_backend_spawn_parse_distro_upgrade (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				       gchar **sections, GError **error)
+{
+	PkDistroUpgradeEnum distro_upgrade_enum;
+
+	distro_upgrade_enum = pk_distro_upgrade_enum_from_string (sections[1]);
+	if (distro_upgrade_enum == PK_DISTRO_UPGRADE_ENUM_UNKNOWN) {
+		g_set_error (error, 1, 0, "distro upgrade enum not recognised, and hence ignored: '%s'", sections[1]);
 		return FALSE;
 	}
+	if (!pk_backend_spawn_check_utf8 (backend_spawn, sections[3], error))
+		return FALSE;
+	pk_backend_job_distro_upgrade (job, distro_upgrade_enum, sections[2], sections[3]);
 	return TRUE;
 }
 
+static gboolean
+pk_backend_spawn_parse_category (PkBackendSpawn *backend_spawn, PkBackendJob *job,
+				 gchar **sections, GError **error)
+{
+	if (g_strcmp0 (sections[1], sections[2]) == 0) {
+		g_set_error_literal (error, 1, 0, "cat_id cannot be the same as parent_id");
+		return FALSE;
+	}
+	if (pk_strzero (sections[2])) {
+		g_set_error_literal (error, 1, 0, "cat_id cannot not blank");
+		return FALSE;
+	}
+	if (pk_strzero (sections[3])) {
+		g_set_error_literal (error, 1, 0, "name cannot not blank");
+		return FALSE;
+	}
+	if (!pk_backend_spawn_check_utf8 (backend_spawn, sections[4], error))
+		return FALSE;
+	if (pk_strzero (sections[5])) {
+		g_set_error_literal (error, 1, 0, "icon cannot not blank");
+		return FALSE;
+	}
+	if (g_str_has_prefix (sections[5], "/")) {
+		g_set_error (error, 1, 0, "icon '%s' should be a named icon, not a path", sections[5]);
+		return FALSE;
+	}
+	pk_backend_job_category (job, sections[1], sections[2], sections[3], sections[4], sections[5]);
+	return TRUE;
+}
+
+/* roughly in order of how often the helpers send them */
+static const PkBackendSpawnCommand pk_backend_spawn_commands[] = {
+	{ "package",			4,	pk_backend_spawn_parse_package },
+	{ "files",			3,	pk_backend_spawn_parse_files },
+	{ "details",			8,	pk_backend_spawn_parse_details },
+	{ "updatedetail",		13,	pk_backend_spawn_parse_update_detail },
+	{ "percentage",			2,	pk_backend_spawn_parse_percentage },
+	{ "item-progress",		4,	pk_backend_spawn_parse_item_progress },
+	{ "status",			2,	pk_backend_spawn_parse_status },
+	{ "finished",			1,	pk_backend_spawn_parse_finished },
+	{ "repo-detail",		4,	pk_backend_spawn_parse_repo_detail },
+	{ "error",			3,	pk_backend_spawn_parse_error },
+	{ "requirerestart",		3,	pk_backend_spawn_parse_require_restart },
+	{ "speed",			2,	pk_backend_spawn_parse_speed },
+	{ "download-size-remaining",	2,	pk_backend_spawn_parse_download_size_remaining },
+	{ "allow-cancel",		2,	pk_backend_spawn_parse_allow_cancel },
+	{ "no-percentage-updates",	1,	pk_backend_spawn_parse_no_percentage_updates },
+	{ "repo-signature-required",	9,	pk_backend_spawn_parse_repo_signature_required },
+	{ "eula-required",		5,	pk_backend_spawn_parse_eula_required },
+	{ "media-change-required",	4,	pk_backend_spawn_parse_media_change_required },
+	{ "distro-upgrade",		4,	pk_backend_spawn_parse_distro_upgrade },
+	{ "category",			6,	pk_backend_spawn_parse_category },
+	{ NULL,				0,	NULL }
+};
+
+/* command name to PkBackendSpawnCommand, built once in class_init */
+static GHashTable *pk_backend_spawn_command_hash = NULL;
+
+/* split on @delimiter in place, stopping at @end, returning the total
+ * number of sections even if there are more than will fit in @sections */
+static guint
+pk_backend_spawn_split_fields (gchar *line, const gchar *end, gchar delimiter,
+			       gchar **sections, guint max)
+{
+	gchar *delim;
+	guint size = 0;
+
+	for (;;) {
+		if (size < max)
+			sections[size] = line;
+		size++;
+		delim = memchr (line, delimiter, end - line);
+		if (delim == NULL)
+			break;
+		*delim = '\0';
+		line = delim + 1;
+	}
+	return size;
+}
+
+static gboolean
+pk_backend_spawn_dispatch (PkBackendSpawn *backend_spawn,
+			   PkBackendJob *job,
+			   gchar **sections,
+			   guint size,
+			   GError **error)
+{
+	const PkBackendSpawnCommand *cmd;
+
+	cmd = g_hash_table_lookup (pk_backend_spawn_command_hash, sections[0]);
+	if (cmd == NULL) {
+		g_set_error (error, 1, 0, "invalid command '%s'", sections[0]);
+		return FALSE;
+	}
+	if (size != cmd->size) {
+		g_set_error (error, 1, 0, "invalid command '%s', size %i", cmd->name, size);
+		return FALSE;
+	}
+	return cmd->func (backend_spawn, job, sections, error);
+}
+
+static gboolean
+pk_backend_spawn_parse_stdout (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       const gchar *line,
+			       GError **error)
+{
+	gsize len;
+	guint size;
+	gchar *sections[PK_BACKEND_SPAWN_MAX_SECTIONS];
+	g_autofree gchar *buf = NULL;
+
+	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+
+	/* check if output line */
+	if (line == NULL)
+		return FALSE;
+
+	/* split by tab, only copying the line once */
+	len = strlen (line);
+	buf = g_strndup (line, len);
+	size = pk_backend_spawn_split_fields (buf, buf + len, '\t',
+					      sections, PK_BACKEND_SPAWN_MAX_SECTIONS);
+	backend_spawn->priv->raw_fields = FALSE;
+	return pk_backend_spawn_dispatch (backend_spawn, job, sections, size, error);
+}
+
+static gboolean
+pk_backend_spawn_parse_record (PkBackendSpawn *backend_spawn,
+			       PkBackendJob *job,
+			       const gchar *data,
+			       guint len,
+			       GError **error)
+{
+	guint size;
+	gchar *sections[PK_BACKEND_SPAWN_MAX_SECTIONS];
+	g_autofree gchar *buf = NULL;
+
+	/* fields are NUL separated, so the last one needs terminating */
+	buf = g_malloc (len + 1);
+	memcpy (buf, data, len);
+	buf[len] = '\0';
+	size = pk_backend_spawn_split_fields (buf, buf + len, '\0',
+					      sections, PK_BACKEND_SPAWN_MAX_SECTIONS);
+	backend_spawn->priv->raw_fields = TRUE;
+	return pk_backend_spawn_dispatch (backend_spawn, job, sections, size, error);
+}
+
 static void
-pk_backend_spawn_exit_cb (PkSpawn *spawn, PkSpawnExitType exit_enum, PkBackendSpawn *backend_spawn)
+pk_backend_spawn_exit_cb (PkSpawn *spawn, PkSpawnExitType exit_enum, PkBackendSpawnWorker *worker)
 {
 	gboolean ret;
-	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
+	PkBackendJob *job = worker->job;
+	PkBackendSpawn *backend_spawn = worker->backend_spawn;
+
+	/* the old instance went away, the worker now belongs to a new one */
+	if (exit_enum == PK_SPAWN_EXIT_TYPE_DISPATCHER_CHANGED) {
+		g_debug ("dispatcher exited, nothing to see here");
+		return;
+	}
+
+	/* the PkSpawn cannot be freed while it is emitting */
+	pk_backend_spawn_refill_pool (backend_spawn);
+
+	if (exit_enum == PK_SPAWN_EXIT_TYPE_DISPATCHER_EXIT) {
+		g_debug ("dispatcher exited, nothing to see here");
+		return;
+	}
 
-	/* reset the busy flag */
-	backend_spawn->priv->is_busy = FALSE;
+	/* a pre-started helper that does not wait for commands on stdin */
+	if (job == NULL) {
+		if (!worker->used) {
+			g_debug ("%s exited without a job, not pre-starting it",
+				 backend_spawn->priv->pool_argv0);
+			backend_spawn->priv->pool_unsupported = TRUE;
+		}
+		return;
+	}
+	worker->job = NULL;
 
 	/* if we force killed the process, set an error */
 	if (exit_enum == PK_SPAWN_EXIT_TYPE_SIGKILL) {
 		/* we just call this failed, and set an error */
-		pk_backend_job_error_code (backend_spawn->priv->job, PK_ERROR_ENUM_PROCESS_KILL,
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_PROCESS_KILL,
 				       "Process had to be killed to be cancelled");
 	}
 
-	if (exit_enum == PK_SPAWN_EXIT_TYPE_DISPATCHER_EXIT ||
-	    exit_enum == PK_SPAWN_EXIT_TYPE_DISPATCHER_CHANGED) {
-		g_debug ("dispatcher exited, nothing to see here");
-		return;
-	}
-
 	/* only emit if not finished */
-	if (!backend_spawn->priv->finished) {
+	if (!worker->finished) {
 		g_debug ("script exited without doing finished, tidying up");
-		ret = pk_backend_job_has_set_error_code (backend_spawn->priv->job);
+		ret = pk_backend_job_has_set_error_code (job);
 		if (!ret) {
-			pk_backend_job_error_code (backend_spawn->priv->job,
+			pk_backend_job_error_code (job,
 					       PK_ERROR_ENUM_INTERNAL_ERROR,
 					       "The backend exited unexpectedly. "
 					       "This is a serious error as the spawned backend did not complete the pending transaction.");
 		}
-		pk_backend_job_finished (backend_spawn->priv->job);
+		pk_backend_job_finished (job);
 	}
 }
 
@@ -605,12 +842,17 @@ pk_backend_spawn_inject_data (PkBackendSpawn *backend_spawn,
 }
 
 static void
-pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
+pk_backend_spawn_stdout_cb (PkSpawn *spawn, const gchar *line, PkBackendSpawnWorker *worker)
 {
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
-	ret = pk_backend_spawn_inject_data (backend_spawn,
-					    backend_spawn->priv->job,
+
+	if (worker->job == NULL) {
+		g_debug ("ignoring output from idle helper: %s", line);
+		return;
+	}
+	ret = pk_backend_spawn_inject_data (worker->backend_spawn,
+					    worker->job,
 					    line,
 					    &error);
 	if (!ret)
@@ -618,22 +860,155 @@ pk_backend_spawn_stdout_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendS
 }
 
 static void
-pk_backend_spawn_stderr_cb (PkBackendSpawn *spawn, const gchar *line, PkBackendSpawn *backend_spawn)
+pk_backend_spawn_record_cb (PkSpawn *spawn, gconstpointer data, guint len,
+			    PkBackendSpawnWorker *worker)
 {
 	gboolean ret;
-	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
+	g_autoptr(GError) error = NULL;
+
+	if (worker->job == NULL) {
+		g_debug ("ignoring record from idle helper");
+		return;
+	}
+
+	/* the stdout filter only ever sees text lines */
+	ret = pk_backend_spawn_parse_record (worker->backend_spawn,
+					     worker->job,
+					     data, len, &error);
+	if (!ret)
+		g_warning ("failed to parse record: %s", error->message);
+}
+
+static void
+pk_backend_spawn_stderr_cb (PkSpawn *spawn, const gchar *line, PkBackendSpawnWorker *worker)
+{
+	gboolean ret;
+	PkBackendSpawn *backend_spawn = worker->backend_spawn;
 
 	/* do we ignore with a filter func ? */
-	if (backend_spawn->priv->stderr_func != NULL) {
-		ret = backend_spawn->priv->stderr_func (backend_spawn->priv->job, line);
+	if (backend_spawn->priv->stderr_func != NULL && worker->job != NULL) {
+		ret = backend_spawn->priv->stderr_func (worker->job, line);
 		if (!ret)
 			return;
 	}
 	g_warning ("STDERR: %s", line);
 }
 
+static void
+pk_backend_spawn_worker_free (PkBackendSpawnWorker *worker)
+{
+	if (worker->kill_id > 0)
+		g_source_remove (worker->kill_id);
+	g_signal_handlers_disconnect_by_data (worker->spawn, worker);
+	g_object_unref (worker->spawn);
+	g_free (worker);
+}
+
+static PkBackendSpawnWorker *
+pk_backend_spawn_worker_new (PkBackendSpawn *backend_spawn)
+{
+	PkBackendSpawnWorker *worker;
+
+	worker = g_new0 (PkBackendSpawnWorker, 1);
+	worker->backend_spawn = backend_spawn;
+	worker->spawn = pk_spawn_new (backend_spawn->priv->conf);
+	g_object_set (worker->spawn,
+		      "allow-sigkill", backend_spawn->priv->allow_sigkill,
+		      NULL);
+	g_signal_connect (worker->spawn, "exit",
+			  G_CALLBACK (pk_backend_spawn_exit_cb), worker);
+	g_signal_connect (worker->spawn, "stdout",
+			  G_CALLBACK (pk_backend_spawn_stdout_cb), worker);
+	g_signal_connect (worker->spawn, "record",
+			  G_CALLBACK (pk_backend_spawn_record_cb), worker);
+	g_signal_connect (worker->spawn, "stderr",
+			  G_CALLBACK (pk_backend_spawn_stderr_cb), worker);
+	g_ptr_array_add (backend_spawn->priv->workers, worker);
+	return worker;
+}
+
+static gboolean
+pk_backend_spawn_refill_cb (gpointer user_data)
+{
+	PkBackendSpawn *backend_spawn = PK_BACKEND_SPAWN (user_data);
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+	PkBackendSpawnWorker *worker;
+	guint idle;
+
+	priv->refill_id = 0;
+
+	/* drop helpers that have gone away */
+	for (guint i = priv->workers->len; i > 0; i--) {
+		worker = g_ptr_array_index (priv->workers, i - 1);
+		if (worker->job == NULL && !pk_spawn_is_running (worker->spawn))
+			g_ptr_array_remove_index (priv->workers, i - 1);
+	}
+
+	/* we need to have seen a helper being used first */
+	if (priv->pool_argv0 == NULL || priv->pool_unsupported)
+		return G_SOURCE_REMOVE;
+
+	/* start the helpers now rather than when the next job arrives; with
+	 * no command they import everything and then wait on stdin */
+	for (idle = pk_backend_spawn_get_idle_count (backend_spawn);
+	     idle < priv->pool_size; idle++) {
+		gchar *argv[] = { priv->pool_argv0, NULL };
+		g_autoptr(GError) error = NULL;
+
+		g_debug ("pre-starting %s", priv->pool_argv0);
+		worker = pk_backend_spawn_worker_new (backend_spawn);
+		g_object_set (worker->spawn,
+			      "background", priv->pool_background,
+			      NULL);
+		if (!pk_spawn_argv (worker->spawn, argv, priv->pool_envp,
+				    PK_SPAWN_ARGV_FLAGS_NONE, &error)) {
+			g_warning ("failed to pre-start %s: %s",
+				   priv->pool_argv0, error->message);
+			g_ptr_array_remove (priv->workers, worker);
+			break;
+		}
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_backend_spawn_refill_pool (PkBackendSpawn *backend_spawn)
+{
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+	if (priv->refill_id != 0)
+		return;
+	priv->refill_id = g_idle_add (pk_backend_spawn_refill_cb, backend_spawn);
+	g_source_set_name_by_id (priv->refill_id, "[PkBackendSpawn] refill");
+}
+
+static PkBackendSpawnWorker *
+pk_backend_spawn_get_worker (PkBackendSpawn *backend_spawn, const gchar *argv0, gchar **envp)
+{
+	PkBackendSpawnWorker *worker;
+	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+
+	if (pk_backend_spawn_get_busy_count (backend_spawn) >= priv->max_workers)
+		return NULL;
+
+	/* prefer a warm helper that can take the command as-is */
+	for (guint i = 0; i < priv->workers->len; i++) {
+		worker = g_ptr_array_index (priv->workers, i);
+		if (worker->job == NULL &&
+		    pk_spawn_can_reuse (worker->spawn, argv0, envp))
+			return worker;
+	}
+
+	/* then any idle one, which will be restarted */
+	for (guint i = 0; i < priv->workers->len; i++) {
+		worker = g_ptr_array_index (priv->workers, i);
+		if (worker->job == NULL)
+			return worker;
+	}
+	return pk_backend_spawn_worker_new (backend_spawn);
+}
+
 static gchar **
-pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn)
+pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn, PkBackendJob *job)
 {
 	gchar **envp;
 	gchar **env_item;
@@ -645,7 +1020,6 @@ pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn)
 	gchar *env_key;
 	gchar *env_value;
 	gboolean ret;
-	PkBackendSpawnPrivate *priv = backend_spawn->priv;
 	gboolean keep_environment;
 	g_autofree gchar *eulas = NULL;
 	const gchar *locale = NULL;
@@ -679,81 +1053,89 @@ pk_backend_spawn_get_envp (PkBackendSpawn *backend_spawn)
 	}
 
 	/* accepted eulas */
-	eulas = pk_backend_get_accepted_eula_string (priv->backend);
+	eulas = pk_backend_get_accepted_eula_string (pk_backend_job_get_backend (job));
 	if (eulas != NULL)
 		g_hash_table_replace (env_table, g_strdup ("accepted_eulas"), g_strdup (eulas));
 
 	/* http_proxy */
-	proxy_http = pk_backend_job_get_proxy_http (priv->job);
+	proxy_http = pk_backend_job_get_proxy_http (job);
 	if (!pk_strzero (proxy_http)) {
 		uri = pk_backend_convert_uri (proxy_http);
 		g_hash_table_replace (env_table, g_strdup ("http_proxy"), uri);
 	}
 
 	/* https_proxy */
-	proxy_https = pk_backend_job_get_proxy_https (priv->job);
+	proxy_https = pk_backend_job_get_proxy_https (job);
 	if (!pk_strzero (proxy_https)) {
 		uri = pk_backend_convert_uri (proxy_https);
 		g_hash_table_replace (env_table, g_strdup ("https_proxy"), uri);
 	}
 
 	/* ftp_proxy */
-	proxy_ftp = pk_backend_job_get_proxy_ftp (priv->job);
+	proxy_ftp = pk_backend_job_get_proxy_ftp (job);
 	if (!pk_strzero (proxy_ftp)) {
 		uri = pk_backend_convert_uri (proxy_ftp);
 		g_hash_table_replace (env_table, g_strdup ("ftp_proxy"), uri);
 	}
 
 	/* socks_proxy */
-	proxy_socks = pk_backend_job_get_proxy_socks (priv->job);
+	proxy_socks = pk_backend_job_get_proxy_socks (job);
 	if (!pk_strzero (proxy_socks)) {
 		uri = pk_backend_convert_uri_socks (proxy_socks);
 		g_hash_table_replace (env_table, g_strdup ("all_proxy"), uri);
 	}
 
 	/* no_proxy */
-	no_proxy = pk_backend_job_get_no_proxy (priv->job);
+	no_proxy = pk_backend_job_get_no_proxy (job);
 	if (!pk_strzero (no_proxy)) {
 		g_hash_table_replace (env_table, g_strdup ("no_proxy"),
 		                      g_strdup (no_proxy));
 	}
 
 	/* pac */
-	pac = pk_backend_job_get_pac (priv->job);
+	pac = pk_backend_job_get_pac (job);
 	if (!pk_strzero (pac)) {
 		uri = pk_backend_convert_uri (pac);
 		g_hash_table_replace (env_table, g_strdup ("pac"), uri);
 	}
 
 	/* LANG */
-	locale = pk_backend_job_get_locale (priv->job);
+	locale = pk_backend_job_get_locale (job);
 	if (!pk_strzero (locale))
 		g_hash_table_replace (env_table, g_strdup ("LANG"), g_strdup (locale));
 
+	/* ROOT, for the readers that answer queries on another root */
+	value = pk_backend_job_get_root (job);
+	if (!pk_strzero (value))
+		g_hash_table_replace (env_table, g_strdup ("ROOT"), g_strdup (value));
+
 	/* FRONTEND SOCKET */
-	value = pk_backend_job_get_frontend_socket (priv->job);
+	value = pk_backend_job_get_frontend_socket (job);
 	if (!pk_strzero (value))
 		g_hash_table_replace (env_table, g_strdup ("FRONTEND_SOCKET"), g_strdup (value));
 
+	/* the helper may answer with length-prefixed records instead of lines */
+	g_hash_table_replace (env_table, g_strdup ("HELPER_PROTOCOL"), g_strdup ("records"));
+
 	/* NETWORK */
-	ret = pk_backend_is_online (priv->backend);
+	ret = pk_backend_is_online (pk_backend_job_get_backend (job));
 	g_hash_table_replace (env_table, g_strdup ("NETWORK"), g_strdup (ret ? "TRUE" : "FALSE"));
 
 	/* BACKGROUND */
-	ret = pk_backend_job_get_background (priv->job);
+	ret = pk_backend_job_get_background (job);
 	g_hash_table_replace (env_table, g_strdup ("BACKGROUND"), g_strdup (ret ? "TRUE" : "FALSE"));
 
 	/* INTERACTIVE */
-	ret = pk_backend_job_get_interactive (priv->job);
+	ret = pk_backend_job_get_interactive (job);
 	g_hash_table_replace (env_table, g_strdup ("INTERACTIVE"), g_strdup (ret ? "TRUE" : "FALSE"));
 
 	/* UID */
 	g_hash_table_replace (env_table,
 			      g_strdup ("UID"),
-			      g_strdup_printf ("%u", pk_backend_job_get_uid (priv->job)));
+			      g_strdup_printf ("%u", pk_backend_job_get_uid (job)));
 
 	/* CACHE_AGE */
-	cache_age = pk_backend_job_get_cache_age (priv->job);
+	cache_age = pk_backend_job_get_cache_age (job);
 	if (cache_age == G_MAXUINT) {
 		g_hash_table_replace (env_table,
 				      g_strdup ("CACHE_AGE"),
@@ -842,6 +1224,7 @@ pk_backend_spawn_helper_va_list (PkBackendSpawn *backend_spawn,
 {
 	gboolean background;
 	PkBackendSpawnPrivate *priv = backend_spawn->priv;
+	PkBackendSpawnWorker *worker;
 	PkSpawnArgvFlags flags = PK_SPAWN_ARGV_FLAGS_NONE;
 #ifdef SOURCEROOTDIR
 	const gchar *directory;
@@ -860,6 +1243,12 @@ pk_backend_spawn_helper_va_list (PkBackendSpawn *backend_spawn,
 		return FALSE;
 	}
 
+	/* not one of the backend helpers */
+	if (g_path_is_absolute (argv[PK_BACKEND_SPAWN_ARGV0])) {
+		filename = g_strdup (argv[PK_BACKEND_SPAWN_ARGV0]);
+		goto found;
+	}
+
 #ifdef SOURCEROOTDIR
 	/* prefer the local version */
 	directory = priv->name;
@@ -884,34 +1273,75 @@ pk_backend_spawn_helper_va_list (PkBackendSpawn *backend_spawn,
 	filename = g_build_filename (DATADIR, "PackageKit", "helpers",
 				     priv->name, argv[PK_BACKEND_SPAWN_ARGV0], NULL);
 #endif
+found:
 	g_debug ("using spawn filename %s", filename);
 
 	/* replace the filename with the full path */
 	g_free (argv[PK_BACKEND_SPAWN_ARGV0]);
 	argv[PK_BACKEND_SPAWN_ARGV0] = g_strdup (filename);
 
-	/* copy idle setting from backend to PkSpawn instance */
-	background = pk_backend_job_get_background (job);
-	g_object_set (priv->spawn,
-		      "background", (background == TRUE),
-		      NULL);
-
 #ifdef ENABLE_STRACE
 	/* we can't reuse when using strace */
 	flags |= PK_SPAWN_ARGV_FLAGS_NEVER_REUSE;
 #endif
 
-	priv->finished = FALSE;
-	envp = pk_backend_spawn_get_envp (backend_spawn);
-	if (!pk_spawn_argv (priv->spawn, argv, envp, flags, &error)) {
-		pk_backend_job_error_code (priv->job,
+	envp = pk_backend_spawn_get_envp (backend_spawn, job);
+	worker = pk_backend_spawn_get_worker (backend_spawn, argv[0], envp);
+	if (worker == NULL) {
+		pk_backend_job_error_code (job,
+					   PK_ERROR_ENUM_LOCK_REQUIRED,
+					   "all %u spawned helpers are busy",
+					   priv->max_workers);
+		pk_backend_job_finished (job);
+		return FALSE;
+	}
+
+	/* don't auto-kill this */
+	if (worker->kill_id > 0) {
+		g_source_remove (worker->kill_id);
+		worker->kill_id = 0;
+	}
+
+	/* but do not reuse out of date data either */
+	if (worker->stale) {
+		worker->stale = FALSE;
+		if (pk_spawn_is_running (worker->spawn))
+			pk_spawn_exit (worker->spawn);
+	}
+
+	/* copy idle setting from backend to PkSpawn instance */
+	background = pk_backend_job_get_background (job);
+	g_object_set (worker->spawn,
+		      "background", (background == TRUE),
+		      NULL);
+
+	worker->job = job;
+	worker->used = TRUE;
+	worker->finished = FALSE;
+	if (!pk_spawn_argv (worker->spawn, argv, envp, flags, &error)) {
+		worker->job = NULL;
+		pk_backend_job_error_code (job,
 					   PK_ERROR_ENUM_INTERNAL_ERROR,
 					   "Spawn of helper '%s' failed: %s",
 					   argv[PK_BACKEND_SPAWN_ARGV0],
 					   error->message);
-		pk_backend_job_finished (priv->job);
+		pk_backend_job_finished (job);
 		return FALSE;
 	}
+	worker->cpu_time_start = pk_spawn_get_cpu_time (worker->spawn);
+
+	/* remember what to pre-start for the next job */
+	if ((flags & PK_SPAWN_ARGV_FLAGS_NEVER_REUSE) == 0 && priv->pool_size > 0) {
+		if (g_strcmp0 (priv->pool_argv0, argv[0]) != 0) {
+			g_free (priv->pool_argv0);
+			priv->pool_argv0 = g_strdup (argv[0]);
+			priv->pool_unsupported = FALSE;
+		}
+		g_strfreev (priv->pool_envp);
+		priv->pool_envp = g_strdupv (envp);
+		priv->pool_background = background;
+		pk_backend_spawn_refill_pool (backend_spawn);
+	}
 	return TRUE;
 }
 
@@ -936,28 +1366,92 @@ pk_backend_spawn_set_name (PkBackendSpawn *backend_spawn, const gchar *name)
 gboolean
 pk_backend_spawn_kill (PkBackendSpawn *backend_spawn)
 {
+	PkBackendSpawnWorker *worker;
+
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
 
-	/* set an error as the script will just exit without doing finished */
-	pk_backend_job_error_code (backend_spawn->priv->job,
-			       PK_ERROR_ENUM_TRANSACTION_CANCELLED,
-			       "the script was killed as the action was cancelled");
-	pk_spawn_kill (backend_spawn->priv->spawn);
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		if (worker->job == NULL)
+			continue;
+
+		/* set an error as the script will just exit without doing finished */
+		pk_backend_job_error_code (worker->job,
+				       PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+				       "the script was killed as the action was cancelled");
+		pk_spawn_kill (worker->spawn);
+	}
 	return TRUE;
 }
 
+/**
+ * pk_backend_spawn_cancel_job:
+ *
+ * Like pk_backend_spawn_kill(), but only for the helper running @job.
+ *
+ * Return value: %FALSE if no helper is running @job
+ **/
+gboolean
+pk_backend_spawn_cancel_job (PkBackendSpawn *backend_spawn, PkBackendJob *job)
+{
+	PkBackendSpawnWorker *worker;
+
+	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
+
+	worker = pk_backend_spawn_get_worker_for_job (backend_spawn, job);
+	if (worker == NULL)
+		return FALSE;
+	pk_backend_job_error_code (job,
+				   PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+				   "the script was killed as the action was cancelled");
+	pk_spawn_kill (worker->spawn);
+	return TRUE;
+}
+
+/**
+ * pk_backend_spawn_restart:
+ *
+ * Makes every helper start again before its next job, e.g. as the data
+ * it loaded is out of date. Busy helpers finish their job first.
+ **/
+void
+pk_backend_spawn_restart (PkBackendSpawn *backend_spawn)
+{
+	PkBackendSpawnWorker *worker;
+
+	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
+
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		if (!pk_spawn_is_running (worker->spawn))
+			continue;
+		if (worker->job != NULL) {
+			worker->stale = TRUE;
+			continue;
+		}
+		pk_spawn_exit (worker->spawn);
+	}
+	pk_backend_spawn_refill_pool (backend_spawn);
+}
+
 gboolean
 pk_backend_spawn_is_busy (PkBackendSpawn *backend_spawn)
 {
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
-	return backend_spawn->priv->is_busy;
+	return pk_backend_spawn_get_busy_count (backend_spawn) >= backend_spawn->priv->max_workers;
 }
 
 gboolean
 pk_backend_spawn_exit (PkBackendSpawn *backend_spawn)
 {
+	PkBackendSpawnWorker *worker;
+
 	g_return_val_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn), FALSE);
-	pk_spawn_exit (backend_spawn->priv->spawn);
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		if (pk_spawn_is_running (worker->spawn))
+			pk_spawn_exit (worker->spawn);
+	}
 	return TRUE;
 }
 
@@ -973,17 +1467,6 @@ pk_backend_spawn_helper (PkBackendSpawn *backend_spawn,
 	g_return_val_if_fail (first_element != NULL, FALSE);
 	g_return_val_if_fail (backend_spawn->priv->name != NULL, FALSE);
 
-	/* save this */
-	backend_spawn->priv->is_busy = TRUE;
-	backend_spawn->priv->job = job;
-	backend_spawn->priv->backend = g_object_ref (pk_backend_job_get_backend (job));
-
-	/* don't auto-kill this */
-	if (backend_spawn->priv->kill_id > 0) {
-		g_source_remove (backend_spawn->priv->kill_id);
-		backend_spawn->priv->kill_id = 0;
-	}
-
 	/* get the argument list */
 	va_start (args, first_element);
 	ret = pk_backend_spawn_helper_va_list (backend_spawn, job, first_element, &args);
@@ -992,13 +1475,26 @@ pk_backend_spawn_helper (PkBackendSpawn *backend_spawn,
 	return ret;
 }
 
+void
+pk_backend_spawn_set_max_workers (PkBackendSpawn *backend_spawn, guint max_workers)
+{
+	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
+	backend_spawn->priv->max_workers = MAX (max_workers, 1);
+}
+
 void
 pk_backend_spawn_set_allow_sigkill (PkBackendSpawn *backend_spawn, gboolean allow_sigkill)
 {
+	PkBackendSpawnWorker *worker;
+
 	g_return_if_fail (PK_IS_BACKEND_SPAWN (backend_spawn));
-	g_object_set (backend_spawn->priv->spawn,
-		      "allow-sigkill", allow_sigkill,
-		      NULL);
+	backend_spawn->priv->allow_sigkill = allow_sigkill;
+	for (guint i = 0; i < backend_spawn->priv->workers->len; i++) {
+		worker = g_ptr_array_index (backend_spawn->priv->workers, i);
+		g_object_set (worker->spawn,
+			      "allow-sigkill", allow_sigkill,
+			      NULL);
+	}
 }
 
 static void
@@ -1010,14 +1506,14 @@ pk_backend_spawn_finalize (GObject *object)
 
 	backend_spawn = PK_BACKEND_SPAWN (object);
 
-	if (backend_spawn->priv->kill_id > 0)
-		g_source_remove (backend_spawn->priv->kill_id);
+	if (backend_spawn->priv->refill_id > 0)
+		g_source_remove (backend_spawn->priv->refill_id);
 
 	g_free (backend_spawn->priv->name);
+	g_free (backend_spawn->priv->pool_argv0);
+	g_strfreev (backend_spawn->priv->pool_envp);
 	g_key_file_unref (backend_spawn->priv->conf);
-	g_object_unref (backend_spawn->priv->spawn);
-	if (backend_spawn->priv->backend != NULL)
-		g_object_unref (backend_spawn->priv->backend);
+	g_ptr_array_unref (backend_spawn->priv->workers);
 
 	G_OBJECT_CLASS (pk_backend_spawn_parent_class)->finalize (object);
 }
@@ -1025,15 +1521,27 @@ pk_backend_spawn_finalize (GObject *object)
 static void
 pk_backend_spawn_class_init (PkBackendSpawnClass *klass)
 {
+	guint i;
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	object_class->finalize = pk_backend_spawn_finalize;
 	g_type_class_add_private (klass, sizeof (PkBackendSpawnPrivate));
+
+	/* index the commands the helpers can send */
+	pk_backend_spawn_command_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; pk_backend_spawn_commands[i].name != NULL; i++) {
+		g_hash_table_insert (pk_backend_spawn_command_hash,
+				     (gpointer) pk_backend_spawn_commands[i].name,
+				     (gpointer) &pk_backend_spawn_commands[i]);
+	}
 }
 
 static void
 pk_backend_spawn_init (PkBackendSpawn *backend_spawn)
 {
 	backend_spawn->priv = PK_BACKEND_SPAWN_GET_PRIVATE (backend_spawn);
+	backend_spawn->priv->workers = g_ptr_array_new_with_free_func ((GDestroyNotify) pk_backend_spawn_worker_free);
+	backend_spawn->priv->allow_sigkill = TRUE;
+	backend_spawn->priv->max_workers = 1;
 }
 
 PkBackendSpawn *
@@ -1042,13 +1550,14 @@ pk_backend_spawn_new (GKeyFile *conf)
 	PkBackendSpawn *backend_spawn;
 	backend_spawn = g_object_new (PK_TYPE_BACKEND_SPAWN, NULL);
 	backend_spawn->priv->conf = g_key_file_ref (conf);
-	backend_spawn->priv->spawn = pk_spawn_new (backend_spawn->priv->conf);
-	g_signal_connect (backend_spawn->priv->spawn, "exit",
-			  G_CALLBACK (pk_backend_spawn_exit_cb), backend_spawn);
-	g_signal_connect (backend_spawn->priv->spawn, "stdout",
-			  G_CALLBACK (pk_backend_spawn_stdout_cb), backend_spawn);
-	g_signal_connect (backend_spawn->priv->spawn, "stderr",
-			  G_CALLBACK (pk_backend_spawn_stderr_cb), backend_spawn);
+	if (g_key_file_has_key (conf, "Daemon", "BackendSpawnPoolSize", NULL)) {
+		gint pool_size = g_key_file_get_integer (conf, "Daemon", "BackendSpawnPoolSize", NULL);
+		backend_spawn->priv->pool_size = MAX (pool_size, 0);
+	}
+	if (g_key_file_has_key (conf, "Daemon", "BackendSpawnMaxWorkers", NULL)) {
+		gint max_workers = g_key_file_get_integer (conf, "Daemon", "BackendSpawnMaxWorkers", NULL);
+		backend_spawn->priv->max_workers = MAX (max_workers, 1);
+	}
 	return PK_BACKEND_SPAWN (backend_spawn);
 }
 
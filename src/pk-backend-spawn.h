@@ -59,6 +59,11 @@ gboolean	 pk_backend_spawn_helper		(PkBackendSpawn	*backend_spawn,
 gboolean	 pk_backend_spawn_is_busy		(PkBackendSpawn	*backend_spawn);
 gboolean	 pk_backend_spawn_kill			(PkBackendSpawn	*backend_spawn);
 gboolean	 pk_backend_spawn_exit			(PkBackendSpawn	*backend_spawn);
+gboolean	 pk_backend_spawn_cancel_job		(PkBackendSpawn	*backend_spawn,
+							 PkBackendJob	*job);
+void		 pk_backend_spawn_restart		(PkBackendSpawn	*backend_spawn);
+void		 pk_backend_spawn_set_max_workers	(PkBackendSpawn	*backend_spawn,
+							 guint		 max_workers);
 const gchar	*pk_backend_spawn_get_name		(PkBackendSpawn	*backend_spawn);
 gboolean	 pk_backend_spawn_set_name		(PkBackendSpawn	*backend_spawn,
 							 const gchar	*name);
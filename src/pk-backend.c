@@ -34,7 +34,9 @@
 #include <packagekit-glib2/pk-common.h>
 
 #include "pk-backend.h"
+#include "pk-backend-spawn.h"
 #include "pk-shared.h"
+#include "pk-trace.h"
 
 #define PK_BACKEND_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_BACKEND, PkBackendPrivate))
 
@@ -58,6 +60,9 @@ typedef struct {
 	PkBitfield	(*get_provides)			(PkBackend	*backend);
 	gchar		**(*get_mime_types)		(PkBackend	*backend);
 	gboolean	(*supports_parallelization)	(PkBackend	*backend);
+	gboolean	(*supports_roots)		(PkBackend	*backend);
+	gboolean	(*watches_repos)		(PkBackend	*backend);
+	PkBitfield	(*get_reader_roles)		(PkBackend	*backend);
 	void		(*job_start)			(PkBackend	*backend,
 							 PkBackendJob	*job);
 	void		(*job_stop)			(PkBackend	*backend,
@@ -178,6 +183,10 @@ typedef struct {
 	void		(*repair_system)		(PkBackend	*backend,
 							 PkBackendJob	*job,
 							 PkBitfield	 transaction_flags);
+	void		(*prewarm)			(PkBackend	*backend,
+							 PkBackendJob	*job);
+	void		(*get_commands)			(PkBackend	*backend,
+							 PkBackendJob	*job);
 } PkBackendDesc;
 
 struct PkBackendPrivate
@@ -198,11 +207,21 @@ struct PkBackendPrivate
 	gpointer		 user_data;
 	GHashTable		*thread_hash;
 	GMutex			 thread_hash_mutex;
+	GThreadPool		*thread_pool;
+	gint			 thread_pool_size;
+	GHashTable		*role_thread_pools;
+	GMainLoop		*io_loop;
+	GThread			*io_thread;
 	gboolean		 transaction_in_progress;
 	guint			 transaction_inhibit_end_idle_id;
 	guint			 repo_list_changed_id;
 	guint			 installed_db_changed_id;
 	guint			 updates_changed_id;
+	GMutex			 epoch_mutex;
+	guint64			 epochs[PK_BACKEND_EPOCH_LAST];
+	guint			 epoch_changed_id;
+	PkBackendSpawn		*readers;
+	PkBitfield		 reader_roles;
 };
 
 G_DEFINE_TYPE (PkBackend, pk_backend, G_TYPE_OBJECT)
@@ -210,6 +229,8 @@ G_DEFINE_TYPE (PkBackend, pk_backend, G_TYPE_OBJECT)
 enum {
 	SIGNAL_REPO_LIST_CHANGED,
 	SIGNAL_UPDATES_CHANGED,
+	SIGNAL_INSTALLED_CHANGED,
+	SIGNAL_EPOCH_CHANGED,
 	SIGNAL_LAST
 };
 
@@ -252,6 +273,171 @@ pk_backend_supports_parallelization (PkBackend	*backend)
 	return backend->priv->desc->supports_parallelization (backend);
 }
 
+/**
+ * pk_backend_supports_roots:
+ *
+ * Return value: %TRUE if jobs can be pointed at another root with
+ * pk_backend_job_set_root(), sharing the repository metadata with the
+ * root the backend was set up with.
+ **/
+gboolean
+pk_backend_supports_roots (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
+
+	/* not compulsory */
+	if (backend->priv->desc->supports_roots == NULL)
+		return FALSE;
+	return backend->priv->desc->supports_roots (backend);
+}
+
+/**
+ * pk_backend_watches_repos:
+ *
+ * Return value: %TRUE if the backend calls pk_backend_repo_list_changed()
+ * when the repositories are changed outside of PackageKit too, so the
+ * repository list can be answered from the query cache.
+ **/
+gboolean
+pk_backend_watches_repos (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
+
+	/* not compulsory */
+	if (backend->priv->desc->watches_repos == NULL)
+		return FALSE;
+	return backend->priv->desc->watches_repos (backend);
+}
+
+/**
+ * pk_backend_get_reader_roles:
+ *
+ * Backends that do not support parallelization can still declare roles
+ * that only read the package database. Transactions with these roles take
+ * the backend lock shared and run next to each other, everything else
+ * takes it exclusively.
+ *
+ * Return value: the roles which may run concurrently, or 0
+ **/
+PkBitfield
+pk_backend_get_reader_roles (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+
+	/* not compulsory */
+	if (backend->priv->desc->get_reader_roles == NULL)
+		return backend->priv->reader_roles;
+	return backend->priv->desc->get_reader_roles (backend) |
+	       backend->priv->reader_roles;
+}
+
+/**
+ * pk_backend_readers_setup:
+ *
+ * A backend that is not thread safe can still answer the read-only roles
+ * from a few packagekit-reader processes, each with its own copy of the
+ * backend loaded read-only, so that queries stop waiting for each other.
+ **/
+static void
+pk_backend_readers_setup (PkBackend *backend)
+{
+#ifdef PK_BUILD_DAEMON
+	gint n_readers;
+	PkBitfield roles;
+	const PkRoleEnum reader_roles[] = {
+		PK_ROLE_ENUM_DEPENDS_ON,
+		PK_ROLE_ENUM_GET_DETAILS,
+		PK_ROLE_ENUM_GET_FILES,
+		PK_ROLE_ENUM_GET_PACKAGES,
+		PK_ROLE_ENUM_GET_UPDATES,
+		PK_ROLE_ENUM_REQUIRED_BY,
+		PK_ROLE_ENUM_RESOLVE,
+		PK_ROLE_ENUM_SEARCH_DETAILS,
+		PK_ROLE_ENUM_SEARCH_FILE,
+		PK_ROLE_ENUM_SEARCH_GROUP,
+		PK_ROLE_ENUM_SEARCH_NAME,
+		PK_ROLE_ENUM_WHAT_PROVIDES,
+		PK_ROLE_ENUM_UNKNOWN };
+
+	n_readers = g_key_file_get_integer (backend->priv->conf,
+					    "Daemon", "ReaderProcesses", NULL);
+	if (n_readers <= 0)
+		return;
+	if (pk_backend_supports_parallelization (backend)) {
+		g_debug ("not using reader processes as %s is thread safe",
+			 backend->priv->name);
+		return;
+	}
+
+	roles = pk_backend_get_roles (backend);
+	for (guint i = 0; reader_roles[i] != PK_ROLE_ENUM_UNKNOWN; i++) {
+		if (pk_bitfield_contain (roles, reader_roles[i]))
+			pk_bitfield_add (backend->priv->reader_roles, reader_roles[i]);
+	}
+	if (backend->priv->reader_roles == 0)
+		return;
+
+	backend->priv->readers = pk_backend_spawn_new (backend->priv->conf);
+	pk_backend_spawn_set_name (backend->priv->readers, backend->priv->name);
+	pk_backend_spawn_set_max_workers (backend->priv->readers, n_readers);
+	g_debug ("using up to %i reader processes", n_readers);
+#endif
+}
+
+static void
+pk_backend_readers_free (PkBackend *backend)
+{
+	if (backend->priv->readers == NULL)
+		return;
+	pk_backend_spawn_exit (backend->priv->readers);
+	g_clear_object (&backend->priv->readers);
+	backend->priv->reader_roles = 0;
+}
+
+/* returns TRUE if a reader process took the job */
+static gboolean
+pk_backend_reader_run (PkBackend *backend,
+		       PkBackendJob *job,
+		       PkBitfield filters,
+		       gchar **values,
+		       gboolean recursive)
+{
+#ifdef PK_BUILD_DAEMON
+	PkRoleEnum role = pk_backend_job_get_role (job);
+	const gchar *root = pk_backend_job_get_root (job);
+	g_autofree gchar *filters_str = NULL;
+	g_autofree gchar *values_str = NULL;
+
+	if (backend->priv->readers == NULL ||
+	    !pk_bitfield_contain (backend->priv->reader_roles, role))
+		return FALSE;
+
+	/* the root is passed in the environment, which is sanitised, and the
+	 * job cannot fall back to running here next to the other readers */
+	if (root != NULL && strpbrk (root, "\\;{}[]()*?%\n\r\t") != NULL) {
+		pk_backend_job_error_code (job, PK_ERROR_ENUM_NOT_SUPPORTED,
+					   "root %s cannot be passed to a reader", root);
+		pk_backend_job_finished (job);
+		return TRUE;
+	}
+
+	/* this finishes the job itself if there is no reader to run it */
+	filters_str = pk_filter_bitfield_to_string (filters);
+	values_str = values != NULL ? g_strjoinv ("&", values) : g_strdup ("");
+	pk_backend_spawn_helper (backend->priv->readers, job,
+				 LIBEXECDIR "/packagekit-reader",
+				 backend->priv->name,
+				 pk_role_enum_to_string (role),
+				 filters_str,
+				 values_str,
+				 pk_backend_bool_to_string (recursive),
+				 NULL);
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
 void
 pk_backend_thread_start (PkBackend *backend, PkBackendJob *job, gpointer func)
 {
@@ -284,6 +470,228 @@ pk_backend_thread_stop (PkBackend *backend, PkBackendJob *job, gpointer func)
 	g_mutex_unlock (mutex);
 }
 
+/* per-worker state cached by the backend between jobs */
+typedef struct {
+	gpointer		 data;
+	GDestroyNotify		 destroy_func;
+} PkBackendThreadContext;
+
+static void
+pk_backend_thread_context_free (gpointer data)
+{
+	PkBackendThreadContext *context = (PkBackendThreadContext *) data;
+	if (context->destroy_func != NULL)
+		context->destroy_func (context->data);
+	g_free (context);
+}
+
+static GPrivate pk_backend_thread_context = G_PRIVATE_INIT (pk_backend_thread_context_free);
+
+/**
+ * pk_backend_thread_get_context:
+ *
+ * Gets the state the backend stored for the current worker thread with
+ * pk_backend_thread_set_context(), for instance an open database handle.
+ *
+ * Return value: the context, or %NULL if none has been set on this thread
+ **/
+gpointer
+pk_backend_thread_get_context (PkBackend *backend)
+{
+	PkBackendThreadContext *context;
+	g_return_val_if_fail (PK_IS_BACKEND (backend), NULL);
+	context = g_private_get (&pk_backend_thread_context);
+	if (context == NULL)
+		return NULL;
+	return context->data;
+}
+
+/**
+ * pk_backend_thread_set_context:
+ * @data: the context to keep for later jobs on this worker thread
+ * @destroy_func: (nullable): called when the context is replaced or the
+ * worker thread exits
+ *
+ * Worker threads are reused between jobs, so backends can keep expensive
+ * per-thread state here rather than setting it up again for every job.
+ **/
+void
+pk_backend_thread_set_context (PkBackend *backend,
+			       gpointer data,
+			       GDestroyNotify destroy_func)
+{
+	PkBackendThreadContext *context = NULL;
+
+	g_return_if_fail (PK_IS_BACKEND (backend));
+
+	if (data != NULL || destroy_func != NULL) {
+		context = g_new0 (PkBackendThreadContext, 1);
+		context->data = data;
+		context->destroy_func = destroy_func;
+	}
+	g_private_replace (&pk_backend_thread_context, context);
+}
+
+/* simple helper to work around the GThreadPool one pointer limit */
+typedef struct {
+	GThreadFunc		 func;
+	gpointer		 user_data;
+} PkBackendThreadTask;
+
+static void
+pk_backend_thread_pool_func (gpointer data, gpointer user_data)
+{
+	PkBackendThreadTask *task = (PkBackendThreadTask *) data;
+	task->func (task->user_data);
+	g_free (task);
+}
+
+static void
+pk_backend_thread_pool_destroy (gpointer data)
+{
+	g_thread_pool_free ((GThreadPool *) data, FALSE, FALSE);
+}
+
+static GThreadPool *
+pk_backend_thread_pool_new (gint max_threads)
+{
+	GThreadPool *pool;
+	g_autoptr(GError) error = NULL;
+
+	g_return_val_if_fail (max_threads > 0, NULL);
+
+	/* exclusive, so the threads and their cached context stay around */
+	pool = g_thread_pool_new (pk_backend_thread_pool_func, NULL,
+				  max_threads, TRUE, &error);
+	if (pool == NULL) {
+		g_warning ("failed to create backend thread pool: %s",
+			   error != NULL ? error->message : "invalid size");
+	}
+	return pool;
+}
+
+static GThreadPool *
+pk_backend_thread_get_pool (PkBackend *backend, PkRoleEnum role)
+{
+	PkBackendPrivate *priv = backend->priv;
+	GThreadPool *pool;
+
+	/* shared pool */
+	if (role == PK_ROLE_ENUM_UNKNOWN) {
+		if (priv->thread_pool == NULL)
+			priv->thread_pool = pk_backend_thread_pool_new (priv->thread_pool_size);
+		return priv->thread_pool;
+	}
+
+	/* one dedicated worker per role */
+	pool = g_hash_table_lookup (priv->role_thread_pools, GUINT_TO_POINTER (role));
+	if (pool == NULL) {
+		pool = pk_backend_thread_pool_new (1);
+		if (pool == NULL)
+			return NULL;
+		g_debug ("created dedicated worker for %s", pk_role_enum_to_string (role));
+		g_hash_table_insert (priv->role_thread_pools, GUINT_TO_POINTER (role), pool);
+	}
+	return pool;
+}
+
+/**
+ * pk_backend_thread_push:
+ * @role: the role to use a dedicated worker for, or %PK_ROLE_ENUM_UNKNOWN
+ * @func: (scope async): the function to run on the worker thread
+ *
+ * Runs @func on a pooled worker thread rather than creating a new thread.
+ **/
+void
+pk_backend_thread_push (PkBackend *backend,
+			PkRoleEnum role,
+			GThreadFunc func,
+			gpointer user_data)
+{
+	GThreadPool *pool;
+	PkBackendThreadTask *task;
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_return_if_fail (func != NULL);
+	g_return_if_fail (pk_is_thread_default ());
+
+	task = g_new0 (PkBackendThreadTask, 1);
+	task->func = func;
+	task->user_data = user_data;
+
+	pool = pk_backend_thread_get_pool (backend, role);
+	if (pool != NULL) {
+		if (g_thread_pool_push (pool, task, &error))
+			return;
+		g_warning ("failed to push to backend thread pool: %s", error->message);
+	}
+
+	/* fall back to a thread of its own; we never need to join() it */
+	g_free (task);
+	g_thread_unref (g_thread_new ("PK-Backend", func, user_data));
+}
+
+static gboolean
+pk_backend_io_quit_cb (gpointer user_data)
+{
+	g_main_loop_quit ((GMainLoop *) user_data);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer
+pk_backend_io_thread_func (gpointer user_data)
+{
+	GMainLoop *loop = (GMainLoop *) user_data;
+	GMainContext *context = g_main_loop_get_context (loop);
+
+	g_main_context_push_thread_default (context);
+	g_main_loop_run (loop);
+	g_main_context_pop_thread_default (context);
+	return NULL;
+}
+
+/**
+ * pk_backend_get_io_context:
+ *
+ * Jobs started with pk_backend_job_async_create() all share this context,
+ * which is iterated on a thread of its own so that waiting on I/O does not
+ * hold a worker for each job, nor slow down the daemon main loop.
+ *
+ * Return value: (transfer none): the context, created on first use
+ **/
+GMainContext *
+pk_backend_get_io_context (PkBackend *backend)
+{
+	PkBackendPrivate *priv = backend->priv;
+	g_autoptr(GMainContext) context = NULL;
+
+	g_return_val_if_fail (PK_IS_BACKEND (backend), NULL);
+	g_return_val_if_fail (pk_is_thread_default (), NULL);
+
+	if (priv->io_loop == NULL) {
+		context = g_main_context_new ();
+		priv->io_loop = g_main_loop_new (context, FALSE);
+		priv->io_thread = g_thread_new ("PK-BackendIO",
+						pk_backend_io_thread_func,
+						priv->io_loop);
+	}
+	return g_main_loop_get_context (priv->io_loop);
+}
+
+static void
+pk_backend_thread_pools_free (PkBackend *backend)
+{
+	PkBackendPrivate *priv = backend->priv;
+
+	/* queued jobs still run, but like plain threads they are never joined */
+	if (priv->thread_pool != NULL) {
+		g_thread_pool_free (priv->thread_pool, FALSE, FALSE);
+		priv->thread_pool = NULL;
+	}
+	g_hash_table_remove_all (priv->role_thread_pools);
+}
+
 PkBitfield
 pk_backend_get_filters (PkBackend *backend)
 {
@@ -512,6 +920,9 @@ pk_backend_load (PkBackend *backend, GError **error)
 		g_module_symbol (handle, "pk_backend_get_groups", (gpointer *)&desc->get_groups);
 		g_module_symbol (handle, "pk_backend_get_mime_types", (gpointer *)&desc->get_mime_types);
 		g_module_symbol (handle, "pk_backend_supports_parallelization", (gpointer *)&desc->supports_parallelization);
+		g_module_symbol (handle, "pk_backend_supports_roots", (gpointer *)&desc->supports_roots);
+		g_module_symbol (handle, "pk_backend_watches_repos", (gpointer *)&desc->watches_repos);
+		g_module_symbol (handle, "pk_backend_get_reader_roles", (gpointer *)&desc->get_reader_roles);
 		g_module_symbol (handle, "pk_backend_get_packages", (gpointer *)&desc->get_packages);
 		g_module_symbol (handle, "pk_backend_get_repo_list", (gpointer *)&desc->get_repo_list);
 		g_module_symbol (handle, "pk_backend_required_by", (gpointer *)&desc->required_by);
@@ -539,6 +950,8 @@ pk_backend_load (PkBackend *backend, GError **error)
 		g_module_symbol (handle, "pk_backend_what_provides", (gpointer *)&desc->what_provides);
 		g_module_symbol (handle, "pk_backend_upgrade_system", (gpointer *)&desc->upgrade_system);
 		g_module_symbol (handle, "pk_backend_repair_system", (gpointer *)&desc->repair_system);
+		g_module_symbol (handle, "pk_backend_prewarm", (gpointer *)&desc->prewarm);
+		g_module_symbol (handle, "pk_backend_get_commands", (gpointer *)&desc->get_commands);
 
 		/* get old static string data */
 		ret = g_module_symbol (handle, "pk_backend_get_author", (gpointer *)&backend_vfunc);
@@ -570,6 +983,7 @@ pk_backend_load (PkBackend *backend, GError **error)
 		backend->priv->during_initialize = FALSE;
 	}
 	backend->priv->loaded = TRUE;
+	pk_backend_readers_setup (backend);
 	return TRUE;
 }
 
@@ -597,12 +1011,84 @@ pk_backend_unload (PkBackend *backend)
 		g_warning ("not yet loaded backend, try pk_backend_load()");
 		return FALSE;
 	}
+	pk_backend_thread_pools_free (backend);
+	pk_backend_readers_free (backend);
 	if (backend->priv->desc->destroy != NULL)
 		backend->priv->desc->destroy (backend);
 	backend->priv->loaded = FALSE;
 	return TRUE;
 }
 
+static gboolean
+pk_backend_epoch_changed_cb (gpointer user_data)
+{
+	PkBackend *backend = PK_BACKEND (user_data);
+
+	g_mutex_lock (&backend->priv->epoch_mutex);
+	backend->priv->epoch_changed_id = 0;
+	g_mutex_unlock (&backend->priv->epoch_mutex);
+
+	/* the readers loaded the old package database */
+	if (backend->priv->readers != NULL)
+		pk_backend_spawn_restart (backend->priv->readers);
+
+	g_signal_emit (backend, signals [SIGNAL_EPOCH_CHANGED], 0);
+	return FALSE;
+}
+
+/**
+ * pk_backend_get_epoch:
+ *
+ * Caches remember the epochs their data was read at, and are still valid
+ * while both are the same. The values only ever go up, and start from the
+ * current time so that they also go up across daemon restarts.
+ *
+ * This function can be called on any thread.
+ **/
+guint64
+pk_backend_get_epoch (PkBackend *backend, PkBackendEpoch epoch)
+{
+	guint64 value;
+
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+	g_return_val_if_fail (epoch < PK_BACKEND_EPOCH_LAST, 0);
+
+	g_mutex_lock (&backend->priv->epoch_mutex);
+	value = backend->priv->epochs[epoch];
+	g_mutex_unlock (&backend->priv->epoch_mutex);
+	return value;
+}
+
+/**
+ * pk_backend_bump_epoch:
+ *
+ * Marks everything read from the @epoch data as out of date. This is done
+ * by pk_backend_installed_db_changed() and pk_backend_repo_list_changed(),
+ * and after transactions which change packages or repositories; backends
+ * only need to call it for changes PackageKit does not see otherwise, such
+ * as new metadata downloaded in the background.
+ *
+ * This function can be called on any thread.
+ *
+ * Return value: the new epoch
+ **/
+guint64
+pk_backend_bump_epoch (PkBackend *backend, PkBackendEpoch epoch)
+{
+	guint64 value;
+
+	g_return_val_if_fail (PK_IS_BACKEND (backend), 0);
+	g_return_val_if_fail (epoch < PK_BACKEND_EPOCH_LAST, 0);
+
+	g_mutex_lock (&backend->priv->epoch_mutex);
+	value = MAX (backend->priv->epochs[epoch] + 1, (guint64) g_get_real_time ());
+	backend->priv->epochs[epoch] = value;
+	if (backend->priv->epoch_changed_id == 0)
+		backend->priv->epoch_changed_id = g_idle_add (pk_backend_epoch_changed_cb, backend);
+	g_mutex_unlock (&backend->priv->epoch_mutex);
+	return value;
+}
+
 static gboolean
 pk_backend_repo_list_changed_cb (gpointer user_data)
 {
@@ -620,6 +1106,8 @@ pk_backend_repo_list_changed (PkBackend *backend)
 	g_return_if_fail (PK_IS_BACKEND (backend));
 	g_return_if_fail (backend->priv->loaded);
 
+	pk_backend_bump_epoch (backend, PK_BACKEND_EPOCH_AVAILABLE);
+
 	/* already scheduled */
 	if (backend->priv->repo_list_changed_id != 0)
 		return;
@@ -674,6 +1162,9 @@ pk_backend_installed_db_changed_cb (gpointer user_data)
 	PkBackend *backend = PK_BACKEND (user_data);
 	g_autoptr(GError) error = NULL;
 
+	g_debug ("emitting installed-changed");
+	g_signal_emit (backend, signals [SIGNAL_INSTALLED_CHANGED], 0);
+
 	if (!backend->priv->transaction_in_progress) {
 		g_debug ("invalidating offline updates");
 		if (!pk_offline_auth_invalidate (&error))
@@ -704,6 +1195,8 @@ pk_backend_installed_db_changed (PkBackend *backend)
 	g_return_if_fail (PK_IS_BACKEND (backend));
 	g_return_if_fail (backend->priv->loaded);
 
+	pk_backend_bump_epoch (backend, PK_BACKEND_EPOCH_INSTALLED);
+
 	/* already scheduled */
 	if (backend->priv->installed_db_changed_id != 0)
 		return;
@@ -809,6 +1302,7 @@ pk_backend_start_job (PkBackend *backend, PkBackendJob *job)
 	}
 
 	pk_backend_job_set_started (job, TRUE);
+	PK_TRACE2 (backend__job__start, job, pk_backend_job_get_role (job));
 
 	/* optional */
 	if (backend->priv->desc->job_start != NULL)
@@ -840,6 +1334,7 @@ pk_backend_stop_job (PkBackend *backend, PkBackendJob *job)
 	/* optional */
 	if (backend->priv->desc->job_stop != NULL)
 		backend->priv->desc->job_stop (backend, job);
+	PK_TRACE2 (backend__job__stop, job, pk_backend_job_get_role (job));
 }
 
 const gchar *
@@ -1072,6 +1567,15 @@ pk_backend_finalize (GObject *object)
 	g_hash_table_destroy (backend->priv->eulas);
 
 	g_mutex_clear (&backend->priv->eulas_mutex);
+	pk_backend_thread_pools_free (backend);
+	g_hash_table_unref (backend->priv->role_thread_pools);
+	if (backend->priv->io_loop != NULL) {
+		/* a quit before the loop is running would be lost */
+		g_main_context_invoke (g_main_loop_get_context (backend->priv->io_loop),
+				       pk_backend_io_quit_cb, backend->priv->io_loop);
+		g_thread_join (backend->priv->io_thread);
+		g_main_loop_unref (backend->priv->io_loop);
+	}
 	g_mutex_clear (&backend->priv->thread_hash_mutex);
 	g_hash_table_unref (backend->priv->thread_hash);
 	g_free (backend->priv->desc);
@@ -1082,6 +1586,10 @@ pk_backend_finalize (GObject *object)
 		g_source_remove (backend->priv->transaction_inhibit_end_idle_id);
 	if (backend->priv->updates_changed_id != 0)
 		g_source_remove (backend->priv->updates_changed_id);
+	if (backend->priv->epoch_changed_id != 0)
+		g_source_remove (backend->priv->epoch_changed_id);
+	g_mutex_clear (&backend->priv->epoch_mutex);
+	pk_backend_readers_free (backend);
 	if (backend->priv->handle != NULL)
 		g_module_close (backend->priv->handle);
 
@@ -1104,6 +1612,16 @@ pk_backend_class_init (PkBackendClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
+	signals [SIGNAL_INSTALLED_CHANGED] =
+		g_signal_new ("installed-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+	signals [SIGNAL_EPOCH_CHANGED] =
+		g_signal_new ("epoch-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 
 	g_type_class_add_private (klass, sizeof (PkBackendPrivate));
 }
@@ -1120,8 +1638,14 @@ pk_backend_cancel (PkBackend *backend, PkBackendJob *job)
 	cancellable = pk_backend_job_get_cancellable (job);
 	if (g_cancellable_is_cancelled (cancellable))
 		return;
+	pk_backend_job_set_cancel_requested (job);
 	g_cancellable_cancel (cancellable);
 
+	/* the job may be running in a reader process */
+	if (backend->priv->readers != NULL &&
+	    pk_backend_spawn_cancel_job (backend->priv->readers, job))
+		return;
+
 	/* call into the backend */
 	backend->priv->desc->cancel (backend, job);
 }
@@ -1179,6 +1703,8 @@ pk_backend_depends_on (PkBackend *backend,
 							   filters,
 							   package_ids,
 							   recursive));
+	if (pk_backend_reader_run (backend, job, filters, package_ids, recursive))
+		return;
 	backend->priv->desc->depends_on (backend, job, filters, package_ids, recursive);
 }
 
@@ -1197,6 +1723,8 @@ pk_backend_get_details (PkBackend *backend,
 	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_DETAILS);
 	pk_backend_job_set_parameters (job, g_variant_new ("(^as)",
 							   package_ids));
+	if (pk_backend_reader_run (backend, job, 0, package_ids, FALSE))
+		return;
 	backend->priv->desc->get_details (backend, job, package_ids);
 }
 
@@ -1265,6 +1793,8 @@ pk_backend_get_files (PkBackend *backend,
 	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_FILES);
 	pk_backend_job_set_parameters (job, g_variant_new ("(^as)",
 							   package_ids));
+	if (pk_backend_reader_run (backend, job, 0, package_ids, FALSE))
+		return;
 	backend->priv->desc->get_files (backend, job, package_ids);
 }
 
@@ -1287,6 +1817,8 @@ pk_backend_required_by (PkBackend *backend,
 							   filters,
 							   package_ids,
 							   recursive));
+	if (pk_backend_reader_run (backend, job, filters, package_ids, recursive))
+		return;
 	backend->priv->desc->required_by (backend, job, filters, package_ids, recursive);
 }
 
@@ -1323,6 +1855,8 @@ pk_backend_get_updates (PkBackend *backend,
 	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_UPDATES);
 	pk_backend_job_set_parameters (job, g_variant_new ("(t)",
 							   filters));
+	if (pk_backend_reader_run (backend, job, filters, NULL, FALSE))
+		return;
 	backend->priv->desc->get_updates (backend, job, filters);
 }
 
@@ -1451,6 +1985,8 @@ pk_backend_resolve (PkBackend *backend,
 	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
 							   filters,
 							   package_ids));
+	if (pk_backend_reader_run (backend, job, filters, package_ids, FALSE))
+		return;
 	backend->priv->desc->resolve (backend, job, filters, package_ids);
 }
 
@@ -1471,6 +2007,8 @@ pk_backend_search_details (PkBackend *backend,
 	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
 							   filters,
 							   values));
+	if (pk_backend_reader_run (backend, job, filters, values, FALSE))
+		return;
 	backend->priv->desc->search_details (backend, job, filters, values);
 }
 
@@ -1491,6 +2029,8 @@ pk_backend_search_files (PkBackend *backend,
 	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
 							   filters,
 							   values));
+	if (pk_backend_reader_run (backend, job, filters, values, FALSE))
+		return;
 	backend->priv->desc->search_files (backend, job, filters, values);
 }
 
@@ -1511,6 +2051,8 @@ pk_backend_search_groups (PkBackend *backend,
 	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
 							   filters,
 							   values));
+	if (pk_backend_reader_run (backend, job, filters, values, FALSE))
+		return;
 	backend->priv->desc->search_groups (backend, job, filters, values);
 }
 
@@ -1531,6 +2073,8 @@ pk_backend_search_names (PkBackend *backend,
 	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
 							   filters,
 							   values));
+	if (pk_backend_reader_run (backend, job, filters, values, FALSE))
+		return;
 	backend->priv->desc->search_names (backend, job, filters, values);
 }
 
@@ -1644,6 +2188,8 @@ pk_backend_what_provides (PkBackend *backend, PkBackendJob *job,
 	pk_backend_job_set_parameters (job, g_variant_new ("(t^as)",
 							   filters,
 							   values));
+	if (pk_backend_reader_run (backend, job, filters, values, FALSE))
+		return;
 	backend->priv->desc->what_provides (backend, job, filters, values);
 }
 
@@ -1660,6 +2206,8 @@ pk_backend_get_packages (PkBackend *backend, PkBackendJob *job, PkBitfield filte
 	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_PACKAGES);
 	pk_backend_job_set_parameters (job, g_variant_new ("(t)",
 							   filters));
+	if (pk_backend_reader_run (backend, job, filters, NULL, FALSE))
+		return;
 	backend->priv->desc->get_packages (backend, job, filters);
 }
 
@@ -1706,6 +2254,78 @@ pk_backend_repair_system (PkBackend *backend, PkBackendJob *job, PkBitfield tran
 	backend->priv->desc->repair_system (backend, job, transaction_flags);
 }
 
+gboolean
+pk_backend_can_prewarm (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
+	if (backend->priv->desc == NULL)
+		return FALSE;
+	return backend->priv->desc->prewarm != NULL;
+}
+
+/**
+ * pk_backend_prewarm:
+ *
+ * Loads whatever the backend caches between transactions, such as the
+ * package sack, so the next query does not have to. The job has the
+ * GetUpdates role as that is the query clients run after boot and after
+ * every change, and the backend should do the same locking as for it.
+ * Nothing is emitted from the job apart from ::Finished.
+ **/
+void
+pk_backend_prewarm (PkBackend *backend, PkBackendJob *job)
+{
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_return_if_fail (backend->priv->desc->prewarm != NULL);
+	g_return_if_fail (pk_is_thread_default ());
+
+	/* final pre-flight checks */
+	g_assert (pk_backend_job_get_vfunc_enabled (job, PK_BACKEND_SIGNAL_FINISHED));
+
+	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_UPDATES);
+	pk_backend_job_set_parameters (job, g_variant_new ("(t)",
+							   pk_bitfield_value (PK_FILTER_ENUM_NONE)));
+	backend->priv->desc->prewarm (backend, job);
+}
+
+gboolean
+pk_backend_can_get_commands (PkBackend *backend)
+{
+	g_return_val_if_fail (PK_IS_BACKEND (backend), FALSE);
+	if (backend->priv->desc == NULL)
+		return FALSE;
+	return backend->priv->desc->get_commands != NULL;
+}
+
+/**
+ * pk_backend_get_commands:
+ *
+ * Lists the commands that could be installed, used to build the index
+ * for command-not-found. The backend emits ::Files for each available
+ * package with the files it has in the bin directories; any other files
+ * are ignored, so backends that cannot filter cheaply can send them all.
+ * The job has the GetFiles role and does not refresh the metadata.
+ **/
+void
+pk_backend_get_commands (PkBackend *backend, PkBackendJob *job)
+{
+	PkBitfield filters;
+
+	g_return_if_fail (PK_IS_BACKEND (backend));
+	g_return_if_fail (backend->priv->desc->get_commands != NULL);
+	g_return_if_fail (pk_is_thread_default ());
+
+	/* final pre-flight checks */
+	g_assert (pk_backend_job_get_vfunc_enabled (job, PK_BACKEND_SIGNAL_FINISHED));
+
+	filters = pk_bitfield_from_enums (PK_FILTER_ENUM_NOT_INSTALLED,
+					  PK_FILTER_ENUM_NEWEST,
+					  PK_FILTER_ENUM_ARCH, -1);
+	pk_backend_job_set_role (job, PK_ROLE_ENUM_GET_FILES);
+	pk_backend_job_set_parameters (job, g_variant_new ("(t)", filters));
+	backend->priv->desc->get_commands (backend, job);
+}
+
 static void
 pk_backend_init (PkBackend *backend)
 {
@@ -1715,8 +2335,16 @@ pk_backend_init (PkBackend *backend)
 							    g_direct_equal,
 							    NULL,
 							    g_free);
+	backend->priv->role_thread_pools = g_hash_table_new_full (g_direct_hash,
+								  g_direct_equal,
+								  NULL,
+								  pk_backend_thread_pool_destroy);
+	backend->priv->thread_pool_size = 8;
 	g_mutex_init (&backend->priv->eulas_mutex);
 	g_mutex_init (&backend->priv->thread_hash_mutex);
+	g_mutex_init (&backend->priv->epoch_mutex);
+	backend->priv->epochs[PK_BACKEND_EPOCH_INSTALLED] = g_get_real_time ();
+	backend->priv->epochs[PK_BACKEND_EPOCH_AVAILABLE] = g_get_real_time ();
 }
 
 PkBackend *
@@ -1725,6 +2353,15 @@ pk_backend_new (GKeyFile *conf)
 	PkBackend *backend;
 	backend = g_object_new (PK_TYPE_BACKEND, NULL);
 	backend->priv->conf = g_key_file_ref (conf);
+	if (g_key_file_has_key (conf, "Daemon", "BackendThreadPoolSize", NULL)) {
+		gint pool_size = g_key_file_get_integer (conf, "Daemon", "BackendThreadPoolSize", NULL);
+		/* exclusive pools cannot be unlimited */
+		if (pool_size > 0)
+			backend->priv->thread_pool_size = pool_size;
+		else
+			g_warning ("BackendThreadPoolSize must be at least 1, using %i",
+				   backend->priv->thread_pool_size);
+	}
 	return PK_BACKEND (backend);
 }
 
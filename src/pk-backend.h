@@ -70,6 +70,19 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkBackend, g_object_unref)
  */
 #define PK_BACKEND_PERCENTAGE_INVALID		101
 
+/**
+ * PkBackendEpoch:
+ * @PK_BACKEND_EPOCH_INSTALLED: the installed packages
+ * @PK_BACKEND_EPOCH_AVAILABLE: the repositories and their metadata
+ *
+ * The package data a cache can depend on.
+ */
+typedef enum {
+	PK_BACKEND_EPOCH_INSTALLED,
+	PK_BACKEND_EPOCH_AVAILABLE,
+	PK_BACKEND_EPOCH_LAST
+} PkBackendEpoch;
+
 GType		 pk_backend_get_type			(void);
 PkBackend	*pk_backend_new				(GKeyFile		*conf);
 
@@ -90,6 +103,10 @@ void		 pk_backend_installed_db_changed	(PkBackend      *backend);
 gboolean	 pk_backend_updates_changed		(PkBackend	*backend);
 gboolean	 pk_backend_updates_changed_delay	(PkBackend	*backend,
 							 guint		 timeout);
+guint64		 pk_backend_get_epoch			(PkBackend	*backend,
+							 PkBackendEpoch	 epoch);
+guint64		 pk_backend_bump_epoch			(PkBackend	*backend,
+							 PkBackendEpoch	 epoch);
 
 void		 pk_backend_transaction_inhibit_start	(PkBackend      *backend);
 void		 pk_backend_transaction_inhibit_end	(PkBackend      *backend);
@@ -119,6 +136,9 @@ PkBitfield	 pk_backend_get_filters			(PkBackend	*backend);
 PkBitfield	 pk_backend_get_roles			(PkBackend	*backend);
 gchar		**pk_backend_get_mime_types		(PkBackend	*backend);
 gboolean	 pk_backend_supports_parallelization	(PkBackend	*backend);
+gboolean	 pk_backend_supports_roots		(PkBackend	*backend);
+gboolean	 pk_backend_watches_repos		(PkBackend	*backend);
+PkBitfield	 pk_backend_get_reader_roles		(PkBackend	*backend);
 void		 pk_backend_initialize			(GKeyFile		*conf,
 							 PkBackend	*backend);
 void		 pk_backend_destroy			(PkBackend	*backend);
@@ -242,6 +262,12 @@ void		 pk_backend_upgrade_system		(PkBackend	*backend,
 void		 pk_backend_repair_system		(PkBackend	*backend,
 							 PkBackendJob	*job,
 							 PkBitfield	 transaction_flags);
+gboolean	 pk_backend_can_prewarm			(PkBackend	*backend);
+void		 pk_backend_prewarm			(PkBackend	*backend,
+							 PkBackendJob	*job);
+gboolean	 pk_backend_can_get_commands		(PkBackend	*backend);
+void		 pk_backend_get_commands		(PkBackend	*backend,
+							 PkBackendJob	*job);
 
 /* thread helpers */
 void		 pk_backend_thread_start		(PkBackend	*backend,
@@ -250,6 +276,15 @@ void		 pk_backend_thread_start		(PkBackend	*backend,
 void		 pk_backend_thread_stop			(PkBackend	*backend,
 							 PkBackendJob	*job,
 							 gpointer	 func);
+void		 pk_backend_thread_push			(PkBackend	*backend,
+							 PkRoleEnum	 role,
+							 GThreadFunc	 func,
+							 gpointer	 user_data);
+gpointer	 pk_backend_thread_get_context		(PkBackend	*backend);
+GMainContext	*pk_backend_get_io_context		(PkBackend	*backend);
+void		 pk_backend_thread_set_context		(PkBackend	*backend,
+							 gpointer	 data,
+							 GDestroyNotify	 destroy_func);
 
 /* global backend state */
 void		 pk_backend_accept_eula			(PkBackend	*backend,
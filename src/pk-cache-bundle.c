@@ -0,0 +1,710 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A bundle is the downloaded metadata and the caches built from it, so a
+ * new host of the same release can start without refreshing:
+ *
+ *   "PKBUNDLE"
+ *   header:  uint32 length, a{sv} with version, distro-id, backend, created
+ *   entries: uint32 length, (sut) path, mode and size, then the contents
+ *   end:     uint32 length, (sut) with an empty path
+ *   trailer: the SHA256 of everything before it
+ *
+ * The lengths are big endian and the variants are in normal form. A
+ * bundle is imported only with a detached OpenPGP signature by one of the
+ * keys the administrator configured. It is copied to a private directory
+ * and checked there before anything is unpacked, the files are then
+ * written next to the ones they replace and renamed over them once the
+ * trailer matches, and only ever below the configured roots.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "pk-cache-bundle.h"
+#include "pk-shared.h"
+
+#define PK_CACHE_BUNDLE_MAGIC		"PKBUNDLE"
+#define PK_CACHE_BUNDLE_VERSION		1
+#define PK_CACHE_BUNDLE_STAGING_DIR	LOCALSTATEDIR "/cache/PackageKit/bundle-import"
+#define PK_CACHE_BUNDLE_SPOOL		PK_CACHE_BUNDLE_STAGING_DIR "/bundle"
+#define PK_CACHE_BUNDLE_SPOOL_SIG	PK_CACHE_BUNDLE_STAGING_DIR "/bundle.sig"
+
+/* a detached signature is a few hundred bytes */
+#define PK_CACHE_BUNDLE_MAX_SIGNATURE	(64 * 1024)
+
+/* the file being imported and the one it replaces, in the same directory */
+#define PK_CACHE_BUNDLE_SUFFIX_NEW	".pk-bundle-new"
+#define PK_CACHE_BUNDLE_SUFFIX_OLD	".pk-bundle-old"
+
+/* the records are small, the file contents are streamed */
+#define PK_CACHE_BUNDLE_MAX_RECORD	(64 * 1024)
+
+/* the metadata and caches of every backend, the ones not in use are missing */
+static const gchar *pk_cache_bundle_roots_default[] = {
+	"/var/lib/apt/lists",
+	"/var/cache/apt/pkgcache.bin",
+	"/var/cache/apt/srcpkgcache.bin",
+	"/var/cache/PackageKit",
+	"/var/cache/zypp/raw",
+	"/var/cache/zypp/solv",
+	"/var/lib/pacman/sync",
+	"/var/lib/PackageKit/command-index",
+	"/var/lib/PackageKit/package-names",
+	NULL };
+
+/* state of this host rather than of the repositories */
+static const gchar *pk_cache_bundle_excluded[] = {
+	"bundle-import",
+	"downloads",
+	"downloads.stale",
+	"lock",
+	"partial",
+	"peer-cache",
+	"warm-state",
+	NULL };
+
+/**
+ * pk_cache_bundle_get_roots:
+ *
+ * Returns: the files and directories a bundle is made of, from
+ * CacheBundlePaths or the defaults
+ **/
+gchar **
+pk_cache_bundle_get_roots (GKeyFile *conf)
+{
+	gchar **roots;
+
+	roots = g_key_file_get_string_list (conf, "Daemon", "CacheBundlePaths", NULL, NULL);
+	if (roots != NULL)
+		return roots;
+	return g_strdupv ((gchar **) pk_cache_bundle_roots_default);
+}
+
+static gboolean
+pk_cache_bundle_is_excluded (const gchar *name)
+{
+	return g_strv_contains ((const gchar * const *) pk_cache_bundle_excluded, name);
+}
+
+/* absolute, without . or .. components, and below one of the roots */
+static gboolean
+pk_cache_bundle_path_is_valid (gchar **roots, const gchar *path)
+{
+	g_auto(GStrv) split = NULL;
+
+	if (!g_path_is_absolute (path))
+		return FALSE;
+	split = g_strsplit (path + 1, "/", -1);
+	for (guint i = 0; split[i] != NULL; i++) {
+		if (split[i][0] == '\0' ||
+		    g_strcmp0 (split[i], ".") == 0 ||
+		    g_strcmp0 (split[i], "..") == 0 ||
+		    g_str_has_suffix (split[i], PK_CACHE_BUNDLE_SUFFIX_NEW) ||
+		    g_str_has_suffix (split[i], PK_CACHE_BUNDLE_SUFFIX_OLD) ||
+		    pk_cache_bundle_is_excluded (split[i]))
+			return FALSE;
+	}
+	for (guint i = 0; roots[i] != NULL; i++) {
+		gsize len = strlen (roots[i]);
+		if (g_strcmp0 (path, roots[i]) == 0)
+			return TRUE;
+		if (strncmp (path, roots[i], len) == 0 && path[len] == '/')
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static gboolean
+pk_cache_bundle_write (GOutputStream *stream,
+		       GChecksum *checksum,
+		       const void *data,
+		       gsize len,
+		       GCancellable *cancellable,
+		       GError **error)
+{
+	g_checksum_update (checksum, data, len);
+	return g_output_stream_write_all (stream, data, len, NULL, cancellable, error);
+}
+
+static gboolean
+pk_cache_bundle_read (GInputStream *stream,
+		      GChecksum *checksum,
+		      void *data,
+		      gsize len,
+		      GCancellable *cancellable,
+		      GError **error)
+{
+	gsize bytes_read = 0;
+
+	if (!g_input_stream_read_all (stream, data, len, &bytes_read, cancellable, error))
+		return FALSE;
+	if (bytes_read != len) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+				     "bundle is truncated");
+		return FALSE;
+	}
+	if (checksum != NULL)
+		g_checksum_update (checksum, data, len);
+	return TRUE;
+}
+
+static gboolean
+pk_cache_bundle_write_record (GOutputStream *stream,
+			      GChecksum *checksum,
+			      GVariant *record,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	g_autoptr(GVariant) sunk = g_variant_ref_sink (record);
+	g_autoptr(GVariant) normal = g_variant_get_normal_form (sunk);
+	guint32 len = GUINT32_TO_BE ((guint32) g_variant_get_size (normal));
+
+	if (!pk_cache_bundle_write (stream, checksum, &len, sizeof (len), cancellable, error))
+		return FALSE;
+	return pk_cache_bundle_write (stream, checksum,
+				      g_variant_get_data (normal),
+				      g_variant_get_size (normal),
+				      cancellable, error);
+}
+
+static GVariant *
+pk_cache_bundle_read_record (GInputStream *stream,
+			     GChecksum *checksum,
+			     const GVariantType *type,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	guint32 len;
+	g_autofree guint8 *data = NULL;
+	g_autoptr(GVariant) record = NULL;
+
+	if (!pk_cache_bundle_read (stream, checksum, &len, sizeof (len), cancellable, error))
+		return NULL;
+	len = GUINT32_FROM_BE (len);
+	if (len > PK_CACHE_BUNDLE_MAX_RECORD) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "record of %u bytes is too large", len);
+		return NULL;
+	}
+	data = g_malloc (len);
+	if (!pk_cache_bundle_read (stream, checksum, data, len, cancellable, error))
+		return NULL;
+	record = g_variant_new_from_data (type, data, len, FALSE, g_free, data);
+	data = NULL;
+	if (!g_variant_is_normal_form (record)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "record is invalid");
+		return NULL;
+	}
+	return g_steal_pointer (&record);
+}
+
+static gboolean
+pk_cache_bundle_export_file (GOutputStream *stream,
+			     GChecksum *checksum,
+			     const gchar *path,
+			     GStatBuf *st,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	guint64 remaining = (guint64) st->st_size;
+	guint8 buf[64 * 1024];
+	g_autoptr(GFile) file = g_file_new_for_path (path);
+	g_autoptr(GFileInputStream) input = NULL;
+
+	input = g_file_read (file, cancellable, error);
+	if (input == NULL)
+		return FALSE;
+	if (!pk_cache_bundle_write_record (stream, checksum,
+					   g_variant_new ("(sut)", path,
+							  (guint32) (st->st_mode & 0777),
+							  remaining),
+					   cancellable, error))
+		return FALSE;
+
+	/* exactly the size in the record, even if the file is being changed */
+	while (remaining > 0) {
+		gsize len = MIN (remaining, sizeof (buf));
+		if (!pk_cache_bundle_read (G_INPUT_STREAM (input), NULL, buf, len, cancellable, error)) {
+			g_prefix_error (error, "%s changed while being exported: ", path);
+			return FALSE;
+		}
+		if (!pk_cache_bundle_write (stream, checksum, buf, len, cancellable, error))
+			return FALSE;
+		remaining -= len;
+	}
+	return TRUE;
+}
+
+static gboolean
+pk_cache_bundle_export_path (GOutputStream *stream,
+			     GChecksum *checksum,
+			     const gchar *path,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	GStatBuf st;
+	const gchar *name;
+	g_autoptr(GDir) dir = NULL;
+
+	/* links could point anywhere, and nothing is missed by not following them */
+	if (g_lstat (path, &st) != 0)
+		return TRUE;
+	if (S_ISREG (st.st_mode))
+		return pk_cache_bundle_export_file (stream, checksum, path, &st, cancellable, error);
+	if (!S_ISDIR (st.st_mode))
+		return TRUE;
+
+	dir = g_dir_open (path, 0, error);
+	if (dir == NULL)
+		return FALSE;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *child = NULL;
+		if (pk_cache_bundle_is_excluded (name))
+			continue;
+		child = g_build_filename (path, name, NULL);
+		if (!pk_cache_bundle_export_path (stream, checksum, child, cancellable, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_cache_bundle_export:
+ * @roots: the files and directories to export
+ * @distro_id: the distro, release and arch the caches are for
+ * @backend_name: the backend that built them
+ *
+ * Writes the roots that exist to @stream as a bundle.
+ **/
+gboolean
+pk_cache_bundle_export (GOutputStream *stream,
+			gchar **roots,
+			const gchar *distro_id,
+			const gchar *backend_name,
+			GCancellable *cancellable,
+			GError **error)
+{
+	GVariantBuilder builder;
+	guint8 digest[32];
+	gsize digest_len = sizeof (digest);
+	g_autoptr(GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+	if (!pk_cache_bundle_write (stream, checksum, PK_CACHE_BUNDLE_MAGIC,
+				    strlen (PK_CACHE_BUNDLE_MAGIC), cancellable, error))
+		return FALSE;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&builder, "{sv}", "version",
+			       g_variant_new_uint32 (PK_CACHE_BUNDLE_VERSION));
+	g_variant_builder_add (&builder, "{sv}", "distro-id",
+			       g_variant_new_string (distro_id));
+	g_variant_builder_add (&builder, "{sv}", "backend",
+			       g_variant_new_string (backend_name));
+	g_variant_builder_add (&builder, "{sv}", "created",
+			       g_variant_new_int64 (g_get_real_time () / G_USEC_PER_SEC));
+	if (!pk_cache_bundle_write_record (stream, checksum, g_variant_builder_end (&builder),
+					   cancellable, error))
+		return FALSE;
+
+	for (guint i = 0; roots[i] != NULL; i++) {
+		if (!pk_cache_bundle_export_path (stream, checksum, roots[i], cancellable, error))
+			return FALSE;
+	}
+	if (!pk_cache_bundle_write_record (stream, checksum,
+					   g_variant_new ("(sut)", "", 0, (guint64) 0),
+					   cancellable, error))
+		return FALSE;
+
+	g_checksum_get_digest (checksum, digest, &digest_len);
+	if (!g_output_stream_write_all (stream, digest, digest_len, NULL, cancellable, error))
+		return FALSE;
+	return g_output_stream_close (stream, cancellable, error);
+}
+
+static gboolean
+pk_cache_bundle_check_header (GVariant *header,
+			      const gchar *distro_id,
+			      const gchar *backend_name,
+			      GError **error)
+{
+	guint32 version = 0;
+	const gchar *tmp = "unknown";
+
+	if (!g_variant_lookup (header, "version", "u", &version) ||
+	    version != PK_CACHE_BUNDLE_VERSION) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     "bundle version %u is not supported", version);
+		return FALSE;
+	}
+	if (!g_variant_lookup (header, "distro-id", "&s", &tmp) ||
+	    g_strcmp0 (tmp, distro_id) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "bundle is for %s, not %s", tmp, distro_id);
+		return FALSE;
+	}
+	if (!g_variant_lookup (header, "backend", "&s", &tmp) ||
+	    g_strcmp0 (tmp, backend_name) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "bundle was made by the %s backend, not %s", tmp, backend_name);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+pk_cache_bundle_spool (GInputStream *stream,
+		       const gchar *filename,
+		       goffset max_size,
+		       GCancellable *cancellable,
+		       GError **error)
+{
+	gssize len;
+	goffset total = 0;
+	guint8 buf[64 * 1024];
+	g_autoptr(GFile) file = g_file_new_for_path (filename);
+	g_autoptr(GFileOutputStream) output = NULL;
+
+	output = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE, cancellable, error);
+	if (output == NULL)
+		return FALSE;
+	while ((len = g_input_stream_read (stream, buf, sizeof (buf), cancellable, error)) > 0) {
+		total += len;
+		if (max_size > 0 && total > max_size) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "more than %" G_GOFFSET_FORMAT " bytes", max_size);
+			return FALSE;
+		}
+		if (!g_output_stream_write_all (G_OUTPUT_STREAM (output), buf, (gsize) len,
+						NULL, cancellable, error))
+			return FALSE;
+	}
+	if (len < 0)
+		return FALSE;
+	return g_output_stream_close (G_OUTPUT_STREAM (output), cancellable, error);
+}
+
+/* only the keys in @keyring count, never the ones root happens to have */
+static gboolean
+pk_cache_bundle_verify (const gchar *keyring, GCancellable *cancellable, GError **error)
+{
+	g_autoptr(GSubprocess) subprocess = NULL;
+	g_autoptr(GSubprocessLauncher) launcher = NULL;
+
+	launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_STDOUT_SILENCE |
+					      G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+	g_subprocess_launcher_setenv (launcher, "GNUPGHOME", PK_CACHE_BUNDLE_STAGING_DIR, TRUE);
+	subprocess = g_subprocess_launcher_spawn (launcher, error,
+						  "gpgv", "--keyring", keyring,
+						  PK_CACHE_BUNDLE_SPOOL_SIG,
+						  PK_CACHE_BUNDLE_SPOOL,
+						  NULL);
+	if (subprocess == NULL)
+		return FALSE;
+	if (!g_subprocess_wait_check (subprocess, cancellable, error)) {
+		g_prefix_error (error, "bundle is not signed by a key in %s: ", keyring);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* remembers what it created, so a failed import can remove it again */
+static gboolean
+pk_cache_bundle_ensure_dir (const gchar *path, GPtrArray *created, GError **error)
+{
+	g_autofree gchar *parent = NULL;
+
+	if (g_file_test (path, G_FILE_TEST_IS_DIR))
+		return TRUE;
+	parent = g_path_get_dirname (path);
+	if (g_strcmp0 (parent, path) != 0 &&
+	    !pk_cache_bundle_ensure_dir (parent, created, error))
+		return FALSE;
+	if (g_mkdir (path, 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", path, g_strerror (errno));
+		return FALSE;
+	}
+	g_ptr_array_add (created, g_strdup (path));
+	return TRUE;
+}
+
+/* next to the file it replaces, so it can be renamed over it */
+static gboolean
+pk_cache_bundle_stage_file (GInputStream *stream,
+			    GChecksum *checksum,
+			    const gchar *path,
+			    guint32 mode,
+			    guint64 size,
+			    GPtrArray *created,
+			    GCancellable *cancellable,
+			    GError **error)
+{
+	GStatBuf st;
+	guint8 buf[64 * 1024];
+	g_autofree gchar *dirname = g_path_get_dirname (path);
+	g_autofree gchar *staged = g_strconcat (path, PK_CACHE_BUNDLE_SUFFIX_NEW, NULL);
+	g_autoptr(GFile) file = g_file_new_for_path (staged);
+	g_autoptr(GFileOutputStream) output = NULL;
+
+	if (g_lstat (path, &st) == 0 && S_ISDIR (st.st_mode)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY,
+			     "bundle cannot replace the directory %s", path);
+		return FALSE;
+	}
+	if (!pk_cache_bundle_ensure_dir (dirname, created, error))
+		return FALSE;
+	output = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE, cancellable, error);
+	if (output == NULL)
+		return FALSE;
+	while (size > 0) {
+		gsize len = MIN (size, sizeof (buf));
+		if (!pk_cache_bundle_read (stream, checksum, buf, len, cancellable, error))
+			return FALSE;
+		if (!g_output_stream_write_all (G_OUTPUT_STREAM (output), buf, len,
+						NULL, cancellable, error))
+			return FALSE;
+		size -= len;
+	}
+	if (!g_output_stream_close (G_OUTPUT_STREAM (output), cancellable, error))
+		return FALSE;
+	if (g_chmod (staged, mode & 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to set the mode of %s: %s", staged, g_strerror (errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* either every file is replaced or, after putting the old ones back, none */
+static gboolean
+pk_cache_bundle_swap (GPtrArray *paths, GError **error)
+{
+	guint i;
+	g_autofree gboolean *had_old = g_new0 (gboolean, paths->len);
+
+	for (i = 0; i < paths->len; i++) {
+		const gchar *path = g_ptr_array_index (paths, i);
+		g_autofree gchar *staged = g_strconcat (path, PK_CACHE_BUNDLE_SUFFIX_NEW, NULL);
+		g_autofree gchar *old = g_strconcat (path, PK_CACHE_BUNDLE_SUFFIX_OLD, NULL);
+
+		if (g_file_test (path, G_FILE_TEST_EXISTS) || g_file_test (path, G_FILE_TEST_IS_SYMLINK)) {
+			if (g_rename (path, old) != 0) {
+				g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+					     "failed to move %s aside: %s", path, g_strerror (errno));
+				break;
+			}
+			had_old[i] = TRUE;
+		}
+		if (g_rename (staged, path) != 0) {
+			g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+				     "failed to replace %s: %s", path, g_strerror (errno));
+			break;
+		}
+	}
+
+	/* nothing can fail from here on */
+	if (i == paths->len) {
+		for (i = 0; i < paths->len; i++) {
+			g_autofree gchar *old = NULL;
+			if (!had_old[i])
+				continue;
+			old = g_strconcat (g_ptr_array_index (paths, i), PK_CACHE_BUNDLE_SUFFIX_OLD, NULL);
+			g_unlink (old);
+		}
+		return TRUE;
+	}
+
+	for (guint j = i + 1; j-- > 0;) {
+		const gchar *path = g_ptr_array_index (paths, j);
+		g_autofree gchar *old = g_strconcat (path, PK_CACHE_BUNDLE_SUFFIX_OLD, NULL);
+
+		if (had_old[j]) {
+			if (g_rename (old, path) != 0)
+				g_warning ("failed to restore %s: %s", path, g_strerror (errno));
+		} else if (j < i) {
+			g_unlink (path);
+		}
+	}
+	return FALSE;
+}
+
+static gboolean
+pk_cache_bundle_unpack (GInputStream *stream,
+			gchar **roots,
+			const gchar *distro_id,
+			const gchar *backend_name,
+			GPtrArray *paths,
+			GPtrArray *created,
+			GCancellable *cancellable,
+			GError **error)
+{
+	gchar magic[sizeof (PK_CACHE_BUNDLE_MAGIC) - 1];
+	guint8 digest[32];
+	guint8 trailer[32];
+	gsize digest_len = sizeof (digest);
+	g_autoptr(GChecksum) checksum = g_checksum_new (G_CHECKSUM_SHA256);
+	g_autoptr(GHashTable) seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_autoptr(GVariant) header = NULL;
+
+	if (!pk_cache_bundle_read (stream, checksum, magic, sizeof (magic), cancellable, error))
+		return FALSE;
+	if (memcmp (magic, PK_CACHE_BUNDLE_MAGIC, sizeof (magic)) != 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "not a cache bundle");
+		return FALSE;
+	}
+	header = pk_cache_bundle_read_record (stream, checksum, G_VARIANT_TYPE_VARDICT,
+					      cancellable, error);
+	if (header == NULL)
+		return FALSE;
+	if (!pk_cache_bundle_check_header (header, distro_id, backend_name, error))
+		return FALSE;
+
+	for (;;) {
+		const gchar *path;
+		guint32 mode;
+		guint64 size;
+		g_autoptr(GVariant) entry = NULL;
+
+		entry = pk_cache_bundle_read_record (stream, checksum, G_VARIANT_TYPE ("(sut)"),
+						     cancellable, error);
+		if (entry == NULL)
+			return FALSE;
+		g_variant_get (entry, "(&sut)", &path, &mode, &size);
+		if (path[0] == '\0')
+			break;
+		if (!pk_cache_bundle_path_is_valid (roots, path)) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+				     "bundle cannot write to %s", path);
+			return FALSE;
+		}
+		if (!g_hash_table_add (seen, g_strdup (path))) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "bundle has %s twice", path);
+			return FALSE;
+		}
+		g_ptr_array_add (paths, g_strdup (path));
+		if (!pk_cache_bundle_stage_file (stream, checksum, path, mode, size,
+						 created, cancellable, error))
+			return FALSE;
+	}
+
+	/* the trailer covers everything above */
+	if (!pk_cache_bundle_read (stream, NULL, trailer, sizeof (trailer), cancellable, error))
+		return FALSE;
+	g_checksum_get_digest (checksum, digest, &digest_len);
+	if (memcmp (digest, trailer, sizeof (trailer)) != 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "bundle checksum does not match");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_cache_bundle_import:
+ * @stream: the bundle
+ * @signature: a detached OpenPGP signature of the bundle
+ * @keyring: the keys the bundle may be signed with, from CacheBundleKeyring
+ * @roots: where the bundle may write to
+ * @distro_id: the distro, release and arch of this host
+ * @backend_name: the backend of this host
+ *
+ * Reads a bundle from @stream and, if it is signed by a key in @keyring,
+ * is complete, was made for this release and backend and only has files
+ * below @roots, puts the files in place. Nothing is unpacked before the
+ * signature is checked, and nothing is changed if any of that is not true.
+ **/
+gboolean
+pk_cache_bundle_import (GInputStream *stream,
+			GInputStream *signature,
+			const gchar *keyring,
+			gchar **roots,
+			const gchar *distro_id,
+			const gchar *backend_name,
+			GCancellable *cancellable,
+			GError **error)
+{
+	gboolean ret = FALSE;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GFileInputStream) spooled = NULL;
+	g_autoptr(GPtrArray) created = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func (g_free);
+
+	if (keyring == NULL || !g_path_is_absolute (keyring) ||
+	    !g_file_test (keyring, G_FILE_TEST_IS_REGULAR)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "CacheBundleKeyring is not set to a keyring");
+		return FALSE;
+	}
+
+	/* left over from an import that was interrupted */
+	if (g_file_test (PK_CACHE_BUNDLE_STAGING_DIR, G_FILE_TEST_IS_DIR))
+		pk_directory_remove_contents (PK_CACHE_BUNDLE_STAGING_DIR);
+	if (g_mkdir_with_parents (PK_CACHE_BUNDLE_STAGING_DIR, 0700) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s",
+			     PK_CACHE_BUNDLE_STAGING_DIR, g_strerror (errno));
+		return FALSE;
+	}
+
+	/* the caller could change the file after it has been checked */
+	if (!pk_cache_bundle_spool (signature, PK_CACHE_BUNDLE_SPOOL_SIG,
+				    PK_CACHE_BUNDLE_MAX_SIGNATURE, cancellable, error)) {
+		g_prefix_error (error, "failed to read the signature: ");
+		goto out;
+	}
+	if (!pk_cache_bundle_spool (stream, PK_CACHE_BUNDLE_SPOOL, 0, cancellable, error)) {
+		g_prefix_error (error, "failed to read the bundle: ");
+		goto out;
+	}
+	if (!pk_cache_bundle_verify (keyring, cancellable, error))
+		goto out;
+
+	file = g_file_new_for_path (PK_CACHE_BUNDLE_SPOOL);
+	spooled = g_file_read (file, cancellable, error);
+	if (spooled == NULL)
+		goto out;
+	if (!pk_cache_bundle_unpack (G_INPUT_STREAM (spooled), roots, distro_id, backend_name,
+				     paths, created, cancellable, error))
+		goto out;
+	if (!pk_cache_bundle_swap (paths, error))
+		goto out;
+	g_debug ("imported %u files from a cache bundle", paths->len);
+	ret = TRUE;
+out:
+	for (guint i = 0; i < paths->len; i++) {
+		g_autofree gchar *staged = g_strconcat (g_ptr_array_index (paths, i),
+							PK_CACHE_BUNDLE_SUFFIX_NEW, NULL);
+		g_unlink (staged);
+	}
+	for (guint i = created->len; !ret && i > 0; i--)
+		g_rmdir (g_ptr_array_index (created, i - 1));
+	pk_directory_remove_contents (PK_CACHE_BUNDLE_STAGING_DIR);
+	g_rmdir (PK_CACHE_BUNDLE_STAGING_DIR);
+	return ret;
+}
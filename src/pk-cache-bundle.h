@@ -0,0 +1,47 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_CACHE_BUNDLE_H
+#define __PK_CACHE_BUNDLE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gchar		**pk_cache_bundle_get_roots		(GKeyFile		*conf);
+gboolean	 pk_cache_bundle_export			(GOutputStream		*stream,
+							 gchar			**roots,
+							 const gchar		*distro_id,
+							 const gchar		*backend_name,
+							 GCancellable		*cancellable,
+							 GError			**error);
+gboolean	 pk_cache_bundle_import			(GInputStream		*stream,
+							 GInputStream		*signature,
+							 const gchar		*keyring,
+							 gchar			**roots,
+							 const gchar		*distro_id,
+							 const gchar		*backend_name,
+							 GCancellable		*cancellable,
+							 GError			**error);
+
+G_END_DECLS
+
+#endif /* __PK_CACHE_BUNDLE_H */
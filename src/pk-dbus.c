@@ -33,18 +33,129 @@
 
 #define PK_DBUS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_DBUS, PkDbusPrivate))
 
+/* what we know about a caller; the cmdline and the session are only
+ * looked up when something asks for them */
+typedef struct {
+	guint			 uid;
+	guint			 pid;
+	gchar			*cmdline;
+	gboolean		 cmdline_valid;
+	gchar			*session;
+	gboolean		 session_valid;
+} PkDbusCredentials;
+
 struct PkDbusPrivate
 {
 	GDBusConnection		*connection;
 	GDBusProxy		*proxy_pid;
 	GDBusProxy		*proxy_uid;
 	GDBusProxy		*proxy_session;
+	GHashTable		*credentials;
+	PkDbusCredentials	*credentials_uncached;
+	guint			 name_owner_changed_id;
 };
 
 static gpointer pk_dbus_object = NULL;
 
 G_DEFINE_TYPE (PkDbus, pk_dbus, G_TYPE_OBJECT)
 
+static void
+pk_dbus_credentials_free (PkDbusCredentials *credentials)
+{
+	g_free (credentials->cmdline);
+	g_free (credentials->session);
+	g_free (credentials);
+}
+
+/* for buses that do not have GetConnectionCredentials */
+static guint
+pk_dbus_get_connection_uint (GDBusProxy *proxy, const gchar *method, const gchar *sender)
+{
+	guint value_uint = G_MAXUINT;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	if (proxy == NULL)
+		return G_MAXUINT;
+	value = g_dbus_proxy_call_sync (proxy,
+					method,
+					g_variant_new ("(s)",
+						       sender),
+					G_DBUS_CALL_FLAGS_NONE,
+					2000,
+					NULL,
+					&error);
+	if (value == NULL) {
+		g_warning ("Failed to %s for %s: %s",
+			   method, sender, error->message);
+		return G_MAXUINT;
+	}
+	g_variant_get (value, "(u)", &value_uint);
+	return value_uint;
+}
+
+/**
+ * pk_dbus_get_credentials:
+ *
+ * Gets the UID and PID of @sender in one round trip, and remembers them
+ * until the name goes away.
+ *
+ * Return value: the credentials, or %NULL if there is no connection
+ **/
+static PkDbusCredentials *
+pk_dbus_get_credentials (PkDbus *dbus, const gchar *sender)
+{
+	PkDbusCredentials *credentials;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) dict = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	/* no connection to DBus */
+	if (dbus->priv->proxy_uid == NULL)
+		return NULL;
+
+	credentials = g_hash_table_lookup (dbus->priv->credentials, sender);
+	if (credentials != NULL)
+		return credentials;
+
+	credentials = g_new0 (PkDbusCredentials, 1);
+	credentials->uid = G_MAXUINT;
+	credentials->pid = G_MAXUINT;
+	value = g_dbus_proxy_call_sync (dbus->priv->proxy_uid,
+					"GetConnectionCredentials",
+					g_variant_new ("(s)",
+						       sender),
+					G_DBUS_CALL_FLAGS_NONE,
+					2000,
+					NULL,
+					&error);
+	if (value != NULL) {
+		dict = g_variant_get_child_value (value, 0);
+		g_variant_lookup (dict, "UnixUserID", "u", &credentials->uid);
+		g_variant_lookup (dict, "ProcessID", "u", &credentials->pid);
+	} else {
+		g_debug ("Failed to get credentials for %s: %s",
+			 sender, error->message);
+		credentials->uid = pk_dbus_get_connection_uint (dbus->priv->proxy_uid,
+								"GetConnectionUnixUser",
+								sender);
+		credentials->pid = pk_dbus_get_connection_uint (dbus->priv->proxy_pid,
+								"GetConnectionUnixProcessID",
+								sender);
+	}
+
+	/* only unique names are guaranteed to stay with the same process,
+	 * and failures should be retried; keep these until the next call */
+	if (sender[0] != ':' || credentials->uid == G_MAXUINT) {
+		if (dbus->priv->credentials_uncached != NULL)
+			pk_dbus_credentials_free (dbus->priv->credentials_uncached);
+		dbus->priv->credentials_uncached = credentials;
+		return credentials;
+	}
+	g_hash_table_insert (dbus->priv->credentials, g_strdup (sender), credentials);
+	return credentials;
+}
+
 /**
  * pk_dbus_get_uid:
  * @dbus: the #PkDbus instance
@@ -57,9 +168,7 @@ G_DEFINE_TYPE (PkDbus, pk_dbus, G_TYPE_OBJECT)
 guint
 pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 {
-	guint uid = G_MAXUINT;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GVariant) value = NULL;
+	PkDbusCredentials *credentials;
 
 	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
 	g_return_val_if_fail (sender != NULL, G_MAXUINT);
@@ -73,68 +182,33 @@ pk_dbus_get_uid (PkDbus *dbus, const gchar *sender)
 		g_debug ("using self-check shortcut");
 		return 500;
 	}
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_uid,
-					"GetConnectionUnixUser",
-					g_variant_new ("(s)",
-						       sender),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get uid for %s: %s",
-			   sender, error->message);
+	credentials = pk_dbus_get_credentials (dbus, sender);
+	if (credentials == NULL)
 		return G_MAXUINT;
-	}
-	g_variant_get (value, "(u)", &uid);
-	return uid;
+	return credentials->uid;
 }
 
 /**
  * pk_dbus_get_pid:
  * @dbus: the #PkDbus instance
- * @sender: the sender, usually got from dbus_g_method_get_dbus()
+ * @sender: the sender
  *
  * Gets the process ID.
  *
  * Return value: the PID, or %G_MAXUINT if it could not be obtained
  **/
-static guint
+guint
 pk_dbus_get_pid (PkDbus *dbus, const gchar *sender)
 {
-	guint pid = G_MAXUINT;
-	g_autoptr(GError) error = NULL;
-	g_autoptr(GVariant) value = NULL;
+	PkDbusCredentials *credentials;
 
 	g_return_val_if_fail (PK_IS_DBUS (dbus), G_MAXUINT);
 	g_return_val_if_fail (sender != NULL, G_MAXUINT);
 
-	/* set in the test suite */
-	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
-		g_debug ("using self-check shortcut");
-		return G_MAXUINT - 1;
-	}
-
-	/* no connection to DBus */
-	if (dbus->priv->proxy_pid == NULL)
-		return G_MAXUINT;
-
-	/* get pid from DBus */
-	value = g_dbus_proxy_call_sync (dbus->priv->proxy_pid,
-					"GetConnectionUnixProcessID",
-					g_variant_new ("(s)",
-						       sender),
-					G_DBUS_CALL_FLAGS_NONE,
-					2000,
-					NULL,
-					&error);
-	if (value == NULL) {
-		g_warning ("Failed to get pid for %s: %s",
-			   sender, error->message);
+	credentials = pk_dbus_get_credentials (dbus, sender);
+	if (credentials == NULL)
 		return G_MAXUINT;
-	}
-	g_variant_get (value, "(u)", &pid);
-	return pid;
+	return credentials->pid;
 }
 
 /**
@@ -149,9 +223,7 @@ pk_dbus_get_pid (PkDbus *dbus, const gchar *sender)
 gchar *
 pk_dbus_get_cmdline (PkDbus *dbus, const gchar *sender)
 {
-	gboolean ret;
-	gchar *cmdline = NULL;
-	guint pid;
+	PkDbusCredentials *credentials;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *filename = NULL;
 
@@ -165,18 +237,20 @@ pk_dbus_get_cmdline (PkDbus *dbus, const gchar *sender)
 	}
 
 	/* get pid */
-	pid = pk_dbus_get_pid (dbus, sender);
-	if (pid == G_MAXUINT) {
+	credentials = pk_dbus_get_credentials (dbus, sender);
+	if (credentials == NULL || credentials->pid == G_MAXUINT) {
 		g_warning ("failed to get PID");
 		return NULL;
 	}
+	if (credentials->cmdline_valid)
+		return g_strdup (credentials->cmdline);
 
 	/* get command line from proc */
-	filename = g_strdup_printf ("/proc/%i/cmdline", pid);
-	ret = g_file_get_contents (filename, &cmdline, NULL, &error);
-	if (!ret)
+	filename = g_strdup_printf ("/proc/%u/cmdline", credentials->pid);
+	if (!g_file_get_contents (filename, &credentials->cmdline, NULL, &error))
 		g_warning ("failed to get cmdline: %s", error->message);
-	return cmdline;
+	credentials->cmdline_valid = TRUE;
+	return g_strdup (credentials->cmdline);
 }
 
 #ifdef HAVE_SYSTEMD_SD_LOGIN_H
@@ -219,12 +293,12 @@ pk_dbus_get_session_systemd (guint pid)
 gchar *
 pk_dbus_get_session (PkDbus *dbus, const gchar *sender)
 {
+	PkDbusCredentials *credentials;
 	gchar *session = NULL;
 #ifndef HAVE_SYSTEMD_SD_LOGIN_H
 	g_autoptr(GError) error = NULL;
-#endif
-	guint pid;
 	g_autoptr(GVariant) value = NULL;
+#endif
 
 	g_return_val_if_fail (PK_IS_DBUS (dbus), NULL);
 	g_return_val_if_fail (sender != NULL, NULL);
@@ -232,34 +306,35 @@ pk_dbus_get_session (PkDbus *dbus, const gchar *sender)
 	/* set in the test suite */
 	if (g_strcmp0 (sender, ":org.freedesktop.PackageKit") == 0) {
 		g_debug ("using self-check shortcut");
-		session = g_strdup ("xxx");
-		goto out;
+		return g_strdup ("xxx");
 	}
 
 	/* no ConsoleKit? */
 	if (dbus->priv->proxy_session == NULL) {
 		g_warning ("no ConsoleKit, so cannot get session");
-		goto out;
+		return NULL;
 	}
 
 	/* get pid */
-	pid = pk_dbus_get_pid (dbus, sender);
-	if (pid == G_MAXUINT) {
+	credentials = pk_dbus_get_credentials (dbus, sender);
+	if (credentials == NULL || credentials->pid == G_MAXUINT) {
 		g_warning ("failed to get PID");
-		goto out;
+		return NULL;
 	}
+	if (credentials->session_valid)
+		return g_strdup (credentials->session);
 
 	/* get session from systemd or ConsoleKit */
 #ifdef HAVE_SYSTEMD_SD_LOGIN_H
-	session = pk_dbus_get_session_systemd (pid);
+	session = pk_dbus_get_session_systemd (credentials->pid);
 	if (session == NULL)
-		g_warning ("failed to get session for pid %u", pid);
+		g_warning ("failed to get session for pid %u", credentials->pid);
 #else
 	/* get session from ConsoleKit */
 	value = g_dbus_proxy_call_sync (dbus->priv->proxy_session,
 					"GetSessionForUnixProcess",
 					g_variant_new ("(u)",
-						       pid),
+						       credentials->pid),
 					G_DBUS_CALL_FLAGS_NONE,
 					2000,
 					NULL,
@@ -267,11 +342,12 @@ pk_dbus_get_session (PkDbus *dbus, const gchar *sender)
 	if (value == NULL) {
 		g_warning ("Failed to get session for %s: %s",
 			   sender, error->message);
-		goto out;
+		return NULL;
 	}
 	g_variant_get (value, "(o)", &session);
 #endif
-out:
+	credentials->session = g_strdup (session);
+	credentials->session_valid = TRUE;
 	return session;
 }
 
@@ -290,6 +366,15 @@ pk_dbus_finalize (GObject *object)
 		g_object_unref (dbus->priv->proxy_uid);
 	if (dbus->priv->proxy_session != NULL)
 		g_object_unref (dbus->priv->proxy_session);
+	if (dbus->priv->name_owner_changed_id != 0) {
+		g_dbus_connection_signal_unsubscribe (dbus->priv->connection,
+						      dbus->priv->name_owner_changed_id);
+	}
+	if (dbus->priv->connection != NULL)
+		g_object_unref (dbus->priv->connection);
+	if (dbus->priv->credentials_uncached != NULL)
+		pk_dbus_credentials_free (dbus->priv->credentials_uncached);
+	g_hash_table_unref (dbus->priv->credentials);
 
 	G_OBJECT_CLASS (pk_dbus_parent_class)->finalize (object);
 }
@@ -303,6 +388,24 @@ pk_dbus_class_init (PkDbusClass *klass)
 	g_type_class_add_private (klass, sizeof (PkDbusPrivate));
 }
 
+static void
+pk_dbus_name_owner_changed_cb (GDBusConnection *connection,
+			       const gchar *sender_name,
+			       const gchar *object_path,
+			       const gchar *interface_name,
+			       const gchar *signal_name,
+			       GVariant *parameters,
+			       gpointer user_data)
+{
+	PkDbus *dbus = PK_DBUS (user_data);
+	const gchar *name;
+	const gchar *new_owner;
+
+	g_variant_get (parameters, "(&s&s&s)", &name, NULL, &new_owner);
+	if (new_owner[0] == '\0')
+		g_hash_table_remove (dbus->priv->credentials, name);
+}
+
 gboolean
 pk_dbus_connect (PkDbus *dbus, GError **error)
 {
@@ -317,6 +420,18 @@ pk_dbus_connect (PkDbus *dbus, GError **error)
 		return FALSE;
 	}
 
+	/* forget cached credentials when the caller goes away */
+	dbus->priv->name_owner_changed_id =
+		g_dbus_connection_signal_subscribe (dbus->priv->connection,
+						    "org.freedesktop.DBus",
+						    "org.freedesktop.DBus",
+						    "NameOwnerChanged",
+						    "/org/freedesktop/DBus",
+						    NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    pk_dbus_name_owner_changed_cb,
+						    dbus, NULL);
+
 	/* connect to DBus so we can get the pid */
 	dbus->priv->proxy_pid =
 		g_dbus_proxy_new_sync (dbus->priv->connection,
@@ -380,6 +495,8 @@ static void
 pk_dbus_init (PkDbus *dbus)
 {
 	dbus->priv = PK_DBUS_GET_PRIVATE (dbus);
+	dbus->priv->credentials = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+							 (GDestroyNotify) pk_dbus_credentials_free);
 }
 
 PkDbus *
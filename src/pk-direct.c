@@ -22,6 +22,8 @@
 #include "config.h"
 
 #include <locale.h>
+#include <stdio.h>
+#include <sys/resource.h>
 #include <glib.h>
 #include <glib-unix.h>
 #include <glib/gi18n.h>
@@ -43,7 +45,12 @@ typedef struct {
 	GPtrArray		*cmd_array;
 	PkBackend		*backend;
 	PkBackendJob		*job;
+	GKeyFile		*conf;
 	gboolean		 value_only;
+	gboolean		 batch;
+	guint			 n_packages;
+	guint			 n_errors;
+	PkExitEnum		 exit_enum;
 } PkDirectPrivate;
 
 typedef gboolean (*PkDirectCommandCb)	(PkDirectPrivate	*util,
@@ -329,7 +336,9 @@ pk_direct_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 	PkExitEnum exit_enum = GPOINTER_TO_UINT (object);
 	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
 
-	g_print ("Exit code: %s\n", pk_exit_enum_to_string (exit_enum));
+	priv->exit_enum = exit_enum;
+	if (!priv->batch)
+		g_print ("Exit code: %s\n", pk_exit_enum_to_string (exit_enum));
 	g_main_loop_quit (priv->loop);
 }
 
@@ -337,6 +346,9 @@ static void
 pk_direct_percentage_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
 	guint percentage = GPOINTER_TO_UINT (object);
+	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
+	if (priv->batch)
+		return;
 	g_print ("Done: %i%%\n", percentage);
 }
 
@@ -344,6 +356,9 @@ static void
 pk_direct_status_changed_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
 	PkStatusEnum status_enum = GPOINTER_TO_UINT (object);
+	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
+	if (priv->batch)
+		return;
 	g_print ("Status: %s\n", pk_status_enum_to_string (status_enum));
 }
 
@@ -351,6 +366,10 @@ static void
 pk_direct_package_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
 	PkPackage *pkg = PK_PACKAGE (object);
+	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
+	priv->n_packages++;
+	if (priv->batch)
+		return;
 	g_print ("Package: %s\t%s\n",
 		 pk_info_enum_to_string (pk_package_get_info (pkg)),
 		 pk_package_get_id (pkg));
@@ -360,6 +379,10 @@ static void
 pk_direct_error_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
 	PkError *err = PK_ERROR_CODE (object);
+	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
+	priv->n_errors++;
+	if (priv->batch)
+		return;
 	g_print ("Error: %s\t%s\n",
 		 pk_error_enum_to_string (pk_error_get_code (err)),
 		 pk_error_get_details (err));
@@ -369,12 +392,118 @@ static void
 pk_direct_item_progress_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
 	PkItemProgress *ip = PK_ITEM_PROGRESS (object);
+	PkDirectPrivate *priv = (PkDirectPrivate *) user_data;
+	if (priv->batch)
+		return;
 	g_print ("ItemProgress: %s\t%i%%\t%s\n",
 		 pk_status_enum_to_string (pk_item_progress_get_status (ip)),
 		 pk_item_progress_get_percentage (ip),
 		 pk_item_progress_get_package_id (ip));
 }
 
+static PkBackendJob *
+pk_direct_job_new (PkDirectPrivate *priv)
+{
+	PkBackendJob *job = pk_backend_job_new (priv->conf);
+	pk_backend_job_set_cache_age (job, G_MAXUINT);
+	pk_backend_job_set_backend (job, priv->backend);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_direct_finished_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PERCENTAGE,
+				  pk_direct_percentage_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_STATUS_CHANGED,
+				  pk_direct_status_changed_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PACKAGE,
+				  pk_direct_package_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_ERROR_CODE,
+				  pk_direct_error_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_ITEM_PROGRESS,
+				  pk_direct_item_progress_cb, priv);
+	return job;
+}
+
+static gint64
+pk_direct_get_cpu_time (void)
+{
+	struct rusage usage;
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+	       usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+ * pk_direct_run_batch:
+ *
+ * Runs one command per line against the loaded backend, a new job for
+ * each, and prints a tab separated line of timings for every command so
+ * that runs can be compared. Empty lines and lines starting with '#' are
+ * ignored.
+ **/
+static gboolean
+pk_direct_run_batch (PkDirectPrivate *priv, const gchar *filename, GError **error)
+{
+	gint64 wall_total = 0;
+	guint n_commands = 0;
+	g_autofree gchar *data = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	if (g_strcmp0 (filename, "-") == 0) {
+		g_autoptr(GString) str = g_string_new (NULL);
+		gchar buf[4096];
+		gsize len;
+		while ((len = fread (buf, 1, sizeof (buf), stdin)) > 0)
+			g_string_append_len (str, buf, len);
+		data = g_string_free (g_steal_pointer (&str), FALSE);
+	} else if (!g_file_get_contents (filename, &data, NULL, error)) {
+		return FALSE;
+	}
+
+	priv->batch = TRUE;
+	g_print ("# command\twall-ms\tcpu-ms\tpackages\terrors\texit\n");
+	lines = g_strsplit (data, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		gint64 cpu_start;
+		gint64 wall_start;
+		gint64 wall;
+		gint64 cpu;
+		const gchar *line = g_strstrip (lines[i]);
+		g_auto(GStrv) argv = NULL;
+
+		if (line[0] == '\0' || line[0] == '#')
+			continue;
+		if (!g_shell_parse_argv (line, NULL, &argv, error)) {
+			g_prefix_error (error, "line %u: ", i + 1);
+			return FALSE;
+		}
+
+		g_clear_object (&priv->job);
+		priv->job = pk_direct_job_new (priv);
+		priv->n_packages = 0;
+		priv->n_errors = 0;
+		priv->exit_enum = PK_EXIT_ENUM_UNKNOWN;
+		wall_start = g_get_monotonic_time ();
+		cpu_start = pk_direct_get_cpu_time ();
+		if (!pk_direct_run (priv, argv[0], &argv[1], error)) {
+			g_prefix_error (error, "line %u: ", i + 1);
+			return FALSE;
+		}
+		wall = g_get_monotonic_time () - wall_start;
+		cpu = pk_direct_get_cpu_time () - cpu_start;
+		wall_total += wall;
+		n_commands++;
+		g_print ("%s\t%.3f\t%.3f\t%u\t%u\t%s\n",
+			 line,
+			 (gdouble) wall / 1000.0,
+			 (gdouble) cpu / 1000.0,
+			 priv->n_packages,
+			 priv->n_errors,
+			 pk_exit_enum_to_string (priv->exit_enum));
+	}
+	g_print ("# %u commands in %.3f ms\n", n_commands, (gdouble) wall_total / 1000.0);
+	return TRUE;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -384,6 +513,7 @@ main (int argc, char *argv[])
 	gint retval = EXIT_SUCCESS;
 	g_autoptr(GError) error = NULL;
 	g_autofree gchar *backend_name = NULL;
+	g_autofree gchar *batch_filename = NULL;
 	g_autofree gchar *cmd_descriptions = NULL;
 	g_autofree gchar *conf_filename = NULL;
 	g_autoptr(GKeyFile) conf = NULL;
@@ -392,6 +522,9 @@ main (int argc, char *argv[])
 		{ "backend", '\0', 0, G_OPTION_ARG_STRING, &backend_name,
 		  /* TRANSLATORS: a backend is the system package tool, e.g. dnf, apt */
 		  _("Packaging backend to use, e.g. dummy"), NULL },
+		{ "batch", '\0', 0, G_OPTION_ARG_FILENAME, &batch_filename,
+		  /* TRANSLATORS: run many commands without reloading the backend */
+		  _("Run the commands in a file, or '-' for stdin, and show timings"), NULL },
 		{ NULL }
 	};
 
@@ -504,24 +637,14 @@ main (int argc, char *argv[])
 	}
 
 	/* set up the job */
-	priv->job = pk_backend_job_new (conf);
-	pk_backend_job_set_cache_age (priv->job, G_MAXUINT);
-	pk_backend_job_set_backend (priv->job, priv->backend);
-	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_FINISHED,
-				  pk_direct_finished_cb, priv);
-	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_PERCENTAGE,
-				  pk_direct_percentage_cb, priv);
-	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_STATUS_CHANGED,
-				  pk_direct_status_changed_cb, priv);
-	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_PACKAGE,
-				  pk_direct_package_cb, priv);
-	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_ERROR_CODE,
-				  pk_direct_error_cb, priv);
-	pk_backend_job_set_vfunc (priv->job, PK_BACKEND_SIGNAL_ITEM_PROGRESS,
-				  pk_direct_item_progress_cb, priv);
-
-	/* run the specified command */
-	ret = pk_direct_run (priv, argv[1], (gchar**) &argv[2], &error);
+	priv->conf = conf;
+	priv->job = pk_direct_job_new (priv);
+
+	/* run the specified command, or all the ones in the batch */
+	if (batch_filename != NULL)
+		ret = pk_direct_run_batch (priv, batch_filename, &error);
+	else
+		ret = pk_direct_run (priv, argv[1], (gchar**) &argv[2], &error);
 	if (!ret) {
 		if (g_error_matches (error, PK_ERROR, PK_ERROR_NO_SUCH_CMD)) {
 			g_autofree gchar *tmp = NULL;
@@ -38,14 +38,26 @@
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <gio/gunixfdlist.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
 #include <packagekit-glib2/pk-offline.h>
 #include <packagekit-glib2/pk-offline-private.h>
+#include <packagekit-glib2/pk-command-index-private.h>
+#include <packagekit-glib2/pk-name-list-private.h>
 #include <packagekit-glib2/pk-version.h>
 #include <polkit/polkit.h>
 
+#include "pk-auth-cache.h"
+#include "pk-plan-cache.h"
 #include "pk-backend.h"
+#include "pk-cache-bundle.h"
 #include "pk-dbus.h"
 #include "pk-engine.h"
+#include "pk-metrics.h"
+#include "pk-peer-bus.h"
+#include "pk-peer-cache.h"
+#include "pk-query-cache.h"
+#include "pk-search-sessions.h"
 #include "pk-shared.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -67,14 +79,63 @@ static void	pk_engine_set_locked (PkEngine *engine, gboolean is_locked);
 /* how long to wait after the computer has been resumed or any system event */
 #define PK_ENGINE_STATE_CHANGED_TIMEOUT_NORMAL		600 /* s */
 
+/* how long a polkit answer is reused for the same caller and action */
+#define PK_ENGINE_AUTH_CACHE_TIMEOUT_DEFAULT		10 /* s */
+#define PK_ENGINE_PLAN_CACHE_TIMEOUT_DEFAULT		300 /* s */
+
+/* how long a client has to use the transactions it leased in advance */
+#define PK_ENGINE_TRANSACTION_LEASE_TIMEOUT_DEFAULT	30 /* s */
+
+/* the most transactions handed out by one LeaseTransactions call */
+#define PK_ENGINE_TRANSACTION_LEASE_MAX			64
+
+/* how often to check if the transaction database needs trimming */
+#define PK_ENGINE_TRANSACTION_DB_MAINTENANCE_INTERVAL	3600 /* s */
+
+/* how long to wait after the backend was loaded or invalidated before
+ * loading its caches */
+#define PK_ENGINE_PREWARM_DELAY				2 /* s */
+
+/* the command index lists every available package, so wait longer */
+#define PK_ENGINE_COMMAND_INDEX_DELAY			30 /* s */
+
+/* the name list is cheap, but epochs change in bursts during a transaction */
+#define PK_ENGINE_NAME_LIST_DELAY			5 /* s */
+
+/* a refresh signals the updates and repositories changing several times */
+#define PK_ENGINE_CHANGE_DELTA_DELAY			5 /* s */
+
+/* how often to check if the updates can be downloaded in the background */
+#define PK_ENGINE_PREFETCH_INTERVAL			300 /* s */
+
+/* the package databases checked before reusing a saved warm state */
+static const gchar *pk_engine_warm_state_paths_default[] = {
+	"/var/lib/rpm",
+	"/usr/lib/sysimage/rpm",
+	"/var/cache/dnf",
+	"/var/cache/zypp",
+	"/var/lib/dpkg/status",
+	"/var/lib/apt/lists",
+	"/var/lib/pacman/local",
+	NULL };
+
 struct PkEnginePrivate
 {
 	GTimer			*timer;
 	gboolean		 notify_clients_of_upgrade;
 	gboolean		 shutdown_as_soon_as_possible;
+	gboolean		 restart_handoff;	/* binary or config changed */
+	gchar			*conf_checksum;
 	PkScheduler		*scheduler;
 	PkTransactionDb		*transaction_db;
 	PkBackend		*backend;
+	PkQueryCache		*query_cache;
+	PkPlanCache		*plan_cache;
+	PkSearchSessions	*search_sessions;
+	PkAuthCache		*auth_cache;
+	PkMetrics		*metrics;
+	PkPeerCache		*peer_cache;
+	PkPeerBus		*peer_bus;
 	GNetworkMonitor		*network_monitor;
 	GKeyFile		*conf;
 	PkDbus			*dbus;
@@ -92,9 +153,49 @@ struct PkEnginePrivate
 	gchar			*distro_id;
 	guint			 timeout_priority_id;
 	guint			 timeout_normal_id;
+	guint			 transaction_db_maintenance_id;
+	guint			 transaction_db_step_id;
 	PolkitAuthority		*authority;
+	gboolean		 prewarm;
+	gboolean		 prewarmed;
+	guint			 updates_count;
+	guint			 security_updates_count;
+	guint			 prewarm_id;
+	PkBackendJob		*prewarm_job;
+	gboolean		 command_index;
+	guint			 command_index_id;
+	PkBackendJob		*command_index_job;
+	GHashTable		*command_index_commands;
+	gboolean		 name_list;
+	guint			 name_list_id;
+	PkBackendJob		*name_list_job;
+	GHashTable		*name_list_names;
+	gboolean		 change_deltas;
+	GHashTable		*updates_known;		/* package-id:info, or NULL */
+	guint64			 updates_epoch;
+	guint			 updates_delta_id;
+	PkBackendJob		*updates_delta_job;
+	PkResults		*updates_delta_results;
+	guint			 updates_delta_generation;
+	GHashTable		*repo_list_known;	/* repo-id:state, or NULL */
+	guint64			 repo_list_epoch;
+	guint			 repo_list_delta_id;
+	PkBackendJob		*repo_list_delta_job;
+	GHashTable		*repo_list_delta_repos;
+	gboolean		 prefetch;
+	guint			 prefetch_id;
+	PkBackendJob		*prefetch_job;
+	gchar			**prefetch_ids;
+	GHashTable		*prefetched;		/* package-ids already downloaded */
 	gboolean		 locked;
+	gboolean		 cache_bundle_busy;
+	gboolean		 cache_bundle_importing;
 	PkNetworkEnum		 network_state;
+	guint			 deferred_init_id;
+	gint64			 startup_time;
+	gint64			 startup_ready;		/* us after startup_time, or 0 */
+	gint64			 startup_first_request;
+	gint64			 startup_deferred;
 	guint			 owner_id;
 	GDBusNodeInfo		*introspection;
 	GDBusConnection		*connection;
@@ -146,6 +247,38 @@ pk_engine_reset_timer (PkEngine *engine)
 	g_timer_reset (engine->priv->timer);
 }
 
+/* how long a D-Bus activated client had to wait before being answered */
+static void
+pk_engine_mark_first_request (PkEngine *engine)
+{
+	if (engine->priv->startup_first_request != 0)
+		return;
+	engine->priv->startup_first_request = MAX (g_get_monotonic_time () - engine->priv->startup_time, 1);
+	g_debug ("first request %" G_GINT64_FORMAT "us after startup",
+		 engine->priv->startup_first_request);
+}
+
+static void pk_engine_authority_changed_cb (PolkitAuthority *authority, PkEngine *engine);
+
+/**
+ * pk_engine_ensure_authority:
+ *
+ * Talking to polkit can mean starting polkitd, so this is done on the
+ * first request that needs it rather than when the daemon is activated.
+ **/
+static gboolean
+pk_engine_ensure_authority (PkEngine *engine, GError **error)
+{
+	if (engine->priv->authority != NULL)
+		return TRUE;
+	engine->priv->authority = polkit_authority_get_sync (NULL, error);
+	if (engine->priv->authority == NULL)
+		return FALSE;
+	g_signal_connect (engine->priv->authority, "changed",
+			  G_CALLBACK (pk_engine_authority_changed_cb), engine);
+	return TRUE;
+}
+
 static void pk_engine_inhibit (PkEngine *engine);
 static void pk_engine_uninhibit (PkEngine *engine);
 
@@ -184,6 +317,36 @@ pk_engine_scheduler_changed_cb (PkScheduler *scheduler, PkEngine *engine)
 	pk_engine_reset_timer (engine);
 }
 
+static void
+pk_engine_scheduler_transaction_added_cb (PkScheduler *scheduler,
+					  const gchar *tid,
+					  PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+	g_dbus_connection_emit_signal (engine->priv->connection,
+				       NULL,
+				       PK_DBUS_PATH,
+				       PK_DBUS_INTERFACE,
+				       "TransactionAdded",
+				       g_variant_new ("(o)", tid),
+				       NULL);
+}
+
+static void
+pk_engine_scheduler_transaction_removed_cb (PkScheduler *scheduler,
+					    const gchar *tid,
+					    PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+	g_dbus_connection_emit_signal (engine->priv->connection,
+				       NULL,
+				       PK_DBUS_PATH,
+				       PK_DBUS_INTERFACE,
+				       "TransactionRemoved",
+				       g_variant_new ("(o)", tid),
+				       NULL);
+}
+
 static void
 pk_engine_emit_property_changed (PkEngine *engine,
 				 const gchar *property_name,
@@ -329,156 +492,1058 @@ pk_engine_set_locked (PkEngine *engine, gboolean is_locked)
 }
 
 static void
-pk_engine_backend_repo_list_changed_cb (PkBackend *backend, PkEngine *engine)
+pk_engine_set_prewarmed (PkEngine *engine, gboolean prewarmed)
 {
-	g_return_if_fail (PK_IS_ENGINE (engine));
+	if (engine->priv->prewarmed == prewarmed)
+		return;
+	engine->priv->prewarmed = prewarmed;
+	pk_engine_emit_property_changed (engine,
+					 "Prewarmed",
+					 g_variant_new_boolean (prewarmed));
+}
 
-	g_debug ("emitting RepoListChanged");
-	g_dbus_connection_emit_signal (engine->priv->connection,
-				       NULL,
-				       PK_DBUS_PATH,
-				       PK_DBUS_INTERFACE,
-				       "RepoListChanged",
-				       NULL,
-				       NULL);
+/**
+ * pk_engine_job_new:
+ * @preemptible: if a committed transaction cancels the job
+ *
+ * Creates a job the daemon runs on the backend for itself. Unless the
+ * backend supports parallelization the scheduler holds the transactions
+ * back until pk_engine_job_finish() is called.
+ *
+ * Return value: the job, or %NULL if the backend is in use and the job
+ * has to be tried again later
+ **/
+static PkBackendJob *
+pk_engine_job_new (PkEngine *engine, gboolean preemptible)
+{
+	g_autoptr(PkBackendJob) job = pk_backend_job_new (engine->priv->conf);
+
+	if (!pk_scheduler_start_job (engine->priv->scheduler, job, preemptible))
+		return NULL;
+
+	/* as unobtrusive as a nightly refresh */
+	pk_backend_job_set_cache_age (job, G_MAXUINT);
+	pk_backend_job_set_background (job, TRUE);
+	return g_steal_pointer (&job);
 }
 
 static void
-pk_engine_backend_updates_changed_cb (PkBackend *backend, PkEngine *engine)
+pk_engine_job_finish (PkEngine *engine, PkBackendJob *job)
 {
-	g_return_if_fail (PK_IS_ENGINE (engine));
+	pk_backend_stop_job (engine->priv->backend, job);
+	pk_scheduler_finish_job (engine->priv->scheduler, job);
+}
 
-	g_debug ("emitting UpdatesChanged");
-	g_dbus_connection_emit_signal (engine->priv->connection,
-				       NULL,
-				       PK_DBUS_PATH,
-				       PK_DBUS_INTERFACE,
-				       "UpdatesChanged",
-				       NULL,
-				       NULL);
+static void
+pk_engine_prewarm_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+
+	pk_engine_job_finish (engine, job);
+
+	/* invalidated again whilst we were loading */
+	if (engine->priv->prewarm_id != 0)
+		return;
+	if (pk_backend_job_get_is_error_set (job)) {
+		g_debug ("failed to prewarm the backend");
+		return;
+	}
+	g_debug ("backend is prewarmed after %ums",
+		 pk_backend_job_get_runtime (job));
+	pk_engine_set_prewarmed (engine, TRUE);
 }
 
 static gboolean
-pk_engine_state_changed_cb (gpointer data)
+pk_engine_prewarm_cb (gpointer user_data)
 {
-	PkEngine *engine = PK_ENGINE (data);
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkEnginePrivate *priv = engine->priv;
+
+	/* the transaction will do the work anyway, so try again later */
+	if (pk_scheduler_get_size (priv->scheduler) > 0)
+		return G_SOURCE_CONTINUE;
+	if (priv->prewarm_job != NULL && pk_backend_job_get_started (priv->prewarm_job))
+		return G_SOURCE_CONTINUE;
+
+	g_clear_object (&priv->prewarm_job);
+	priv->prewarm_job = pk_engine_job_new (engine, FALSE);
+	if (priv->prewarm_job == NULL)
+		return G_SOURCE_CONTINUE;
+	priv->prewarm_id = 0;
+	pk_backend_job_set_vfunc (priv->prewarm_job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_engine_prewarm_finished_cb, engine);
+	pk_backend_start_job (priv->backend, priv->prewarm_job);
+	pk_backend_prewarm (priv->backend, priv->prewarm_job);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_engine_prewarm_schedule:
+ *
+ * Changes are often signalled in bursts, so wait for things to settle
+ * before loading the backend caches again.
+ **/
+static void
+pk_engine_prewarm_schedule (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
+
+	if (!priv->prewarm || !pk_backend_can_prewarm (priv->backend))
+		return;
+	pk_engine_set_prewarmed (engine, FALSE);
+	if (priv->prewarm_id != 0)
+		g_source_remove (priv->prewarm_id);
+	priv->prewarm_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+						       PK_ENGINE_PREWARM_DELAY,
+						       pk_engine_prewarm_cb,
+						       engine, NULL);
+	g_source_set_name_by_id (priv->prewarm_id, "[PkEngine] prewarm");
+}
+
+static void
+pk_engine_command_index_files_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkFiles *item = PK_FILES (object);
+	const gchar *package_id = pk_files_get_package_id (item);
+	gchar **files = pk_files_get_files (item);
+
+	for (guint i = 0; files != NULL && files[i] != NULL; i++) {
+		GPtrArray *package_ids;
+		const gchar *command = pk_command_index_get_command (files[i]);
+		if (command == NULL)
+			continue;
+		package_ids = g_hash_table_lookup (engine->priv->command_index_commands, command);
+		if (package_ids == NULL) {
+			package_ids = g_ptr_array_new_with_free_func (g_free);
+			g_hash_table_insert (engine->priv->command_index_commands,
+					     g_strdup (command), package_ids);
+		}
+		g_ptr_array_add (package_ids, g_strdup (package_id));
+	}
+}
+
+static void
+pk_engine_command_index_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
 	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) commands = NULL;
 
-	g_return_val_if_fail (PK_IS_ENGINE (engine), FALSE);
+	pk_engine_job_finish (engine, job);
+	commands = g_steal_pointer (&engine->priv->command_index_commands);
 
-	/* we're done something low-level */
-	if (!pk_offline_auth_invalidate (&error))
-		g_warning ("failed to invalidate: %s", error->message);
+	/* keep the old index rather than writing a partial one */
+	if (engine->priv->command_index_id != 0)
+		return;
+	if (pk_backend_job_get_is_error_set (job)) {
+		g_debug ("failed to get the list of commands");
+		return;
+	}
+	if (!pk_command_index_save (commands, PK_COMMAND_INDEX_FILENAME, &error)) {
+		g_warning ("failed to save the command index: %s", error->message);
+		return;
+	}
+	g_debug ("saved %u commands to the index after %ums",
+		 g_hash_table_size (commands),
+		 pk_backend_job_get_runtime (job));
+}
 
-	/* if network is not up, then just reschedule */
-	if (!g_network_monitor_get_network_available (engine->priv->network_monitor)) {
-		/* wait another timeout of PK_ENGINE_STATE_CHANGED_x_TIMEOUT */
+/* never compete with a transaction or another job for the backend */
+static gboolean
+pk_engine_backend_is_busy (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
+	PkBackendJob *jobs[] = { priv->prewarm_job,
+				 priv->command_index_job,
+				 priv->name_list_job,
+				 priv->updates_delta_job,
+				 priv->repo_list_delta_job,
+				 priv->prefetch_job };
+
+	if (pk_scheduler_get_size (priv->scheduler) > 0)
+		return TRUE;
+	if (priv->prewarm_id != 0)
 		return TRUE;
+	for (guint i = 0; i < G_N_ELEMENTS (jobs); i++) {
+		if (jobs[i] != NULL && pk_backend_job_get_started (jobs[i]))
+			return TRUE;
 	}
+	return FALSE;
+}
 
-	pk_backend_updates_changed (engine->priv->backend);
+static gboolean
+pk_engine_command_index_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkEnginePrivate *priv = engine->priv;
+
+	if (pk_engine_backend_is_busy (engine))
+		return G_SOURCE_CONTINUE;
+
+	g_clear_object (&priv->command_index_job);
+	priv->command_index_job = pk_engine_job_new (engine, FALSE);
+	if (priv->command_index_job == NULL)
+		return G_SOURCE_CONTINUE;
+	priv->command_index_id = 0;
+	g_clear_pointer (&priv->command_index_commands, g_hash_table_unref);
+	priv->command_index_commands = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+							      (GDestroyNotify) g_ptr_array_unref);
+	pk_backend_job_set_vfunc (priv->command_index_job, PK_BACKEND_SIGNAL_FILES,
+				  pk_engine_command_index_files_cb, engine);
+	pk_backend_job_set_vfunc (priv->command_index_job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_engine_command_index_finished_cb, engine);
+	pk_backend_start_job (priv->backend, priv->command_index_job);
+	pk_backend_get_commands (priv->backend, priv->command_index_job);
+	return G_SOURCE_REMOVE;
+}
 
-	/* reset, now valid */
-	engine->priv->timeout_priority_id = 0;
-	engine->priv->timeout_normal_id = 0;
+/**
+ * pk_engine_command_index_schedule:
+ *
+ * Rebuilds the index command-not-found uses once the package lists have
+ * settled, so that looking up a mistyped command does not need the daemon.
+ **/
+static void
+pk_engine_command_index_schedule (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
 
-	/* reset the timer */
-	pk_engine_reset_timer (engine);
+	if (!priv->command_index || !pk_backend_can_get_commands (priv->backend))
+		return;
+	if (priv->command_index_id != 0)
+		g_source_remove (priv->command_index_id);
+	priv->command_index_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+							     PK_ENGINE_COMMAND_INDEX_DELAY,
+							     pk_engine_command_index_cb,
+							     engine, NULL);
+	g_source_set_name_by_id (priv->command_index_id, "[PkEngine] command index");
+}
 
-	return FALSE;
+static void
+pk_engine_name_list_package_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkPackage *package = PK_PACKAGE (object);
+
+	g_hash_table_add (engine->priv->name_list_names,
+			  g_strdup (pk_package_get_name (package)));
 }
 
 static void
-pk_engine_emit_restart_schedule (PkEngine *engine)
+pk_engine_name_list_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
-	g_return_if_fail (PK_IS_ENGINE (engine));
+	PkEngine *engine = PK_ENGINE (user_data);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) names = NULL;
 
-	g_debug ("emitting RestartSchedule");
+	pk_engine_job_finish (engine, job);
+	names = g_steal_pointer (&engine->priv->name_list_names);
+
+	/* keep the old list rather than writing a partial one */
+	if (engine->priv->name_list_id != 0)
+		return;
+	if (pk_backend_job_get_is_error_set (job)) {
+		g_debug ("failed to get the list of packages");
+		return;
+	}
+	if (!pk_name_list_save (names, PK_NAME_LIST_FILENAME, &error)) {
+		g_warning ("failed to save the package name list: %s", error->message);
+		return;
+	}
+	g_debug ("saved %u package names after %ums",
+		 g_hash_table_size (names),
+		 pk_backend_job_get_runtime (job));
+}
+
+static gboolean
+pk_engine_name_list_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkEnginePrivate *priv = engine->priv;
+
+	if (pk_engine_backend_is_busy (engine))
+		return G_SOURCE_CONTINUE;
+
+	g_clear_object (&priv->name_list_job);
+	priv->name_list_job = pk_engine_job_new (engine, FALSE);
+	if (priv->name_list_job == NULL)
+		return G_SOURCE_CONTINUE;
+	priv->name_list_id = 0;
+	g_clear_pointer (&priv->name_list_names, g_hash_table_unref);
+	priv->name_list_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	pk_backend_job_set_vfunc (priv->name_list_job, PK_BACKEND_SIGNAL_PACKAGE,
+				  pk_engine_name_list_package_cb, engine);
+	pk_backend_job_set_vfunc (priv->name_list_job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_engine_name_list_finished_cb, engine);
+	pk_backend_start_job (priv->backend, priv->name_list_job);
+	pk_backend_get_packages (priv->backend, priv->name_list_job,
+				 pk_bitfield_value (PK_FILTER_ENUM_NONE));
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_engine_name_list_schedule:
+ *
+ * Rewrites the sorted list of package names pkcon completes from once the
+ * epochs have settled, so that pressing tab does not need a transaction.
+ **/
+static void
+pk_engine_name_list_schedule (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
+
+	if (!priv->name_list || !pk_backend_is_implemented (priv->backend, PK_ROLE_ENUM_GET_PACKAGES))
+		return;
+	if (priv->name_list_id != 0)
+		g_source_remove (priv->name_list_id);
+	priv->name_list_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+							 PK_ENGINE_NAME_LIST_DELAY,
+							 pk_engine_name_list_cb,
+							 engine, NULL);
+	g_source_set_name_by_id (priv->name_list_id, "[PkEngine] name list");
+}
+
+/**
+ * pk_engine_emit_delta:
+ * @known: (inout): the state the last delta was made against
+ * @current: what the backend returned now, as id:state
+ *
+ * Tells the clients what was added, removed or changed since the last
+ * state the daemon knew of, so they do not have to query everything
+ * again. Nothing is sent for the first state.
+ **/
+static void
+pk_engine_emit_delta (PkEngine *engine,
+		      const gchar *signal_name,
+		      GHashTable **known,
+		      guint64 *epoch,
+		      GHashTable *current)
+{
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	gpointer value_known;
+	g_autoptr(GPtrArray) added = g_ptr_array_new ();
+	g_autoptr(GPtrArray) removed = g_ptr_array_new ();
+	g_autoptr(GPtrArray) changed = g_ptr_array_new ();
+
+	if (*known == NULL)
+		goto out;
+
+	g_hash_table_iter_init (&iter, current);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (!g_hash_table_lookup_extended (*known, key, NULL, &value_known))
+			g_ptr_array_add (added, key);
+		else if (g_strcmp0 (value, value_known) != 0)
+			g_ptr_array_add (changed, key);
+	}
+	g_hash_table_iter_init (&iter, *known);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (!g_hash_table_contains (current, key))
+			g_ptr_array_add (removed, key);
+	}
+	if (added->len == 0 && removed->len == 0 && changed->len == 0)
+		goto out;
+
+	(*epoch)++;
+	g_debug ("emitting %s %" G_GUINT64_FORMAT ": %u added, %u removed, %u changed",
+		 signal_name, *epoch, added->len, removed->len, changed->len);
+	g_ptr_array_add (added, NULL);
+	g_ptr_array_add (removed, NULL);
+	g_ptr_array_add (changed, NULL);
 	g_dbus_connection_emit_signal (engine->priv->connection,
 				       NULL,
 				       PK_DBUS_PATH,
 				       PK_DBUS_INTERFACE,
-				       "RestartSchedule",
-				       NULL,
+				       signal_name,
+				       g_variant_new ("(t^as^as^as)",
+						      *epoch,
+						      (gchar **) added->pdata,
+						      (gchar **) removed->pdata,
+						      (gchar **) changed->pdata),
 				       NULL);
+out:
+	g_clear_pointer (known, g_hash_table_unref);
+	*known = g_hash_table_ref (current);
 }
 
-guint
-pk_engine_get_seconds_idle (PkEngine *engine)
+static void
+pk_engine_updates_delta_package_cb (PkBackendJob *job, gpointer object, gpointer user_data)
 {
-	guint idle;
-	guint size;
-
-	g_return_val_if_fail (PK_IS_ENGINE (engine), 0);
-	g_return_val_if_fail (pk_is_thread_default (), 0);
+	PkEngine *engine = PK_ENGINE (user_data);
+	pk_results_add_package (engine->priv->updates_delta_results, PK_PACKAGE (object));
+}
 
-	/* check for transactions running - a transaction that takes a *long* time might not
-	 * give sufficient percentage updates to not be marked as idle */
-	size = pk_scheduler_get_size (engine->priv->scheduler);
-	if (size != 0) {
-		g_debug ("engine idle zero as %i transactions in progress", size);
-		return 0;
-	}
+static void
+pk_engine_updates_delta_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	g_autoptr(PkResults) results = NULL;
 
-	/* have we been updated? */
-	if (engine->priv->notify_clients_of_upgrade) {
-		pk_engine_emit_restart_schedule (engine);
-		return G_MAXUINT;
-	}
+	pk_engine_job_finish (engine, job);
+	results = g_steal_pointer (&engine->priv->updates_delta_results);
 
-	/* do we need to shutdown quickly */
-	if (engine->priv->shutdown_as_soon_as_possible) {
-		g_debug ("need to restart daemon asap");
-		return G_MAXUINT;
+	/* changed again whilst we were listing them */
+	if (engine->priv->updates_delta_id != 0)
+		return;
+	if (pk_backend_job_get_is_error_set (job)) {
+		g_debug ("failed to get the updates");
+		return;
 	}
 
-	idle = (guint) g_timer_elapsed (engine->priv->timer, NULL);
-	return idle;
+	/* a client asked first, and the delta was made then */
+	if (pk_query_cache_get_updates (engine->priv->query_cache) != NULL)
+		return;
+	pk_results_set_role (results, PK_ROLE_ENUM_GET_UPDATES);
+	pk_results_set_exit_code (results, PK_EXIT_ENUM_SUCCESS);
+	pk_query_cache_set_updates (engine->priv->query_cache, results,
+				    engine->priv->updates_delta_generation);
 }
 
 static gboolean
-pk_engine_set_proxy_internal (PkEngine *engine, const gchar *sender,
-			      const gchar *proxy_http,
-			      const gchar *proxy_https,
-			      const gchar *proxy_ftp,
-			      const gchar *proxy_socks,
-			      const gchar *no_proxy,
-			      const gchar *pac,
-			      GError **error)
+pk_engine_updates_delta_cb (gpointer user_data)
 {
-	gboolean ret;
-	guint uid;
-	g_autofree gchar *session = NULL;
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkEnginePrivate *priv = engine->priv;
 
-	/* get uid */
-	uid = pk_dbus_get_uid (engine->priv->dbus, sender);
-	if (uid == G_MAXUINT) {
-		g_set_error_literal (error,
-				     PK_ENGINE_ERROR,
-				     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
-				     "failed to get the uid");
-		return FALSE;
-	}
+	if (pk_engine_backend_is_busy (engine))
+		return G_SOURCE_CONTINUE;
 
-	/* get session */
-	session = pk_dbus_get_session (engine->priv->dbus, sender);
-	if (session == NULL) {
-		g_set_error_literal (error,
-				     PK_ENGINE_ERROR,
-				     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
-				     "failed to get the session");
-		return FALSE;
+	/* a client already asked */
+	if (pk_query_cache_get_updates (priv->query_cache) != NULL) {
+		priv->updates_delta_id = 0;
+		return G_SOURCE_REMOVE;
 	}
 
-	/* save to database */
-	ret = pk_transaction_db_set_proxy (engine->priv->transaction_db,
-					   uid, session,
-					   proxy_http,
-					   proxy_https,
-					   proxy_ftp,
-					   proxy_socks,
-					   no_proxy,
-					   pac);
+	g_clear_object (&priv->updates_delta_job);
+	priv->updates_delta_job = pk_engine_job_new (engine, FALSE);
+	if (priv->updates_delta_job == NULL)
+		return G_SOURCE_CONTINUE;
+	priv->updates_delta_id = 0;
+	g_clear_object (&priv->updates_delta_results);
+	priv->updates_delta_results = pk_results_new ();
+	priv->updates_delta_generation = pk_query_cache_get_generation (priv->query_cache);
+	pk_backend_job_set_vfunc (priv->updates_delta_job, PK_BACKEND_SIGNAL_PACKAGE,
+				  pk_engine_updates_delta_package_cb, engine);
+	pk_backend_job_set_vfunc (priv->updates_delta_job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_engine_updates_delta_finished_cb, engine);
+	pk_backend_start_job (priv->backend, priv->updates_delta_job);
+	pk_backend_get_updates (priv->backend, priv->updates_delta_job,
+				pk_bitfield_value (PK_FILTER_ENUM_NONE));
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_engine_updates_delta_schedule:
+ *
+ * Lists the updates in the background after they changed, so that the
+ * UpdatesDelta signal is sent without waiting for a client to ask.
+ **/
+static void
+pk_engine_updates_delta_schedule (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
+
+	if (!priv->change_deltas || !pk_backend_is_implemented (priv->backend, PK_ROLE_ENUM_GET_UPDATES))
+		return;
+	if (priv->updates_delta_id != 0)
+		g_source_remove (priv->updates_delta_id);
+	priv->updates_delta_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+							     PK_ENGINE_CHANGE_DELTA_DELAY,
+							     pk_engine_updates_delta_cb,
+							     engine, NULL);
+	g_source_set_name_by_id (priv->updates_delta_id, "[PkEngine] updates delta");
+}
+
+static void
+pk_engine_repo_list_delta_repo_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkRepoDetail *item = PK_REPO_DETAIL (object);
+
+	g_hash_table_insert (engine->priv->repo_list_delta_repos,
+			     g_strdup (pk_repo_detail_get_id (item)),
+			     g_strdup_printf ("%i\t%s",
+					      pk_repo_detail_get_enabled (item),
+					      pk_repo_detail_get_description (item)));
+}
+
+static void
+pk_engine_repo_list_delta_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	g_autoptr(GHashTable) repos = NULL;
+
+	pk_engine_job_finish (engine, job);
+	repos = g_steal_pointer (&engine->priv->repo_list_delta_repos);
+
+	/* changed again whilst we were listing them */
+	if (engine->priv->repo_list_delta_id != 0)
+		return;
+	if (pk_backend_job_get_is_error_set (job)) {
+		g_debug ("failed to get the repositories");
+		return;
+	}
+	pk_engine_emit_delta (engine, "RepoListDelta",
+			      &engine->priv->repo_list_known,
+			      &engine->priv->repo_list_epoch,
+			      repos);
+}
+
+static gboolean
+pk_engine_repo_list_delta_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkEnginePrivate *priv = engine->priv;
+
+	if (pk_engine_backend_is_busy (engine))
+		return G_SOURCE_CONTINUE;
+
+	g_clear_object (&priv->repo_list_delta_job);
+	priv->repo_list_delta_job = pk_engine_job_new (engine, FALSE);
+	if (priv->repo_list_delta_job == NULL)
+		return G_SOURCE_CONTINUE;
+	priv->repo_list_delta_id = 0;
+	g_clear_pointer (&priv->repo_list_delta_repos, g_hash_table_unref);
+	priv->repo_list_delta_repos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	pk_backend_job_set_vfunc (priv->repo_list_delta_job, PK_BACKEND_SIGNAL_REPO_DETAIL,
+				  pk_engine_repo_list_delta_repo_cb, engine);
+	pk_backend_job_set_vfunc (priv->repo_list_delta_job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_engine_repo_list_delta_finished_cb, engine);
+	pk_backend_start_job (priv->backend, priv->repo_list_delta_job);
+	pk_backend_get_repo_list (priv->backend, priv->repo_list_delta_job,
+				  pk_bitfield_value (PK_FILTER_ENUM_NONE));
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_engine_repo_list_delta_schedule (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
+
+	if (!priv->change_deltas || !pk_backend_is_implemented (priv->backend, PK_ROLE_ENUM_GET_REPO_LIST))
+		return;
+	if (priv->repo_list_delta_id != 0)
+		g_source_remove (priv->repo_list_delta_id);
+	priv->repo_list_delta_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+							       PK_ENGINE_CHANGE_DELTA_DELAY,
+							       pk_engine_repo_list_delta_cb,
+							       engine, NULL);
+	g_source_set_name_by_id (priv->repo_list_delta_id, "[PkEngine] repo list delta");
+}
+
+/* like on_ac_power(1): with no mains supply listed at all, assume AC */
+static gboolean
+pk_engine_is_on_ac_power (void)
+{
+	const gchar *name;
+	gboolean found_mains = FALSE;
+	g_autoptr(GDir) dir = NULL;
+
+	dir = g_dir_open ("/sys/class/power_supply", 0, NULL);
+	if (dir == NULL)
+		return TRUE;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *type = NULL;
+		g_autofree gchar *online = NULL;
+		g_autofree gchar *fn_type = NULL;
+		g_autofree gchar *fn_online = NULL;
+
+		fn_type = g_build_filename ("/sys/class/power_supply", name, "type", NULL);
+		if (!g_file_get_contents (fn_type, &type, NULL, NULL))
+			continue;
+		if (g_strcmp0 (g_strstrip (type), "Mains") != 0)
+			continue;
+		found_mains = TRUE;
+		fn_online = g_build_filename ("/sys/class/power_supply", name, "online", NULL);
+		if (!g_file_get_contents (fn_online, &online, NULL, NULL))
+			continue;
+		if (g_strcmp0 (g_strstrip (online), "1") == 0)
+			return TRUE;
+	}
+	return !found_mains;
+}
+
+/* the daemon being idle is not enough, nobody should be using the machine */
+static gboolean
+pk_engine_is_system_idle (PkEngine *engine)
+{
+#ifdef HAVE_SYSTEMD_SD_LOGIN_H
+	gboolean idle = FALSE;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) res = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	if (engine->priv->logind_proxy == NULL)
+		return TRUE;
+	res = g_dbus_connection_call_sync (engine->priv->connection,
+					   "org.freedesktop.login1",
+					   "/org/freedesktop/login1",
+					   "org.freedesktop.DBus.Properties",
+					   "Get",
+					   g_variant_new ("(ss)",
+							  "org.freedesktop.login1.Manager",
+							  "IdleHint"),
+					   G_VARIANT_TYPE ("(v)"),
+					   G_DBUS_CALL_FLAGS_NONE,
+					   1000, NULL, &error);
+	if (res == NULL) {
+		g_debug ("failed to get IdleHint: %s", error->message);
+		return FALSE;
+	}
+	g_variant_get (res, "(v)", &value);
+	if (g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+		idle = g_variant_get_boolean (value);
+	return idle;
+#else
+	return TRUE;
+#endif
+}
+
+static void pk_engine_prefetch_schedule (PkEngine *engine);
+
+static void
+pk_engine_prefetch_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	g_auto(GStrv) package_ids = NULL;
+
+	pk_engine_job_finish (engine, job);
+	package_ids = g_steal_pointer (&engine->priv->prefetch_ids);
+
+	/* try again at the next interval, e.g. if a transaction preempted it */
+	if (pk_backend_job_get_is_error_set (job)) {
+		g_debug ("failed to download the updates in the background");
+		pk_engine_prefetch_schedule (engine);
+		return;
+	}
+	for (guint i = 0; package_ids[i] != NULL; i++)
+		g_hash_table_add (engine->priv->prefetched, g_strdup (package_ids[i]));
+	g_debug ("downloaded %u updates in the background after %ums",
+		 g_strv_length (package_ids),
+		 pk_backend_job_get_runtime (job));
+}
+
+static gboolean
+pk_engine_prefetch_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	PkEnginePrivate *priv = engine->priv;
+	PkResults *results;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) package_ids = NULL;
+
+	/* keep waiting for a cheap moment */
+	if (pk_engine_backend_is_busy (engine))
+		return G_SOURCE_CONTINUE;
+	if (priv->network_state != PK_NETWORK_ENUM_ONLINE)
+		return G_SOURCE_CONTINUE;
+	if (!pk_engine_is_on_ac_power ())
+		return G_SOURCE_CONTINUE;
+	if (!pk_engine_is_system_idle (engine))
+		return G_SOURCE_CONTINUE;
+
+	/* the list is scheduled again once the updates are known again */
+	results = pk_query_cache_get_updates (priv->query_cache);
+	if (results == NULL) {
+		priv->prefetch_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	packages = pk_results_get_package_array (results);
+	package_ids = g_ptr_array_new_with_free_func (g_free);
+	for (guint i = 0; i < packages->len; i++) {
+		PkPackage *pkg = g_ptr_array_index (packages, i);
+		if (pk_package_get_info (pkg) == PK_INFO_ENUM_BLOCKED)
+			continue;
+		if (g_hash_table_contains (priv->prefetched, pk_package_get_id (pkg)))
+			continue;
+		g_ptr_array_add (package_ids, g_strdup (pk_package_get_id (pkg)));
+	}
+	if (package_ids->len == 0) {
+		priv->prefetch_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+	g_ptr_array_add (package_ids, NULL);
+
+	/* any transaction committed from now on cancels it and waits */
+	g_clear_object (&priv->prefetch_job);
+	priv->prefetch_job = pk_engine_job_new (engine, TRUE);
+	if (priv->prefetch_job == NULL)
+		return G_SOURCE_CONTINUE;
+	priv->prefetch_id = 0;
+	g_strfreev (priv->prefetch_ids);
+	priv->prefetch_ids = (gchar **) g_ptr_array_free (g_steal_pointer (&package_ids), FALSE);
+	pk_backend_job_set_vfunc (priv->prefetch_job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_engine_prefetch_finished_cb, engine);
+	g_debug ("downloading %u updates in the background",
+		 g_strv_length (priv->prefetch_ids));
+	pk_backend_start_job (priv->backend, priv->prefetch_job);
+	pk_backend_update_packages (priv->backend, priv->prefetch_job,
+				    pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ONLY_DOWNLOAD),
+				    priv->prefetch_ids);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * pk_engine_prefetch_schedule:
+ *
+ * Downloads the pending updates once the machine is idle, on AC power and
+ * on an unmetered network, so that installing them later only has to
+ * install them.
+ **/
+static void
+pk_engine_prefetch_schedule (PkEngine *engine)
+{
+	PkEnginePrivate *priv = engine->priv;
+
+	if (!priv->prefetch || !pk_backend_is_implemented (priv->backend, PK_ROLE_ENUM_UPDATE_PACKAGES))
+		return;
+	if (priv->prefetch_id != 0)
+		g_source_remove (priv->prefetch_id);
+	priv->prefetch_id = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+							PK_ENGINE_PREFETCH_INTERVAL,
+							pk_engine_prefetch_cb,
+							engine, NULL);
+	g_source_set_name_by_id (priv->prefetch_id, "[PkEngine] prefetch");
+}
+
+static void
+pk_engine_query_cache_updates_changed_cb (PkQueryCache *query_cache, PkEngine *engine)
+{
+	PkResults *results;
+	guint i;
+	guint security = 0;
+	g_autoptr(GPtrArray) packages = NULL;
+
+	results = pk_query_cache_get_updates (query_cache);
+	if (results != NULL) {
+		packages = pk_results_get_package_array (results);
+		for (i = 0; i < packages->len; i++) {
+			PkPackage *pkg = g_ptr_array_index (packages, i);
+			if (pk_package_get_info (pkg) == PK_INFO_ENUM_SECURITY)
+				security++;
+		}
+	}
+	engine->priv->updates_count = packages != NULL ? packages->len : 0;
+	engine->priv->security_updates_count = security;
+
+	/* whoever listed the updates, the clients learn what changed */
+	if (packages != NULL) {
+		g_autoptr(GHashTable) current = NULL;
+		current = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		for (i = 0; i < packages->len; i++) {
+			PkPackage *pkg = g_ptr_array_index (packages, i);
+			g_hash_table_insert (current,
+					     g_strdup (pk_package_get_id (pkg)),
+					     (gpointer) pk_info_enum_to_string (pk_package_get_info (pkg)));
+		}
+		pk_engine_emit_delta (engine, "UpdatesDelta",
+				      &engine->priv->updates_known,
+				      &engine->priv->updates_epoch,
+				      current);
+	}
+
+	pk_engine_emit_property_changed (engine,
+					 "UpdatesCount",
+					 g_variant_new_uint32 (engine->priv->updates_count));
+	pk_engine_emit_property_changed (engine,
+					 "SecurityUpdatesCount",
+					 g_variant_new_uint32 (engine->priv->security_updates_count));
+	pk_engine_emit_property_changed (engine,
+					 "UpdatesTimestamp",
+					 g_variant_new_uint64 (pk_query_cache_get_updates_timestamp (query_cache)));
+
+	if (engine->priv->updates_count > 0)
+		pk_engine_prefetch_schedule (engine);
+}
+
+static GVariant *
+pk_engine_get_cached_updates (PkEngine *engine, GError **error)
+{
+	PkResults *results;
+	GVariantBuilder builder;
+	guint i;
+	g_autoptr(GPtrArray) packages = NULL;
+
+	results = pk_query_cache_get_updates (engine->priv->query_cache);
+	if (results == NULL) {
+		g_set_error_literal (error,
+				     PK_ENGINE_ERROR,
+				     PK_ENGINE_ERROR_INVALID_STATE,
+				     "no updates are cached, use GetUpdates");
+		return NULL;
+	}
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(uss)"));
+	packages = pk_results_get_package_array (results);
+	for (i = 0; i < packages->len; i++) {
+		PkPackage *pkg = g_ptr_array_index (packages, i);
+		g_variant_builder_add (&builder, "(uss)",
+				       pk_package_get_info (pkg),
+				       pk_package_get_id (pkg),
+				       pk_package_get_summary (pkg) != NULL ?
+				       pk_package_get_summary (pkg) : "");
+	}
+	return g_variant_new ("(ta(uss))",
+			      (guint64) pk_query_cache_get_updates_timestamp (engine->priv->query_cache),
+			      &builder);
+}
+
+static GVariant *
+pk_engine_lease_transactions (PkEngine *engine,
+			      const gchar *sender,
+			      guint count,
+			      GError **error)
+{
+	gint timeout;
+	guint i;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GPtrArray) tids = g_ptr_array_new_with_free_func (g_free);
+
+	if (count == 0) {
+		g_set_error_literal (error,
+				     PK_ENGINE_ERROR,
+				     PK_ENGINE_ERROR_INVALID_STATE,
+				     "no transactions requested");
+		return NULL;
+	}
+	timeout = PK_ENGINE_TRANSACTION_LEASE_TIMEOUT_DEFAULT;
+	if (g_key_file_has_key (engine->priv->conf, "Daemon", "TransactionLeaseTimeout", NULL))
+		timeout = g_key_file_get_integer (engine->priv->conf, "Daemon",
+						  "TransactionLeaseTimeout", NULL);
+	timeout = MAX (timeout, 1);
+
+	/* stop at the per-user limit, the client can ask again later */
+	count = MIN (count, PK_ENGINE_TRANSACTION_LEASE_MAX);
+	for (i = 0; i < count; i++) {
+		gchar *tid = pk_transaction_db_generate_id (engine->priv->transaction_db);
+		if (!pk_scheduler_lease (engine->priv->scheduler, tid, sender,
+					 (guint) timeout, &error_local)) {
+			g_free (tid);
+			break;
+		}
+		g_ptr_array_add (tids, tid);
+	}
+	if (tids->len == 0) {
+		g_set_error (error,
+			     PK_ENGINE_ERROR,
+			     PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+			     "could not lease transactions: %s",
+			     error_local->message);
+		return NULL;
+	}
+	g_debug ("leased %u transactions to %s for %is", tids->len, sender, timeout);
+	g_ptr_array_add (tids, NULL);
+	return g_variant_new ("(^aou)", (gchar **) tids->pdata, (guint) timeout);
+}
+
+static void
+pk_engine_backend_epoch_changed_cb (PkBackend *backend, PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	pk_engine_emit_property_changed (engine,
+					 "InstalledEpoch",
+					 g_variant_new_uint64 (pk_backend_get_epoch (backend, PK_BACKEND_EPOCH_INSTALLED)));
+	pk_engine_emit_property_changed (engine,
+					 "AvailableEpoch",
+					 g_variant_new_uint64 (pk_backend_get_epoch (backend, PK_BACKEND_EPOCH_AVAILABLE)));
+	pk_engine_name_list_schedule (engine);
+}
+
+static void
+pk_engine_backend_installed_changed_cb (PkBackend *backend, PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	/* something outside PackageKit changed the package database */
+	pk_query_cache_invalidate (engine->priv->query_cache);
+	pk_plan_cache_invalidate (engine->priv->plan_cache);
+	pk_search_sessions_invalidate (engine->priv->search_sessions);
+	pk_engine_prewarm_schedule (engine);
+	pk_engine_command_index_schedule (engine);
+
+	/* installed or removed outside PackageKit, maybe with the downloads */
+	g_hash_table_remove_all (engine->priv->prefetched);
+}
+
+static void
+pk_engine_backend_repo_list_changed_cb (PkBackend *backend, PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	pk_query_cache_invalidate (engine->priv->query_cache);
+	pk_plan_cache_invalidate (engine->priv->plan_cache);
+	pk_search_sessions_invalidate (engine->priv->search_sessions);
+	pk_engine_prewarm_schedule (engine);
+	pk_engine_command_index_schedule (engine);
+	pk_engine_repo_list_delta_schedule (engine);
+
+	g_debug ("emitting RepoListChanged");
+	g_dbus_connection_emit_signal (engine->priv->connection,
+				       NULL,
+				       PK_DBUS_PATH,
+				       PK_DBUS_INTERFACE,
+				       "RepoListChanged",
+				       NULL,
+				       NULL);
+}
+
+static void
+pk_engine_backend_updates_changed_cb (PkBackend *backend, PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	pk_query_cache_invalidate (engine->priv->query_cache);
+	pk_plan_cache_invalidate (engine->priv->plan_cache);
+	pk_search_sessions_invalidate (engine->priv->search_sessions);
+	pk_engine_prewarm_schedule (engine);
+	pk_engine_command_index_schedule (engine);
+	pk_engine_updates_delta_schedule (engine);
+
+	g_debug ("emitting UpdatesChanged");
+	g_dbus_connection_emit_signal (engine->priv->connection,
+				       NULL,
+				       PK_DBUS_PATH,
+				       PK_DBUS_INTERFACE,
+				       "UpdatesChanged",
+				       NULL,
+				       NULL);
+}
+
+static gboolean
+pk_engine_state_changed_cb (gpointer data)
+{
+	PkEngine *engine = PK_ENGINE (data);
+	g_autoptr(GError) error = NULL;
+
+	g_return_val_if_fail (PK_IS_ENGINE (engine), FALSE);
+
+	/* we're done something low-level */
+	if (!pk_offline_auth_invalidate (&error))
+		g_warning ("failed to invalidate: %s", error->message);
+
+	/* if network is not up, then just reschedule */
+	if (!g_network_monitor_get_network_available (engine->priv->network_monitor)) {
+		/* wait another timeout of PK_ENGINE_STATE_CHANGED_x_TIMEOUT */
+		return TRUE;
+	}
+
+	pk_backend_updates_changed (engine->priv->backend);
+
+	/* reset, now valid */
+	engine->priv->timeout_priority_id = 0;
+	engine->priv->timeout_normal_id = 0;
+
+	/* reset the timer */
+	pk_engine_reset_timer (engine);
+
+	return FALSE;
+}
+
+static void
+pk_engine_emit_restart_schedule (PkEngine *engine)
+{
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	g_debug ("emitting RestartSchedule");
+	g_dbus_connection_emit_signal (engine->priv->connection,
+				       NULL,
+				       PK_DBUS_PATH,
+				       PK_DBUS_INTERFACE,
+				       "RestartSchedule",
+				       NULL,
+				       NULL);
+}
+
+guint
+pk_engine_get_seconds_idle (PkEngine *engine)
+{
+	guint idle;
+	guint size;
+
+	g_return_val_if_fail (PK_IS_ENGINE (engine), 0);
+	g_return_val_if_fail (pk_is_thread_default (), 0);
+
+	/* check for transactions running - a transaction that takes a *long* time might not
+	 * give sufficient percentage updates to not be marked as idle */
+	size = pk_scheduler_get_size (engine->priv->scheduler);
+	if (size != 0) {
+		g_debug ("engine idle zero as %i transactions in progress", size);
+		return 0;
+	}
+
+	if (engine->priv->cache_bundle_busy) {
+		g_debug ("engine idle zero as a cache bundle is being copied");
+		return 0;
+	}
+
+	/* a peer is part way through downloading a package from us */
+	if (engine->priv->peer_cache != NULL &&
+	    pk_peer_cache_get_active (engine->priv->peer_cache) != 0) {
+		g_debug ("engine idle zero as sending packages to peers");
+		return 0;
+	}
+
+	/* have we been updated? */
+	if (engine->priv->notify_clients_of_upgrade) {
+		pk_engine_emit_restart_schedule (engine);
+		return G_MAXUINT;
+	}
+
+	/* do we need to shutdown quickly */
+	if (engine->priv->shutdown_as_soon_as_possible) {
+		g_debug ("need to restart daemon asap");
+		return G_MAXUINT;
+	}
+
+	idle = (guint) g_timer_elapsed (engine->priv->timer, NULL);
+	return idle;
+}
+
+static gboolean
+pk_engine_set_proxy_internal (PkEngine *engine, const gchar *sender,
+			      const gchar *proxy_http,
+			      const gchar *proxy_https,
+			      const gchar *proxy_ftp,
+			      const gchar *proxy_socks,
+			      const gchar *no_proxy,
+			      const gchar *pac,
+			      GError **error)
+{
+	gboolean ret;
+	guint uid;
+	g_autofree gchar *session = NULL;
+
+	/* get uid */
+	uid = pk_dbus_get_uid (engine->priv->dbus, sender);
+	if (uid == G_MAXUINT) {
+		g_set_error_literal (error,
+				     PK_ENGINE_ERROR,
+				     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
+				     "failed to get the uid");
+		return FALSE;
+	}
+
+	/* get session */
+	session = pk_dbus_get_session (engine->priv->dbus, sender);
+	if (session == NULL) {
+		g_set_error_literal (error,
+				     PK_ENGINE_ERROR,
+				     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
+				     "failed to get the session");
+		return FALSE;
+	}
+
+	/* save to database */
+	ret = pk_transaction_db_set_proxy (engine->priv->transaction_db,
+					   uid, session,
+					   proxy_http,
+					   proxy_https,
+					   proxy_ftp,
+					   proxy_socks,
+					   no_proxy,
+					   pac);
 	if (!ret) {
 		g_set_error_literal (error,
 				     PK_ENGINE_ERROR,
@@ -632,110 +1697,405 @@ pk_engine_is_proxy_unchanged (PkEngine *engine, const gchar *sender,
 	return TRUE;
 }
 
-static PolkitCheckAuthorizationFlags
-get_polkit_flags_for_dbus_invocation (GDBusMethodInvocation *invocation)
+static PolkitCheckAuthorizationFlags
+get_polkit_flags_for_dbus_invocation (GDBusMethodInvocation *invocation)
+{
+	PolkitCheckAuthorizationFlags flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
+	GDBusMessage *message = g_dbus_method_invocation_get_message (invocation);
+
+	if (g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_ALLOW_INTERACTIVE_AUTHORIZATION)
+		flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
+
+	return flags;
+}
+
+static void
+pk_engine_set_proxy (PkEngine *engine,
+		     const gchar *proxy_http,
+		     const gchar *proxy_https,
+		     const gchar *proxy_ftp,
+		     const gchar *proxy_socks,
+		     const gchar *no_proxy,
+		     const gchar *pac,
+		     GDBusMethodInvocation *context)
+{
+	guint len;
+	GError *error = NULL;
+	gboolean ret;
+	const gchar *sender;
+	PkEngineDbusState *state;
+	g_autoptr(PolkitSubject) subject = NULL;
+
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	/* blank is NULL */
+	if (proxy_http != NULL && proxy_http[0] == '\0')
+		proxy_http = NULL;
+	if (proxy_ftp != NULL && proxy_ftp[0] == '\0')
+		proxy_ftp = NULL;
+
+	g_debug ("SetProxy method called: %s, %s", proxy_http, proxy_ftp);
+
+	/* check length of http */
+	len = pk_strlen (proxy_http, 1024);
+	if (len == 1024) {
+		error = g_error_new_literal (PK_ENGINE_ERROR,
+					     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
+					     "http proxy was too long");
+		g_dbus_method_invocation_return_gerror (context, error);
+		goto out;
+	}
+
+	/* check length of ftp */
+	len = pk_strlen (proxy_ftp, 1024);
+	if (len == 1024) {
+		error = g_error_new_literal (PK_ENGINE_ERROR,
+					     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
+					     "ftp proxy was too long");
+		g_dbus_method_invocation_return_gerror (context, error);
+		goto out;
+	}
+
+	/* save sender */
+	sender = g_dbus_method_invocation_get_sender (context);
+
+	/* is exactly the same proxy? */
+	ret = pk_engine_is_proxy_unchanged (engine, sender,
+					    proxy_http,
+					    proxy_https,
+					    proxy_ftp,
+					    proxy_socks,
+					    no_proxy,
+					    pac);
+	if (ret) {
+		g_debug ("not changing proxy as the same as before");
+		g_dbus_method_invocation_return_value (context, NULL);
+		goto out;
+	}
+
+	if (!pk_engine_ensure_authority (engine, &error)) {
+		g_dbus_method_invocation_return_gerror (context, error);
+		goto out;
+	}
+
+	/* check subject */
+	subject = polkit_system_bus_name_new (sender);
+
+	/* cache state */
+	state = g_new0 (PkEngineDbusState, 1);
+	state->context = context;
+	state->engine = g_object_ref (engine);
+	state->sender = g_strdup (sender);
+	state->value1 = g_strdup (proxy_http);
+	state->value2 = g_strdup (proxy_https);
+	state->value3 = g_strdup (proxy_ftp);
+	state->value4 = g_strdup (proxy_socks);
+	state->value5 = g_strdup (no_proxy);
+	state->value6 = g_strdup (pac);
+
+	/* do authorization async */
+	polkit_authority_check_authorization (engine->priv->authority, subject,
+					      "org.freedesktop.packagekit.system-network-proxy-configure",
+					      NULL,
+					      get_polkit_flags_for_dbus_invocation (context),
+					      NULL,
+					      (GAsyncReadyCallback) pk_engine_action_obtain_proxy_authorization_finished_cb,
+					      state);
+
+	/* reset the timer */
+	pk_engine_reset_timer (engine);
+out:
+	return;
+}
+
+typedef struct {
+	GDBusMethodInvocation	*context;
+	PkEngine		*engine;
+	guint64			 rate;
+} PkEngineRateState;
+
+static void
+pk_engine_action_obtain_rate_authorization_finished_cb (PolkitAuthority *authority,
+							GAsyncResult *res,
+							PkEngineRateState *state)
+{
+	PkEnginePrivate *priv = state->engine->priv;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
+
+	/* finish the call */
+	result = polkit_authority_check_authorization_finish (priv->authority, res, &error_local);
+	if (result == NULL) {
+		g_dbus_method_invocation_return_error (state->context,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+						       "could not check for auth: %s",
+						       error_local->message);
+		goto out;
+	}
+	if (!polkit_authorization_result_get_is_authorized (result)) {
+		g_dbus_method_invocation_return_error_literal (state->context,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_DENIED,
+							       "failed to obtain auth");
+		goto out;
+	}
+
+	/* the transactions read this when they start running */
+	g_debug ("changing background download rate to %" G_GUINT64_FORMAT " bytes/s",
+		 state->rate);
+	g_key_file_set_uint64 (priv->conf, "Daemon", "BackgroundDownloadRate", state->rate);
+	pk_engine_emit_property_changed (state->engine,
+					 "BackgroundDownloadRate",
+					 g_variant_new_uint64 (state->rate));
+	g_dbus_method_invocation_return_value (state->context, NULL);
+out:
+	g_object_unref (state->engine);
+	g_free (state);
+}
+
+static void
+pk_engine_set_background_download_rate (PkEngine *engine,
+					guint64 rate,
+					GDBusMethodInvocation *context)
+{
+	PkEngineRateState *state;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PolkitSubject) subject = NULL;
+
+	/* nothing to do */
+	if (g_key_file_get_uint64 (engine->priv->conf, "Daemon",
+				   "BackgroundDownloadRate", NULL) == rate) {
+		g_dbus_method_invocation_return_value (context, NULL);
+		return;
+	}
+	if (!pk_engine_ensure_authority (engine, &error)) {
+		g_dbus_method_invocation_return_gerror (context, error);
+		return;
+	}
+
+	state = g_new0 (PkEngineRateState, 1);
+	state->context = context;
+	state->engine = g_object_ref (engine);
+	state->rate = rate;
+
+	/* do authorization async */
+	subject = polkit_system_bus_name_new (g_dbus_method_invocation_get_sender (context));
+	polkit_authority_check_authorization (engine->priv->authority, subject,
+					      "org.freedesktop.packagekit.system-network-bandwidth-configure",
+					      NULL,
+					      get_polkit_flags_for_dbus_invocation (context),
+					      NULL,
+					      (GAsyncReadyCallback) pk_engine_action_obtain_rate_authorization_finished_cb,
+					      state);
+
+	/* reset the timer */
+	pk_engine_reset_timer (engine);
+}
+
+static const gchar *
+pk_engine_get_distro_id (PkEngine *engine)
 {
-	PolkitCheckAuthorizationFlags flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
-	GDBusMessage *message = g_dbus_method_invocation_get_message (invocation);
+	if (engine->priv->distro_id == NULL)
+		engine->priv->distro_id = pk_get_distro_id ();
+	return engine->priv->distro_id;
+}
 
-	if (g_dbus_message_get_flags (message) & G_DBUS_MESSAGE_FLAGS_ALLOW_INTERACTIVE_AUTHORIZATION)
-		flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
+typedef struct {
+	GDBusMethodInvocation	*context;
+	PkEngine		*engine;
+	gboolean		 import;
+	gint			 fd;
+	gint			 signature_fd;
+	gchar			**roots;
+	gchar			*keyring;
+	gchar			*distro_id;
+	gchar			*backend_name;
+} PkEngineBundleState;
 
-	return flags;
+static void
+pk_engine_bundle_state_free (PkEngineBundleState *state)
+{
+	if (state->fd >= 0)
+		close (state->fd);
+	if (state->signature_fd >= 0)
+		close (state->signature_fd);
+	g_strfreev (state->roots);
+	g_free (state->keyring);
+	g_free (state->distro_id);
+	g_free (state->backend_name);
+	g_object_unref (state->engine);
+	g_free (state);
 }
 
+/* a bundle is hundreds of megabytes, so not on the main thread */
 static void
-pk_engine_set_proxy (PkEngine *engine,
-		     const gchar *proxy_http,
-		     const gchar *proxy_https,
-		     const gchar *proxy_ftp,
-		     const gchar *proxy_socks,
-		     const gchar *no_proxy,
-		     const gchar *pac,
-		     GDBusMethodInvocation *context)
+pk_engine_cache_bundle_thread (GTask *task,
+			       gpointer source_object,
+			       gpointer task_data,
+			       GCancellable *cancellable)
 {
-	guint len;
-	GError *error = NULL;
+	PkEngineBundleState *state = (PkEngineBundleState *) task_data;
 	gboolean ret;
-	const gchar *sender;
-	PkEngineDbusState *state;
-	g_autoptr(PolkitSubject) subject = NULL;
-
-	g_return_if_fail (PK_IS_ENGINE (engine));
+	g_autoptr(GError) error = NULL;
 
-	/* blank is NULL */
-	if (proxy_http != NULL && proxy_http[0] == '\0')
-		proxy_http = NULL;
-	if (proxy_ftp != NULL && proxy_ftp[0] == '\0')
-		proxy_ftp = NULL;
+	if (state->import) {
+		g_autoptr(GInputStream) stream = g_unix_input_stream_new (state->fd, TRUE);
+		g_autoptr(GInputStream) signature = g_unix_input_stream_new (state->signature_fd, TRUE);
+		state->fd = -1;
+		state->signature_fd = -1;
+		ret = pk_cache_bundle_import (stream, signature, state->keyring,
+					      state->roots, state->distro_id,
+					      state->backend_name, cancellable, &error);
+	} else {
+		g_autoptr(GOutputStream) stream = g_unix_output_stream_new (state->fd, TRUE);
+		state->fd = -1;
+		ret = pk_cache_bundle_export (stream, state->roots, state->distro_id,
+					      state->backend_name, cancellable, &error);
+	}
+	if (!ret) {
+		g_task_return_error (task, g_steal_pointer (&error));
+		return;
+	}
+	g_task_return_boolean (task, TRUE);
+}
 
-	g_debug ("SetProxy method called: %s, %s", proxy_http, proxy_ftp);
+static void
+pk_engine_cache_bundle_done_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (source);
+	PkEngineBundleState *state = g_task_get_task_data (G_TASK (res));
+	g_autoptr(GError) error = NULL;
 
-	/* check length of http */
-	len = pk_strlen (proxy_http, 1024);
-	if (len == 1024) {
-		error = g_error_new_literal (PK_ENGINE_ERROR,
-					     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
-					     "http proxy was too long");
-		g_dbus_method_invocation_return_gerror (context, error);
-		goto out;
+	engine->priv->cache_bundle_busy = FALSE;
+	engine->priv->cache_bundle_importing = FALSE;
+	if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+		g_dbus_method_invocation_return_error (state->context,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_INVALID_STATE,
+						       "failed to %s the cache bundle: %s",
+						       state->import ? "import" : "export",
+						       error->message);
+		return;
 	}
 
-	/* check length of ftp */
-	len = pk_strlen (proxy_ftp, 1024);
-	if (len == 1024) {
-		error = g_error_new_literal (PK_ENGINE_ERROR,
-					     PK_ENGINE_ERROR_CANNOT_SET_PROXY,
-					     "ftp proxy was too long");
-		g_dbus_method_invocation_return_gerror (context, error);
-		goto out;
+	/* the backend only reads the new caches when it is loaded again */
+	if (state->import) {
+		g_debug ("cache bundle imported, restarting");
+		engine->priv->shutdown_as_soon_as_possible = TRUE;
 	}
+	g_dbus_method_invocation_return_value (state->context, NULL);
+}
 
-	/* save sender */
-	sender = g_dbus_method_invocation_get_sender (context);
+static void
+pk_engine_action_obtain_bundle_authorization_finished_cb (PolkitAuthority *authority,
+							  GAsyncResult *res,
+							  PkEngineBundleState *state)
+{
+	PkEnginePrivate *priv = state->engine->priv;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(PolkitAuthorizationResult) result = NULL;
 
-	/* is exactly the same proxy? */
-	ret = pk_engine_is_proxy_unchanged (engine, sender,
-					    proxy_http,
-					    proxy_https,
-					    proxy_ftp,
-					    proxy_socks,
-					    no_proxy,
-					    pac);
-	if (ret) {
-		g_debug ("not changing proxy as the same as before");
-		g_dbus_method_invocation_return_value (context, NULL);
-		goto out;
+	/* finish the call */
+	result = polkit_authority_check_authorization_finish (priv->authority, res, &error_local);
+	if (result == NULL) {
+		g_dbus_method_invocation_return_error (state->context,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_CANNOT_CHECK_AUTH,
+						       "could not check for auth: %s",
+						       error_local->message);
+		pk_engine_bundle_state_free (state);
+		return;
+	}
+	if (!polkit_authorization_result_get_is_authorized (result)) {
+		g_dbus_method_invocation_return_error_literal (state->context,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_DENIED,
+							       "failed to obtain auth");
+		pk_engine_bundle_state_free (state);
+		return;
 	}
 
-	/* check subject */
-	subject = polkit_system_bus_name_new (sender);
+	/* the caches must not change while they are copied */
+	if (priv->cache_bundle_busy ||
+	    pk_scheduler_get_size (priv->scheduler) != 0) {
+		g_dbus_method_invocation_return_error_literal (state->context,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_INVALID_STATE,
+							       "transactions are running");
+		pk_engine_bundle_state_free (state);
+		return;
+	}
+	priv->cache_bundle_busy = TRUE;
+	priv->cache_bundle_importing = state->import;
+
+	state->roots = pk_cache_bundle_get_roots (priv->conf);
+	state->keyring = g_key_file_get_string (priv->conf, "Daemon", "CacheBundleKeyring", NULL);
+	state->distro_id = g_strdup (pk_engine_get_distro_id (state->engine));
+	state->backend_name = g_strdup (priv->backend_name);
+	task = g_task_new (state->engine, NULL, pk_engine_cache_bundle_done_cb, NULL);
+	g_task_set_task_data (task, state, (GDestroyNotify) pk_engine_bundle_state_free);
+	g_task_run_in_thread (task, pk_engine_cache_bundle_thread);
+}
 
-	/* cache state */
-	state = g_new0 (PkEngineDbusState, 1);
+static void
+pk_engine_cache_bundle (PkEngine *engine,
+			gboolean import,
+			GVariant *parameters,
+			GDBusMethodInvocation *context)
+{
+	GUnixFDList *fd_list;
+	PkEngineBundleState *state;
+	gint32 fd_index = 0;
+	gint32 signature_index = -1;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PolkitSubject) subject = NULL;
+
+	if (import)
+		g_variant_get (parameters, "(hh)", &fd_index, &signature_index);
+	else
+		g_variant_get (parameters, "(h)", &fd_index);
+	fd_list = g_dbus_message_get_unix_fd_list (g_dbus_method_invocation_get_message (context));
+	if (fd_list == NULL ||
+	    fd_index < 0 || fd_index >= g_unix_fd_list_get_length (fd_list) ||
+	    (import && (signature_index < 0 || signature_index >= g_unix_fd_list_get_length (fd_list)))) {
+		g_dbus_method_invocation_return_error_literal (context,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_NOT_SUPPORTED,
+							       "no file descriptor was passed");
+		return;
+	}
+
+	state = g_new0 (PkEngineBundleState, 1);
 	state->context = context;
 	state->engine = g_object_ref (engine);
-	state->sender = g_strdup (sender);
-	state->value1 = g_strdup (proxy_http);
-	state->value2 = g_strdup (proxy_https);
-	state->value3 = g_strdup (proxy_ftp);
-	state->value4 = g_strdup (proxy_socks);
-	state->value5 = g_strdup (no_proxy);
-	state->value6 = g_strdup (pac);
+	state->import = import;
+	state->signature_fd = -1;
+	state->fd = g_unix_fd_list_get (fd_list, fd_index, &error);
+	if (state->fd >= 0 && import)
+		state->signature_fd = g_unix_fd_list_get (fd_list, signature_index, &error);
+	if (state->fd < 0 || (import && state->signature_fd < 0) ||
+	    !pk_engine_ensure_authority (engine, &error)) {
+		g_dbus_method_invocation_return_gerror (context, error);
+		pk_engine_bundle_state_free (state);
+		return;
+	}
 
-	/* do authorization async */
+	/* seeding the caches is as good as refreshing them, but replacing
+	 * them decides what gets installed */
+	subject = polkit_system_bus_name_new (g_dbus_method_invocation_get_sender (context));
 	polkit_authority_check_authorization (engine->priv->authority, subject,
-					      "org.freedesktop.packagekit.system-network-proxy-configure",
+					      import ? "org.freedesktop.packagekit.system-cache-import" :
+						       "org.freedesktop.packagekit.system-sources-refresh",
 					      NULL,
 					      get_polkit_flags_for_dbus_invocation (context),
 					      NULL,
-					      (GAsyncReadyCallback) pk_engine_action_obtain_proxy_authorization_finished_cb,
+					      (GAsyncReadyCallback) pk_engine_action_obtain_bundle_authorization_finished_cb,
 					      state);
 
 	/* reset the timer */
 	pk_engine_reset_timer (engine);
-out:
-	return;
 }
 
 static PkAuthorizeEnum
@@ -747,6 +2107,9 @@ pk_engine_can_authorize_action_id (PkEngine *engine,
 	g_autoptr(PolkitAuthorizationResult) res = NULL;
 	g_autoptr(PolkitSubject) subject = NULL;
 
+	if (!pk_engine_ensure_authority (engine, error))
+		return PK_AUTHORIZE_ENUM_UNKNOWN;
+
 	/* check subject */
 	subject = polkit_system_bus_name_new (sender);
 
@@ -790,6 +2153,17 @@ pk_engine_class_init (PkEngineClass *klass)
 	g_type_class_add_private (klass, sizeof (PkEnginePrivate));
 }
 
+static gchar *
+pk_engine_get_conf_checksum (GFile *file)
+{
+	gsize len = 0;
+	g_autofree gchar *data = NULL;
+
+	if (!g_file_load_contents (file, NULL, &data, &len, NULL, NULL))
+		return NULL;
+	return g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *) data, len);
+}
+
 static void
 pk_engine_conf_file_changed_cb (GFileMonitor *file_monitor,
 				GFile *file,
@@ -797,9 +2171,19 @@ pk_engine_conf_file_changed_cb (GFileMonitor *file_monitor,
 				GFileMonitorEvent event_type,
 				PkEngine *engine)
 {
+	g_autofree gchar *checksum = NULL;
+
 	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	/* configuration management rewrites the file with the same contents */
+	checksum = pk_engine_get_conf_checksum (file);
+	if (checksum != NULL && g_strcmp0 (checksum, engine->priv->conf_checksum) == 0) {
+		g_debug ("config file touched but not changed");
+		return;
+	}
 	g_debug ("setting shutdown_as_soon_as_possible TRUE");
 	engine->priv->shutdown_as_soon_as_possible = TRUE;
+	engine->priv->restart_handoff = TRUE;
 }
 
 static void
@@ -812,6 +2196,7 @@ pk_engine_binary_file_changed_cb (GFileMonitor *file_monitor,
 	g_return_if_fail (PK_IS_ENGINE (engine));
 	g_debug ("setting notify_clients_of_upgrade TRUE");
 	engine->priv->notify_clients_of_upgrade = TRUE;
+	engine->priv->restart_handoff = TRUE;
 }
 
 static void
@@ -904,60 +2289,258 @@ pk_engine_network_state_changed_cb (GNetworkMonitor *network_monitor,
 }
 
 static void
-pk_engine_setup_file_monitors (PkEngine *engine)
+pk_engine_setup_file_monitors (PkEngine *engine)
+{
+	const gchar *filename = "/etc/PackageKit/PackageKit.conf";
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file_binary = NULL;
+	g_autoptr(GFile) file_conf = NULL;
+
+	/* monitor the binary file for changes */
+	file_binary = g_file_new_for_path (LIBEXECDIR "/packagekitd");
+	engine->priv->monitor_binary = g_file_monitor_file (file_binary,
+							    G_FILE_MONITOR_NONE,
+							    NULL,
+							    &error);
+	if (engine->priv->monitor_binary == NULL) {
+		g_warning ("Failed to set watch on %s: %s",
+			   LIBEXECDIR "/packagekitd", error->message);
+		return;
+	}
+	g_signal_connect (engine->priv->monitor_binary, "changed",
+			  G_CALLBACK (pk_engine_binary_file_changed_cb), engine);
+
+	/* monitor config file for changes */
+	g_debug ("setting config file watch on %s", filename);
+	file_conf = g_file_new_for_path (filename);
+	engine->priv->conf_checksum = pk_engine_get_conf_checksum (file_conf);
+	engine->priv->monitor_conf = g_file_monitor_file (file_conf,
+							  G_FILE_MONITOR_NONE,
+							  NULL,
+							  &error);
+	if (engine->priv->monitor_conf == NULL) {
+		g_warning ("Failed to set watch on %s: %s", filename, error->message);
+		return;
+	}
+	g_signal_connect (engine->priv->monitor_conf, "changed",
+			  G_CALLBACK (pk_engine_conf_file_changed_cb), engine);
+
+	/* set up the prepared update monitor */
+	engine->priv->monitor_offline = pk_offline_get_prepared_monitor (NULL, &error);
+	if (engine->priv->monitor_offline == NULL) {
+		g_warning ("Failed to set watch on %s: %s",
+			   PK_OFFLINE_PREPARED_FILENAME, error->message);
+		return;
+	}
+	g_signal_connect (engine->priv->monitor_offline, "changed",
+			  G_CALLBACK (pk_engine_offline_file_changed_cb), engine);
+
+	/* set up the prepared system upgrade monitor */
+	engine->priv->monitor_offline_upgrade = pk_offline_get_prepared_upgrade_monitor (NULL, &error);
+	if (engine->priv->monitor_offline_upgrade == NULL) {
+		g_warning ("Failed to set watch on %s: %s",
+			   PK_OFFLINE_PREPARED_UPGRADE_FILENAME, error->message);
+		return;
+	}
+	g_signal_connect (engine->priv->monitor_offline_upgrade, "changed",
+			  G_CALLBACK (pk_engine_offline_upgrade_file_changed_cb), engine);
+}
+
+static void
+pk_engine_authority_changed_cb (PolkitAuthority *authority, PkEngine *engine)
+{
+	/* rules or temporary authorizations may have been revoked */
+	pk_auth_cache_invalidate (engine->priv->auth_cache);
+}
+
+static gboolean
+pk_engine_transaction_db_step_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+
+	/* stop as soon as there is real work to do, the next check resumes */
+	if (pk_scheduler_get_size (engine->priv->scheduler) == 0 &&
+	    pk_transaction_db_maintenance_step (engine->priv->transaction_db))
+		return TRUE;
+	engine->priv->transaction_db_step_id = 0;
+	return FALSE;
+}
+
+static gboolean
+pk_engine_transaction_db_maintenance_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+
+	if (engine->priv->transaction_db_step_id != 0)
+		return TRUE;
+	if (pk_scheduler_get_size (engine->priv->scheduler) != 0)
+		return TRUE;
+	engine->priv->transaction_db_step_id =
+		g_idle_add_full (G_PRIORITY_LOW,
+				 pk_engine_transaction_db_step_cb,
+				 engine, NULL);
+	g_source_set_name_by_id (engine->priv->transaction_db_step_id,
+				 "[PkEngine] transaction-db-step");
+	return TRUE;
+}
+
+static void
+pk_engine_setup_transaction_db_retention (PkEngine *engine)
+{
+	gint max_age;
+	gint max_count;
+	gint archive_age;
+
+	max_age = g_key_file_get_integer (engine->priv->conf, "Daemon", "TransactionHistoryMaxAge", NULL);
+	max_count = g_key_file_get_integer (engine->priv->conf, "Daemon", "TransactionHistoryMaxCount", NULL);
+	archive_age = g_key_file_get_integer (engine->priv->conf, "Daemon", "TransactionHistoryArchiveAge", NULL);
+	if (max_age <= 0 && max_count <= 0 && archive_age <= 0)
+		return;
+
+	/* the ages are set in days */
+	pk_transaction_db_set_retention (engine->priv->transaction_db,
+					 (gint64) MAX (max_age, 0) * 24 * 60 * 60,
+					 MAX (max_count, 0),
+					 (gint64) MAX (archive_age, 0) * 24 * 60 * 60);
+	engine->priv->transaction_db_maintenance_id =
+		g_timeout_add_seconds (PK_ENGINE_TRANSACTION_DB_MAINTENANCE_INTERVAL,
+				       pk_engine_transaction_db_maintenance_cb,
+				       engine);
+	g_source_set_name_by_id (engine->priv->transaction_db_maintenance_id,
+				 "[PkEngine] transaction-db-maintenance");
+}
+
+static gchar *
+pk_engine_get_warm_state_filename (gboolean handoff)
+{
+	return g_build_filename (LOCALSTATEDIR, "cache", "PackageKit",
+				 handoff ? "warm-state.handoff" : "warm-state", NULL);
+}
+
+/**
+ * pk_engine_get_warm_state_stamp:
+ *
+ * Describes everything the saved results depend on, so that a snapshot
+ * written by a different daemon, backend or package database is ignored.
+ **/
+static GVariant *
+pk_engine_get_warm_state_stamp (PkEngine *engine)
+{
+	GVariantBuilder builder;
+	const gchar * const *paths;
+	guint i;
+	g_auto(GStrv) paths_conf = NULL;
+
+	paths_conf = g_key_file_get_string_list (engine->priv->conf, "Daemon",
+						 "WarmStatePaths", NULL, NULL);
+	paths = paths_conf != NULL ? (const gchar * const *) paths_conf :
+				     pk_engine_warm_state_paths_default;
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(st)"));
+	for (i = 0; paths[i] != NULL; i++) {
+		GStatBuf buf;
+		guint64 mtime = 0;
+
+		if (g_stat (paths[i], &buf) == 0)
+			mtime = (guint64) buf.st_mtime;
+		g_variant_builder_add (&builder, "(st)", paths[i], mtime);
+	}
+	return g_variant_new ("(sstt@a(st))",
+			      PROJECT_VERSION,
+			      engine->priv->backend_name,
+			      engine->priv->roles,
+			      engine->priv->filters,
+			      g_variant_builder_end (&builder));
+}
+
+/**
+ * pk_engine_save_warm_state:
+ *
+ * Writes the answered queries to disk when exiting idle, so that the next
+ * activation can reply without loading the backend caches again. When
+ * restarting because the binary or the config changed they are handed
+ * over to the next instance even without WarmState, as that is started
+ * straight away.
+ **/
+void
+pk_engine_save_warm_state (PkEngine *engine)
+{
+	gboolean handoff;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) stamp = NULL;
+
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	handoff = pk_engine_get_restart_in_place (engine);
+	if (!handoff &&
+	    !g_key_file_get_boolean (engine->priv->conf, "Daemon", "WarmState", NULL))
+		return;
+	if (engine->priv->backend_name == NULL)
+		return;
+	if (pk_query_cache_get_size (engine->priv->query_cache) == 0)
+		return;
+	filename = pk_engine_get_warm_state_filename (handoff);
+	stamp = g_variant_ref_sink (pk_engine_get_warm_state_stamp (engine));
+	if (!pk_query_cache_save (engine->priv->query_cache, filename, stamp, &error)) {
+		g_warning ("failed to save warm state: %s", error->message);
+		return;
+	}
+	g_debug ("saved %u cached queries to %s",
+		 pk_query_cache_get_size (engine->priv->query_cache), filename);
+}
+
+static void
+pk_engine_load_warm_state_file (PkEngine *engine, gboolean handoff)
 {
-	const gchar *filename = "/etc/PackageKit/PackageKit.conf";
+	g_autofree gchar *filename = NULL;
 	g_autoptr(GError) error = NULL;
-	g_autoptr(GFile) file_binary = NULL;
-	g_autoptr(GFile) file_conf = NULL;
+	g_autoptr(GVariant) stamp = NULL;
 
-	/* monitor the binary file for changes */
-	file_binary = g_file_new_for_path (LIBEXECDIR "/packagekitd");
-	engine->priv->monitor_binary = g_file_monitor_file (file_binary,
-							    G_FILE_MONITOR_NONE,
-							    NULL,
-							    &error);
-	if (engine->priv->monitor_binary == NULL) {
-		g_warning ("Failed to set watch on %s: %s",
-			   LIBEXECDIR "/packagekitd", error->message);
+	filename = pk_engine_get_warm_state_filename (handoff);
+	if (!g_file_test (filename, G_FILE_TEST_EXISTS))
 		return;
+	if (handoff ||
+	    g_key_file_get_boolean (engine->priv->conf, "Daemon", "WarmState", NULL)) {
+		stamp = g_variant_ref_sink (pk_engine_get_warm_state_stamp (engine));
+		if (pk_query_cache_load (engine->priv->query_cache, filename, stamp, &error)) {
+			g_debug ("restored %u cached queries from %s",
+				 pk_query_cache_get_size (engine->priv->query_cache),
+				 filename);
+		} else {
+			g_debug ("not using warm state: %s", error->message);
+		}
 	}
-	g_signal_connect (engine->priv->monitor_binary, "changed",
-			  G_CALLBACK (pk_engine_binary_file_changed_cb), engine);
 
-	/* monitor config file for changes */
-	g_debug ("setting config file watch on %s", filename);
-	file_conf = g_file_new_for_path (filename);
-	engine->priv->monitor_conf = g_file_monitor_file (file_conf,
-							  G_FILE_MONITOR_NONE,
-							  NULL,
-							  &error);
-	if (engine->priv->monitor_conf == NULL) {
-		g_warning ("Failed to set watch on %s: %s", filename, error->message);
-		return;
-	}
-	g_signal_connect (engine->priv->monitor_conf, "changed",
-			  G_CALLBACK (pk_engine_conf_file_changed_cb), engine);
+	/* only ever used once, as nothing tracks changes made after this */
+	if (g_unlink (filename) != 0)
+		g_warning ("failed to remove %s: %s", filename, g_strerror (errno));
+}
 
-	/* set up the prepared update monitor */
-	engine->priv->monitor_offline = pk_offline_get_prepared_monitor (NULL, &error);
-	if (engine->priv->monitor_offline == NULL) {
-		g_warning ("Failed to set watch on %s: %s",
-			   PK_OFFLINE_PREPARED_FILENAME, error->message);
-		return;
-	}
-	g_signal_connect (engine->priv->monitor_offline, "changed",
-			  G_CALLBACK (pk_engine_offline_file_changed_cb), engine);
+static void
+pk_engine_load_warm_state (PkEngine *engine)
+{
+	/* what the instance that restarted for us handed over, then any
+	 * older snapshot, which the same stamp check makes harmless */
+	pk_engine_load_warm_state_file (engine, TRUE);
+	pk_engine_load_warm_state_file (engine, FALSE);
+}
 
-	/* set up the prepared system upgrade monitor */
-	engine->priv->monitor_offline_upgrade = pk_offline_get_prepared_upgrade_monitor (NULL, &error);
-	if (engine->priv->monitor_offline_upgrade == NULL) {
-		g_warning ("Failed to set watch on %s: %s",
-			   PK_OFFLINE_PREPARED_UPGRADE_FILENAME, error->message);
-		return;
-	}
-	g_signal_connect (engine->priv->monitor_offline_upgrade, "changed",
-			  G_CALLBACK (pk_engine_offline_upgrade_file_changed_cb), engine);
+/**
+ * pk_engine_get_restart_in_place:
+ *
+ * Return value: %TRUE if the daemon is going to exit because its binary
+ * or config changed, and should start the new instance itself
+ **/
+gboolean
+pk_engine_get_restart_in_place (PkEngine *engine)
+{
+	g_return_val_if_fail (PK_IS_ENGINE (engine), FALSE);
+
+	if (!engine->priv->restart_handoff)
+		return FALSE;
+	if (!g_key_file_has_key (engine->priv->conf, "Daemon", "RestartInPlace", NULL))
+		return TRUE;
+	return g_key_file_get_boolean (engine->priv->conf, "Daemon", "RestartInPlace", NULL);
 }
 
 gboolean
@@ -967,12 +2550,12 @@ pk_engine_load_backend (PkEngine *engine, GError **error)
 	if (!pk_backend_load (engine->priv->backend, error))
 		return FALSE;
 
-	/* load anything that can fail */
-	engine->priv->authority = polkit_authority_get_sync (NULL, error);
-	if (engine->priv->authority == NULL)
-		return FALSE;
+	/* load anything that can fail, the job count is needed for the first tid */
 	if (!pk_transaction_db_load (engine->priv->transaction_db, error))
 		return FALSE;
+	pk_transaction_db_set_compress (engine->priv->transaction_db,
+					g_key_file_get_boolean (engine->priv->conf, "Daemon",
+								"TransactionHistoryCompress", NULL));
 
 	/* create a new backend so we can get the static stuff */
 	engine->priv->roles = pk_backend_get_roles (engine->priv->backend);
@@ -982,6 +2565,38 @@ pk_engine_load_backend (PkEngine *engine, GError **error)
 	engine->priv->backend_name = pk_backend_get_name (engine->priv->backend);
 	engine->priv->backend_description = pk_backend_get_description (engine->priv->backend);
 	engine->priv->backend_author = pk_backend_get_author (engine->priv->backend);
+
+	/* answer the first queries from the last instance */
+	pk_engine_load_warm_state (engine);
+
+	/* have the caches ready for the first query */
+	engine->priv->prewarm = g_key_file_get_boolean (engine->priv->conf, "Daemon",
+							"BackendPrewarm", NULL);
+	pk_engine_prewarm_schedule (engine);
+
+	/* the index is kept across restarts, so only build a missing one */
+	engine->priv->command_index = g_key_file_get_boolean (engine->priv->conf, "Daemon",
+							      "CommandNotFoundIndex", NULL);
+	if (!g_file_test (PK_COMMAND_INDEX_FILENAME, G_FILE_TEST_EXISTS))
+		pk_engine_command_index_schedule (engine);
+
+	/* the epochs are new on every start, so the list may be stale */
+	engine->priv->name_list = g_key_file_get_boolean (engine->priv->conf, "Daemon",
+							  "PackageNameList", NULL);
+	pk_engine_name_list_schedule (engine);
+
+	/* the first lists are what the first deltas are made against */
+	engine->priv->change_deltas = g_key_file_get_boolean (engine->priv->conf, "Daemon",
+							      "ChangeDeltas", NULL);
+	pk_engine_updates_delta_schedule (engine);
+	pk_engine_repo_list_delta_schedule (engine);
+
+	/* only once a refresh or a client has listed the updates */
+	engine->priv->prefetch = g_key_file_get_boolean (engine->priv->conf, "Daemon",
+							 "UpdatesPrefetch", NULL);
+
+	engine->priv->startup_ready = g_get_monotonic_time () - engine->priv->startup_time;
+	g_debug ("ready %" G_GINT64_FORMAT "us after startup", engine->priv->startup_ready);
 	return TRUE;
 }
 
@@ -1003,6 +2618,7 @@ pk_engine_offline_get_property (GDBusConnection *connection_, const gchar *sende
 
 	/* reset the timer */
 	pk_engine_reset_timer (engine);
+	pk_engine_mark_first_request (engine);
 
 	if (g_strcmp0 (property_name, "TriggerAction") == 0) {
 		PkOfflineAction action = pk_offline_get_action (NULL);
@@ -1062,6 +2678,7 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 
 	/* reset the timer */
 	pk_engine_reset_timer (engine);
+	pk_engine_mark_first_request (engine);
 
 	if (g_strcmp0 (property_name, "VersionMajor") == 0)
 		return g_variant_new_uint32 (PK_MAJOR_VERSION);
@@ -1088,7 +2705,22 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 	if (g_strcmp0 (property_name, "NetworkState") == 0)
 		return g_variant_new_uint32 (engine->priv->network_state);
 	if (g_strcmp0 (property_name, "DistroId") == 0)
-		return _g_variant_new_maybe_string (engine->priv->distro_id);
+		return _g_variant_new_maybe_string (pk_engine_get_distro_id (engine));
+	if (g_strcmp0 (property_name, "Prewarmed") == 0)
+		return g_variant_new_boolean (engine->priv->prewarmed);
+	if (g_strcmp0 (property_name, "UpdatesCount") == 0)
+		return g_variant_new_uint32 (engine->priv->updates_count);
+	if (g_strcmp0 (property_name, "SecurityUpdatesCount") == 0)
+		return g_variant_new_uint32 (engine->priv->security_updates_count);
+	if (g_strcmp0 (property_name, "UpdatesTimestamp") == 0)
+		return g_variant_new_uint64 (pk_query_cache_get_updates_timestamp (engine->priv->query_cache));
+	if (g_strcmp0 (property_name, "InstalledEpoch") == 0)
+		return g_variant_new_uint64 (pk_backend_get_epoch (engine->priv->backend, PK_BACKEND_EPOCH_INSTALLED));
+	if (g_strcmp0 (property_name, "AvailableEpoch") == 0)
+		return g_variant_new_uint64 (pk_backend_get_epoch (engine->priv->backend, PK_BACKEND_EPOCH_AVAILABLE));
+	if (g_strcmp0 (property_name, "BackgroundDownloadRate") == 0)
+		return g_variant_new_uint64 (g_key_file_get_uint64 (engine->priv->conf, "Daemon",
+								    "BackgroundDownloadRate", NULL));
 
 	/* return an error */
 	g_set_error (error,
@@ -1099,173 +2731,157 @@ pk_engine_daemon_get_property (GDBusConnection *connection_, const gchar *sender
 	return NULL;
 }
 
-static gboolean
-pk_engine_package_name_in_strv (gchar **strv, PkPackage *pkg)
+typedef struct {
+	PkEngine		*engine;
+	GDBusMethodInvocation	*invocation;
+	GCancellable		*cancellable;
+	gchar			*package_name;
+	guint			 watch_id;
+} PkEngineHistoryHelper;
+
+static void
+pk_engine_history_helper_free (PkEngineHistoryHelper *helper)
 {
-	guint i;
-	for (i = 0; strv[i] != NULL; i++) {
-		if (g_strcmp0 (strv[i], pk_package_get_name (pkg)) == 0)
-			return TRUE;
-	}
-	return FALSE;
+	if (helper->watch_id != 0)
+		g_bus_unwatch_name (helper->watch_id);
+	g_object_unref (helper->engine);
+	g_object_unref (helper->invocation);
+	g_object_unref (helper->cancellable);
+	g_free (helper->package_name);
+	g_free (helper);
 }
 
-static GVariant *
-pk_engine_get_package_history_pkg (PkTransactionPast *item, PkPackage *pkg)
+/* nobody is left to read the reply, so stop the query */
+static void
+pk_engine_history_vanished_cb (GDBusConnection *connection,
+			       const gchar *name,
+			       gpointer user_data)
 {
-	GVariantBuilder builder;
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder, "{sv}", "info",
-			       g_variant_new_uint32 (pk_package_get_info (pkg)));
-	g_variant_builder_add (&builder, "{sv}", "source",
-			       g_variant_new_string (pk_package_get_data (pkg)));
-	g_variant_builder_add (&builder, "{sv}", "version",
-			       g_variant_new_string (pk_package_get_version (pkg)));
-	g_variant_builder_add (&builder, "{sv}", "timestamp",
-			       g_variant_new_uint64 (pk_transaction_past_get_timestamp (item)));
-	g_variant_builder_add (&builder, "{sv}", "user-id",
-			       g_variant_new_uint32 (pk_transaction_past_get_uid (item)));
-	return g_variant_builder_end (&builder);
+	PkEngineHistoryHelper *helper = (PkEngineHistoryHelper *) user_data;
+	g_debug ("%s went away, cancelling package history", name);
+	g_cancellable_cancel (helper->cancellable);
 }
 
-static gboolean
-pk_engine_is_package_history_interesing (PkPackage *package)
+static void
+pk_engine_get_package_history_cb (GObject *source,
+				  GAsyncResult *res,
+				  gpointer user_data)
 {
-	gboolean ret;
-
-	switch (pk_package_get_info (package)) {
-	case PK_INFO_ENUM_INSTALLING:
-	case PK_INFO_ENUM_REMOVING:
-	case PK_INFO_ENUM_UPDATING:
-		ret = TRUE;
-		break;
-	default:
-		ret = FALSE;
-		break;
+	GVariant *tuple;
+	PkEngineHistoryHelper *helper = (PkEngineHistoryHelper *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = pk_transaction_db_get_package_history_finish (helper->engine->priv->transaction_db,
+							      res, &error);
+	if (value == NULL) {
+		/* the caller has gone, so nobody sees this */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_dbus_method_invocation_return_gerror (helper->invocation, error);
+			pk_engine_history_helper_free (helper);
+			return;
+		}
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_NOT_SUPPORTED,
+						       "history for package name %s failed: %s",
+						       helper->package_name,
+						       error->message);
+		pk_engine_history_helper_free (helper);
+		return;
 	}
-	return ret;
+	tuple = g_variant_new_tuple (&value, 1);
+	g_dbus_method_invocation_return_value (helper->invocation, tuple);
+	pk_engine_history_helper_free (helper);
 }
 
-static GVariant *
+/* the sqlite query runs on the transaction-db reader thread */
+static void
 pk_engine_get_package_history (PkEngine *engine,
+			       const gchar *sender,
 			       gchar **package_names,
 			       guint max_size,
-			       GError **error)
+			       GDBusMethodInvocation *invocation)
 {
-	const gchar *data;
-	const gchar *pkgname;
-	gboolean ret;
-	gchar *key;
-	gint64 timestamp;
-	GList *l;
-	GList *list;
-	GPtrArray *array = NULL;
-	guint i;
-	GVariantBuilder builder;
-	GVariant *value = NULL;
-	PkTransactionPast *item;
-	g_autoptr(GHashTable) deduplicate_hash = NULL;
-	g_autoptr(GHashTable) pkgname_hash = NULL;
-	g_autoptr(GList) keys = NULL;
-	g_autoptr(PkPackage) package_tmp = NULL;
-
-	list = pk_transaction_db_get_list (engine->priv->transaction_db, max_size);
-
-	/* simplify the loop */
-	if (max_size == 0)
-		max_size = G_MAXUINT;
-
-	pkgname_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-	deduplicate_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-	package_tmp = pk_package_new ();
-	for (l = list; l != NULL; l = l->next) {
-		g_auto(GStrv) package_lines = NULL;
-		item = PK_TRANSACTION_PAST (l->data);
-
-		/* ignore anything that failed */
-		if (!pk_transaction_past_get_succeeded (item))
-			continue;
+	PkEngineHistoryHelper *helper;
+
+	helper = g_new0 (PkEngineHistoryHelper, 1);
+	helper->engine = g_object_ref (engine);
+	helper->invocation = g_object_ref (invocation);
+	helper->cancellable = g_cancellable_new ();
+	helper->package_name = g_strdup (package_names[0]);
+	helper->watch_id =
+		g_bus_watch_name_on_connection (g_dbus_method_invocation_get_connection (invocation),
+						sender,
+						G_BUS_NAME_WATCHER_FLAGS_NONE,
+						NULL,
+						pk_engine_history_vanished_cb,
+						helper,
+						NULL);
+	pk_transaction_db_get_package_history_async (engine->priv->transaction_db,
+						     package_names,
+						     max_size,
+						     helper->cancellable,
+						     pk_engine_get_package_history_cb,
+						     helper);
+}
 
-		/* split up data */
-		data = pk_transaction_past_get_data (item);
-		if (data == NULL)
-			continue;
-		package_lines = g_strsplit (data, "\n", -1);
-		for (i = 0; package_lines[i] != NULL; i++) {
-			g_autoptr(GError) error_local = NULL;
-			ret = pk_package_parse (package_tmp,
-						package_lines[i],
-						&error_local);
-			if (!ret) {
-				g_warning ("Failed to parse package: '%s': %s",
-					   package_lines[i], error_local->message);
-				continue;
-			}
-
-			/* not the package we care about */
-			if (!pk_engine_package_name_in_strv (package_names, package_tmp))
-				continue;
-
-			/* not a state we care about */
-			if (!pk_engine_is_package_history_interesing (package_tmp))
-				continue;
-
-			/* transactions without a timestamp are not interesting */
-			timestamp = pk_transaction_past_get_timestamp (item);
-			if (timestamp == 0)
-				continue;
-
-			/* de-duplicate the entry, in the case of multiarch */
-			key = g_strdup_printf ("%s-%" G_GINT64_FORMAT,
-					       pk_package_get_name (package_tmp),
-					       timestamp);
-			if (g_hash_table_lookup (deduplicate_hash, key) != NULL) {
-				g_free (key);
-				continue;
-			}
-			g_hash_table_insert (deduplicate_hash, key, package_lines[i]);
-
-			/* get the blob for this data item */
-			value = pk_engine_get_package_history_pkg (item, package_tmp);
-			if (value == NULL)
-				continue;
-
-			/* find the array */
-			pkgname = pk_package_get_name (package_tmp);
-			array = g_hash_table_lookup (pkgname_hash, pkgname);
-			if (array == NULL) {
-				array = g_ptr_array_new ();
-				g_hash_table_insert (pkgname_hash,
-						     g_strdup (pkgname),
-						     array);
-			}
-			g_ptr_array_add (array, value);
+static void
+pk_engine_get_history_stats_cb (GObject *source,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	GVariant *tuple;
+	PkEngineHistoryHelper *helper = (PkEngineHistoryHelper *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = pk_transaction_db_get_history_stats_finish (helper->engine->priv->transaction_db,
+							    res, &error);
+	if (value == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_dbus_method_invocation_return_gerror (helper->invocation, error);
+			pk_engine_history_helper_free (helper);
+			return;
 		}
+		g_dbus_method_invocation_return_error (helper->invocation,
+						       PK_ENGINE_ERROR,
+						       PK_ENGINE_ERROR_NOT_SUPPORTED,
+						       "history stats failed: %s",
+						       error->message);
+		pk_engine_history_helper_free (helper);
+		return;
 	}
+	tuple = g_variant_new_tuple (&value, 1);
+	g_dbus_method_invocation_return_value (helper->invocation, tuple);
+	pk_engine_history_helper_free (helper);
+}
 
-	/* no history returns an empty array */
-	if (g_hash_table_size (pkgname_hash) == 0) {
-		value = g_variant_new_array (G_VARIANT_TYPE ("{saa{sv}}"), NULL, 0);
-		goto out;
-	}
-
-	/* we have a hash of pkgname:GPtrArray where the GPtrArray is an array
-	 * of GVariants of type a{sv} */
-	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	keys = g_hash_table_get_keys (pkgname_hash);
-	for (l = keys; l != NULL; l = l->next) {
-		pkgname = l->data;
-		array = g_hash_table_lookup (pkgname_hash, pkgname);
-		/* create aa{sv} */
-		value = g_variant_new_array (NULL,
-					     (GVariant * const *) array->pdata,
-					     MIN (array->len, max_size));
-		g_variant_builder_add (&builder, "{s@aa{sv}}", pkgname, value);
-	}
-	value = g_variant_builder_end (&builder);
-out:
-	g_list_free_full (list, (GDestroyNotify) g_object_unref);
-	return value;
+static void
+pk_engine_get_history_stats (PkEngine *engine,
+			     const gchar *sender,
+			     gchar **package_names,
+			     GDBusMethodInvocation *invocation)
+{
+	PkEngineHistoryHelper *helper;
+
+	helper = g_new0 (PkEngineHistoryHelper, 1);
+	helper->engine = g_object_ref (engine);
+	helper->invocation = g_object_ref (invocation);
+	helper->cancellable = g_cancellable_new ();
+	helper->watch_id =
+		g_bus_watch_name_on_connection (g_dbus_method_invocation_get_connection (invocation),
+						sender,
+						G_BUS_NAME_WATCHER_FLAGS_NONE,
+						NULL,
+						pk_engine_history_vanished_cb,
+						helper,
+						NULL);
+	pk_transaction_db_get_history_stats_async (engine->priv->transaction_db,
+						   package_names,
+						   helper->cancellable,
+						   pk_engine_get_history_stats_cb,
+						   helper);
 }
 
 static void
@@ -1278,7 +2894,6 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 	gboolean ret;
 	guint time_since;
 	GVariant *value = NULL;
-	GVariant *tuple = NULL;
 	PkAuthorizeEnum result_enum;
 	PkEngine *engine = PK_ENGINE (user_data);
 	PkRoleEnum role;
@@ -1293,6 +2908,7 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 
 	/* reset the timer */
 	pk_engine_reset_timer (engine);
+	pk_engine_mark_first_request (engine);
 
 	if (g_strcmp0 (method_name, "GetTimeSinceAction") == 0) {
 		g_variant_get (parameters, "(u)", &role);
@@ -1303,6 +2919,16 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "GetCachedUpdates") == 0) {
+		value = pk_engine_get_cached_updates (engine, &error);
+		if (value == NULL) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "GetDaemonState") == 0) {
 		data = pk_scheduler_get_state (engine->priv->scheduler);
 		value = g_variant_new ("(s)", data);
@@ -1321,24 +2947,28 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 							       "history for package name invalid");
 			return;
 		}
-		value = pk_engine_get_package_history (engine, package_names, size, &error);
-		if (value == NULL) {
-			g_dbus_method_invocation_return_error (invocation,
-							       PK_ENGINE_ERROR,
-							       PK_ENGINE_ERROR_NOT_SUPPORTED,
-							       "history for package name %s failed: %s",
-							       package_names[0],
-							       error->message);
-			return;
-		}
-		tuple = g_variant_new_tuple (&value, 1);
-		g_dbus_method_invocation_return_value (invocation, tuple);
+		pk_engine_get_package_history (engine, sender, package_names, size, invocation);
+		return;
+	}
+
+	if (g_strcmp0 (method_name, "GetHistoryStats") == 0) {
+		g_autofree gchar **package_names = NULL;
+
+		g_variant_get (parameters, "(^a&s)", &package_names);
+		pk_engine_get_history_stats (engine, sender, package_names, invocation);
 		return;
 	}
 
 	if (g_strcmp0 (method_name, "CreateTransaction") == 0) {
 
 		g_debug ("CreateTransaction method called");
+		if (engine->priv->cache_bundle_importing) {
+			g_dbus_method_invocation_return_error_literal (invocation,
+								       PK_ENGINE_ERROR,
+								       PK_ENGINE_ERROR_INVALID_STATE,
+								       "the caches are being imported");
+			return;
+		}
 		data = pk_transaction_db_generate_id (engine->priv->transaction_db);
 		g_assert (data != NULL);
 		ret = pk_scheduler_create (engine->priv->scheduler,
@@ -1359,6 +2989,35 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "CreateSearchSession") == 0) {
+		g_autofree gchar *token = NULL;
+		token = pk_search_sessions_create (engine->priv->search_sessions,
+						   connection_, sender, &error);
+		if (token == NULL) {
+			g_dbus_method_invocation_return_error (invocation,
+							       PK_ENGINE_ERROR,
+							       PK_ENGINE_ERROR_NOT_SUPPORTED,
+							       "could not create search session: %s",
+							       error->message);
+			return;
+		}
+		g_debug ("created search session %s for %s", token, sender);
+		value = g_variant_new ("(s)", token);
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
+	if (g_strcmp0 (method_name, "LeaseTransactions") == 0) {
+		g_variant_get (parameters, "(u)", &size);
+		value = pk_engine_lease_transactions (engine, sender, size, &error);
+		if (value == NULL) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		g_dbus_method_invocation_return_value (invocation, value);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "GetTransactionList") == 0) {
 		g_auto(GStrv) transaction_list = NULL;
 		transaction_list = pk_scheduler_get_array (engine->priv->scheduler);
@@ -1458,6 +3117,23 @@ pk_engine_daemon_method_call (GDBusConnection *connection_, const gchar *sender,
 		return;
 	}
 
+	if (g_strcmp0 (method_name, "SetBackgroundDownloadRate") == 0) {
+		guint64 rate;
+		g_variant_get (parameters, "(t)", &rate);
+		pk_engine_set_background_download_rate (engine, rate, invocation);
+		return;
+	}
+
+	if (g_strcmp0 (method_name, "ExportCache") == 0) {
+		pk_engine_cache_bundle (engine, FALSE, parameters, invocation);
+		return;
+	}
+
+	if (g_strcmp0 (method_name, "ImportCache") == 0) {
+		pk_engine_cache_bundle (engine, TRUE, parameters, invocation);
+		return;
+	}
+
 	if (g_strcmp0 (method_name, "CanAuthorize") == 0) {
 
 		g_variant_get (parameters, "(&s)", &tmp);
@@ -1604,8 +3280,13 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 
 	/* reset the timer */
 	pk_engine_reset_timer (engine);
+	pk_engine_mark_first_request (engine);
 
 	/* set up polkit */
+	if (!pk_engine_ensure_authority (engine, &error)) {
+		g_dbus_method_invocation_return_gerror (invocation, error);
+		return;
+	}
 	subject = polkit_system_bus_name_new (sender);
 
 	if (g_strcmp0 (method_name, "Cancel") == 0) {
@@ -1713,6 +3394,56 @@ pk_engine_offline_method_call (GDBusConnection *connection_, const gchar *sender
 	}
 }
 
+static GVariant *
+pk_engine_get_startup_metrics (PkEngine *engine)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&builder, "{sv}", "ready",
+			       g_variant_new_int64 (engine->priv->startup_ready));
+	g_variant_builder_add (&builder, "{sv}", "first-request",
+			       g_variant_new_int64 (engine->priv->startup_first_request));
+	g_variant_builder_add (&builder, "{sv}", "deferred",
+			       g_variant_new_int64 (engine->priv->startup_deferred));
+	return g_variant_builder_end (&builder);
+}
+
+static void
+pk_engine_metrics_method_call (GDBusConnection *connection_, const gchar *sender,
+			       const gchar *object_path, const gchar *interface_name,
+			       const gchar *method_name, GVariant *parameters,
+			       GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+
+	g_return_if_fail (PK_IS_ENGINE (engine));
+
+	if (g_strcmp0 (method_name, "GetMetrics") == 0) {
+		GVariantBuilder builder;
+		GVariantIter iter;
+		GVariant *value;
+		const gchar *key;
+		g_autoptr(GVariant) metrics = NULL;
+
+		/* the scheduler depth is only known here */
+		metrics = g_variant_ref_sink (pk_metrics_to_variant (engine->priv->metrics));
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+		g_variant_iter_init (&iter, metrics);
+		while (g_variant_iter_next (&iter, "{&sv}", &key, &value)) {
+			g_variant_builder_add (&builder, "{sv}", key, value);
+			g_variant_unref (value);
+		}
+		g_variant_builder_add (&builder, "{sv}", "scheduler",
+				       pk_scheduler_get_depth (engine->priv->scheduler));
+		g_variant_builder_add (&builder, "{sv}", "startup",
+				       pk_engine_get_startup_metrics (engine));
+		g_dbus_method_invocation_return_value (invocation,
+						       g_variant_new ("(a{sv})", &builder));
+		return;
+	}
+}
+
 #ifdef HAVE_SYSTEMD_SD_LOGIN_H
 static void
 pk_engine_proxy_logind_cb (GObject *source_object,
@@ -1745,6 +3476,11 @@ pk_engine_on_bus_acquired_cb (GDBusConnection *connection,
 		.get_property = pk_engine_offline_get_property,
 		.set_property = NULL
 	};
+	static const GDBusInterfaceVTable iface_metrics_vtable = {
+		.method_call = pk_engine_metrics_method_call,
+		.get_property = NULL,
+		.set_property = NULL
+	};
 
 	/* save copy for emitting signals */
 	engine->priv->connection = g_object_ref (connection);
@@ -1779,15 +3515,124 @@ pk_engine_on_bus_acquired_cb (GDBusConnection *connection,
 							     NULL,  /* user_data_free_func */
 							     NULL); /* GError** */
 	g_assert (registration_id > 0);
+	registration_id = g_dbus_connection_register_object (connection,
+							     PK_DBUS_PATH,
+							     engine->priv->introspection->interfaces[2],
+							     &iface_metrics_vtable,
+							     engine,  /* user_data */
+							     NULL,  /* user_data_free_func */
+							     NULL); /* GError** */
+	g_assert (registration_id > 0);
+}
+
+
+static void
+pk_engine_authority_get_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PolkitAuthority) authority = NULL;
+
+	authority = polkit_authority_get_finish (res, &error);
+	if (authority == NULL) {
+		g_debug ("failed to get polkit authority: %s", error->message);
+		goto out;
+	}
+
+	/* a request may have needed it first */
+	if (engine->priv->authority == NULL) {
+		engine->priv->authority = g_steal_pointer (&authority);
+		g_signal_connect (engine->priv->authority, "changed",
+				  G_CALLBACK (pk_engine_authority_changed_cb), engine);
+	}
+out:
+	g_object_unref (engine);
+}
+
+static void
+pk_engine_clear_stale_downloads (void)
+{
+	g_autofree gchar *filename = NULL;
+
+	filename = g_build_filename (LOCALSTATEDIR, "cache", "PackageKit", "downloads.stale", NULL);
+	if (!g_file_test (filename, G_FILE_TEST_IS_DIR))
+		return;
+	g_debug ("clearing download cache at %s", filename);
+	pk_directory_remove_contents (filename);
+	if (g_rmdir (filename) != 0)
+		g_warning ("failed to remove %s: %s", filename, g_strerror (errno));
 }
 
+/**
+ * pk_engine_deferred_init_cb:
+ *
+ * Sets up everything the first request does not need, once the requests
+ * that activated the daemon have been dispatched.
+ **/
+static gboolean
+pk_engine_deferred_init_cb (gpointer user_data)
+{
+	PkEngine *engine = PK_ENGINE (user_data);
+	gint64 start = g_get_monotonic_time ();
+	gint port;
+
+	engine->priv->deferred_init_id = 0;
+	pk_engine_setup_file_monitors (engine);
+	pk_engine_setup_transaction_db_retention (engine);
+	pk_engine_clear_stale_downloads ();
+	pk_peer_cache_prune ();
+
+	/* share what this host downloads with the others */
+	port = g_key_file_get_integer (engine->priv->conf, "Daemon", "PeerCachePort", NULL);
+	if (port > 0 && port <= G_MAXUINT16) {
+		g_autofree gchar *address = NULL;
+		g_auto(GStrv) hosts = NULL;
+		g_autoptr(GError) error = NULL;
+
+		address = g_key_file_get_string (engine->priv->conf, "Daemon", "PeerCacheAddress", NULL);
+		hosts = g_key_file_get_string_list (engine->priv->conf, "Daemon", "PeerCacheHosts", NULL, NULL);
+		engine->priv->peer_cache = pk_peer_cache_new ((guint) port, address, hosts);
+		if (!pk_peer_cache_start (engine->priv->peer_cache, &error)) {
+			g_warning ("failed to share packages on port %i: %s", port, error->message);
+			g_clear_object (&engine->priv->peer_cache);
+		}
+	}
+
+	/* let heavy clients skip the bus daemon */
+	if (g_key_file_get_boolean (engine->priv->conf, "Daemon", "PrivateBus", NULL)) {
+		g_autoptr(GError) error = NULL;
+		engine->priv->peer_bus = pk_peer_bus_new (engine->priv->scheduler,
+							  engine->priv->introspection->interfaces[3]);
+		if (!pk_peer_bus_start (engine->priv->peer_bus, &error)) {
+			g_warning ("failed to accept private connections: %s", error->message);
+			g_clear_object (&engine->priv->peer_bus);
+		}
+	}
+	if (engine->priv->authority == NULL)
+		polkit_authority_get_async (NULL, pk_engine_authority_get_cb, g_object_ref (engine));
+
+	engine->priv->startup_deferred = g_get_monotonic_time () - start;
+	g_debug ("deferred init took %" G_GINT64_FORMAT "us", engine->priv->startup_deferred);
+	return G_SOURCE_REMOVE;
+}
 
 static void
 pk_engine_on_name_acquired_cb (GDBusConnection *connection_,
 			       const gchar *name,
 			       gpointer user_data)
 {
+	PkEngine *engine = PK_ENGINE (user_data);
+
 	g_debug ("PkEngine: acquired name: %s", name);
+
+	/* queued behind the messages sent to the activatable name */
+	if (engine->priv->deferred_init_id != 0)
+		return;
+	engine->priv->deferred_init_id = g_idle_add_full (G_PRIORITY_LOW,
+							  pk_engine_deferred_init_cb,
+							  engine, NULL);
+	g_source_set_name_by_id (engine->priv->deferred_init_id,
+				 "[PkEngine] deferred-init");
 }
 
 
@@ -1808,6 +3653,7 @@ pk_engine_init (PkEngine *engine)
 	g_autofree gchar *filename = NULL;
 
 	engine->priv = PK_ENGINE_GET_PRIVATE (engine);
+	engine->priv->startup_time = g_get_monotonic_time ();
 
 	/* load introspection */
 	engine->priv->introspection = pk_load_introspection (PK_DBUS_INTERFACE ".xml",
@@ -1817,11 +3663,16 @@ pk_engine_init (PkEngine *engine)
 			 error->message);
 	}
 
-	/* clear the download cache */
+	/* clear the download cache, moving it aside so the files can be
+	 * removed once the first requests have been answered */
 	filename = g_build_filename (LOCALSTATEDIR, "cache", "PackageKit", "downloads", NULL);
 	if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
-		g_debug ("clearing download cache at %s", filename);
-		pk_directory_remove_contents (filename);
+		g_autofree gchar *stale = g_strconcat (filename, ".stale", NULL);
+		if (g_file_test (stale, G_FILE_TEST_EXISTS) ||
+		    g_rename (filename, stale) != 0) {
+			g_debug ("clearing download cache at %s", filename);
+			pk_directory_remove_contents (filename);
+		}
 	}
 
 	/* proxy the network state */
@@ -1829,9 +3680,7 @@ pk_engine_init (PkEngine *engine)
 	g_signal_connect (engine->priv->network_monitor, "network-changed",
 			  G_CALLBACK (pk_engine_network_state_changed_cb), engine);
 	engine->priv->network_state = pk_engine_get_network_state (engine->priv->network_monitor);
-
-	/* try to get the distro id */
-	engine->priv->distro_id = pk_get_distro_id ();
+	engine->priv->prefetched = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
 	engine->priv->timer = g_timer_new ();
 
@@ -1842,9 +3691,6 @@ pk_engine_init (PkEngine *engine)
 	engine->priv->timeout_priority_id = 0;
 	engine->priv->timeout_normal_id = 0;
 
-	/* setup file watches */
-	pk_engine_setup_file_monitors (engine);
-
 	/* we use a trasaction db to store old transactions */
 	engine->priv->transaction_db = pk_transaction_db_new ();
 
@@ -1881,6 +3727,38 @@ pk_engine_finalize (GObject *object)
 		g_source_remove (engine->priv->timeout_normal_id);
 		engine->priv->timeout_normal_id = 0;
 	}
+	if (engine->priv->transaction_db_maintenance_id != 0)
+		g_source_remove (engine->priv->transaction_db_maintenance_id);
+	if (engine->priv->transaction_db_step_id != 0)
+		g_source_remove (engine->priv->transaction_db_step_id);
+	if (engine->priv->deferred_init_id != 0)
+		g_source_remove (engine->priv->deferred_init_id);
+	if (engine->priv->prewarm_id != 0)
+		g_source_remove (engine->priv->prewarm_id);
+	g_clear_object (&engine->priv->prewarm_job);
+	if (engine->priv->command_index_id != 0)
+		g_source_remove (engine->priv->command_index_id);
+	g_clear_object (&engine->priv->command_index_job);
+	g_clear_pointer (&engine->priv->command_index_commands, g_hash_table_unref);
+	if (engine->priv->name_list_id != 0)
+		g_source_remove (engine->priv->name_list_id);
+	g_clear_object (&engine->priv->name_list_job);
+	g_clear_pointer (&engine->priv->name_list_names, g_hash_table_unref);
+	if (engine->priv->updates_delta_id != 0)
+		g_source_remove (engine->priv->updates_delta_id);
+	g_clear_object (&engine->priv->updates_delta_job);
+	g_clear_object (&engine->priv->updates_delta_results);
+	g_clear_pointer (&engine->priv->updates_known, g_hash_table_unref);
+	if (engine->priv->repo_list_delta_id != 0)
+		g_source_remove (engine->priv->repo_list_delta_id);
+	g_clear_object (&engine->priv->repo_list_delta_job);
+	if (engine->priv->prefetch_id != 0)
+		g_source_remove (engine->priv->prefetch_id);
+	g_clear_object (&engine->priv->prefetch_job);
+	g_strfreev (engine->priv->prefetch_ids);
+	g_hash_table_unref (engine->priv->prefetched);
+	g_clear_pointer (&engine->priv->repo_list_delta_repos, g_hash_table_unref);
+	g_clear_pointer (&engine->priv->repo_list_known, g_hash_table_unref);
 
 	/* unlock if we locked this */
 	if (!pk_backend_unload (engine->priv->backend))
@@ -1905,23 +3783,53 @@ pk_engine_finalize (GObject *object)
 
 	/* compulsory gobjects */
 	g_timer_destroy (engine->priv->timer);
-	g_object_unref (engine->priv->monitor_conf);
-	g_object_unref (engine->priv->monitor_binary);
-	g_object_unref (engine->priv->monitor_offline);
-	g_object_unref (engine->priv->monitor_offline_upgrade);
+	g_clear_object (&engine->priv->monitor_conf);
+	g_clear_object (&engine->priv->monitor_binary);
+	g_clear_object (&engine->priv->monitor_offline);
+	g_clear_object (&engine->priv->monitor_offline_upgrade);
 	g_object_unref (engine->priv->scheduler);
 	g_object_unref (engine->priv->transaction_db);
-	if (engine->priv->authority != NULL)
+	if (engine->priv->authority != NULL) {
+		g_signal_handlers_disconnect_by_data (engine->priv->authority, engine);
 		g_object_unref (engine->priv->authority);
+	}
 	g_object_unref (engine->priv->backend);
+	g_object_unref (engine->priv->query_cache);
+	g_object_unref (engine->priv->plan_cache);
+	g_object_unref (engine->priv->search_sessions);
+	g_object_unref (engine->priv->auth_cache);
+	g_object_unref (engine->priv->metrics);
+	g_clear_object (&engine->priv->peer_cache);
+	g_clear_object (&engine->priv->peer_bus);
 	g_key_file_unref (engine->priv->conf);
 	g_object_unref (engine->priv->dbus);
 	g_strfreev (engine->priv->mime_types);
 	g_free (engine->priv->distro_id);
+	g_free (engine->priv->conf_checksum);
 
 	G_OBJECT_CLASS (pk_engine_parent_class)->finalize (object);
 }
 
+static guint
+pk_engine_get_auth_cache_timeout (GKeyFile *conf)
+{
+	gint timeout;
+	if (!g_key_file_has_key (conf, "Daemon", "AuthorizationCacheTimeout", NULL))
+		return PK_ENGINE_AUTH_CACHE_TIMEOUT_DEFAULT;
+	timeout = g_key_file_get_integer (conf, "Daemon", "AuthorizationCacheTimeout", NULL);
+	return MAX (timeout, 0);
+}
+
+static guint
+pk_engine_get_plan_cache_timeout (GKeyFile *conf)
+{
+	gint timeout;
+	if (!g_key_file_has_key (conf, "Daemon", "SimulationPlanTimeout", NULL))
+		return PK_ENGINE_PLAN_CACHE_TIMEOUT_DEFAULT;
+	timeout = g_key_file_get_integer (conf, "Daemon", "SimulationPlanTimeout", NULL);
+	return MAX (timeout, 0);
+}
+
 PkEngine *
 pk_engine_new (GKeyFile *conf)
 {
@@ -1929,15 +3837,40 @@ pk_engine_new (GKeyFile *conf)
 	engine = g_object_new (PK_TYPE_ENGINE, NULL);
 	engine->priv->conf = g_key_file_ref (conf);
 	engine->priv->backend = pk_backend_new (engine->priv->conf);
+	engine->priv->query_cache = pk_query_cache_new ();
+	g_signal_connect (engine->priv->query_cache, "updates-changed",
+			  G_CALLBACK (pk_engine_query_cache_updates_changed_cb), engine);
+	engine->priv->plan_cache = pk_plan_cache_new (pk_engine_get_plan_cache_timeout (conf));
+	engine->priv->auth_cache = pk_auth_cache_new (pk_engine_get_auth_cache_timeout (conf));
+	engine->priv->search_sessions = pk_search_sessions_new ();
+	engine->priv->metrics = pk_metrics_new ();
+	g_signal_connect (engine->priv->backend, "installed-changed",
+			  G_CALLBACK (pk_engine_backend_installed_changed_cb), engine);
 	g_signal_connect (engine->priv->backend, "repo-list-changed",
 			  G_CALLBACK (pk_engine_backend_repo_list_changed_cb), engine);
 	g_signal_connect (engine->priv->backend, "updates-changed",
 			  G_CALLBACK (pk_engine_backend_updates_changed_cb), engine);
+	g_signal_connect (engine->priv->backend, "epoch-changed",
+			  G_CALLBACK (pk_engine_backend_epoch_changed_cb), engine);
 	engine->priv->scheduler = pk_scheduler_new (engine->priv->conf);
 	pk_scheduler_set_backend (engine->priv->scheduler,
 				  engine->priv->backend);
+	pk_scheduler_set_query_cache (engine->priv->scheduler,
+				      engine->priv->query_cache);
+	pk_scheduler_set_plan_cache (engine->priv->scheduler,
+				     engine->priv->plan_cache);
+	pk_scheduler_set_search_sessions (engine->priv->scheduler,
+					  engine->priv->search_sessions);
+	pk_scheduler_set_auth_cache (engine->priv->scheduler,
+				     engine->priv->auth_cache);
+	pk_scheduler_set_metrics (engine->priv->scheduler,
+				  engine->priv->metrics);
 	g_signal_connect (engine->priv->scheduler, "changed",
 			  G_CALLBACK (pk_engine_scheduler_changed_cb), engine);
+	g_signal_connect (engine->priv->scheduler, "transaction-added",
+			  G_CALLBACK (pk_engine_scheduler_transaction_added_cb), engine);
+	g_signal_connect (engine->priv->scheduler, "transaction-removed",
+			  G_CALLBACK (pk_engine_scheduler_transaction_removed_cb), engine);
 	return PK_ENGINE (engine);
 }
 
@@ -77,5 +77,7 @@ PkEngine	*pk_engine_new				(GKeyFile		*conf);
 guint		 pk_engine_get_seconds_idle		(PkEngine	*engine);
 gboolean	 pk_engine_load_backend			(PkEngine	*engine,
 							 GError		**error);
+void		 pk_engine_save_warm_state		(PkEngine	*engine);
+gboolean	 pk_engine_get_restart_in_place		(PkEngine	*engine);
 
 #endif /* __PK_ENGINE_H */
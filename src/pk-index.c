@@ -0,0 +1,809 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "pk-index.h"
+
+static void     pk_index_finalize	(GObject        *object);
+
+#define PK_INDEX_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_INDEX, PkIndexPrivate))
+
+/*
+ * The file is one read-only mapping, written in native byte order and made
+ * only of guint32 arrays so that it can be used without parsing:
+ *
+ *  header
+ *  records	string offset of each package-id, in the order added
+ *  entries	(kind, key, record), sorted by kind and key
+ *  buckets	n_buckets + 1 offsets into chain
+ *  chain	file entries, grouped by the hash of their basename
+ *  trigrams	(trigram, offset into postings), sorted, plus a sentinel
+ *  postings	entry indexes, ascending for each trigram
+ *  strings	NUL-terminated, deduplicated, offset 0 is ""
+ *
+ * Every offset is checked against the mapping when it is used, so a
+ * damaged file gives wrong answers at worst, never a crash.
+ */
+#define PK_INDEX_MAGIC			"PKINDEX"
+#define PK_INDEX_FORMAT_VERSION		1
+#define PK_INDEX_BYTE_ORDER		0x01020304
+
+typedef struct {
+	gchar		 magic[8];
+	guint32		 version;
+	guint32		 byte_order;
+	guint32		 file_size;
+	guint32		 stamp;
+	guint32		 kinds[PK_INDEX_KIND_LAST + 1];	/* first entry of each kind */
+	guint32		 n_records;
+	guint32		 records;
+	guint32		 n_entries;
+	guint32		 entries;
+	guint32		 n_buckets;
+	guint32		 buckets;
+	guint32		 n_chain;
+	guint32		 chain;
+	guint32		 n_trigrams;
+	guint32		 trigrams;
+	guint32		 n_postings;
+	guint32		 postings;
+	guint32		 strings_size;
+	guint32		 strings;
+} PkIndexHeader;
+
+typedef struct {
+	guint32		 kind;
+	guint32		 key;
+	guint32		 record;
+} PkIndexEntry;
+
+typedef struct {
+	guint32		 trigram;
+	guint32		 postings;
+} PkIndexTrigram;
+
+struct PkIndexBuilder
+{
+	GString		*strings;
+	GHashTable	*string_offsets;
+	GArray		*records;
+	GArray		*entries;
+};
+
+struct PkIndexPrivate
+{
+	GMappedFile		*file;
+	const PkIndexHeader	*header;
+	const guint32		*records;
+	const PkIndexEntry	*entries;
+	const guint32		*buckets;
+	const guint32		*chain;
+	const PkIndexTrigram	*trigrams;
+	const guint32		*postings;
+	const gchar		*strings;
+};
+
+G_DEFINE_TYPE (PkIndex, pk_index, G_TYPE_OBJECT)
+
+static const gchar *
+pk_index_basename (const gchar *path)
+{
+	const gchar *sep = strrchr (path, '/');
+	return sep != NULL ? sep + 1 : path;
+}
+
+/* trigrams are case-insensitive and per kind, so one table serves all */
+static guint32
+pk_index_trigram (PkIndexKind kind, const gchar *str)
+{
+	return ((guint32) kind << 24) |
+	       ((guint32) (guint8) g_ascii_tolower (str[0]) << 16) |
+	       ((guint32) (guint8) g_ascii_tolower (str[1]) << 8) |
+	       (guint32) (guint8) g_ascii_tolower (str[2]);
+}
+
+static gboolean
+pk_index_contains (const gchar *haystack, const gchar *needle, gsize needle_len)
+{
+	gsize len = strlen (haystack);
+	gsize i;
+
+	for (i = 0; i + needle_len <= len; i++) {
+		if (g_ascii_strncasecmp (haystack + i, needle, needle_len) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * pk_index_builder_new:
+ *
+ * Collects the packages of a backend so they can be written out with
+ * pk_index_builder_write(). Most backends want pk_index_rebuild().
+ **/
+PkIndexBuilder *
+pk_index_builder_new (void)
+{
+	PkIndexBuilder *builder = g_new0 (PkIndexBuilder, 1);
+	builder->strings = g_string_sized_new (4096);
+	builder->string_offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	builder->records = g_array_new (FALSE, FALSE, sizeof (guint32));
+	builder->entries = g_array_new (FALSE, FALSE, sizeof (PkIndexEntry));
+
+	/* offset 0 is the empty string */
+	g_string_append_c (builder->strings, '\0');
+	g_hash_table_insert (builder->string_offsets, g_strdup (""), GUINT_TO_POINTER (0));
+	return builder;
+}
+
+/**
+ * pk_index_builder_free:
+ **/
+void
+pk_index_builder_free (PkIndexBuilder *builder)
+{
+	if (builder == NULL)
+		return;
+	g_string_free (builder->strings, TRUE);
+	g_hash_table_unref (builder->string_offsets);
+	g_array_unref (builder->records);
+	g_array_unref (builder->entries);
+	g_free (builder);
+}
+
+static guint32
+pk_index_builder_intern (PkIndexBuilder *builder, const gchar *str)
+{
+	gpointer value;
+	guint32 offset;
+
+	if (g_hash_table_lookup_extended (builder->string_offsets, str, NULL, &value))
+		return GPOINTER_TO_UINT (value);
+
+	offset = builder->strings->len;
+	g_string_append_len (builder->strings, str, strlen (str) + 1);
+	g_hash_table_insert (builder->string_offsets, g_strdup (str), GUINT_TO_POINTER (offset));
+	return offset;
+}
+
+/**
+ * pk_index_builder_add_record:
+ *
+ * Adds a package. Lookups return package-ids in the order they were added.
+ *
+ * Return value: the record to pass to pk_index_builder_add_key()
+ **/
+guint
+pk_index_builder_add_record (PkIndexBuilder *builder, const gchar *package_id)
+{
+	guint32 offset;
+
+	g_return_val_if_fail (builder != NULL, G_MAXUINT);
+	g_return_val_if_fail (package_id != NULL, G_MAXUINT);
+
+	offset = pk_index_builder_intern (builder, package_id);
+	g_array_append_val (builder->records, offset);
+	return builder->records->len - 1;
+}
+
+/**
+ * pk_index_builder_add_key:
+ * @key: a name, an absolute path or a provide
+ *
+ * Makes @record found when looking up @key as @kind.
+ **/
+void
+pk_index_builder_add_key (PkIndexBuilder *builder,
+			  guint record,
+			  PkIndexKind kind,
+			  const gchar *key)
+{
+	PkIndexEntry entry;
+
+	g_return_if_fail (builder != NULL);
+	g_return_if_fail (record < builder->records->len);
+	g_return_if_fail (kind < PK_INDEX_KIND_LAST);
+	g_return_if_fail (key != NULL);
+
+	entry.kind = kind;
+	entry.key = pk_index_builder_intern (builder, key);
+	entry.record = record;
+	g_array_append_val (builder->entries, entry);
+}
+
+static gint
+pk_index_builder_entry_cmp (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const PkIndexEntry *entry_a = a;
+	const PkIndexEntry *entry_b = b;
+	const gchar *strings = user_data;
+	gint rc;
+
+	if (entry_a->kind != entry_b->kind)
+		return entry_a->kind < entry_b->kind ? -1 : 1;
+	rc = strcmp (strings + entry_a->key, strings + entry_b->key);
+	if (rc != 0)
+		return rc;
+	if (entry_a->record != entry_b->record)
+		return entry_a->record < entry_b->record ? -1 : 1;
+	return 0;
+}
+
+static gint
+pk_index_builder_trigram_cmp (gconstpointer a, gconstpointer b)
+{
+	guint32 trigram_a = GPOINTER_TO_UINT (*(gconstpointer *) a);
+	guint32 trigram_b = GPOINTER_TO_UINT (*(gconstpointer *) b);
+
+	if (trigram_a == trigram_b)
+		return 0;
+	return trigram_a < trigram_b ? -1 : 1;
+}
+
+static guint32
+pk_index_builder_append (GByteArray *data, gconstpointer buf, gsize len)
+{
+	guint32 offset = data->len;
+	g_byte_array_append (data, buf, len);
+	return offset;
+}
+
+/**
+ * pk_index_builder_write:
+ * @stamp: describes the package database the records were read from, and
+ *	   has to match in pk_index_new_from_file()
+ *
+ * Writes the index. The new file replaces @filename atomically, so
+ * processes which have the previous index mapped keep their copy.
+ **/
+gboolean
+pk_index_builder_write (PkIndexBuilder *builder,
+			const gchar *filename,
+			const gchar *stamp,
+			GError **error)
+{
+	PkIndexHeader header;
+	PkIndexEntry *entries;
+	PkIndexTrigram sentinel;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	guint i;
+	guint j;
+	guint n_entries = 0;
+	guint n_files;
+	guint32 *buckets;
+	guint32 *chain;
+	guint64 size;
+	g_autofree gchar *dirname = NULL;
+	g_autoptr(GArray) postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+	g_autoptr(GArray) trigrams = g_array_new (FALSE, FALSE, sizeof (PkIndexTrigram));
+	g_autoptr(GByteArray) data = NULL;
+	g_autoptr(GHashTable) trigram_hash = NULL;
+	g_autoptr(GPtrArray) trigram_keys = NULL;
+
+	g_return_val_if_fail (builder != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (stamp != NULL, FALSE);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, PK_INDEX_MAGIC, sizeof (PK_INDEX_MAGIC));
+	header.version = PK_INDEX_FORMAT_VERSION;
+	header.byte_order = PK_INDEX_BYTE_ORDER;
+	header.stamp = pk_index_builder_intern (builder, stamp);
+
+	/* sort and drop duplicates */
+	g_array_sort_with_data (builder->entries, pk_index_builder_entry_cmp,
+				builder->strings->str);
+	entries = (PkIndexEntry *) builder->entries->data;
+	for (i = 0; i < builder->entries->len; i++) {
+		if (n_entries > 0 &&
+		    pk_index_builder_entry_cmp (&entries[n_entries - 1], &entries[i],
+						builder->strings->str) == 0)
+			continue;
+		entries[n_entries++] = entries[i];
+	}
+	g_array_set_size (builder->entries, n_entries);
+
+	for (i = 0, j = 0; i <= PK_INDEX_KIND_LAST; i++) {
+		while (j < n_entries && entries[j].kind < i)
+			j++;
+		header.kinds[i] = j;
+	}
+
+	/* files are looked up by basename far more often than by path */
+	n_files = header.kinds[PK_INDEX_KIND_FILE + 1] - header.kinds[PK_INDEX_KIND_FILE];
+	header.n_buckets = MAX (n_files / 2, 1);
+	header.n_chain = n_files;
+	buckets = g_new0 (guint32, header.n_buckets + 1);
+	chain = g_new0 (guint32, MAX (n_files, 1));
+	for (i = header.kinds[PK_INDEX_KIND_FILE]; i < header.kinds[PK_INDEX_KIND_FILE + 1]; i++) {
+		const gchar *basename = pk_index_basename (builder->strings->str + entries[i].key);
+		buckets[g_str_hash (basename) % header.n_buckets + 1]++;
+	}
+	for (i = 0; i < header.n_buckets; i++)
+		buckets[i + 1] += buckets[i];
+	for (i = header.kinds[PK_INDEX_KIND_FILE]; i < header.kinds[PK_INDEX_KIND_FILE + 1]; i++) {
+		const gchar *basename = pk_index_basename (builder->strings->str + entries[i].key);
+		guint bucket = g_str_hash (basename) % header.n_buckets;
+		chain[buckets[bucket]++] = i;
+	}
+	/* the fill moved every start along by one bucket */
+	for (i = header.n_buckets; i > 0; i--)
+		buckets[i] = buckets[i - 1];
+	buckets[0] = 0;
+
+	/* substring search over everything but the paths */
+	trigram_hash = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					      NULL, (GDestroyNotify) g_array_unref);
+	for (i = 0; i < n_entries; i++) {
+		const gchar *str = builder->strings->str + entries[i].key;
+		gsize len = strlen (str);
+		gsize k;
+
+		if (entries[i].kind == PK_INDEX_KIND_FILE)
+			continue;
+		for (k = 0; k + 3 <= len; k++) {
+			guint32 trigram = pk_index_trigram (entries[i].kind, str + k);
+			GArray *list = g_hash_table_lookup (trigram_hash, GUINT_TO_POINTER (trigram));
+			if (list == NULL) {
+				list = g_array_new (FALSE, FALSE, sizeof (guint32));
+				g_hash_table_insert (trigram_hash, GUINT_TO_POINTER (trigram), list);
+			}
+			if (list->len > 0 && g_array_index (list, guint32, list->len - 1) == i)
+				continue;
+			g_array_append_val (list, i);
+		}
+	}
+	trigram_keys = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, trigram_hash);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_ptr_array_add (trigram_keys, key);
+	g_ptr_array_sort (trigram_keys, pk_index_builder_trigram_cmp);
+	for (i = 0; i < trigram_keys->len; i++) {
+		PkIndexTrigram item;
+		GArray *list = g_hash_table_lookup (trigram_hash, g_ptr_array_index (trigram_keys, i));
+
+		item.trigram = GPOINTER_TO_UINT (g_ptr_array_index (trigram_keys, i));
+		item.postings = postings->len;
+		g_array_append_val (trigrams, item);
+		g_array_append_vals (postings, list->data, list->len);
+	}
+	header.n_trigrams = trigrams->len;
+	header.n_postings = postings->len;
+	sentinel.trigram = G_MAXUINT32;
+	sentinel.postings = postings->len;
+	g_array_append_val (trigrams, sentinel);
+
+	/* the offsets are 32 bit */
+	header.n_records = builder->records->len;
+	header.n_entries = n_entries;
+	header.strings_size = builder->strings->len;
+	size = sizeof (header) +
+	       (guint64) header.n_records * sizeof (guint32) +
+	       (guint64) n_entries * sizeof (PkIndexEntry) +
+	       (guint64) (header.n_buckets + 1 + n_files) * sizeof (guint32) +
+	       (guint64) trigrams->len * sizeof (PkIndexTrigram) +
+	       (guint64) postings->len * sizeof (guint32) +
+	       builder->strings->len;
+	if (size > G_MAXUINT32) {
+		g_free (buckets);
+		g_free (chain);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+			     "%s would be too large", filename);
+		return FALSE;
+	}
+
+	/* lay out the file */
+	data = g_byte_array_sized_new (size);
+	pk_index_builder_append (data, &header, sizeof (header));
+	header.records = pk_index_builder_append (data, builder->records->data,
+						  builder->records->len * sizeof (guint32));
+	header.entries = pk_index_builder_append (data, builder->entries->data,
+						  n_entries * sizeof (PkIndexEntry));
+	header.buckets = pk_index_builder_append (data, buckets,
+						  (header.n_buckets + 1) * sizeof (guint32));
+	header.chain = pk_index_builder_append (data, chain, n_files * sizeof (guint32));
+	header.trigrams = pk_index_builder_append (data, trigrams->data,
+						   trigrams->len * sizeof (PkIndexTrigram));
+	header.postings = pk_index_builder_append (data, postings->data,
+						   postings->len * sizeof (guint32));
+	header.strings = pk_index_builder_append (data, builder->strings->str,
+						  builder->strings->len);
+	g_free (buckets);
+	g_free (chain);
+	header.file_size = data->len;
+	memcpy (data->data, &header, sizeof (header));
+
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", dirname, g_strerror (errno));
+		return FALSE;
+	}
+	return g_file_set_contents (filename, (const gchar *) data->data,
+				    (gssize) data->len, error);
+}
+
+/**
+ * pk_index_rebuild:
+ * @func: adds every package of the backend to the builder
+ *
+ * Builds a new index from the records @func feeds in and swaps it in for
+ * @filename. On failure the previous index is left in place.
+ **/
+gboolean
+pk_index_rebuild (const gchar *filename,
+		  const gchar *stamp,
+		  PkIndexFeedFunc func,
+		  gpointer user_data,
+		  GError **error)
+{
+	g_autoptr(PkIndexBuilder) builder = pk_index_builder_new ();
+
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	if (!func (builder, user_data, error))
+		return FALSE;
+	return pk_index_builder_write (builder, filename, stamp, error);
+}
+
+static gboolean
+pk_index_section_valid (const PkIndexHeader *header, guint32 offset, guint32 n_items, gsize size)
+{
+	if (offset % sizeof (guint32) != 0 || offset > header->file_size)
+		return FALSE;
+	return (guint64) n_items * size <= header->file_size - offset;
+}
+
+static const gchar *
+pk_index_get_string (PkIndex *index, guint32 offset)
+{
+	if (offset >= index->priv->header->strings_size)
+		return "";
+	return index->priv->strings + offset;
+}
+
+/**
+ * pk_index_new_from_file:
+ * @stamp: the current state of the package database
+ *
+ * Maps an index written by pk_index_builder_write(), as long as it was
+ * built from the package database described by @stamp.
+ *
+ * Return value: the index, or %NULL if it is missing, damaged or stale
+ **/
+PkIndex *
+pk_index_new_from_file (const gchar *filename, const gchar *stamp, GError **error)
+{
+	const PkIndexHeader *header;
+	const gchar *contents;
+	gsize length;
+	guint i;
+	g_autoptr(GMappedFile) file = NULL;
+	g_autoptr(PkIndex) index = NULL;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+	g_return_val_if_fail (stamp != NULL, NULL);
+
+	file = g_mapped_file_new (filename, FALSE, error);
+	if (file == NULL)
+		return NULL;
+	contents = g_mapped_file_get_contents (file);
+	length = g_mapped_file_get_length (file);
+
+	/* the file may be truncated or from another daemon */
+	header = (const PkIndexHeader *) contents;
+	if (length < sizeof (PkIndexHeader) ||
+	    memcmp (header->magic, PK_INDEX_MAGIC, sizeof (PK_INDEX_MAGIC)) != 0 ||
+	    header->version != PK_INDEX_FORMAT_VERSION ||
+	    header->byte_order != PK_INDEX_BYTE_ORDER ||
+	    header->file_size != length ||
+	    header->n_buckets == 0 ||
+	    !pk_index_section_valid (header, header->records, header->n_records, sizeof (guint32)) ||
+	    !pk_index_section_valid (header, header->entries, header->n_entries, sizeof (PkIndexEntry)) ||
+	    !pk_index_section_valid (header, header->buckets, header->n_buckets + 1, sizeof (guint32)) ||
+	    !pk_index_section_valid (header, header->chain, header->n_chain, sizeof (guint32)) ||
+	    !pk_index_section_valid (header, header->trigrams, header->n_trigrams + 1, sizeof (PkIndexTrigram)) ||
+	    !pk_index_section_valid (header, header->postings, header->n_postings, sizeof (guint32)) ||
+	    header->strings > header->file_size ||
+	    header->strings_size == 0 ||
+	    header->strings_size > header->file_size - header->strings ||
+	    contents[header->strings + header->strings_size - 1] != '\0') {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is not valid", filename);
+		return NULL;
+	}
+	for (i = 0; i < PK_INDEX_KIND_LAST; i++) {
+		if (header->kinds[i] > header->kinds[i + 1] ||
+		    header->kinds[i + 1] > header->n_entries) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "%s is not valid", filename);
+			return NULL;
+		}
+	}
+
+	index = g_object_new (PK_TYPE_INDEX, NULL);
+	index->priv->header = header;
+	index->priv->records = (const guint32 *) (contents + header->records);
+	index->priv->entries = (const PkIndexEntry *) (contents + header->entries);
+	index->priv->buckets = (const guint32 *) (contents + header->buckets);
+	index->priv->chain = (const guint32 *) (contents + header->chain);
+	index->priv->trigrams = (const PkIndexTrigram *) (contents + header->trigrams);
+	index->priv->postings = (const guint32 *) (contents + header->postings);
+	index->priv->strings = contents + header->strings;
+	if (g_strcmp0 (pk_index_get_string (index, header->stamp), stamp) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is out of date", filename);
+		return NULL;
+	}
+	index->priv->file = g_steal_pointer (&file);
+	return g_steal_pointer (&index);
+}
+
+/**
+ * pk_index_get_n_records:
+ **/
+guint
+pk_index_get_n_records (PkIndex *index)
+{
+	g_return_val_if_fail (PK_IS_INDEX (index), 0);
+	return index->priv->header->n_records;
+}
+
+static void
+pk_index_collect (PkIndex *index, GArray *records, guint32 entry)
+{
+	guint32 record;
+
+	if (entry >= index->priv->header->n_entries)
+		return;
+	record = index->priv->entries[entry].record;
+	if (record >= index->priv->header->n_records)
+		return;
+	g_array_append_val (records, record);
+}
+
+static gint
+pk_index_record_cmp (gconstpointer a, gconstpointer b)
+{
+	guint32 record_a = *(const guint32 *) a;
+	guint32 record_b = *(const guint32 *) b;
+
+	if (record_a == record_b)
+		return 0;
+	return record_a < record_b ? -1 : 1;
+}
+
+/* package-ids of @records, in the order they were added and only once */
+static GPtrArray *
+pk_index_records_to_package_ids (PkIndex *index, GArray *records)
+{
+	GPtrArray *package_ids = g_ptr_array_new_with_free_func (g_free);
+	guint i;
+
+	g_array_sort (records, pk_index_record_cmp);
+	for (i = 0; i < records->len; i++) {
+		guint32 record = g_array_index (records, guint32, i);
+		if (i > 0 && g_array_index (records, guint32, i - 1) == record)
+			continue;
+		g_ptr_array_add (package_ids,
+				 g_strdup (pk_index_get_string (index, index->priv->records[record])));
+	}
+	return package_ids;
+}
+
+/**
+ * pk_index_lookup:
+ * @key: the exact name, absolute path or provide
+ *
+ * Return value: (transfer container): the package-ids with @key
+ **/
+GPtrArray *
+pk_index_lookup (PkIndex *index, PkIndexKind kind, const gchar *key)
+{
+	const PkIndexHeader *header;
+	guint32 lower;
+	guint32 upper;
+	g_autoptr(GArray) records = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	g_return_val_if_fail (PK_IS_INDEX (index), NULL);
+	g_return_val_if_fail (kind < PK_INDEX_KIND_LAST, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	/* the first entry of the kind which is not less than key */
+	header = index->priv->header;
+	lower = header->kinds[kind];
+	upper = header->kinds[kind + 1];
+	while (lower < upper) {
+		guint32 middle = lower + (upper - lower) / 2;
+		const gchar *str = pk_index_get_string (index, index->priv->entries[middle].key);
+		if (strcmp (str, key) < 0)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	for (; lower < header->kinds[kind + 1]; lower++) {
+		const gchar *str = pk_index_get_string (index, index->priv->entries[lower].key);
+		if (strcmp (str, key) != 0)
+			break;
+		pk_index_collect (index, records, lower);
+	}
+	return pk_index_records_to_package_ids (index, records);
+}
+
+/**
+ * pk_index_lookup_basename:
+ * @basename: a file name without the directory
+ *
+ * Return value: (transfer container): the package-ids which own a file
+ *	called @basename in any directory
+ **/
+GPtrArray *
+pk_index_lookup_basename (PkIndex *index, const gchar *basename)
+{
+	const PkIndexHeader *header;
+	guint bucket;
+	guint32 i;
+	guint32 end;
+	g_autoptr(GArray) records = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	g_return_val_if_fail (PK_IS_INDEX (index), NULL);
+	g_return_val_if_fail (basename != NULL, NULL);
+
+	header = index->priv->header;
+	bucket = g_str_hash (basename) % header->n_buckets;
+	end = MIN (index->priv->buckets[bucket + 1], header->n_chain);
+	for (i = index->priv->buckets[bucket]; i < end; i++) {
+		guint32 entry = index->priv->chain[i];
+		const gchar *path;
+
+		if (entry >= header->n_entries)
+			continue;
+		path = pk_index_get_string (index, index->priv->entries[entry].key);
+		if (strcmp (pk_index_basename (path), basename) == 0)
+			pk_index_collect (index, records, entry);
+	}
+	return pk_index_records_to_package_ids (index, records);
+}
+
+static gboolean
+pk_index_get_postings (PkIndex *index, guint32 trigram, const guint32 **postings, guint32 *n_postings)
+{
+	const PkIndexTrigram *trigrams = index->priv->trigrams;
+	guint32 lower = 0;
+	guint32 upper = index->priv->header->n_trigrams;
+	guint32 start;
+	guint32 end;
+
+	while (lower < upper) {
+		guint32 middle = lower + (upper - lower) / 2;
+		if (trigrams[middle].trigram < trigram)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+	if (lower >= index->priv->header->n_trigrams || trigrams[lower].trigram != trigram)
+		return FALSE;
+
+	start = trigrams[lower].postings;
+	end = MIN (trigrams[lower + 1].postings, index->priv->header->n_postings);
+	if (start > end)
+		return FALSE;
+	*postings = index->priv->postings + start;
+	*n_postings = end - start;
+	return TRUE;
+}
+
+/**
+ * pk_index_search:
+ * @needle: the text to look for, ignoring ASCII case
+ *
+ * Finds the keys of @kind which contain @needle. Paths are not indexed
+ * for substring search; use pk_index_lookup_basename() for those.
+ *
+ * Return value: (transfer container): the package-ids with a matching key
+ **/
+GPtrArray *
+pk_index_search (PkIndex *index, PkIndexKind kind, const gchar *needle)
+{
+	const PkIndexHeader *header;
+	const guint32 *candidates = NULL;
+	gsize needle_len;
+	guint32 n_candidates = 0;
+	guint32 i;
+	g_autoptr(GArray) records = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	g_return_val_if_fail (PK_IS_INDEX (index), NULL);
+	g_return_val_if_fail (kind < PK_INDEX_KIND_LAST, NULL);
+	g_return_val_if_fail (kind != PK_INDEX_KIND_FILE, NULL);
+	g_return_val_if_fail (needle != NULL, NULL);
+
+	header = index->priv->header;
+	needle_len = strlen (needle);
+
+	/* too short for a trigram, so check every key of the kind */
+	if (needle_len < 3) {
+		for (i = header->kinds[kind]; i < header->kinds[kind + 1]; i++) {
+			const gchar *str = pk_index_get_string (index, index->priv->entries[i].key);
+			if (pk_index_contains (str, needle, needle_len))
+				pk_index_collect (index, records, i);
+		}
+		return pk_index_records_to_package_ids (index, records);
+	}
+
+	/* every trigram has to be there; verify from the rarest one */
+	for (i = 0; i + 3 <= needle_len; i++) {
+		const guint32 *postings;
+		guint32 n_postings;
+
+		if (!pk_index_get_postings (index, pk_index_trigram (kind, needle + i),
+					    &postings, &n_postings))
+			return pk_index_records_to_package_ids (index, records);
+		if (candidates == NULL || n_postings < n_candidates) {
+			candidates = postings;
+			n_candidates = n_postings;
+		}
+	}
+	for (i = 0; i < n_candidates; i++) {
+		const gchar *str;
+
+		if (candidates[i] >= header->n_entries)
+			continue;
+		str = pk_index_get_string (index, index->priv->entries[candidates[i]].key);
+		if (pk_index_contains (str, needle, needle_len))
+			pk_index_collect (index, records, candidates[i]);
+	}
+	return pk_index_records_to_package_ids (index, records);
+}
+
+static void
+pk_index_class_init (PkIndexClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_index_finalize;
+	g_type_class_add_private (klass, sizeof (PkIndexPrivate));
+}
+
+static void
+pk_index_init (PkIndex *index)
+{
+	index->priv = PK_INDEX_GET_PRIVATE (index);
+}
+
+static void
+pk_index_finalize (GObject *object)
+{
+	PkIndex *index;
+	g_return_if_fail (PK_IS_INDEX (object));
+	index = PK_INDEX (object);
+
+	if (index->priv->file != NULL)
+		g_mapped_file_unref (index->priv->file);
+
+	G_OBJECT_CLASS (pk_index_parent_class)->finalize (object);
+}
@@ -0,0 +1,106 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_INDEX_H
+#define __PK_INDEX_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_INDEX		(pk_index_get_type ())
+#define PK_INDEX(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_INDEX, PkIndex))
+#define PK_INDEX_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_INDEX, PkIndexClass))
+#define PK_IS_INDEX(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_INDEX))
+#define PK_IS_INDEX_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_INDEX))
+#define PK_INDEX_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_INDEX, PkIndexClass))
+
+typedef struct PkIndexPrivate PkIndexPrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkIndexPrivate		*priv;
+} PkIndex;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkIndexClass;
+
+/* part of the on-disk format, only ever append */
+typedef enum {
+	PK_INDEX_KIND_NAME,
+	PK_INDEX_KIND_FILE,
+	PK_INDEX_KIND_PROVIDES,
+	PK_INDEX_KIND_LAST
+} PkIndexKind;
+
+typedef struct PkIndexBuilder PkIndexBuilder;
+
+/* called by pk_index_rebuild() to add every package to @builder */
+typedef gboolean (*PkIndexFeedFunc)	(PkIndexBuilder		*builder,
+					 gpointer		 user_data,
+					 GError			**error);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkIndex, g_object_unref)
+#endif
+
+PkIndexBuilder	*pk_index_builder_new			(void);
+void		 pk_index_builder_free			(PkIndexBuilder		*builder);
+guint		 pk_index_builder_add_record		(PkIndexBuilder		*builder,
+							 const gchar		*package_id);
+void		 pk_index_builder_add_key		(PkIndexBuilder		*builder,
+							 guint			 record,
+							 PkIndexKind		 kind,
+							 const gchar		*key);
+gboolean	 pk_index_builder_write			(PkIndexBuilder		*builder,
+							 const gchar		*filename,
+							 const gchar		*stamp,
+							 GError			**error);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkIndexBuilder, pk_index_builder_free)
+#endif
+
+GType		 pk_index_get_type			(void);
+PkIndex		*pk_index_new_from_file			(const gchar		*filename,
+							 const gchar		*stamp,
+							 GError			**error);
+gboolean	 pk_index_rebuild			(const gchar		*filename,
+							 const gchar		*stamp,
+							 PkIndexFeedFunc	 func,
+							 gpointer		 user_data,
+							 GError			**error);
+guint		 pk_index_get_n_records			(PkIndex		*index);
+GPtrArray	*pk_index_lookup			(PkIndex		*index,
+							 PkIndexKind		 kind,
+							 const gchar		*key);
+GPtrArray	*pk_index_lookup_basename		(PkIndex		*index,
+							 const gchar		*basename);
+GPtrArray	*pk_index_search			(PkIndex		*index,
+							 PkIndexKind		 kind,
+							 const gchar		*needle);
+
+G_END_DECLS
+
+#endif /* __PK_INDEX_H */
@@ -45,6 +45,7 @@ typedef struct {
 	PkEngine	*engine;
 	guint		 exit_idle_time;
 	guint		 timer_id;
+	gboolean	 restart_in_place;
 } PkMainHelper;
 
 /**
@@ -69,6 +70,8 @@ pk_main_timeout_check_cb (PkMainHelper *helper)
 	idle = pk_engine_get_seconds_idle (helper->engine);
 	g_debug ("idle is %i", idle);
 	if (idle > helper->exit_idle_time) {
+		helper->restart_in_place = pk_engine_get_restart_in_place (helper->engine);
+		pk_engine_save_warm_state (helper->engine);
 		g_main_loop_quit (helper->loop);
 		helper->timer_id = 0;
 		return FALSE;
@@ -97,7 +100,7 @@ main (int argc, char *argv[])
 {
 	GMainLoop *loop = NULL;
 	GOptionContext *context;
-	PkMainHelper helper;
+	PkMainHelper helper = { 0 };
 	gboolean ret = TRUE;
 	gboolean disable_timer = FALSE;
 	gboolean version = FALSE;
@@ -106,6 +109,7 @@ main (int argc, char *argv[])
 	gboolean keep_environment = FALSE;
 	gint exit_idle_time;
 	g_autoptr(GError) error = NULL;
+	g_auto(GStrv) argv_exec = NULL;
 	g_autofree gchar *backend_name = NULL;
 	g_autofree gchar *conf_filename = NULL;
 	g_autoptr(GKeyFile) conf = NULL;
@@ -142,6 +146,9 @@ main (int argc, char *argv[])
 	/* set the default thread explicitly */
 	pk_is_thread_default ();
 
+	/* the options are removed when parsed, but needed to restart */
+	argv_exec = g_strdupv (argv);
+
 	/* TRANSLATORS: describing the service that is running */
 	context = g_option_context_new (_("PackageKit service"));
 	g_option_context_add_main_entries (context, options, NULL);
@@ -201,6 +208,9 @@ main (int argc, char *argv[])
 		}
 	}
 
+	/* limits for background transactions */
+	pk_background_init (conf);
+
 	loop = g_main_loop_new (NULL, FALSE);
 
 	/* create a new engine object */
@@ -249,13 +259,24 @@ out:
 	closelog ();
 
 #ifdef HAVE_SYSTEMD_SD_DAEMON_H
-	sd_notify (0, "STOPPING=1");
+	if (!helper.restart_in_place)
+		sd_notify (0, "STOPPING=1");
 #endif
 
 	if (helper.timer_id > 0)
 		g_source_remove (helper.timer_id);
 	if (loop != NULL)
 		g_main_loop_unref (loop);
+
+	/* keep the PID, so the service manager and the clients waiting for the
+	 * name see a restart rather than an exit; the bus connection and the
+	 * database are closed on exec */
+	if (helper.restart_in_place) {
+		g_clear_object (&engine);
+		g_debug ("restarting %s", LIBEXECDIR "/packagekitd");
+		execv (LIBEXECDIR "/packagekitd", argv_exec);
+		g_warning ("failed to restart: %s", g_strerror (errno));
+	}
 exit_program:
 	return 0;
 }
@@ -0,0 +1,356 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include "pk-metrics.h"
+
+static void     pk_metrics_finalize	(GObject        *object);
+
+#define PK_METRICS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_METRICS, PkMetricsPrivate))
+
+/*
+ * Latencies are kept in log-linear buckets, in the style of HdrHistogram:
+ * each power of two is split into PK_METRICS_SUB_BUCKETS linear steps, so
+ * the relative error is bounded at 25% from one microsecond up to about
+ * twelve days while a whole histogram stays at 160 counters.
+ */
+#define PK_METRICS_SUB_BUCKET_BITS	2
+#define PK_METRICS_SUB_BUCKETS		(1 << PK_METRICS_SUB_BUCKET_BITS)
+#define PK_METRICS_MAX_EXPONENT		40
+#define PK_METRICS_BUCKETS		((PK_METRICS_MAX_EXPONENT - PK_METRICS_SUB_BUCKET_BITS + 2) * PK_METRICS_SUB_BUCKETS)
+
+typedef struct {
+	guint64			 count;
+	guint64			 sum;		/* us */
+	guint64			 max;		/* us */
+	guint64			 buckets[PK_METRICS_BUCKETS];
+} PkMetricsHistogramData;
+
+typedef struct {
+	guint64			 transactions;
+	guint64			 succeeded;
+	guint64			 failed;
+	guint64			 cancelled;
+	guint64			 results;
+	guint64			 signals;
+	guint64			 bytes_emitted;
+	PkMetricsHistogramData	 histograms[PK_METRICS_HISTOGRAM_LAST];
+} PkMetricsRole;
+
+struct PkMetricsPrivate
+{
+	PkMetricsRole		*roles[PK_ROLE_ENUM_LAST];	/* allocated on first use */
+};
+
+G_DEFINE_TYPE (PkMetrics, pk_metrics, G_TYPE_OBJECT)
+
+static const gchar *
+pk_metrics_histogram_to_string (PkMetricsHistogram histogram)
+{
+	if (histogram == PK_METRICS_HISTOGRAM_QUEUE_WAIT)
+		return "queue-wait";
+	if (histogram == PK_METRICS_HISTOGRAM_RUN_TIME)
+		return "run-time";
+	if (histogram == PK_METRICS_HISTOGRAM_DISPATCH)
+		return "dispatch";
+	if (histogram == PK_METRICS_HISTOGRAM_CANCEL)
+		return "cancel";
+	return NULL;
+}
+
+static PkMetricsRole *
+pk_metrics_get_role (PkMetrics *metrics, PkRoleEnum role)
+{
+	if (role >= PK_ROLE_ENUM_LAST)
+		role = PK_ROLE_ENUM_UNKNOWN;
+	if (metrics->priv->roles[role] == NULL)
+		metrics->priv->roles[role] = g_new0 (PkMetricsRole, 1);
+	return metrics->priv->roles[role];
+}
+
+/**
+ * pk_metrics_bucket_for_value:
+ * @value: the value in microseconds
+ *
+ * Return value: the histogram bucket that counts @value
+ **/
+guint
+pk_metrics_bucket_for_value (gint64 value)
+{
+	guint64 tmp;
+	guint exponent = 0;
+	guint bucket;
+
+	if (value < PK_METRICS_SUB_BUCKETS)
+		return value > 0 ? (guint) value : 0;
+
+	/* find the highest bit set */
+	for (tmp = (guint64) value; tmp > 1; tmp >>= 1)
+		exponent++;
+	bucket = (exponent - PK_METRICS_SUB_BUCKET_BITS + 1) * PK_METRICS_SUB_BUCKETS;
+	bucket += (value >> (exponent - PK_METRICS_SUB_BUCKET_BITS)) & (PK_METRICS_SUB_BUCKETS - 1);
+	return MIN (bucket, PK_METRICS_BUCKETS - 1);
+}
+
+/**
+ * pk_metrics_bucket_lower_bound:
+ * @bucket: the histogram bucket index
+ *
+ * Return value: the smallest value in microseconds counted by @bucket
+ **/
+guint64
+pk_metrics_bucket_lower_bound (guint bucket)
+{
+	guint64 sub = bucket % PK_METRICS_SUB_BUCKETS;
+	guint shift = bucket / PK_METRICS_SUB_BUCKETS;
+
+	if (shift == 0)
+		return bucket;
+	return (PK_METRICS_SUB_BUCKETS + sub) << (shift - 1);
+}
+
+/**
+ * pk_metrics_record:
+ * @role: the transaction role
+ * @histogram: which latency histogram to add to
+ * @value: the latency in microseconds
+ **/
+void
+pk_metrics_record (PkMetrics *metrics,
+		   PkRoleEnum role,
+		   PkMetricsHistogram histogram,
+		   gint64 value)
+{
+	PkMetricsHistogramData *data;
+
+	g_return_if_fail (PK_IS_METRICS (metrics));
+	g_return_if_fail (histogram < PK_METRICS_HISTOGRAM_LAST);
+
+	/* the clock is monotonic, but be careful anyway */
+	if (value < 0)
+		value = 0;
+	data = &pk_metrics_get_role (metrics, role)->histograms[histogram];
+	data->buckets[pk_metrics_bucket_for_value (value)]++;
+	data->count++;
+	data->sum += value;
+	data->max = MAX (data->max, (guint64) value);
+}
+
+/**
+ * pk_metrics_add_signal:
+ * @role: the transaction role
+ * @elapsed: the time spent emitting the signal in microseconds
+ * @bytes: the serialized size of the signal parameters
+ **/
+void
+pk_metrics_add_signal (PkMetrics *metrics,
+		       PkRoleEnum role,
+		       gint64 elapsed,
+		       gsize bytes)
+{
+	PkMetricsRole *data;
+
+	g_return_if_fail (PK_IS_METRICS (metrics));
+
+	data = pk_metrics_get_role (metrics, role);
+	data->signals++;
+	data->bytes_emitted += bytes;
+	pk_metrics_record (metrics, role, PK_METRICS_HISTOGRAM_DISPATCH, elapsed);
+}
+
+/**
+ * pk_metrics_add_finished:
+ * @role: the transaction role
+ * @exit_enum: how the transaction finished
+ * @results: the number of packages the transaction returned
+ **/
+void
+pk_metrics_add_finished (PkMetrics *metrics,
+			 PkRoleEnum role,
+			 PkExitEnum exit_enum,
+			 guint results)
+{
+	PkMetricsRole *data;
+
+	g_return_if_fail (PK_IS_METRICS (metrics));
+
+	data = pk_metrics_get_role (metrics, role);
+	data->transactions++;
+	data->results += results;
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
+		data->succeeded++;
+	else if (exit_enum == PK_EXIT_ENUM_CANCELLED ||
+		 exit_enum == PK_EXIT_ENUM_CANCELLED_PRIORITY)
+		data->cancelled++;
+	else
+		data->failed++;
+}
+
+/**
+ * pk_metrics_get_count:
+ * @role: the transaction role
+ * @histogram: the latency histogram
+ *
+ * Return value: the number of samples recorded in the histogram
+ **/
+guint64
+pk_metrics_get_count (PkMetrics *metrics,
+		      PkRoleEnum role,
+		      PkMetricsHistogram histogram)
+{
+	g_return_val_if_fail (PK_IS_METRICS (metrics), 0);
+	g_return_val_if_fail (histogram < PK_METRICS_HISTOGRAM_LAST, 0);
+
+	if (role >= PK_ROLE_ENUM_LAST || metrics->priv->roles[role] == NULL)
+		return 0;
+	return metrics->priv->roles[role]->histograms[histogram].count;
+}
+
+static GVariant *
+pk_metrics_histogram_to_variant (PkMetricsHistogramData *data)
+{
+	GVariantBuilder builder;
+	GVariantBuilder buckets;
+	guint len = 0;
+
+	/* drop the empty tail, the bounds are always sent in full */
+	for (guint i = 0; i < PK_METRICS_BUCKETS; i++) {
+		if (data->buckets[i] > 0)
+			len = i + 1;
+	}
+	g_variant_builder_init (&buckets, G_VARIANT_TYPE ("at"));
+	for (guint i = 0; i < len; i++)
+		g_variant_builder_add (&buckets, "t", data->buckets[i]);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&builder, "{sv}", "count",
+			       g_variant_new_uint64 (data->count));
+	g_variant_builder_add (&builder, "{sv}", "sum",
+			       g_variant_new_uint64 (data->sum));
+	g_variant_builder_add (&builder, "{sv}", "max",
+			       g_variant_new_uint64 (data->max));
+	g_variant_builder_add (&builder, "{sv}", "buckets",
+			       g_variant_builder_end (&buckets));
+	return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+pk_metrics_role_to_variant (PkMetricsRole *data)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&builder, "{sv}", "transactions",
+			       g_variant_new_uint64 (data->transactions));
+	g_variant_builder_add (&builder, "{sv}", "succeeded",
+			       g_variant_new_uint64 (data->succeeded));
+	g_variant_builder_add (&builder, "{sv}", "failed",
+			       g_variant_new_uint64 (data->failed));
+	g_variant_builder_add (&builder, "{sv}", "cancelled",
+			       g_variant_new_uint64 (data->cancelled));
+	g_variant_builder_add (&builder, "{sv}", "results",
+			       g_variant_new_uint64 (data->results));
+	g_variant_builder_add (&builder, "{sv}", "signals",
+			       g_variant_new_uint64 (data->signals));
+	g_variant_builder_add (&builder, "{sv}", "bytes-emitted",
+			       g_variant_new_uint64 (data->bytes_emitted));
+	for (guint i = 0; i < PK_METRICS_HISTOGRAM_LAST; i++) {
+		g_variant_builder_add (&builder, "{sv}",
+				       pk_metrics_histogram_to_string (i),
+				       pk_metrics_histogram_to_variant (&data->histograms[i]));
+	}
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * pk_metrics_to_variant:
+ *
+ * Return value: (transfer floating): an a{sv} with the bucket bounds and
+ * the counters and histograms of every role seen so far
+ **/
+GVariant *
+pk_metrics_to_variant (PkMetrics *metrics)
+{
+	GVariantBuilder builder;
+	GVariantBuilder bounds;
+	GVariantBuilder roles;
+
+	g_return_val_if_fail (PK_IS_METRICS (metrics), NULL);
+
+	g_variant_builder_init (&bounds, G_VARIANT_TYPE ("at"));
+	for (guint i = 0; i < PK_METRICS_BUCKETS; i++)
+		g_variant_builder_add (&bounds, "t", pk_metrics_bucket_lower_bound (i));
+
+	g_variant_builder_init (&roles, G_VARIANT_TYPE ("a{sv}"));
+	for (guint i = 0; i < PK_ROLE_ENUM_LAST; i++) {
+		if (metrics->priv->roles[i] == NULL)
+			continue;
+		g_variant_builder_add (&roles, "{sv}",
+				       pk_role_enum_to_string (i),
+				       pk_metrics_role_to_variant (metrics->priv->roles[i]));
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&builder, "{sv}", "histogram-bounds",
+			       g_variant_builder_end (&bounds));
+	g_variant_builder_add (&builder, "{sv}", "roles",
+			       g_variant_builder_end (&roles));
+	return g_variant_builder_end (&builder);
+}
+
+static void
+pk_metrics_class_init (PkMetricsClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_metrics_finalize;
+	g_type_class_add_private (klass, sizeof (PkMetricsPrivate));
+}
+
+static void
+pk_metrics_init (PkMetrics *metrics)
+{
+	metrics->priv = PK_METRICS_GET_PRIVATE (metrics);
+}
+
+static void
+pk_metrics_finalize (GObject *object)
+{
+	PkMetrics *metrics;
+	g_return_if_fail (PK_IS_METRICS (object));
+	metrics = PK_METRICS (object);
+
+	for (guint i = 0; i < PK_ROLE_ENUM_LAST; i++)
+		g_free (metrics->priv->roles[i]);
+
+	G_OBJECT_CLASS (pk_metrics_parent_class)->finalize (object);
+}
+
+/**
+ * pk_metrics_new:
+ **/
+PkMetrics *
+pk_metrics_new (void)
+{
+	PkMetrics *metrics;
+	metrics = g_object_new (PK_TYPE_METRICS, NULL);
+	return PK_METRICS (metrics);
+}
@@ -0,0 +1,85 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_METRICS_H
+#define __PK_METRICS_H
+
+#include <glib-object.h>
+#include <packagekit-glib2/pk-enum.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_METRICS		(pk_metrics_get_type ())
+#define PK_METRICS(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_METRICS, PkMetrics))
+#define PK_METRICS_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_METRICS, PkMetricsClass))
+#define PK_IS_METRICS(o)	(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_METRICS))
+#define PK_IS_METRICS_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_METRICS))
+#define PK_METRICS_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_METRICS, PkMetricsClass))
+
+typedef struct PkMetricsPrivate PkMetricsPrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkMetricsPrivate	*priv;
+} PkMetrics;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkMetricsClass;
+
+typedef enum {
+	PK_METRICS_HISTOGRAM_QUEUE_WAIT,	/* created until run */
+	PK_METRICS_HISTOGRAM_RUN_TIME,		/* run until finished */
+	PK_METRICS_HISTOGRAM_DISPATCH,		/* emitting one signal */
+	PK_METRICS_HISTOGRAM_CANCEL,		/* cancel requested until finished */
+	PK_METRICS_HISTOGRAM_LAST
+} PkMetricsHistogram;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkMetrics, g_object_unref)
+#endif
+
+GType		 pk_metrics_get_type			(void);
+PkMetrics	*pk_metrics_new				(void);
+void		 pk_metrics_record			(PkMetrics		*metrics,
+							 PkRoleEnum		 role,
+							 PkMetricsHistogram	 histogram,
+							 gint64			 value);
+void		 pk_metrics_add_signal			(PkMetrics		*metrics,
+							 PkRoleEnum		 role,
+							 gint64			 elapsed,
+							 gsize			 bytes);
+void		 pk_metrics_add_finished		(PkMetrics		*metrics,
+							 PkRoleEnum		 role,
+							 PkExitEnum		 exit_enum,
+							 guint			 results);
+guint64		 pk_metrics_get_count			(PkMetrics		*metrics,
+							 PkRoleEnum		 role,
+							 PkMetricsHistogram	 histogram);
+guint		 pk_metrics_bucket_for_value		(gint64			 value);
+guint64		 pk_metrics_bucket_lower_bound		(guint			 bucket);
+GVariant	*pk_metrics_to_variant			(PkMetrics		*metrics);
+
+G_END_DECLS
+
+#endif /* __PK_METRICS_H */
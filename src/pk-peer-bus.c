@@ -0,0 +1,263 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Clients that read large result sets can skip the bus daemon, which
+ * copies and routes every message, by connecting to this socket. Only
+ * the EXTERNAL mechanism is allowed, so every connection has the UID and
+ * PID of the peer, and the transactions themselves are still created and
+ * authorized on the system bus; the peer only attaches them here, which
+ * pk_transaction_attach_peer() allows for the creating process alone.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-common-private.h>
+
+#include "pk-peer-bus.h"
+#include "pk-transaction.h"
+
+static void     pk_peer_bus_finalize	(GObject        *object);
+
+#define PK_PEER_BUS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PEER_BUS, PkPeerBusPrivate))
+
+struct PkPeerBusPrivate
+{
+	GDBusServer		*server;
+	GDBusAuthObserver	*observer;
+	GDBusInterfaceInfo	*interface_info;
+	PkScheduler		*scheduler;
+	GPtrArray		*connections;
+};
+
+G_DEFINE_TYPE (PkPeerBus, pk_peer_bus, G_TYPE_OBJECT)
+
+static gboolean
+pk_peer_bus_allow_mechanism_cb (GDBusAuthObserver *observer,
+				const gchar *mechanism,
+				gpointer user_data)
+{
+	return g_strcmp0 (mechanism, "EXTERNAL") == 0;
+}
+
+static gboolean
+pk_peer_bus_authorize_cb (GDBusAuthObserver *observer,
+			  GIOStream *stream,
+			  GCredentials *credentials,
+			  gpointer user_data)
+{
+	return credentials != NULL;
+}
+
+static void
+pk_peer_bus_method_call (GDBusConnection *connection,
+			 const gchar *sender,
+			 const gchar *object_path,
+			 const gchar *interface_name,
+			 const gchar *method_name,
+			 GVariant *parameters,
+			 GDBusMethodInvocation *invocation,
+			 gpointer user_data)
+{
+	PkPeerBus *bus = PK_PEER_BUS (user_data);
+	PkTransaction *transaction;
+	const gchar *tid = NULL;
+	g_autoptr(GError) error = NULL;
+
+	if (g_strcmp0 (method_name, "Attach") != 0) {
+		g_dbus_method_invocation_return_error (invocation,
+						       G_DBUS_ERROR,
+						       G_DBUS_ERROR_UNKNOWN_METHOD,
+						       "no method %s", method_name);
+		return;
+	}
+	g_variant_get (parameters, "(&o)", &tid);
+	transaction = pk_scheduler_get_transaction (bus->priv->scheduler, tid);
+	if (transaction == NULL) {
+		g_dbus_method_invocation_return_error (invocation,
+						       G_DBUS_ERROR,
+						       G_DBUS_ERROR_UNKNOWN_OBJECT,
+						       "no transaction %s", tid);
+		return;
+	}
+	if (!pk_transaction_attach_peer (transaction, connection, &error)) {
+		g_dbus_method_invocation_return_gerror (invocation, error);
+		return;
+	}
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+pk_peer_bus_closed_cb (GDBusConnection *connection,
+		       gboolean remote_peer_vanished,
+		       GError *error,
+		       PkPeerBus *bus)
+{
+	g_signal_handlers_disconnect_by_data (connection, bus);
+	g_ptr_array_remove (bus->priv->connections, connection);
+}
+
+static gboolean
+pk_peer_bus_new_connection_cb (GDBusServer *server,
+			       GDBusConnection *connection,
+			       PkPeerBus *bus)
+{
+	static const GDBusInterfaceVTable interface_vtable = {
+		.method_call = pk_peer_bus_method_call,
+		.get_property = NULL,
+		.set_property = NULL
+	};
+	g_autoptr(GError) error = NULL;
+
+	if (g_dbus_connection_register_object (connection,
+					       PK_DBUS_PATH,
+					       bus->priv->interface_info,
+					       &interface_vtable,
+					       bus,  /* user_data */
+					       NULL,  /* user_data_free_func */
+					       &error) == 0) {
+		g_warning ("failed to export %s: %s",
+			   PK_DBUS_INTERFACE_PEER, error->message);
+		return FALSE;
+	}
+	g_ptr_array_add (bus->priv->connections, g_object_ref (connection));
+	g_signal_connect (connection, "closed",
+			  G_CALLBACK (pk_peer_bus_closed_cb), bus);
+	return TRUE;
+}
+
+/**
+ * pk_peer_bus_start:
+ *
+ * Listens on %PK_DBUS_PEER_SOCKET, replacing what a previous daemon left
+ * there.
+ **/
+gboolean
+pk_peer_bus_start (PkPeerBus *bus, GError **error)
+{
+	g_autofree gchar *address = NULL;
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *guid = NULL;
+
+	g_return_val_if_fail (PK_IS_PEER_BUS (bus), FALSE);
+
+	if (bus->priv->server != NULL)
+		return TRUE;
+	dirname = g_path_get_dirname (PK_DBUS_PEER_SOCKET);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", dirname, g_strerror (errno));
+		return FALSE;
+	}
+	if (g_unlink (PK_DBUS_PEER_SOCKET) != 0 && errno != ENOENT) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to remove %s: %s", PK_DBUS_PEER_SOCKET, g_strerror (errno));
+		return FALSE;
+	}
+
+	address = g_strdup_printf ("unix:path=%s", PK_DBUS_PEER_SOCKET);
+	guid = g_dbus_generate_guid ();
+	bus->priv->server = g_dbus_server_new_sync (address,
+						    G_DBUS_SERVER_FLAGS_NONE,
+						    guid,
+						    bus->priv->observer,
+						    NULL,
+						    error);
+	if (bus->priv->server == NULL)
+		return FALSE;
+
+	/* everybody may connect, attaching is what is checked */
+	if (g_chmod (PK_DBUS_PEER_SOCKET, 0666) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to chmod %s: %s", PK_DBUS_PEER_SOCKET, g_strerror (errno));
+		g_clear_object (&bus->priv->server);
+		return FALSE;
+	}
+	g_signal_connect (bus->priv->server, "new-connection",
+			  G_CALLBACK (pk_peer_bus_new_connection_cb), bus);
+	g_dbus_server_start (bus->priv->server);
+	g_debug ("accepting private connections on %s", PK_DBUS_PEER_SOCKET);
+	return TRUE;
+}
+
+static void
+pk_peer_bus_class_init (PkPeerBusClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_peer_bus_finalize;
+	g_type_class_add_private (klass, sizeof (PkPeerBusPrivate));
+}
+
+static void
+pk_peer_bus_init (PkPeerBus *bus)
+{
+	bus->priv = PK_PEER_BUS_GET_PRIVATE (bus);
+	bus->priv->connections = g_ptr_array_new_with_free_func (g_object_unref);
+	bus->priv->observer = g_dbus_auth_observer_new ();
+	g_signal_connect (bus->priv->observer, "allow-mechanism",
+			  G_CALLBACK (pk_peer_bus_allow_mechanism_cb), bus);
+	g_signal_connect (bus->priv->observer, "authorize-authenticated-peer",
+			  G_CALLBACK (pk_peer_bus_authorize_cb), bus);
+}
+
+static void
+pk_peer_bus_finalize (GObject *object)
+{
+	PkPeerBus *bus;
+	g_return_if_fail (PK_IS_PEER_BUS (object));
+	bus = PK_PEER_BUS (object);
+
+	if (bus->priv->server != NULL) {
+		g_dbus_server_stop (bus->priv->server);
+		g_object_unref (bus->priv->server);
+		g_unlink (PK_DBUS_PEER_SOCKET);
+	}
+	for (guint i = 0; i < bus->priv->connections->len; i++) {
+		GDBusConnection *connection = g_ptr_array_index (bus->priv->connections, i);
+		g_signal_handlers_disconnect_by_data (connection, bus);
+		g_dbus_connection_close (connection, NULL, NULL, NULL);
+	}
+	g_ptr_array_unref (bus->priv->connections);
+	g_object_unref (bus->priv->observer);
+	g_dbus_interface_info_unref (bus->priv->interface_info);
+	g_object_unref (bus->priv->scheduler);
+
+	G_OBJECT_CLASS (pk_peer_bus_parent_class)->finalize (object);
+}
+
+/**
+ * pk_peer_bus_new:
+ * @scheduler: where the attached transactions are looked up
+ * @interface_info: the org.freedesktop.PackageKit.Peer interface
+ **/
+PkPeerBus *
+pk_peer_bus_new (PkScheduler *scheduler, GDBusInterfaceInfo *interface_info)
+{
+	PkPeerBus *bus;
+	bus = g_object_new (PK_TYPE_PEER_BUS, NULL);
+	bus->priv->scheduler = g_object_ref (scheduler);
+	bus->priv->interface_info = g_dbus_interface_info_ref (interface_info);
+	return PK_PEER_BUS (bus);
+}
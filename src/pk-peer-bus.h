@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __PK_PEER_BUS_H
+#define __PK_PEER_BUS_H
+
+#include <gio/gio.h>
+
+#include "pk-scheduler.h"
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_PEER_BUS		(pk_peer_bus_get_type ())
+#define PK_PEER_BUS(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_PEER_BUS, PkPeerBus))
+#define PK_PEER_BUS_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_PEER_BUS, PkPeerBusClass))
+#define PK_IS_PEER_BUS(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_PEER_BUS))
+#define PK_IS_PEER_BUS_CLASS(k)		(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_PEER_BUS))
+#define PK_PEER_BUS_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_PEER_BUS, PkPeerBusClass))
+
+typedef struct PkPeerBusPrivate PkPeerBusPrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkPeerBusPrivate	*priv;
+} PkPeerBus;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkPeerBusClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkPeerBus, g_object_unref)
+#endif
+
+GType		 pk_peer_bus_get_type			(void);
+PkPeerBus	*pk_peer_bus_new			(PkScheduler		*scheduler,
+							 GDBusInterfaceInfo	*interface_info);
+gboolean	 pk_peer_bus_start			(PkPeerBus		*bus,
+							 GError			**error);
+
+G_END_DECLS
+
+#endif /* __PK_PEER_BUS_H */
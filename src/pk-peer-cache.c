@@ -0,0 +1,695 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The packages this host downloaded are linked into a directory per
+ * package-id, named like the download pool, and served read-only over
+ * plain HTTP to the hosts in PeerCacheHosts, and nobody else. Nothing
+ * fetched from a peer is trusted: the backends put the file where their
+ * own download would have gone, and check the checksum and the signature
+ * exactly as they do for a file from a mirror.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "pk-peer-cache.h"
+#include "pk-shared.h"
+
+static void     pk_peer_cache_finalize	(GObject        *object);
+
+#define PK_PEER_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PEER_CACHE, PkPeerCachePrivate))
+
+#define PK_PEER_CACHE_DIR		LOCALSTATEDIR "/cache/PackageKit/peer-cache"
+
+/* a peer that does not answer is skipped quickly, the mirror is the fallback */
+#define PK_PEER_CACHE_TIMEOUT		5 /* s */
+
+/* packages are only kept for the length of a rollout */
+#define PK_PEER_CACHE_MAX_AGE		(7 * 24 * 60 * 60) /* s */
+
+/* longer request and header lines are refused */
+#define PK_PEER_CACHE_MAX_LINE		1024
+#define PK_PEER_CACHE_MAX_HEADERS	64
+
+/* further peers wait for a thread rather than each getting one */
+#define PK_PEER_CACHE_MAX_PEERS		8
+
+struct PkPeerCachePrivate
+{
+	GSocketService		*service;
+	guint			 port;
+	gchar			*address;
+	gchar			**hosts;
+	gint			 active;	/* atomic */
+};
+
+G_DEFINE_TYPE (PkPeerCache, pk_peer_cache, G_TYPE_OBJECT)
+
+static gchar *
+pk_peer_cache_get_key (const gchar *package_id)
+{
+	return g_compute_checksum_for_string (G_CHECKSUM_SHA1, package_id, -1);
+}
+
+static gboolean
+pk_peer_cache_key_is_valid (const gchar *key)
+{
+	guint i;
+
+	for (i = 0; key[i] != '\0'; i++) {
+		if (!g_ascii_isxdigit (key[i]) || g_ascii_isupper (key[i]))
+			return FALSE;
+	}
+	return i == 40;
+}
+
+/* never anything that leaves the directory of the package */
+static gboolean
+pk_peer_cache_name_is_valid (const gchar *name)
+{
+	if (name[0] == '\0' || name[0] == '.')
+		return FALSE;
+	return strchr (name, '/') == NULL && strchr (name, '\\') == NULL;
+}
+
+/**
+ * pk_peer_cache_read_line:
+ *
+ * Reads one CRLF or LF terminated line into @buf, which is always
+ * terminated. Lines that do not fit are an error rather than truncated.
+ **/
+static gboolean
+pk_peer_cache_read_line (GBufferedInputStream *stream,
+			 gchar *buf,
+			 gsize size,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	gsize len = 0;
+
+	for (;;) {
+		gint c = g_buffered_input_stream_read_byte (stream, cancellable, error);
+		if (c < 0) {
+			if (error != NULL && *error == NULL) {
+				g_set_error_literal (error, G_IO_ERROR,
+						     G_IO_ERROR_CONNECTION_CLOSED,
+						     "connection closed");
+			}
+			return FALSE;
+		}
+		if (c == '\n')
+			break;
+		if (len + 1 >= size) {
+			g_set_error_literal (error, G_IO_ERROR,
+					     G_IO_ERROR_INVALID_DATA,
+					     "line too long");
+			return FALSE;
+		}
+		buf[len++] = (gchar) c;
+	}
+	if (len > 0 && buf[len - 1] == '\r')
+		len--;
+	buf[len] = '\0';
+	return TRUE;
+}
+
+static gboolean
+pk_peer_cache_write_status (GOutputStream *stream,
+			    const gchar *status,
+			    goffset length,
+			    GError **error)
+{
+	g_autofree gchar *head = NULL;
+
+	head = g_strdup_printf ("HTTP/1.0 %s\r\n"
+				"Content-Type: application/octet-stream\r\n"
+				"Content-Length: %" G_GOFFSET_FORMAT "\r\n"
+				"Connection: close\r\n"
+				"\r\n",
+				status, length);
+	return g_output_stream_write_all (stream, head, strlen (head), NULL, NULL, error);
+}
+
+static gboolean
+pk_peer_cache_serve (GSocketConnection *connection, GError **error)
+{
+	GOutputStream *output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+	gchar line[PK_PEER_CACHE_MAX_LINE];
+	guint i;
+	g_auto(GStrv) request = NULL;
+	g_auto(GStrv) path = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GFileInfo) info = NULL;
+	g_autoptr(GFileInputStream) input_file = NULL;
+	g_autoptr(GInputStream) input = NULL;
+
+	input = g_buffered_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	if (!pk_peer_cache_read_line (G_BUFFERED_INPUT_STREAM (input), line, sizeof (line), NULL, error))
+		return FALSE;
+	request = g_strsplit (line, " ", 3);
+
+	/* the headers say nothing we need */
+	for (i = 0;; i++) {
+		gchar header[PK_PEER_CACHE_MAX_LINE];
+		if (i == PK_PEER_CACHE_MAX_HEADERS)
+			return pk_peer_cache_write_status (output, "431 Request Header Fields Too Large", 0, error);
+		if (!pk_peer_cache_read_line (G_BUFFERED_INPUT_STREAM (input), header, sizeof (header), NULL, error))
+			return FALSE;
+		if (header[0] == '\0')
+			break;
+	}
+
+	if (g_strv_length (request) != 3 || !g_str_has_prefix (request[2], "HTTP/1."))
+		return pk_peer_cache_write_status (output, "400 Bad Request", 0, error);
+	if (g_strcmp0 (request[0], "GET") != 0)
+		return pk_peer_cache_write_status (output, "405 Method Not Allowed", 0, error);
+
+	/* only ever /<key>/<name> */
+	path = g_strsplit (request[1], "/", -1);
+	if (g_strv_length (path) != 3 ||
+	    path[0][0] != '\0' ||
+	    !pk_peer_cache_key_is_valid (path[1]) ||
+	    !pk_peer_cache_name_is_valid (path[2]))
+		return pk_peer_cache_write_status (output, "404 Not Found", 0, error);
+
+	filename = g_build_filename (PK_PEER_CACHE_DIR, path[1], path[2], NULL);
+	file = g_file_new_for_path (filename);
+	input_file = g_file_read (file, NULL, NULL);
+	if (input_file == NULL)
+		return pk_peer_cache_write_status (output, "404 Not Found", 0, error);
+	info = g_file_input_stream_query_info (input_file, G_FILE_ATTRIBUTE_STANDARD_SIZE, NULL, error);
+	if (info == NULL)
+		return FALSE;
+
+	g_debug ("sending %s to a peer", filename);
+	if (!pk_peer_cache_write_status (output, "200 OK", g_file_info_get_size (info), error))
+		return FALSE;
+	return g_output_stream_splice (output, G_INPUT_STREAM (input_file),
+				       G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+				       NULL, error) >= 0;
+}
+
+/* a peer connecting to a dual-stack socket over IPv4 is ::ffff:a.b.c.d */
+static GInetAddress *
+pk_peer_cache_get_remote_address (GSocketConnection *connection, GError **error)
+{
+	GInetAddress *address;
+	const guint8 *bytes;
+	static const guint8 v4_mapped[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+	g_autoptr(GSocketAddress) remote = NULL;
+
+	remote = g_socket_connection_get_remote_address (connection, error);
+	if (remote == NULL)
+		return NULL;
+	if (!G_IS_INET_SOCKET_ADDRESS (remote)) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+				     "not an internet address");
+		return NULL;
+	}
+	address = g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (remote));
+	if (g_inet_address_get_family (address) != G_SOCKET_FAMILY_IPV6)
+		return g_object_ref (address);
+	bytes = g_inet_address_to_bytes (address);
+	if (memcmp (bytes, v4_mapped, sizeof (v4_mapped)) != 0)
+		return g_object_ref (address);
+	return g_inet_address_new_from_bytes (bytes + sizeof (v4_mapped), G_SOCKET_FAMILY_IPV4);
+}
+
+/* resolved for every connection, the peers may be on DHCP */
+static gboolean
+pk_peer_cache_is_peer (PkPeerCache *cache, GInetAddress *address)
+{
+	GResolver *resolver;
+
+	if (cache->priv->hosts == NULL)
+		return FALSE;
+	resolver = g_resolver_get_default ();
+	for (guint i = 0; cache->priv->hosts[i] != NULL; i++) {
+		GList *l;
+		GList *addresses;
+		gboolean ret = FALSE;
+		const gchar *hostname;
+		g_autoptr(GError) error = NULL;
+		g_autoptr(GSocketConnectable) host = NULL;
+
+		if (cache->priv->hosts[i][0] == '\0')
+			continue;
+		host = g_network_address_parse (cache->priv->hosts[i],
+						PK_PEER_CACHE_PORT_DEFAULT, &error);
+		if (host == NULL) {
+			g_debug ("ignoring peer %s: %s", cache->priv->hosts[i], error->message);
+			continue;
+		}
+		hostname = g_network_address_get_hostname (G_NETWORK_ADDRESS (host));
+		addresses = g_resolver_lookup_by_name (resolver, hostname, NULL, &error);
+		if (addresses == NULL) {
+			g_debug ("cannot resolve peer %s: %s", hostname, error->message);
+			continue;
+		}
+		for (l = addresses; l != NULL && !ret; l = l->next)
+			ret = g_inet_address_equal (address, G_INET_ADDRESS (l->data));
+		g_resolver_free_addresses (addresses);
+		if (ret) {
+			g_object_unref (resolver);
+			return TRUE;
+		}
+	}
+	g_object_unref (resolver);
+	return FALSE;
+}
+
+/* on a thread of the service, so blocking is fine */
+static gboolean
+pk_peer_cache_run_cb (GThreadedSocketService *service,
+		      GSocketConnection *connection,
+		      GObject *source_object,
+		      gpointer user_data)
+{
+	PkPeerCache *cache = PK_PEER_CACHE (user_data);
+	g_autofree gchar *remote_str = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GInetAddress) remote = NULL;
+
+	remote = pk_peer_cache_get_remote_address (connection, &error);
+	if (remote == NULL) {
+		g_debug ("refusing a peer: %s", error->message);
+		return TRUE;
+	}
+	if (!pk_peer_cache_is_peer (cache, remote)) {
+		remote_str = g_inet_address_to_string (remote);
+		g_debug ("refusing %s, not in PeerCacheHosts", remote_str);
+		return TRUE;
+	}
+
+	g_atomic_int_inc (&cache->priv->active);
+	g_socket_set_timeout (g_socket_connection_get_socket (connection), PK_PEER_CACHE_TIMEOUT);
+	if (!pk_peer_cache_serve (connection, &error))
+		g_debug ("failed to serve a peer: %s", error->message);
+	g_atomic_int_dec_and_test (&cache->priv->active);
+	return TRUE;
+}
+
+/**
+ * pk_peer_cache_start:
+ *
+ * Starts serving the shared packages on the configured address, or on all
+ * the addresses of the host if there is none.
+ **/
+gboolean
+pk_peer_cache_start (PkPeerCache *cache, GError **error)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (PK_IS_PEER_CACHE (cache), FALSE);
+
+	if (cache->priv->service != NULL)
+		return TRUE;
+	if (cache->priv->hosts == NULL || cache->priv->hosts[0] == NULL) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+				     "no peers configured in PeerCacheHosts");
+		return FALSE;
+	}
+	cache->priv->service = g_threaded_socket_service_new (PK_PEER_CACHE_MAX_PEERS);
+	if (cache->priv->address != NULL && cache->priv->address[0] != '\0') {
+		g_autoptr(GInetAddress) inet_address = NULL;
+		g_autoptr(GSocketAddress) address = NULL;
+
+		inet_address = g_inet_address_new_from_string (cache->priv->address);
+		if (inet_address == NULL) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+				     "invalid PeerCacheAddress %s", cache->priv->address);
+			g_clear_object (&cache->priv->service);
+			return FALSE;
+		}
+		address = g_inet_socket_address_new (inet_address, (guint16) cache->priv->port);
+		ret = g_socket_listener_add_address (G_SOCKET_LISTENER (cache->priv->service),
+						     address, G_SOCKET_TYPE_STREAM,
+						     G_SOCKET_PROTOCOL_TCP, NULL, NULL, error);
+	} else {
+		ret = g_socket_listener_add_inet_port (G_SOCKET_LISTENER (cache->priv->service),
+						       (guint16) cache->priv->port, NULL, error);
+	}
+	if (!ret) {
+		g_clear_object (&cache->priv->service);
+		return FALSE;
+	}
+	g_signal_connect (cache->priv->service, "run",
+			  G_CALLBACK (pk_peer_cache_run_cb), cache);
+	g_socket_service_start (cache->priv->service);
+	g_debug ("sharing downloaded packages on port %u", cache->priv->port);
+	return TRUE;
+}
+
+/**
+ * pk_peer_cache_get_active:
+ *
+ * Returns: the number of peers being sent a package right now
+ **/
+guint
+pk_peer_cache_get_active (PkPeerCache *cache)
+{
+	g_return_val_if_fail (PK_IS_PEER_CACHE (cache), 0);
+	return (guint) g_atomic_int_get (&cache->priv->active);
+}
+
+/**
+ * pk_peer_cache_prune:
+ *
+ * Removes the packages shared for longer than a rollout lasts.
+ **/
+void
+pk_peer_cache_prune (void)
+{
+	const gchar *key;
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	g_autoptr(GDir) dir = NULL;
+
+	dir = g_dir_open (PK_PEER_CACHE_DIR, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((key = g_dir_read_name (dir)) != NULL) {
+		GStatBuf st;
+		g_autofree gchar *path = g_build_filename (PK_PEER_CACHE_DIR, key, NULL);
+
+		if (g_stat (path, &st) != 0 || now - st.st_mtime < PK_PEER_CACHE_MAX_AGE)
+			continue;
+		g_debug ("removing shared package %s", key);
+		pk_directory_remove_contents (path);
+		if (g_rmdir (path) != 0)
+			g_warning ("failed to remove %s: %s", path, g_strerror (errno));
+	}
+}
+
+static gboolean
+pk_peer_cache_fetch_from_host (GSocketClient *client,
+			       const gchar *host,
+			       const gchar *key,
+			       const gchar *name,
+			       const gchar *filename,
+			       goffset size,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	GOutputStream *output;
+	gchar line[PK_PEER_CACHE_MAX_LINE];
+	gint64 length = -1;
+	goffset remaining = size;
+	guint i;
+	g_autofree gchar *request = NULL;
+	g_autofree gchar *tmp = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GFileOutputStream) output_file = NULL;
+	g_autoptr(GInputStream) input = NULL;
+	g_autoptr(GSocketConnection) connection = NULL;
+
+	connection = g_socket_client_connect_to_host (client, host,
+						      PK_PEER_CACHE_PORT_DEFAULT,
+						      cancellable, error);
+	if (connection == NULL)
+		return FALSE;
+
+	output = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+	request = g_strdup_printf ("GET /%s/%s HTTP/1.0\r\n"
+				   "Host: %s\r\n"
+				   "\r\n",
+				   key, name, host);
+	if (!g_output_stream_write_all (output, request, strlen (request), NULL, cancellable, error))
+		return FALSE;
+
+	input = g_buffered_input_stream_new (g_io_stream_get_input_stream (G_IO_STREAM (connection)));
+	if (!pk_peer_cache_read_line (G_BUFFERED_INPUT_STREAM (input), line, sizeof (line), cancellable, error))
+		return FALSE;
+	if (!g_str_has_prefix (line, "HTTP/1.") || strstr (line, " 200 ") == NULL) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "%s", line);
+		return FALSE;
+	}
+	for (i = 0;; i++) {
+		if (i == PK_PEER_CACHE_MAX_HEADERS) {
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					     "too many headers");
+			return FALSE;
+		}
+		if (!pk_peer_cache_read_line (G_BUFFERED_INPUT_STREAM (input), line, sizeof (line), cancellable, error))
+			return FALSE;
+		if (line[0] == '\0')
+			break;
+		if (g_ascii_strncasecmp (line, "Content-Length:", 15) == 0)
+			length = g_ascii_strtoll (line + 15, NULL, 10);
+	}
+	if (length != size) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "offered %" G_GINT64_FORMAT " bytes, expected %" G_GOFFSET_FORMAT,
+			     length, size);
+		return FALSE;
+	}
+
+	/* only moved into place once it is complete */
+	tmp = g_strdup_printf ("%s.peer", filename);
+	file = g_file_new_for_path (tmp);
+	output_file = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, error);
+	if (output_file == NULL)
+		return FALSE;
+
+	/* never more than the repo metadata says the package is */
+	while (remaining > 0) {
+		gchar buf[64 * 1024];
+		gssize len;
+
+		len = g_input_stream_read (input, buf, MIN (remaining, (goffset) sizeof (buf)),
+					   cancellable, error);
+		if (len == 0) {
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+				     "got %" G_GOFFSET_FORMAT " of %" G_GOFFSET_FORMAT " bytes",
+				     size - remaining, size);
+		}
+		if (len <= 0 ||
+		    !g_output_stream_write_all (G_OUTPUT_STREAM (output_file), buf, (gsize) len,
+						NULL, cancellable, error)) {
+			g_unlink (tmp);
+			return FALSE;
+		}
+		remaining -= len;
+	}
+	if (!g_output_stream_close (G_OUTPUT_STREAM (output_file), cancellable, error)) {
+		g_unlink (tmp);
+		return FALSE;
+	}
+	if (g_rename (tmp, filename) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to rename %s: %s", tmp, g_strerror (errno));
+		g_unlink (tmp);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_peer_cache_fetch:
+ * @conf: the daemon configuration, for PeerCacheHosts
+ * @package_id: the package the file belongs to
+ * @filename: where the backend would download the file to
+ * @size: the size of the file in the repo metadata
+ *
+ * Asks each peer in turn for the file of @package_id with the basename
+ * of @filename, and writes it there. A peer that offers anything but
+ * @size bytes is skipped, and nothing past @size is ever read.
+ *
+ * Returns: %TRUE if a peer had the file
+ **/
+gboolean
+pk_peer_cache_fetch (GKeyFile *conf,
+		     const gchar *package_id,
+		     const gchar *filename,
+		     goffset size,
+		     GCancellable *cancellable,
+		     GError **error)
+{
+	g_auto(GStrv) hosts = NULL;
+	g_autofree gchar *key = NULL;
+	g_autofree gchar *name = NULL;
+	g_autofree gchar *dirname = NULL;
+	g_autoptr(GSocketClient) client = NULL;
+
+	hosts = g_key_file_get_string_list (conf, "Daemon", "PeerCacheHosts", NULL, NULL);
+	if (hosts == NULL || hosts[0] == NULL) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+				     "no peers configured");
+		return FALSE;
+	}
+	if (size <= 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+				     "size not known");
+		return FALSE;
+	}
+	name = g_path_get_basename (filename);
+	if (!pk_peer_cache_name_is_valid (name)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_FILENAME,
+			     "cannot share %s", filename);
+		return FALSE;
+	}
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", dirname, g_strerror (errno));
+		return FALSE;
+	}
+
+	key = pk_peer_cache_get_key (package_id);
+	client = g_socket_client_new ();
+	g_socket_client_set_timeout (client, PK_PEER_CACHE_TIMEOUT);
+	for (guint i = 0; hosts[i] != NULL; i++) {
+		g_autoptr(GError) error_local = NULL;
+
+		if (hosts[i][0] == '\0')
+			continue;
+		if (pk_peer_cache_fetch_from_host (client, hosts[i], key, name, filename,
+						   size, cancellable, &error_local)) {
+			g_debug ("got %s for %s from %s", name, package_id, hosts[i]);
+			return TRUE;
+		}
+		if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+		g_debug ("%s does not have %s: %s", hosts[i], name, error_local->message);
+	}
+	g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+		     "no peer has %s", name);
+	return FALSE;
+}
+
+/**
+ * pk_peer_cache_share:
+ * @conf: the daemon configuration, for PeerCachePort
+ * @package_id: the package the file belongs to
+ * @filename: a file the backend downloaded and verified
+ *
+ * Offers @filename to the peers, if this host shares its downloads.
+ * The file is hardlinked where possible, so sharing costs no space
+ * while the backend keeps its copy.
+ **/
+gboolean
+pk_peer_cache_share (GKeyFile *conf,
+		     const gchar *package_id,
+		     const gchar *filename,
+		     GError **error)
+{
+	g_autofree gchar *dest = NULL;
+	g_autofree gchar *dir = NULL;
+	g_autofree gchar *key = NULL;
+	g_autofree gchar *name = NULL;
+	g_autofree gchar *tmp = NULL;
+	g_autoptr(GFile) file_dest = NULL;
+	g_autoptr(GFile) file_src = NULL;
+
+	if (g_key_file_get_integer (conf, "Daemon", "PeerCachePort", NULL) <= 0)
+		return TRUE;
+
+	name = g_path_get_basename (filename);
+	if (!pk_peer_cache_name_is_valid (name))
+		return TRUE;
+	key = pk_peer_cache_get_key (package_id);
+	dir = g_build_filename (PK_PEER_CACHE_DIR, key, NULL);
+	dest = g_build_filename (dir, name, NULL);
+	if (g_file_test (dest, G_FILE_TEST_EXISTS))
+		return TRUE;
+	if (g_mkdir_with_parents (dir, 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", dir, g_strerror (errno));
+		return FALSE;
+	}
+	if (link (filename, dest) == 0)
+		return TRUE;
+	if (errno != EXDEV) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to link %s: %s", filename, g_strerror (errno));
+		return FALSE;
+	}
+
+	/* the cache is on another filesystem, a peer must never see half a file */
+	tmp = g_strdup_printf ("%s.tmp", dest);
+	file_src = g_file_new_for_path (filename);
+	file_dest = g_file_new_for_path (tmp);
+	if (!g_file_copy (file_src, file_dest, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, error))
+		return FALSE;
+	if (g_rename (tmp, dest) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to rename %s: %s", tmp, g_strerror (errno));
+		g_unlink (tmp);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+pk_peer_cache_class_init (PkPeerCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_peer_cache_finalize;
+	g_type_class_add_private (klass, sizeof (PkPeerCachePrivate));
+}
+
+static void
+pk_peer_cache_init (PkPeerCache *cache)
+{
+	cache->priv = PK_PEER_CACHE_GET_PRIVATE (cache);
+}
+
+static void
+pk_peer_cache_finalize (GObject *object)
+{
+	PkPeerCache *cache;
+	g_return_if_fail (PK_IS_PEER_CACHE (object));
+	cache = PK_PEER_CACHE (object);
+
+	if (cache->priv->service != NULL) {
+		g_socket_service_stop (cache->priv->service);
+		g_socket_listener_close (G_SOCKET_LISTENER (cache->priv->service));
+		g_object_unref (cache->priv->service);
+	}
+	g_free (cache->priv->address);
+	g_strfreev (cache->priv->hosts);
+
+	G_OBJECT_CLASS (pk_peer_cache_parent_class)->finalize (object);
+}
+
+/**
+ * pk_peer_cache_new:
+ * @port: the TCP port to serve the shared packages on
+ * @address: (nullable): the address to listen on, or %NULL for all of them
+ * @hosts: the only hosts that are sent anything, as in PeerCacheHosts
+ **/
+PkPeerCache *
+pk_peer_cache_new (guint port, const gchar *address, gchar **hosts)
+{
+	PkPeerCache *cache;
+	cache = g_object_new (PK_TYPE_PEER_CACHE, NULL);
+	cache->priv->port = port;
+	cache->priv->address = g_strdup (address);
+	cache->priv->hosts = g_strdupv (hosts);
+	return PK_PEER_CACHE (cache);
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_PEER_CACHE_H
+#define __PK_PEER_CACHE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_PEER_CACHE		(pk_peer_cache_get_type ())
+#define PK_PEER_CACHE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_PEER_CACHE, PkPeerCache))
+#define PK_PEER_CACHE_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_PEER_CACHE, PkPeerCacheClass))
+#define PK_IS_PEER_CACHE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_PEER_CACHE))
+#define PK_IS_PEER_CACHE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_PEER_CACHE))
+#define PK_PEER_CACHE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_PEER_CACHE, PkPeerCacheClass))
+
+/* the port the peers listen on when PeerCacheHosts does not say */
+#define PK_PEER_CACHE_PORT_DEFAULT	8269
+
+typedef struct PkPeerCachePrivate PkPeerCachePrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkPeerCachePrivate	*priv;
+} PkPeerCache;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkPeerCacheClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkPeerCache, g_object_unref)
+#endif
+
+GType		 pk_peer_cache_get_type			(void);
+PkPeerCache	*pk_peer_cache_new			(guint			 port,
+							 const gchar		*address,
+							 gchar			**hosts);
+gboolean	 pk_peer_cache_start			(PkPeerCache		*cache,
+							 GError			**error);
+guint		 pk_peer_cache_get_active		(PkPeerCache		*cache);
+void		 pk_peer_cache_prune			(void);
+gboolean	 pk_peer_cache_fetch			(GKeyFile		*conf,
+							 const gchar		*package_id,
+							 const gchar		*filename,
+							 goffset		 size,
+							 GCancellable		*cancellable,
+							 GError			**error);
+gboolean	 pk_peer_cache_share			(GKeyFile		*conf,
+							 const gchar		*package_id,
+							 const gchar		*filename,
+							 GError			**error);
+
+G_END_DECLS
+
+#endif /* __PK_PEER_CACHE_H */
@@ -0,0 +1,274 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include "pk-plan-cache.h"
+
+static void     pk_plan_cache_finalize	(GObject        *object);
+
+#define PK_PLAN_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_PLAN_CACHE, PkPlanCachePrivate))
+
+/* solver states can be large, so only keep the most recent ones */
+#define PK_PLAN_CACHE_MAX_ITEMS		8
+
+/* the flags that change what the solver does, the others only change how
+ * the result is committed */
+#define PK_PLAN_CACHE_SOLVER_FLAGS	(pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ALLOW_REINSTALL) | \
+					 pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE) | \
+					 pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_JUST_REINSTALL))
+
+typedef struct {
+	gchar			*key;
+	gpointer		 plan;
+	GDestroyNotify		 destroy;
+	gint64			 expires;	/* monotonic, in us */
+} PkPlanCacheItem;
+
+struct PkPlanCachePrivate
+{
+	GHashTable		*hash;		/* token:PkPlanCacheItem */
+	gint64			 timeout;	/* us */
+};
+
+G_DEFINE_TYPE (PkPlanCache, pk_plan_cache, G_TYPE_OBJECT)
+
+static void
+pk_plan_cache_item_free (PkPlanCacheItem *item)
+{
+	if (item->destroy != NULL)
+		item->destroy (item->plan);
+	g_free (item->key);
+	g_free (item);
+}
+
+/**
+ * pk_plan_cache_role_has_plan:
+ *
+ * Only the roles that run the solver can have their plan reused.
+ **/
+gboolean
+pk_plan_cache_role_has_plan (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	       role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
+	       role == PK_ROLE_ENUM_REMOVE_PACKAGES;
+}
+
+/**
+ * pk_plan_cache_build_key:
+ *
+ * Everything a commit has to share with the simulation for the solved
+ * plan to still be the right answer. The package IDs are used in the
+ * given order as PkTask sends the same array both times.
+ **/
+gchar *
+pk_plan_cache_build_key (PkRoleEnum role,
+			 PkBitfield transaction_flags,
+			 gchar **package_ids,
+			 gboolean allow_deps,
+			 gboolean autoremove,
+			 guint uid)
+{
+	GString *key;
+	guint i;
+
+	key = g_string_new (pk_role_enum_to_string (role));
+	g_string_append_printf (key, "\t%" G_GUINT64_FORMAT "\t%i\t%i\t%u",
+				transaction_flags & PK_PLAN_CACHE_SOLVER_FLAGS,
+				allow_deps, autoremove, uid);
+	for (i = 0; package_ids != NULL && package_ids[i] != NULL; i++) {
+		g_string_append_c (key, '\t');
+		g_string_append (key, package_ids[i]);
+	}
+	return g_string_free (key, FALSE);
+}
+
+static gboolean
+pk_plan_cache_item_is_expired (gpointer key, gpointer value, gpointer user_data)
+{
+	PkPlanCacheItem *item = (PkPlanCacheItem *) value;
+	return item->expires < *((gint64 *) user_data);
+}
+
+static void
+pk_plan_cache_prune (PkPlanCache *cache)
+{
+	GHashTableIter iter;
+	PkPlanCacheItem *item;
+	const gchar *oldest = NULL;
+	gint64 now = g_get_monotonic_time ();
+	gint64 expires = G_MAXINT64;
+	gpointer key;
+
+	g_hash_table_foreach_remove (cache->priv->hash,
+				     pk_plan_cache_item_is_expired,
+				     &now);
+	if (g_hash_table_size (cache->priv->hash) < PK_PLAN_CACHE_MAX_ITEMS)
+		return;
+
+	/* make room by dropping the one closest to expiring */
+	g_hash_table_iter_init (&iter, cache->priv->hash);
+	while (g_hash_table_iter_next (&iter, &key, (gpointer *) &item)) {
+		if (item->expires < expires) {
+			expires = item->expires;
+			oldest = key;
+		}
+	}
+	if (oldest != NULL)
+		g_hash_table_remove (cache->priv->hash, oldest);
+}
+
+/**
+ * pk_plan_cache_insert:
+ * @key: from pk_plan_cache_build_key()
+ * @plan: the backend state, owned by the cache from now on
+ * @destroy: the function to free @plan
+ *
+ * Return value: the token the client has to send to commit the plan,
+ * or %NULL if plans are not being kept
+ **/
+gchar *
+pk_plan_cache_insert (PkPlanCache *cache,
+		      const gchar *key,
+		      gpointer plan,
+		      GDestroyNotify destroy)
+{
+	PkPlanCacheItem *item;
+	gchar *token;
+
+	g_return_val_if_fail (PK_IS_PLAN_CACHE (cache), NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	if (cache->priv->timeout == 0) {
+		if (destroy != NULL)
+			destroy (plan);
+		return NULL;
+	}
+	pk_plan_cache_prune (cache);
+
+	item = g_new0 (PkPlanCacheItem, 1);
+	item->key = g_strdup (key);
+	item->plan = plan;
+	item->destroy = destroy;
+	item->expires = g_get_monotonic_time () + cache->priv->timeout;
+	token = g_uuid_string_random ();
+	g_hash_table_insert (cache->priv->hash, g_strdup (token), item);
+	return token;
+}
+
+/**
+ * pk_plan_cache_take:
+ * @token: the token returned by pk_plan_cache_insert()
+ * @key: from pk_plan_cache_build_key() for the commit
+ * @destroy: (out): the function to free the plan
+ *
+ * A plan can only be committed once, so it is removed from the cache.
+ *
+ * Return value: the plan, or %NULL if it expired, was invalidated or
+ * was made for a different request
+ **/
+gpointer
+pk_plan_cache_take (PkPlanCache *cache,
+		    const gchar *token,
+		    const gchar *key,
+		    GDestroyNotify *destroy)
+{
+	PkPlanCacheItem *item;
+	gpointer plan = NULL;
+
+	g_return_val_if_fail (PK_IS_PLAN_CACHE (cache), NULL);
+	g_return_val_if_fail (token != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+	g_return_val_if_fail (destroy != NULL, NULL);
+
+	item = g_hash_table_lookup (cache->priv->hash, token);
+	if (item == NULL)
+		return NULL;
+	if (item->expires >= g_get_monotonic_time () &&
+	    g_strcmp0 (item->key, key) == 0) {
+		plan = item->plan;
+		*destroy = item->destroy;
+		item->destroy = NULL;
+	}
+	g_hash_table_remove (cache->priv->hash, token);
+	return plan;
+}
+
+void
+pk_plan_cache_invalidate (PkPlanCache *cache)
+{
+	g_return_if_fail (PK_IS_PLAN_CACHE (cache));
+
+	if (g_hash_table_size (cache->priv->hash) == 0)
+		return;
+	g_debug ("invalidating %u cached plans",
+		 g_hash_table_size (cache->priv->hash));
+	g_hash_table_remove_all (cache->priv->hash);
+}
+
+guint
+pk_plan_cache_get_size (PkPlanCache *cache)
+{
+	g_return_val_if_fail (PK_IS_PLAN_CACHE (cache), 0);
+	return g_hash_table_size (cache->priv->hash);
+}
+
+static void
+pk_plan_cache_class_init (PkPlanCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_plan_cache_finalize;
+	g_type_class_add_private (klass, sizeof (PkPlanCachePrivate));
+}
+
+static void
+pk_plan_cache_init (PkPlanCache *cache)
+{
+	cache->priv = PK_PLAN_CACHE_GET_PRIVATE (cache);
+	cache->priv->hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, (GDestroyNotify) pk_plan_cache_item_free);
+}
+
+static void
+pk_plan_cache_finalize (GObject *object)
+{
+	PkPlanCache *cache;
+	g_return_if_fail (PK_IS_PLAN_CACHE (object));
+	cache = PK_PLAN_CACHE (object);
+
+	g_hash_table_unref (cache->priv->hash);
+
+	G_OBJECT_CLASS (pk_plan_cache_parent_class)->finalize (object);
+}
+
+/**
+ * pk_plan_cache_new:
+ * @timeout: the number of seconds to keep a simulated plan, or 0
+ **/
+PkPlanCache *
+pk_plan_cache_new (guint timeout)
+{
+	PkPlanCache *cache;
+	cache = g_object_new (PK_TYPE_PLAN_CACHE, NULL);
+	cache->priv->timeout = (gint64) timeout * G_USEC_PER_SEC;
+	return PK_PLAN_CACHE (cache);
+}
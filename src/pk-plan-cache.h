@@ -0,0 +1,79 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_PLAN_CACHE_H
+#define __PK_PLAN_CACHE_H
+
+#include <glib-object.h>
+#include <packagekit-glib2/pk-bitfield.h>
+#include <packagekit-glib2/pk-enum.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_PLAN_CACHE		(pk_plan_cache_get_type ())
+#define PK_PLAN_CACHE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_PLAN_CACHE, PkPlanCache))
+#define PK_PLAN_CACHE_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_PLAN_CACHE, PkPlanCacheClass))
+#define PK_IS_PLAN_CACHE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_PLAN_CACHE))
+#define PK_IS_PLAN_CACHE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_PLAN_CACHE))
+#define PK_PLAN_CACHE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_PLAN_CACHE, PkPlanCacheClass))
+
+typedef struct PkPlanCachePrivate PkPlanCachePrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkPlanCachePrivate	*priv;
+} PkPlanCache;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkPlanCacheClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkPlanCache, g_object_unref)
+#endif
+
+GType		 pk_plan_cache_get_type			(void);
+PkPlanCache	*pk_plan_cache_new			(guint			 timeout);
+gboolean	 pk_plan_cache_role_has_plan		(PkRoleEnum		 role);
+gchar		*pk_plan_cache_build_key		(PkRoleEnum		 role,
+							 PkBitfield		 transaction_flags,
+							 gchar			**package_ids,
+							 gboolean		 allow_deps,
+							 gboolean		 autoremove,
+							 guint			 uid)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gchar		*pk_plan_cache_insert			(PkPlanCache		*cache,
+							 const gchar		*key,
+							 gpointer		 plan,
+							 GDestroyNotify		 destroy)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gpointer	 pk_plan_cache_take			(PkPlanCache		*cache,
+							 const gchar		*token,
+							 const gchar		*key,
+							 GDestroyNotify		*destroy);
+void		 pk_plan_cache_invalidate		(PkPlanCache		*cache);
+guint		 pk_plan_cache_get_size			(PkPlanCache		*cache);
+
+G_END_DECLS
+
+#endif /* __PK_PLAN_CACHE_H */
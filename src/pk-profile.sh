@@ -0,0 +1,180 @@
+#!/bin/sh
+# Copyright (C) 2026 The PackageKit Authors
+#
+# Licensed under the GNU General Public License Version 2
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+
+# Runs a fixed scenario against a daemon started under a profiler, so the
+# same measurement can be taken before and after a change. Needs root, a
+# build configured with -Dlocal_checkout=true so the daemon reads the
+# config written here, and the DBus policy and polkit rules installed as
+# run-pk.sh describes.
+#
+# Each run writes to OUTDIR/<scenario>-<tool>-<date>/:
+#   daemon.conf     the config the daemon was started with
+#   client.log      what the client printed, JSON for pk-bench
+#   summary.txt     the profiler's own report
+#   flamegraph.svg  when stackcollapse-*.pl and flamegraph.pl are in PATH
+# and appends a line to OUTDIR/summary.tsv.
+
+usage() {
+    cat <<EOF
+Usage: $0 [-t perf|callgrind|heaptrack] [-b BACKEND] [-B BUILDDIR] [-o OUTDIR] SCENARIO...
+
+Scenarios:
+  cold-get-updates     start the daemon and run GetUpdates straight away
+  resolve-10k          one Resolve of 10000 synthetic names
+  get-files-installed  GetFiles on every installed package
+  search-names-1000    1000 concurrent SearchNames
+
+The default tool is perf, the default backend dummy, which is given
+10000 synthetic packages.
+EOF
+    exit 1
+}
+
+TOOL=perf
+BACKEND=dummy
+BUILDDIR=build
+OUTDIR=profile-results
+while getopts "t:b:B:o:h" opt; do
+    case $opt in
+        t) TOOL=$OPTARG ;;
+        b) BACKEND=$OPTARG ;;
+        B) BUILDDIR=$OPTARG ;;
+        o) OUTDIR=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 0 ] || usage
+
+if [ "$(id -u)" != "0" ]; then
+    echo "The daemon has to own the system bus name, run as root"
+    exit 1
+fi
+case $TOOL in
+    perf|callgrind|heaptrack) ;;
+    *) echo "Unknown tool $TOOL"; usage ;;
+esac
+
+SRCDIR=$(cd "$(dirname "$0")/.." && pwd)
+BUILDDIR=$(cd "$BUILDDIR" && pwd) || exit 1
+mkdir -p "$OUTDIR" && OUTDIR=$(cd "$OUTDIR" && pwd) || exit 1
+for exe in src/packagekitd client/pkcon client/pk-bench tests/pk-conformance; do
+    if [ ! -x "$BUILDDIR/$exe" ]; then
+        echo "$BUILDDIR/$exe is missing, build first"
+        exit 1
+    fi
+done
+if [ ! -f "$OUTDIR/summary.tsv" ]; then
+    printf "scenario\ttool\tbackend\tdate\twall-s\tclient-exit\n" > "$OUTDIR/summary.tsv"
+fi
+
+# the daemon looks for ../etc/PackageKit.conf from where it is started
+write_config() {
+    mkdir -p "$1/root/etc" "$1/root/run"
+    cp "$SRCDIR/etc/PackageKit.conf" "$1/root/etc/PackageKit.conf"
+    cat >> "$1/root/etc/PackageKit.conf" <<EOF
+
+[Dummy]
+SyntheticPackages=10000
+SyntheticRate=0
+EOF
+    cp "$1/root/etc/PackageKit.conf" "$1/daemon.conf"
+}
+
+start_daemon() {
+    DAEMON="$BUILDDIR/src/packagekitd --disable-timer --backend=$BACKEND"
+    cd "$1/root/run" || exit 1
+    case $TOOL in
+        perf)
+            perf record -g -F 999 -o "$1/perf.data" -- $DAEMON > "$1/daemon.log" 2>&1 & ;;
+        callgrind)
+            valgrind --tool=callgrind --collect-systime=yes \
+                --callgrind-out-file="$1/callgrind.out" $DAEMON > "$1/daemon.log" 2>&1 & ;;
+        heaptrack)
+            heaptrack -o "$1/heaptrack" $DAEMON > "$1/daemon.log" 2>&1 & ;;
+    esac
+    DAEMON_PID=$!
+    cd - > /dev/null || exit 1
+    gdbus wait --system --timeout 120 org.freedesktop.PackageKit
+}
+
+stop_daemon() {
+    "$BUILDDIR/client/pkcon" quit > /dev/null 2>&1
+    for i in $(seq 60); do
+        kill -0 "$DAEMON_PID" 2> /dev/null || break
+        sleep 1
+    done
+    kill -INT "$DAEMON_PID" 2> /dev/null
+    wait "$DAEMON_PID" 2> /dev/null
+}
+
+run_client() {
+    case $1 in
+        cold-get-updates)
+            "$BUILDDIR/client/pkcon" --plain get-updates ;;
+        resolve-10k)
+            "$BUILDDIR/client/pk-bench" --roles resolve --clients 1 --iterations 1 \
+                --names "$(seq -f synthetic-%g -s, 0 9999)" ;;
+        get-files-installed)
+            "$BUILDDIR/tests/pk-conformance" --workloads get-files --iterations 1 ;;
+        search-names-1000)
+            "$BUILDDIR/client/pk-bench" --roles search-name --clients 1000 --no-ramp \
+                --iterations 1 --names power ;;
+    esac
+}
+
+report() {
+    case $TOOL in
+        perf)
+            perf report -i "$1/perf.data" --stdio --no-children --percent-limit 1 \
+                > "$1/summary.txt" 2> /dev/null
+            if command -v stackcollapse-perf.pl > /dev/null && command -v flamegraph.pl > /dev/null; then
+                perf script -i "$1/perf.data" 2> /dev/null | stackcollapse-perf.pl | \
+                    flamegraph.pl --title "$2" > "$1/flamegraph.svg"
+            fi ;;
+        callgrind)
+            callgrind_annotate --inclusive=yes "$1/callgrind.out" > "$1/summary.txt" ;;
+        heaptrack)
+            DATA=$(ls "$1"/heaptrack.* | head -n 1)
+            HEAPTRACK_STACKS="$1/stacks.txt"
+            heaptrack_print -f "$DATA" -F "$HEAPTRACK_STACKS" > "$1/summary.txt"
+            if command -v flamegraph.pl > /dev/null; then
+                flamegraph.pl --title "$2" --countname allocations \
+                    < "$HEAPTRACK_STACKS" > "$1/flamegraph.svg"
+            fi ;;
+    esac
+}
+
+for SCENARIO in "$@"; do
+    case $SCENARIO in
+        cold-get-updates|resolve-10k|get-files-installed|search-names-1000) ;;
+        *) echo "Unknown scenario $SCENARIO"; usage ;;
+    esac
+    DATE=$(date +%Y%m%d-%H%M%S)
+    RUN="$OUTDIR/$SCENARIO-$TOOL-$DATE"
+    mkdir -p "$RUN"
+    write_config "$RUN"
+
+    echo "Running $SCENARIO under $TOOL, writing to $RUN"
+    # only the cold start counts the daemon starting up
+    START=$(date +%s.%N)
+    start_daemon "$RUN" || exit 1
+    [ "$SCENARIO" = "cold-get-updates" ] || START=$(date +%s.%N)
+    run_client "$SCENARIO" > "$RUN/client.log" 2>&1
+    CLIENT_EXIT=$?
+    END=$(date +%s.%N)
+    stop_daemon
+    report "$RUN" "$SCENARIO ($TOOL, $BACKEND)"
+    rm -rf "$RUN/root"
+
+    WALL=$(awk "BEGIN { printf \"%.3f\", $END - $START }")
+    printf "%s\t%s\t%s\t%s\t%s\t%s\n" "$SCENARIO" "$TOOL" "$BACKEND" "$DATE" \
+        "$WALL" "$CLIENT_EXIT" >> "$OUTDIR/summary.tsv"
+done
+column -t -s "$(printf '\t')" "$OUTDIR/summary.tsv"
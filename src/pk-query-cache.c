@@ -0,0 +1,688 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <packagekit-glib2/pk-category.h>
+#include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-details.h>
+#include <packagekit-glib2/pk-distro-upgrade.h>
+#include <packagekit-glib2/pk-package.h>
+#include <packagekit-glib2/pk-repo-detail.h>
+#include <packagekit-glib2/pk-update-detail.h>
+
+#include "pk-query-cache.h"
+
+static void     pk_query_cache_finalize	(GObject        *object);
+
+#define PK_QUERY_CACHE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_QUERY_CACHE, PkQueryCachePrivate))
+
+/* the oldest entry is dropped when adding more than this */
+#define PK_QUERY_CACHE_MAX_ENTRIES	64
+
+/* bump when the on-disk layout changes */
+#define PK_QUERY_CACHE_FILE_VERSION	2
+#define PK_QUERY_CACHE_FILE_TYPE	"(uva(saa{sv}aa{sv}aa{sv}aa{sv}aa{sv}aa{sv}))"
+
+struct PkQueryCachePrivate
+{
+	GHashTable		*hash;		/* key:PkResults */
+	GQueue			 keys;		/* oldest first, owned by hash */
+	guint			 hits;
+	guint			 misses;
+	PkResults		*updates;
+	gint64			 updates_timestamp;
+	guint			 generation;	/* bumped by every invalidation */
+};
+
+enum {
+	SIGNAL_UPDATES_CHANGED,
+	SIGNAL_LAST
+};
+
+static guint signals [SIGNAL_LAST] = { 0 };
+
+G_DEFINE_TYPE (PkQueryCache, pk_query_cache, G_TYPE_OBJECT)
+
+/**
+ * pk_query_cache_role_is_cacheable:
+ *
+ * Only roles that read the package database or the repository
+ * configuration, and that return nothing but packages, details, update
+ * details, categories, repositories or distribution upgrades, can be
+ * replayed. The last three only change on a refresh or when the
+ * repositories are edited, which both invalidate the cache.
+ **/
+gboolean
+pk_query_cache_role_is_cacheable (PkRoleEnum role)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_GET_DETAILS:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_GET_UPDATE_DETAIL:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+	case PK_ROLE_ENUM_GET_CATEGORIES:
+	case PK_ROLE_ENUM_GET_REPO_LIST:
+	case PK_ROLE_ENUM_GET_DISTRO_UPGRADES:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/**
+ * pk_query_cache_build_key:
+ *
+ * The locale and the values come from the client and may contain any
+ * separator, so each is prefixed with its length.
+ **/
+gchar *
+pk_query_cache_build_key (PkRoleEnum role,
+			  PkBitfield filters,
+			  gchar **values,
+			  const gchar *locale)
+{
+	GString *key;
+
+	key = g_string_new (pk_role_enum_to_string (role));
+	g_string_append_printf (key, "\t%" G_GUINT64_FORMAT "\t", filters);
+	if (locale == NULL)
+		locale = "";
+	g_string_append_printf (key, "%" G_GSIZE_FORMAT ":%s", strlen (locale), locale);
+	for (guint i = 0; values != NULL && values[i] != NULL; i++) {
+		g_string_append_printf (key, "\t%" G_GSIZE_FORMAT ":%s",
+					strlen (values[i]), values[i]);
+	}
+	return g_string_free (key, FALSE);
+}
+
+/**
+ * pk_query_cache_lookup:
+ *
+ * Return value: (transfer full): the stored results, or %NULL
+ **/
+PkResults *
+pk_query_cache_lookup (PkQueryCache *cache, const gchar *key)
+{
+	PkResults *results;
+
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	results = g_hash_table_lookup (cache->priv->hash, key);
+	if (results == NULL) {
+		cache->priv->misses++;
+		return NULL;
+	}
+	cache->priv->hits++;
+	return g_object_ref (results);
+}
+
+/**
+ * pk_query_cache_get_generation:
+ *
+ * Return value: a number that changes on every invalidation, which is
+ * read when a query starts and passed back when its results are added
+ **/
+guint
+pk_query_cache_get_generation (PkQueryCache *cache)
+{
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), 0);
+	return cache->priv->generation;
+}
+
+/**
+ * pk_query_cache_insert:
+ * @generation: from pk_query_cache_get_generation() when the query started
+ *
+ * Adds the results of a query, unless the cache was invalidated whilst
+ * it ran and they may be from before the change.
+ **/
+void
+pk_query_cache_insert (PkQueryCache *cache,
+		       const gchar *key,
+		       PkResults *results,
+		       guint generation)
+{
+	gchar *key_dup;
+
+	g_return_if_fail (PK_IS_QUERY_CACHE (cache));
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	if (generation != cache->priv->generation) {
+		g_debug ("not caching %s, invalidated whilst it ran", key);
+		return;
+	}
+
+	/* already got a copy */
+	if (g_hash_table_contains (cache->priv->hash, key))
+		return;
+
+	/* make space */
+	if (cache->priv->keys.length >= PK_QUERY_CACHE_MAX_ENTRIES) {
+		const gchar *oldest = g_queue_pop_head (&cache->priv->keys);
+		g_hash_table_remove (cache->priv->hash, oldest);
+	}
+
+	key_dup = g_strdup (key);
+	g_hash_table_insert (cache->priv->hash, key_dup, g_object_ref (results));
+	g_queue_push_tail (&cache->priv->keys, key_dup);
+}
+
+/**
+ * pk_query_cache_set_updates:
+ *
+ * @generation: from pk_query_cache_get_generation() when the query started
+ *
+ * Keeps the results of the last unfiltered GetUpdates until the package
+ * database changes, so clients can show the update count without
+ * starting a transaction.
+ **/
+void
+pk_query_cache_set_updates (PkQueryCache *cache, PkResults *results, guint generation)
+{
+	g_return_if_fail (PK_IS_QUERY_CACHE (cache));
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	if (generation != cache->priv->generation) {
+		g_debug ("not keeping the updates, invalidated whilst they were listed");
+		return;
+	}
+
+	g_set_object (&cache->priv->updates, results);
+	cache->priv->updates_timestamp = g_get_real_time () / G_USEC_PER_SEC;
+	g_signal_emit (cache, signals [SIGNAL_UPDATES_CHANGED], 0);
+}
+
+/**
+ * pk_query_cache_get_updates:
+ *
+ * Return value: (transfer none): the last GetUpdates results, or %NULL
+ **/
+PkResults *
+pk_query_cache_get_updates (PkQueryCache *cache)
+{
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), NULL);
+	return cache->priv->updates;
+}
+
+/**
+ * pk_query_cache_get_updates_timestamp:
+ *
+ * Return value: when the updates were set in seconds since the epoch,
+ * or 0 if there are none
+ **/
+gint64
+pk_query_cache_get_updates_timestamp (PkQueryCache *cache)
+{
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), 0);
+	return cache->priv->updates != NULL ? cache->priv->updates_timestamp : 0;
+}
+
+void
+pk_query_cache_invalidate (PkQueryCache *cache)
+{
+	g_return_if_fail (PK_IS_QUERY_CACHE (cache));
+
+	/* even when empty, a query that is running may be for the old state */
+	cache->priv->generation++;
+	if (cache->priv->updates != NULL) {
+		g_clear_object (&cache->priv->updates);
+		g_signal_emit (cache, signals [SIGNAL_UPDATES_CHANGED], 0);
+	}
+	if (cache->priv->keys.length == 0)
+		return;
+	g_debug ("invalidating %u cached queries", cache->priv->keys.length);
+	g_queue_clear (&cache->priv->keys);
+	g_hash_table_remove_all (cache->priv->hash);
+}
+
+guint
+pk_query_cache_get_size (PkQueryCache *cache)
+{
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), 0);
+	return cache->priv->keys.length;
+}
+
+guint
+pk_query_cache_get_hits (PkQueryCache *cache)
+{
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), 0);
+	return cache->priv->hits;
+}
+
+guint
+pk_query_cache_get_misses (PkQueryCache *cache)
+{
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), 0);
+	return cache->priv->misses;
+}
+
+static GVariant *
+pk_query_cache_value_to_variant (const GValue *value)
+{
+	switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value))) {
+	case G_TYPE_STRING:
+		if (g_value_get_string (value) == NULL)
+			return NULL;
+		return g_variant_new_string (g_value_get_string (value));
+	case G_TYPE_BOOLEAN:
+		return g_variant_new_boolean (g_value_get_boolean (value));
+	case G_TYPE_INT:
+		return g_variant_new_int32 (g_value_get_int (value));
+	case G_TYPE_UINT:
+		return g_variant_new_uint32 (g_value_get_uint (value));
+	case G_TYPE_INT64:
+		return g_variant_new_int64 (g_value_get_int64 (value));
+	case G_TYPE_UINT64:
+		return g_variant_new_uint64 (g_value_get_uint64 (value));
+	case G_TYPE_ENUM:
+		return g_variant_new_int32 (g_value_get_enum (value));
+	case G_TYPE_FLAGS:
+		return g_variant_new_uint32 (g_value_get_flags (value));
+	case G_TYPE_BOXED:
+		if (G_VALUE_TYPE (value) != G_TYPE_STRV || g_value_get_boxed (value) == NULL)
+			return NULL;
+		return g_variant_new_strv (g_value_get_boxed (value), -1);
+	default:
+		return NULL;
+	}
+}
+
+static gboolean
+pk_query_cache_variant_to_value (GVariant *variant, GValue *value)
+{
+	const GVariantType *type = g_variant_get_type (variant);
+
+	switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (value))) {
+	case G_TYPE_STRING:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_STRING))
+			return FALSE;
+		g_value_set_string (value, g_variant_get_string (variant, NULL));
+		return TRUE;
+	case G_TYPE_BOOLEAN:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_BOOLEAN))
+			return FALSE;
+		g_value_set_boolean (value, g_variant_get_boolean (variant));
+		return TRUE;
+	case G_TYPE_INT:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_INT32))
+			return FALSE;
+		g_value_set_int (value, g_variant_get_int32 (variant));
+		return TRUE;
+	case G_TYPE_UINT:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_UINT32))
+			return FALSE;
+		g_value_set_uint (value, g_variant_get_uint32 (variant));
+		return TRUE;
+	case G_TYPE_INT64:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_INT64))
+			return FALSE;
+		g_value_set_int64 (value, g_variant_get_int64 (variant));
+		return TRUE;
+	case G_TYPE_UINT64:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_UINT64))
+			return FALSE;
+		g_value_set_uint64 (value, g_variant_get_uint64 (variant));
+		return TRUE;
+	case G_TYPE_ENUM:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_INT32))
+			return FALSE;
+		g_value_set_enum (value, g_variant_get_int32 (variant));
+		return TRUE;
+	case G_TYPE_FLAGS:
+		if (!g_variant_type_equal (type, G_VARIANT_TYPE_UINT32))
+			return FALSE;
+		g_value_set_flags (value, g_variant_get_uint32 (variant));
+		return TRUE;
+	case G_TYPE_BOXED:
+		if (G_VALUE_TYPE (value) != G_TYPE_STRV ||
+		    !g_variant_type_equal (type, G_VARIANT_TYPE_STRING_ARRAY))
+			return FALSE;
+		g_value_take_boxed (value, g_variant_dup_strv (variant, NULL));
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * The result objects are stored using their writable properties, so new
+ * fields are picked up without changing the file layout; the package-id
+ * is only readable and is stored separately.
+ */
+static GVariant *
+pk_query_cache_object_to_variant (GObject *object)
+{
+	GVariantBuilder builder;
+	guint i;
+	guint n_pspecs = 0;
+	g_autofree GParamSpec **pspecs = NULL;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+	if (PK_IS_PACKAGE (object)) {
+		g_variant_builder_add (&builder, "{sv}", "package-id",
+				       g_variant_new_string (pk_package_get_id (PK_PACKAGE (object))));
+	}
+	pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (object), &n_pspecs);
+	for (i = 0; i < n_pspecs; i++) {
+		GVariant *variant;
+		g_auto(GValue) value = G_VALUE_INIT;
+
+		if ((pspecs[i]->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+		    (pspecs[i]->flags & G_PARAM_CONSTRUCT_ONLY) != 0)
+			continue;
+		g_value_init (&value, pspecs[i]->value_type);
+		g_object_get_property (object, pspecs[i]->name, &value);
+		variant = pk_query_cache_value_to_variant (&value);
+		if (variant != NULL)
+			g_variant_builder_add (&builder, "{sv}", pspecs[i]->name, variant);
+	}
+	return g_variant_builder_end (&builder);
+}
+
+static gboolean
+pk_query_cache_object_from_variant (GObject *object, GVariant *dict)
+{
+	GVariantIter iter;
+	const gchar *name;
+	GVariant *variant;
+
+	g_variant_iter_init (&iter, dict);
+	while (g_variant_iter_next (&iter, "{&sv}", &name, &variant)) {
+		GParamSpec *pspec;
+		g_auto(GValue) value = G_VALUE_INIT;
+		g_autoptr(GVariant) variant_auto = variant;
+
+		if (PK_IS_PACKAGE (object) && g_strcmp0 (name, "package-id") == 0) {
+			if (!g_variant_is_of_type (variant, G_VARIANT_TYPE_STRING))
+				return FALSE;
+			if (!pk_package_set_id (PK_PACKAGE (object),
+						g_variant_get_string (variant, NULL),
+						NULL))
+				return FALSE;
+			continue;
+		}
+
+		/* ignore anything that has since been removed */
+		pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (object), name);
+		if (pspec == NULL || (pspec->flags & G_PARAM_WRITABLE) == 0)
+			continue;
+		g_value_init (&value, pspec->value_type);
+		if (!pk_query_cache_variant_to_value (variant, &value))
+			return FALSE;
+		g_object_set_property (object, name, &value);
+	}
+	return TRUE;
+}
+
+static GVariant *
+pk_query_cache_array_to_variant (GPtrArray *array)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+	for (i = 0; i < array->len; i++) {
+		g_variant_builder_add_value (&builder,
+					     pk_query_cache_object_to_variant (g_ptr_array_index (array, i)));
+	}
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * pk_query_cache_save:
+ * @stamp: describes the state of the package database the results were
+ *	   read from, and has to match when loading
+ *
+ * Writes the stored results to @filename so that a new daemon instance
+ * can answer the first queries without loading the backend caches.
+ **/
+gboolean
+pk_query_cache_save (PkQueryCache *cache,
+		     const gchar *filename,
+		     GVariant *stamp,
+		     GError **error)
+{
+	GList *l;
+	GVariantBuilder builder;
+	g_autofree gchar *dirname = NULL;
+	g_autoptr(GVariant) data = NULL;
+
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (stamp != NULL, FALSE);
+
+	/* oldest first, so that loading keeps the eviction order */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(saa{sv}aa{sv}aa{sv}aa{sv}aa{sv}aa{sv})"));
+	for (l = cache->priv->keys.head; l != NULL; l = l->next) {
+		PkResults *results = g_hash_table_lookup (cache->priv->hash, l->data);
+		g_autoptr(GPtrArray) details = pk_results_get_details_array (results);
+		g_autoptr(GPtrArray) packages = pk_results_get_package_array (results);
+		g_autoptr(GPtrArray) update_details = pk_results_get_update_detail_array (results);
+		g_autoptr(GPtrArray) categories = pk_results_get_category_array (results);
+		g_autoptr(GPtrArray) repo_details = pk_results_get_repo_detail_array (results);
+		g_autoptr(GPtrArray) distro_upgrades = pk_results_get_distro_upgrade_array (results);
+
+		g_variant_builder_add (&builder, "(s@aa{sv}@aa{sv}@aa{sv}@aa{sv}@aa{sv}@aa{sv})",
+				       (const gchar *) l->data,
+				       pk_query_cache_array_to_variant (packages),
+				       pk_query_cache_array_to_variant (details),
+				       pk_query_cache_array_to_variant (update_details),
+				       pk_query_cache_array_to_variant (categories),
+				       pk_query_cache_array_to_variant (repo_details),
+				       pk_query_cache_array_to_variant (distro_upgrades));
+	}
+	data = g_variant_ref_sink (g_variant_new (PK_QUERY_CACHE_FILE_TYPE,
+						  PK_QUERY_CACHE_FILE_VERSION,
+						  stamp, &builder));
+	dirname = g_path_get_dirname (filename);
+	if (g_mkdir_with_parents (dirname, 0755) != 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create %s: %s", dirname, g_strerror (errno));
+		return FALSE;
+	}
+	return g_file_set_contents (filename,
+				    g_variant_get_data (data),
+				    (gssize) g_variant_get_size (data),
+				    error);
+}
+
+/**
+ * pk_query_cache_load:
+ * @stamp: the current state of the package database
+ *
+ * Adds the results written by pk_query_cache_save(), as long as they were
+ * read from the same package database described by @stamp.
+ *
+ * Return value: %TRUE if the results were loaded
+ **/
+gboolean
+pk_query_cache_load (PkQueryCache *cache,
+		     const gchar *filename,
+		     GVariant *stamp,
+		     GError **error)
+{
+	gchar *contents = NULL;
+	gsize length = 0;
+	guint version = 0;
+	const gchar *key;
+	GVariant *packages;
+	GVariant *details;
+	GVariant *update_details;
+	GVariant *categories;
+	GVariant *repo_details;
+	GVariant *distro_upgrades;
+	GVariantIter *entries = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GVariant) data = NULL;
+	g_autoptr(GVariant) saved_stamp = NULL;
+
+	g_return_val_if_fail (PK_IS_QUERY_CACHE (cache), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (stamp != NULL, FALSE);
+
+	if (!g_file_get_contents (filename, &contents, &length, error))
+		return FALSE;
+	bytes = g_bytes_new_take (contents, length);
+	data = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (PK_QUERY_CACHE_FILE_TYPE),
+							     bytes, FALSE));
+
+	/* the file may be truncated or from an older daemon */
+	if (!g_variant_is_normal_form (data)) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is not valid", filename);
+		return FALSE;
+	}
+	g_variant_get (data, PK_QUERY_CACHE_FILE_TYPE,
+		       &version, &saved_stamp, &entries);
+	if (version != PK_QUERY_CACHE_FILE_VERSION ||
+	    !g_variant_equal (saved_stamp, stamp)) {
+		g_variant_iter_free (entries);
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "%s is out of date", filename);
+		return FALSE;
+	}
+
+	while (g_variant_iter_next (entries, "(&s@aa{sv}@aa{sv}@aa{sv}@aa{sv}@aa{sv}@aa{sv})",
+				    &key, &packages, &details, &update_details,
+				    &categories, &repo_details, &distro_upgrades)) {
+		GVariantIter iter;
+		GVariant *dict;
+		gboolean ret = TRUE;
+		g_autoptr(PkResults) results = pk_results_new ();
+
+		g_variant_iter_init (&iter, packages);
+		while (ret && (dict = g_variant_iter_next_value (&iter)) != NULL) {
+			g_autoptr(PkPackage) item = pk_package_new ();
+			ret = pk_query_cache_object_from_variant (G_OBJECT (item), dict) &&
+			      pk_results_add_package (results, item);
+			g_variant_unref (dict);
+		}
+		g_variant_iter_init (&iter, details);
+		while (ret && (dict = g_variant_iter_next_value (&iter)) != NULL) {
+			g_autoptr(PkDetails) item = pk_details_new ();
+			ret = pk_query_cache_object_from_variant (G_OBJECT (item), dict) &&
+			      pk_results_add_details (results, item);
+			g_variant_unref (dict);
+		}
+		g_variant_iter_init (&iter, update_details);
+		while (ret && (dict = g_variant_iter_next_value (&iter)) != NULL) {
+			g_autoptr(PkUpdateDetail) item = pk_update_detail_new ();
+			ret = pk_query_cache_object_from_variant (G_OBJECT (item), dict) &&
+			      pk_results_add_update_detail (results, item);
+			g_variant_unref (dict);
+		}
+		g_variant_iter_init (&iter, categories);
+		while (ret && (dict = g_variant_iter_next_value (&iter)) != NULL) {
+			g_autoptr(PkCategory) item = pk_category_new ();
+			ret = pk_query_cache_object_from_variant (G_OBJECT (item), dict) &&
+			      pk_results_add_category (results, item);
+			g_variant_unref (dict);
+		}
+		g_variant_iter_init (&iter, repo_details);
+		while (ret && (dict = g_variant_iter_next_value (&iter)) != NULL) {
+			g_autoptr(PkRepoDetail) item = pk_repo_detail_new ();
+			ret = pk_query_cache_object_from_variant (G_OBJECT (item), dict) &&
+			      pk_results_add_repo_detail (results, item);
+			g_variant_unref (dict);
+		}
+		g_variant_iter_init (&iter, distro_upgrades);
+		while (ret && (dict = g_variant_iter_next_value (&iter)) != NULL) {
+			g_autoptr(PkDistroUpgrade) item = pk_distro_upgrade_new ();
+			ret = pk_query_cache_object_from_variant (G_OBJECT (item), dict) &&
+			      pk_results_add_distro_upgrade (results, item);
+			g_variant_unref (dict);
+		}
+		g_variant_unref (packages);
+		g_variant_unref (details);
+		g_variant_unref (update_details);
+		g_variant_unref (categories);
+		g_variant_unref (repo_details);
+		g_variant_unref (distro_upgrades);
+
+		/* drop just this query rather than failing the rest */
+		if (!ret) {
+			g_warning ("failed to restore cached results for %s", key);
+			continue;
+		}
+		pk_query_cache_insert (cache, key, results, cache->priv->generation);
+	}
+	g_variant_iter_free (entries);
+	return TRUE;
+}
+
+static void
+pk_query_cache_class_init (PkQueryCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_query_cache_finalize;
+
+	signals [SIGNAL_UPDATES_CHANGED] =
+		g_signal_new ("updates-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+
+	g_type_class_add_private (klass, sizeof (PkQueryCachePrivate));
+}
+
+static void
+pk_query_cache_init (PkQueryCache *cache)
+{
+	cache->priv = PK_QUERY_CACHE_GET_PRIVATE (cache);
+	cache->priv->hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, (GDestroyNotify) g_object_unref);
+	g_queue_init (&cache->priv->keys);
+}
+
+static void
+pk_query_cache_finalize (GObject *object)
+{
+	PkQueryCache *cache;
+	g_return_if_fail (PK_IS_QUERY_CACHE (object));
+	cache = PK_QUERY_CACHE (object);
+
+	g_queue_clear (&cache->priv->keys);
+	g_hash_table_unref (cache->priv->hash);
+	g_clear_object (&cache->priv->updates);
+
+	G_OBJECT_CLASS (pk_query_cache_parent_class)->finalize (object);
+}
+
+PkQueryCache *
+pk_query_cache_new (void)
+{
+	PkQueryCache *cache;
+	cache = g_object_new (PK_TYPE_QUERY_CACHE, NULL);
+	return PK_QUERY_CACHE (cache);
+}
@@ -0,0 +1,90 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_QUERY_CACHE_H
+#define __PK_QUERY_CACHE_H
+
+#include <glib-object.h>
+#include <packagekit-glib2/pk-enum.h>
+#include <packagekit-glib2/pk-results.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_QUERY_CACHE		(pk_query_cache_get_type ())
+#define PK_QUERY_CACHE(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_QUERY_CACHE, PkQueryCache))
+#define PK_QUERY_CACHE_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_QUERY_CACHE, PkQueryCacheClass))
+#define PK_IS_QUERY_CACHE(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_QUERY_CACHE))
+#define PK_IS_QUERY_CACHE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_QUERY_CACHE))
+#define PK_QUERY_CACHE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_QUERY_CACHE, PkQueryCacheClass))
+
+typedef struct PkQueryCachePrivate PkQueryCachePrivate;
+
+typedef struct
+{
+	 GObject		 parent;
+	 PkQueryCachePrivate	*priv;
+} PkQueryCache;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkQueryCacheClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkQueryCache, g_object_unref)
+#endif
+
+GType		 pk_query_cache_get_type		(void);
+PkQueryCache	*pk_query_cache_new			(void);
+gboolean	 pk_query_cache_role_is_cacheable	(PkRoleEnum		 role);
+gchar		*pk_query_cache_build_key		(PkRoleEnum		 role,
+							 PkBitfield		 filters,
+							 gchar			**values,
+							 const gchar		*locale)
+							 G_GNUC_WARN_UNUSED_RESULT;
+PkResults	*pk_query_cache_lookup			(PkQueryCache		*cache,
+							 const gchar		*key);
+guint		 pk_query_cache_get_generation		(PkQueryCache		*cache);
+void		 pk_query_cache_insert			(PkQueryCache		*cache,
+							 const gchar		*key,
+							 PkResults		*results,
+							 guint			 generation);
+void		 pk_query_cache_invalidate		(PkQueryCache		*cache);
+void		 pk_query_cache_set_updates		(PkQueryCache		*cache,
+							 PkResults		*results,
+							 guint			 generation);
+PkResults	*pk_query_cache_get_updates		(PkQueryCache		*cache);
+gint64		 pk_query_cache_get_updates_timestamp	(PkQueryCache		*cache);
+gboolean	 pk_query_cache_save			(PkQueryCache		*cache,
+							 const gchar		*filename,
+							 GVariant		*stamp,
+							 GError			**error);
+gboolean	 pk_query_cache_load			(PkQueryCache		*cache,
+							 const gchar		*filename,
+							 GVariant		*stamp,
+							 GError			**error);
+guint		 pk_query_cache_get_size		(PkQueryCache		*cache);
+guint		 pk_query_cache_get_hits		(PkQueryCache		*cache);
+guint		 pk_query_cache_get_misses		(PkQueryCache		*cache);
+
+G_END_DECLS
+
+#endif /* __PK_QUERY_CACHE_H */
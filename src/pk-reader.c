@@ -0,0 +1,421 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * packagekit-reader is started by the daemon when ReaderProcesses is set,
+ * and runs the read-only roles of a backend that is not thread safe in a
+ * process of its own. It speaks the same protocol as the spawned backend
+ * helpers: the first command is on the command line, the next ones arrive
+ * one per line on stdin, and every result is written back as a record.
+ *
+ * A command is: backend, role, filters, values joined by '&', recursive.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <packagekit-glib2/pk-details.h>
+#include <packagekit-glib2/pk-error.h>
+#include <packagekit-glib2/pk-files.h>
+#include <packagekit-glib2/pk-package.h>
+
+#include "pk-backend.h"
+#include "pk-shared.h"
+
+#define PK_READER_RECORD_MARKER		'\0'
+#define PK_READER_FLUSH_SIZE		(64 * 1024)
+
+typedef struct {
+	GMainLoop		*loop;
+	GKeyFile		*conf;
+	PkBackend		*backend;
+	gchar			*backend_name;
+	GString			*out;
+	gint			 out_fd;
+} PkReaderPrivate;
+
+static void
+pk_reader_flush (PkReaderPrivate *priv)
+{
+	gsize done = 0;
+
+	while (done < priv->out->len) {
+		gssize wrote = write (priv->out_fd, priv->out->str + done,
+				      priv->out->len - done);
+		if (wrote < 0 && errno == EINTR)
+			continue;
+		if (wrote <= 0) {
+			/* the daemon has gone away */
+			exit (EXIT_FAILURE);
+		}
+		done += wrote;
+	}
+	g_string_truncate (priv->out, 0);
+}
+
+/* a record is the marker, a big-endian guint32 length, then the fields
+ * separated by NUL */
+static void
+pk_reader_emit (PkReaderPrivate *priv, const gchar *command, ...)
+{
+	const gchar *field;
+	gsize start;
+	guint32 len;
+	va_list args;
+
+	g_string_append_c (priv->out, PK_READER_RECORD_MARKER);
+	start = priv->out->len;
+	g_string_append_len (priv->out, "\0\0\0\0", 4);
+	g_string_append (priv->out, command);
+	va_start (args, command);
+	while ((field = va_arg (args, const gchar *)) != NULL) {
+		g_string_append_c (priv->out, '\0');
+		g_string_append (priv->out, field);
+	}
+	va_end (args);
+
+	len = GUINT32_TO_BE (priv->out->len - start - 4);
+	memcpy (priv->out->str + start, &len, sizeof (len));
+	if (priv->out->len > PK_READER_FLUSH_SIZE)
+		pk_reader_flush (priv);
+}
+
+static void
+pk_reader_finished_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	pk_reader_emit (priv, "finished", NULL);
+	pk_reader_flush (priv);
+	g_main_loop_quit (priv->loop);
+}
+
+static void
+pk_reader_percentage_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	g_autofree gchar *percentage = NULL;
+
+	percentage = g_strdup_printf ("%u", GPOINTER_TO_UINT (object));
+	pk_reader_emit (priv, "percentage", percentage, NULL);
+}
+
+static void
+pk_reader_status_changed_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	pk_reader_emit (priv, "status",
+			pk_status_enum_to_string (GPOINTER_TO_UINT (object)),
+			NULL);
+}
+
+static void
+pk_reader_allow_cancel_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	pk_reader_emit (priv, "allow-cancel",
+			GPOINTER_TO_UINT (object) ? "true" : "false",
+			NULL);
+}
+
+static void
+pk_reader_package_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkPackage *pkg = PK_PACKAGE (object);
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	pk_reader_emit (priv, "package",
+			pk_info_enum_to_string (pk_package_get_info (pkg)),
+			pk_package_get_id (pkg),
+			pk_package_get_summary (pkg),
+			NULL);
+}
+
+static void
+pk_reader_details_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkDetails *details = PK_DETAILS (object);
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	g_autofree gchar *size = NULL;
+
+	size = g_strdup_printf ("%" G_GUINT64_FORMAT, pk_details_get_size (details));
+	pk_reader_emit (priv, "details",
+			pk_details_get_package_id (details),
+			pk_details_get_summary (details) ?: "",
+			pk_details_get_license (details) ?: "",
+			pk_group_enum_to_string (pk_details_get_group (details)),
+			pk_details_get_description (details) ?: "",
+			pk_details_get_url (details) ?: "",
+			size,
+			NULL);
+}
+
+static void
+pk_reader_files_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkFiles *files = PK_FILES (object);
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	g_autofree gchar *joined = NULL;
+
+	joined = g_strjoinv (";", pk_files_get_files (files));
+	pk_reader_emit (priv, "files",
+			pk_files_get_package_id (files),
+			joined,
+			NULL);
+}
+
+static void
+pk_reader_error_cb (PkBackendJob *job, gpointer object, gpointer user_data)
+{
+	PkError *err = PK_ERROR_CODE (object);
+	PkReaderPrivate *priv = (PkReaderPrivate *) user_data;
+	pk_reader_emit (priv, "error",
+			pk_error_enum_to_string (pk_error_get_code (err)),
+			pk_error_get_details (err),
+			NULL);
+}
+
+static void
+pk_reader_fail (PkReaderPrivate *priv, const gchar *details)
+{
+	pk_reader_emit (priv, "error",
+			pk_error_enum_to_string (PK_ERROR_ENUM_INTERNAL_ERROR),
+			details,
+			NULL);
+	pk_reader_emit (priv, "finished", NULL);
+	pk_reader_flush (priv);
+}
+
+/* the daemon passes the job settings in the environment, as for helpers */
+static PkBackendJob *
+pk_reader_job_new (PkReaderPrivate *priv)
+{
+	const gchar *tmp;
+	PkBackendJob *job = pk_backend_job_new (priv->conf);
+
+	pk_backend_job_set_backend (job, priv->backend);
+	tmp = g_getenv ("CACHE_AGE");
+	if (g_strcmp0 (tmp, "-1") == 0)
+		pk_backend_job_set_cache_age (job, G_MAXUINT);
+	else if (tmp != NULL)
+		pk_backend_job_set_cache_age (job, atoi (tmp));
+	tmp = g_getenv ("LANG");
+	if (tmp != NULL)
+		pk_backend_job_set_locale (job, tmp);
+	pk_backend_job_set_background (job, g_strcmp0 (g_getenv ("BACKGROUND"), "TRUE") == 0);
+	tmp = g_getenv ("UID");
+	if (tmp != NULL)
+		pk_backend_job_set_uid (job, atoi (tmp));
+	tmp = g_getenv ("ROOT");
+	if (tmp != NULL && tmp[0] != '\0')
+		pk_backend_job_set_root (job, tmp);
+
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_FINISHED,
+				  pk_reader_finished_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PERCENTAGE,
+				  pk_reader_percentage_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_STATUS_CHANGED,
+				  pk_reader_status_changed_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_ALLOW_CANCEL,
+				  pk_reader_allow_cancel_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_PACKAGE,
+				  pk_reader_package_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_DETAILS,
+				  pk_reader_details_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_FILES,
+				  pk_reader_files_cb, priv);
+	pk_backend_job_set_vfunc (job, PK_BACKEND_SIGNAL_ERROR_CODE,
+				  pk_reader_error_cb, priv);
+	return job;
+}
+
+static gboolean
+pk_reader_load (PkReaderPrivate *priv, const gchar *backend_name, GError **error)
+{
+	const gchar *destdir;
+	g_autofree gchar *conf_filename = NULL;
+
+	/* one reader only ever serves one backend */
+	if (priv->backend != NULL) {
+		if (g_strcmp0 (priv->backend_name, backend_name) == 0)
+			return TRUE;
+		g_set_error (error, 1, 0, "already serving %s", priv->backend_name);
+		return FALSE;
+	}
+
+	priv->conf = g_key_file_new ();
+	conf_filename = pk_util_get_config_filename ();
+	if (!g_key_file_load_from_file (priv->conf, conf_filename,
+					G_KEY_FILE_NONE, error))
+		return FALSE;
+	destdir = g_getenv ("DESTDIR");
+	if (destdir != NULL)
+		g_key_file_set_string (priv->conf, "Daemon", "DestDir", destdir);
+	g_key_file_set_string (priv->conf, "Daemon", "DefaultBackend", backend_name);
+
+	/* the daemon still holds the package database lock */
+	g_key_file_set_boolean (priv->conf, "Daemon", "ReadOnly", TRUE);
+
+	priv->backend = pk_backend_new (priv->conf);
+	if (!pk_backend_load (priv->backend, error)) {
+		g_clear_object (&priv->backend);
+		return FALSE;
+	}
+	priv->backend_name = g_strdup (backend_name);
+	return TRUE;
+}
+
+static void
+pk_reader_run (PkReaderPrivate *priv, gchar **argv)
+{
+	gboolean recursive;
+	PkBitfield filters;
+	PkRoleEnum role;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkBackendJob) job = NULL;
+	g_auto(GStrv) values = NULL;
+
+	if (g_strv_length (argv) != 5) {
+		pk_reader_fail (priv, "expected: backend role filters values recursive");
+		return;
+	}
+	if (!pk_reader_load (priv, argv[0], &error)) {
+		pk_reader_fail (priv, error->message);
+		return;
+	}
+	role = pk_role_enum_from_string (argv[1]);
+	filters = pk_filter_bitfield_from_string (argv[2]);
+	values = g_strsplit (argv[3], "&", -1);
+	recursive = g_strcmp0 (argv[4], "true") == 0;
+
+	job = pk_reader_job_new (priv);
+	pk_backend_start_job (priv->backend, job);
+	switch (role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+		pk_backend_depends_on (priv->backend, job, filters, values, recursive);
+		break;
+	case PK_ROLE_ENUM_GET_DETAILS:
+		pk_backend_get_details (priv->backend, job, values);
+		break;
+	case PK_ROLE_ENUM_GET_FILES:
+		pk_backend_get_files (priv->backend, job, values);
+		break;
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		pk_backend_get_packages (priv->backend, job, filters);
+		break;
+	case PK_ROLE_ENUM_GET_UPDATES:
+		pk_backend_get_updates (priv->backend, job, filters);
+		break;
+	case PK_ROLE_ENUM_REQUIRED_BY:
+		pk_backend_required_by (priv->backend, job, filters, values, recursive);
+		break;
+	case PK_ROLE_ENUM_RESOLVE:
+		pk_backend_resolve (priv->backend, job, filters, values);
+		break;
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+		pk_backend_search_details (priv->backend, job, filters, values);
+		break;
+	case PK_ROLE_ENUM_SEARCH_FILE:
+		pk_backend_search_files (priv->backend, job, filters, values);
+		break;
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+		pk_backend_search_groups (priv->backend, job, filters, values);
+		break;
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		pk_backend_search_names (priv->backend, job, filters, values);
+		break;
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		pk_backend_what_provides (priv->backend, job, filters, values);
+		break;
+	default:
+		pk_backend_stop_job (priv->backend, job);
+		pk_reader_fail (priv, "role is not read-only");
+		return;
+	}
+	g_main_loop_run (priv->loop);
+	pk_backend_stop_job (priv->backend, job);
+}
+
+int
+main (int argc, char *argv[])
+{
+	PkReaderPrivate *priv;
+	gint retval = EXIT_SUCCESS;
+	g_autoptr(GIOChannel) channel = NULL;
+
+	setlocale (LC_ALL, "");
+
+	/* anything the backend prints must not end up in the records */
+	priv = g_new0 (PkReaderPrivate, 1);
+	priv->out_fd = dup (STDOUT_FILENO);
+	if (priv->out_fd < 0 || dup2 (STDERR_FILENO, STDOUT_FILENO) < 0) {
+		g_printerr ("failed to set up stdout: %s\n", g_strerror (errno));
+		return EXIT_FAILURE;
+	}
+	priv->out = g_string_new (NULL);
+	priv->loop = g_main_loop_new (NULL, FALSE);
+
+	/* the first command is on the command line */
+	if (argc > 1)
+		pk_reader_run (priv, &argv[1]);
+
+	/* and the rest on stdin, until told to exit */
+	channel = g_io_channel_unix_new (STDIN_FILENO);
+	for (;;) {
+		gsize term = 0;
+		g_autofree gchar *line = NULL;
+		g_auto(GStrv) sections = NULL;
+		g_autoptr(GError) error = NULL;
+		GIOStatus status;
+
+		status = g_io_channel_read_line (channel, &line, NULL, &term, &error);
+		if (status == G_IO_STATUS_AGAIN)
+			continue;
+		if (status != G_IO_STATUS_NORMAL) {
+			if (error != NULL) {
+				g_printerr ("failed to read command: %s\n", error->message);
+				retval = EXIT_FAILURE;
+			}
+			break;
+		}
+		line[term] = '\0';
+		if (g_strcmp0 (line, "exit") == 0)
+			break;
+		sections = g_strsplit (line, "\t", -1);
+		pk_reader_run (priv, sections);
+	}
+
+	if (priv->backend != NULL) {
+		pk_backend_unload (priv->backend);
+		g_object_unref (priv->backend);
+	}
+	if (priv->conf != NULL)
+		g_key_file_unref (priv->conf);
+	g_main_loop_unref (priv->loop);
+	g_string_free (priv->out, TRUE);
+	g_free (priv->backend_name);
+	g_free (priv);
+	return retval;
+}
@@ -61,6 +61,7 @@
 
 #include <glib/gi18n.h>
 #include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-common-private.h>
 
 #include "pk-shared.h"
 #include "pk-transaction.h"
@@ -71,7 +72,7 @@ static void     pk_scheduler_finalize	(GObject	*object);
 
 #define PK_SCHEDULER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SCHEDULER, PkSchedulerPrivate))
 
-/* the interval between each CST, in seconds */
+/* the interval between each CST while transactions exist, in seconds */
 #define PK_TRANSACTION_WEDGE_CHECK			10
 
 /* How long the transaction should be queriable after it is finished */
@@ -86,13 +87,63 @@ static void     pk_scheduler_finalize	(GObject	*object);
 /* maximum number of requests a given user is able to request and queue */
 #define PK_SCHEDULER_SIMULTANEOUS_TRANSACTIONS_FOR_UID	500
 
+/* how many transactions a user starts from a queue before the next user */
+#define PK_SCHEDULER_DEFAULT_UID_QUANTUM		1
+
+/* default priorities of the ready queues, higher runs first */
+#define PK_SCHEDULER_DEFAULT_PRIORITY_INTERACTIVE	20
+#define PK_SCHEDULER_DEFAULT_PRIORITY_NORMAL		10
+#define PK_SCHEDULER_DEFAULT_PRIORITY_BACKGROUND	0
+
+/* a waiting transaction gains one priority point per interval */
+#define PK_SCHEDULER_DEFAULT_AGING_INTERVAL		10 /* s */
+
+typedef enum {
+	PK_SCHEDULER_QUEUE_INTERACTIVE,
+	PK_SCHEDULER_QUEUE_NORMAL,
+	PK_SCHEDULER_QUEUE_BACKGROUND,
+	PK_SCHEDULER_QUEUE_LAST
+} PkSchedulerQueue;
+
+/* the transactions of one user waiting in one ready queue */
+typedef struct {
+	GQueue			 items;		/* PkSchedulerItem */
+	GList			*link;		/* in the ready queue, or NULL */
+	guint			 served;	/* since it was last rotated */
+} PkSchedulerFlow;
+
+typedef struct {
+	guint			 uid;
+	guint			 transactions;	/* created and not yet removed */
+	PkSchedulerFlow		 flows[PK_SCHEDULER_QUEUE_LAST][2];
+} PkSchedulerUser;
+
 struct PkSchedulerPrivate
 {
 	GPtrArray		*array;
+	GPtrArray		*running;
+	GPtrArray		*jobs;		/* PkBackendJob the daemon runs itself */
+	GPtrArray		*jobs_preemptible;
+	GQueue			 ready[PK_SCHEDULER_QUEUE_LAST][2];	/* PkSchedulerFlow, [queue][exclusive] */
+	guint			 ready_len[PK_SCHEDULER_QUEUE_LAST][2];
+	GHashTable		*users;		/* uid:PkSchedulerUser */
+	guint			 uid_quantum;
+	guint			 uid_max_transactions;
+	gint			 priority[PK_SCHEDULER_QUEUE_LAST];
+	guint			 aging_interval;
 	guint			 unwedge_id;
 	GKeyFile		*conf;
 	PkBackend		*backend;
+	PkQueryCache		*query_cache;
+	PkPlanCache		*plan_cache;
+	PkSearchSessions	*search_sessions;
+	PkAuthCache		*auth_cache;
+	PkMetrics		*metrics;
 	GDBusNodeInfo		*introspection;
+	GHashTable		*listed;	/* tid, as last announced */
+	GHashTable		*tids;		/* tid : PkSchedulerItem */
+	GDBusConnection		*connection;
+	guint			 subtree_id;
 };
 
 typedef struct {
@@ -106,16 +157,68 @@ typedef struct {
 	gulong			 state_changed_id;
 	gulong			 allow_cancel_changed_id;
 	guint			 uid;
+	PkSchedulerUser		*user;
 	guint			 tries;
+	PkSchedulerQueue	 queue;
+	gboolean		 queued_exclusive;
+	GList			*ready_link;
+	gint64			 ready_time;
+	gint64			 deadline;	/* monotonic, G_MAXINT64 for none */
+	gint64			 created_time;	/* monotonic, in us */
+	gint64			 run_time;	/* monotonic, in us */
+	gchar			*query_key;
+	gchar			*coalesce_key;
+	gboolean		 coalesced;	/* merged into the leader */
+	gboolean		 leased;
+	gpointer		 leader;	/* PkSchedulerItem */
+	GPtrArray		*subscribers;	/* PkSchedulerItem */
 } PkSchedulerItem;
 
 enum {
 	PK_SCHEDULER_CHANGED,
+	PK_SCHEDULER_TRANSACTION_ADDED,
+	PK_SCHEDULER_TRANSACTION_REMOVED,
 	PK_SCHEDULER_LAST_SIGNAL
 };
 
 static guint signals [PK_SCHEDULER_LAST_SIGNAL] = { 0 };
 
+/**
+ * pk_scheduler_emit_changed:
+ *
+ * Announces the transactions that were committed or finished since the
+ * last change, so that clients do not have to diff the whole list, and
+ * then that the list changed.
+ **/
+static void
+pk_scheduler_emit_changed (PkScheduler *scheduler)
+{
+	GHashTableIter iter;
+	gpointer key;
+	g_autoptr(GHashTable) listed = NULL;
+
+	listed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (guint i = 0; i < scheduler->priv->array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (scheduler->priv->array, i);
+		PkTransactionState state = pk_transaction_get_state (item->transaction);
+		if (state != PK_TRANSACTION_STATE_READY &&
+		    state != PK_TRANSACTION_STATE_RUNNING)
+			continue;
+		g_hash_table_add (listed, g_strdup (item->tid));
+		if (!g_hash_table_contains (scheduler->priv->listed, item->tid))
+			g_signal_emit (scheduler, signals [PK_SCHEDULER_TRANSACTION_ADDED], 0, item->tid);
+	}
+	g_hash_table_iter_init (&iter, scheduler->priv->listed);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (!g_hash_table_contains (listed, key))
+			g_signal_emit (scheduler, signals [PK_SCHEDULER_TRANSACTION_REMOVED], 0, key);
+	}
+	g_hash_table_unref (scheduler->priv->listed);
+	scheduler->priv->listed = g_steal_pointer (&listed);
+
+	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
+}
+
 G_DEFINE_TYPE (PkScheduler, pk_scheduler, G_TYPE_OBJECT)
 
 /**
@@ -124,23 +227,12 @@ G_DEFINE_TYPE (PkScheduler, pk_scheduler, G_TYPE_OBJECT)
 static PkSchedulerItem *
 pk_scheduler_get_from_tid (PkScheduler *scheduler, const gchar *tid)
 {
-	guint i;
-	GPtrArray *array;
-	PkSchedulerItem *item;
-	const gchar *tmptid;
-
 	g_return_val_if_fail (scheduler != NULL, NULL);
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
 
-	/* find the runner with the transaction ID */
-	array = scheduler->priv->array;
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		tmptid = pk_transaction_get_tid (item->transaction);
-		if (g_strcmp0 (tmptid, tid) == 0)
-			return item;
-	}
-	return NULL;
+	if (tid == NULL)
+		return NULL;
+	return g_hash_table_lookup (scheduler->priv->tids, tid);
 }
 
 PkTransaction *
@@ -206,6 +298,9 @@ pk_scheduler_item_free (PkSchedulerItem *item)
 	if (item->remove_id != 0)
 		g_source_remove (item->remove_id);
 	g_object_unref (item->scheduler);
+	g_ptr_array_unref (item->subscribers);
+	g_free (item->query_key);
+	g_free (item->coalesce_key);
 	g_free (item->tid);
 	g_free (item);
 }
@@ -216,6 +311,262 @@ pk_scheduler_item_free_cb (PkSchedulerItem *item, gpointer user_data)
 	pk_scheduler_item_free (item);
 }
 
+static const gchar *
+pk_scheduler_queue_to_string (PkSchedulerQueue queue)
+{
+	if (queue == PK_SCHEDULER_QUEUE_INTERACTIVE)
+		return "interactive";
+	if (queue == PK_SCHEDULER_QUEUE_NORMAL)
+		return "normal";
+	if (queue == PK_SCHEDULER_QUEUE_BACKGROUND)
+		return "background";
+	return NULL;
+}
+
+static PkSchedulerQueue
+pk_scheduler_item_get_queue (PkSchedulerItem *item)
+{
+	PkBackendJob *job;
+
+	if (pk_transaction_get_background (item->transaction))
+		return PK_SCHEDULER_QUEUE_BACKGROUND;
+	job = pk_transaction_get_backend_job (item->transaction);
+	if (job != NULL && pk_backend_job_get_interactive (job))
+		return PK_SCHEDULER_QUEUE_INTERACTIVE;
+	return PK_SCHEDULER_QUEUE_NORMAL;
+}
+
+/**
+ * pk_scheduler_item_get_priority:
+ *
+ * Return value: the priority of the queue the item is waiting in, raised
+ * by how long it has been waiting so that no queue can starve.
+ **/
+static gint64
+pk_scheduler_item_get_priority (PkScheduler *scheduler,
+				PkSchedulerItem *item,
+				gint64 now)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+	gint64 priority = priv->priority[item->queue];
+
+	if (priv->aging_interval > 0) {
+		priority += (now - item->ready_time) /
+			    ((gint64) priv->aging_interval * G_USEC_PER_SEC);
+	}
+	return priority;
+}
+
+static PkSchedulerUser *
+pk_scheduler_user_ref (PkScheduler *scheduler, guint uid)
+{
+	PkSchedulerUser *user;
+
+	user = g_hash_table_lookup (scheduler->priv->users, GUINT_TO_POINTER (uid));
+	if (user == NULL) {
+		user = g_new0 (PkSchedulerUser, 1);
+		user->uid = uid;
+		g_hash_table_insert (scheduler->priv->users, GUINT_TO_POINTER (uid), user);
+	}
+	user->transactions++;
+	return user;
+}
+
+static void
+pk_scheduler_user_unref (PkScheduler *scheduler, PkSchedulerUser *user)
+{
+	if (--user->transactions > 0)
+		return;
+	g_hash_table_remove (scheduler->priv->users, GUINT_TO_POINTER (user->uid));
+}
+
+/**
+ * pk_scheduler_enqueue:
+ *
+ * Each ready queue holds one flow per user with something waiting in it,
+ * and each flow is in order of the deadline-ms hint, then FIFO. The flows
+ * take turns at the head of the queue, so a user queueing thousands of
+ * requests only delays the others by uid_quantum transactions each time.
+ **/
+static void
+pk_scheduler_enqueue (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkBackendJob *job;
+	PkSchedulerFlow *flow;
+	GQueue *queue;
+	GList *l;
+
+	/* already waiting */
+	if (item->ready_link != NULL)
+		return;
+
+	item->queue = pk_scheduler_item_get_queue (item);
+	item->queued_exclusive = pk_transaction_is_exclusive (item->transaction);
+	item->ready_time = g_get_monotonic_time ();
+	job = pk_transaction_get_backend_job (item->transaction);
+	item->deadline = job != NULL ? pk_backend_job_get_deadline (job) : 0;
+	if (item->deadline == 0)
+		item->deadline = G_MAXINT64;
+
+	/* behind everything due no later, so usually just the tail */
+	flow = &item->user->flows[item->queue][item->queued_exclusive];
+	for (l = flow->items.tail; l != NULL; l = l->prev) {
+		PkSchedulerItem *tmp = l->data;
+		if (tmp->deadline <= item->deadline)
+			break;
+	}
+	if (l == NULL) {
+		g_queue_push_head (&flow->items, item);
+		item->ready_link = g_queue_peek_head_link (&flow->items);
+	} else {
+		g_queue_insert_after (&flow->items, l, item);
+		item->ready_link = l->next;
+	}
+	if (flow->link == NULL) {
+		queue = &scheduler->priv->ready[item->queue][item->queued_exclusive];
+		g_queue_push_tail (queue, flow);
+		flow->link = g_queue_peek_tail_link (queue);
+		flow->served = 0;
+	}
+	scheduler->priv->ready_len[item->queue][item->queued_exclusive]++;
+	g_debug ("queued %s as %s for uid %u", item->tid,
+		 pk_scheduler_queue_to_string (item->queue), item->uid);
+}
+
+static void
+pk_scheduler_dequeue (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerFlow *flow;
+	GQueue *queue;
+
+	if (item->ready_link == NULL)
+		return;
+	flow = &item->user->flows[item->queue][item->queued_exclusive];
+	queue = &scheduler->priv->ready[item->queue][item->queued_exclusive];
+	g_queue_delete_link (&flow->items, item->ready_link);
+	item->ready_link = NULL;
+	scheduler->priv->ready_len[item->queue][item->queued_exclusive]--;
+
+	/* nothing left for this user */
+	if (flow->items.length == 0) {
+		g_queue_delete_link (queue, flow->link);
+		flow->link = NULL;
+	}
+}
+
+static void
+pk_scheduler_flow_served (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerFlow *flow = &item->user->flows[item->queue][item->queued_exclusive];
+	GQueue *queue = &scheduler->priv->ready[item->queue][item->queued_exclusive];
+
+	/* had its turn, let the next user go first */
+	if (flow->link == NULL)
+		return;
+	if (++flow->served < scheduler->priv->uid_quantum)
+		return;
+	g_queue_unlink (queue, flow->link);
+	g_queue_push_tail_link (queue, flow->link);
+	flow->served = 0;
+}
+
+static void pk_scheduler_commit_item (PkScheduler *scheduler, PkSchedulerItem *item);
+static void pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item);
+static void pk_scheduler_serve_queued_before_refresh (PkScheduler *scheduler);
+static gboolean pk_scheduler_check_invariants (PkScheduler *scheduler);
+static void pk_scheduler_wedge_check_update (PkScheduler *scheduler);
+
+/**
+ * pk_scheduler_get_leader:
+ *
+ * Return value: a transaction asking exactly the same query that is
+ * waiting or already running, or %NULL
+ **/
+static PkSchedulerItem *
+pk_scheduler_get_leader (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	GPtrArray *array = scheduler->priv->array;
+	PkSchedulerItem *tmp;
+	PkTransactionState state;
+	guint i;
+
+	if (item->query_key == NULL)
+		return NULL;
+	for (i = 0; i < array->len; i++) {
+		tmp = g_ptr_array_index (array, i);
+		if (tmp == item || tmp->leader != NULL || tmp->query_key == NULL)
+			continue;
+		state = pk_transaction_get_state (tmp->transaction);
+		if (state != PK_TRANSACTION_STATE_READY &&
+		    state != PK_TRANSACTION_STATE_RUNNING)
+			continue;
+		if (g_strcmp0 (tmp->query_key, item->query_key) == 0)
+			return tmp;
+	}
+	return NULL;
+}
+
+static void
+pk_scheduler_detach_subscriber (PkSchedulerItem *item)
+{
+	PkSchedulerItem *leader = item->leader;
+
+	if (leader == NULL)
+		return;
+	g_ptr_array_remove (leader->subscribers, item);
+	item->leader = NULL;
+}
+
+/**
+ * pk_scheduler_release_subscribers:
+ *
+ * Fans the results of @item out to every transaction that was waiting
+ * for it, or lets them run on their own if @item did not succeed.
+ **/
+static void
+pk_scheduler_release_subscribers (PkScheduler *scheduler,
+				  PkSchedulerItem *item,
+				  gboolean success)
+{
+	PkResults *results = pk_transaction_get_results (item->transaction);
+	PkSchedulerItem *subscriber;
+	g_autoptr(GPtrArray) subscribers = NULL;
+	guint i;
+
+	if (item->subscribers->len == 0)
+		return;
+
+	/* the callbacks may add or remove subscribers */
+	subscribers = g_ptr_array_new ();
+	for (i = 0; i < item->subscribers->len; i++)
+		g_ptr_array_add (subscribers, g_ptr_array_index (item->subscribers, i));
+	g_ptr_array_set_size (item->subscribers, 0);
+
+	for (i = 0; i < subscribers->len; i++) {
+		subscriber = g_ptr_array_index (subscribers, i);
+		subscriber->leader = NULL;
+		if (success && subscriber->coalesced) {
+			g_autoptr(PkResults) own = NULL;
+			g_debug ("reporting the packages of %s from %s",
+				 subscriber->tid, item->tid);
+			own = pk_transaction_get_coalesced_results (item->transaction,
+								    subscriber->transaction);
+			pk_transaction_set_shared_results (subscriber->transaction, own);
+			pk_scheduler_run_item (scheduler, subscriber);
+			continue;
+		}
+		if (success) {
+			g_debug ("sharing results of %s with %s",
+				 item->tid, subscriber->tid);
+			pk_transaction_set_shared_results (subscriber->transaction, results);
+			pk_scheduler_run_item (scheduler, subscriber);
+			continue;
+		}
+		subscriber->coalesced = FALSE;
+		pk_scheduler_commit_item (scheduler, subscriber);
+	}
+}
+
 static gboolean
 pk_scheduler_remove_internal (PkScheduler *scheduler, PkSchedulerItem *item)
 {
@@ -224,13 +575,23 @@ pk_scheduler_remove_internal (PkScheduler *scheduler, PkSchedulerItem *item)
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), FALSE);
 	g_return_val_if_fail (item != NULL, FALSE);
 
+	/* not waiting or running any more */
+	pk_scheduler_dequeue (scheduler, item);
+	pk_scheduler_detach_subscriber (item);
+	g_ptr_array_remove (scheduler->priv->running, item);
+	pk_scheduler_release_subscribers (scheduler, item, FALSE);
+
 	/* valid item */
 	ret = g_ptr_array_remove (scheduler->priv->array, item);
 	if (!ret) {
 		g_warning ("could not remove %p as not present in list", item);
 		return FALSE;
 	}
+	g_hash_table_remove (scheduler->priv->tids, item->tid);
+	pk_scheduler_user_unref (scheduler, item->user);
 	pk_scheduler_item_free (item);
+	pk_scheduler_check_invariants (scheduler);
+	pk_scheduler_wedge_check_update (scheduler);
 
 	return TRUE;
 }
@@ -287,6 +648,16 @@ static gboolean
 pk_scheduler_run_idle_cb (PkSchedulerItem *item)
 {
 	gboolean ret;
+	PkScheduler *scheduler = item->scheduler;
+
+	/* how long did we sit in the queue */
+	item->run_time = g_get_monotonic_time ();
+	if (scheduler->priv->metrics != NULL) {
+		pk_metrics_record (scheduler->priv->metrics,
+				   pk_transaction_get_role (item->transaction),
+				   PK_METRICS_HISTOGRAM_QUEUE_WAIT,
+				   item->run_time - item->created_time);
+	}
 
 	/* run the transaction */
 	pk_transaction_set_backend (item->transaction,
@@ -300,39 +671,85 @@ pk_scheduler_run_idle_cb (PkSchedulerItem *item)
 	return FALSE;
 }
 
+/**
+ * pk_scheduler_coalesce:
+ *
+ * Merges the transactions @item's user queued with the same coalesce key
+ * into @item, so that the backend solves and commits them once. They wait
+ * like subscribers and get their own packages when @item succeeded, or
+ * are run one by one if it did not.
+ **/
+static void
+pk_scheduler_coalesce (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerItem *tmp;
+	gboolean background = pk_transaction_get_background (item->transaction);
+	g_autoptr(GPtrArray) followers = g_ptr_array_new ();
+	GList *l;
+	guint i;
+	guint exclusive;
+
+	if (item->coalesce_key == NULL || item->leader != NULL)
+		return;
+
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		for (exclusive = 0; exclusive < 2; exclusive++) {
+			for (l = item->user->flows[i][exclusive].items.head; l != NULL; l = l->next) {
+				tmp = l->data;
+				if (tmp == item || tmp->subscribers->len > 0)
+					continue;
+				if (g_strcmp0 (tmp->coalesce_key, item->coalesce_key) != 0)
+					continue;
+				if (pk_transaction_get_background (tmp->transaction) != background)
+					continue;
+				g_ptr_array_add (followers, tmp);
+			}
+		}
+	}
+
+	for (i = 0; i < followers->len; i++) {
+		tmp = g_ptr_array_index (followers, i);
+		pk_scheduler_dequeue (scheduler, tmp);
+		pk_transaction_coalesce (item->transaction, tmp->transaction);
+		pk_transaction_set_coalesce (tmp->transaction, FALSE);
+		g_clear_pointer (&tmp->coalesce_key, g_free);
+		tmp->coalesced = TRUE;
+		tmp->leader = item;
+		g_ptr_array_add (item->subscribers, tmp);
+	}
+}
+
 static void
 pk_scheduler_run_item (PkScheduler *scheduler, PkSchedulerItem *item)
 {
+	/* take the compatible queued transactions along */
+	pk_scheduler_coalesce (scheduler, item);
+
+	/* move from the ready queue to the running set */
+	if (item->ready_link != NULL) {
+		pk_scheduler_dequeue (scheduler, item);
+		pk_scheduler_flow_served (scheduler, item);
+	}
+	g_ptr_array_add (scheduler->priv->running, item);
+
 	/* we set this here so that we don't try starting more than one */
 	pk_transaction_set_state (item->transaction, PK_TRANSACTION_STATE_RUNNING);
 
 	/* add this idle, so that we don't have a deep out-of-order callchain */
 	item->idle_id = g_idle_add ((GSourceFunc) pk_scheduler_run_idle_cb, item);
 	g_source_set_name_by_id (item->idle_id, "[PkScheduler] run");
+
+	/* the queries already waiting for the backend need not wait for the
+	 * download either */
+	if (pk_transaction_get_role (item->transaction) == PK_ROLE_ENUM_REFRESH_CACHE)
+		pk_scheduler_serve_queued_before_refresh (scheduler);
 }
 
 static GPtrArray *
 pk_scheduler_get_active_transactions (PkScheduler *scheduler)
 {
-	guint i;
-	GPtrArray *array;
-	GPtrArray *res;
-	PkSchedulerItem *item;
-
 	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
-
-	/* create array to store the results */
-	res = g_ptr_array_new ();
-
-	/* find the runner with the transaction ID */
-	array = scheduler->priv->array;
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		if (pk_transaction_get_state (item->transaction) == PK_TRANSACTION_STATE_RUNNING)
-			g_ptr_array_add (res, item);
-	}
-
-	return res;
+	return g_ptr_array_ref (scheduler->priv->running);
 }
 
 /**
@@ -392,62 +809,266 @@ pk_scheduler_get_background_running (PkScheduler *scheduler)
 	return FALSE;
 }
 
-static PkSchedulerItem *
-pk_scheduler_get_next_item (PkScheduler *scheduler)
+static guint
+pk_scheduler_get_waiting (PkScheduler *scheduler)
 {
-	PkSchedulerItem *item = NULL;
-	GPtrArray *array;
 	guint i;
-	PkTransactionState state;
-	gboolean exclusive_running;
+	guint waiting = 0;
 
-	array = scheduler->priv->array;
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		waiting += scheduler->priv->ready_len[i][FALSE];
+		waiting += scheduler->priv->ready_len[i][TRUE];
+	}
+	return waiting;
+}
 
-	/* check for running exclusive transaction */
-	exclusive_running = pk_scheduler_get_exclusive_running (scheduler) > 0;
+static guint
+pk_scheduler_get_exclusive_waiting (PkScheduler *scheduler)
+{
+	guint i;
+	guint waiting = 0;
 
-	/* first try the waiting non-background transactions */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		state = pk_transaction_get_state (item->transaction);
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++)
+		waiting += scheduler->priv->ready_len[i][TRUE];
+	return waiting;
+}
 
-		if ((state == PK_TRANSACTION_STATE_READY) && (!pk_transaction_get_background (item->transaction))) {
-			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
-				goto out;
+/**
+ * pk_scheduler_item_can_run:
+ *
+ * If the backend supports parallelization only exclusive transactions
+ * have to wait for each other. Otherwise the backend lock is shared by
+ * the reader roles it declares and taken exclusively by everything else,
+ * with waiting writers holding back new readers so they cannot starve.
+ **/
+static gboolean
+pk_scheduler_item_can_run (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	gboolean exclusive = pk_transaction_is_exclusive (item->transaction);
+	gboolean parallel = pk_backend_supports_parallelization (scheduler->priv->backend);
+
+	/* a job of the daemon holds the backend until it finishes */
+	if (!parallel && scheduler->priv->jobs->len > 0)
+		return FALSE;
+
+	/* only a parallel backend can run anything next to a writer */
+	if (pk_scheduler_get_exclusive_running (scheduler) > 0)
+		return parallel && !exclusive;
+	if (exclusive)
+		return parallel || scheduler->priv->running->len == 0;
+	if (parallel)
+		return TRUE;
+	return pk_scheduler_get_exclusive_waiting (scheduler) == 0;
+}
+
+/**
+ * pk_scheduler_get_next_item:
+ *
+ * Only the head of each ready queue has to be looked at: that is the
+ * oldest transaction of the user whose turn it is.
+ **/
+static PkSchedulerItem *
+pk_scheduler_get_next_item (PkScheduler *scheduler)
+{
+	PkSchedulerItem *best = NULL;
+	PkSchedulerItem *item;
+	PkSchedulerFlow *flow;
+	gint64 best_priority = 0;
+	gint64 now;
+	gint64 priority;
+	guint exclusive;
+	guint i;
+
+	now = g_get_monotonic_time ();
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		for (exclusive = 0; exclusive < 2; exclusive++) {
+			flow = g_queue_peek_head (&scheduler->priv->ready[i][exclusive]);
+			if (flow == NULL)
+				continue;
+			item = g_queue_peek_head (&flow->items);
+
+			/* we need to wait for the lock release */
+			if (!pk_scheduler_item_can_run (scheduler, item))
+				continue;
+
+			/* the higher priority, the earliest deadline, then
+			 * the oldest wins */
+			priority = pk_scheduler_item_get_priority (scheduler, item, now);
+			if (best == NULL ||
+			    priority > best_priority ||
+			    (priority == best_priority &&
+			     item->deadline < best->deadline) ||
+			    (priority == best_priority &&
+			     item->deadline == best->deadline &&
+			     item->ready_time < best->ready_time)) {
+				best = item;
+				best_priority = priority;
 			}
 		}
 	}
+	return best;
+}
 
-	/* then try the other waiting transactions (background tasks) */
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		state = pk_transaction_get_state (item->transaction);
+/**
+ * pk_scheduler_check_invariants:
+ *
+ * Run on every change of the ready queues or the running set, so this
+ * only looks at the counters they keep and the (short) running set.
+ * Only a finishing transaction starts the queued ones, so if something is
+ * waiting with nothing running the daemon is wedged: start it ourselves.
+ **/
+static gboolean
+pk_scheduler_check_invariants (PkScheduler *scheduler)
+{
+	PkSchedulerItem *item;
+	guint running = scheduler->priv->running->len;
+	guint waiting = pk_scheduler_get_waiting (scheduler);
+	guint running_exclusive;
 
-		if (state == PK_TRANSACTION_STATE_READY) {
-			/* check if we can run the transaction now or if we need to wait for lock release */
-			if (pk_transaction_is_exclusive (item->transaction)) {
-				if (!exclusive_running)
-					goto out;
-			} else {
-				goto out;
-			}
+	if (running + waiting > scheduler->priv->array->len) {
+		g_warning ("%u running and %u waiting but only %u transactions",
+			   running, waiting, scheduler->priv->array->len);
+		return FALSE;
+	}
+
+	running_exclusive = pk_scheduler_get_exclusive_running (scheduler);
+	if (running_exclusive > 1) {
+		g_warning ("%u exclusive transactions running", running_exclusive);
+		return FALSE;
+	}
+
+	if (waiting > 0 && running == 0 && scheduler->priv->jobs->len == 0) {
+		g_warning ("%u transactions waiting with nothing running, unwedging",
+			   waiting);
+		while ((item = pk_scheduler_get_next_item (scheduler)) != NULL)
+			pk_scheduler_run_item (scheduler, item);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_scheduler_serve_before_refresh:
+ *
+ * A running RefreshCache holds the backend for the whole download, so a
+ * query whose results from before it are still cached is answered with
+ * those when its cache age allows, rather than waiting behind it. The
+ * replay does not touch the backend, so it does not need the lock.
+ *
+ * Return value: %TRUE if @item was started with the cached results
+ **/
+static gboolean
+pk_scheduler_serve_before_refresh (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	PkSchedulerItem *tmp;
+	gboolean refreshing = FALSE;
+	guint i;
+	g_autoptr(PkResults) results = NULL;
+
+	if (pk_transaction_is_exclusive (item->transaction))
+		return FALSE;
+	for (i = 0; i < scheduler->priv->running->len && !refreshing; i++) {
+		tmp = g_ptr_array_index (scheduler->priv->running, i);
+		refreshing = pk_transaction_get_role (tmp->transaction) == PK_ROLE_ENUM_REFRESH_CACHE;
+	}
+	if (!refreshing)
+		return FALSE;
+	results = pk_transaction_get_results_before_refresh (item->transaction);
+	if (results == NULL)
+		return FALSE;
+
+	g_debug ("answering %s from before the running refresh", item->tid);
+	pk_transaction_set_shared_results (item->transaction, results);
+	pk_scheduler_run_item (scheduler, item);
+	return TRUE;
+}
+
+/**
+ * pk_scheduler_serve_queued_before_refresh:
+ *
+ * Called when a RefreshCache starts, so that the queries queued before it
+ * are treated like the ones committed while it runs.
+ **/
+static void
+pk_scheduler_serve_queued_before_refresh (PkScheduler *scheduler)
+{
+	PkSchedulerItem *item;
+	g_autoptr(GPtrArray) waiting = g_ptr_array_new ();
+
+	/* serving one dequeues it, and maybe others it coalesces with */
+	for (guint i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		for (GList *l = scheduler->priv->ready[i][FALSE].head; l != NULL; l = l->next) {
+			PkSchedulerFlow *flow = l->data;
+			for (GList *j = flow->items.head; j != NULL; j = j->next)
+				g_ptr_array_add (waiting, j->data);
 		}
 	}
+	for (guint i = 0; i < waiting->len; i++) {
+		item = g_ptr_array_index (waiting, i);
+		if (item->ready_link == NULL)
+			continue;
+		pk_scheduler_serve_before_refresh (scheduler, item);
+	}
+}
 
-	/* nothing to run */
-	item = NULL;
-out:
-	return item;
+static void
+pk_scheduler_preempt_jobs (PkScheduler *scheduler)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+
+	if (pk_backend_supports_parallelization (priv->backend))
+		return;
+	if (!pk_backend_is_implemented (priv->backend, PK_ROLE_ENUM_CANCEL))
+		return;
+	for (guint i = 0; i < priv->jobs_preemptible->len; i++) {
+		PkBackendJob *job = g_ptr_array_index (priv->jobs_preemptible, i);
+		if (pk_backend_job_get_is_finished (job))
+			continue;
+		g_debug ("cancelling a background job of the daemon");
+		pk_backend_cancel (priv->backend, job);
+	}
+}
+
+static void
+pk_scheduler_commit_item (PkScheduler *scheduler, PkSchedulerItem *item)
+{
+	/* the previous generation of the metadata may do */
+	if (pk_scheduler_serve_before_refresh (scheduler, item))
+		return;
+
+	/* if the backend does not support parallelization only the roles it
+	 * declares safe to run next to each other may share the lock */
+	if (!pk_backend_supports_parallelization (scheduler->priv->backend)) {
+		PkBitfield reader_roles = pk_backend_get_reader_roles (scheduler->priv->backend);
+		if (!pk_bitfield_contain (reader_roles, pk_transaction_get_role (item->transaction)))
+			pk_transaction_make_exclusive (item->transaction);
+	}
+
+	/* the daemon only downloads in the background whilst nobody asks */
+	pk_scheduler_preempt_jobs (scheduler);
+
+	/* is one of the current running transactions background, and this new
+	 * transaction foreground? */
+	if (!pk_transaction_get_background (item->transaction) &&
+	    pk_scheduler_get_background_running (scheduler)) {
+		g_debug ("cancelling running background transactions and instead running %s",
+			item->tid);
+		pk_scheduler_cancel_background (scheduler);
+	}
+
+	/* do the transaction now, if possible, else wait for the
+	 * backend lock to be released */
+	if (pk_scheduler_item_can_run (scheduler, item))
+		pk_scheduler_run_item (scheduler, item);
+	else
+		pk_scheduler_enqueue (scheduler, item);
 }
 
 static void
 pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 {
 	PkSchedulerItem *item;
+	PkSchedulerItem *leader;
 
 	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
 	g_return_if_fail (tid != NULL);
@@ -458,10 +1079,6 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 		return;
 	}
 
-	/* treat all transactions as exclusive if backend does not support parallelization */
-	if (!pk_backend_supports_parallelization (scheduler->priv->backend))
-		pk_transaction_make_exclusive (item->transaction);
-
 	/* we've been 'used' */
 	if (item->commit_id != 0) {
 		g_source_remove (item->commit_id);
@@ -469,21 +1086,26 @@ pk_scheduler_commit (PkScheduler *scheduler, const gchar *tid)
 	}
 
 	/* we will changed what is running */
-	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
-
-	/* is one of the current running transactions background, and this new
-	 * transaction foreground? */
-	if (!pk_transaction_get_background (item->transaction) &&
-	    pk_scheduler_get_background_running (scheduler)) {
-		g_debug ("cancelling running background transactions and instead running %s",
-			item->tid);
-		pk_scheduler_cancel_background (scheduler);
+	pk_scheduler_emit_changed (scheduler);
+
+	/* is the same query already in flight? a foreground transaction
+	 * does not wait for a background one that may get cancelled */
+	if (item->query_key == NULL)
+		item->query_key = pk_transaction_get_query_key (item->transaction);
+	if (item->coalesce_key == NULL)
+		item->coalesce_key = pk_transaction_get_coalesce_key (item->transaction);
+	leader = item->subscribers->len == 0 ? pk_scheduler_get_leader (scheduler, item) : NULL;
+	if (leader != NULL &&
+	    (pk_transaction_get_background (item->transaction) ||
+	     !pk_transaction_get_background (leader->transaction))) {
+		g_debug ("%s is waiting for the results of %s", item->tid, leader->tid);
+		item->leader = leader;
+		g_ptr_array_add (leader->subscribers, item);
+		return;
 	}
 
-	/* do the transaction now, if possible */
-	if (pk_transaction_is_exclusive (item->transaction) == FALSE ||
-	    pk_scheduler_get_exclusive_running (scheduler) == 0)
-		pk_scheduler_run_item (scheduler, item);
+	pk_scheduler_commit_item (scheduler, item);
+	pk_scheduler_check_invariants (scheduler);
 }
 
 static void
@@ -492,7 +1114,7 @@ pk_scheduler_transaction_allow_cancel_changed_cb (PkTransaction *transaction,
 					          PkScheduler *scheduler)
 {
 	/* just proxy this back up */
-	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
+	pk_scheduler_emit_changed (scheduler);
 }
 
 static void
@@ -511,6 +1133,26 @@ pk_scheduler_transaction_state_changed_cb (PkTransaction *transaction,
 	}
 }
 
+static void
+pk_scheduler_record_finished (PkScheduler *scheduler,
+			      PkSchedulerItem *item,
+			      PkResults *results)
+{
+	PkRoleEnum role = pk_transaction_get_role (item->transaction);
+	g_autoptr(GPtrArray) packages = NULL;
+
+	/* subscribers never ran the backend themselves */
+	if (item->run_time != 0) {
+		pk_metrics_record (scheduler->priv->metrics, role,
+				   PK_METRICS_HISTOGRAM_RUN_TIME,
+				   g_get_monotonic_time () - item->run_time);
+	}
+	packages = pk_results_get_package_array (results);
+	pk_metrics_add_finished (scheduler->priv->metrics, role,
+				 pk_results_get_exit_code (results),
+				 packages->len);
+}
+
 static void
 pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 				      PkScheduler *scheduler)
@@ -518,6 +1160,7 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 	PkSchedulerItem *item;
 	PkTransactionState state;
 	PkBackendJob *job;
+	PkResults *results;
 	const gchar *tid;
 
 	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
@@ -534,7 +1177,25 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 		return;
 	}
 
-	if (pk_transaction_is_finished_with_lock_required (item->transaction)) {
+	/* this may have been cancelled whilst still waiting */
+	pk_scheduler_dequeue (scheduler, item);
+	pk_scheduler_detach_subscriber (item);
+	g_ptr_array_remove (scheduler->priv->running, item);
+
+	if (pk_transaction_is_preempted (item->transaction)) {
+		/* wait behind whatever we made way for, the partial
+		 * downloads are still in the cache for the next go */
+		pk_transaction_reset_after_preempt (item->transaction);
+		pk_scheduler_enqueue (scheduler, item);
+	} else if (pk_transaction_is_coalesce_failed (item->transaction)) {
+		/* one of them broke the merged transaction, so try each
+		 * on its own and let the others succeed */
+		g_debug ("coalesced transaction %s failed", item->tid);
+		pk_transaction_reset_after_coalesce (item->transaction);
+		g_clear_pointer (&item->coalesce_key, g_free);
+		pk_scheduler_enqueue (scheduler, item);
+		pk_scheduler_release_subscribers (scheduler, item, FALSE);
+	} else if (pk_transaction_is_finished_with_lock_required (item->transaction)) {
 		pk_transaction_reset_after_lock_error (item->transaction);
 
 		/* increase the number of tries */
@@ -567,24 +1228,38 @@ pk_scheduler_transaction_finished_cb (PkTransaction *transaction,
 							 pk_scheduler_remove_item_cb,
 							 item);
 		g_source_set_name_by_id (item->remove_id, "[PkScheduler] remove");
+
+		/* everyone asking the same gets the same answer */
+		results = pk_transaction_get_results (item->transaction);
+		if (scheduler->priv->metrics != NULL)
+			pk_scheduler_record_finished (scheduler, item, results);
+		pk_scheduler_release_subscribers (scheduler, item,
+						  pk_results_get_exit_code (results) == PK_EXIT_ENUM_SUCCESS);
 	}
 
-	/* try to run the next transaction, if possible */
-	item = pk_scheduler_get_next_item (scheduler);
-	if (item != NULL) {
+	/* try to run the next transactions, if possible; releasing a
+	 * writer can let several readers start at once */
+	while ((item = pk_scheduler_get_next_item (scheduler)) != NULL) {
 		g_debug ("running %s as previous one finished", item->tid);
 		pk_scheduler_run_item (scheduler, item);
 	}
+	pk_scheduler_check_invariants (scheduler);
 
 	/* we have changed what is running */
-	g_signal_emit (scheduler, signals [PK_SCHEDULER_CHANGED], 0);
+	pk_scheduler_emit_changed (scheduler);
 }
 
 static gboolean
 pk_scheduler_no_commit_cb (gpointer user_data)
 {
 	PkSchedulerItem *item = (PkSchedulerItem *) user_data;
-	g_warning ("ID %s was not committed in time!", item->tid);
+
+	/* clients are expected to not use all of the IDs they lease */
+	if (item->leased)
+		g_debug ("lease of ID %s expired", item->tid);
+	else
+		g_warning ("ID %s was not committed in time!", item->tid);
+	item->commit_id = 0;
 	pk_scheduler_remove_internal (item->scheduler, item);
 
 	/* never repeat */
@@ -594,26 +1269,125 @@ pk_scheduler_no_commit_cb (gpointer user_data)
 static guint
 pk_scheduler_get_number_transactions_for_uid (PkScheduler *scheduler, guint uid)
 {
-	guint i;
-	GPtrArray *array;
+	PkSchedulerUser *user;
+
+	user = g_hash_table_lookup (scheduler->priv->users, GUINT_TO_POINTER (uid));
+	if (user == NULL)
+		return 0;
+	return user->transactions;
+}
+
+static PkSchedulerItem *
+pk_scheduler_get_from_node (PkScheduler *scheduler, const gchar *node)
+{
+	g_autofree gchar *tid = NULL;
+
+	if (node == NULL)
+		return NULL;
+	tid = g_strconcat (PK_DBUS_PATH_TRANSACTION "/", node, NULL);
+	return pk_scheduler_get_from_tid (scheduler, tid);
+}
+
+static gchar **
+pk_scheduler_subtree_enumerate_cb (GDBusConnection *connection,
+				   const gchar *sender,
+				   const gchar *object_path,
+				   gpointer user_data)
+{
+	PkScheduler *scheduler = PK_SCHEDULER (user_data);
+	GPtrArray *array = scheduler->priv->array;
+	gchar **nodes = g_new0 (gchar *, array->len + 1);
+
+	for (guint i = 0; i < array->len; i++) {
+		PkSchedulerItem *item = g_ptr_array_index (array, i);
+		nodes[i] = g_path_get_basename (item->tid);
+	}
+	return nodes;
+}
+
+static GDBusInterfaceInfo **
+pk_scheduler_subtree_introspect_cb (GDBusConnection *connection,
+				    const gchar *sender,
+				    const gchar *object_path,
+				    const gchar *node,
+				    gpointer user_data)
+{
+	PkScheduler *scheduler = PK_SCHEDULER (user_data);
+	GDBusInterfaceInfo **interfaces;
+
+	if (pk_scheduler_get_from_node (scheduler, node) == NULL)
+		return NULL;
+	interfaces = g_new0 (GDBusInterfaceInfo *, 2);
+	interfaces[0] = g_dbus_interface_info_ref (scheduler->priv->introspection->interfaces[0]);
+	return interfaces;
+}
+
+static const GDBusInterfaceVTable *
+pk_scheduler_subtree_dispatch_cb (GDBusConnection *connection,
+				  const gchar *sender,
+				  const gchar *object_path,
+				  const gchar *interface_name,
+				  const gchar *node,
+				  gpointer *out_user_data,
+				  gpointer user_data)
+{
+	PkScheduler *scheduler = PK_SCHEDULER (user_data);
 	PkSchedulerItem *item;
-	guint count = 0;
 
-	/* find all the transactions in progress */
-	array = scheduler->priv->array;
-	for (i = 0; i < array->len; i++) {
-		item = (PkSchedulerItem *) g_ptr_array_index (array, i);
-		if (item->uid == uid)
-			count++;
+	if (g_strcmp0 (interface_name, PK_DBUS_INTERFACE_TRANSACTION) != 0)
+		return NULL;
+	item = pk_scheduler_get_from_node (scheduler, node);
+	if (item == NULL)
+		return NULL;
+	*out_user_data = item->transaction;
+	return pk_transaction_get_interface_vtable ();
+}
+
+static const GDBusSubtreeVTable pk_scheduler_subtree_vtable = {
+	.enumerate = pk_scheduler_subtree_enumerate_cb,
+	.introspect = pk_scheduler_subtree_introspect_cb,
+	.dispatch = pk_scheduler_subtree_dispatch_cb
+};
+
+/**
+ * pk_scheduler_register_subtree:
+ *
+ * Exports every transaction object with one registration, rather than
+ * registering and unregistering an object with GDBus for each one.
+ **/
+static void
+pk_scheduler_register_subtree (PkScheduler *scheduler)
+{
+	g_autoptr(GError) error = NULL;
+
+	if (scheduler->priv->connection == NULL)
+		scheduler->priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (scheduler->priv->connection == NULL) {
+		g_warning ("failed to get system bus: %s", error->message);
+		return;
 	}
-	return count;
+
+	/* dispatch looks the node up by tid, rather than GDBus enumerating
+	 * every transaction before each method call */
+	scheduler->priv->subtree_id =
+		g_dbus_connection_register_subtree (scheduler->priv->connection,
+						    PK_DBUS_PATH_TRANSACTION,
+						    &pk_scheduler_subtree_vtable,
+						    G_DBUS_SUBTREE_FLAGS_DISPATCH_TO_UNENUMERATED_NODES,
+						    scheduler,
+						    NULL,
+						    &error);
+	if (scheduler->priv->subtree_id == 0)
+		g_warning ("failed to register %s: %s", PK_DBUS_PATH_TRANSACTION, error->message);
 }
 
-gboolean
-pk_scheduler_create (PkScheduler *scheduler,
-			    const gchar *tid,
-			    const gchar *sender,
-			    GError **error)
+static gboolean
+pk_scheduler_create_internal (PkScheduler *scheduler,
+			      const gchar *tid,
+			      const gchar *sender,
+			      guint commit_timeout,
+			      gboolean leased,
+			      GError **error)
 {
 	guint count;
 	gboolean ret = FALSE;
@@ -630,10 +1404,17 @@ pk_scheduler_create (PkScheduler *scheduler,
 		return FALSE;
 	}
 
+	/* the first transaction exports the subtree they all live in */
+	if (scheduler->priv->subtree_id == 0)
+		pk_scheduler_register_subtree (scheduler);
+
 	/* add to the array */
 	item = g_new0 (PkSchedulerItem, 1);
 	item->scheduler = g_object_ref (scheduler);
 	item->tid = g_strdup (tid);
+	item->created_time = g_get_monotonic_time ();
+	item->leased = leased;
+	item->subscribers = g_ptr_array_new ();
 	item->transaction = pk_transaction_new (scheduler->priv->conf,
 						scheduler->priv->introspection);
 	item->finished_id =
@@ -673,6 +1454,26 @@ pk_scheduler_create (PkScheduler *scheduler,
 		pk_transaction_set_backend (item->transaction,
 					    scheduler->priv->backend);
 	}
+	if (scheduler->priv->query_cache != NULL) {
+		pk_transaction_set_query_cache (item->transaction,
+						scheduler->priv->query_cache);
+	}
+	if (scheduler->priv->plan_cache != NULL) {
+		pk_transaction_set_plan_cache (item->transaction,
+					       scheduler->priv->plan_cache);
+	}
+	if (scheduler->priv->search_sessions != NULL) {
+		pk_transaction_set_search_sessions (item->transaction,
+						    scheduler->priv->search_sessions);
+	}
+	if (scheduler->priv->auth_cache != NULL) {
+		pk_transaction_set_auth_cache (item->transaction,
+					       scheduler->priv->auth_cache);
+	}
+	if (scheduler->priv->metrics != NULL) {
+		pk_transaction_set_metrics (item->transaction,
+					    scheduler->priv->metrics);
+	}
 
 	/* get the uid for the transaction */
 	item->uid = pk_transaction_get_uid (item->transaction);
@@ -681,7 +1482,7 @@ pk_scheduler_create (PkScheduler *scheduler,
 	count = pk_scheduler_get_number_transactions_for_uid (scheduler, item->uid);
 
 	/* would this take us over the maximum number of requests allowed */
-	if (count > PK_SCHEDULER_SIMULTANEOUS_TRANSACTIONS_FOR_UID) {
+	if (count >= scheduler->priv->uid_max_transactions) {
 		g_set_error (error, 1, 0,
 			     "failed to allocate %s as uid %i already has "
 			     "%i transactions in progress",
@@ -692,16 +1493,108 @@ pk_scheduler_create (PkScheduler *scheduler,
 	}
 
 	/* the client only has a finite amount of time to use the object, else it's destroyed */
-	item->commit_id = g_timeout_add_seconds (PK_SCHEDULER_CREATE_COMMIT_TIMEOUT,
+	item->commit_id = g_timeout_add_seconds (commit_timeout,
 						 pk_scheduler_no_commit_cb,
 						 item);
 	g_source_set_name_by_id (item->commit_id, "[PkScheduler] commit");
 
 	g_debug ("adding transaction %p", item->transaction);
+	item->user = pk_scheduler_user_ref (scheduler, item->uid);
 	g_ptr_array_add (scheduler->priv->array, item);
+	g_hash_table_insert (scheduler->priv->tids, item->tid, item);
+	pk_scheduler_wedge_check_update (scheduler);
 	return TRUE;
 }
 
+gboolean
+pk_scheduler_create (PkScheduler *scheduler,
+			    const gchar *tid,
+			    const gchar *sender,
+			    GError **error)
+{
+	return pk_scheduler_create_internal (scheduler, tid, sender,
+					     PK_SCHEDULER_CREATE_COMMIT_TIMEOUT,
+					     FALSE, error);
+}
+
+/**
+ * pk_scheduler_lease:
+ * @timeout: how long the client has to use the transaction, in seconds
+ *
+ * Creates a transaction for a client that asked for several in advance.
+ * Unused leases are expected and are removed quietly after @timeout.
+ **/
+gboolean
+pk_scheduler_lease (PkScheduler *scheduler,
+		    const gchar *tid,
+		    const gchar *sender,
+		    guint timeout,
+		    GError **error)
+{
+	g_return_val_if_fail (timeout > 0, FALSE);
+	return pk_scheduler_create_internal (scheduler, tid, sender,
+					     timeout, TRUE, error);
+}
+
+/**
+ * pk_scheduler_start_job:
+ * @job: a job the daemon runs on the backend for itself
+ * @preemptible: if a committed transaction cancels @job
+ *
+ * Gives @job the backend as the lowest priority item of the scheduler.
+ * Unless the backend supports parallelization, this only succeeds when
+ * no transaction is running or waiting and no other job is running, and
+ * the transactions committed until pk_scheduler_finish_job() is called
+ * wait for @job.
+ *
+ * Return value: %TRUE if @job may be started now, otherwise try again later
+ **/
+gboolean
+pk_scheduler_start_job (PkScheduler *scheduler, PkBackendJob *job, gboolean preemptible)
+{
+	PkSchedulerPrivate *priv = scheduler->priv;
+
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), FALSE);
+	g_return_val_if_fail (PK_IS_BACKEND_JOB (job), FALSE);
+
+	if (!pk_backend_supports_parallelization (priv->backend) &&
+	    (priv->running->len > 0 ||
+	     pk_scheduler_get_waiting (scheduler) > 0 ||
+	     priv->jobs->len > 0))
+		return FALSE;
+	g_ptr_array_add (priv->jobs, g_object_ref (job));
+	if (preemptible)
+		g_ptr_array_add (priv->jobs_preemptible, job);
+	return TRUE;
+}
+
+/**
+ * pk_scheduler_finish_job:
+ * @job: a job started with pk_scheduler_start_job()
+ *
+ * Releases the backend after @job has finished, and runs the
+ * transactions that were waiting for it.
+ **/
+void
+pk_scheduler_finish_job (PkScheduler *scheduler, PkBackendJob *job)
+{
+	PkSchedulerItem *item;
+	PkSchedulerPrivate *priv = scheduler->priv;
+
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+	g_return_if_fail (PK_IS_BACKEND_JOB (job));
+
+	g_ptr_array_remove (priv->jobs_preemptible, job);
+	if (!g_ptr_array_remove (priv->jobs, job))
+		return;
+	while ((item = pk_scheduler_get_next_item (scheduler)) != NULL) {
+		g_debug ("running %s as a job of the daemon finished", item->tid);
+		pk_scheduler_run_item (scheduler, item);
+	}
+	pk_scheduler_check_invariants (scheduler);
+	pk_scheduler_emit_changed (scheduler);
+}
+
 /**
  * pk_scheduler_get_locked:
  *
@@ -887,6 +1780,23 @@ pk_scheduler_get_state (PkScheduler *scheduler)
 					pk_transaction_get_background (item->transaction));
 	}
 
+	/* ready queue depths */
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		g_string_append_printf (string, "queue[%s] priority[%i] waiting[%u]\n",
+					pk_scheduler_queue_to_string (i),
+					scheduler->priv->priority[i],
+					scheduler->priv->ready_len[i][FALSE] +
+					scheduler->priv->ready_len[i][TRUE]);
+	}
+
+	/* query cache efficiency */
+	if (scheduler->priv->query_cache != NULL) {
+		g_string_append_printf (string, "query-cache size[%u] hits[%u] misses[%u]\n",
+					pk_query_cache_get_size (scheduler->priv->query_cache),
+					pk_query_cache_get_hits (scheduler->priv->query_cache),
+					pk_query_cache_get_misses (scheduler->priv->query_cache));
+	}
+
 	/* nothing running */
 	if (waiting == length)
 		g_string_append_printf (string, "WARNING: everything is waiting!\n");
@@ -894,6 +1804,44 @@ out:
 	return g_string_free (string, FALSE);
 }
 
+/**
+ * pk_scheduler_get_depth:
+ *
+ * Return value: (transfer floating): an a{su} with the number of
+ * transactions in each state, and the number waiting in each ready queue
+ **/
+GVariant *
+pk_scheduler_get_depth (PkScheduler *scheduler)
+{
+	guint states[PK_TRANSACTION_STATE_UNKNOWN + 1] = { 0 };
+	GVariantBuilder builder;
+	PkSchedulerItem *item;
+	PkTransactionState state;
+
+	g_return_val_if_fail (PK_IS_SCHEDULER (scheduler), NULL);
+
+	for (guint i = 0; i < scheduler->priv->array->len; i++) {
+		item = (PkSchedulerItem *) g_ptr_array_index (scheduler->priv->array, i);
+		state = pk_transaction_get_state (item->transaction);
+		states[MIN (state, PK_TRANSACTION_STATE_UNKNOWN)]++;
+	}
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{su}"));
+	for (guint i = 0; i < PK_TRANSACTION_STATE_UNKNOWN; i++) {
+		g_variant_builder_add (&builder, "{su}",
+				       pk_transaction_state_to_string (i),
+				       states[i]);
+	}
+	for (guint i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		g_autofree gchar *key = NULL;
+		key = g_strdup_printf ("queue-%s", pk_scheduler_queue_to_string (i));
+		g_variant_builder_add (&builder, "{su}", key,
+				       scheduler->priv->ready_len[i][FALSE] +
+				       scheduler->priv->ready_len[i][TRUE]);
+	}
+	return g_variant_builder_end (&builder);
+}
+
 static void
 pk_scheduler_print (PkScheduler *scheduler)
 {
@@ -914,8 +1862,6 @@ pk_scheduler_is_consistent (PkScheduler *scheduler)
 	guint i;
 	gboolean ret = TRUE;
 	guint running = 0;
-	guint running_exclusive = 0;
-	guint waiting = 0;
 	guint no_commit = 0;
 	guint length;
 	guint unknown_role = 0;
@@ -936,8 +1882,6 @@ pk_scheduler_is_consistent (PkScheduler *scheduler)
 		state = pk_transaction_get_state (item->transaction);
 		if (state == PK_TRANSACTION_STATE_RUNNING)
 			running++;
-		if (state == PK_TRANSACTION_STATE_READY)
-			waiting++;
 		if (state == PK_TRANSACTION_STATE_NEW)
 			no_commit++;
 		role = pk_transaction_get_role (item->transaction);
@@ -963,16 +1907,8 @@ pk_scheduler_is_consistent (PkScheduler *scheduler)
 		g_debug ("%i are running", running);
 	}
 
-	/* more than one exclusive transactions running? */
-	running_exclusive = pk_scheduler_get_exclusive_running (scheduler);
-	if (running_exclusive > 1) {
-		pk_scheduler_print (scheduler);
-		g_warning ("%i exclusive transactions running", running_exclusive);
-		ret = FALSE;
-	}
-
-	/* nothing running */
-	if (waiting == length) {
+	/* the same checks as on every state change */
+	if (!pk_scheduler_check_invariants (scheduler)) {
 		pk_scheduler_print (scheduler);
 		ret = FALSE;
 	}
@@ -988,6 +1924,29 @@ pk_scheduler_wedge_check (PkScheduler *scheduler)
 	return TRUE;
 }
 
+/**
+ * pk_scheduler_wedge_check_update:
+ *
+ * The periodic check is only useful while there are transactions to
+ * look at, so an idle daemon never has to wake up for it.
+ **/
+static void
+pk_scheduler_wedge_check_update (PkScheduler *scheduler)
+{
+	if (scheduler->priv->array->len == 0) {
+		if (scheduler->priv->unwedge_id != 0) {
+			g_source_remove (scheduler->priv->unwedge_id);
+			scheduler->priv->unwedge_id = 0;
+		}
+		return;
+	}
+	if (scheduler->priv->unwedge_id != 0)
+		return;
+	scheduler->priv->unwedge_id = g_timeout_add_seconds (PK_TRANSACTION_WEDGE_CHECK,
+							  (GSourceFunc) pk_scheduler_wedge_check, scheduler);
+	g_source_set_name_by_id (scheduler->priv->unwedge_id, "[PkScheduler] wedge-check (main)");
+}
+
 /**
  * pk_scheduler_set_backend:
  *
@@ -1006,6 +1965,80 @@ pk_scheduler_set_backend (PkScheduler *scheduler,
 	scheduler->priv->backend = g_object_ref (backend);
 }
 
+/**
+ * pk_scheduler_set_query_cache:
+ *
+ * The cache is shared by all the transactions, so that identical
+ * queries can be answered without running the backend again.
+ */
+void
+pk_scheduler_set_query_cache (PkScheduler *scheduler,
+			      PkQueryCache *query_cache)
+{
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+	g_return_if_fail (PK_IS_QUERY_CACHE (query_cache));
+	g_return_if_fail (scheduler->priv->query_cache == NULL);
+	scheduler->priv->query_cache = g_object_ref (query_cache);
+}
+
+/**
+ * pk_scheduler_set_plan_cache:
+ *
+ * The cache is shared by all the transactions, so that the transaction
+ * committing a simulation can find the plan the simulation solved.
+ */
+void
+pk_scheduler_set_plan_cache (PkScheduler *scheduler,
+			     PkPlanCache *plan_cache)
+{
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+	g_return_if_fail (PK_IS_PLAN_CACHE (plan_cache));
+	g_return_if_fail (scheduler->priv->plan_cache == NULL);
+	scheduler->priv->plan_cache = g_object_ref (plan_cache);
+}
+
+void
+pk_scheduler_set_search_sessions (PkScheduler *scheduler,
+				  PkSearchSessions *search_sessions)
+{
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+	g_return_if_fail (PK_IS_SEARCH_SESSIONS (search_sessions));
+	g_return_if_fail (scheduler->priv->search_sessions == NULL);
+	scheduler->priv->search_sessions = g_object_ref (search_sessions);
+}
+
+/**
+ * pk_scheduler_set_auth_cache:
+ *
+ * The cache is shared by all the transactions, so that a client starting
+ * many transactions in a row does not wait for polkit every time.
+ */
+void
+pk_scheduler_set_auth_cache (PkScheduler *scheduler,
+			     PkAuthCache *auth_cache)
+{
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+	g_return_if_fail (PK_IS_AUTH_CACHE (auth_cache));
+	g_return_if_fail (scheduler->priv->auth_cache == NULL);
+	scheduler->priv->auth_cache = g_object_ref (auth_cache);
+}
+
+/**
+ * pk_scheduler_set_metrics:
+ *
+ * The metrics are shared by all the transactions, so the latencies of
+ * every role can be read back over D-Bus.
+ */
+void
+pk_scheduler_set_metrics (PkScheduler *scheduler,
+			  PkMetrics *metrics)
+{
+	g_return_if_fail (PK_IS_SCHEDULER (scheduler));
+	g_return_if_fail (PK_IS_METRICS (metrics));
+	g_return_if_fail (scheduler->priv->metrics == NULL);
+	scheduler->priv->metrics = g_object_ref (metrics);
+}
+
 static void
 pk_scheduler_class_init (PkSchedulerClass *klass)
 {
@@ -1018,26 +2051,58 @@ pk_scheduler_class_init (PkSchedulerClass *klass)
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
+	signals [PK_SCHEDULER_TRANSACTION_ADDED] =
+		g_signal_new ("transaction-added",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
+	signals [PK_SCHEDULER_TRANSACTION_REMOVED] =
+		g_signal_new ("transaction-removed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
 
 	g_type_class_add_private (klass, sizeof (PkSchedulerPrivate));
 }
 
+static void
+pk_scheduler_user_free (gpointer data)
+{
+	PkSchedulerUser *user = (PkSchedulerUser *) data;
+	for (guint i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		g_queue_clear (&user->flows[i][FALSE].items);
+		g_queue_clear (&user->flows[i][TRUE].items);
+	}
+	g_free (user);
+}
+
 static void
 pk_scheduler_init (PkScheduler *scheduler)
 {
+	guint i;
+
 	scheduler->priv = PK_SCHEDULER_GET_PRIVATE (scheduler);
 	scheduler->priv->array = g_ptr_array_new ();
+	scheduler->priv->running = g_ptr_array_new ();
+	scheduler->priv->jobs = g_ptr_array_new_with_free_func (g_object_unref);
+	scheduler->priv->jobs_preemptible = g_ptr_array_new ();
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		g_queue_init (&scheduler->priv->ready[i][FALSE]);
+		g_queue_init (&scheduler->priv->ready[i][TRUE]);
+	}
+	scheduler->priv->users = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							NULL, pk_scheduler_user_free);
+	scheduler->priv->listed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	scheduler->priv->tids = g_hash_table_new (g_str_hash, g_str_equal);
 	scheduler->priv->introspection = pk_load_introspection (PK_DBUS_INTERFACE_TRANSACTION ".xml",
 							    NULL);
-	scheduler->priv->unwedge_id = g_timeout_add_seconds (PK_TRANSACTION_WEDGE_CHECK,
-							  (GSourceFunc) pk_scheduler_wedge_check, scheduler);
-	g_source_set_name_by_id (scheduler->priv->unwedge_id, "[PkScheduler] wedge-check (main)");
 }
 
 static void
 pk_scheduler_finalize (GObject *object)
 {
 	PkScheduler *scheduler;
+	guint i;
 
 	g_return_if_fail (PK_IS_SCHEDULER (object));
 
@@ -1048,23 +2113,81 @@ pk_scheduler_finalize (GObject *object)
 	if (scheduler->priv->unwedge_id != 0)
 		g_source_remove (scheduler->priv->unwedge_id);
 
+	for (i = 0; i < PK_SCHEDULER_QUEUE_LAST; i++) {
+		g_queue_clear (&scheduler->priv->ready[i][FALSE]);
+		g_queue_clear (&scheduler->priv->ready[i][TRUE]);
+	}
+	g_ptr_array_unref (scheduler->priv->running);
+	g_ptr_array_unref (scheduler->priv->jobs_preemptible);
+	g_ptr_array_unref (scheduler->priv->jobs);
 	g_ptr_array_foreach (scheduler->priv->array,
 			     (GFunc) pk_scheduler_item_free_cb, NULL);
 	g_ptr_array_free (scheduler->priv->array, TRUE);
+	g_hash_table_unref (scheduler->priv->users);
+	g_hash_table_unref (scheduler->priv->listed);
+	g_hash_table_unref (scheduler->priv->tids);
+	if (scheduler->priv->subtree_id != 0)
+		g_dbus_connection_unregister_subtree (scheduler->priv->connection,
+						      scheduler->priv->subtree_id);
+	g_clear_object (&scheduler->priv->connection);
 
 	g_dbus_node_info_unref (scheduler->priv->introspection);
 	g_key_file_unref (scheduler->priv->conf);
 	if (scheduler->priv->backend != NULL)
 		g_object_unref (scheduler->priv->backend);
+	if (scheduler->priv->query_cache != NULL)
+		g_object_unref (scheduler->priv->query_cache);
+	if (scheduler->priv->plan_cache != NULL)
+		g_object_unref (scheduler->priv->plan_cache);
+	if (scheduler->priv->search_sessions != NULL)
+		g_object_unref (scheduler->priv->search_sessions);
+	if (scheduler->priv->auth_cache != NULL)
+		g_object_unref (scheduler->priv->auth_cache);
+	if (scheduler->priv->metrics != NULL)
+		g_object_unref (scheduler->priv->metrics);
 
 	G_OBJECT_CLASS (pk_scheduler_parent_class)->finalize (object);
 }
 
+static gint
+pk_scheduler_conf_get_integer (GKeyFile *conf, const gchar *key, gint value_default)
+{
+	if (!g_key_file_has_key (conf, "Daemon", key, NULL))
+		return value_default;
+	return g_key_file_get_integer (conf, "Daemon", key, NULL);
+}
+
 PkScheduler *
 pk_scheduler_new (GKeyFile *conf)
 {
 	PkScheduler *scheduler = PK_SCHEDULER (g_object_new (PK_TYPE_SCHEDULER, NULL));
+	gint aging_interval;
+	gint uid_quantum;
+	gint uid_max_transactions;
+
 	scheduler->priv->conf = g_key_file_ref (conf);
+
+	/* priorities of the ready queues */
+	scheduler->priv->priority[PK_SCHEDULER_QUEUE_INTERACTIVE] =
+		pk_scheduler_conf_get_integer (conf, "SchedulerInteractivePriority",
+					       PK_SCHEDULER_DEFAULT_PRIORITY_INTERACTIVE);
+	scheduler->priv->priority[PK_SCHEDULER_QUEUE_NORMAL] =
+		pk_scheduler_conf_get_integer (conf, "SchedulerNormalPriority",
+					       PK_SCHEDULER_DEFAULT_PRIORITY_NORMAL);
+	scheduler->priv->priority[PK_SCHEDULER_QUEUE_BACKGROUND] =
+		pk_scheduler_conf_get_integer (conf, "SchedulerBackgroundPriority",
+					       PK_SCHEDULER_DEFAULT_PRIORITY_BACKGROUND);
+	aging_interval = pk_scheduler_conf_get_integer (conf, "SchedulerAgingInterval",
+							PK_SCHEDULER_DEFAULT_AGING_INTERVAL);
+	scheduler->priv->aging_interval = MAX (aging_interval, 0);
+
+	/* sharing the queues between users */
+	uid_quantum = pk_scheduler_conf_get_integer (conf, "SchedulerUidQuantum",
+						     PK_SCHEDULER_DEFAULT_UID_QUANTUM);
+	scheduler->priv->uid_quantum = MAX (uid_quantum, 1);
+	uid_max_transactions = pk_scheduler_conf_get_integer (conf, "SchedulerUidMaxTransactions",
+							      PK_SCHEDULER_SIMULTANEOUS_TRANSACTIONS_FOR_UID);
+	scheduler->priv->uid_max_transactions = MAX (uid_max_transactions, 1);
 	return scheduler;
 }
 
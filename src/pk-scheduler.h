@@ -25,6 +25,11 @@
 #include <glib-object.h>
 #include <packagekit-glib2/pk-enum.h>
 
+#include "pk-auth-cache.h"
+#include "pk-metrics.h"
+#include "pk-plan-cache.h"
+#include "pk-query-cache.h"
+#include "pk-search-sessions.h"
 #include "pk-transaction.h"
 
 G_BEGIN_DECLS
@@ -62,14 +67,25 @@ gboolean	 pk_scheduler_create		(PkScheduler	*scheduler,
 						 const gchar	*tid,
 						 const gchar	*sender,
 						 GError		**error);
+gboolean	 pk_scheduler_lease		(PkScheduler	*scheduler,
+						 const gchar	*tid,
+						 const gchar	*sender,
+						 guint		 timeout,
+						 GError		**error);
 gboolean	 pk_scheduler_remove		(PkScheduler	*scheduler,
 						 const gchar	*tid);
+gboolean	 pk_scheduler_start_job		(PkScheduler	*scheduler,
+						 PkBackendJob	*job,
+						 gboolean	 preemptible);
+void		 pk_scheduler_finish_job	(PkScheduler	*scheduler,
+						 PkBackendJob	*job);
 gboolean	 pk_scheduler_role_present	(PkScheduler	*scheduler,
 						 PkRoleEnum	 role);
 gchar		**pk_scheduler_get_array	(PkScheduler	*scheduler)
 						 G_GNUC_WARN_UNUSED_RESULT;
 gchar		*pk_scheduler_get_state		(PkScheduler	*scheduler)
 						 G_GNUC_WARN_UNUSED_RESULT;
+GVariant	*pk_scheduler_get_depth		(PkScheduler	*scheduler);
 guint		 pk_scheduler_get_size		(PkScheduler	*scheduler);
 gboolean	 pk_scheduler_get_locked	(PkScheduler	*scheduler);
 gboolean	 pk_scheduler_get_inhibited	(PkScheduler	*scheduler);
@@ -79,6 +95,16 @@ void		 pk_scheduler_cancel_background	(PkScheduler	*scheduler);
 void		 pk_scheduler_cancel_queued	(PkScheduler	*scheduler);
 void		 pk_scheduler_set_backend	(PkScheduler	*scheduler,
 						 PkBackend	*backend);
+void		 pk_scheduler_set_query_cache	(PkScheduler	*scheduler,
+						 PkQueryCache	*query_cache);
+void		 pk_scheduler_set_plan_cache	(PkScheduler	*scheduler,
+						 PkPlanCache	*plan_cache);
+void		 pk_scheduler_set_search_sessions (PkScheduler	*scheduler,
+						 PkSearchSessions *search_sessions);
+void		 pk_scheduler_set_auth_cache	(PkScheduler	*scheduler,
+						 PkAuthCache	*auth_cache);
+void		 pk_scheduler_set_metrics	(PkScheduler	*scheduler,
+						 PkMetrics	*metrics);
 
 G_END_DECLS
 
@@ -0,0 +1,328 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <packagekit-glib2/pk-package.h>
+
+#include "pk-search-sessions.h"
+
+static void     pk_search_sessions_finalize	(GObject        *object);
+
+#define PK_SEARCH_SESSIONS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SEARCH_SESSIONS, PkSearchSessionsPrivate))
+
+/* a software center only needs one for its search box */
+#define PK_SEARCH_SESSIONS_MAX_PER_SENDER	4
+
+typedef struct {
+	PkSearchSessions	*sessions;	/* not ref'd, it owns us */
+	gchar			*token;
+	gchar			*sender;
+	guint			 watch_id;
+	/* the last complete search, if still valid */
+	PkRoleEnum		 role;
+	PkBitfield		 filters;
+	gchar			*value;		/* lowercase */
+	GPtrArray		*packages;	/* of PkPackage */
+} PkSearchSessionsItem;
+
+struct PkSearchSessionsPrivate
+{
+	GHashTable		*hash;		/* token:PkSearchSessionsItem */
+};
+
+G_DEFINE_TYPE (PkSearchSessions, pk_search_sessions, G_TYPE_OBJECT)
+
+static void
+pk_search_sessions_item_clear (PkSearchSessionsItem *item)
+{
+	item->role = PK_ROLE_ENUM_UNKNOWN;
+	item->filters = 0;
+	g_clear_pointer (&item->value, g_free);
+	g_clear_pointer (&item->packages, g_ptr_array_unref);
+}
+
+static void
+pk_search_sessions_item_free (PkSearchSessionsItem *item)
+{
+	if (item->watch_id != 0)
+		g_bus_unwatch_name (item->watch_id);
+	pk_search_sessions_item_clear (item);
+	g_free (item->token);
+	g_free (item->sender);
+	g_free (item);
+}
+
+/**
+ * pk_search_sessions_role_is_incremental:
+ *
+ * A name search for a longer term only matches packages that also matched
+ * the shorter one, and the name is part of the package ID, so the daemon
+ * can filter the earlier results itself. The other searches match data
+ * the daemon does not have.
+ **/
+gboolean
+pk_search_sessions_role_is_incremental (PkRoleEnum role)
+{
+	return role == PK_ROLE_ENUM_SEARCH_NAME;
+}
+
+static void
+pk_search_sessions_vanished_cb (GDBusConnection *connection,
+				const gchar *name,
+				gpointer user_data)
+{
+	PkSearchSessionsItem *item = (PkSearchSessionsItem *) user_data;
+	g_debug ("%s went away, ending search session %s", name, item->token);
+	g_hash_table_remove (item->sessions->priv->hash, item->token);
+}
+
+/**
+ * pk_search_sessions_create:
+ * @connection: the bus @sender is on, or %NULL to not watch it
+ * @sender: the unique name of the caller
+ *
+ * The session ends when @sender disconnects from the bus.
+ *
+ * Return value: the token the client sends with its searches, or %NULL
+ **/
+gchar *
+pk_search_sessions_create (PkSearchSessions *sessions,
+			   GDBusConnection *connection,
+			   const gchar *sender,
+			   GError **error)
+{
+	GHashTableIter iter;
+	PkSearchSessionsItem *item;
+	guint count = 0;
+
+	g_return_val_if_fail (PK_IS_SEARCH_SESSIONS (sessions), NULL);
+	g_return_val_if_fail (sender != NULL, NULL);
+
+	g_hash_table_iter_init (&iter, sessions->priv->hash);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item)) {
+		if (g_strcmp0 (item->sender, sender) == 0)
+			count++;
+	}
+	if (count >= PK_SEARCH_SESSIONS_MAX_PER_SENDER) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_TOO_MANY_OPEN_FILES,
+			     "%s already has %u search sessions", sender, count);
+		return NULL;
+	}
+
+	item = g_new0 (PkSearchSessionsItem, 1);
+	item->sessions = sessions;
+	item->token = g_uuid_string_random ();
+	item->sender = g_strdup (sender);
+	if (connection != NULL) {
+		item->watch_id = g_bus_watch_name_on_connection (connection,
+								 sender,
+								 G_BUS_NAME_WATCHER_FLAGS_NONE,
+								 NULL,
+								 pk_search_sessions_vanished_cb,
+								 item,
+								 NULL);
+	}
+	g_hash_table_insert (sessions->priv->hash, item->token, item);
+	return g_strdup (item->token);
+}
+
+static PkSearchSessionsItem *
+pk_search_sessions_lookup (PkSearchSessions *sessions,
+			   const gchar *token,
+			   const gchar *sender)
+{
+	PkSearchSessionsItem *item;
+
+	item = g_hash_table_lookup (sessions->priv->hash, token);
+	if (item == NULL || g_strcmp0 (item->sender, sender) != 0)
+		return NULL;
+	return item;
+}
+
+/**
+ * pk_search_sessions_has:
+ *
+ * Return value: %TRUE if @token is a session of @sender
+ **/
+gboolean
+pk_search_sessions_has (PkSearchSessions *sessions,
+			const gchar *token,
+			const gchar *sender)
+{
+	g_return_val_if_fail (PK_IS_SEARCH_SESSIONS (sessions), FALSE);
+	g_return_val_if_fail (token != NULL, FALSE);
+	return pk_search_sessions_lookup (sessions, token, sender) != NULL;
+}
+
+/* only single terms, as backends combine several in different ways */
+static gchar *
+pk_search_sessions_get_value (PkRoleEnum role, gchar **values)
+{
+	if (!pk_search_sessions_role_is_incremental (role))
+		return NULL;
+	if (values == NULL || values[0] == NULL || values[1] != NULL)
+		return NULL;
+	if (values[0][0] == '\0')
+		return NULL;
+	return g_utf8_strdown (values[0], -1);
+}
+
+/**
+ * pk_search_sessions_narrow:
+ * @values: the search terms
+ *
+ * Return value: (transfer container): the packages of the previous search
+ * of the session that also match @values, or %NULL if the backend has to
+ * search again because the new term does not extend the previous one
+ **/
+GPtrArray *
+pk_search_sessions_narrow (PkSearchSessions *sessions,
+			   const gchar *token,
+			   const gchar *sender,
+			   PkRoleEnum role,
+			   PkBitfield filters,
+			   gchar **values)
+{
+	PkSearchSessionsItem *item;
+	GPtrArray *narrowed;
+	guint i;
+	g_autofree gchar *value = NULL;
+
+	g_return_val_if_fail (PK_IS_SEARCH_SESSIONS (sessions), NULL);
+	g_return_val_if_fail (token != NULL, NULL);
+
+	item = pk_search_sessions_lookup (sessions, token, sender);
+	if (item == NULL || item->packages == NULL)
+		return NULL;
+	if (item->role != role || item->filters != filters)
+		return NULL;
+	value = pk_search_sessions_get_value (role, values);
+	if (value == NULL || strstr (value, item->value) == NULL)
+		return NULL;
+
+	narrowed = g_ptr_array_new_with_free_func (g_object_unref);
+	for (i = 0; i < item->packages->len; i++) {
+		PkPackage *package = g_ptr_array_index (item->packages, i);
+		g_autofree gchar *name = g_utf8_strdown (pk_package_get_name (package), -1);
+		if (strstr (name, value) != NULL)
+			g_ptr_array_add (narrowed, g_object_ref (package));
+	}
+	g_debug ("search session %s narrowed %u packages to %u for %s",
+		 token, item->packages->len, narrowed->len, value);
+	return narrowed;
+}
+
+/**
+ * pk_search_sessions_update:
+ * @packages: the complete results of the search
+ *
+ * Keeps the results as the candidates for the next search of the session.
+ **/
+void
+pk_search_sessions_update (PkSearchSessions *sessions,
+			   const gchar *token,
+			   const gchar *sender,
+			   PkRoleEnum role,
+			   PkBitfield filters,
+			   gchar **values,
+			   GPtrArray *packages)
+{
+	PkSearchSessionsItem *item;
+
+	g_return_if_fail (PK_IS_SEARCH_SESSIONS (sessions));
+	g_return_if_fail (token != NULL);
+	g_return_if_fail (packages != NULL);
+
+	item = pk_search_sessions_lookup (sessions, token, sender);
+	if (item == NULL)
+		return;
+	pk_search_sessions_item_clear (item);
+	item->value = pk_search_sessions_get_value (role, values);
+	if (item->value == NULL)
+		return;
+	item->role = role;
+	item->filters = filters;
+	item->packages = g_ptr_array_ref (packages);
+}
+
+/**
+ * pk_search_sessions_invalidate:
+ *
+ * Drops the candidates of every session when the packages changed, the
+ * sessions themselves stay open.
+ **/
+void
+pk_search_sessions_invalidate (PkSearchSessions *sessions)
+{
+	GHashTableIter iter;
+	PkSearchSessionsItem *item;
+
+	g_return_if_fail (PK_IS_SEARCH_SESSIONS (sessions));
+
+	g_hash_table_iter_init (&iter, sessions->priv->hash);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item))
+		pk_search_sessions_item_clear (item);
+}
+
+guint
+pk_search_sessions_get_size (PkSearchSessions *sessions)
+{
+	g_return_val_if_fail (PK_IS_SEARCH_SESSIONS (sessions), 0);
+	return g_hash_table_size (sessions->priv->hash);
+}
+
+static void
+pk_search_sessions_class_init (PkSearchSessionsClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = pk_search_sessions_finalize;
+	g_type_class_add_private (klass, sizeof (PkSearchSessionsPrivate));
+}
+
+static void
+pk_search_sessions_init (PkSearchSessions *sessions)
+{
+	sessions->priv = PK_SEARCH_SESSIONS_GET_PRIVATE (sessions);
+	sessions->priv->hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      NULL, (GDestroyNotify) pk_search_sessions_item_free);
+}
+
+static void
+pk_search_sessions_finalize (GObject *object)
+{
+	PkSearchSessions *sessions;
+	g_return_if_fail (PK_IS_SEARCH_SESSIONS (object));
+	sessions = PK_SEARCH_SESSIONS (object);
+
+	g_hash_table_unref (sessions->priv->hash);
+
+	G_OBJECT_CLASS (pk_search_sessions_parent_class)->finalize (object);
+}
+
+PkSearchSessions *
+pk_search_sessions_new (void)
+{
+	PkSearchSessions *sessions;
+	sessions = g_object_new (PK_TYPE_SEARCH_SESSIONS, NULL);
+	return PK_SEARCH_SESSIONS (sessions);
+}
@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_SEARCH_SESSIONS_H
+#define __PK_SEARCH_SESSIONS_H
+
+#include <gio/gio.h>
+#include <packagekit-glib2/pk-bitfield.h>
+#include <packagekit-glib2/pk-enum.h>
+
+G_BEGIN_DECLS
+
+#define PK_TYPE_SEARCH_SESSIONS		(pk_search_sessions_get_type ())
+#define PK_SEARCH_SESSIONS(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), PK_TYPE_SEARCH_SESSIONS, PkSearchSessions))
+#define PK_SEARCH_SESSIONS_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), PK_TYPE_SEARCH_SESSIONS, PkSearchSessionsClass))
+#define PK_IS_SEARCH_SESSIONS(o)	(G_TYPE_CHECK_INSTANCE_TYPE ((o), PK_TYPE_SEARCH_SESSIONS))
+#define PK_IS_SEARCH_SESSIONS_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), PK_TYPE_SEARCH_SESSIONS))
+#define PK_SEARCH_SESSIONS_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), PK_TYPE_SEARCH_SESSIONS, PkSearchSessionsClass))
+
+typedef struct PkSearchSessionsPrivate PkSearchSessionsPrivate;
+
+typedef struct
+{
+	 GObject			 parent;
+	 PkSearchSessionsPrivate	*priv;
+} PkSearchSessions;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} PkSearchSessionsClass;
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PkSearchSessions, g_object_unref)
+#endif
+
+GType		 pk_search_sessions_get_type		(void);
+PkSearchSessions *pk_search_sessions_new		(void);
+gboolean	 pk_search_sessions_role_is_incremental	(PkRoleEnum		 role);
+gchar		*pk_search_sessions_create		(PkSearchSessions	*sessions,
+							 GDBusConnection	*connection,
+							 const gchar		*sender,
+							 GError			**error)
+							 G_GNUC_WARN_UNUSED_RESULT;
+gboolean	 pk_search_sessions_has			(PkSearchSessions	*sessions,
+							 const gchar		*token,
+							 const gchar		*sender);
+GPtrArray	*pk_search_sessions_narrow		(PkSearchSessions	*sessions,
+							 const gchar		*token,
+							 const gchar		*sender,
+							 PkRoleEnum		 role,
+							 PkBitfield		 filters,
+							 gchar			**values);
+void		 pk_search_sessions_update		(PkSearchSessions	*sessions,
+							 const gchar		*token,
+							 const gchar		*sender,
+							 PkRoleEnum		 role,
+							 PkBitfield		 filters,
+							 gchar			**values,
+							 GPtrArray		*packages);
+void		 pk_search_sessions_invalidate		(PkSearchSessions	*sessions);
+guint		 pk_search_sessions_get_size		(PkSearchSessions	*sessions);
+
+G_END_DECLS
+
+#endif /* __PK_SEARCH_SESSIONS_H */
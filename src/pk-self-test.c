@@ -25,10 +25,16 @@
 #include <glib-object.h>
 #include <glib/gstdio.h>
 
+#include "pk-auth-cache.h"
 #include "pk-backend.h"
 #include "pk-backend-spawn.h"
 #include "pk-dbus.h"
 #include "pk-engine.h"
+#include "pk-index.h"
+#include "pk-metrics.h"
+#include "pk-plan-cache.h"
+#include "pk-query-cache.h"
+#include "pk-search-sessions.h"
 #include "pk-spawn.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
@@ -123,6 +129,30 @@ pk_test_backend_func_true (PkBackendJob *job,
 	pk_backend_job_package (job, PK_INFO_ENUM_AVAILABLE,
 				"vips-doc;7.12.4-2.fc8;noarch;linva",
 				"The vips documentation package.");
+
+	/* the bulk path drops the same duplicates */
+	{
+		g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func (g_object_unref);
+		g_ptr_array_add (packages,
+				 pk_package_new_full (PK_INFO_ENUM_AVAILABLE,
+						      "vips-doc;7.12.4-2.fc8;noarch;linva",
+						      "The vips documentation package.",
+						      PK_INFO_ENUM_UNKNOWN, PK_ROLE_ENUM_UNKNOWN,
+						      NULL, NULL));
+		g_ptr_array_add (packages,
+				 pk_package_new_full (PK_INFO_ENUM_AVAILABLE,
+						      "vips;7.12.4-2.fc8;i386;linva",
+						      "The vips image processing library.",
+						      PK_INFO_ENUM_UNKNOWN, PK_ROLE_ENUM_UNKNOWN,
+						      NULL, NULL));
+		g_ptr_array_add (packages,
+				 pk_package_new_full (PK_INFO_ENUM_INSTALLED,
+						      "glib2;2.14.0;i386;fedora",
+						      "The GLib library",
+						      PK_INFO_ENUM_UNKNOWN, PK_ROLE_ENUM_UNKNOWN,
+						      NULL, NULL));
+		pk_backend_job_packages (job, packages);
+	}
 }
 
 static void
@@ -132,6 +162,35 @@ pk_test_backend_func_immediate_false (PkBackendJob *job,
 {
 }
 
+static gboolean
+pk_test_backend_async_timeout_cb (gpointer user_data)
+{
+	PkBackendJob *job = PK_BACKEND_JOB (user_data);
+
+	pk_backend_job_package (job, PK_INFO_ENUM_AVAILABLE,
+				"powertop;1.8-1.fc8;i386;fedora",
+				"Power consumption monitor");
+	pk_backend_job_async_finished (job);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_test_backend_func_async (PkBackendJob *job,
+			    GVariant *params,
+			    GMainContext *context,
+			    gpointer user_data)
+{
+	g_autoptr(GSource) source = NULL;
+
+	/* we are on the I/O thread, not the one running the test loop */
+	g_assert (context == g_main_context_get_thread_default ());
+	g_assert (context != g_main_context_default ());
+
+	source = g_timeout_source_new (10);
+	g_source_set_callback (source, pk_test_backend_async_timeout_cb, job, NULL);
+	g_source_attach (source, context);
+}
+
 static void
 pk_test_backend_package_cb (PkBackend *backend, PkPackage *package, gpointer user_data)
 {
@@ -145,6 +204,7 @@ pk_test_backend_func (void)
 	const gchar *text;
 	gboolean ret;
 	const gchar *filename;
+	guint64 epoch;
 	GError *error = NULL;
 	g_autoptr(GKeyFile) conf = NULL;
 	g_autoptr(PkBackend) backend = NULL;
@@ -155,6 +215,12 @@ pk_test_backend_func (void)
 	backend = pk_backend_new (conf);
 	g_assert (backend != NULL);
 
+	/* epochs only go up, and separately */
+	epoch = pk_backend_get_epoch (backend, PK_BACKEND_EPOCH_AVAILABLE);
+	g_assert_cmpuint (pk_backend_bump_epoch (backend, PK_BACKEND_EPOCH_INSTALLED), >, 0);
+	g_assert_cmpuint (pk_backend_get_epoch (backend, PK_BACKEND_EPOCH_AVAILABLE), ==, epoch);
+	g_assert_cmpuint (pk_backend_bump_epoch (backend, PK_BACKEND_EPOCH_AVAILABLE), >, epoch);
+
 	/* create a config file */
 	filename = "/tmp/dave";
 	ret = g_file_set_contents (filename, "foo", -1, NULL);
@@ -257,7 +323,7 @@ pk_test_backend_func (void)
 	_g_test_loop_wait (2000);
 
 	/* check duplicate filter */
-	g_assert_cmpint (number_packages, ==, 1);
+	g_assert_cmpint (number_packages, ==, 3);
 
 	/* reset */
 	g_object_unref (job);
@@ -274,6 +340,24 @@ pk_test_backend_func (void)
 	/* wait for Finished */
 	_g_test_loop_wait (10);
 
+	/* finish from an async operation on the I/O context */
+	g_object_unref (job);
+	job = pk_backend_job_new (conf);
+	pk_backend_job_set_backend (job, backend);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_PACKAGE,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_package_cb),
+				  NULL);
+	pk_backend_job_set_vfunc (job,
+				  PK_BACKEND_SIGNAL_FINISHED,
+				  PK_BACKEND_JOB_VFUNC (pk_test_backend_finished_cb),
+				  NULL);
+	ret = pk_backend_job_async_create (job, pk_test_backend_func_async, NULL, NULL);
+	g_assert (ret);
+	_g_test_loop_run_with_timeout (2000);
+	g_assert (pk_backend_job_get_is_finished (job));
+	g_assert_cmpint (number_packages, ==, 4);
+
 	/* reset */
 	g_object_unref (job);
 	job = pk_backend_job_new (conf);
@@ -283,6 +367,44 @@ pk_test_backend_func (void)
 	/* get exit code from error code */
 	g_assert_cmpint (pk_backend_job_get_exit_code (job), ==,
 		         PK_EXIT_ENUM_NEED_UNTRUSTED);
+
+	/* the first checkpoint after a cancel request is remembered */
+	g_object_unref (job);
+	job = pk_backend_job_new (conf);
+	g_assert (!pk_backend_job_checkpoint (job, "test:before"));
+	g_assert_cmpint (pk_backend_job_get_cancel_requested (job), ==, 0);
+	pk_backend_job_set_cancel_requested (job);
+	g_cancellable_cancel (pk_backend_job_get_cancellable (job));
+	g_assert_cmpint (pk_backend_job_get_cancel_requested (job), >, 0);
+	g_assert (pk_backend_job_checkpoint (job, "test:first"));
+	g_assert (pk_backend_job_checkpoint (job, "test:second"));
+	g_assert_cmpstr (pk_backend_job_get_cancel_checkpoint (job), ==, "test:first");
+
+	/* the budget left before the deadline of the client */
+	g_object_unref (job);
+	job = pk_backend_job_new (conf);
+	g_assert_cmpint (pk_backend_job_get_budget (job), ==, -1);
+	pk_backend_job_set_deadline (job, g_get_monotonic_time () + 60 * G_USEC_PER_SEC);
+	g_assert_cmpint (pk_backend_job_get_budget (job), >, 59000);
+	g_assert_cmpint (pk_backend_job_get_budget (job), <=, 60000);
+	pk_backend_job_set_deadline (job, g_get_monotonic_time () - 1);
+	g_assert_cmpint (pk_backend_job_get_budget (job), ==, 0);
+	g_assert (!pk_backend_job_get_partial (job));
+	pk_backend_job_set_partial (job);
+	g_assert (pk_backend_job_get_partial (job));
+
+	/* only the fields the client asked for */
+	{
+		gchar *fields[] = { (gchar *) "summary", NULL };
+		gchar *none[] = { NULL };
+
+		g_assert (pk_backend_job_wants_field (job, "changelog"));
+		pk_backend_job_set_fields (job, fields);
+		g_assert (pk_backend_job_wants_field (job, "summary"));
+		g_assert (!pk_backend_job_wants_field (job, "changelog"));
+		pk_backend_job_set_fields (job, none);
+		g_assert (!pk_backend_job_wants_field (job, "summary"));
+	}
 }
 
 static guint _backend_spawn_number_packages = 0;
@@ -727,6 +849,394 @@ pk_test_transaction_func (void)
 	g_dbus_node_info_unref (introspection);
 }
 
+static void
+pk_test_query_cache_func (void)
+{
+	gchar *values[] = { "gtk2", NULL };
+	gchar *values_split[] = { "a", "b", NULL };
+	gchar *values_joined[] = { "a\tb", NULL };
+	guint generation;
+	g_autofree gchar *key = NULL;
+	g_autofree gchar *key_locale = NULL;
+	g_autofree gchar *key_split = NULL;
+	g_autofree gchar *key_joined = NULL;
+	g_autoptr(PkQueryCache) cache = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_autoptr(PkResults) results_cached = NULL;
+
+	cache = pk_query_cache_new ();
+	g_assert (pk_query_cache_role_is_cacheable (PK_ROLE_ENUM_RESOLVE));
+	g_assert (!pk_query_cache_role_is_cacheable (PK_ROLE_ENUM_INSTALL_PACKAGES));
+	g_assert (pk_query_cache_role_is_cacheable (PK_ROLE_ENUM_GET_REPO_LIST));
+	g_assert (pk_query_cache_role_is_cacheable (PK_ROLE_ENUM_GET_CATEGORIES));
+	g_assert (pk_query_cache_role_is_cacheable (PK_ROLE_ENUM_GET_DISTRO_UPGRADES));
+
+	/* the locale is part of the key */
+	key = pk_query_cache_build_key (PK_ROLE_ENUM_RESOLVE, 0, values, NULL);
+	key_locale = pk_query_cache_build_key (PK_ROLE_ENUM_RESOLVE, 0, values, "en_GB.utf8");
+	g_assert_cmpstr (key, !=, key_locale);
+
+	/* a separator inside a value is not a second value */
+	key_split = pk_query_cache_build_key (PK_ROLE_ENUM_RESOLVE, 0, values_split, NULL);
+	key_joined = pk_query_cache_build_key (PK_ROLE_ENUM_RESOLVE, 0, values_joined, NULL);
+	g_assert_cmpstr (key_split, !=, key_joined);
+
+	/* miss */
+	results_cached = pk_query_cache_lookup (cache, key);
+	g_assert (results_cached == NULL);
+	g_assert_cmpint (pk_query_cache_get_misses (cache), ==, 1);
+
+	/* hit */
+	results = pk_results_new ();
+	pk_query_cache_insert (cache, key, results, pk_query_cache_get_generation (cache));
+	results_cached = pk_query_cache_lookup (cache, key);
+	g_assert (results_cached == results);
+	g_assert_cmpint (pk_query_cache_get_hits (cache), ==, 1);
+	g_clear_object (&results_cached);
+
+	/* the update snapshot */
+	g_assert (pk_query_cache_get_updates (cache) == NULL);
+	g_assert_cmpint (pk_query_cache_get_updates_timestamp (cache), ==, 0);
+	pk_query_cache_set_updates (cache, results, pk_query_cache_get_generation (cache));
+	g_assert (pk_query_cache_get_updates (cache) == results);
+	g_assert_cmpint (pk_query_cache_get_updates_timestamp (cache), >, 0);
+
+	/* invalidated */
+	pk_query_cache_invalidate (cache);
+	g_assert_cmpint (pk_query_cache_get_size (cache), ==, 0);
+	results_cached = pk_query_cache_lookup (cache, key);
+	g_assert (results_cached == NULL);
+	g_assert_cmpint (pk_query_cache_get_misses (cache), ==, 2);
+	g_assert (pk_query_cache_get_updates (cache) == NULL);
+
+	/* a query that started before the invalidation is not kept */
+	generation = pk_query_cache_get_generation (cache);
+	pk_query_cache_invalidate (cache);
+	pk_query_cache_insert (cache, key, results, generation);
+	g_assert_cmpint (pk_query_cache_get_size (cache), ==, 0);
+	pk_query_cache_set_updates (cache, results, generation);
+	g_assert (pk_query_cache_get_updates (cache) == NULL);
+}
+
+static void
+pk_test_auth_cache_func (void)
+{
+	const gchar *action_id = "org.freedesktop.packagekit.package-install";
+	g_autoptr(PkAuthCache) cache = NULL;
+	g_autoptr(PkAuthCache) cache_disabled = NULL;
+
+	/* miss */
+	cache = pk_auth_cache_new (60);
+	g_assert (!pk_auth_cache_lookup (cache, ":1.42", action_id, FALSE));
+
+	/* hit, only for the same sender and interactive flag */
+	pk_auth_cache_insert (cache, ":1.42", action_id, FALSE);
+	g_assert (pk_auth_cache_lookup (cache, ":1.42", action_id, FALSE));
+	g_assert (!pk_auth_cache_lookup (cache, ":1.42", action_id, TRUE));
+	g_assert (!pk_auth_cache_lookup (cache, ":1.43", action_id, FALSE));
+
+	/* the caller went away */
+	pk_auth_cache_insert (cache, ":1.43", action_id, FALSE);
+	pk_auth_cache_invalidate_sender (cache, ":1.42");
+	g_assert (!pk_auth_cache_lookup (cache, ":1.42", action_id, FALSE));
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 1);
+
+	/* polkit changed */
+	pk_auth_cache_invalidate (cache);
+	g_assert_cmpint (pk_auth_cache_get_size (cache), ==, 0);
+
+	/* disabled */
+	cache_disabled = pk_auth_cache_new (0);
+	pk_auth_cache_insert (cache_disabled, ":1.42", action_id, FALSE);
+	g_assert (!pk_auth_cache_lookup (cache_disabled, ":1.42", action_id, FALSE));
+}
+
+static void
+pk_test_plan_cache_func (void)
+{
+	gchar *package_ids[] = { "powertop;1.8-1.fc8;i386;fedora", NULL };
+	GDestroyNotify destroy = NULL;
+	gpointer plan;
+	g_autofree gchar *key = NULL;
+	g_autofree gchar *key_other = NULL;
+	g_autofree gchar *token = NULL;
+	g_autofree gchar *token_other = NULL;
+	g_autofree gchar *token_disabled = NULL;
+	g_autoptr(PkPlanCache) cache = NULL;
+	g_autoptr(PkPlanCache) cache_disabled = NULL;
+
+	/* only the flags the solver cares about are part of the key */
+	key = pk_plan_cache_build_key (PK_ROLE_ENUM_INSTALL_PACKAGES,
+				       pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_SIMULATE),
+				       package_ids, FALSE, FALSE, 500);
+	key_other = pk_plan_cache_build_key (PK_ROLE_ENUM_INSTALL_PACKAGES,
+					     pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED),
+					     package_ids, FALSE, FALSE, 500);
+	g_assert_cmpstr (key, ==, key_other);
+	g_clear_pointer (&key_other, g_free);
+	key_other = pk_plan_cache_build_key (PK_ROLE_ENUM_INSTALL_PACKAGES,
+					     pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ALLOW_DOWNGRADE),
+					     package_ids, FALSE, FALSE, 500);
+	g_assert_cmpstr (key, !=, key_other);
+
+	/* committed once, with the same request */
+	cache = pk_plan_cache_new (60);
+	token = pk_plan_cache_insert (cache, key, g_strdup ("plan"), g_free);
+	g_assert (token != NULL);
+	plan = pk_plan_cache_take (cache, token, key, &destroy);
+	g_assert_cmpstr (plan, ==, "plan");
+	g_assert (destroy == g_free);
+	destroy (plan);
+	g_assert (pk_plan_cache_take (cache, token, key, &destroy) == NULL);
+
+	/* a different request drops it */
+	token_other = pk_plan_cache_insert (cache, key, g_strdup ("plan"), g_free);
+	g_assert (pk_plan_cache_take (cache, token_other, key_other, &destroy) == NULL);
+	g_assert_cmpint (pk_plan_cache_get_size (cache), ==, 0);
+
+	/* the package database changed */
+	g_clear_pointer (&token_other, g_free);
+	token_other = pk_plan_cache_insert (cache, key, g_strdup ("plan"), g_free);
+	pk_plan_cache_invalidate (cache);
+	g_assert_cmpint (pk_plan_cache_get_size (cache), ==, 0);
+	g_assert (pk_plan_cache_take (cache, token_other, key, &destroy) == NULL);
+
+	/* disabled */
+	cache_disabled = pk_plan_cache_new (0);
+	token_disabled = pk_plan_cache_insert (cache_disabled, key, g_strdup ("plan"), g_free);
+	g_assert (token_disabled == NULL);
+	g_assert_cmpint (pk_plan_cache_get_size (cache_disabled), ==, 0);
+}
+
+static void
+pk_test_search_sessions_func (void)
+{
+	gchar *values_fi[] = { "Fi", NULL };
+	gchar *values_fir[] = { "fir", NULL };
+	gchar *values_gi[] = { "gi", NULL };
+	PkPackage *package;
+	g_autofree gchar *token = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) narrowed = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(PkSearchSessions) sessions = NULL;
+
+	packages = g_ptr_array_new_with_free_func (g_object_unref);
+	package = pk_package_new ();
+	g_assert (pk_package_set_id (package, "firefox;1.0;x86_64;fedora", NULL));
+	g_ptr_array_add (packages, package);
+	package = pk_package_new ();
+	g_assert (pk_package_set_id (package, "wifi-tools;1.0;x86_64;fedora", NULL));
+	g_ptr_array_add (packages, package);
+
+	sessions = pk_search_sessions_new ();
+	token = pk_search_sessions_create (sessions, NULL, ":1.42", &error);
+	g_assert_no_error (error);
+	g_assert (token != NULL);
+	g_assert (pk_search_sessions_has (sessions, token, ":1.42"));
+	g_assert (!pk_search_sessions_has (sessions, token, ":1.43"));
+
+	/* nothing searched yet */
+	g_assert (pk_search_sessions_narrow (sessions, token, ":1.42",
+					     PK_ROLE_ENUM_SEARCH_NAME, 0, values_fir) == NULL);
+
+	/* a longer term is answered from the previous results */
+	pk_search_sessions_update (sessions, token, ":1.42",
+				   PK_ROLE_ENUM_SEARCH_NAME, 0, values_fi, packages);
+	narrowed = pk_search_sessions_narrow (sessions, token, ":1.42",
+					      PK_ROLE_ENUM_SEARCH_NAME, 0, values_fir);
+	g_assert (narrowed != NULL);
+	g_assert_cmpint (narrowed->len, ==, 1);
+	g_assert_cmpstr (pk_package_get_name (g_ptr_array_index (narrowed, 0)), ==, "firefox");
+
+	/* a different term, other filters or another caller search again */
+	g_assert (pk_search_sessions_narrow (sessions, token, ":1.42",
+					     PK_ROLE_ENUM_SEARCH_NAME, 0, values_gi) == NULL);
+	g_assert (pk_search_sessions_narrow (sessions, token, ":1.42",
+					     PK_ROLE_ENUM_SEARCH_NAME,
+					     pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+					     values_fir) == NULL);
+	g_assert (pk_search_sessions_narrow (sessions, token, ":1.43",
+					     PK_ROLE_ENUM_SEARCH_NAME, 0, values_fir) == NULL);
+
+	/* the package database changed */
+	pk_search_sessions_invalidate (sessions);
+	g_assert (pk_search_sessions_narrow (sessions, token, ":1.42",
+					     PK_ROLE_ENUM_SEARCH_NAME, 0, values_fir) == NULL);
+	g_assert_cmpint (pk_search_sessions_get_size (sessions), ==, 1);
+}
+
+static void
+pk_test_metrics_func (void)
+{
+	GVariantDict dict;
+	guint64 value = 0;
+	g_autoptr(GVariant) resolve = NULL;
+	g_autoptr(GVariant) roles = NULL;
+	g_autoptr(GVariant) variant = NULL;
+	g_autoptr(PkMetrics) metrics = NULL;
+
+	/* small values are exact, larger ones are log-linear */
+	for (guint i = 0; i < 8; i++)
+		g_assert_cmpint (pk_metrics_bucket_for_value (i), ==, i);
+	g_assert_cmpint (pk_metrics_bucket_for_value (8), ==, 8);
+	g_assert_cmpint (pk_metrics_bucket_for_value (9), ==, 8);
+	g_assert_cmpint (pk_metrics_bucket_for_value (10), ==, 9);
+	g_assert_cmpint (pk_metrics_bucket_lower_bound (9), ==, 10);
+	for (guint i = 1; i < 150; i++) {
+		guint64 bound = pk_metrics_bucket_lower_bound (i);
+		g_assert_cmpint (pk_metrics_bucket_for_value (bound), ==, i);
+		g_assert_cmpint (pk_metrics_bucket_for_value (bound - 1), ==, i - 1);
+	}
+	g_assert_cmpint (pk_metrics_bucket_for_value (-1), ==, 0);
+	g_assert_cmpint (pk_metrics_bucket_for_value (G_MAXINT64), ==, 159);
+
+	/* record */
+	metrics = pk_metrics_new ();
+	pk_metrics_record (metrics, PK_ROLE_ENUM_RESOLVE, PK_METRICS_HISTOGRAM_QUEUE_WAIT, 1500);
+	pk_metrics_record (metrics, PK_ROLE_ENUM_RESOLVE, PK_METRICS_HISTOGRAM_RUN_TIME, 250000);
+	pk_metrics_add_signal (metrics, PK_ROLE_ENUM_RESOLVE, 20, 128);
+	pk_metrics_add_finished (metrics, PK_ROLE_ENUM_RESOLVE, PK_EXIT_ENUM_SUCCESS, 3);
+	g_assert_cmpint (pk_metrics_get_count (metrics, PK_ROLE_ENUM_RESOLVE,
+					       PK_METRICS_HISTOGRAM_DISPATCH), ==, 1);
+	g_assert_cmpint (pk_metrics_get_count (metrics, PK_ROLE_ENUM_SEARCH_NAME,
+					       PK_METRICS_HISTOGRAM_RUN_TIME), ==, 0);
+
+	/* only the used roles are exported */
+	variant = g_variant_ref_sink (pk_metrics_to_variant (metrics));
+	g_variant_dict_init (&dict, variant);
+	roles = g_variant_dict_lookup_value (&dict, "roles", G_VARIANT_TYPE ("a{sv}"));
+	g_assert (roles != NULL);
+	g_assert_cmpint (g_variant_n_children (roles), ==, 1);
+	g_variant_dict_clear (&dict);
+	resolve = g_variant_lookup_value (roles, "resolve", G_VARIANT_TYPE ("a{sv}"));
+	g_assert (resolve != NULL);
+	g_assert (g_variant_lookup (resolve, "bytes-emitted", "t", &value));
+	g_assert_cmpuint (value, ==, 128);
+	g_assert (g_variant_lookup (resolve, "results", "t", &value));
+	g_assert_cmpuint (value, ==, 3);
+}
+
+static gboolean
+pk_test_index_feed_cb (PkIndexBuilder *builder, gpointer user_data, GError **error)
+{
+	guint record;
+
+	record = pk_index_builder_add_record (builder, "powertop;1.8-1.fc8;i386;fedora");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_NAME, "powertop");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_FILE, "/usr/bin/powertop");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_FILE, "/usr/share/man/man8/powertop.8.gz");
+	record = pk_index_builder_add_record (builder, "PowerTOP-gui;0.1-1;noarch;fedora");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_NAME, "PowerTOP-gui");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_FILE, "/usr/libexec/powertop");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_PROVIDES, "powertop-ui");
+	record = pk_index_builder_add_record (builder, "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_NAME, "kernel");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_NAME, "kernel");
+	pk_index_builder_add_key (builder, record, PK_INDEX_KIND_FILE, "/boot/vmlinuz");
+	return TRUE;
+}
+
+static void
+pk_test_index_func (void)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) package_ids = NULL;
+	g_autoptr(PkIndex) index = NULL;
+	g_autoptr(PkIndex) index_stale = NULL;
+
+	ret = pk_index_rebuild ("./pk-index.bin", "stamp-1", pk_test_index_feed_cb, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* a different package database */
+	index_stale = pk_index_new_from_file ("./pk-index.bin", "stamp-2", &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert (index_stale == NULL);
+	g_clear_error (&error);
+
+	index = pk_index_new_from_file ("./pk-index.bin", "stamp-1", &error);
+	g_assert_no_error (error);
+	g_assert (index != NULL);
+	g_assert_cmpint (pk_index_get_n_records (index), ==, 3);
+
+	/* exact */
+	package_ids = pk_index_lookup (index, PK_INDEX_KIND_NAME, "kernel");
+	g_assert_cmpint (package_ids->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (package_ids, 0), ==,
+			 "kernel;2.6.23-0.115.rc3.git1.fc8;i386;installed");
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+	package_ids = pk_index_lookup (index, PK_INDEX_KIND_FILE, "/usr/bin/powertop");
+	g_assert_cmpint (package_ids->len, ==, 1);
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+	package_ids = pk_index_lookup (index, PK_INDEX_KIND_PROVIDES, "powertop");
+	g_assert_cmpint (package_ids->len, ==, 0);
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+
+	/* basename, in the order the records were added */
+	package_ids = pk_index_lookup_basename (index, "powertop");
+	g_assert_cmpint (package_ids->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (package_ids, 0), ==, "powertop;1.8-1.fc8;i386;fedora");
+	g_assert_cmpstr (g_ptr_array_index (package_ids, 1), ==, "PowerTOP-gui;0.1-1;noarch;fedora");
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+
+	/* substring, ignoring case */
+	package_ids = pk_index_search (index, PK_INDEX_KIND_NAME, "werto");
+	g_assert_cmpint (package_ids->len, ==, 2);
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+	package_ids = pk_index_search (index, PK_INDEX_KIND_NAME, "GUI");
+	g_assert_cmpint (package_ids->len, ==, 1);
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+	package_ids = pk_index_search (index, PK_INDEX_KIND_NAME, "rn");
+	g_assert_cmpint (package_ids->len, ==, 1);
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+	package_ids = pk_index_search (index, PK_INDEX_KIND_NAME, "topx");
+	g_assert_cmpint (package_ids->len, ==, 0);
+	g_clear_pointer (&package_ids, g_ptr_array_unref);
+
+	/* rebuilding does not disturb the mapping already in use */
+	ret = pk_index_rebuild ("./pk-index.bin", "stamp-2", pk_test_index_feed_cb, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	package_ids = pk_index_search (index, PK_INDEX_KIND_PROVIDES, "ui");
+	g_assert_cmpint (package_ids->len, ==, 1);
+	g_unlink ("./pk-index.bin");
+}
+
+static void
+pk_test_transaction_db_get_list_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GList **list = (GList **) user_data;
+	g_autoptr(GError) error = NULL;
+
+	*list = pk_transaction_db_get_list_finish (NULL, res, &error);
+	g_assert_no_error (error);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_transaction_db_get_package_history_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GVariant **history = (GVariant **) user_data;
+	g_autoptr(GError) error = NULL;
+
+	*history = pk_transaction_db_get_package_history_finish (NULL, res, &error);
+	g_assert_no_error (error);
+	_g_test_loop_quit ();
+}
+
+static void
+pk_test_transaction_db_get_history_stats_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GVariant **stats = (GVariant **) user_data;
+	g_autoptr(GError) error = NULL;
+
+	*stats = pk_transaction_db_get_history_stats_finish (NULL, res, &error);
+	g_assert_no_error (error);
+	_g_test_loop_quit ();
+}
+
 static void
 pk_test_transaction_db_func (void)
 {
@@ -735,6 +1245,10 @@ pk_test_transaction_db_func (void)
 	gboolean ret;
 	gdouble ms;
 	GError *error = NULL;
+	GList *list;
+	GList *l;
+	GVariant *history;
+	PkTransactionPast *past;
 	g_autoptr(PkTransactionDb) db = NULL;
 	g_autofree gchar *proxy_http = NULL;
 	g_autofree gchar *proxy_ftp = NULL;
@@ -853,10 +1367,137 @@ pk_test_transaction_db_func (void)
 	g_assert (ret);
 	g_assert_cmpstr (proxy_http, ==, "127.0.0.1:80");
 	g_assert_cmpstr (proxy_ftp, ==, "127.0.0.1:21");
+
+	/* metadata is written together when the transaction finishes */
+	tid = pk_transaction_db_generate_id (db);
+	ret = pk_transaction_db_add (db, tid);
+	g_assert (ret);
+	ret = pk_transaction_db_set_role (db, tid, PK_ROLE_ENUM_INSTALL_PACKAGES);
+	g_assert (ret);
+	ret = pk_transaction_db_set_uid (db, tid, 500);
+	g_assert (ret);
+	ret = pk_transaction_db_set_data (db, tid, "installing\thal;0.1.2;i386;fedora\tHardware Abstraction Layer");
+	g_assert (ret);
+	list = pk_transaction_db_get_list (db, 0);
+	for (l = list; l != NULL; l = l->next)
+		g_assert_cmpstr (pk_transaction_past_get_id (l->data), !=, tid);
+	g_list_free_full (list, g_object_unref);
+	ret = pk_transaction_db_set_resources (db, tid, 25000, 4096, 512);
+	g_assert (ret);
+	ret = pk_transaction_db_set_finished (db, tid, TRUE, 1234);
+	g_assert (ret);
+	list = pk_transaction_db_get_list (db, 1);
+	g_assert (list != NULL);
+	past = PK_TRANSACTION_PAST (list->data);
+	g_assert_cmpstr (pk_transaction_past_get_id (past), ==, tid);
+	g_assert_cmpint (pk_transaction_past_get_role (past), ==, PK_ROLE_ENUM_INSTALL_PACKAGES);
+	g_assert_cmpint (pk_transaction_past_get_uid (past), ==, 500);
+	g_assert_cmpint (pk_transaction_past_get_duration (past), ==, 1234);
+	g_assert_cmpint (pk_transaction_past_get_cpu_time (past), ==, 25000);
+	g_assert_cmpint (pk_transaction_past_get_memory_growth (past), ==, 4096);
+	g_assert_cmpint (pk_transaction_past_get_bytes_emitted (past), ==, 512);
+	g_assert (pk_transaction_past_get_succeeded (past));
+	g_list_free_full (list, g_object_unref);
+	g_free (tid);
+
+	/* the package history is split out when the transaction finishes */
+	history = pk_transaction_db_get_package_history (db, "hal", 0);
+	g_assert (history != NULL);
+	g_assert_cmpint (g_variant_n_children (history), ==, 1);
+	g_variant_unref (history);
+	history = pk_transaction_db_get_package_history (db, "colord", 0);
+	g_assert (history == NULL);
+
+	/* the same queries on the reader thread */
+	list = NULL;
+	pk_transaction_db_get_list_async (db, 1, NULL,
+					  pk_test_transaction_db_get_list_cb, &list);
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (g_list_length (list), ==, 1);
+	g_assert_cmpint (pk_transaction_past_get_duration (list->data), ==, 1234);
+	g_list_free_full (list, g_object_unref);
+	{
+		gchar *names[] = { "hal", "colord", "hal", NULL };
+		pk_transaction_db_get_package_history_async (db, names, 0, NULL,
+							     pk_test_transaction_db_get_package_history_cb,
+							     &history);
+	}
+	_g_test_loop_run_with_timeout (5000);
+	g_assert_cmpint (g_variant_n_children (history), ==, 1);
+	g_variant_unref (history);
+
+	/* the install was counted when it finished */
+	{
+		gchar *names[] = { "hal", "colord", NULL };
+		g_autoptr(GVariant) months = NULL;
+		g_autoptr(GVariant) month = NULL;
+		guint32 installs = 0;
+		pk_transaction_db_get_history_stats_async (db, names, NULL,
+							   pk_test_transaction_db_get_history_stats_cb,
+							   &history);
+		_g_test_loop_run_with_timeout (5000);
+		g_assert_cmpint (g_variant_n_children (history), ==, 1);
+		g_assert (g_variant_lookup (history, "hal", "@aa{sv}", &months));
+		month = g_variant_get_child_value (months, g_variant_n_children (months) - 1);
+		g_assert (g_variant_lookup (month, "installs", "u", &installs));
+		g_assert_cmpint (installs, >=, 1);
+		g_variant_unref (history);
+	}
+
+	/* compressed package lists read back as plain text */
+	pk_transaction_db_set_compress (db, TRUE);
+	tid = pk_transaction_db_generate_id (db);
+	ret = pk_transaction_db_add (db, tid);
+	g_assert (ret);
+	ret = pk_transaction_db_set_data (db, tid, "installing\thal;0.1.2;i386;fedora\tHardware Abstraction Layer\n"
+					  "updating\tcolord;1.0;i386;fedora\tColor daemon");
+	g_assert (ret);
+	ret = pk_transaction_db_set_finished (db, tid, TRUE, 12);
+	g_assert (ret);
+	list = pk_transaction_db_get_list (db, 1);
+	g_assert (list != NULL);
+	g_assert_cmpstr (pk_transaction_past_get_id (list->data), ==, tid);
+	g_assert_cmpstr (pk_transaction_past_get_data (list->data), ==,
+			 "installing\thal;0.1.2;i386;fedora\tHardware Abstraction Layer\n"
+			 "updating\tcolord;1.0;i386;fedora\tColor daemon");
+	g_list_free_full (list, g_object_unref);
+	pk_transaction_db_set_compress (db, FALSE);
+	g_free (tid);
+
+	/* only keep the most recent transaction */
+	tid = pk_transaction_db_generate_id (db);
+	ret = pk_transaction_db_add (db, tid);
+	g_assert (ret);
+	ret = pk_transaction_db_set_finished (db, tid, TRUE, 10);
+	g_assert (ret);
+	pk_transaction_db_set_retention (db, 0, 1, 0);
+	while (pk_transaction_db_maintenance_step (db));
+	list = pk_transaction_db_get_list (db, 0);
+	g_assert_cmpint (g_list_length (list), ==, 1);
+	g_assert_cmpstr (pk_transaction_past_get_id (list->data), ==, tid);
+	g_list_free_full (list, g_object_unref);
+	history = pk_transaction_db_get_package_history (db, "hal", 0);
+	g_assert (history == NULL);
+	g_free (tid);
 }
 
 static PkTransactionDb *db = NULL;
 
+static guint _scheduler_added = 0;
+static guint _scheduler_removed = 0;
+
+static void
+pk_test_scheduler_added_cb (PkScheduler *tlist, const gchar *tid, gpointer user_data)
+{
+	_scheduler_added++;
+}
+
+static void
+pk_test_scheduler_removed_cb (PkScheduler *tlist, const gchar *tid, gpointer user_data)
+{
+	_scheduler_removed++;
+}
+
 static void
 pk_test_scheduler_finished_cb (PkTransaction *transaction, const gchar *exit_text, guint time, gpointer user_data)
 {
@@ -924,11 +1565,16 @@ pk_test_scheduler_func (void)
 	/* get a transaction list object */
 	tlist = pk_scheduler_new (conf);
 	g_assert (tlist != NULL);
+	g_signal_connect (tlist, "transaction-added",
+			  G_CALLBACK (pk_test_scheduler_added_cb), NULL);
+	g_signal_connect (tlist, "transaction-removed",
+			  G_CALLBACK (pk_test_scheduler_removed_cb), NULL);
 
 	/* make sure we get a valid tid */
 	pk_scheduler_set_backend (tlist, backend);
 	tid = pk_transaction_db_generate_id (db);
 	g_assert (tid != NULL);
+	g_assert (g_str_has_prefix (tid, "/org/freedesktop/PackageKit/Transaction/"));
 
 	/* create a transaction object */
 	ret = pk_scheduler_create (tlist, tid, ":org.freedesktop.PackageKit", &error);
@@ -959,6 +1605,7 @@ pk_test_scheduler_func (void)
 	/* remove without ever committing */
 	ret = pk_scheduler_remove (tlist, tid);
 	g_assert (ret);
+	g_assert (pk_scheduler_get_transaction (tlist, tid) == NULL);
 
 	/* get size none we have in queue */
 	size = pk_scheduler_get_size (tlist);
@@ -1006,9 +1653,13 @@ pk_test_scheduler_func (void)
 	size = g_strv_length (array);
 	g_assert_cmpint (size, ==, 1);
 	g_strfreev (array);
+	g_assert_cmpint (_scheduler_added, ==, 1);
+	g_assert_cmpint (_scheduler_removed, ==, 0);
 
 	/* wait for Finished */
 	_g_test_loop_run_with_timeout (2000);
+	g_assert_cmpint (_scheduler_added, ==, 1);
+	g_assert_cmpint (_scheduler_removed, ==, 1);
 
 	/* get size one we have in queue */
 	size = pk_scheduler_get_size (tlist);
@@ -1188,6 +1839,44 @@ pk_test_scheduler_func (void)
 	g_object_unref (db);
 }
 
+static void
+pk_test_scheduler_lease_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	g_autofree gchar *tid = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransactionDb) tdb = NULL;
+
+	tdb = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (tdb, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* a leased transaction exists but is not committed */
+	tid = pk_transaction_db_generate_id (tdb);
+	ret = pk_scheduler_lease (tlist, tid, ":org.freedesktop.PackageKit", 1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (pk_scheduler_get_transaction (tlist, tid) != NULL);
+	g_assert_cmpint (pk_scheduler_get_size (tlist), ==, 1);
+
+	/* it goes away quietly when the lease expires */
+	_g_test_loop_wait (2500);
+	g_assert (pk_scheduler_get_transaction (tlist, tid) == NULL);
+	g_assert_cmpint (pk_scheduler_get_size (tlist), ==, 0);
+}
+
 static void
 pk_test_scheduler_parallel_func (void)
 {
@@ -1396,6 +2085,398 @@ pk_test_scheduler_parallel_func (void)
 	g_object_unref (db);
 }
 
+static PkBackend *
+pk_test_scheduler_backend_new (GKeyFile *conf)
+{
+	gboolean ret;
+	PkBackend *backend;
+
+	g_key_file_set_string (conf, "Daemon", "DefaultBackend", "dummy");
+	g_key_file_set_string (conf, "Daemon", "MaximumPackagesToProcess", "1000");
+	g_key_file_set_integer (conf, "Dummy", "SyntheticPackages", 10);
+	backend = pk_backend_new (conf);
+	ret = pk_backend_load (backend, NULL);
+	g_assert (ret);
+	return backend;
+}
+
+static void
+pk_test_scheduler_state_changed_cb (PkTransaction *transaction,
+				    PkTransactionState state,
+				    GString *log)
+{
+	const gchar *label = g_object_get_data (G_OBJECT (transaction), "pk-test-label");
+
+	if (state == PK_TRANSACTION_STATE_RUNNING)
+		g_string_append_printf (log, "+%s", label);
+	else if (state == PK_TRANSACTION_STATE_FINISHED)
+		g_string_append_printf (log, "-%s", label);
+}
+
+static PkTransaction *
+pk_test_scheduler_new_transaction (PkScheduler *tlist,
+				   const gchar *label,
+				   const gchar *hint,
+				   GString *log)
+{
+	gboolean ret;
+	PkTransaction *transaction;
+	g_autofree gchar *tid = NULL;
+	g_autoptr(GError) error = NULL;
+
+	tid = pk_test_scheduler_create_transaction (tlist);
+	transaction = g_object_ref (pk_scheduler_get_transaction (tlist, tid));
+	g_object_set_data (G_OBJECT (transaction), "pk-test-label", (gpointer) label);
+	g_signal_connect (transaction, "state-changed",
+			  G_CALLBACK (pk_test_scheduler_state_changed_cb), log);
+	if (hint != NULL) {
+		g_auto(GStrv) sections = g_strsplit (hint, "=", 2);
+		ret = pk_transaction_set_hint (transaction, sections[0], sections[1], &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	return transaction;
+}
+
+static PkTransaction *
+pk_test_scheduler_install (PkScheduler *tlist,
+			   const gchar *label,
+			   const gchar *hint,
+			   const gchar *package_ids,
+			   GString *log)
+{
+	PkTransaction *transaction;
+	g_auto(GStrv) array = g_strsplit (package_ids, " ", -1);
+
+	transaction = pk_test_scheduler_new_transaction (tlist, label, hint, log);
+	pk_transaction_skip_auth_checks (transaction, TRUE);
+	pk_transaction_install_packages (transaction,
+					 g_variant_new ("(t^as)",
+							pk_bitfield_value (PK_TRANSACTION_FLAG_ENUM_ONLY_TRUSTED),
+							array),
+					 NULL);
+	return transaction;
+}
+
+static PkTransaction *
+pk_test_scheduler_search (PkScheduler *tlist,
+			  const gchar *label,
+			  PkRoleEnum role,
+			  const gchar *search,
+			  GString *log)
+{
+	PkTransaction *transaction;
+	g_auto(GStrv) array = g_strsplit (search, " ", -1);
+
+	transaction = pk_test_scheduler_new_transaction (tlist, label, NULL, log);
+	if (role == PK_ROLE_ENUM_SEARCH_NAME) {
+		pk_transaction_search_names (transaction,
+					     g_variant_new ("(t^as)",
+							    pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							    array),
+					     NULL);
+	} else {
+		pk_transaction_search_details (transaction,
+					       g_variant_new ("(t^as)",
+							      pk_bitfield_value (PK_FILTER_ENUM_NONE),
+							      array),
+					       NULL);
+	}
+	return transaction;
+}
+
+static void
+pk_test_scheduler_wait_finished (PkTransaction **transactions)
+{
+	for (guint i = 0; i < 100; i++) {
+		gboolean finished = TRUE;
+		for (guint j = 0; transactions[j] != NULL; j++) {
+			if (pk_transaction_get_state (transactions[j]) != PK_TRANSACTION_STATE_FINISHED)
+				finished = FALSE;
+		}
+		if (finished)
+			return;
+		_g_test_loop_wait (100);
+	}
+	g_assert_not_reached ();
+}
+
+static gchar *
+pk_test_scheduler_get_names (PkTransaction *transaction)
+{
+	GString *str = g_string_new (NULL);
+	g_autoptr(GPtrArray) packages = NULL;
+
+	packages = pk_results_get_package_array (pk_transaction_get_results (transaction));
+	for (guint i = 0; i < packages->len; i++) {
+		if (str->len > 0)
+			g_string_append_c (str, ' ');
+		g_string_append (str, pk_package_get_name (g_ptr_array_index (packages, i)));
+	}
+	return g_string_free (str, FALSE);
+}
+
+static void
+pk_test_scheduler_coalesce_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	g_autofree gchar *names = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GString) log = g_string_new (NULL);
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransaction) transaction_x = NULL;
+	g_autoptr(PkTransaction) transaction_a = NULL;
+	g_autoptr(PkTransaction) transaction_b = NULL;
+	g_autoptr(PkTransaction) transaction_c = NULL;
+	PkTransaction *transactions[5] = { NULL };
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	backend = pk_test_scheduler_backend_new (conf);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* hold the backend so that the others have to queue */
+	transaction_x = pk_test_scheduler_install (tlist, "X", NULL,
+						   "synthetic-0;1.0-1;x86_64;bench", log);
+
+	/* B asks for a name A asks for as well, which stays with A */
+	transaction_a = pk_test_scheduler_install (tlist, "A", "coalesce=true",
+						   "synthetic-1;1.0-1;x86_64;bench", log);
+	transaction_b = pk_test_scheduler_install (tlist, "B", "coalesce=true",
+						   "synthetic-1;1.0-1;x86_64;bench "
+						   "synthetic-2;1.0-1;x86_64;bench", log);
+	transaction_c = pk_test_scheduler_install (tlist, "C", "coalesce=true",
+						   "synthetic-3;1.0-1;x86_64;bench", log);
+	g_assert_cmpstr (log->str, ==, "+X");
+	g_assert_cmpint (pk_transaction_get_state (transaction_a), ==, PK_TRANSACTION_STATE_READY);
+
+	transactions[0] = transaction_x;
+	transactions[1] = transaction_a;
+	transactions[2] = transaction_b;
+	transactions[3] = transaction_c;
+	pk_test_scheduler_wait_finished (transactions);
+
+	/* B and C were committed with A, and only got their results after it */
+	g_assert_cmpstr (log->str, ==, "+X-X+A-A+B+C-B-C");
+
+	/* each got the packages with the names it asked for */
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction_a)), ==, PK_EXIT_ENUM_SUCCESS);
+	names = pk_test_scheduler_get_names (transaction_a);
+	g_assert_cmpstr (names, ==, "synthetic-1");
+	g_free (names);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction_b)), ==, PK_EXIT_ENUM_SUCCESS);
+	names = pk_test_scheduler_get_names (transaction_b);
+	g_assert_cmpstr (names, ==, "synthetic-2");
+	g_free (names);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction_c)), ==, PK_EXIT_ENUM_SUCCESS);
+	names = pk_test_scheduler_get_names (transaction_c);
+	g_assert_cmpstr (names, ==, "synthetic-3");
+
+	g_object_unref (db);
+}
+
+static void
+pk_test_scheduler_coalesce_failed_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	g_autofree gchar *names = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GString) log = g_string_new (NULL);
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransaction) transaction_x = NULL;
+	g_autoptr(PkTransaction) transaction_a = NULL;
+	g_autoptr(PkTransaction) transaction_b = NULL;
+	g_autoptr(PkTransaction) transaction_c = NULL;
+	PkTransaction *transactions[5] = { NULL };
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	g_key_file_set_string (conf, "Dummy", "SyntheticBroken", "synthetic-2");
+	backend = pk_test_scheduler_backend_new (conf);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	transaction_x = pk_test_scheduler_install (tlist, "X", NULL,
+						   "synthetic-0;1.0-1;x86_64;bench", log);
+	transaction_a = pk_test_scheduler_install (tlist, "A", "coalesce=true",
+						   "synthetic-1;1.0-1;x86_64;bench", log);
+	transaction_b = pk_test_scheduler_install (tlist, "B", "coalesce=true",
+						   "synthetic-2;1.0-1;x86_64;bench", log);
+	transaction_c = pk_test_scheduler_install (tlist, "C", "coalesce=true",
+						   "synthetic-3;1.0-1;x86_64;bench", log);
+
+	transactions[0] = transaction_x;
+	transactions[1] = transaction_a;
+	transactions[2] = transaction_b;
+	transactions[3] = transaction_c;
+	pk_test_scheduler_wait_finished (transactions);
+
+	/* the merged transaction failed, so A, B and C were run again alone */
+	g_assert_cmpstr (log->str, ==, "+X-X+A+B-B+A-A+C-C");
+
+	/* and only the one with the broken package failed */
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction_a)), ==, PK_EXIT_ENUM_SUCCESS);
+	names = pk_test_scheduler_get_names (transaction_a);
+	g_assert_cmpstr (names, ==, "synthetic-1");
+	g_free (names);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction_b)), ==, PK_EXIT_ENUM_FAILED);
+	g_assert_cmpint (pk_results_get_exit_code (pk_transaction_get_results (transaction_c)), ==, PK_EXIT_ENUM_SUCCESS);
+	names = pk_test_scheduler_get_names (transaction_c);
+	g_assert_cmpstr (names, ==, "synthetic-3");
+
+	g_object_unref (db);
+}
+
+static void
+pk_test_scheduler_queues_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GString) log = g_string_new (NULL);
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransaction) transaction_x = NULL;
+	g_autoptr(PkTransaction) transaction_n = NULL;
+	g_autoptr(PkTransaction) transaction_i = NULL;
+	PkTransaction *transactions[4] = { NULL };
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	backend = pk_test_scheduler_backend_new (conf);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* the interactive transaction overtakes the normal one queued first */
+	transaction_x = pk_test_scheduler_install (tlist, "X", NULL,
+						   "synthetic-0;1.0-1;x86_64;bench", log);
+	transaction_n = pk_test_scheduler_install (tlist, "N", NULL,
+						   "synthetic-1;1.0-1;x86_64;bench", log);
+	transaction_i = pk_test_scheduler_install (tlist, "I", "interactive=true",
+						   "synthetic-2;1.0-1;x86_64;bench", log);
+
+	transactions[0] = transaction_x;
+	transactions[1] = transaction_n;
+	transactions[2] = transaction_i;
+	pk_test_scheduler_wait_finished (transactions);
+	g_assert_cmpstr (log->str, ==, "+X-X+I-I+N-N");
+
+	g_object_unref (db);
+}
+
+static void
+pk_test_scheduler_readers_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GString) log = g_string_new (NULL);
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransaction) transaction_r1 = NULL;
+	g_autoptr(PkTransaction) transaction_r2 = NULL;
+	g_autoptr(PkTransaction) transaction_w = NULL;
+	g_autoptr(PkTransaction) transaction_r3 = NULL;
+	PkTransaction *transactions[5] = { NULL };
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the searches are the only reader roles of a serial backend */
+	conf = g_key_file_new ();
+	g_key_file_set_boolean (conf, "Dummy", "Serial", TRUE);
+	backend = pk_test_scheduler_backend_new (conf);
+	g_assert (!pk_backend_supports_parallelization (backend));
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* readers share the backend */
+	transaction_r1 = pk_test_scheduler_search (tlist, "R1", PK_ROLE_ENUM_SEARCH_NAME, "power", log);
+	transaction_r2 = pk_test_scheduler_search (tlist, "R2", PK_ROLE_ENUM_SEARCH_DETAILS, "dave", log);
+	g_assert_cmpstr (log->str, ==, "+R1+R2");
+
+	/* a writer waits for them, and holds back the readers after it */
+	transaction_w = pk_test_scheduler_install (tlist, "W", NULL,
+						   "synthetic-1;1.0-1;x86_64;bench", log);
+	transaction_r3 = pk_test_scheduler_search (tlist, "R3", PK_ROLE_ENUM_SEARCH_NAME, "paul", log);
+	g_assert_cmpstr (log->str, ==, "+R1+R2");
+	g_assert (pk_transaction_is_exclusive (transaction_w));
+	g_assert (!pk_transaction_is_exclusive (transaction_r3));
+
+	transactions[0] = transaction_r1;
+	transactions[1] = transaction_r2;
+	transactions[2] = transaction_w;
+	transactions[3] = transaction_r3;
+	pk_test_scheduler_wait_finished (transactions);
+	g_assert_cmpstr (log->str, ==, "+R1+R2-R2-R1+W-W+R3-R3");
+
+	g_object_unref (db);
+}
+
+static void
+pk_test_scheduler_single_flight_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	g_autofree gchar *names_a = NULL;
+	g_autofree gchar *names_b = NULL;
+	g_autoptr(GKeyFile) conf = NULL;
+	g_autoptr(GString) log = g_string_new (NULL);
+	g_autoptr(PkBackend) backend = NULL;
+	g_autoptr(PkScheduler) tlist = NULL;
+	g_autoptr(PkTransaction) transaction_a = NULL;
+	g_autoptr(PkTransaction) transaction_b = NULL;
+	PkTransaction *transactions[3] = { NULL };
+
+	db = pk_transaction_db_new ();
+	ret = pk_transaction_db_load (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	conf = g_key_file_new ();
+	backend = pk_test_scheduler_backend_new (conf);
+	tlist = pk_scheduler_new (conf);
+	pk_scheduler_set_backend (tlist, backend);
+
+	/* the backend would run both at once, but B waits for the answer to A */
+	transaction_a = pk_test_scheduler_search (tlist, "A", PK_ROLE_ENUM_SEARCH_NAME, "power", log);
+	transaction_b = pk_test_scheduler_search (tlist, "B", PK_ROLE_ENUM_SEARCH_NAME, "power", log);
+	g_assert_cmpstr (log->str, ==, "+A");
+	g_assert_cmpint (pk_transaction_get_state (transaction_b), ==, PK_TRANSACTION_STATE_READY);
+
+	transactions[0] = transaction_a;
+	transactions[1] = transaction_b;
+	pk_test_scheduler_wait_finished (transactions);
+	g_assert_cmpstr (log->str, ==, "+A-A+B-B");
+
+	/* and gets the same one */
+	names_a = pk_test_scheduler_get_names (transaction_a);
+	names_b = pk_test_scheduler_get_names (transaction_b);
+	g_assert_cmpstr (names_a, !=, "");
+	g_assert_cmpstr (names_b, ==, names_a);
+
+	g_object_unref (db);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1416,7 +2497,19 @@ main (int argc, char **argv)
 	g_test_add_func ("/packagekit/spawn", pk_test_spawn_func);
 	g_test_add_func ("/packagekit/scheduler", pk_test_scheduler_func);
 	g_test_add_func ("/packagekit/scheduler-parallel", pk_test_scheduler_parallel_func);
+	g_test_add_func ("/packagekit/scheduler-lease", pk_test_scheduler_lease_func);
+	g_test_add_func ("/packagekit/scheduler-coalesce", pk_test_scheduler_coalesce_func);
+	g_test_add_func ("/packagekit/scheduler-coalesce-failed", pk_test_scheduler_coalesce_failed_func);
+	g_test_add_func ("/packagekit/scheduler-queues", pk_test_scheduler_queues_func);
+	g_test_add_func ("/packagekit/scheduler-readers", pk_test_scheduler_readers_func);
+	g_test_add_func ("/packagekit/scheduler-single-flight", pk_test_scheduler_single_flight_func);
 	g_test_add_func ("/packagekit/transaction-db", pk_test_transaction_db_func);
+	g_test_add_func ("/packagekit/query-cache", pk_test_query_cache_func);
+	g_test_add_func ("/packagekit/auth-cache", pk_test_auth_cache_func);
+	g_test_add_func ("/packagekit/plan-cache", pk_test_plan_cache_func);
+	g_test_add_func ("/packagekit/search-sessions", pk_test_search_sessions_func);
+	g_test_add_func ("/packagekit/metrics", pk_test_metrics_func);
+	g_test_add_func ("/packagekit/index", pk_test_index_func);
 
 	/* backend stuff */
 	g_test_add_func ("/packagekit/backend", pk_test_backend_func);
@@ -37,6 +37,7 @@
 
 #ifdef linux
   #include <sys/syscall.h>
+  #include <errno.h>
 #endif
 
 #ifdef PK_BUILD_DAEMON
@@ -390,32 +391,258 @@ pk_util_set_auto_backend (GKeyFile *conf, GError **error)
 	return TRUE;
 }
 
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+enum {
+	IOPRIO_CLASS_NONE,
+	IOPRIO_CLASS_RT,
+	IOPRIO_CLASS_BE,
+	IOPRIO_CLASS_IDLE
+};
+
+enum {
+	IOPRIO_WHO_PROCESS = 1,
+	IOPRIO_WHO_PGRP,
+	IOPRIO_WHO_USER
+};
+#define IOPRIO_CLASS_SHIFT	13
+
+static gboolean
+pk_ioprio_set (GPid pid, gint class, gint prio)
+{
+	/* FIXME: glibc should have this function */
+	return syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid,
+			prio | (class << IOPRIO_CLASS_SHIFT)) == 0;
+}
+#endif
+
 gboolean
 pk_ioprio_set_idle (GPid pid)
 {
 #if defined(PK_BUILD_DAEMON) && defined(linux)
-	enum {
-		IOPRIO_CLASS_NONE,
-		IOPRIO_CLASS_RT,
-		IOPRIO_CLASS_BE,
-		IOPRIO_CLASS_IDLE
-	};
-
-	enum {
-		IOPRIO_WHO_PROCESS = 1,
-		IOPRIO_WHO_PGRP,
-		IOPRIO_WHO_USER
-	};
-	#define IOPRIO_CLASS_SHIFT	13
-	gint prio = 7;
-	gint class = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
-	/* FIXME: glibc should have this function */
-	return syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, prio | class) == 0;
+	return pk_ioprio_set (pid, IOPRIO_CLASS_IDLE, 7);
+#else
+	return TRUE;
+#endif
+}
+
+/* go back to the priority derived from the CPU nice level */
+gboolean
+pk_ioprio_set_default (GPid pid)
+{
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+	return pk_ioprio_set (pid, IOPRIO_CLASS_NONE, 0);
 #else
 	return TRUE;
 #endif
 }
 
+/* the defaults of cgroup v2 are 100 for both */
+#define PK_BACKGROUND_DEFAULT_CPU_WEIGHT	20
+#define PK_BACKGROUND_DEFAULT_IO_WEIGHT		10
+
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+/* the resource limits of background work, set by pk_background_init() */
+static gboolean	 pk_background_enabled = FALSE;
+static guint64	 pk_background_cpu_weight = 0;
+static guint64	 pk_background_io_weight = 0;
+static guint64	 pk_background_memory_high = 0;
+static gchar	*pk_background_cgroup_main = NULL;	/* threaded, or NULL */
+static gchar	*pk_background_cgroup_idle = NULL;	/* threaded, or NULL */
+
+static gboolean
+pk_background_cgroup_write (const gchar *dir, const gchar *file, const gchar *value)
+{
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *filename = g_build_filename (dir, file, NULL);
+	if (!g_file_set_contents (filename, value, -1, &error)) {
+		g_debug ("failed to write %s to %s: %s", value, filename, error->message);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * pk_background_cgroup_setup:
+ *
+ * If our service cgroup was delegated to us (Delegate=cpu) we split it
+ * into two threaded children, so a single backend thread can be moved
+ * to a lower CPU weight. Only the cpu controller works in threaded mode,
+ * the IO weight and memory limits cannot apply to single threads.
+ **/
+static void
+pk_background_cgroup_setup (void)
+{
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *dir = NULL;
+	g_autofree gchar *main_dir = NULL;
+	g_autofree gchar *idle_dir = NULL;
+	g_autofree gchar *subtree_control = NULL;
+	g_autofree gchar *pid = NULL;
+	g_autofree gchar *weight = NULL;
+	g_auto(GStrv) lines = NULL;
+
+	/* only the unified hierarchy has "0::/path" */
+	if (!g_file_get_contents ("/proc/self/cgroup", &contents, NULL, NULL))
+		return;
+	lines = g_strsplit (contents, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], "0::/") && lines[i][4] != '\0') {
+			dir = g_build_filename ("/sys/fs/cgroup", lines[i] + 3, NULL);
+			break;
+		}
+	}
+	if (dir == NULL)
+		return;
+	subtree_control = g_build_filename (dir, "cgroup.subtree_control", NULL);
+	if (access (subtree_control, W_OK) != 0) {
+		g_debug ("%s is not delegated, not using threaded cgroups", dir);
+		return;
+	}
+
+	main_dir = g_build_filename (dir, "main", NULL);
+	idle_dir = g_build_filename (dir, "background", NULL);
+	if (g_mkdir (main_dir, 0755) != 0 && errno != EEXIST)
+		return;
+	if (g_mkdir (idle_dir, 0755) != 0 && errno != EEXIST)
+		return;
+	if (!pk_background_cgroup_write (main_dir, "cgroup.type", "threaded") ||
+	    !pk_background_cgroup_write (idle_dir, "cgroup.type", "threaded"))
+		return;
+
+	/* a cgroup with controllers enabled cannot also hold threads */
+	pid = g_strdup_printf ("%i", getpid ());
+	if (!pk_background_cgroup_write (main_dir, "cgroup.procs", pid))
+		return;
+	if (!pk_background_cgroup_write (dir, "cgroup.subtree_control", "+cpu"))
+		return;
+	weight = g_strdup_printf ("%" G_GUINT64_FORMAT, pk_background_cpu_weight);
+	if (!pk_background_cgroup_write (idle_dir, "cpu.weight", weight))
+		return;
+
+	g_debug ("background threads use %s", idle_dir);
+	pk_background_cgroup_main = g_steal_pointer (&main_dir);
+	pk_background_cgroup_idle = g_steal_pointer (&idle_dir);
+}
+
+static void
+pk_background_thread_move (const gchar *dir)
+{
+	g_autofree gchar *tid = NULL;
+	if (dir == NULL)
+		return;
+	tid = g_strdup_printf ("%li", (glong) syscall (SYS_gettid));
+	pk_background_cgroup_write (dir, "cgroup.threads", tid);
+}
+
+static void
+pk_background_move_pid_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	value = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (value == NULL)
+		g_debug ("failed to start background scope: %s", error->message);
+}
+#endif
+
+/**
+ * pk_background_init:
+ *
+ * Reads the limits that background transactions run with, on top of the
+ * idle IO priority.
+ **/
+void
+pk_background_init (GKeyFile *conf)
+{
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+	pk_background_enabled = TRUE;
+	if (g_key_file_has_key (conf, "Daemon", "BackgroundIsolation", NULL))
+		pk_background_enabled = g_key_file_get_boolean (conf, "Daemon", "BackgroundIsolation", NULL);
+	if (!pk_background_enabled)
+		return;
+	pk_background_cpu_weight = PK_BACKGROUND_DEFAULT_CPU_WEIGHT;
+	if (g_key_file_has_key (conf, "Daemon", "BackgroundCPUWeight", NULL))
+		pk_background_cpu_weight = g_key_file_get_uint64 (conf, "Daemon", "BackgroundCPUWeight", NULL);
+	pk_background_cpu_weight = CLAMP (pk_background_cpu_weight, 1, 10000);
+	pk_background_io_weight = PK_BACKGROUND_DEFAULT_IO_WEIGHT;
+	if (g_key_file_has_key (conf, "Daemon", "BackgroundIOWeight", NULL))
+		pk_background_io_weight = g_key_file_get_uint64 (conf, "Daemon", "BackgroundIOWeight", NULL);
+	pk_background_io_weight = CLAMP (pk_background_io_weight, 1, 10000);
+	pk_background_memory_high = g_key_file_get_uint64 (conf, "Daemon", "BackgroundMemoryHigh", NULL);
+	pk_background_cgroup_setup ();
+#endif
+}
+
+/**
+ * pk_background_move_pid:
+ *
+ * Moves a spawned helper into its own transient systemd scope with the
+ * background limits. This is asynchronous, so the first few milliseconds
+ * of the child still run with the daemon limits.
+ **/
+void
+pk_background_move_pid (GPid pid)
+{
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+	GVariantBuilder props;
+	g_autofree gchar *name = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+
+	if (!pk_background_enabled)
+		return;
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+	if (connection == NULL)
+		return;
+
+	g_variant_builder_init (&props, G_VARIANT_TYPE ("a(sv)"));
+	g_variant_builder_add (&props, "(sv)", "PIDs",
+			       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+							  &pid, 1, sizeof (guint32)));
+	g_variant_builder_add (&props, "(sv)", "CPUWeight",
+			       g_variant_new_uint64 (pk_background_cpu_weight));
+	g_variant_builder_add (&props, "(sv)", "IOWeight",
+			       g_variant_new_uint64 (pk_background_io_weight));
+	if (pk_background_memory_high > 0) {
+		g_variant_builder_add (&props, "(sv)", "MemoryHigh",
+				       g_variant_new_uint64 (pk_background_memory_high));
+	}
+	g_variant_builder_add (&props, "(sv)", "CollectMode",
+			       g_variant_new_string ("inactive-or-failed"));
+
+	name = g_strdup_printf ("packagekit-background-%i.scope", pid);
+	g_dbus_connection_call (connection,
+				"org.freedesktop.systemd1",
+				"/org/freedesktop/systemd1",
+				"org.freedesktop.systemd1.Manager",
+				"StartTransientUnit",
+				g_variant_new ("(ssa(sv)a(sa(sv)))",
+					       name, "fail", &props, NULL),
+				G_VARIANT_TYPE ("(o)"),
+				G_DBUS_CALL_FLAGS_NO_AUTO_START,
+				-1, NULL,
+				pk_background_move_pid_cb, NULL);
+#endif
+}
+
+/* moves the calling thread to the low CPU weight, if we can */
+void
+pk_background_thread_enter (void)
+{
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+	pk_background_thread_move (pk_background_cgroup_idle);
+#endif
+}
+
+/* moves the calling thread back, as the worker is reused */
+void
+pk_background_thread_leave (void)
+{
+#if defined(PK_BUILD_DAEMON) && defined(linux)
+	pk_background_thread_move (pk_background_cgroup_main);
+#endif
+}
+
 guint
 pk_string_replace (GString *string, const gchar *search, const gchar *replace)
 {
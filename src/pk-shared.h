@@ -53,6 +53,11 @@ gboolean	 pk_is_thread_default_real		(const gchar *strloc,
 							 const gchar *strfunc);
 
 gboolean	 pk_ioprio_set_idle			(GPid		 pid);
+gboolean	 pk_ioprio_set_default			(GPid		 pid);
+void		 pk_background_init			(GKeyFile	*conf);
+void		 pk_background_move_pid			(GPid		 pid);
+void		 pk_background_thread_enter		(void);
+void		 pk_background_thread_leave		(void);
 guint		 pk_string_replace			(GString	*string,
 							 const gchar	*search,
 							 const gchar	*replace);
@@ -39,15 +39,33 @@
 #include <fcntl.h>
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 
 #include "pk-spawn.h"
 #include "pk-shared.h"
+#include "pk-trace.h"
 
 static void     pk_spawn_finalize	(GObject       *object);
 
 #define PK_SPAWN_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_SPAWN, PkSpawnPrivate))
-#define PK_SPAWN_POLL_DELAY	50 /* ms */
 #define PK_SPAWN_SIGKILL_DELAY	2500 /* ms */
+#define PK_SPAWN_EXIT_TIMEOUT	5000 /* ms */
+#define PK_SPAWN_READ_SIZE	4096 /* bytes */
+#define PK_SPAWN_MAX_LINE_LENGTH	(4 * 1024 * 1024) /* bytes */
+
+/* a record is the marker, a big-endian guint32 length, then the payload */
+#define PK_SPAWN_RECORD_MARKER		'\0'
+#define PK_SPAWN_RECORD_HEADER_SIZE	5
+
+typedef struct {
+	gchar			*data;
+	gsize			 size;
+	gsize			 head;		/* start of the partial line */
+	gsize			 tail;		/* end of the data read */
+	gsize			 scan;		/* no newline before here */
+	gsize			 skip;		/* bytes of a record to drop */
+	gboolean		 discard;	/* skipping an over-long line */
+} PkSpawnLineBuffer;
 
 struct PkSpawnPrivate
 {
@@ -55,7 +73,9 @@ struct PkSpawnPrivate
 	gint			 stdin_fd;
 	gint			 stdout_fd;
 	gint			 stderr_fd;
-	guint			 poll_id;
+	GSource			*stdout_source;
+	GSource			*stderr_source;
+	GSource			*child_source;
 	guint			 kill_id;
 	gboolean		 finished;
 	gboolean		 background;
@@ -63,8 +83,9 @@ struct PkSpawnPrivate
 	gboolean		 is_changing_dispatcher;
 	gboolean		 allow_sigkill;
 	PkSpawnExitType		 exit;
-	GString			*stdout_buf;
+	PkSpawnLineBuffer	 stdout_buf;
 	GString			*stderr_buf;
+	guint			 max_line_length;
 	gchar			*last_argv0;
 	gchar			**last_envp;
 	GKeyFile		*conf;
@@ -74,6 +95,7 @@ enum {
 	SIGNAL_EXIT,
 	SIGNAL_STDOUT,
 	SIGNAL_STDERR,
+	SIGNAL_RECORD,
 	SIGNAL_LAST
 };
 
@@ -89,51 +111,165 @@ static guint signals [SIGNAL_LAST] = { 0 };
 G_DEFINE_TYPE (PkSpawn, pk_spawn, G_TYPE_OBJECT)
 
 static gboolean
-pk_spawn_read_fd_into_buffer (gint fd, GString *string)
+pk_spawn_read_should_continue (gssize bytes_read, gint errsv)
 {
-	gint bytes_read;
-	gchar buffer[BUFSIZ];
+	/* the other end has been closed */
+	if (bytes_read == 0)
+		return FALSE;
 
-	/* ITS4: ignore, we manually NULL terminate and GString cannot overflow */
-	while ((bytes_read = read (fd, buffer, BUFSIZ-1)) > 0) {
-		buffer[bytes_read] = '\0';
-		g_string_append (string, buffer);
-	}
+	/* nothing more to read just yet */
+	return errsv == EAGAIN || errsv == EINTR;
+}
 
-	return TRUE;
+static void
+pk_spawn_line_buffer_reserve (PkSpawnLineBuffer *buf, gsize len)
+{
+	if (buf->size - buf->tail >= len)
+		return;
+
+	/* only move the partial line down if that frees half the buffer,
+	 * otherwise a long line would be copied on every read */
+	if (buf->head > 0 && buf->head >= buf->size / 2) {
+		memmove (buf->data, buf->data + buf->head, buf->tail - buf->head);
+		buf->tail -= buf->head;
+		buf->scan -= buf->head;
+		buf->head = 0;
+		if (buf->size - buf->tail >= len)
+			return;
+	}
+	while (buf->size - buf->tail < len)
+		buf->size = MAX (buf->size * 2, PK_SPAWN_READ_SIZE);
+	buf->data = g_realloc (buf->data, buf->size);
 }
 
 static gboolean
-pk_spawn_emit_whole_lines (PkSpawn *spawn, GString *string)
+pk_spawn_emit_record (PkSpawn *spawn)
 {
-	guint i;
-	guint size;
-	guint bytes_processed;
-	g_auto(GStrv) lines = NULL;
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+	guint32 len;
 
-	/* if nothing then don't emit */
-	if (pk_strzero (string->str))
+	/* wait for the whole header */
+	if (buf->tail - buf->head < PK_SPAWN_RECORD_HEADER_SIZE)
 		return FALSE;
+	memcpy (&len, buf->data + buf->head + 1, sizeof (len));
+	len = GUINT32_FROM_BE (len);
+
+	/* the length is known, so skip it without buffering */
+	if (len > spawn->priv->max_line_length) {
+		g_warning ("discarding record longer than %u bytes",
+			   spawn->priv->max_line_length);
+		buf->head += PK_SPAWN_RECORD_HEADER_SIZE;
+		buf->scan = buf->head;
+		buf->skip = len;
+		return TRUE;
+	}
 
-	/* split into lines - the last line may be incomplete */
-	lines = g_strsplit (string->str, "\n", 0);
-	if (lines == NULL)
+	/* wait for the whole payload */
+	if (buf->tail - buf->head < PK_SPAWN_RECORD_HEADER_SIZE + len)
 		return FALSE;
+	PK_TRACE2 (spawn__line, spawn->priv->child_pid, len);
+	g_signal_emit (spawn, signals [SIGNAL_RECORD], 0,
+		       buf->data + buf->head + PK_SPAWN_RECORD_HEADER_SIZE, len);
+	buf->head += PK_SPAWN_RECORD_HEADER_SIZE + len;
+	buf->scan = buf->head;
+	return TRUE;
+}
+
+static void
+pk_spawn_emit_whole_lines (PkSpawn *spawn)
+{
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+	gchar *eol;
+	gsize len;
+
+	while (buf->head < buf->tail) {
+		/* dropping the rest of an over-long record */
+		if (buf->skip > 0) {
+			len = MIN (buf->skip, buf->tail - buf->head);
+			buf->skip -= len;
+			buf->head += len;
+			buf->scan = buf->head;
+			continue;
+		}
 
-	/* find size */
-	size = g_strv_length (lines);
+		/* no text line starts with a NUL, so this is a record */
+		if (!buf->discard && buf->data[buf->head] == PK_SPAWN_RECORD_MARKER) {
+			if (!pk_spawn_emit_record (spawn))
+				break;
+			continue;
+		}
 
-	bytes_processed = 0;
-	/* we only emit n-1 strings */
-	for (i = 0; i < (size-1); i++) {
-		g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, lines[i]);
-		/* ITS4: ignore, g_strsplit always NULL terminates */
-		bytes_processed += strlen (lines[i]) + 1;
+		/* only the bytes read since last time need scanning */
+		eol = memchr (buf->data + buf->scan, '\n', buf->tail - buf->scan);
+		if (eol == NULL) {
+			buf->scan = buf->tail;
+			break;
+		}
+		if (buf->discard) {
+			buf->discard = FALSE;
+		} else {
+			/* terminate in place, the signal does not copy the line */
+			*eol = '\0';
+			PK_TRACE2 (spawn__line, spawn->priv->child_pid,
+				   eol - (buf->data + buf->head));
+			g_signal_emit (spawn, signals [SIGNAL_STDOUT], 0, buf->data + buf->head);
+		}
+		buf->head = eol - buf->data + 1;
+		buf->scan = buf->head;
 	}
 
-	/* remove the text we've processed */
-	g_string_erase (string, 0, bytes_processed);
-	return TRUE;
+	/* either everything was consumed or we are skipping a long line */
+	if (buf->head == buf->tail || buf->discard) {
+		buf->head = buf->tail = buf->scan = 0;
+		return;
+	}
+
+	/* don't let a broken helper make us buffer without bound */
+	if (buf->data[buf->head] != PK_SPAWN_RECORD_MARKER &&
+	    buf->tail - buf->head > spawn->priv->max_line_length) {
+		g_warning ("discarding line longer than %u bytes",
+			   spawn->priv->max_line_length);
+		buf->head = buf->tail = buf->scan = 0;
+		buf->discard = TRUE;
+	}
+}
+
+static gboolean
+pk_spawn_read_stdout (PkSpawn *spawn, gint fd)
+{
+	PkSpawnLineBuffer *buf = &spawn->priv->stdout_buf;
+	gssize bytes_read;
+	gint errsv;
+
+	/* read straight into the line buffer and frame as we go */
+	do {
+		pk_spawn_line_buffer_reserve (buf, PK_SPAWN_READ_SIZE);
+		bytes_read = read (fd, buf->data + buf->tail, buf->size - buf->tail);
+		errsv = errno;
+		if (bytes_read > 0) {
+			buf->tail += bytes_read;
+			pk_spawn_emit_whole_lines (spawn);
+		}
+	} while (bytes_read > 0);
+	return pk_spawn_read_should_continue (bytes_read, errsv);
+}
+
+static gboolean
+pk_spawn_read_stderr (PkSpawn *spawn, gint fd)
+{
+	GString *string = spawn->priv->stderr_buf;
+	gssize bytes_read;
+	gsize len;
+	gint errsv;
+
+	do {
+		len = string->len;
+		g_string_set_size (string, len + PK_SPAWN_READ_SIZE);
+		bytes_read = read (fd, string->str + len, PK_SPAWN_READ_SIZE);
+		errsv = errno;
+		g_string_set_size (string, len + MAX (bytes_read, 0));
+	} while (bytes_read > 0);
+	return pk_spawn_read_should_continue (bytes_read, errsv);
 }
 
 static const gchar *
@@ -154,67 +290,101 @@ pk_spawn_exit_type_enum_to_string (PkSpawnExitType type)
 	return "unknown";
 }
 
-static gboolean
-pk_spawn_check_child (PkSpawn *spawn)
+static void
+pk_spawn_source_clear (GSource **source)
 {
-	pid_t pid;
-	int status;
-	gint retval;
-	static guint limit_printing = 0;
-
-	/* this shouldn't happen */
-	if (spawn->priv->finished) {
-		g_warning ("finished twice!");
-		spawn->priv->poll_id = 0;
-		return FALSE;
-	}
-
-	pk_spawn_read_fd_into_buffer (spawn->priv->stdout_fd, spawn->priv->stdout_buf);
-	pk_spawn_read_fd_into_buffer (spawn->priv->stderr_fd, spawn->priv->stderr_buf);
+	if (*source == NULL)
+		return;
+	g_source_destroy (*source);
+	g_source_unref (*source);
+	*source = NULL;
+}
 
+static void
+pk_spawn_emit_stderr (PkSpawn *spawn)
+{
 	/* emit all lines on standard out in one callback, as it's all probably
 	* related to the error that just happened */
 	if (spawn->priv->stderr_buf->len != 0) {
 		g_signal_emit (spawn, signals [SIGNAL_STDERR], 0, spawn->priv->stderr_buf->str);
 		g_string_set_size (spawn->priv->stderr_buf, 0);
 	}
+}
+
+static void
+pk_spawn_close_fd (gint *fd)
+{
+	if (*fd == -1)
+		return;
+	close (*fd);
+	*fd = -1;
+}
+
+static gboolean
+pk_spawn_stdout_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	gboolean ret;
 
 	/* all usual output goes on standard out, only bad libraries bitch to stderr */
-	pk_spawn_emit_whole_lines (spawn, spawn->priv->stdout_buf);
+	ret = pk_spawn_read_stdout (spawn, fd);
+	if (ret)
+		return G_SOURCE_CONTINUE;
+
+	/* the child closed its end, so nothing more will arrive */
+	pk_spawn_source_clear (&spawn->priv->stdout_source);
+	pk_spawn_close_fd (&spawn->priv->stdout_fd);
+	return G_SOURCE_REMOVE;
+}
 
-	/* Only print one in twenty times to avoid filling the screen */
-	if (limit_printing++ % 20 == 0)
-		g_debug ("polling child_pid=%ld (1/20)", (long)spawn->priv->child_pid);
+static gboolean
+pk_spawn_stderr_cb (gint fd, GIOCondition condition, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	gboolean ret;
 
-	/* check if the child exited */
-	pid = waitpid (spawn->priv->child_pid, &status, WNOHANG);
-	if (pid == -1) {
-		g_warning ("failed to get the child PID data for %ld", (long)spawn->priv->child_pid);
-		return TRUE;
-	}
-	if (pid == 0) {
-		/* process still exist, but has not changed state */
-		return TRUE;
-	}
-	if (pid != spawn->priv->child_pid) {
-		g_warning ("some other process id was returned: got %ld and wanted %ld",
-			     (long)pid, (long)spawn->priv->child_pid);
-		return TRUE;
+	ret = pk_spawn_read_stderr (spawn, fd);
+	pk_spawn_emit_stderr (spawn);
+	if (ret)
+		return G_SOURCE_CONTINUE;
+	pk_spawn_source_clear (&spawn->priv->stderr_source);
+	pk_spawn_close_fd (&spawn->priv->stderr_fd);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_spawn_child_watch_cb (GPid pid, gint status, gpointer user_data)
+{
+	PkSpawn *spawn = PK_SPAWN (user_data);
+	gint retval;
+
+	/* this shouldn't happen */
+	if (spawn->priv->finished) {
+		g_warning ("finished twice!");
+		return;
 	}
 
-	/* disconnect the poll as there will be no more updates */
-	if (spawn->priv->poll_id > 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
+	/* GLib has already reaped the child, so this source is done */
+	pk_spawn_source_clear (&spawn->priv->child_source);
+	PK_TRACE2 (spawn__exit, pid, status);
+	g_spawn_close_pid (pid);
+
+	/* the child may have exited before we got to the last of its output */
+	if (spawn->priv->stderr_fd != -1) {
+		pk_spawn_read_stderr (spawn, spawn->priv->stderr_fd);
+		pk_spawn_emit_stderr (spawn);
 	}
+	if (spawn->priv->stdout_fd != -1)
+		pk_spawn_read_stdout (spawn, spawn->priv->stdout_fd);
+
+	/* disconnect the watches as there will be no more updates */
+	pk_spawn_source_clear (&spawn->priv->stdout_source);
+	pk_spawn_source_clear (&spawn->priv->stderr_source);
 
 	/* child exited, close resources */
-	close (spawn->priv->stdin_fd);
-	close (spawn->priv->stdout_fd);
-	close (spawn->priv->stderr_fd);
-	spawn->priv->stdin_fd = -1;
-	spawn->priv->stdout_fd = -1;
-	spawn->priv->stderr_fd = -1;
+	pk_spawn_close_fd (&spawn->priv->stdin_fd);
+	pk_spawn_close_fd (&spawn->priv->stdout_fd);
+	pk_spawn_close_fd (&spawn->priv->stderr_fd);
 	spawn->priv->child_pid = -1;
 
 	/* use this to detect SIGKILL and SIGQUIT */
@@ -231,12 +401,6 @@ pk_spawn_check_child (PkSpawn *spawn)
 			spawn->priv->exit = PK_SPAWN_EXIT_TYPE_SIGKILL;
 		}
 	} else {
-		/* check we are dead and buried */
-		if (!WIFEXITED (status)) {
-			g_warning ("the process did not exit, but waitpid() returned!");
-			return TRUE;
-		}
-
 		/* get the exit code */
 		retval = WEXITSTATUS (status);
 		if (retval == 0) {
@@ -271,9 +435,55 @@ pk_spawn_check_child (PkSpawn *spawn)
 	/* don't emit if we just closed an invalid dispatcher */
 	g_debug ("emitting exit %s", pk_spawn_exit_type_enum_to_string (spawn->priv->exit));
 	g_signal_emit (spawn, signals [SIGNAL_EXIT], 0, spawn->priv->exit);
+}
 
-	spawn->priv->poll_id = 0;
-	return FALSE;
+static GSource *
+pk_spawn_fd_source_new (PkSpawn *spawn, gint fd, GUnixFDSourceFunc func,
+			const gchar *name, GMainContext *context)
+{
+	GSource *source;
+
+	source = g_unix_fd_source_new (fd, G_IO_IN | G_IO_HUP | G_IO_ERR);
+	g_source_set_callback (source, (GSourceFunc) func, spawn, NULL);
+	g_source_set_name (source, name);
+	g_source_attach (source, context);
+	return source;
+}
+
+static void
+pk_spawn_watch_child (PkSpawn *spawn, GMainContext *context)
+{
+	PkSpawnPrivate *priv = spawn->priv;
+
+	/* the pipes may already have hung up */
+	if (priv->stdout_fd != -1) {
+		priv->stdout_source = pk_spawn_fd_source_new (spawn, priv->stdout_fd,
+							      pk_spawn_stdout_cb,
+							      "[PkSpawn] stdout",
+							      context);
+	}
+	if (priv->stderr_fd != -1) {
+		priv->stderr_source = pk_spawn_fd_source_new (spawn, priv->stderr_fd,
+							      pk_spawn_stderr_cb,
+							      "[PkSpawn] stderr",
+							      context);
+	}
+
+	/* reaps the child, using a pidfd where the kernel supports it */
+	priv->child_source = g_child_watch_source_new (priv->child_pid);
+	g_source_set_callback (priv->child_source,
+			       (GSourceFunc) pk_spawn_child_watch_cb,
+			       spawn, NULL);
+	g_source_set_name (priv->child_source, "[PkSpawn] child watch");
+	g_source_attach (priv->child_source, context);
+}
+
+static void
+pk_spawn_unwatch_child (PkSpawn *spawn)
+{
+	pk_spawn_source_clear (&spawn->priv->stdout_source);
+	pk_spawn_source_clear (&spawn->priv->stderr_source);
+	pk_spawn_source_clear (&spawn->priv->child_source);
 }
 
 static gboolean
@@ -305,6 +515,41 @@ out:
 	return FALSE;
 }
 
+/**
+ * pk_spawn_get_cpu_time:
+ *
+ * Return value: the user and system time the running helper has used so
+ * far in microseconds, or 0 if it is not running
+ **/
+gint64
+pk_spawn_get_cpu_time (PkSpawn *spawn)
+{
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *contents = NULL;
+	g_auto(GStrv) fields = NULL;
+	const gchar *tmp;
+	guint64 ticks;
+
+	g_return_val_if_fail (PK_IS_SPAWN (spawn), 0);
+
+	if (spawn->priv->child_pid == -1)
+		return 0;
+	filename = g_strdup_printf ("/proc/%ld/stat", (long) spawn->priv->child_pid);
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return 0;
+
+	/* the command name can contain spaces, the fields start after it */
+	tmp = strrchr (contents, ')');
+	if (tmp == NULL)
+		return 0;
+	fields = g_strsplit (tmp + 2, " ", -1);
+	if (g_strv_length (fields) < 13)
+		return 0;
+	ticks = g_ascii_strtoull (fields[11], NULL, 10) +
+		g_ascii_strtoull (fields[12], NULL, 10);
+	return (gint64) (ticks * G_USEC_PER_SEC / sysconf (_SC_CLK_TCK));
+}
+
 /**
  * pk_spawn_is_running:
  *
@@ -410,6 +655,14 @@ pk_spawn_send_stdin (PkSpawn *spawn, const gchar *command)
 	return TRUE;
 }
 
+static gboolean
+pk_spawn_exit_timeout_cb (gpointer user_data)
+{
+	gboolean *timed_out = (gboolean *) user_data;
+	*timed_out = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
 /**
  * pk_spawn_exit:
  *
@@ -420,7 +673,9 @@ gboolean
 pk_spawn_exit (PkSpawn *spawn)
 {
 	gboolean ret;
-	guint count = 0;
+	gboolean timed_out = FALSE;
+	g_autoptr(GMainContext) context = NULL;
+	g_autoptr(GSource) timeout = NULL;
 
 	g_return_val_if_fail (PK_IS_SPAWN (spawn), FALSE);
 
@@ -438,22 +693,33 @@ pk_spawn_exit (PkSpawn *spawn)
 		goto out;
 	}
 
-	/* block until the previous script exited */
-	do {
-		g_debug ("waiting for exit");
-		/* Usleep rather than g_main_loop_run -- we have to block.
-		 * If we run the loop, other idle events can be processed,
-		 * and this includes sending data to a new instance,
-		 * which of course will fail as the 'old' script is exiting */
-		g_usleep (10*1000); /* 10 ms */
-		ret = pk_spawn_check_child (spawn);
-	} while (ret && count++ < 500);
+	/* block until the previous script exited -- we run a private context
+	 * rather than the default one as we have to block: if we run the
+	 * default loop, other idle events can be processed, and this includes
+	 * sending data to a new instance, which of course will fail as the
+	 * 'old' script is exiting */
+	g_debug ("waiting for exit");
+	context = g_main_context_new ();
+	pk_spawn_unwatch_child (spawn);
+	pk_spawn_watch_child (spawn, context);
+	timeout = g_timeout_source_new (PK_SPAWN_EXIT_TIMEOUT);
+	g_source_set_callback (timeout, pk_spawn_exit_timeout_cb, &timed_out, NULL);
+	g_source_attach (timeout, context);
+	while (!spawn->priv->finished && !timed_out)
+		g_main_context_iteration (context, TRUE);
+	g_source_destroy (timeout);
 
 	/* the script exited okay */
-	if (count < 500)
+	if (spawn->priv->finished) {
 		ret = TRUE;
-	else
+	} else {
 		g_warning ("failed to exit script");
+		ret = FALSE;
+
+		/* keep watching from the default context in case it exits later */
+		pk_spawn_unwatch_child (spawn);
+		pk_spawn_watch_child (spawn, NULL);
+	}
 out:
 	spawn->priv->is_sending_exit = FALSE;
 	return ret;
@@ -489,6 +755,24 @@ pk_strvequal (gchar **id1, gchar **id2)
 	return TRUE;
 }
 
+/**
+ * pk_spawn_can_reuse:
+ *
+ * Would pk_spawn_argv() hand the command to the running instance rather
+ * than starting a new one?
+ **/
+gboolean
+pk_spawn_can_reuse (PkSpawn *spawn, const gchar *argv0, gchar **envp)
+{
+	g_return_val_if_fail (PK_IS_SPAWN (spawn), FALSE);
+
+	if (spawn->priv->stdin_fd == -1 || spawn->priv->is_sending_exit)
+		return FALSE;
+	if (g_strcmp0 (spawn->priv->last_argv0, argv0) != 0)
+		return FALSE;
+	return pk_strvequal (spawn->priv->last_envp, envp);
+}
+
 /**
  * pk_spawn_argv:
  * @argv: Can be generated using g_strsplit (command, " ", 0)
@@ -559,11 +843,8 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		ret = pk_spawn_exit (spawn);
 		if (!ret) {
 			g_warning ("failed to exit previous instance");
-			/* remove poll, as we can't reply on pk_spawn_check_child() */
-			if (spawn->priv->poll_id != 0) {
-				g_source_remove (spawn->priv->poll_id);
-				spawn->priv->poll_id = 0;
-			}
+			/* remove the watches, as we can't rely on the old instance */
+			pk_spawn_unwatch_child (spawn);
 		}
 		spawn->priv->is_changing_dispatcher = FALSE;
 	}
@@ -583,6 +864,7 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 		g_set_error (error, 1, 0, "failed to spawn %s: %s", argv[0], error_local->message);
 		goto out;
 	}
+	PK_TRACE2 (spawn__child, spawn->priv->child_pid, argv[0]);
 
 #if HAVE_SETPRIORITY
 	/* get the nice value and ensure we are in the valid range */
@@ -600,6 +882,7 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	if (spawn->priv->background) {
 		g_debug ("setting ioprio class to idle");
 		pk_ioprio_set_idle (spawn->priv->child_pid);
+		pk_background_move_pid (spawn->priv->child_pid);
 	}
 
 	/* save this so we can check the dispatcher name */
@@ -610,7 +893,7 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	g_strfreev (spawn->priv->last_envp);
 	spawn->priv->last_envp = g_strdupv (envp);
 
-	/* install an idle handler to check if the child returnd successfully. */
+	/* the watches drain the pipes until they would block */
 	rc = fcntl (spawn->priv->stdout_fd, F_SETFL, O_NONBLOCK);
 	if (rc < 0) {
 		ret = FALSE;
@@ -625,14 +908,13 @@ pk_spawn_argv (PkSpawn *spawn, gchar **argv, gchar **envp,
 	}
 
 	/* sanity check */
-	if (spawn->priv->poll_id != 0) {
-		g_warning ("trying to set timeout when already set");
-		g_source_remove (spawn->priv->poll_id);
+	if (spawn->priv->child_source != NULL) {
+		g_warning ("trying to watch child when already watching");
+		pk_spawn_unwatch_child (spawn);
 	}
 
-	/* poll quickly */
-	spawn->priv->poll_id = g_timeout_add (PK_SPAWN_POLL_DELAY, (GSourceFunc) pk_spawn_check_child, spawn);
-	g_source_set_name_by_id (spawn->priv->poll_id, "[PkSpawn] main poll");
+	/* handle output as soon as it arrives, and the exit as it happens */
+	pk_spawn_watch_child (spawn, NULL);
 out:
 	return ret;
 }
@@ -713,7 +995,13 @@ pk_spawn_class_init (PkSpawnClass *klass)
 		g_signal_new ("stdout",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
 			      0, NULL, NULL, g_cclosure_marshal_VOID__STRING,
-			      G_TYPE_NONE, 1, G_TYPE_STRING);
+			      G_TYPE_NONE, 1, G_TYPE_STRING | G_SIGNAL_TYPE_STATIC_SCOPE);
+	/* the payload is only valid for the duration of the emission */
+	signals [SIGNAL_RECORD] =
+		g_signal_new ("record",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, NULL,
+			      G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_UINT);
 	signals [SIGNAL_STDERR] =
 		g_signal_new ("stderr",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -732,7 +1020,9 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->priv->stdout_fd = -1;
 	spawn->priv->stderr_fd = -1;
 	spawn->priv->stdin_fd = -1;
-	spawn->priv->poll_id = 0;
+	spawn->priv->stdout_source = NULL;
+	spawn->priv->stderr_source = NULL;
+	spawn->priv->child_source = NULL;
 	spawn->priv->kill_id = 0;
 	spawn->priv->finished = FALSE;
 	spawn->priv->is_sending_exit = FALSE;
@@ -743,7 +1033,7 @@ pk_spawn_init (PkSpawn *spawn)
 	spawn->priv->background = FALSE;
 	spawn->priv->exit = PK_SPAWN_EXIT_TYPE_UNKNOWN;
 
-	spawn->priv->stdout_buf = g_string_new ("");
+	spawn->priv->max_line_length = PK_SPAWN_MAX_LINE_LENGTH;
 	spawn->priv->stderr_buf = g_string_new ("");
 }
 
@@ -759,11 +1049,8 @@ pk_spawn_finalize (GObject *object)
 
 	g_return_if_fail (spawn->priv != NULL);
 
-	/* disconnect the poll in case we were cancelled before completion */
-	if (spawn->priv->poll_id != 0) {
-		g_source_remove (spawn->priv->poll_id);
-		spawn->priv->poll_id = 0;
-	}
+	/* disconnect the watches in case we were cancelled before completion */
+	pk_spawn_unwatch_child (spawn);
 
 	/* disconnect the SIGKILL check */
 	if (spawn->priv->kill_id != 0) {
@@ -781,7 +1068,7 @@ pk_spawn_finalize (GObject *object)
 	}
 
 	/* free the buffers */
-	g_string_free (spawn->priv->stdout_buf, TRUE);
+	g_free (spawn->priv->stdout_buf.data);
 	g_string_free (spawn->priv->stderr_buf, TRUE);
 	g_free (spawn->priv->last_argv0);
 	g_strfreev (spawn->priv->last_envp);
@@ -796,6 +1083,13 @@ pk_spawn_new (GKeyFile *conf)
 	PkSpawn *spawn;
 	spawn = g_object_new (PK_TYPE_SPAWN, NULL);
 	spawn->priv->conf = g_key_file_ref (conf);
+	if (g_key_file_has_key (conf, "Daemon", "SpawnMaxLineLength", NULL)) {
+		gint max_line_length = g_key_file_get_integer (conf, "Daemon",
+							       "SpawnMaxLineLength",
+							       NULL);
+		if (max_line_length > 0)
+			spawn->priv->max_line_length = max_line_length;
+	}
 	return PK_SPAWN (spawn);
 }
 
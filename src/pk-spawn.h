@@ -83,6 +83,10 @@ gboolean	 pk_spawn_argv				(PkSpawn	*spawn,
 							 GError		**error)
 							 G_GNUC_WARN_UNUSED_RESULT;
 gboolean	 pk_spawn_is_running			(PkSpawn	*spawn);
+gint64		 pk_spawn_get_cpu_time			(PkSpawn	*spawn);
+gboolean	 pk_spawn_can_reuse			(PkSpawn	*spawn,
+							 const gchar	*argv0,
+							 gchar		**envp);
 gboolean	 pk_spawn_kill				(PkSpawn	*spawn);
 gboolean	 pk_spawn_exit				(PkSpawn	*spawn);
 
@@ -0,0 +1,51 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PK_TRACE_H
+#define __PK_TRACE_H
+
+/*
+ * Static tracepoints for bpftrace, perf and SystemTap, all in the
+ * "packagekit" provider. The probes compile to a single nop when nobody
+ * is attached, so they are safe to leave in release builds; arguments
+ * must be cheap to evaluate as they are computed even then.
+ *
+ * The names are recorded as written, so tracers attach to them with the
+ * double underscores, e.g.
+ * usdt:/usr/libexec/packagekitd:packagekit:transaction__run
+ */
+
+#ifdef PK_ENABLE_USDT
+#include <sys/sdt.h>
+#define PK_TRACE(name)				DTRACE_PROBE(packagekit, name)
+#define PK_TRACE1(name, a1)			DTRACE_PROBE1(packagekit, name, a1)
+#define PK_TRACE2(name, a1, a2)			DTRACE_PROBE2(packagekit, name, a1, a2)
+#define PK_TRACE3(name, a1, a2, a3)		DTRACE_PROBE3(packagekit, name, a1, a2, a3)
+#define PK_TRACE4(name, a1, a2, a3, a4)		DTRACE_PROBE4(packagekit, name, a1, a2, a3, a4)
+#else
+#define PK_TRACE(name)				do { } while (0)
+#define PK_TRACE1(name, a1)			do { } while (0)
+#define PK_TRACE2(name, a1, a2)			do { } while (0)
+#define PK_TRACE3(name, a1, a2, a3)		do { } while (0)
+#define PK_TRACE4(name, a1, a2, a3, a4)		do { } while (0)
+#endif
+
+#endif /* __PK_TRACE_H */
@@ -39,6 +39,7 @@
 #include <packagekit-glib2/pk-enum.h>
 #include <packagekit-glib2/pk-results.h>
 #include <packagekit-glib2/pk-common.h>
+#include <packagekit-glib2/pk-common-private.h>
 
 #include "pk-shared.h"
 
@@ -48,16 +49,46 @@ static void     pk_transaction_db_finalize	(GObject        *object);
 
 #define PK_TRANSACTION_DB_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), PK_TYPE_TRANSACTION_DB, PkTransactionDbPrivate))
 
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (sqlite3_stmt, sqlite3_finalize);
-
 struct PkTransactionDbPrivate
 {
 	gboolean		 loaded;
 	sqlite3			*db;
 	guint			 job_count;
 	guint			 database_save_id;
+	GHashTable		*statements;
+	GHashTable		*pending;
+	gint64			 max_age;
+	guint			 max_rows;
+	gint64			 archive_age;
+	gboolean		 vacuum_pending;
+	gboolean		 compress;
+	GThreadPool		*reader_pool;
+	sqlite3			*reader_db;
+	GCancellable		*reader_cancellable;
 };
 
+#define PK_TRANSACTION_DB_MAINTENANCE_BATCH	100 /* rows */
+
+/* metadata for a transaction that is written in one go when it finishes */
+typedef struct {
+	gchar			*tid;
+	gchar			*timespec;
+	PkRoleEnum		 role;
+	guint			 uid;
+	gchar			*cmdline;
+	gchar			*data;
+	guint64			 cpu_time;
+	guint64			 memory_growth;
+	guint64			 bytes_emitted;
+} PkTransactionDbPending;
+
+/* a read-only query run on the reader thread */
+typedef struct {
+	guint			 limit;
+	gchar			**names;
+	guint			 max_size;
+} PkTransactionDbQuery;
+
 G_DEFINE_TYPE (PkTransactionDb, pk_transaction_db, G_TYPE_OBJECT)
 
 typedef struct {
@@ -70,62 +101,114 @@ typedef struct {
 	gboolean	set;
 } PkTransactionDbProxyItem;
 
-static gint
-pk_transaction_db_add_transaction_cb (void *data,
-				      gint argc,
-				      gchar **argv,
-				      gchar **col_name)
+#define PK_TRANSACTION_DB_PACKAGE_ID_LOOKUP_SQL \
+	"SELECT package_id FROM package_ids WHERE id = ?1"
+
+static GBytes *
+pk_transaction_db_convert (GConverter *converter, gconstpointer data, gsize len, GError **error)
 {
-	PkTransactionPast *item;
-	GList **list = (GList **) data;
-	gint i;
-	gchar *col;
-	gchar *value;
-	guint temp;
+	g_autoptr(GOutputStream) base = NULL;
+	g_autoptr(GOutputStream) stream = NULL;
+
+	base = g_memory_output_stream_new_resizable ();
+	stream = g_converter_output_stream_new (base, converter);
+	if (!g_output_stream_write_all (stream, data, len, NULL, NULL, error))
+		return NULL;
+	if (!g_output_stream_close (stream, NULL, error))
+		return NULL;
+	return g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (base));
+}
 
-	item = pk_transaction_past_new ();
-	for (i = 0; i < argc; i++) {
-		col = col_name[i];
-		value = argv[i];
-		if (g_strcmp0 (col, "succeeded") == 0) {
-			if (!pk_strtouint (value, &temp)) {
-				g_warning ("failed to parse succeeded: %s", value);
-				continue;
-			}
-			if (temp == 1)
-				g_object_set (item, "succeeded", TRUE, NULL);
-			else
-				g_object_set (item, "succeeded", FALSE, NULL);
-		} else if (g_strcmp0 (col, "role") == 0) {
-			if (value != NULL)
-				g_object_set (item, "role", pk_role_enum_from_string (value), NULL);
-		} else if (g_strcmp0 (col, "transaction_id") == 0) {
-			if (value != NULL)
-				g_object_set (item, "tid", value, NULL);
-		} else if (g_strcmp0 (col, "timespec") == 0) {
-			if (value != NULL)
-				g_object_set (item, "timespec", value, NULL);
-		} else if (g_strcmp0 (col, "cmdline") == 0) {
-			if (value != NULL)
-				g_object_set (item, "cmdline", value, NULL);
-		} else if (g_strcmp0 (col, "data") == 0) {
-			if (value != NULL)
-				g_object_set (item, "data", value, NULL);
-		} else if (g_strcmp0 (col, "uid") == 0) {
-			if (pk_strtouint (value, &temp))
-				g_object_set (item, "uid", temp, NULL);
-		} else if (g_strcmp0 (col, "duration") == 0) {
-			if (pk_strtouint (value, &temp))
-				g_object_set (item, "duration", temp, NULL);
-		} else {
-			g_warning ("%s = %s", col, value);
+/**
+ * pk_transaction_db_decode_data:
+ * @lookup: a prepared %PK_TRANSACTION_DB_PACKAGE_ID_LOOKUP_SQL statement
+ *
+ * Turns a data_z blob back into the plain "info\tpackage-id\tsummary" lines.
+ *
+ * Return value: the package list, or %NULL if the blob is corrupt
+ **/
+static gchar *
+pk_transaction_db_decode_data (sqlite3_stmt *lookup, gconstpointer blob, gsize len)
+{
+	const gchar *package_id;
+	gint64 key;
+	guint i;
+	GString *string;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GConverter) converter = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *text = NULL;
+	g_auto(GStrv) package_lines = NULL;
+
+	converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW));
+	bytes = pk_transaction_db_convert (converter, blob, len, &error);
+	if (bytes == NULL) {
+		g_warning ("failed to decompress transaction data: %s", error->message);
+		return NULL;
+	}
+	text = g_strndup (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+
+	string = g_string_new ("");
+	package_lines = g_strsplit (text, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		g_auto(GStrv) split = g_strsplit (package_lines[i], "\t", 3);
+		if (g_strv_length (split) != 3 || !g_ascii_string_to_signed (split[1], 10, 0, G_MAXINT64, &key, NULL)) {
+			g_warning ("invalid transaction data line: %s", package_lines[i]);
+			g_string_free (string, TRUE);
+			return NULL;
+		}
+		sqlite3_bind_int64 (lookup, 1, key);
+		package_id = sqlite3_step (lookup) == SQLITE_ROW ?
+			(const gchar *) sqlite3_column_text (lookup, 0) : NULL;
+		if (package_id == NULL) {
+			g_warning ("unknown package-id %" G_GINT64_FORMAT, key);
+			sqlite3_reset (lookup);
+			g_string_free (string, TRUE);
+			return NULL;
 		}
+		if (i > 0)
+			g_string_append_c (string, '\n');
+		g_string_append_printf (string, "%s\t%s\t%s", split[0], package_id, split[2]);
+		sqlite3_reset (lookup);
 	}
+	return g_string_free (string, FALSE);
+}
 
-	/* add to start of the list */
-	*list = g_list_prepend (*list, item);
+/* columns as selected by pk_transaction_db_query_list() */
+static PkTransactionPast *
+pk_transaction_db_item_from_row (sqlite3_stmt *statement, sqlite3_stmt *lookup)
+{
+	const gchar *tmp;
+	PkTransactionPast *item;
+	g_autofree gchar *data = NULL;
 
-	return 0;
+	item = pk_transaction_past_new ();
+	g_object_set (item,
+		      "tid", (const gchar *) sqlite3_column_text (statement, 0),
+		      "timespec", (const gchar *) sqlite3_column_text (statement, 1),
+		      "succeeded", sqlite3_column_int (statement, 2) == 1,
+		      "duration", (guint) sqlite3_column_int (statement, 3),
+		      "uid", (guint) sqlite3_column_int (statement, 6),
+		      "cmdline", (const gchar *) sqlite3_column_text (statement, 7),
+		      "cpu-time", (guint64) sqlite3_column_int64 (statement, 9),
+		      "memory-growth", (guint64) sqlite3_column_int64 (statement, 10),
+		      "bytes-emitted", (guint64) sqlite3_column_int64 (statement, 11),
+		      NULL);
+	tmp = (const gchar *) sqlite3_column_text (statement, 4);
+	if (tmp != NULL)
+		g_object_set (item, "role", pk_role_enum_from_string (tmp), NULL);
+
+	/* compressed rows keep the text column empty */
+	if (sqlite3_column_type (statement, 8) == SQLITE_BLOB) {
+		data = pk_transaction_db_decode_data (lookup,
+						      sqlite3_column_blob (statement, 8),
+						      sqlite3_column_bytes (statement, 8));
+	} else {
+		data = g_strdup ((const gchar *) sqlite3_column_text (statement, 5));
+	}
+	if (data != NULL)
+		g_object_set (item, "data", data, NULL);
+	return item;
 }
 
 static gboolean
@@ -259,116 +342,965 @@ pk_transaction_db_action_time_reset (PkTransactionDb *tdb, PkRoleEnum role)
 	return TRUE;
 }
 
-GList *
-pk_transaction_db_get_list (PkTransactionDb *tdb, guint limit)
+static gboolean
+pk_transaction_db_query_list (sqlite3 *db, guint limit, GList **list, GError **error)
+{
+	gint rc;
+	sqlite3_stmt *lookup = NULL;
+	sqlite3_stmt *statement = NULL;
+
+	rc = sqlite3_prepare_v2 (db,
+				 "SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline, data_z, "
+				 "cpu_time, memory_growth, bytes_emitted "
+				 "FROM transactions ORDER BY timespec DESC LIMIT ?1",
+				 -1, &statement, NULL);
+	if (rc == SQLITE_OK)
+		rc = sqlite3_prepare_v2 (db, PK_TRANSACTION_DB_PACKAGE_ID_LOOKUP_SQL, -1, &lookup, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0, "SQL error: %s", sqlite3_errmsg (db));
+		sqlite3_finalize (statement);
+		return FALSE;
+	}
+	sqlite3_bind_int (statement, 1, limit > 0 ? (gint) MIN (limit, G_MAXINT) : -1);
+
+	/* add to start of the list */
+	while ((rc = sqlite3_step (statement)) == SQLITE_ROW)
+		*list = g_list_prepend (*list, pk_transaction_db_item_from_row (statement, lookup));
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, 1, 0, "SQL error: %s", sqlite3_errmsg (db));
+		g_list_free_full (*list, (GDestroyNotify) g_object_unref);
+		*list = NULL;
+	}
+	sqlite3_finalize (lookup);
+	sqlite3_finalize (statement);
+	return rc == SQLITE_DONE;
+}
+
+GList *
+pk_transaction_db_get_list (PkTransactionDb *tdb, guint limit)
+{
+	GList *list = NULL;
+	g_autoptr(GError) error = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+
+	if (!pk_transaction_db_query_list (tdb->priv->db, limit, &list, &error))
+		g_warning ("%s", error->message);
+	return list;
+}
+
+static void
+pk_transaction_db_pending_free (PkTransactionDbPending *pending)
+{
+	g_free (pending->tid);
+	g_free (pending->timespec);
+	g_free (pending->cmdline);
+	g_free (pending->data);
+	g_free (pending);
+}
+
+/* the returned statement is owned by the cache and must not be finalized */
+static gboolean
+pk_transaction_db_prepare (PkTransactionDb *tdb, const gchar *sql, sqlite3_stmt **statement)
+{
+	gint rc = 0;
+
+	/* reuse the compiled statement */
+	*statement = g_hash_table_lookup (tdb->priv->statements, sql);
+	if (*statement != NULL) {
+		sqlite3_reset (*statement);
+		sqlite3_clear_bindings (*statement);
+		return TRUE;
+	}
+
+	if ((rc = sqlite3_prepare_v2 (tdb->priv->db,
+				      sql,
+				      -1,
+				      statement,
+				      NULL)) != SQLITE_OK) {
+		g_warning ("(%s) prepare error: %d: %s", sql, rc, sqlite3_errmsg (tdb->priv->db));
+		*statement = NULL;
+		return FALSE;
+	}
+	g_hash_table_insert (tdb->priv->statements, g_strdup (sql), *statement);
+
+	return TRUE;
+}
+
+static gboolean
+pk_transaction_db_step (sqlite3 *db, sqlite3_stmt *statement)
+{
+	gint rc = 0;
+
+	rc = sqlite3_step (statement);
+
+	/* do not hold the statement open until it is next used */
+	sqlite3_reset (statement);
+
+	if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+		g_warning ("SQL error: %d: %s", rc, sqlite3_errmsg (db));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+pk_transaction_db_set_strings (PkTransactionDb *tdb, const gchar *sql, const gchar *first, const gchar *second)
+{
+	sqlite3_stmt *statement = NULL;
+	gint rc = 0;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
+	g_return_val_if_fail (sql != NULL, FALSE);
+	g_return_val_if_fail (first != NULL, FALSE);
+	g_return_val_if_fail (second != NULL, FALSE);
+
+	if (!pk_transaction_db_prepare (tdb, sql, &statement))
+		return FALSE;
+
+	if ((rc = sqlite3_bind_text (statement, 1, first, -1, SQLITE_STATIC)) != SQLITE_OK) {
+		g_warning ("bind text1 error: %d: %s", rc, sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+
+	if ((rc = sqlite3_bind_text (statement, 2, second, -1, SQLITE_STATIC)) != SQLITE_OK) {
+		g_warning ("bind text2 error: %d: %s", rc, sqlite3_errmsg (tdb->priv->db));
+		return FALSE;
+	}
+
+	return pk_transaction_db_step (tdb->priv->db, statement);
+}
+
+static gint64
+pk_transaction_db_get_package_id_key (PkTransactionDb *tdb, const gchar *package_id)
+{
+	gint64 key = -1;
+	sqlite3_stmt *statement = NULL;
+
+	if (!pk_transaction_db_prepare (tdb,
+					"SELECT id FROM package_ids WHERE package_id = ?1",
+					&statement))
+		return -1;
+	sqlite3_bind_text (statement, 1, package_id, -1, SQLITE_STATIC);
+	if (sqlite3_step (statement) == SQLITE_ROW)
+		key = sqlite3_column_int64 (statement, 0);
+	sqlite3_reset (statement);
+	if (key >= 0)
+		return key;
+
+	if (!pk_transaction_db_prepare (tdb,
+					"INSERT INTO package_ids (package_id) VALUES (?1)",
+					&statement))
+		return -1;
+	sqlite3_bind_text (statement, 1, package_id, -1, SQLITE_STATIC);
+	if (!pk_transaction_db_step (tdb->priv->db, statement))
+		return -1;
+	return sqlite3_last_insert_rowid (tdb->priv->db);
+}
+
+/**
+ * pk_transaction_db_encode_data:
+ *
+ * Replaces each package-id with its key in the package_ids table, which is
+ * shared by all rows, and deflates the result.
+ *
+ * Return value: the data_z blob, or %NULL to store @data as plain text
+ **/
+static GBytes *
+pk_transaction_db_encode_data (PkTransactionDb *tdb, const gchar *data)
+{
+	gint64 key;
+	guint i;
+	g_autoptr(GConverter) converter = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) string = NULL;
+	g_auto(GStrv) package_lines = NULL;
+
+	string = g_string_new ("");
+	package_lines = g_strsplit (data, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		g_auto(GStrv) split = g_strsplit (package_lines[i], "\t", 3);
+		if (g_strv_length (split) != 3)
+			return NULL;
+		key = pk_transaction_db_get_package_id_key (tdb, split[1]);
+		if (key < 0)
+			return NULL;
+		if (i > 0)
+			g_string_append_c (string, '\n');
+		g_string_append_printf (string, "%s\t%" G_GINT64_FORMAT "\t%s",
+					split[0], key, split[2]);
+	}
+
+	converter = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW, -1));
+	return pk_transaction_db_convert (converter, string->str, string->len, &error);
+}
+
+/* binds @data either as text at @text_idx or compressed at @blob_idx */
+static void
+pk_transaction_db_bind_data (PkTransactionDb *tdb,
+			     sqlite3_stmt *statement,
+			     gint text_idx,
+			     gint blob_idx,
+			     const gchar *data)
+{
+	g_autoptr(GBytes) blob = NULL;
+
+	if (tdb->priv->compress && data != NULL && data[0] != '\0')
+		blob = pk_transaction_db_encode_data (tdb, data);
+	if (blob == NULL) {
+		sqlite3_bind_text (statement, text_idx, data, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_null (statement, blob_idx);
+		return;
+	}
+	sqlite3_bind_null (statement, text_idx);
+	sqlite3_bind_blob (statement, blob_idx,
+			   g_bytes_get_data (blob, NULL),
+			   g_bytes_get_size (blob),
+			   SQLITE_TRANSIENT);
+}
+
+/* transactions without a timestamp are not interesting */
+static gboolean
+pk_transaction_db_timespec_to_unix (const gchar *timespec, gint64 *timestamp)
+{
+	GTimeVal timeval;
+	if (timespec == NULL || !g_time_val_from_iso8601 (timespec, &timeval))
+		return FALSE;
+	*timestamp = timeval.tv_sec;
+	return timeval.tv_sec != 0;
+}
+
+static gboolean
+pk_transaction_db_is_package_history_interesting (PkPackage *package)
+{
+	switch (pk_package_get_info (package)) {
+	case PK_INFO_ENUM_INSTALLING:
+	case PK_INFO_ENUM_REMOVING:
+	case PK_INFO_ENUM_UPDATING:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/* split the package list of a finished transaction into package_history */
+static void
+pk_transaction_db_add_package_history (PkTransactionDb *tdb,
+				       const gchar *tid,
+				       const gchar *timespec,
+				       guint uid,
+				       const gchar *data)
+{
+	gint64 timestamp;
+	guint i;
+	sqlite3_stmt *statement = NULL;
+	g_auto(GStrv) package_lines = NULL;
+	g_autoptr(PkPackage) package_tmp = NULL;
+
+	if (data == NULL)
+		return;
+	if (!pk_transaction_db_timespec_to_unix (timespec, &timestamp))
+		return;
+	if (!pk_transaction_db_prepare (tdb,
+					"INSERT INTO package_history (name, version, arch, data, "
+					"info, timestamp, uid, transaction_id) "
+					"VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8)",
+					&statement))
+		return;
+
+	package_tmp = pk_package_new ();
+	package_lines = g_strsplit (data, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		g_autoptr(GError) error_local = NULL;
+		if (!pk_package_parse (package_tmp, package_lines[i], &error_local)) {
+			g_warning ("Failed to parse package: '%s': %s",
+				   package_lines[i], error_local->message);
+			continue;
+		}
+		if (!pk_transaction_db_is_package_history_interesting (package_tmp))
+			continue;
+		sqlite3_bind_text (statement, 1, pk_package_get_name (package_tmp), -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 2, pk_package_get_version (package_tmp), -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 3, pk_package_get_arch (package_tmp), -1, SQLITE_STATIC);
+		sqlite3_bind_text (statement, 4, pk_package_get_data (package_tmp), -1, SQLITE_STATIC);
+		sqlite3_bind_int (statement, 5, pk_package_get_info (package_tmp));
+		sqlite3_bind_int64 (statement, 6, timestamp);
+		sqlite3_bind_int (statement, 7, uid);
+		sqlite3_bind_text (statement, 8, tid, -1, SQLITE_STATIC);
+		pk_transaction_db_step (tdb->priv->db, statement);
+	}
+}
+
+/* keep the per-month counts of every package touched by @data current */
+static void
+pk_transaction_db_add_package_stats (PkTransactionDb *tdb,
+				     const gchar *timespec,
+				     const gchar *data,
+				     gboolean success)
+{
+	gint64 timestamp;
+	guint i;
+	sqlite3_stmt *insert = NULL;
+	sqlite3_stmt *update = NULL;
+	g_autofree gchar *month = NULL;
+	g_autoptr(GDateTime) datetime = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+	g_auto(GStrv) package_lines = NULL;
+	g_autoptr(PkPackage) package_tmp = NULL;
+
+	if (data == NULL)
+		return;
+	if (!pk_transaction_db_timespec_to_unix (timespec, &timestamp))
+		return;
+	if (!pk_transaction_db_prepare (tdb,
+					"INSERT OR IGNORE INTO package_stats (name, month) VALUES (?1, ?2)",
+					&insert))
+		return;
+	if (!pk_transaction_db_prepare (tdb,
+					"UPDATE package_stats SET installs = installs + ?3, "
+					"updates = updates + ?4, removes = removes + ?5, "
+					"failures = failures + ?6, last_updated = MAX(last_updated, ?7) "
+					"WHERE name = ?1 AND month = ?2",
+					&update))
+		return;
+	datetime = g_date_time_new_from_unix_utc (timestamp);
+	month = g_date_time_format (datetime, "%Y-%m");
+
+	/* multiarch packages are counted once */
+	seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	package_tmp = pk_package_new ();
+	package_lines = g_strsplit (data, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		PkInfoEnum info;
+		const gchar *name;
+		g_autoptr(GError) error_local = NULL;
+
+		if (!pk_package_parse (package_tmp, package_lines[i], &error_local))
+			continue;
+		if (!pk_transaction_db_is_package_history_interesting (package_tmp))
+			continue;
+		name = pk_package_get_name (package_tmp);
+		if (!g_hash_table_add (seen, g_strdup (name)))
+			continue;
+		info = pk_package_get_info (package_tmp);
+		sqlite3_bind_text (insert, 1, name, -1, SQLITE_STATIC);
+		sqlite3_bind_text (insert, 2, month, -1, SQLITE_STATIC);
+		pk_transaction_db_step (tdb->priv->db, insert);
+		sqlite3_bind_text (update, 1, name, -1, SQLITE_STATIC);
+		sqlite3_bind_text (update, 2, month, -1, SQLITE_STATIC);
+		sqlite3_bind_int (update, 3, success && info == PK_INFO_ENUM_INSTALLING);
+		sqlite3_bind_int (update, 4, success && info == PK_INFO_ENUM_UPDATING);
+		sqlite3_bind_int (update, 5, success && info == PK_INFO_ENUM_REMOVING);
+		sqlite3_bind_int (update, 6, !success);
+		sqlite3_bind_int64 (update, 7, success ? timestamp : 0);
+		pk_transaction_db_step (tdb->priv->db, update);
+	}
+}
+
+/* one entry per timestamp, in the case of multiarch */
+#define PK_TRANSACTION_DB_PACKAGE_HISTORY_SQL \
+	"SELECT info, data, version, timestamp, uid " \
+	"FROM package_history WHERE name = ?1 " \
+	"GROUP BY timestamp ORDER BY timestamp DESC LIMIT ?2"
+
+static GVariant *
+pk_transaction_db_query_package_history (sqlite3_stmt *statement,
+					 const gchar *name,
+					 guint max_size)
+{
+	const gchar *tmp;
+	GVariantBuilder builder;
+	g_autoptr(GPtrArray) array = NULL;
+
+	sqlite3_bind_text (statement, 1, name, -1, SQLITE_STATIC);
+	sqlite3_bind_int (statement, 2, max_size > 0 ? (gint) MIN (max_size, G_MAXINT) : -1);
+
+	array = g_ptr_array_new ();
+	while (sqlite3_step (statement) == SQLITE_ROW) {
+		g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+		g_variant_builder_add (&builder, "{sv}", "info",
+				       g_variant_new_uint32 (sqlite3_column_int (statement, 0)));
+		tmp = (const gchar *) sqlite3_column_text (statement, 1);
+		g_variant_builder_add (&builder, "{sv}", "source",
+				       g_variant_new_string (tmp != NULL ? tmp : ""));
+		tmp = (const gchar *) sqlite3_column_text (statement, 2);
+		g_variant_builder_add (&builder, "{sv}", "version",
+				       g_variant_new_string (tmp != NULL ? tmp : ""));
+		g_variant_builder_add (&builder, "{sv}", "timestamp",
+				       g_variant_new_uint64 (sqlite3_column_int64 (statement, 3)));
+		g_variant_builder_add (&builder, "{sv}", "user-id",
+				       g_variant_new_uint32 (sqlite3_column_int (statement, 4)));
+
+		/* newest come first, so build the array backwards */
+		g_ptr_array_insert (array, 0, g_variant_builder_end (&builder));
+	}
+	sqlite3_reset (statement);
+
+	if (array->len == 0)
+		return NULL;
+	return g_variant_new_array (G_VARIANT_TYPE ("a{sv}"),
+				    (GVariant * const *) array->pdata,
+				    array->len);
+}
+
+/**
+ * pk_transaction_db_get_package_history:
+ * @name: the package name, e.g. "colord"
+ * @max_size: the maximum number of entries, or 0 for no limit
+ *
+ * Gets the most recent successful installs, updates and removals of a
+ * package, oldest first.
+ *
+ * Return value: a #GVariant of type aa{sv}, or %NULL if there is no history
+ **/
+GVariant *
+pk_transaction_db_get_package_history (PkTransactionDb *tdb,
+				       const gchar *name,
+				       guint max_size)
+{
+	sqlite3_stmt *statement = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
+	g_return_val_if_fail (tdb->priv->db != NULL, NULL);
+	g_return_val_if_fail (name != NULL, NULL);
+
+	if (!pk_transaction_db_prepare (tdb, PK_TRANSACTION_DB_PACKAGE_HISTORY_SQL, &statement))
+		return NULL;
+	return pk_transaction_db_query_package_history (statement, name, max_size);
+}
+
+/* the reader thread stops a running query when the caller goes away */
+static gint
+pk_transaction_db_reader_progress_cb (void *data)
+{
+	PkTransactionDbPrivate *priv = (PkTransactionDbPrivate *) data;
+	return g_cancellable_is_cancelled (priv->reader_cancellable) ? 1 : 0;
+}
+
+/* only ever called on the reader thread */
+static sqlite3 *
+pk_transaction_db_reader_open (PkTransactionDbPrivate *priv, GError **error)
+{
+	gint rc;
+
+	if (priv->reader_db != NULL)
+		return priv->reader_db;
+
+	/* a second connection, so the writer on the main thread is never blocked */
+	rc = sqlite3_open_v2 (PK_DB_DIR "/transactions.db", &priv->reader_db,
+			      SQLITE_OPEN_READONLY, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error,
+			     1, 0,
+			     "Can't open transaction database: %s",
+			     sqlite3_errmsg (priv->reader_db));
+		sqlite3_close (priv->reader_db);
+		priv->reader_db = NULL;
+		return NULL;
+	}
+	sqlite3_busy_timeout (priv->reader_db, 5000);
+	sqlite3_progress_handler (priv->reader_db, 1000,
+				  pk_transaction_db_reader_progress_cb, priv);
+	return priv->reader_db;
+}
+
+static GVariant *
+pk_transaction_db_query_package_histories (sqlite3 *db,
+					   gchar **names,
+					   guint max_size,
+					   GCancellable *cancellable,
+					   GError **error)
+{
+	gint rc;
+	guint i;
+	GVariant *value;
+	GVariantBuilder builder;
+	sqlite3_stmt *statement = NULL;
+	g_autoptr(GHashTable) hash = NULL;
+
+	rc = sqlite3_prepare_v2 (db, PK_TRANSACTION_DB_PACKAGE_HISTORY_SQL, -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (db));
+		return NULL;
+	}
+
+	/* no history returns an empty array */
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{saa{sv}}"));
+	for (i = 0; names[i] != NULL; i++) {
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+		if (!g_hash_table_add (hash, names[i]))
+			continue;
+		value = pk_transaction_db_query_package_history (statement, names[i], max_size);
+		if (value == NULL)
+			continue;
+		g_variant_builder_add (&builder, "{s@aa{sv}}", names[i], value);
+	}
+	sqlite3_finalize (statement);
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+#define PK_TRANSACTION_DB_PACKAGE_STATS_COLUMNS \
+	"SELECT name, month, installs, updates, removes, failures, last_updated FROM package_stats "
+
+/* rows of one package are next to each other, oldest month first */
+static GVariant *
+pk_transaction_db_query_history_stats (sqlite3 *db,
+				       gchar **names,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	gint rc;
+	guint i;
+	GVariantBuilder builder;
+	GVariantBuilder months;
+	sqlite3_stmt *statement = NULL;
+	g_autofree gchar *name_last = NULL;
+	g_autoptr(GHashTable) hash = NULL;
+
+	if (names[0] == NULL) {
+		rc = sqlite3_prepare_v2 (db,
+					 PK_TRANSACTION_DB_PACKAGE_STATS_COLUMNS
+					 "ORDER BY name, month",
+					 -1, &statement, NULL);
+	} else {
+		rc = sqlite3_prepare_v2 (db,
+					 PK_TRANSACTION_DB_PACKAGE_STATS_COLUMNS
+					 "WHERE name = ?1 ORDER BY month",
+					 -1, &statement, NULL);
+	}
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to prepare statement: %s",
+			     sqlite3_errmsg (db));
+		return NULL;
+	}
+
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{saa{sv}}"));
+	for (i = 0; i == 0 || names[i] != NULL; i++) {
+		if (g_cancellable_is_cancelled (cancellable))
+			break;
+		if (names[i] != NULL) {
+			if (!g_hash_table_add (hash, names[i]))
+				continue;
+			sqlite3_reset (statement);
+			sqlite3_bind_text (statement, 1, names[i], -1, SQLITE_STATIC);
+		}
+		while (sqlite3_step (statement) == SQLITE_ROW) {
+			const gchar *name = (const gchar *) sqlite3_column_text (statement, 0);
+			const gchar *month = (const gchar *) sqlite3_column_text (statement, 1);
+			if (name == NULL || month == NULL)
+				continue;
+			if (g_strcmp0 (name, name_last) != 0) {
+				if (name_last != NULL)
+					g_variant_builder_add (&builder, "{saa{sv}}", name_last, &months);
+				g_free (name_last);
+				name_last = g_strdup (name);
+				g_variant_builder_init (&months, G_VARIANT_TYPE ("aa{sv}"));
+			}
+			g_variant_builder_open (&months, G_VARIANT_TYPE ("a{sv}"));
+			g_variant_builder_add (&months, "{sv}", "month",
+					       g_variant_new_string (month));
+			g_variant_builder_add (&months, "{sv}", "installs",
+					       g_variant_new_uint32 (sqlite3_column_int (statement, 2)));
+			g_variant_builder_add (&months, "{sv}", "updates",
+					       g_variant_new_uint32 (sqlite3_column_int (statement, 3)));
+			g_variant_builder_add (&months, "{sv}", "removes",
+					       g_variant_new_uint32 (sqlite3_column_int (statement, 4)));
+			g_variant_builder_add (&months, "{sv}", "failures",
+					       g_variant_new_uint32 (sqlite3_column_int (statement, 5)));
+			g_variant_builder_add (&months, "{sv}", "last-updated",
+					       g_variant_new_uint64 (sqlite3_column_int64 (statement, 6)));
+			g_variant_builder_close (&months);
+		}
+		if (names[i] == NULL)
+			break;
+	}
+	if (name_last != NULL)
+		g_variant_builder_add (&builder, "{saa{sv}}", name_last, &months);
+	sqlite3_finalize (statement);
+	return g_variant_ref_sink (g_variant_builder_end (&builder));
+}
+
+static void
+pk_transaction_db_list_free (GList *list)
+{
+	g_list_free_full (list, (GDestroyNotify) g_object_unref);
+}
+
+static void
+pk_transaction_db_reader_func (gpointer data, gpointer user_data)
+{
+	GCancellable *cancellable;
+	GList *list = NULL;
+	GTask *task = G_TASK (data);
+	GVariant *value;
+	PkTransactionDbPrivate *priv = (PkTransactionDbPrivate *) user_data;
+	PkTransactionDbQuery *query = g_task_get_task_data (task);
+	sqlite3 *db;
+	GError *error = NULL;
+
+	/* the caller went away while this was queued */
+	if (g_task_return_error_if_cancelled (task))
+		goto out;
+
+	db = pk_transaction_db_reader_open (priv, &error);
+	if (db == NULL) {
+		g_task_return_error (task, error);
+		goto out;
+	}
+
+	cancellable = g_task_get_cancellable (task);
+	priv->reader_cancellable = cancellable;
+	if (g_task_get_source_tag (task) == pk_transaction_db_get_list_async) {
+		if (!pk_transaction_db_query_list (db, query->limit, &list, &error)) {
+			priv->reader_cancellable = NULL;
+			if (!g_task_return_error_if_cancelled (task))
+				g_task_return_error (task, error);
+			else
+				g_error_free (error);
+			goto out;
+		}
+		priv->reader_cancellable = NULL;
+		if (g_task_return_error_if_cancelled (task)) {
+			pk_transaction_db_list_free (list);
+			goto out;
+		}
+		g_task_return_pointer (task, list, (GDestroyNotify) pk_transaction_db_list_free);
+	} else {
+		if (g_task_get_source_tag (task) == pk_transaction_db_get_history_stats_async) {
+			value = pk_transaction_db_query_history_stats (db, query->names,
+								       cancellable, &error);
+		} else {
+			value = pk_transaction_db_query_package_histories (db, query->names,
+									   query->max_size,
+									   cancellable, &error);
+		}
+		priv->reader_cancellable = NULL;
+		if (value == NULL) {
+			g_task_return_error (task, error);
+			goto out;
+		}
+		if (g_task_return_error_if_cancelled (task)) {
+			g_variant_unref (value);
+			goto out;
+		}
+		g_task_return_pointer (task, value, (GDestroyNotify) g_variant_unref);
+	}
+out:
+	g_object_unref (task);
+}
+
+static void
+pk_transaction_db_query_free (PkTransactionDbQuery *query)
+{
+	g_strfreev (query->names);
+	g_free (query);
+}
+
+/*
+ * The task deliberately has no source object: the reader thread must never
+ * drop the last reference to @tdb, as finalizing it waits for that thread.
+ */
+static void
+pk_transaction_db_reader_push (PkTransactionDb *tdb,
+			       PkTransactionDbQuery *query,
+			       gpointer source_tag,
+			       GCancellable *cancellable,
+			       GAsyncReadyCallback callback,
+			       gpointer user_data)
+{
+	GTask *task;
+
+	if (tdb->priv->reader_pool == NULL) {
+		tdb->priv->reader_pool = g_thread_pool_new (pk_transaction_db_reader_func,
+							    tdb->priv, 1, TRUE, NULL);
+	}
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, source_tag);
+	g_task_set_task_data (task, query, (GDestroyNotify) pk_transaction_db_query_free);
+	g_thread_pool_push (tdb->priv->reader_pool, task, NULL);
+}
+
+/**
+ * pk_transaction_db_get_list_async:
+ * @limit: the maximum number of transactions, or 0 for no limit
+ *
+ * Like pk_transaction_db_get_list(), but runs the query on the reader
+ * thread so the main loop keeps dispatching.
+ **/
+void
+pk_transaction_db_get_list_async (PkTransactionDb *tdb,
+				  guint limit,
+				  GCancellable *cancellable,
+				  GAsyncReadyCallback callback,
+				  gpointer user_data)
+{
+	PkTransactionDbQuery *query;
+
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	g_return_if_fail (tdb->priv->loaded);
+
+	query = g_new0 (PkTransactionDbQuery, 1);
+	query->limit = limit;
+	pk_transaction_db_reader_push (tdb, query, pk_transaction_db_get_list_async,
+				       cancellable, callback, user_data);
+}
+
+/**
+ * pk_transaction_db_get_list_finish:
+ *
+ * Return value: a list of #PkTransactionPast, which may be empty when
+ * @error is unset
+ **/
+GList *
+pk_transaction_db_get_list_finish (PkTransactionDb *tdb,
+				   GAsyncResult *res,
+				   GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, NULL), NULL);
+	g_return_val_if_fail (g_task_get_source_tag (G_TASK (res)) == pk_transaction_db_get_list_async, NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * pk_transaction_db_get_package_history_async:
+ * @names: the package names, duplicates are ignored
+ * @max_size: the maximum number of entries per package, or 0 for no limit
+ *
+ * Gets the history of several packages on the reader thread.
+ **/
+void
+pk_transaction_db_get_package_history_async (PkTransactionDb *tdb,
+					     gchar **names,
+					     guint max_size,
+					     GCancellable *cancellable,
+					     GAsyncReadyCallback callback,
+					     gpointer user_data)
+{
+	PkTransactionDbQuery *query;
+
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	g_return_if_fail (tdb->priv->loaded);
+	g_return_if_fail (names != NULL);
+
+	query = g_new0 (PkTransactionDbQuery, 1);
+	query->names = g_strdupv (names);
+	query->max_size = max_size;
+	pk_transaction_db_reader_push (tdb, query, pk_transaction_db_get_package_history_async,
+				       cancellable, callback, user_data);
+}
+
+/**
+ * pk_transaction_db_get_package_history_finish:
+ *
+ * Return value: a #GVariant of type a{saa{sv}}, or %NULL for error
+ **/
+GVariant *
+pk_transaction_db_get_package_history_finish (PkTransactionDb *tdb,
+					      GAsyncResult *res,
+					      GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, NULL), NULL);
+	g_return_val_if_fail (g_task_get_source_tag (G_TASK (res)) == pk_transaction_db_get_package_history_async, NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * pk_transaction_db_get_history_stats_async:
+ * @names: the package names, or an empty array for every package
+ *
+ * Gets the per-month install, update, removal and failure counts of
+ * packages on the reader thread. These are kept up to date as each
+ * transaction finishes, so this only reads the rows that are returned.
+ **/
+void
+pk_transaction_db_get_history_stats_async (PkTransactionDb *tdb,
+					   gchar **names,
+					   GCancellable *cancellable,
+					   GAsyncReadyCallback callback,
+					   gpointer user_data)
+{
+	PkTransactionDbQuery *query;
+
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	g_return_if_fail (tdb->priv->loaded);
+	g_return_if_fail (names != NULL);
+
+	query = g_new0 (PkTransactionDbQuery, 1);
+	query->names = g_strdupv (names);
+	pk_transaction_db_reader_push (tdb, query, pk_transaction_db_get_history_stats_async,
+				       cancellable, callback, user_data);
+}
+
+/**
+ * pk_transaction_db_get_history_stats_finish:
+ *
+ * Return value: a #GVariant of type a{saa{sv}}, or %NULL for error
+ **/
+GVariant *
+pk_transaction_db_get_history_stats_finish (PkTransactionDb *tdb,
+					    GAsyncResult *res,
+					    GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, NULL), NULL);
+	g_return_val_if_fail (g_task_get_source_tag (G_TASK (res)) == pk_transaction_db_get_history_stats_async, NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/* failed transactions were never split out, so only successes are known */
+static gboolean
+pk_transaction_db_backfill_package_stats (PkTransactionDb *tdb, GError **error)
 {
 	gchar *error_msg = NULL;
 	gint rc;
-	GList *list = NULL;
 	g_autofree gchar *statement = NULL;
 
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), NULL);
-
-	if (limit == 0) {
-		statement = g_strdup ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-				      "FROM transactions ORDER BY timespec DESC");
-	} else {
-		statement = g_strdup_printf ("SELECT transaction_id, timespec, succeeded, duration, role, data, uid, cmdline "
-					     "FROM transactions ORDER BY timespec DESC LIMIT %i", limit);
-	}
-	rc = sqlite3_exec (tdb->priv->db,
-			   statement,
-			   pk_transaction_db_add_transaction_cb,
-			   &list,
-			   &error_msg);
+	statement = g_strdup_printf ("INSERT INTO package_stats (name, month, installs, updates, "
+				     "removes, last_updated) "
+				     "SELECT name, strftime('%%Y-%%m', timestamp, 'unixepoch'), "
+				     "COUNT(DISTINCT CASE WHEN info = %u THEN transaction_id END), "
+				     "COUNT(DISTINCT CASE WHEN info = %u THEN transaction_id END), "
+				     "COUNT(DISTINCT CASE WHEN info = %u THEN transaction_id END), "
+				     "MAX(timestamp) FROM package_history GROUP BY 1, 2;",
+				     (guint) PK_INFO_ENUM_INSTALLING,
+				     (guint) PK_INFO_ENUM_UPDATING,
+				     (guint) PK_INFO_ENUM_REMOVING);
+	rc = sqlite3_exec (tdb->priv->db, statement, NULL, NULL, &error_msg);
 	if (rc != SQLITE_OK) {
-		g_warning ("SQL error: %s", error_msg);
+		g_set_error (error, 1, 0, "SQL error: %s", error_msg);
 		sqlite3_free (error_msg);
-		goto out;
+		return FALSE;
 	}
-out:
-	return list;
+	return TRUE;
 }
 
+/* populate package_history from transactions written before it existed */
 static gboolean
-pk_transaction_db_prepare (PkTransactionDb *tdb, const gchar *sql, sqlite3_stmt **statement)
+pk_transaction_db_backfill_package_history (PkTransactionDb *tdb, GError **error)
 {
-	gint rc = 0;
-	*statement = NULL;
+	gint rc;
+	sqlite3_stmt *statement = NULL;
 
-	if ((rc = sqlite3_prepare_v2 (tdb->priv->db,
-				      sql,
-				      -1,
-				      statement,
-				      NULL) != SQLITE_OK)) {
-		g_warning ("(%s) prepare error: %d: %s", sql, rc, sqlite3_errmsg (tdb->priv->db));
+	rc = sqlite3_prepare_v2 (tdb->priv->db,
+				 "SELECT transaction_id, timespec, uid, data FROM transactions "
+				 "WHERE succeeded = 1 AND data IS NOT NULL",
+				 -1, &statement, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, 1, 0,
+			     "failed to read transactions: %s",
+			     sqlite3_errmsg (tdb->priv->db));
 		return FALSE;
 	}
-
+	sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+	while (sqlite3_step (statement) == SQLITE_ROW) {
+		pk_transaction_db_add_package_history (tdb,
+						       (const gchar *) sqlite3_column_text (statement, 0),
+						       (const gchar *) sqlite3_column_text (statement, 1),
+						       sqlite3_column_int (statement, 2),
+						       (const gchar *) sqlite3_column_text (statement, 3));
+	}
+	sqlite3_finalize (statement);
+	sqlite3_exec (tdb->priv->db, "COMMIT", NULL, NULL, NULL);
 	return TRUE;
 }
 
 static gboolean
-pk_transaction_db_step (sqlite3 *db, sqlite3_stmt *statement)
+pk_transaction_db_write_pending (PkTransactionDb *tdb,
+				 PkTransactionDbPending *pending,
+				 gboolean success,
+				 guint runtime)
 {
-	gint rc = 0;
-
-	rc = sqlite3_step (statement);
+	sqlite3_stmt *statement = NULL;
 
-	if (rc != SQLITE_OK && rc != SQLITE_DONE) {
-		g_warning ("SQL error: %d: %s", rc, sqlite3_errmsg (db));
+	if (!pk_transaction_db_prepare (tdb,
+					"INSERT INTO transactions (transaction_id, timespec, role, uid, "
+					"cmdline, data, succeeded, duration, data_z, "
+					"cpu_time, memory_growth, bytes_emitted) "
+					"VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11, ?12)",
+					&statement))
 		return FALSE;
-	}
 
-	return TRUE;
+	/* bind data, so that the freeform text cannot be used to inject SQL */
+	sqlite3_bind_text (statement, 1, pending->tid, -1, SQLITE_STATIC);
+	sqlite3_bind_text (statement, 2, pending->timespec, -1, SQLITE_STATIC);
+	if (pending->role != PK_ROLE_ENUM_UNKNOWN)
+		sqlite3_bind_text (statement, 3, pk_role_enum_to_string (pending->role), -1, SQLITE_STATIC);
+	sqlite3_bind_int (statement, 4, pending->uid);
+	sqlite3_bind_text (statement, 5, pending->cmdline, -1, SQLITE_STATIC);
+	pk_transaction_db_bind_data (tdb, statement, 6, 9, pending->data);
+	sqlite3_bind_int (statement, 7, success);
+	sqlite3_bind_int (statement, 8, runtime);
+	sqlite3_bind_int64 (statement, 10, (sqlite3_int64) pending->cpu_time);
+	sqlite3_bind_int64 (statement, 11, (sqlite3_int64) pending->memory_growth);
+	sqlite3_bind_int64 (statement, 12, (sqlite3_int64) pending->bytes_emitted);
+
+	return pk_transaction_db_step (tdb->priv->db, statement);
 }
 
-static gboolean
-pk_transaction_db_set_strings (PkTransactionDb *tdb, const gchar *sql, const gchar *first, const gchar *second)
+/* write everything that is still held back in one transaction */
+static void
+pk_transaction_db_flush_pending (PkTransactionDb *tdb)
 {
-	g_autoptr (sqlite3_stmt) statement = NULL;
-	gint rc = 0;
-
-	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
-	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
-	g_return_val_if_fail (sql != NULL, FALSE);
-	g_return_val_if_fail (first != NULL, FALSE);
-	g_return_val_if_fail (second != NULL, FALSE);
-
-	if (!pk_transaction_db_prepare (tdb, sql, &statement))
-		return FALSE;
-
-	if ((rc = sqlite3_bind_text (statement, 1, first, -1, SQLITE_STATIC)) != SQLITE_OK) {
-		g_warning ("bind text1 error: %d: %s", rc, sqlite3_errmsg (tdb->priv->db));
-		return FALSE;
-	}
+	GHashTableIter iter;
+	PkTransactionDbPending *pending;
 
-	if ((rc = sqlite3_bind_text (statement, 2, second, -1, SQLITE_STATIC)) != SQLITE_OK) {
-		g_warning ("bind text2 error: %d: %s", rc, sqlite3_errmsg (tdb->priv->db));
-		return FALSE;
-	}
+	if (tdb->priv->db == NULL || g_hash_table_size (tdb->priv->pending) == 0)
+		return;
 
-	return pk_transaction_db_step (tdb->priv->db, statement);
+	g_debug ("writing %u unfinished transactions",
+		 g_hash_table_size (tdb->priv->pending));
+	sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+	g_hash_table_iter_init (&iter, tdb->priv->pending);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &pending))
+		pk_transaction_db_write_pending (tdb, pending, FALSE, 0);
+	sqlite3_exec (tdb->priv->db, "COMMIT", NULL, NULL, NULL);
+	g_hash_table_remove_all (tdb->priv->pending);
 }
 
+/**
+ * pk_transaction_db_add:
+ *
+ * Starts a history entry for @tid. The role, uid, cmdline and data set
+ * after this are kept in memory and only written, together with the
+ * result, by pk_transaction_db_set_finished().
+ **/
 gboolean
 pk_transaction_db_add (PkTransactionDb *tdb, const gchar *tid)
 {
-	g_autofree gchar *timespec = NULL;
-	timespec = pk_iso8601_present ();
+	PkTransactionDbPending *pending;
 
-	return pk_transaction_db_set_strings (tdb,
-					      "INSERT INTO transactions (transaction_id, timespec) VALUES (?1, ?2)",
-					      tid,
-					      timespec);
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
+
+	pending = g_new0 (PkTransactionDbPending, 1);
+	pending->tid = g_strdup (tid);
+	pending->timespec = pk_iso8601_present ();
+	g_hash_table_replace (tdb->priv->pending, pending->tid, pending);
+	return TRUE;
 }
 
 gboolean
 pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum role)
 {
+	PkTransactionDbPending *pending;
 	const gchar *role_text;
-	role_text = pk_role_enum_to_string (role);
 
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+
+	pending = g_hash_table_lookup (tdb->priv->pending, tid);
+	if (pending != NULL) {
+		pending->role = role;
+		return TRUE;
+	}
+
+	role_text = pk_role_enum_to_string (role);
 	return pk_transaction_db_set_strings (tdb,
 					      "UPDATE transactions SET role=?1 WHERE transaction_id=?2",
 					      role_text,
@@ -378,13 +1310,20 @@ pk_transaction_db_set_role (PkTransactionDb *tdb, const gchar *tid, PkRoleEnum r
 gboolean
 pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 {
-	g_autoptr (sqlite3_stmt) statement = NULL;
+	PkTransactionDbPending *pending;
+	sqlite3_stmt *statement = NULL;
 	gint rc = 0;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
 	g_return_val_if_fail (tid != NULL, FALSE);
 
+	pending = g_hash_table_lookup (tdb->priv->pending, tid);
+	if (pending != NULL) {
+		pending->uid = uid;
+		return TRUE;
+	}
+
 	if (!pk_transaction_db_prepare (tdb, "UPDATE transactions SET uid=?1 WHERE transaction_id=?2", &statement))
 		return FALSE;
 
@@ -404,6 +1343,17 @@ pk_transaction_db_set_uid (PkTransactionDb *tdb, const gchar *tid, guint uid)
 gboolean
 pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gchar *cmdline)
 {
+	PkTransactionDbPending *pending;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+
+	pending = g_hash_table_lookup (tdb->priv->pending, tid);
+	if (pending != NULL) {
+		g_free (pending->cmdline);
+		pending->cmdline = g_strdup (cmdline);
+		return TRUE;
+	}
+
 	return pk_transaction_db_set_strings (tdb,
 					      "UPDATE transactions SET cmdline=?1 WHERE transaction_id=?2",
 					      cmdline,
@@ -413,22 +1363,104 @@ pk_transaction_db_set_cmdline (PkTransactionDb *tdb, const gchar *tid, const gch
 gboolean
 pk_transaction_db_set_data (PkTransactionDb *tdb, const gchar *tid, const gchar *data)
 {
-	return pk_transaction_db_set_strings (tdb,
-					      "UPDATE transactions SET data=?1 WHERE transaction_id=?2",
-					      data,
-					      tid);
+	PkTransactionDbPending *pending;
+	sqlite3_stmt *statement = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+
+	pending = g_hash_table_lookup (tdb->priv->pending, tid);
+	if (pending != NULL) {
+		g_free (pending->data);
+		pending->data = g_strdup (data);
+		return TRUE;
+	}
+
+	if (!pk_transaction_db_prepare (tdb,
+					"UPDATE transactions SET data=?1, data_z=?2 WHERE transaction_id=?3",
+					&statement))
+		return FALSE;
+	pk_transaction_db_bind_data (tdb, statement, 1, 2, data);
+	sqlite3_bind_text (statement, 3, tid, -1, SQLITE_STATIC);
+	return pk_transaction_db_step (tdb->priv->db, statement);
+}
+
+/**
+ * pk_transaction_db_set_resources:
+ * @cpu_time: CPU time of the backend in microseconds
+ * @memory_growth: growth of the peak resident size in bytes
+ * @bytes_emitted: size of the results sent to clients
+ *
+ * Records what the transaction cost; call this before
+ * pk_transaction_db_set_finished() so it is written with the result.
+ **/
+gboolean
+pk_transaction_db_set_resources (PkTransactionDb *tdb,
+				 const gchar *tid,
+				 guint64 cpu_time,
+				 guint64 memory_growth,
+				 guint64 bytes_emitted)
+{
+	PkTransactionDbPending *pending;
+	sqlite3_stmt *statement = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tid != NULL, FALSE);
+
+	pending = g_hash_table_lookup (tdb->priv->pending, tid);
+	if (pending != NULL) {
+		pending->cpu_time = cpu_time;
+		pending->memory_growth = memory_growth;
+		pending->bytes_emitted = bytes_emitted;
+		return TRUE;
+	}
+
+	if (!pk_transaction_db_prepare (tdb,
+					"UPDATE transactions SET cpu_time=?1, memory_growth=?2, "
+					"bytes_emitted=?3 WHERE transaction_id=?4",
+					&statement))
+		return FALSE;
+	sqlite3_bind_int64 (statement, 1, (sqlite3_int64) cpu_time);
+	sqlite3_bind_int64 (statement, 2, (sqlite3_int64) memory_growth);
+	sqlite3_bind_int64 (statement, 3, (sqlite3_int64) bytes_emitted);
+	sqlite3_bind_text (statement, 4, tid, -1, SQLITE_STATIC);
+	return pk_transaction_db_step (tdb->priv->db, statement);
 }
 
 gboolean
 pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean success, guint runtime)
 {
-	g_autoptr (sqlite3_stmt) statement = NULL;
+	PkTransactionDbPending *pending;
+	sqlite3_stmt *statement = NULL;
+	gboolean ret;
 	gint rc = 0;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
 	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
 	g_return_val_if_fail (tid != NULL, FALSE);
 
+	/* write the whole entry at once */
+	pending = g_hash_table_lookup (tdb->priv->pending, tid);
+	if (pending != NULL) {
+		sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+		ret = pk_transaction_db_write_pending (tdb, pending, success, runtime);
+		if (ret && success) {
+			pk_transaction_db_add_package_history (tdb,
+							       pending->tid,
+							       pending->timespec,
+							       pending->uid,
+							       pending->data);
+		}
+		if (ret) {
+			pk_transaction_db_add_package_stats (tdb,
+							     pending->timespec,
+							     pending->data,
+							     success);
+		}
+		sqlite3_exec (tdb->priv->db, ret ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL);
+		g_hash_table_remove (tdb->priv->pending, tid);
+		return ret;
+	}
+
 	if (!pk_transaction_db_prepare (tdb, "UPDATE transactions SET succeeded=?1, duration=?2 WHERE transaction_id=?3",
 					&statement))
 		return FALSE;
@@ -451,6 +1483,240 @@ pk_transaction_db_set_finished (PkTransactionDb *tdb, const gchar *tid, gboolean
 	return pk_transaction_db_step (tdb->priv->db, statement);
 }
 
+/**
+ * pk_transaction_db_set_retention:
+ * @max_age: seconds after which transactions are removed, or 0
+ * @max_rows: the number of most recent transactions to keep, or 0
+ * @archive_age: seconds after which transactions are compacted, or 0
+ *
+ * Sets the policy applied by pk_transaction_db_maintenance_step().
+ **/
+void
+pk_transaction_db_set_retention (PkTransactionDb *tdb,
+				 gint64 max_age,
+				 guint max_rows,
+				 gint64 archive_age)
+{
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	tdb->priv->max_age = max_age;
+	tdb->priv->max_rows = max_rows;
+	tdb->priv->archive_age = archive_age;
+}
+
+/**
+ * pk_transaction_db_set_compress:
+ * @compress: whether to store new package lists compressed
+ *
+ * Compressed rows keep their package-ids in a shared dictionary table and
+ * are deflated; pk_transaction_db_get_list() decodes them transparently.
+ **/
+void
+pk_transaction_db_set_compress (PkTransactionDb *tdb, gboolean compress)
+{
+	g_return_if_fail (PK_IS_TRANSACTION_DB (tdb));
+	tdb->priv->compress = compress;
+}
+
+/* timespecs are all UTC, so they sort as strings */
+static gchar *
+pk_transaction_db_get_cutoff (gint64 age)
+{
+	GTimeVal timeval;
+	g_get_current_time (&timeval);
+	timeval.tv_sec -= age;
+	return g_time_val_to_iso8601 (&timeval);
+}
+
+/* remove a batch of transactions outside the retention window */
+static guint
+pk_transaction_db_purge_batch (PkTransactionDb *tdb)
+{
+	guint i;
+	sqlite3_stmt *statement = NULL;
+	g_autofree gchar *cutoff = NULL;
+	g_autoptr(GPtrArray) tids = NULL;
+
+	if (tdb->priv->max_age == 0 && tdb->priv->max_rows == 0)
+		return 0;
+	if (tdb->priv->max_age > 0)
+		cutoff = pk_transaction_db_get_cutoff (tdb->priv->max_age);
+	if (!pk_transaction_db_prepare (tdb,
+					"SELECT transaction_id FROM transactions WHERE timespec < ?1 "
+					"UNION SELECT transaction_id FROM (SELECT transaction_id FROM transactions "
+					"ORDER BY timespec DESC LIMIT -1 OFFSET ?2) LIMIT ?3",
+					&statement))
+		return 0;
+	sqlite3_bind_text (statement, 1, cutoff, -1, SQLITE_STATIC);
+	sqlite3_bind_int (statement, 2, tdb->priv->max_rows > 0 ? (gint) MIN (tdb->priv->max_rows, G_MAXINT) : G_MAXINT);
+	sqlite3_bind_int (statement, 3, PK_TRANSACTION_DB_MAINTENANCE_BATCH);
+	tids = g_ptr_array_new_with_free_func (g_free);
+	while (sqlite3_step (statement) == SQLITE_ROW)
+		g_ptr_array_add (tids, g_strdup ((const gchar *) sqlite3_column_text (statement, 0)));
+	sqlite3_reset (statement);
+	if (tids->len == 0)
+		return 0;
+
+	g_debug ("removing %u old transactions", tids->len);
+	sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+	for (i = 0; i < tids->len; i++) {
+		const gchar *tid = g_ptr_array_index (tids, i);
+		if (pk_transaction_db_prepare (tdb, "DELETE FROM package_history WHERE transaction_id = ?1", &statement)) {
+			sqlite3_bind_text (statement, 1, tid, -1, SQLITE_STATIC);
+			pk_transaction_db_step (tdb->priv->db, statement);
+		}
+		if (pk_transaction_db_prepare (tdb, "DELETE FROM transactions WHERE transaction_id = ?1", &statement)) {
+			sqlite3_bind_text (statement, 1, tid, -1, SQLITE_STATIC);
+			pk_transaction_db_step (tdb->priv->db, statement);
+		}
+	}
+	sqlite3_exec (tdb->priv->db, "COMMIT", NULL, NULL, NULL);
+	return tids->len;
+}
+
+/* the archive form drops the summaries, which are only of use while the
+ * packages are current; the lines still parse as packages */
+static gchar *
+pk_transaction_db_archive_data (const gchar *data)
+{
+	const gchar *tab;
+	guint i;
+	GString *string;
+	g_auto(GStrv) package_lines = NULL;
+
+	string = g_string_new ("");
+	package_lines = g_strsplit (data, "\n", -1);
+	for (i = 0; package_lines[i] != NULL; i++) {
+		if (i > 0)
+			g_string_append_c (string, '\n');
+		tab = strchr (package_lines[i], '\t');
+		if (tab != NULL)
+			tab = strchr (tab + 1, '\t');
+		if (tab == NULL) {
+			g_string_append (string, package_lines[i]);
+			continue;
+		}
+		g_string_append_len (string, package_lines[i], tab - package_lines[i] + 1);
+	}
+	return g_string_free (string, FALSE);
+}
+
+/* compact a batch of transactions older than the archive age */
+static guint
+pk_transaction_db_archive_batch (PkTransactionDb *tdb)
+{
+	guint i;
+	sqlite3_stmt *lookup = NULL;
+	sqlite3_stmt *statement = NULL;
+	g_autofree gchar *cutoff = NULL;
+	g_autoptr(GPtrArray) tids = NULL;
+	g_autoptr(GPtrArray) data = NULL;
+
+	if (tdb->priv->archive_age == 0)
+		return 0;
+	cutoff = pk_transaction_db_get_cutoff (tdb->priv->archive_age);
+	if (!pk_transaction_db_prepare (tdb, PK_TRANSACTION_DB_PACKAGE_ID_LOOKUP_SQL, &lookup))
+		return 0;
+	if (!pk_transaction_db_prepare (tdb,
+					"SELECT transaction_id, data, data_z FROM transactions "
+					"WHERE archived = 0 AND timespec < ?1 LIMIT ?2",
+					&statement))
+		return 0;
+	sqlite3_bind_text (statement, 1, cutoff, -1, SQLITE_STATIC);
+	sqlite3_bind_int (statement, 2, PK_TRANSACTION_DB_MAINTENANCE_BATCH);
+	tids = g_ptr_array_new_with_free_func (g_free);
+	data = g_ptr_array_new_with_free_func (g_free);
+	while (sqlite3_step (statement) == SQLITE_ROW) {
+		g_autofree gchar *tmp = NULL;
+		if (sqlite3_column_type (statement, 2) == SQLITE_BLOB) {
+			tmp = pk_transaction_db_decode_data (lookup,
+							     sqlite3_column_blob (statement, 2),
+							     sqlite3_column_bytes (statement, 2));
+		} else {
+			tmp = g_strdup ((const gchar *) sqlite3_column_text (statement, 1));
+		}
+		g_ptr_array_add (tids, g_strdup ((const gchar *) sqlite3_column_text (statement, 0)));
+		g_ptr_array_add (data, tmp != NULL ? pk_transaction_db_archive_data (tmp) : NULL);
+	}
+	sqlite3_reset (statement);
+	if (tids->len == 0)
+		return 0;
+
+	g_debug ("archiving %u transactions", tids->len);
+	sqlite3_exec (tdb->priv->db, "BEGIN", NULL, NULL, NULL);
+	for (i = 0; i < tids->len; i++) {
+		if (!pk_transaction_db_prepare (tdb,
+						"UPDATE transactions SET data = ?1, description = NULL, "
+						"archived = 1, data_z = ?3 WHERE transaction_id = ?2",
+						&statement))
+			break;
+		pk_transaction_db_bind_data (tdb, statement, 1, 3, g_ptr_array_index (data, i));
+		sqlite3_bind_text (statement, 2, g_ptr_array_index (tids, i), -1, SQLITE_STATIC);
+		pk_transaction_db_step (tdb->priv->db, statement);
+	}
+	sqlite3_exec (tdb->priv->db, "COMMIT", NULL, NULL, NULL);
+	return tids->len;
+}
+
+static void
+pk_transaction_db_vacuum (PkTransactionDb *tdb)
+{
+	gint auto_vacuum = 0;
+	sqlite3_stmt *statement = NULL;
+
+	if (pk_transaction_db_prepare (tdb, "PRAGMA auto_vacuum", &statement)) {
+		if (sqlite3_step (statement) == SQLITE_ROW)
+			auto_vacuum = sqlite3_column_int (statement, 0);
+		sqlite3_reset (statement);
+	}
+
+	/* databases created before auto_vacuum was set need one full
+	 * rebuild, after that the free pages can be released cheaply */
+	if (auto_vacuum != 2) {
+		g_debug ("converting database to incremental vacuum");
+		sqlite3_exec (tdb->priv->db, "PRAGMA auto_vacuum=INCREMENTAL", NULL, NULL, NULL);
+		sqlite3_exec (tdb->priv->db, "VACUUM", NULL, NULL, NULL);
+		return;
+	}
+	sqlite3_exec (tdb->priv->db, "PRAGMA incremental_vacuum", NULL, NULL, NULL);
+}
+
+/**
+ * pk_transaction_db_maintenance_step:
+ *
+ * Does a small, bounded amount of the work needed to apply the retention
+ * policy, so it can be run from an idle handler.
+ *
+ * Return value: %TRUE if there is more work to do
+ **/
+gboolean
+pk_transaction_db_maintenance_step (PkTransactionDb *tdb)
+{
+	guint affected;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION_DB (tdb), FALSE);
+	g_return_val_if_fail (tdb->priv->db != NULL, FALSE);
+
+	/* remove whole transactions first, as there is no point compacting them */
+	affected = pk_transaction_db_purge_batch (tdb);
+	if (affected > 0)
+		tdb->priv->vacuum_pending = TRUE;
+	if (affected == PK_TRANSACTION_DB_MAINTENANCE_BATCH)
+		return TRUE;
+
+	affected = pk_transaction_db_archive_batch (tdb);
+	if (affected > 0)
+		tdb->priv->vacuum_pending = TRUE;
+	if (affected == PK_TRANSACTION_DB_MAINTENANCE_BATCH)
+		return TRUE;
+
+	/* give the space back */
+	if (tdb->priv->vacuum_pending) {
+		pk_transaction_db_vacuum (tdb);
+		tdb->priv->vacuum_pending = FALSE;
+	}
+	return FALSE;
+}
+
 gboolean
 pk_transaction_db_print (PkTransactionDb *tdb)
 {
@@ -564,7 +1830,8 @@ pk_transaction_db_generate_id (PkTransactionDb *tdb)
 
 	/* make the tid */
 	rand_str = pk_transaction_db_get_random_hex_string (8);
-	tid = g_strdup_printf ("/%i_%s", tdb->priv->job_count, rand_str);
+	tid = g_strdup_printf (PK_DBUS_PATH_TRANSACTION "/%i_%s",
+			       tdb->priv->job_count, rand_str);
 	return tid;
 }
 
@@ -902,6 +2169,15 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 		return FALSE;
 	}
 
+	/* only takes effect for new databases, see pk_transaction_db_vacuum() */
+	pk_transaction_db_execute (tdb, "PRAGMA auto_vacuum=INCREMENTAL", NULL);
+
+	/* appends to a log rather than rewriting the database pages */
+	if (!pk_transaction_db_execute (tdb, "PRAGMA journal_mode=WAL", &error_local)) {
+		g_debug ("failed to use WAL mode: %s", error_local->message);
+		g_clear_error (&error_local);
+	}
+
 	/* we don't need to keep doing fsync */
 	if (!pk_transaction_db_execute (tdb, "PRAGMA synchronous=OFF", error))
 		return FALSE;
@@ -969,6 +2245,74 @@ pk_transaction_db_load (PkTransactionDb *tdb, GError **error)
 			return FALSE;
 	}
 
+	/* per-package history (since 1.2.5) */
+	if (!pk_transaction_db_execute (tdb, "SELECT * FROM package_history LIMIT 1", &error_local)) {
+		g_debug ("adding table package_history: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "CREATE TABLE package_history (name TEXT, version TEXT, arch TEXT, data TEXT, "
+			    "info INTEGER, timestamp INTEGER, uid INTEGER, transaction_id TEXT);";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		statement = "CREATE INDEX package_history_name_timestamp ON package_history (name, timestamp);";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		if (!pk_transaction_db_backfill_package_history (tdb, error))
+			return FALSE;
+	}
+
+	/* retention (since 1.2.5) */
+	if (!pk_transaction_db_execute (tdb, "SELECT archived FROM transactions LIMIT 1", &error_local)) {
+		g_debug ("adding archived column: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "ALTER TABLE transactions ADD COLUMN archived INTEGER DEFAULT 0;";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+	}
+	statement = "CREATE INDEX IF NOT EXISTS package_history_transaction_id ON package_history (transaction_id);";
+	if (!pk_transaction_db_execute (tdb, statement, error))
+		return FALSE;
+
+	/* compressed package lists (since 1.2.5) */
+	if (!pk_transaction_db_execute (tdb, "SELECT data_z FROM transactions LIMIT 1", &error_local)) {
+		g_debug ("adding data_z column: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "ALTER TABLE transactions ADD COLUMN data_z BLOB;";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+	}
+	statement = "CREATE TABLE IF NOT EXISTS package_ids (id INTEGER PRIMARY KEY, package_id TEXT UNIQUE);";
+	if (!pk_transaction_db_execute (tdb, statement, error))
+		return FALSE;
+
+	/* per-month package counts (since 1.2.5) */
+	if (!pk_transaction_db_execute (tdb, "SELECT * FROM package_stats LIMIT 1", &error_local)) {
+		g_debug ("adding table package_stats: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "CREATE TABLE package_stats (name TEXT, month TEXT, "
+			    "installs INTEGER DEFAULT 0, updates INTEGER DEFAULT 0, "
+			    "removes INTEGER DEFAULT 0, failures INTEGER DEFAULT 0, "
+			    "last_updated INTEGER DEFAULT 0, PRIMARY KEY (name, month));";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		if (!pk_transaction_db_backfill_package_stats (tdb, error))
+			return FALSE;
+	}
+
+	/* resource accounting (since 1.2.5) */
+	if (!pk_transaction_db_execute (tdb, "SELECT cpu_time FROM transactions LIMIT 1", &error_local)) {
+		g_debug ("adding resource columns: %s", error_local->message);
+		g_clear_error (&error_local);
+		statement = "ALTER TABLE transactions ADD COLUMN cpu_time INTEGER DEFAULT 0;";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		statement = "ALTER TABLE transactions ADD COLUMN memory_growth INTEGER DEFAULT 0;";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+		statement = "ALTER TABLE transactions ADD COLUMN bytes_emitted INTEGER DEFAULT 0;";
+		if (!pk_transaction_db_execute (tdb, statement, error))
+			return FALSE;
+	}
+
 	/* try to set correct permissions */
 	g_chmod (PK_DB_DIR "/transactions.db", 0644);
 
@@ -981,6 +2325,10 @@ static void
 pk_transaction_db_init (PkTransactionDb *tdb)
 {
 	tdb->priv = PK_TRANSACTION_DB_GET_PRIVATE (tdb);
+	tdb->priv->statements = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, (GDestroyNotify) sqlite3_finalize);
+	tdb->priv->pending = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						    (GDestroyNotify) pk_transaction_db_pending_free);
 }
 
 static void
@@ -997,7 +2345,18 @@ pk_transaction_db_finalize (GObject *object)
 		g_source_remove (tdb->priv->database_save_id);
 	}
 
-	/* close the database */
+	/* keep unfinished transactions in the history */
+	pk_transaction_db_flush_pending (tdb);
+	g_hash_table_unref (tdb->priv->pending);
+
+	/* wait for any queued read-only queries */
+	if (tdb->priv->reader_pool != NULL)
+		g_thread_pool_free (tdb->priv->reader_pool, FALSE, TRUE);
+	if (tdb->priv->reader_db != NULL)
+		sqlite3_close (tdb->priv->reader_db);
+
+	/* statements have to be finalized before the database can close */
+	g_hash_table_unref (tdb->priv->statements);
 	sqlite3_close (tdb->priv->db);
 
 	G_OBJECT_CLASS (pk_transaction_db_parent_class)->finalize (object);
@@ -22,7 +22,7 @@
 #ifndef __PK_TRANSACTION_DB_H
 #define __PK_TRANSACTION_DB_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include <packagekit-glib2/pk-enum.h>
 
 G_BEGIN_DECLS
@@ -68,6 +68,11 @@ gboolean	 pk_transaction_db_set_uid		(PkTransactionDb	*tdb,
 gboolean	 pk_transaction_db_set_cmdline		(PkTransactionDb	*tdb,
 							 const gchar		*tid,
 							 const gchar		*cmdline);
+gboolean	 pk_transaction_db_set_resources	(PkTransactionDb	*tdb,
+							 const gchar		*tid,
+							 guint64		 cpu_time,
+							 guint64		 memory_growth,
+							 guint64		 bytes_emitted);
 gboolean	 pk_transaction_db_set_finished		(PkTransactionDb	*tdb,
 							 const gchar		*tid,
 							 gboolean		 success,
@@ -77,6 +82,41 @@ gboolean	 pk_transaction_db_set_data		(PkTransactionDb	*tdb,
 							 const gchar		*data);
 GList		*pk_transaction_db_get_list		(PkTransactionDb	*tdb,
 							 guint			 limit);
+GVariant	*pk_transaction_db_get_package_history	(PkTransactionDb	*tdb,
+							 const gchar		*name,
+							 guint			 max_size);
+void		 pk_transaction_db_get_list_async	(PkTransactionDb	*tdb,
+							 guint			 limit,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+GList		*pk_transaction_db_get_list_finish	(PkTransactionDb	*tdb,
+							 GAsyncResult		*res,
+							 GError			**error);
+void		 pk_transaction_db_get_package_history_async (PkTransactionDb	*tdb,
+							 gchar			**names,
+							 guint			 max_size,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+GVariant	*pk_transaction_db_get_package_history_finish (PkTransactionDb	*tdb,
+							 GAsyncResult		*res,
+							 GError			**error);
+void		 pk_transaction_db_get_history_stats_async (PkTransactionDb	*tdb,
+							 gchar			**names,
+							 GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+GVariant	*pk_transaction_db_get_history_stats_finish (PkTransactionDb	*tdb,
+							 GAsyncResult		*res,
+							 GError			**error);
+void		 pk_transaction_db_set_retention	(PkTransactionDb	*tdb,
+							 gint64			 max_age,
+							 guint			 max_rows,
+							 gint64			 archive_age);
+void		 pk_transaction_db_set_compress	(PkTransactionDb	*tdb,
+							 gboolean		 compress);
+gboolean	 pk_transaction_db_maintenance_step	(PkTransactionDb	*tdb);
 gboolean	 pk_transaction_db_action_time_reset	(PkTransactionDb	*tdb,
 							 PkRoleEnum		 role);
 guint		 pk_transaction_db_action_time_since	(PkTransactionDb	*tdb,
@@ -42,6 +42,10 @@ void	pk_transaction_install_packages (PkTransaction *transaction,
 					 GDBusMethodInvocation *context);
 gboolean	 pk_transaction_set_sender			(PkTransaction	*transaction,
 								 const gchar	*sender);
+gboolean	 pk_transaction_set_hint			(PkTransaction	*transaction,
+								 const gchar	*key,
+								 const gchar	*value,
+								 GError		**error);
 gboolean	 pk_transaction_filter_check			(const gchar	*filter,
 								 GError		**error);
 gboolean	 pk_transaction_strvalidate			(const gchar	*textr,
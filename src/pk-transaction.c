@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#define _GNU_SOURCE
 #include "config.h"
 
 #include <stdlib.h>
@@ -34,12 +35,18 @@
 
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <syslog.h>
+#ifdef HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
 
 #include <glib/gstdio.h>
 #include <glib/gi18n.h>
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <gio/gunixinputstream.h>
 #include <packagekit-glib2/pk-common.h>
 #include <packagekit-glib2/pk-common-private.h>
 #include <packagekit-glib2/pk-enum.h>
@@ -52,6 +59,7 @@
 #include "pk-backend.h"
 #include "pk-dbus.h"
 #include "pk-shared.h"
+#include "pk-trace.h"
 #include "pk-transaction-db.h"
 #include "pk-transaction.h"
 #include "pk-transaction-private.h"
@@ -76,6 +84,41 @@ static gboolean pk_transaction_is_supported_content_type (PkTransaction *transac
 /* maximum number of items that can be resolved in one go */
 #define PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE	10000
 
+/* input given with AppendInput or SetInputFd is passed to the backend
+ * this many items at a time */
+#define PK_TRANSACTION_INPUT_CHUNK_SIZE		1000
+
+/* limits on all the input given with AppendInput or SetInputFd */
+#define PK_TRANSACTION_MAX_INPUT_ITEMS		1000000
+#define PK_TRANSACTION_MAX_INPUT_LINE		1024 /* bytes */
+
+/* maximum number of packages that can be sent in one ::Packages signal */
+#define PK_TRANSACTION_MAX_PACKAGES_BATCH_SIZE	10000
+
+/* the longest time a queued ::Packages batch is held back */
+#define PK_TRANSACTION_PACKAGES_FLUSH_TIMEOUT	50 /* ms */
+
+/* progress property changes are sent at most this many times a second */
+#define PK_TRANSACTION_PROPERTIES_MAX_RATE_DEFAULT	10 /* Hz */
+
+/* the shortest time between two ::ItemsProgress signals */
+#define PK_TRANSACTION_ITEMS_PROGRESS_INTERVAL	250 /* ms */
+
+/* the longest deadline-ms hint, a day */
+#define PK_TRANSACTION_DEADLINE_MAX		(24 * 60 * 60 * 1000) /* ms */
+
+/* the GVariant type of the data returned by GetResultsFd */
+#define PK_TRANSACTION_RESULTS_FD_FORMAT	"(a(uss)a(sas))"
+
+/* the client is told a cancelled transaction finished after this long */
+#define PK_TRANSACTION_CANCEL_TIMEOUT_DEFAULT	10 /* s */
+
+/* cancels that take longer to finish are logged */
+#define PK_TRANSACTION_CANCEL_SLOW		1000 /* ms */
+
+/* freeing results of at least this size hands the heap back to the system */
+#define PK_TRANSACTION_TRIM_THRESHOLD		(1024 * 1024) /* bytes sent */
+
 struct PkTransactionPrivate
 {
 	PkRoleEnum		 role;
@@ -85,7 +128,17 @@ struct PkTransactionPrivate
 	guint			 elapsed_time;
 	guint			 speed;
 	guint			 download_size_remaining;
+	guint64			 download_bytes_done;
+	guint64			 download_bytes_total;
 	gboolean		 finished;
+	gboolean		 preempted;
+	gint64			 time_created;		/* monotonic, for the slow log */
+	gint64			 time_auth;
+	gint64			 time_ready;
+	gint64			 time_running;
+	gint64			 time_setup_done;
+	gint64			 time_finished;
+	gint64			 time_db;		/* spent, not a timestamp */
 	gboolean		 allow_cancel;
 	gboolean		 waiting_for_auth;
 	gboolean		 emit_eula_required;
@@ -97,6 +150,14 @@ struct PkTransactionPrivate
 	guint			 watch_id;
 	PkBackend		*backend;
 	PkBackendJob		*job;
+	PkQueryCache		*query_cache;
+	guint			 query_generation;	/* of the cache when the backend started */
+	PkPlanCache		*plan_cache;
+	PkSearchSessions	*search_sessions;
+	PkAuthCache		*auth_cache;
+	PkMetrics		*metrics;
+	PkResults		*shared_results;
+	gboolean		 replayed;
 	GKeyFile		*conf;
 	PkDbus			*dbus;
 	PolkitAuthority		*authority;
@@ -122,6 +183,7 @@ struct PkTransactionPrivate
 	gchar			**cached_package_ids;
 	gchar			*cached_transaction_id;
 	gchar			**cached_full_paths;
+	gchar			*cached_file_dir;
 	PkBitfield		 cached_filters;
 	gchar			**cached_values;
 	gchar			*cached_repo_id;
@@ -132,9 +194,78 @@ struct PkTransactionPrivate
 	gchar			*cached_cat_id;
 	PkUpgradeKindEnum	 cached_upgrade_kind;
 	GPtrArray		*supported_content_types;
-	guint			 registration_id;
 	GDBusConnection		*connection;
 	GDBusNodeInfo		*introspection;
+
+	/* the private connection the client attached, see PkPeerBus */
+	GDBusConnection		*peer_connection;
+	guint			 peer_registration_id;
+	gulong			 peer_closed_id;
+
+	/* batched ::Packages, negotiated with the batch-size hint */
+	guint			 packages_batch_size;
+	guint			 packages_batch_len;
+	guint			 packages_flush_id;
+	GVariantBuilder		*packages_builder;
+
+	/* coalesced ::PropertiesChanged for the progress properties */
+	GHashTable		*properties_pending;	/* name:GVariant */
+	guint			 properties_interval;	/* ms, or 0 */
+	guint			 properties_flush_id;
+	gint64			 properties_last_flush;	/* monotonic, in us */
+
+	/* batched ::ItemsProgress, negotiated with the items-progress hint */
+	gboolean		 items_progress_requested;
+	GHashTable		*items_progress;	/* id:PkItemProgress */
+	guint			 items_progress_flush_id;
+	gint64			 items_progress_last_flush;	/* monotonic, in us */
+
+	/* the backend ignoring a cancel, see CancelTimeout */
+	guint			 cancel_deadline_id;
+	gboolean		 cancel_escalated;
+
+	/* results sent as a sealed memfd, negotiated with the results-fd hint */
+	gboolean		 results_fd_requested;
+	gint			 results_fd;
+	gboolean		 results_sent;
+
+	/* what the transaction cost, for the history */
+	guint64			 bytes_emitted;
+	guint64			 cpu_time;	/* us */
+	guint64			 memory_growth;	/* bytes */
+
+	/* a SetHints that failed, which every later method then fails with */
+	GError			*hints_error;
+
+	/* solved simulations, the plan hint and the Plan property */
+	gchar			*plan_hint;
+	gchar			*plan;
+	/* the limit and cursor hints and the Cursor property */
+	guint			 limit;
+	guint			 offset;
+	gchar			*cursor;
+	gchar			*search_session;
+	/* the backend left detail out to meet the deadline-ms hint */
+	gboolean		 partial;
+	/* only some fields are sent, with the fields hint */
+	gboolean		 projected;
+	/* the client gave a cache-age hint */
+	gboolean		 cache_age_set;
+
+	/* queued installs or updates merged in, with the coalesce hint */
+	gboolean		 coalesce;
+	gboolean		 coalesce_failed;
+	gchar			**own_package_ids;	/* before the merge */
+	GHashTable		*coalesced_names;	/* name:PkTransaction */
+	PkResults		*coalesced_results;
+
+	/* input too large for one method call, fed to the backend in chunks */
+	GPtrArray		*input_items;
+	guint			 input_pos;
+	gboolean		 input_reading;	/* SetInputFd still running */
+	guint64			 input_size;	/* items */
+	guint64			 input_done;
+	guint64			 input_chunk_start;
 };
 
 typedef enum {
@@ -291,35 +422,280 @@ pk_transaction_finish_invalidate_caches (PkTransaction *transaction)
 		pk_backend_updates_changed_delay (priv->backend,
 						  PK_TRANSACTION_UPDATES_CHANGED_TIMEOUT);
 	}
+
+	/* every cache layer checks these rather than waiting for a signal */
+	if (priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
+	    priv->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	    priv->role == PK_ROLE_ENUM_INSTALL_FILES ||
+	    priv->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	    priv->role == PK_ROLE_ENUM_UPGRADE_SYSTEM ||
+	    priv->role == PK_ROLE_ENUM_REPAIR_SYSTEM) {
+		pk_backend_bump_epoch (priv->backend, PK_BACKEND_EPOCH_INSTALLED);
+	}
+	if (priv->role == PK_ROLE_ENUM_REPO_ENABLE ||
+	    priv->role == PK_ROLE_ENUM_REPO_SET_DATA ||
+	    priv->role == PK_ROLE_ENUM_REPO_REMOVE ||
+	    priv->role == PK_ROLE_ENUM_REFRESH_CACHE ||
+	    priv->role == PK_ROLE_ENUM_UPGRADE_SYSTEM) {
+		pk_backend_bump_epoch (priv->backend, PK_BACKEND_EPOCH_AVAILABLE);
+	}
+
+	/* queries made after this point must not see the old results */
+	if (priv->query_cache != NULL &&
+	    (priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
+	     priv->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
+	     priv->role == PK_ROLE_ENUM_INSTALL_FILES ||
+	     priv->role == PK_ROLE_ENUM_REMOVE_PACKAGES ||
+	     priv->role == PK_ROLE_ENUM_REPO_ENABLE ||
+	     priv->role == PK_ROLE_ENUM_REPO_SET_DATA ||
+	     priv->role == PK_ROLE_ENUM_REPO_REMOVE ||
+	     priv->role == PK_ROLE_ENUM_REFRESH_CACHE ||
+	     priv->role == PK_ROLE_ENUM_UPGRADE_SYSTEM ||
+	     priv->role == PK_ROLE_ENUM_REPAIR_SYSTEM)) {
+		pk_query_cache_invalidate (priv->query_cache);
+		if (priv->search_sessions != NULL)
+			pk_search_sessions_invalidate (priv->search_sessions);
+	}
+
+	/* the installed packages may have changed under any solved plan */
+	if (priv->plan_cache != NULL &&
+	    (pk_plan_cache_role_has_plan (priv->role) ||
+	     priv->role == PK_ROLE_ENUM_INSTALL_FILES ||
+	     priv->role == PK_ROLE_ENUM_REPO_ENABLE ||
+	     priv->role == PK_ROLE_ENUM_REPO_SET_DATA ||
+	     priv->role == PK_ROLE_ENUM_REPO_REMOVE ||
+	     priv->role == PK_ROLE_ENUM_REFRESH_CACHE ||
+	     priv->role == PK_ROLE_ENUM_UPGRADE_SYSTEM ||
+	     priv->role == PK_ROLE_ENUM_REPAIR_SYSTEM)) {
+		pk_plan_cache_invalidate (priv->plan_cache);
+	}
 out:
 	return TRUE;
 }
 
 static void
-pk_transaction_emit_property_changed (PkTransaction *transaction,
-				      const gchar *property_name,
-				      GVariant *property_value)
+pk_transaction_emit_signal (PkTransaction *transaction,
+			    const gchar *interface_name,
+			    const gchar *signal_name,
+			    GVariant *parameters)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 start;
+	gsize size = 0;
+
+	/* keep the parameters alive after the emit to measure them */
+	if (parameters != NULL) {
+		g_variant_ref_sink (parameters);
+		size = g_variant_get_size (parameters);
+	}
+
+	/* the client was told we finished when the cancel timed out */
+	if (priv->cancel_escalated && g_strcmp0 (signal_name, "Destroy") != 0) {
+		if (parameters != NULL)
+			g_variant_unref (parameters);
+		return;
+	}
+	start = g_get_monotonic_time ();
+	g_dbus_connection_emit_signal (priv->peer_connection != NULL ?
+				       priv->peer_connection : priv->connection,
+				       NULL,
+				       priv->tid,
+				       interface_name,
+				       signal_name,
+				       parameters,
+				       NULL);
+	priv->bytes_emitted += size;
+	if (priv->metrics != NULL) {
+		pk_metrics_add_signal (priv->metrics, priv->role,
+				       g_get_monotonic_time () - start, size);
+	}
+	if (parameters != NULL)
+		g_variant_unref (parameters);
+}
+
+static void
+pk_transaction_properties_flush (PkTransaction *transaction)
 {
+	PkTransactionPrivate *priv = transaction->priv;
+	GHashTableIter iter;
 	GVariantBuilder builder;
 	GVariantBuilder invalidated_builder;
+	gpointer key, value;
+
+	if (priv->properties_flush_id != 0) {
+		g_source_remove (priv->properties_flush_id);
+		priv->properties_flush_id = 0;
+	}
+
+	/* nothing changed */
+	if (g_hash_table_size (priv->properties_pending) == 0)
+		return;
 
 	/* build the dict */
 	g_variant_builder_init (&invalidated_builder, G_VARIANT_TYPE ("as"));
 	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
-	g_variant_builder_add (&builder,
-			       "{sv}",
-			       property_name,
-			       property_value);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       "org.freedesktop.DBus.Properties",
-				       "PropertiesChanged",
-				       g_variant_new ("(sa{sv}as)",
-						      PK_DBUS_INTERFACE_TRANSACTION,
-						      &builder,
-						      &invalidated_builder),
-				       NULL);
+	g_hash_table_iter_init (&iter, priv->properties_pending);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_variant_builder_add (&builder, "{sv}", key, value);
+	g_hash_table_remove_all (priv->properties_pending);
+	priv->properties_last_flush = g_get_monotonic_time ();
+
+	pk_transaction_emit_signal (transaction,
+				    "org.freedesktop.DBus.Properties",
+				    "PropertiesChanged",
+				    g_variant_new ("(sa{sv}as)",
+						   PK_DBUS_INTERFACE_TRANSACTION,
+						   &builder,
+						   &invalidated_builder));
+}
+
+static gboolean
+pk_transaction_properties_flush_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	transaction->priv->properties_flush_id = 0;
+	pk_transaction_properties_flush (transaction);
+	return G_SOURCE_REMOVE;
+}
+
+/* these change many times a second during a download */
+static gboolean
+pk_transaction_property_is_progress (const gchar *property_name)
+{
+	return g_strcmp0 (property_name, "Percentage") == 0 ||
+	       g_strcmp0 (property_name, "ElapsedTime") == 0 ||
+	       g_strcmp0 (property_name, "RemainingTime") == 0 ||
+	       g_strcmp0 (property_name, "Status") == 0 ||
+	       g_strcmp0 (property_name, "Speed") == 0 ||
+	       g_strcmp0 (property_name, "DownloadSizeRemaining") == 0 ||
+	       g_strcmp0 (property_name, "DownloadBytesDone") == 0 ||
+	       g_strcmp0 (property_name, "DownloadBytesTotal") == 0 ||
+	       g_strcmp0 (property_name, "AllowCancel") == 0;
+}
+
+/**
+ * pk_transaction_emit_property_changed:
+ *
+ * Progress properties are collected and sent together in one
+ * ::PropertiesChanged at most every properties_interval, only keeping the
+ * latest value of each. Any other property is sent straight away, along
+ * with whatever progress was still pending so the order is kept.
+ **/
+static void
+pk_transaction_emit_property_changed (PkTransaction *transaction,
+				      const gchar *property_name,
+				      GVariant *property_value)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 due;
+
+	g_hash_table_replace (priv->properties_pending,
+			      (gpointer) g_intern_string (property_name),
+			      g_variant_ref_sink (property_value));
+
+	if (priv->properties_interval == 0 ||
+	    !pk_transaction_property_is_progress (property_name)) {
+		pk_transaction_properties_flush (transaction);
+		return;
+	}
+
+	/* already going to be sent */
+	if (priv->properties_flush_id != 0)
+		return;
+
+	/* the first change after a quiet period goes out at once */
+	due = priv->properties_last_flush + (gint64) priv->properties_interval * 1000;
+	if (g_get_monotonic_time () >= due) {
+		pk_transaction_properties_flush (transaction);
+		return;
+	}
+	priv->properties_flush_id =
+		g_timeout_add (MAX ((due - g_get_monotonic_time ()) / 1000, 1),
+			       pk_transaction_properties_flush_cb,
+			       transaction);
+	g_source_set_name_by_id (priv->properties_flush_id,
+				 "[PkTransaction] properties-flush");
+}
+
+static void
+pk_transaction_packages_flush (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->packages_flush_id != 0) {
+		g_source_remove (priv->packages_flush_id);
+		priv->packages_flush_id = 0;
+	}
+
+	/* nothing queued */
+	if (priv->packages_builder == NULL)
+		return;
+
+	g_debug ("emitting %u batched packages", priv->packages_batch_len);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "Packages",
+				    g_variant_new ("(a(uss))",
+						   priv->packages_builder));
+	g_variant_builder_unref (priv->packages_builder);
+	priv->packages_builder = NULL;
+	priv->packages_batch_len = 0;
+}
+
+static gboolean
+pk_transaction_packages_flush_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	transaction->priv->packages_flush_id = 0;
+	pk_transaction_packages_flush (transaction);
+	return G_SOURCE_REMOVE;
+}
+
+/* every item still in progress, then forget the ones that are done */
+static void
+pk_transaction_items_progress_flush (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GHashTableIter iter;
+	GVariantBuilder builder;
+	gpointer value;
+
+	if (priv->items_progress_flush_id != 0) {
+		g_source_remove (priv->items_progress_flush_id);
+		priv->items_progress_flush_id = 0;
+	}
+	if (priv->items_progress == NULL ||
+	    g_hash_table_size (priv->items_progress) == 0)
+		return;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(suu)"));
+	g_hash_table_iter_init (&iter, priv->items_progress);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		PkItemProgress *item = PK_ITEM_PROGRESS (value);
+		g_variant_builder_add (&builder, "(suu)",
+				       pk_item_progress_get_package_id (item),
+				       pk_item_progress_get_status (item),
+				       pk_item_progress_get_percentage (item));
+		if (pk_item_progress_get_percentage (item) == 100 ||
+		    pk_item_progress_get_status (item) == PK_STATUS_ENUM_FINISHED)
+			g_hash_table_iter_remove (&iter);
+	}
+	priv->items_progress_last_flush = g_get_monotonic_time ();
+
+	g_debug ("emitting batched item-progress");
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "ItemsProgress",
+				    g_variant_new ("(a(suu))", &builder));
+}
+
+static gboolean
+pk_transaction_items_progress_flush_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	transaction->priv->items_progress_flush_id = 0;
+	pk_transaction_items_progress_flush (transaction);
+	return G_SOURCE_REMOVE;
 }
 
 static void
@@ -384,23 +760,206 @@ pk_transaction_status_changed_emit (PkTransaction *transaction, PkStatusEnum sta
 					      g_variant_new_uint32 (status));
 }
 
+/**
+ * pk_transaction_use_results_fd:
+ *
+ * Only roles that can return very large result sets are sent as a memfd
+ * rather than as ::Package and ::Files signals.
+ **/
+static gboolean
+pk_transaction_use_results_fd (PkTransaction *transaction)
+{
+	if (!transaction->priv->results_fd_requested)
+		return FALSE;
+	return transaction->priv->role == PK_ROLE_ENUM_GET_PACKAGES ||
+	       transaction->priv->role == PK_ROLE_ENUM_GET_FILES ||
+	       transaction->priv->role == PK_ROLE_ENUM_SEARCH_FILE;
+}
+
+static GVariant *
+pk_transaction_results_to_variant (PkTransaction *transaction)
+{
+	GVariantBuilder builder_packages;
+	GVariantBuilder builder_files;
+	gboolean with_summary;
+	guint i;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) files = NULL;
+
+	g_variant_builder_init (&builder_packages, G_VARIANT_TYPE ("a(uss)"));
+	packages = pk_results_get_package_array (transaction->priv->results);
+	with_summary = pk_backend_job_wants_field (transaction->priv->job, "summary");
+	for (i = 0; i < packages->len; i++) {
+		PkPackage *item = g_ptr_array_index (packages, i);
+		const gchar *summary = with_summary ? pk_package_get_summary (item) : NULL;
+		g_variant_builder_add (&builder_packages, "(uss)",
+				       pk_package_get_info (item) |
+				       (((guint32) pk_package_get_update_severity (item)) << 16),
+				       pk_package_get_id (item),
+				       summary != NULL ? summary : "");
+	}
+
+	g_variant_builder_init (&builder_files, G_VARIANT_TYPE ("a(sas)"));
+	files = pk_results_get_files_array (transaction->priv->results);
+	for (i = 0; i < files->len; i++) {
+		PkFiles *item = g_ptr_array_index (files, i);
+		const gchar *package_id = pk_files_get_package_id (item);
+		g_variant_builder_add (&builder_files, "(s^as)",
+				       package_id != NULL ? package_id : "",
+				       pk_files_get_files (item));
+	}
+
+	return g_variant_ref_sink (g_variant_new (PK_TRANSACTION_RESULTS_FD_FORMAT,
+						  &builder_packages,
+						  &builder_files));
+}
+
+/**
+ * pk_transaction_results_fd_prepare:
+ *
+ * Writes the results into a sealed memfd for GetResultsFd, so a large
+ * result set crosses the bus as a single file descriptor.
+ **/
+static gboolean
+pk_transaction_results_fd_prepare (PkTransaction *transaction, GError **error)
+{
+#ifdef HAVE_MEMFD_CREATE
+	const guint8 *data;
+	gint fd;
+	gsize size;
+	gsize written = 0;
+	g_autoptr(GVariant) variant = NULL;
+
+	variant = pk_transaction_results_to_variant (transaction);
+	data = g_variant_get_data (variant);
+	size = g_variant_get_size (variant);
+
+	fd = memfd_create ("packagekit-results", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to create memfd: %s", g_strerror (errno));
+		return FALSE;
+	}
+	while (written < size) {
+		gssize len = write (fd, data + written, size - written);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+				     "failed to write memfd: %s", g_strerror (errno));
+			close (fd);
+			return FALSE;
+		}
+		written += len;
+	}
+
+	/* the client can trust the contents will not change under it */
+	if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+				    F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+			     "failed to seal memfd: %s", g_strerror (errno));
+		close (fd);
+		return FALSE;
+	}
+	transaction->priv->results_fd = fd;
+	transaction->priv->bytes_emitted += size;
+	g_debug ("wrote %" G_GSIZE_FORMAT " bytes of results to memfd", size);
+	return TRUE;
+#else
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     "memfd_create is not available");
+	return FALSE;
+#endif
+}
+
+/**
+ * pk_transaction_results_fd_emit_fallback:
+ *
+ * Sends the results the usual way if they could not be put in a memfd.
+ **/
 static void
-pk_transaction_finished_emit (PkTransaction *transaction,
-			      PkExitEnum exit_enum,
-			      guint time_ms)
+pk_transaction_results_fd_emit_fallback (PkTransaction *transaction)
+{
+	GVariantIter iter;
+	const gchar *package_id;
+	const gchar *summary;
+	guint32 encoded_value;
+	g_autofree gchar **files = NULL;
+	g_autoptr(GVariant) variant = NULL;
+	g_autoptr(GVariant) child = NULL;
+
+	variant = pk_transaction_results_to_variant (transaction);
+	child = g_variant_get_child_value (variant, 0);
+	g_variant_iter_init (&iter, child);
+	while (g_variant_iter_next (&iter, "(u&s&s)", &encoded_value, &package_id, &summary)) {
+		pk_transaction_emit_signal (transaction,
+					    PK_DBUS_INTERFACE_TRANSACTION,
+					    "Package",
+					    g_variant_new ("(uss)",
+							   encoded_value,
+							   package_id,
+							   summary));
+	}
+	g_variant_unref (child);
+	child = g_variant_get_child_value (variant, 1);
+	g_variant_iter_init (&iter, child);
+	while (g_variant_iter_next (&iter, "(&s^a&s)", &package_id, &files)) {
+		pk_transaction_emit_signal (transaction,
+					    PK_DBUS_INTERFACE_TRANSACTION,
+					    "Files",
+					    g_variant_new ("(s^as)",
+							   package_id,
+							   files));
+		g_clear_pointer (&files, g_free);
+	}
+}
+
+/* clients have to get all the results before ::Finished */
+static void
+pk_transaction_results_send (PkTransaction *transaction)
+{
+	g_autoptr(GError) error = NULL;
+
+	if (transaction->priv->results_sent)
+		return;
+	transaction->priv->results_sent = TRUE;
+	if (pk_transaction_use_results_fd (transaction) &&
+	    !pk_transaction_results_fd_prepare (transaction, &error)) {
+		g_warning ("sending results as signals: %s", error->message);
+		pk_transaction_results_fd_emit_fallback (transaction);
+	}
+	pk_transaction_packages_flush (transaction);
+}
+
+static void
+pk_transaction_finished_emit_client (PkTransaction *transaction,
+				     PkExitEnum exit_enum,
+				     guint time_ms)
 {
+	pk_transaction_results_send (transaction);
+	pk_transaction_packages_flush (transaction);
+	pk_transaction_items_progress_flush (transaction);
+	pk_transaction_properties_flush (transaction);
+
 	g_debug ("emitting finished '%s', %i",
 		 pk_exit_enum_to_string (exit_enum),
 		 time_ms);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Finished",
-				       g_variant_new ("(uu)",
-						      exit_enum,
-						      time_ms),
-				       NULL);
+	PK_TRACE4 (transaction__finish, transaction->priv->tid,
+		   transaction->priv->role, exit_enum, time_ms);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "Finished",
+				    g_variant_new ("(uu)",
+						   exit_enum,
+						   time_ms));
+}
+
+static void
+pk_transaction_finished_emit (PkTransaction *transaction,
+			      PkExitEnum exit_enum,
+			      guint time_ms)
+{
+	pk_transaction_finished_emit_client (transaction, exit_enum, time_ms);
 
 	/* For the transaction list */
 	g_signal_emit (transaction, signals[SIGNAL_FINISHED], 0);
@@ -411,18 +970,20 @@ pk_transaction_error_code_emit (PkTransaction *transaction,
 				PkErrorEnum error_enum,
 				const gchar *details)
 {
+	/* keep the ordering of the results and the error */
+	pk_transaction_packages_flush (transaction);
+	pk_transaction_items_progress_flush (transaction);
+
+	pk_transaction_properties_flush (transaction);
 	g_debug ("emitting error-code %s, '%s'",
 		 pk_error_enum_to_string (error_enum),
 		 details);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "ErrorCode",
-				       g_variant_new ("(us)",
-						      error_enum,
-						      details),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "ErrorCode",
+				    g_variant_new ("(us)",
+						   error_enum,
+						   details));
 }
 
 static void
@@ -452,6 +1013,13 @@ pk_transaction_locked_changed_cb (PkBackendJob *job,
 		pk_transaction_make_exclusive (transaction);
 }
 
+/* %FALSE if the fields hint left @field out */
+static gboolean
+pk_transaction_wants_field (PkTransaction *transaction, const gchar *field)
+{
+	return pk_backend_job_wants_field (transaction->priv->job, field);
+}
+
 static void
 pk_transaction_details_cb (PkBackendJob *job,
 			   PkDetails *item,
@@ -474,41 +1042,39 @@ pk_transaction_details_cb (PkBackendJob *job,
 	g_variant_builder_add (&builder, "{sv}", "package-id",
 			       g_variant_new_string (pk_details_get_package_id (item)));
 	group = pk_details_get_group (item);
-	if (group != PK_GROUP_ENUM_UNKNOWN)
+	if (group != PK_GROUP_ENUM_UNKNOWN &&
+	    pk_transaction_wants_field (transaction, "group"))
 		g_variant_builder_add (&builder, "{sv}", "group",
 				       g_variant_new_uint32 (group));
 	tmp = pk_details_get_summary (item);
-	if (tmp != NULL)
+	if (tmp != NULL && pk_transaction_wants_field (transaction, "summary"))
 		g_variant_builder_add (&builder, "{sv}", "summary",
 				       g_variant_new_string (tmp));
 	tmp = pk_details_get_description (item);
-	if (tmp != NULL)
+	if (tmp != NULL && pk_transaction_wants_field (transaction, "description"))
 		g_variant_builder_add (&builder, "{sv}", "description",
 				       g_variant_new_string (tmp));
 	tmp = pk_details_get_url (item);
-	if (tmp != NULL)
+	if (tmp != NULL && pk_transaction_wants_field (transaction, "url"))
 		g_variant_builder_add (&builder, "{sv}", "url",
 				       g_variant_new_string (tmp));
 	tmp = pk_details_get_license (item);
-	if (tmp != NULL)
+	if (tmp != NULL && pk_transaction_wants_field (transaction, "license"))
 		g_variant_builder_add (&builder, "{sv}", "license",
 				       g_variant_new_string (tmp));
 	size = pk_details_get_size (item);
-	if (size != 0)
+	if (size != 0 && pk_transaction_wants_field (transaction, "size"))
 		g_variant_builder_add (&builder, "{sv}", "size",
 				       g_variant_new_uint64 (size));
 	size = pk_details_get_download_size (item);
-	if (size != G_MAXUINT64)
+	if (size != G_MAXUINT64 && pk_transaction_wants_field (transaction, "download-size"))
 		g_variant_builder_add (&builder, "{sv}", "download-size",
 				       g_variant_new_uint64 (size));
 
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Details",
-				       g_variant_new ("(a{sv})", &builder),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "Details",
+				    g_variant_new ("(a{sv})", &builder));
 }
 
 static void
@@ -533,9 +1099,26 @@ pk_transaction_error_code_cb (PkBackendJob *job,
 			   pk_role_enum_to_string (transaction->priv->role));
 	}
 
+	/* the backend is complaining about being cancelled, but we are
+	 * going to run it again */
+	if (transaction->priv->preempted) {
+		g_debug ("ignoring %s from preempted transaction",
+			 pk_error_enum_to_string (code));
+		return;
+	}
+
 	/* add to results */
 	pk_results_set_error_code (transaction->priv->results, item);
 
+	/* the merged transaction failing does not mean each one would */
+	if (transaction->priv->coalesced_names != NULL &&
+	    code != PK_ERROR_ENUM_LOCK_REQUIRED &&
+	    code != PK_ERROR_ENUM_TRANSACTION_CANCELLED) {
+		g_debug ("not emitting %s from coalesced transaction",
+			 pk_error_enum_to_string (code));
+		return;
+	}
+
 	if (!transaction->priv->exclusive && code == PK_ERROR_ENUM_LOCK_REQUIRED) {
 		/* the backend failed to get lock for this action, this means this transaction has to be run in exclusive mode */
 		g_debug ("changing transaction to exclusive mode (after failing with lock-required)");
@@ -546,6 +1129,95 @@ pk_transaction_error_code_cb (PkBackendJob *job,
 	}
 }
 
+/**
+ * pk_transaction_download_pool_get_dir:
+ *
+ * Every package downloaded without store_in_cache during the lifetime of
+ * the daemon is also hardlinked into a directory of the pool. A later
+ * DownloadPackages for the same package-id gets links to the same files
+ * rather than downloading it again. The pool is emptied with the rest of
+ * the download cache when the daemon starts.
+ **/
+static gchar *
+pk_transaction_download_pool_get_dir (const gchar *package_id)
+{
+	g_autofree gchar *hash = NULL;
+
+	hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, package_id, -1);
+	return g_build_filename (LOCALSTATEDIR, "cache", "PackageKit",
+				 "downloads", "pool", hash, NULL);
+}
+
+static void
+pk_transaction_download_pool_add (const gchar *package_id, gchar **files)
+{
+	g_autofree gchar *dir = NULL;
+	g_autofree gchar *tmpdir = NULL;
+
+	dir = pk_transaction_download_pool_get_dir (package_id);
+	if (g_file_test (dir, G_FILE_TEST_IS_DIR))
+		return;
+
+	/* fill a private directory first so a lookup never sees half of it */
+	tmpdir = g_strdup_printf ("%s.XXXXXX", dir);
+	if (g_mkdir_with_parents (LOCALSTATEDIR "/cache/PackageKit/downloads/pool", 0755) != 0 ||
+	    g_mkdtemp_full (tmpdir, 0755) == NULL) {
+		g_debug ("cannot create %s: %s", tmpdir, g_strerror (errno));
+		return;
+	}
+	for (guint i = 0; files[i] != NULL; i++) {
+		g_autofree gchar *basename = g_path_get_basename (files[i]);
+		g_autofree gchar *dest = g_build_filename (tmpdir, basename, NULL);
+		if (link (files[i], dest) != 0) {
+			g_debug ("not adding %s to the download pool: %s",
+				 package_id, g_strerror (errno));
+			pk_directory_remove_contents (tmpdir);
+			g_rmdir (tmpdir);
+			return;
+		}
+	}
+	if (g_rename (tmpdir, dir) != 0) {
+		pk_directory_remove_contents (tmpdir);
+		g_rmdir (tmpdir);
+	}
+}
+
+/**
+ * pk_transaction_download_pool_lookup:
+ *
+ * Links the pooled files for @package_id into @directory.
+ *
+ * Return value: the linked files, or %NULL if the package has to be
+ * downloaded
+ **/
+static gchar **
+pk_transaction_download_pool_lookup (const gchar *package_id, const gchar *directory)
+{
+	const gchar *name;
+	g_autofree gchar *dir = NULL;
+	g_autoptr(GDir) pool = NULL;
+	g_autoptr(GPtrArray) files = g_ptr_array_new_with_free_func (g_free);
+
+	dir = pk_transaction_download_pool_get_dir (package_id);
+	pool = g_dir_open (dir, 0, NULL);
+	if (pool == NULL)
+		return NULL;
+	while ((name = g_dir_read_name (pool)) != NULL) {
+		g_autofree gchar *src = g_build_filename (dir, name, NULL);
+		gchar *dest = g_build_filename (directory, name, NULL);
+		if (link (src, dest) != 0 && errno != EEXIST) {
+			g_debug ("cannot link %s: %s", src, g_strerror (errno));
+			g_free (dest);
+			return NULL;
+		}
+		g_ptr_array_add (files, dest);
+	}
+	if (files->len == 0)
+		return NULL;
+	g_ptr_array_add (files, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&files), FALSE);
+}
+
 static void
 pk_transaction_files_cb (PkBackendJob *job,
 			 PkFiles *item,
@@ -574,22 +1246,27 @@ pk_transaction_files_cb (PkBackendJob *job,
 					   transaction->priv->cached_directory);
 			}
 		}
+
+		/* not when we are handing out pooled files */
+		if (job != NULL && package_id != NULL)
+			pk_transaction_download_pool_add (package_id, files);
 	}
 
 	/* add to results */
 	pk_results_add_files (transaction->priv->results, item);
 
+	/* sent as a memfd when finished */
+	if (pk_transaction_use_results_fd (transaction))
+		return;
+
 	/* emit */
 	g_debug ("emitting files %s", package_id);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Files",
-				       g_variant_new ("(s^as)",
-						      package_id != NULL ? package_id : "",
-						      files),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "Files",
+				    g_variant_new ("(s^as)",
+						   package_id != NULL ? package_id : "",
+						   files));
 }
 
 static void
@@ -620,18 +1297,15 @@ pk_transaction_category_cb (PkBackendJob *job,
 
 	/* emit */
 	g_debug ("emitting category %s, %s, %s, %s, %s ", parent_id, cat_id, name, summary, icon);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Category",
-				       g_variant_new ("(sssss)",
-						      parent_id != NULL ? parent_id : "",
-						      cat_id,
-						      name,
-						      summary,
-						      icon != NULL ? icon : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "Category",
+				    g_variant_new ("(sssss)",
+						   parent_id != NULL ? parent_id : "",
+						   cat_id,
+						   name,
+						   summary,
+						   icon != NULL ? icon : ""));
 }
 
 static void
@@ -639,24 +1313,52 @@ pk_transaction_item_progress_cb (PkBackendJob *job,
 				 PkItemProgress *item_progress,
 				 PkTransaction *transaction)
 {
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 due;
+
 	g_return_if_fail (PK_IS_TRANSACTION (transaction));
 	g_return_if_fail (transaction->priv->tid != NULL);
 
+	/* only the latest state of each item is kept until the next batch */
+	if (priv->items_progress_requested) {
+		if (priv->items_progress == NULL) {
+			priv->items_progress = g_hash_table_new_full (g_str_hash, g_str_equal,
+								      g_free, g_object_unref);
+		}
+		g_hash_table_replace (priv->items_progress,
+				      g_strdup (pk_item_progress_get_package_id (item_progress)),
+				      g_object_ref (item_progress));
+		if (priv->items_progress_flush_id != 0)
+			return;
+
+		/* the first change after a quiet period goes out at once */
+		due = priv->items_progress_last_flush +
+		      (gint64) PK_TRANSACTION_ITEMS_PROGRESS_INTERVAL * 1000;
+		if (g_get_monotonic_time () >= due) {
+			pk_transaction_items_progress_flush (transaction);
+			return;
+		}
+		priv->items_progress_flush_id =
+			g_timeout_add (MAX ((due - g_get_monotonic_time ()) / 1000, 1),
+				       pk_transaction_items_progress_flush_cb,
+				       transaction);
+		g_source_set_name_by_id (priv->items_progress_flush_id,
+					 "[PkTransaction] items-progress-flush");
+		return;
+	}
+
 	/* emit */
 	g_debug ("emitting item-progress %s, %s: %u",
 		 pk_item_progress_get_package_id (item_progress),
 		 pk_status_enum_to_string (pk_item_progress_get_status (item_progress)),
 		 pk_item_progress_get_percentage (item_progress));
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "ItemProgress",
-				       g_variant_new ("(suu)",
-						      pk_item_progress_get_package_id (item_progress),
-						      pk_item_progress_get_status (item_progress),
-						      pk_item_progress_get_percentage (item_progress)),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "ItemProgress",
+				    g_variant_new ("(suu)",
+						   pk_item_progress_get_package_id (item_progress),
+						   pk_item_progress_get_status (item_progress),
+						   pk_item_progress_get_percentage (item_progress)));
 }
 
 static void
@@ -685,16 +1387,13 @@ pk_transaction_distro_upgrade_cb (PkBackendJob *job,
 	g_debug ("emitting distro-upgrade %s, %s, %s",
 		 pk_update_state_enum_to_string (state),
 		 name, summary);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "DistroUpgrade",
-				       g_variant_new ("(uss)",
-						      state,
-						      name,
-						      summary != NULL ? summary : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "DistroUpgrade",
+				    g_variant_new ("(uss)",
+						   state,
+						   name,
+						   summary != NULL ? summary : ""));
 }
 
 static gchar *
@@ -766,6 +1465,14 @@ pk_transaction_set_state (PkTransaction *transaction, PkTransactionState state)
 
 	g_debug ("transaction now %s", pk_transaction_state_to_string (state));
 	priv->state = state;
+	if (state == PK_TRANSACTION_STATE_WAITING_FOR_AUTH)
+		priv->time_auth = g_get_monotonic_time ();
+	else if (state == PK_TRANSACTION_STATE_READY)
+		priv->time_ready = g_get_monotonic_time ();
+	else if (state == PK_TRANSACTION_STATE_RUNNING)
+		priv->time_running = g_get_monotonic_time ();
+	if (state == PK_TRANSACTION_STATE_READY)
+		PK_TRACE2 (transaction__commit, priv->tid, priv->role);
 	g_signal_emit (transaction, signals[SIGNAL_STATE_CHANGED], 0, state);
 
 	/* only save into the database for useful stuff */
@@ -852,25 +1559,269 @@ pk_transaction_set_backend (PkTransaction *transaction,
 	pk_transaction_setup_mime_types (transaction);
 }
 
-/**
-* pk_transaction_get_backend_job:
-*
-* Returns: (transfer none): Current PkBackendJob for this transaction
-**/
-PkBackendJob *
-pk_transaction_get_backend_job (PkTransaction *transaction)
+void
+pk_transaction_set_query_cache (PkTransaction *transaction,
+				PkQueryCache *query_cache)
 {
-	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
-	return transaction->priv->job;
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_QUERY_CACHE (query_cache));
+
+	if (transaction->priv->query_cache != NULL)
+		g_object_unref (transaction->priv->query_cache);
+	transaction->priv->query_cache = g_object_ref (query_cache);
 }
 
-/**
- * pk_transaction_is_finished_with_lock_required:
- **/
-gboolean
-pk_transaction_is_finished_with_lock_required (PkTransaction *transaction)
+void
+pk_transaction_set_search_sessions (PkTransaction *transaction,
+				    PkSearchSessions *search_sessions)
 {
-	g_autoptr(PkError) error_code = NULL;
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_SEARCH_SESSIONS (search_sessions));
+
+	if (transaction->priv->search_sessions != NULL)
+		g_object_unref (transaction->priv->search_sessions);
+	transaction->priv->search_sessions = g_object_ref (search_sessions);
+}
+
+void
+pk_transaction_set_plan_cache (PkTransaction *transaction,
+			       PkPlanCache *plan_cache)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_PLAN_CACHE (plan_cache));
+
+	if (transaction->priv->plan_cache != NULL)
+		g_object_unref (transaction->priv->plan_cache);
+	transaction->priv->plan_cache = g_object_ref (plan_cache);
+}
+
+void
+pk_transaction_set_auth_cache (PkTransaction *transaction,
+			       PkAuthCache *auth_cache)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_AUTH_CACHE (auth_cache));
+
+	if (transaction->priv->auth_cache != NULL)
+		g_object_unref (transaction->priv->auth_cache);
+	transaction->priv->auth_cache = g_object_ref (auth_cache);
+}
+
+void
+pk_transaction_set_metrics (PkTransaction *transaction,
+			    PkMetrics *metrics)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_METRICS (metrics));
+
+	if (transaction->priv->metrics != NULL)
+		g_object_unref (transaction->priv->metrics);
+	transaction->priv->metrics = g_object_ref (metrics);
+}
+
+static gboolean
+pk_transaction_has_input (PkTransaction *transaction)
+{
+	return transaction->priv->input_items != NULL ||
+	       transaction->priv->input_reading;
+}
+
+static gboolean
+pk_transaction_input_item_validate (PkRoleEnum role, const gchar *item, GError **error)
+{
+	if (role == PK_ROLE_ENUM_GET_DETAILS && !pk_package_id_check (item)) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_PACKAGE_ID_INVALID,
+			     "The package id '%s' is not valid",
+			     item);
+		return FALSE;
+	}
+	return pk_transaction_strvalidate (item, error);
+}
+
+/**
+ * pk_transaction_input_read_chunk:
+ *
+ * Takes up to %PK_TRANSACTION_INPUT_CHUNK_SIZE items from the input given
+ * with AppendInput or SetInputFd. Staged items are freed as they are taken.
+ *
+ * Return value: the items, or %NULL at the end of the input or for error
+ **/
+static gchar **
+pk_transaction_input_read_chunk (PkTransaction *transaction,
+				 PkRoleEnum role,
+				 GError **error)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autoptr(GPtrArray) chunk = NULL;
+
+	chunk = g_ptr_array_new_with_free_func (g_free);
+	priv->input_chunk_start = priv->input_done;
+	while (chunk->len < PK_TRANSACTION_INPUT_CHUNK_SIZE) {
+		g_autofree gchar *item = NULL;
+
+		if (priv->input_pos >= priv->input_items->len)
+			break;
+		item = g_ptr_array_index (priv->input_items, priv->input_pos);
+		priv->input_items->pdata[priv->input_pos++] = NULL;
+		priv->input_done++;
+
+		/* allow a trailing newline */
+		if (item[0] == '\0')
+			continue;
+		if (!pk_transaction_input_item_validate (role, item, error))
+			return NULL;
+		g_ptr_array_add (chunk, g_steal_pointer (&item));
+	}
+	if (chunk->len == 0)
+		return NULL;
+	g_ptr_array_add (chunk, NULL);
+	return (gchar **) g_ptr_array_free (g_steal_pointer (&chunk), FALSE);
+}
+
+/* Resolve and GetDetails called with an empty list take the staged input */
+static gboolean
+pk_transaction_input_start (PkTransaction *transaction, PkRoleEnum role, GError **error)
+{
+	gchar **chunk;
+	g_autoptr(GError) error_local = NULL;
+
+	if (transaction->priv->input_reading) {
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INVALID_STATE,
+				     "the input is still being read");
+		return FALSE;
+	}
+	chunk = pk_transaction_input_read_chunk (transaction, role, &error_local);
+	if (chunk == NULL) {
+		if (error_local != NULL) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INPUT_INVALID,
+				     "Too few items to process");
+		return FALSE;
+	}
+	g_strfreev (transaction->priv->cached_package_ids);
+	transaction->priv->cached_package_ids = chunk;
+	return TRUE;
+}
+
+/**
+ * pk_transaction_input_run_next_chunk:
+ *
+ * Called when the backend has finished a chunk, which is what keeps the
+ * input from being read faster than the backend can take it.
+ *
+ * Return value: %TRUE if the backend is running the next chunk, otherwise
+ * @exit_enum is set to %PK_EXIT_ENUM_FAILED if the input was invalid
+ **/
+static gboolean
+pk_transaction_input_run_next_chunk (PkTransaction *transaction, PkExitEnum *exit_enum)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkError) item = NULL;
+	gchar **chunk;
+
+	chunk = pk_transaction_input_read_chunk (transaction, priv->role, &error);
+	if (chunk == NULL) {
+		if (error == NULL)
+			return FALSE;
+		item = pk_error_new ();
+		g_object_set (item,
+			      "code", priv->role == PK_ROLE_ENUM_GET_DETAILS ?
+					PK_ERROR_ENUM_PACKAGE_ID_INVALID :
+					PK_ERROR_ENUM_INTERNAL_ERROR,
+			      "details", error->message,
+			      NULL);
+		pk_results_set_error_code (priv->results, item);
+		pk_transaction_error_code_emit (transaction,
+						pk_error_get_code (item),
+						error->message);
+		*exit_enum = PK_EXIT_ENUM_FAILED;
+		return FALSE;
+	}
+	g_strfreev (priv->cached_package_ids);
+	priv->cached_package_ids = chunk;
+
+	g_debug ("running the next %u items of %s",
+		 g_strv_length (chunk), priv->tid);
+	pk_backend_job_reset_finished (priv->job);
+	if (priv->role == PK_ROLE_ENUM_RESOLVE) {
+		pk_backend_resolve (priv->backend, priv->job,
+				    priv->cached_filters,
+				    priv->cached_package_ids);
+	} else {
+		pk_backend_get_details (priv->backend, priv->job,
+					priv->cached_package_ids);
+	}
+	return TRUE;
+}
+
+/**
+ * pk_transaction_get_query_key:
+ *
+ * Return value: a key that is equal for transactions asking exactly the
+ * same query, or %NULL if the results of this transaction cannot be shared
+ **/
+gchar *
+pk_transaction_get_query_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+
+	if (!pk_query_cache_role_is_cacheable (priv->role))
+		return NULL;
+
+	/* nothing would drop it after zypper ar or an edited sources.list */
+	if (priv->role == PK_ROLE_ENUM_GET_REPO_LIST &&
+	    (priv->backend == NULL || !pk_backend_watches_repos (priv->backend)))
+		return NULL;
+
+	/* the cached results are all for the default root */
+	if (pk_backend_job_get_root (priv->job) != NULL)
+		return NULL;
+
+	/* only the current chunk is known */
+	if (pk_transaction_has_input (transaction))
+		return NULL;
+
+	/* a page is not the whole answer */
+	if (priv->limit > 0 || priv->offset > 0)
+		return NULL;
+	return pk_query_cache_build_key (priv->role,
+					 priv->cached_filters,
+					 priv->cached_package_ids != NULL ?
+						priv->cached_package_ids :
+						priv->cached_values,
+					 pk_backend_job_get_locale (priv->job));
+}
+
+/**
+* pk_transaction_get_backend_job:
+*
+* Returns: (transfer none): Current PkBackendJob for this transaction
+**/
+PkBackendJob *
+pk_transaction_get_backend_job (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+	return transaction->priv->job;
+}
+
+/**
+ * pk_transaction_is_finished_with_lock_required:
+ **/
+gboolean
+pk_transaction_is_finished_with_lock_required (PkTransaction *transaction)
+{
+	g_autoptr(PkError) error_code = NULL;
 
 	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
 
@@ -882,6 +1833,165 @@ pk_transaction_is_finished_with_lock_required (PkTransaction *transaction)
 	return FALSE;
 }
 
+/**
+ * pk_transaction_get_coalesce_key:
+ *
+ * Installs and updates with the coalesce hint can be merged into one
+ * backend transaction, so the dependencies are solved and the triggers
+ * run only once, if they were queued by the same user in the same session
+ * with the same flags.
+ *
+ * Return value: what transactions have to share to be merged, or %NULL
+ **/
+gchar *
+pk_transaction_get_coalesce_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autofree gchar *session = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+
+	if (!priv->coalesce)
+		return NULL;
+	if (pk_backend_job_get_root (priv->job) != NULL)
+		return NULL;
+	if (priv->role != PK_ROLE_ENUM_INSTALL_PACKAGES &&
+	    priv->role != PK_ROLE_ENUM_UPDATE_PACKAGES)
+		return NULL;
+	if (pk_bitfield_contain (priv->cached_transaction_flags,
+				 PK_TRANSACTION_FLAG_ENUM_SIMULATE))
+		return NULL;
+
+	/* the plan and the chunks only cover what this one asked for */
+	if (priv->plan_hint != NULL || pk_transaction_has_input (transaction))
+		return NULL;
+	if (priv->cached_package_ids == NULL)
+		return NULL;
+
+	if (!pk_dbus_connect (priv->dbus, NULL))
+		return NULL;
+	session = pk_dbus_get_session (priv->dbus, priv->sender);
+	if (session == NULL)
+		return NULL;
+	return g_strdup_printf ("%s\t%u\t%s\t%" G_GUINT64_FORMAT,
+				pk_role_enum_to_string (priv->role),
+				priv->uid, session,
+				priv->cached_transaction_flags);
+}
+
+/**
+ * pk_transaction_coalesce:
+ * @transaction: the transaction that will run
+ * @follower: a queued transaction with the same coalesce key
+ *
+ * Adds the packages of @follower to @transaction. The packages with the
+ * names @follower asked for are kept apart for it rather than emitted,
+ * unless @transaction asked for the same name.
+ **/
+void
+pk_transaction_coalesce (PkTransaction *transaction, PkTransaction *follower)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gchar **follower_ids = follower->priv->cached_package_ids;
+	g_autoptr(GPtrArray) package_ids = g_ptr_array_new ();
+	guint i;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_TRANSACTION (follower));
+
+	if (priv->own_package_ids == NULL) {
+		priv->own_package_ids = g_strdupv (priv->cached_package_ids);
+		priv->coalesced_names = g_hash_table_new_full (g_str_hash, g_str_equal,
+							      g_free, NULL);
+		priv->coalesced_results = pk_results_new ();
+	}
+
+	for (i = 0; priv->cached_package_ids[i] != NULL; i++)
+		g_ptr_array_add (package_ids, priv->cached_package_ids[i]);
+	for (i = 0; follower_ids[i] != NULL; i++) {
+		g_auto(GStrv) split = pk_package_id_split (follower_ids[i]);
+		gboolean own = FALSE;
+
+		if (split == NULL)
+			continue;
+		for (guint j = 0; priv->own_package_ids[j] != NULL; j++) {
+			g_auto(GStrv) own_split = pk_package_id_split (priv->own_package_ids[j]);
+			if (own_split != NULL &&
+			    g_strcmp0 (own_split[PK_PACKAGE_ID_NAME], split[PK_PACKAGE_ID_NAME]) == 0) {
+				own = TRUE;
+				break;
+			}
+		}
+		if (!own && !g_hash_table_contains (priv->coalesced_names, split[PK_PACKAGE_ID_NAME])) {
+			g_hash_table_insert (priv->coalesced_names,
+					     g_strdup (split[PK_PACKAGE_ID_NAME]), follower);
+		}
+		if (!g_strv_contains ((const gchar * const *) priv->cached_package_ids,
+				      follower_ids[i]))
+			g_ptr_array_add (package_ids, follower_ids[i]);
+	}
+	g_ptr_array_add (package_ids, NULL);
+
+	g_debug ("coalescing %s into %s", follower->priv->tid, priv->tid);
+	follower_ids = g_strdupv ((gchar **) package_ids->pdata);
+	g_strfreev (priv->cached_package_ids);
+	priv->cached_package_ids = follower_ids;
+}
+
+/**
+ * pk_transaction_get_coalesced_results:
+ *
+ * Return value: (transfer full): the packages reported for @follower
+ **/
+PkResults *
+pk_transaction_get_coalesced_results (PkTransaction *transaction, PkTransaction *follower)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	PkResults *results = pk_results_new ();
+	g_autoptr(GPtrArray) packages = NULL;
+	guint i;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+
+	if (priv->coalesced_results == NULL)
+		return results;
+	packages = pk_results_get_package_array (priv->coalesced_results);
+	for (i = 0; i < packages->len; i++) {
+		PkPackage *item = g_ptr_array_index (packages, i);
+		if (g_hash_table_lookup (priv->coalesced_names,
+					 pk_package_get_name (item)) == follower)
+			pk_results_add_package (results, item);
+	}
+	return results;
+}
+
+/**
+ * pk_transaction_is_coalesce_failed:
+ *
+ * Return value: %TRUE if transactions were merged into this one and it
+ * failed, so it has to be run again with only its own packages
+ **/
+gboolean
+pk_transaction_is_coalesce_failed (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	return transaction->priv->coalesce_failed;
+}
+
+/**
+ * pk_transaction_is_preempted:
+ *
+ * Return value: %TRUE if a resumable background transaction was cancelled
+ * to let another one run, and is waiting to be queued again
+ **/
+gboolean
+pk_transaction_is_preempted (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	return transaction->priv->preempted &&
+	       pk_backend_job_get_exit_code (transaction->priv->job) == PK_EXIT_ENUM_CANCELLED_PRIORITY;
+}
+
 static void
 pk_transaction_offline_invalidate_check (PkTransaction *transaction)
 {
@@ -1008,9 +2118,273 @@ pk_transaction_offline_finished (PkTransaction *transaction)
 	}
 }
 
+static gchar *
+pk_transaction_get_plan_key (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->plan_cache == NULL || !pk_plan_cache_role_has_plan (priv->role))
+		return NULL;
+	if (pk_backend_job_get_root (priv->job) != NULL)
+		return NULL;
+	return pk_plan_cache_build_key (priv->role,
+					priv->cached_transaction_flags,
+					priv->cached_package_ids,
+					priv->cached_allow_deps,
+					priv->cached_autoremove,
+					priv->uid);
+}
+
+/*
+ * pk_transaction_keep_plan:
+ *
+ * Keeps what the backend solved for a simulation, so that committing the
+ * same request does not have to solve it again.
+ **/
+static void
+pk_transaction_keep_plan (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GDestroyNotify destroy = NULL;
+	gpointer plan;
+	g_autofree gchar *key = NULL;
+
+	key = pk_transaction_get_plan_key (transaction);
+	if (key == NULL)
+		return;
+	plan = pk_backend_job_steal_plan (priv->job, &destroy);
+	if (plan == NULL)
+		return;
+	priv->plan = pk_plan_cache_insert (priv->plan_cache, key, plan, destroy);
+	if (priv->plan == NULL)
+		return;
+	g_debug ("keeping plan %s for %s", priv->plan, priv->tid);
+	pk_transaction_emit_property_changed (transaction,
+					      "Plan",
+					      g_variant_new_string (priv->plan));
+}
+
+/*
+ * pk_transaction_take_plan:
+ *
+ * Gives the plan named by the plan hint to the job, if it was made for
+ * exactly this request and nothing has changed since.
+ **/
+static void
+pk_transaction_take_plan (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GDestroyNotify destroy = NULL;
+	gpointer plan;
+	g_autofree gchar *key = NULL;
+
+	if (priv->plan_hint == NULL)
+		return;
+	if (pk_bitfield_contain (priv->cached_transaction_flags,
+				 PK_TRANSACTION_FLAG_ENUM_SIMULATE))
+		return;
+	key = pk_transaction_get_plan_key (transaction);
+	if (key == NULL)
+		return;
+	plan = pk_plan_cache_take (priv->plan_cache, priv->plan_hint, key, &destroy);
+	if (plan == NULL) {
+		g_debug ("plan %s is no longer valid, solving again", priv->plan_hint);
+		return;
+	}
+	g_debug ("committing plan %s for %s", priv->plan_hint, priv->tid);
+	pk_backend_job_set_plan (priv->job, plan, destroy);
+}
+
+/* in ms, or 0 if the phase was skipped */
+static guint64
+pk_transaction_phase_ms (gint64 start, gint64 end)
+{
+	if (start == 0 || end < start)
+		return 0;
+	return (end - start) / 1000;
+}
+
+/**
+ * pk_transaction_log_if_slow:
+ *
+ * Sends a transaction that took longer than SlowTransactionThreshold to
+ * the journal, with the time spent in each phase as separate fields so
+ * they can be queried for.
+ **/
+static void
+pk_transaction_log_if_slow (PkTransaction *transaction, PkExitEnum exit_enum)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 now = g_get_monotonic_time ();
+	gint64 job_finished;
+	guint64 threshold;
+	guint64 total;
+	g_autofree gchar *total_str = NULL;
+	g_autofree gchar *commit_str = NULL;
+	g_autofree gchar *auth_str = NULL;
+	g_autofree gchar *queue_str = NULL;
+	g_autofree gchar *setup_str = NULL;
+	g_autofree gchar *backend_str = NULL;
+	g_autofree gchar *dispatch_str = NULL;
+	g_autofree gchar *db_str = NULL;
+
+	threshold = g_key_file_get_uint64 (priv->conf, "Daemon",
+					   "SlowTransactionThreshold", NULL);
+	total = pk_transaction_phase_ms (priv->time_created, now);
+	if (threshold == 0 || total < threshold)
+		return;
+
+	/* when the backend said so, before the main loop got to it */
+	job_finished = pk_backend_job_get_finished_time (priv->job);
+	if (job_finished == 0)
+		job_finished = priv->time_finished;
+
+	total_str = g_strdup_printf ("%" G_GUINT64_FORMAT, total);
+	commit_str = g_strdup_printf ("%" G_GUINT64_FORMAT,
+				      pk_transaction_phase_ms (priv->time_created,
+							       priv->time_auth != 0 ? priv->time_auth : priv->time_ready));
+	auth_str = g_strdup_printf ("%" G_GUINT64_FORMAT,
+				    pk_transaction_phase_ms (priv->time_auth, priv->time_ready));
+	queue_str = g_strdup_printf ("%" G_GUINT64_FORMAT,
+				     pk_transaction_phase_ms (priv->time_ready, priv->time_running));
+	setup_str = g_strdup_printf ("%" G_GUINT64_FORMAT,
+				     pk_transaction_phase_ms (priv->time_running, priv->time_setup_done));
+	backend_str = g_strdup_printf ("%" G_GUINT64_FORMAT,
+				       pk_transaction_phase_ms (priv->time_setup_done, job_finished));
+	dispatch_str = g_strdup_printf ("%" G_GUINT64_FORMAT,
+					pk_transaction_phase_ms (job_finished, priv->time_finished));
+	db_str = g_strdup_printf ("%" G_GINT64_FORMAT, priv->time_db / 1000);
+
+	g_log_structured (G_LOG_DOMAIN, G_LOG_LEVEL_MESSAGE,
+			  "MESSAGE", "slow %s transaction %s took %sms (commit %s, auth %s, queue %s, setup %s, backend %s, dispatch %s, db %s)",
+			  pk_role_enum_to_string (priv->role), priv->tid, total_str,
+			  commit_str, auth_str, queue_str, setup_str,
+			  backend_str, dispatch_str, db_str,
+			  "PACKAGEKIT_TID", "%s", priv->tid,
+			  "PACKAGEKIT_ROLE", "%s", pk_role_enum_to_string (priv->role),
+			  "PACKAGEKIT_BACKEND", "%s", pk_backend_get_name (priv->backend),
+			  "PACKAGEKIT_EXIT", "%s", pk_exit_enum_to_string (exit_enum),
+			  "PACKAGEKIT_UID", "%u", priv->uid,
+			  "PACKAGEKIT_TOTAL_MS", "%s", total_str,
+			  "PACKAGEKIT_COMMIT_MS", "%s", commit_str,
+			  "PACKAGEKIT_AUTH_MS", "%s", auth_str,
+			  "PACKAGEKIT_QUEUE_MS", "%s", queue_str,
+			  "PACKAGEKIT_SETUP_MS", "%s", setup_str,
+			  "PACKAGEKIT_BACKEND_MS", "%s", backend_str,
+			  "PACKAGEKIT_DISPATCH_MS", "%s", dispatch_str,
+			  "PACKAGEKIT_DB_MS", "%s", db_str);
+}
+
+/**
+ * pk_transaction_resources_update:
+ *
+ * Takes the CPU time and memory from the finished job and publishes them,
+ * with the bytes sent so far, as the CpuTime, MemoryGrowth and
+ * BytesEmitted properties.
+ **/
+static void
+pk_transaction_resources_update (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	priv->cpu_time = (guint64) pk_backend_job_get_cpu_time (priv->job);
+	priv->memory_growth = (guint64) pk_backend_job_get_memory_growth (priv->job);
+	g_debug ("transaction used %" G_GUINT64_FORMAT "us of CPU, grew the peak RSS by "
+		 "%" G_GUINT64_FORMAT " bytes and sent %" G_GUINT64_FORMAT " bytes",
+		 priv->cpu_time, priv->memory_growth, priv->bytes_emitted);
+	pk_transaction_emit_property_changed (transaction,
+					      "CpuTime",
+					      g_variant_new_uint64 (priv->cpu_time));
+	pk_transaction_emit_property_changed (transaction,
+					      "MemoryGrowth",
+					      g_variant_new_uint64 (priv->memory_growth));
+	pk_transaction_emit_property_changed (transaction,
+					      "BytesEmitted",
+					      g_variant_new_uint64 (priv->bytes_emitted));
+}
+
+/*
+ * pk_transaction_cancel_deadline_cb:
+ *
+ * The backend is still running long after it was cancelled. Threads
+ * cannot be stopped from outside, so the backend keeps the transaction
+ * slot until it returns, but the client is not kept waiting for it.
+ */
+static gboolean
+pk_transaction_cancel_deadline_cb (gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	PkTransactionPrivate *priv = transaction->priv;
+	const gchar *where = pk_backend_job_get_cancel_checkpoint (priv->job);
+
+	priv->cancel_deadline_id = 0;
+	g_warning ("%s is still running after being cancelled (%s), finishing it for the client",
+		   pk_role_enum_to_string (priv->role),
+		   where != NULL ? where : "no checkpoint noticed it");
+	pk_transaction_error_code_emit (transaction,
+					PK_ERROR_ENUM_TRANSACTION_CANCELLED,
+					"the backend did not stop in time");
+	pk_transaction_finished_emit_client (transaction,
+					     PK_EXIT_ENUM_CANCELLED,
+					     pk_transaction_get_runtime (transaction));
+	priv->cancel_escalated = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pk_transaction_cancel_set_deadline (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint timeout = PK_TRANSACTION_CANCEL_TIMEOUT_DEFAULT;
+
+	if (priv->cancel_deadline_id != 0)
+		return;
+	if (g_key_file_has_key (priv->conf, "Daemon", "CancelTimeout", NULL))
+		timeout = g_key_file_get_integer (priv->conf, "Daemon", "CancelTimeout", NULL);
+	if (timeout <= 0)
+		return;
+	priv->cancel_deadline_id = g_timeout_add_seconds (timeout,
+							  pk_transaction_cancel_deadline_cb,
+							  transaction);
+	g_source_set_name_by_id (priv->cancel_deadline_id,
+				 "[PkTransaction] cancel-deadline");
+}
+
+/*
+ * pk_transaction_cancel_finished:
+ *
+ * Records how long the backend took to finish after a cancel request,
+ * and logs the roles that are slow to stop.
+ */
+static void
+pk_transaction_cancel_finished (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	gint64 requested = pk_backend_job_get_cancel_requested (priv->job);
+	gint64 latency;
+	const gchar *where;
+
+	if (priv->cancel_deadline_id != 0) {
+		g_source_remove (priv->cancel_deadline_id);
+		priv->cancel_deadline_id = 0;
+	}
+	if (requested == 0)
+		return;
+	latency = priv->time_finished - requested;
+	if (priv->metrics != NULL)
+		pk_metrics_record (priv->metrics, priv->role, PK_METRICS_HISTOGRAM_CANCEL, latency);
+	if (latency < PK_TRANSACTION_CANCEL_SLOW * 1000)
+		return;
+	where = pk_backend_job_get_cancel_checkpoint (priv->job);
+	g_warning ("%s took %" G_GINT64_FORMAT "ms to finish after being cancelled (%s)",
+		   pk_role_enum_to_string (priv->role), latency / 1000,
+		   where != NULL ? where : "no checkpoint noticed it");
+}
+
 static void
 pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransaction *transaction)
 {
+	gint64 db_start;
 	guint time_ms;
 	guint i;
 	PkPackage *item;
@@ -1025,6 +2399,21 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 		g_warning ("Already finished");
 		return;
 	}
+	transaction->priv->time_finished = g_get_monotonic_time ();
+	pk_transaction_cancel_finished (transaction);
+
+	/* the client has already been told, only the scheduler is waiting */
+	if (transaction->priv->cancel_escalated) {
+		transaction->priv->finished = TRUE;
+		g_signal_emit (transaction, signals[SIGNAL_FINISHED], 0);
+		return;
+	}
+
+	/* keep going until the whole input has been through the backend */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    pk_transaction_has_input (transaction) &&
+	    pk_transaction_input_run_next_chunk (transaction, &exit_enum))
+		return;
 
 	/* save this so we know if the cache is valid */
 	pk_results_set_exit_code (transaction->priv->results, exit_enum);
@@ -1037,6 +2426,21 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 		return;
 	}
 
+	/* likewise if we made way for an interactive transaction */
+	if (pk_transaction_is_preempted (transaction)) {
+		g_signal_emit (transaction, signals[SIGNAL_FINISHED], 0);
+		return;
+	}
+
+	/* or if the merged transaction failed, and each is tried alone */
+	if (transaction->priv->coalesced_names != NULL &&
+	    exit_enum != PK_EXIT_ENUM_SUCCESS &&
+	    exit_enum != PK_EXIT_ENUM_CANCELLED) {
+		transaction->priv->coalesce_failed = TRUE;
+		g_signal_emit (transaction, signals[SIGNAL_FINISHED], 0);
+		return;
+	}
+
 	/* handle offline updates */
 	transaction_flags = transaction->priv->cached_transaction_flags;
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
@@ -1059,10 +2463,67 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
 		pk_transaction_finish_invalidate_caches (transaction);
 
+	/* keep the solved plan of a simulation, and drop any other */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    pk_bitfield_contain (transaction_flags, PK_TRANSACTION_FLAG_ENUM_SIMULATE))
+		pk_transaction_keep_plan (transaction);
+	pk_backend_job_set_plan (transaction->priv->job, NULL, NULL);
+
+	/* tell the client where the next page starts */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    pk_backend_job_get_limit_reached (transaction->priv->job)) {
+		g_free (transaction->priv->cursor);
+		transaction->priv->cursor = g_strdup_printf ("%u", transaction->priv->offset +
+								   transaction->priv->limit);
+		pk_transaction_emit_property_changed (transaction,
+						      "Cursor",
+						      g_variant_new_string (transaction->priv->cursor));
+	}
+
+	/* tell the client some detail was left out to meet its deadline */
+	if (pk_backend_job_get_partial (transaction->priv->job)) {
+		transaction->priv->partial = TRUE;
+		pk_transaction_emit_property_changed (transaction,
+						      "Partial",
+						      g_variant_new_boolean (TRUE));
+	}
+
+	/* the candidates for the next search of the session */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
+		pk_transaction_keep_search (transaction);
+
+	/* save the results of queries so they can be replayed */
+	if (exit_enum == PK_EXIT_ENUM_SUCCESS &&
+	    transaction->priv->query_cache != NULL &&
+	    !transaction->priv->partial &&
+	    !transaction->priv->projected &&
+	    !transaction->priv->replayed) {
+		g_autofree gchar *key = pk_transaction_get_query_key (transaction);
+		if (key != NULL)
+			pk_query_cache_insert (transaction->priv->query_cache,
+					       key, transaction->priv->results,
+					       transaction->priv->query_generation);
+
+		/* what update badges are shown from */
+		if (transaction->priv->role == PK_ROLE_ENUM_GET_UPDATES &&
+		    pk_backend_job_get_root (transaction->priv->job) == NULL &&
+		    (transaction->priv->cached_filters == 0 ||
+		     transaction->priv->cached_filters == pk_bitfield_value (PK_FILTER_ENUM_NONE))) {
+			pk_query_cache_set_updates (transaction->priv->query_cache,
+						    transaction->priv->results,
+						    transaction->priv->query_generation);
+		}
+	}
+
 	/* find the length of time we have been running */
 	time_ms = pk_transaction_get_runtime (transaction);
 	g_debug ("backend was running for %i ms", time_ms);
 
+	/* so the size of the results is known for the history */
+	pk_transaction_results_send (transaction);
+	pk_transaction_resources_update (transaction);
+	db_start = g_get_monotonic_time ();
+
 	/* add to the database if we are going to log it */
 	if (transaction->priv->role == PK_ROLE_ENUM_UPDATE_PACKAGES ||
 	    transaction->priv->role == PK_ROLE_ENUM_INSTALL_PACKAGES ||
@@ -1106,11 +2567,18 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
 		pk_transaction_db_action_time_reset (transaction->priv->transaction_db, transaction->priv->role);
 
+	pk_transaction_db_set_resources (transaction->priv->transaction_db,
+					 transaction->priv->tid,
+					 transaction->priv->cpu_time,
+					 transaction->priv->memory_growth,
+					 transaction->priv->bytes_emitted);
+
 	/* did we finish okay? */
 	if (exit_enum == PK_EXIT_ENUM_SUCCESS)
 		pk_transaction_db_set_finished (transaction->priv->transaction_db, transaction->priv->tid, TRUE, time_ms);
 	else
 		pk_transaction_db_set_finished (transaction->priv->transaction_db, transaction->priv->tid, FALSE, time_ms);
+	transaction->priv->time_db = g_get_monotonic_time () - db_start;
 
 	/* remove any inhibit */
 	//TODO: on main interface
@@ -1139,10 +2607,39 @@ pk_transaction_finished_cb (PkBackendJob *job, PkExitEnum exit_enum, PkTransacti
 	/* destroy the job */
 	pk_backend_stop_job (transaction->priv->backend, transaction->priv->job);
 
+	pk_transaction_log_if_slow (transaction, exit_enum);
+
 	/* we emit last, as other backends will be running very soon after us, and we don't want to be notified */
 	pk_transaction_finished_emit (transaction, exit_enum, time_ms);
 }
 
+/**
+ * pk_transaction_role_can_batch_packages:
+ *
+ * Only roles where ::Package is the result, rather than progress of a
+ * running action, are safe to send as a ::Packages batch.
+ **/
+static gboolean
+pk_transaction_role_can_batch_packages (PkRoleEnum role)
+{
+	switch (role) {
+	case PK_ROLE_ENUM_DEPENDS_ON:
+	case PK_ROLE_ENUM_GET_PACKAGES:
+	case PK_ROLE_ENUM_GET_UPDATES:
+	case PK_ROLE_ENUM_REQUIRED_BY:
+	case PK_ROLE_ENUM_RESOLVE:
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+	case PK_ROLE_ENUM_SEARCH_FILE:
+	case PK_ROLE_ENUM_SEARCH_GROUP:
+	case PK_ROLE_ENUM_SEARCH_NAME:
+	case PK_ROLE_ENUM_WHAT_PROVIDES:
+		return TRUE;
+	default:
+		break;
+	}
+	return FALSE;
+}
+
 static void
 pk_transaction_package_cb (PkBackend *backend,
 			   PkPackage *item,
@@ -1198,6 +2695,15 @@ pk_transaction_package_cb (PkBackend *backend,
 		}
 	}
 
+	/* what a coalesced transaction asked for is reported there */
+	if (transaction->priv->coalesced_names != NULL &&
+	    g_hash_table_contains (transaction->priv->coalesced_names,
+				   pk_package_get_name (item))) {
+		if (info != PK_INFO_ENUM_FINISHED)
+			pk_results_add_package (transaction->priv->coalesced_results, item);
+		return;
+	}
+
 	/* add to results even if we already got a result */
 	if (info != PK_INFO_ENUM_FINISHED)
 		pk_results_add_package (transaction->priv->results, item);
@@ -1206,7 +2712,8 @@ pk_transaction_package_cb (PkBackend *backend,
 	package_id = pk_package_get_id (item);
 	g_free (transaction->priv->last_package_id);
 	transaction->priv->last_package_id = g_strdup (package_id);
-	summary = pk_package_get_summary (item);
+	if (pk_transaction_wants_field (transaction, "summary"))
+		summary = pk_package_get_summary (item);
 	if (transaction->priv->role != PK_ROLE_ENUM_GET_PACKAGES) {
 		g_debug ("emit package %s, %s, %s",
 			 pk_info_enum_to_string (info),
@@ -1220,16 +2727,41 @@ pk_transaction_package_cb (PkBackend *backend,
 	update_severity = pk_package_get_update_severity (item);
 	encoded_value = info | (((guint32) update_severity) << 16);
 
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "Package",
-				       g_variant_new ("(uss)",
-						      encoded_value,
-						      package_id,
-						      summary ? summary : ""),
-				       NULL);
+	/* sent as a memfd when finished */
+	if (pk_transaction_use_results_fd (transaction))
+		return;
+
+	/* queue up for ::Packages if the client asked for batching */
+	if (transaction->priv->packages_batch_size > 0 &&
+	    pk_transaction_role_can_batch_packages (transaction->priv->role)) {
+		PkTransactionPrivate *priv = transaction->priv;
+		if (priv->packages_builder == NULL)
+			priv->packages_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(uss)"));
+		g_variant_builder_add (priv->packages_builder,
+				       "(uss)",
+				       encoded_value,
+				       package_id,
+				       summary ? summary : "");
+		if (++priv->packages_batch_len >= priv->packages_batch_size) {
+			pk_transaction_packages_flush (transaction);
+		} else if (priv->packages_flush_id == 0) {
+			priv->packages_flush_id =
+				g_timeout_add (PK_TRANSACTION_PACKAGES_FLUSH_TIMEOUT,
+					       pk_transaction_packages_flush_cb,
+					       transaction);
+			g_source_set_name_by_id (priv->packages_flush_id,
+						 "[PkTransaction] flush packages");
+		}
+		return;
+	}
+
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "Package",
+				    g_variant_new ("(uss)",
+						   encoded_value,
+						   package_id,
+						   summary ? summary : ""));
 }
 
 static void
@@ -1252,16 +2784,13 @@ pk_transaction_repo_detail_cb (PkBackend *backend,
 	description = pk_repo_detail_get_description (item);
 	enabled = pk_repo_detail_get_enabled (item);
 	g_debug ("emitting repo-detail %s, %s, %i", repo_id, description, enabled);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "RepoDetail",
-				       g_variant_new ("(ssb)",
-						      repo_id,
-						      description != NULL ? description : "",
-						      enabled),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "RepoDetail",
+				    g_variant_new ("(ssb)",
+						   repo_id,
+						   description != NULL ? description : "",
+						   enabled));
 }
 
 static void
@@ -1301,21 +2830,18 @@ pk_transaction_repo_signature_required_cb (PkBackend *backend,
 		 package_id, repository_name, key_url, key_userid, key_id,
 		 key_fingerprint, key_timestamp,
 		 pk_sig_type_enum_to_string (type));
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "RepoSignatureRequired",
-				       g_variant_new ("(sssssssu)",
-						      package_id,
-						      repository_name,
-						      key_url != NULL ? key_url : "",
-						      key_userid != NULL ? key_userid : "",
-						      key_id != NULL ? key_id : "",
-						      key_fingerprint != NULL ? key_fingerprint : "",
-						      key_timestamp != NULL ? key_timestamp : "",
-						      type),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "RepoSignatureRequired",
+				    g_variant_new ("(sssssssu)",
+						   package_id,
+						   repository_name,
+						   key_url != NULL ? key_url : "",
+						   key_userid != NULL ? key_userid : "",
+						   key_id != NULL ? key_id : "",
+						   key_fingerprint != NULL ? key_fingerprint : "",
+						   key_timestamp != NULL ? key_timestamp : "",
+						   type));
 
 	/* we should mark this transaction so that we finish with a special code */
 	transaction->priv->emit_signature_required = TRUE;
@@ -1346,17 +2872,14 @@ pk_transaction_eula_required_cb (PkBackend *backend,
 	/* emit */
 	g_debug ("emitting eula-required %s, %s, %s, %s",
 		   eula_id, package_id, vendor_name, license_agreement);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "EulaRequired",
-				       g_variant_new ("(ssss)",
-						      eula_id,
-						      package_id,
-						      vendor_name != NULL ? vendor_name : "",
-						      license_agreement != NULL ? license_agreement : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "EulaRequired",
+				    g_variant_new ("(ssss)",
+						   eula_id,
+						   package_id,
+						   vendor_name != NULL ? vendor_name : "",
+						   license_agreement != NULL ? license_agreement : ""));
 
 	/* we should mark this transaction so that we finish with a special code */
 	transaction->priv->emit_eula_required = TRUE;
@@ -1389,16 +2912,13 @@ pk_transaction_media_change_required_cb (PkBackend *backend,
 		 pk_media_type_enum_to_string (media_type),
 		 media_id,
 		 media_text);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "MediaChangeRequired",
-				       g_variant_new ("(uss)",
-						      media_type,
-						      media_id,
-						      media_text != NULL ? media_text : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "MediaChangeRequired",
+				    g_variant_new ("(uss)",
+						   media_type,
+						   media_id,
+						   media_text != NULL ? media_text : ""));
 
 	/* we should mark this transaction so that we finish with a special code */
 	transaction->priv->emit_media_change_required = TRUE;
@@ -1454,15 +2974,12 @@ pk_transaction_require_restart_cb (PkBackend *backend,
 	g_debug ("emitting require-restart %s, '%s'",
 		 pk_restart_enum_to_string (restart),
 		 package_id);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "RequireRestart",
-				       g_variant_new ("(us)",
-						      restart,
-						      package_id),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "RequireRestart",
+				    g_variant_new ("(us)",
+						   restart,
+						   package_id));
 }
 
 static void
@@ -1521,26 +3038,39 @@ pk_transaction_update_detail_cb (PkBackend *backend,
 	changelog = pk_update_detail_get_changelog (item);
 	issued = pk_update_detail_get_issued (item);
 	updated = pk_update_detail_get_updated (item);
+
+	/* only what the fields hint asked for */
+	if (!pk_transaction_wants_field (transaction, "vendor-urls"))
+		vendor_urls = NULL;
+	if (!pk_transaction_wants_field (transaction, "bugzilla-urls"))
+		bugzilla_urls = NULL;
+	if (!pk_transaction_wants_field (transaction, "cve-urls"))
+		cve_urls = NULL;
+	if (!pk_transaction_wants_field (transaction, "update-text"))
+		update_text = NULL;
+	if (!pk_transaction_wants_field (transaction, "changelog"))
+		changelog = NULL;
+	if (!pk_transaction_wants_field (transaction, "issued"))
+		issued = NULL;
+	if (!pk_transaction_wants_field (transaction, "updated"))
+		updated = NULL;
 	g_debug ("emitting update-detail for %s", package_id);
-	g_dbus_connection_emit_signal (transaction->priv->connection,
-				       NULL,
-				       transaction->priv->tid,
-				       PK_DBUS_INTERFACE_TRANSACTION,
-				       "UpdateDetail",
-				       g_variant_new ("(s^as^as^as^as^asussuss)",
-						      package_id,
-						      updates != NULL ? updates : empty,
-						      obsoletes != NULL ? obsoletes : empty,
-						      vendor_urls != NULL ? vendor_urls : empty,
-						      bugzilla_urls != NULL ? bugzilla_urls : empty,
-						      cve_urls != NULL ? cve_urls : empty,
-						      pk_update_detail_get_restart (item),
-						      update_text != NULL ? update_text : "",
-						      changelog != NULL ? changelog : "",
-						      pk_update_detail_get_state (item),
-						      issued != NULL ? issued : "",
-						      updated != NULL ? updated : ""),
-				       NULL);
+	pk_transaction_emit_signal (transaction,
+				    PK_DBUS_INTERFACE_TRANSACTION,
+				    "UpdateDetail",
+				    g_variant_new ("(s^as^as^as^as^asussuss)",
+						   package_id,
+						   updates != NULL ? updates : empty,
+						   obsoletes != NULL ? obsoletes : empty,
+						   vendor_urls != NULL ? vendor_urls : empty,
+						   bugzilla_urls != NULL ? bugzilla_urls : empty,
+						   cve_urls != NULL ? cve_urls : empty,
+						   pk_update_detail_get_restart (item),
+						   update_text != NULL ? update_text : "",
+						   changelog != NULL ? changelog : "",
+						   pk_update_detail_get_state (item),
+						   issued != NULL ? issued : "",
+						   updated != NULL ? updated : ""));
 }
 
 static gboolean
@@ -1624,11 +3154,36 @@ pk_transaction_download_size_remaining_cb (PkBackendJob *job,
 					      g_variant_new_uint64 (*download_size_remaining));
 }
 
+static void
+pk_transaction_download_bytes_cb (PkBackendJob *job,
+				  guint64 *totals,
+				  PkTransaction *transaction)
+{
+	transaction->priv->download_bytes_done = totals[0];
+	transaction->priv->download_bytes_total = totals[1];
+	pk_transaction_emit_property_changed (transaction,
+					      "DownloadBytesDone",
+					      g_variant_new_uint64 (totals[0]));
+	pk_transaction_emit_property_changed (transaction,
+					      "DownloadBytesTotal",
+					      g_variant_new_uint64 (totals[1]));
+}
+
 static void
 pk_transaction_percentage_cb (PkBackendJob *job,
 			      guint percentage,
 			      PkTransaction *transaction)
 {
+	PkTransactionPrivate *priv = transaction->priv;
+
+	/* each chunk of a large input goes from 0 to 100 again */
+	if (pk_transaction_has_input (transaction) &&
+	    percentage <= 100 && priv->input_size > 0) {
+		guint64 done = priv->input_chunk_start +
+			       (priv->input_done - priv->input_chunk_start) * percentage / 100;
+		percentage = MIN (done * 100 / priv->input_size, 100);
+	}
+
 	/* emit */
 	transaction->priv->percentage = percentage;
 	pk_transaction_emit_property_changed (transaction,
@@ -1636,6 +3191,244 @@ pk_transaction_percentage_cb (PkBackendJob *job,
 					      g_variant_new_uint32 (percentage));
 }
 
+/**
+ * pk_transaction_keep_search:
+ *
+ * Keeps the complete results of a search as the candidates for the next
+ * search of the session, which may then be answered without the backend.
+ **/
+static void
+pk_transaction_keep_search (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autoptr(GPtrArray) packages = NULL;
+
+	if (priv->search_session == NULL || priv->search_sessions == NULL)
+		return;
+	if (priv->limit > 0 || priv->offset > 0)
+		return;
+	if (pk_backend_job_get_root (priv->job) != NULL)
+		return;
+	if (priv->partial || priv->projected)
+		return;
+	packages = pk_results_get_package_array (priv->results);
+	pk_search_sessions_update (priv->search_sessions,
+				   priv->search_session,
+				   priv->sender,
+				   priv->role,
+				   priv->cached_filters,
+				   priv->cached_values,
+				   packages);
+}
+
+/**
+ * pk_transaction_replay_results:
+ *
+ * Emits the results of an identical query and finishes the transaction
+ * without starting a backend job.
+ **/
+static void
+pk_transaction_replay_results (PkTransaction *transaction, PkResults *results)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	guint i;
+	g_autoptr(GPtrArray) details = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) update_details = NULL;
+	g_autoptr(GPtrArray) categories = NULL;
+	g_autoptr(GPtrArray) repo_details = NULL;
+	g_autoptr(GPtrArray) distro_upgrades = NULL;
+
+	priv->replayed = TRUE;
+
+	/* use the same paths as the backend would */
+	packages = pk_results_get_package_array (results);
+	for (i = 0; i < packages->len; i++)
+		pk_transaction_package_cb (NULL, g_ptr_array_index (packages, i), transaction);
+	details = pk_results_get_details_array (results);
+	for (i = 0; i < details->len; i++)
+		pk_transaction_details_cb (NULL, g_ptr_array_index (details, i), transaction);
+	update_details = pk_results_get_update_detail_array (results);
+	for (i = 0; i < update_details->len; i++)
+		pk_transaction_update_detail_cb (NULL, g_ptr_array_index (update_details, i), transaction);
+	categories = pk_results_get_category_array (results);
+	for (i = 0; i < categories->len; i++)
+		pk_transaction_category_cb (NULL, g_ptr_array_index (categories, i), transaction);
+	repo_details = pk_results_get_repo_detail_array (results);
+	for (i = 0; i < repo_details->len; i++)
+		pk_transaction_repo_detail_cb (NULL, g_ptr_array_index (repo_details, i), transaction);
+	distro_upgrades = pk_results_get_distro_upgrade_array (results);
+	for (i = 0; i < distro_upgrades->len; i++)
+		pk_transaction_distro_upgrade_cb (NULL, g_ptr_array_index (distro_upgrades, i), transaction);
+	pk_transaction_keep_search (transaction);
+
+	/* we should get nothing more for this tid */
+	priv->finished = TRUE;
+	pk_results_set_exit_code (priv->results, PK_EXIT_ENUM_SUCCESS);
+	pk_transaction_db_set_finished (priv->transaction_db, priv->tid, TRUE, 0);
+	pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_SUCCESS, 0);
+}
+
+/**
+ * pk_transaction_replay_download_pool:
+ *
+ * Hands out the packages of a DownloadPackages that are already in the
+ * download pool, and leaves only the others for the backend.
+ *
+ * Return value: %TRUE if nothing is left to download
+ **/
+static gboolean
+pk_transaction_replay_download_pool (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autoptr(GPtrArray) missing = g_ptr_array_new_with_free_func (g_free);
+
+	if (priv->role != PK_ROLE_ENUM_DOWNLOAD_PACKAGES ||
+	    priv->cached_directory == NULL)
+		return FALSE;
+
+	for (guint i = 0; priv->cached_package_ids[i] != NULL; i++) {
+		const gchar *package_id = priv->cached_package_ids[i];
+		g_auto(GStrv) files = NULL;
+		g_autoptr(PkFiles) item = NULL;
+
+		files = pk_transaction_download_pool_lookup (package_id, priv->cached_directory);
+		if (files == NULL) {
+			g_ptr_array_add (missing, g_strdup (package_id));
+			continue;
+		}
+		g_debug ("%s is already in the download pool", package_id);
+		item = pk_files_new ();
+		g_object_set (item,
+			      "package-id", package_id,
+			      "files", files,
+			      NULL);
+		pk_transaction_files_cb (NULL, item, transaction);
+	}
+
+	/* the backend only has to get the rest */
+	if (missing->len > 0) {
+		g_ptr_array_add (missing, NULL);
+		g_strfreev (priv->cached_package_ids);
+		priv->cached_package_ids = (gchar **) g_ptr_array_free (g_steal_pointer (&missing), FALSE);
+		return FALSE;
+	}
+
+	priv->finished = TRUE;
+	pk_results_set_exit_code (priv->results, PK_EXIT_ENUM_SUCCESS);
+	pk_transaction_db_set_finished (priv->transaction_db, priv->tid, TRUE, 0);
+	pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_SUCCESS, 0);
+	return TRUE;
+}
+
+static gboolean
+pk_transaction_replay_query_cache (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autofree gchar *key = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	if (priv->query_cache == NULL)
+		return FALSE;
+	key = pk_transaction_get_query_key (transaction);
+	if (key == NULL)
+		return FALSE;
+	results = pk_query_cache_lookup (priv->query_cache, key);
+	if (results == NULL)
+		return FALSE;
+
+	g_debug ("replaying cached results for %s", priv->tid);
+	pk_transaction_replay_results (transaction, results);
+	return TRUE;
+}
+
+/* the new term extends the previous one of the session */
+static gboolean
+pk_transaction_replay_search_session (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	guint i;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	if (priv->search_session == NULL || priv->search_sessions == NULL)
+		return FALSE;
+	if (priv->limit > 0 || priv->offset > 0)
+		return FALSE;
+	if (pk_backend_job_get_root (priv->job) != NULL)
+		return FALSE;
+	packages = pk_search_sessions_narrow (priv->search_sessions,
+					      priv->search_session,
+					      priv->sender,
+					      priv->role,
+					      priv->cached_filters,
+					      priv->cached_values);
+	if (packages == NULL)
+		return FALSE;
+
+	g_debug ("replaying search session results for %s", priv->tid);
+	results = pk_results_new ();
+	for (i = 0; i < packages->len; i++)
+		pk_results_add_package (results, g_ptr_array_index (packages, i));
+	pk_transaction_replay_results (transaction, results);
+	return TRUE;
+}
+
+PkResults *
+pk_transaction_get_results (PkTransaction *transaction)
+{
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+	return transaction->priv->results;
+}
+
+/**
+ * pk_transaction_set_shared_results:
+ *
+ * Sets the results of an identical query that was in flight when this
+ * transaction was committed, to be emitted instead of running the backend.
+ **/
+void
+pk_transaction_set_shared_results (PkTransaction *transaction, PkResults *results)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (PK_IS_RESULTS (results));
+
+	if (transaction->priv->shared_results != NULL)
+		g_object_unref (transaction->priv->shared_results);
+	transaction->priv->shared_results = g_object_ref (results);
+}
+
+/**
+ * pk_transaction_get_results_before_refresh:
+ *
+ * Looks up the answer to the query from before the RefreshCache that is
+ * running. It is only good enough if the client gave a cache age and the
+ * metadata it came from is no older than that.
+ *
+ * Return value: (transfer full): the cached results, or %NULL
+ **/
+PkResults *
+pk_transaction_get_results_before_refresh (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	guint cache_age;
+	g_autofree gchar *key = NULL;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), NULL);
+
+	if (priv->query_cache == NULL || !priv->cache_age_set)
+		return NULL;
+	key = pk_transaction_get_query_key (transaction);
+	if (key == NULL)
+		return NULL;
+	cache_age = pk_backend_job_get_cache_age (priv->job);
+	if (cache_age != G_MAXUINT &&
+	    pk_transaction_db_action_time_since (priv->transaction_db,
+						 PK_ROLE_ENUM_REFRESH_CACHE) > cache_age)
+		return NULL;
+	return pk_query_cache_lookup (priv->query_cache, key);
+}
+
 gboolean
 pk_transaction_run (PkTransaction *transaction)
 {
@@ -1647,6 +3440,8 @@ pk_transaction_run (PkTransaction *transaction)
 	g_return_val_if_fail (priv->tid != NULL, FALSE);
 	g_return_val_if_fail (transaction->priv->backend != NULL, FALSE);
 
+	PK_TRACE2 (transaction__run, priv->tid, priv->role);
+
 	/* we are no longer waiting, we are setting up */
 	pk_transaction_status_changed_emit (transaction, PK_STATUS_ENUM_SETUP);
 
@@ -1657,6 +3452,15 @@ pk_transaction_run (PkTransaction *transaction)
 		g_clear_error (&error);
 	}
 
+	/* background work shares the daemon-wide bandwidth budget, which
+	 * can be changed at runtime so is only read when starting */
+	if (pk_backend_job_get_background (priv->job)) {
+		pk_backend_job_set_download_rate (priv->job,
+						  g_key_file_get_uint64 (priv->conf, "Daemon",
+									 "BackgroundDownloadRate",
+									 NULL));
+	}
+
 	/* already cancelled? */
 	if (pk_backend_job_get_exit_code (priv->job) == PK_EXIT_ENUM_CANCELLED) {
 		exit_status = pk_backend_job_get_exit_code (priv->job);
@@ -1664,8 +3468,32 @@ pk_transaction_run (PkTransaction *transaction)
 		return TRUE;
 	}
 
+	/* an identical query was in flight when we were committed */
+	if (priv->shared_results != NULL) {
+		g_debug ("replaying shared results for %s", priv->tid);
+		pk_transaction_replay_results (transaction, priv->shared_results);
+		return TRUE;
+	}
+
+	/* the previous search of the session already has every match */
+	if (pk_transaction_replay_search_session (transaction))
+		return TRUE;
+
+	/* an identical query has already been answered */
+	if (pk_transaction_replay_query_cache (transaction))
+		return TRUE;
+
+	/* results from before an invalidation must not be cached after it */
+	if (priv->query_cache != NULL)
+		priv->query_generation = pk_query_cache_get_generation (priv->query_cache);
+
+	/* everything asked for has been downloaded before */
+	if (pk_transaction_replay_download_pool (transaction))
+		return TRUE;
+
 	/* run the job */
 	pk_backend_start_job (priv->backend, priv->job);
+	priv->time_setup_done = g_get_monotonic_time ();
 
 	/* is an error code set? */
 	if (pk_backend_job_get_is_error_set (priv->job)) {
@@ -1738,6 +3566,10 @@ pk_transaction_run (PkTransaction *transaction)
 				  PK_BACKEND_SIGNAL_DOWNLOAD_SIZE_REMAINING,
 				  PK_BACKEND_JOB_VFUNC (pk_transaction_download_size_remaining_cb),
 				  transaction);
+	pk_backend_job_set_vfunc (priv->job,
+				  PK_BACKEND_SIGNAL_DOWNLOAD_BYTES,
+				  PK_BACKEND_JOB_VFUNC (pk_transaction_download_bytes_cb),
+				  transaction);
 	pk_backend_job_set_vfunc (priv->job,
 				  PK_BACKEND_SIGNAL_REPO_DETAIL,
 				  PK_BACKEND_JOB_VFUNC (pk_transaction_repo_detail_cb),
@@ -1771,6 +3603,9 @@ pk_transaction_run (PkTransaction *transaction)
 				  PK_BACKEND_JOB_VFUNC (pk_transaction_category_cb),
 				  transaction);
 
+	/* commit the plan of an earlier simulation rather than solving again */
+	pk_transaction_take_plan (transaction);
+
 	/* do the correct action with the cached parameters */
 	switch (priv->role) {
 	case PK_ROLE_ENUM_DEPENDS_ON:
@@ -2000,6 +3835,14 @@ pk_transaction_vanished_cb (GDBusConnection *connection,
 
 	transaction->priv->caller_active = FALSE;
 
+	/* nobody is left to read the history */
+	if (transaction->priv->role == PK_ROLE_ENUM_GET_OLD_TRANSACTIONS)
+		g_cancellable_cancel (transaction->priv->cancellable);
+
+	/* nothing else can use these */
+	if (transaction->priv->auth_cache != NULL)
+		pk_auth_cache_invalidate_sender (transaction->priv->auth_cache, name);
+
 	/* emit */
 	pk_transaction_emit_property_changed (transaction,
 					      "CallerActive",
@@ -2081,8 +3924,8 @@ pk_transaction_strvalidate (const gchar *text, GError **error)
 		return FALSE;
 	}
 
-	/* just check for valid UTF-8 */
-	if (!g_utf8_validate (text, -1, NULL)) {
+	/* just check for valid UTF-8, the length is already known */
+	if (!g_utf8_validate (text, length, NULL)) {
 		g_set_error (error,
 			     PK_TRANSACTION_ERROR,
 			     PK_TRANSACTION_ERROR_INPUT_INVALID,
@@ -2095,6 +3938,7 @@ pk_transaction_strvalidate (const gchar *text, GError **error)
 static gboolean
 pk_transaction_search_check_item (const gchar *values, GError **error)
 {
+	guchar seen = 0;
 	guint size;
 
 	/* limit to a 1k chunk */
@@ -2105,26 +3949,23 @@ pk_transaction_search_check_item (const gchar *values, GError **error)
 				     "Search is null. This isn't supposed to happen...");
 		return FALSE;
 	}
-	size = pk_strlen (values, 1024);
-	if (size == 0) {
-		g_set_error_literal (error,
-				     PK_TRANSACTION_ERROR,
-				     PK_TRANSACTION_ERROR_SEARCH_INVALID,
-				     "Search string zero length");
-		return FALSE;
-	}
-	if (strstr (values, "*") != NULL) {
-		g_set_error_literal (error,
+
+	/* find the length and any wildcard in one pass */
+	for (size = 0; size < 1024 && values[size] != '\0'; size++) {
+		if (values[size] == '*' || values[size] == '?') {
+			g_set_error (error,
 				     PK_TRANSACTION_ERROR,
 				     PK_TRANSACTION_ERROR_SEARCH_INVALID,
-				     "Invalid search containing '*'");
-		return FALSE;
+				     "Invalid search containing '%c'", values[size]);
+			return FALSE;
+		}
+		seen |= (guchar) values[size];
 	}
-	if (strstr (values, "?") != NULL) {
+	if (size == 0) {
 		g_set_error_literal (error,
 				     PK_TRANSACTION_ERROR,
 				     PK_TRANSACTION_ERROR_SEARCH_INVALID,
-				     "Invalid search containing '?'");
+				     "Search string zero length");
 		return FALSE;
 	}
 	if (size == 1024) {
@@ -2134,7 +3975,16 @@ pk_transaction_search_check_item (const gchar *values, GError **error)
 				     "The search string length is too large");
 		return FALSE;
 	}
-	return pk_transaction_strvalidate (values, error);
+
+	/* plain ASCII is always valid UTF-8 */
+	if ((seen & 0x80) != 0 && !g_utf8_validate (values, size, NULL)) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Invalid input passed to daemon: %s", values);
+		return FALSE;
+	}
+	return TRUE;
 }
 
 static gboolean
@@ -2153,6 +4003,7 @@ pk_transaction_search_check (gchar **values, GError **error)
 struct AuthorizeActionsData {
 	PkTransaction *transaction;
 	PkRoleEnum role;
+	gboolean interactive;
 	/** Array of policy actions to authorize. They will are processed sequentially,
 	 * which can result in several chained callbacks. */
 	GPtrArray *actions;
@@ -2187,6 +4038,8 @@ pk_transaction_authorize_actions_finished_cb (GObject *source_object,
 
 	/* finish the call */
 	result = polkit_authority_check_authorization_finish (priv->authority, res, &error);
+	PK_TRACE3 (transaction__authorize__done, priv->tid, action_id,
+		   result != NULL && polkit_authorization_result_get_is_authorized (result));
 
 	/* failed because the request was cancelled */
 	if (g_cancellable_is_cancelled (priv->cancellable)) {
@@ -2227,6 +4080,15 @@ pk_transaction_authorize_actions_finished_cb (GObject *source_object,
 		goto out;
 	}
 
+	/* only remember answers that did not need the user, or that polkit
+	 * itself keeps, so a one-off password prompt is not extended */
+	if (priv->auth_cache != NULL &&
+	    (!data->interactive ||
+	     polkit_authorization_result_get_retains_authorization (result))) {
+		pk_auth_cache_insert (priv->auth_cache, priv->sender,
+				      action_id, data->interactive);
+	}
+
 	if (data->actions->len <= 1) {
 		/* authentication finished successfully */
 		priv->waiting_for_auth = FALSE;
@@ -2271,6 +4133,17 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 	const gchar *text = NULL;
 	struct AuthorizeActionsData *data = NULL;
 	PolkitCheckAuthorizationFlags flags;
+	gboolean interactive;
+
+	/* skip the actions this caller was recently authorized for */
+	interactive = pk_backend_job_get_interactive (priv->job);
+	while (priv->auth_cache != NULL && actions->len > 0 &&
+	       pk_auth_cache_lookup (priv->auth_cache, priv->sender,
+				     g_ptr_array_index (actions, 0), interactive)) {
+		g_debug ("using cached authorization for %s",
+			 (const gchar *) g_ptr_array_index (actions, 0));
+		g_ptr_array_remove_index (actions, 0);
+	}
 
 	if (actions->len <= 0) {
 		g_debug ("No authentication required");
@@ -2355,6 +4228,7 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 	data = g_new (struct AuthorizeActionsData, 1);
 	data->transaction = g_object_ref (transaction);
 	data->role = role;
+	data->interactive = interactive;
 	data->actions = g_ptr_array_ref (actions);
 
 	/* create if required */
@@ -2368,10 +4242,11 @@ pk_transaction_authorize_actions (PkTransaction *transaction,
 	}
 
 	flags = POLKIT_CHECK_AUTHORIZATION_FLAGS_NONE;
-	if (pk_backend_job_get_interactive (priv->job))
+	if (interactive)
 		flags |= POLKIT_CHECK_AUTHORIZATION_FLAGS_ALLOW_USER_INTERACTION;
 
 	g_debug ("authorizing action %s", action_id);
+	PK_TRACE3 (transaction__authorize__start, priv->tid, action_id, interactive);
 	/* do authorization async */
 	polkit_authority_check_authorization (priv->authority,
 					      priv->subject,
@@ -2641,6 +4516,14 @@ pk_transaction_cancel_bg (PkTransaction *transaction)
 		return;
 	}
 
+	/* whatever was already fetched stays in the cache, so run it again
+	 * once the backend is free rather than failing it */
+	if (pk_transaction_get_background (transaction) &&
+	    pk_backend_job_get_resumable (transaction->priv->job)) {
+		g_debug ("preempting %s", transaction->priv->tid);
+		transaction->priv->preempted = TRUE;
+	}
+
 	/* set the state, as cancelling might take a few seconds */
 	pk_backend_job_set_status (transaction->priv->job, PK_STATUS_ENUM_CANCEL);
 
@@ -2652,6 +4535,10 @@ pk_transaction_cancel_bg (PkTransaction *transaction)
 
 	/* actually run the method */
 	pk_backend_cancel (transaction->priv->backend, transaction->priv->job);
+
+	/* a preempted transaction runs again, nobody is waiting for it */
+	if (!transaction->priv->preempted)
+		pk_transaction_cancel_set_deadline (transaction);
 }
 
 static void
@@ -2705,9 +4592,12 @@ pk_transaction_cancel (PkTransaction *transaction,
 		goto out;
 	}
 
-	/* first, check the sender -- if it's the same we don't need to check the uid */
+	/* first, check the sender -- if it's the same we don't need to check the uid,
+	 * and the private connection was checked when it was attached */
 	sender = g_dbus_method_invocation_get_sender (context);
-	ret = (g_strcmp0 (transaction->priv->sender, sender) == 0);
+	ret = (g_strcmp0 (transaction->priv->sender, sender) == 0 ||
+	       (transaction->priv->peer_connection != NULL &&
+		g_dbus_method_invocation_get_connection (context) == transaction->priv->peer_connection));
 	if (ret) {
 		g_debug ("same sender, no need to check uid");
 		goto skip_uid;
@@ -2757,6 +4647,9 @@ skip_uid:
 		goto out;
 	}
 
+	/* the user wants it gone, even if it was only making way */
+	transaction->priv->preempted = FALSE;
+
 	/* set the state, as cancelling might take a few seconds */
 	pk_backend_job_set_status (transaction->priv->job, PK_STATUS_ENUM_CANCEL);
 
@@ -2768,6 +4661,7 @@ skip_uid:
 
 	/* actually run the method */
 	pk_backend_cancel (transaction->priv->backend, transaction->priv->job);
+	pk_transaction_cancel_set_deadline (transaction);
 out:
 	pk_transaction_dbus_return (context, error);
 }
@@ -2954,6 +4848,17 @@ pk_transaction_get_details (PkTransaction *transaction,
 		goto out;
 	}
 
+	/* too many to send in one go */
+	if (package_ids[0] == NULL && pk_transaction_has_input (transaction)) {
+		if (!pk_transaction_input_start (transaction, PK_ROLE_ENUM_GET_DETAILS, &error)) {
+			pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+			goto out;
+		}
+		pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_DETAILS);
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
+		goto out;
+	}
+
 	/* check package_ids */
 	ret = pk_package_ids_check (package_ids);
 	if (!ret) {
@@ -3271,9 +5176,9 @@ out:
 }
 
 static void
-pk_transaction_get_old_transactions (PkTransaction *transaction,
-				     GVariant *params,
-				     GDBusMethodInvocation *context)
+pk_transaction_get_old_transactions_cb (GObject *source,
+					GAsyncResult *res,
+					gpointer user_data)
 {
 	const gchar *cmdline;
 	const gchar *data;
@@ -3283,22 +5188,25 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 	GList *l;
 	GList *transactions = NULL;
 	guint duration;
-	guint idle_id;
-	guint number;
 	guint uid;
 	PkRoleEnum role;
 	PkTransactionPast *item;
+	g_autoptr(PkTransaction) transaction = PK_TRANSACTION (user_data);
+	g_autoptr(GError) error = NULL;
 
-	g_return_if_fail (PK_IS_TRANSACTION (transaction));
-	g_return_if_fail (transaction->priv->tid != NULL);
-
-	g_variant_get (params, "(u)",
-		       &number);
-
-	g_debug ("GetOldTransactions method called");
-
-	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_OLD_TRANSACTIONS);
-	transactions = pk_transaction_db_get_list (transaction->priv->transaction_db, number);
+	transactions = pk_transaction_db_get_list_finish (transaction->priv->transaction_db,
+							  res, &error);
+	if (error != NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_CANCELLED, 0);
+			return;
+		}
+		pk_transaction_error_code_emit (transaction,
+						PK_ERROR_ENUM_INTERNAL_ERROR,
+						error->message);
+		pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_FAILED, 0);
+		return;
+	}
 	for (l = transactions; l != NULL; l = l->next) {
 		item = PK_TRANSACTION_PAST (l->data);
 
@@ -3320,26 +5228,54 @@ pk_transaction_get_old_transactions (PkTransaction *transaction,
 			 tid, modified, succeeded,
 			 pk_role_enum_to_string (role),
 			 duration, data, uid, cmdline);
-		g_dbus_connection_emit_signal (transaction->priv->connection,
-					       NULL,
-					       transaction->priv->tid,
-					       PK_DBUS_INTERFACE_TRANSACTION,
-					       "Transaction",
-					       g_variant_new ("(osbuusus)",
-							      tid,
-							      modified,
-							      succeeded,
-							      role,
-							      duration,
-							      data != NULL ? data : "",
-							      uid,
-							      cmdline != NULL ? cmdline : ""),
-					       NULL);
+		pk_transaction_emit_signal (transaction,
+					    PK_DBUS_INTERFACE_TRANSACTION,
+					    "Transaction",
+					    g_variant_new ("(osbuusus)",
+							   tid,
+							   modified,
+							   succeeded,
+							   role,
+							   duration,
+							   data != NULL ? data : "",
+							   uid,
+							   cmdline != NULL ? cmdline : ""));
+		pk_transaction_emit_signal (transaction,
+					    PK_DBUS_INTERFACE_TRANSACTION,
+					    "TransactionResources",
+					    g_variant_new ("(ottt)",
+							   tid,
+							   pk_transaction_past_get_cpu_time (item),
+							   pk_transaction_past_get_memory_growth (item),
+							   pk_transaction_past_get_bytes_emitted (item)));
 	}
 	g_list_free_full (transactions, (GDestroyNotify) g_object_unref);
 
-	idle_id = g_idle_add ((GSourceFunc) pk_transaction_finished_idle_cb, transaction);
-	g_source_set_name_by_id (idle_id, "[PkTransaction] finished from get-old-transactions");
+	pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_SUCCESS, 0);
+}
+
+static void
+pk_transaction_get_old_transactions (PkTransaction *transaction,
+				     GVariant *params,
+				     GDBusMethodInvocation *context)
+{
+	guint number;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->priv->tid != NULL);
+
+	g_variant_get (params, "(u)",
+		       &number);
+
+	g_debug ("GetOldTransactions method called");
+
+	/* the results are emitted when the reader thread has finished */
+	pk_transaction_set_role (transaction, PK_ROLE_ENUM_GET_OLD_TRANSACTIONS);
+	pk_transaction_db_get_list_async (transaction->priv->transaction_db,
+					  number,
+					  transaction->priv->cancellable,
+					  pk_transaction_get_old_transactions_cb,
+					  g_object_ref (transaction));
 
 	pk_transaction_dbus_return (context, NULL);
 }
@@ -3558,6 +5494,27 @@ pk_transaction_is_supported_content_type (PkTransaction *transaction,
 	return FALSE;
 }
 
+static gboolean
+pk_transaction_install_files_authorize (PkTransaction *transaction,
+					PkBitfield transaction_flags,
+					gchar **full_paths,
+					GError **error)
+{
+	transaction->priv->cached_transaction_flags = transaction_flags;
+	transaction->priv->cached_full_paths = g_strdupv (full_paths);
+	pk_transaction_set_role (transaction, PK_ROLE_ENUM_INSTALL_FILES);
+
+	/* this changed */
+	pk_transaction_emit_property_changed (transaction,
+					      "TransactionFlags",
+					      g_variant_new_uint64 (transaction_flags));
+
+	/* try to get authorization */
+	return pk_transaction_obtain_authorization (transaction,
+						    PK_ROLE_ENUM_INSTALL_FILES,
+						    error);
+}
+
 static void
 pk_transaction_install_files (PkTransaction *transaction,
 			      GVariant *params,
@@ -3635,24 +5592,251 @@ pk_transaction_install_files (PkTransaction *transaction,
 	}
 
 	/* save so we can run later */
-	transaction->priv->cached_transaction_flags = transaction_flags;
-	transaction->priv->cached_full_paths = g_strdupv (full_paths);
-	pk_transaction_set_role (transaction, PK_ROLE_ENUM_INSTALL_FILES);
+	ret = pk_transaction_install_files_authorize (transaction,
+						      transaction_flags,
+						      full_paths,
+						      &error);
+	if (!ret) {
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+out:
+	pk_transaction_dbus_return (context, error);
+}
 
-	/* this changed */
-	pk_transaction_emit_property_changed (transaction,
-					      "TransactionFlags",
-					      g_variant_new_uint64 (transaction_flags));
+/* backends go by the file name, so give each copy the usual extension */
+static const gchar *
+pk_transaction_get_extension_for_content_type (const gchar *content_type)
+{
+	const struct {
+		const gchar	*content_type;
+		const gchar	*extension;
+	} map[] = {
+		{ "application/x-rpm",				".rpm" },
+		{ "application/vnd.debian.binary-package",	".deb" },
+		{ "application/x-deb",				".deb" },
+		{ "application/x-compressed-tar",		".tar.gz" },
+		{ "application/x-xz-compressed-tar",		".tar.xz" },
+		{ "application/x-bzip-compressed-tar",		".tar.bz2" },
+		{ "application/x-lzma-compressed-tar",		".tar.lzma" },
+		{ "application/x-zstd-compressed-tar",		".tar.zst" },
+		{ NULL, NULL }
+	};
 
-	/* try to get authorization */
-	ret = pk_transaction_obtain_authorization (transaction,
-						   PK_ROLE_ENUM_INSTALL_FILES,
-						   &error);
-	if (!ret) {
+	for (guint i = 0; map[i].content_type != NULL; i++) {
+		if (g_strcmp0 (map[i].content_type, content_type) == 0)
+			return map[i].extension;
+	}
+	return "";
+}
+
+typedef struct {
+	GArray		*fds;
+	GPtrArray	*extensions;
+	gchar		*directory;
+	PkBitfield	 transaction_flags;
+} PkTransactionFdCopy;
+
+static void
+pk_transaction_fd_copy_free (PkTransactionFdCopy *copy)
+{
+	for (guint i = 0; i < copy->fds->len; i++)
+		close (g_array_index (copy->fds, gint, i));
+	g_array_unref (copy->fds);
+	g_ptr_array_unref (copy->extensions);
+	g_free (copy->directory);
+	g_free (copy);
+}
+
+static void
+pk_transaction_install_files_fd_copy_thread (GTask *task,
+					     gpointer source_object,
+					     gpointer task_data,
+					     GCancellable *cancellable)
+{
+	PkTransactionFdCopy *copy = task_data;
+	g_autoptr(GPtrArray) full_paths = g_ptr_array_new_with_free_func (g_free);
+
+	for (guint i = 0; i < copy->fds->len; i++) {
+		const gchar *extension = g_ptr_array_index (copy->extensions, i);
+		g_autofree gchar *basename = g_strdup_printf ("%u%s", i, extension);
+		g_autofree gchar *filename = g_build_filename (copy->directory, basename, NULL);
+		g_autoptr(GError) error = NULL;
+		g_autoptr(GFile) file = g_file_new_for_path (filename);
+		g_autoptr(GFileOutputStream) output = NULL;
+		g_autoptr(GInputStream) input = NULL;
+
+		input = g_unix_input_stream_new (g_array_index (copy->fds, gint, i), FALSE);
+		output = g_file_create (file, G_FILE_CREATE_PRIVATE, cancellable, &error);
+		if (output == NULL ||
+		    g_output_stream_splice (G_OUTPUT_STREAM (output), input,
+					    G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+					    cancellable, &error) < 0) {
+			g_task_return_new_error (task,
+						 PK_TRANSACTION_ERROR,
+						 PK_TRANSACTION_ERROR_NO_SUCH_FILE,
+						 "Failed to copy file descriptor %u: %s",
+						 i, error->message);
+			return;
+		}
+		g_ptr_array_add (full_paths, g_steal_pointer (&filename));
+	}
+	g_ptr_array_add (full_paths, NULL);
+	g_task_return_pointer (task,
+			       g_ptr_array_free (g_steal_pointer (&full_paths), FALSE),
+			       (GDestroyNotify) g_strfreev);
+}
+
+static void
+pk_transaction_install_files_fd_copy_cb (GObject *source_object,
+					 GAsyncResult *res,
+					 gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (source_object);
+	PkTransactionFdCopy *copy = g_task_get_task_data (G_TASK (res));
+	g_autoptr(GDBusMethodInvocation) context = user_data;
+	g_autoptr(GError) error = NULL;
+	g_auto(GStrv) full_paths = NULL;
+
+	full_paths = g_task_propagate_pointer (G_TASK (res), &error);
+	if (full_paths == NULL) {
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+
+	/* save so we can run later */
+	if (!pk_transaction_install_files_authorize (transaction,
+						     copy->transaction_flags,
+						     full_paths,
+						     &error)) {
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+out:
+	pk_transaction_dbus_return (context, error);
+}
+
+static void
+pk_transaction_install_files_fd (PkTransaction *transaction,
+				 GVariant *params,
+				 GDBusMethodInvocation *context)
+{
+	gint fd;
+	gsize n_handles;
+	gssize len;
+	guint i;
+	gchar buf[4096];
+	struct stat st;
+	GUnixFDList *fd_list;
+	PkBitfield transaction_flags;
+	PkTransactionFdCopy *copy;
+	const gint32 *handles;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GArray) fds = g_array_new (FALSE, FALSE, sizeof (gint));
+	g_autoptr(GPtrArray) extensions = g_ptr_array_new ();
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(GVariant) handles_variant = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->priv->tid != NULL);
+
+	g_variant_get (params, "(t@ah)",
+		       &transaction_flags,
+		       &handles_variant);
+	handles = g_variant_get_fixed_array (handles_variant, &n_handles, sizeof (gint32));
+	g_debug ("InstallFilesFd method called: %" G_GSIZE_FORMAT " files", n_handles);
+
+	/* not implemented yet */
+	if (!pk_backend_is_implemented (transaction->priv->backend,
+					PK_ROLE_ENUM_INSTALL_FILES)) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "InstallFiles not supported by backend");
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+
+	fd_list = g_dbus_message_get_unix_fd_list (g_dbus_method_invocation_get_message (context));
+	if (fd_list == NULL || n_handles == 0) {
+		g_set_error_literal (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NO_SUCH_FILE,
+				     "no file descriptor was sent");
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+
+	for (i = 0; i < n_handles; i++) {
+		g_autofree gchar *content_type = NULL;
+
+		fd = g_unix_fd_list_get (fd_list, handles[i], &error);
+		if (fd < 0) {
+			pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+			goto out;
+		}
+		g_array_append_val (fds, fd);
+
+		if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) ||
+		    lseek (fd, 0, SEEK_SET) != 0) {
+			g_set_error (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NO_SUCH_FILE,
+				     "File descriptor %u is not a regular file", i);
+			pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+			goto out;
+		}
+
+		/* there is no name to go by, so sniff the contents */
+		len = pread (fd, buf, sizeof (buf), 0);
+		if (len > 0)
+			content_type = g_content_type_guess (NULL, (const guchar *) buf, len, NULL);
+		if (content_type == NULL ||
+		    !pk_transaction_is_supported_content_type (transaction, content_type)) {
+			g_set_error (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NO_SUCH_FILE,
+				     "File descriptor %u is unsupported", i);
+			pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+			goto out;
+		}
+		g_ptr_array_add (extensions,
+				 (gpointer) pk_transaction_get_extension_for_content_type (content_type));
+	}
+
+	/* the caller can change or truncate the file behind the fd at any
+	 * time, so the backend only ever sees a copy the daemon owns */
+	transaction->priv->cached_file_dir = g_build_filename (LOCALSTATEDIR, "cache", "PackageKit",
+							       "downloads", "fd-XXXXXX", NULL);
+	if (g_mkdir_with_parents (LOCALSTATEDIR "/cache/PackageKit/downloads", 0755) != 0 ||
+	    g_mkdtemp_full (transaction->priv->cached_file_dir, 0700) == NULL) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NO_SUCH_FILE,
+			     "Failed to create %s: %s",
+			     transaction->priv->cached_file_dir, g_strerror (errno));
+		g_clear_pointer (&transaction->priv->cached_file_dir, g_free);
 		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
 		goto out;
 	}
+
+	/* copy off the main loop, the files can be large */
+	copy = g_new0 (PkTransactionFdCopy, 1);
+	copy->fds = g_steal_pointer (&fds);
+	copy->extensions = g_steal_pointer (&extensions);
+	copy->directory = g_strdup (transaction->priv->cached_file_dir);
+	copy->transaction_flags = transaction_flags;
+	task = g_task_new (transaction, NULL,
+			   pk_transaction_install_files_fd_copy_cb,
+			   g_object_ref (context));
+	g_task_set_task_data (task, copy, (GDestroyNotify) pk_transaction_fd_copy_free);
+	g_task_run_in_thread (task, pk_transaction_install_files_fd_copy_thread);
+	return;
 out:
+	if (fds != NULL) {
+		for (i = 0; i < fds->len; i++)
+			close (g_array_index (fds, gint, i));
+	}
 	pk_transaction_dbus_return (context, error);
 }
 
@@ -4121,6 +6305,16 @@ pk_transaction_resolve (PkTransaction *transaction,
 
 	/* check for length sanity */
 	length = g_strv_length (packages);
+	if (length == 0 && pk_transaction_has_input (transaction)) {
+		if (!pk_transaction_input_start (transaction, PK_ROLE_ENUM_RESOLVE, &error)) {
+			pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+			goto out;
+		}
+		transaction->priv->cached_filters = filter;
+		pk_transaction_set_role (transaction, PK_ROLE_ENUM_RESOLVE);
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_READY);
+		goto out;
+	}
 	if (length == 0) {
 		g_set_error (&error,
 			     PK_TRANSACTION_ERROR,
@@ -4133,7 +6327,7 @@ pk_transaction_resolve (PkTransaction *transaction,
 		g_set_error (&error,
 			     PK_TRANSACTION_ERROR,
 			     PK_TRANSACTION_ERROR_INPUT_INVALID,
-			     "Too many items to process (%i/%i)",
+			     "Too many items to process (%i/%i), use AppendInput or SetInputFd",
 			     length, PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE);
 		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
 		goto out;
@@ -4371,7 +6565,65 @@ out:
 	pk_transaction_dbus_return (context, error);
 }
 
+/**
+ * pk_transaction_check_root:
+ *
+ * Another root can only be used if it is one of AllowedRoots or below one,
+ * given without symlinks or "..", and if the backend can share its
+ * repository metadata with it.
+ **/
 static gboolean
+pk_transaction_check_root (PkTransaction *transaction, const gchar *root, GError **error)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	g_autofree gchar *resolved = NULL;
+	g_auto(GStrv) allowed = NULL;
+
+	if (priv->backend == NULL || !pk_backend_supports_roots (priv->backend)) {
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "the backend cannot use another root");
+		return FALSE;
+	}
+	if (root == NULL || root[0] != '/') {
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "root has to be an absolute path");
+		return FALSE;
+	}
+	resolved = realpath (root, NULL);
+	if (resolved == NULL || g_strcmp0 (resolved, root) != 0 ||
+	    !g_file_test (resolved, G_FILE_TEST_IS_DIR)) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "root %s is not a directory given by its real path", root);
+		return FALSE;
+	}
+
+	allowed = g_key_file_get_string_list (priv->conf, "Daemon", "AllowedRoots", NULL, NULL);
+	for (guint i = 0; allowed != NULL && allowed[i] != NULL; i++) {
+		gsize len = strlen (allowed[i]);
+
+		/* the same directory or something below it */
+		while (len > 1 && allowed[i][len - 1] == '/')
+			allowed[i][--len] = '\0';
+		if (len <= 1 || allowed[i][0] != '/')
+			continue;
+		if (strncmp (resolved, allowed[i], len) == 0 &&
+		    (resolved[len] == '\0' || resolved[len] == '/'))
+			return TRUE;
+	}
+	g_set_error (error,
+		     PK_TRANSACTION_ERROR,
+		     PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
+		     "root %s is not allowed by AllowedRoots", root);
+	return FALSE;
+}
+
+gboolean
 pk_transaction_set_hint (PkTransaction *transaction,
 			 const gchar *key,
 			 const gchar *value,
@@ -4385,6 +6637,50 @@ pk_transaction_set_hint (PkTransaction *transaction,
 		return TRUE;
 	}
 
+	/* root=/var/lib/image-builder/rootfs */
+	if (g_strcmp0 (key, "root") == 0) {
+		if (!pk_transaction_check_root (transaction, value, error))
+			return FALSE;
+		pk_backend_job_set_root (priv->job, value);
+		return TRUE;
+	}
+
+	/* deadline-ms=500 */
+	if (g_strcmp0 (key, "deadline-ms") == 0) {
+		guint deadline_ms;
+
+		if (!pk_strtouint (value, &deadline_ms) ||
+		    deadline_ms == 0 || deadline_ms > PK_TRANSACTION_DEADLINE_MAX) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "deadline-ms has to be between 1 and %u, not %s",
+				     (guint) PK_TRANSACTION_DEADLINE_MAX, value);
+			return FALSE;
+		}
+		pk_backend_job_set_deadline (priv->job,
+					     g_get_monotonic_time () +
+					     (gint64) deadline_ms * 1000);
+		return TRUE;
+	}
+
+	/* fields=summary;license, or nothing for just the package IDs */
+	if (g_strcmp0 (key, "fields") == 0) {
+		g_auto(GStrv) fields = NULL;
+		g_autoptr(GPtrArray) array = g_ptr_array_new ();
+
+		/* unknown fields are ignored, for newer clients */
+		fields = g_strsplit (value != NULL ? value : "", ";", -1);
+		for (guint i = 0; fields[i] != NULL; i++) {
+			if (fields[i][0] != '\0')
+				g_ptr_array_add (array, fields[i]);
+		}
+		g_ptr_array_add (array, NULL);
+		pk_backend_job_set_fields (priv->job, (gchar **) array->pdata);
+		priv->projected = TRUE;
+		return TRUE;
+	}
+
 	/* frontend_socket=/tmp/socket.3456 */
 	if (g_strcmp0 (key, "frontend-socket") == 0) {
 
@@ -4470,6 +6766,135 @@ pk_transaction_set_hint (PkTransaction *transaction,
 			return FALSE;
 		}
 		pk_backend_job_set_cache_age (priv->job, cache_age);
+		priv->cache_age_set = TRUE;
+		return TRUE;
+	}
+
+	/* batch-size=<number-of-packages> */
+	if (g_strcmp0 (key, "batch-size") == 0) {
+		guint batch_size;
+		if (!pk_strtouint (value, &batch_size)) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "cannot parse batch size value %s", value);
+			return FALSE;
+		}
+		if (batch_size > PK_TRANSACTION_MAX_PACKAGES_BATCH_SIZE) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "batch size %u is larger than %u",
+				     batch_size,
+				     PK_TRANSACTION_MAX_PACKAGES_BATCH_SIZE);
+			return FALSE;
+		}
+
+		/* the queue has to go out in the old mode */
+		if (batch_size != priv->packages_batch_size)
+			pk_transaction_packages_flush (transaction);
+		priv->packages_batch_size = batch_size;
+		return TRUE;
+	}
+
+	/* items-progress=true */
+	if (g_strcmp0 (key, "items-progress") == 0) {
+		if (g_strcmp0 (value, "true") == 0) {
+			priv->items_progress_requested = TRUE;
+		} else if (g_strcmp0 (value, "false") == 0) {
+			pk_transaction_items_progress_flush (transaction);
+			priv->items_progress_requested = FALSE;
+		} else {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				      "items-progress hint expects true or false, not %s", value);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	/* results-fd=true */
+	if (g_strcmp0 (key, "results-fd") == 0) {
+		if (g_strcmp0 (value, "true") == 0) {
+#ifdef HAVE_MEMFD_CREATE
+			priv->results_fd_requested = TRUE;
+#else
+			g_debug ("no memfd support, ignoring results-fd");
+#endif
+		} else if (g_strcmp0 (value, "false") == 0) {
+			priv->results_fd_requested = FALSE;
+		} else {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				      "results-fd hint expects true or false, not %s", value);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	/* coalesce=true */
+	if (g_strcmp0 (key, "coalesce") == 0) {
+		if (g_strcmp0 (value, "true") == 0) {
+			priv->coalesce = TRUE;
+		} else if (g_strcmp0 (value, "false") == 0) {
+			priv->coalesce = FALSE;
+		} else {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				      "coalesce hint expects true or false, not %s", value);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	/* plan=token */
+	if (g_strcmp0 (key, "plan") == 0) {
+		g_free (priv->plan_hint);
+		priv->plan_hint = g_strdup (value);
+		return TRUE;
+	}
+
+	/* limit=<number-of-packages> */
+	if (g_strcmp0 (key, "limit") == 0) {
+		if (!pk_strtouint (value, &priv->limit)) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "cannot parse limit value %s", value);
+			return FALSE;
+		}
+		pk_backend_job_set_page (priv->job, priv->limit, priv->offset);
+		return TRUE;
+	}
+
+	/* search-session=token, from CreateSearchSession */
+	if (g_strcmp0 (key, "search-session") == 0) {
+		if (priv->search_sessions == NULL ||
+		    !pk_search_sessions_has (priv->search_sessions, value, priv->sender)) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "unknown search session %s", value);
+			return FALSE;
+		}
+		g_free (priv->search_session);
+		priv->search_session = g_strdup (value);
+		return TRUE;
+	}
+
+	/* cursor=token, as set in the Cursor of the previous page */
+	if (g_strcmp0 (key, "cursor") == 0) {
+		if (!pk_strtouint (value, &priv->offset)) {
+			g_set_error (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+				     "cannot parse cursor %s", value);
+			return FALSE;
+		}
+		pk_backend_job_set_page (priv->job, priv->limit, priv->offset);
 		return TRUE;
 	}
 
@@ -4516,6 +6941,12 @@ pk_transaction_set_hints (PkTransaction *transaction,
 		}
 	}
 out:
+	/* the hints already set may leave the transaction half-configured,
+	 * e.g. with a root but without the plan, so never run it like that */
+	if (error != NULL) {
+		transaction->priv->hints_error = g_error_copy (error);
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+	}
 	pk_transaction_dbus_return (context, error);
 }
 
@@ -4678,114 +7109,416 @@ pk_transaction_upgrade_system (PkTransaction *transaction,
 	transaction->priv->cached_upgrade_kind = upgrade_kind;
 	pk_transaction_set_role (transaction, PK_ROLE_ENUM_UPGRADE_SYSTEM);
 
-	/* this changed */
-	pk_transaction_emit_property_changed (transaction,
-					      "TransactionFlags",
-					      g_variant_new_uint64 (transaction_flags));
+	/* this changed */
+	pk_transaction_emit_property_changed (transaction,
+					      "TransactionFlags",
+					      g_variant_new_uint64 (transaction_flags));
+
+	/* try to get authorization */
+	ret = pk_transaction_obtain_authorization (transaction,
+						   PK_ROLE_ENUM_UPGRADE_SYSTEM,
+						   &error);
+	if (!ret) {
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+out:
+	pk_transaction_dbus_return (context, error);
+}
+
+static void
+pk_transaction_repair_system (PkTransaction *transaction,
+			      GVariant *params,
+			      GDBusMethodInvocation *context)
+{
+	gboolean ret;
+	PkBitfield transaction_flags;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *transaction_flags_temp = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (transaction->priv->tid != NULL);
+
+	g_variant_get (params, "(t)", &transaction_flags);
+
+	transaction_flags_temp = pk_transaction_flag_bitfield_to_string (transaction_flags);
+	g_debug ("RepairSystem method called  (transaction_flags: %s)",
+		 transaction_flags_temp);
+
+	/* not implemented yet */
+	if (!pk_backend_is_implemented (transaction->priv->backend,
+					PK_ROLE_ENUM_REPAIR_SYSTEM)) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
+			     "RepairSystem not supported by backend");
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+
+	/* save so we can run later */
+	transaction->priv->cached_transaction_flags = transaction_flags;
+	pk_transaction_set_role (transaction, PK_ROLE_ENUM_REPAIR_SYSTEM);
+
+	/* this changed */
+	pk_transaction_emit_property_changed (transaction,
+					      "TransactionFlags",
+					      g_variant_new_uint64 (transaction_flags));
+
+	/* try to get authorization */
+	ret = pk_transaction_obtain_authorization (transaction,
+						   PK_ROLE_ENUM_REPAIR_SYSTEM,
+						   &error);
+	if (!ret) {
+		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
+		goto out;
+	}
+out:
+	pk_transaction_dbus_return (context, error);
+}
+
+static GVariant *
+_g_variant_new_maybe_string (const gchar *value)
+{
+	if (value == NULL)
+		return g_variant_new_string ("");
+	return g_variant_new_string (value);
+}
+
+static GVariant *
+pk_transaction_get_property (GDBusConnection *connection_, const gchar *sender,
+			     const gchar *object_path, const gchar *interface_name,
+			     const gchar *property_name, GError **error,
+			     gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (user_data);
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (g_strcmp0 (property_name, "Role") == 0)
+		return g_variant_new_uint32 (priv->role);
+	if (g_strcmp0 (property_name, "Status") == 0)
+		return g_variant_new_uint32 (priv->status);
+	if (g_strcmp0 (property_name, "LastPackage") == 0)
+		return _g_variant_new_maybe_string (priv->last_package_id);
+	if (g_strcmp0 (property_name, "Uid") == 0)
+		return g_variant_new_uint32 (priv->uid);
+	if (g_strcmp0 (property_name, "Percentage") == 0)
+		return g_variant_new_uint32 (transaction->priv->percentage);
+	if (g_strcmp0 (property_name, "AllowCancel") == 0)
+		return g_variant_new_boolean (priv->allow_cancel);
+	if (g_strcmp0 (property_name, "CallerActive") == 0)
+		return g_variant_new_boolean (priv->caller_active);
+	if (g_strcmp0 (property_name, "ElapsedTime") == 0)
+		return g_variant_new_uint32 (priv->elapsed_time);
+	if (g_strcmp0 (property_name, "Speed") == 0)
+		return g_variant_new_uint32 (priv->speed);
+	if (g_strcmp0 (property_name, "DownloadSizeRemaining") == 0)
+		return g_variant_new_uint64 (priv->download_size_remaining);
+	if (g_strcmp0 (property_name, "DownloadBytesDone") == 0)
+		return g_variant_new_uint64 (priv->download_bytes_done);
+	if (g_strcmp0 (property_name, "DownloadBytesTotal") == 0)
+		return g_variant_new_uint64 (priv->download_bytes_total);
+	if (g_strcmp0 (property_name, "TransactionFlags") == 0)
+		return g_variant_new_uint64 (priv->cached_transaction_flags);
+	if (g_strcmp0 (property_name, "Plan") == 0)
+		return _g_variant_new_maybe_string (priv->plan);
+	if (g_strcmp0 (property_name, "Cursor") == 0)
+		return _g_variant_new_maybe_string (priv->cursor);
+	if (g_strcmp0 (property_name, "Partial") == 0)
+		return g_variant_new_boolean (priv->partial);
+	if (g_strcmp0 (property_name, "CpuTime") == 0)
+		return g_variant_new_uint64 (priv->cpu_time);
+	if (g_strcmp0 (property_name, "MemoryGrowth") == 0)
+		return g_variant_new_uint64 (priv->memory_growth);
+	if (g_strcmp0 (property_name, "BytesEmitted") == 0)
+		return g_variant_new_uint64 (priv->bytes_emitted);
+	return NULL;
+}
+
+static gboolean
+pk_transaction_input_check_state (PkTransaction *transaction, GError **error)
+{
+	if (transaction->priv->role != PK_ROLE_ENUM_UNKNOWN) {
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INVALID_STATE,
+				     "input has to be given before the method is called");
+		return FALSE;
+	}
+	if (transaction->priv->input_reading) {
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INVALID_STATE,
+				     "input has already been set from a file descriptor");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+pk_transaction_append_input (PkTransaction *transaction,
+			     GVariant *params,
+			     GDBusMethodInvocation *context)
+{
+	guint i;
+	guint length;
+	g_autofree gchar **items = NULL;
+	g_autoptr(GError) error = NULL;
+
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+
+	g_variant_get (params, "(^a&s)", &items);
+
+	if (!pk_transaction_input_check_state (transaction, &error)) {
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+	length = g_strv_length (items);
+	if (length > PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Too many items in one part (%u/%i)",
+			     length, PK_TRANSACTION_MAX_ITEMS_TO_RESOLVE);
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+
+	if (transaction->priv->input_size + length > PK_TRANSACTION_MAX_INPUT_ITEMS) {
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Too many items in total (%" G_GUINT64_FORMAT "/%i)",
+			     transaction->priv->input_size + length,
+			     PK_TRANSACTION_MAX_INPUT_ITEMS);
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+
+	/* checked as the chunks are taken */
+	if (transaction->priv->input_items == NULL)
+		transaction->priv->input_items = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < length; i++)
+		g_ptr_array_add (transaction->priv->input_items, g_strdup (items[i]));
+	transaction->priv->input_size = transaction->priv->input_items->len;
+	g_debug ("AppendInput method called: %u items, %u staged",
+		 length, transaction->priv->input_items->len);
+
+	pk_transaction_dbus_return (context, NULL);
+}
+
+static gboolean
+pk_transaction_input_add_line (GPtrArray *items, GString *line, GError **error)
+{
+	if (!g_utf8_validate (line->str, line->len, NULL)) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Item %u is not valid UTF-8", items->len + 1);
+		return FALSE;
+	}
+	if (items->len >= PK_TRANSACTION_MAX_INPUT_ITEMS) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "Too many items in total (>%i)",
+			     PK_TRANSACTION_MAX_INPUT_ITEMS);
+		return FALSE;
+	}
+	g_ptr_array_add (items, g_strndup (line->str, line->len));
+	g_string_truncate (line, 0);
+	return TRUE;
+}
+
+/* only the limits are checked here, the items are checked for the role
+ * as the chunks are taken */
+static void
+pk_transaction_set_input_fd_thread (GTask *task,
+				    gpointer source_object,
+				    gpointer task_data,
+				    GCancellable *cancellable)
+{
+	GInputStream *stream = G_INPUT_STREAM (task_data);
+	gchar buf[4096];
+	gssize len;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) items = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GString) line = g_string_sized_new (PK_TRANSACTION_MAX_INPUT_LINE);
+
+	while ((len = g_input_stream_read (stream, buf, sizeof (buf),
+					   cancellable, &error)) > 0) {
+		for (gssize i = 0; i < len; i++) {
+			if (buf[i] == '\n') {
+				if (!pk_transaction_input_add_line (items, line, &error)) {
+					g_task_return_error (task, g_steal_pointer (&error));
+					return;
+				}
+				continue;
+			}
+			if (line->len >= PK_TRANSACTION_MAX_INPUT_LINE) {
+				g_task_return_new_error (task,
+							 PK_TRANSACTION_ERROR,
+							 PK_TRANSACTION_ERROR_INPUT_INVALID,
+							 "Item %u is longer than %i bytes",
+							 items->len + 1,
+							 PK_TRANSACTION_MAX_INPUT_LINE);
+				return;
+			}
+			g_string_append_c (line, buf[i]);
+		}
+	}
+	if (len < 0) {
+		g_task_return_new_error (task,
+					 PK_TRANSACTION_ERROR,
+					 PK_TRANSACTION_ERROR_INPUT_INVALID,
+					 "failed to read input: %s",
+					 error->message);
+		return;
+	}
+
+	/* the last line does not need a newline */
+	if (line->len > 0 && !pk_transaction_input_add_line (items, line, &error)) {
+		g_task_return_error (task, g_steal_pointer (&error));
+		return;
+	}
+	g_task_return_pointer (task,
+			       g_steal_pointer (&items),
+			       (GDestroyNotify) g_ptr_array_unref);
+}
 
-	/* try to get authorization */
-	ret = pk_transaction_obtain_authorization (transaction,
-						   PK_ROLE_ENUM_UPGRADE_SYSTEM,
-						   &error);
-	if (!ret) {
-		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
-		goto out;
+static void
+pk_transaction_set_input_fd_cb (GObject *source_object,
+				GAsyncResult *res,
+				gpointer user_data)
+{
+	PkTransaction *transaction = PK_TRANSACTION (source_object);
+	g_autoptr(GDBusMethodInvocation) context = user_data;
+	g_autoptr(GError) error = NULL;
+	GPtrArray *items;
+
+	transaction->priv->input_reading = FALSE;
+	items = g_task_propagate_pointer (G_TASK (res), &error);
+	if (items == NULL) {
+		pk_transaction_dbus_return (context, error);
+		return;
 	}
-out:
-	pk_transaction_dbus_return (context, error);
+	transaction->priv->input_items = items;
+	transaction->priv->input_size = items->len;
+	g_debug ("SetInputFd read %u items", items->len);
+	pk_transaction_dbus_return (context, NULL);
 }
 
 static void
-pk_transaction_repair_system (PkTransaction *transaction,
-			      GVariant *params,
-			      GDBusMethodInvocation *context)
+pk_transaction_set_input_fd (PkTransaction *transaction,
+			     GVariant *params,
+			     GDBusMethodInvocation *context)
 {
-	gboolean ret;
-	PkBitfield transaction_flags;
+	gint fd;
+	gint32 idx;
+	struct stat st;
+	GUnixFDList *fd_list;
 	g_autoptr(GError) error = NULL;
-	g_autofree gchar *transaction_flags_temp = NULL;
+	g_autoptr(GInputStream) stream = NULL;
+	g_autoptr(GTask) task = NULL;
 
 	g_return_if_fail (PK_IS_TRANSACTION (transaction));
-	g_return_if_fail (transaction->priv->tid != NULL);
-
-	g_variant_get (params, "(t)", &transaction_flags);
 
-	transaction_flags_temp = pk_transaction_flag_bitfield_to_string (transaction_flags);
-	g_debug ("RepairSystem method called  (transaction_flags: %s)",
-		 transaction_flags_temp);
+	g_variant_get (params, "(h)", &idx);
 
-	/* not implemented yet */
-	if (!pk_backend_is_implemented (transaction->priv->backend,
-					PK_ROLE_ENUM_REPAIR_SYSTEM)) {
-		g_set_error (&error,
-			     PK_TRANSACTION_ERROR,
-			     PK_TRANSACTION_ERROR_NOT_SUPPORTED,
-			     "RepairSystem not supported by backend");
-		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
-		goto out;
+	if (!pk_transaction_input_check_state (transaction, &error)) {
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+	if (transaction->priv->input_items != NULL) {
+		g_set_error_literal (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INVALID_STATE,
+				     "input has already been appended");
+		pk_transaction_dbus_return (context, error);
+		return;
 	}
 
-	/* save so we can run later */
-	transaction->priv->cached_transaction_flags = transaction_flags;
-	pk_transaction_set_role (transaction, PK_ROLE_ENUM_REPAIR_SYSTEM);
-
-	/* this changed */
-	pk_transaction_emit_property_changed (transaction,
-					      "TransactionFlags",
-					      g_variant_new_uint64 (transaction_flags));
+	fd_list = g_dbus_message_get_unix_fd_list (g_dbus_method_invocation_get_message (context));
+	if (fd_list == NULL) {
+		g_set_error_literal (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INPUT_INVALID,
+				     "no file descriptor was sent");
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+	fd = g_unix_fd_list_get (fd_list, idx, &error);
+	if (fd < 0) {
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
 
-	/* try to get authorization */
-	ret = pk_transaction_obtain_authorization (transaction,
-						   PK_ROLE_ENUM_REPAIR_SYSTEM,
-						   &error);
-	if (!ret) {
-		pk_transaction_set_state (transaction, PK_TRANSACTION_STATE_ERROR);
-		goto out;
+	/* a pipe could be held open for ever, a memfd always ends */
+	if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+		close (fd);
+		g_set_error_literal (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INPUT_INVALID,
+				     "the input has to be a memfd or a regular file");
+		pk_transaction_dbus_return (context, error);
+		return;
 	}
-out:
-	pk_transaction_dbus_return (context, error);
+	if (lseek (fd, 0, SEEK_SET) != 0) {
+		close (fd);
+		g_set_error (&error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INPUT_INVALID,
+			     "failed to rewind the input: %s",
+			     g_strerror (errno));
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+	g_debug ("SetInputFd method called: %" G_GUINT64_FORMAT " bytes",
+		 (guint64) st.st_size);
+
+	/* the file can still be slow to read, so keep it off the main loop;
+	 * the method returns once all of it has been staged */
+	stream = g_unix_input_stream_new (fd, TRUE);
+	transaction->priv->input_reading = TRUE;
+	task = g_task_new (transaction, NULL,
+			   pk_transaction_set_input_fd_cb,
+			   g_object_ref (context));
+	g_task_set_task_data (task, g_steal_pointer (&stream), g_object_unref);
+	g_task_run_in_thread (task, pk_transaction_set_input_fd_thread);
 }
 
-static GVariant *
-_g_variant_new_maybe_string (const gchar *value)
+static void
+pk_transaction_get_results_fd (PkTransaction *transaction,
+			       GVariant *params,
+			       GDBusMethodInvocation *context)
 {
-	if (value == NULL)
-		return g_variant_new_string ("");
-	return g_variant_new_string (value);
-}
+	gint idx;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GUnixFDList) fd_list = NULL;
 
-static GVariant *
-pk_transaction_get_property (GDBusConnection *connection_, const gchar *sender,
-			     const gchar *object_path, const gchar *interface_name,
-			     const gchar *property_name, GError **error,
-			     gpointer user_data)
-{
-	PkTransaction *transaction = PK_TRANSACTION (user_data);
-	PkTransactionPrivate *priv = transaction->priv;
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
 
-	if (g_strcmp0 (property_name, "Role") == 0)
-		return g_variant_new_uint32 (priv->role);
-	if (g_strcmp0 (property_name, "Status") == 0)
-		return g_variant_new_uint32 (priv->status);
-	if (g_strcmp0 (property_name, "LastPackage") == 0)
-		return _g_variant_new_maybe_string (priv->last_package_id);
-	if (g_strcmp0 (property_name, "Uid") == 0)
-		return g_variant_new_uint32 (priv->uid);
-	if (g_strcmp0 (property_name, "Percentage") == 0)
-		return g_variant_new_uint32 (transaction->priv->percentage);
-	if (g_strcmp0 (property_name, "AllowCancel") == 0)
-		return g_variant_new_boolean (priv->allow_cancel);
-	if (g_strcmp0 (property_name, "CallerActive") == 0)
-		return g_variant_new_boolean (priv->caller_active);
-	if (g_strcmp0 (property_name, "ElapsedTime") == 0)
-		return g_variant_new_uint32 (priv->elapsed_time);
-	if (g_strcmp0 (property_name, "Speed") == 0)
-		return g_variant_new_uint32 (priv->speed);
-	if (g_strcmp0 (property_name, "DownloadSizeRemaining") == 0)
-		return g_variant_new_uint64 (priv->download_size_remaining);
-	if (g_strcmp0 (property_name, "TransactionFlags") == 0)
-		return g_variant_new_uint64 (priv->cached_transaction_flags);
-	return NULL;
+	if (transaction->priv->results_fd < 0) {
+		g_set_error_literal (&error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_INVALID_STATE,
+				     "no results were sent as a file descriptor");
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+
+	/* the list has its own copy */
+	fd_list = g_unix_fd_list_new ();
+	idx = g_unix_fd_list_append (fd_list, transaction->priv->results_fd, &error);
+	if (idx < 0) {
+		pk_transaction_dbus_return (context, error);
+		return;
+	}
+	g_dbus_method_invocation_return_value_with_unix_fd_list (context,
+								 g_variant_new ("(hs)",
+										idx,
+										PK_TRANSACTION_RESULTS_FD_FORMAT),
+								 fd_list);
 }
 
 static void
@@ -4798,8 +7531,10 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 
 	g_return_if_fail (transaction->priv->sender != NULL);
 
-	/* check is the same as the sender that did CreateTransaction */
-	if (g_strcmp0 (transaction->priv->sender, sender) != 0) {
+	/* check is the same as the sender that did CreateTransaction, or
+	 * the private connection that process attached */
+	if (connection_ != transaction->priv->peer_connection &&
+	    g_strcmp0 (transaction->priv->sender, sender) != 0) {
 		g_dbus_method_invocation_return_error (invocation,
 						       PK_TRANSACTION_ERROR,
 						       PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
@@ -4808,6 +7543,12 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 						       transaction->priv->sender);
 		return;
 	}
+	if (transaction->priv->hints_error != NULL &&
+	    g_strcmp0 (method_name, "Cancel") != 0) {
+		g_dbus_method_invocation_return_gerror (invocation,
+							transaction->priv->hints_error);
+		return;
+	}
 	if (g_strcmp0 (method_name, "SetHints") == 0) {
 		pk_transaction_set_hints (transaction, parameters, invocation);
 		return;
@@ -4816,6 +7557,18 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 		pk_transaction_accept_eula (transaction, parameters, invocation);
 		return;
 	}
+	if (g_strcmp0 (method_name, "GetResultsFd") == 0) {
+		pk_transaction_get_results_fd (transaction, parameters, invocation);
+		return;
+	}
+	if (g_strcmp0 (method_name, "AppendInput") == 0) {
+		pk_transaction_append_input (transaction, parameters, invocation);
+		return;
+	}
+	if (g_strcmp0 (method_name, "SetInputFd") == 0) {
+		pk_transaction_set_input_fd (transaction, parameters, invocation);
+		return;
+	}
 	if (g_strcmp0 (method_name, "Cancel") == 0) {
 		pk_transaction_cancel (transaction, parameters, invocation);
 		return;
@@ -4880,6 +7633,10 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 		pk_transaction_install_files (transaction, parameters, invocation);
 		return;
 	}
+	if (g_strcmp0 (method_name, "InstallFilesFd") == 0) {
+		pk_transaction_install_files_fd (transaction, parameters, invocation);
+		return;
+	}
 	if (g_strcmp0 (method_name, "InstallPackages") == 0) {
 		pk_transaction_install_packages (transaction, parameters, invocation);
 		return;
@@ -4953,33 +7710,134 @@ pk_transaction_method_call (GDBusConnection *connection_, const gchar *sender,
 					       sender);
 }
 
+static const GDBusInterfaceVTable pk_transaction_interface_vtable = {
+	.method_call = pk_transaction_method_call,
+	.get_property = pk_transaction_get_property,
+	.set_property = NULL
+};
+
+/**
+ * pk_transaction_get_interface_vtable:
+ *
+ * The handlers for org.freedesktop.PackageKit.Transaction, with the
+ * #PkTransaction as the user data. The transaction objects on the system
+ * bus are all served from the one subtree in #PkScheduler.
+ **/
+const GDBusInterfaceVTable *
+pk_transaction_get_interface_vtable (void)
+{
+	return &pk_transaction_interface_vtable;
+}
+
 gboolean
 pk_transaction_set_tid (PkTransaction *transaction, const gchar *tid)
 {
-	static const GDBusInterfaceVTable interface_vtable = {
-		.method_call = pk_transaction_method_call,
-		.get_property = pk_transaction_get_property,
-		.set_property = NULL
-	};
-
 	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
 	g_return_val_if_fail (tid != NULL, FALSE);
 	g_return_val_if_fail (transaction->priv->tid == NULL, FALSE);
 
 	transaction->priv->tid = g_strdup (tid);
+	PK_TRACE1 (transaction__create, transaction->priv->tid);
 
-	/* register org.freedesktop.PackageKit.Transaction */
+	/* the object itself is dispatched by the PkScheduler subtree */
 	transaction->priv->connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
 	g_assert (transaction->priv->connection != NULL);
-	transaction->priv->registration_id =
-		g_dbus_connection_register_object (transaction->priv->connection,
-						   tid,
-						   transaction->priv->introspection->interfaces[0],
-						   &interface_vtable,
+	return TRUE;
+}
+
+static void
+pk_transaction_peer_detach (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+
+	if (priv->peer_connection == NULL)
+		return;
+	g_dbus_connection_unregister_object (priv->peer_connection,
+					     priv->peer_registration_id);
+	g_signal_handler_disconnect (priv->peer_connection, priv->peer_closed_id);
+	priv->peer_registration_id = 0;
+	priv->peer_closed_id = 0;
+	g_clear_object (&priv->peer_connection);
+}
+
+static void
+pk_transaction_peer_closed_cb (GDBusConnection *connection,
+			       gboolean remote_peer_vanished,
+			       GError *error,
+			       PkTransaction *transaction)
+{
+	/* the client may still be listening on the system bus */
+	g_debug ("private connection of %s closed", transaction->priv->tid);
+	pk_transaction_peer_detach (transaction);
+}
+
+/**
+ * pk_transaction_attach_peer:
+ * @connection: a private connection accepted by #PkPeerBus
+ *
+ * Exports the transaction on @connection and emits all its signals there
+ * from now on. The peer has to be the process that created the
+ * transaction, which is checked against the credentials the connection
+ * was authenticated with.
+ **/
+gboolean
+pk_transaction_attach_peer (PkTransaction *transaction,
+			    GDBusConnection *connection,
+			    GError **error)
+{
+	PkTransactionPrivate *priv = transaction->priv;
+	GCredentials *credentials;
+	pid_t pid;
+	uid_t uid;
+
+	g_return_val_if_fail (PK_IS_TRANSACTION (transaction), FALSE);
+	g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+
+	if (priv->peer_connection != NULL || priv->state != PK_TRANSACTION_STATE_NEW) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_INVALID_STATE,
+			     "transaction %s can no longer be attached", priv->tid);
+		return FALSE;
+	}
+	credentials = g_dbus_connection_get_peer_credentials (connection);
+	if (credentials == NULL) {
+		g_set_error_literal (error,
+				     PK_TRANSACTION_ERROR,
+				     PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
+				     "no credentials for the connection");
+		return FALSE;
+	}
+	uid = g_credentials_get_unix_user (credentials, error);
+	if (uid == (uid_t) -1)
+		return FALSE;
+	pid = g_credentials_get_unix_pid (credentials, error);
+	if (pid == -1)
+		return FALSE;
+	if (uid != priv->uid ||
+	    (guint) pid != pk_dbus_get_pid (priv->dbus, priv->sender)) {
+		g_set_error (error,
+			     PK_TRANSACTION_ERROR,
+			     PK_TRANSACTION_ERROR_REFUSED_BY_POLICY,
+			     "peer %i is not the creator of %s", (gint) pid, priv->tid);
+		return FALSE;
+	}
+
+	priv->peer_registration_id =
+		g_dbus_connection_register_object (connection,
+						   priv->tid,
+						   priv->introspection->interfaces[0],
+						   &pk_transaction_interface_vtable,
 						   transaction,  /* user_data */
 						   NULL,  /* user_data_free_func */
-						   NULL); /* GError** */
-	g_assert (transaction->priv->registration_id > 0);
+						   error);
+	if (priv->peer_registration_id == 0)
+		return FALSE;
+	priv->peer_connection = g_object_ref (connection);
+	priv->peer_closed_id = g_signal_connect (connection, "closed",
+						 G_CALLBACK (pk_transaction_peer_closed_cb),
+						 transaction);
+	g_debug ("attached %s to a private connection of pid %i", priv->tid, (gint) pid);
 	return TRUE;
 }
 
@@ -5001,6 +7859,71 @@ pk_transaction_reset_after_lock_error (PkTransaction *transaction)
 	g_debug ("transaction has been reset after lock-required issue.");
 }
 
+/**
+ * pk_transaction_reset_after_coalesce:
+ *
+ * Makes a failed merged transaction ready to run again with only its own
+ * packages, and without merging anything this time. Like a preempted
+ * transaction the scheduler queues it itself.
+ **/
+void
+pk_transaction_reset_after_coalesce (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = PK_TRANSACTION_GET_PRIVATE (transaction);
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (priv->coalesce_failed);
+
+	priv->coalesce = FALSE;
+	priv->coalesce_failed = FALSE;
+	g_strfreev (priv->cached_package_ids);
+	priv->cached_package_ids = g_steal_pointer (&priv->own_package_ids);
+	g_clear_pointer (&priv->coalesced_names, g_hash_table_unref);
+	g_clear_object (&priv->coalesced_results);
+
+	g_object_unref (priv->results);
+	priv->results = pk_results_new ();
+	pk_backend_job_reset_preempted (priv->job);
+	priv->state = PK_TRANSACTION_STATE_READY;
+	pk_transaction_status_changed_emit (transaction, PK_STATUS_ENUM_WAIT);
+
+	g_debug ("%s will be run on its own", priv->tid);
+}
+
+/**
+ * pk_transaction_set_coalesce:
+ *
+ * Stops a transaction from being merged, e.g. when it is run on its own
+ * after the merged transaction it was in failed.
+ **/
+void
+pk_transaction_set_coalesce (PkTransaction *transaction, gboolean coalesce)
+{
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	transaction->priv->coalesce = coalesce;
+}
+
+/**
+ * pk_transaction_reset_after_preempt:
+ *
+ * Makes a preempted transaction ready to run again. The state is changed
+ * without telling the scheduler, which queues it itself so that whatever
+ * was waiting for the backend goes first.
+ **/
+void
+pk_transaction_reset_after_preempt (PkTransaction *transaction)
+{
+	PkTransactionPrivate *priv = PK_TRANSACTION_GET_PRIVATE (transaction);
+	g_return_if_fail (PK_IS_TRANSACTION (transaction));
+	g_return_if_fail (priv->preempted);
+
+	priv->preempted = FALSE;
+	pk_backend_job_reset_preempted (priv->job);
+	priv->state = PK_TRANSACTION_STATE_READY;
+	pk_transaction_status_changed_emit (transaction, PK_STATUS_ENUM_WAIT);
+
+	g_debug ("%s will be resumed", priv->tid);
+}
+
 static void
 pk_transaction_class_init (PkTransactionClass *klass)
 {
@@ -5033,6 +7956,7 @@ pk_transaction_init (PkTransaction *transaction)
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
 	transaction->priv = PK_TRANSACTION_GET_PRIVATE (transaction);
+	transaction->priv->time_created = g_get_monotonic_time ();
 	transaction->priv->allow_cancel = TRUE;
 	transaction->priv->caller_active = TRUE;
 	transaction->priv->cached_transaction_flags = PK_TRANSACTION_FLAG_ENUM_NONE;
@@ -5042,9 +7966,14 @@ pk_transaction_init (PkTransaction *transaction)
 	transaction->priv->status = PK_STATUS_ENUM_WAIT;
 	transaction->priv->percentage = PK_BACKEND_PERCENTAGE_INVALID;
 	transaction->priv->state = PK_TRANSACTION_STATE_UNKNOWN;
+	transaction->priv->results_fd = -1;
 	transaction->priv->dbus = pk_dbus_new ();
 	transaction->priv->results = pk_results_new ();
 	transaction->priv->supported_content_types = g_ptr_array_new_with_free_func (g_free);
+	transaction->priv->properties_pending = g_hash_table_new_full (g_direct_hash,
+								       g_direct_equal,
+								       NULL,
+								       (GDestroyNotify) g_variant_unref);
 	transaction->priv->cancellable = g_cancellable_new ();
 
 	transaction->priv->transaction_db = pk_transaction_db_new ();
@@ -5062,6 +7991,24 @@ pk_transaction_dispose (GObject *object)
 
 	transaction = PK_TRANSACTION (object);
 
+	/* never emit a batch for a transaction we are destroying */
+	if (transaction->priv->packages_flush_id != 0) {
+		g_source_remove (transaction->priv->packages_flush_id);
+		transaction->priv->packages_flush_id = 0;
+	}
+	if (transaction->priv->properties_flush_id != 0) {
+		g_source_remove (transaction->priv->properties_flush_id);
+		transaction->priv->properties_flush_id = 0;
+	}
+	if (transaction->priv->items_progress_flush_id != 0) {
+		g_source_remove (transaction->priv->items_progress_flush_id);
+		transaction->priv->items_progress_flush_id = 0;
+	}
+	if (transaction->priv->cancel_deadline_id != 0) {
+		g_source_remove (transaction->priv->cancel_deadline_id);
+		transaction->priv->cancel_deadline_id = 0;
+	}
+
 	/* were we waiting for the client to authorise */
 	if (transaction->priv->waiting_for_auth) {
 		g_cancellable_cancel (transaction->priv->cancellable);
@@ -5070,27 +8017,51 @@ pk_transaction_dispose (GObject *object)
 		pk_transaction_finished_emit (transaction, PK_EXIT_ENUM_FAILED, 0);
 	}
 
-	if (transaction->priv->registration_id > 0) {
-		g_dbus_connection_unregister_object (transaction->priv->connection,
-						     transaction->priv->registration_id);
-		transaction->priv->registration_id = 0;
-	}
-
 	/* send signal to clients that we are about to be destroyed */
 	if (transaction->priv->connection != NULL) {
 		g_debug ("emitting destroy %s", transaction->priv->tid);
-		g_dbus_connection_emit_signal (transaction->priv->connection,
-					       NULL,
-					       transaction->priv->tid,
-					       PK_DBUS_INTERFACE_TRANSACTION,
-					       "Destroy",
-					       NULL,
-					       NULL);
+		pk_transaction_emit_signal (transaction,
+					    PK_DBUS_INTERFACE_TRANSACTION,
+					    "Destroy",
+					    NULL);
 	}
+	pk_transaction_peer_detach (transaction);
 
 	G_OBJECT_CLASS (pk_transaction_parent_class)->dispose (object);
 }
 
+#ifdef HAVE_MALLOC_TRIM
+static guint pk_transaction_trim_id = 0;
+
+static gboolean
+pk_transaction_trim_cb (gpointer user_data)
+{
+	g_debug ("returning freed heap to the system");
+	malloc_trim (0);
+	pk_transaction_trim_id = 0;
+	return G_SOURCE_REMOVE;
+}
+#endif
+
+/**
+ * pk_transaction_trim_schedule:
+ *
+ * The many small result items of a big query are freed one by one and
+ * leave the heap fragmented, so ask glibc to release the free pages once
+ * the daemon is idle. Transactions finishing together share one trim.
+ **/
+static void
+pk_transaction_trim_schedule (void)
+{
+#ifdef HAVE_MALLOC_TRIM
+	if (pk_transaction_trim_id != 0)
+		return;
+	pk_transaction_trim_id = g_idle_add_full (G_PRIORITY_LOW,
+						  pk_transaction_trim_cb,
+						  NULL, NULL);
+#endif
+}
+
 static void
 pk_transaction_finalize (GObject *object)
 {
@@ -5108,8 +8079,15 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->cached_package_id);
 	g_free (transaction->priv->cached_key_id);
 	g_strfreev (transaction->priv->cached_package_ids);
+	if (transaction->priv->input_items != NULL)
+		g_ptr_array_unref (transaction->priv->input_items);
 	g_free (transaction->priv->cached_transaction_id);
 	g_free (transaction->priv->cached_directory);
+	if (transaction->priv->cached_file_dir != NULL) {
+		pk_directory_remove_contents (transaction->priv->cached_file_dir);
+		g_rmdir (transaction->priv->cached_file_dir);
+		g_free (transaction->priv->cached_file_dir);
+	}
 	g_strfreev (transaction->priv->cached_values);
 	g_free (transaction->priv->cached_repo_id);
 	g_free (transaction->priv->cached_parameter);
@@ -5117,7 +8095,24 @@ pk_transaction_finalize (GObject *object)
 	g_free (transaction->priv->tid);
 	g_free (transaction->priv->sender);
 	g_free (transaction->priv->cmdline);
+	g_clear_error (&transaction->priv->hints_error);
+	g_free (transaction->priv->plan_hint);
+	g_free (transaction->priv->plan);
+	g_free (transaction->priv->cursor);
+	g_free (transaction->priv->search_session);
+	g_strfreev (transaction->priv->own_package_ids);
+	if (transaction->priv->coalesced_names != NULL)
+		g_hash_table_unref (transaction->priv->coalesced_names);
+	if (transaction->priv->coalesced_results != NULL)
+		g_object_unref (transaction->priv->coalesced_results);
 	g_ptr_array_unref (transaction->priv->supported_content_types);
+	g_hash_table_unref (transaction->priv->properties_pending);
+	if (transaction->priv->items_progress != NULL)
+		g_hash_table_unref (transaction->priv->items_progress);
+	if (transaction->priv->packages_builder != NULL)
+		g_variant_builder_unref (transaction->priv->packages_builder);
+	if (transaction->priv->results_fd >= 0)
+		close (transaction->priv->results_fd);
 
 	if (transaction->priv->connection != NULL)
 		g_object_unref (transaction->priv->connection);
@@ -5128,22 +8123,48 @@ pk_transaction_finalize (GObject *object)
 	g_object_unref (transaction->priv->dbus);
 	if (transaction->priv->backend != NULL)
 		g_object_unref (transaction->priv->backend);
+	if (transaction->priv->query_cache != NULL)
+		g_object_unref (transaction->priv->query_cache);
+	if (transaction->priv->plan_cache != NULL)
+		g_object_unref (transaction->priv->plan_cache);
+	if (transaction->priv->search_sessions != NULL)
+		g_object_unref (transaction->priv->search_sessions);
+	if (transaction->priv->auth_cache != NULL)
+		g_object_unref (transaction->priv->auth_cache);
+	if (transaction->priv->metrics != NULL)
+		g_object_unref (transaction->priv->metrics);
+	if (transaction->priv->shared_results != NULL)
+		g_object_unref (transaction->priv->shared_results);
 	g_object_unref (transaction->priv->job);
 	g_object_unref (transaction->priv->transaction_db);
 	g_object_unref (transaction->priv->results);
 	if (transaction->priv->authority != NULL)
 		g_object_unref (transaction->priv->authority);
 	g_object_unref (transaction->priv->cancellable);
+	if (transaction->priv->bytes_emitted >= PK_TRANSACTION_TRIM_THRESHOLD)
+		pk_transaction_trim_schedule ();
 
 	G_OBJECT_CLASS (pk_transaction_parent_class)->finalize (object);
 }
 
+static guint
+pk_transaction_get_properties_interval (GKeyFile *conf)
+{
+	gint rate = PK_TRANSACTION_PROPERTIES_MAX_RATE_DEFAULT;
+	if (g_key_file_has_key (conf, "Daemon", "PropertiesChangedMaxRate", NULL))
+		rate = g_key_file_get_integer (conf, "Daemon", "PropertiesChangedMaxRate", NULL);
+	if (rate <= 0)
+		return 0;
+	return 1000 / MIN (rate, 1000);
+}
+
 PkTransaction *
 pk_transaction_new (GKeyFile *conf, GDBusNodeInfo *introspection)
 {
 	PkTransaction *transaction;
 	transaction = g_object_new (PK_TYPE_TRANSACTION, NULL);
 	transaction->priv->conf = g_key_file_ref (conf);
+	transaction->priv->properties_interval = pk_transaction_get_properties_interval (conf);
 	transaction->priv->job = pk_backend_job_new (conf);
 	transaction->priv->introspection = g_dbus_node_info_ref (introspection);
 	return PK_TRANSACTION (transaction);
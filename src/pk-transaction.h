@@ -27,6 +27,11 @@
 #include <packagekit-glib2/pk-results.h>
 
 #include "pk-backend.h"
+#include "pk-auth-cache.h"
+#include "pk-plan-cache.h"
+#include "pk-metrics.h"
+#include "pk-query-cache.h"
+#include "pk-search-sessions.h"
 
 G_BEGIN_DECLS
 
@@ -78,7 +83,24 @@ PkRoleEnum	 pk_transaction_get_role			(PkTransaction	*transaction);
 guint		 pk_transaction_get_uid				(PkTransaction	*transaction);
 void		 pk_transaction_set_backend			(PkTransaction	*transaction,
 								 PkBackend	*backend);
+void		 pk_transaction_set_query_cache			(PkTransaction	*transaction,
+								 PkQueryCache	*query_cache);
+void		 pk_transaction_set_plan_cache			(PkTransaction	*transaction,
+								 PkPlanCache	*plan_cache);
+void		 pk_transaction_set_search_sessions		(PkTransaction	*transaction,
+								 PkSearchSessions *search_sessions);
+void		 pk_transaction_set_auth_cache			(PkTransaction	*transaction,
+								 PkAuthCache	*auth_cache);
+void		 pk_transaction_set_metrics			(PkTransaction	*transaction,
+								 PkMetrics	*metrics);
 PkBackendJob	*pk_transaction_get_backend_job 		(PkTransaction	*transaction);
+PkResults	*pk_transaction_get_results			(PkTransaction	*transaction);
+void		 pk_transaction_set_shared_results		(PkTransaction	*transaction,
+								 PkResults	*results);
+PkResults	*pk_transaction_get_results_before_refresh	(PkTransaction	*transaction)
+								 G_GNUC_WARN_UNUSED_RESULT;
+gchar		*pk_transaction_get_query_key			(PkTransaction	*transaction)
+								 G_GNUC_WARN_UNUSED_RESULT;
 PkTransactionState pk_transaction_get_state			(PkTransaction	*transaction);
 void		 pk_transaction_set_state			(PkTransaction	*transaction,
 								 PkTransactionState state);
@@ -87,9 +109,25 @@ const gchar	*pk_transaction_get_tid				(PkTransaction	*transaction);
 gboolean	 pk_transaction_is_exclusive			(PkTransaction	*transaction);
 gboolean	 pk_transaction_is_finished_with_lock_required	(PkTransaction *transaction);
 void		 pk_transaction_reset_after_lock_error		(PkTransaction *transaction);
+gboolean	 pk_transaction_is_preempted			(PkTransaction *transaction);
+void		 pk_transaction_reset_after_preempt		(PkTransaction *transaction);
+gchar		*pk_transaction_get_coalesce_key		(PkTransaction	*transaction)
+								 G_GNUC_WARN_UNUSED_RESULT;
+void		 pk_transaction_coalesce			(PkTransaction	*transaction,
+								 PkTransaction	*follower);
+PkResults	*pk_transaction_get_coalesced_results		(PkTransaction	*transaction,
+								 PkTransaction	*follower);
+gboolean	 pk_transaction_is_coalesce_failed		(PkTransaction *transaction);
+void		 pk_transaction_reset_after_coalesce		(PkTransaction *transaction);
+void		 pk_transaction_set_coalesce			(PkTransaction	*transaction,
+								 gboolean	 coalesce);
 void		 pk_transaction_make_exclusive			(PkTransaction *transaction);
 void		 pk_transaction_skip_auth_checks		(PkTransaction *transaction,
 								 gboolean skip_checks);
+gboolean	 pk_transaction_attach_peer			(PkTransaction	*transaction,
+								 GDBusConnection *connection,
+								 GError		**error);
+const GDBusInterfaceVTable *pk_transaction_get_interface_vtable	(void);
 
 G_END_DECLS
 
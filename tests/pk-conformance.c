@@ -0,0 +1,512 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2026 The PackageKit Authors
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Runs the same read-only workloads against whatever backend the running
+ * daemon has loaded, and prints the latency, result counts and daemon peak
+ * RSS of each as JSON. Two reports taken on the same hardware can then be
+ * compared between backends, or between releases of one backend.
+ *
+ * The inputs are taken from the installed packages, so the workloads are
+ * the same shape on every distro. Roles that change the system are listed
+ * as not covered rather than run.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <packagekit-glib2/packagekit.h>
+
+typedef enum {
+	PK_CONFORMANCE_INPUT_NONE,
+	PK_CONFORMANCE_INPUT_NAMES,
+	PK_CONFORMANCE_INPUT_SEARCH,
+	PK_CONFORMANCE_INPUT_FILE,
+	PK_CONFORMANCE_INPUT_ALL_IDS,
+	PK_CONFORMANCE_INPUT_SAMPLE_IDS,
+} PkConformanceInput;
+
+typedef struct {
+	const gchar		*name;
+	PkRoleEnum		 role;
+	PkConformanceInput	 input;
+	guint			 count;
+} PkConformanceWorkload;
+
+static const PkConformanceWorkload workloads[] = {
+	{ "resolve-1",			PK_ROLE_ENUM_RESOLVE,		PK_CONFORMANCE_INPUT_NAMES,	1 },
+	{ "resolve-100",		PK_ROLE_ENUM_RESOLVE,		PK_CONFORMANCE_INPUT_NAMES,	100 },
+	{ "resolve-10000",		PK_ROLE_ENUM_RESOLVE,		PK_CONFORMANCE_INPUT_NAMES,	10000 },
+	{ "search-name",		PK_ROLE_ENUM_SEARCH_NAME,	PK_CONFORMANCE_INPUT_SEARCH,	0 },
+	{ "search-details",		PK_ROLE_ENUM_SEARCH_DETAILS,	PK_CONFORMANCE_INPUT_SEARCH,	0 },
+	{ "search-file",		PK_ROLE_ENUM_SEARCH_FILE,	PK_CONFORMANCE_INPUT_FILE,	0 },
+	{ "get-packages",		PK_ROLE_ENUM_GET_PACKAGES,	PK_CONFORMANCE_INPUT_NONE,	0 },
+	{ "get-details",		PK_ROLE_ENUM_GET_DETAILS,	PK_CONFORMANCE_INPUT_ALL_IDS,	0 },
+	{ "get-files",			PK_ROLE_ENUM_GET_FILES,		PK_CONFORMANCE_INPUT_ALL_IDS,	0 },
+	{ "get-updates",		PK_ROLE_ENUM_GET_UPDATES,	PK_CONFORMANCE_INPUT_NONE,	0 },
+	{ "depends-on-recursive",	PK_ROLE_ENUM_DEPENDS_ON,	PK_CONFORMANCE_INPUT_SAMPLE_IDS, 0 },
+	{ "required-by-recursive",	PK_ROLE_ENUM_REQUIRED_BY,	PK_CONFORMANCE_INPUT_SAMPLE_IDS, 0 },
+	{ NULL,				PK_ROLE_ENUM_UNKNOWN,		PK_CONFORMANCE_INPUT_NONE,	0 }
+};
+
+typedef struct {
+	PkClient		*client;
+	gchar			**names;	/* of the installed packages */
+	gchar			**package_ids;	/* of the installed packages */
+	gchar			**sample_ids;
+	gchar			*search;
+	gchar			*file;
+	guint			 iterations;
+} PkConformance;
+
+static gint
+pk_conformance_sort_double_cb (gconstpointer a, gconstpointer b)
+{
+	gdouble da = *((const gdouble *) a);
+	gdouble db = *((const gdouble *) b);
+	if (da < db)
+		return -1;
+	if (da > db)
+		return 1;
+	return 0;
+}
+
+static gdouble
+pk_conformance_percentile (GArray *sorted, gdouble percentile)
+{
+	guint idx;
+	if (sorted->len == 0)
+		return 0.f;
+	idx = (guint) (percentile / 100.f * sorted->len + 0.5f);
+	idx = CLAMP (idx, 1, sorted->len) - 1;
+	return g_array_index (sorted, gdouble, idx);
+}
+
+static void
+pk_conformance_json_add_double (GString *str, const gchar *key, gdouble value, gboolean comma)
+{
+	gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+	g_string_append_printf (str, "\"%s\": %s%s", key,
+				g_ascii_formatd (buf, sizeof (buf), "%.3f", value),
+				comma ? ", " : "");
+}
+
+static void
+pk_conformance_json_add_string (GString *str, const gchar *key, const gchar *value, gboolean comma)
+{
+	g_autofree gchar *escaped = g_strescape (value != NULL ? value : "", NULL);
+	g_string_append_printf (str, "\"%s\": \"%s\"%s", key, escaped, comma ? ", " : "");
+}
+
+/* VmHWM of the daemon, as most backends run in-process */
+static gint64
+pk_conformance_get_daemon_peak_rss (void)
+{
+	guint32 pid = 0;
+	gint64 rss = -1;
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *filename = NULL;
+	g_auto(GStrv) lines = NULL;
+	g_autoptr(GDBusConnection) connection = NULL;
+	g_autoptr(GVariant) value = NULL;
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+	if (connection == NULL)
+		return -1;
+	value = g_dbus_connection_call_sync (connection,
+					     "org.freedesktop.DBus",
+					     "/org/freedesktop/DBus",
+					     "org.freedesktop.DBus",
+					     "GetConnectionUnixProcessID",
+					     g_variant_new ("(s)", PK_DBUS_SERVICE),
+					     G_VARIANT_TYPE ("(u)"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1, NULL, NULL);
+	if (value == NULL)
+		return -1;
+	g_variant_get (value, "(u)", &pid);
+
+	filename = g_strdup_printf ("/proc/%u/status", pid);
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return -1;
+	lines = g_strsplit (contents, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], "VmHWM:"))
+			rss = g_ascii_strtoll (lines[i] + strlen ("VmHWM:"), NULL, 10);
+	}
+	return rss;
+}
+
+/* the inputs every backend can answer: what it says is installed */
+static gboolean
+pk_conformance_load_installed (PkConformance *conformance, guint sample, GError **error)
+{
+	PkPackage *package;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GPtrArray) names = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) package_ids = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) sample_ids = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_get_packages (conformance->client,
+					  pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+					  NULL, NULL, NULL, error);
+	if (results == NULL)
+		return FALSE;
+	array = pk_results_get_package_array (results);
+	if (array->len == 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+				     "the backend reports no installed packages");
+		return FALSE;
+	}
+	for (guint i = 0; i < array->len; i++) {
+		package = g_ptr_array_index (array, i);
+		g_ptr_array_add (names, g_strdup (pk_package_get_name (package)));
+		g_ptr_array_add (package_ids, g_strdup (pk_package_get_id (package)));
+	}
+
+	/* spread over the list, so it is not all one letter */
+	for (guint i = 0; i < MIN (sample, array->len); i++) {
+		package = g_ptr_array_index (array, i * array->len / MIN (sample, array->len));
+		g_ptr_array_add (sample_ids, g_strdup (pk_package_get_id (package)));
+	}
+	if (conformance->search == NULL) {
+		package = g_ptr_array_index (array, array->len / 2);
+		conformance->search = g_strdup (pk_package_get_name (package));
+	}
+
+	g_ptr_array_add (names, NULL);
+	g_ptr_array_add (package_ids, NULL);
+	g_ptr_array_add (sample_ids, NULL);
+	conformance->names = (gchar **) g_ptr_array_free (g_steal_pointer (&names), FALSE);
+	conformance->package_ids = (gchar **) g_ptr_array_free (g_steal_pointer (&package_ids), FALSE);
+	conformance->sample_ids = (gchar **) g_ptr_array_free (g_steal_pointer (&sample_ids), FALSE);
+	return TRUE;
+}
+
+/* repeats the installed names when there are fewer than asked for */
+static gchar **
+pk_conformance_get_names (PkConformance *conformance, guint count)
+{
+	guint len = g_strv_length (conformance->names);
+	gchar **names = g_new0 (gchar *, count + 1);
+	for (guint i = 0; i < count; i++)
+		names[i] = g_strdup (conformance->names[i % len]);
+	return names;
+}
+
+static PkResults *
+pk_conformance_run_once (PkConformance *conformance,
+			 const PkConformanceWorkload *workload,
+			 gchar **names,
+			 GError **error)
+{
+	PkBitfield filters = pk_bitfield_value (PK_FILTER_ENUM_NONE);
+	gchar *values[] = { NULL, NULL };
+
+	switch (workload->role) {
+	case PK_ROLE_ENUM_RESOLVE:
+		return pk_client_resolve (conformance->client, filters, names,
+					  NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_SEARCH_NAME:
+		values[0] = conformance->search;
+		return pk_client_search_names (conformance->client, filters, values,
+					       NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_SEARCH_DETAILS:
+		values[0] = conformance->search;
+		return pk_client_search_details (conformance->client, filters, values,
+						 NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_SEARCH_FILE:
+		values[0] = conformance->file;
+		return pk_client_search_files (conformance->client, filters, values,
+					       NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_GET_PACKAGES:
+		return pk_client_get_packages (conformance->client, filters,
+					       NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_GET_DETAILS:
+		return pk_client_get_details (conformance->client, conformance->package_ids,
+					      NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_GET_FILES:
+		return pk_client_get_files (conformance->client, conformance->package_ids,
+					    NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_GET_UPDATES:
+		return pk_client_get_updates (conformance->client, filters,
+					      NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_DEPENDS_ON:
+		return pk_client_depends_on (conformance->client, filters,
+					     conformance->sample_ids, TRUE,
+					     NULL, NULL, NULL, error);
+	case PK_ROLE_ENUM_REQUIRED_BY:
+		return pk_client_required_by (conformance->client, filters,
+					      conformance->sample_ids, TRUE,
+					      NULL, NULL, NULL, error);
+	default:
+		g_assert_not_reached ();
+	}
+	return NULL;
+}
+
+/* the packages, details and files the backend emitted, whichever apply */
+static guint
+pk_conformance_count_results (PkResults *results)
+{
+	g_autoptr(GPtrArray) packages = pk_results_get_package_array (results);
+	g_autoptr(GPtrArray) details = pk_results_get_details_array (results);
+	g_autoptr(GPtrArray) files = pk_results_get_files_array (results);
+	return packages->len + details->len + files->len;
+}
+
+static void
+pk_conformance_run (PkConformance *conformance,
+		    const PkConformanceWorkload *workload,
+		    PkBitfield roles,
+		    GString *json,
+		    gboolean comma)
+{
+	gdouble sum = 0.f;
+	gint64 rss;
+	guint count = 0;
+	g_autofree gchar *failure = NULL;
+	g_auto(GStrv) names = NULL;
+	g_autoptr(GArray) latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+	g_string_append (json, "    { ");
+	pk_conformance_json_add_string (json, "workload", workload->name, TRUE);
+	pk_conformance_json_add_string (json, "role",
+					pk_role_enum_to_string (workload->role), TRUE);
+
+	if (!pk_bitfield_contain (roles, workload->role)) {
+		pk_conformance_json_add_string (json, "status", "unsupported", FALSE);
+		g_string_append_printf (json, " }%s\n", comma ? "," : "");
+		return;
+	}
+	if (workload->input == PK_CONFORMANCE_INPUT_NAMES)
+		names = pk_conformance_get_names (conformance, workload->count);
+
+	for (guint i = 0; i < conformance->iterations; i++) {
+		gdouble latency;
+		gint64 start = g_get_monotonic_time ();
+		g_autoptr(GError) error = NULL;
+		g_autoptr(PkResults) results = NULL;
+
+		results = pk_conformance_run_once (conformance, workload, names, &error);
+		latency = (gdouble) (g_get_monotonic_time () - start) / 1000.f;
+		if (results == NULL) {
+			failure = g_strdup (error->message);
+			break;
+		}
+		if (pk_results_get_exit_code (results) != PK_EXIT_ENUM_SUCCESS) {
+			g_autoptr(PkError) error_code = pk_results_get_error_code (results);
+			failure = g_strdup (error_code != NULL ?
+					    pk_error_get_details (error_code) :
+					    pk_exit_enum_to_string (pk_results_get_exit_code (results)));
+			break;
+		}
+		count = pk_conformance_count_results (results);
+		g_array_append_val (latencies, latency);
+		sum += latency;
+	}
+
+	if (failure != NULL) {
+		pk_conformance_json_add_string (json, "status", "failed", TRUE);
+		pk_conformance_json_add_string (json, "error", failure, FALSE);
+		g_string_append_printf (json, " }%s\n", comma ? "," : "");
+		return;
+	}
+
+	g_array_sort (latencies, pk_conformance_sort_double_cb);
+	pk_conformance_json_add_string (json, "status", "ok", TRUE);
+	if (workload->input == PK_CONFORMANCE_INPUT_ALL_IDS)
+		g_string_append_printf (json, "\"inputs\": %u, ", g_strv_length (conformance->package_ids));
+	else if (workload->input == PK_CONFORMANCE_INPUT_SAMPLE_IDS)
+		g_string_append_printf (json, "\"inputs\": %u, ", g_strv_length (conformance->sample_ids));
+	else if (workload->input == PK_CONFORMANCE_INPUT_NAMES)
+		g_string_append_printf (json, "\"inputs\": %u, ", workload->count);
+	g_string_append_printf (json, "\"results\": %u, ", count);
+	g_string_append (json, "\"latency-ms\": { ");
+	pk_conformance_json_add_double (json, "min", pk_conformance_percentile (latencies, 0.f), TRUE);
+	pk_conformance_json_add_double (json, "mean", sum / latencies->len, TRUE);
+	pk_conformance_json_add_double (json, "p50", pk_conformance_percentile (latencies, 50.f), TRUE);
+	pk_conformance_json_add_double (json, "p95", pk_conformance_percentile (latencies, 95.f), TRUE);
+	pk_conformance_json_add_double (json, "p99", pk_conformance_percentile (latencies, 99.f), TRUE);
+	pk_conformance_json_add_double (json, "max", pk_conformance_percentile (latencies, 100.f), FALSE);
+	g_string_append (json, " }, ");
+
+	/* the high water mark only grows, so this is the peak up to here */
+	rss = pk_conformance_get_daemon_peak_rss ();
+	if (rss >= 0)
+		g_string_append_printf (json, "\"daemon-peak-rss-kb\": %" G_GINT64_FORMAT, rss);
+	else
+		g_string_append (json, "\"daemon-peak-rss-kb\": null");
+	g_string_append_printf (json, " }%s\n", comma ? "," : "");
+}
+
+int
+main (int argc, char *argv[])
+{
+	gboolean first = TRUE;
+	gint iterations = 5;
+	gint sample = 10;
+	GOptionContext *context;
+	PkBitfield roles = 0;
+	PkConformance conformance = { 0 };
+	g_autofree gchar *backend_name = NULL;
+	g_autofree gchar *distro_id = NULL;
+	g_autofree gchar *output = NULL;
+	g_autofree gchar *selected = NULL;
+	g_auto(GStrv) selected_split = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) to_run = g_ptr_array_new ();
+	g_autoptr(GString) json = NULL;
+	g_autoptr(PkControl) control = NULL;
+
+	const GOptionEntry options[] = {
+		{ "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+			"Times each workload is run", "N" },
+		{ "sample", 's', 0, G_OPTION_ARG_INT, &sample,
+			"Installed packages to ask depends-on and required-by for", "N" },
+		{ "search", 0, 0, G_OPTION_ARG_STRING, &conformance.search,
+			"Term for the name and details searches, default an installed name", "TERM" },
+		{ "file", 0, 0, G_OPTION_ARG_STRING, &conformance.file,
+			"Path for the file search, default /usr/bin/env", "PATH" },
+		{ "workloads", 'w', 0, G_OPTION_ARG_STRING, &selected,
+			"Comma separated workloads to run, default all of them", "NAMES" },
+		{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+			"Write the JSON to a file rather than stdout", "FILE" },
+		{ NULL}
+	};
+
+	context = g_option_context_new (NULL);
+	g_option_context_set_summary (context, "PackageKit Backend Conformance");
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_add_group (context, pk_debug_get_option_group ());
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("Failed to parse options: %s\n", error->message);
+		g_option_context_free (context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free (context);
+
+	if (iterations < 1 || sample < 1) {
+		g_printerr ("--iterations and --sample must be at least 1\n");
+		return EXIT_FAILURE;
+	}
+	conformance.iterations = iterations;
+	if (selected != NULL) {
+		selected_split = g_strsplit (selected, ",", -1);
+		for (guint i = 0; selected_split[i] != NULL; i++) {
+			gboolean found = FALSE;
+			for (guint j = 0; workloads[j].name != NULL; j++) {
+				if (g_strcmp0 (workloads[j].name, selected_split[i]) == 0)
+					found = TRUE;
+			}
+			if (!found) {
+				g_printerr ("Workload %s is not known\n", selected_split[i]);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	if (conformance.file == NULL)
+		conformance.file = g_strdup ("/usr/bin/env");
+
+	control = pk_control_new ();
+	if (!pk_control_get_properties (control, NULL, &error)) {
+		g_printerr ("Failed to contact the daemon: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+	g_object_get (control,
+		      "roles", &roles,
+		      "backend-name", &backend_name,
+		      "distro-id", &distro_id,
+		      NULL);
+
+	conformance.client = pk_client_new ();
+	pk_client_set_background (conformance.client, FALSE);
+	pk_client_set_interactive (conformance.client, FALSE);
+	if (!pk_bitfield_contain (roles, PK_ROLE_ENUM_GET_PACKAGES)) {
+		g_printerr ("The %s backend cannot list packages\n", backend_name);
+		return EXIT_FAILURE;
+	}
+	if (!pk_conformance_load_installed (&conformance, sample, &error)) {
+		g_printerr ("Failed to get the installed packages: %s\n", error->message);
+		return EXIT_FAILURE;
+	}
+
+	json = g_string_new ("{\n  ");
+	pk_conformance_json_add_string (json, "version", VERSION, FALSE);
+	g_string_append (json, ",\n  ");
+	pk_conformance_json_add_string (json, "backend", backend_name, FALSE);
+	g_string_append (json, ",\n  ");
+	pk_conformance_json_add_string (json, "distro-id", distro_id, FALSE);
+	g_string_append_printf (json, ",\n  \"processors\": %u,\n", g_get_num_processors ());
+	g_string_append_printf (json, "  \"iterations\": %i,\n", iterations);
+	g_string_append_printf (json, "  \"installed\": %u,\n", g_strv_length (conformance.package_ids));
+	g_string_append (json, "  \"workloads\": [\n");
+	for (guint i = 0; workloads[i].name != NULL; i++) {
+		if (selected_split != NULL &&
+		    !g_strv_contains ((const gchar * const *) selected_split, workloads[i].name))
+			continue;
+		g_ptr_array_add (to_run, (gpointer) &workloads[i]);
+	}
+	for (guint i = 0; i < to_run->len; i++) {
+		pk_conformance_run (&conformance, g_ptr_array_index (to_run, i),
+				    roles, json, i + 1 < to_run->len);
+	}
+	g_string_append (json, "  ],\n");
+
+	/* what the backend can do that no workload drives */
+	g_string_append (json, "  \"not-covered\": [");
+	for (guint role = PK_ROLE_ENUM_UNKNOWN + 1; role < PK_ROLE_ENUM_LAST; role++) {
+		gboolean covered = FALSE;
+		if (!pk_bitfield_contain (roles, role))
+			continue;
+		for (guint i = 0; workloads[i].name != NULL; i++) {
+			if (workloads[i].role == role)
+				covered = TRUE;
+		}
+		if (covered)
+			continue;
+		g_string_append_printf (json, "%s\"%s\"", first ? " " : ", ",
+					pk_role_enum_to_string (role));
+		first = FALSE;
+	}
+	g_string_append (json, first ? "]\n" : " ]\n");
+	g_string_append (json, "}\n");
+
+	g_object_unref (conformance.client);
+	g_strfreev (conformance.names);
+	g_strfreev (conformance.package_ids);
+	g_strfreev (conformance.sample_ids);
+	g_free (conformance.search);
+	g_free (conformance.file);
+
+	if (output == NULL) {
+		g_print ("%s", json->str);
+		return EXIT_SUCCESS;
+	}
+	if (!g_file_set_contents (output, json->str, json->len, &error)) {
+		g_printerr ("Failed to write %s: %s\n", output, error->message);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}